@@ -55,6 +55,27 @@
 #define PLD(code...)
 #endif
 
+/*
+ * How far ahead of the source the copy loops preload.  A multiple of
+ * 32 bytes, the amount one pass of the unrolled loops moves.
+ */
+#define PLD_DISTANCE	CONFIG_ARM_COPY_PLD_DISTANCE
+
+#if PLD_DISTANCE % 32
+#error CONFIG_ARM_COPY_PLD_DISTANCE must be a multiple of 32
+#endif
+
+/*
+ * Preload [base + first, base + last] every step bytes, used to warm
+ * up the first PLD_DISTANCE bytes ahead of a copy loop.
+ */
+	.macro	pld_range, base, first, last, step=32
+	.if	(\first) <= (\last)
+	pld	[\base, #(\first)]
+	pld_range \base, (\first)+(\step), \last, \step
+	.endif
+	.endm
+
 /*
  * This can be used to enable code to cacheline align the destination
  * pointer when bulk writing to memory.  Experiments on StrongARM and
@@ -63,8 +84,10 @@
  * is used).
  *
  * On Feroceon there is much to gain however, regardless of cache mode.
+ * Cortex-A9 also benefits since it avoids partial line writes through
+ * the store buffer to the L2.
  */
-#ifdef CONFIG_CPU_FEROCEON
+#ifdef CONFIG_ARM_COPY_ALIGN_DEST
 #define CALGN(code...) code
 #else
 #define CALGN(code...)
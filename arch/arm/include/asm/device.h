@@ -10,6 +10,13 @@ struct dev_archdata {
 #ifdef CONFIG_DMABOUNCE
 	struct dmabounce_device_info *dmabounce;
 #endif
+	/*
+	 * Set by drivers whose DMA_FROM_DEVICE scatterlist buffers are
+	 * never written by the CPU between dma_unmap_sg() and the next
+	 * dma_map_sg().  The lines are then known to be clean and the
+	 * invalidate at map time is skipped for line-aligned segments.
+	 */
+	unsigned int dma_rx_clean:1;
 };
 
 struct pdev_archdata {
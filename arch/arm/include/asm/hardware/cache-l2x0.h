@@ -24,9 +24,12 @@
 #define   L2X0_CACHE_ID_PART_MASK	(0xf << 6)
 #define   L2X0_CACHE_ID_PART_L210	(1 << 6)
 #define   L2X0_CACHE_ID_PART_L310	(3 << 6)
+#define   L2X0_CACHE_ID_RTL_MASK	0x3f
+#define   L2X0_CACHE_ID_RTL_R2P0	0x4
 #define L2X0_CACHE_TYPE			0x004
 #define L2X0_CTRL			0x100
 #define L2X0_AUX_CTRL			0x104
+#define   L2X0_AUX_CTRL_WAY_SIZE_MASK	(0x7 << 17)
 #define L2X0_TAG_LATENCY_CTRL		0x108
 #define L2X0_DATA_LATENCY_CTRL		0x10C
 #define L2X0_EVENT_CNT_CTRL		0x200
@@ -40,6 +40,10 @@ extern const struct mem_type *get_mem_type(unsigned int type);
  */
 extern int ioremap_page(unsigned long virt, unsigned long phys,
 			const struct mem_type *mtype);
+/*
+ * use 64K large pages for the aligned parts of an existing kernel mapping
+ */
+extern void remap_kernel_large_pages(unsigned long start, unsigned long end);
 #else
 #define iotable_init(map,num)	do { } while (0)
 #endif
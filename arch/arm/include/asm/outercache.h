@@ -27,6 +27,10 @@ struct outer_cache_fns {
 	void (*flush_range)(unsigned long, unsigned long);
 #ifdef CONFIG_OUTER_CACHE_SYNC
 	void (*sync)(void);
+	/* as above, but the caller does outer_sync() when it is done */
+	void (*inv_range_nosync)(unsigned long, unsigned long);
+	void (*clean_range_nosync)(unsigned long, unsigned long);
+	void (*flush_range_nosync)(unsigned long, unsigned long);
 #endif
 };
 
@@ -67,9 +71,43 @@ static inline void outer_sync(void)
 	if (outer_cache.sync)
 		outer_cache.sync();
 }
+
+/*
+ * Range operations that leave the final cache sync to the caller, for
+ * walking many ranges back to back.  They must be followed by
+ * outer_sync() before the memory is handed to a device.
+ */
+static inline void outer_inv_range_nosync(unsigned long start,
+					  unsigned long end)
+{
+	if (outer_cache.inv_range_nosync)
+		outer_cache.inv_range_nosync(start, end);
+	else
+		outer_inv_range(start, end);
+}
+static inline void outer_clean_range_nosync(unsigned long start,
+					    unsigned long end)
+{
+	if (outer_cache.clean_range_nosync)
+		outer_cache.clean_range_nosync(start, end);
+	else
+		outer_clean_range(start, end);
+}
+static inline void outer_flush_range_nosync(unsigned long start,
+					    unsigned long end)
+{
+	if (outer_cache.flush_range_nosync)
+		outer_cache.flush_range_nosync(start, end);
+	else
+		outer_flush_range(start, end);
+}
 #else
 static inline void outer_sync(void)
 { }
+
+#define outer_inv_range_nosync		outer_inv_range
+#define outer_clean_range_nosync	outer_clean_range
+#define outer_flush_range_nosync	outer_flush_range
 #endif
 
 #endif	/* __ASM_OUTERCACHE_H */
@@ -17,6 +17,25 @@ enum arm_pmu_type {
 	ARM_NUM_PMU_DEVICES,
 };
 
+/*
+ * Raw perf events with this bit set in their config do not belong to the
+ * CPU counters and are handed to platform_pmu_event_init() instead.
+ */
+#define ARM_PMU_PLATFORM_EVENT	(1 << 16)
+
+struct perf_event;
+struct pmu;
+
+/**
+ * platform_pmu_event_init() - claim a platform performance counter event
+ *
+ * Called for raw events carrying ARM_PMU_PLATFORM_EVENT, such as counters
+ * in a memory controller. Returns the pmu that will count the event, or an
+ * ERR_PTR() encoded error. The default implementation returns -ENOENT.
+ */
+extern const struct pmu *
+platform_pmu_event_init(struct perf_event *event);
+
 #ifdef CONFIG_CPU_HAS_PMU
 
 /**
@@ -74,4 +93,33 @@ init_pmu(enum arm_pmu_type device)
 
 #endif /* CONFIG_CPU_HAS_PMU */
 
+#ifdef CONFIG_HW_PERF_EVENTS
+
+/**
+ * armpmu_cpu_save() - save the perf counters of this CPU
+ *
+ * Called with interrupts disabled before a low power state that loses the
+ * PMU state. armpmu_cpu_restore() programs the counters again afterwards,
+ * whether or not the power was actually removed.
+ */
+extern void
+armpmu_cpu_save(void);
+
+extern void
+armpmu_cpu_restore(void);
+
+#else /* CONFIG_HW_PERF_EVENTS */
+
+static inline void
+armpmu_cpu_save(void)
+{
+}
+
+static inline void
+armpmu_cpu_restore(void)
+{
+}
+
+#endif /* CONFIG_HW_PERF_EVENTS */
+
 #endif /* __ARM_PMU_H__ */
@@ -14,11 +14,14 @@
  */
 #define pr_fmt(fmt) "hw perfevents: " fmt
 
+#include <linux/cpu.h>
+#include <linux/debugfs.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/perf_event.h>
 #include <linux/platform_device.h>
+#include <linux/seq_file.h>
 #include <linux/spinlock.h>
 #include <linux/uaccess.h>
 
@@ -79,6 +82,12 @@ static const char *arm_pmu_names[] = {
 	[ARM_PERF_PMU_ID_CA9]	  = "ARMv7 Cortex-A9",
 };
 
+/* A model specific event, listed in debugfs for use as a raw event. */
+struct armpmu_event_name {
+	const char	*name;
+	u32		event;
+};
+
 struct arm_pmu {
 	enum arm_perf_pmu_ids id;
 	irqreturn_t	(*handle_irq)(int irq_num, void *dev);
@@ -92,8 +101,11 @@ struct arm_pmu {
 	void		(*write_counter)(int idx, u32 val);
 	void		(*start)(void);
 	void		(*stop)(void);
+	void		(*reset)(void *);
 	int		num_events;
 	u64		max_period;
+	const struct armpmu_event_name *event_names;
+	int		num_event_names;
 };
 
 /* Set at runtime when we know what CPU type we are. */
@@ -360,6 +372,10 @@ armpmu_reserve_hardware(void)
 
 	init_pmu(ARM_PMU_DEVICE_CPU);
 
+	/* Secondary cores have never had their counters initialised. */
+	if (armpmu->reset)
+		on_each_cpu(armpmu->reset, NULL, 1);
+
 	if (pmu_device->num_resources < 1) {
 		pr_err("no irqs for PMUs defined\n");
 		return -ENODEV;
@@ -491,11 +507,21 @@ __hw_perf_event_init(struct perf_event *event)
 	return err;
 }
 
+const struct pmu * __weak
+platform_pmu_event_init(struct perf_event *event)
+{
+	return ERR_PTR(-ENOENT);
+}
+
 const struct pmu *
 hw_perf_event_init(struct perf_event *event)
 {
 	int err = 0;
 
+	if (PERF_TYPE_RAW == event->attr.type &&
+	    (event->attr.config & ARM_PMU_PLATFORM_EVENT))
+		return platform_pmu_event_init(event);
+
 	if (!armpmu)
 		return ERR_PTR(-ENODEV);
 
@@ -556,6 +582,95 @@ hw_perf_disable(void)
 		armpmu->stop();
 }
 
+/*
+ * Fold the counters of this CPU into their events before the core is
+ * powered down, and program them again once it is back.  Called with
+ * interrupts disabled around CPU power-gating idle states.
+ */
+void
+armpmu_cpu_save(void)
+{
+	struct cpu_hw_events *cpuc = &__get_cpu_var(cpu_hw_events);
+	int idx;
+
+	if (!armpmu || !pmu_device)
+		return;
+
+	if (bitmap_empty(cpuc->active_mask, ARMPMU_MAX_HWEVENTS))
+		return;
+
+	armpmu->stop();
+
+	for (idx = 0; idx <= armpmu->num_events; ++idx) {
+		struct perf_event *event = cpuc->events[idx];
+
+		if (!test_bit(idx, cpuc->active_mask))
+			continue;
+
+		armpmu_event_update(event, &event->hw, idx);
+	}
+}
+
+void
+armpmu_cpu_restore(void)
+{
+	struct cpu_hw_events *cpuc = &__get_cpu_var(cpu_hw_events);
+	int idx;
+
+	if (!armpmu || !pmu_device)
+		return;
+
+	if (bitmap_empty(cpuc->active_mask, ARMPMU_MAX_HWEVENTS))
+		return;
+
+	if (armpmu->reset)
+		armpmu->reset(NULL);
+
+	for (idx = 0; idx <= armpmu->num_events; ++idx) {
+		struct perf_event *event = cpuc->events[idx];
+
+		if (!test_bit(idx, cpuc->active_mask))
+			continue;
+
+		armpmu_event_set_period(event, &event->hw, idx);
+		armpmu->enable(&event->hw, idx);
+	}
+
+	armpmu->start();
+}
+
+/*
+ * A core coming back online starts with random counter state, and the
+ * overflow interrupt of its PMU was migrated to another core while it
+ * was down. That core cannot acknowledge it, so point it back.
+ */
+static int __cpuinit
+armpmu_cpu_notify(struct notifier_block *b, unsigned long action, void *hcpu)
+{
+	unsigned int cpu = (long)hcpu;
+	int irq;
+
+	if (!armpmu || !pmu_device)
+		return NOTIFY_DONE;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_STARTING:
+		if (armpmu->reset)
+			armpmu->reset(NULL);
+		break;
+	case CPU_ONLINE:
+		if (pmu_device->num_resources < 2)
+			break;
+		irq = platform_get_irq(pmu_device, cpu);
+		if (irq >= 0 && irq_set_affinity(irq, cpumask_of(cpu)))
+			pr_warning("unable to set irq affinity (irq=%d, "
+				   "cpu=%u)\n", irq, cpu);
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
 /*
  * ARMv6 Performance counter handling code.
  *
@@ -2067,6 +2182,51 @@ static u64 armv7pmu_raw_event(u64 config)
 	return config & 0xff;
 }
 
+static void armv7pmu_reset(void *info)
+{
+	int idx;
+
+	/* The enable and event select registers are unknown out of reset */
+	for (idx = ARMV7_CYCLE_COUNTER; idx <= armpmu->num_events; ++idx) {
+		armv7_pmnc_disable_counter(idx);
+		armv7_pmnc_disable_intens(idx);
+	}
+
+	armv7_pmnc_getreset_flags();
+	armv7_pmnc_write(ARMV7_PMNC_P | ARMV7_PMNC_C);
+}
+
+/*
+ * Cortex-A9 events without a generic perf equivalent, usable with
+ * perf as rNN.
+ */
+static const struct armpmu_event_name armv7_a9_event_names[] = {
+	{ "coherent-line-miss",		ARMV7_PERFCTR_COHERENT_LINE_MISS },
+	{ "coherent-line-hit",		ARMV7_PERFCTR_COHERENT_LINE_HIT },
+	{ "icache-dep-stall-cycles",	ARMV7_PERFCTR_ICACHE_DEP_STALL_CYCLES },
+	{ "dcache-dep-stall-cycles",	ARMV7_PERFCTR_DCACHE_DEP_STALL_CYCLES },
+	{ "tlb-miss-dep-stall-cycles",
+				ARMV7_PERFCTR_TLB_MISS_DEP_STALL_CYCLES },
+	{ "strex-passed",		ARMV7_PERFCTR_STREX_EXECUTED_PASSED },
+	{ "strex-failed",		ARMV7_PERFCTR_STREX_EXECUTED_FAILED },
+	{ "data-eviction",		ARMV7_PERFCTR_DATA_EVICTION },
+	{ "issue-no-dispatch",		ARMV7_PERFCTR_ISSUE_STAGE_NO_INST },
+	{ "issue-empty",		ARMV7_PERFCTR_ISSUE_STAGE_EMPTY },
+	{ "main-unit-inst",		ARMV7_PERFCTR_MAIN_UNIT_EXECUTED_INST },
+	{ "second-unit-inst",		ARMV7_PERFCTR_SECOND_UNIT_EXECUTED_INST },
+	{ "ld-st-unit-inst",		ARMV7_PERFCTR_LD_ST_UNIT_EXECUTED_INST },
+	{ "fp-inst",			ARMV7_PERFCTR_FP_EXECUTED_INST },
+	{ "pld-full-stall-cycles",	ARMV7_PERFCTR_PLD_FULL_DEP_STALL_CYCLES },
+	{ "write-full-stall-cycles",	ARMV7_PERFCTR_DATA_WR_DEP_STALL_CYCLES },
+	{ "itlb-miss-stall-cycles",	ARMV7_PERFCTR_ITLB_MISS_DEP_STALL_CYCLES },
+	{ "dtlb-miss-stall-cycles",	ARMV7_PERFCTR_DTLB_MISS_DEP_STALL_CYCLES },
+	{ "dmb-stall-cycles",		ARMV7_PERFCTR_DMB_DEP_STALL_CYCLES },
+	{ "isb-inst",			ARMV7_PERFCTR_ISB_INST },
+	{ "dsb-inst",			ARMV7_PERFCTR_DSB_INST },
+	{ "dmb-inst",			ARMV7_PERFCTR_DMB_INST },
+	{ "external-interrupts",	ARMV7_PERFCTR_EXT_INTERRUPTS },
+};
+
 static int armv7pmu_get_event_idx(struct cpu_hw_events *cpuc,
 				  struct hw_perf_event *event)
 {
@@ -2103,6 +2263,7 @@ static struct arm_pmu armv7pmu = {
 	.get_event_idx		= armv7pmu_get_event_idx,
 	.start			= armv7pmu_start,
 	.stop			= armv7pmu_stop,
+	.reset			= armv7pmu_reset,
 	.max_period		= (1LLU << 32) - 1,
 };
 
@@ -2959,6 +3120,9 @@ init_hw_perf_events(void)
 			memcpy(armpmu_perf_cache_map, armv7_a9_perf_cache_map,
 				sizeof(armv7_a9_perf_cache_map));
 			armv7pmu.event_map = armv7_a9_pmu_event_map;
+			armv7pmu.event_names = armv7_a9_event_names;
+			armv7pmu.num_event_names =
+				ARRAY_SIZE(armv7_a9_event_names);
 			armpmu = &armv7pmu;
 
 			/* Reset PMNC and read the nb of CNTx counters
@@ -2989,6 +3153,7 @@ init_hw_perf_events(void)
 	if (armpmu) {
 		pr_info("enabled with %s PMU driver, %d counters available\n",
 				arm_pmu_names[armpmu->id], armpmu->num_events);
+		hotcpu_notifier(armpmu_cpu_notify, 0);
 	} else {
 		pr_info("no hardware support available\n");
 		perf_max_events = -1;
@@ -2998,6 +3163,44 @@ init_hw_perf_events(void)
 }
 arch_initcall(init_hw_perf_events);
 
+#ifdef CONFIG_DEBUG_FS
+static int armpmu_events_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	for (i = 0; i < armpmu->num_event_names; i++)
+		seq_printf(s, "%-28s r%02x\n", armpmu->event_names[i].name,
+			   armpmu->event_names[i].event);
+
+	return 0;
+}
+
+static int armpmu_events_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, armpmu_events_show, inode->i_private);
+}
+
+static const struct file_operations armpmu_events_fops = {
+	.open		= armpmu_events_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init armpmu_debugfs_init(void)
+{
+	if (!armpmu || !armpmu->num_event_names)
+		return 0;
+
+	if (!debugfs_create_file("arm_pmu_events", S_IRUGO, NULL, NULL,
+				 &armpmu_events_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+late_initcall(armpmu_debugfs_init);
+#endif
+
 /*
  * Callchain handling code.
  */
@@ -22,6 +22,7 @@
 #include <linux/completion.h>
 #include <linux/sched.h>
 #include <linux/mutex.h>
+#include <linux/string.h>
 
 #include <mach/dma.h>
 #include <mach/iomap.h>
@@ -30,6 +31,9 @@
 
 static DEFINE_MUTEX(tegra_apb_dma_lock);
 
+/* largest transfer, longer ranges are split */
+#define TEGRA_APB_BB_WORDS	64
+
 #ifdef CONFIG_TEGRA_SYSTEM_DMA
 static struct tegra_dma_channel *tegra_apb_dma;
 static u32 *tegra_apb_bb;
@@ -41,25 +45,35 @@ static void apb_dma_complete(struct tegra_dma_req *req)
 	complete(&tegra_apb_wait);
 }
 
-static inline u32 apb_readl(unsigned long offset)
+/*
+ * Moves @words words between the bounce buffer and the APB, starting at
+ * @offset, or always at @offset for FIFO style registers if @fixed is set.
+ * Called with tegra_apb_dma_lock held.
+ */
+static int apb_dma_xfer(unsigned long offset, unsigned words, bool fixed,
+			bool to_memory)
 {
 	struct tegra_dma_req req;
 	int ret;
 
-	if (!tegra_apb_dma)
-		return readl(IO_TO_VIRT(offset));
-
-	mutex_lock(&tegra_apb_dma_lock);
 	req.complete = apb_dma_complete;
-	req.to_memory = 1;
-	req.dest_addr = tegra_apb_bb_phys;
+	req.to_memory = to_memory;
+	if (to_memory) {
+		req.dest_addr = tegra_apb_bb_phys;
+		req.dest_wrap = 0;
+		req.source_addr = offset;
+		req.source_wrap = fixed ? 4 : 0;
+	} else {
+		req.dest_addr = offset;
+		req.dest_wrap = fixed ? 4 : 0;
+		req.source_addr = tegra_apb_bb_phys;
+		req.source_wrap = 0;
+	}
 	req.dest_bus_width = 32;
-	req.dest_wrap = 1;
-	req.source_addr = offset;
 	req.source_bus_width = 32;
-	req.source_wrap = 4;
 	req.req_sel = 0;
-	req.size = 4;
+	req.size = words * 4;
+	req.sg = NULL;
 
 	INIT_COMPLETION(tegra_apb_wait);
 
@@ -68,70 +82,112 @@ static inline u32 apb_readl(unsigned long offset)
 	ret = wait_for_completion_timeout(&tegra_apb_wait,
 		msecs_to_jiffies(400));
 
-	if (WARN(ret == 0, "apb read dma timed out")) {
+	if (WARN(ret == 0, "apb %s dma timed out",
+		 to_memory ? "read" : "write")) {
 		tegra_dma_dequeue_req(tegra_apb_dma, &req);
-		*(u32 *)tegra_apb_bb = 0;
+		return -ETIMEDOUT;
 	}
 
-	mutex_unlock(&tegra_apb_dma_lock);
-	return *((u32 *)tegra_apb_bb);
+	return 0;
 }
 
-static inline void apb_writel(u32 value, unsigned long offset)
+static void apb_read_array(unsigned long offset, u32 *buf, unsigned count,
+			   bool fixed)
 {
-	struct tegra_dma_req req;
-	int ret;
+	unsigned n, i;
 
 	if (!tegra_apb_dma) {
-		writel(value, IO_TO_VIRT(offset));
+		for (i = 0; i < count; i++)
+			buf[i] = readl(IO_TO_VIRT(offset + (fixed ? 0 : i * 4)));
 		return;
 	}
 
 	mutex_lock(&tegra_apb_dma_lock);
-	*((u32 *)tegra_apb_bb) = value;
-	req.complete = apb_dma_complete;
-	req.to_memory = 0;
-	req.dest_addr = offset;
-	req.dest_wrap = 4;
-	req.dest_bus_width = 32;
-	req.source_addr = tegra_apb_bb_phys;
-	req.source_bus_width = 32;
-	req.source_wrap = 1;
-	req.req_sel = 0;
-	req.size = 4;
-
-	INIT_COMPLETION(tegra_apb_wait);
-
-	tegra_dma_enqueue_req(tegra_apb_dma, &req);
+	while (count) {
+		n = min_t(unsigned, count, TEGRA_APB_BB_WORDS);
+		if (apb_dma_xfer(offset, n, fixed, true))
+			memset(buf, 0, n * sizeof(*buf));
+		else
+			memcpy(buf, tegra_apb_bb, n * sizeof(*buf));
+		if (!fixed)
+			offset += n * 4;
+		buf += n;
+		count -= n;
+	}
+	mutex_unlock(&tegra_apb_dma_lock);
+}
 
-	ret = wait_for_completion_timeout(&tegra_apb_wait,
-		msecs_to_jiffies(400));
+static void apb_write_array(unsigned long offset, const u32 *buf,
+			    unsigned count, bool fixed)
+{
+	unsigned n, i;
 
-	if (WARN(ret == 0, "apb write dma timed out"))
-		tegra_dma_dequeue_req(tegra_apb_dma, &req);
+	if (!tegra_apb_dma) {
+		for (i = 0; i < count; i++)
+			writel(buf[i], IO_TO_VIRT(offset + (fixed ? 0 : i * 4)));
+		return;
+	}
 
+	mutex_lock(&tegra_apb_dma_lock);
+	while (count) {
+		n = min_t(unsigned, count, TEGRA_APB_BB_WORDS);
+		memcpy(tegra_apb_bb, buf, n * sizeof(*buf));
+		apb_dma_xfer(offset, n, fixed, false);
+		if (!fixed)
+			offset += n * 4;
+		buf += n;
+		count -= n;
+	}
 	mutex_unlock(&tegra_apb_dma_lock);
 }
 #else
-static inline u32 apb_readl(unsigned long offset)
+static void apb_read_array(unsigned long offset, u32 *buf, unsigned count,
+			   bool fixed)
 {
-	return readl(IO_TO_VIRT(offset));
+	unsigned i;
+
+	for (i = 0; i < count; i++)
+		buf[i] = readl(IO_TO_VIRT(offset + (fixed ? 0 : i * 4)));
 }
 
-static inline void apb_writel(u32 value, unsigned long offset)
+static void apb_write_array(unsigned long offset, const u32 *buf,
+			    unsigned count, bool fixed)
 {
-	writel(value, IO_TO_VIRT(offset));
+	unsigned i;
+
+	for (i = 0; i < count; i++)
+		writel(buf[i], IO_TO_VIRT(offset + (fixed ? 0 : i * 4)));
 }
 #endif
 
 u32 tegra_apb_readl(unsigned long offset)
 {
-	return apb_readl(offset);
+	u32 val;
+
+	apb_read_array(offset, &val, 1, false);
+	return val;
 }
 
 void tegra_apb_writel(u32 value, unsigned long offset)
 {
-	apb_writel(value, offset);
+	apb_write_array(offset, &value, 1, false);
+}
+
+/*
+ * Reads @count consecutive registers starting at @offset with as few DMA
+ * requests as possible.  With @fixed every word is read from @offset, for
+ * registers that step through their data on each read.
+ */
+void tegra_apb_readl_array(unsigned long offset, u32 *buf, unsigned count,
+			   bool fixed)
+{
+	apb_read_array(offset, buf, count, fixed);
+}
+
+void tegra_apb_writel_array(unsigned long offset, const u32 *buf,
+			    unsigned count, bool fixed)
+{
+	apb_write_array(offset, buf, count, fixed);
 }
 
 void tegra_init_apb_dma(void)
@@ -144,7 +200,8 @@ void tegra_init_apb_dma(void)
 		return;
 	}
 
-	tegra_apb_bb = dma_alloc_coherent(NULL, sizeof(u32),
+	tegra_apb_bb = dma_alloc_coherent(NULL,
+		TEGRA_APB_BB_WORDS * sizeof(u32),
 		&tegra_apb_bb_phys, GFP_KERNEL);
 	if (!tegra_apb_bb) {
 		pr_err("%s: can not allocate bounce buffer\n", __func__);
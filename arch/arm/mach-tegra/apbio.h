@@ -17,4 +17,8 @@
 
 u32 tegra_apb_readl(unsigned long offset);
 void tegra_apb_writel(u32 value, unsigned long offset);
+void tegra_apb_readl_array(unsigned long offset, u32 *buf, unsigned count,
+			   bool fixed);
+void tegra_apb_writel_array(unsigned long offset, const u32 *buf,
+			    unsigned count, bool fixed);
 void tegra_init_apb_dma(void);
@@ -22,6 +22,10 @@
 #include <linux/err.h>
 #include <linux/delay.h>
 #include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <mach/arb_sema.h>
 #include <mach/irqs.h>
@@ -37,12 +41,25 @@
 #define ARB_GRANT_REQUEST	0x4
 #define ARB_GRANT_RELEASE	0x8
 
+/* Updated by the holder of the semaphore's mutex, read racily by debugfs */
+struct tegra_arb_stats {
+	unsigned long acquired;
+	unsigned long contended;	/* had to sleep for the grant */
+	unsigned long timeouts;
+	u64 wait_us;
+	u32 max_wait_us;
+	u64 hold_us;
+	u32 max_hold_us;
+	ktime_t granted;
+};
+
 struct tegra_arb_dev {
 	void __iomem	*sema_base;
 	void __iomem	*gnt_base;
 	spinlock_t lock;
 	struct completion arb_gnt_complete[TEGRA_RPC_MAX_SEM];
 	struct mutex mutexes[TEGRA_RPC_MAX_SEM];
+	struct tegra_arb_stats stats[TEGRA_RPC_MAX_SEM];
 	int irq;
 	int status;
 	bool suspended;
@@ -70,19 +87,29 @@ static inline void arb_gnt_write(u32 value, u32 offset)
 	writel(value, arb->gnt_base + offset);
 }
 
-static void request_arb_sem(enum tegra_arb_module lock)
+/*
+ * Returns true if the semaphore was free and has been granted right away.
+ * The grant interrupt is only left enabled when the AVP holds it, so an
+ * uncontended lock does not take an interrupt or sleep.
+ */
+static bool request_arb_sem(enum tegra_arb_module lock)
 {
 	unsigned long flags;
+	bool granted;
 	u32 value;
 
 	spin_lock_irqsave(&arb->lock, flags);
 
 	arb_sema_write(1 << lock, ARB_GRANT_REQUEST);
-	value = arb_gnt_read(ARB_CPU_INT_EN);
-	value |= (1 << lock);
-	arb_gnt_write(value, ARB_CPU_INT_EN);
+	granted = arb_sema_read(ARB_GRANT_STATUS) & (1 << lock);
+	if (!granted) {
+		value = arb_gnt_read(ARB_CPU_INT_EN);
+		value |= (1 << lock);
+		arb_gnt_write(value, ARB_CPU_INT_EN);
+	}
 
 	spin_unlock_irqrestore(&arb->lock, flags);
+	return granted;
 }
 
 static void cancel_arb_sem(enum tegra_arb_module lock)
@@ -100,8 +127,25 @@ static void cancel_arb_sem(enum tegra_arb_module lock)
 	spin_unlock_irqrestore(&arb->lock, flags);
 }
 
+static void arb_note_granted(enum tegra_arb_module lock, ktime_t start,
+			     bool contended)
+{
+	struct tegra_arb_stats *st = &arb->stats[lock];
+	u32 us;
+
+	st->granted = ktime_get();
+	us = ktime_us_delta(st->granted, start);
+	st->acquired++;
+	if (contended)
+		st->contended++;
+	st->wait_us += us;
+	if (us > st->max_wait_us)
+		st->max_wait_us = us;
+}
+
 int tegra_arb_mutex_lock_timeout(enum tegra_arb_module lock, int msecs)
 {
+	ktime_t start;
 	int ret;
 
 	if (!arb)
@@ -112,23 +156,58 @@ int tegra_arb_mutex_lock_timeout(enum tegra_arb_module lock, int msecs)
 		return -ETIMEDOUT;
 	}
 
+	start = ktime_get();
 	mutex_lock(&arb->mutexes[lock]);
 	INIT_COMPLETION(arb->arb_gnt_complete[lock]);
-	request_arb_sem(lock);
+	if (request_arb_sem(lock)) {
+		arb_note_granted(lock, start, false);
+		return 0;
+	}
+
 	ret = wait_for_completion_timeout(&arb->arb_gnt_complete[lock], msecs_to_jiffies(msecs));
 	if (ret == 0) {
 		pr_err("timed out.\n");
+		arb->stats[lock].timeouts++;
 		cancel_arb_sem(lock);
 		mutex_unlock(&arb->mutexes[lock]);
 		return -ETIMEDOUT;
 	}
 
+	arb_note_granted(lock, start, true);
 	return 0;
 }
 EXPORT_SYMBOL(tegra_arb_mutex_lock_timeout);
 
+int tegra_arb_mutex_trylock(enum tegra_arb_module lock)
+{
+	if (!arb)
+		return -ENODEV;
+
+	if (arb->suspended) {
+		pr_err("device in suspend\n");
+		return -ETIMEDOUT;
+	}
+
+	if (!mutex_trylock(&arb->mutexes[lock]))
+		return -EBUSY;
+
+	if (!request_arb_sem(lock)) {
+		/* held by the AVP, withdraw the request */
+		cancel_arb_sem(lock);
+		mutex_unlock(&arb->mutexes[lock]);
+		return -EBUSY;
+	}
+
+	arb_note_granted(lock, ktime_get(), false);
+	return 0;
+}
+EXPORT_SYMBOL(tegra_arb_mutex_trylock);
+
 int tegra_arb_mutex_unlock(enum tegra_arb_module lock)
 {
+	struct tegra_arb_stats *st;
+	u32 us;
+
 	if (!arb)
 		return -ENODEV;
 
@@ -137,6 +216,12 @@ int tegra_arb_mutex_unlock(enum tegra_arb_module lock)
 		return -ETIMEDOUT;
 	}
 
+	st = &arb->stats[lock];
+	us = ktime_us_delta(ktime_get(), st->granted);
+	st->hold_us += us;
+	if (us > st->max_hold_us)
+		st->max_hold_us = us;
+
 	cancel_arb_sem(lock);
 	mutex_unlock(&arb->mutexes[lock]);
 	return 0;
@@ -239,4 +324,53 @@ out:
 }
 subsys_initcall(tegra_arb_init);
 
+#ifdef CONFIG_DEBUG_FS
+static int arb_stats_show(struct seq_file *s, void *data)
+{
+	struct tegra_arb_stats *st;
+	int i;
+
+	seq_printf(s, "sem  acquired contended timeouts avg_wait_us "
+		   "max_wait_us avg_hold_us max_hold_us\n");
+	for (i = 0; i < TEGRA_RPC_MAX_SEM; i++) {
+		st = &arb->stats[i];
+		if (!st->acquired && !st->timeouts)
+			continue;
+		seq_printf(s, "%3d %9lu %9lu %8lu %11llu %11u %11llu %11u\n",
+			   i, st->acquired, st->contended, st->timeouts,
+			   st->acquired ? div_u64(st->wait_us, st->acquired) : 0,
+			   st->max_wait_us,
+			   st->acquired ? div_u64(st->hold_us, st->acquired) : 0,
+			   st->max_hold_us);
+	}
+
+	return 0;
+}
+
+static int arb_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, arb_stats_show, inode->i_private);
+}
+
+static const struct file_operations arb_stats_fops = {
+	.open		= arb_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_arb_debugfs_init(void)
+{
+	if (!arb)
+		return 0;
+
+	if (!debugfs_create_file("arb_sema", S_IRUGO, NULL, NULL,
+				 &arb_stats_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+late_initcall(tegra_arb_debugfs_init);
+#endif
+
 MODULE_LICENSE("GPLv2");
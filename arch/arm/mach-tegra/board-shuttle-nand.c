@@ -86,6 +86,7 @@ static struct tegra_nand_chip_parms shuttle_nand_chip_parms[] = {
     [2] = {
 		.vendor_id	= 0xEC, 
 		.device_id  = 0xD3,
+		.flags		= TEGRA_NAND_CACHE_READ | TEGRA_NAND_CACHE_PROG,
 		.capacity   = 1024,
 		.timing		= {
 			.trp		= 15,
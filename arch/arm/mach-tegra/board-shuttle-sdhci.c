@@ -88,6 +88,7 @@ struct tegra_sdhci_platform_data shuttle_wlan_data = {
 	.cd_gpio = -1,
 	.wp_gpio = -1,
 	.power_gpio = -1,
+	.deferred_resume = 1,
 };
 
 static struct tegra_sdhci_platform_data tegra_sdhci_platform_data2 = {
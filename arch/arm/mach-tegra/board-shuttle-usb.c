@@ -183,7 +183,7 @@ static struct tegra_ehci_platform_data tegra_ehci_pdata[] = {
 	[2] = {
 		.phy_config = &utmi_phy_config[1],
 		.operating_mode = TEGRA_USB_HOST,
-		.power_down_on_bus_suspend = 1,
+		.clk_gate_on_bus_suspend = 1,
 	},
 };
 
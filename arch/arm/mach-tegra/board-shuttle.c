@@ -32,6 +32,8 @@
 #include <linux/reboot.h>
 #include <linux/i2c-tegra.h>
 #include <linux/memblock.h>
+#include <linux/async.h>
+#include <linux/ktime.h>
 
 #include <asm/mach-types.h>
 #include <asm/mach/arch.h>
@@ -131,6 +133,18 @@ void shuttle_3g_gps_deinit(void)
 }
 EXPORT_SYMBOL_GPL(shuttle_3g_gps_deinit);
 
+/* Controllers whose resume only needs the PMU rails (DVC bus) back up */
+static const struct tegra_suspend_async_dev shuttle_async_devs[] = {
+	{ .name = "sdhci-tegra.0",	.after = "tegra-i2c.3" },
+	{ .name = "sdhci-tegra.1",	.after = "tegra-i2c.3" },
+	{ .name = "sdhci-tegra.2",	.after = "tegra-i2c.3" },
+	{ .name = "sdhci-tegra.3",	.after = "tegra-i2c.3" },
+	{ .name = "tegra-ehci.0",	.after = "tegra-i2c.3" },
+	{ .name = "tegra-ehci.1",	.after = "tegra-i2c.3" },
+	{ .name = "tegra-ehci.2",	.after = "tegra-i2c.3" },
+	{ .name = "fsl-tegra-udc",	.after = "tegra-i2c.3" },
+};
+
 static struct tegra_suspend_platform_data shuttle_suspend = {
 	.cpu_timer = 5000,
 	.cpu_off_timer = 5000,
@@ -149,8 +163,101 @@ static struct tegra_suspend_platform_data shuttle_suspend = {
 				SHUTTLE_WAKE_KEY_RESUME,
 	.wake_any = 0,
 #endif
+	.async_devs = shuttle_async_devs,
+	.num_async_devs = ARRAY_SIZE(shuttle_async_devs),
+};
+
+static int __init shuttle_dma_register_devices(void)
+{
+	/* Register the dmaengine front end of the system DMA */
+	return platform_device_register(&tegra_dma_device);
+}
+
+/*
+ * Board device registration, in order.  A synchronous stage waits for
+ * every stage before it.  An async stage only depends on the synchronous
+ * stages before it, and runs concurrently with the other async stages
+ * on both cores.  All of them are done when machine init returns, so
+ * i2c board info is still registered before the adapters show up.
+ * Booting with initcall_debug reports how long each stage took.
+ */
+struct shuttle_init_stage {
+	const char *name;
+	int (*init)(void);
+	bool async;
+};
+
+static struct shuttle_init_stage shuttle_init_stages[] __initdata = {
+	/* i2c devices are required for power management, the power
+	   subsystem (including the poweroff handler) by all the others */
+	{ "i2c",	shuttle_i2c_register_devices,		false },
+	{ "power",	shuttle_power_register_devices,		false },
+	{ "usb",	shuttle_usb_register_devices,		false },
+	{ "dma",	shuttle_dma_register_devices,		false },
+	{ "uart",	shuttle_uart_register_devices,		false },
+	{ "spi",	shuttle_spi_register_devices,		true },
+	{ "gpu",	shuttle_gpu_register_devices,		true },
+	{ "audio",	shuttle_audio_register_devices,		true },
+	{ "aes",	shuttle_aes_register_devices,		true },
+	{ "wdt",	shuttle_wdt_register_devices,		true },
+	{ "keyboard",	shuttle_keyboard_register_devices,	true },
+	{ "touch",	shuttle_touch_register_devices,		true },
+	{ "sdhci",	shuttle_sdhci_register_devices,		true },
+	{ "sensors",	shuttle_sensors_register_devices,	true },
+	{ "wlan-pm",	shuttle_wlan_pm_register_devices,	true },
+	{ "gps-pm",	shuttle_gps_pm_register_devices,	true },
+	{ "gsm-pm",	shuttle_gsm_pm_register_devices,	true },
+	{ "bt-pm",	shuttle_bt_pm_register_devices,		true },
+	{ "camera-pm",	shuttle_camera_pm_register_devices,	true },
+	{ "nand",	shuttle_nand_register_devices,		true },
 };
 
+static LIST_HEAD(shuttle_init_domain);
+
+static void __init shuttle_run_stage(struct shuttle_init_stage *stage)
+{
+	ktime_t calltime = ktime_get();
+	int ret;
+
+	ret = stage->init();
+	if (initcall_debug)
+		printk(KERN_DEBUG "shuttle: %s stage returned %d after %lld "
+			"usecs\n", stage->name, ret,
+			ktime_to_ns(ktime_sub(ktime_get(), calltime)) >> 10);
+	else if (ret)
+		pr_warning("shuttle: %s stage failed (%d)\n", stage->name,
+			ret);
+}
+
+static void __init shuttle_async_stage(void *data, async_cookie_t cookie)
+{
+	shuttle_run_stage(data);
+}
+
+static void __init shuttle_run_stages(void)
+{
+	ktime_t calltime = ktime_get();
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(shuttle_init_stages); i++) {
+		struct shuttle_init_stage *stage = &shuttle_init_stages[i];
+
+		if (stage->async) {
+			async_schedule_domain(shuttle_async_stage, stage,
+				&shuttle_init_domain);
+		} else {
+			async_synchronize_full_domain(&shuttle_init_domain);
+			shuttle_run_stage(stage);
+		}
+	}
+	async_synchronize_full_domain(&shuttle_init_domain);
+
+	if (initcall_debug)
+		printk(KERN_DEBUG "shuttle: device registration took %lld "
+			"usecs\n",
+			ktime_to_ns(ktime_sub(ktime_get(), calltime)) >> 10);
+}
+
 static void __init tegra_shuttle_init(void)
 {
 	struct clk *clk;
@@ -181,62 +288,8 @@ static void __init tegra_shuttle_init(void)
 	/* Initialize the pinmux */
 	shuttle_pinmux_init();
 
-	/* Register i2c devices - required for Power management and MUST be done before the power register */
-	shuttle_i2c_register_devices();
-
-	/* Register the power subsystem - Including the poweroff handler - Required by all the others */
-	shuttle_power_register_devices();
-	
-	/* Register the USB device */
-	shuttle_usb_register_devices();
-
-	/* Register UART devices */
-	shuttle_uart_register_devices();
-	
-	/* Register SPI devices */
-	shuttle_spi_register_devices();
-
-	/* Register GPU devices */
-	shuttle_gpu_register_devices();
-
-	/* Register Audio devices */
-	shuttle_audio_register_devices();
-
-	/* Register AES encryption devices */
-	shuttle_aes_register_devices();
-
-	/* Register Watchdog devices */
-	shuttle_wdt_register_devices();
-
-	/* Register all the keyboard devices */
-	shuttle_keyboard_register_devices();
-	
-	/* Register touchscreen devices */
-	shuttle_touch_register_devices();
-	
-	/* Register SDHCI devices */
-	shuttle_sdhci_register_devices();
-
-	/* Register accelerometer device */
-	shuttle_sensors_register_devices();
-	
-	/* Register wlan powermanagement devices */
-	shuttle_wlan_pm_register_devices();
-	
-	/* Register gps powermanagement devices */
-	shuttle_gps_pm_register_devices();
-
-	/* Register gsm powermanagement devices */
-	shuttle_gsm_pm_register_devices();
-	
-	/* Register Bluetooth powermanagement devices */
-	shuttle_bt_pm_register_devices();
-
-	/* Register Camera powermanagement devices */
-	shuttle_camera_pm_register_devices();
-
-	/* Register NAND flash devices */
-	shuttle_nand_register_devices();
+	/* Register the board devices, see shuttle_init_stages */
+	shuttle_run_stages();
 	
 #if 0
 	/* Finally, init the external memory controller and memory frequency scaling
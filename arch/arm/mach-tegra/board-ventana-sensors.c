@@ -29,6 +29,7 @@
 #include <linux/regulator/consumer.h>
 
 #include <mach/gpio.h>
+#include <mach/thermal.h>
 
 #include <media/ov5650.h>
 #include <media/ov2710.h>
@@ -45,8 +46,6 @@
 #define AC_PRESENT_GPIO		TEGRA_GPIO_PV3
 #define NCT1008_THERM2_GPIO	TEGRA_GPIO_PN6
 
-extern void tegra_throttling_enable(bool enable);
-
 static int ventana_camera_init(void)
 {
 	tegra_gpio_enable(CAMERA_POWER_GPIO);
@@ -175,6 +174,8 @@ static void ventana_nct1008_init(void)
 	gpio_direction_input(NCT1008_THERM2_GPIO);
 }
 
+static const u8 ventana_throttle_limits[] = { 90, 95, 100 };
+
 static struct nct1008_platform_data ventana_nct1008_pdata = {
 	.supported_hwrev = true,
 	.ext_range = false,
@@ -183,8 +184,10 @@ static struct nct1008_platform_data ventana_nct1008_pdata = {
 	.hysteresis = 0,
 	.shutdown_ext_limit = 115,
 	.shutdown_local_limit = 120,
-	.throttling_ext_limit = 90,
-	.alarm_fn = tegra_throttling_enable,
+	.throttle_limits = ventana_throttle_limits,
+	.num_throttle_limits = ARRAY_SIZE(ventana_throttle_limits),
+	.throttle_hysteresis = 3,
+	.throttle_fn = tegra_throttling_set_step,
 };
 
 static const struct i2c_board_info ventana_i2c0_board_info[] = {
@@ -617,6 +617,7 @@ static struct platform_device *ventana_devices[] __initdata = {
 	&tegra_avp_device,
 	&tegra_camera,
 	&tegra_das_device,
+	&tegra_dma_device,
 };
 
 
@@ -20,6 +20,7 @@
 #include <linux/clk.h>
 #include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
 #include <linux/init.h>
 #include <linux/list.h>
 #include <linux/module.h>
@@ -35,6 +36,9 @@
 #include "clock.h"
 #include "dvfs.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/clk.h>
+
 /*
  * Locking:
  *
@@ -49,17 +53,13 @@
  * To avoid AB-BA locking problems, locks must always be traversed from child
  * clock to parent clock.  For example, when enabling a clock, the clock's lock
  * is taken, and then clk_enable is called on the parent, which take's the
- * parent clock's lock.  There are two exceptions to this ordering:
+ * parent clock's lock.  There is one exception to this ordering:
  *  1. When setting a clock as cansleep, in which case the entire list of clocks
  *     is traversed to set the children as cansleep as well.  This must occur
  *     during init, before any calls to clk_get, so no other clock locks can
  *     get taken.
- *  2. When dumping the clock tree through debugfs.  In this case, clk_lock_all
- *     is called, which attemps to iterate through the entire list of clocks
- *     and take every clock lock.  If any call to clk_trylock fails, a locked
- *     clocks are unlocked, and the process is retried.  When all the locks
- *     are held, the only clock operation that can be called is
- *     clk_get_rate_all_locked.
+ * Dumping the clock tree through debugfs takes only clock_list_lock and
+ * reads each clock without its lock, see below.
  *
  * Within a single clock, no clock operation can call another clock operation
  * on itself, except for clk_get_rate_locked.  Any clock operation can call
@@ -75,6 +75,14 @@
  * An additional lock, clock_list_lock, is used to protect the list of all
  * clocks.
  *
+ * clk_get_rate does not take any lock.  The fields it reads (rate, parent,
+ * mul and div) only change inside the set_rate and set_parent ops, which
+ * clock.c wraps in a write section of the clock's rate_seq seqcount, so a
+ * reader retries instead of blocking behind a rate change.  The reader
+ * follows the parent chain with each parent's own seqcount.  Clock ops
+ * must therefore never call clk_get_rate on the clock they are changing;
+ * clk_get_rate_locked is still available for that.
+ *
  * The clock operations must lock internally to protect against
  * read-modify-write on registers that are shared by multiple clocks
  */
@@ -118,6 +126,7 @@ static inline void clk_lock_init(struct clk *c)
 {
 	mutex_init(&c->mutex);
 	spin_lock_init(&c->spinlock);
+	seqcount_init(&c->rate_seq);
 }
 
 struct clk *tegra_get_clock_by_name(const char *name)
@@ -135,7 +144,7 @@ struct clk *tegra_get_clock_by_name(const char *name)
 	return ret;
 }
 
-/* Must be called with clk_lock(c) held */
+/* Must be called with clk_lock(c) held, or inside a rate_seq read section */
 static unsigned long clk_predict_rate_from_parent(struct clk *c, struct clk *p)
 {
 	u64 rate;
@@ -151,7 +160,7 @@ static unsigned long clk_predict_rate_from_parent(struct clk *c, struct clk *p)
 	return rate;
 }
 
-/* Must be called with clk_lock(c) held */
+/* Must be called with clk_lock(c) held, or inside a rate_seq read section */
 unsigned long clk_get_rate_locked(struct clk *c)
 {
 	unsigned long rate;
@@ -166,14 +175,13 @@ unsigned long clk_get_rate_locked(struct clk *c)
 
 unsigned long clk_get_rate(struct clk *c)
 {
-	unsigned long flags;
 	unsigned long rate;
+	unsigned seq;
 
-	clk_lock_save(c, flags);
-
-	rate = clk_get_rate_locked(c);
-
-	clk_unlock_restore(c, flags);
+	do {
+		seq = read_seqcount_begin(&c->rate_seq);
+		rate = clk_get_rate_locked(c);
+	} while (read_seqcount_retry(&c->rate_seq, seq));
 
 	return rate;
 }
@@ -303,12 +311,24 @@ void clk_disable(struct clk *c)
 }
 EXPORT_SYMBOL(clk_disable);
 
+/* Must be called with clk_lock(c) held */
+static void clk_trace_rate_change(struct clk *c, unsigned long old_rate,
+	ktime_t start)
+{
+	unsigned long rate = clk_get_rate_locked(c);
+
+	if (rate != old_rate)
+		trace_clk_rate_change(c->name, old_rate, rate,
+			ktime_to_us(ktime_sub(ktime_get(), start)));
+}
+
 int clk_set_parent(struct clk *c, struct clk *parent)
 {
 	int ret = 0;
 	unsigned long flags;
 	unsigned long new_rate;
 	unsigned long old_rate;
+	ktime_t start;
 
 	clk_lock_save(c, flags);
 
@@ -317,6 +337,7 @@ int clk_set_parent(struct clk *c, struct clk *parent)
 		goto out;
 	}
 
+	start = ktime_get();
 	new_rate = clk_predict_rate_from_parent(c, parent);
 	old_rate = clk_get_rate_locked(c);
 
@@ -327,7 +348,9 @@ int clk_set_parent(struct clk *c, struct clk *parent)
 			goto out;
 	}
 
+	write_seqcount_begin(&c->rate_seq);
 	ret = c->ops->set_parent(c, parent);
+	write_seqcount_end(&c->rate_seq);
 	if (ret)
 		goto out;
 
@@ -335,6 +358,7 @@ int clk_set_parent(struct clk *c, struct clk *parent)
 			new_rate < old_rate)
 		ret = tegra_dvfs_set_rate(c, new_rate);
 
+	clk_trace_rate_change(c, old_rate, start);
 out:
 	clk_unlock_restore(c, flags);
 	return ret;
@@ -353,6 +377,7 @@ int clk_set_rate(struct clk *c, unsigned long rate)
 	unsigned long flags;
 	unsigned long old_rate;
 	long new_rate;
+	ktime_t start;
 
 	clk_lock_save(c, flags);
 
@@ -361,10 +386,14 @@ int clk_set_rate(struct clk *c, unsigned long rate)
 		goto out;
 	}
 
+	start = ktime_get();
 	old_rate = clk_get_rate_locked(c);
+	c->requested_rate = rate;
 
 	if (rate > c->max_rate)
 		rate = c->max_rate;
+	if (c->cap_rate && rate > c->cap_rate)
+		rate = c->cap_rate;
 
 	if (c->ops && c->ops->round_rate) {
 		new_rate = c->ops->round_rate(c, rate);
@@ -383,19 +412,44 @@ int clk_set_rate(struct clk *c, unsigned long rate)
 			goto out;
 	}
 
+	write_seqcount_begin(&c->rate_seq);
 	ret = c->ops->set_rate(c, rate);
+	write_seqcount_end(&c->rate_seq);
 	if (ret)
 		goto out;
 
 	if (clk_is_auto_dvfs(c) && rate < old_rate && c->refcnt > 0)
 		ret = tegra_dvfs_set_rate(c, rate);
 
+	clk_trace_rate_change(c, old_rate, start);
 out:
 	clk_unlock_restore(c, flags);
 	return ret;
 }
 EXPORT_SYMBOL(clk_set_rate);
 
+/*
+ * Limit the rate of a clock below its max_rate, e.g. while the chip is hot.
+ * The rate last asked for with clk_set_rate() is kept, so it comes back when
+ * the cap is raised or removed (cap == 0).  The rate change goes through
+ * clk_set_rate(), which lowers the voltage for clocks that scale with dvfs.
+ */
+int tegra_clk_set_cap(struct clk *c, unsigned long cap)
+{
+	unsigned long flags;
+	unsigned long rate;
+
+	clk_lock_save(c, flags);
+	if (!c->requested_rate)
+		c->requested_rate = clk_get_rate_locked(c);
+	c->cap_rate = cap;
+	rate = c->requested_rate;
+	clk_unlock_restore(c, flags);
+
+	return clk_set_rate(c, rate);
+}
+EXPORT_SYMBOL(tegra_clk_set_cap);
+
 /* Must be called with clocks lock and all indvidual clock locks held */
 unsigned long clk_get_rate_all_locked(struct clk *c)
 {
@@ -434,6 +488,8 @@ long clk_round_rate(struct clk *c, unsigned long rate)
 
 	if (rate > c->max_rate)
 		rate = c->max_rate;
+	if (c->cap_rate && rate > c->cap_rate)
+		rate = c->cap_rate;
 
 	ret = c->ops->round_rate(c, rate);
 
@@ -570,117 +626,6 @@ void tegra_sdmmc_tap_delay(struct clk *c, int delay) {
 
 #ifdef CONFIG_DEBUG_FS
 
-/*
- * Attempt to lock all the clocks that are marked cansleep
- * Must be called with irqs enabled
- */
-static int __clk_lock_all_mutexes(void)
-{
-	struct clk *c;
-
-	might_sleep();
-
-	list_for_each_entry(c, &clocks, node)
-		if (clk_cansleep(c))
-			if (!mutex_trylock(&c->mutex))
-				goto unlock_mutexes;
-
-	return 0;
-
-unlock_mutexes:
-	list_for_each_entry_continue_reverse(c, &clocks, node)
-		if (clk_cansleep(c))
-			mutex_unlock(&c->mutex);
-
-	return -EAGAIN;
-}
-
-/*
- * Attempt to lock all the clocks that are not marked cansleep
- * Must be called with irqs disabled
- */
-static int __clk_lock_all_spinlocks(void)
-{
-	struct clk *c;
-
-	list_for_each_entry(c, &clocks, node)
-		if (!clk_cansleep(c))
-			if (!spin_trylock(&c->spinlock))
-				goto unlock_spinlocks;
-
-	return 0;
-
-unlock_spinlocks:
-	list_for_each_entry_continue_reverse(c, &clocks, node)
-		if (!clk_cansleep(c))
-			spin_unlock(&c->spinlock);
-
-	return -EAGAIN;
-}
-
-static void __clk_unlock_all_mutexes(void)
-{
-	struct clk *c;
-
-	list_for_each_entry_reverse(c, &clocks, node)
-		if (clk_cansleep(c))
-			mutex_unlock(&c->mutex);
-}
-
-static void __clk_unlock_all_spinlocks(void)
-{
-	struct clk *c;
-
-	list_for_each_entry_reverse(c, &clocks, node)
-		if (!clk_cansleep(c))
-			spin_unlock(&c->spinlock);
-}
-
-/*
- * This function retries until it can take all locks, and may take
- * an arbitrarily long time to complete.
- * Must be called with irqs enabled, returns with irqs disabled
- * Must be called with clock_list_lock held
- */
-static void clk_lock_all(void)
-{
-	int ret;
-retry:
-	ret = __clk_lock_all_mutexes();
-	if (ret)
-		goto failed_mutexes;
-
-	local_irq_disable();
-
-	ret = __clk_lock_all_spinlocks();
-	if (ret)
-		goto failed_spinlocks;
-
-	/* All locks taken successfully, return */
-	return;
-
-failed_spinlocks:
-	local_irq_enable();
-	__clk_unlock_all_mutexes();
-failed_mutexes:
-	msleep(1);
-	goto retry;
-}
-
-/*
- * Unlocks all clocks after a clk_lock_all
- * Must be called with irqs disabled, returns with irqs enabled
- * Must be called with clock_list_lock held
- */
-static void clk_unlock_all(void)
-{
-	__clk_unlock_all_spinlocks();
-
-	local_irq_enable();
-
-	__clk_unlock_all_mutexes();
-}
-
 static struct dentry *clk_debugfs_root;
 
 static void dvfs_show_one(struct seq_file *s, struct dvfs *d, int level)
@@ -697,10 +642,18 @@ static void clock_tree_show_one(struct seq_file *s, struct clk *c, int level)
 	struct clk *child;
 	const char *state = "uninit";
 	char div[8] = {0};
+	enum clk_state c_state;
+	u32 refcnt;
+	unsigned long rate;
+
+	/* Not locked, each field is read once and may be slightly stale */
+	c_state = ACCESS_ONCE(c->state);
+	refcnt = ACCESS_ONCE(c->refcnt);
+	rate = clk_get_rate(c);
 
-	if (c->state == ON)
+	if (c_state == ON)
 		state = "on";
-	else if (c->state == OFF)
+	else if (c_state == OFF)
 		state = "off";
 
 	if (c->mul != 0 && c->div != 0) {
@@ -725,7 +678,7 @@ static void clock_tree_show_one(struct seq_file *s, struct clk *c, int level)
 		c->rate > c->max_rate ? '!' : ' ',
 		!c->set ? '*' : ' ',
 		30 - level * 3, c->name,
-		state, c->refcnt, div, clk_get_rate_all_locked(c));
+		state, refcnt, div, rate);
 
 	if (c->dvfs)
 		dvfs_show_one(s, c->dvfs, level + 1);
@@ -746,14 +699,10 @@ static int clock_tree_show(struct seq_file *s, void *data)
 
 	mutex_lock(&clock_list_lock);
 
-	clk_lock_all();
-
 	list_for_each_entry(c, &clocks, node)
 		if (c->parent == NULL)
 			clock_tree_show_one(s, c, 0);
 
-	clk_unlock_all();
-
 	mutex_unlock(&clock_list_lock);
 	return 0;
 }
@@ -898,6 +847,10 @@ static int clk_debugfs_register_one(struct clk *c)
 	if (!d)
 		goto err_out;
 
+	d = debugfs_create_u32("cap", S_IRUGO, c->dent, (u32 *)&c->cap_rate);
+	if (!d)
+		goto err_out;
+
 	d = debugfs_create_file(
 		"parent", parent_rate_mode, c->dent, c, &parent_fops);
 	if (!d)
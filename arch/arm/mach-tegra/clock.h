@@ -23,6 +23,7 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
+#include <linux/seqlock.h>
 #include <asm/clkdev.h>
 
 #define DIV_BUS			(1 << 0)
@@ -92,6 +93,8 @@ struct clk {
 	unsigned long		rate;
 	unsigned long		max_rate;
 	unsigned long		min_rate;
+	unsigned long		cap_rate;	/* 0 if not capped */
+	unsigned long		requested_rate;
 	bool			auto_dvfs;
 	bool			cansleep;
 	u32			flags;
@@ -140,6 +143,7 @@ struct clk {
 
 	struct mutex mutex;
 	spinlock_t spinlock;
+	seqcount_t rate_seq;
 };
 
 struct clk_duplicate {
@@ -0,0 +1,494 @@
+/*
+ * arch/arm/mach-tegra/cpu-tegra-hotplug.c
+ *
+ * Takes the second Cortex-A9 offline while the system runs slowly, so
+ * that CPU0 can enter LP2 without the CPU1 handshake in cpuidle.
+ *
+ * Copyright (C) 2010 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/sched.h>
+#include <linux/cpu.h>
+#include <linux/init.h>
+#include <linux/input.h>
+#include <linux/jiffies.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+#include <linux/netdevice.h>
+
+#include "cpu-tegra.h"
+
+/*
+ * CPU1 goes down once the shared cpufreq target has stayed at or below
+ * idle_bottom_freq for down_delay_ms, and comes back once it has stayed
+ * at or above idle_top_freq for up_delay_ms. While CPU1 is down the
+ * runqueue is sampled every sample_ms, and CPU1 comes back as soon as
+ * more than up_rq_depth tasks are runnable, or as soon as the network
+ * stack receives more than up_rx_pps packets a second so that rx work
+ * steered by RPS has somewhere to go. The same rx rate also keeps CPU1
+ * from going down. Touch input brings CPU1 back at once and holds it up
+ * for boost_ms.
+ */
+static bool enabled = true;
+static unsigned int idle_bottom_freq = 312000;
+static unsigned int idle_top_freq = 608000;
+static unsigned int down_delay_ms = 2000;
+static unsigned int up_delay_ms = 50;
+static unsigned int sample_ms = 100;
+static unsigned int up_rq_depth = 2;
+static unsigned int boost_ms = 1000;
+static unsigned int up_rx_pps = 2000;
+
+module_param(idle_bottom_freq, uint, 0644);
+module_param(idle_top_freq, uint, 0644);
+module_param(down_delay_ms, uint, 0644);
+module_param(up_delay_ms, uint, 0644);
+module_param(sample_ms, uint, 0644);
+module_param(up_rq_depth, uint, 0644);
+module_param(boost_ms, uint, 0644);
+module_param(up_rx_pps, uint, 0644);
+
+enum {
+	TEGRA_HP_IDLE = 0,	/* nothing pending */
+	TEGRA_HP_DOWN,		/* CPU1 online, going down after down_delay */
+	TEGRA_HP_UP,		/* CPU1 offline, coming up after up_delay */
+};
+
+enum {
+	TEGRA_HP_UP_FREQ = 0,
+	TEGRA_HP_UP_RUNQUEUE,
+	TEGRA_HP_UP_BOOST,
+	TEGRA_HP_UP_NETRX,
+	TEGRA_HP_UP_REASONS,
+};
+
+static struct mutex *tegra_cpu_lock;
+static struct workqueue_struct *hotplug_wq;
+static struct delayed_work hotplug_work;
+static struct work_struct boost_work;
+static int hp_state;
+static bool hp_suspended;
+static unsigned long boost_until;
+
+static DEFINE_SPINLOCK(hp_stats_lock);
+static struct {
+	u64 time_in[2];		/* jiffies with one and two cores online */
+	u64 last_change;
+	unsigned int up_count;
+	unsigned int down_count;
+	unsigned int up_reason[TEGRA_HP_UP_REASONS];
+} hp_stats;
+
+static inline bool tegra_hp_boosted(void)
+{
+	return time_before(jiffies, boost_until);
+}
+
+#ifdef CONFIG_RPS
+static unsigned int rx_last_processed;
+static unsigned long rx_last_sample;
+
+/*
+ * Called with tegra_cpu_lock held. True if the network stack received
+ * more than up_rx_pps packets a second since the last call.
+ */
+static bool tegra_hp_rx_busy(void)
+{
+	unsigned int processed = 0;
+	unsigned int elapsed;
+	unsigned long now = jiffies;
+	u64 rate = 0;
+	int cpu;
+
+	/* offline CPUs keep their counters, so the sum never goes back */
+	for_each_possible_cpu(cpu)
+		processed += per_cpu(softnet_data, cpu).processed;
+
+	elapsed = jiffies_to_msecs(now - rx_last_sample);
+	if (elapsed)
+		rate = div_u64((u64)(processed - rx_last_processed) * 1000,
+			elapsed);
+	rx_last_processed = processed;
+	rx_last_sample = now;
+
+	return up_rx_pps && rate > up_rx_pps;
+}
+#else
+static inline bool tegra_hp_rx_busy(void)
+{
+	return false;
+}
+#endif
+
+static void tegra_hp_cpu_up(int reason)
+{
+	if (cpu_online(1) || cpu_up(1))
+		return;
+
+	spin_lock(&hp_stats_lock);
+	hp_stats.up_reason[reason]++;
+	spin_unlock(&hp_stats_lock);
+}
+
+/* Called with tegra_cpu_lock held */
+static void tegra_hp_sample(void)
+{
+	if (!cpu_online(1) && hp_state == TEGRA_HP_IDLE)
+		queue_delayed_work(hotplug_wq, &hotplug_work,
+			msecs_to_jiffies(sample_ms));
+}
+
+static void tegra_auto_hotplug_work_func(struct work_struct *work)
+{
+	bool up = false;
+	bool down = false;
+	int reason = TEGRA_HP_UP_FREQ;
+
+	mutex_lock(tegra_cpu_lock);
+	if (!enabled || hp_suspended)
+		goto out;
+
+	switch (hp_state) {
+	case TEGRA_HP_DOWN:
+		hp_state = TEGRA_HP_IDLE;
+		if (!cpu_online(1))
+			break;
+		if (tegra_hp_boosted() || tegra_hp_rx_busy()) {
+			hp_state = TEGRA_HP_DOWN;
+			queue_delayed_work(hotplug_wq, &hotplug_work,
+				msecs_to_jiffies(down_delay_ms));
+			break;
+		}
+		down = true;
+		break;
+	case TEGRA_HP_UP:
+		hp_state = TEGRA_HP_IDLE;
+		up = !cpu_online(1);
+		break;
+	default:
+		/* Exclude ourselves from the runnable count */
+		if (!cpu_online(1) && nr_running() > up_rq_depth + 1) {
+			up = true;
+			reason = TEGRA_HP_UP_RUNQUEUE;
+		} else if (!cpu_online(1) && tegra_hp_rx_busy()) {
+			up = true;
+			reason = TEGRA_HP_UP_NETRX;
+		} else {
+			tegra_hp_sample();
+		}
+		break;
+	}
+out:
+	mutex_unlock(tegra_cpu_lock);
+
+	/* cpufreq takes tegra_cpu_lock from the hotplug notifiers */
+	if (up) {
+		tegra_hp_cpu_up(reason);
+	} else if (down) {
+		cpu_down(1);
+		mutex_lock(tegra_cpu_lock);
+		tegra_hp_sample();
+		mutex_unlock(tegra_cpu_lock);
+	}
+}
+
+static void tegra_auto_hotplug_boost_func(struct work_struct *work)
+{
+	bool up;
+
+	mutex_lock(tegra_cpu_lock);
+	up = enabled && !hp_suspended && !cpu_online(1);
+	if (up && hp_state == TEGRA_HP_UP)
+		hp_state = TEGRA_HP_IDLE;
+	mutex_unlock(tegra_cpu_lock);
+
+	if (up)
+		tegra_hp_cpu_up(TEGRA_HP_UP_BOOST);
+}
+
+/*
+ * Called by cpu-tegra.c with tegra_cpu_lock held each time the shared
+ * cpufreq target changes.
+ */
+void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
+{
+	if (!hotplug_wq)
+		return;
+
+	hp_suspended = suspend;
+	if (suspend || !enabled) {
+		cancel_delayed_work(&hotplug_work);
+		hp_state = TEGRA_HP_IDLE;
+		return;
+	}
+
+	if (cpu_online(1)) {
+		if (cpu_freq <= idle_bottom_freq) {
+			if (hp_state != TEGRA_HP_DOWN) {
+				hp_state = TEGRA_HP_DOWN;
+				cancel_delayed_work(&hotplug_work);
+				queue_delayed_work(hotplug_wq, &hotplug_work,
+					msecs_to_jiffies(down_delay_ms));
+			}
+		} else if (hp_state == TEGRA_HP_DOWN) {
+			hp_state = TEGRA_HP_IDLE;
+			cancel_delayed_work(&hotplug_work);
+		}
+		return;
+	}
+
+	if (cpu_freq >= idle_top_freq) {
+		if (hp_state != TEGRA_HP_UP) {
+			hp_state = TEGRA_HP_UP;
+			cancel_delayed_work(&hotplug_work);
+			queue_delayed_work(hotplug_wq, &hotplug_work,
+				msecs_to_jiffies(up_delay_ms));
+		}
+	} else {
+		if (hp_state == TEGRA_HP_UP) {
+			hp_state = TEGRA_HP_IDLE;
+			cancel_delayed_work(&hotplug_work);
+		}
+		tegra_hp_sample();
+	}
+}
+
+static int tegra_hp_set_enabled(const char *arg, const struct kernel_param *kp)
+{
+	int ret;
+
+	ret = param_set_bool(arg, kp);
+	if (ret || !hotplug_wq)
+		return ret;
+
+	/* Leave both cores running when the governor is switched off */
+	if (!enabled)
+		queue_work(hotplug_wq, &boost_work);
+	return 0;
+}
+
+static struct kernel_param_ops tegra_hp_enabled_ops = {
+	.set = tegra_hp_set_enabled,
+	.get = param_get_bool,
+};
+
+module_param_cb(enabled, &tegra_hp_enabled_ops, &enabled, 0644);
+
+static void tegra_hp_boost_event(struct input_handle *handle,
+	unsigned int type, unsigned int code, int value)
+{
+	if (!enabled || !boost_ms)
+		return;
+
+	boost_until = jiffies + msecs_to_jiffies(boost_ms);
+	if (!cpu_online(1))
+		queue_work(hotplug_wq, &boost_work);
+}
+
+static int tegra_hp_boost_connect(struct input_handler *handler,
+	struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpu-tegra-hotplug";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void tegra_hp_boost_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id tegra_hp_boost_ids[] = {
+	{
+		/* multi-touch touchscreens */
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			BIT_MASK(ABS_MT_POSITION_X) },
+	},
+	{
+		/* single-touch touchscreens */
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] = BIT_MASK(ABS_X) },
+	},
+	{ },
+};
+
+static struct input_handler tegra_hp_boost_handler = {
+	.event		= tegra_hp_boost_event,
+	.connect	= tegra_hp_boost_connect,
+	.disconnect	= tegra_hp_boost_disconnect,
+	.name		= "cpu-tegra-hotplug",
+	.id_table	= tegra_hp_boost_ids,
+};
+
+static int tegra_hp_cpu_notify(struct notifier_block *nb,
+	unsigned long action, void *hcpu)
+{
+	u64 now;
+
+	if ((long)hcpu != 1)
+		return NOTIFY_OK;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DEAD:
+		now = get_jiffies_64();
+		spin_lock(&hp_stats_lock);
+		/* CPU_ONLINE ends a stretch on one core, CPU_DEAD on two */
+		hp_stats.time_in[(action & ~CPU_TASKS_FROZEN) == CPU_DEAD] +=
+			now - hp_stats.last_change;
+		hp_stats.last_change = now;
+		if ((action & ~CPU_TASKS_FROZEN) == CPU_ONLINE)
+			hp_stats.up_count++;
+		else
+			hp_stats.down_count++;
+		spin_unlock(&hp_stats_lock);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block tegra_hp_cpu_nb = {
+	.notifier_call = tegra_hp_cpu_notify,
+};
+
+int tegra_auto_hotplug_init(struct mutex *cpu_lock)
+{
+	int ret;
+
+	/*
+	 * Not bound to a CPU, so the work never runs on the CPU it is
+	 * about to take down.  Single-threaded.
+	 */
+	hotplug_wq = alloc_workqueue("cpu-tegra-hotplug",
+				     WQ_UNBOUND | WQ_RESCUER, 1);
+	if (!hotplug_wq)
+		return -ENOMEM;
+
+	INIT_DELAYED_WORK_DEFERRABLE(&hotplug_work,
+		tegra_auto_hotplug_work_func);
+	INIT_WORK(&boost_work, tegra_auto_hotplug_boost_func);
+	tegra_cpu_lock = cpu_lock;
+	hp_state = TEGRA_HP_IDLE;
+	hp_stats.last_change = get_jiffies_64();
+
+	register_hotcpu_notifier(&tegra_hp_cpu_nb);
+
+	ret = input_register_handler(&tegra_hp_boost_handler);
+	if (ret)
+		pr_warning("%s: touch boost unavailable: %d\n", __func__, ret);
+
+	return 0;
+}
+
+void tegra_auto_hotplug_exit(void)
+{
+	input_unregister_handler(&tegra_hp_boost_handler);
+	unregister_hotcpu_notifier(&tegra_hp_cpu_nb);
+	cancel_delayed_work_sync(&hotplug_work);
+	cancel_work_sync(&boost_work);
+	destroy_workqueue(hotplug_wq);
+	hotplug_wq = NULL;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int tegra_hp_stats_show(struct seq_file *s, void *data)
+{
+	u64 time_in[2];
+	u64 now = get_jiffies_64();
+	unsigned int up_reason[TEGRA_HP_UP_REASONS];
+	unsigned int up_count;
+	unsigned int down_count;
+
+	spin_lock(&hp_stats_lock);
+	time_in[0] = hp_stats.time_in[0];
+	time_in[1] = hp_stats.time_in[1];
+	time_in[cpu_online(1)] += now - hp_stats.last_change;
+	memcpy(up_reason, hp_stats.up_reason, sizeof(up_reason));
+	up_count = hp_stats.up_count;
+	down_count = hp_stats.down_count;
+	spin_unlock(&hp_stats_lock);
+
+	seq_printf(s, "enabled:           %u\n", enabled);
+	seq_printf(s, "cpu1 online:       %u\n", cpu_online(1));
+	seq_printf(s, "down:              %8u\n", down_count);
+	seq_printf(s, "up:                %8u\n", up_count);
+	seq_printf(s, "  frequency:       %8u\n", up_reason[TEGRA_HP_UP_FREQ]);
+	seq_printf(s, "  runqueue:        %8u\n",
+		up_reason[TEGRA_HP_UP_RUNQUEUE]);
+	seq_printf(s, "  touch boost:     %8u\n", up_reason[TEGRA_HP_UP_BOOST]);
+	seq_printf(s, "  network rx:      %8u\n", up_reason[TEGRA_HP_UP_NETRX]);
+	seq_printf(s, "time on 1 core:    %8u ms\n",
+		jiffies_to_msecs(time_in[0]));
+	seq_printf(s, "time on 2 cores:   %8u ms\n",
+		jiffies_to_msecs(time_in[1]));
+	return 0;
+}
+
+static int tegra_hp_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_hp_stats_show, inode->i_private);
+}
+
+static const struct file_operations tegra_hp_stats_fops = {
+	.open		= tegra_hp_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_hp_debug_init(void)
+{
+	if (!debugfs_create_file("tegra_hotplug", S_IRUGO, NULL, NULL,
+		&tegra_hp_stats_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(tegra_hp_debug_init);
+#endif
@@ -36,8 +36,10 @@
 
 #include <mach/hardware.h>
 #include <mach/clk.h>
+#include <mach/thermal.h>
 
 #include "clock.h"
+#include "cpu-tegra.h"
 
 static struct cpufreq_frequency_table *freq_table;
 
@@ -66,13 +68,25 @@ static int throttle_next_index;
 static struct delayed_work throttle_work;
 static struct workqueue_struct *workqueue;
 
+/* steps set by the sensor interrupt, 0 when not throttling */
+static const struct tegra_throttle_step *throttle_steps;
+static int throttle_num_steps;
+static int throttle_step;
+
 #define tegra_cpu_is_throttling() (is_throttling)
 
+static unsigned int throttle_governor_speed(unsigned int requested_speed);
+
 static void tegra_throttle_work_func(struct work_struct *work)
 {
 	unsigned int current_freq;
 
 	mutex_lock(&tegra_cpu_lock);
+	if (!is_throttling || throttle_step) {
+		mutex_unlock(&tegra_cpu_lock);
+		return;
+	}
+
 	current_freq = tegra_getspeed(0);
 	throttle_index = throttle_next_index;
 
@@ -121,6 +135,81 @@ void tegra_throttling_enable(bool enable)
 }
 EXPORT_SYMBOL_GPL(tegra_throttling_enable);
 
+void tegra_throttling_register_steps(const struct tegra_throttle_step *steps,
+	int num_steps)
+{
+	mutex_lock(&tegra_cpu_lock);
+	throttle_steps = steps;
+	throttle_num_steps = num_steps;
+	mutex_unlock(&tegra_cpu_lock);
+}
+EXPORT_SYMBOL_GPL(tegra_throttling_register_steps);
+
+static int throttle_step_index(int step)
+{
+	int index;
+
+	if (!throttle_steps)
+		return max(throttle_highest_index - (step - 1),
+			   throttle_lowest_index);
+
+	for (index = throttle_highest_index;
+	     index > throttle_lowest_index;
+	     index--)
+		if (freq_table[index].frequency <=
+		    throttle_steps[step - 1].cpu_khz)
+			break;
+
+	return index;
+}
+
+static void throttle_set_cap(const char *name, unsigned long cap)
+{
+	struct clk *c = tegra_get_clock_by_name(name);
+
+	if (c && c->cap_rate != cap)
+		tegra_clk_set_cap(c, cap);
+}
+
+/*
+ * tegra_throttling_set_step
+ * Called from the temperature sensor as it crosses a threshold, there is
+ * no work left running between calls.  This function may sleep
+ */
+void tegra_throttling_set_step(int step)
+{
+	const struct tegra_throttle_step *s = NULL;
+
+	mutex_lock(&tegra_cpu_lock);
+
+	step = max(step, 0);
+	if (throttle_steps)
+		step = min(step, throttle_num_steps);
+	if (step == throttle_step)
+		goto out;
+
+	/* the work only runs for tegra_throttling_enable() */
+	cancel_delayed_work(&throttle_work);
+
+	throttle_step = step;
+	is_throttling = step > 0;
+	if (is_throttling) {
+		throttle_index = throttle_step_index(step);
+		if (throttle_steps)
+			s = &throttle_steps[step - 1];
+	}
+
+	throttle_set_cap("3d", s ? s->gpu_hz : 0);
+	throttle_set_cap("emc", s ? s->emc_hz : 0);
+
+	if (!is_suspended)
+		tegra_update_cpu_speed(
+			throttle_governor_speed(tegra_cpu_highest_speed()));
+out:
+	mutex_unlock(&tegra_cpu_lock);
+}
+EXPORT_SYMBOL_GPL(tegra_throttling_set_step);
+
 static unsigned int throttle_governor_speed(unsigned int requested_speed)
 {
 	return tegra_cpu_is_throttling() ?
@@ -149,6 +238,20 @@ static int throttle_debug_get(void *data, u64 *val)
 
 DEFINE_SIMPLE_ATTRIBUTE(throttle_fops, throttle_debug_get, throttle_debug_set, "%llu\n");
 
+static int throttle_step_debug_set(void *data, u64 val)
+{
+	tegra_throttling_set_step(val);
+	return 0;
+}
+static int throttle_step_debug_get(void *data, u64 *val)
+{
+	*val = (u64) throttle_step;
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(throttle_step_fops, throttle_step_debug_get,
+	throttle_step_debug_set, "%llu\n");
+
 static struct dentry *cpu_tegra_debugfs_root;
 
 static int __init tegra_cpu_debug_init(void)
@@ -161,6 +264,10 @@ static int __init tegra_cpu_debug_init(void)
 	if (!debugfs_create_file("throttle", 0644, cpu_tegra_debugfs_root, NULL, &throttle_fops))
 		goto err_out;
 
+	if (!debugfs_create_file("throttle_step", 0644, cpu_tegra_debugfs_root,
+				 NULL, &throttle_step_fops))
+		goto err_out;
+
 	return 0;
 
 err_out:
@@ -185,6 +292,15 @@ module_exit(tegra_cpu_debug_exit);
 void tegra_throttling_enable(bool enable)
 {
 }
+
+void tegra_throttling_register_steps(const struct tegra_throttle_step *steps,
+	int num_steps)
+{
+}
+
+void tegra_throttling_set_step(int step)
+{
+}
 #endif /* CONFIG_TEGRA_THERMAL_THROTTLE */
 
 int tegra_verify_speed(struct cpufreq_policy *policy)
@@ -283,6 +399,8 @@ static int tegra_target(struct cpufreq_policy *policy,
 	target_cpu_speed[policy->cpu] = freq;
 	new_speed = throttle_governor_speed(tegra_cpu_highest_speed());
 	ret = tegra_update_cpu_speed(new_speed);
+	if (ret == 0)
+		tegra_auto_hotplug_governor(new_speed, false);
 out:
 	mutex_unlock(&tegra_cpu_lock);
 	return ret;
@@ -298,6 +416,7 @@ static int tegra_pm_notify(struct notifier_block *nb, unsigned long event,
 		pr_info("Tegra cpufreq suspend: setting frequency to %d kHz\n",
 			freq_table[0].frequency);
 		tegra_update_cpu_speed(freq_table[0].frequency);
+		tegra_auto_hotplug_governor(freq_table[0].frequency, true);
 	} else if (event == PM_POST_SUSPEND) {
 		is_suspended = false;
 	}
@@ -375,6 +494,8 @@ static int __init tegra_cpufreq_init(void)
 {
 	struct tegra_cpufreq_table_data *table_data =
 		tegra_cpufreq_table_get();
+	int ret;
+
 	BUG_ON(!table_data);
 
 #ifdef CONFIG_TEGRA_THERMAL_THROTTLE
@@ -393,6 +514,11 @@ static int __init tegra_cpufreq_init(void)
 	throttle_highest_index = table_data->throttle_highest_index;
 #endif
 	freq_table = table_data->freq_table;
+
+	ret = tegra_auto_hotplug_init(&tegra_cpu_lock);
+	if (ret)
+		return ret;
+
 	return cpufreq_register_driver(&tegra_cpufreq_driver);
 }
 
@@ -402,6 +528,7 @@ static void __exit tegra_cpufreq_exit(void)
 	destroy_workqueue(workqueue);
 #endif
         cpufreq_unregister_driver(&tegra_cpufreq_driver);
+	tegra_auto_hotplug_exit();
 }
 
 
@@ -40,6 +40,7 @@
 #include <asm/cacheflush.h>
 #include <asm/hardware/gic.h>
 #include <asm/localtimer.h>
+#include <asm/pmu.h>
 
 #include <mach/iomap.h>
 #include <mach/irqs.h>
@@ -64,6 +65,22 @@ static bool lp2_in_idle __read_mostly = true;
 static bool lp2_disabled_by_suspend;
 module_param(lp2_in_idle, bool, 0644);
 
+static bool lp2_predict __read_mostly = true;
+module_param(lp2_predict, bool, 0644);
+
+#ifdef CONFIG_SMP
+/*
+ * CPU0 only reaches LP2 while CPU1 is idle too, so waking CPU1 for a short
+ * task costs an LP2 exit on both.  Have the scheduler pack such wakeups on
+ * the busy cpu instead.  Read whenever the sched domains are rebuilt, which
+ * the auto hotplug governor triggers each time it brings CPU1 up.
+ */
+int arch_sd_pack_wakeups(void)
+{
+	return lp2_in_idle ? SD_PACK_WAKEUPS : 0;
+}
+#endif
+
 static s64 tegra_cpu1_idle_time = LLONG_MAX;;
 static int tegra_lp2_exit_latency;
 static int tegra_lp2_power_off_time;
@@ -73,9 +90,16 @@ static struct {
 	unsigned long long cpu_wants_lp2_time[2];
 	unsigned long long in_lp2_time;
 	unsigned int both_idle_count;
+	unsigned int single_core_count;
 	unsigned int tear_down_count;
 	unsigned int lp2_count;
 	unsigned int lp2_completed_count;
+	unsigned int lp2_wasted_count;
+	unsigned int lp2_skipped_count[2];
+	unsigned int predict_count[2];
+	unsigned int predict_hit_count[2];
+	unsigned int predict_count_bin[32];
+	unsigned int predict_hit_count_bin[32];
 	unsigned int lp2_count_bin[32];
 	unsigned int lp2_completed_count_bin[32];
 	unsigned int lp2_int_count[NR_IRQS];
@@ -89,6 +113,22 @@ struct cpuidle_driver tegra_idle = {
 
 static DEFINE_PER_CPU(struct cpuidle_device *, idle_devices);
 
+/*
+ * The last few idle durations on each CPU.  The next timer event does
+ * not know about device interrupts (USB, SDIO, ...), so when these are
+ * consistent they are a better guess at how long the next idle period
+ * will last than tick_nohz_get_sleep_length().
+ */
+#define TEGRA_IDLE_HISTORY	8
+#define TEGRA_IDLE_MAX_INTERVAL	USEC_PER_SEC
+
+struct tegra_idle_predictor {
+	unsigned int interval[TEGRA_IDLE_HISTORY];
+	unsigned int next;
+};
+
+static DEFINE_PER_CPU(struct tegra_idle_predictor, idle_predictor);
+
 #define FLOW_CTRL_WAITEVENT   (2<<29)
 #define FLOW_CTRL_JTAG_RESUME (1<<28)
 #define FLOW_CTRL_HALT_CPUx_EVENTS(cpu) ((cpu)?((cpu-1)*0x8 + 0x14) : 0x0)
@@ -103,6 +143,90 @@ static inline unsigned int time_to_bin(unsigned int time)
 	return fls(time);
 }
 
+static void tegra_idle_record(unsigned int cpu, s64 us)
+{
+	struct tegra_idle_predictor *p = &per_cpu(idle_predictor, cpu);
+
+	p->interval[p->next] = clamp_t(s64, us, 0, TEGRA_IDLE_MAX_INTERVAL);
+	p->next = (p->next + 1) % TEGRA_IDLE_HISTORY;
+}
+
+/*
+ * Returns the typical recent idle duration in us, or UINT_MAX if the
+ * history is too scattered to say.  Outliers at the top are dropped
+ * one at a time, the same way the menu governor looks for a repeating
+ * interrupt interval.
+ */
+static unsigned int tegra_idle_predict(unsigned int cpu)
+{
+	struct tegra_idle_predictor *p = &per_cpu(idle_predictor, cpu);
+	unsigned int thresh = UINT_MAX;
+	unsigned int divisor;
+	unsigned int longest;
+	unsigned int i;
+	u64 avg;
+	u64 variance;
+	s64 diff;
+	int pass;
+
+	for (pass = 0; pass < 3; pass++) {
+		avg = 0;
+		divisor = 0;
+		longest = 0;
+		for (i = 0; i < TEGRA_IDLE_HISTORY; i++) {
+			if (p->interval[i] > thresh)
+				continue;
+			avg += p->interval[i];
+			longest = max(longest, p->interval[i]);
+			divisor++;
+		}
+
+		/* Dropped too many samples to trust what is left */
+		if (divisor < TEGRA_IDLE_HISTORY * 3 / 4)
+			break;
+
+		avg = div_u64(avg, divisor);
+		variance = 0;
+		for (i = 0; i < TEGRA_IDLE_HISTORY; i++) {
+			if (p->interval[i] > thresh)
+				continue;
+			diff = (s64)p->interval[i] - (s64)avg;
+			variance += diff * diff;
+		}
+		variance = div_u64(variance, divisor);
+
+		/* Standard deviation within a quarter of the mean, or 20 us */
+		if (variance * 16 <= avg * avg || variance <= 400)
+			return (unsigned int)avg;
+
+		thresh = longest - 1;
+	}
+
+	return UINT_MAX;
+}
+
+static void tegra_idle_predict_update(unsigned int cpu, s64 predicted,
+	s64 us, struct cpuidle_state *state)
+{
+	unsigned int bin;
+	bool hit;
+
+	/*
+	 * The prediction was right if it put the wakeup on the same side
+	 * of the LP2 break-even time as what actually happened.
+	 */
+	hit = (predicted < state->target_residency) ==
+		(us < state->target_residency);
+	bin = time_to_bin((u32)predicted / 1000);
+
+	idle_stats.predict_count[cpu]++;
+	idle_stats.predict_count_bin[bin]++;
+	if (hit) {
+		idle_stats.predict_hit_count[cpu]++;
+		idle_stats.predict_hit_count_bin[bin]++;
+	}
+}
+
 static inline void tegra_unmask_irq(int irq)
 {
 	struct irq_chip *chip = get_irq_chip(irq);
@@ -179,6 +303,12 @@ static inline bool tegra_cpu_in_reset(int cpu)
 	return !!(readl(CLK_RST_CONTROLLER_RST_CPU_CMPLX_SET) & (1 << cpu));
 }
 
+/* CPU1 has been hotplugged out and is already held in reset */
+static inline bool tegra_cpu1_is_down(void)
+{
+	return !cpu_online(1) && tegra_cpu_in_reset(1);
+}
+
 static int tegra_tear_down_cpu1(void)
 {
 	u32 reg;
@@ -205,10 +335,6 @@ static int tegra_tear_down_cpu1(void)
 
 	return 0;
 }
-#ifdef CONFIG_TRUSTED_FOUNDATIONS
-void callGenericSMC(u32 param0, u32 param1, u32 param2);
-#endif
-
 static void tegra_wake_cpu1(void)
 {
 	unsigned long boot_vector;
@@ -221,7 +347,7 @@ static void tegra_wake_cpu1(void)
 
 	boot_vector = virt_to_phys(tegra_hotplug_startup);
 #if CONFIG_TRUSTED_FOUNDATIONS
-	callGenericSMC(0xFFFFFFFC, 0xFFFFFFE5, boot_vector);
+	tegra_smc_set_boot_vector(boot_vector);
 #else
 	old_boot_vector = readl(vector_base);
 	writel(boot_vector, vector_base);
@@ -251,6 +377,11 @@ static void tegra_wake_cpu1(void)
 	/* CPU1 is now started */
 }
 #else
+static inline bool tegra_cpu1_is_down(void)
+{
+	return true;
+}
+
 static inline bool tegra_wait_for_both_idle(struct cpuidle_device *dev)
 {
 	return true;
@@ -273,13 +404,19 @@ static void tegra_idle_enter_lp2_cpu0(struct cpuidle_device *dev,
 	ktime_t enter;
 	ktime_t exit;
 	bool sleep_completed = false;
+	bool cpu1_down = tegra_cpu1_is_down();
 	int bin;
 
 restart:
-	if (!tegra_wait_for_both_idle(dev))
-		return;
-
-	idle_stats.both_idle_count++;
+	/* With CPU1 hotplugged out there is nobody to handshake with */
+	if (cpu1_down) {
+		idle_stats.single_core_count++;
+	} else {
+		if (!tegra_wait_for_both_idle(dev))
+			return;
+
+		idle_stats.both_idle_count++;
+	}
 
 	if (need_resched())
 		return;
@@ -293,15 +430,18 @@ restart:
 		return;
 	}
 
-	idle_stats.tear_down_count++;
+	if (!cpu1_down) {
+		idle_stats.tear_down_count++;
 
-	if (tegra_tear_down_cpu1())
-		goto restart;
+		if (tegra_tear_down_cpu1())
+			goto restart;
+	}
 
 	/* Enter LP2 */
 	request = ktime_to_us(tick_nohz_get_sleep_length());
 	smp_rmb();
-	request = min_t(s64, request, tegra_cpu1_idle_time);
+	if (!cpu1_down)
+		request = min_t(s64, request, tegra_cpu1_idle_time);
 
 	enter = ktime_get();
 	if (request > state->target_residency) {
@@ -311,10 +451,17 @@ restart:
 		idle_stats.lp2_count++;
 		idle_stats.lp2_count_bin[bin]++;
 
+		armpmu_cpu_save();
 		if (tegra_suspend_lp2(sleep_time) == 0)
 			sleep_completed = true;
 		else
 			idle_stats.lp2_int_count[tegra_pending_interrupt()]++;
+		armpmu_cpu_restore();
+
+		/* Woke before LP2 paid for the power-good and restore time */
+		if (ktime_to_us(ktime_sub(ktime_get(), enter)) <
+		    state->target_residency)
+			idle_stats.lp2_wasted_count++;
 	}
 
 	/* Bring CPU1 out of LP2 */
@@ -324,7 +471,8 @@ restart:
 	/* set the reset vector to point to the secondary_startup routine */
 	smp_wmb();
 
-	tegra_wake_cpu1();
+	if (!cpu1_down)
+		tegra_wake_cpu1();
 
 	/*
 	 * TODO: is it worth going back to wfi if no interrupt is pending
@@ -396,6 +544,7 @@ static void tegra_idle_enter_lp2_cpu1(struct cpuidle_device *dev,
 	twd_ctrl = readl(twd_base + 0x8);
 	twd_load = readl(twd_base + 0);
 
+	armpmu_cpu_save();
 	flush_cache_all();
 	barrier();
 	__cortex_a9_save(0);
@@ -408,6 +557,7 @@ static void tegra_idle_enter_lp2_cpu1(struct cpuidle_device *dev,
 	writel(twd_load, twd_base + 0);
 	gic_cpu_init(0, IO_ADDRESS(TEGRA_ARM_PERIF_BASE) + 0x100);
 	tegra_unmask_irq(IRQ_LOCALTIMER);
+	armpmu_cpu_restore();
 
 	tegra_legacy_force_irq_clr(TEGRA_CPUIDLE_BOTH_IDLE);
 
@@ -443,6 +593,9 @@ static int tegra_idle_enter_lp3(struct cpuidle_device *dev,
 
 	local_fiq_enable();
 	local_irq_enable();
+
+	tegra_idle_record(dev->cpu, us);
+
 	return (int)us;
 }
 
@@ -451,10 +604,28 @@ static int tegra_idle_enter_lp2(struct cpuidle_device *dev,
 {
 	ktime_t enter, exit;
 	s64 us;
+	s64 request;
+	s64 predicted;
 
 	if (!lp2_in_idle || lp2_disabled_by_suspend)
 		return tegra_idle_enter_lp3(dev, state);
 
+	request = ktime_to_us(tick_nohz_get_sleep_length());
+	predicted = lp2_predict ? tegra_idle_predict(dev->cpu) : UINT_MAX;
+	predicted = min(predicted, request);
+
+	/*
+	 * The timer alone would allow LP2, but recent history says an
+	 * interrupt will arrive before LP2 breaks even.
+	 */
+	if (predicted < state->target_residency &&
+	    request >= state->target_residency) {
+		idle_stats.lp2_skipped_count[dev->cpu]++;
+		us = tegra_idle_enter_lp3(dev, state);
+		tegra_idle_predict_update(dev->cpu, predicted, us, state);
+		return (int)us;
+	}
+
 	local_irq_disable();
 	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_ENTER, &dev->cpu);
 	local_fiq_disable();
@@ -485,6 +656,9 @@ static int tegra_idle_enter_lp2(struct cpuidle_device *dev,
 
 	idle_stats.cpu_wants_lp2_time[dev->cpu] += us;
 
+	tegra_idle_record(dev->cpu, us);
+	tegra_idle_predict_update(dev->cpu, predicted, us, state);
+
 	return (int)us;
 }
 
@@ -492,6 +666,7 @@ static int tegra_cpuidle_register_device(unsigned int cpu)
 {
 	struct cpuidle_device *dev;
 	struct cpuidle_state *state;
+	int i;
 
 	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
 	if (!dev)
@@ -500,6 +675,11 @@ static int tegra_cpuidle_register_device(unsigned int cpu)
 	dev->state_count = 0;
 	dev->cpu = cpu;
 
+	/* Start out trusting the timer until some history builds up */
+	for (i = 0; i < TEGRA_IDLE_HISTORY; i++)
+		per_cpu(idle_predictor, cpu).interval[i] =
+			TEGRA_IDLE_MAX_INTERVAL;
+
 	tegra_lp2_power_off_time = tegra_cpu_power_off_time();
 
 	state = &dev->states[0];
@@ -638,6 +818,7 @@ static int tegra_lp2_debug_show(struct seq_file *s, void *data)
 			(idle_stats.cpu_ready_count[0] ?: 1),
 		idle_stats.both_idle_count * 100 /
 			(idle_stats.cpu_ready_count[1] ?: 1));
+	seq_printf(s, "cpu1 offline:   %8u\n", idle_stats.single_core_count);
 	seq_printf(s, "tear down:      %8u %7u%%\n", idle_stats.tear_down_count,
 		idle_stats.tear_down_count * 100 /
 			(idle_stats.both_idle_count ?: 1));
@@ -648,6 +829,23 @@ static int tegra_lp2_debug_show(struct seq_file *s, void *data)
 		idle_stats.lp2_completed_count,
 		idle_stats.lp2_completed_count * 100 /
 			(idle_stats.lp2_count ?: 1));
+	seq_printf(s, "lp2 wasted:     %8u %7u%%\n",
+		idle_stats.lp2_wasted_count,
+		idle_stats.lp2_wasted_count * 100 /
+			(idle_stats.lp2_count ?: 1));
+
+	seq_printf(s, "\n");
+	seq_printf(s, "lp2 predicted short:            %8u %8u\n",
+		idle_stats.lp2_skipped_count[0],
+		idle_stats.lp2_skipped_count[1]);
+	seq_printf(s, "predictions:                    %8u %8u\n",
+		idle_stats.predict_count[0],
+		idle_stats.predict_count[1]);
+	seq_printf(s, "prediction accuracy:            %7u%% %7u%%\n",
+		idle_stats.predict_hit_count[0] * 100 /
+			(idle_stats.predict_count[0] ?: 1),
+		idle_stats.predict_hit_count[1] * 100 /
+			(idle_stats.predict_count[1] ?: 1));
 
 	seq_printf(s, "\n");
 	seq_printf(s, "cpu ready time:                 %8llu %8llu ms\n",
@@ -674,6 +872,20 @@ static int tegra_lp2_debug_show(struct seq_file *s, void *data)
 				idle_stats.lp2_count_bin[bin]);
 	}
 
+	seq_printf(s, "\n");
+	seq_printf(s, "%19s %8s %8s %8s\n", "predicted", "count", "hit", "%");
+	seq_printf(s, "-------------------------------------------------\n");
+	for (bin = 0; bin < 32; bin++) {
+		if (idle_stats.predict_count_bin[bin] == 0)
+			continue;
+		seq_printf(s, "%6u - %6u ms: %8u %8u %7u%%\n",
+			1 << (bin - 1), 1 << bin,
+			idle_stats.predict_count_bin[bin],
+			idle_stats.predict_hit_count_bin[bin],
+			idle_stats.predict_hit_count_bin[bin] * 100 /
+				idle_stats.predict_count_bin[bin]);
+	}
+
 	seq_printf(s, "\n");
 	seq_printf(s, "%3s %20s %6s %10s\n",
 		"int", "name", "count", "last count");
@@ -867,3 +867,14 @@ struct platform_device tegra_aes_device = {
 		.coherent_dma_mask = DMA_BIT_MASK(32),
 	},
 };
+
+static u64 tegra_dma_dma_mask = DMA_BIT_MASK(32);
+
+struct platform_device tegra_dma_device = {
+	.name		= "tegra-dma",
+	.id		= -1,
+	.dev	= {
+		.dma_mask = &tegra_dma_dma_mask,
+		.coherent_dma_mask = DMA_BIT_MASK(32),
+	},
+};
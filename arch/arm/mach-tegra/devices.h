@@ -62,5 +62,6 @@ extern struct platform_device tegra_spdif_device;
 extern struct platform_device tegra_avp_device;
 extern struct platform_device tegra_aes_device;
 extern struct platform_device tegra_das_device;
+extern struct platform_device tegra_dma_device;
 
 #endif
@@ -27,11 +27,17 @@
 #include <linux/err.h>
 #include <linux/irq.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <mach/dma.h>
 #include <mach/irqs.h>
 #include <mach/iomap.h>
 #include <mach/suspend.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/tegra_dma.h>
+
 #define APB_DMA_GEN				0x000
 #define GEN_ENABLE				(1<<31)
 
@@ -109,6 +115,11 @@ const unsigned int apb_addr_wrap_table[8] = {0, 1, 2, 4, 8, 16, 32, 64};
 
 const unsigned int bus_width_table[5] = {8, 16, 32, 64, 128};
 
+/* Latency histogram buckets: bucket 0 is below 1us, bucket n counts
+ * [2^(n-1), 2^n) us and the last one everything above.
+ */
+#define TEGRA_DMA_LAT_BUCKETS	16
+
 #define TEGRA_DMA_NAME_SIZE 16
 struct tegra_dma_channel {
 	struct list_head	list;
@@ -119,6 +130,12 @@ struct tegra_dma_channel {
 	int			mode;
 	int			irq;
 	int			req_transfer_count;
+#ifdef CONFIG_DEBUG_FS
+	ktime_t			irq_ts;
+	ktime_t			callback_ts;
+	u32			irq_to_callback[TEGRA_DMA_LAT_BUCKETS];
+	u32			callback_to_requeue[TEGRA_DMA_LAT_BUCKETS];
+#endif
 };
 
 #define  NV_DMA_MAX_CHANNELS  32
@@ -135,6 +152,45 @@ static void tegra_dma_update_hw_partial(struct tegra_dma_channel *ch,
 	struct tegra_dma_req *req);
 static void tegra_dma_stop(struct tegra_dma_channel *ch);
 
+#ifdef CONFIG_DEBUG_FS
+static void tegra_dma_lat_add(u32 *hist, ktime_t start, ktime_t end)
+{
+	s64 us = ktime_us_delta(end, start);
+	int bucket = 0;
+
+	if (us > 0)
+		bucket = min(fls(min_t(s64, us, INT_MAX)),
+			TEGRA_DMA_LAT_BUCKETS - 1);
+	hist[bucket]++;
+}
+
+static inline void tegra_dma_note_irq(struct tegra_dma_channel *ch)
+{
+	ch->irq_ts = ktime_get();
+}
+
+/* Called with the channel lock held, just before a client callback */
+static void tegra_dma_note_callback(struct tegra_dma_channel *ch)
+{
+	ch->callback_ts = ktime_get();
+	tegra_dma_lat_add(ch->irq_to_callback, ch->irq_ts, ch->callback_ts);
+}
+
+/* Called with the channel lock held when a client queues a request */
+static void tegra_dma_note_requeue(struct tegra_dma_channel *ch)
+{
+	if (!ktime_to_ns(ch->callback_ts))
+		return;
+	tegra_dma_lat_add(ch->callback_to_requeue, ch->callback_ts,
+		ktime_get());
+	ch->callback_ts = ktime_set(0, 0);
+}
+#else
+static inline void tegra_dma_note_irq(struct tegra_dma_channel *ch) { }
+static inline void tegra_dma_note_callback(struct tegra_dma_channel *ch) { }
+static inline void tegra_dma_note_requeue(struct tegra_dma_channel *ch) { }
+#endif
+
 void tegra_dma_flush(struct tegra_dma_channel *ch)
 {
 }
@@ -254,6 +310,12 @@ static unsigned int dma_active_count(struct tegra_dma_channel *ch,
 
 	bytes_transferred *= 4;
 
+	/* Scatterlist requests keep the finished segments in
+	 * bytes_transferred; the count above is the current one only.
+	 */
+	if (req->sg)
+		bytes_transferred += req->bytes_transferred;
+
 	return bytes_transferred;
 }
 
@@ -302,6 +364,8 @@ skip_status:
 	spin_unlock_irqrestore(&ch->lock, irq_flags);
 
 	/* Callback should be called without any lock */
+	trace_tegra_dma_req_complete(ch->id, req->bytes_transferred,
+		req->status);
 	req->complete(req);
 	return 0;
 }
@@ -377,12 +441,29 @@ int tegra_dma_enqueue_req(struct tegra_dma_channel *ch,
 	struct tegra_dma_req *_req;
 	int start_dma = 0;
 
-	if (req->size > TEGRA_DMA_MAX_TRANSFER_SIZE ||
-		req->source_addr & 0x3 || req->dest_addr & 0x3) {
-		pr_err("Invalid DMA request for channel %d\n", ch->id);
-		return -EINVAL;
+	if (req->sg) {
+		struct scatterlist *sg;
+		unsigned int size = 0;
+		int i;
+
+		if (!(ch->mode & TEGRA_DMA_MODE_ONESHOT) || !req->sg_len)
+			goto invalid;
+
+		for_each_sg(req->sg, sg, req->sg_len, i) {
+			if (!sg_dma_len(sg) ||
+			    sg_dma_len(sg) > TEGRA_DMA_MAX_TRANSFER_SIZE ||
+			    (sg_dma_len(sg) | sg_dma_address(sg)) & 0x3)
+				goto invalid;
+			size += sg_dma_len(sg);
+		}
+		req->size = size;
+	} else if (req->size > TEGRA_DMA_MAX_TRANSFER_SIZE) {
+		goto invalid;
 	}
 
+	if (req->source_addr & 0x3 || req->dest_addr & 0x3)
+		goto invalid;
+
 	spin_lock_irqsave(&ch->lock, irq_flags);
 
 	list_for_each_entry(_req, &ch->list, node) {
@@ -392,8 +473,12 @@ int tegra_dma_enqueue_req(struct tegra_dma_channel *ch,
 		}
 	}
 
+	tegra_dma_note_requeue(ch);
+
 	req->bytes_transferred = 0;
 	req->status = 0;
+	req->cur_sg = req->sg;
+	req->sg_left = req->sg_len;
 	/* STATUS_EMPTY just means the DMA hasn't processed the buf yet. */
 	req->buffer_status = TEGRA_DMA_REQ_BUF_STATUS_EMPTY;
 	if (list_empty(&ch->list))
@@ -435,6 +520,10 @@ int tegra_dma_enqueue_req(struct tegra_dma_channel *ch,
 	spin_unlock_irqrestore(&ch->lock, irq_flags);
 
 	return 0;
+
+invalid:
+	pr_err("Invalid DMA request for channel %d\n", ch->id);
+	return -EINVAL;
 }
 EXPORT_SYMBOL(tegra_dma_enqueue_req);
 
@@ -516,6 +605,7 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 	int ahb_bus_width;
 	int apb_bus_width;
 	int index;
+	unsigned int size;
 
 	u32 ahb_seq;
 	u32 apb_seq;
@@ -523,6 +613,8 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 	u32 apb_ptr;
 	u32 csr;
 
+	size = req->sg ? sg_dma_len(req->cur_sg) : req->size;
+
 	csr = CSR_IE_EOC | CSR_FLOW;
 	ahb_seq = AHB_SEQ_INTR_ENB;
 
@@ -536,9 +628,9 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 		 * i.e. if multiple of 32 bytes then busrt is
 		 * 8 word else if multiple of 16 bytes then burst is
 		 * 4 word else burst size is 1 word */
-		if (req->size & 0xF)
+		if (size & 0xF)
 			ahb_seq |= AHB_SEQ_BURST_1;
-		else if ((req->size >> 4) & 0x1)
+		else if ((size >> 4) & 0x1)
 			ahb_seq |= AHB_SEQ_BURST_4;
 		else
 			ahb_seq |= AHB_SEQ_BURST_8;
@@ -552,7 +644,7 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 
 	csr |= req->req_sel << CSR_REQ_SEL_SHIFT;
 
-	ch->req_transfer_count = (req->size >> 2) - 1;
+	ch->req_transfer_count = (size >> 2) - 1;
 
 	/* One shot mode is always single buffered.  Continuous mode could
 	 * support either.
@@ -565,7 +657,7 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 		 * completion.  The double buffer means 2 interrupts
 		 * pass before the DMA HW latches a new AHB_PTR etc.
 		 */
-		ch->req_transfer_count = (req->size >> 3) - 1;
+		ch->req_transfer_count = (size >> 3) - 1;
 	}
 	csr |= ch->req_transfer_count << CSR_WCOUNT_SHIFT;
 
@@ -589,6 +681,9 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 		ahb_bus_width = req->source_bus_width;
 	}
 
+	if (req->sg)
+		ahb_ptr = sg_dma_address(req->cur_sg);
+
 	apb_addr_wrap >>= 2;
 	ahb_addr_wrap >>= 2;
 
@@ -636,11 +731,13 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 	writel(csr, ch->addr + APB_DMA_CHAN_CSR);
 
 	req->status = TEGRA_DMA_REQ_INFLIGHT;
+	trace_tegra_dma_req_start(ch->id, req->req_sel, size, req->to_memory);
 }
 
 static void handle_oneshot_dma(struct tegra_dma_channel *ch)
 {
 	struct tegra_dma_req *req;
+	struct tegra_dma_req *next_req;
 	unsigned long irq_flags;
 
 	spin_lock_irqsave(&ch->lock, irq_flags);
@@ -650,27 +747,46 @@ static void handle_oneshot_dma(struct tegra_dma_channel *ch)
 	}
 
 	req = list_entry(ch->list.next, typeof(*req), node);
-	if (req) {
-		list_del(&req->node);
-		req->bytes_transferred = req->size;
-		req->status = TEGRA_DMA_REQ_SUCCESS;
 
+	/* Chain the next scatterlist segment right here; the channel has
+	 * stopped and the device FIFO is the only buffering left.
+	 */
+	if (req->sg && req->sg_left > 1) {
+		req->bytes_transferred += sg_dma_len(req->cur_sg);
+		req->cur_sg = sg_next(req->cur_sg);
+		req->sg_left--;
+		tegra_dma_update_hw(ch, req);
+		if (req->progress)
+			tegra_dma_note_callback(ch);
 		spin_unlock_irqrestore(&ch->lock, irq_flags);
-		/* Callback should be called without any lock */
-		pr_debug("%s: transferred %d bytes\n", __func__,
-			req->bytes_transferred);
-		req->complete(req);
-		spin_lock_irqsave(&ch->lock, irq_flags);
+
+		if (req->progress)
+			req->progress(req);
+		return;
 	}
 
+	list_del(&req->node);
+	req->bytes_transferred = req->size;
+	req->status = TEGRA_DMA_REQ_SUCCESS;
+
+	/* Start the next request before calling back, so the channel is
+	 * busy again while the client handles this one. If the queue is
+	 * empty, a request queued from the callback starts right away in
+	 * tegra_dma_enqueue_req().
+	 */
 	if (!list_empty(&ch->list)) {
-		req = list_entry(ch->list.next, typeof(*req), node);
-		/* the complete function we just called may have enqueued
-		   another req, in which case dma has already started */
-		if (req->status != TEGRA_DMA_REQ_INFLIGHT)
-			tegra_dma_update_hw(ch, req);
+		next_req = list_entry(ch->list.next, typeof(*next_req), node);
+		tegra_dma_update_hw(ch, next_req);
 	}
+	tegra_dma_note_callback(ch);
 	spin_unlock_irqrestore(&ch->lock, irq_flags);
+
+	/* Callback should be called without any lock */
+	pr_debug("%s: transferred %d bytes\n", __func__,
+		req->bytes_transferred);
+	trace_tegra_dma_req_complete(ch->id, req->bytes_transferred,
+		req->status);
+	req->complete(req);
 }
 
 static void handle_continuous_dbl_dma(struct tegra_dma_channel *ch)
@@ -709,10 +825,13 @@ static void handle_continuous_dbl_dma(struct tegra_dma_channel *ch)
 				}
 
 				list_del(&req->node);
+				tegra_dma_note_callback(ch);
 
 				/* DMA lock is NOT held when callbak is
 				 * called. */
 				spin_unlock_irqrestore(&ch->lock, irq_flags);
+				trace_tegra_dma_req_complete(ch->id,
+					req->bytes_transferred, req->status);
 				req->complete(req);
 				return;
 			}
@@ -725,6 +844,8 @@ static void handle_continuous_dbl_dma(struct tegra_dma_channel *ch)
 			}
 			req->buffer_status = TEGRA_DMA_REQ_BUF_STATUS_HALF_FULL;
 			req->bytes_transferred = req->size >> 1;
+			if (likely(req->threshold))
+				tegra_dma_note_callback(ch);
 			/* DMA lock is NOT held when callback is called */
 			spin_unlock_irqrestore(&ch->lock, irq_flags);
 			if (likely(req->threshold))
@@ -755,9 +876,12 @@ static void handle_continuous_dbl_dma(struct tegra_dma_channel *ch)
 			}
 
 			list_del(&req->node);
+			tegra_dma_note_callback(ch);
 
 			/* DMA lock is NOT held when callbak is called */
 			spin_unlock_irqrestore(&ch->lock, irq_flags);
+			trace_tegra_dma_req_complete(ch->id, req->bytes_transferred,
+				req->status);
 			req->complete(req);
 			return;
 
@@ -817,7 +941,10 @@ static void handle_continuous_sngl_dma(struct tegra_dma_channel *ch)
 		}
 	}
 	list_del(&req->node);
+	tegra_dma_note_callback(ch);
 	spin_unlock_irqrestore(&ch->lock, irq_flags);
+	trace_tegra_dma_req_complete(ch->id, req->bytes_transferred,
+		req->status);
 	req->complete(req);
 }
 
@@ -833,6 +960,7 @@ static irqreturn_t dma_isr(int irq, void *data)
 		pr_warning("Got a spurious ISR for DMA channel %d\n", ch->id);
 		return IRQ_HANDLED;
 	}
+	tegra_dma_note_irq(ch);
 
 	if (ch->mode & TEGRA_DMA_MODE_ONESHOT)
 		handle_oneshot_dma(ch);
@@ -905,6 +1033,61 @@ fail:
 	return ret;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static void tegra_dma_show_hist(struct seq_file *s, const char *name,
+	const u32 *hist)
+{
+	int i;
+
+	seq_printf(s, "  %-12s", name);
+	for (i = 0; i < TEGRA_DMA_LAT_BUCKETS; i++)
+		seq_printf(s, " %6u", hist[i]);
+	seq_printf(s, "\n");
+}
+
+static int tegra_dma_latency_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	seq_printf(s, "  %-12s", "usec <");
+	for (i = 0; i < TEGRA_DMA_LAT_BUCKETS - 1; i++)
+		seq_printf(s, " %6u", 1 << i);
+	seq_printf(s, " %6s\n", "more");
+
+	for (i = TEGRA_SYSTEM_DMA_CH_MIN; i <= TEGRA_SYSTEM_DMA_CH_MAX; i++) {
+		struct tegra_dma_channel *ch = &dma_channels[i];
+
+		if (!test_bit(i, channel_usage))
+			continue;
+		seq_printf(s, "%s:\n", ch->name);
+		tegra_dma_show_hist(s, "irq->cb", ch->irq_to_callback);
+		tegra_dma_show_hist(s, "cb->requeue", ch->callback_to_requeue);
+	}
+	return 0;
+}
+
+static int tegra_dma_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_dma_latency_show, inode->i_private);
+}
+
+static const struct file_operations tegra_dma_latency_fops = {
+	.open		= tegra_dma_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_dma_debug_init(void)
+{
+	if (!debugfs_create_file("tegra_dma_latency", S_IRUGO, NULL, NULL,
+		&tegra_dma_latency_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(tegra_dma_debug_init);
+#endif
+
 #ifdef CONFIG_PM
 static u32 apb_dma[5*TEGRA_SYSTEM_DMA_CH_NR + 3];
 
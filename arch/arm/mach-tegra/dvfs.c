@@ -28,6 +28,9 @@
 #include <linux/slab.h>
 #include <linux/suspend.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
 
 #include <asm/clkdev.h>
 
@@ -40,6 +43,14 @@
 static LIST_HEAD(dvfs_rail_list);
 static DEFINE_MUTEX(dvfs_lock);
 
+/*
+ * Clocks whose rate has already dropped, but whose lower voltage has not
+ * been applied yet because someone else held dvfs_lock.  Whoever holds
+ * dvfs_lock applies them before releasing it.
+ */
+static LIST_HEAD(dvfs_pending_list);
+static DEFINE_SPINLOCK(dvfs_pending_lock);
+
 static int dvfs_rail_update(struct dvfs_rail *rail);
 
 void tegra_dvfs_add_relationships(struct dvfs_relationship *rels, int n)
@@ -127,9 +138,15 @@ static int dvfs_rail_set_voltage(struct dvfs_rail *rail, int millivolts)
 		}
 
 		if (!rail->disabled) {
+			ktime_t start = ktime_get();
+
 			ret = regulator_set_voltage(rail->reg,
 				rail->new_millivolts * 1000,
 				rail->max_millivolts * 1000);
+
+			rail->transitions++;
+			rail->regulator_time_us +=
+				ktime_to_us(ktime_sub(ktime_get(), start));
 		}
 		if (ret) {
 			pr_err("Failed to set dvfs regulator %s\n", rail->reg_id);
@@ -158,6 +175,15 @@ static int dvfs_rail_set_voltage(struct dvfs_rail *rail, int millivolts)
 	return ret;
 }
 
+/* Voltage the rail supplies for a clock request of @millivolts */
+static int dvfs_rail_clk_target(struct dvfs_rail *rail, int millivolts)
+{
+	if (!millivolts)
+		return 0;
+
+	return max(millivolts + rail->offset_millivolts, rail->min_millivolts);
+}
+
 /* Determine the minimum valid voltage for a rail, taking into account
  * the dvfs clocks and any rails that this rail depends on.  Calls
  * dvfs_rail_set_voltage with the new voltage, which will call
@@ -169,6 +195,12 @@ static int dvfs_rail_update(struct dvfs_rail *rail)
 	struct dvfs_relationship *rel;
 	int ret = 0;
 
+	/* Find the maximum voltage requested by any clock */
+	list_for_each_entry(d, &rail->dvfs, reg_node)
+		millivolts = max(d->cur_millivolts, millivolts);
+
+	rail->clk_millivolts = millivolts;
+
 	/* if dvfs is suspended, return and handle it during resume */
 	if (rail->suspended)
 		return 0;
@@ -177,11 +209,7 @@ static int dvfs_rail_update(struct dvfs_rail *rail)
 	if (!rail->reg)
 		return 0;
 
-	/* Find the maximum voltage requested by any clock */
-	list_for_each_entry(d, &rail->dvfs, reg_node)
-		millivolts = max(d->cur_millivolts, millivolts);
-
-	rail->new_millivolts = millivolts;
+	rail->new_millivolts = dvfs_rail_clk_target(rail, millivolts);
 
 	/* Check any rails that this rail depends on */
 	list_for_each_entry(rel, &rail->relationships_from, from_node)
@@ -208,11 +236,9 @@ static int dvfs_rail_connect_to_regulator(struct dvfs_rail *rail)
 	return 0;
 }
 
-static int
-__tegra_dvfs_set_rate(struct dvfs *d, unsigned long rate)
+static int dvfs_rate_to_millivolts(struct dvfs *d, unsigned long rate)
 {
 	int i = 0;
-	int ret;
 
 	if (d->freqs == NULL || d->millivolts == NULL)
 		return -ENODEV;
@@ -223,17 +249,54 @@ __tegra_dvfs_set_rate(struct dvfs *d, unsigned long rate)
 		return -EINVAL;
 	}
 
-	if (rate == 0) {
-		d->cur_millivolts = 0;
-	} else {
-		while (i < d->num_freqs && rate > d->freqs[i])
-			i++;
+	if (rate == 0)
+		return 0;
 
-		d->cur_millivolts = d->millivolts[i];
-	}
+	while (i < d->num_freqs && rate > d->freqs[i])
+		i++;
 
+	return d->millivolts[i];
+}
+
+/*
+ * Whether moving clock d from old_millivolts to millivolts can change
+ * the highest voltage any clock on its rail asks for.  Must be called
+ * with dvfs_lock held, rail->clk_millivolts is only updated under it.
+ */
+static bool dvfs_rail_needs_update(struct dvfs *d, int old_millivolts,
+	int millivolts)
+{
+	struct dvfs_rail *rail = d->dvfs_rail;
+
+	if (millivolts == old_millivolts)
+		return false;
+
+	/* Another clock is still holding the rail at or above this one */
+	if (millivolts < old_millivolts)
+		return old_millivolts >= rail->clk_millivolts;
+
+	/* The rail already supplies the higher voltage */
+	return millivolts > rail->clk_millivolts ||
+		dvfs_rail_clk_target(rail, millivolts) > rail->millivolts;
+}
+
+/* Must be called with dvfs_lock held */
+static int
+__tegra_dvfs_set_rate(struct dvfs *d, int millivolts, unsigned long rate)
+{
+	int old_millivolts = d->cur_millivolts;
+	int ret;
+
+	d->cur_millivolts = millivolts;
 	d->cur_rate = rate;
 
+	if (!dvfs_rail_needs_update(d, old_millivolts, millivolts)) {
+		spin_lock(&dvfs_pending_lock);
+		d->dvfs_rail->skipped++;
+		spin_unlock(&dvfs_pending_lock);
+		return 0;
+	}
+
 	ret = dvfs_rail_update(d->dvfs_rail);
 	if (ret)
 		pr_err("Failed to set regulator %s for clock %s to %d mV\n",
@@ -242,16 +305,132 @@ __tegra_dvfs_set_rate(struct dvfs *d, unsigned long rate)
 	return ret;
 }
 
+/* Must be called with dvfs_lock held */
+static void dvfs_apply_pending(void)
+{
+	struct dvfs *d;
+	struct dvfs_rail *rail;
+	int old_millivolts;
+
+	spin_lock(&dvfs_pending_lock);
+	while (!list_empty(&dvfs_pending_list)) {
+		d = list_first_entry(&dvfs_pending_list, struct dvfs,
+			pending_node);
+		list_del_init(&d->pending_node);
+
+		old_millivolts = d->cur_millivolts;
+		d->cur_millivolts = d->pending_millivolts;
+		d->cur_rate = d->pending_rate;
+
+		if (dvfs_rail_needs_update(d, old_millivolts,
+					   d->cur_millivolts))
+			d->dvfs_rail->update_pending = true;
+		else
+			d->dvfs_rail->skipped++;
+	}
+	spin_unlock(&dvfs_pending_lock);
+
+	/* One pass per rail, however many of its clocks were lowered */
+	list_for_each_entry(rail, &dvfs_rail_list, node) {
+		if (!rail->update_pending)
+			continue;
+		rail->update_pending = false;
+		if (dvfs_rail_update(rail))
+			pr_err("Failed to lower regulator %s\n", rail->reg_id);
+	}
+}
+
+static bool dvfs_has_pending(void)
+{
+	bool pending;
+
+	spin_lock(&dvfs_pending_lock);
+	pending = !list_empty(&dvfs_pending_list);
+	spin_unlock(&dvfs_pending_lock);
+
+	return pending;
+}
+
+static void dvfs_unlock(void)
+{
+	/*
+	 * A request queued after the last dvfs_apply_pending() but before
+	 * the unlock saw dvfs_lock held and left it to us.  Look again
+	 * after the unlock so it is never stranded.
+	 */
+	do {
+		dvfs_apply_pending();
+		mutex_unlock(&dvfs_lock);
+	} while (dvfs_has_pending() && mutex_trylock(&dvfs_lock));
+}
+
+#define DVFS_RAISE	0
+#define DVFS_UNCHANGED	1
+#define DVFS_QUEUED	2
+
+/*
+ * A request that does not need more voltage than the clock already has
+ * never has to wait for the regulator: the clock has already been
+ * lowered, so the lower voltage can be applied by whoever holds
+ * dvfs_lock next, together with any other clocks lowered meanwhile.
+ */
+static int dvfs_queue_lower(struct dvfs *d, int millivolts,
+	unsigned long rate)
+{
+	int ret;
+
+	spin_lock(&dvfs_pending_lock);
+	if (millivolts > d->cur_millivolts) {
+		ret = DVFS_RAISE;
+	} else if (millivolts == d->cur_millivolts &&
+		   list_empty(&d->pending_node)) {
+		d->cur_rate = rate;
+		d->dvfs_rail->skipped++;
+		ret = DVFS_UNCHANGED;
+	} else {
+		d->pending_millivolts = millivolts;
+		d->pending_rate = rate;
+		if (list_empty(&d->pending_node))
+			list_add_tail(&d->pending_node, &dvfs_pending_list);
+		ret = DVFS_QUEUED;
+	}
+	spin_unlock(&dvfs_pending_lock);
+
+	return ret;
+}
+
 int tegra_dvfs_set_rate(struct clk *c, unsigned long rate)
 {
+	struct dvfs *d = c->dvfs;
+	int millivolts;
 	int ret;
 
-	if (!c->dvfs)
+	if (!d)
 		return -EINVAL;
 
+	millivolts = dvfs_rate_to_millivolts(d, rate);
+	if (millivolts < 0)
+		return millivolts;
+
+	switch (dvfs_queue_lower(d, millivolts, rate)) {
+	case DVFS_UNCHANGED:
+		return 0;
+	case DVFS_QUEUED:
+		if (mutex_trylock(&dvfs_lock)) {
+			dvfs_unlock();
+		} else {
+			spin_lock(&dvfs_pending_lock);
+			d->dvfs_rail->deferred++;
+			spin_unlock(&dvfs_pending_lock);
+		}
+		return 0;
+	}
+
 	mutex_lock(&dvfs_lock);
-	ret = __tegra_dvfs_set_rate(c->dvfs, rate);
-	mutex_unlock(&dvfs_lock);
+	/* Older lowered rates, this clock's included, go first */
+	dvfs_apply_pending();
+	ret = __tegra_dvfs_set_rate(d, millivolts, rate);
+	dvfs_unlock();
 
 	return ret;
 }
@@ -288,10 +467,11 @@ int __init tegra_enable_dvfs_on_clk(struct clk *c, struct dvfs *d)
 	}
 
 	c->dvfs = d;
+	INIT_LIST_HEAD(&d->pending_node);
 
 	mutex_lock(&dvfs_lock);
 	list_add_tail(&d->reg_node, &d->dvfs_rail->dvfs);
-	mutex_unlock(&dvfs_lock);
+	dvfs_unlock();
 
 	return 0;
 }
@@ -352,7 +532,7 @@ static void tegra_dvfs_resume(void)
 	list_for_each_entry(rail, &dvfs_rail_list, node)
 		dvfs_rail_update(rail);
 
-	mutex_unlock(&dvfs_lock);
+	dvfs_unlock();
 }
 
 static int tegra_dvfs_suspend(void)
@@ -367,7 +547,7 @@ static int tegra_dvfs_suspend(void)
 			break;
 	}
 
-	mutex_unlock(&dvfs_lock);
+	dvfs_unlock();
 
 	if (ret)
 		tegra_dvfs_resume();
@@ -423,14 +603,26 @@ void tegra_dvfs_rail_enable(struct dvfs_rail *rail)
 {
 	mutex_lock(&dvfs_lock);
 	__tegra_dvfs_rail_enable(rail);
-	mutex_unlock(&dvfs_lock);
+	dvfs_unlock();
 }
 
 void tegra_dvfs_rail_disable(struct dvfs_rail *rail)
 {
 	mutex_lock(&dvfs_lock);
 	__tegra_dvfs_rail_disable(rail);
-	mutex_unlock(&dvfs_lock);
+	dvfs_unlock();
+}
+
+/*
+ * Lowers the voltage of every clock on the rail by -@millivolts, down to
+ * the rail minimum.  Relationships with other rails still apply.
+ */
+void tegra_dvfs_rail_set_offset(struct dvfs_rail *rail, int millivolts)
+{
+	mutex_lock(&dvfs_lock);
+	rail->offset_millivolts = min(millivolts, 0);
+	dvfs_rail_update(rail);
+	dvfs_unlock();
 }
 
 int tegra_dvfs_rail_disable_by_name(const char *reg_id)
@@ -449,7 +641,7 @@ int tegra_dvfs_rail_disable_by_name(const char *reg_id)
 	ret = -EINVAL;
 
 out:
-	mutex_unlock(&dvfs_lock);
+	dvfs_unlock();
 	return ret;
 }
 
@@ -470,7 +662,7 @@ int __init tegra_dvfs_late_init(void)
 	list_for_each_entry(rail, &dvfs_rail_list, node)
 		dvfs_rail_update(rail);
 
-	mutex_unlock(&dvfs_lock);
+	dvfs_unlock();
 
 	register_pm_notifier(&tegra_dvfs_nb);
 
@@ -508,8 +700,13 @@ static int dvfs_tree_show(struct seq_file *s, void *data)
 	mutex_lock(&dvfs_lock);
 
 	list_for_each_entry(rail, &dvfs_rail_list, node) {
-		seq_printf(s, "%s %d mV%s:\n", rail->reg_id,
-			rail->millivolts, rail->disabled ? " disabled" : "");
+		seq_printf(s, "%s %d mV (margin %d mV)%s:\n", rail->reg_id,
+			rail->millivolts, rail->offset_millivolts,
+			rail->disabled ? " disabled" : "");
+		seq_printf(s, "   transitions %u (%llu us in regulator), "
+			"skipped %u, deferred %u\n", rail->transitions,
+			rail->regulator_time_us, rail->skipped,
+			rail->deferred);
 		list_for_each_entry(rel, &rail->relationships_from, from_node) {
 			seq_printf(s, "   %-10s %-7d mV %-4d mV\n",
 				rel->from->reg_id,
@@ -525,7 +722,7 @@ static int dvfs_tree_show(struct seq_file *s, void *data)
 		}
 	}
 
-	mutex_unlock(&dvfs_lock);
+	dvfs_unlock();
 
 	return 0;
 }
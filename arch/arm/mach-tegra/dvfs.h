@@ -48,6 +48,9 @@ struct dvfs_rail {
 	int step;
 	bool disabled;
 
+	/* added to what the clocks ask for, <= 0, see tegra_dvfs_rail_set_offset */
+	int offset_millivolts;
+
 	struct list_head node;  /* node in dvfs_rail_list */
 	struct list_head dvfs;  /* list head of attached dvfs clocks */
 	struct list_head relationships_to;
@@ -56,6 +59,17 @@ struct dvfs_rail {
 	int millivolts;
 	int new_millivolts;
 	bool suspended;
+
+	/* Highest voltage requested by the clocks on this rail */
+	int clk_millivolts;
+	bool update_pending;
+
+	/* transitions and regulator_time_us are protected by dvfs_lock,
+	 * skipped and deferred by dvfs_pending_lock */
+	unsigned int transitions;
+	u64 regulator_time_us;
+	unsigned int skipped;
+	unsigned int deferred;
 };
 
 struct dvfs {
@@ -80,6 +94,11 @@ struct dvfs {
 	struct list_head node;
 	struct list_head debug_node;
 	struct list_head reg_node;
+
+	/* Lowered rate waiting for dvfs_lock, see tegra_dvfs_set_rate */
+	int pending_millivolts;
+	unsigned long pending_rate;
+	struct list_head pending_node;
 };
 
 void tegra2_init_dvfs(void);
@@ -90,5 +109,6 @@ int tegra_dvfs_init_rails(struct dvfs_rail *dvfs_rails[], int n);
 void tegra_dvfs_add_relationships(struct dvfs_relationship *rels, int n);
 void tegra_dvfs_rail_enable(struct dvfs_rail *rail);
 void tegra_dvfs_rail_disable(struct dvfs_rail *rail);
+void tegra_dvfs_rail_set_offset(struct dvfs_rail *rail, int millivolts);
 
 #endif
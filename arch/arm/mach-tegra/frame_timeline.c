@@ -0,0 +1,470 @@
+/*
+ * arch/arm/mach-tegra/frame_timeline.c
+ *
+ * Frame timeline recorder.  nvhost logs submits and syncpoint completions,
+ * the display flip queues log when a flip is queued and programmed, and
+ * the display interrupt logs the vblank that latched it.  Events go to a
+ * per-CPU ring that userspace maps read-only, so logging is a few stores
+ * with interrupts off and readers never slow the writers down.
+ *
+ * When a frame latches later than the vblank it could have made, the
+ * reason is worked out from the same events and counted, see
+ * ftl_classify().
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/math64.h>
+
+#include <mach/dc.h>
+#include <mach/frame_timeline.h>
+
+#define FTL_RING_PAGES		16
+#define FTL_NR_SYNCPTS		32
+#define FTL_PENDING		16	/* submits in flight per syncpt */
+#define FTL_DONE_HIST		8	/* completions kept per syncpt */
+#define FTL_FRAMES		8	/* flips in flight per dc */
+
+static bool enable = true;
+module_param(enable, bool, 0644);
+
+struct ftl_ring {
+	struct tegra_ftl_ring_hdr *hdr;
+	struct tegra_ftl_event *events;
+};
+
+static DEFINE_PER_CPU(struct ftl_ring, ftl_rings);
+
+struct ftl_syncpt {
+	u32 pending[FTL_PENDING];
+	u8 pending_ch[FTL_PENDING];
+	unsigned int npending;
+	u32 done_val[FTL_DONE_HIST];
+	ktime_t done_ts[FTL_DONE_HIST];
+	unsigned int done_idx;
+};
+
+struct ftl_frame {
+	u32 frame;
+	u32 fence_id;
+	u32 fence_val;
+	ktime_t queued;
+	ktime_t programmed;
+};
+
+struct ftl_dc {
+	struct ftl_frame frames[FTL_FRAMES];
+	u32 programmed;
+	bool has_programmed;
+	ktime_t last_latch;
+	u32 frame_ns;
+	u32 blank_ns;
+	unsigned long latched;
+	unsigned long missed[TEGRA_FTL_MISS_COUNT];
+};
+
+static DEFINE_SPINLOCK(ftl_lock);
+static struct ftl_syncpt ftl_syncpts[FTL_NR_SYNCPTS];
+static struct ftl_dc ftl_dcs[TEGRA_MAX_DC];
+static ktime_t ftl_emc_start, ftl_emc_end;
+
+static const char *ftl_miss_names[TEGRA_FTL_MISS_COUNT] = {
+	[TEGRA_FTL_MISS_GPU]	= "gpu late",
+	[TEGRA_FTL_MISS_EMC]	= "emc switch",
+	[TEGRA_FTL_MISS_WORKER]	= "flip worker late",
+	[TEGRA_FTL_MISS_OTHER]	= "other",
+};
+
+static void ftl_log(u16 type, u16 id, u32 val, u32 arg, u32 arg2, ktime_t ts)
+{
+	struct tegra_ftl_event *e;
+	struct ftl_ring *ring;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	ring = &__get_cpu_var(ftl_rings);
+	if (ring->hdr) {
+		e = &ring->events[ring->hdr->head % ring->hdr->nr_events];
+		e->ts_ns = ktime_to_ns(ts);
+		e->type = type;
+		e->id = id;
+		e->val = val;
+		e->arg = arg;
+		e->arg2 = arg2;
+		smp_wmb();
+		ring->hdr->head++;
+	}
+	local_irq_restore(flags);
+}
+
+static inline bool ftl_reached(u32 val, u32 thresh)
+{
+	return (s32)(val - thresh) >= 0;
+}
+
+void tegra_ftl_submit(u32 chid, u32 syncpt_id, u32 thresh)
+{
+	ktime_t now = ktime_get();
+	struct ftl_syncpt *sp;
+	unsigned long flags;
+
+	if (!enable || syncpt_id >= FTL_NR_SYNCPTS)
+		return;
+
+	ftl_log(TEGRA_FTL_SUBMIT, syncpt_id, thresh, chid, 0, now);
+
+	spin_lock_irqsave(&ftl_lock, flags);
+	sp = &ftl_syncpts[syncpt_id];
+	/* nothing ahead of it, the channel starts on it right away */
+	if (!sp->npending)
+		ftl_log(TEGRA_FTL_GPU_START, syncpt_id, thresh, chid, 0, now);
+	if (sp->npending < FTL_PENDING) {
+		sp->pending[sp->npending] = thresh;
+		sp->pending_ch[sp->npending] = chid;
+		sp->npending++;
+	}
+	spin_unlock_irqrestore(&ftl_lock, flags);
+}
+
+void tegra_ftl_syncpt_done(u32 syncpt_id, u32 val, ktime_t ts)
+{
+	struct ftl_syncpt *sp;
+	unsigned long flags;
+	unsigned int n;
+
+	if (!enable || syncpt_id >= FTL_NR_SYNCPTS)
+		return;
+
+	ftl_log(TEGRA_FTL_GPU_END, syncpt_id, val, 0, 0, ts);
+
+	spin_lock_irqsave(&ftl_lock, flags);
+	sp = &ftl_syncpts[syncpt_id];
+
+	for (n = 0; n < sp->npending && ftl_reached(val, sp->pending[n]); n++)
+		;
+	if (n) {
+		sp->npending -= n;
+		memmove(sp->pending, sp->pending + n,
+			sp->npending * sizeof(sp->pending[0]));
+		memmove(sp->pending_ch, sp->pending_ch + n,
+			sp->npending * sizeof(sp->pending_ch[0]));
+		/* the next submit starts when the previous one ends */
+		if (sp->npending)
+			ftl_log(TEGRA_FTL_GPU_START, syncpt_id, sp->pending[0],
+				sp->pending_ch[0], 0, ts);
+	}
+
+	sp->done_val[sp->done_idx] = val;
+	sp->done_ts[sp->done_idx] = ts;
+	sp->done_idx = (sp->done_idx + 1) % FTL_DONE_HIST;
+	spin_unlock_irqrestore(&ftl_lock, flags);
+}
+
+/* earliest completion we saw that reached val, or 0 if not recorded */
+static s64 ftl_fence_done(u32 syncpt_id, u32 val)
+{
+	struct ftl_syncpt *sp;
+	s64 best = 0;
+	int i;
+
+	if (syncpt_id >= FTL_NR_SYNCPTS)
+		return 0;
+
+	sp = &ftl_syncpts[syncpt_id];
+	for (i = 0; i < FTL_DONE_HIST; i++) {
+		s64 ts = ktime_to_ns(sp->done_ts[i]);
+
+		if (ts && ftl_reached(sp->done_val[i], val) &&
+		    (!best || ts < best))
+			best = ts;
+	}
+
+	return best;
+}
+
+void tegra_ftl_flip_queued(int dc, u32 frame, u32 fence_id, u32 fence_val)
+{
+	ktime_t now = ktime_get();
+	struct ftl_frame *f;
+	unsigned long flags;
+
+	if (!enable || dc < 0 || dc >= TEGRA_MAX_DC)
+		return;
+
+	ftl_log(TEGRA_FTL_FLIP_QUEUED, dc, frame, fence_val, fence_id, now);
+
+	spin_lock_irqsave(&ftl_lock, flags);
+	f = &ftl_dcs[dc].frames[frame % FTL_FRAMES];
+	f->frame = frame;
+	f->fence_id = fence_id;
+	f->fence_val = fence_val;
+	f->queued = now;
+	f->programmed = ktime_set(0, 0);
+	spin_unlock_irqrestore(&ftl_lock, flags);
+}
+
+void tegra_ftl_flip_programmed(int dc, u32 frame)
+{
+	ktime_t now = ktime_get();
+	struct ftl_frame *f;
+	unsigned long flags;
+
+	if (!enable || dc < 0 || dc >= TEGRA_MAX_DC)
+		return;
+
+	ftl_log(TEGRA_FTL_FLIP_PROGRAMMED, dc, frame, 0, 0, now);
+
+	spin_lock_irqsave(&ftl_lock, flags);
+	f = &ftl_dcs[dc].frames[frame % FTL_FRAMES];
+	if (f->frame == frame)
+		f->programmed = now;
+	ftl_dcs[dc].programmed = frame;
+	ftl_dcs[dc].has_programmed = true;
+	spin_unlock_irqrestore(&ftl_lock, flags);
+}
+
+/*
+ * A frame could have latched at the first frame end after it was queued,
+ * but no sooner than one frame after the previous latch.  If it latched
+ * more than half a frame after that, find out why: its fence signaled too
+ * late, an EMC switch stalled the display while the frame was queued, or
+ * the flip worker only programmed it after that frame end.
+ */
+static void ftl_classify(int dc, struct ftl_dc *d, struct ftl_frame *f,
+			 ktime_t ts)
+{
+	s64 period = d->frame_ns;
+	s64 last = ktime_to_ns(d->last_latch);
+	s64 queued = ktime_to_ns(f->queued);
+	s64 latched = ktime_to_ns(ts);
+	s64 expected, fence;
+	int reason;
+
+	d->latched++;
+	if (!period || !last || !queued)
+		return;
+
+	/* too long since the last latch to know where the frame ends fall */
+	if (queued - last > 64 * period)
+		last = queued;
+
+	expected = last + period;
+	if (queued > last) {
+		s64 next = last + div64_u64(queued - last + period - 1,
+					    period) * period;
+		expected = max(expected, next);
+	}
+	if (latched <= expected + period / 2)
+		return;
+
+	fence = ftl_fence_done(f->fence_id, f->fence_val);
+	if (fence > expected)
+		reason = TEGRA_FTL_MISS_GPU;
+	else if (ktime_to_ns(ftl_emc_end) >= queued &&
+		 ktime_to_ns(ftl_emc_start) <= latched)
+		reason = TEGRA_FTL_MISS_EMC;
+	else if (ktime_to_ns(f->programmed) > expected)
+		reason = TEGRA_FTL_MISS_WORKER;
+	else
+		reason = TEGRA_FTL_MISS_OTHER;
+
+	d->missed[reason]++;
+	ftl_log(TEGRA_FTL_FRAME_MISSED, dc, f->frame, reason,
+		div_s64(latched - expected, NSEC_PER_USEC), ts);
+}
+
+void tegra_ftl_flip_latched(int dc, ktime_t ts)
+{
+	struct ftl_frame *f;
+	struct ftl_dc *d;
+	unsigned long flags;
+
+	if (!enable || dc < 0 || dc >= TEGRA_MAX_DC)
+		return;
+
+	spin_lock_irqsave(&ftl_lock, flags);
+	d = &ftl_dcs[dc];
+	if (d->has_programmed) {
+		d->has_programmed = false;
+		f = &d->frames[d->programmed % FTL_FRAMES];
+
+		ftl_log(TEGRA_FTL_FLIP_LATCHED, dc, d->programmed, 0, 0, ts);
+		ftl_log(TEGRA_FTL_SCANOUT, dc, d->programmed, 0, 0,
+			ktime_add_ns(ts, d->blank_ns));
+		if (f->frame == d->programmed)
+			ftl_classify(dc, d, f, ts);
+	}
+	d->last_latch = ts;
+	spin_unlock_irqrestore(&ftl_lock, flags);
+}
+
+void tegra_ftl_dc_mode(int dc, u32 frame_ns, u32 blank_ns)
+{
+	unsigned long flags;
+
+	if (dc < 0 || dc >= TEGRA_MAX_DC)
+		return;
+
+	spin_lock_irqsave(&ftl_lock, flags);
+	ftl_dcs[dc].frame_ns = frame_ns;
+	ftl_dcs[dc].blank_ns = blank_ns;
+	ftl_dcs[dc].last_latch = ktime_set(0, 0);
+	spin_unlock_irqrestore(&ftl_lock, flags);
+}
+
+void tegra_ftl_emc_switch(ktime_t start, ktime_t end)
+{
+	unsigned long flags;
+
+	if (!enable)
+		return;
+
+	ftl_log(TEGRA_FTL_EMC_SWITCH, 0, 0,
+		div_s64(ktime_to_ns(ktime_sub(end, start)), NSEC_PER_USEC), 0,
+		start);
+
+	spin_lock_irqsave(&ftl_lock, flags);
+	ftl_emc_start = start;
+	ftl_emc_end = end;
+	spin_unlock_irqrestore(&ftl_lock, flags);
+}
+
+static int ftl_ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct ftl_ring *ring = file->private_data;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, ring->hdr, vma->vm_pgoff);
+}
+
+static int ftl_ring_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static const struct file_operations ftl_ring_fops = {
+	.open		= ftl_ring_open,
+	.mmap		= ftl_ring_mmap,
+};
+
+static int ftl_frames_show(struct seq_file *s, void *data)
+{
+	struct ftl_dc d;
+	unsigned long flags;
+	int i, j;
+
+	for (i = 0; i < TEGRA_MAX_DC; i++) {
+		spin_lock_irqsave(&ftl_lock, flags);
+		d = ftl_dcs[i];
+		spin_unlock_irqrestore(&ftl_lock, flags);
+
+		if (!d.frame_ns)
+			continue;
+
+		seq_printf(s, "dc%d: frame %u us, blank %u us, %lu latched\n",
+			   i, d.frame_ns / NSEC_PER_USEC,
+			   d.blank_ns / NSEC_PER_USEC, d.latched);
+		for (j = 0; j < TEGRA_FTL_MISS_COUNT; j++)
+			seq_printf(s, "  missed (%s): %lu\n",
+				   ftl_miss_names[j], d.missed[j]);
+	}
+
+	return 0;
+}
+
+static int ftl_frames_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ftl_frames_show, inode->i_private);
+}
+
+static const struct file_operations ftl_frames_fops = {
+	.open		= ftl_frames_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_ftl_init(void)
+{
+	unsigned int nr = (FTL_RING_PAGES * PAGE_SIZE) /
+			  sizeof(struct tegra_ftl_event);
+	struct dentry *dir;
+	char name[16];
+	int cpu;
+
+	/* allocate every ring before any of them is used */
+	for_each_possible_cpu(cpu) {
+		struct ftl_ring *ring = &per_cpu(ftl_rings, cpu);
+		struct tegra_ftl_ring_hdr *hdr;
+
+		hdr = vmalloc_user((FTL_RING_PAGES + 1) * PAGE_SIZE);
+		if (!hdr)
+			goto err_alloc;
+		hdr->nr_events = nr;
+		hdr->event_size = sizeof(struct tegra_ftl_event);
+		ring->events = (void *)hdr + PAGE_SIZE;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct ftl_ring *ring = &per_cpu(ftl_rings, cpu);
+
+		smp_wmb();
+		ring->hdr = (void *)ring->events - PAGE_SIZE;
+	}
+
+	dir = debugfs_create_dir("frame_timeline", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("frames", S_IRUGO, dir, NULL,
+				 &ftl_frames_fops))
+		goto err_debugfs;
+
+	for_each_possible_cpu(cpu) {
+		snprintf(name, sizeof(name), "cpu%d", cpu);
+		if (!debugfs_create_file(name, S_IRUSR, dir,
+					 &per_cpu(ftl_rings, cpu),
+					 &ftl_ring_fops))
+			goto err_debugfs;
+	}
+
+	return 0;
+
+err_debugfs:
+	/* the rings stay, they are already being written to */
+	debugfs_remove_recursive(dir);
+	return -ENOMEM;
+
+err_alloc:
+	for_each_possible_cpu(cpu) {
+		struct ftl_ring *ring = &per_cpu(ftl_rings, cpu);
+
+		if (ring->events)
+			vfree((void *)ring->events - PAGE_SIZE);
+		ring->events = NULL;
+	}
+	return -ENOMEM;
+}
+late_initcall(tegra_ftl_init);
@@ -80,6 +80,14 @@ unsigned int tegra_spare_fuse(int bit)
 	return tegra_fuse_readl(FUSE_SPARE_BIT + bit * 4);
 }
 
+/* reads spare fuse bits first to first + count - 1 in one go */
+void tegra_spare_fuses(int first, int count, u32 *bits)
+{
+	BUG_ON(first < 0 || count < 0 || first + count > 62);
+	tegra_apb_readl_array(TEGRA_FUSE_BASE + FUSE_SPARE_BIT + first * 4,
+			      bits, count, false);
+}
+
 int tegra_sku_id(void)
 {
 	int sku_id;
@@ -27,10 +27,13 @@ enum tegra_revision {
 
 unsigned long long tegra_chip_uid(void);
 unsigned int tegra_spare_fuse(int bit);
+void tegra_spare_fuses(int first, int count, u32 *bits);
 int tegra_sku_id(void);
 int tegra_cpu_process_id(void);
 int tegra_core_process_id(void);
 int tegra_soc_speedo_id(void);
+int tegra_cpu_sub_corner(void);
+int tegra_core_sub_corner(void);
 void tegra_init_fuse(void);
 void tegra_init_speedo_data(void);
 u32 tegra_fuse_readl(unsigned long offset);
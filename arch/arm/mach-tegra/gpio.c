@@ -20,6 +20,7 @@
 #include <linux/init.h>
 #include <linux/irq.h>
 #include <linux/interrupt.h>
+#include <linux/sched.h>
 
 #include <linux/io.h>
 #include <linux/gpio.h>
@@ -58,10 +59,23 @@
 #define GPIO_INT_LVL_LEVEL_HIGH		0x000001
 #define GPIO_INT_LVL_LEVEL_LOW		0x000000
 
+#ifdef CONFIG_DEBUG_FS
+struct tegra_gpio_irq_stats {
+	u32 count;
+	u32 max_ns;
+	u64 total_ns;
+};
+#endif
+
 struct tegra_gpio_bank {
 	int bank;
 	int irq;
 	spinlock_t lvl_lock[4];
+	u8 edge[4];		/* edge triggered pins, mirrors INT_LVL */
+#ifdef CONFIG_DEBUG_FS
+	u32 irqs;
+	struct tegra_gpio_irq_stats stats[32];
+#endif
 #ifdef CONFIG_PM
 	u32 cnf[4];
 	u32 out[4];
@@ -143,13 +157,6 @@ static struct gpio_chip tegra_gpio_chip = {
 	.ngpio			= TEGRA_NR_GPIOS,
 };
 
-static void tegra_gpio_irq_ack(unsigned int irq)
-{
-	int gpio = irq - INT_GPIO_BASE;
-
-	__raw_writel(1 << GPIO_BIT(gpio), GPIO_INT_CLR(gpio));
-}
-
 static void tegra_gpio_irq_mask(unsigned int irq)
 {
 	int gpio = irq - INT_GPIO_BASE;
@@ -205,6 +212,11 @@ static int tegra_gpio_irq_set_type(unsigned int irq, unsigned int type)
 	val |= lvl_type << GPIO_BIT(gpio);
 	__raw_writel(val, GPIO_INT_LVL(gpio));
 
+	if (lvl_type & 0x100)
+		bank->edge[port] |= 1 << GPIO_BIT(gpio);
+	else
+		bank->edge[port] &= ~(1 << GPIO_BIT(gpio));
+
 	spin_unlock_irqrestore(&bank->lvl_lock[port], flags);
 
 	if (type & (IRQ_TYPE_LEVEL_LOW | IRQ_TYPE_LEVEL_HIGH))
@@ -218,12 +230,46 @@ static int tegra_gpio_irq_set_type(unsigned int irq, unsigned int type)
 	return 0;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static unsigned long tegra_gpio_stats_start;
+
+static inline void tegra_gpio_handle_pin(struct tegra_gpio_bank *bank,
+	int gpio)
+{
+	struct tegra_gpio_irq_stats *stats = &bank->stats[gpio & 0x1f];
+	u64 start = sched_clock();
+	u32 ns;
+
+	generic_handle_irq(gpio_to_irq(gpio));
+
+	ns = sched_clock() - start;
+	stats->count++;
+	stats->total_ns += ns;
+	if (ns > stats->max_ns)
+		stats->max_ns = ns;
+	bank->irqs++;
+}
+#else
+static inline void tegra_gpio_handle_pin(struct tegra_gpio_bank *bank,
+	int gpio)
+{
+	generic_handle_irq(gpio_to_irq(gpio));
+}
+#endif
+
+/*
+ * Every pending pin of the bank is cleared with one write per port
+ * before any handler runs, so the per-pin flow handlers have nothing
+ * left to ack. Edge or level comes from bank->edge instead of reading
+ * INT_LVL back on every interrupt.
+ */
 static void tegra_gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 {
 	struct tegra_gpio_bank *bank;
+	unsigned long sta[4];
+	unsigned long edge = 0;
 	int port;
 	int pin;
-	int unmasked = 0;
 
 	desc->chip->ack(irq);
 
@@ -231,29 +277,29 @@ static void tegra_gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 
 	for (port = 0; port < 4; port++) {
 		int gpio = tegra_gpio_compose(bank->bank, port, 0);
-		unsigned long sta = __raw_readl(GPIO_INT_STA(gpio)) &
+
+		sta[port] = __raw_readl(GPIO_INT_STA(gpio)) &
 			__raw_readl(GPIO_INT_ENB(gpio));
-		u32 lvl = __raw_readl(GPIO_INT_LVL(gpio));
+		if (sta[port])
+			__raw_writel(sta[port], GPIO_INT_CLR(gpio));
+		edge |= sta[port] & bank->edge[port];
+	}
 
-		for_each_set_bit(pin, &sta, 8) {
-			__raw_writel(1 << pin, GPIO_INT_CLR(gpio));
+	/* edge conditions are already cleared, unmask now so that edges
+	 * arriving while the handlers run are not missed
+	 */
+	if (edge)
+		desc->chip->unmask(irq);
 
-			/* if gpio is edge triggered, clear condition
-			 * before executing the hander so that we don't
-			 * miss edges
-			 */
-			if (lvl & (0x100 << pin)) {
-				unmasked = 1;
-				desc->chip->unmask(irq);
-			}
+	for (port = 0; port < 4; port++) {
+		int gpio = tegra_gpio_compose(bank->bank, port, 0);
 
-			generic_handle_irq(gpio_to_irq(gpio + pin));
-		}
+		for_each_set_bit(pin, &sta[port], 8)
+			tegra_gpio_handle_pin(bank, gpio + pin);
 	}
 
-	if (!unmasked)
+	if (!edge)
 		desc->chip->unmask(irq);
-
 }
 
 #ifdef CONFIG_PM
@@ -338,7 +384,6 @@ static int tegra_gpio_wake_enable(unsigned int irq, unsigned int enable)
 
 static struct irq_chip tegra_gpio_irq_chip = {
 	.name		= "GPIO",
-	.ack		= tegra_gpio_irq_ack,
 	.mask		= tegra_gpio_irq_mask,
 	.unmask		= tegra_gpio_irq_unmask,
 	.set_type	= tegra_gpio_irq_set_type,
@@ -363,6 +408,8 @@ static int __init tegra_gpio_init(void)
 		for (j = 0; j < 4; j++) {
 			int gpio = tegra_gpio_compose(i, j, 0);
 			__raw_writel(0x00, GPIO_INT_ENB(gpio));
+			tegra_gpio_banks[i].edge[j] =
+				__raw_readl(GPIO_INT_LVL(gpio)) >> 8;
 		}
 	}
 
@@ -397,6 +444,7 @@ postcore_initcall(tegra_gpio_init);
 
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/math64.h>
 
 static int dbg_gpio_show(struct seq_file *s, void *unused)
 {
@@ -433,10 +481,80 @@ static const struct file_operations debug_fops = {
 	.release	= single_release,
 };
 
+/* per pin interrupt counts and handler times since the last clear */
+static int dbg_gpio_irq_show(struct seq_file *s, void *unused)
+{
+	unsigned int elapsed = jiffies_to_msecs(jiffies -
+		tegra_gpio_stats_start);
+	int i;
+	int j;
+
+	seq_printf(s, "bank  irqs\n");
+	for (i = 0; i < ARRAY_SIZE(tegra_gpio_banks); i++)
+		seq_printf(s, "%4d %10u\n", i, tegra_gpio_banks[i].irqs);
+
+	seq_printf(s, "\ngpio   irq      count   per sec   avg us   max us\n");
+	for (i = 0; i < ARRAY_SIZE(tegra_gpio_banks); i++) {
+		struct tegra_gpio_bank *bank = &tegra_gpio_banks[i];
+
+		for (j = 0; j < ARRAY_SIZE(bank->stats); j++) {
+			struct tegra_gpio_irq_stats *stats = &bank->stats[j];
+			int gpio = (i << 5) | j;
+
+			if (!stats->count)
+				continue;
+			seq_printf(s, "%3d.%d %4d %10u %9llu %8llu %8u\n",
+				gpio / 8, gpio & 7, gpio_to_irq(gpio),
+				stats->count,
+				elapsed ? div_u64((u64)stats->count * 1000,
+					elapsed) : 0,
+				div_u64(div_u64(stats->total_ns, stats->count),
+					1000),
+				stats->max_ns / 1000);
+		}
+	}
+	return 0;
+}
+
+static int dbg_gpio_irq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbg_gpio_irq_show, &inode->i_private);
+}
+
+/* any write clears the statistics */
+static ssize_t dbg_gpio_irq_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+	int i;
+
+	local_irq_save(flags);
+	for (i = 0; i < ARRAY_SIZE(tegra_gpio_banks); i++) {
+		tegra_gpio_banks[i].irqs = 0;
+		memset(tegra_gpio_banks[i].stats, 0,
+			sizeof(tegra_gpio_banks[i].stats));
+	}
+	tegra_gpio_stats_start = jiffies;
+	local_irq_restore(flags);
+
+	return count;
+}
+
+static const struct file_operations debug_irq_fops = {
+	.open		= dbg_gpio_irq_open,
+	.read		= seq_read,
+	.write		= dbg_gpio_irq_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init tegra_gpio_debuginit(void)
 {
+	tegra_gpio_stats_start = jiffies;
 	(void) debugfs_create_file("tegra_gpio", S_IRUGO,
 					NULL, NULL, &debug_fops);
+	(void) debugfs_create_file("tegra_gpio_irq", S_IRUGO | S_IWUSR,
+					NULL, NULL, &debug_irq_fops);
 	return 0;
 }
 late_initcall(tegra_gpio_debuginit);
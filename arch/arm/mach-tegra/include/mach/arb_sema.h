@@ -29,6 +29,9 @@ enum tegra_arb_module {
 
 int tegra_arb_mutex_lock_timeout(enum tegra_arb_module lock, int msecs);
 
+/* Returns -EBUSY instead of waiting if either the CPU or the AVP holds it */
+int tegra_arb_mutex_trylock(enum tegra_arb_module lock);
+
 int tegra_arb_mutex_unlock(enum tegra_arb_module lock);
 
 #endif
@@ -262,6 +262,18 @@ struct tegra_dc_out {
 struct tegra_dc;
 struct nvmap_handle_ref;
 
+/* YUV to RGB coefficients, in the format of the DC_WIN_CSC_* registers */
+struct tegra_dc_csc {
+	unsigned short		yof;
+	unsigned short		kyrgb;
+	unsigned short		kur;
+	unsigned short		kvr;
+	unsigned short		kug;
+	unsigned short		kvg;
+	unsigned short		kub;
+	unsigned short		kvb;
+};
+
 struct tegra_dc_win {
 	u8			idx;
 	u8			fmt;
@@ -284,6 +296,10 @@ struct tegra_dc_win {
 	unsigned		out_h;
 	unsigned		z;
 
+	/* set csc_dirty to load csc with the next update */
+	struct tegra_dc_csc	csc;
+	bool			csc_dirty;
+
 	int			dirty;
 	int			underflows;
 	struct tegra_dc		*dc;
@@ -326,6 +342,22 @@ struct tegra_dc_win {
 #define TEGRA_WIN_FMT_YCbCr422RA	24
 #define TEGRA_WIN_FMT_YUV422RA		25
 
+#define TEGRA_WIN_FMT_RGB_MASK		0x0000f0ff
+#define TEGRA_WIN_FMT_YUV_MASK		0x03ff0000
+
+/* what a window of the display controller can scan out */
+struct tegra_dc_win_caps {
+	u32			formats;	/* BIT(TEGRA_WIN_FMT_*) */
+	u32			flags;
+	unsigned		max_w;
+	unsigned		max_h;
+	unsigned		max_downscale;
+};
+
+#define TEGRA_WIN_CAP_H_FILTER		(1 << 0)
+#define TEGRA_WIN_CAP_V_FILTER		(1 << 1)
+#define TEGRA_WIN_CAP_CSC		(1 << 2)
+
 struct tegra_fb_data {
 	int		win;
 
@@ -349,6 +381,8 @@ struct tegra_dc_platform_data {
 
 struct tegra_dc *tegra_dc_get_dc(unsigned idx);
 struct tegra_dc_win *tegra_dc_get_window(struct tegra_dc *dc, unsigned win);
+const struct tegra_dc_win_caps *tegra_dc_get_window_caps(unsigned win);
+extern const struct tegra_dc_csc tegra_dc_csc_bt601;
 
 void tegra_dc_enable(struct tegra_dc *dc);
 void tegra_dc_disable(struct tegra_dc *dc);
@@ -357,12 +391,23 @@ u32 tegra_dc_get_syncpt_id(const struct tegra_dc *dc);
 u32 tegra_dc_incr_syncpt_max(struct tegra_dc *dc);
 void tegra_dc_incr_syncpt_min(struct tegra_dc *dc, u32 val);
 
+struct tegra_dc_rect {
+	unsigned	x;
+	unsigned	y;
+	unsigned	w;
+	unsigned	h;
+};
+
 /* tegra_dc_update_windows and tegra_dc_sync_windows do not support windows
  * with differenct dcs in one call
  */
 int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n);
+int tegra_dc_update_windows_region(struct tegra_dc_win *windows[], int n,
+				   const struct tegra_dc_rect *damage);
 int tegra_dc_sync_windows(struct tegra_dc_win *windows[], int n);
 
+int tegra_dc_wait_vblank(struct tegra_dc *dc, unsigned long timeout);
+
 int tegra_dc_set_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode);
 
 unsigned tegra_dc_get_out_height(struct tegra_dc *dc);
@@ -22,6 +22,7 @@
 #define __MACH_TEGRA_DMA_H
 
 #include <linux/list.h>
+#include <linux/scatterlist.h>
 
 #if defined(CONFIG_TEGRA_SYSTEM_DMA)
 
@@ -127,10 +128,34 @@ struct tegra_dma_req {
 	unsigned long req_sel;
 	unsigned int size;
 
+	/* Optional scatterlist for the memory side of a one-shot request.
+	 * The list must already be mapped with dma_map_sg(); each segment
+	 * must be word aligned and no larger than TEGRA_DMA_MAX_TRANSFER_SIZE.
+	 * When set, the memory address (dest_addr or source_addr depending
+	 * on to_memory) is taken from the list and size is set by the DMA
+	 * driver to the total length.
+	 *
+	 * The DMA ISR moves the channel on to the next segment as soon as
+	 * one finishes, so the device sees a single request of any length.
+	 */
+	struct scatterlist *sg;
+	unsigned int sg_len;
+
+	/* Called from the DMA ISR context after every segment of a
+	 * scatterlist request except the last one, with bytes_transferred
+	 * covering the segments finished so far. The request is still
+	 * queued and in flight; completion is reported through complete().
+	 */
+	void (*progress)(struct tegra_dma_req *req);
+
 	/* Updated by the DMA driver on the conpletion of the request. */
 	int bytes_transferred;
 	int status;
 
+	/* Segment the DMA is working on, maintained by the DMA driver */
+	struct scatterlist *cur_sg;
+	unsigned int sg_left;
+
 	/* DMA completion tracking information */
 	int buffer_status;
 
@@ -158,6 +183,23 @@ int tegra_dma_cancel(struct tegra_dma_channel *ch);
 
 int __init tegra_dma_init(void);
 
+#if defined(CONFIG_TEGRA_DMAENGINE)
+#include <linux/dmaengine.h>
+
+/* Passed to dma_request_channel() with tegra_dmae_filter; the filter
+ * stores it in dma_chan->private. Peripheral addresses and widths are
+ * set with DMA_SLAVE_CONFIG.
+ */
+struct tegra_dma_slave {
+	unsigned long req_sel;
+};
+
+bool tegra_dmae_filter(struct dma_chan *chan, void *param);
+struct dma_async_tx_descriptor *tegra_dmae_prep_cyclic(struct dma_chan *chan,
+	dma_addr_t buf_addr, size_t buf_len, size_t period_len,
+	enum dma_data_direction direction);
+#endif
+
 #else /* !defined(CONFIG_TEGRA_SYSTEM_DMA) */
 static inline int tegra_dma_init(void)
 {
@@ -0,0 +1,93 @@
+/*
+ * arch/arm/mach-tegra/include/mach/frame_timeline.h
+ *
+ * Per-frame timeline of the graphics stack: GPU submits and completions,
+ * display flips and the vblank that latched them.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __MACH_TEGRA_FRAME_TIMELINE_H
+#define __MACH_TEGRA_FRAME_TIMELINE_H
+
+#include <linux/types.h>
+
+/*
+ * Each CPU logs into its own ring, mmap()ed read-only from debugfs
+ * frame_timeline/cpuN.  The first page holds the header, the events
+ * follow from the second page on.  head counts every event ever logged,
+ * the event is at events[head % nr_events] and is complete once head has
+ * moved past it.
+ */
+struct tegra_ftl_ring_hdr {
+	__u32	head;
+	__u32	nr_events;
+	__u32	event_size;
+	__u32	reserved;
+};
+
+struct tegra_ftl_event {
+	__u64	ts_ns;		/* ktime_get() */
+	__u16	type;
+	__u16	id;		/* syncpt id, or display controller index */
+	__u32	val;		/* syncpt value, or frame (display post syncpt) */
+	__u32	arg;
+	__u32	arg2;
+};
+
+enum {
+	TEGRA_FTL_SUBMIT = 1,	/* id/val: syncpt threshold, arg: channel */
+	TEGRA_FTL_GPU_START,	/* id/val: syncpt threshold, arg: channel */
+	TEGRA_FTL_GPU_END,	/* id/val: syncpt value seen by the irq */
+	TEGRA_FTL_FLIP_QUEUED,	/* id: dc, val: frame, arg/arg2: fence val/id */
+	TEGRA_FTL_FLIP_PROGRAMMED, /* id: dc, val: frame */
+	TEGRA_FTL_FLIP_LATCHED,	/* id: dc, val: frame */
+	TEGRA_FTL_SCANOUT,	/* id: dc, val: frame */
+	TEGRA_FTL_FRAME_MISSED,	/* id: dc, val: frame, arg: reason, arg2: us */
+	TEGRA_FTL_EMC_SWITCH,	/* arg: duration in us */
+};
+
+/* why a frame latched later than the vblank it was queued for */
+enum {
+	TEGRA_FTL_MISS_GPU,	/* its fence signaled after that vblank */
+	TEGRA_FTL_MISS_EMC,	/* an EMC switch ran while it was queued */
+	TEGRA_FTL_MISS_WORKER,	/* the flip worker programmed it too late */
+	TEGRA_FTL_MISS_OTHER,
+	TEGRA_FTL_MISS_COUNT,
+};
+
+#define TEGRA_FTL_NO_FENCE	0xffff
+
+#ifdef __KERNEL__
+#include <linux/ktime.h>
+
+#ifdef CONFIG_TEGRA_FRAME_TIMELINE
+void tegra_ftl_submit(u32 chid, u32 syncpt_id, u32 thresh);
+void tegra_ftl_syncpt_done(u32 syncpt_id, u32 val, ktime_t ts);
+void tegra_ftl_flip_queued(int dc, u32 frame, u32 fence_id, u32 fence_val);
+void tegra_ftl_flip_programmed(int dc, u32 frame);
+void tegra_ftl_flip_latched(int dc, ktime_t ts);
+void tegra_ftl_dc_mode(int dc, u32 frame_ns, u32 blank_ns);
+void tegra_ftl_emc_switch(ktime_t start, ktime_t end);
+#else
+static inline void tegra_ftl_submit(u32 chid, u32 syncpt_id, u32 thresh) { }
+static inline void tegra_ftl_syncpt_done(u32 syncpt_id, u32 val,
+					 ktime_t ts) { }
+static inline void tegra_ftl_flip_queued(int dc, u32 frame, u32 fence_id,
+					 u32 fence_val) { }
+static inline void tegra_ftl_flip_programmed(int dc, u32 frame) { }
+static inline void tegra_ftl_flip_latched(int dc, ktime_t ts) { }
+static inline void tegra_ftl_dc_mode(int dc, u32 frame_ns, u32 blank_ns) { }
+static inline void tegra_ftl_emc_switch(ktime_t start, ktime_t end) { }
+#endif
+#endif
+
+#endif
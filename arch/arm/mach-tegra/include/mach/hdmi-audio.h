@@ -0,0 +1,37 @@
+/*
+ * arch/arm/mach-tegra/include/mach/hdmi-audio.h
+ *
+ * Copyright (C) 2010 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __MACH_TEGRA_HDMI_AUDIO_H
+#define __MACH_TEGRA_HDMI_AUDIO_H
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+
+/* Tell the HDMI output what the S/PDIF source carries, so the audio clock
+ * regeneration and the audio infoframe match it. Takes effect immediately
+ * when HDMI is up, otherwise on the next enable.
+ */
+#ifdef CONFIG_TEGRA_DC
+int tegra_hdmi_setup_audio_format(unsigned audio_freq, bool compressed);
+#else
+static inline int tegra_hdmi_setup_audio_format(unsigned audio_freq,
+		bool compressed)
+{
+	return 0;
+}
+#endif
+
+#endif
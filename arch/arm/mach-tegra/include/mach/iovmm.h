@@ -59,6 +59,7 @@ struct tegra_iovmm_domain {
 	struct rw_semaphore	map_lock;
 	struct rb_root		all_blocks;  /* ordered by address */
 	struct rb_root		free_blocks; /* ordered by size */
+	unsigned int		alloc_failures; /* protected by block_lock */
 	struct tegra_iovmm_device *dev;
 };
 
@@ -21,6 +21,10 @@
 #ifndef __MACH_TEGRA_NAND_H
 #define __MACH_TEGRA_NAND_H
 
+/* tegra_nand_chip_parms flags */
+#define TEGRA_NAND_CACHE_READ		(1 << 0)	/* 31h/3Fh cache read */
+#define TEGRA_NAND_CACHE_PROG		(1 << 1)	/* 15h cache program */
+
 struct tegra_nand_chip_parms {
 	uint8_t vendor_id;
 	uint8_t device_id;
@@ -60,6 +60,15 @@ extern int nvhost_get_irq(struct nvhost_device *, unsigned int);
 extern struct resource *nvhost_get_resource_byname(struct nvhost_device *, unsigned int, const char *);
 extern int nvhost_get_irq_byname(struct nvhost_device *, const char *);
 
+#ifdef CONFIG_TEGRA_GRHOST
+extern bool nvhost_is_idle(void);
+#else
+static inline bool nvhost_is_idle(void)
+{
+	return true;
+}
+#endif
+
 #define to_nvhost_device(x) container_of((x), struct nvhost_device, dev)
 #define to_nvhost_driver(drv)	(container_of((drv), struct nvhost_driver, \
 				 driver))
@@ -96,10 +105,34 @@ struct nvhost_reloc {
 	__u32 target_offset;
 };
 
+struct nvhost_waitchk {
+	__u32 mem;
+	__u32 offset;		/* of the wait_syncpt data word */
+	__u32 syncpt_id;
+	__u32 thresh;
+};
+
 struct nvhost_get_param_args {
 	__u32 value;
 };
 
+/*
+ * One-call replacement for the write() stream plus FLUSH.  Waits whose
+ * threshold has already passed are patched out before the kickoff.
+ */
+struct nvhost_submit_args {
+	__u32 syncpt_id;
+	__u32 syncpt_incrs;
+	__u32 num_cmdbufs;
+	__u32 num_relocs;
+	__u32 num_waitchks;
+	__u32 null_kickoff;
+	struct nvhost_cmdbuf *cmdbufs;
+	struct nvhost_reloc *relocs;
+	struct nvhost_waitchk *waitchks;
+	__u32 fence;		/* returned sync point threshold */
+};
+
 struct nvhost_set_nvmap_fd_args {
 	__u32 fd;
 };
@@ -116,9 +149,11 @@ struct nvhost_set_nvmap_fd_args {
 	_IOW(NVHOST_IOCTL_MAGIC, 5, struct nvhost_set_nvmap_fd_args)
 #define NVHOST_IOCTL_CHANNEL_NULL_KICKOFF	\
 	_IOR(NVHOST_IOCTL_MAGIC, 6, struct nvhost_get_param_args)
+#define NVHOST_IOCTL_CHANNEL_SUBMIT		\
+	_IOWR(NVHOST_IOCTL_MAGIC, 7, struct nvhost_submit_args)
 #define NVHOST_IOCTL_CHANNEL_LAST		\
-	_IOC_NR(NVHOST_IOCTL_CHANNEL_NULL_KICKOFF)
-#define NVHOST_IOCTL_CHANNEL_MAX_ARG_SIZE sizeof(struct nvhost_get_param_args)
+	_IOC_NR(NVHOST_IOCTL_CHANNEL_SUBMIT)
+#define NVHOST_IOCTL_CHANNEL_MAX_ARG_SIZE sizeof(struct nvhost_submit_args)
 
 struct nvhost_ctrl_syncpt_read_args {
 	__u32 id;
@@ -149,6 +184,18 @@ struct nvhost_ctrl_module_regrdwr_args {
 	__u32 write;
 };
 
+struct nvhost_ctrl_fence_create_args {
+	__u32 id;
+	__u32 thresh;
+	__s32 fd;		/* returned fence file descriptor */
+};
+
+struct nvhost_ctrl_fence_merge_args {
+	__s32 fd1;
+	__s32 fd2;
+	__s32 fd;		/* returned fence, signalled after both */
+};
+
 #define NVHOST_IOCTL_CTRL_SYNCPT_READ		\
 	_IOWR(NVHOST_IOCTL_MAGIC, 1, struct nvhost_ctrl_syncpt_read_args)
 #define NVHOST_IOCTL_CTRL_SYNCPT_INCR		\
@@ -161,8 +208,15 @@ struct nvhost_ctrl_module_regrdwr_args {
 #define NVHOST_IOCTL_CTRL_MODULE_REGRDWR	\
 	_IOWR(NVHOST_IOCTL_MAGIC, 5, struct nvhost_ctrl_module_regrdwr_args)
 
+/* fences are file descriptors which poll readable once the sync point
+ * thresholds they stand for have all been reached */
+#define NVHOST_IOCTL_CTRL_FENCE_CREATE		\
+	_IOWR(NVHOST_IOCTL_MAGIC, 6, struct nvhost_ctrl_fence_create_args)
+#define NVHOST_IOCTL_CTRL_FENCE_MERGE		\
+	_IOWR(NVHOST_IOCTL_MAGIC, 7, struct nvhost_ctrl_fence_merge_args)
+
 #define NVHOST_IOCTL_CTRL_LAST			\
-	_IOC_NR(NVHOST_IOCTL_CTRL_MODULE_REGRDWR)
+	_IOC_NR(NVHOST_IOCTL_CTRL_FENCE_MERGE)
 #define NVHOST_IOCTL_CTRL_MAX_ARG_SIZE sizeof(struct nvhost_ctrl_module_regrdwr_args)
 
 #endif
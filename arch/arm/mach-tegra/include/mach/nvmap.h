@@ -97,6 +97,9 @@ int nvmap_pin_array(struct nvmap_client *client, struct nvmap_handle *gather,
 void nvmap_unpin_handles(struct nvmap_client *client,
 			 struct nvmap_handle **h, int nr);
 
+int nvmap_patch_word(struct nvmap_client *client, unsigned long id,
+		     u32 offset, u32 value);
+
 struct nvmap_platform_carveout {
 	const char *name;
 	unsigned int usage_mask;
@@ -37,4 +37,11 @@ int tegra_powergate_remove_clamping(int id);
 /* Must be called with clk disabled, and returns with clk enabled */
 int tegra_powergate_sequence_power_up(int id, struct clk *clk);
 
+/* Refcounted users of a partition, see powergate.c */
+int tegra_powergate_get(int id, struct clk *clk);
+void tegra_powergate_put(int id, struct clk *clk);
+
+int tegra_powergate_suspend(void);
+void tegra_powergate_resume(void);
+
 #endif /* _MACH_TEGRA_POWERGATE_H_ */
@@ -48,6 +48,9 @@
 #define SPDIF_CH_STA_TX_D_0		0x14C
 #define SPDIF_CH_STA_TX_E_0		0x150
 #define SPDIF_CH_STA_TX_F_0		0x154
+
+/* IEC 60958 channel status byte 0, bit 1: the samples are not linear PCM */
+#define SPDIF_CH_STA_TX_A_0_NON_AUDIO	(1<<1)
 #define SPDIF_USR_STA_RX_A_0		0x180
 #define SPDIF_USR_DAT_TX_A_0		0x1C0
 
@@ -415,6 +418,7 @@ void spdif_fifo_enable(unsigned long base, int mode, int on);
 int spdif_set_bit_mode(unsigned long base, unsigned mode);
 int spdif_set_fifo_packed(unsigned long base, unsigned on);
 int spdif_set_sample_rate(unsigned long base, unsigned int sample_rate);
+void spdif_set_non_audio(unsigned long base, unsigned on);
 void spdif_fifo_write(unsigned long base, int mode, u32 data);
 int spdif_fifo_set_attention_level(unsigned long base,
 					int mode,
@@ -29,6 +29,16 @@ enum tegra_suspend_mode {
 	TEGRA_MAX_SUSPEND_MODE,
 };
 
+/*
+ * A device that is safe to suspend and resume asynchronously.  If @after
+ * is set, the device resumes only once the platform device named @after
+ * has resumed, and @after suspends only once this device has suspended.
+ */
+struct tegra_suspend_async_dev {
+	const char *name;
+	const char *after;
+};
+
 struct tegra_suspend_platform_data {
 	unsigned long cpu_timer;   /* CPU power good time in us,  LP2/LP1 */
 	unsigned long cpu_off_timer;	/* CPU power off time us, LP2/LP1 */
@@ -42,6 +52,8 @@ struct tegra_suspend_platform_data {
 	bool sysclkreq_high;       /* System clock request is active-high */
 	bool separate_req;         /* Core & CPU power request are separate */
 	enum tegra_suspend_mode suspend_mode;
+	const struct tegra_suspend_async_dev *async_devs;
+	int num_async_devs;
 };
 
 unsigned long tegra_cpu_power_good_time(void);
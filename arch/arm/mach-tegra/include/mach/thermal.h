@@ -0,0 +1,40 @@
+/*
+ * arch/arm/mach-tegra/include/mach/thermal.h
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __MACH_TEGRA_THERMAL_H
+#define __MACH_TEGRA_THERMAL_H
+
+/*
+ * One throttle step, from mildest to most severe.  gpu_hz and emc_hz cap
+ * the 3d and emc clocks while the step is active, 0 leaves them alone.
+ */
+struct tegra_throttle_step {
+	unsigned int cpu_khz;
+	unsigned long gpu_hz;
+	unsigned long emc_hz;
+};
+
+/* legacy single alarm: lower the cpu speed gradually while enabled */
+void tegra_throttling_enable(bool enable);
+
+/*
+ * Throttle steps are set directly by the temperature sensor, step 0 ends
+ * throttling.  Without a table of steps each one lowers the cpu by one
+ * frequency table entry, starting from the highest throttle speed.
+ */
+void tegra_throttling_register_steps(const struct tegra_throttle_step *steps,
+	int num_steps);
+void tegra_throttling_set_step(int step);
+
+#endif
@@ -27,6 +27,9 @@
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/mm.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 #include <asm/io.h>
 #include <asm/cacheflush.h>
 
@@ -44,6 +47,18 @@
 #define GART_PAGE_SHIFT (12)
 #define GART_PAGE_MASK (~((1<<GART_PAGE_SHIFT)-1))
 
+/* pages made resident before pte_lock is taken to write their entries */
+#define GART_MAP_BATCH	(64)
+
+struct gart_stats {
+	u64			map_pages;
+	u64			map_ns;
+	u64			unmap_pages;
+	u64			unmap_ns;
+};
+
+/* savedata shadows every entry written to the GART, so suspend has
+ * nothing to read back and resume replays it with a single flush */
 struct gart_device {
 	void __iomem		*regs;
 	u32			*savedata;
@@ -54,6 +69,8 @@ struct gart_device {
 	struct tegra_iovmm_domain domain;
 	bool			enable;
 	bool			needs_barrier; /* emulator WAR */
+	struct gart_stats	stats; /* protected by pte_lock */
+	struct dentry		*debugfs;
 };
 
 static int gart_map(struct tegra_iovmm_device *, struct tegra_iovmm_area *);
@@ -87,27 +104,32 @@ static struct platform_driver tegra_iovmm_gart_drv = {
 	},
 };
 
+/* the registers are mapped as device memory, so the entry address and
+ * data writes reach the GART in order without a barrier per entry. */
+static inline void gart_set_pte(struct gart_device *gart,
+	tegra_iovmm_addr_t offs, u32 pte)
+{
+	writel_relaxed(offs, gart->regs + GART_ENTRY_ADDR);
+	writel_relaxed(pte, gart->regs + GART_ENTRY_DATA);
+	gart->savedata[(offs - gart->iovmm_base) >> GART_PAGE_SHIFT] = pte;
+}
+
+/* called once after a run of gart_set_pte(); the read back does not
+ * complete until the entry writes have landed */
+static inline void gart_flush_ptes(struct gart_device *gart)
+{
+	wmb();
+	readl(gart->regs + GART_CONFIG);
+}
+
 static int gart_suspend(struct tegra_iovmm_device *dev)
 {
 	struct gart_device *gart = container_of(dev, struct gart_device, iovmm);
-	unsigned int i;
-	unsigned long reg;
 
 	if (!gart)
 		return -ENODEV;
 
-	if (!gart->enable)
-		return 0;
-
-	spin_lock(&gart->pte_lock);
-	reg = gart->iovmm_base;
-	for (i=0; i<gart->page_count; i++) {
-		writel(reg, gart->regs + GART_ENTRY_ADDR);
-		gart->savedata[i] = readl(gart->regs + GART_ENTRY_DATA);
-		dmb();
-		reg += 1 << GART_PAGE_SHIFT;
-	}
-	spin_unlock(&gart->pte_lock);
+	/* savedata is always up to date */
 	return 0;
 }
 
@@ -120,14 +142,54 @@ static void do_gart_setup(struct gart_device *gart, const u32 *data)
 
 	reg = gart->iovmm_base;
 	for (i=0; i<gart->page_count; i++) {
-		writel(reg, gart->regs + GART_ENTRY_ADDR);
-		writel((data) ? data[i] : 0, gart->regs + GART_ENTRY_DATA);
-		wmb();
+		writel_relaxed(reg, gart->regs + GART_ENTRY_ADDR);
+		writel_relaxed((data) ? data[i] : 0,
+			gart->regs + GART_ENTRY_DATA);
 		reg += 1 << GART_PAGE_SHIFT;
 	}
-	wmb();
+	gart_flush_ptes(gart);
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int gart_stats_show(struct seq_file *s, void *data)
+{
+	struct gart_device *gart = s->private;
+	struct gart_stats st;
+
+	spin_lock(&gart->pte_lock);
+	st = gart->stats;
+	spin_unlock(&gart->pte_lock);
+
+	seq_printf(s, "map:   %llu pages, %llu ns/page\n", st.map_pages,
+		st.map_pages ? div64_u64(st.map_ns, st.map_pages) : 0);
+	seq_printf(s, "unmap: %llu pages, %llu ns/page\n", st.unmap_pages,
+		st.unmap_pages ? div64_u64(st.unmap_ns, st.unmap_pages) : 0);
+	return 0;
+}
+
+static int gart_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gart_stats_show, inode->i_private);
+}
+
+static const struct file_operations gart_stats_fops = {
+	.open		= gart_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void gart_debugfs_init(struct gart_device *gart)
+{
+	gart->debugfs = debugfs_create_file(VMM_NAME, S_IRUGO, NULL, gart,
+		&gart_stats_fops);
+}
+#else
+static void gart_debugfs_init(struct gart_device *gart)
+{
+}
+#endif
+
 static void gart_resume(struct tegra_iovmm_device *dev)
 {
 	struct gart_device *gart = container_of(dev, struct gart_device, iovmm);
@@ -150,6 +212,7 @@ static int gart_remove(struct platform_device *pdev)
 	if (gart->enable)
 		writel(0, gart->regs + GART_CONFIG);
 
+	debugfs_remove(gart->debugfs);
 	gart->enable = 0;
 	platform_set_drvdata(pdev, NULL);
 	tegra_iovmm_unregister(&gart->iovmm);
@@ -193,7 +256,7 @@ static int gart_probe(struct platform_device *pdev)
 		goto fail;
 	}
 
-	gart_regs = ioremap_wc(res->start, res->end - res->start + 1);
+	gart_regs = ioremap(res->start, res->end - res->start + 1);
 	if (!gart_regs) {
 		pr_err(DRIVER_NAME ": failed to remap GART registers\n");
 		e = -ENXIO;
@@ -229,10 +292,13 @@ static int gart_probe(struct platform_device *pdev)
 
 	spin_lock(&gart->pte_lock);
 
+	memset(gart->savedata, 0, sizeof(u32)*gart->page_count);
 	do_gart_setup(gart, NULL);
 	gart->enable = 1;
 
 	spin_unlock(&gart->pte_lock);
+
+	gart_debugfs_init(gart);
 	return 0;
 
 fail:
@@ -262,42 +328,51 @@ static int gart_map(struct tegra_iovmm_device *dev,
 	struct tegra_iovmm_area *iovma)
 {
 	struct gart_device *gart = container_of(dev, struct gart_device, iovmm);
+	unsigned long pfns[GART_MAP_BATCH];
 	unsigned long gart_page, count;
-	unsigned int i;
+	unsigned int i, j, n;
+	ktime_t start = ktime_get();
 
 	gart_page = iovma->iovm_start;
 	count = iovma->iovm_length >> GART_PAGE_SHIFT;
 
-	for (i=0; i<count; i++) {
-		unsigned long pfn;
+	for (i=0; i<count; i+=n) {
+		n = min_t(unsigned long, count - i, GART_MAP_BATCH);
 
-		pfn = iovma->ops->lock_makeresident(iovma, i<<PAGE_SHIFT);
-		if (!pfn_valid(pfn))
-			goto fail;
+		for (j=0; j<n; j++) {
+			pfns[j] = iovma->ops->lock_makeresident(iovma,
+				(i+j)<<PAGE_SHIFT);
+			if (!pfn_valid(pfns[j]))
+				goto fail;
+		}
 
 		spin_lock(&gart->pte_lock);
-
-		writel(gart_page, gart->regs + GART_ENTRY_ADDR);
-		writel(GART_PTE(pfn), gart->regs + GART_ENTRY_DATA);
-		wmb();
-		gart_page += 1 << GART_PAGE_SHIFT;
-
+		for (j=0; j<n; j++) {
+			gart_set_pte(gart, gart_page, GART_PTE(pfns[j]));
+			gart_page += 1 << GART_PAGE_SHIFT;
+		}
 		spin_unlock(&gart->pte_lock);
 	}
-	wmb();
+
+	spin_lock(&gart->pte_lock);
+	gart_flush_ptes(gart);
+	gart->stats.map_pages += count;
+	gart->stats.map_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	spin_unlock(&gart->pte_lock);
 	return 0;
 
 fail:
+	/* the pages made resident in the failed batch have no entry yet */
+	while (j--)
+		iovma->ops->release(iovma, (i+j)<<PAGE_SHIFT);
 	spin_lock(&gart->pte_lock);
 	while (i--) {
 		iovma->ops->release(iovma, i<<PAGE_SHIFT);
 		gart_page -= 1 << GART_PAGE_SHIFT;
-		writel(gart_page, gart->regs + GART_ENTRY_ADDR);
-		writel(0, gart->regs + GART_ENTRY_DATA);
-		wmb();
+		gart_set_pte(gart, gart_page, 0);
 	}
+	gart_flush_ptes(gart);
 	spin_unlock(&gart->pte_lock);
-	wmb();
 	return -ENOMEM;
 }
 
@@ -308,6 +383,8 @@ static void gart_unmap(struct tegra_iovmm_device *dev,
 	unsigned long gart_page, count;
 	unsigned int i;
 
+	ktime_t start = ktime_get();
+
 	count = iovma->iovm_length >> GART_PAGE_SHIFT;
 	gart_page = iovma->iovm_start;
 
@@ -316,13 +393,13 @@ static void gart_unmap(struct tegra_iovmm_device *dev,
 		if (iovma->ops && iovma->ops->release)
 			iovma->ops->release(iovma, i<<PAGE_SHIFT);
 
-		writel(gart_page, gart->regs + GART_ENTRY_ADDR);
-		writel(0, gart->regs + GART_ENTRY_DATA);
-		wmb();
+		gart_set_pte(gart, gart_page, 0);
 		gart_page += 1 << GART_PAGE_SHIFT;
 	}
+	gart_flush_ptes(gart);
+	gart->stats.unmap_pages += count;
+	gart->stats.unmap_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
 	spin_unlock(&gart->pte_lock);
-	wmb();
 }
 
 static void gart_map_pfn(struct tegra_iovmm_device *dev,
@@ -333,11 +410,9 @@ static void gart_map_pfn(struct tegra_iovmm_device *dev,
 
 	BUG_ON(!pfn_valid(pfn));
 	spin_lock(&gart->pte_lock);
-	writel(offs, gart->regs + GART_ENTRY_ADDR);
-	writel(GART_PTE(pfn), gart->regs + GART_ENTRY_DATA);
-	wmb();
+	gart_set_pte(gart, offs, GART_PTE(pfn));
+	gart_flush_ptes(gart);
 	spin_unlock(&gart->pte_lock);
-	wmb();
 }
 
 static struct tegra_iovmm_domain *gart_alloc_domain(
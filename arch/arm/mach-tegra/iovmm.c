@@ -36,6 +36,20 @@
 #define MIN_SPLIT_PAGE (4)
 #define MIN_SPLIT_BYTES(_d) (MIN_SPLIT_PAGE<<(_d)->dev->pgsize_bits)
 
+/* allocations of at least LARGE_BLOCK_BYTES are carved from the top of
+ * the best-fit block and smaller ones from the bottom, so that large
+ * surfaces collect at one end of the aperture instead of leaving short
+ * holes between small buffers when they are freed.
+ */
+#define LARGE_BLOCK_BYTES (1 << 20)
+
+/* upper bounds of the free block size buckets reported in /proc/iovmminfo,
+ * the last bucket holds everything larger */
+static const tegra_iovmm_addr_t iovmm_bucket_bytes[] = {
+	64 << 10, 256 << 10, 1 << 20, 4 << 20,
+};
+#define NUM_FREE_BUCKETS (ARRAY_SIZE(iovmm_bucket_bytes) + 1)
+
 #define iovmm_start(_b) ((_b)->vm_area.iovm_start)
 #define iovmm_length(_b) ((_b)->vm_area.iovm_length)
 #define iovmm_end(_b) (iovmm_start(_b) + iovmm_length(_b))
@@ -93,16 +107,19 @@ static tegra_iovmm_addr_t iovmm_align_down(struct tegra_iovmm_device *dev,
 static void tegra_iovmm_block_stats(struct tegra_iovmm_domain *domain,
 	unsigned int *num_blocks, unsigned int *num_free,
 	tegra_iovmm_addr_t *total, tegra_iovmm_addr_t *total_free,
-	tegra_iovmm_addr_t *max_free)
+	tegra_iovmm_addr_t *max_free, unsigned int *free_hist,
+	unsigned int *failures)
 {
 	struct rb_node *n;
 	struct tegra_iovmm_block *b;
+	int i;
 
 	*num_blocks = 0;
 	*num_free = 0;
 	*total = (tegra_iovmm_addr_t)0;
 	*total_free = (tegra_iovmm_addr_t)0;
 	*max_free = (tegra_iovmm_addr_t)0;
+	memset(free_hist, 0, NUM_FREE_BUCKETS * sizeof(*free_hist));
 
 	spin_lock(&domain->block_lock);
 	n = rb_first(&domain->all_blocks);
@@ -116,8 +133,13 @@ static void tegra_iovmm_block_stats(struct tegra_iovmm_domain *domain,
 			(*total_free) += iovmm_length(b);
 			(*max_free) = max_t(tegra_iovmm_addr_t,
 				(*max_free), iovmm_length(b));
+			for (i = 0; i < ARRAY_SIZE(iovmm_bucket_bytes); i++)
+				if (iovmm_length(b) < iovmm_bucket_bytes[i])
+					break;
+			free_hist[i]++;
 		}
 	}
+	*failures = domain->alloc_failures;
 	spin_unlock(&domain->block_lock);
 }
 
@@ -126,7 +148,10 @@ static int tegra_iovmm_read_proc(char *page, char **start, off_t off,
 {
 	struct iovmm_share_group *grp;
 	tegra_iovmm_addr_t max_free, total_free, total;
-	unsigned int num, num_free;
+	unsigned int num, num_free, failures;
+	unsigned int free_hist[NUM_FREE_BUCKETS];
+	unsigned int frag;
+	int i;
 
 	int len = 0;
 
@@ -140,13 +165,25 @@ static int tegra_iovmm_read_proc(char *page, char **start, off_t off,
 				(grp->name) ? grp->name : "<unnamed>",
 				grp->domain->dev->name);
 			tegra_iovmm_block_stats(grp->domain, &num,
-				&num_free, &total, &total_free, &max_free);
+				&num_free, &total, &total_free, &max_free,
+				free_hist, &failures);
 			total >>= 10;
 			total_free >>= 10;
 			max_free >>= 10;
+			/* share of the free space outside the largest hole */
+			frag = total_free ?
+				100 - max_free * 100 / total_free : 0;
 			len += iovmprint("\t\tsize: %uKiB free: %uKiB "
 				"largest: %uKiB (%u free / %u total blocks)\n",
 				total, total_free, max_free, num_free, num);
+			len += iovmprint("\t\tfragmentation: %u%% "
+				"alloc failures: %u\n", frag, failures);
+			len += iovmprint("\t\tfree blocks:");
+			for (i = 0; i < ARRAY_SIZE(iovmm_bucket_bytes); i++)
+				len += iovmprint(" <%uKiB: %u",
+					iovmm_bucket_bytes[i] >> 10,
+					free_hist[i]);
+			len += iovmprint(" larger: %u\n", free_hist[i]);
 		}
 	}
 	mutex_unlock(&iovmm_list_lock);
@@ -226,26 +263,29 @@ static void iovmm_free_block(struct tegra_iovmm_domain *domain,
 	spin_unlock(&domain->block_lock);
 }
 
-/* if the best-fit block is larger than the requested size, a remainder
- * block will be created and inserted into the free list in its place.
+/* if the best-fit block is larger than the requested size, the remainder
+ * is moved into rem and inserted into the free list in its place.
  * since all free blocks are stored in two trees the new block needs to be
- * linked into both. */
+ * linked into both.  called with the domain's block_lock held. */
 static void iovmm_split_free_block(struct tegra_iovmm_domain *domain,
-	struct tegra_iovmm_block *block, unsigned long size)
+	struct tegra_iovmm_block *block, struct tegra_iovmm_block *rem,
+	unsigned long size)
 {
 	struct rb_node **p;
 	struct rb_node *parent = NULL;
-	struct tegra_iovmm_block *rem;
 	struct tegra_iovmm_block *b;
 
-	rem = kmem_cache_zalloc(iovmm_cache, GFP_KERNEL);
-	if (!rem) return;
-
-	spin_lock(&domain->block_lock);
 	p = &domain->free_blocks.rb_node;
 
-	iovmm_start(rem) = iovmm_start(block) + size;
 	iovmm_length(rem) = iovmm_length(block) - size;
+	if (size >= LARGE_BLOCK_BYTES) {
+		/* the remainder stays below the block, so the block
+		 * keeps its place in the address-ordered tree */
+		iovmm_start(rem) = iovmm_start(block);
+		iovmm_start(block) += iovmm_length(rem);
+	} else {
+		iovmm_start(rem) = iovmm_start(block) + size;
+	}
 	atomic_set(&rem->ref, 1);
 	iovmm_length(block) = size;
 
@@ -279,18 +319,16 @@ static struct tegra_iovmm_block *iovmm_alloc_block(
 	struct tegra_iovmm_domain *domain, unsigned long size)
 {
 	struct rb_node *n;
-	struct tegra_iovmm_block *b, *best;
-        static int splitting = 0;
+	struct tegra_iovmm_block *b, *best, *rem;
 
 	BUG_ON(!size);
 	size = iovmm_align_up(domain->dev, size);
-        for (;;) {
-		spin_lock(&domain->block_lock);
-		if (!splitting)
-			break;
-		spin_unlock(&domain->block_lock);
-		schedule();
-	}
+
+	/* allocated up front so the split can happen under block_lock;
+	 * without it the best-fit block is just handed out whole */
+	rem = kmem_cache_zalloc(iovmm_cache, GFP_KERNEL);
+
+	spin_lock(&domain->block_lock);
 	n = domain->free_blocks.rb_node;
 	best = NULL;
 	while (n) {
@@ -305,21 +343,25 @@ static struct tegra_iovmm_block *iovmm_alloc_block(
 		}
 	}
 	if (!best) {
+		domain->alloc_failures++;
 		spin_unlock(&domain->block_lock);
+		if (rem)
+			kmem_cache_free(iovmm_cache, rem);
 		return NULL;
 	}
 	rb_erase(&best->free_node, &domain->free_blocks);
 	clear_bit(BK_free, &best->flags);
 	atomic_inc(&best->ref);
-	if (iovmm_length(best) >= size+MIN_SPLIT_BYTES(domain)) {
-		splitting = 1;
-		spin_unlock(&domain->block_lock);
-		iovmm_split_free_block(domain, best, size);
-		splitting = 0;
+	if (rem && iovmm_length(best) >= size+MIN_SPLIT_BYTES(domain)) {
+		iovmm_split_free_block(domain, best, rem, size);
+		rem = NULL;
 	}
 
 	spin_unlock(&domain->block_lock);
 
+	if (rem)
+		kmem_cache_free(iovmm_cache, rem);
+
 	return best;
 }
 
@@ -335,6 +377,7 @@ int tegra_iovmm_domain_init(struct tegra_iovmm_domain *domain,
 	domain->dev = dev;
 	atomic_set(&domain->clients, 0);
 	atomic_set(&domain->locks, 0);
+	domain->alloc_failures = 0;
 	atomic_set(&b->ref, 1);
 	spin_lock_init(&domain->block_lock);
 	init_rwsem(&domain->map_lock);
@@ -65,8 +65,7 @@ static int wait_for_done(void)
  */
 int tegra_kfuse_read(void *dest, size_t len)
 {
-	u32 v;
-	unsigned cnt;
+	u32 keys[KFUSE_DATA_SZ / 4];
 
 	if (len > KFUSE_DATA_SZ)
 		return -EINVAL;
@@ -79,10 +78,10 @@ int tegra_kfuse_read(void *dest, size_t len)
 		return -EIO;
 	}
 
-	for (cnt = 0; cnt < len; cnt += 4) {
-		v = tegra_kfuse_readl(KFUSE_KEYS);
-		memcpy(dest + cnt, &v, sizeof v);
-	}
+	/* KFUSE_KEYS steps to the next word on every read */
+	tegra_apb_readl_array(TEGRA_KFUSE_BASE + KFUSE_KEYS, keys,
+			      DIV_ROUND_UP(len, 4), true);
+	memcpy(dest, keys, len);
 
 	return 0;
 }
@@ -120,6 +120,12 @@ NV_DAEMON_MODULES(F)
 NV_KERNEL_MODULES(F)
 #undef F
 
+/* Per-function entry of a package dispatcher. Package dispatchers index a
+ * static table of these by function id instead of switching on it.
+ */
+typedef NvError (*NvIdlFuncDispatch)( void *InBuffer, NvU32 InSize,
+    void *OutBuffer, NvU32 OutSize, NvDispatchCtx* Ctx );
+
 /* utility functions called by stubs & dispatchers for transferring data
  * over FIFO objects. semantics are identical to NvOsFread / NvOsFwrite */
 NvError NvIdlHelperFifoRead(void *fifo, void *ptr, size_t len, size_t *read);
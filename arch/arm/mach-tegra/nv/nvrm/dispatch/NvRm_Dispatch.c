@@ -216,7 +216,7 @@ typedef struct NvIdlDispatchTableRec
     NvIdlDispatchFunc DispFunc;
 } NvIdlDispatchTable;
 
-static NvIdlDispatchTable gs_DispatchTable[] =
+static const NvIdlDispatchTable gs_DispatchTable[] =
 {
     { NvRm_nvrm_xpc, nvrm_xpc_Dispatch },
     { NvRm_nvrm_transport, nvrm_transport_Dispatch },
@@ -245,7 +245,7 @@ NvError NvRm_Dispatch( void *InBuffer, NvU32 InSize, void *OutBuffer, NvU32 OutS
 {
     NvU32 packid_;
     NvU32 funcid_;
-    NvIdlDispatchTable *table_;
+    const NvIdlDispatchTable *table_;
 
     NV_ASSERT( InBuffer );
     NV_ASSERT( OutBuffer );
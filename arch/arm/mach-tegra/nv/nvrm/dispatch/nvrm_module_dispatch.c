@@ -482,18 +482,16 @@ static NvError NvRmModuleReset_dispatch_( void *InBuffer, NvU32 InSize, void *Ou
 }
 
 NvError nvrm_module_Dispatch( NvU32 function, void *InBuffer, NvU32 InSize, void *OutBuffer, NvU32 OutSize, NvDispatchCtx* Ctx );
-NvError nvrm_module_Dispatch( NvU32 function, void *InBuffer, NvU32 InSize, void *OutBuffer, NvU32 OutSize, NvDispatchCtx* Ctx )
+static const NvIdlFuncDispatch gs_ModuleDispatch[] =
 {
-    NvError err_ = NvSuccess;
+    [3] = NvRmModuleReset_dispatch_,
+};
 
-    switch( function ) {
-    case 3:
-        err_ = NvRmModuleReset_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    default:
-        err_ = NvSuccess;
-        break;
-    }
+NvError nvrm_module_Dispatch( NvU32 function, void *InBuffer, NvU32 InSize, void *OutBuffer, NvU32 OutSize, NvDispatchCtx* Ctx )
+{
+    if( function >= NV_ARRAY_SIZE(gs_ModuleDispatch) ||
+        !gs_ModuleDispatch[function] )
+        return NvSuccess;
 
-    return err_;
+    return gs_ModuleDispatch[function]( InBuffer, InSize, OutBuffer, OutSize, Ctx );
 }
@@ -40,6 +40,7 @@
 #include "nvrm_power.h"
 
 #define OFFSET( s, e ) (NvU32)(void *)(&(((s*)0)->e))
+#define MAX_PREF_LIST_LENGTH 16
 
 typedef struct NvRmPowerVoltageControl_in_t
 {
@@ -137,13 +138,16 @@ static NvError NvRmPowerVoltageControl_dispatch_( void *InBuffer, NvU32 InSize,
     NvRmPowerVoltageControl_in *p_in;
     NvRmPowerVoltageControl_out *p_out;
     NvRmMilliVolts *PrefVoltageList = NULL;
+    NvRmMilliVolts VoltageBuff[MAX_PREF_LIST_LENGTH];
 
     p_in = (NvRmPowerVoltageControl_in *)InBuffer;
     p_out = (NvRmPowerVoltageControl_out *)((NvU8 *)OutBuffer + OFFSET(NvRmPowerVoltageControl_params, out) - OFFSET(NvRmPowerVoltageControl_params, inout));
 
     if( p_in->PrefVoltageListCount && p_in->PrefVoltageList )
     {
-        PrefVoltageList = (NvRmMilliVolts  *)NvOsAlloc( p_in->PrefVoltageListCount * sizeof( NvRmMilliVolts  ) );
+        PrefVoltageList = VoltageBuff;
+        if( p_in->PrefVoltageListCount > MAX_PREF_LIST_LENGTH )
+            PrefVoltageList = (NvRmMilliVolts  *)NvOsAlloc( p_in->PrefVoltageListCount * sizeof( NvRmMilliVolts  ) );
         if( !PrefVoltageList )
         {
             err_ = NvError_InsufficientMemory;
@@ -163,7 +167,8 @@ static NvError NvRmPowerVoltageControl_dispatch_( void *InBuffer, NvU32 InSize,
     p_out->ret_ = NvRmPowerVoltageControl( p_in->hRmDeviceHandle, p_in->ModuleId, p_in->ClientId, p_in->MinVolts, p_in->MaxVolts, PrefVoltageList, p_in->PrefVoltageListCount, &p_out->CurrentVolts );
 
 clean:
-    NvOsFree( PrefVoltageList );
+    if( PrefVoltageList != VoltageBuff )
+        NvOsFree( PrefVoltageList );
     return err_;
 }
 
@@ -188,13 +193,16 @@ static NvError NvRmPowerModuleClockConfig_dispatch_( void *InBuffer, NvU32 InSiz
     NvRmPowerModuleClockConfig_in *p_in;
     NvRmPowerModuleClockConfig_out *p_out;
     NvRmFreqKHz *PrefFreqList = NULL;
+    NvRmFreqKHz FreqBuff[MAX_PREF_LIST_LENGTH];
 
     p_in = (NvRmPowerModuleClockConfig_in *)InBuffer;
     p_out = (NvRmPowerModuleClockConfig_out *)((NvU8 *)OutBuffer + OFFSET(NvRmPowerModuleClockConfig_params, out) - OFFSET(NvRmPowerModuleClockConfig_params, inout));
 
     if( p_in->PrefFreqListCount && p_in->PrefFreqList )
     {
-        PrefFreqList = (NvRmFreqKHz  *)NvOsAlloc( p_in->PrefFreqListCount * sizeof( NvRmFreqKHz  ) );
+        PrefFreqList = FreqBuff;
+        if( p_in->PrefFreqListCount > MAX_PREF_LIST_LENGTH )
+            PrefFreqList = (NvRmFreqKHz  *)NvOsAlloc( p_in->PrefFreqListCount * sizeof( NvRmFreqKHz  ) );
         if( !PrefFreqList )
         {
             err_ = NvError_InsufficientMemory;
@@ -214,28 +222,23 @@ static NvError NvRmPowerModuleClockConfig_dispatch_( void *InBuffer, NvU32 InSiz
     p_out->ret_ = NvRmPowerModuleClockConfig( p_in->hRmDeviceHandle, p_in->ModuleId, p_in->ClientId, p_in->MinFreq, p_in->MaxFreq, PrefFreqList, p_in->PrefFreqListCount, &p_out->CurrentFreq, p_in->flags );
 
 clean:
-    NvOsFree( PrefFreqList );
+    if( PrefFreqList != FreqBuff )
+        NvOsFree( PrefFreqList );
     return err_;
 }
 
-NvError nvrm_power_Dispatch( NvU32 function, void *InBuffer, NvU32 InSize, void *OutBuffer, NvU32 OutSize, NvDispatchCtx* Ctx )
+static const NvIdlFuncDispatch gs_PowerDispatch[] =
 {
-    NvError err_ = NvSuccess;
+    [7] = NvRmPowerModuleClockConfig_dispatch_,
+    [8] = NvRmPowerModuleClockControl_dispatch_,
+    [9] = NvRmPowerVoltageControl_dispatch_,
+};
 
-    switch( function ) {
-    case 9:
-        err_ = NvRmPowerVoltageControl_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 8:
-        err_ = NvRmPowerModuleClockControl_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 7:
-        err_ = NvRmPowerModuleClockConfig_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    default:
-        err_ = NvSuccess;
-        break;
-    }
+NvError nvrm_power_Dispatch( NvU32 function, void *InBuffer, NvU32 InSize, void *OutBuffer, NvU32 OutSize, NvDispatchCtx* Ctx )
+{
+    if( function >= NV_ARRAY_SIZE(gs_PowerDispatch) ||
+        !gs_PowerDispatch[function] )
+        return NvSuccess;
 
-    return err_;
+    return gs_PowerDispatch[function]( InBuffer, InSize, OutBuffer, OutSize, Ctx );
 }
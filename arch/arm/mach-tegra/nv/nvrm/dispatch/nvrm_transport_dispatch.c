@@ -631,48 +631,25 @@ clean:
 }
 
 NvError nvrm_transport_Dispatch( NvU32 function, void *InBuffer, NvU32 InSize, void *OutBuffer, NvU32 OutSize, NvDispatchCtx* Ctx );
+static const NvIdlFuncDispatch gs_TransportDispatch[] =
+{
+    [0] = NvRmTransportOpen_dispatch_,
+    [1] = NvRmTransportGetPortName_dispatch_,
+    [2] = NvRmTransportClose_dispatch_,
+    [3] = NvRmTransportInit_dispatch_,
+    [4] = NvRmTransportDeInit_dispatch_,
+    [5] = NvRmTransportWaitForConnect_dispatch_,
+    [6] = NvRmTransportConnect_dispatch_,
+    [7] = NvRmTransportSetQueueDepth_dispatch_,
+    [8] = NvRmTransportSendMsg_dispatch_,
+    [9] = NvRmTransportSendMsgInLP0_dispatch_,
+    [10] = NvRmTransportRecvMsg_dispatch_,
+};
+
 NvError nvrm_transport_Dispatch( NvU32 function, void *InBuffer, NvU32 InSize, void *OutBuffer, NvU32 OutSize, NvDispatchCtx* Ctx )
 {
-    NvError err_ = NvSuccess;
+    if( function >= NV_ARRAY_SIZE(gs_TransportDispatch) )
+        return NvError_BadParameter;
 
-    switch( function ) {
-    case 10:
-        err_ = NvRmTransportRecvMsg_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 9:
-        err_ = NvRmTransportSendMsgInLP0_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 8:
-        err_ = NvRmTransportSendMsg_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 7:
-        err_ = NvRmTransportSetQueueDepth_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 6:
-        err_ = NvRmTransportConnect_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 5:
-        err_ = NvRmTransportWaitForConnect_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 4:
-        err_ = NvRmTransportDeInit_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 3:
-        err_ = NvRmTransportInit_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 2:
-        err_ = NvRmTransportClose_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 1:
-        err_ = NvRmTransportGetPortName_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    case 0:
-        err_ = NvRmTransportOpen_dispatch_( InBuffer, InSize, OutBuffer, OutSize, Ctx );
-        break;
-    default:
-        err_ = NvError_BadParameter;
-        break;
-    }
-
-    return err_;
+    return gs_TransportDispatch[function]( InBuffer, InSize, OutBuffer, OutSize, Ctx );
 }
@@ -202,7 +202,9 @@ long nvrm_unlocked_ioctl(struct file *file,
     NvError err;
     NvOsIoctlParams p;
     NvU32 size;
-    NvU32 small_buf[8];
+    /* large enough for the marshalled parameters of every power, module
+     * and transport call, so the frequent ones never allocate */
+    NvU32 small_buf[32];
     void *ptr = 0;
     long e;
     NvBool bAlloc = NV_FALSE;
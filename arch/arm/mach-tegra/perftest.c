@@ -0,0 +1,551 @@
+/*
+ * arch/arm/mach-tegra/perftest.c
+ *
+ * Micro-benchmarks for the platform primitives the drivers lean on:
+ * APB register access, the AES engine, L2 maintenance, nvmap and GART
+ * mappings, I2C transfers and idle wakeup latency.  Each test is a file
+ * under debugfs tegra_perf/ and runs when the file is read; "all" runs
+ * every test.  Results are printed one per line as
+ *
+ *   <test> size=<bytes> iters=<n> avg_ns=<ns> max_ns=<ns> kBps=<rate>
+ *
+ * so runs before and after a change can be compared with a script.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/err.h>
+#include <linux/completion.h>
+#include <linux/scatterlist.h>
+#include <linux/crypto.h>
+#include <linux/i2c.h>
+
+#include <asm/cacheflush.h>
+#include <asm/outercache.h>
+#include <asm/sizes.h>
+
+#include <mach/iomap.h>
+#include <mach/iovmm.h>
+#include <mach/nvmap.h>
+
+#include "apbio.h"
+
+#define PERF_ITERS		64
+
+/* the fuse cache is the largest always-clocked block of APB registers */
+#define PERF_APB_OFFSET		(TEGRA_FUSE_BASE + 0x200)
+#define PERF_APB_WORDS		62
+
+static unsigned int iters = PERF_ITERS;
+module_param(iters, uint, 0644);
+
+static int i2c_bus;
+module_param(i2c_bus, int, 0644);
+static unsigned int i2c_addr;
+module_param(i2c_addr, uint, 0644);
+static unsigned int i2c_reg;
+module_param(i2c_reg, uint, 0644);
+
+struct perf_stat {
+	unsigned int size;
+	unsigned int iters;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+static void perf_start(struct perf_stat *st, unsigned int size)
+{
+	st->size = size;
+	st->iters = 0;
+	st->total_ns = 0;
+	st->max_ns = 0;
+}
+
+static void perf_sample(struct perf_stat *st, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	st->iters++;
+	st->total_ns += ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+}
+
+static void perf_report(struct seq_file *s, const char *name,
+			struct perf_stat *st)
+{
+	u64 avg = 0, rate = 0;
+
+	if (st->iters) {
+		avg = div64_u64(st->total_ns, st->iters);
+		/* bytes per ns * 10^6 = kB/s */
+		if (st->total_ns)
+			rate = div64_u64((u64)st->size * st->iters * 1000000ULL,
+					 st->total_ns);
+	}
+
+	seq_printf(s, "%s size=%u iters=%u avg_ns=%llu max_ns=%llu kBps=%llu\n",
+		   name, st->size, st->iters, avg, st->max_ns, rate);
+}
+
+static unsigned int perf_iters(void)
+{
+	return clamp_t(unsigned int, iters, 1, 4096);
+}
+
+static int perf_apb(struct seq_file *s)
+{
+	static const unsigned int words[] = { 1, 16, PERF_APB_WORDS };
+	u32 buf[PERF_APB_WORDS];
+	struct perf_stat st;
+	ktime_t start;
+	unsigned int i, j, n;
+
+	for (i = 0; i < ARRAY_SIZE(words); i++) {
+		perf_start(&st, words[i] * 4);
+		for (n = 0; n < perf_iters(); n++) {
+			start = ktime_get();
+			for (j = 0; j < words[i]; j++)
+				buf[j] = tegra_apb_readl(PERF_APB_OFFSET + j * 4);
+			perf_sample(&st, start);
+		}
+		perf_report(s, "apb_readl", &st);
+
+		perf_start(&st, words[i] * 4);
+		for (n = 0; n < perf_iters(); n++) {
+			start = ktime_get();
+			tegra_apb_readl_array(PERF_APB_OFFSET, buf, words[i],
+					      false);
+			perf_sample(&st, start);
+		}
+		perf_report(s, "apb_readl_array", &st);
+	}
+
+	return 0;
+}
+
+struct perf_aes_wait {
+	struct completion done;
+	int err;
+};
+
+static void perf_aes_done(struct crypto_async_request *req, int err)
+{
+	struct perf_aes_wait *wait = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+	wait->err = err;
+	complete(&wait->done);
+}
+
+static int perf_aes_one(struct seq_file *s, const char *drv,
+			const char *name, void *buf, unsigned int size)
+{
+	static const u8 key[16];
+	struct crypto_ablkcipher *tfm;
+	struct ablkcipher_request *req;
+	struct perf_aes_wait wait;
+	struct scatterlist sg;
+	struct perf_stat st;
+	u8 iv[16];
+	ktime_t start;
+	unsigned int n;
+	int err;
+
+	tfm = crypto_alloc_ablkcipher(drv, 0, 0);
+	if (IS_ERR(tfm)) {
+		seq_printf(s, "%s skipped: no %s\n", name, drv);
+		return 0;
+	}
+
+	err = crypto_ablkcipher_setkey(tfm, key, sizeof(key));
+	if (err)
+		goto out_tfm;
+
+	req = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+	if (!req) {
+		err = -ENOMEM;
+		goto out_tfm;
+	}
+	ablkcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+					perf_aes_done, &wait);
+	sg_init_one(&sg, buf, size);
+
+	perf_start(&st, size);
+	for (n = 0; n < perf_iters(); n++) {
+		memset(iv, 0, sizeof(iv));
+		ablkcipher_request_set_crypt(req, &sg, &sg, size, iv);
+		init_completion(&wait.done);
+		wait.err = 0;
+
+		start = ktime_get();
+		err = crypto_ablkcipher_encrypt(req);
+		if (err == -EINPROGRESS || err == -EBUSY) {
+			wait_for_completion(&wait.done);
+			err = wait.err;
+		}
+		if (err)
+			break;
+		perf_sample(&st, start);
+	}
+	perf_report(s, name, &st);
+
+	ablkcipher_request_free(req);
+out_tfm:
+	crypto_free_ablkcipher(tfm);
+	return err;
+}
+
+static int perf_aes(struct seq_file *s)
+{
+	static const unsigned int sizes[] = { SZ_4K, SZ_64K };
+	void *buf;
+	unsigned int i;
+	int err = 0;
+
+	buf = (void *)__get_free_pages(GFP_KERNEL, get_order(SZ_64K));
+	if (!buf)
+		return -ENOMEM;
+	memset(buf, 0x5a, SZ_64K);
+
+	for (i = 0; i < ARRAY_SIZE(sizes) && !err; i++) {
+		err = perf_aes_one(s, "ecb-aes-tegra", "aes_ecb", buf,
+				   sizes[i]);
+		if (!err)
+			err = perf_aes_one(s, "cbc-aes-tegra", "aes_cbc", buf,
+					   sizes[i]);
+	}
+
+	free_pages((unsigned long)buf, get_order(SZ_64K));
+	return err;
+}
+
+static int perf_l2x0(struct seq_file *s)
+{
+	static const unsigned int sizes[] = { SZ_4K, SZ_64K, SZ_512K };
+	struct perf_stat clean, flush;
+	unsigned long buf;
+	phys_addr_t phys;
+	ktime_t start;
+	unsigned int i, n;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		buf = __get_free_pages(GFP_KERNEL, get_order(sizes[i]));
+		if (!buf)
+			return -ENOMEM;
+		phys = virt_to_phys((void *)buf);
+
+		perf_start(&clean, sizes[i]);
+		perf_start(&flush, sizes[i]);
+		for (n = 0; n < perf_iters(); n++) {
+			/* dirty the lines and push them out to L2 */
+			memset((void *)buf, n, sizes[i]);
+			__cpuc_flush_dcache_area((void *)buf, sizes[i]);
+			start = ktime_get();
+			outer_clean_range(phys, phys + sizes[i]);
+			perf_sample(&clean, start);
+
+			memset((void *)buf, n, sizes[i]);
+			__cpuc_flush_dcache_area((void *)buf, sizes[i]);
+			start = ktime_get();
+			outer_flush_range(phys, phys + sizes[i]);
+			perf_sample(&flush, start);
+		}
+		perf_report(s, "l2_clean", &clean);
+		perf_report(s, "l2_flush", &flush);
+
+		free_pages(buf, get_order(sizes[i]));
+	}
+
+	return 0;
+}
+
+static int perf_nvmap(struct seq_file *s)
+{
+	static const unsigned int sizes[] = { SZ_4K, SZ_64K, SZ_1M };
+	struct perf_stat alloc, pin, unpin, free;
+	struct nvmap_client *client;
+	struct nvmap_handle_ref *r;
+	unsigned long addr;
+	ktime_t start;
+	unsigned int i, n;
+	int err = 0;
+
+	if (!nvmap_dev) {
+		seq_printf(s, "nvmap skipped: no device\n");
+		return 0;
+	}
+
+	client = nvmap_create_client(nvmap_dev, "perftest");
+	if (!client)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(sizes) && !err; i++) {
+		perf_start(&alloc, sizes[i]);
+		perf_start(&pin, sizes[i]);
+		perf_start(&unpin, sizes[i]);
+		perf_start(&free, sizes[i]);
+
+		for (n = 0; n < perf_iters(); n++) {
+			start = ktime_get();
+			r = nvmap_alloc(client, sizes[i], 32,
+					NVMAP_HANDLE_WRITE_COMBINE);
+			if (IS_ERR(r)) {
+				err = PTR_ERR(r);
+				break;
+			}
+			perf_sample(&alloc, start);
+
+			start = ktime_get();
+			addr = nvmap_pin(client, r);
+			if (IS_ERR_VALUE(addr)) {
+				nvmap_free(client, r);
+				err = addr;
+				break;
+			}
+			perf_sample(&pin, start);
+
+			start = ktime_get();
+			nvmap_unpin(client, r);
+			perf_sample(&unpin, start);
+
+			start = ktime_get();
+			nvmap_free(client, r);
+			perf_sample(&free, start);
+		}
+
+		perf_report(s, "nvmap_alloc", &alloc);
+		perf_report(s, "nvmap_pin", &pin);
+		perf_report(s, "nvmap_unpin", &unpin);
+		perf_report(s, "nvmap_free", &free);
+	}
+
+	nvmap_client_put(client);
+	return err;
+}
+
+#ifdef CONFIG_TEGRA_IOVMM
+static int perf_gart(struct seq_file *s)
+{
+	static const unsigned int sizes[] = { SZ_64K, SZ_1M };
+	struct tegra_iovmm_client *client;
+	struct tegra_iovmm_area *area;
+	struct perf_stat map, unmap;
+	unsigned long pfn;
+	ktime_t start;
+	unsigned int i, j, n;
+	int err = 0;
+
+	client = tegra_iovmm_alloc_client("perftest", NULL);
+	if (!client) {
+		seq_printf(s, "gart skipped: no iovmm device\n");
+		return 0;
+	}
+
+	/* every page maps the same frame, only the PTE writes are timed */
+	pfn = page_to_pfn(ZERO_PAGE(0));
+
+	for (i = 0; i < ARRAY_SIZE(sizes) && !err; i++) {
+		perf_start(&map, sizes[i]);
+		perf_start(&unmap, sizes[i]);
+
+		for (n = 0; n < perf_iters(); n++) {
+			area = tegra_iovmm_create_vm(client, NULL, sizes[i],
+						     pgprot_kernel);
+			if (!area) {
+				err = -ENOMEM;
+				break;
+			}
+
+			start = ktime_get();
+			for (j = 0; j < sizes[i] >> PAGE_SHIFT; j++)
+				tegra_iovmm_vm_insert_pfn(area,
+					area->iovm_start + j * PAGE_SIZE, pfn);
+			perf_sample(&map, start);
+
+			start = ktime_get();
+			tegra_iovmm_free_vm(area);
+			perf_sample(&unmap, start);
+		}
+
+		perf_report(s, "gart_map", &map);
+		perf_report(s, "gart_unmap", &unmap);
+	}
+
+	tegra_iovmm_free_client(client);
+	return err;
+}
+#endif
+
+static int perf_i2c(struct seq_file *s)
+{
+	struct i2c_adapter *adap;
+	struct i2c_msg msg[2];
+	struct perf_stat st;
+	u8 reg, val;
+	ktime_t start;
+	unsigned int n;
+	int err = 0;
+
+	if (!i2c_addr) {
+		seq_printf(s, "i2c skipped: set i2c_bus and i2c_addr\n");
+		return 0;
+	}
+
+	adap = i2c_get_adapter(i2c_bus);
+	if (!adap)
+		return -ENODEV;
+
+	reg = i2c_reg;
+	msg[0].addr = i2c_addr;
+	msg[0].flags = 0;
+	msg[0].len = 1;
+	msg[0].buf = &reg;
+	msg[1].addr = i2c_addr;
+	msg[1].flags = I2C_M_RD;
+	msg[1].len = 1;
+	msg[1].buf = &val;
+
+	perf_start(&st, 2);
+	for (n = 0; n < perf_iters(); n++) {
+		start = ktime_get();
+		err = i2c_transfer(adap, msg, ARRAY_SIZE(msg));
+		if (err != ARRAY_SIZE(msg)) {
+			err = err < 0 ? err : -EIO;
+			break;
+		}
+		perf_sample(&st, start);
+		err = 0;
+	}
+	perf_report(s, "i2c_read_reg", &st);
+
+	i2c_put_adapter(adap);
+	return err;
+}
+
+/*
+ * How late an idle CPU wakes up for a timer.  The short sleep lands in
+ * LP3, the longer ones let the cpuidle governor pick LP2, so the
+ * overshoot includes the exit latency of whichever state was entered.
+ */
+static int perf_idle(struct seq_file *s)
+{
+	static const unsigned int sleep_us[] = { 200, 5000, 50000 };
+	struct perf_stat st;
+	ktime_t start, expires;
+	unsigned int i, n, count;
+	char name[24];
+	u64 ns;
+
+	for (i = 0; i < ARRAY_SIZE(sleep_us); i++) {
+		/* keep the long sleeps from taking minutes */
+		count = min(perf_iters(), 1000000 / sleep_us[i] + 1);
+
+		perf_start(&st, 0);
+		for (n = 0; n < count; n++) {
+			start = ktime_get();
+			expires = ktime_add_us(start, sleep_us[i]);
+			set_current_state(TASK_UNINTERRUPTIBLE);
+			schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+
+			ns = ktime_to_ns(ktime_sub(ktime_get(), expires));
+			st.iters++;
+			st.total_ns += ns;
+			if (ns > st.max_ns)
+				st.max_ns = ns;
+		}
+		snprintf(name, sizeof(name), "idle_wake_%uus", sleep_us[i]);
+		perf_report(s, name, &st);
+	}
+
+	return 0;
+}
+
+struct perf_test {
+	const char *name;
+	int (*run)(struct seq_file *s);
+};
+
+static const struct perf_test perf_tests[] = {
+	{ "apb",	perf_apb },
+	{ "aes",	perf_aes },
+	{ "l2x0",	perf_l2x0 },
+	{ "nvmap",	perf_nvmap },
+#ifdef CONFIG_TEGRA_IOVMM
+	{ "gart",	perf_gart },
+#endif
+	{ "i2c",	perf_i2c },
+	{ "idle",	perf_idle },
+};
+
+static int perf_run(struct seq_file *s, const struct perf_test *t)
+{
+	int err = t->run(s);
+
+	if (err)
+		seq_printf(s, "%s failed: %d\n", t->name, err);
+	return err;
+}
+
+static int perf_show(struct seq_file *s, void *data)
+{
+	const struct perf_test *t = s->private;
+	int i;
+
+	if (t)
+		return perf_run(s, t);
+
+	for (i = 0; i < ARRAY_SIZE(perf_tests); i++)
+		perf_run(s, &perf_tests[i]);
+	return 0;
+}
+
+static int perf_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, perf_show, inode->i_private);
+}
+
+static const struct file_operations perf_fops = {
+	.open		= perf_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_perftest_init(void)
+{
+	struct dentry *dir;
+	int i;
+
+	dir = debugfs_create_dir("tegra_perf", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(perf_tests); i++)
+		if (!debugfs_create_file(perf_tests[i].name, S_IRUSR, dir,
+					 (void *)&perf_tests[i], &perf_fops))
+			goto err_out;
+
+	if (!debugfs_create_file("all", S_IRUSR, dir, NULL, &perf_fops))
+		goto err_out;
+
+	return 0;
+
+err_out:
+	debugfs_remove_recursive(dir);
+	return -ENOMEM;
+}
+late_initcall(tegra_perftest_init);
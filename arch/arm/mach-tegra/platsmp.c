@@ -75,10 +75,6 @@ void __cpuinit platform_secondary_init(unsigned int cpu)
 #endif
 	spin_unlock(&boot_lock);
 }
-#ifdef CONFIG_TRUSTED_FOUNDATIONS
-void callGenericSMC(u32 param0, u32 param1, u32 param2);
-#endif
-
 int __cpuinit boot_secondary(unsigned int cpu, struct task_struct *idle)
 {
 	unsigned long old_boot_vector;
@@ -106,7 +102,7 @@ int __cpuinit boot_secondary(unsigned int cpu, struct task_struct *idle)
 	smp_wmb();
 
 #if CONFIG_TRUSTED_FOUNDATIONS
-	callGenericSMC(0xFFFFFFFC, 0xFFFFFFE5, boot_vector);
+	tegra_smc_set_boot_vector(boot_vector);
 #else
 	old_boot_vector = readl(vector_base);
 	writel(boot_vector, vector_base);
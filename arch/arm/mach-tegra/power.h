@@ -58,6 +58,11 @@ void __shut_off_mmu(void);
 void tegra_lp2_startup(void);
 unsigned int tegra_suspend_lp2(unsigned int us);
 void tegra_hotplug_startup(void);
+
+#ifdef CONFIG_TRUSTED_FOUNDATIONS
+void callGenericSMC(u32 param0, u32 param1, u32 param2);
+void tegra_smc_set_boot_vector(u32 boot_vector);
+#endif
 #endif
 
 #endif
@@ -24,8 +24,12 @@
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
 #include <linux/seq_file.h>
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 #include <mach/clk.h>
 #include <mach/iomap.h>
@@ -42,6 +46,38 @@ static DEFINE_SPINLOCK(tegra_powergate_lock);
 
 static void __iomem *pmc = IO_ADDRESS(TEGRA_PMC_BASE);
 
+/*
+ * Partitions shared through tegra_powergate_get()/put() are refcounted
+ * and powered off off_delay_ms after the last user is gone, so a user
+ * coming back quickly does not pay for a full power up.  Residency and
+ * toggles are counted for every transition, including the ones made
+ * through the raw power_on/power_off calls.
+ */
+struct powergate_partition {
+	int			refs;
+	struct delayed_work	off_work;
+
+	/* protected by tegra_powergate_lock */
+	bool			powered;
+	ktime_t			state_start;
+	u64			on_us;
+	u64			off_us;
+	unsigned int		toggles;
+
+	/* protected by tegra_powergate_mutex */
+	u32			up_us;
+	u32			up_max_us;
+	u32			down_us;
+	u32			down_max_us;
+};
+
+static DEFINE_MUTEX(tegra_powergate_mutex);
+static struct powergate_partition partitions[TEGRA_NUM_POWERGATE];
+
+static unsigned int off_delay_ms = 10;
+module_param(off_delay_ms, uint, 0644);
+MODULE_PARM_DESC(off_delay_ms, "delay before an unused partition is powered off");
+
 static u32 pmc_read(unsigned long reg)
 {
 	return readl(pmc + reg);
@@ -52,6 +88,24 @@ static void pmc_write(u32 val, unsigned long reg)
 	writel(val, pmc + reg);
 }
 
+/* Called with tegra_powergate_lock held */
+static void powergate_account(int id, bool new_state, bool toggled)
+{
+	struct powergate_partition *pg = &partitions[id];
+	ktime_t now = ktime_get();
+	s64 us = ktime_to_us(ktime_sub(now, pg->state_start));
+
+	if (pg->powered)
+		pg->on_us += us;
+	else
+		pg->off_us += us;
+
+	pg->powered = new_state;
+	pg->state_start = now;
+	if (toggled)
+		pg->toggles++;
+}
+
 static int tegra_powergate_set(int id, bool new_state)
 {
 	bool status;
@@ -67,6 +121,7 @@ static int tegra_powergate_set(int id, bool new_state)
 	}
 
 	pmc_write(PWRGATE_TOGGLE_START | id, PWRGATE_TOGGLE);
+	powergate_account(id, new_state, true);
 
 	spin_unlock_irqrestore(&tegra_powergate_lock, flags);
 
@@ -180,6 +235,170 @@ err_power:
 	return ret;
 }
 
+static inline u32 powergate_elapsed_us(ktime_t start)
+{
+	return (u32)ktime_to_us(ktime_sub(ktime_get(), start));
+}
+
+/* Called with tegra_powergate_mutex held */
+static void powergate_off_locked(int id)
+{
+	struct powergate_partition *pg = &partitions[id];
+	ktime_t start;
+
+	if (pg->refs || !tegra_powergate_is_powered(id))
+		return;
+
+	start = ktime_get();
+	tegra_powergate_power_off(id);
+	pg->down_us = powergate_elapsed_us(start);
+	pg->down_max_us = max(pg->down_max_us, pg->down_us);
+}
+
+static void powergate_off_work(struct work_struct *work)
+{
+	struct powergate_partition *pg = container_of(to_delayed_work(work),
+		struct powergate_partition, off_work);
+
+	mutex_lock(&tegra_powergate_mutex);
+	powergate_off_locked(pg - partitions);
+	mutex_unlock(&tegra_powergate_mutex);
+}
+
+/*
+ * Take a reference on a partition.  The first user powers it up (or just
+ * resets its module if the delayed power off has not run yet), later
+ * users only get their clock enabled and reset deasserted.
+ * Must be called with clk disabled, and returns with clk enabled
+ */
+int tegra_powergate_get(int id, struct clk *clk)
+{
+	struct powergate_partition *pg;
+	ktime_t start;
+	bool was_powered;
+	int ret;
+
+	if (id < 0 || id >= TEGRA_NUM_POWERGATE)
+		return -EINVAL;
+
+	pg = &partitions[id];
+
+	mutex_lock(&tegra_powergate_mutex);
+	cancel_delayed_work(&pg->off_work);
+
+	if (pg->refs) {
+		ret = clk_enable(clk);
+		if (!ret)
+			tegra_periph_reset_deassert(clk);
+	} else {
+		was_powered = tegra_powergate_is_powered(id);
+		start = ktime_get();
+		ret = tegra_powergate_sequence_power_up(id, clk);
+		if (!ret && !was_powered) {
+			pg->up_us = powergate_elapsed_us(start);
+			pg->up_max_us = max(pg->up_max_us, pg->up_us);
+		}
+	}
+
+	if (!ret)
+		pg->refs++;
+	mutex_unlock(&tegra_powergate_mutex);
+
+	return ret;
+}
+
+/*
+ * Drop a reference taken by tegra_powergate_get().  The module is put
+ * back in reset, the partition is powered off later once unused.
+ * Must be called with clk disabled
+ */
+void tegra_powergate_put(int id, struct clk *clk)
+{
+	struct powergate_partition *pg;
+
+	if (id < 0 || id >= TEGRA_NUM_POWERGATE)
+		return;
+
+	pg = &partitions[id];
+
+	mutex_lock(&tegra_powergate_mutex);
+	if (WARN_ON(!pg->refs))
+		goto out;
+
+	tegra_periph_reset_assert(clk);
+	if (--pg->refs)
+		goto out;
+
+	if (off_delay_ms)
+		schedule_delayed_work(&pg->off_work,
+			msecs_to_jiffies(off_delay_ms));
+	else
+		powergate_off_locked(id);
+out:
+	mutex_unlock(&tegra_powergate_mutex);
+}
+
+/*
+ * Run the pending delayed power offs now, nothing can be left half way
+ * before LP0 turns the core rail off.  A partition that still has users
+ * would lose power under them, so refuse to suspend.
+ */
+int tegra_powergate_suspend(void)
+{
+	bool pending[TEGRA_NUM_POWERGATE];
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < TEGRA_NUM_POWERGATE; i++)
+		pending[i] = cancel_delayed_work_sync(&partitions[i].off_work);
+
+	mutex_lock(&tegra_powergate_mutex);
+	for (i = 0; i < TEGRA_NUM_POWERGATE; i++) {
+		if (partitions[i].refs) {
+			pr_err("%s: partition %d still in use\n", __func__, i);
+			ret = -EBUSY;
+		} else if (pending[i]) {
+			powergate_off_locked(i);
+		}
+	}
+	mutex_unlock(&tegra_powergate_mutex);
+
+	return ret;
+}
+
+/* LP0 may have changed partition state behind our back, resync with it */
+void tegra_powergate_resume(void)
+{
+	unsigned long flags;
+	bool powered;
+	int i;
+
+	spin_lock_irqsave(&tegra_powergate_lock, flags);
+	for (i = 0; i < TEGRA_NUM_POWERGATE; i++) {
+		powered = !!(pmc_read(PWRGATE_STATUS) & (1 << i));
+		if (powered != partitions[i].powered)
+			powergate_account(i, powered, false);
+	}
+	spin_unlock_irqrestore(&tegra_powergate_lock, flags);
+}
+
+static int __init tegra_powergate_init(void)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&tegra_powergate_lock, flags);
+	for (i = 0; i < TEGRA_NUM_POWERGATE; i++) {
+		INIT_DELAYED_WORK(&partitions[i].off_work, powergate_off_work);
+		partitions[i].powered =
+			!!(pmc_read(PWRGATE_STATUS) & (1 << i));
+	}
+	spin_unlock_irqrestore(&tegra_powergate_lock, flags);
+
+	return 0;
+}
+arch_initcall(tegra_powergate_init);
+
 #ifdef CONFIG_DEBUG_FS
 
 static const char *powergate_name[] = {
@@ -194,14 +413,37 @@ static const char *powergate_name[] = {
 
 static int powergate_show(struct seq_file *s, void *data)
 {
+	struct powergate_partition pg;
+	unsigned long flags;
+	s64 cur;
 	int i;
 
-	seq_printf(s, " powergate powered\n");
-	seq_printf(s, "------------------\n");
+	seq_printf(s, " powergate powered refs toggles     on(ms)    off(ms)"
+		"  up(us)   max down(us)   max\n");
+	seq_printf(s, "------------------------------------------------------"
+		"----------------------------\n");
+
+	mutex_lock(&tegra_powergate_mutex);
+	for (i = 0; i < TEGRA_NUM_POWERGATE; i++) {
+		spin_lock_irqsave(&tegra_powergate_lock, flags);
+		pg = partitions[i];
+		spin_unlock_irqrestore(&tegra_powergate_lock, flags);
+
+		cur = ktime_to_us(ktime_sub(ktime_get(), pg.state_start));
+		if (pg.powered)
+			pg.on_us += cur;
+		else
+			pg.off_us += cur;
+
+		seq_printf(s, " %9s %7s %4d %7u %10llu %10llu %7u %5u %8u %5u\n",
+			powergate_name[i],
+			tegra_powergate_is_powered(i) ? "yes" : "no",
+			pg.refs, pg.toggles,
+			div_u64(pg.on_us, 1000), div_u64(pg.off_us, 1000),
+			pg.up_us, pg.up_max_us, pg.down_us, pg.down_max_us);
+	}
+	mutex_unlock(&tegra_powergate_mutex);
 
-	for (i = 0; i < TEGRA_NUM_POWERGATE; i++)
-		seq_printf(s, " %9s %7s\n", powergate_name[i],
-			tegra_powergate_is_powered(i) ? "yes" : "no");
 	return 0;
 }
 
@@ -34,6 +34,7 @@
 #include <linux/rfkill.h>
 #include <linux/mutex.h>
 #include <linux/regulator/consumer.h>
+#include <linux/async.h>
 
 #include <mach/hardware.h>
 #include <asm/mach-types.h>
@@ -361,9 +362,18 @@ static struct platform_driver shuttle_wlan_driver = {
 	},
 };
 
+static void __devinit shuttle_wlan_register(void *data, async_cookie_t cookie)
+{
+	if (platform_driver_register(&shuttle_wlan_driver))
+		pr_err("shuttle-pm-wlan: failed to register driver\n");
+}
+
 static int __devinit shuttle_wlan_init(void)
 {
-	return platform_driver_register(&shuttle_wlan_driver);
+	/* The probe powers the adapter up, which sleeps for some 30ms:
+	   let the other initcalls run meanwhile */
+	async_schedule(shuttle_wlan_register, NULL);
+	return 0;
 }
 
 static void shuttle_wlan_exit(void)
@@ -128,6 +128,19 @@ int spdif_set_sample_rate(unsigned long base, unsigned int sample_rate)
 	return 0;
 }
 
+/* Must be called after spdif_set_sample_rate(), which rewrites the
+ * channel status.
+ */
+void spdif_set_non_audio(unsigned long base, unsigned on)
+{
+	u32 val = spdif_readl(base, SPDIF_CH_STA_TX_A_0);
+
+	val &= ~SPDIF_CH_STA_TX_A_0_NON_AUDIO;
+	if (on)
+		val |= SPDIF_CH_STA_TX_A_0_NON_AUDIO;
+	spdif_writel(base, val, SPDIF_CH_STA_TX_A_0);
+}
+
 u32 spdif_get_control(unsigned long base)
 {
 	return spdif_readl(base, SPDIF_CTRL_0);
@@ -187,6 +187,14 @@ struct spi_tegra_data {
 	u32			*tx_bb;
 	dma_addr_t		tx_bb_phys;
 
+	/* 32 bit word transfers map the client buffers in place of the
+	 * bounce buffers when they are word aligned lowmem.
+	 */
+	dma_addr_t		tx_map;
+	dma_addr_t		rx_map;
+	bool			is_tx_mapped;
+	bool			is_rx_mapped;
+
 	bool			is_suspended;
 	unsigned long		save_slink_cmd;
 	callback client_funct;
@@ -279,6 +287,36 @@ static void spi_tegra_go(struct spi_tegra_data *tspi)
 	spi_tegra_writel(tspi, val, SLINK_DMA_CTL);
 }
 
+static bool spi_tegra_map_client_buf(struct spi_tegra_data *tspi,
+	void *buf, unsigned len, enum dma_data_direction dir, dma_addr_t *map)
+{
+	struct device *dev = &tspi->pdev->dev;
+
+	if (tspi->g_bits_per_word != 32 || !buf || !len)
+		return false;
+	if (((unsigned long)buf | len) & 0x3)
+		return false;
+	if (!virt_addr_valid(buf) || !virt_addr_valid(buf + len - 1))
+		return false;
+
+	*map = dma_map_single(dev, buf, len, dir);
+	return !dma_mapping_error(dev, *map);
+}
+
+static void spi_tegra_unmap_client_bufs(struct spi_tegra_data *tspi)
+{
+	struct device *dev = &tspi->pdev->dev;
+
+	if (tspi->is_tx_mapped)
+		dma_unmap_single(dev, tspi->tx_map, tspi->cur_len,
+				DMA_TO_DEVICE);
+	if (tspi->is_rx_mapped)
+		dma_unmap_single(dev, tspi->rx_map, tspi->cur_len,
+				DMA_FROM_DEVICE);
+	tspi->is_tx_mapped = false;
+	tspi->is_rx_mapped = false;
+}
+
 static unsigned spi_tegra_fill_tx_fifo(struct spi_tegra_data *tspi,
 				struct spi_transfer *t)
 {
@@ -293,8 +331,20 @@ static unsigned spi_tegra_fill_tx_fifo(struct spi_tegra_data *tspi,
 	val |= SLINK_WORD_SIZE(len / tspi->cur_bytes_per_word - 1);
 	spi_tegra_writel(tspi, val, SLINK_COMMAND);
 
+	tspi->is_tx_mapped = spi_tegra_map_client_buf(tspi, tx_buf, len,
+					DMA_TO_DEVICE, &tspi->tx_map);
+	tspi->tx_dma_req.source_addr = tspi->is_tx_mapped ?
+					tspi->tx_map : tspi->tx_bb_phys;
+
+	tspi->is_rx_mapped = t->rx_buf && spi_tegra_map_client_buf(tspi,
+					t->rx_buf + tspi->cur_pos, len,
+					DMA_FROM_DEVICE, &tspi->rx_map);
+	tspi->rx_dma_req.dest_addr = tspi->is_rx_mapped ?
+					tspi->rx_map : tspi->rx_bb_phys;
+
 	if (tspi->g_bits_per_word == 32) {
-		memcpy(tspi->tx_bb, (void *)tx_buf, len);
+		if (!tspi->is_tx_mapped)
+			memcpy(tspi->tx_bb, (void *)tx_buf, len);
 	} else {
 		for (i = 0; i < len; i += tspi->cur_bytes_per_word) {
 			val = 0;
@@ -318,6 +368,11 @@ static unsigned spi_tegra_drain_rx_fifo(struct spi_tegra_data *tspi,
 	int i, j;
 	u8 *rx_buf = (u8 *)t->rx_buf + tspi->cur_pos;
 	unsigned long val;
+	bool was_rx_mapped = tspi->is_rx_mapped;
+
+	spi_tegra_unmap_client_bufs(tspi);
+	if (was_rx_mapped)
+		return len;
 
 	if (tspi->g_bits_per_word == 32) {
 		memcpy(rx_buf, (void *)tspi->rx_bb, len);
@@ -529,9 +584,12 @@ static void complete_operation(struct tegra_dma_req *req)
 			struct spi_transfer, transfer_list);
 		spi_tegra_start_transfer(spi, tspi->cur);
 	} else {
-		list_del(&m->queue);
+		struct spi_message *done = m;
 
-		m->complete(m->context);
+		/* arm the next message before the client sees this one, the
+		 * master may start clocking as soon as we signal ready
+		 */
+		list_del(&m->queue);
 
 		if (!list_empty(&tspi->queue)) {
 			m = list_first_entry(&tspi->queue, struct spi_message,
@@ -542,6 +600,8 @@ static void complete_operation(struct tegra_dma_req *req)
 			clk_disable(tspi->clk);
 			tspi->cur_speed = 0;
 		}
+
+		done->complete(done->context);
 	}
 }
 
@@ -31,11 +31,15 @@
 #include <linux/err.h>
 #include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/device.h>
+#include <linux/platform_device.h>
+#include <linux/pm.h>
 #include <linux/suspend.h>
 #include <linux/slab.h>
 #include <linux/serial_reg.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
+#include <linux/wakelock.h>
 
 #include <linux/regulator/machine.h>
 
@@ -51,13 +55,15 @@
 #include <mach/iovmm.h>
 #include <mach/irqs.h>
 #include <mach/legacy_irq.h>
+#include <mach/powergate.h>
 #include <mach/suspend.h>
 
 #include "board.h"
 #include "power.h"
+#include "tegra2_emc.h"
 
 #ifdef CONFIG_TRUSTED_FOUNDATIONS
-void callGenericSMC(u32 param0, u32 param1, u32 param2)
+static void __callGenericSMC(u32 param0, u32 param1, u32 param2)
 {
 	__asm__ volatile(
 		"mov r0, %2\n"
@@ -74,6 +80,154 @@ void callGenericSMC(u32 param0, u32 param1, u32 param2)
 		: "r0", "r1", "r2", "r3", "r4");
 }
 u32 buffer_rdv[64];
+
+/*
+ * Every SMC is a world switch into the secure monitor.  They are counted
+ * and timed per command so their share of idle entry and exit latency
+ * can be read back from debugfs (tegra_smc).
+ */
+struct tegra_smc_stat {
+	u32		param0;
+	u32		param1;
+	const char	*name;
+	unsigned long	count;
+	unsigned long	skipped;
+	u64		total_ns;
+	u64		max_ns;
+};
+
+#define TEGRA_SMC_BOOT_VECTOR	4
+
+static struct tegra_smc_stat tegra_smc_stats[] = {
+	{ 0xFFFFF100, 0x00000001, "l2 enable" },
+	{ 0xFFFFF100, 0x00000002, "l2 disable" },
+	{ 0xFFFFFFFC, 0xFFFFFFE3, "lp0/lp1 save" },
+	{ 0xFFFFFFFC, 0xFFFFFFE4, "lp2 save" },
+	[TEGRA_SMC_BOOT_VECTOR] = { 0xFFFFFFFC, 0xFFFFFFE5, "boot vector" },
+	{ 0, 0, "other" },
+};
+static DEFINE_SPINLOCK(tegra_smc_lock);
+
+/* last CPU1 boot vector given to the monitor, 0 when unknown */
+static u32 tegra_smc_boot_vector;
+static DEFINE_SPINLOCK(tegra_smc_boot_vector_lock);
+
+static struct tegra_smc_stat *tegra_smc_find_stat(u32 param0, u32 param1)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tegra_smc_stats) - 1; i++)
+		if (tegra_smc_stats[i].param0 == param0 &&
+		    tegra_smc_stats[i].param1 == param1)
+			break;
+	return &tegra_smc_stats[i];
+}
+
+void callGenericSMC(u32 param0, u32 param1, u32 param2)
+{
+	struct tegra_smc_stat *st = tegra_smc_find_stat(param0, param1);
+	unsigned long flags;
+	u64 t;
+
+	t = sched_clock();
+	__callGenericSMC(param0, param1, param2);
+	t = sched_clock() - t;
+
+	spin_lock_irqsave(&tegra_smc_lock, flags);
+	st->count++;
+	st->total_ns += t;
+	if (t > st->max_ns)
+		st->max_ns = t;
+	spin_unlock_irqrestore(&tegra_smc_lock, flags);
+}
+
+/*
+ * The monitor keeps the CPU1 boot vector until it is reinitialised on
+ * warm boot from LP0/LP1, so only tell it about a new one.  LP2 exit
+ * brings CPU1 back through the same vector every time.
+ */
+void tegra_smc_set_boot_vector(u32 boot_vector)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tegra_smc_boot_vector_lock, flags);
+	if (boot_vector == tegra_smc_boot_vector) {
+		spin_lock(&tegra_smc_lock);
+		tegra_smc_stats[TEGRA_SMC_BOOT_VECTOR].skipped++;
+		spin_unlock(&tegra_smc_lock);
+	} else {
+		callGenericSMC(0xFFFFFFFC, 0xFFFFFFE5, boot_vector);
+		tegra_smc_boot_vector = boot_vector;
+	}
+	spin_unlock_irqrestore(&tegra_smc_boot_vector_lock, flags);
+}
+
+static void tegra_smc_forget_boot_vector(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tegra_smc_boot_vector_lock, flags);
+	tegra_smc_boot_vector = 0;
+	spin_unlock_irqrestore(&tegra_smc_boot_vector_lock, flags);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int tegra_smc_debug_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	seq_printf(s, "command          count    skipped   total (us)   max (us)\n");
+	spin_lock_irq(&tegra_smc_lock);
+	for (i = 0; i < ARRAY_SIZE(tegra_smc_stats); i++) {
+		struct tegra_smc_stat *st = &tegra_smc_stats[i];
+
+		seq_printf(s, "%-12s %9lu %10lu %12llu %10llu\n", st->name,
+			st->count, st->skipped, div_u64(st->total_ns, 1000),
+			div_u64(st->max_ns, 1000));
+	}
+	spin_unlock_irq(&tegra_smc_lock);
+	return 0;
+}
+
+static int tegra_smc_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_smc_debug_show, NULL);
+}
+
+/* any write clears the counters */
+static ssize_t tegra_smc_debug_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	int i;
+
+	spin_lock_irq(&tegra_smc_lock);
+	for (i = 0; i < ARRAY_SIZE(tegra_smc_stats); i++) {
+		tegra_smc_stats[i].count = 0;
+		tegra_smc_stats[i].skipped = 0;
+		tegra_smc_stats[i].total_ns = 0;
+		tegra_smc_stats[i].max_ns = 0;
+	}
+	spin_unlock_irq(&tegra_smc_lock);
+	return count;
+}
+
+static const struct file_operations tegra_smc_debug_fops = {
+	.open		= tegra_smc_debug_open,
+	.read		= seq_read,
+	.write		= tegra_smc_debug_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_smc_debug_init(void)
+{
+	if (!debugfs_create_file("tegra_smc", 0644, NULL, NULL,
+				 &tegra_smc_debug_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(tegra_smc_debug_init);
+#endif
 #endif
 
 /**************** END TL *********************/
@@ -164,6 +318,21 @@ static enum tegra_suspend_mode current_suspend_mode;
 
 static unsigned int tegra_time_in_suspend[32];
 
+/* the slowest devices of the last resume, slowest first */
+#define TEGRA_RESUME_TIMES	16
+
+struct tegra_resume_time {
+	char name[24];
+	s64 usecs;
+	int error;
+	bool async;
+};
+
+static DEFINE_SPINLOCK(tegra_resume_time_lock);
+static struct tegra_resume_time tegra_resume_times[TEGRA_RESUME_TIMES];
+static unsigned int tegra_resume_devices;
+static s64 tegra_resume_usecs;
+
 static inline unsigned int time_to_bin(unsigned int time)
 {
 	return fls(time);
@@ -495,6 +664,10 @@ static void tegra_suspend_dram(bool do_lp0)
 #endif
 	__cortex_a9_save(mode);
 	restore_cpu_complex();
+#ifdef CONFIG_TRUSTED_FOUNDATIONS
+	/* the monitor came back through warm boot */
+	tegra_smc_forget_boot_vector();
+#endif
 
 	writel(orig, evp_reset);
 #ifdef CONFIG_CACHE_L2X0
@@ -505,6 +678,9 @@ static void tegra_suspend_dram(bool do_lp0)
 		memcpy(iram_code, iram_save, iram_save_size);
 		tegra_legacy_irq_restore_mask();
 	} else {
+		/* warm boot reprogrammed the emc from its own table */
+		tegra_emc_forget_shadow();
+
 		/* for platforms where the core & CPU power requests are
 		 * combined as a single request to the PMU, transition out
 		 * of LP0 state by temporarily enabling both requests
@@ -521,19 +697,144 @@ static void tegra_suspend_dram(bool do_lp0)
 	wmb();
 }
 
+static const struct tegra_suspend_async_dev *tegra_async_dev(
+	const char *name)
+{
+	int i;
+
+	for (i = 0; i < pdata->num_async_devs; i++)
+		if (!strcmp(pdata->async_devs[i].name, name))
+			return &pdata->async_devs[i];
+	return NULL;
+}
+
+static void tegra_async_wait_for(struct device *dev, const char *name)
+{
+	struct device *other;
+
+	other = bus_find_device_by_name(&platform_bus_type, NULL, name);
+	if (other) {
+		device_pm_wait_for_dev(dev, other);
+		put_device(other);
+	}
+}
+
+/* Hold back the devices that @dev was declared to come after */
+static void tegra_async_suspend_prepare(struct device *dev)
+{
+	int i;
+
+	for (i = 0; i < pdata->num_async_devs; i++) {
+		const struct tegra_suspend_async_dev *a = &pdata->async_devs[i];
+
+		if (a->after && !strcmp(a->after, dev_name(dev)))
+			tegra_async_wait_for(dev, a->name);
+	}
+}
+
+static void tegra_async_resume_prepare(struct device *dev)
+{
+	const struct tegra_suspend_async_dev *a = tegra_async_dev(dev_name(dev));
+
+	if (a && a->after)
+		tegra_async_wait_for(dev, a->after);
+}
+
+static void tegra_resume_report(struct device *dev, s64 usecs, int error)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&tegra_resume_time_lock, flags);
+	tegra_resume_devices++;
+	tegra_resume_usecs += usecs;
+
+	for (i = 0; i < TEGRA_RESUME_TIMES; i++)
+		if (usecs > tegra_resume_times[i].usecs)
+			break;
+	if (i < TEGRA_RESUME_TIMES) {
+		memmove(&tegra_resume_times[i + 1], &tegra_resume_times[i],
+			(TEGRA_RESUME_TIMES - i - 1) *
+			sizeof(tegra_resume_times[0]));
+		strlcpy(tegra_resume_times[i].name, dev_name(dev),
+			sizeof(tegra_resume_times[i].name));
+		tegra_resume_times[i].usecs = usecs;
+		tegra_resume_times[i].error = error;
+		tegra_resume_times[i].async = dev->power.async_suspend;
+	}
+	spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+}
+
+static const struct dpm_platform_ops tegra_dpm_ops = {
+	.suspend_prepare	= tegra_async_suspend_prepare,
+	.resume_prepare		= tegra_async_resume_prepare,
+	.resume_report		= tegra_resume_report,
+};
+
+static int tegra_async_mark(struct device *dev, void *data)
+{
+	if (tegra_async_dev(dev_name(dev)))
+		device_enable_async_suspend(dev);
+	return 0;
+}
+
+static int tegra_async_notify(struct notifier_block *nb,
+	unsigned long action, void *data)
+{
+	if (action == BUS_NOTIFY_ADD_DEVICE)
+		tegra_async_mark(data, NULL);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block tegra_async_nb = {
+	.notifier_call = tegra_async_notify,
+};
+
+static void __init tegra_init_async_suspend(void)
+{
+	if (pdata->num_async_devs) {
+		bus_register_notifier(&platform_bus_type, &tegra_async_nb);
+		bus_for_each_dev(&platform_bus_type, NULL, NULL,
+			tegra_async_mark);
+	}
+	dpm_set_platform_ops(&tegra_dpm_ops);
+}
+
 static int tegra_suspend_begin(suspend_state_t state)
 {
+	unsigned long flags;
+
+	spin_lock_irqsave(&tegra_resume_time_lock, flags);
+	memset(tegra_resume_times, 0, sizeof(tegra_resume_times));
+	tegra_resume_devices = 0;
+	tegra_resume_usecs = 0;
+	spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+
 	return regulator_suspend_prepare(state);
 }
 
 static int tegra_suspend_prepare_late(void)
 {
+	int err;
+
 	disable_irq(INT_SYS_STATS_MON);
-	return tegra_iovmm_suspend();
+	err = tegra_iovmm_suspend();
+	if (err)
+		return err;
+
+	if (current_suspend_mode == TEGRA_SUSPEND_LP0) {
+		err = tegra_powergate_suspend();
+		if (err)
+			return err;
+	}
+
+	/* tegra_suspend_wake() undoes the above if this aborts */
+	return suspend_abort_check("prepare_late");
 }
 
 static void tegra_suspend_wake(void)
 {
+	tegra_powergate_resume();
 	tegra_iovmm_resume();
 	enable_irq(INT_SYS_STATS_MON);
 }
@@ -782,6 +1083,7 @@ void __init tegra_init_suspend(struct tegra_suspend_platform_data *plat)
 	if (pdata->suspend_mode == TEGRA_SUSPEND_LP0)
 		lp0_suspend_init();
 
+	tegra_init_async_suspend();
 	suspend_set_ops(&tegra_suspend_ops);
 #endif
 
@@ -854,6 +1156,21 @@ static int tegra_suspend_time_debug_show(struct seq_file *s, void *data)
 			bin ? 1 << (bin - 1) : 0, 1 << bin,
 			tegra_time_in_suspend[bin]);
 	}
+
+	spin_lock_irq(&tegra_resume_time_lock);
+	seq_printf(s, "\nlast resume: %u devices, %lld us in callbacks\n",
+		tegra_resume_devices, tegra_resume_usecs);
+	seq_printf(s, "device                       time (us)  async  error\n");
+	seq_printf(s, "--------------------------------------------------\n");
+	for (bin = 0; bin < TEGRA_RESUME_TIMES; bin++) {
+		struct tegra_resume_time *t = &tegra_resume_times[bin];
+
+		if (!t->name[0])
+			break;
+		seq_printf(s, "%-24s %13lld  %5s  %5d\n", t->name, t->usecs,
+			t->async ? "yes" : "no", t->error);
+	}
+	spin_unlock_irq(&tegra_resume_time_lock);
 	return 0;
 }
 
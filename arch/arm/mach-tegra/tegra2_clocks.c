@@ -1061,6 +1061,7 @@ static long tegra2_emc_clk_round_rate(struct clk *c, unsigned long rate)
 
 static int tegra2_emc_clk_set_rate(struct clk *c, unsigned long rate)
 {
+	ktime_t start = ktime_get();
 	int ret;
 	/* The Tegra2 memory controller has an interlock with the clock
 	 * block that allows memory shadowed registers to be updated,
@@ -1073,6 +1074,9 @@ static int tegra2_emc_clk_set_rate(struct clk *c, unsigned long rate)
 	ret = tegra2_periph_clk_set_rate(c, rate);
 	udelay(1);
 
+	if (!ret)
+		tegra_emc_switch_done(start);
+
 	return ret;
 }
 
@@ -2094,6 +2098,7 @@ struct clk tegra_list_clks[] = {
 	SHARED_CLK("disp2.emc",	"tegradc.1",		"emc",	&tegra_clk_emc),
 	SHARED_CLK("hdmi.emc",	"hdmi",			"emc",	&tegra_clk_emc),
 	SHARED_CLK("host.emc",	"tegra_grhost",		"emc",	&tegra_clk_emc),
+	SHARED_CLK("gov.emc",	"tegra_emc_gov",	"emc",	&tegra_clk_emc),
 	SHARED_CLK("usbd.emc",	"fsl-tegra-udc",	"emc",	&tegra_clk_emc),
 	SHARED_CLK("usb1.emc",	"tegra-ehci.0",		"emc",	&tegra_clk_emc),
 	SHARED_CLK("usb2.emc",	"tegra-ehci.1",		"emc",	&tegra_clk_emc),
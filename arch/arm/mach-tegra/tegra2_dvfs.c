@@ -50,6 +50,29 @@ static const int core_speedo_nominal_millivolts[] =
 /* spedo_id  0,    1,    2 */
 	{ 1225, 1225, 1300 };
 
+/*
+ * The tables above are for the slowest chip of each process corner.
+ * Chips near the fast end of their corner get part of the margin back.
+ */
+static const int cpu_sub_corner_offset_millivolts[] =
+/* sub corner 0,  1,   2,   3 */
+	{    0,  0, -25, -25 };
+
+static const int core_sub_corner_offset_millivolts[] =
+/* sub corner 0,  1,   2,   3 */
+	{    0,  0,   0, -25 };
+
+/*
+ * Further undervolt validated for this particular chip, e.g. by a stress
+ * test run from userspace that stores the result and passes it back on
+ * the command line as tegra2_dvfs.cpu_undervolt_mv=.
+ */
+#define TEGRA_DVFS_MAX_UNDERVOLT	100
+
+static int cpu_undervolt_mv;
+static int core_undervolt_mv;
+static bool tegra2_dvfs_initialized;
+
 #define KHZ 1000
 #define MHZ 1000000
 
@@ -293,6 +316,52 @@ module_param_cb(disable_core, &tegra_dvfs_disable_core_ops,
 module_param_cb(disable_cpu, &tegra_dvfs_disable_cpu_ops,
 	&tegra_dvfs_cpu_disabled, 0644);
 
+static void tegra2_dvfs_apply_offsets(void)
+{
+	int cpu_sub = tegra_cpu_sub_corner();
+	int core_sub = tegra_core_sub_corner();
+
+	BUG_ON(cpu_sub >= ARRAY_SIZE(cpu_sub_corner_offset_millivolts));
+	BUG_ON(core_sub >= ARRAY_SIZE(core_sub_corner_offset_millivolts));
+
+	tegra_dvfs_rail_set_offset(&tegra2_dvfs_rail_vdd_cpu,
+		cpu_sub_corner_offset_millivolts[cpu_sub] - cpu_undervolt_mv);
+	tegra_dvfs_rail_set_offset(&tegra2_dvfs_rail_vdd_core,
+		core_sub_corner_offset_millivolts[core_sub] - core_undervolt_mv);
+}
+
+static int tegra_dvfs_undervolt_set(const char *arg,
+	const struct kernel_param *kp)
+{
+	int ret;
+	int old = *(int *)kp->arg;
+
+	ret = param_set_int(arg, kp);
+	if (ret)
+		return ret;
+
+	if (*(int *)kp->arg < 0 ||
+	    *(int *)kp->arg > TEGRA_DVFS_MAX_UNDERVOLT) {
+		*(int *)kp->arg = old;
+		return -EINVAL;
+	}
+
+	if (tegra2_dvfs_initialized)
+		tegra2_dvfs_apply_offsets();
+
+	return 0;
+}
+
+static struct kernel_param_ops tegra_dvfs_undervolt_ops = {
+	.set = tegra_dvfs_undervolt_set,
+	.get = param_get_int,
+};
+
+module_param_cb(cpu_undervolt_mv, &tegra_dvfs_undervolt_ops,
+	&cpu_undervolt_mv, 0644);
+module_param_cb(core_undervolt_mv, &tegra_dvfs_undervolt_ops,
+	&core_undervolt_mv, 0644);
+
 void __init tegra2_init_dvfs(void)
 {
 	int i;
@@ -347,6 +416,9 @@ void __init tegra2_init_dvfs(void)
 				c->name);
 	}
 
+	tegra2_dvfs_apply_offsets();
+	tegra2_dvfs_initialized = true;
+
 	if (tegra_dvfs_core_disabled)
 		tegra_dvfs_rail_disable(&tegra2_dvfs_rail_vdd_core);
 
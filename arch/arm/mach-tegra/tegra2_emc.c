@@ -18,10 +18,15 @@
 #include <linux/kernel.h>
 #include <linux/delay.h>
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/err.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
 
+#include <mach/frame_timeline.h>
 #include <mach/iomap.h>
 
 #include "tegra2_emc.h"
@@ -42,6 +47,26 @@ static void __iomem *emc = IO_ADDRESS(TEGRA_EMC_BASE);
 static const struct tegra_emc_table *tegra_emc_table;
 static int tegra_emc_table_size;
 
+/*
+ * emc_delta[from * size + to] has a bit set for every register that differs
+ * between the two table entries, so a switch only rewrites those.  The shadow
+ * registers hold the values of emc_shadow_entry, -1 until the first switch.
+ * All of this is serialized by the emc clock lock.
+ */
+typedef unsigned long emc_reg_mask_t[BITS_TO_LONGS(TEGRA_EMC_NUM_REGS)];
+static emc_reg_mask_t *emc_delta;
+static int emc_shadow_entry = -1;
+
+struct emc_switch_stat {
+	unsigned long	count;
+	u64		total_ns;
+	u32		max_ns;
+};
+
+/* indexed like emc_delta */
+static struct emc_switch_stat *emc_switch_stats;
+static int emc_switch_from = -1;
+
 static inline void emc_writel(u32 val, unsigned long addr)
 {
 	writel(val, emc + addr);
@@ -156,7 +181,7 @@ static void tegra_emc_config_clk_change(void)
         case 2: /* LPDDR2 */
 
             // Dummy mode control command to activate PD state machine
-            emc_writel(EMC_MRW_0, NULL_DEV_SELECTN << 30);
+            emc_writel(NULL_DEV_SELECTN << 30, EMC_MRW_0);
 					
             udelay(NVRM_CLOCK_CHANGE_DELAY);
 
@@ -167,7 +192,7 @@ static void tegra_emc_config_clk_change(void)
         case 3: /* DDR2 */
 
             // Dummy mode control command to activate PD state machine
-            emc_writel(EMC_MRS_0, NULL_DEV_SELECTN << 30);
+            emc_writel(NULL_DEV_SELECTN << 30, EMC_MRS_0);
 			
             udelay(NVRM_CLOCK_CHANGE_DELAY);
 
@@ -181,7 +206,7 @@ static void tegra_emc_config_clk_change(void)
     }
 	
     cfg2 |= 0x00000001; /* allows EMC and CAR to handshake on PLL divider/source changes. */
-    emc_writel(EMC_CFG_2_0, cfg2);
+    emc_writel(cfg2, EMC_CFG_2_0);
 }
 
 
@@ -228,6 +253,8 @@ long tegra_emc_round_rate(unsigned long rate)
  * multiple frequency changes */
 int tegra_emc_set_rate(unsigned long rate)
 {
+	const unsigned long *mask = NULL;
+	const u32 *regs;
 	int i;
 	int j;
 
@@ -247,14 +274,99 @@ int tegra_emc_set_rate(unsigned long rate)
 
 	pr_debug("%s: setting to %lu\n", __func__, rate);
 
-	for (j = 0; j < TEGRA_EMC_NUM_REGS; j++)
-		emc_writel(tegra_emc_table[i].regs[j], emc_reg_addr[j]);
+	emc_switch_from = emc_shadow_entry;
+	if (i == emc_shadow_entry)
+		return 0;
+
+	if (emc_delta && emc_shadow_entry >= 0)
+		mask = emc_delta[emc_shadow_entry * tegra_emc_table_size + i];
+
+	regs = tegra_emc_table[i].regs;
+	if (mask) {
+		for_each_set_bit(j, mask, TEGRA_EMC_NUM_REGS)
+			emc_writel(regs[j], emc_reg_addr[j]);
+	} else {
+		for (j = 0; j < TEGRA_EMC_NUM_REGS; j++)
+			emc_writel(regs[j], emc_reg_addr[j]);
+	}
 
-	emc_readl(tegra_emc_table[i].regs[TEGRA_EMC_NUM_REGS - 1]);
+	/* make sure the shadow writes landed before the clock changes */
+	emc_readl(emc_reg_addr[TEGRA_EMC_NUM_REGS - 1]);
+	emc_shadow_entry = i;
 
 	return 0;
 }
 
+/*
+ * Called by the emc clock after the switch started by the last
+ * tegra_emc_set_rate() completed, @start is taken before that call.
+ */
+void tegra_emc_switch_done(ktime_t start)
+{
+	struct emc_switch_stat *stat;
+	u32 ns;
+
+	tegra_ftl_emc_switch(start, ktime_get());
+
+	if (!emc_switch_stats || emc_switch_from < 0 || emc_shadow_entry < 0)
+		return;
+
+	ns = (u32)min_t(s64, ktime_to_ns(ktime_sub(ktime_get(), start)),
+			UINT_MAX);
+	stat = &emc_switch_stats[emc_switch_from * tegra_emc_table_size +
+				 emc_shadow_entry];
+	stat->count++;
+	stat->total_ns += ns;
+	if (ns > stat->max_ns)
+		stat->max_ns = ns;
+}
+
+/* The next switch rewrites every register, e.g. after LP0 */
+void tegra_emc_forget_shadow(void)
+{
+	emc_shadow_entry = -1;
+}
+
+static void tegra_emc_init_delta(void)
+{
+	int n = tegra_emc_table_size;
+	int from, to, j;
+
+	emc_delta = kcalloc(n * n, sizeof(*emc_delta), GFP_KERNEL);
+	emc_switch_stats = kcalloc(n * n, sizeof(*emc_switch_stats),
+				   GFP_KERNEL);
+	if (!emc_delta) {
+		pr_warn("%s: no memory, rewriting all registers on switch\n",
+			__func__);
+		return;
+	}
+
+	for (from = 0; from < n; from++)
+		for (to = 0; to < n; to++)
+			for (j = 0; j < TEGRA_EMC_NUM_REGS; j++)
+				if (tegra_emc_table[from].regs[j] !=
+				    tegra_emc_table[to].regs[j])
+					__set_bit(j, emc_delta[from * n + to]);
+}
+
+/* Number of EMC table entries available for scaling, 0 when disabled */
+int tegra_emc_table_steps(void)
+{
+	if (!tegra_emc_table || !emc_enable)
+		return 0;
+
+	return tegra_emc_table_size;
+}
+
+/* EMC clock rate of a table entry, the table is sorted by rate */
+unsigned long tegra_emc_step_rate(int step)
+{
+	if (!tegra_emc_table || step < 0 || step >= tegra_emc_table_size)
+		return 0;
+
+	return tegra_emc_table[step].rate * 2 * 1000;
+}
+
 void tegra_init_emc(const struct tegra_emc_chip *chips, int chips_size)
 {
 	int i;
@@ -297,6 +409,7 @@ void tegra_init_emc(const struct tegra_emc_chip *chips, int chips_size)
 			chips[chip_matched].description);
 		tegra_emc_table = chips[chip_matched].table;
 		tegra_emc_table_size = chips[chip_matched].table_size;
+		tegra_emc_init_delta();
 		
 		/* configure the clock change mechanism of tegra */
 		tegra_emc_config_clk_change();
@@ -310,3 +423,59 @@ void tegra_init_emc(const struct tegra_emc_chip *chips, int chips_size)
 		pr_info("%s: Memory pid     = 0x%04x", __func__, pid);
 	}
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int emc_switch_show(struct seq_file *s, void *data)
+{
+	int n = tegra_emc_table_size;
+	int from, to;
+
+	if (!emc_switch_stats)
+		return 0;
+
+	seq_printf(s, "%9s %9s %8s %8s %8s\n",
+		   "from kHz", "to kHz", "count", "avg us", "max us");
+	for (from = 0; from < n; from++) {
+		for (to = 0; to < n; to++) {
+			struct emc_switch_stat *stat =
+				&emc_switch_stats[from * n + to];
+
+			if (!stat->count)
+				continue;
+
+			seq_printf(s, "%9lu %9lu %8lu %8llu %8u\n",
+				   tegra_emc_table[from].rate * 2,
+				   tegra_emc_table[to].rate * 2, stat->count,
+				   div_u64(stat->total_ns, stat->count * 1000),
+				   stat->max_ns / 1000);
+		}
+	}
+
+	return 0;
+}
+
+static int emc_switch_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, emc_switch_show, inode->i_private);
+}
+
+static const struct file_operations emc_switch_fops = {
+	.open		= emc_switch_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_emc_debugfs_init(void)
+{
+	if (!tegra_emc_table)
+		return 0;
+
+	if (!debugfs_create_file("emc_switch", S_IRUGO, NULL, NULL,
+				 &emc_switch_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+late_initcall(tegra_emc_debugfs_init);
+#endif
@@ -15,6 +15,8 @@
  *
  */
 
+#include <linux/ktime.h>
+
 #define TEGRA_EMC_NUM_REGS 46
 
 struct tegra_emc_table {
@@ -34,5 +36,9 @@ struct tegra_emc_chip {
 };
 
 int tegra_emc_set_rate(unsigned long rate);
+void tegra_emc_switch_done(ktime_t start);
+void tegra_emc_forget_shadow(void);
 long tegra_emc_round_rate(unsigned long rate);
+int tegra_emc_table_steps(void);
+unsigned long tegra_emc_step_rate(int step);
 void tegra_init_emc(const struct tegra_emc_chip *chips, int chips_size);
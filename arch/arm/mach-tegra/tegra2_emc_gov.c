@@ -0,0 +1,379 @@
+/*
+ * arch/arm/mach-tegra/tegra2_emc_gov.c
+ *
+ * Closed-loop EMC frequency governor.  Reads the memory controller
+ * utilization counters and walks the EMC table to keep utilization
+ * inside a target band.
+ *
+ * Copyright (C) 2010 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/clk.h>
+#include <linux/err.h>
+#include <linux/io.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <mach/iomap.h>
+
+#include "tegra2_emc.h"
+#include "tegra2_mc.h"
+
+/*
+ * Every sample_ms the fraction of EMC clocks that carried a request is
+ * read from the MC statistics counter.  Above up_threshold percent the
+ * governor asks for the lowest step that brings utilization back to the
+ * middle of the band, and above boost_threshold it jumps straight to the
+ * top step, so that a 3D or video load gets bandwidth before the display
+ * FIFOs run dry.  Below down_threshold it walks down one step per sample,
+ * but only once utilization has stayed low for down_delay_ms.
+ *
+ * The request goes through a user of the shared EMC bus, so the floors
+ * from the display, host1x and the other bus users still apply; the
+ * governor can only ask for more than they do.
+ */
+static bool enabled = true;
+static unsigned int sample_ms = 20;
+static unsigned int up_threshold = 70;
+static unsigned int down_threshold = 40;
+static unsigned int boost_threshold = 90;
+static unsigned int down_delay_ms = 100;
+
+module_param(sample_ms, uint, 0644);
+module_param(up_threshold, uint, 0644);
+module_param(down_threshold, uint, 0644);
+module_param(boost_threshold, uint, 0644);
+module_param(down_delay_ms, uint, 0644);
+
+static void __iomem *mc = IO_ADDRESS(TEGRA_MC_BASE);
+
+static DEFINE_MUTEX(emc_gov_lock);
+static struct delayed_work emc_gov_work;
+static struct clk *emc_gov_clk;
+static struct clk *emc_clk;
+static int emc_gov_steps;
+static int emc_gov_step;
+static bool emc_gov_running;
+static unsigned long emc_gov_last_busy;
+
+static struct {
+	u64 *time_in_step;
+	u64 last_change;
+	unsigned int util;
+	unsigned int raise;
+	unsigned int boost;
+	unsigned int lower;
+} emc_gov_stats;
+
+static inline void mc_writel(u32 val, unsigned long addr)
+{
+	writel(val, mc + addr);
+}
+
+static inline u32 mc_readl(unsigned long addr)
+{
+	return readl(mc + addr);
+}
+
+/* Count every qualified request from every client on counter 0 */
+static void emc_gov_stat_start(void)
+{
+	u32 reg;
+
+	mc_writel(MC_STAT_CONTROL_0_EMC_GATHER_DISABLE <<
+		MC_STAT_CONTROL_0_EMC_GATHER_SHIFT, MC_STAT_CONTROL_0);
+
+	reg = (ARMC_STAT_CONTROL_MODE_BANDWIDTH <<
+			ARMC_STAT_CONTROL_MODE_SHIFT) |
+		(ARMC_STAT_CONTROL_EVENT_QUALIFIED <<
+			ARMC_STAT_CONTROL_EVENT_SHIFT) |
+		(ARMC_STAT_CONTROL_FILTER_PRI_DISABLE <<
+			ARMC_STAT_CONTROL_FILTER_PRI_SHIFT) |
+		(ARMC_STAT_CONTROL_FILTER_COALESCED_DISABLE <<
+			ARMC_STAT_CONTROL_FILTER_COALESCED_SHIFT) |
+		(ARMC_STAT_CONTROL_FILTER_CLIENT_DISABLE <<
+			ARMC_STAT_CONTROL_FILTER_CLIENT_SHIFT) |
+		(ARMC_STAT_CONTROL_FILTER_ADDR_DISABLE <<
+			ARMC_STAT_CONTROL_FILTER_ADDR_SHIFT);
+
+	mc_writel(0xFFFFFFFF, MC_STAT_EMC_CLOCK_LIMIT_0);
+	mc_writel(reg, MC_STAT_EMC_CONTROL_0_0);
+
+	mc_writel(MC_STAT_CONTROL_0_EMC_GATHER_CLEAR <<
+		MC_STAT_CONTROL_0_EMC_GATHER_SHIFT, MC_STAT_CONTROL_0);
+	mc_writel(MC_STAT_CONTROL_0_EMC_GATHER_ENABLE <<
+		MC_STAT_CONTROL_0_EMC_GATHER_SHIFT, MC_STAT_CONTROL_0);
+}
+
+/* Returns the utilization in percent since the last call, and restarts */
+static unsigned int emc_gov_stat_sample(void)
+{
+	u32 clocks;
+	u32 count;
+
+	mc_writel(MC_STAT_CONTROL_0_EMC_GATHER_DISABLE <<
+		MC_STAT_CONTROL_0_EMC_GATHER_SHIFT, MC_STAT_CONTROL_0);
+	clocks = mc_readl(MC_STAT_EMC_CLOCKS_0);
+	count = mc_readl(MC_STAT_EMC_COUNT_0_0);
+
+	mc_writel(MC_STAT_CONTROL_0_EMC_GATHER_CLEAR <<
+		MC_STAT_CONTROL_0_EMC_GATHER_SHIFT, MC_STAT_CONTROL_0);
+	mc_writel(MC_STAT_CONTROL_0_EMC_GATHER_ENABLE <<
+		MC_STAT_CONTROL_0_EMC_GATHER_SHIFT, MC_STAT_CONTROL_0);
+
+	if (!clocks)
+		return 0;
+	if (count >= clocks)
+		return 100;
+	return div_u64((u64)count * 100, clocks);
+}
+
+static int emc_gov_rate_to_step(unsigned long rate)
+{
+	int i;
+
+	for (i = 0; i < emc_gov_steps - 1; i++)
+		if (tegra_emc_step_rate(i) >= rate)
+			break;
+	return i;
+}
+
+static void emc_gov_set_step(int step)
+{
+	u64 now = get_jiffies_64();
+
+	emc_gov_stats.time_in_step[emc_gov_step] +=
+		now - emc_gov_stats.last_change;
+	emc_gov_stats.last_change = now;
+
+	if (step == emc_gov_step)
+		return;
+
+	if (step > emc_gov_step)
+		emc_gov_stats.raise++;
+	else
+		emc_gov_stats.lower++;
+	if (step == emc_gov_steps - 1)
+		emc_gov_stats.boost++;
+
+	emc_gov_step = step;
+	clk_set_rate(emc_gov_clk, tegra_emc_step_rate(step));
+}
+
+static void emc_gov_update(unsigned int util)
+{
+	unsigned long rate;
+	unsigned int target;
+	int step = emc_gov_step;
+
+	/*
+	 * The counters run at the rate the bus actually runs at, which may
+	 * be above our own request because of another user's floor.
+	 */
+	rate = clk_get_rate(emc_clk);
+	target = (up_threshold + down_threshold) / 2;
+	if (!target)
+		target = 1;
+
+	if (util >= boost_threshold) {
+		step = emc_gov_steps - 1;
+		emc_gov_last_busy = jiffies;
+	} else if (util > up_threshold) {
+		step = emc_gov_rate_to_step(div_u64((u64)rate * util, target));
+		step = max(step, emc_gov_step + 1);
+		step = min(step, emc_gov_steps - 1);
+		emc_gov_last_busy = jiffies;
+	} else if (util >= down_threshold) {
+		emc_gov_last_busy = jiffies;
+	} else if (time_after_eq(jiffies, emc_gov_last_busy +
+			msecs_to_jiffies(down_delay_ms))) {
+		if (emc_gov_rate_to_step(div_u64((u64)rate * util, target)) <
+				emc_gov_step)
+			step = emc_gov_step - 1;
+	}
+
+	emc_gov_set_step(step);
+}
+
+static void emc_gov_work_func(struct work_struct *work)
+{
+	mutex_lock(&emc_gov_lock);
+	if (emc_gov_running) {
+		emc_gov_stats.util = emc_gov_stat_sample();
+		emc_gov_update(emc_gov_stats.util);
+		schedule_delayed_work(&emc_gov_work,
+			msecs_to_jiffies(max(sample_ms, 1U)));
+	}
+	mutex_unlock(&emc_gov_lock);
+}
+
+/* Called with emc_gov_lock held */
+static void emc_gov_start(void)
+{
+	if (emc_gov_running)
+		return;
+
+	emc_gov_step = emc_gov_rate_to_step(clk_get_rate(emc_clk));
+	emc_gov_stats.last_change = get_jiffies_64();
+	emc_gov_last_busy = jiffies;
+	clk_set_rate(emc_gov_clk, tegra_emc_step_rate(emc_gov_step));
+	clk_enable(emc_gov_clk);
+
+	emc_gov_stat_start();
+	emc_gov_running = true;
+	schedule_delayed_work(&emc_gov_work,
+		msecs_to_jiffies(max(sample_ms, 1U)));
+}
+
+/* Called with emc_gov_lock held, returns the bus to the other users */
+static void emc_gov_stop(void)
+{
+	if (!emc_gov_running)
+		return;
+
+	emc_gov_running = false;
+	emc_gov_set_step(emc_gov_step);
+	clk_disable(emc_gov_clk);
+	mc_writel(MC_STAT_CONTROL_0_EMC_GATHER_DISABLE <<
+		MC_STAT_CONTROL_0_EMC_GATHER_SHIFT, MC_STAT_CONTROL_0);
+}
+
+static int emc_gov_set_enabled(const char *arg, const struct kernel_param *kp)
+{
+	int ret;
+
+	ret = param_set_bool(arg, kp);
+	if (ret || !emc_gov_clk)
+		return ret;
+
+	mutex_lock(&emc_gov_lock);
+	if (enabled)
+		emc_gov_start();
+	else
+		emc_gov_stop();
+	mutex_unlock(&emc_gov_lock);
+	return 0;
+}
+
+static struct kernel_param_ops emc_gov_enabled_ops = {
+	.set = emc_gov_set_enabled,
+	.get = param_get_bool,
+};
+
+module_param_cb(enabled, &emc_gov_enabled_ops, &enabled, 0644);
+
+static int __init tegra_emc_gov_init(void)
+{
+	struct clk *c;
+
+	emc_gov_steps = tegra_emc_table_steps();
+	if (emc_gov_steps <= 0)
+		return 0;
+
+	emc_gov_stats.time_in_step = kcalloc(emc_gov_steps, sizeof(u64),
+		GFP_KERNEL);
+	if (!emc_gov_stats.time_in_step)
+		return -ENOMEM;
+
+	emc_clk = clk_get_sys(NULL, "emc");
+	if (IS_ERR(emc_clk)) {
+		pr_err("%s: could not get emc clock\n", __func__);
+		goto err_free;
+	}
+
+	c = clk_get_sys("tegra_emc_gov", "emc");
+	if (IS_ERR(c)) {
+		pr_err("%s: could not get emc governor clock\n", __func__);
+		goto err_put_emc;
+	}
+
+	INIT_DELAYED_WORK_DEFERRABLE(&emc_gov_work, emc_gov_work_func);
+
+	mutex_lock(&emc_gov_lock);
+	emc_gov_clk = c;
+	if (enabled)
+		emc_gov_start();
+	mutex_unlock(&emc_gov_lock);
+
+	pr_info("%s: %d steps, sampling every %u ms\n", __func__,
+		emc_gov_steps, sample_ms);
+	return 0;
+
+err_put_emc:
+	clk_put(emc_clk);
+err_free:
+	kfree(emc_gov_stats.time_in_step);
+	emc_gov_stats.time_in_step = NULL;
+	return -ENODEV;
+}
+late_initcall(tegra_emc_gov_init);
+
+#ifdef CONFIG_DEBUG_FS
+static int emc_gov_stats_show(struct seq_file *s, void *data)
+{
+	u64 now = get_jiffies_64();
+	int i;
+
+	if (!emc_gov_stats.time_in_step)
+		return 0;
+
+	mutex_lock(&emc_gov_lock);
+	seq_printf(s, "enabled:        %u\n", enabled);
+	seq_printf(s, "utilization:    %3u%%\n", emc_gov_stats.util);
+	seq_printf(s, "request:        %lu kHz\n",
+		tegra_emc_step_rate(emc_gov_step) / 1000);
+	seq_printf(s, "emc:            %lu kHz\n", clk_get_rate(emc_clk) / 1000);
+	seq_printf(s, "raise:          %8u\n", emc_gov_stats.raise);
+	seq_printf(s, "  boost:        %8u\n", emc_gov_stats.boost);
+	seq_printf(s, "lower:          %8u\n", emc_gov_stats.lower);
+	seq_printf(s, "time in step:\n");
+	for (i = 0; i < emc_gov_steps; i++) {
+		u64 t = emc_gov_stats.time_in_step[i];
+
+		if (emc_gov_running && i == emc_gov_step)
+			t += now - emc_gov_stats.last_change;
+		seq_printf(s, "  %7lu kHz %10u ms\n",
+			tegra_emc_step_rate(i) / 1000, jiffies_to_msecs(t));
+	}
+	mutex_unlock(&emc_gov_lock);
+	return 0;
+}
+
+static int emc_gov_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, emc_gov_stats_show, inode->i_private);
+}
+
+static const struct file_operations emc_gov_stats_fops = {
+	.open		= emc_gov_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_emc_gov_debug_init(void)
+{
+	if (!debugfs_create_file("tegra_emc_gov", S_IRUGO, NULL, NULL,
+		&emc_gov_stats_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(tegra_emc_gov_debug_init);
+#endif
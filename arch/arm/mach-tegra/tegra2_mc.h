@@ -49,6 +49,7 @@ typedef enum {
 #define MC_STAT_EMC_CLOCK_LIMIT_0				0xa0
 #define MC_STAT_EMC_CLOCKS_0					0xa4
 #define MC_STAT_EMC_CONTROL_0_0					0xa8
+#define MC_STAT_EMC_CONTROL_1_0					0xac
 #define MC_STAT_EMC_COUNT_0_0					0xb8
 #define MC_STAT_EMC_COUNT_1_0					0xbc
 
@@ -0,0 +1,344 @@
+/*
+ * arch/arm/mach-tegra/tegra2_mc_pmu.c
+ *
+ * perf events for the memory controller and EMC statistics counters
+ *
+ * Copyright (C) 2010 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/err.h>
+#include <linux/io.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/perf_event.h>
+#include <linux/spinlock.h>
+
+#include <asm/pmu.h>
+
+#include <mach/iomap.h>
+
+#include "tegra2_mc.h"
+
+/*
+ * Events are raw perf events, config = ARM_PMU_PLATFORM_EVENT | id, with
+ * id taken from device_id in tegra2_mc.h:
+ *
+ *   < 0x80       EMC clocks in which the MC client transferred data
+ *   0x80 - 0x8a  DRAM counters (activates, reads, writes, ...),
+ *                summed over both devices
+ *   0xff         EMC clocks
+ *
+ * so "perf stat -a -C 0 -e r10000 -e r100ff" gives the display 0 window A
+ * read bandwidth as a fraction of the EMC clock.  The counters are global,
+ * so events have to be opened system-wide on CPU 0.
+ *
+ * Only two MC clients can be counted at once.  Further client events fail
+ * to schedule and the perf core rotates them over the two counters, with
+ * time_enabled/time_running giving the scaling.  The DRAM and clock
+ * counters are free running and never conflict.
+ *
+ * All counters are cleared together, so every read, enable and disable
+ * banks each active event's count and restarts gathering, and a timer
+ * does the same before the 32-bit counters can wrap.
+ */
+#define MC_PMU_CLIENT_COUNTERS	2
+#define MC_PMU_MAX_EVENTS	16
+#define MC_PMU_POLL_NSEC	(1000 * NSEC_PER_MSEC)
+
+static void __iomem *mc = IO_ADDRESS(TEGRA_MC_BASE);
+static void __iomem *emc = IO_ADDRESS(TEGRA_EMC_BASE);
+
+static DEFINE_SPINLOCK(mc_pmu_lock);
+static struct hrtimer mc_pmu_timer;
+static struct perf_event *mc_pmu_events[MC_PMU_MAX_EVENTS];
+static struct perf_event *mc_pmu_clients[MC_PMU_CLIENT_COUNTERS];
+static int mc_pmu_active;
+
+static const unsigned long mc_pmu_count_regs[MC_PMU_CLIENT_COUNTERS] = {
+	MC_STAT_EMC_COUNT_0_0,
+	MC_STAT_EMC_COUNT_1_0,
+};
+
+static const unsigned long mc_pmu_control_regs[MC_PMU_CLIENT_COUNTERS] = {
+	MC_STAT_EMC_CONTROL_0_0,
+	MC_STAT_EMC_CONTROL_1_0,
+};
+
+static const unsigned long mc_pmu_dram_regs[][2] = {
+	{ EMC_STAT_DRAM_DEV0_ACTIVATE_CNT_LO_0,
+	  EMC_STAT_DRAM_DEV1_ACTIVATE_CNT_LO_0 },
+	{ EMC_STAT_DRAM_DEV0_READ_CNT_LO_0,
+	  EMC_STAT_DRAM_DEV1_READ_CNT_LO_0 },
+	{ EMC_STAT_DRAM_DEV0_WRITE_CNT_LO_0,
+	  EMC_STAT_DRAM_DEV1_WRITE_CNT_LO_0 },
+	{ EMC_STAT_DRAM_DEV0_REF_CNT_LO_0,
+	  EMC_STAT_DRAM_DEV1_REF_CNT_LO_0 },
+	{ EMC_STAT_DRAM_DEV0_CUMM_BANKS_ACTIVE_CKE_EQ1_LO_0,
+	  EMC_STAT_DRAM_DEV1_CUMM_BANKS_ACTIVE_CKE_EQ1_LO_0 },
+	{ EMC_STAT_DRAM_DEV0_CUMM_BANKS_ACTIVE_CKE_EQ0_LO_0,
+	  EMC_STAT_DRAM_DEV1_CUMM_BANKS_ACTIVE_CKE_EQ0_LO_0 },
+	{ EMC_STAT_DRAM_DEV0_CKE_EQ1_CLKS_LO_0,
+	  EMC_STAT_DRAM_DEV1_CKE_EQ1_CLKS_LO_0 },
+	{ EMC_STAT_DRAM_DEV0_EXTCLKS_CKE_EQ1_LO_0,
+	  EMC_STAT_DRAM_DEV1_EXTCLKS_CKE_EQ1_LO_0 },
+	{ EMC_STAT_DRAM_DEV0_EXTCLKS_CKE_EQ0_LO_0,
+	  EMC_STAT_DRAM_DEV1_EXTCLKS_CKE_EQ0_LO_0 },
+	{ EMC_STAT_DRAM_DEV0_NO_BANKS_ACTIVE_CKE_EQ1_LO_0,
+	  EMC_STAT_DRAM_DEV1_NO_BANKS_ACTIVE_CKE_EQ1_LO_0 },
+	{ EMC_STAT_DRAM_DEV0_NO_BANKS_ACTIVE_CKE_EQ0_LO_0,
+	  EMC_STAT_DRAM_DEV1_NO_BANKS_ACTIVE_CKE_EQ0_LO_0 },
+};
+
+static inline bool mc_pmu_is_client(u32 id)
+{
+	return id < MC_STAT_END;
+}
+
+static inline bool mc_pmu_is_dram(u32 id)
+{
+	return id >= EMC_DRAM_STAT_BEGIN && id < EMC_DRAM_STAT_END;
+}
+
+static void mc_pmu_gather(u32 mc_ctrl, u32 emc_ctrl)
+{
+	writel(mc_ctrl << MC_STAT_CONTROL_0_EMC_GATHER_SHIFT,
+		mc + MC_STAT_CONTROL_0);
+	writel((emc_ctrl << EMC_STAT_CONTROL_0_LLMC_GATHER_SHIFT) |
+		(emc_ctrl << EMC_STAT_CONTROL_0_DRAM_GATHER_SHIFT),
+		emc + EMC_STAT_CONTROL_0);
+}
+
+static void mc_pmu_restart(void)
+{
+	mc_pmu_gather(MC_STAT_CONTROL_0_EMC_GATHER_CLEAR,
+		EMC_STAT_CONTROL_0_DRAM_GATHER_CLEAR);
+	mc_pmu_gather(MC_STAT_CONTROL_0_EMC_GATHER_ENABLE,
+		EMC_STAT_CONTROL_0_DRAM_GATHER_ENABLE);
+}
+
+static u64 mc_pmu_read_dram(u32 id)
+{
+	const unsigned long *regs = mc_pmu_dram_regs[id - EMC_DRAM_STAT_BEGIN];
+	u64 val = 0;
+	int i;
+
+	/* the HI register sits right after LO and holds the top 8 bits */
+	for (i = 0; i < 2; i++) {
+		val += readl(emc + regs[i]);
+		val += (u64)(readl(emc + regs[i] + 4) & 0xff) << 32;
+	}
+	return val;
+}
+
+/* Called with mc_pmu_lock held: bank every active count, then restart */
+static void mc_pmu_flush(void)
+{
+	u32 counts[MC_PMU_CLIENT_COUNTERS];
+	u32 clocks;
+	int i;
+
+	mc_pmu_gather(MC_STAT_CONTROL_0_EMC_GATHER_DISABLE,
+		EMC_STAT_CONTROL_0_DRAM_GATHER_DISABLE);
+
+	clocks = readl(mc + MC_STAT_EMC_CLOCKS_0);
+	for (i = 0; i < MC_PMU_CLIENT_COUNTERS; i++)
+		counts[i] = readl(mc + mc_pmu_count_regs[i]);
+
+	for (i = 0; i < MC_PMU_MAX_EVENTS; i++) {
+		struct perf_event *event = mc_pmu_events[i];
+		u32 id;
+		u64 delta;
+
+		if (!event)
+			continue;
+
+		id = event->hw.config;
+		if (mc_pmu_is_client(id))
+			delta = counts[event->hw.idx];
+		else if (mc_pmu_is_dram(id))
+			delta = mc_pmu_read_dram(id);
+		else
+			delta = clocks;
+
+		local64_add(delta, &event->count);
+	}
+
+	mc_pmu_restart();
+}
+
+static void mc_pmu_program(int counter, u32 id)
+{
+	u32 reg;
+
+	reg = (ARMC_STAT_CONTROL_MODE_BANDWIDTH <<
+			ARMC_STAT_CONTROL_MODE_SHIFT) |
+		(ARMC_STAT_CONTROL_EVENT_QUALIFIED <<
+			ARMC_STAT_CONTROL_EVENT_SHIFT) |
+		(ARMC_STAT_CONTROL_FILTER_PRI_DISABLE <<
+			ARMC_STAT_CONTROL_FILTER_PRI_SHIFT) |
+		(ARMC_STAT_CONTROL_FILTER_COALESCED_DISABLE <<
+			ARMC_STAT_CONTROL_FILTER_COALESCED_SHIFT) |
+		(ARMC_STAT_CONTROL_FILTER_CLIENT_ENABLE <<
+			ARMC_STAT_CONTROL_FILTER_CLIENT_SHIFT) |
+		(ARMC_STAT_CONTROL_FILTER_ADDR_DISABLE <<
+			ARMC_STAT_CONTROL_FILTER_ADDR_SHIFT) |
+		(id << ARMC_STAT_CONTROL_CLIENT_ID_SHIFT);
+
+	writel(reg, mc + mc_pmu_control_regs[counter]);
+}
+
+static int mc_pmu_enable(struct perf_event *event)
+{
+	struct hw_perf_event *hwc = &event->hw;
+	unsigned long flags;
+	int slot;
+	int i;
+	int err = 0;
+
+	spin_lock_irqsave(&mc_pmu_lock, flags);
+
+	for (slot = 0; slot < MC_PMU_MAX_EVENTS; slot++)
+		if (!mc_pmu_events[slot])
+			break;
+	if (slot == MC_PMU_MAX_EVENTS) {
+		err = -EAGAIN;
+		goto out;
+	}
+
+	if (mc_pmu_is_client(hwc->config)) {
+		for (i = 0; i < MC_PMU_CLIENT_COUNTERS; i++)
+			if (!mc_pmu_clients[i])
+				break;
+		if (i == MC_PMU_CLIENT_COUNTERS) {
+			err = -EAGAIN;
+			goto out;
+		}
+		hwc->idx = i;
+	}
+
+	if (mc_pmu_active)
+		mc_pmu_flush();
+
+	if (mc_pmu_is_client(hwc->config)) {
+		mc_pmu_clients[hwc->idx] = event;
+		mc_pmu_program(hwc->idx, hwc->config);
+	}
+	mc_pmu_events[slot] = event;
+	hwc->event_base = slot;
+
+	if (!mc_pmu_active++) {
+		writel(0xFFFFFFFF, mc + MC_STAT_EMC_CLOCK_LIMIT_0);
+		writel(0xFFFFFFFF, emc + EMC_STAT_DRAM_CLOCK_LIMIT_LO_0);
+		writel(0xFF, emc + EMC_STAT_DRAM_CLOCK_LIMIT_HI_0);
+		mc_pmu_restart();
+		hrtimer_start(&mc_pmu_timer, ns_to_ktime(MC_PMU_POLL_NSEC),
+			HRTIMER_MODE_REL);
+	}
+
+out:
+	spin_unlock_irqrestore(&mc_pmu_lock, flags);
+	return err;
+}
+
+static void mc_pmu_disable(struct perf_event *event)
+{
+	struct hw_perf_event *hwc = &event->hw;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mc_pmu_lock, flags);
+
+	mc_pmu_flush();
+	mc_pmu_events[hwc->event_base] = NULL;
+	if (mc_pmu_is_client(hwc->config))
+		mc_pmu_clients[hwc->idx] = NULL;
+	hwc->idx = -1;
+
+	/* the timer stops itself if it is already running */
+	if (!--mc_pmu_active) {
+		mc_pmu_gather(MC_STAT_CONTROL_0_EMC_GATHER_DISABLE,
+			EMC_STAT_CONTROL_0_DRAM_GATHER_DISABLE);
+		hrtimer_try_to_cancel(&mc_pmu_timer);
+	}
+
+	spin_unlock_irqrestore(&mc_pmu_lock, flags);
+}
+
+static void mc_pmu_read(struct perf_event *event)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&mc_pmu_lock, flags);
+	if (mc_pmu_active)
+		mc_pmu_flush();
+	spin_unlock_irqrestore(&mc_pmu_lock, flags);
+}
+
+static void mc_pmu_unthrottle(struct perf_event *event)
+{
+}
+
+static const struct pmu mc_pmu = {
+	.enable		= mc_pmu_enable,
+	.disable	= mc_pmu_disable,
+	.read		= mc_pmu_read,
+	.unthrottle	= mc_pmu_unthrottle,
+};
+
+static enum hrtimer_restart mc_pmu_timer_func(struct hrtimer *timer)
+{
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+
+	spin_lock(&mc_pmu_lock);
+	if (mc_pmu_active) {
+		mc_pmu_flush();
+		hrtimer_forward_now(timer, ns_to_ktime(MC_PMU_POLL_NSEC));
+		ret = HRTIMER_RESTART;
+	}
+	spin_unlock(&mc_pmu_lock);
+
+	return ret;
+}
+
+const struct pmu *platform_pmu_event_init(struct perf_event *event)
+{
+	u32 id = event->attr.config & ~ARM_PMU_PLATFORM_EVENT;
+
+	if (event->attr.config >> 32)
+		return ERR_PTR(-ENOENT);
+
+	if (!mc_pmu_is_client(id) && !mc_pmu_is_dram(id) &&
+	    id != MC_STAT_AGGREGATE)
+		return ERR_PTR(-ENOENT);
+
+	/* The counters see the whole system and cannot interrupt */
+	if (event->cpu != 0 || event->attr.sample_period)
+		return ERR_PTR(-EINVAL);
+
+	if (event->attr.exclude_kernel || event->attr.exclude_user ||
+	    event->attr.exclude_hv || event->attr.exclude_idle)
+		return ERR_PTR(-EPERM);
+
+	event->hw.config = id;
+	event->hw.idx = -1;
+	return &mc_pmu;
+}
+
+static int __init tegra_mc_pmu_init(void)
+{
+	hrtimer_init(&mc_pmu_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	mc_pmu_timer.function = mc_pmu_timer_func;
+	return 0;
+}
+arch_initcall(tegra_mc_pmu_init);
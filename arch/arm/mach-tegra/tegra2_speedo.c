@@ -45,6 +45,7 @@
 #define CHIP_MINOR_MASK			(0xF <<	CHIP_MINOR_SHIFT)
 
 #define PROCESS_CORNERS_NUM		4
+#define SUB_CORNERS_NUM			4
 
 #define SPEEDO_ID_SELECT_0(rev)		((rev) <= 2)
 #define SPEEDO_ID_SELECT_1(sku)		\
@@ -70,9 +71,38 @@ static const u32 core_process_speedos[][PROCESS_CORNERS_NUM] = {
 static int cpu_process_id;
 static int core_process_id;
 static int soc_speedo_id;
+static int cpu_sub_corner;
+static int core_sub_corner;
+
+/*
+ * Where a speedo value falls inside its process corner, 0 (slowest) to
+ * SUB_CORNERS_NUM - 1.  The lowest and the highest corner are open ended,
+ * so chips in them always report 0.
+ */
+static int speedo_sub_corner(const u32 *speedos, int process_id, u32 val)
+{
+	u32 lo, hi;
+
+	if (process_id == 0 || process_id >= PROCESS_CORNERS_NUM - 1)
+		return 0;
+
+	lo = speedos[process_id - 1];
+	hi = speedos[process_id];
+	if (hi <= lo || val <= lo)
+		return 0;
+
+	return min_t(u32, (val - lo - 1) * SUB_CORNERS_NUM / (hi - lo),
+		     SUB_CORNERS_NUM - 1);
+}
+
+/* all speedo fuses are spare bits in this range, read in one go */
+#define SPEEDO_FUSE_FIRST		CPU_SPEEDO_LSBIT
+#define SPEEDO_FUSE_COUNT		(CORE_SPEEDO_REDUND_MSBIT - CPU_SPEEDO_LSBIT + 1)
+#define speedo_fuse(fuses, bit)		((fuses)[(bit) - SPEEDO_FUSE_FIRST])
 
 void tegra_init_speedo_data(void)
 {
+	u32 fuses[SPEEDO_FUSE_COUNT];
 	u32 reg, val;
 	int i, bit, rev;
 	int sku = tegra_sku_id();
@@ -89,10 +119,12 @@ void tegra_init_speedo_data(void)
 	BUG_ON(soc_speedo_id >= ARRAY_SIZE(cpu_process_speedos));
 	BUG_ON(soc_speedo_id >= ARRAY_SIZE(core_process_speedos));
 
+	tegra_spare_fuses(SPEEDO_FUSE_FIRST, SPEEDO_FUSE_COUNT, fuses);
+
 	val = 0;
 	for (bit = CPU_SPEEDO_MSBIT; bit >= CPU_SPEEDO_LSBIT; bit--) {
-		reg = tegra_spare_fuse(bit) |
-			tegra_spare_fuse(bit + CPU_SPEEDO_REDUND_OFFS);
+		reg = speedo_fuse(fuses, bit) |
+			speedo_fuse(fuses, bit + CPU_SPEEDO_REDUND_OFFS);
 		val = (val << 1) | (reg & 0x1);
 	}
 	val = val * SPEEDO_MULT;
@@ -103,11 +135,13 @@ void tegra_init_speedo_data(void)
 			break;
 	}
 	cpu_process_id = i;
+	cpu_sub_corner = speedo_sub_corner(cpu_process_speedos[soc_speedo_id],
+					   i, val);
 
 	val = 0;
 	for (bit = CORE_SPEEDO_MSBIT; bit >= CORE_SPEEDO_LSBIT; bit--) {
-		reg = tegra_spare_fuse(bit) |
-			tegra_spare_fuse(bit + CORE_SPEEDO_REDUND_OFFS);
+		reg = speedo_fuse(fuses, bit) |
+			speedo_fuse(fuses, bit + CORE_SPEEDO_REDUND_OFFS);
 		val = (val << 1) | (reg & 0x1);
 	}
 	val = val * SPEEDO_MULT;
@@ -118,10 +152,12 @@ void tegra_init_speedo_data(void)
 			break;
 	}
 	core_process_id = i;
+	core_sub_corner = speedo_sub_corner(core_process_speedos[soc_speedo_id],
+					    i, val);
 
-	pr_info("Tegra SKU: %d Rev: A%.2d CPU Process: %d Core Process: %d"
-		" Speedo ID: %d\n", sku, rev, cpu_process_id, core_process_id,
-		soc_speedo_id);
+	pr_info("Tegra SKU: %d Rev: A%.2d CPU Process: %d.%d Core Process: %d.%d"
+		" Speedo ID: %d\n", sku, rev, cpu_process_id, cpu_sub_corner,
+		core_process_id, core_sub_corner, soc_speedo_id);
 }
 
 int tegra_cpu_process_id(void)
@@ -138,3 +174,13 @@ int tegra_soc_speedo_id(void)
 {
 	return soc_speedo_id;
 }
+
+int tegra_cpu_sub_corner(void)
+{
+	return cpu_sub_corner;
+}
+
+int tegra_core_sub_corner(void)
+{
+	return core_sub_corner;
+}
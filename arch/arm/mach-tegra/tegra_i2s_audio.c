@@ -49,6 +49,9 @@
 #include <linux/tegra_audio.h>
 #include <linux/pm.h>
 #include <linux/workqueue.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
 
 #include <mach/dma.h>
 #include <mach/iomap.h>
@@ -92,6 +95,26 @@ struct audio_stream {
 	struct work_struct allow_suspend_work;
 	struct wake_lock wake_lock;
 	char wake_lock_name[100];
+
+	/* mmap mode: the DMA runs over a ring of periods shared with the
+	 * application. Each request covers two periods, so the half-buffer
+	 * interrupt of the continuous channel ends the first one. Counters
+	 * are protected by dma_req_lock.
+	 */
+	struct tegra_audio_mmap_config mmap_config;
+	void *mmap_buf;
+	dma_addr_t mmap_phys;
+	size_t mmap_size;
+	struct tegra_dma_channel *mmap_chan;
+	struct tegra_dma_req mmap_req[TEGRA_AUDIO_MMAP_MAX_PERIODS / 2];
+	int mmap_head;
+	bool mmap_active;
+	u32 hw_periods;
+	u32 appl_periods;
+	u32 xruns;
+	u32 latency_us;
+	ktime_t period_time[TEGRA_AUDIO_MMAP_MAX_PERIODS];
+	wait_queue_head_t mmap_wait;
 };
 
 /* per i2s controller */
@@ -996,6 +1019,411 @@ static void stop_dma_recording(struct audio_stream *ais)
 		pr_warn("%s: spinny\n", __func__);
 }
 
+static inline unsigned mmap_req_size(struct audio_stream *as)
+{
+	return 2 * as->mmap_config.period_size;
+}
+
+static void mmap_note_latency(struct audio_stream *as, ktime_t now, int idx)
+{
+	s64 us = ktime_us_delta(now, as->period_time[idx]);
+
+	if (us < 0)
+		return;
+	if (!as->latency_us)
+		as->latency_us = us;
+	else
+		as->latency_us += ((s32)us - (s32)as->latency_us) / 8;
+}
+
+/* Called with as->dma_req_lock taken. */
+static void mmap_period_elapsed(struct audio_stream *as, bool capture)
+{
+	unsigned n = as->mmap_config.num_periods;
+	int idx = as->hw_periods % n;
+	ktime_t now = ktime_get();
+
+	as->hw_periods++;
+	if (capture) {
+		/* the DMA has overwritten a period the app has not read */
+		if (as->hw_periods - as->appl_periods >= n) {
+			as->xruns++;
+			as->appl_periods = as->hw_periods - (n - 1);
+		}
+		as->period_time[idx] = now;
+	} else {
+		/* Silence what was just played, so that an underrun plays
+		 * silence instead of repeating stale audio.
+		 */
+		memset(as->mmap_buf + idx * as->mmap_config.period_size, 0,
+			as->mmap_config.period_size);
+		if ((s32)(as->appl_periods - as->hw_periods) <= 0) {
+			/* skip the period being played */
+			as->xruns++;
+			as->appl_periods = as->hw_periods + 1;
+		} else
+			mmap_note_latency(as, now, as->hw_periods % n);
+	}
+	wake_up_interruptible(&as->mmap_wait);
+}
+
+static void dma_mmap_threshold_callback(struct tegra_dma_req *req)
+{
+	unsigned long flags;
+	struct audio_stream *as = req->dev;
+
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	if (as->mmap_active)
+		mmap_period_elapsed(as, req->to_memory);
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+}
+
+static void dma_mmap_complete_callback(struct tegra_dma_req *req)
+{
+	unsigned long flags;
+	struct audio_stream *as = req->dev;
+	unsigned nreqs = as->mmap_config.num_periods / 2;
+
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	if (as->mmap_active &&
+			req->status != -TEGRA_DMA_REQ_ERROR_ABORTED) {
+		mmap_period_elapsed(as, req->to_memory);
+		as->mmap_head = (as->mmap_head + 1) % nreqs;
+		/* put the request back at the end of the ring */
+		tegra_dma_enqueue_req(as->mmap_chan, req);
+	}
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+}
+
+static void mmap_free(struct audio_driver_state *ads, struct audio_stream *as)
+{
+	if (as->mmap_chan) {
+		tegra_dma_free_channel(as->mmap_chan);
+		as->mmap_chan = NULL;
+	}
+	if (as->mmap_buf) {
+		dma_free_writecombine(&ads->pdev->dev, as->mmap_size,
+				as->mmap_buf, as->mmap_phys);
+		as->mmap_buf = NULL;
+	}
+	as->mmap_size = 0;
+	memset(&as->mmap_config, 0, sizeof(as->mmap_config));
+}
+
+/* Called with as->lock taken. */
+static int mmap_set_config(struct audio_driver_state *ads,
+		struct audio_stream *as, struct tegra_audio_mmap_config *cfg)
+{
+	unsigned period = cfg->period_size;
+	unsigned n = cfg->num_periods;
+
+	if (period < TEGRA_AUDIO_MMAP_MIN_PERIOD || !IS_ALIGNED(period, 4) ||
+			2 * period > TEGRA_DMA_MAX_TRANSFER_SIZE ||
+			n < 2 || n > TEGRA_AUDIO_MMAP_MAX_PERIODS || n & 1) {
+		pr_err("%s: invalid config %d x %d\n", __func__, n, period);
+		return -EINVAL;
+	}
+	if (!as->opened) {
+		pr_err("%s: stream is not open\n", __func__);
+		return -ENODEV;
+	}
+	if (as->mmap_active || pending_buffer_requests(as) || as->active) {
+		pr_err("%s: stream busy\n", __func__);
+		return -EBUSY;
+	}
+	if (as->mmap_buf) {
+		/* the old ring may still be mapped until the stream closes */
+		if (cfg->period_size == as->mmap_config.period_size &&
+				cfg->num_periods == as->mmap_config.num_periods)
+			return 0;
+		pr_err("%s: ring already set up\n", __func__);
+		return -EBUSY;
+	}
+
+	as->mmap_size = PAGE_ALIGN(period * n);
+	as->mmap_buf = dma_alloc_writecombine(&ads->pdev->dev, as->mmap_size,
+			&as->mmap_phys, GFP_KERNEL);
+	if (!as->mmap_buf) {
+		pr_err("%s: could not allocate %zu byte ring\n", __func__,
+			as->mmap_size);
+		as->mmap_size = 0;
+		return -ENOMEM;
+	}
+	memset(as->mmap_buf, 0, as->mmap_size);
+
+	as->mmap_chan = tegra_dma_allocate_channel(TEGRA_DMA_MODE_CONTINUOUS);
+	if (!as->mmap_chan) {
+		pr_err("%s: could not allocate DMA channel\n", __func__);
+		mmap_free(ads, as);
+		return -ENODEV;
+	}
+	as->mmap_config = *cfg;
+	as->hw_periods = 0;
+	as->appl_periods = 0;
+	return 0;
+}
+
+/* Called with as->lock taken. */
+static int mmap_start(struct audio_driver_state *ads, struct audio_stream *as)
+{
+	int i, rc = 0;
+	unsigned long flags;
+	bool capture = as == &ads->in;
+	unsigned nreqs = as->mmap_config.num_periods / 2;
+	int fifo = capture ? I2S_FIFO_RX : I2S_FIFO_TX;
+
+	if (!as->mmap_buf)
+		return -EINVAL;
+	if (as->mmap_active)
+		return 0;
+
+	prevent_suspend(as);
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	/* keep what the application already filled in for playback */
+	if (capture)
+		as->appl_periods = 0;
+	as->hw_periods = 0;
+	as->xruns = 0;
+	as->latency_us = 0;
+	as->mmap_head = 0;
+	as->mmap_active = true;
+
+	for (i = 0; i < nreqs; i++) {
+		struct tegra_dma_req *req = &as->mmap_req[i];
+		dma_addr_t addr = as->mmap_phys + i * mmap_req_size(as);
+
+		if (capture) {
+			setup_dma_rx_request(req, as);
+			req->dest_addr = addr;
+		} else {
+			setup_dma_tx_request(req, as);
+			req->source_addr = addr;
+		}
+		req->virt_addr = as->mmap_buf + i * mmap_req_size(as);
+		req->size = mmap_req_size(as);
+		req->complete = dma_mmap_complete_callback;
+		req->threshold = dma_mmap_threshold_callback;
+		rc = tegra_dma_enqueue_req(as->mmap_chan, req);
+		if (rc)
+			break;
+	}
+
+	if (!rc) {
+		i2s_fifo_set_attention_level(ads->i2s_base, fifo,
+				as->i2s_fifo_atn_level);
+		i2s_fifo_enable(ads->i2s_base, fifo, 1);
+	} else {
+		as->mmap_active = false;
+	}
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+
+	if (rc) {
+		pr_err("%s: could not enqueue DMA ring\n", __func__);
+		tegra_dma_cancel(as->mmap_chan);
+		allow_suspend(as);
+	}
+	return rc;
+}
+
+/* Called with as->lock taken. */
+static void mmap_stop(struct audio_driver_state *ads, struct audio_stream *as)
+{
+	unsigned long flags;
+
+	if (!as->mmap_active)
+		return;
+
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	as->mmap_active = false;
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+
+	tegra_dma_cancel(as->mmap_chan);
+	if (as == &ads->in) {
+		i2s_fifo_enable(ads->i2s_base, I2S_FIFO_RX, 0);
+		i2s_fifo_clear(ads->i2s_base, I2S_FIFO_RX);
+	} else {
+		spin_lock_irqsave(&as->dma_req_lock, flags);
+		sound_ops->stop_playback(as);
+		spin_unlock_irqrestore(&as->dma_req_lock, flags);
+	}
+	allow_suspend(as);
+	wake_up_interruptible(&as->mmap_wait);
+}
+
+/* Called with as->lock taken. */
+static int mmap_commit(struct audio_driver_state *ads,
+		struct audio_stream *as, unsigned int count)
+{
+	unsigned long flags;
+	bool capture = as == &ads->in;
+	unsigned n = as->mmap_config.num_periods;
+	ktime_t now = ktime_get();
+	int rc = 0;
+
+	if (!as->mmap_buf)
+		return -EINVAL;
+
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	if (capture) {
+		if (count > as->hw_periods - as->appl_periods) {
+			rc = -EINVAL;
+			goto done;
+		}
+		/* time from the DMA filling a period to the app taking it */
+		while (count--)
+			mmap_note_latency(as, now, as->appl_periods++ % n);
+	} else {
+		if (count > as->hw_periods + n - as->appl_periods) {
+			rc = -EINVAL;
+			goto done;
+		}
+		while (count--)
+			as->period_time[as->appl_periods++ % n] = now;
+	}
+done:
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+	return rc;
+}
+
+static void mmap_get_status(struct audio_stream *as,
+		struct tegra_audio_mmap_status *st)
+{
+	unsigned long flags;
+	struct tegra_dma_req *req;
+	unsigned count = 0;
+
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	memset(st, 0, sizeof(*st));
+	if (as->mmap_active) {
+		req = &as->mmap_req[as->mmap_head];
+		count = tegra_dma_get_transfer_count(as->mmap_chan, req,
+				false);
+		st->hw_ptr = as->mmap_head * mmap_req_size(as) +
+				min(count, mmap_req_size(as));
+		st->hw_ptr %= as->mmap_config.period_size *
+				as->mmap_config.num_periods;
+	}
+	st->hw_periods = as->hw_periods;
+	st->appl_periods = as->appl_periods;
+	st->xruns = as->xruns;
+	st->latency_us = as->latency_us;
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+}
+
+/* Called with as->lock taken. */
+static long tegra_audio_mmap_ioctl(struct audio_driver_state *ads,
+		struct audio_stream *as, unsigned int cmd, unsigned long arg)
+{
+	int rc = 0;
+
+	switch (cmd) {
+	case TEGRA_AUDIO_MMAP_SET_CONFIG: {
+		struct tegra_audio_mmap_config cfg;
+		if (copy_from_user(&cfg, (const void __user *)arg,
+					sizeof(cfg))) {
+			rc = -EFAULT;
+			break;
+		}
+		rc = mmap_set_config(ads, as, &cfg);
+	}
+		break;
+	case TEGRA_AUDIO_MMAP_GET_CONFIG:
+		if (copy_to_user((void __user *)arg, &as->mmap_config,
+				sizeof(as->mmap_config)))
+			rc = -EFAULT;
+		break;
+	case TEGRA_AUDIO_MMAP_START:
+		rc = mmap_start(ads, as);
+		break;
+	case TEGRA_AUDIO_MMAP_STOP:
+		mmap_stop(ads, as);
+		break;
+	case TEGRA_AUDIO_MMAP_COMMIT: {
+		unsigned int count;
+		if (copy_from_user(&count, (const void __user *)arg,
+					sizeof(count))) {
+			rc = -EFAULT;
+			break;
+		}
+		rc = mmap_commit(ads, as, count);
+	}
+		break;
+	case TEGRA_AUDIO_MMAP_GET_STATUS: {
+		struct tegra_audio_mmap_status st;
+		mmap_get_status(as, &st);
+		if (copy_to_user((void __user *)arg, &st, sizeof(st)))
+			rc = -EFAULT;
+	}
+		break;
+	default:
+		rc = -EINVAL;
+	}
+	return rc;
+}
+
+static int tegra_audio_mmap_common(struct audio_driver_state *ads,
+		struct audio_stream *as, struct vm_area_struct *vma)
+{
+	int rc;
+
+	mutex_lock(&as->lock);
+	if (!as->mmap_buf || vma->vm_pgoff ||
+			vma->vm_end - vma->vm_start > as->mmap_size) {
+		rc = -EINVAL;
+		goto done;
+	}
+	rc = dma_mmap_writecombine(&ads->pdev->dev, vma, as->mmap_buf,
+			as->mmap_phys, as->mmap_size);
+done:
+	mutex_unlock(&as->lock);
+	return rc;
+}
+
+static int tegra_audio_out_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct audio_driver_state *ads = ads_from_misc_out(file);
+	return tegra_audio_mmap_common(ads, &ads->out, vma);
+}
+
+static int tegra_audio_in_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct audio_driver_state *ads = ads_from_misc_in(file);
+	return tegra_audio_mmap_common(ads, &ads->in, vma);
+}
+
+static unsigned int tegra_audio_out_poll(struct file *file,
+		struct poll_table_struct *wait)
+{
+	struct audio_driver_state *ads = ads_from_misc_out(file);
+	struct audio_stream *aos = &ads->out;
+	unsigned int mask = 0;
+	unsigned long flags;
+
+	poll_wait(file, &aos->mmap_wait, wait);
+	spin_lock_irqsave(&aos->dma_req_lock, flags);
+	if (!aos->mmap_buf || aos->appl_periods !=
+			aos->hw_periods + aos->mmap_config.num_periods)
+		mask |= POLLOUT | POLLWRNORM;
+	spin_unlock_irqrestore(&aos->dma_req_lock, flags);
+	return mask;
+}
+
+static unsigned int tegra_audio_in_poll(struct file *file,
+		struct poll_table_struct *wait)
+{
+	struct audio_driver_state *ads = ads_from_misc_in(file);
+	struct audio_stream *ais = &ads->in;
+	unsigned int mask = 0;
+	unsigned long flags;
+
+	poll_wait(file, &ais->mmap_wait, wait);
+	spin_lock_irqsave(&ais->dma_req_lock, flags);
+	if (ais->mmap_buf && ais->appl_periods != ais->hw_periods)
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock_irqrestore(&ais->dma_req_lock, flags);
+	return mask;
+}
+
 static irqreturn_t i2s_interrupt(int irq, void *data)
 {
 	struct audio_driver_state *ads = data;
@@ -1028,6 +1456,12 @@ static ssize_t tegra_audio_write(struct file *file,
 
 	pr_debug("%s: write %d bytes\n", __func__, size);
 
+	if (ads->out.mmap_buf) {
+		pr_err("%s: stream is in mmap mode\n", __func__);
+		rc = -EBUSY;
+		goto done;
+	}
+
 	if (ads->out.stop) {
 		pr_debug("%s: playback has been cancelled\n", __func__);
 		goto done;
@@ -1133,7 +1567,7 @@ static long tegra_audio_out_ioctl(struct file *file,
 			rc = -EFAULT;
 		break;
 	default:
-		rc = -EINVAL;
+		rc = tegra_audio_mmap_ioctl(ads, aos, cmd, arg);
 	}
 
 	mutex_unlock(&aos->lock);
@@ -1289,7 +1723,7 @@ static long tegra_audio_in_ioctl(struct file *file,
 			rc = -EFAULT;
 		break;
 	default:
-		rc = -EINVAL;
+		rc = tegra_audio_mmap_ioctl(ads, ais, cmd, arg);
 	}
 
 	mutex_unlock(&ais->lock);
@@ -1315,6 +1749,12 @@ static ssize_t tegra_audio_read(struct file *file, char __user *buf,
 
 	pr_debug("%s: size %d\n", __func__, size);
 
+	if (ads->in.mmap_buf) {
+		pr_err("%s: stream is in mmap mode\n", __func__);
+		rc = -EBUSY;
+		goto done;
+	}
+
 	/* If we want recording to stop immediately after it gets cancelled,
 	 * then we do not want to wait for the fifo to get drained.
 	 */
@@ -1419,6 +1859,8 @@ static int tegra_audio_out_release(struct inode *inode, struct file *file)
 
 	mutex_lock(&ads->out.lock);
 	ads->out.opened = 0;
+	mmap_stop(ads, &ads->out);
+	mmap_free(ads, &ads->out);
 	request_stop_nosync(&ads->out);
 	if (stop_playback_if_necessary(&ads->out))
 		pr_debug("%s: done (stopped)\n", __func__);
@@ -1464,6 +1906,8 @@ static int tegra_audio_in_release(struct inode *inode, struct file *file)
 
 	mutex_lock(&ads->in.lock);
 	ads->in.opened = 0;
+	mmap_stop(ads, &ads->in);
+	mmap_free(ads, &ads->in);
 	if (ads->in.active) {
 		sound_ops->stop_recording(&ads->in);
 		complete(&ads->in.stop_completion);
@@ -1480,6 +1924,8 @@ static const struct file_operations tegra_audio_out_fops = {
 	.open = tegra_audio_out_open,
 	.release = tegra_audio_out_release,
 	.write = tegra_audio_write,
+	.mmap = tegra_audio_out_mmap,
+	.poll = tegra_audio_out_poll,
 };
 
 static const struct file_operations tegra_audio_in_fops = {
@@ -1487,6 +1933,8 @@ static const struct file_operations tegra_audio_in_fops = {
 	.open = tegra_audio_in_open,
 	.read = tegra_audio_read,
 	.release = tegra_audio_in_release,
+	.mmap = tegra_audio_in_mmap,
+	.poll = tegra_audio_in_poll,
 };
 
 static int tegra_audio_ctl_open(struct inode *inode, struct file *file)
@@ -1808,6 +2256,7 @@ static int tegra_audio_probe(struct platform_device *pdev)
 		mutex_init(&state->out.lock);
 		init_completion(&state->out.stop_completion);
 		spin_lock_init(&state->out.dma_req_lock);
+		init_waitqueue_head(&state->out.mmap_wait);
 		state->out.dma_chan = NULL;
 		state->out.i2s_fifo_atn_level = I2S_FIFO_ATN_LVL_FOUR_SLOTS;
 		state->out.num_bufs = I2S_DEFAULT_TX_NUM_BUFS;
@@ -1850,6 +2299,7 @@ static int tegra_audio_probe(struct platform_device *pdev)
 		mutex_init(&state->in.lock);
 		init_completion(&state->in.stop_completion);
 		spin_lock_init(&state->in.dma_req_lock);
+		init_waitqueue_head(&state->in.mmap_wait);
 		state->in.dma_chan = NULL;
 		state->in.i2s_fifo_atn_level = I2S_FIFO_ATN_LVL_FOUR_SLOTS;
 		state->in.num_bufs = I2S_DEFAULT_RX_NUM_BUFS;
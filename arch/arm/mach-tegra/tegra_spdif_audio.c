@@ -48,8 +48,12 @@
 #include <linux/tegra_audio.h>
 #include <linux/pm.h>
 #include <linux/workqueue.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
 
 #include <mach/dma.h>
+#include <mach/hdmi-audio.h>
 #include <mach/iomap.h>
 #include <mach/spdif.h>
 #include <mach/audio.h>
@@ -86,6 +90,26 @@ struct audio_stream {
 	struct work_struct allow_suspend_work;
 	struct wake_lock wake_lock;
 	char wake_lock_name[100];
+
+	/* mmap mode: the DMA runs over a ring of periods shared with the
+	 * application. Each request covers two periods, so the half-buffer
+	 * interrupt of the continuous channel ends the first one. Counters
+	 * are protected by dma_req_lock.
+	 */
+	struct tegra_audio_mmap_config mmap_config;
+	void *mmap_buf;
+	dma_addr_t mmap_phys;
+	size_t mmap_size;
+	struct tegra_dma_channel *mmap_chan;
+	struct tegra_dma_req mmap_req[TEGRA_AUDIO_MMAP_MAX_PERIODS / 2];
+	int mmap_head;
+	bool mmap_active;
+	u32 hw_periods;
+	u32 appl_periods;
+	u32 xruns;
+	u32 latency_us;
+	ktime_t period_time[TEGRA_AUDIO_MMAP_MAX_PERIODS];
+	wait_queue_head_t mmap_wait;
 };
 
 struct audio_driver_state {
@@ -98,6 +122,8 @@ struct audio_driver_state {
 
 	unsigned long dma_req_sel;
 	bool fifo_init;
+	bool clk_enabled;
+	struct tegra_audio_spdif_format format;
 
 	int irq;
 
@@ -206,10 +232,14 @@ static int set_spdif_clock(struct audio_driver_state *state,
 	}
 
 	clk_set_rate(spdif_clk, clock_freq);
-	if (clk_enable(spdif_clk)) {
-		dev_err(&state->pdev->dev,
-			"%s: failed to enable spdif_clk clock\n", __func__);
-		return -EIO;
+	if (!state->clk_enabled) {
+		if (clk_enable(spdif_clk)) {
+			dev_err(&state->pdev->dev,
+				"%s: failed to enable spdif_clk clock\n",
+				__func__);
+			return -EIO;
+		}
+		state->clk_enabled = true;
 	}
 	pr_info("%s: spdif_clk rate %ld\n", __func__, clk_get_rate(spdif_clk));
 
@@ -395,6 +425,22 @@ static void setup_dma_tx_request(struct tegra_dma_req *req,
 }
 
 
+/* Called with ads->out.dma_req_lock taken. */
+static void start_tx_fifo(struct audio_driver_state *ads)
+{
+	spdif_fifo_set_attention_level(ads->spdif_base,
+		AUDIO_TX_MODE,
+		ads->out.spdif_fifo_atn_level);
+
+	if (ads->fifo_init) {
+		spdif_set_bit_mode(ads->spdif_base, SPDIF_BIT_MODE_MODE16BIT);
+		spdif_set_fifo_packed(ads->spdif_base, 1);
+		ads->fifo_init = false;
+	}
+
+	spdif_fifo_enable(ads->spdif_base, AUDIO_TX_MODE, 1);
+}
+
 static int start_playback(struct audio_stream *aos,
 			struct tegra_dma_req *req)
 {
@@ -410,17 +456,7 @@ static int start_playback(struct audio_stream *aos,
 	spdif_fifo_clear(ads->spdif_base);
 #endif
 
-	spdif_fifo_set_attention_level(ads->spdif_base,
-		AUDIO_TX_MODE,
-		ads->out.spdif_fifo_atn_level);
-
-	if (ads->fifo_init) {
-		spdif_set_bit_mode(ads->spdif_base, SPDIF_BIT_MODE_MODE16BIT);
-		spdif_set_fifo_packed(ads->spdif_base, 1);
-		ads->fifo_init = false;
-	}
-
-	spdif_fifo_enable(ads->spdif_base, AUDIO_TX_MODE, 1);
+	start_tx_fifo(ads);
 
 	rc = tegra_dma_enqueue_req(aos->dma_chan, req);
 	spin_unlock_irqrestore(&aos->dma_req_lock, flags);
@@ -448,6 +484,306 @@ static void stop_dma_playback(struct audio_stream *aos)
 	ads->fifo_init = true;
 }
 
+static inline unsigned mmap_req_size(struct audio_stream *aos)
+{
+	return 2 * aos->mmap_config.period_size;
+}
+
+static void mmap_note_latency(struct audio_stream *aos, ktime_t now, int idx)
+{
+	s64 us = ktime_us_delta(now, aos->period_time[idx]);
+
+	if (us < 0)
+		return;
+	if (!aos->latency_us)
+		aos->latency_us = us;
+	else
+		aos->latency_us += ((s32)us - (s32)aos->latency_us) / 8;
+}
+
+/* Called with aos->dma_req_lock taken. */
+static void mmap_period_elapsed(struct audio_stream *aos)
+{
+	unsigned n = aos->mmap_config.num_periods;
+	int idx = aos->hw_periods % n;
+	ktime_t now = ktime_get();
+
+	aos->hw_periods++;
+	/* Silence what was just played, so that an underrun plays silence
+	 * instead of repeating stale audio. For IEC 61937 streams zeroes
+	 * carry no burst, so the receiver mutes rather than losing sync.
+	 */
+	memset(aos->mmap_buf + idx * aos->mmap_config.period_size, 0,
+		aos->mmap_config.period_size);
+	if ((s32)(aos->appl_periods - aos->hw_periods) <= 0) {
+		/* skip the period being played */
+		aos->xruns++;
+		aos->appl_periods = aos->hw_periods + 1;
+	} else
+		mmap_note_latency(aos, now, aos->hw_periods % n);
+	wake_up_interruptible(&aos->mmap_wait);
+}
+
+static void dma_mmap_threshold_callback(struct tegra_dma_req *req)
+{
+	unsigned long flags;
+	struct audio_stream *aos = req->dev;
+
+	spin_lock_irqsave(&aos->dma_req_lock, flags);
+	if (aos->mmap_active)
+		mmap_period_elapsed(aos);
+	spin_unlock_irqrestore(&aos->dma_req_lock, flags);
+}
+
+static void dma_mmap_complete_callback(struct tegra_dma_req *req)
+{
+	unsigned long flags;
+	struct audio_stream *aos = req->dev;
+	unsigned nreqs = aos->mmap_config.num_periods / 2;
+
+	spin_lock_irqsave(&aos->dma_req_lock, flags);
+	if (aos->mmap_active &&
+			req->status != -TEGRA_DMA_REQ_ERROR_ABORTED) {
+		mmap_period_elapsed(aos);
+		aos->mmap_head = (aos->mmap_head + 1) % nreqs;
+		/* put the request back at the end of the ring */
+		tegra_dma_enqueue_req(aos->mmap_chan, req);
+	}
+	spin_unlock_irqrestore(&aos->dma_req_lock, flags);
+}
+
+static void mmap_free(struct audio_driver_state *ads)
+{
+	struct audio_stream *aos = &ads->out;
+
+	if (aos->mmap_chan) {
+		tegra_dma_free_channel(aos->mmap_chan);
+		aos->mmap_chan = NULL;
+	}
+	if (aos->mmap_buf) {
+		dma_free_writecombine(&ads->pdev->dev, aos->mmap_size,
+				aos->mmap_buf, aos->mmap_phys);
+		aos->mmap_buf = NULL;
+	}
+	aos->mmap_size = 0;
+	memset(&aos->mmap_config, 0, sizeof(aos->mmap_config));
+}
+
+/* Called with ads->out.lock taken.
+ *
+ * Periods may be as large as half a DMA transfer (32kB), so a ring of
+ * a few large periods raises one interrupt every ~170ms of 48kHz audio
+ * and the CPU can stay idle in between.
+ */
+static int mmap_set_config(struct audio_driver_state *ads,
+		struct tegra_audio_mmap_config *cfg)
+{
+	struct audio_stream *aos = &ads->out;
+	unsigned period = cfg->period_size;
+	unsigned n = cfg->num_periods;
+
+	if (period < TEGRA_AUDIO_MMAP_MIN_PERIOD || !IS_ALIGNED(period, 4) ||
+			2 * period > TEGRA_DMA_MAX_TRANSFER_SIZE ||
+			n < 2 || n > TEGRA_AUDIO_MMAP_MAX_PERIODS || n & 1) {
+		pr_err("%s: invalid config %d x %d\n", __func__, n, period);
+		return -EINVAL;
+	}
+	if (!aos->opened) {
+		pr_err("%s: stream is not open\n", __func__);
+		return -ENODEV;
+	}
+	if (aos->mmap_active || pending_buffer_requests(aos)) {
+		pr_err("%s: stream busy\n", __func__);
+		return -EBUSY;
+	}
+	if (aos->mmap_buf) {
+		/* the old ring may still be mapped until the stream closes */
+		if (cfg->period_size == aos->mmap_config.period_size &&
+				cfg->num_periods == aos->mmap_config.num_periods)
+			return 0;
+		pr_err("%s: ring already set up\n", __func__);
+		return -EBUSY;
+	}
+
+	aos->mmap_size = PAGE_ALIGN(period * n);
+	aos->mmap_buf = dma_alloc_writecombine(&ads->pdev->dev, aos->mmap_size,
+			&aos->mmap_phys, GFP_KERNEL);
+	if (!aos->mmap_buf) {
+		pr_err("%s: could not allocate %zu byte ring\n", __func__,
+			aos->mmap_size);
+		aos->mmap_size = 0;
+		return -ENOMEM;
+	}
+	memset(aos->mmap_buf, 0, aos->mmap_size);
+
+	aos->mmap_chan = tegra_dma_allocate_channel(TEGRA_DMA_MODE_CONTINUOUS);
+	if (!aos->mmap_chan) {
+		pr_err("%s: could not allocate DMA channel\n", __func__);
+		mmap_free(ads);
+		return -ENODEV;
+	}
+	aos->mmap_config = *cfg;
+	aos->hw_periods = 0;
+	aos->appl_periods = 0;
+	return 0;
+}
+
+/* Called with ads->out.lock taken. */
+static int mmap_start(struct audio_driver_state *ads)
+{
+	int i, rc = 0;
+	unsigned long flags;
+	struct audio_stream *aos = &ads->out;
+	unsigned nreqs = aos->mmap_config.num_periods / 2;
+
+	if (!aos->mmap_buf)
+		return -EINVAL;
+	if (aos->mmap_active)
+		return 0;
+
+	prevent_suspend(aos);
+	spin_lock_irqsave(&aos->dma_req_lock, flags);
+	/* keep what the application already filled in */
+	aos->hw_periods = 0;
+	aos->xruns = 0;
+	aos->latency_us = 0;
+	aos->mmap_head = 0;
+	aos->mmap_active = true;
+
+	for (i = 0; i < nreqs; i++) {
+		struct tegra_dma_req *req = &aos->mmap_req[i];
+
+		setup_dma_tx_request(req, aos);
+		req->source_addr = aos->mmap_phys + i * mmap_req_size(aos);
+		req->virt_addr = aos->mmap_buf + i * mmap_req_size(aos);
+		req->size = mmap_req_size(aos);
+		req->complete = dma_mmap_complete_callback;
+		req->threshold = dma_mmap_threshold_callback;
+		rc = tegra_dma_enqueue_req(aos->mmap_chan, req);
+		if (rc)
+			break;
+	}
+
+	if (!rc)
+		start_tx_fifo(ads);
+	else
+		aos->mmap_active = false;
+	spin_unlock_irqrestore(&aos->dma_req_lock, flags);
+
+	if (rc) {
+		pr_err("%s: could not enqueue DMA ring\n", __func__);
+		tegra_dma_cancel(aos->mmap_chan);
+		allow_suspend(aos);
+	}
+	return rc;
+}
+
+/* Called with ads->out.lock taken. */
+static void mmap_stop(struct audio_driver_state *ads)
+{
+	unsigned long flags;
+	struct audio_stream *aos = &ads->out;
+
+	if (!aos->mmap_active)
+		return;
+
+	spin_lock_irqsave(&aos->dma_req_lock, flags);
+	aos->mmap_active = false;
+	spin_unlock_irqrestore(&aos->dma_req_lock, flags);
+
+	tegra_dma_cancel(aos->mmap_chan);
+	spin_lock_irqsave(&aos->dma_req_lock, flags);
+	sound_ops->stop_playback(aos);
+	spin_unlock_irqrestore(&aos->dma_req_lock, flags);
+	allow_suspend(aos);
+	wake_up_interruptible(&aos->mmap_wait);
+}
+
+/* Called with ads->out.lock taken. */
+static int mmap_commit(struct audio_driver_state *ads, unsigned int count)
+{
+	unsigned long flags;
+	struct audio_stream *aos = &ads->out;
+	unsigned n = aos->mmap_config.num_periods;
+	ktime_t now = ktime_get();
+	int rc = 0;
+
+	if (!aos->mmap_buf)
+		return -EINVAL;
+
+	spin_lock_irqsave(&aos->dma_req_lock, flags);
+	if (count > aos->hw_periods + n - aos->appl_periods) {
+		rc = -EINVAL;
+		goto done;
+	}
+	while (count--)
+		aos->period_time[aos->appl_periods++ % n] = now;
+done:
+	spin_unlock_irqrestore(&aos->dma_req_lock, flags);
+	return rc;
+}
+
+static void mmap_get_status(struct audio_stream *aos,
+		struct tegra_audio_mmap_status *st)
+{
+	unsigned long flags;
+	struct tegra_dma_req *req;
+	unsigned count = 0;
+
+	spin_lock_irqsave(&aos->dma_req_lock, flags);
+	memset(st, 0, sizeof(*st));
+	if (aos->mmap_active) {
+		req = &aos->mmap_req[aos->mmap_head];
+		count = tegra_dma_get_transfer_count(aos->mmap_chan, req,
+				false);
+		st->hw_ptr = aos->mmap_head * mmap_req_size(aos) +
+				min(count, mmap_req_size(aos));
+		st->hw_ptr %= aos->mmap_config.period_size *
+				aos->mmap_config.num_periods;
+	}
+	st->hw_periods = aos->hw_periods;
+	st->appl_periods = aos->appl_periods;
+	st->xruns = aos->xruns;
+	st->latency_us = aos->latency_us;
+	spin_unlock_irqrestore(&aos->dma_req_lock, flags);
+}
+
+/* Called with ads->out.lock taken. */
+static int spdif_set_format(struct audio_driver_state *ads,
+		const struct tegra_audio_spdif_format *fmt)
+{
+	struct audio_stream *aos = &ads->out;
+	bool non_audio = fmt->mode == TEGRA_AUDIO_SPDIF_NON_AUDIO;
+	int rc;
+
+	if (fmt->mode != TEGRA_AUDIO_SPDIF_PCM && !non_audio) {
+		pr_err("%s: invalid mode %d\n", __func__, fmt->mode);
+		return -EINVAL;
+	}
+	if (aos->mmap_active || pending_buffer_requests(aos)) {
+		pr_err("%s: playback in progress\n", __func__);
+		return -EBUSY;
+	}
+
+	if (fmt->rate != ads->format.rate) {
+		rc = set_spdif_clock(ads, fmt->rate);
+		if (rc < 0) {
+			pr_err("%s: unsupported rate %d\n", __func__,
+				fmt->rate);
+			return -EINVAL;
+		}
+	}
+	spdif_set_sample_rate(ads->spdif_base, fmt->rate);
+	spdif_set_non_audio(ads->spdif_base, non_audio);
+	ads->format = *fmt;
+
+	/* S/PDIF still works if the sink on HDMI can't take this rate */
+	if (tegra_hdmi_setup_audio_format(fmt->rate, non_audio) < 0)
+		pr_warn("%s: HDMI can't carry %d Hz audio\n", __func__,
+			fmt->rate);
+	return 0;
+}
+
 
 static irqreturn_t spdif_interrupt(int irq, void *data)
 {
@@ -474,6 +810,12 @@ static ssize_t tegra_spdif_write(struct file *file,
 
 	mutex_lock(&ads->out.lock);
 
+	if (ads->out.mmap_buf) {
+		pr_err("%s: stream is in mmap mode\n", __func__);
+		rc = -EBUSY;
+		goto done;
+	}
+
 	if (!IS_ALIGNED(size, 4) || size < 4 || size > buf_size(&ads->out)) {
 		pr_err("%s: invalid user size %d\n", __func__, size);
 		rc = -EINVAL;
@@ -584,6 +926,59 @@ static long tegra_spdif_out_ioctl(struct file *file,
 				&aos->num_bufs, sizeof(aos->num_bufs)))
 			rc = -EFAULT;
 		break;
+	case TEGRA_AUDIO_SPDIF_SET_FORMAT: {
+		struct tegra_audio_spdif_format fmt;
+		if (copy_from_user(&fmt, (const void __user *)arg,
+					sizeof(fmt))) {
+			rc = -EFAULT;
+			break;
+		}
+		rc = spdif_set_format(ads, &fmt);
+	}
+		break;
+	case TEGRA_AUDIO_SPDIF_GET_FORMAT:
+		if (copy_to_user((void __user *)arg, &ads->format,
+				sizeof(ads->format)))
+			rc = -EFAULT;
+		break;
+	case TEGRA_AUDIO_MMAP_SET_CONFIG: {
+		struct tegra_audio_mmap_config cfg;
+		if (copy_from_user(&cfg, (const void __user *)arg,
+					sizeof(cfg))) {
+			rc = -EFAULT;
+			break;
+		}
+		rc = mmap_set_config(ads, &cfg);
+	}
+		break;
+	case TEGRA_AUDIO_MMAP_GET_CONFIG:
+		if (copy_to_user((void __user *)arg, &aos->mmap_config,
+				sizeof(aos->mmap_config)))
+			rc = -EFAULT;
+		break;
+	case TEGRA_AUDIO_MMAP_START:
+		rc = mmap_start(ads);
+		break;
+	case TEGRA_AUDIO_MMAP_STOP:
+		mmap_stop(ads);
+		break;
+	case TEGRA_AUDIO_MMAP_COMMIT: {
+		unsigned int count;
+		if (copy_from_user(&count, (const void __user *)arg,
+					sizeof(count))) {
+			rc = -EFAULT;
+			break;
+		}
+		rc = mmap_commit(ads, count);
+	}
+		break;
+	case TEGRA_AUDIO_MMAP_GET_STATUS: {
+		struct tegra_audio_mmap_status st;
+		mmap_get_status(aos, &st);
+		if (copy_to_user((void __user *)arg, &st, sizeof(st)))
+			rc = -EFAULT;
+	}
+		break;
 	default:
 		rc = -EINVAL;
 	}
@@ -630,6 +1025,8 @@ static int tegra_spdif_out_release(struct inode *inode, struct file *file)
 
 	mutex_lock(&ads->out.lock);
 	ads->out.opened = 0;
+	mmap_stop(ads);
+	mmap_free(ads);
 	request_stop_nosync(&ads->out);
 	if (stop_playback_if_necessary(&ads->out))
 		pr_debug("%s: done (stopped)\n", __func__);
@@ -640,11 +1037,49 @@ static int tegra_spdif_out_release(struct inode *inode, struct file *file)
 }
 
 
+static int tegra_spdif_out_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct audio_driver_state *ads = ads_from_misc_out(file);
+	struct audio_stream *aos = &ads->out;
+	int rc;
+
+	mutex_lock(&aos->lock);
+	if (!aos->mmap_buf || vma->vm_pgoff ||
+			vma->vm_end - vma->vm_start > aos->mmap_size) {
+		rc = -EINVAL;
+		goto done;
+	}
+	rc = dma_mmap_writecombine(&ads->pdev->dev, vma, aos->mmap_buf,
+			aos->mmap_phys, aos->mmap_size);
+done:
+	mutex_unlock(&aos->lock);
+	return rc;
+}
+
+static unsigned int tegra_spdif_out_poll(struct file *file,
+		struct poll_table_struct *wait)
+{
+	struct audio_driver_state *ads = ads_from_misc_out(file);
+	struct audio_stream *aos = &ads->out;
+	unsigned int mask = 0;
+	unsigned long flags;
+
+	poll_wait(file, &aos->mmap_wait, wait);
+	spin_lock_irqsave(&aos->dma_req_lock, flags);
+	if (!aos->mmap_buf || aos->appl_periods !=
+			aos->hw_periods + aos->mmap_config.num_periods)
+		mask |= POLLOUT | POLLWRNORM;
+	spin_unlock_irqrestore(&aos->dma_req_lock, flags);
+	return mask;
+}
+
 static const struct file_operations tegra_spdif_out_fops = {
 	.owner = THIS_MODULE,
 	.open = tegra_spdif_out_open,
 	.release = tegra_spdif_out_release,
 	.write = tegra_spdif_write,
+	.mmap = tegra_spdif_out_mmap,
+	.poll = tegra_spdif_out_poll,
 };
 
 static int tegra_spdif_ctl_open(struct inode *inode, struct file *file)
@@ -814,7 +1249,7 @@ static ssize_t tx_fifo_atn_store(struct device *dev,
 	struct tegra_audio_platform_data *pdata = dev->platform_data;
 	struct audio_driver_state *ads = pdata->driver_data;
 	mutex_lock(&ads->out.lock);
-	if (pending_buffer_requests(&ads->out)) {
+	if (pending_buffer_requests(&ads->out) || ads->out.mmap_active) {
 		pr_err("%s: playback in progress.\n", __func__);
 		rc = -EBUSY;
 		goto done;
@@ -838,14 +1273,16 @@ static int spdif_configure(struct platform_device *pdev)
 	if (!state)
 		return -ENOMEM;
 
-	set_spdif_clock(state, 44100);
+	set_spdif_clock(state, state->format.rate);
 
 	spdif_initialize(state->spdif_base, AUDIO_TX_MODE);
 
 	spdif_fifo_set_attention_level(state->spdif_base, AUDIO_TX_MODE,
 		state->out.spdif_fifo_atn_level);
 
-	spdif_set_sample_rate(state->spdif_base, 44100);
+	spdif_set_sample_rate(state->spdif_base, state->format.rate);
+	spdif_set_non_audio(state->spdif_base,
+		state->format.mode == TEGRA_AUDIO_SPDIF_NON_AUDIO);
 
 	state->fifo_init = true;
 	return 0;
@@ -901,6 +1338,8 @@ static int tegra_spdif_probe(struct platform_device *pdev)
 	}
 	state->irq = res->start;
 
+	state->format.rate = 44100;
+	state->format.mode = TEGRA_AUDIO_SPDIF_PCM;
 	rc = spdif_configure(pdev);
 	if (rc < 0)
 		return rc;
@@ -920,6 +1359,7 @@ static int tegra_spdif_probe(struct platform_device *pdev)
 		state->out.buf_phy[i] = 0;
 	}
 	state->out.last_queued = 0;
+	init_waitqueue_head(&state->out.mmap_wait);
 	rc = init_stream_buffer(&state->out, state->out.num_bufs);
 	if (rc < 0)
 		return rc;
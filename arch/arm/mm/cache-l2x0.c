@@ -21,6 +21,7 @@
 #include <linux/io.h>
 
 #include <asm/cacheflush.h>
+#include <asm/sizes.h>
 #include <asm/hardware/cache-l2x0.h>
 
 #ifdef CONFIG_TRUSTED_FOUNDATIONS
@@ -32,6 +33,7 @@ void callGenericSMC(u32 param0, u32 param1, u32 param2);
 
 static void __iomem *l2x0_base;
 static uint32_t l2x0_way_mask;	/* Bitmask of active ways */
+static unsigned long l2x0_size;	/* Range ops at least this big go by way */
 bool l2x0_disabled;
 
 static inline void cache_wait_always(void __iomem *reg, unsigned long mask)
@@ -48,10 +50,16 @@ static inline void cache_wait(void __iomem *reg, unsigned long mask)
 	/* cache operations are atomic */
 }
 
-#define _l2x0_lock(lock, flags)		((void)(flags))
-#define _l2x0_unlock(lock, flags)	((void)(flags))
-
-#define block_end(start, end)		(end)
+/*
+ * PL310 line operations are atomic, so CPUs may issue them concurrently
+ * and only share the lock.  Background operations by way must not overlap
+ * with line operations and take it exclusively.
+ */
+static DEFINE_RWLOCK(l2x0_lock);
+#define _l2x0_lock(lock, flags)		read_lock_irqsave(lock, flags)
+#define _l2x0_unlock(lock, flags)	read_unlock_irqrestore(lock, flags)
+#define _l2x0_way_lock(lock, flags)	write_lock_irqsave(lock, flags)
+#define _l2x0_way_unlock(lock, flags)	write_unlock_irqrestore(lock, flags)
 
 #define L2CC_TYPE			"PL310/L2C-310"
 
@@ -62,13 +70,16 @@ static inline void cache_wait(void __iomem *reg, unsigned long mask)
 static DEFINE_SPINLOCK(l2x0_lock);
 #define _l2x0_lock(lock, flags)		spin_lock_irqsave(lock, flags)
 #define _l2x0_unlock(lock, flags)	spin_unlock_irqrestore(lock, flags)
-
-#define block_end(start, end)		((start) + min((end) - (start), 4096UL))
+#define _l2x0_way_lock(lock, flags)	spin_lock_irqsave(lock, flags)
+#define _l2x0_way_unlock(lock, flags)	spin_unlock_irqrestore(lock, flags)
 
 #define L2CC_TYPE			"L2x0"
 
 #endif	/* CONFIG_CACHE_PL310 */
 
+/* the lock is dropped every block so way operations and irqs get in */
+#define block_end(start, end)		((start) + min((end) - (start), 4096UL))
+
 static inline void cache_sync(void)
 {
 	void __iomem *base = l2x0_base;
@@ -141,11 +152,11 @@ static inline void l2x0_inv_all(void)
 	unsigned long flags;
 
 	/* invalidate all ways */
-	_l2x0_lock(&l2x0_lock, flags);
+	_l2x0_way_lock(&l2x0_lock, flags);
 	writel_relaxed(l2x0_way_mask, l2x0_base + L2X0_INV_WAY);
 	cache_wait_always(l2x0_base + L2X0_INV_WAY, l2x0_way_mask);
 	cache_sync();
-	_l2x0_unlock(&l2x0_lock, flags);
+	_l2x0_way_unlock(&l2x0_lock, flags);
 }
 
 static inline void l2x0_flush_all(void)
@@ -153,14 +164,34 @@ static inline void l2x0_flush_all(void)
 	unsigned long flags;
 
 	/* flush all ways */
-	_l2x0_lock(&l2x0_lock, flags);
-	writel(0xff, l2x0_base + L2X0_CLEAN_INV_WAY);
-	cache_wait_always(l2x0_base + L2X0_CLEAN_INV_WAY, 0xff);
+	_l2x0_way_lock(&l2x0_lock, flags);
+	writel_relaxed(l2x0_way_mask, l2x0_base + L2X0_CLEAN_INV_WAY);
+	cache_wait_always(l2x0_base + L2X0_CLEAN_INV_WAY, l2x0_way_mask);
 	cache_sync();
-	_l2x0_unlock(&l2x0_lock, flags);
+	_l2x0_way_unlock(&l2x0_lock, flags);
 }
 
-static void l2x0_inv_range(unsigned long start, unsigned long end)
+static inline void l2x0_clean_all(void)
+{
+	unsigned long flags;
+
+	/* clean all ways */
+	_l2x0_way_lock(&l2x0_lock, flags);
+	writel_relaxed(l2x0_way_mask, l2x0_base + L2X0_CLEAN_WAY);
+	cache_wait_always(l2x0_base + L2X0_CLEAN_WAY, l2x0_way_mask);
+	cache_sync();
+	_l2x0_way_unlock(&l2x0_lock, flags);
+}
+
+/*
+ * The range operations below come in two flavours: the outer_cache
+ * entry points end with a cache sync, the _nosync ones leave it to a
+ * later outer_sync() so callers walking many ranges sync only once.
+ * An invalidate cannot be widened to the whole cache, so only clean and
+ * flush switch to way operations for ranges of l2x0_size and up.
+ */
+static void __l2x0_inv_range(unsigned long start, unsigned long end,
+			     bool sync)
 {
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
@@ -195,15 +226,22 @@ static void l2x0_inv_range(unsigned long start, unsigned long end)
 		}
 	}
 	cache_wait(base + L2X0_INV_LINE_PA, 1);
-	cache_sync();
+	if (sync)
+		cache_sync();
 	_l2x0_unlock(&l2x0_lock, flags);
 }
 
-static void l2x0_clean_range(unsigned long start, unsigned long end)
+static void __l2x0_clean_range(unsigned long start, unsigned long end,
+			       bool sync)
 {
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
 
+	if (end - start >= l2x0_size) {
+		l2x0_clean_all();
+		return;
+	}
+
 	_l2x0_lock(&l2x0_lock, flags);
 	start &= ~(CACHE_LINE_SIZE - 1);
 	while (start < end) {
@@ -220,15 +258,22 @@ static void l2x0_clean_range(unsigned long start, unsigned long end)
 		}
 	}
 	cache_wait(base + L2X0_CLEAN_LINE_PA, 1);
-	cache_sync();
+	if (sync)
+		cache_sync();
 	_l2x0_unlock(&l2x0_lock, flags);
 }
 
-static void l2x0_flush_range(unsigned long start, unsigned long end)
+static void __l2x0_flush_range(unsigned long start, unsigned long end,
+			       bool sync)
 {
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
 
+	if (end - start >= l2x0_size) {
+		l2x0_flush_all();
+		return;
+	}
+
 	_l2x0_lock(&l2x0_lock, flags);
 	start &= ~(CACHE_LINE_SIZE - 1);
 	while (start < end) {
@@ -247,10 +292,41 @@ static void l2x0_flush_range(unsigned long start, unsigned long end)
 		}
 	}
 	cache_wait(base + L2X0_CLEAN_INV_LINE_PA, 1);
-	cache_sync();
+	if (sync)
+		cache_sync();
 	_l2x0_unlock(&l2x0_lock, flags);
 }
 
+static void l2x0_inv_range(unsigned long start, unsigned long end)
+{
+	__l2x0_inv_range(start, end, true);
+}
+
+static void l2x0_clean_range(unsigned long start, unsigned long end)
+{
+	__l2x0_clean_range(start, end, true);
+}
+
+static void l2x0_flush_range(unsigned long start, unsigned long end)
+{
+	__l2x0_flush_range(start, end, true);
+}
+
+static void l2x0_inv_range_nosync(unsigned long start, unsigned long end)
+{
+	__l2x0_inv_range(start, end, false);
+}
+
+static void l2x0_clean_range_nosync(unsigned long start, unsigned long end)
+{
+	__l2x0_clean_range(start, end, false);
+}
+
+static void l2x0_flush_range_nosync(unsigned long start, unsigned long end)
+{
+	__l2x0_flush_range(start, end, false);
+}
+
 void l2x0_shutdown(void)
 {
 	unsigned long flags;
@@ -316,6 +392,7 @@ static void l2x0_enable(__u32 aux_val, __u32 aux_mask)
 	__u32 aux;
 	__u32 cache_id;
 	int ways;
+	int way_size;
 	const char *type;
 #ifdef CONFIG_SMP
 	long ret;
@@ -354,6 +431,24 @@ static void l2x0_enable(__u32 aux_val, __u32 aux_mask)
 
 	l2x0_way_mask = (1 << ways) - 1;
 
+	/*
+	 * Above the cache size a walk by line touches more lines than the
+	 * cache holds, so clean and flush by way instead.  PL310 r2p0 can
+	 * corrupt data on a background way flush racing with line fills
+	 * (erratum 727915), keep it on line operations.  So do secure
+	 * monitor setups, where the way registers belong to the monitor.
+	 */
+	way_size = (aux & L2X0_AUX_CTRL_WAY_SIZE_MASK) >> 17;
+#ifndef CONFIG_TRUSTED_FOUNDATIONS
+	if ((cache_id & L2X0_CACHE_ID_PART_MASK) == L2X0_CACHE_ID_PART_L310 &&
+	    (cache_id & L2X0_CACHE_ID_RTL_MASK) == L2X0_CACHE_ID_RTL_R2P0)
+		l2x0_size = ~0UL;
+	else
+		l2x0_size = ways * (SZ_1K << (way_size + 3));
+#else
+	l2x0_size = ~0UL;
+#endif
+
 	/*
 	 * Check if l2x0 controller is already enabled.
 	 * If you are booting from non-secure mode
@@ -431,6 +526,9 @@ void __init l2x0_init(void __iomem *base, __u32 aux_val, __u32 aux_mask)
 	outer_cache.clean_range = l2x0_clean_range;
 	outer_cache.flush_range = l2x0_flush_range;
 	outer_cache.sync = l2x0_cache_sync;
+	outer_cache.inv_range_nosync = l2x0_inv_range_nosync;
+	outer_cache.clean_range_nosync = l2x0_clean_range_nosync;
+	outer_cache.flush_range_nosync = l2x0_flush_range_nosync;
 }
 
 static int __init l2x0_disable(char *unused)
@@ -12,15 +12,35 @@
 #include <linux/mm.h>
 #include <linux/smp.h>
 #include <linux/percpu.h>
+#include <linux/bitmap.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/mmu_context.h>
 #include <asm/tlbflush.h>
 
+/*
+ * ASIDs are handed out from a single bitmap for all CPUs, and tagged
+ * with a generation in the upper bits of mm->context.id.  When the
+ * bitmap runs out a new generation starts, but the other CPUs are not
+ * interrupted: the ASID each one is running keeps its number into the
+ * new generation (reserved_asids), and each CPU flushes its own TLB
+ * the next time it allocates a context (tlb_flush_pending).
+ *
+ * ASID 0 is never allocated, it is used while the TTBR changes.
+ */
+#define NUM_USER_ASIDS		(1 << ASID_BITS)
+
 static DEFINE_SPINLOCK(cpu_asid_lock);
-unsigned int cpu_last_asid = ASID_FIRST_VERSION;
-#ifdef CONFIG_SMP
-DEFINE_PER_CPU(struct mm_struct *, current_mm);
-#endif
+unsigned int asid_generation = ASID_FIRST_VERSION;
+static DECLARE_BITMAP(asid_map, NUM_USER_ASIDS);
+static cpumask_t tlb_flush_pending;
+
+DEFINE_PER_CPU(atomic_t, active_asids);
+static DEFINE_PER_CPU(unsigned int, reserved_asids);
+
+static unsigned long asid_rollovers;
+static DEFINE_PER_CPU(unsigned long, asid_lazy_flushes);
 
 /*
  * We fork()ed a process, and we need a new context for the child
@@ -34,124 +54,141 @@ void __init_new_context(struct task_struct *tsk, struct mm_struct *mm)
 	spin_lock_init(&mm->context.id_lock);
 }
 
-static void flush_context(void)
+/*
+ * Start a new generation.  Called with cpu_asid_lock held.
+ */
+static void flush_context(unsigned int cpu)
 {
-	/* set the reserved ASID before flushing the TLB */
-	asm("mcr	p15, 0, %0, c13, c0, 1\n" : : "r" (0));
-	isb();
-	local_flush_tlb_all();
+	unsigned int asid;
+	int i;
+
+	bitmap_clear(asid_map, 0, NUM_USER_ASIDS);
+
+	for_each_possible_cpu(i) {
+		if (i == cpu) {
+			/* this CPU is switching away, it reserves nothing */
+			asid = 0;
+		} else {
+			/*
+			 * A CPU that has not switched context since the
+			 * previous rollover is still running its reserved ASID.
+			 */
+			asid = atomic_xchg(&per_cpu(active_asids, i), 0);
+			if (asid == 0)
+				asid = per_cpu(reserved_asids, i);
+			__set_bit(asid & ~ASID_MASK, asid_map);
+		}
+		per_cpu(reserved_asids, i) = asid;
+	}
+
+	cpumask_setall(&tlb_flush_pending);
+	asid_rollovers++;
+
 	if (icache_is_vivt_asid_tagged()) {
 		__flush_icache_all();
 		dsb();
 	}
 }
 
-#ifdef CONFIG_SMP
+static int is_reserved_asid(unsigned int asid)
+{
+	int cpu;
 
-static void set_mm_context(struct mm_struct *mm, unsigned int asid)
+	for_each_possible_cpu(cpu)
+		if (per_cpu(reserved_asids, cpu) == asid)
+			return 1;
+
+	return 0;
+}
+
+static unsigned int new_context(struct mm_struct *mm, unsigned int cpu)
 {
-	unsigned long flags;
+	unsigned int asid = mm->context.id;
 
 	/*
-	 * Locking needed for multi-threaded applications where the
-	 * same mm->context.id could be set from different CPUs during
-	 * the broadcast. This function is also called via IPI so the
-	 * mm->context.id_lock has to be IRQ-safe.
+	 * If the mm was running somewhere across the rollover, it keeps
+	 * its ASID so the CPU still using it does not have to be told.
 	 */
-	spin_lock_irqsave(&mm->context.id_lock, flags);
-	if (likely((mm->context.id ^ cpu_last_asid) >> ASID_BITS)) {
-		/*
-		 * Old version of ASID found. Set the new one and
-		 * reset mm_cpumask(mm).
-		 */
-		mm->context.id = asid;
-		cpumask_clear(mm_cpumask(mm));
+	if (asid != 0 && is_reserved_asid(asid))
+		return asid_generation | (asid & ~ASID_MASK);
+
+	asid = find_next_zero_bit(asid_map, NUM_USER_ASIDS, 1);
+	if (asid == NUM_USER_ASIDS) {
+		asid_generation += ASID_FIRST_VERSION;
+		if (asid_generation == 0)
+			asid_generation = ASID_FIRST_VERSION;
+		flush_context(cpu);
+		asid = find_next_zero_bit(asid_map, NUM_USER_ASIDS, 1);
 	}
-	spin_unlock_irqrestore(&mm->context.id_lock, flags);
 
-	/*
-	 * Set the mm_cpumask(mm) bit for the current CPU.
-	 */
-	cpumask_set_cpu(smp_processor_id(), mm_cpumask(mm));
+	__set_bit(asid, asid_map);
+	cpumask_clear(mm_cpumask(mm));
+
+	return asid_generation | asid;
 }
 
-/*
- * Reset the ASID on the current CPU. This function call is broadcast
- * from the CPU handling the ASID rollover and holding cpu_asid_lock.
- */
-static void reset_context(void *info)
+void __new_context(struct mm_struct *mm)
 {
-	unsigned int asid;
 	unsigned int cpu = smp_processor_id();
-	struct mm_struct *mm = per_cpu(current_mm, cpu);
+	unsigned long flags;
+	unsigned int asid;
 
-	/*
-	 * Check if a current_mm was set on this CPU as it might still
-	 * be in the early booting stages and using the reserved ASID.
-	 */
-	if (!mm)
-		return;
+	spin_lock_irqsave(&cpu_asid_lock, flags);
 
-	smp_rmb();
-	asid = cpu_last_asid + cpu + 1;
+	/* another thread of this mm may have updated it meanwhile */
+	asid = mm->context.id;
+	if ((asid ^ asid_generation) >> ASID_BITS) {
+		asid = new_context(mm, cpu);
+		mm->context.id = asid;
+	}
 
-	flush_context();
-	set_mm_context(mm, asid);
+	if (cpumask_test_and_clear_cpu(cpu, &tlb_flush_pending)) {
+		/* set the reserved ASID before flushing the TLB */
+		asm("mcr	p15, 0, %0, c13, c0, 1\n" : : "r" (0));
+		isb();
+		local_flush_tlb_all();
+		__get_cpu_var(asid_lazy_flushes)++;
+	}
 
-	/* set the new ASID */
-	asm("mcr	p15, 0, %0, c13, c0, 1\n" : : "r" (mm->context.id));
-	isb();
-}
+	atomic_set(&per_cpu(active_asids, cpu), asid);
+	cpumask_set_cpu(cpu, mm_cpumask(mm));
 
-#else
+	spin_unlock_irqrestore(&cpu_asid_lock, flags);
+}
 
-static inline void set_mm_context(struct mm_struct *mm, unsigned int asid)
+#ifdef CONFIG_DEBUG_FS
+static int asid_stats_show(struct seq_file *s, void *data)
 {
-	mm->context.id = asid;
-	cpumask_copy(mm_cpumask(mm), cpumask_of(smp_processor_id()));
-}
+	int cpu;
 
-#endif
+	seq_printf(s, "generation: %u\n", asid_generation >> ASID_BITS);
+	seq_printf(s, "rollovers:  %lu\n", asid_rollovers);
+	for_each_possible_cpu(cpu)
+		seq_printf(s, "cpu%d lazy flushes: %lu\n", cpu,
+			   per_cpu(asid_lazy_flushes, cpu));
 
-void __new_context(struct mm_struct *mm)
+	return 0;
+}
+
+static int asid_stats_open(struct inode *inode, struct file *file)
 {
-	unsigned int asid;
+	return single_open(file, asid_stats_show, inode->i_private);
+}
 
-	spin_lock(&cpu_asid_lock);
-#ifdef CONFIG_SMP
-	/*
-	 * Check the ASID again, in case the change was broadcast from
-	 * another CPU before we acquired the lock.
-	 */
-	if (unlikely(((mm->context.id ^ cpu_last_asid) >> ASID_BITS) == 0)) {
-		cpumask_set_cpu(smp_processor_id(), mm_cpumask(mm));
-		spin_unlock(&cpu_asid_lock);
-		return;
-	}
-#endif
-	/*
-	 * At this point, it is guaranteed that the current mm (with
-	 * an old ASID) isn't active on any other CPU since the ASIDs
-	 * are changed simultaneously via IPI.
-	 */
-	asid = ++cpu_last_asid;
-	if (asid == 0)
-		asid = cpu_last_asid = ASID_FIRST_VERSION;
+static const struct file_operations asid_stats_fops = {
+	.open		= asid_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
 
-	/*
-	 * If we've used up all our ASIDs, we need
-	 * to start a new version and flush the TLB.
-	 */
-	if (unlikely((asid & ~ASID_MASK) == 0)) {
-		asid = cpu_last_asid + smp_processor_id() + 1;
-		flush_context();
-#ifdef CONFIG_SMP
-		smp_wmb();
-		smp_call_function(reset_context, NULL, 1);
-#endif
-		cpu_last_asid += NR_CPUS;
-	}
+static int __init asid_debugfs_init(void)
+{
+	if (!debugfs_create_file("asid", S_IRUGO, NULL, NULL,
+				 &asid_stats_fops))
+		return -ENOMEM;
 
-	set_mm_context(mm, asid);
-	spin_unlock(&cpu_asid_lock);
+	return 0;
 }
+late_initcall(asid_debugfs_init);
+#endif
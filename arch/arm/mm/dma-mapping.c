@@ -17,12 +17,20 @@
 #include <linux/init.h>
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
 
 #include <asm/memory.h>
 #include <asm/highmem.h>
 #include <asm/cacheflush.h>
 #include <asm/tlbflush.h>
 #include <asm/sizes.h>
+#include <asm/mach/map.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/dma.h>
 
 static u64 get_coherent_dma_mask(struct device *dev)
 {
@@ -231,6 +239,10 @@ __dma_alloc_remap(struct page *page, size_t size, gfp_t gfp, pgprot_t prot)
 
 		dsb();
 
+		/* alloc_pages() blocks are naturally aligned, like c */
+		if (c->vm_end - c->vm_start >= SZ_64K)
+			remap_kernel_large_pages(c->vm_start, c->vm_end);
+
 		return (void *)c->vm_start;
 	}
 	return NULL;
@@ -291,6 +303,222 @@ static void __dma_free_remap(void *cpu_addr, size_t size)
 
 #endif	/* CONFIG_MMU */
 
+/*
+ * Per driver accounting of coherent allocations, for debugfs.  Entries
+ * are only ever added, so lookups need no lock.
+ */
+#define DMA_STATS_MAX		32
+
+struct dma_alloc_stats {
+	const char	*name;
+	atomic_t	allocs;
+	atomic_t	pooled;
+	atomic_t	bytes;
+};
+
+static struct dma_alloc_stats dma_stats[DMA_STATS_MAX];
+static int dma_stats_nr;
+static DEFINE_SPINLOCK(dma_stats_lock);
+
+static struct dma_alloc_stats *dma_stats_get(struct device *dev)
+{
+	const char *name = dev ? dev_driver_string(dev) : "(none)";
+	struct dma_alloc_stats *s = NULL;
+	unsigned long flags;
+	int i, nr;
+
+	nr = ACCESS_ONCE(dma_stats_nr);
+	smp_rmb();
+	for (i = 0; i < nr; i++)
+		if (dma_stats[i].name == name)
+			return &dma_stats[i];
+
+	spin_lock_irqsave(&dma_stats_lock, flags);
+	for (i = 0; i < dma_stats_nr; i++)
+		if (dma_stats[i].name == name)
+			break;
+	if (i < dma_stats_nr) {
+		s = &dma_stats[i];
+	} else if (dma_stats_nr < DMA_STATS_MAX) {
+		s = &dma_stats[dma_stats_nr];
+		s->name = name;
+		smp_wmb();
+		dma_stats_nr++;
+	}
+	spin_unlock_irqrestore(&dma_stats_lock, flags);
+
+	return s;
+}
+
+static void dma_stats_add(struct device *dev, int bytes, bool pooled)
+{
+	struct dma_alloc_stats *s = dma_stats_get(dev);
+
+	if (!s)
+		return;
+
+	atomic_add(bytes, &s->bytes);
+	if (bytes > 0) {
+		atomic_inc(&s->allocs);
+		if (pooled)
+			atomic_inc(&s->pooled);
+	}
+}
+
+static void *
+__dma_alloc(struct device *dev, size_t size, dma_addr_t *handle, gfp_t gfp,
+	    pgprot_t prot);
+
+#ifdef CONFIG_MMU
+/*
+ * Small coherent buffers (descriptor rings, ADMA tables, dTDs) are
+ * carved from 64K chunks with a bitmap per size class, instead of
+ * taking a whole page and a walk of the consistent region list each.
+ * Allocation and free only use atomic bitops; the chunk lists only
+ * grow, under a lock.  Chunks are never returned.
+ */
+#define DMA_POOL_CHUNK		SZ_64K
+#define DMA_POOL_MIN_SHIFT	5
+#define DMA_POOL_MAX_SHIFT	11
+#define DMA_POOL_CLASSES	(DMA_POOL_MAX_SHIFT - DMA_POOL_MIN_SHIFT + 1)
+
+struct dma_pool_chunk {
+	struct dma_pool_chunk	*next;
+	void			*virt;
+	dma_addr_t		dma;
+	unsigned long		map[BITS_TO_LONGS(DMA_POOL_CHUNK >>
+						  DMA_POOL_MIN_SHIFT)];
+};
+
+struct dma_pool_class {
+	struct dma_pool_chunk	*chunks;
+	unsigned int		nr_chunks;
+	atomic_t		in_use;
+};
+
+struct dma_small_pool {
+	const char		*name;
+	struct dma_pool_class	classes[DMA_POOL_CLASSES];
+};
+
+static struct dma_small_pool dma_coherent_pool = { .name = "coherent" };
+static struct dma_small_pool dma_wc_pool = { .name = "writecombine" };
+static DEFINE_SPINLOCK(dma_pool_lock);
+
+static void *dma_pool_chunk_alloc(struct dma_pool_chunk *c,
+	unsigned int shift, dma_addr_t *handle)
+{
+	unsigned int nr = DMA_POOL_CHUNK >> shift;
+	unsigned int bit;
+
+	for (;;) {
+		bit = find_first_zero_bit(c->map, nr);
+		if (bit >= nr)
+			return NULL;
+		if (!test_and_set_bit(bit, c->map))
+			break;
+	}
+
+	*handle = c->dma + (bit << shift);
+	return c->virt + (bit << shift);
+}
+
+static void *__dma_pool_alloc(struct dma_small_pool *pool,
+	struct device *dev, size_t size, dma_addr_t *handle, gfp_t gfp,
+	pgprot_t prot)
+{
+	unsigned int shift = max_t(unsigned int, fls(size - 1),
+				   DMA_POOL_MIN_SHIFT);
+	struct dma_pool_class *pc;
+	struct dma_pool_chunk *c;
+	unsigned long flags;
+	void *addr = NULL;
+
+	if (shift > DMA_POOL_MAX_SHIFT || arch_is_coherent())
+		return NULL;
+
+	/* chunks are shared, so only for devices that can reach them all */
+	if (get_coherent_dma_mask(dev) < 0xffffffffULL)
+		return NULL;
+
+	pc = &pool->classes[shift - DMA_POOL_MIN_SHIFT];
+
+	for (c = ACCESS_ONCE(pc->chunks); c; c = c->next) {
+		smp_read_barrier_depends();
+		addr = dma_pool_chunk_alloc(c, shift, handle);
+		if (addr)
+			goto out;
+	}
+
+	c = kzalloc(sizeof(*c), gfp & ~(__GFP_DMA | __GFP_HIGHMEM));
+	if (!c)
+		return NULL;
+
+	c->virt = __dma_alloc(dev, DMA_POOL_CHUNK, &c->dma, gfp, prot);
+	if (!c->virt) {
+		kfree(c);
+		return NULL;
+	}
+
+	addr = dma_pool_chunk_alloc(c, shift, handle);
+
+	spin_lock_irqsave(&dma_pool_lock, flags);
+	c->next = pc->chunks;
+	smp_wmb();
+	pc->chunks = c;
+	pc->nr_chunks++;
+	spin_unlock_irqrestore(&dma_pool_lock, flags);
+
+out:
+	atomic_inc(&pc->in_use);
+	memset(addr, 0, 1 << shift);
+	return addr;
+}
+
+static bool __dma_pool_free(struct dma_small_pool *pool, void *cpu_addr)
+{
+	struct dma_pool_class *pc;
+	struct dma_pool_chunk *c;
+	unsigned int shift;
+	unsigned long off;
+
+	for (shift = DMA_POOL_MIN_SHIFT; shift <= DMA_POOL_MAX_SHIFT; shift++) {
+		pc = &pool->classes[shift - DMA_POOL_MIN_SHIFT];
+		for (c = ACCESS_ONCE(pc->chunks); c; c = c->next) {
+			smp_read_barrier_depends();
+			if (cpu_addr < c->virt ||
+			    cpu_addr >= c->virt + DMA_POOL_CHUNK)
+				continue;
+
+			off = cpu_addr - c->virt;
+			if (WARN_ON(off & ((1 << shift) - 1)) ||
+			    WARN_ON(!test_and_clear_bit(off >> shift, c->map)))
+				return true;
+
+			atomic_dec(&pc->in_use);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool dma_pool_free(void *cpu_addr, size_t size)
+{
+	if (size > (1 << DMA_POOL_MAX_SHIFT))
+		return false;
+
+	return __dma_pool_free(&dma_coherent_pool, cpu_addr) ||
+		__dma_pool_free(&dma_wc_pool, cpu_addr);
+}
+
+#else	/* !CONFIG_MMU */
+
+#define __dma_pool_alloc(pool, dev, size, handle, gfp, prot)	NULL
+#define dma_pool_free(cpu_addr, size)				false
+
+#endif	/* CONFIG_MMU */
+
 static void *
 __dma_alloc(struct device *dev, size_t size, dma_addr_t *handle, gfp_t gfp,
 	    pgprot_t prot)
@@ -328,8 +556,19 @@ dma_alloc_coherent(struct device *dev, size_t size, dma_addr_t *handle, gfp_t gf
 	if (dma_alloc_from_coherent(dev, size, handle, &memory))
 		return memory;
 
-	return __dma_alloc(dev, size, handle, gfp,
-			   pgprot_dmacoherent(pgprot_kernel));
+	memory = __dma_pool_alloc(&dma_coherent_pool, dev, size, handle, gfp,
+				  pgprot_dmacoherent(pgprot_kernel));
+	if (memory) {
+		dma_stats_add(dev, size, true);
+		return memory;
+	}
+
+	memory = __dma_alloc(dev, size, handle, gfp,
+			     pgprot_dmacoherent(pgprot_kernel));
+	if (memory)
+		dma_stats_add(dev, PAGE_ALIGN(size), false);
+
+	return memory;
 }
 EXPORT_SYMBOL(dma_alloc_coherent);
 
@@ -340,8 +579,21 @@ EXPORT_SYMBOL(dma_alloc_coherent);
 void *
 dma_alloc_writecombine(struct device *dev, size_t size, dma_addr_t *handle, gfp_t gfp)
 {
-	return __dma_alloc(dev, size, handle, gfp,
-			   pgprot_writecombine(pgprot_kernel));
+	void *memory;
+
+	memory = __dma_pool_alloc(&dma_wc_pool, dev, size, handle, gfp,
+				  pgprot_writecombine(pgprot_kernel));
+	if (memory) {
+		dma_stats_add(dev, size, true);
+		return memory;
+	}
+
+	memory = __dma_alloc(dev, size, handle, gfp,
+			     pgprot_writecombine(pgprot_kernel));
+	if (memory)
+		dma_stats_add(dev, PAGE_ALIGN(size), false);
+
+	return memory;
 }
 EXPORT_SYMBOL(dma_alloc_writecombine);
 
@@ -401,7 +653,13 @@ void dma_free_coherent(struct device *dev, size_t size, void *cpu_addr, dma_addr
 	if (dma_release_from_coherent(dev, get_order(size), cpu_addr))
 		return;
 
+	if (dma_pool_free(cpu_addr, size)) {
+		dma_stats_add(dev, -(int)size, true);
+		return;
+	}
+
 	size = PAGE_ALIGN(size);
+	dma_stats_add(dev, -(int)size, false);
 
 	if (!arch_is_coherent())
 		__dma_free_remap(cpu_addr, size);
@@ -495,7 +753,11 @@ static void dma_cache_maint_page(struct page *page, unsigned long offset,
 	} while (left);
 }
 
-void ___dma_page_cpu_to_dev(struct page *page, unsigned long off,
+/*
+ * The outer cache operations below do not wait for the controller; the
+ * caller issues outer_sync() once all of its ranges have been queued.
+ */
+static void dma_page_cpu_to_dev_nosync(struct page *page, unsigned long off,
 	size_t size, enum dma_data_direction dir)
 {
 	unsigned long paddr;
@@ -504,12 +766,19 @@ void ___dma_page_cpu_to_dev(struct page *page, unsigned long off,
 
 	paddr = page_to_phys(page) + off;
 	if (dir == DMA_FROM_DEVICE) {
-		outer_inv_range(paddr, paddr + size);
+		outer_inv_range_nosync(paddr, paddr + size);
 	} else {
-		outer_clean_range(paddr, paddr + size);
+		outer_clean_range_nosync(paddr, paddr + size);
 	}
 	/* FIXME: non-speculating: flush on bidirectional mappings? */
 }
+
+void ___dma_page_cpu_to_dev(struct page *page, unsigned long off,
+	size_t size, enum dma_data_direction dir)
+{
+	dma_page_cpu_to_dev_nosync(page, off, size, dir);
+	outer_sync();
+}
 EXPORT_SYMBOL(___dma_page_cpu_to_dev);
 
 void ___dma_page_dev_to_cpu(struct page *page, unsigned long off,
@@ -532,6 +801,68 @@ void ___dma_page_dev_to_cpu(struct page *page, unsigned long off,
 }
 EXPORT_SYMBOL(___dma_page_dev_to_cpu);
 
+#if !defined(CONFIG_DMABOUNCE)
+/*
+ * Scatterlists are maintained segment by segment with the nosync outer
+ * cache operations and wait for the outer cache once per call.
+ */
+static void dma_sg_cpu_to_dev(struct device *dev, struct scatterlist *sg,
+	int nents, enum dma_data_direction dir, const char *op)
+{
+	unsigned long long start = sched_clock();
+	struct scatterlist *s;
+	size_t bytes = 0;
+	int skip_clean;
+	int i;
+
+	/* lines the CPU has not written since the last unmap are clean */
+	skip_clean = dir == DMA_FROM_DEVICE && dev &&
+		     dev->archdata.dma_rx_clean;
+
+	for_each_sg(sg, s, nents, i) {
+		bytes += s->length;
+		if (skip_clean && !((s->offset | s->length) &
+				    (L1_CACHE_BYTES - 1)))
+			continue;
+		dma_page_cpu_to_dev_nosync(sg_page(s), s->offset,
+					   s->length, dir);
+	}
+	outer_sync();
+
+	trace_dma_sg_maint(op, nents, bytes, dir, sched_clock() - start);
+}
+
+static void dma_sg_dev_to_cpu(struct device *dev, struct scatterlist *sg,
+	int nents, enum dma_data_direction dir, const char *op)
+{
+	unsigned long long start = sched_clock();
+	struct scatterlist *s;
+	size_t bytes = 0;
+	int i;
+
+	/* the outer invalidate must complete before the inner one */
+	if (dir != DMA_TO_DEVICE) {
+		for_each_sg(sg, s, nents, i) {
+			unsigned long paddr = page_to_phys(sg_page(s)) +
+					      s->offset;
+
+			outer_inv_range_nosync(paddr, paddr + s->length);
+		}
+		outer_sync();
+	}
+
+	for_each_sg(sg, s, nents, i) {
+		bytes += s->length;
+		dma_cache_maint_page(sg_page(s), s->offset, s->length, dir,
+				     dmac_unmap_area);
+		if (dir != DMA_TO_DEVICE)
+			set_bit(PG_dcache_clean, &sg_page(s)->flags);
+	}
+
+	trace_dma_sg_maint(op, nents, bytes, dir, sched_clock() - start);
+}
+#endif
+
 /**
  * dma_map_sg - map a set of SG buffers for streaming mode DMA
  * @dev: valid struct device pointer, or NULL for ISA and EISA-like devices
@@ -554,6 +885,16 @@ int dma_map_sg(struct device *dev, struct scatterlist *sg, int nents,
 	struct scatterlist *s;
 	int i, j;
 
+#if !defined(CONFIG_DMABOUNCE)
+	if (!arch_is_coherent()) {
+		for_each_sg(sg, s, nents, i)
+			s->dma_address = page_to_dma(dev, sg_page(s)) +
+					 s->offset;
+		dma_sg_cpu_to_dev(dev, sg, nents, dir, "map");
+		return nents;
+	}
+#endif
+
 	for_each_sg(sg, s, nents, i) {
 		s->dma_address = dma_map_page(dev, sg_page(s), s->offset,
 						s->length, dir);
@@ -585,6 +926,13 @@ void dma_unmap_sg(struct device *dev, struct scatterlist *sg, int nents,
 	struct scatterlist *s;
 	int i;
 
+#if !defined(CONFIG_DMABOUNCE)
+	if (!arch_is_coherent()) {
+		dma_sg_dev_to_cpu(dev, sg, nents, dir, "unmap");
+		return;
+	}
+#endif
+
 	for_each_sg(sg, s, nents, i)
 		dma_unmap_page(dev, sg_dma_address(s), sg_dma_len(s), dir);
 }
@@ -603,6 +951,13 @@ void dma_sync_sg_for_cpu(struct device *dev, struct scatterlist *sg,
 	struct scatterlist *s;
 	int i;
 
+#if !defined(CONFIG_DMABOUNCE)
+	if (!arch_is_coherent()) {
+		dma_sg_dev_to_cpu(dev, sg, nents, dir, "sync_cpu");
+		return;
+	}
+#endif
+
 	for_each_sg(sg, s, nents, i) {
 		if (!dmabounce_sync_for_cpu(dev, sg_dma_address(s), 0,
 					    sg_dma_len(s), dir))
@@ -627,6 +982,13 @@ void dma_sync_sg_for_device(struct device *dev, struct scatterlist *sg,
 	struct scatterlist *s;
 	int i;
 
+#if !defined(CONFIG_DMABOUNCE)
+	if (!arch_is_coherent()) {
+		dma_sg_cpu_to_dev(dev, sg, nents, dir, "sync_device");
+		return;
+	}
+#endif
+
 	for_each_sg(sg, s, nents, i) {
 		if (!dmabounce_sync_for_device(dev, sg_dma_address(s), 0,
 					sg_dma_len(s), dir))
@@ -637,3 +999,63 @@ void dma_sync_sg_for_device(struct device *dev, struct scatterlist *sg,
 	}
 }
 EXPORT_SYMBOL(dma_sync_sg_for_device);
+
+#ifdef CONFIG_DEBUG_FS
+static int dma_coherent_stats_show(struct seq_file *s, void *data)
+{
+	int i, nr;
+#ifdef CONFIG_MMU
+	struct dma_small_pool *pools[] = { &dma_coherent_pool, &dma_wc_pool };
+	int p;
+
+	seq_printf(s, "%-12s %6s %6s %8s\n", "pool", "size", "chunks",
+		   "in use");
+	for (p = 0; p < ARRAY_SIZE(pools); p++) {
+		for (i = 0; i < DMA_POOL_CLASSES; i++) {
+			struct dma_pool_class *pc = &pools[p]->classes[i];
+
+			if (!pc->nr_chunks)
+				continue;
+			seq_printf(s, "%-12s %6u %6u %8d\n", pools[p]->name,
+				   1 << (i + DMA_POOL_MIN_SHIFT),
+				   pc->nr_chunks, atomic_read(&pc->in_use));
+		}
+	}
+	seq_printf(s, "\n");
+#endif
+
+	seq_printf(s, "%-20s %8s %8s %10s\n", "driver", "allocs", "pooled",
+		   "bytes");
+	nr = ACCESS_ONCE(dma_stats_nr);
+	smp_rmb();
+	for (i = 0; i < nr; i++)
+		seq_printf(s, "%-20s %8d %8d %10d\n", dma_stats[i].name,
+			   atomic_read(&dma_stats[i].allocs),
+			   atomic_read(&dma_stats[i].pooled),
+			   atomic_read(&dma_stats[i].bytes));
+
+	return 0;
+}
+
+static int dma_coherent_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dma_coherent_stats_show, inode->i_private);
+}
+
+static const struct file_operations dma_coherent_stats_fops = {
+	.open		= dma_coherent_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init dma_coherent_debugfs_init(void)
+{
+	if (!debugfs_create_file("dma_coherent", S_IRUGO, NULL, NULL,
+				 &dma_coherent_stats_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+late_initcall(dma_coherent_debugfs_init);
+#endif
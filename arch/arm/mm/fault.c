@@ -39,6 +39,23 @@ static inline int fsr_fs(unsigned int fsr)
 	return (fsr & FSR_FS3_0) | (fsr & FSR_FS4) >> 6;
 }
 
+/*
+ * Page translation (0x07) and page permission (0x0f) faults are almost
+ * every abort an ARMv7 system takes.  Both always go to do_page_fault()
+ * and are never hooked, so they skip the fault status table.
+ */
+#if __LINUX_ARM_ARCH__ >= 7
+static inline bool fsr_is_page_fault(unsigned int fsr)
+{
+	return (fsr & (FSR_FS4 | 7)) == 7;
+}
+#else
+static inline bool fsr_is_page_fault(unsigned int fsr)
+{
+	return false;
+}
+#endif
+
 #ifdef CONFIG_MMU
 
 #ifdef CONFIG_KPROBES
@@ -532,7 +549,10 @@ do_DataAbort(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 	const struct fsr_info *inf = fsr_info + fsr_fs(fsr);
 	struct siginfo info;
 
-	if (!inf->fn(addr, fsr & ~FSR_LNX_PF, regs))
+	if (fsr_is_page_fault(fsr)) {
+		if (!do_page_fault(addr, fsr & ~FSR_LNX_PF, regs))
+			return;
+	} else if (!inf->fn(addr, fsr & ~FSR_LNX_PF, regs))
 		return;
 
 	printk(KERN_ALERT "Unhandled fault: %s (0x%03x) at 0x%08lx\n",
@@ -587,7 +607,10 @@ do_PrefetchAbort(unsigned long addr, unsigned int ifsr, struct pt_regs *regs)
 	const struct fsr_info *inf = ifsr_info + fsr_fs(ifsr);
 	struct siginfo info;
 
-	if (!inf->fn(addr, ifsr | FSR_LNX_PF, regs))
+	if (fsr_is_page_fault(ifsr)) {
+		if (!do_page_fault(addr, ifsr | FSR_LNX_PF, regs))
+			return;
+	} else if (!inf->fn(addr, ifsr | FSR_LNX_PF, regs))
 		return;
 
 	printk(KERN_ALERT "Unhandled prefetch abort: %s (0x%03x) at 0x%08lx\n",
@@ -11,8 +11,11 @@
  */
 
 #include <linux/module.h>
+#include <linux/debugfs.h>
 #include <linux/highmem.h>
 #include <linux/interrupt.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
 #include <asm/fixmap.h>
 #include <asm/cacheflush.h>
 #include <asm/tlbflush.h>
@@ -36,6 +39,30 @@ void kunmap(struct page *page)
 }
 EXPORT_SYMBOL(kunmap);
 
+/*
+ * When debugging is off, kunmap_atomic leaves the previous mapping in
+ * place, so each per-CPU slot keeps remembering the last page it held.
+ * Mapping that page again in the same slot needs neither the PTE write
+ * nor the TLB flush.  The counters are per-CPU and not irq safe, which
+ * is fine for telling how often that happens.
+ */
+static DEFINE_PER_CPU(unsigned long, kmap_atomic_hits);
+static DEFINE_PER_CPU(unsigned long, kmap_atomic_misses);
+
+static inline void kmap_atomic_set_pte(unsigned long vaddr, pte_t pte)
+{
+	pte_t *ptep = TOP_PTE(vaddr);
+
+	if (pte_val(*ptep) == pte_val(pte)) {
+		__get_cpu_var(kmap_atomic_hits)++;
+		return;
+	}
+
+	__get_cpu_var(kmap_atomic_misses)++;
+	set_pte_ext(ptep, pte, 0);
+	local_flush_tlb_kernel_page(vaddr);
+}
+
 void *kmap_atomic(struct page *page, enum km_type type)
 {
 	unsigned int idx;
@@ -70,13 +97,7 @@ void *kmap_atomic(struct page *page, enum km_type type)
 	 */
 	BUG_ON(!pte_none(*(TOP_PTE(vaddr))));
 #endif
-	set_pte_ext(TOP_PTE(vaddr), mk_pte(page, kmap_prot), 0);
-	/*
-	 * When debugging is off, kunmap_atomic leaves the previous mapping
-	 * in place, so this TLB flush ensures the TLB is updated with the
-	 * new mapping.
-	 */
-	local_flush_tlb_kernel_page(vaddr);
+	kmap_atomic_set_pte(vaddr, mk_pte(page, kmap_prot));
 
 	return (void *)vaddr;
 }
@@ -117,12 +138,50 @@ void *kmap_atomic_pfn(unsigned long pfn, enum km_type type)
 #ifdef CONFIG_DEBUG_HIGHMEM
 	BUG_ON(!pte_none(*(TOP_PTE(vaddr))));
 #endif
-	set_pte_ext(TOP_PTE(vaddr), pfn_pte(pfn, kmap_prot), 0);
-	local_flush_tlb_kernel_page(vaddr);
+	kmap_atomic_set_pte(vaddr, pfn_pte(pfn, kmap_prot));
 
 	return (void *)vaddr;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int kmap_atomic_stats_show(struct seq_file *s, void *data)
+{
+	unsigned long hits, misses;
+	int cpu;
+
+	seq_printf(s, "cpu       hits     misses\n");
+	for_each_possible_cpu(cpu) {
+		hits = per_cpu(kmap_atomic_hits, cpu);
+		misses = per_cpu(kmap_atomic_misses, cpu);
+		seq_printf(s, "%3d %10lu %10lu\n", cpu, hits, misses);
+	}
+
+	return 0;
+}
+
+static int kmap_atomic_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, kmap_atomic_stats_show, inode->i_private);
+}
+
+static const struct file_operations kmap_atomic_stats_fops = {
+	.open		= kmap_atomic_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init kmap_atomic_debugfs_init(void)
+{
+	if (!debugfs_create_file("kmap_atomic", S_IRUGO, NULL, NULL,
+				 &kmap_atomic_stats_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+late_initcall(kmap_atomic_debugfs_init);
+#endif
+
 struct page *kmap_atomic_to_page(const void *ptr)
 {
 	unsigned long vaddr = (unsigned long)ptr;
@@ -137,8 +196,6 @@ struct page *kmap_atomic_to_page(const void *ptr)
 
 #ifdef CONFIG_CPU_CACHE_VIPT
 
-#include <linux/percpu.h>
-
 /*
  * The VIVT cache of a highmem page is always flushed before the page
  * is unmapped. Hence unmapped highmem pages need no cache maintenance
@@ -50,6 +50,97 @@ int ioremap_page(unsigned long virt, unsigned long phys,
 }
 EXPORT_SYMBOL(ioremap_page);
 
+/*
+ * ARMv6+ large page descriptors carry the same attributes as extended
+ * small pages, but TEX moves from bits 6-8 to 12-14 and XN from bit 0
+ * to bit 15.  All 16 hardware entries of a 64K page hold the same value.
+ */
+#define LARGE_PAGE_PTES		(SZ_64K >> PAGE_SHIFT)
+#define PTE_LARGE_XN		(1 << 15)
+#define PTE_LARGE_TEX_SHIFT	6
+#define PTE_SMALL_ATTRS		(PTE_BUFFERABLE | PTE_CACHEABLE | \
+				 PTE_EXT_AP_MASK | PTE_EXT_APX | \
+				 PTE_EXT_SHARED | PTE_EXT_NG)
+
+static inline u32 *hw_pte(pte_t *ptep)
+{
+	/* the hardware tables sit 2048 bytes below the Linux ones */
+	return (u32 *)ptep - PTRS_PER_PTE;
+}
+
+/*
+ * A run can become a large page if the 16 small pages are present, map
+ * one 64K aligned physical block in order, and share their attributes.
+ */
+static bool pte_run_is_large(pte_t *ptep)
+{
+	u32 *hw = hw_pte(ptep);
+	unsigned long pfn = pte_pfn(*ptep);
+	int i;
+
+	if (pfn & (LARGE_PAGE_PTES - 1))
+		return false;
+
+	for (i = 0; i < LARGE_PAGE_PTES; i++) {
+		if (!pte_present(ptep[i]) || pte_pfn(ptep[i]) != pfn + i)
+			return false;
+		if ((hw[i] & PTE_TYPE_MASK) != PTE_TYPE_SMALL ||
+		    (hw[i] & ~PAGE_MASK) != (hw[0] & ~PAGE_MASK))
+			return false;
+	}
+
+	return true;
+}
+
+static void pte_run_set_large(pte_t *ptep)
+{
+	u32 *hw = hw_pte(ptep);
+	u32 small = hw[0];
+	u32 large;
+	int i;
+
+	large = (small & ~(SZ_64K - 1)) | PTE_TYPE_LARGE |
+		(small & PTE_SMALL_ATTRS) |
+		((small & PTE_EXT_TEX(7)) << PTE_LARGE_TEX_SHIFT);
+	if (small & PTE_EXT_XN)
+		large |= PTE_LARGE_XN;
+
+	for (i = 0; i < LARGE_PAGE_PTES; i++)
+		hw[i] = large;
+
+	clean_dcache_area(hw, LARGE_PAGE_PTES * sizeof(*hw));
+}
+
+/*
+ * Collapse the kernel page mappings in [addr, end) into 64K large pages
+ * wherever the virtual and physical addresses are both 64K aligned, to
+ * save TLB entries on big contiguous buffers.  The Linux ptes are left
+ * as they are, so the range is still torn down by vunmap() as usual.
+ */
+void remap_kernel_large_pages(unsigned long addr, unsigned long end)
+{
+	unsigned long start = addr;
+
+	if (cpu_architecture() < CPU_ARCH_ARMv6 || !(get_cr() & CR_XP))
+		return;
+
+	for (addr = ALIGN(addr, SZ_64K); addr + SZ_64K <= end;
+	     addr += SZ_64K) {
+		pmd_t *pmd = pmd_offset(pgd_offset_k(addr), addr);
+		pte_t *ptep;
+
+		if (pmd_none(*pmd) || pmd_bad(*pmd))
+			continue;
+
+		ptep = pte_offset_kernel(pmd, addr);
+		if (pte_run_is_large(ptep))
+			pte_run_set_large(ptep);
+	}
+
+	flush_tlb_kernel_range(start, end);
+}
+EXPORT_SYMBOL(remap_kernel_large_pages);
+
 void __check_kvm_seq(struct mm_struct *mm)
 {
 	unsigned int seq;
@@ -237,8 +328,12 @@ void __iomem * __arm_ioremap_pfn_caller(unsigned long pfn,
 		err = remap_area_sections(addr, pfn, size, type);
 	} else
 #endif
+	{
 		err = ioremap_page_range(addr, addr + size, __pfn_to_phys(pfn),
 					 __pgprot(type->prot_pte));
+		if (!err && size >= SZ_64K)
+			remap_kernel_large_pages(addr, addr + size);
+	}
 
 	if (err) {
  		vunmap((void *)addr);
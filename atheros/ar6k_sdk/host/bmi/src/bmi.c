@@ -198,8 +198,8 @@ BMIWriteMemory(HIF_DEVICE *device,
     A_UINT32 offset;
     A_UINT32 remaining, txlen;
     const A_UINT32 header = sizeof(cid) + sizeof(address) + sizeof(length);
+    /* every byte sent is filled in below, no need to clear it */
     static A_UCHAR data[BMI_DATASZ_MAX + sizeof(cid) + sizeof(address) + sizeof(length)];
-	memset (&data, 0, BMI_DATASZ_MAX+header);
 
     if (bmiDone) {
         AR_DEBUG_PRINTF(ATH_DEBUG_ERR, ("Command disallowed\n"));
@@ -568,10 +568,9 @@ BMILZData(HIF_DEVICE *device,
     A_UINT32 offset;
     A_UINT32 remaining, txlen;
     const A_UINT32 header = sizeof(cid) + sizeof(length);
+    /* every byte sent is filled in below, no need to clear it */
     static A_UCHAR data[BMI_DATASZ_MAX + sizeof(cid) + sizeof(length)];
 
-    memset (&data, 0, BMI_DATASZ_MAX+header);
-
     if (bmiDone) {
         AR_DEBUG_PRINTF(ATH_DEBUG_ERR, ("Command disallowed\n"));
         return A_ERROR;
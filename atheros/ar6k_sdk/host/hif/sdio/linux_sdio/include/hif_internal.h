@@ -51,6 +51,13 @@
 #define HIF_MBOX_END_ADDR(mbox)	                         \
     HIF_MBOX_START_ADDR(mbox) + HIF_MBOX_WIDTH - 1
 
+/* mailbox 0 is also mapped at a larger window so that transfers longer than
+ * HIF_MBOX_WIDTH (message bundles) can still end on the EOM address */
+#define HIF_MBOX0_EXTENDED_BASE_ADDR       0x2800
+#define HIF_MBOX0_EXTENDED_WIDTH_AR6002    (6*1024)
+#define HIF_MBOX0_EXTENDED_WIDTH_AR6003    (18*1024)
+#define MANUFACTURER_ID_AR6K_BASE_MASK     0xFF00
+
 typedef struct bus_request {
     struct bus_request *next;       /* link list of available requests */
     struct bus_request *inusenext;  /* link list of in use requests */
@@ -78,10 +85,13 @@ struct hif_device {
     void     *claimedContext;
     HTC_CALLBACKS htcCallbacks;
     A_UINT8     *dma_buffer;
+    A_UINT32    mbox0ExtendedWidth;             /* size of the extended mailbox 0 window */
     A_BOOL   is_suspend;
     atomic_t   irqHandling;
+    A_UINT32   irqModerationMs;                 /* DSR hold off after an interrupt */
 };
 
 #define HIF_DMA_BUFFER_SIZE (32 * 1024)
+#define HIF_IRQ_MODERATION_MAX_MS 100
 #define CMD53_FIXED_ADDRESS 1
 #define CMD53_INCR_ADDRESS  2
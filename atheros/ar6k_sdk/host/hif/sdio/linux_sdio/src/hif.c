@@ -25,6 +25,7 @@
 #include <linux/mmc/sdio_func.h>
 #include <linux/mmc/sdio_ids.h>
 #include <linux/kthread.h>
+#include <linux/delay.h>
 /* by default setup a bounce buffer for the data packets, if the underlying host controller driver
    does not use DMA you may be able to skip this step and save the memory allocation and transfer time */
 #define HIF_USE_DMA_BOUNCE_BUFFER 1
@@ -204,6 +205,13 @@ __HIFReadWrite(HIF_DEVICE *device,
              * falls on the EOM address.
              */
             address += (HIF_MBOX_WIDTH - length);
+        } else if ((address >= HIF_MBOX0_EXTENDED_BASE_ADDR) &&
+                   (address < HIF_MBOX0_EXTENDED_BASE_ADDR + device->mbox0ExtendedWidth))
+        {
+            AR_DEBUG_ASSERT(length <= device->mbox0ExtendedWidth);
+
+                /* same for the extended mailbox 0 window */
+            address += (device->mbox0ExtendedWidth - length);
         }
 
         if (request & HIF_FIXED_ADDRESS) {
@@ -429,6 +437,17 @@ HIFConfigureDevice(HIF_DEVICE *device, HIF_DEVICE_CONFIG_OPCODE opcode,
         case HIF_DEVICE_GET_MBOX_ADDR:
             for (count = 0; count < 4; count ++) {
                 ((A_UINT32 *)config)[count] = HIF_MBOX_START_ADDR(count);
+            }
+                /* callers passing a full HIF_DEVICE_MBOX_INFO also get the
+                 * extended mailbox 0 window */
+            if (configLen >= sizeof(HIF_DEVICE_MBOX_INFO)) {
+                HIF_DEVICE_MBOX_INFO *pInfo = (HIF_DEVICE_MBOX_INFO *)config;
+
+                A_MEMZERO(pInfo->MboxProp, sizeof(pInfo->MboxProp));
+                pInfo->MboxProp[0].ExtendedAddress = HIF_MBOX0_EXTENDED_BASE_ADDR;
+                pInfo->MboxProp[0].ExtendedSize = device->mbox0ExtendedWidth;
+                pInfo->GMboxAddress = 0;
+                pInfo->GMboxSize = 0;
             }
             break;
         case HIF_DEVICE_GET_IRQ_PROC_MODE:
@@ -438,6 +457,12 @@ HIFConfigureDevice(HIF_DEVICE *device, HIF_DEVICE_CONFIG_OPCODE opcode,
                 /* pass back a pointer to the SDIO function's "dev" struct */
             ((HIF_DEVICE_OS_DEVICE_INFO *)config)->pOSDevice = &device->func->dev;
             break; 
+        case HIF_DEVICE_SET_IRQ_MODERATION:
+            if (configLen < sizeof(A_UINT32)) {
+                return A_EINVAL;
+            }
+            device->irqModerationMs = min_t(A_UINT32, *((A_UINT32 *)config), HIF_IRQ_MODERATION_MAX_MS);
+            break;
         default:
             AR_DEBUG_PRINTF(ATH_DEBUG_WARN,
                             ("AR6000: Unsupported configuration opcode: %d\n", opcode));
@@ -485,6 +510,10 @@ hifIRQHandler(struct sdio_func *func)
     atomic_set(&device->irqHandling, 1);
     /* release the host during ints so we can pick it back up when we process cmds */
     sdio_release_host(device->func);
+    if (device->irqModerationMs) {
+            /* let the target queue up more messages, the DSR drains them all in one pass */
+        msleep(device->irqModerationMs);
+    }
     status = device->htcCallbacks.dsrHandler(device->htcCallbacks.context);
     sdio_claim_host(device->func);
     atomic_set(&device->irqHandling, 0);
@@ -855,6 +884,11 @@ addHifDevice(struct sdio_func *func)
     AR_DEBUG_ASSERT(hifdevice->dma_buffer != NULL);
 #endif
     hifdevice->func = func;
+    if ((func->device & MANUFACTURER_ID_AR6K_BASE_MASK) == MANUFACTURER_ID_AR6003_BASE) {
+        hifdevice->mbox0ExtendedWidth = HIF_MBOX0_EXTENDED_WIDTH_AR6003;
+    } else {
+        hifdevice->mbox0ExtendedWidth = HIF_MBOX0_EXTENDED_WIDTH_AR6002;
+    }
     sdio_set_drvdata(func, hifdevice);
     AR_DEBUG_PRINTF(ATH_DEBUG_TRACE, ("AR6000: addHifDevice; 0x%p\n", hifdevice));
     return hifdevice;
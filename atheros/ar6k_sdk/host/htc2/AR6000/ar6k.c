@@ -35,6 +35,8 @@ extern A_UINT32 resetok;
 A_STATUS DevEnableInterrupts(AR6K_DEVICE *pDev);
 A_STATUS DevDisableInterrupts(AR6K_DEVICE *pDev);
 
+static void DevCleanupVirtualScatterSupport(AR6K_DEVICE *pDev);
+
 #define LOCK_AR6K(p)      A_MUTEX_LOCK(&(p)->Lock);
 #define UNLOCK_AR6K(p)    A_MUTEX_UNLOCK(&(p)->Lock);
 
@@ -58,6 +60,8 @@ HTC_PACKET *AR6KAllocIOPacket(AR6K_DEVICE *pDev)
 
 void DevCleanup(AR6K_DEVICE *pDev)
 {
+    DevCleanupVirtualScatterSupport(pDev);
+
     if (A_IS_MUTEX_VALID(&pDev->Lock)) {
         A_MUTEX_DELETE(&pDev->Lock);
     }
@@ -71,7 +75,6 @@ void DevCleanup(AR6K_DEVICE *pDev)
 
 A_STATUS DevSetup(AR6K_DEVICE *pDev)
 {
-    A_UINT32 mailboxaddrs[AR6K_MAILBOXES];
     A_UINT32 blocksizes[AR6K_MAILBOXES];
     A_STATUS status = A_OK;
     int      i;
@@ -98,11 +101,14 @@ A_STATUS DevSetup(AR6K_DEVICE *pDev)
 
             /* initialize our free list of IO packets */
         INIT_HTC_PACKET_QUEUE(&pDev->RegisterIOList);
+        DL_LIST_INIT(&pDev->ScatterReqHead);
         A_MUTEX_INIT(&pDev->Lock);
 
-            /* get the addresses for all 4 mailboxes */
+            /* get the addresses for all 4 mailboxes, HIF layers that know about
+             * the extended mailbox window fill in the rest of the info */
+        A_MEMZERO(&pDev->MailBoxInfo, sizeof(pDev->MailBoxInfo));
         status = HIFConfigureDevice(pDev->HIFDevice, HIF_DEVICE_GET_MBOX_ADDR,
-                                    mailboxaddrs, sizeof(mailboxaddrs));
+                                    &pDev->MailBoxInfo, sizeof(pDev->MailBoxInfo));
 
         if (status != A_OK) {
             AR_DEBUG_ASSERT(FALSE);
@@ -122,7 +128,7 @@ A_STATUS DevSetup(AR6K_DEVICE *pDev)
         }
 
             /* get the address of the mailbox we are using */
-        pDev->MailboxAddress = mailboxaddrs[HTC_MAILBOX];
+        pDev->MailboxAddress = pDev->MailBoxInfo.MboxAddresses[HTC_MAILBOX];
 
             /* get the block sizes */
         status = HIFConfigureDevice(pDev->HIFDevice, HIF_DEVICE_GET_MBOX_BLOCK_SIZE,
@@ -467,6 +473,274 @@ A_STATUS DevEnableRecv(AR6K_DEVICE *pDev, A_BOOL AsyncMode)
     }
 }
 
+/* Message bundling
+ *
+ * A bundle is a single block mode CMD53 carrying several HTC messages, each
+ * padded to the block size.  HTC builds bundles out of HIF_SCATTER_REQs.  When
+ * the HIF layer has no native scatter support, the device layer emulates it by
+ * copying the scatter list to/from a bounce buffer and issuing one
+ * HIFReadWrite() for the whole transfer. */
+
+#define DEV_GET_VIRT_INFO(pReq) ((DEV_SCATTER_DMA_VIRTUAL_INFO *)(pReq)->HIFPrivate[0])
+
+static HIF_SCATTER_REQ *DevAllocScatterReq(HIF_DEVICE *Context)
+{
+    AR6K_DEVICE *pDev = (AR6K_DEVICE *)Context;
+    DL_LIST     *pItem;
+
+    LOCK_AR6K(pDev);
+    pItem = DL_ListRemoveItemFromHead(&pDev->ScatterReqHead);
+    UNLOCK_AR6K(pDev);
+
+    if (pItem != NULL) {
+        return A_CONTAINING_STRUCT(pItem, HIF_SCATTER_REQ, ListLink);
+    }
+
+    return NULL;
+}
+
+static void DevFreeScatterReq(HIF_DEVICE *Context, HIF_SCATTER_REQ *pReq)
+{
+    AR6K_DEVICE *pDev = (AR6K_DEVICE *)Context;
+
+    LOCK_AR6K(pDev);
+    DL_ListInsertTail(&pDev->ScatterReqHead, &pReq->ListLink);
+    UNLOCK_AR6K(pDev);
+}
+
+static void DevCopyScatterListToFromBounce(HIF_SCATTER_REQ *pReq, A_BOOL FromScatterList)
+{
+    A_UINT8 *pBuffer = DEV_GET_VIRT_INFO(pReq)->pVirtDmaBuffer;
+    int     i;
+
+    for (i = 0; i < pReq->ValidScatterEntries; i++) {
+        if (FromScatterList) {
+            A_MEMCPY(pBuffer, pReq->ScatterList[i].pBuffer, pReq->ScatterList[i].Length);
+        } else {
+            A_MEMCPY(pReq->ScatterList[i].pBuffer, pBuffer, pReq->ScatterList[i].Length);
+        }
+        pBuffer += pReq->ScatterList[i].Length;
+    }
+}
+
+static void DevReadWriteScatterAsyncHandler(void *Context, HTC_PACKET *pPacket)
+{
+    HIF_SCATTER_REQ *pReq = (HIF_SCATTER_REQ *)pPacket->pPktContext;
+
+    AR_DEBUG_PRINTF(ATH_DEBUG_SEND,("+DevReadWriteScatterAsyncHandler: (dev: 0x%X)\n", (A_UINT32)Context));
+
+    pReq->CompletionStatus = pPacket->Status;
+
+    if (A_SUCCESS(pPacket->Status) && !(pReq->Request & HIF_WRITE)) {
+        DevCopyScatterListToFromBounce(pReq, FALSE);
+    }
+
+    pReq->CompletionRoutine(pReq);
+
+    AR_DEBUG_PRINTF(ATH_DEBUG_SEND,("-DevReadWriteScatterAsyncHandler \n"));
+}
+
+static A_STATUS DevReadWriteScatter(HIF_DEVICE *Context, HIF_SCATTER_REQ *pReq)
+{
+    AR6K_DEVICE                  *pDev = (AR6K_DEVICE *)Context;
+    DEV_SCATTER_DMA_VIRTUAL_INFO *pVirtInfo = DEV_GET_VIRT_INFO(pReq);
+    A_BOOL                       async = (pReq->Request & HIF_ASYNCHRONOUS) ? TRUE : FALSE;
+    A_STATUS                     status = A_OK;
+
+    do {
+
+        if (pReq->TotalLength > AR6K_MAX_TRANSFER_SIZE_PER_SCATTER) {
+            AR_DEBUG_PRINTF(ATH_DEBUG_ERR,
+                ("Invalid length: %d \n", pReq->TotalLength));
+            status = A_EINVAL;
+            break;
+        }
+
+        if (pReq->Request & HIF_WRITE) {
+            DevCopyScatterListToFromBounce(pReq, TRUE);
+        }
+
+        if (async) {
+            pVirtInfo->IOPacket.pPktContext = pReq;
+            pVirtInfo->IOPacket.pContext = pDev;
+            pVirtInfo->IOPacket.Completion = DevReadWriteScatterAsyncHandler;
+        }
+
+        status = HIFReadWrite(pDev->HIFDevice,
+                              pReq->Address,
+                              pVirtInfo->pVirtDmaBuffer,
+                              pReq->TotalLength,
+                              pReq->Request,
+                              async ? &pVirtInfo->IOPacket : NULL);
+
+        if (async) {
+                /* completion (and any error) is reported through the callback */
+            return A_OK;
+        }
+
+        if (A_SUCCESS(status) && !(pReq->Request & HIF_WRITE)) {
+            DevCopyScatterListToFromBounce(pReq, FALSE);
+        }
+
+    } while (FALSE);
+
+    pReq->CompletionStatus = status;
+
+    if (async) {
+            /* async callers always get their completion */
+        pReq->CompletionRoutine(pReq);
+        return A_OK;
+    }
+
+    return status;
+}
+
+static void DevCleanupVirtualScatterSupport(AR6K_DEVICE *pDev)
+{
+    HIF_SCATTER_REQ *pReq;
+
+    if (!pDev->ScatterIsVirtual) {
+        return;
+    }
+
+    while (1) {
+        pReq = DevAllocScatterReq((HIF_DEVICE *)pDev);
+        if (NULL == pReq) {
+            break;
+        }
+        A_FREE(pReq);
+    }
+
+    pDev->ScatterIsVirtual = FALSE;
+}
+
+static A_STATUS DevSetupVirtualScatterSupport(AR6K_DEVICE *pDev, int MaxMsgsPerTransfer)
+{
+    DEV_SCATTER_DMA_VIRTUAL_INFO *pVirtInfo;
+    HIF_SCATTER_REQ              *pReq;
+    int                          reqSize, i;
+
+    reqSize = sizeof(HIF_SCATTER_REQ) +
+              (MaxMsgsPerTransfer - 1) * sizeof(HIF_SCATTER_ITEM);
+        /* keep the virtual info pointer aligned */
+    reqSize = (reqSize + 3) & ~3;
+
+    pDev->ScatterIsVirtual = TRUE;
+
+    for (i = 0; i < AR6K_SCATTER_REQS; i++) {
+        pReq = (HIF_SCATTER_REQ *)A_MALLOC(reqSize + sizeof(DEV_SCATTER_DMA_VIRTUAL_INFO) +
+                                           AR6K_MAX_TRANSFER_SIZE_PER_SCATTER);
+        if (NULL == pReq) {
+            break;
+        }
+        A_MEMZERO(pReq, reqSize + sizeof(DEV_SCATTER_DMA_VIRTUAL_INFO));
+
+        pVirtInfo = (DEV_SCATTER_DMA_VIRTUAL_INFO *)((A_UINT8 *)pReq + reqSize);
+        pVirtInfo->pVirtDmaBuffer = pVirtInfo->DataArea;
+        pReq->HIFPrivate[0] = pVirtInfo;
+        pReq->ScatterMethod = HIF_SCATTER_NONE;
+        pReq->pScatterBounceBuffer = pVirtInfo->pVirtDmaBuffer;
+        DevFreeScatterReq((HIF_DEVICE *)pDev, pReq);
+    }
+
+    if (i != AR6K_SCATTER_REQS) {
+        DevCleanupVirtualScatterSupport(pDev);
+        return A_NO_MEMORY;
+    }
+
+    pDev->HifScatterInfo.pAllocateReqFunc = DevAllocScatterReq;
+    pDev->HifScatterInfo.pFreeReqFunc = DevFreeScatterReq;
+    pDev->HifScatterInfo.pReadWriteScatterFunc = DevReadWriteScatter;
+    pDev->HifScatterInfo.MaxScatterEntries = MaxMsgsPerTransfer;
+    pDev->HifScatterInfo.MaxTransferSizePerScatterReq = AR6K_MAX_TRANSFER_SIZE_PER_SCATTER;
+
+    return A_OK;
+}
+
+A_STATUS DevSetupMsgBundling(AR6K_DEVICE *pDev, int MaxMsgsPerTransfer)
+{
+    A_STATUS status;
+    int      maxLength;
+
+    if (pDev->HifScatterInfo.pReadWriteScatterFunc != NULL) {
+            /* already set up (HTCWaitTarget after a target reset) */
+        return A_OK;
+    }
+
+    status = HIFConfigureDevice(pDev->HIFDevice,
+                                HIF_CONFIGURE_QUERY_SCATTER_REQUEST_SUPPORT,
+                                &pDev->HifScatterInfo,
+                                sizeof(pDev->HifScatterInfo));
+
+    if (A_FAILED(status)) {
+        AR_DEBUG_PRINTF(ATH_DEBUG_TRC,("HIF has no scatter support, using virtual scatter requests\n"));
+        A_MEMZERO(&pDev->HifScatterInfo, sizeof(pDev->HifScatterInfo));
+        status = DevSetupVirtualScatterSupport(pDev, MaxMsgsPerTransfer);
+        if (A_FAILED(status)) {
+            A_MEMZERO(&pDev->HifScatterInfo, sizeof(pDev->HifScatterInfo));
+            return status;
+        }
+    } else if (pDev->HifScatterInfo.MaxScatterEntries > MaxMsgsPerTransfer) {
+        pDev->HifScatterInfo.MaxScatterEntries = MaxMsgsPerTransfer;
+    }
+
+        /* a transfer must end on the EOM address of the window it is issued to,
+         * transfers that don't fit the normal window need the extended one */
+    if (pDev->MailBoxInfo.MboxProp[HTC_MAILBOX].ExtendedAddress != 0) {
+        maxLength = pDev->MailBoxInfo.MboxProp[HTC_MAILBOX].ExtendedSize;
+    } else {
+        maxLength = AR6K_LEGACY_MAX_WRITE_LENGTH;
+    }
+
+    maxLength = min(maxLength, pDev->HifScatterInfo.MaxTransferSizePerScatterReq);
+        /* messages are padded to whole blocks */
+    maxLength &= ~pDev->BlockMask;
+
+    pDev->MaxRecvBundleSize = maxLength;
+    pDev->MaxSendBundleSize = maxLength;
+
+    AR_DEBUG_PRINTF(ATH_DEBUG_TRC,
+        ("Message bundling: %d messages, %d bytes per transfer (ext mbox: 0x%X)\n",
+            DEV_GET_MAX_MSG_PER_BUNDLE(pDev), maxLength,
+            pDev->MailBoxInfo.MboxProp[HTC_MAILBOX].ExtendedAddress));
+
+    return A_OK;
+}
+
+A_STATUS DevSubmitScatterRequest(AR6K_DEVICE *pDev, HIF_SCATTER_REQ *pScatterReq, A_BOOL Read, A_BOOL Async)
+{
+    A_STATUS status;
+
+    if (Read) {
+        pScatterReq->Request = Async ? HIF_RD_ASYNC_BLOCK_INC : HIF_RD_SYNC_BLOCK_INC;
+    } else {
+        pScatterReq->Request = Async ? HIF_WR_ASYNC_BLOCK_INC : HIF_WR_SYNC_BLOCK_INC;
+    }
+
+    if (pScatterReq->TotalLength > AR6K_LEGACY_MAX_WRITE_LENGTH) {
+        pScatterReq->Address = pDev->MailBoxInfo.MboxProp[HTC_MAILBOX].ExtendedAddress;
+    } else {
+        pScatterReq->Address = pDev->MailboxAddress;
+    }
+
+    AR_DEBUG_PRINTF(ATH_DEBUG_SEND | ATH_DEBUG_RECV,
+        ("DevSubmitScatterRequest, Entries: %d, Total Length: %d Mbox:0x%X (mode:%s : %s)\n",
+            pScatterReq->ValidScatterEntries,
+            pScatterReq->TotalLength,
+            pScatterReq->Address,
+            Async ? "ASYNC" : "SYNC",
+            Read ? "RD" : "WR"));
+
+    status = pDev->HifScatterInfo.pReadWriteScatterFunc(DEV_SCATTER_CONTEXT(pDev), pScatterReq);
+
+    if (!Async) {
+            /* in sync mode, we can touch the scatter request */
+        pScatterReq->CompletionStatus = status;
+    }
+
+    return status;
+}
+
 void DevDumpRegisters(AR6K_IRQ_PROC_REGISTERS   *pIrqProcRegs,
                       AR6K_IRQ_ENABLE_REGISTERS *pIrqEnableRegs)
 {
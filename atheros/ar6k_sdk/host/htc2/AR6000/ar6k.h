@@ -70,6 +70,13 @@ typedef struct _AR6K_ASYNC_REG_IO_BUFFER {
     A_UINT8       Buffer[AR6K_REG_IO_BUFFER_SIZE];
 } AR6K_ASYNC_REG_IO_BUFFER;
 
+/* bookkeeping for scatter requests emulated by the device layer on top of HIFReadWrite() */
+typedef struct _DEV_SCATTER_DMA_VIRTUAL_INFO {
+    HTC_PACKET    IOPacket;        /* wrapper handed to HIF for async completion */
+    A_UINT8       *pVirtDmaBuffer; /* bounce buffer the scatter list is copied to/from */
+    A_UINT8       DataArea[1];     /* start of the bounce buffer allocation */
+} DEV_SCATTER_DMA_VIRTUAL_INFO;
+
 typedef enum _AR6K_TARGET_FAILURE_TYPE {
     AR6K_TARGET_ASSERT = 1,
     AR6K_TARGET_RX_ERROR,
@@ -93,10 +100,47 @@ typedef struct _AR6K_DEVICE {
     HIF_DEVICE_IRQ_PROCESSING_MODE  HifIRQProcessingMode;
     HIF_MASK_UNMASK_RECV_EVENT      HifMaskUmaskRecvEvent;
     A_BOOL                          HifAttached;
+    HIF_DEVICE_MBOX_INFO            MailBoxInfo;
+    HIF_DEVICE_SCATTER_SUPPORT_INFO HifScatterInfo;
+    DL_LIST                         ScatterReqHead;     /* free virtual scatter requests */
+    A_BOOL                          ScatterIsVirtual;
+    int                             MaxRecvBundleSize;
+    int                             MaxSendBundleSize;
 } AR6K_DEVICE;
 
 #define IS_DEV_IRQ_PROCESSING_ASYNC_ALLOWED(pDev) ((pDev)->HifIRQProcessingMode != HIF_DEVICE_IRQ_SYNC_ONLY)
 
+/* message bundling over scatter requests */
+#define AR6K_SCATTER_REQS                   4
+#define AR6K_MAX_TRANSFER_SIZE_PER_SCATTER  (16*1024)
+#define AR6K_LEGACY_MAX_WRITE_LENGTH        2048    /* size of the normal mailbox window */
+
+#define DEV_SCATTER_READ  TRUE
+#define DEV_SCATTER_WRITE FALSE
+#define DEV_SCATTER_ASYNC TRUE
+#define DEV_SCATTER_SYNC  FALSE
+
+#define DEV_GET_MAX_MSG_PER_BUNDLE(pDev)        (pDev)->HifScatterInfo.MaxScatterEntries
+#define DEV_GET_MAX_BUNDLE_RECV_LENGTH(pDev)    (pDev)->MaxRecvBundleSize
+#define DEV_GET_MAX_BUNDLE_SEND_LENGTH(pDev)    (pDev)->MaxSendBundleSize
+
+#define DEV_SCATTER_CONTEXT(pDev) \
+    ((pDev)->ScatterIsVirtual ? (HIF_DEVICE *)(pDev) : (HIF_DEVICE *)(pDev)->HIFDevice)
+
+#define DEV_ALLOC_SCATTER_REQ(pDev) \
+    (pDev)->HifScatterInfo.pAllocateReqFunc(DEV_SCATTER_CONTEXT(pDev))
+
+#define DEV_FREE_SCATTER_REQ(pDev,pR) \
+    (pDev)->HifScatterInfo.pFreeReqFunc(DEV_SCATTER_CONTEXT(pDev),(pR))
+
+#define DEV_CALC_RECV_PADDED_LEN(pDev, length) \
+    (((length) + (pDev)->BlockMask) & (~((pDev)->BlockMask)))
+#define DEV_CALC_SEND_PADDED_LEN(pDev, length) \
+    DEV_CALC_RECV_PADDED_LEN(pDev,length)
+
+A_STATUS DevSetupMsgBundling(AR6K_DEVICE *pDev, int MaxMsgsPerTransfer);
+A_STATUS DevSubmitScatterRequest(AR6K_DEVICE *pDev, HIF_SCATTER_REQ *pScatterReq, A_BOOL Read, A_BOOL Async);
+
 A_STATUS DevSetup(AR6K_DEVICE *pDev);
 void     DevCleanup(AR6K_DEVICE *pDev);
 A_STATUS DevUnmaskInterrupts(AR6K_DEVICE *pDev);
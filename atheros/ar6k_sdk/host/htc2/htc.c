@@ -252,6 +252,50 @@ A_STATUS HTCWaitTarget(HTC_HANDLE HTCHandle)
         AR_DEBUG_PRINTF(ATH_DEBUG_TRC, (" Target Ready: credits: %d credit size: %d\n",
                 target->TargetCredits, target->TargetCreditSize));
 
+            /* check if this is an extended ready message */
+        if (pPacket->ActualLength >= sizeof(HTC_READY_EX_MSG)) {
+                /* this is an extended message */
+            HTC_READY_EX_MSG *pReadyEx = (HTC_READY_EX_MSG *)pRdyMsg;
+            target->HTCTargetVersion = pReadyEx->HTCVersion;
+            target->MaxMsgPerBundle = pReadyEx->MaxMsgsPerHTCBundle;
+        } else {
+                /* legacy */
+            target->HTCTargetVersion = HTC_VERSION_2P0;
+            target->MaxMsgPerBundle = 0;
+        }
+
+        AR_DEBUG_PRINTF(ATH_DEBUG_TRC, (" Target HTC version: %d, max bundle: %d\n",
+                target->HTCTargetVersion, target->MaxMsgPerBundle));
+
+        target->SendBundlingEnabled = FALSE;
+        target->RecvBundlingEnabled = FALSE;
+
+        if ((target->HTCTargetVersion >= HTC_VERSION_2P1) && (target->MaxMsgPerBundle > 0)) {
+                /* limit what HTC can handle */
+            target->MaxMsgPerBundle = min(HTC_HOST_MAX_MSG_PER_BUNDLE, target->MaxMsgPerBundle);
+                /* target supports message bundling, setup device layer */
+            if (A_FAILED(DevSetupMsgBundling(&target->Device,target->MaxMsgPerBundle))) {
+                    /* device layer can't handle bundling */
+                target->MaxMsgPerBundle = 0;
+            } else {
+                    /* limit bundle depth to what the device layer can handle */
+                target->MaxMsgPerBundle = min(DEV_GET_MAX_MSG_PER_BUNDLE(&target->Device),
+                                              target->MaxMsgPerBundle);
+            }
+        } else {
+            target->MaxMsgPerBundle = 0;
+        }
+
+        if (target->MaxMsgPerBundle > 0) {
+            target->SendBundlingEnabled = TRUE;
+                /* recv bundles are fetched in the synchronous interrupt path only */
+            if (!IS_DEV_IRQ_PROCESSING_ASYNC_ALLOWED(&target->Device)) {
+                target->RecvBundlingEnabled = TRUE;
+            }
+        }
+
+        target->BundleStats.MaxMsgsPerBundle = target->MaxMsgPerBundle;
+
             /* setup our pseudo HTC control endpoint connection */
         A_MEMZERO(&connect,sizeof(connect));
         A_MEMZERO(&resp,sizeof(resp));
@@ -406,6 +450,17 @@ void HTCDumpCreditStates(HTC_HANDLE HTCHandle)
     DumpCreditDistStates(target);
 
     UNLOCK_HTC_TX(target);
+
+    AR_DEBUG_PRINTF(ATH_DEBUG_ANY, ("--- HTC Bundle Stats (max:%d tx:%s rx:%s) :\n",
+            target->MaxMsgPerBundle,
+            target->SendBundlingEnabled ? "on" : "off",
+            target->RecvBundlingEnabled ? "on" : "off"));
+    AR_DEBUG_PRINTF(ATH_DEBUG_ANY, ("  TX transfers:%d msgs:%d bytes:%d bundles:%d \n",
+            target->BundleStats.TxTransfers, target->BundleStats.TxMessages,
+            target->BundleStats.TxBytes, target->BundleStats.TxBundles));
+    AR_DEBUG_PRINTF(ATH_DEBUG_ANY, ("  RX transfers:%d msgs:%d bytes:%d bundles:%d \n",
+            target->BundleStats.RxTransfers, target->BundleStats.RxMessages,
+            target->BundleStats.RxBytes, target->BundleStats.RxBundles));
 }
 
 /* report a target failure from the device, this is a callback from the device layer
@@ -519,3 +574,27 @@ A_BOOL HTCGetEndpointStatistics(HTC_HANDLE               HTCHandle,
     return FALSE;
 #endif
 }
+
+void HTCGetBundleStatistics(HTC_HANDLE               HTCHandle,
+                            HTC_ENDPOINT_STAT_ACTION Action,
+                            HTC_BUNDLE_STATS         *pStats)
+{
+    HTC_TARGET *target = GET_HTC_TARGET_FROM_HANDLE(HTCHandle);
+
+        /* lock out TX and RX while we sample and/or clear */
+    LOCK_HTC_TX(target);
+    LOCK_HTC_RX(target);
+
+    if (Action != HTC_EP_STAT_CLEAR) {
+        A_ASSERT(pStats != NULL);
+        A_MEMCPY(pStats, &target->BundleStats, sizeof(HTC_BUNDLE_STATS));
+    }
+
+    if (Action != HTC_EP_STAT_SAMPLE) {
+        A_MEMZERO(&target->BundleStats, sizeof(HTC_BUNDLE_STATS));
+        target->BundleStats.MaxMsgsPerBundle = target->MaxMsgPerBundle;
+    }
+
+    UNLOCK_HTC_RX(target);
+    UNLOCK_HTC_TX(target);
+}
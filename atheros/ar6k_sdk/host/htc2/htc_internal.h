@@ -107,9 +107,27 @@ typedef struct _HTC_TARGET {
     A_UINT8                     LastTrailerLength;
 #endif
     HTC_INIT_INFO               HTCInitInfo;                 
+    A_UINT8                     HTCTargetVersion;
+    int                         MaxMsgPerBundle;       /* max messages per bundle for HTC */
+    A_BOOL                      SendBundlingEnabled;   /* run time enable for send bundling (dynamic) */
+    A_BOOL                      RecvBundlingEnabled;   /* run time enable for recv bundling (dynamic) */
+    HTC_BUNDLE_STATS            BundleStats;
 } HTC_TARGET;
 
 #define HTC_STOPPING(t) ((t)->HTCStateFlags & HTC_STATE_STOPPING)
+
+    /* count a bus transfer of cnt messages and len bytes */
+#define INC_HTC_BUNDLE_STAT(t,dir,cnt,len)                                   \
+{                                                                            \
+    (t)->BundleStats.dir##Transfers++;                                       \
+    (t)->BundleStats.dir##Messages += (cnt);                                 \
+    (t)->BundleStats.dir##Bytes += (len);                                    \
+    if ((cnt) > 1) {                                                         \
+        (t)->BundleStats.dir##Bundles++;                                     \
+    }                                                                        \
+    (t)->BundleStats.dir##BundleDepth[min((cnt),HTC_HOST_MAX_MSG_PER_BUNDLE)]++; \
+}
+
 #define LOCK_HTC(t)      A_MUTEX_LOCK(&(t)->HTCLock);
 #define UNLOCK_HTC(t)    A_MUTEX_UNLOCK(&(t)->HTCLock);
 #define LOCK_HTC_RX(t)   A_MUTEX_LOCK(&(t)->HTCRxLock);
@@ -53,12 +53,15 @@
 static INLINE A_STATUS HTCProcessTrailer(HTC_TARGET *target,
                                          A_UINT8    *pBuffer,
                                          int         Length,
-                                         A_UINT32   *pNextLookAhead,
+                                         A_UINT32   *pNextLookAheads,
+                                         int        *pNumLookAheads,
                                          HTC_ENDPOINT_ID FromEndpoint)
 {
     HTC_RECORD_HDR          *pRecord;
     A_UINT8                 *pRecordBuf;
     HTC_LOOKAHEAD_REPORT    *pLookAhead;
+    HTC_BUNDLED_LOOKAHEAD_REPORT *pBundledLookAheadRpt;
+    int                     i;
     A_UINT8                 *pOrigBuffer;
     int                     origLength;
     A_STATUS                status;
@@ -107,7 +110,7 @@ static INLINE A_STATUS HTCProcessTrailer(HTC_TARGET *target,
                 AR_DEBUG_ASSERT(pRecord->Length >= sizeof(HTC_LOOKAHEAD_REPORT));
                 pLookAhead = (HTC_LOOKAHEAD_REPORT *)pRecordBuf;
                 if ((pLookAhead->PreValid == ((~pLookAhead->PostValid) & 0xFF)) &&
-                    (pNextLookAhead != NULL)) {
+                    (pNextLookAheads != NULL)) {
 
                     AR_DEBUG_PRINTF(ATH_DEBUG_RECV,
                                 (" LookAhead Report Found (pre valid:0x%X, post valid:0x%X) \n",
@@ -115,14 +118,47 @@ static INLINE A_STATUS HTCProcessTrailer(HTC_TARGET *target,
                                 pLookAhead->PostValid));
 
                         /* look ahead bytes are valid, copy them over */
-                    ((A_UINT8 *)pNextLookAhead)[0] = pLookAhead->LookAhead[0];
-                    ((A_UINT8 *)pNextLookAhead)[1] = pLookAhead->LookAhead[1];
-                    ((A_UINT8 *)pNextLookAhead)[2] = pLookAhead->LookAhead[2];
-                    ((A_UINT8 *)pNextLookAhead)[3] = pLookAhead->LookAhead[3];
+                    ((A_UINT8 *)pNextLookAheads)[0] = pLookAhead->LookAhead[0];
+                    ((A_UINT8 *)pNextLookAheads)[1] = pLookAhead->LookAhead[1];
+                    ((A_UINT8 *)pNextLookAheads)[2] = pLookAhead->LookAhead[2];
+                    ((A_UINT8 *)pNextLookAheads)[3] = pLookAhead->LookAhead[3];
 
                     if (AR_DEBUG_LVL_CHECK(ATH_DEBUG_RECV)) {
-                        DebugDumpBytes((A_UINT8 *)pNextLookAhead,4,"Next Look Ahead");
+                        DebugDumpBytes((A_UINT8 *)pNextLookAheads,4,"Next Look Ahead");
                     }
+                        /* just one normal lookahead */
+                    *pNumLookAheads = 1;
+                }
+                break;
+            case HTC_RECORD_LOOKAHEAD_BUNDLE:
+                AR_DEBUG_ASSERT(pRecord->Length >= sizeof(HTC_BUNDLED_LOOKAHEAD_REPORT));
+                if ((pRecord->Length >= sizeof(HTC_BUNDLED_LOOKAHEAD_REPORT)) &&
+                    (pNextLookAheads != NULL)) {
+
+                    pBundledLookAheadRpt = (HTC_BUNDLED_LOOKAHEAD_REPORT *)pRecordBuf;
+
+                    if (AR_DEBUG_LVL_CHECK(ATH_DEBUG_RECV)) {
+                        DebugDumpBytes(pRecordBuf,pRecord->Length,"Bundle LookAhead");
+                    }
+
+                    if ((pRecord->Length / (sizeof(HTC_BUNDLED_LOOKAHEAD_REPORT))) >
+                            HTC_HOST_MAX_MSG_PER_BUNDLE) {
+                            /* this should never happen, the target restricts the number
+                             * of messages per bundle configured by the host */
+                        A_ASSERT(FALSE);
+                        status = A_EPROTO;
+                        break;
+                    }
+
+                    for (i = 0; i < (int)(pRecord->Length / (sizeof(HTC_BUNDLED_LOOKAHEAD_REPORT))); i++) {
+                        ((A_UINT8 *)&pNextLookAheads[i])[0] = pBundledLookAheadRpt->LookAhead[0];
+                        ((A_UINT8 *)&pNextLookAheads[i])[1] = pBundledLookAheadRpt->LookAhead[1];
+                        ((A_UINT8 *)&pNextLookAheads[i])[2] = pBundledLookAheadRpt->LookAhead[2];
+                        ((A_UINT8 *)&pNextLookAheads[i])[3] = pBundledLookAheadRpt->LookAhead[3];
+                        pBundledLookAheadRpt++;
+                    }
+
+                    *pNumLookAheads = i;
                 }
                 break;
             default:
@@ -151,7 +187,10 @@ static INLINE A_STATUS HTCProcessTrailer(HTC_TARGET *target,
 
 /* process a received message (i.e. strip off header, process any trailer data)
  * note : locks must be released when this function is called */
-static A_STATUS HTCProcessRecvHeader(HTC_TARGET *target, HTC_PACKET *pPacket, A_UINT32 *pNextLookAhead)
+static A_STATUS HTCProcessRecvHeader(HTC_TARGET *target,
+                                     HTC_PACKET *pPacket,
+                                     A_UINT32   *pNextLookAheads,
+                                     int        *pNumLookAheads)
 {
     A_UINT8   temp;
     A_UINT8   *pBuf;
@@ -177,6 +216,35 @@ static A_STATUS HTCProcessRecvHeader(HTC_TARGET *target, HTC_PACKET *pPacket, A_
         ((A_UINT8 *)&lookAhead)[2] = pBuf[2];
         ((A_UINT8 *)&lookAhead)[3] = pBuf[3];
 
+        if (pPacket->PktInfo.AsRx.HTCRxFlags & HTC_RX_PKT_REFRESH_HDR) {
+                /* refresh expected hdr, since this was unknown at the time we grabbed the packets
+                 * as part of a bundle */
+            pPacket->HTCReserved = lookAhead;
+                /* refresh actual length since we now have the real header */
+            pPacket->ActualLength = payloadLen + HTC_HDR_LENGTH;
+
+                /* validate the actual header that was refreshed  */
+            if (pPacket->ActualLength > pPacket->BufferLength) {
+                AR_DEBUG_PRINTF(ATH_DEBUG_ERR,
+                    ("Refreshed HDR payload length (%d) in bundled RECV is invalid (hdr: 0x%X) \n",
+                    payloadLen, lookAhead));
+                    /* limit this to max buffer just to print out some of the buffer */
+                pPacket->ActualLength = min(pPacket->ActualLength, pPacket->BufferLength);
+                status = A_EPROTO;
+                break;
+            }
+
+            if (pPacket->Endpoint != A_GET_UINT8_FIELD(pBuf, HTC_FRAME_HDR, EndpointID)) {
+                AR_DEBUG_PRINTF(ATH_DEBUG_ERR,
+                    ("Refreshed HDR endpoint (%d) does not match expected endpoint (%d) \n",
+                    A_GET_UINT8_FIELD(pBuf, HTC_FRAME_HDR, EndpointID), pPacket->Endpoint));
+                status = A_EPROTO;
+                break;
+            }
+
+            pPacket->PktInfo.AsRx.HTCRxFlags &= ~HTC_RX_PKT_REFRESH_HDR;
+        }
+
         if (lookAhead != pPacket->HTCReserved) {
             /* somehow the lookahead that gave us the full read length did not
              * reflect the actual header in the pending message */
@@ -217,7 +285,8 @@ static A_STATUS HTCProcessRecvHeader(HTC_TARGET *target, HTC_PACKET *pPacket, A_
             status = HTCProcessTrailer(target,
                                        (pBuf + HTC_HDR_LENGTH + payloadLen - temp),
                                        temp,
-                                       pNextLookAhead,
+                                       pNextLookAheads,
+                                       pNumLookAheads,
                                        pPacket->Endpoint);
 
             if (A_FAILED(status)) {
@@ -268,7 +337,10 @@ void HTCRecvCompleteHandler(void *Context, HTC_PACKET *pPacket)
 {
     HTC_TARGET      *target = (HTC_TARGET *)Context;
     HTC_ENDPOINT    *pEndpoint;
+    A_UINT32        nextLookAheads[HTC_HOST_MAX_MSG_PER_BUNDLE];
+    int             numLookAheads = 0;
     A_UINT32        nextLookAhead = 0;
+    A_UINT32        fetchLength;
     A_STATUS        status;
 
     AR_DEBUG_PRINTF(ATH_DEBUG_RECV, ("+HTCRecvCompleteHandler (status:%d, ep:%d) \n",
@@ -280,6 +352,7 @@ void HTCRecvCompleteHandler(void *Context, HTC_PACKET *pPacket)
 
         /* get completion status */
     status = pPacket->Status;
+    fetchLength = DEV_CALC_RECV_PADDED_LEN(&target->Device, pPacket->ActualLength);
 
     do {
         if (A_FAILED(status)) {
@@ -288,11 +361,21 @@ void HTCRecvCompleteHandler(void *Context, HTC_PACKET *pPacket)
             break;
         }
             /* process the header for any trailer data */
-        status = HTCProcessRecvHeader(target,pPacket,&nextLookAhead);
+        status = HTCProcessRecvHeader(target,pPacket,nextLookAheads,&numLookAheads);
 
         if (A_FAILED(status)) {
             break;
         }
+
+        LOCK_HTC_RX(target);
+        INC_HTC_BUNDLE_STAT(target,Rx,1,fetchLength);
+        UNLOCK_HTC_RX(target);
+
+            /* bundles are only fetched in the synchronous path, only the first
+             * lookahead can be pipelined from here */
+        if (numLookAheads > 0) {
+            nextLookAhead = nextLookAheads[0];
+        }
             /* was there a lookahead for the next packet? */
         if (nextLookAhead != 0) {
             A_STATUS nextStatus;
@@ -390,6 +473,7 @@ A_STATUS HTCWaitforControlMessage(HTC_TARGET *target, HTC_PACKET **ppControlPack
 
         pPacket->HTCReserved = lookAhead;
         pPacket->ActualLength = pHdr->PayloadLen + HTC_HDR_LENGTH;
+        pPacket->PktInfo.AsRx.HTCRxFlags = 0;
 
         if (pPacket->ActualLength > pPacket->BufferLength) {
             AR_DEBUG_ASSERT(FALSE);
@@ -408,7 +492,7 @@ A_STATUS HTCWaitforControlMessage(HTC_TARGET *target, HTC_PACKET **ppControlPack
         }
 
             /* process receive header */
-        status = HTCProcessRecvHeader(target,pPacket,NULL);
+        status = HTCProcessRecvHeader(target,pPacket,NULL,NULL);
 
         pPacket->Status = status;
 
@@ -436,32 +520,91 @@ A_STATUS HTCWaitforControlMessage(HTC_TARGET *target, HTC_PACKET **ppControlPack
     return status;
 }
 
-/* callback when device layer or lookahead report parsing detects a pending message */
-A_STATUS HTCRecvMessagePendingHandler(void *Context, A_UINT32 *LookAhead, A_BOOL *pAsyncProc)
+/* give back packets that were allocated for messages that could not be fetched,
+ * packets from the endpoint queue go back to the head of the queue without
+ * touching the receiver blocking state */
+static void HTCReturnUnusedRxPkts(HTC_TARGET *target, HTC_PACKET_QUEUE *pQueue)
 {
-    HTC_TARGET      *target = (HTC_TARGET *)Context;
-    A_STATUS         status = A_OK;
-    HTC_PACKET      *pPacket = NULL;
-    HTC_FRAME_HDR   *pHdr = NULL;
-    HTC_ENDPOINT    *pEndpoint = NULL;
-    A_BOOL          asyncProc = FALSE;
+    HTC_PACKET      *pPacket;
+    HTC_ENDPOINT    *pEndpoint;
 
-    AR_DEBUG_PRINTF(ATH_DEBUG_RECV,("+HTCRecvMessagePendingHandler LookAhead:0x%X \n", *LookAhead));
-    
-    if (IS_DEV_IRQ_PROCESSING_ASYNC_ALLOWED(&target->Device)) {
-            /* We use async mode to get the packets if the device layer supports it.
-             * The device layer interfaces with HIF in which HIF may have restrictions on
-             * how interrupts are processed */
-        asyncProc = TRUE;
+    while (1) {
+        pPacket = HTC_PACKET_DEQUEUE(pQueue);
+        if (NULL == pPacket) {
+            break;
+        }
+        pEndpoint = &target->EndPoint[pPacket->Endpoint];
+        HTC_PACKET_RESET_RX(pPacket);
+        if (pEndpoint->EpCallBacks.EpRecvAlloc != NULL) {
+            pPacket->Status = A_ECANCELED;
+            pEndpoint->EpCallBacks.EpRecv(pEndpoint->EpCallBacks.pContext, pPacket);
+        } else {
+            LOCK_HTC_RX(target);
+            DL_ListInsertHead(&pEndpoint->RxBuffers, &pPacket->ListLink);
+            UNLOCK_HTC_RX(target);
+        }
     }
+}
 
-    if (pAsyncProc != NULL) {
-            /* indicate to caller how we decided to process this */
-        *pAsyncProc = asyncProc;
+/* get a receive packet for a message on this endpoint */
+static HTC_PACKET *HTCAllocRxPkt(HTC_TARGET *target, HTC_ENDPOINT *pEndpoint, HTC_FRAME_HDR *pHdr)
+{
+    HTC_PACKET *pPacket;
+
+    if (pEndpoint->EpCallBacks.EpRecvAlloc != NULL) {
+            /* user is using a per-packet allocation callback */
+        pPacket = pEndpoint->EpCallBacks.EpRecvAlloc(pEndpoint->EpCallBacks.pContext,
+                                                     (HTC_ENDPOINT_ID) pHdr->EndpointID,
+                                                     pHdr->PayloadLen + sizeof(HTC_FRAME_HDR));
+        return pPacket;
     }
 
-    while (TRUE) {
-        pHdr = (HTC_FRAME_HDR *)LookAhead;
+        /* user is using a refill handler that can refill multiple HTC buffers */
+        /* lock RX to get a buffer */
+    LOCK_HTC_RX(target);
+
+        /* get a packet from the endpoint recv queue */
+    pPacket = HTC_PACKET_DEQUEUE(&pEndpoint->RxBuffers);
+
+    if (NULL == pPacket) {
+            /* check for refill handler */
+        if (pEndpoint->EpCallBacks.EpRecvRefill != NULL) {
+            UNLOCK_HTC_RX(target);
+                /* call the re-fill handler */
+            pEndpoint->EpCallBacks.EpRecvRefill(pEndpoint->EpCallBacks.pContext,
+                                                (HTC_ENDPOINT_ID) pHdr->EndpointID);
+            LOCK_HTC_RX(target);
+                /* check if we have more buffers */
+            pPacket = HTC_PACKET_DEQUEUE(&pEndpoint->RxBuffers);
+                /* fall through */
+        }
+    }
+
+    UNLOCK_HTC_RX(target);
+
+    return pPacket;
+}
+
+/* allocate packets for the messages described by the lookaheads and queue them in
+ * the order the messages sit in the mailbox.  A lookahead with a bundle count
+ * stands for several messages of the same endpoint, the target pads all of them
+ * to the length of the first one. */
+static A_STATUS HTCAllocAndPrepareRxPackets(HTC_TARGET       *target,
+                                            A_UINT32         LookAheads[],
+                                            int              NumLookAheads,
+                                            HTC_PACKET_QUEUE *pQueue)
+{
+    A_STATUS        status = A_OK;
+    HTC_PACKET      *pPacket;
+    HTC_FRAME_HDR   *pHdr;
+    HTC_ENDPOINT    *pEndpoint;
+    int             i, j;
+    int             numMessages;
+    int             fullLength;
+
+    for (i = 0; i < NumLookAheads; i++) {
+
+        pHdr = (HTC_FRAME_HDR *)&LookAheads[i];
 
         if (pHdr->EndpointID >= ENDPOINT_MAX) {
             AR_DEBUG_PRINTF(ATH_DEBUG_ERR,("Invalid Endpoint in look-ahead: %d \n",pHdr->EndpointID));
@@ -486,130 +629,338 @@ A_STATUS HTCRecvMessagePendingHandler(void *Context, A_UINT32 *LookAhead, A_BOOL
             break;
         }
 
-        if (pEndpoint->EpCallBacks.EpRecvAlloc != NULL) {
-                /* user is using a per-packet allocation callback */
-            pPacket = pEndpoint->EpCallBacks.EpRecvAlloc(pEndpoint->EpCallBacks.pContext,
-                                                         (HTC_ENDPOINT_ID) pHdr->EndpointID,
-                                                         pHdr->PayloadLen + sizeof(HTC_FRAME_HDR));
+        numMessages = 1;
 
-                /* lock RX, in case this allocation fails, we need to update internal state below */
+        if (pHdr->Flags & HTC_FLAGS_RECV_BUNDLE_CNT_MASK) {
+                /* the count does not include the first message */
+            numMessages += (pHdr->Flags & HTC_FLAGS_RECV_BUNDLE_CNT_MASK) >> HTC_FLAGS_RECV_BUNDLE_CNT_SHIFT;
 
-            LOCK_HTC_RX(target);
+            if (!target->RecvBundlingEnabled || (numMessages > target->MaxMsgPerBundle)) {
+                AR_DEBUG_PRINTF(ATH_DEBUG_ERR,
+                    ("HTC bundle of %d messages not expected (max: %d, enabled: %d) \n",
+                    numMessages, target->MaxMsgPerBundle, target->RecvBundlingEnabled));
+                status = A_EPROTO;
+                break;
+            }
 
-        } else {
-                /* user is using a refill handler that can refill multiple HTC buffers */
-                /* lock RX to get a buffer */
-            LOCK_HTC_RX(target);
+            AR_DEBUG_PRINTF(ATH_DEBUG_RECV,
+                ("HTC header indicates :%d messages can be fetched as a bundle \n",numMessages));
+        }
 
-                /* get a packet from the endpoint recv queue */
-            pPacket = HTC_PACKET_DEQUEUE(&pEndpoint->RxBuffers);
+        fullLength = DEV_CALC_RECV_PADDED_LEN(&target->Device,pHdr->PayloadLen + sizeof(HTC_FRAME_HDR));
+
+        for (j = 0; j < numMessages; j++) {
+
+            pPacket = HTCAllocRxPkt(target, pEndpoint, pHdr);
+
+            LOCK_HTC_RX(target);
 
             if (NULL == pPacket) {
-                    /* check for refill handler */
-                if (pEndpoint->EpCallBacks.EpRecvRefill != NULL) {
-                    UNLOCK_HTC_RX(target);
-                        /* call the re-fill handler */
-                    pEndpoint->EpCallBacks.EpRecvRefill(pEndpoint->EpCallBacks.pContext,
-                                                        (HTC_ENDPOINT_ID) pHdr->EndpointID);
-                    LOCK_HTC_RX(target);
-                        /* check if we have more buffers */
-                    pPacket = HTC_PACKET_DEQUEUE(&pEndpoint->RxBuffers);
-                        /* fall through */
-                }
+                    /* this is not an error, we simply need to mark that we are waiting for buffers.*/
+                target->HTCStateFlags |= HTC_STATE_WAIT_BUFFERS;
+                target->EpWaitingForBuffers = (HTC_ENDPOINT_ID) pHdr->EndpointID;
+                status = A_NO_MEMORY;
+            } else if (HTC_STOPPING(target)) {
+                status = A_ECANCELED;
             }
-        }
 
-        if (NULL == pPacket) {
-                /* this is not an error, we simply need to mark that we are waiting for buffers.*/
-            target->HTCStateFlags |= HTC_STATE_WAIT_BUFFERS;
-            target->EpWaitingForBuffers = (HTC_ENDPOINT_ID) pHdr->EndpointID;
-            status = A_NO_MEMORY;
-        }
+            UNLOCK_HTC_RX(target);
 
-        if (HTC_STOPPING(target)) {
-            status = A_ECANCELED;
-        }
+            if (pPacket != NULL) {
+                    /* queue it, so the caller gives it back if anything fails */
+                HTC_PACKET_ENQUEUE(pQueue,pPacket);
+            }
 
-        UNLOCK_HTC_RX(target);
+            if (A_FAILED(status)) {
+                /* no buffers or stopping */
+                break;
+            }
+
+            AR_DEBUG_ASSERT(pPacket->Endpoint == pHdr->EndpointID);
+
+            pPacket->PktInfo.AsRx.IndicationFlags = 0;
+            pPacket->PktInfo.AsRx.HTCRxFlags = 0;
+
+                /* make sure this message can fit in the endpoint buffer */
+            if ((A_UINT32)fullLength > pPacket->BufferLength) {
+                AR_DEBUG_PRINTF(ATH_DEBUG_ERR,
+                        ("Payload Length Error : header reports payload of: %d (%d) endpoint buffer size: %d \n",
+                        pHdr->PayloadLen, fullLength, pPacket->BufferLength));
+                status = A_EPROTO;
+                break;
+            }
+
+            if (j > 0) {
+                    /* for messages fetched in a bundled transfer, only the first
+                     * header is known, the rest get picked up from the buffer */
+                pPacket->PktInfo.AsRx.HTCRxFlags |= HTC_RX_PKT_REFRESH_HDR;
+                pPacket->HTCReserved = 0;
+            } else {
+                pPacket->HTCReserved = LookAheads[i]; /* set expected look ahead */
+            }
+
+            if (numMessages > 1) {
+                pPacket->PktInfo.AsRx.HTCRxFlags |= HTC_RX_PKT_PART_OF_BUNDLE;
+            }
+
+                /* set the amount of data to fetch */
+            pPacket->ActualLength = pHdr->PayloadLen + HTC_HDR_LENGTH;
+        }
 
         if (A_FAILED(status)) {
-            /* no buffers or stopping */
             break;
         }
+    }
+
+    return status;
+}
 
-        pPacket->PktInfo.AsRx.IndicationFlags = 0;
+/* fetch a run of queued packets with one scatter transfer, the fetched packets are
+ * moved to pSyncCompletionQueue in mailbox order.  *pNumPacketsFetched is zero
+ * if the run could not be bundled and the caller has to fetch singly */
+static A_STATUS HTCIssueRecvPacketBundle(HTC_TARGET        *target,
+                                         HTC_PACKET_QUEUE  *pRecvPktQueue,
+                                         HTC_PACKET_QUEUE  *pSyncCompletionQueue,
+                                         int               *pNumPacketsFetched)
+{
+    A_STATUS        status = A_OK;
+    HIF_SCATTER_REQ *pScatterReq;
+    int             i, totalLength;
+    int             paddedLength;
+    HTC_PACKET      *pPacket;
+    int             maxMessages;
 
-        AR_DEBUG_ASSERT(pPacket->Endpoint == pHdr->EndpointID);
+    *pNumPacketsFetched = 0;
 
-            /* make sure this message can fit in the endpoint buffer */
-        if ((pHdr->PayloadLen + HTC_HDR_LENGTH) > pPacket->BufferLength) {
-            AR_DEBUG_PRINTF(ATH_DEBUG_ERR,
-                    ("Payload Length Error : header reports payload of: %d, endpoint buffer size: %d \n",
-                    pHdr->PayloadLen, pPacket->BufferLength));
-            status = A_EPROTO;
+    pScatterReq = DEV_ALLOC_SCATTER_REQ(&target->Device);
+
+    if (NULL == pScatterReq) {
+            /* no scatter resources, fetch singly */
+        return A_OK;
+    }
+
+    maxMessages = min(target->MaxMsgPerBundle, DEV_GET_MAX_MSG_PER_BUNDLE(&target->Device));
+    totalLength = 0;
+
+    for (i = 0; (i < maxMessages) && !HTC_QUEUE_EMPTY(pRecvPktQueue); i++) {
+        pPacket = HTC_GET_PKT_AT_HEAD(pRecvPktQueue);
+        paddedLength = DEV_CALC_RECV_PADDED_LEN(&target->Device, pPacket->ActualLength);
+        if ((totalLength + paddedLength) > DEV_GET_MAX_BUNDLE_RECV_LENGTH(&target->Device)) {
+                /* the next one won't fit */
             break;
         }
+        HTC_PACKET_REMOVE(pPacket);
+        pScatterReq->ScatterList[i].pBuffer = pPacket->pBuffer;
+        pScatterReq->ScatterList[i].Length = paddedLength;
+        pScatterReq->ScatterList[i].pCallerContexts[0] = pPacket;
+        totalLength += paddedLength;
+    }
 
-        pPacket->HTCReserved = *LookAhead; /* set expected look ahead */
-            /* set the amount of data to fetch */
-        pPacket->ActualLength = pHdr->PayloadLen + HTC_HDR_LENGTH;
+    if (i < 2) {
+            /* nothing to bundle, put it back */
+        if (i == 1) {
+            pPacket = (HTC_PACKET *)pScatterReq->ScatterList[0].pCallerContexts[0];
+            DL_ListInsertHead(pRecvPktQueue, &pPacket->ListLink);
+        }
+        DEV_FREE_SCATTER_REQ(&target->Device, pScatterReq);
+        return A_OK;
+    }
+
+    pScatterReq->ValidScatterEntries = i;
+    pScatterReq->TotalLength = totalLength;
+    pScatterReq->CompletionRoutine = NULL;
+
+    AR_DEBUG_PRINTF(ATH_DEBUG_RECV,("HTCIssueRecvPacketBundle, %d messages, %d bytes \n",
+            i, totalLength));
+
+        /* fully synchronous, we are in the interrupt DSR */
+    status = DevSubmitScatterRequest(&target->Device, pScatterReq, DEV_SCATTER_READ, DEV_SCATTER_SYNC);
+
+    for (i = 0; i < pScatterReq->ValidScatterEntries; i++) {
+        pPacket = (HTC_PACKET *)pScatterReq->ScatterList[i].pCallerContexts[0];
+        pPacket->Status = status;
+            /* the caller gives these back on failure */
+        HTC_PACKET_ENQUEUE(pSyncCompletionQueue,pPacket);
+    }
+
+    if (A_SUCCESS(status)) {
+        *pNumPacketsFetched = pScatterReq->ValidScatterEntries;
+        LOCK_HTC_RX(target);
+        INC_HTC_BUNDLE_STAT(target,Rx,pScatterReq->ValidScatterEntries,totalLength);
+        UNLOCK_HTC_RX(target);
+    }
+
+    DEV_FREE_SCATTER_REQ(&target->Device, pScatterReq);
+
+    return status;
+}
+
+/* callback when device layer or lookahead report parsing detects a pending message */
+A_STATUS HTCRecvMessagePendingHandler(void *Context, A_UINT32 *LookAhead, A_BOOL *pAsyncProc)
+{
+    HTC_TARGET      *target = (HTC_TARGET *)Context;
+    A_STATUS         status = A_OK;
+    HTC_PACKET      *pPacket = NULL;
+    HTC_PACKET      *pNext;
+    HTC_FRAME_HDR   *pHdr = NULL;
+    HTC_ENDPOINT    *pEndpoint = NULL;
+    A_BOOL          asyncProc = FALSE;
+    A_UINT32        lookAheads[HTC_HOST_MAX_MSG_PER_BUNDLE];
+    int             numLookAheads = 1;
+    int             numFetched;
+    HTC_PACKET_QUEUE recvPktQueue, syncCompletedPktsQueue;
+    A_UINT32        fetchLength;
+
+    AR_DEBUG_PRINTF(ATH_DEBUG_RECV,("+HTCRecvMessagePendingHandler LookAhead:0x%X \n", *LookAhead));
+    
+    if (IS_DEV_IRQ_PROCESSING_ASYNC_ALLOWED(&target->Device)) {
+            /* We use async mode to get the packets if the device layer supports it.
+             * The device layer interfaces with HIF in which HIF may have restrictions on
+             * how interrupts are processed */
+        asyncProc = TRUE;
+    }
+
+    if (pAsyncProc != NULL) {
+            /* indicate to caller how we decided to process this */
+        *pAsyncProc = asyncProc;
+    }
+
+    INIT_HTC_PACKET_QUEUE(&recvPktQueue);
+    INIT_HTC_PACKET_QUEUE(&syncCompletedPktsQueue);
+
+    lookAheads[0] = *LookAhead;
+
+    while (TRUE) {
+
+        *LookAhead = lookAheads[0];
+        pHdr = (HTC_FRAME_HDR *)&lookAheads[0];
 
         if (asyncProc) {
-                /* we use async mode to get the packet if the device layer supports it
-                 * set our callback and context */
-            pPacket->Completion = HTCRecvCompleteHandler;
-            pPacket->pContext = target;
-        } else {
-                /* fully synchronous */
-            pPacket->Completion = NULL;
+                /* bundles are never expected in this mode */
+            numLookAheads = 1;
         }
 
-            /* go fetch the packet */
-        status = HTCIssueRecv(target, pPacket);
+            /* get packets for all the messages we know about */
+        status = HTCAllocAndPrepareRxPackets(target, lookAheads, numLookAheads, &recvPktQueue);
 
         if (A_FAILED(status)) {
+            /* no buffers, stopping or a bad lookahead */
             break;
         }
 
         if (asyncProc) {
+            pPacket = HTC_PACKET_DEQUEUE(&recvPktQueue);
+                /* we use async mode to get the packet if the device layer supports it
+                 * set our callback and context */
+            pPacket->Completion = HTCRecvCompleteHandler;
+            pPacket->pContext = target;
+                /* go fetch the packet */
+            status = HTCIssueRecv(target, pPacket);
+            if (A_FAILED(status)) {
+                HTC_PACKET_ENQUEUE(&recvPktQueue,pPacket);
+            }
+            pPacket = NULL;
                 /* we did this asynchronously so we can get out of the loop, the asynch processing
                  * creates a chain of requests to continue processing pending messages in the
                  * context of callbacks  */
             break;
         }
 
-            /* in the sync case, we process the packet, check lookaheads and then repeat */
+            /* in the sync case, fetch everything in mailbox order, bundling runs of
+             * messages when the target agreed to it */
+        while (!HTC_QUEUE_EMPTY(&recvPktQueue)) {
 
-        *LookAhead = 0;
-        status = HTCProcessRecvHeader(target,pPacket,LookAhead);
+            numFetched = 0;
+
+            if (target->RecvBundlingEnabled && (recvPktQueue.pNext != recvPktQueue.pPrev)) {
+                    /* more than one message pending, try a bundle */
+                status = HTCIssueRecvPacketBundle(target,
+                                                  &recvPktQueue,
+                                                  &syncCompletedPktsQueue,
+                                                  &numFetched);
+                if (A_FAILED(status)) {
+                    break;
+                }
+            }
+
+            if (numFetched == 0) {
+                    /* fetch a single message */
+                pPacket = HTC_PACKET_DEQUEUE(&recvPktQueue);
+                    /* fully synchronous */
+                pPacket->Completion = NULL;
+                fetchLength = DEV_CALC_RECV_PADDED_LEN(&target->Device, pPacket->ActualLength);
+                status = HTCIssueRecv(target, pPacket);
+                if (A_FAILED(status)) {
+                    break;
+                }
+                HTC_PACKET_ENQUEUE(&syncCompletedPktsQueue,pPacket);
+                pPacket = NULL;
+                LOCK_HTC_RX(target);
+                INC_HTC_BUNDLE_STAT(target,Rx,1,fetchLength);
+                UNLOCK_HTC_RX(target);
+            }
+        }
 
         if (A_FAILED(status)) {
             break;
         }
 
-        HTC_RX_STAT_PROFILE(target,pEndpoint,*LookAhead);
-
-            /* check lookahead to see if we can indicate next packet hint to recv callback */
-        if (LookAhead != 0) {
-            pHdr = (HTC_FRAME_HDR *)&LookAhead;
-                /* check to see if the "next" packet is from the same endpoint of the
-                   completing packet */
-            if (pHdr->EndpointID == pPacket->Endpoint) {
-                    /* check that there is a buffer available to actually fetch it
-                     * NOTE: no need to lock RX here , since we are synchronously processing RX
-                     * and we are only looking at the queue (not modifying it) */
-                if (!HTC_QUEUE_EMPTY(&pEndpoint->RxBuffers)) {                        
-                        /* provide a hint that there are more RX packets to fetch */
-                    pPacket->PktInfo.AsRx.IndicationFlags |= HTC_RX_FLAGS_INDICATE_MORE_PKTS;        
-                }             
-            }                  
-        }
-        
-        DO_RCV_COMPLETION(target,pPacket,pEndpoint);
+            /* process the fetched packets, only the lookahead of the last one
+             * points to messages we have not fetched yet */
+        numLookAheads = 0;
+
+        while (!HTC_QUEUE_EMPTY(&syncCompletedPktsQueue)) {
 
-        pPacket = NULL;
+            pPacket = HTC_PACKET_DEQUEUE(&syncCompletedPktsQueue);
+            pEndpoint = &target->EndPoint[pPacket->Endpoint];
+
+            numLookAheads = 0;
+            status = HTCProcessRecvHeader(target,pPacket,lookAheads,&numLookAheads);
+
+            if (A_FAILED(status)) {
+                break;
+            }
+
+            if (!HTC_QUEUE_EMPTY(&syncCompletedPktsQueue)) {
+                    /* the lookahead of this one was fetched already */
+                numLookAheads = 0;
+            }
+
+            HTC_RX_STAT_PROFILE(target,pEndpoint,numLookAheads);
+
+            if (!HTC_QUEUE_EMPTY(&syncCompletedPktsQueue)) {
+                pNext = HTC_GET_PKT_AT_HEAD(&syncCompletedPktsQueue);
+                if (pNext->Endpoint == pPacket->Endpoint) {
+                        /* the next one is already here */
+                    pPacket->PktInfo.AsRx.IndicationFlags |= HTC_RX_FLAGS_INDICATE_MORE_PKTS;
+                }
+            } else if (numLookAheads > 0) {
+                    /* check lookahead to see if we can indicate next packet hint to recv callback */
+                pHdr = (HTC_FRAME_HDR *)&lookAheads[0];
+                    /* check to see if the "next" packet is from the same endpoint of the
+                       completing packet */
+                if (pHdr->EndpointID == pPacket->Endpoint) {
+                        /* check that there is a buffer available to actually fetch it
+                         * NOTE: no need to lock RX here , since we are synchronously processing RX
+                         * and we are only looking at the queue (not modifying it) */
+                    if (!HTC_QUEUE_EMPTY(&pEndpoint->RxBuffers)) {
+                            /* provide a hint that there are more RX packets to fetch */
+                        pPacket->PktInfo.AsRx.IndicationFlags |= HTC_RX_FLAGS_INDICATE_MORE_PKTS;
+                    }
+                }
+            }
+
+            DO_RCV_COMPLETION(target,pPacket,pEndpoint);
+
+            pPacket = NULL;
+        }
+
+        if (A_FAILED(status)) {
+            break;
+        }
 
-        if (0 == *LookAhead) {
+        if (0 == numLookAheads) {
+            *LookAhead = 0;
             break;
         }
 
@@ -622,6 +973,8 @@ A_STATUS HTCRecvMessagePendingHandler(void *Context, A_UINT32 *LookAhead, A_BOOL
         AR_DEBUG_PRINTF(ATH_DEBUG_ERR,
                 (" Endpoint :%d has no buffers, blocking receiver to prevent overrun.. \n",
                 (pHdr != NULL) ? pHdr->EndpointID : 0xFFFF));
+            /* the message stays in the mailbox, give back what we took for it */
+        HTCReturnUnusedRxPkts(target, &recvPktQueue);
             /* try to stop receive at the device layer */
         DevStopRecv(&target->Device, asyncProc ? DEV_STOP_RECV_ASYNC : DEV_STOP_RECV_SYNC);
         status = A_OK;
@@ -631,8 +984,11 @@ A_STATUS HTCRecvMessagePendingHandler(void *Context, A_UINT32 *LookAhead, A_BOOL
                         *LookAhead, status));
         if (pPacket != NULL) {
                 /* clean up packet on error */
-            HTC_RECYCLE_RX_PKT(target, pPacket, pEndpoint);
+            HTC_PACKET_ENQUEUE(&recvPktQueue,pPacket);
         }
+            /* clean up any packets we did not get to */
+        HTCReturnUnusedRxPkts(target, &syncCompletedPktsQueue);
+        HTCReturnUnusedRxPkts(target, &recvPktQueue);
         if (HTC_STOPPING(target)) {
             AR_DEBUG_PRINTF(ATH_DEBUG_ERR,
                 (" HTC stopping... blocking receiver to finish the stop \n"));
@@ -104,6 +104,189 @@ A_STATUS HTCIssueSend(HTC_TARGET *target, HTC_PACKET *pPacket, A_UINT8 SendFlags
     return status;
 }
 
+/* completion of a send bundle, complete each packet that went out with it */
+static void HTCSendBundleCompletionHandler(HIF_SCATTER_REQ *pScatterReq)
+{
+    HTC_TARGET      *target = (HTC_TARGET *)pScatterReq->Context;
+    HTC_PACKET      *pPacket;
+    int             i;
+
+    if (A_FAILED(pScatterReq->CompletionStatus)) {
+        AR_DEBUG_PRINTF(ATH_DEBUG_ERR,("** Send Scatter Request Failed: %d \n",pScatterReq->CompletionStatus));
+    }
+
+    for (i = 0; i < pScatterReq->ValidScatterEntries; i++) {
+        pPacket = (HTC_PACKET *)(pScatterReq->ScatterList[i].pCallerContexts[0]);
+        pPacket->Status = pScatterReq->CompletionStatus;
+        HTCSendPktCompletionHandler(target, pPacket);
+    }
+
+    DEV_FREE_SCATTER_REQ(&target->Device, pScatterReq);
+}
+
+/* send the packets in pQueue with one scatter transfer, each one padded to a block.
+ * The send flags of every packet were stashed in HTCReserved when its credits were
+ * taken.  Without a free scatter request the packets are sent one at a time. */
+static void HTCIssueSendBundle(HTC_TARGET *target, HTC_PACKET_QUEUE *pQueue, int Count)
+{
+    HIF_SCATTER_REQ *pScatterReq;
+    HTC_PACKET      *pPacket;
+    A_UINT8         *pHdrBuf;
+    int             i, totalLength, paddedLength;
+
+    pScatterReq = DEV_ALLOC_SCATTER_REQ(&target->Device);
+
+    if (NULL == pScatterReq) {
+        AR_DEBUG_PRINTF(ATH_DEBUG_SEND,(" no scatter request, sending %d packets singly \n", Count));
+        while (1) {
+            pPacket = HTC_PACKET_DEQUEUE(pQueue);
+            if (NULL == pPacket) {
+                break;
+            }
+            LOCK_HTC_TX(target);
+            INC_HTC_BUNDLE_STAT(target,Tx,1,
+                DEV_CALC_SEND_PADDED_LEN(&target->Device, pPacket->ActualLength + HTC_HDR_LENGTH));
+            UNLOCK_HTC_TX(target);
+            HTCIssueSend(target, pPacket, (A_UINT8)pPacket->HTCReserved);
+        }
+        return;
+    }
+
+    totalLength = 0;
+
+    for (i = 0; i < Count; i++) {
+        pPacket = HTC_PACKET_DEQUEUE(pQueue);
+        AR_DEBUG_ASSERT(pPacket != NULL);
+        paddedLength = DEV_CALC_SEND_PADDED_LEN(&target->Device, pPacket->ActualLength + HTC_HDR_LENGTH);
+            /* caller always provides headrooom */
+        pPacket->pBuffer -= HTC_HDR_LENGTH;
+        pHdrBuf = pPacket->pBuffer;
+            /* setup frame header */
+        A_SET_UINT16_FIELD(pHdrBuf,HTC_FRAME_HDR,PayloadLen,(A_UINT16)pPacket->ActualLength);
+        A_SET_UINT8_FIELD(pHdrBuf,HTC_FRAME_HDR,Flags,
+                          (A_UINT8)pPacket->HTCReserved | HTC_FLAGS_SEND_BUNDLE);
+        A_SET_UINT8_FIELD(pHdrBuf,HTC_FRAME_HDR,EndpointID, (A_UINT8)pPacket->Endpoint);
+        pScatterReq->ScatterList[i].pBuffer = pHdrBuf;
+        pScatterReq->ScatterList[i].Length = paddedLength;
+        pScatterReq->ScatterList[i].pCallerContexts[0] = pPacket;
+        totalLength += paddedLength;
+    }
+
+    pScatterReq->ValidScatterEntries = Count;
+    pScatterReq->TotalLength = totalLength;
+    pScatterReq->CompletionRoutine = HTCSendBundleCompletionHandler;
+    pScatterReq->Context = target;
+
+    LOCK_HTC_TX(target);
+    INC_HTC_BUNDLE_STAT(target,Tx,Count,totalLength);
+    UNLOCK_HTC_TX(target);
+
+    AR_DEBUG_PRINTF(ATH_DEBUG_SEND,("+-HTCIssueSendBundle: %d messages, %d bytes \n",
+            Count, totalLength));
+
+        /* the completion routine runs in every case */
+    DevSubmitScatterRequest(&target->Device, pScatterReq, DEV_SCATTER_WRITE, DEV_SCATTER_ASYNC);
+}
+
+/* take the credits a packet at the head of the endpoint queue needs, returns FALSE
+ * (and leaves the credits alone) if there are not enough.  Called with the TX lock held. */
+static A_BOOL HTCGetSendCredits(HTC_TARGET   *target,
+                                HTC_ENDPOINT *pEndpoint,
+                                HTC_PACKET   *pPacket,
+                                A_UINT8      *pSendFlags)
+{
+    int         creditsRequired;
+    int         remainder;
+
+        /* figure out how many credits this message requires */
+    creditsRequired = (pPacket->ActualLength + HTC_HDR_LENGTH) / target->TargetCreditSize;
+    remainder = (pPacket->ActualLength + HTC_HDR_LENGTH) % target->TargetCreditSize;
+
+    if (remainder) {
+        creditsRequired++;
+    }
+
+    AR_DEBUG_PRINTF(ATH_DEBUG_SEND,(" Creds Required:%d   Got:%d\n",
+                        creditsRequired, pEndpoint->CreditDist.TxCredits));
+
+    if (pEndpoint->CreditDist.TxCredits < creditsRequired) {
+
+        /* not enough credits */
+
+        if (pPacket->Endpoint == ENDPOINT_0) {
+                /* leave it in the queue */
+            return FALSE;
+        }
+            /* invoke the registered distribution function only if this is not
+             * endpoint 0, we let the driver layer provide more credits if it can.
+             * We pass the credit distribution list starting at the endpoint in question
+             * */
+
+            /* set how many credits we need  */
+        pEndpoint->CreditDist.TxCreditsSeek =
+                                creditsRequired - pEndpoint->CreditDist.TxCredits;
+        DO_DISTRIBUTION(target,
+                        HTC_CREDIT_DIST_SEEK_CREDITS,
+                        "Seek Credits",
+                        &pEndpoint->CreditDist);
+        pEndpoint->CreditDist.TxCreditsSeek = 0;
+
+        if (pEndpoint->CreditDist.TxCredits < creditsRequired) {
+                /* still not enough credits to send, leave packet in the queue */
+            AR_DEBUG_PRINTF(ATH_DEBUG_SEND,
+                (" Not enough credits for ep %d leaving packet in queue..\n",
+                pPacket->Endpoint));
+            return FALSE;
+        }
+
+    }
+
+    pEndpoint->CreditDist.TxCredits -= creditsRequired;
+    INC_HTC_EP_STAT(pEndpoint, TxCreditsConsummed, creditsRequired);
+
+        /* check if we need credits back from the target */
+    if (pEndpoint->CreditDist.TxCredits < pEndpoint->CreditDist.TxCreditsPerMaxMsg) {
+            /* we are getting low on credits, see if we can ask for more from the distribution function */
+        pEndpoint->CreditDist.TxCreditsSeek =
+                    pEndpoint->CreditDist.TxCreditsPerMaxMsg - pEndpoint->CreditDist.TxCredits;
+
+        DO_DISTRIBUTION(target,
+                        HTC_CREDIT_DIST_SEEK_CREDITS,
+                        "Seek Credits",
+                        &pEndpoint->CreditDist);
+
+        pEndpoint->CreditDist.TxCreditsSeek = 0;
+            /* see if we were successful in getting more */
+        if (pEndpoint->CreditDist.TxCredits < pEndpoint->CreditDist.TxCreditsPerMaxMsg) {
+                /* tell the target we need credits ASAP! */
+            *pSendFlags |= HTC_FLAGS_NEED_CREDIT_UPDATE;
+            INC_HTC_EP_STAT(pEndpoint, TxCreditLowIndications, 1);
+            AR_DEBUG_PRINTF(ATH_DEBUG_SEND,(" Host Needs Credits  \n"));
+        }
+    }
+
+    return TRUE;
+}
+
+/* queue an expedited packet behind any other expedited packets but ahead of
+ * the bulk packets waiting on the endpoint, call with tx lock held */
+static void HTCEnqueueExpedited(HTC_PACKET_QUEUE *pQueue, HTC_PACKET *pPacket)
+{
+    DL_LIST    *pItem;
+    HTC_PACKET *pQueued;
+
+    ITERATE_OVER_LIST(pQueue, pItem) {
+        pQueued = A_CONTAINING_STRUCT(pItem, HTC_PACKET, ListLink);
+        if (!(pQueued->PktInfo.AsTx.Flags & HTC_TX_PACKET_FLAG_EXPEDITE)) {
+                /* inserting at the "tail" of an item links in front of it */
+            DL_ListInsertTail(pItem, &pPacket->ListLink);
+            return;
+        }
+    }
+
+    HTC_PACKET_ENQUEUE(pQueue, pPacket);
+}
+
 /* try to send the current packet or a packet at the head of the TX queue,
  * if there are no credits, the packet remains in the queue.
  * this function returns the result of the attempt to send the HTC packet */
@@ -112,10 +295,13 @@ static HTC_SEND_QUEUE_RESULT HTCTrySend(HTC_TARGET   *target,
                                         HTC_PACKET   *pPacketToSend)
 {
     HTC_PACKET  *pPacket;
-    int         creditsRequired;
-    int         remainder;
+    HTC_PACKET  *pNext;
     A_UINT8     sendFlags;
     HTC_SEND_QUEUE_RESULT result;
+    HTC_PACKET_QUEUE bundleQueue;
+    int         bundleCount;
+    int         bundleLength;
+    int         paddedLength;
 
     AR_DEBUG_PRINTF(ATH_DEBUG_SEND,("+HTCTrySend (pPkt:0x%X)\n",(A_UINT32)pPacketToSend));
 
@@ -144,7 +330,11 @@ static HTC_SEND_QUEUE_RESULT HTCTrySend(HTC_TARGET   *target,
 
     if (pPacketToSend != NULL) {
             /* packet was supplied to be queued */
-        HTC_PACKET_ENQUEUE(&pEndpoint->TxQueue,pPacketToSend);
+        if (pPacketToSend->PktInfo.AsTx.Flags & HTC_TX_PACKET_FLAG_EXPEDITE) {
+            HTCEnqueueExpedited(&pEndpoint->TxQueue,pPacketToSend);
+        } else {
+            HTC_PACKET_ENQUEUE(&pEndpoint->TxQueue,pPacketToSend);
+        }
         pEndpoint->CurrentTxQueueDepth++;
     }
 
@@ -185,82 +375,61 @@ static HTC_SEND_QUEUE_RESULT HTCTrySend(HTC_TARGET   *target,
         AR_DEBUG_PRINTF(ATH_DEBUG_SEND,(" Got head packet:0x%X , Queue Depth: %d\n",
                 (A_UINT32)pPacket, pEndpoint->CurrentTxQueueDepth));
 
-            /* figure out how many credits this message requires */
-        creditsRequired = (pPacket->ActualLength + HTC_HDR_LENGTH) / target->TargetCreditSize;
-        remainder = (pPacket->ActualLength + HTC_HDR_LENGTH) % target->TargetCreditSize;
-
-        if (remainder) {
-            creditsRequired++;
+        if (!HTCGetSendCredits(target, pEndpoint, pPacket, &sendFlags)) {
+            break;
         }
 
-        AR_DEBUG_PRINTF(ATH_DEBUG_SEND,(" Creds Required:%d   Got:%d\n",
-                            creditsRequired, pEndpoint->CreditDist.TxCredits));
-
-        if (pEndpoint->CreditDist.TxCredits < creditsRequired) {
+            /* now we can fully dequeue */
+        pPacket = HTC_PACKET_DEQUEUE(&pEndpoint->TxQueue);
+        pEndpoint->CurrentTxQueueDepth--;
 
-            /* not enough credits */
+        INC_HTC_EP_STAT(pEndpoint, TxIssued, 1);
 
-            if (pPacket->Endpoint == ENDPOINT_0) {
-                    /* leave it in the queue */
-                break;
-            }
-                /* invoke the registered distribution function only if this is not
-                 * endpoint 0, we let the driver layer provide more credits if it can.
-                 * We pass the credit distribution list starting at the endpoint in question
-                 * */
-
-                /* set how many credits we need  */
-            pEndpoint->CreditDist.TxCreditsSeek =
-                                    creditsRequired - pEndpoint->CreditDist.TxCredits;
-            DO_DISTRIBUTION(target,
-                            HTC_CREDIT_DIST_SEEK_CREDITS,
-                            "Seek Credits",
-                            &pEndpoint->CreditDist);
-            pEndpoint->CreditDist.TxCreditsSeek = 0;
-
-            if (pEndpoint->CreditDist.TxCredits < creditsRequired) {
-                    /* still not enough credits to send, leave packet in the queue */
-                AR_DEBUG_PRINTF(ATH_DEBUG_SEND,
-                    (" Not enough credits for ep %d leaving packet in queue..\n",
-                    pPacket->Endpoint));
-                break;
+        pPacket->HTCReserved = sendFlags;
+        bundleCount = 1;
+
+        if (target->SendBundlingEnabled && (pPacket->Endpoint != ENDPOINT_0) &&
+            !HTC_QUEUE_EMPTY(&pEndpoint->TxQueue)) {
+                /* pull in more packets that have credits and fit in one bus transfer */
+            INIT_HTC_PACKET_QUEUE(&bundleQueue);
+            HTC_PACKET_ENQUEUE(&bundleQueue,pPacket);
+            bundleLength = DEV_CALC_SEND_PADDED_LEN(&target->Device,
+                                                    pPacket->ActualLength + HTC_HDR_LENGTH);
+
+            while ((bundleCount < target->MaxMsgPerBundle) &&
+                   !HTC_QUEUE_EMPTY(&pEndpoint->TxQueue)) {
+                pNext = HTC_GET_PKT_AT_HEAD(&pEndpoint->TxQueue);
+                paddedLength = DEV_CALC_SEND_PADDED_LEN(&target->Device,
+                                                        pNext->ActualLength + HTC_HDR_LENGTH);
+                if ((bundleLength + paddedLength) > DEV_GET_MAX_BUNDLE_SEND_LENGTH(&target->Device)) {
+                    break;
+                }
+                sendFlags = 0;
+                if (!HTCGetSendCredits(target, pEndpoint, pNext, &sendFlags)) {
+                    break;
+                }
+                pNext = HTC_PACKET_DEQUEUE(&pEndpoint->TxQueue);
+                pEndpoint->CurrentTxQueueDepth--;
+                INC_HTC_EP_STAT(pEndpoint, TxIssued, 1);
+                pNext->HTCReserved = sendFlags;
+                HTC_PACKET_ENQUEUE(&bundleQueue,pNext);
+                bundleLength += paddedLength;
+                bundleCount++;
             }
-
         }
 
-        pEndpoint->CreditDist.TxCredits -= creditsRequired;
-        INC_HTC_EP_STAT(pEndpoint, TxCreditsConsummed, creditsRequired);
-
-            /* check if we need credits back from the target */
-        if (pEndpoint->CreditDist.TxCredits < pEndpoint->CreditDist.TxCreditsPerMaxMsg) {
-                /* we are getting low on credits, see if we can ask for more from the distribution function */
-            pEndpoint->CreditDist.TxCreditsSeek =
-                        pEndpoint->CreditDist.TxCreditsPerMaxMsg - pEndpoint->CreditDist.TxCredits;
-
-            DO_DISTRIBUTION(target,
-                            HTC_CREDIT_DIST_SEEK_CREDITS,
-                            "Seek Credits",
-                            &pEndpoint->CreditDist);
-
-            pEndpoint->CreditDist.TxCreditsSeek = 0;
-                /* see if we were successful in getting more */
-            if (pEndpoint->CreditDist.TxCredits < pEndpoint->CreditDist.TxCreditsPerMaxMsg) {
-                    /* tell the target we need credits ASAP! */
-                sendFlags |= HTC_FLAGS_NEED_CREDIT_UPDATE;
-                INC_HTC_EP_STAT(pEndpoint, TxCreditLowIndications, 1);
-                AR_DEBUG_PRINTF(ATH_DEBUG_SEND,(" Host Needs Credits  \n"));
-            }
+        if (bundleCount == 1) {
+            INC_HTC_BUNDLE_STAT(target,Tx,1,
+                DEV_CALC_SEND_PADDED_LEN(&target->Device, pPacket->ActualLength + HTC_HDR_LENGTH));
         }
 
-            /* now we can fully dequeue */
-        pPacket = HTC_PACKET_DEQUEUE(&pEndpoint->TxQueue);
-        pEndpoint->CurrentTxQueueDepth--;
-
-        INC_HTC_EP_STAT(pEndpoint, TxIssued, 1);
-
         UNLOCK_HTC_TX(target);
 
-        HTCIssueSend(target, pPacket, sendFlags);
+        if (bundleCount > 1) {
+            HTCIssueSendBundle(target, &bundleQueue, bundleCount);
+        } else {
+            HTCIssueSend(target, pPacket, (A_UINT8)pPacket->HTCReserved);
+        }
 
         LOCK_HTC_TX(target);
 
@@ -55,6 +55,8 @@ A_STATUS HTCSendSetupComplete(HTC_TARGET *target)
     HTC_PACKET             *pSendPacket = NULL;
     A_STATUS                status;
     HTC_SETUP_COMPLETE_MSG *pSetupComplete;
+    HTC_SETUP_COMPLETE_EX_MSG *pSetupCompleteEx;
+    A_UINT32               setupLength;
 
     do {
            /* allocate a packet to send to the target */
@@ -65,15 +67,29 @@ A_STATUS HTCSendSetupComplete(HTC_TARGET *target)
             break;
         }
 
-            /* assemble setup complete message */
-        pSetupComplete = (HTC_SETUP_COMPLETE_MSG *)pSendPacket->pBuffer;
-        A_MEMZERO(pSetupComplete,sizeof(HTC_SETUP_COMPLETE_MSG));
-        pSetupComplete->MessageID = HTC_MSG_SETUP_COMPLETE_ID;
+        if (target->HTCTargetVersion >= HTC_VERSION_2P1) {
+                /* newer targets take the extended message, which is how the target
+                 * learns that it may bundle messages to us */
+            pSetupCompleteEx = (HTC_SETUP_COMPLETE_EX_MSG *)pSendPacket->pBuffer;
+            A_MEMZERO(pSetupCompleteEx,sizeof(HTC_SETUP_COMPLETE_EX_MSG));
+            pSetupCompleteEx->MessageID = HTC_MSG_SETUP_COMPLETE_EX_ID;
+            if (target->RecvBundlingEnabled) {
+                pSetupCompleteEx->SetupFlags |= HTC_SETUP_COMPLETE_FLAGS_ENABLE_BUNDLE_RECV;
+                pSetupCompleteEx->MaxMsgsPerBundledRecv = target->MaxMsgPerBundle;
+            }
+            setupLength = sizeof(HTC_SETUP_COMPLETE_EX_MSG);
+        } else {
+                /* assemble setup complete message */
+            pSetupComplete = (HTC_SETUP_COMPLETE_MSG *)pSendPacket->pBuffer;
+            A_MEMZERO(pSetupComplete,sizeof(HTC_SETUP_COMPLETE_MSG));
+            pSetupComplete->MessageID = HTC_MSG_SETUP_COMPLETE_ID;
+            setupLength = sizeof(HTC_SETUP_COMPLETE_MSG);
+        }
 
         SET_HTC_PACKET_INFO_TX(pSendPacket,
                                NULL,
-                               (A_UINT8 *)pSetupComplete,
-                               sizeof(HTC_SETUP_COMPLETE_MSG),
+                               pSendPacket->pBuffer,
+                               setupLength,
                                ENDPOINT_0,
                                HTC_SERVICE_TX_PACKET_TAG);
 
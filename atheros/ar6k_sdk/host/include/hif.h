@@ -136,6 +136,7 @@ typedef enum {
     HIF_DEVICE_GET_IRQ_YIELD_PARAMS,
     HIF_CONFIGURE_QUERY_SCATTER_REQUEST_SUPPORT,
     HIF_DEVICE_GET_OS_DEVICE,
+    HIF_DEVICE_SET_IRQ_MODERATION,
 } HIF_DEVICE_CONFIG_OPCODE;
 
 /*
@@ -209,6 +210,13 @@ typedef enum {
  *   output : HIF_DEVICE_OS_DEVICE_INFO;
  *   note: On some operating systems, the HIF layer has a parent device object for the bus.  This object
  *         may be required to register certain types of logical devices.
+ *
+ *   HIF_DEVICE_SET_IRQ_MODERATION
+ *   input : A_UINT32, interval in milliseconds (0 to disable)
+ *   output : none
+ *   note: this is optional for the HIF layer.  The HIF layer holds off calling the DSR for the
+ *         given interval after the target interrupts, so messages arriving in the meantime are
+ *         fetched in the same pass instead of waking the host once per message.
  * 
  */
 
@@ -212,6 +212,24 @@ typedef struct _HTC_ENDPOINT_STATS {
                                          found in messages received on this endpoint */
 } HTC_ENDPOINT_STATS;
 
+    /* max messages the host will put in a send or accept in a recv bundle */
+#define HTC_HOST_MAX_MSG_PER_BUNDLE  8
+
+    /* message bundling statistics */
+typedef struct _HTC_BUNDLE_STATS {
+    A_UINT32  MaxMsgsPerBundle;       /* negotiated bundle depth, 0 if bundling is off */
+    A_UINT32  TxTransfers;            /* bus transfers issued (single sends and bundles) */
+    A_UINT32  TxMessages;             /* messages sent */
+    A_UINT32  TxBytes;                /* bytes sent, including padding */
+    A_UINT32  TxBundles;              /* send bundles issued */
+    A_UINT32  TxBundleDepth[HTC_HOST_MAX_MSG_PER_BUNDLE + 1]; /* transfers by message count */
+    A_UINT32  RxTransfers;            /* bus transfers fetched (single recvs and bundles) */
+    A_UINT32  RxMessages;             /* messages received */
+    A_UINT32  RxBytes;                /* bytes received, including padding */
+    A_UINT32  RxBundles;              /* recv bundles fetched */
+    A_UINT32  RxBundleDepth[HTC_HOST_MAX_MSG_PER_BUNDLE + 1]; /* transfers by message count */
+} HTC_BUNDLE_STATS;
+
 /* ------ Function Prototypes ------ */
 /*+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
   @desc: Create an instance of HTC over the underlying HIF device
@@ -429,6 +447,25 @@ A_BOOL       HTCGetEndpointStatistics(HTC_HANDLE               HTCHandle,
                                       HTC_ENDPOINT_STAT_ACTION Action,
                                       HTC_ENDPOINT_STATS       *pStats);
 
+/*+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  @desc: Get message bundling statistics
+  @function name: HTCGetBundleStatistics
+  @input:  HTCHandle - HTC handle
+           Action - action to take with statistics
+  @output:
+           pStats - statistics that were sampled (can be NULL if Action is HTC_EP_STAT_CLEAR)
+
+  @return:
+  @notes:  The statistics count bus transfers against the messages they carried
+           so the effect of bundling can be checked.  The actions are the same as
+           for HTCGetEndpointStatistics, MaxMsgsPerBundle is never cleared.
+  @example:
+  @see also: HTCGetEndpointStatistics
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+void         HTCGetBundleStatistics(HTC_HANDLE               HTCHandle,
+                                    HTC_ENDPOINT_STAT_ACTION Action,
+                                    HTC_BUNDLE_STATS         *pStats);
+
 /*+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
   @desc: Unblock HTC message reception
   @function name: HTCUnblockRecv
@@ -46,18 +46,27 @@ typedef A_UINT16 HTC_TX_TAG;
 
 typedef struct _HTC_TX_PACKET_INFO {
     HTC_TX_TAG    Tag;            /* tag used to selective flush packets */
+    A_UINT16      Flags;          /* HTC_TX_PACKET_FLAG_XXX */
 } HTC_TX_PACKET_INFO;
 
+    /* packet is queued ahead of non-expedited packets on its endpoint (e.g. TCP ACKs) */
+#define HTC_TX_PACKET_FLAG_EXPEDITE    (1 << 0)
+
 #define HTC_TX_PACKET_TAG_ALL          0    /* a tag of zero is reserved and used to flush ALL packets */
 #define HTC_TX_PACKET_TAG_INTERNAL     1                                /* internal tags start here */
 #define HTC_TX_PACKET_TAG_USER_DEFINED (HTC_TX_PACKET_TAG_INTERNAL + 9) /* user-defined tags start here */
 
 typedef struct _HTC_RX_PACKET_INFO {
     A_UINT32    IndicationFlags;
+    A_UINT32    HTCRxFlags;     /* internal HTC use */
 } HTC_RX_PACKET_INFO;
 
 #define HTC_RX_FLAGS_INDICATE_MORE_PKTS  (1 << 0)
 
+/* internal HTCRxFlags */
+#define HTC_RX_PKT_PART_OF_BUNDLE        (1 << 0)  /* fetched as part of a recv bundle */
+#define HTC_RX_PKT_REFRESH_HDR           (1 << 1)  /* lookahead was not known, take it from the header */
+
 /* wrapper around endpoint-specific packets */
 typedef struct _HTC_PACKET {
     DL_LIST         ListLink;       /* double link */
@@ -128,6 +137,7 @@ typedef struct _HTC_PACKET {
     (p)->ActualLength = (len);                    \
     (p)->Endpoint = (ep);                         \
     (p)->PktInfo.AsTx.Tag = (tag);                \
+    (p)->PktInfo.AsTx.Flags = 0;                  \
 }
 
 /* HTC Packet Queueing Macros */
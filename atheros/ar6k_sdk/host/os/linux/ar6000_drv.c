@@ -57,6 +57,8 @@ A_TIMER dhcp_timer;
 
 #include <linux/fs.h>
 #include <linux/vmalloc.h>
+#include <linux/tcp.h>
+#include <net/ip.h>
 
 #ifdef ANDROID_ENV
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,27)
@@ -164,6 +166,7 @@ unsigned int fwmode = 1;
 unsigned int mbox_yield_limit = 99;
 int reduce_credit_dribble = 1 + HTC_CONNECT_FLAGS_THRESHOLD_LEVEL_ONE_HALF;
 int allow_trace_signal = 0;
+unsigned int irq_moderation = 20;   /* ms the HIF holds off the DSR while the screen is off */
 #ifdef CONFIG_HOST_TCMD_SUPPORT
 unsigned int testmode =0;
 #endif
@@ -188,6 +191,7 @@ module_param(mbox_yield_limit, int, 0644);
 module_param(reduce_credit_dribble, int, 0644);
 module_param(allow_trace_signal, int, 0644);
 module_param(processDot11Hdr, int, 0644);
+module_param(irq_moderation, int, 0644);
 /* ATHENV */
 #ifdef ANDROID_ENV
 module_param(work_mode, int, 0644);
@@ -231,6 +235,7 @@ MODULE_PARM(mbox_yield_limit,"i");
 MODULE_PARM(reduce_credit_dribble,"i");
 MODULE_PARM(allow_trace_signal,"i");
 MODULE_PARM(processDot11Hdr,"i");
+MODULE_PARM(irq_moderation,"i");
 #ifdef CONFIG_HOST_TCMD_SUPPORT
 MODULE_PARM(testmode, "i");
 #endif
@@ -386,8 +391,29 @@ static HTC_SEND_FULL_ACTION ar6000_tx_queue_full(void *Context, HTC_PACKET *pPac
 
 static void deliver_frames_to_nw_stack(struct sk_buff *skb);
 
+static void ar6000_rx_buf_free(AR_SOFTC_T *ar, struct sk_buff *skb);
+
+static void ar6000_rx_flush(AR_SOFTC_T *ar);
+
+#ifdef AR6000_RX_NAPI
+static int ar6000_rx_poll(struct napi_struct *napi, int budget);
+static void ar6000_rx_schedule(AR_SOFTC_T *ar);
+#endif
+
 static int checkforDHCPPacket(struct sk_buff *skb);
 static void dhcp_timer_handler(unsigned long ptr);
+static A_BOOL ar6000_is_tcp_ack(struct sk_buff *skb);
+
+static void ar6000_txq_init(AR_SOFTC_T *ar);
+static void ar6000_rps_init(struct net_device *dev);
+static void ar6000_txq_complete(AR_SOFTC_T *ar, struct ar_cookie *cookie, A_UINT8 ac);
+static A_BOOL ar6000_txq_below_limits(AR_SOFTC_T *ar);
+static void ar6000_wmi_cmd_init(AR_SOFTC_T *ar);
+static void ar6000_wmi_cmd_kick(AR_SOFTC_T *ar);
+static void ar6000_wmi_cmd_done(AR_SOFTC_T *ar, A_UINT32 count, A_STATUS status);
+static void ar6000_wmi_cmd_purge(AR_SOFTC_T *ar);
+static void ar6000_connect_assoc(AR_SOFTC_T *ar, A_UINT16 channel);
+static void ar6000_connect_lost(AR_SOFTC_T *ar, A_UINT8 reason);
 
 
 /*
@@ -876,14 +902,33 @@ static void ar6000_pwr_down(AR_SOFTC_T *ar)
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 
+static void ar6000_set_irq_moderation(A_UINT32 interval)
+{
+    AR_SOFTC_T *ar;
+
+    if (ar6000_devices[0] == NULL) {
+        return;
+    }
+
+    ar = (AR_SOFTC_T *)netdev_priv(ar6000_devices[0]);
+    if (ar->arHifDevice != NULL) {
+            /* optional for the HIF, nothing to do if it is not supported */
+        HIFConfigureDevice(ar->arHifDevice, HIF_DEVICE_SET_IRQ_MODERATION,
+                           &interval, sizeof(interval));
+    }
+}
+
 static void android_early_suspend(struct early_suspend *h)
 {
 	screen_is_off = 1;
+	/* nobody is looking, wake up once per batch of frames */
+	ar6000_set_irq_moderation(irq_moderation);
 }
 
 static void android_late_resume(struct early_suspend *h)
 {
 	screen_is_off = 0;
+	ar6000_set_irq_moderation(0);
 }
 
 #endif
@@ -1375,7 +1420,8 @@ static void firmware_transfer(HIF_DEVICE *device, char* filename, A_UINT32 addre
         }
     }
 
-    remaining = bufsize;
+    /* only the image itself, not the page padding of the buffer */
+    remaining = bmisize;
     src = fw_buf;
     while (remaining>0) {
         length = (remaining > MAX_BUF)? MAX_BUF : remaining;
@@ -2008,6 +2054,13 @@ ar6000_avail_ev(void *context, void *hif_handle)
 
     ar                       = (AR_SOFTC_T *)ar_netif;
     ar->arNetDev             = dev;
+    A_NETBUF_QUEUE_INIT(&ar->arRxBufPool);
+    A_NETBUF_QUEUE_INIT(&ar->arWmiCmdQueue);
+#ifdef AR6000_RX_NAPI
+    A_NETBUF_QUEUE_INIT(&ar->arRxNapiQueue);
+    netif_napi_add(dev, &ar->arNapi, ar6000_rx_poll, AR6000_RX_NAPI_WEIGHT);
+    dev->features |= NETIF_F_GRO;
+#endif
     ar->arHifDevice          = hif_handle;
     ar->arWlanState          = WLAN_ENABLED;
     ar->arDeviceIndex        = device_index;
@@ -2131,6 +2184,8 @@ ar6000_avail_ev(void *context, void *hif_handle)
                 return A_ERROR;
             }
 
+    ar6000_rps_init(dev);
+
     HIFClaimDevice(ar->arHifDevice, ar);
 
     /* We only register the device in the global list if we succeed. */
@@ -2283,6 +2338,7 @@ ar6000_stop_endpoint(struct net_device *dev, A_BOOL keepprofile)
         /* stop HTC */
         HTCStop(ar->arHtcTarget);
     }
+    ar6000_wmi_cmd_purge(ar);
 
     if (resetok) {
         /* try to reset the device if we can
@@ -2363,6 +2419,8 @@ ar6000_destroy(struct net_device *dev, unsigned int unregister)
        /* Done with cookies */
     ar6000_cookie_cleanup(ar);
 
+    ar6000_rx_flush(ar);
+
     /* Cleanup BMI */
     BMIInit();
 
@@ -2538,14 +2596,28 @@ ar6000_open(struct net_device *dev)
         netif_carrier_off(dev);
 
     spin_unlock_irqrestore(&ar->arLock, flags);
+
+#ifdef AR6000_RX_NAPI
+    napi_enable(&ar->arNapi);
+#endif
     return 0;
 }
 
 static int
 ar6000_close(struct net_device *dev)
 {
+    AR_SOFTC_T    *ar = (AR_SOFTC_T *)netdev_priv(dev);
+
     netif_stop_queue(dev);
 
+#ifdef AR6000_RX_NAPI
+    napi_disable(&ar->arNapi);
+        /* drop anything the poll did not get to */
+    while (!A_NETBUF_QUEUE_EMPTY(&ar->arRxNapiQueue)) {
+        A_NETBUF_FREE(A_NETBUF_DEQUEUE(&ar->arRxNapiQueue));
+    }
+#endif
+
     return 0;
 }
 
@@ -2808,6 +2880,8 @@ int ar6000_init(struct net_device *dev)
     /* Since cookies are used for HTC transports, they should be */
     /* initialized prior to enabling HTC.                        */
     ar6000_cookie_init(ar);
+    ar6000_txq_init(ar);
+    ar6000_wmi_cmd_init(ar);
 
     /* start HTC */
     status = HTCStart(ar->arHtcTarget);
@@ -2979,6 +3053,8 @@ ar6000_data_tx(struct sk_buff *skb, struct net_device *dev)
     int               len;
     struct ar_cookie *cookie;
     A_BOOL            checkAdHocPsMapping = FALSE,bMoreData = FALSE;
+    A_BOOL            fastAck = FALSE, stopNet = FALSE;
+    struct ar6000_txq *txq;
 #ifdef CONFIG_PM
     if (ar->arWowState) {
         A_NETBUF_FREE(skb);
@@ -3017,6 +3093,11 @@ ar6000_data_tx(struct sk_buff *skb, struct net_device *dev)
         return 0;
     }
 
+        /* look at the frame before the WMI headers go on */
+    if (ar->arWmiEnabled) {
+        fastAck = ar6000_is_tcp_ack(skb);
+    }
+
     do {
 
         if (ar->arWmiReady == FALSE && bypasswmi == 0) {
@@ -3215,12 +3296,34 @@ ar6000_data_tx(struct sk_buff *skb, struct net_device *dev)
                 /* update counts while the lock is held */
             ar->arTxPending[eid]++;
             ar->arTotalTxDataPending++;
+
+            txq = &ar->arTxq[arEndpoint2Ac(ar, eid)];
+            if (fastAck) {
+                    /* pure ACKs clock the peer's sender, they are not held
+                     * back by the limit and skip ahead of bulk data in HTC */
+                cookie->arc_txq_bytes = 0;
+                txq->stats.fastAcks++;
+            } else {
+                cookie->arc_txq_bytes = A_NETBUF_LEN(skb);
+                txq->inflight += cookie->arc_txq_bytes;
+                if ((txq->inflight >= txq->limit) && !ar->arNetQueueStopped) {
+                    ar->arNetQueueStopped = TRUE;
+                    txq->stats.limitStops++;
+                    stopNet = TRUE;
+                }
+            }
+            cookie->arc_txq_time = ktime_get();
         }
 
     } while (FALSE);
 
     AR6000_SPIN_UNLOCK(&ar->arLock, 0);
 
+    if (stopNet) {
+            /* the queue resumes in ar6000_tx_complete() */
+        netif_stop_queue(dev);
+    }
+
     if (cookie != NULL) {
         cookie->arc_bp[0] = (A_UINT32)skb;
         cookie->arc_bp[1] = mapNo;
@@ -3230,6 +3333,9 @@ ar6000_data_tx(struct sk_buff *skb, struct net_device *dev)
                                A_NETBUF_LEN(skb),
                                eid,
                                AR6K_DATA_PKT_TAG);
+        if (fastAck) {
+            cookie->HtcPkt.PktInfo.AsTx.Flags |= HTC_TX_PACKET_FLAG_EXPEDITE;
+        }
 
 #ifdef DEBUG
         if (debugdriver >= 3) {
@@ -3300,6 +3406,96 @@ applyAPTCHeuristics(AR_SOFTC_T *ar)
 }
 #endif /* ADAPTIVE_POWER_THROUGHPUT_CONTROL */
 
+/*
+ * Steer rx protocol work off CPU0, which takes the SDIO interrupt and
+ * runs the NAPI poll. User space can still change it through
+ * queues/rx-0/rps_cpus.
+ */
+static void
+ar6000_rps_init(struct net_device *dev)
+{
+    cpumask_var_t mask;
+
+    if (num_possible_cpus() < 2 || !alloc_cpumask_var(&mask, GFP_KERNEL)) {
+        return;
+    }
+
+    cpumask_andnot(mask, cpu_possible_mask, cpumask_of(0));
+    if (netif_set_rps_cpus(dev, 0, mask)) {
+        AR_DEBUG_PRINTF("ar6000_avail: couldn't set rps cpus\n");
+    }
+    free_cpumask_var(mask);
+}
+
+static void
+ar6000_txq_init(AR_SOFTC_T *ar)
+{
+    int i;
+
+    for (i = 0; i < WMM_NUM_AC; i++) {
+        A_MEMZERO(&ar->arTxq[i], sizeof(struct ar6000_txq));
+        ar->arTxq[i].limit = AR6000_TXQ_LIMIT_MIN * 2;
+        ar->arTxq[i].intervalEnd = jiffies + AR6000_TXQ_LIMIT_INTERVAL;
+    }
+}
+
+/* charge a completed frame back to its access category and adjust the
+ * limit once per interval, call with arLock held */
+static void
+ar6000_txq_complete(AR_SOFTC_T *ar, struct ar_cookie *cookie, A_UINT8 ac)
+{
+    struct ar6000_txq *txq = &ar->arTxq[ac];
+    A_UINT32           delay;
+
+    if (ktime_to_ns(cookie->arc_txq_time) == 0) {
+            /* control message issued on a data endpoint */
+        return;
+    }
+
+    delay = (A_UINT32)ktime_us_delta(ktime_get(), cookie->arc_txq_time);
+    txq->stats.avgDelayUs += (A_INT32)(delay - txq->stats.avgDelayUs) >> 3;
+    if (delay > txq->stats.maxDelayUs) {
+        txq->stats.maxDelayUs = delay;
+    }
+
+    txq->inflight -= cookie->arc_txq_bytes;
+    if (txq->inflight < txq->lowest) {
+        txq->lowest = txq->inflight;
+    }
+    if ((txq->inflight == 0) && ar->arNetQueueStopped) {
+            /* the target ran dry while the stack was held off */
+        txq->starved = TRUE;
+    }
+
+    if (time_after(jiffies, txq->intervalEnd)) {
+        if (txq->starved) {
+            txq->limit += txq->limit >> 1;
+        } else if (txq->lowest < txq->limit) {
+                /* bytes that sat in the queue the whole interval only add delay */
+            txq->limit -= txq->lowest;
+        }
+        txq->limit = max_t(A_UINT32, txq->limit, AR6000_TXQ_LIMIT_MIN);
+        txq->limit = min_t(A_UINT32, txq->limit, AR6000_TXQ_LIMIT_MAX);
+        txq->lowest = txq->inflight;
+        txq->starved = FALSE;
+        txq->intervalEnd = jiffies + AR6000_TXQ_LIMIT_INTERVAL;
+    }
+}
+
+static A_BOOL
+ar6000_txq_below_limits(AR_SOFTC_T *ar)
+{
+    int i;
+
+    for (i = 0; i < WMM_NUM_AC; i++) {
+        if (ar->arTxq[i].inflight >= ar->arTxq[i].limit) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 static HTC_SEND_FULL_ACTION ar6000_tx_queue_full(void *Context, HTC_PACKET *pPacket)
 {
     AR_SOFTC_T     *ar = (AR_SOFTC_T *)Context;
@@ -3337,6 +3533,11 @@ static HTC_SEND_FULL_ACTION ar6000_tx_queue_full(void *Context, HTC_PACKET *pPac
             break;
         }
 
+        if (pPacket->PktInfo.AsTx.Flags & HTC_TX_PACKET_FLAG_EXPEDITE) {
+            /* TCP ACKs are tiny and never charged to the byte limits, keep them */
+            break;
+        }
+
         if (ar->arNetworkType == ADHOC_NETWORK) {
             /* in adhoc mode, we cannot differentiate traffic priorities so there is no need to
              * continue, however we should stop the network */
@@ -3380,6 +3581,7 @@ ar6000_tx_complete(void *Context, HTC_PACKET *pPacket)
     struct ar_cookie * ar_cookie;
     HTC_ENDPOINT_ID   eid;
     A_BOOL          wakeEvent = FALSE;
+    A_BOOL          wakeNet;
 
     status = pPacket->Status;
     ar_cookie = (struct ar_cookie *)cookie;
@@ -3408,6 +3610,10 @@ ar6000_tx_complete(void *Context, HTC_PACKET *pPacket)
         ar->arTotalTxDataPending--;
     }
 
+    if (eid != ar->arControlEp) {
+        ar6000_txq_complete(ar, ar_cookie, arEndpoint2Ac(ar, eid));
+    }
+
     if (eid == ar->arControlEp)
     {
         if (ar->arWMIControlEpFull) {
@@ -3464,7 +3670,9 @@ ar6000_tx_complete(void *Context, HTC_PACKET *pPacket)
         ar6000_free_cookie(ar, cookie);
     }
 
-    if (ar->arNetQueueStopped) {
+    wakeNet = ar6000_txq_below_limits(ar);
+
+    if (ar->arNetQueueStopped && wakeNet) {
         ar->arNetQueueStopped = FALSE;
     }
 
@@ -3472,16 +3680,22 @@ ar6000_tx_complete(void *Context, HTC_PACKET *pPacket)
 
     /* lock is released, we can freely call other kernel APIs */
 
-    A_NETBUF_FREE(skb);
+        /* sent frames are the cheapest source of rx buffers */
+    ar6000_rx_buf_free(ar, skb);
 
     if ((ar->arConnected == TRUE) || (bypasswmi)) {
-        if (status != A_ECANCELED) {
+        if ((status != A_ECANCELED) && wakeNet) {
                 /* don't wake the queue if we are flushing, other wise it will just
                  * keep queueing packets, which will keep failing */
             netif_wake_queue(ar->arNetDev);
         }
     }
 
+    if (eid == ar->arControlEp) {
+        ar6000_wmi_cmd_kick(ar);
+        ar6000_wmi_cmd_done(ar, 1, status);
+    }
+
     if (wakeEvent) {
         wake_up(&arEvent);
     }
@@ -3539,6 +3753,9 @@ ar6000_rx(void *Context, HTC_PACKET *pPacket)
     int minHdrLen;
     A_STATUS        status = pPacket->Status;
     HTC_ENDPOINT_ID   ept = pPacket->Endpoint;
+        /* the packet lives in the skb headroom, it is gone once the skb is delivered */
+    A_BOOL          morePkts = (pPacket->PktInfo.AsRx.IndicationFlags &
+                                HTC_RX_FLAGS_INDICATE_MORE_PKTS) ? TRUE : FALSE;
 
     A_ASSERT((status != A_OK) ||
              (pPacket->pBuffer == (A_NETBUF_DATA(skb) + HTC_HEADER_LEN)));
@@ -3581,7 +3798,7 @@ ar6000_rx(void *Context, HTC_PACKET *pPacket)
     skb->dev = ar->arNetDev;
     if (status != A_OK) {
         AR6000_STAT_INC(ar, rx_errors);
-        A_NETBUF_FREE(skb);
+        ar6000_rx_buf_free(ar, skb);
     } else if (ar->arWmiEnabled == TRUE) {
         if (ept == ar->arControlEp) {
            /*
@@ -3619,7 +3836,7 @@ ar6000_rx(void *Context, HTC_PACKET *pPacket)
                     AR_DEBUG_PRINTF("TOO SHORT or TOO LONG\n");
                     AR6000_STAT_INC(ar, rx_errors);
                     AR6000_STAT_INC(ar, rx_length_errors);
-                    A_NETBUF_FREE(skb);
+                    ar6000_rx_buf_free(ar, skb);
                 } else {
 #if 0
                     /* Access RSSI values here */
@@ -3679,7 +3896,7 @@ ar6000_rx(void *Context, HTC_PACKET *pPacket)
                         /* Drop NULL data frames here */
                         if((pPacket->ActualLength < minHdrLen) ||
                                 (pPacket->ActualLength > AR6000_BUFFER_SIZE)) {
-                            A_NETBUF_FREE(skb);
+                            ar6000_rx_buf_free(ar, skb);
                             goto refill;
                         }
                     }
@@ -3725,7 +3942,7 @@ ar6000_rx(void *Context, HTC_PACKET *pPacket)
                                     skb1 = skb;
                                     skb = NULL;
                                 } else if(conn && !ar->intra_bss) {
-                                    A_NETBUF_FREE(skb);
+                                    ar6000_rx_buf_free(ar, skb);
                                     skb = NULL;
                                 }
                             }
@@ -3757,6 +3974,47 @@ refill:
          */
         ar6000_rx_refill(Context, ept);
     }
+
+#ifdef AR6000_RX_NAPI
+        /* HTC tells us when the next frame is already on its way, let the
+         * frames pile up and hand them over in one poll */
+    if (!morePkts ||
+        (A_NETBUF_QUEUE_SIZE(&ar->arRxNapiQueue) >= AR6000_RX_NAPI_WEIGHT)) {
+        ar6000_rx_schedule(ar);
+    }
+#endif
+}
+
+/* an IPv4 TCP segment that carries nothing but an ACK */
+static A_BOOL
+ar6000_is_tcp_ack(struct sk_buff *skb)
+{
+    ATH_MAC_HDR   *macHdr = (ATH_MAC_HDR *)A_NETBUF_DATA(skb);
+    struct iphdr  *ipHdr;
+    struct tcphdr *tcpHdr;
+    unsigned int   ipLen;
+
+    if ((skb_headlen(skb) < sizeof(ATH_MAC_HDR) + sizeof(struct iphdr)) ||
+        (macHdr->typeOrLen != htons(ETH_P_IP))) {
+        return FALSE;
+    }
+
+    ipHdr = (struct iphdr *)(macHdr + 1);
+    if ((ipHdr->protocol != IPPROTO_TCP) || (ipHdr->frag_off & htons(IP_MF | IP_OFFSET))) {
+        return FALSE;
+    }
+
+    ipLen = ipHdr->ihl * 4;
+    if (skb_headlen(skb) < sizeof(ATH_MAC_HDR) + ipLen + sizeof(struct tcphdr)) {
+        return FALSE;
+    }
+
+    tcpHdr = (struct tcphdr *)((A_UINT8 *)ipHdr + ipLen);
+    if (!tcpHdr->ack || tcpHdr->syn || tcpHdr->fin || tcpHdr->rst || tcpHdr->urg) {
+        return FALSE;
+    }
+
+    return (ntohs(ipHdr->tot_len) == ipLen + tcpHdr->doff * 4) ? TRUE : FALSE;
 }
 
 static int checkforDHCPPacket(struct sk_buff *skb) 
@@ -3787,6 +4045,9 @@ deliver_frames_to_nw_stack(struct sk_buff *skb)
             android_ar6k_check_wow_status((AR_SOFTC_T*)netdev_priv(skb->dev), skb, FALSE);
 #endif
             skb->protocol = eth_type_trans(skb, skb->dev);
+#ifdef AR6000_RX_NAPI
+            A_NETBUF_ENQUEUE(&((AR_SOFTC_T *)netdev_priv(skb->dev))->arRxNapiQueue, skb);
+#else
         /*
          * If this routine is called on a ISR (Hard IRQ) or DSR (Soft IRQ)
          * or tasklet use the netif_rx to deliver the packet to the stack
@@ -3802,10 +4063,80 @@ deliver_frames_to_nw_stack(struct sk_buff *skb)
             } else {
                 netif_rx_ni(skb);
             }
+#endif /* AR6000_RX_NAPI */
         } else {
-            A_NETBUF_FREE(skb);
+            ar6000_rx_buf_free((AR_SOFTC_T *)netdev_priv(skb->dev), skb);
+        }
+    }
+}
+
+#ifdef AR6000_RX_NAPI
+static void
+ar6000_rx_schedule(AR_SOFTC_T *ar)
+{
+    if (in_interrupt()) {
+        napi_schedule(&ar->arNapi);
+    } else {
+            /* HIF completions run in a thread, make the softirq run now
+             * rather than at the next interrupt */
+        local_bh_disable();
+        napi_schedule(&ar->arNapi);
+        local_bh_enable();
+    }
+}
+
+static int
+ar6000_rx_poll(struct napi_struct *napi, int budget)
+{
+    AR_SOFTC_T     *ar = container_of(napi, AR_SOFTC_T, arNapi);
+    struct sk_buff *skb;
+    int            work = 0;
+
+    while (work < budget) {
+        skb = A_NETBUF_DEQUEUE(&ar->arRxNapiQueue);
+        if (skb == NULL) {
+            break;
+        }
+        napi_gro_receive(napi, skb);
+        work++;
+    }
+
+    if (work < budget) {
+        napi_complete(napi);
+            /* a frame queued after the queue ran dry would wait for the next one */
+        if (!A_NETBUF_QUEUE_EMPTY(&ar->arRxNapiQueue)) {
+            napi_reschedule(napi);
         }
     }
+
+    return work;
+}
+#endif /* AR6000_RX_NAPI */
+
+/* free an skb the driver is done with, keeping it as an rx buffer if it fits */
+static void
+ar6000_rx_buf_free(AR_SOFTC_T *ar, struct sk_buff *skb)
+{
+    if ((A_NETBUF_QUEUE_SIZE(&ar->arRxBufPool) < AR6000_RX_POOL_MAX) &&
+        (A_NETBUF_RECYCLE(skb, AR6000_BUFFER_SIZE) != NULL)) {
+        A_NETBUF_ENQUEUE(&ar->arRxBufPool, skb);
+        return;
+    }
+
+    A_NETBUF_FREE(skb);
+}
+
+static void
+ar6000_rx_flush(AR_SOFTC_T *ar)
+{
+    while (!A_NETBUF_QUEUE_EMPTY(&ar->arRxBufPool)) {
+        A_NETBUF_FREE(A_NETBUF_DEQUEUE(&ar->arRxBufPool));
+    }
+#ifdef AR6000_RX_NAPI
+    while (!A_NETBUF_QUEUE_EMPTY(&ar->arRxNapiQueue)) {
+        A_NETBUF_FREE(A_NETBUF_DEQUEUE(&ar->arRxNapiQueue));
+    }
+#endif
 }
 
 
@@ -3830,7 +4161,10 @@ ar6000_rx_refill(void *Context, HTC_ENDPOINT_ID Endpoint)
                     buffersToRefill, Endpoint);
 
     for (RxBuffers = 0; RxBuffers < buffersToRefill; RxBuffers++) {
-        osBuf = A_NETBUF_ALLOC(AR6000_BUFFER_SIZE);
+        osBuf = A_NETBUF_DEQUEUE(&ar->arRxBufPool);
+        if (NULL == osBuf) {
+            osBuf = A_NETBUF_ALLOC(AR6000_BUFFER_SIZE);
+        }
         if (NULL == osBuf) {
             break;
         }
@@ -4157,6 +4491,8 @@ ar6000_connect_event(AR_SOFTC_T *ar, A_UINT16 channel, A_UINT8 *bssid,
     netif_carrier_on(ar->arNetDev);
     spin_unlock_irqrestore(&ar->arLock, flags);
 
+    ar6000_connect_assoc(ar, channel);
+
     reconnect_flag = 0;
 
     A_MEMZERO(&wrqu, sizeof(wrqu));
@@ -4286,6 +4622,8 @@ ar6000_disconnect_event(AR_SOFTC_T *ar, A_UINT8 reason, A_UINT8 *bssid,
 
     A_UNTIMEOUT(&ar->disconnect_timer);
 
+    ar6000_connect_lost(ar, reason);
+
     A_PRINTF("AR6000 disconnected");
     if (bssid[0] || bssid[1] || bssid[2] || bssid[3] || bssid[4] || bssid[5]) {
         A_PRINTF(" from %2.2x:%2.2x:%2.2x:%2.2x:%2.2x:%2.2x ",
@@ -4812,19 +5150,29 @@ ar6000_control_tx(void *devt, void *osbuf, HTC_ENDPOINT_ID eid)
         AR_DEBUG2_PRINTF("ar_contrstatus = ol_tx: skb=0x%x, len=0x%x eid =%d\n",
                          (A_UINT32)osbuf, A_NETBUF_LEN(osbuf), eid);
 
-        if (ar->arWMIControlEpFull && (eid == ar->arControlEp)) {
-                /* control endpoint is full, don't allocate resources, we
-                 * are just going to drop this packet */
+        if (eid == ar->arControlEp) {
+            int depth = A_NETBUF_QUEUE_SIZE(&ar->arWmiCmdQueue);
+
+            if (depth >= AR6000_WMI_CMD_QUEUE_MAX) {
+                AR_DEBUG_PRINTF(" WMI command queue full, dropping packet : 0x%X, len:%d \n",
+                        (A_UINT32)osbuf, A_NETBUF_LEN(osbuf));
+                status = A_NO_MEMORY;
+                break;
+            }
+            if (ar->arWMIControlEpFull || depth) {
+                ar->arConnStats.wmiCmdsDeferred++;
+            }
+            if (depth + 1 > ar->arConnStats.wmiQueueMax) {
+                ar->arConnStats.wmiQueueMax = depth + 1;
+            }
+                /* sent from ar6000_wmi_cmd_kick() so commands keep their order */
             cookie = NULL;
-            AR_DEBUG_PRINTF(" WMI Control EP full, dropping packet : 0x%X, len:%d \n",
-                    (A_UINT32)osbuf, A_NETBUF_LEN(osbuf));
         } else {
             cookie = ar6000_alloc_cookie(ar);
-        }
-
-        if (cookie == NULL) {
-            status = A_NO_MEMORY;
-            break;
+            if (cookie == NULL) {
+                status = A_NO_MEMORY;
+                break;
+            }
         }
 
         if(logWmiRawMsgs) {
@@ -4836,6 +5184,12 @@ ar6000_control_tx(void *devt, void *osbuf, HTC_ENDPOINT_ID eid)
 
         wmiSendCmdNum++;
 
+        if (eid == ar->arControlEp) {
+            ar->arTxPending[eid]++;
+            ar->arWmiCmdSeq++;
+            A_NETBUF_ENQUEUE(&ar->arWmiCmdQueue, osbuf);
+        }
+
     } while (FALSE);
 
     if (cookie != NULL) {
@@ -4866,10 +5220,151 @@ ar6000_control_tx(void *devt, void *osbuf, HTC_ENDPOINT_ID eid)
 
     if (status != A_OK) {
         A_NETBUF_FREE(osbuf);
+    } else if (eid == ar->arControlEp) {
+        ar6000_wmi_cmd_kick(ar);
     }
     return status;
 }
 
+static void
+ar6000_wmi_cmd_init(AR_SOFTC_T *ar)
+{
+    ar->arWmiCmdSending = FALSE;
+    ar->arWmiCmdSeq = 0;
+    ar->arWmiCmdDone = 0;
+    A_MEMZERO(ar->arWmiBarrier, sizeof(ar->arWmiBarrier));
+}
+
+/* hand queued control commands to HTC while the endpoint takes them */
+static void
+ar6000_wmi_cmd_kick(AR_SOFTC_T *ar)
+{
+    struct ar_cookie *cookie;
+    void             *osbuf;
+
+    AR6000_SPIN_LOCK(&ar->arLock, 0);
+
+    if (ar->arWmiCmdSending) {
+            /* whoever is sending picks up what we queued */
+        AR6000_SPIN_UNLOCK(&ar->arLock, 0);
+        return;
+    }
+    ar->arWmiCmdSending = TRUE;
+
+    while ((ar->arWmiEnabled == TRUE) && !ar->arWMIControlEpFull &&
+           !A_NETBUF_QUEUE_EMPTY(&ar->arWmiCmdQueue)) {
+        cookie = ar6000_alloc_cookie(ar);
+        if (cookie == NULL) {
+                /* the next tx completion frees one and kicks again */
+            break;
+        }
+        osbuf = A_NETBUF_DEQUEUE(&ar->arWmiCmdQueue);
+        AR6000_SPIN_UNLOCK(&ar->arLock, 0);
+
+        cookie->arc_bp[0] = (A_UINT32)osbuf;
+        cookie->arc_bp[1] = 0;
+        SET_HTC_PACKET_INFO_TX(&cookie->HtcPkt,
+                               cookie,
+                               A_NETBUF_DATA(osbuf),
+                               A_NETBUF_LEN(osbuf),
+                               ar->arControlEp,
+                               AR6K_CONTROL_PKT_TAG);
+        HTCSendPkt(ar->arHtcTarget, &cookie->HtcPkt);
+
+        AR6000_SPIN_LOCK(&ar->arLock, 0);
+    }
+
+    ar->arWmiCmdSending = FALSE;
+    AR6000_SPIN_UNLOCK(&ar->arLock, 0);
+}
+
+/* account for finished control commands and run the barriers they release */
+static void
+ar6000_wmi_cmd_done(AR_SOFTC_T *ar, A_UINT32 count, A_STATUS status)
+{
+    struct ar6000_wmi_barrier ready[AR6000_WMI_BARRIERS];
+    struct ar6000_wmi_barrier *barrier;
+    int i, num = 0;
+
+    AR6000_SPIN_LOCK(&ar->arLock, 0);
+    ar->arWmiCmdDone += count;
+    for (i = 0; i < AR6000_WMI_BARRIERS; i++) {
+        barrier = &ar->arWmiBarrier[i];
+        if (barrier->cb == NULL) {
+            continue;
+        }
+        if (A_FAILED(status)) {
+            barrier->failed = TRUE;
+        }
+        if ((A_INT32)(ar->arWmiCmdDone - barrier->seq) >= 0) {
+            ready[num++] = *barrier;
+            barrier->cb = NULL;
+        }
+    }
+    AR6000_SPIN_UNLOCK(&ar->arLock, 0);
+
+    for (i = 0; i < num; i++) {
+        ready[i].cb(ar, ready[i].failed ? A_ERROR : A_OK, ready[i].context);
+    }
+}
+
+/* HTC is stopped, whatever is still queued will never be sent */
+static void
+ar6000_wmi_cmd_purge(AR_SOFTC_T *ar)
+{
+    A_UINT32 count = 0;
+    void     *osbuf;
+
+    while ((osbuf = A_NETBUF_DEQUEUE(&ar->arWmiCmdQueue)) != NULL) {
+        A_NETBUF_FREE(osbuf);
+        count++;
+    }
+
+    if (count) {
+        AR6000_SPIN_LOCK(&ar->arLock, 0);
+        ar->arTxPending[ar->arControlEp] -= count;
+        AR6000_SPIN_UNLOCK(&ar->arLock, 0);
+        wake_up(&arEvent);
+    }
+    ar6000_wmi_cmd_done(ar, count, count ? A_ECANCELED : A_OK);
+}
+
+/*
+ * Run cb once every WMI command submitted so far has been handed to the
+ * target, with A_ERROR if any of them failed. cb is called from the tx
+ * completion path and must not sleep, or right away when nothing is
+ * outstanding.
+ */
+A_STATUS
+ar6000_wmi_cmd_barrier(AR_SOFTC_T *ar, AR6000_WMI_DONE_CB cb, void *context)
+{
+    struct ar6000_wmi_barrier *barrier;
+    int i;
+
+    AR6000_SPIN_LOCK(&ar->arLock, 0);
+
+    if (ar->arWmiCmdDone == ar->arWmiCmdSeq) {
+        AR6000_SPIN_UNLOCK(&ar->arLock, 0);
+        cb(ar, A_OK, context);
+        return A_OK;
+    }
+
+    for (i = 0; i < AR6000_WMI_BARRIERS; i++) {
+        barrier = &ar->arWmiBarrier[i];
+        if (barrier->cb == NULL) {
+            barrier->seq = ar->arWmiCmdSeq;
+            barrier->failed = FALSE;
+            barrier->cb = cb;
+            barrier->context = context;
+            AR6000_SPIN_UNLOCK(&ar->arLock, 0);
+            return A_OK;
+        }
+    }
+
+    AR6000_SPIN_UNLOCK(&ar->arLock, 0);
+    return A_NO_RESOURCE;
+}
+
 /* indicate tx activity or inactivity on a WMI stream */
 void ar6000_indicate_tx_activity(void *devt, A_UINT8 TrafficClass, A_BOOL Active)
 {
@@ -4975,6 +5470,8 @@ ar6000_alloc_cookie(AR_SOFTC_T  *ar)
     if(cookie != NULL)
     {
         ar->arCookieList = cookie->arc_list_next;
+        cookie->arc_txq_bytes = 0;
+        cookie->arc_txq_time = ktime_set(0, 0);
     }
 
     return cookie;
@@ -5445,6 +5942,128 @@ skip_key:
     return 0;
 }
 
+static struct ar6000_conn_cache *
+ar6000_conn_cache_find(AR_SOFTC_T *ar)
+{
+    struct ar6000_conn_cache *entry;
+    int i;
+
+    for (i = 0; i < AR6000_CONN_CACHE_SIZE; i++) {
+        entry = &ar->arConnCache[i];
+        if (entry->ssidLen && (entry->ssidLen == ar->arSsidLen) &&
+            (A_MEMCMP(entry->ssid, ar->arSsid, ar->arSsidLen) == 0)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void
+ar6000_conn_cache_update(AR_SOFTC_T *ar, A_UINT16 channel)
+{
+    struct ar6000_conn_cache *entry = ar6000_conn_cache_find(ar);
+    int i;
+
+    if (entry == NULL) {
+            /* take a free slot, or the one joined longest ago */
+        entry = &ar->arConnCache[0];
+        for (i = 0; i < AR6000_CONN_CACHE_SIZE; i++) {
+            if (ar->arConnCache[i].ssidLen == 0) {
+                entry = &ar->arConnCache[i];
+                break;
+            }
+            if (time_before(ar->arConnCache[i].lastUsed, entry->lastUsed)) {
+                entry = &ar->arConnCache[i];
+            }
+        }
+        A_MEMCPY(entry->ssid, ar->arSsid, ar->arSsidLen);
+        entry->ssidLen = ar->arSsidLen;
+    }
+    entry->channel = channel;
+    entry->lastUsed = jiffies;
+}
+
+static void
+ar6000_connect_cmd_sent(AR_SOFTC_T *ar, A_STATUS status, void *context)
+{
+        /* a later connect restarted the timing */
+    if (((unsigned long)context != ar->arConnStats.connects) ||
+        (ktime_to_ns(ar->arConnStart) == 0)) {
+        return;
+    }
+    ar->arConnStats.cmdSentUs = (A_UINT32)ktime_us_delta(ktime_get(), ar->arConnStart);
+}
+
+static void
+ar6000_connect_report(AR_SOFTC_T *ar)
+{
+    struct ar6000_connect_stats *stats = &ar->arConnStats;
+
+    AR_DEBUG_PRINTF("AR6000 connect took %u us: commands %u us, assoc %u us%s\n",
+                    stats->keysUs, stats->cmdSentUs, stats->assocUs,
+                    ar->arConnHinted ? " (cached channel)" : "");
+    ar->arConnHinted = FALSE;
+    ar->arConnStart = ktime_set(0, 0);
+}
+
+/* link is up, remember where the network was found and time the connect */
+static void
+ar6000_connect_assoc(AR_SOFTC_T *ar, A_UINT16 channel)
+{
+    if (ar->arNetworkType == INFRA_NETWORK) {
+        ar6000_conn_cache_update(ar, channel);
+    }
+
+    if (ktime_to_ns(ar->arConnStart) == 0) {
+            /* roaming, not a connect requested by the host */
+        return;
+    }
+
+    ar->arConnStats.assocUs = (A_UINT32)ktime_us_delta(ktime_get(), ar->arConnStart);
+    if (ar->arAuthMode == NONE_AUTH) {
+        ar->arConnStats.keysUs = ar->arConnStats.assocUs;
+        ar6000_connect_report(ar);
+    } else {
+            /* the port opens when the supplicant installs the group key */
+        ar->arConnKeysPending = TRUE;
+    }
+}
+
+void
+ar6000_connect_keys_installed(AR_SOFTC_T *ar)
+{
+    if (!ar->arConnKeysPending) {
+        return;
+    }
+    ar->arConnKeysPending = FALSE;
+    ar->arConnStats.keysUs = (A_UINT32)ktime_us_delta(ktime_get(), ar->arConnStart);
+    ar6000_connect_report(ar);
+}
+
+static void
+ar6000_connect_lost(AR_SOFTC_T *ar, A_UINT8 reason)
+{
+    struct ar6000_conn_cache *entry;
+
+    ar->arConnKeysPending = FALSE;
+
+    if (ar->arConnHinted && !ar->arConnected && (reason != DISCONNECT_CMD)) {
+            /* the network is no longer where we last saw it */
+        entry = ar6000_conn_cache_find(ar);
+        if (entry != NULL) {
+            entry->ssidLen = 0;
+        }
+        ar->arConnStats.hintMisses++;
+        ar->arConnHinted = FALSE;
+    }
+
+    if (ar->arConnected || (reason == DISCONNECT_CMD)) {
+            /* the target keeps retrying a failed connect, anything else ends it */
+        ar->arConnHinted = FALSE;
+        ar->arConnStart = ktime_set(0, 0);
+    }
+}
+
 A_STATUS
 ar6000_connect_to_ap(struct ar6_softc *ar)
 {
@@ -5454,6 +6073,8 @@ ar6000_connect_to_ap(struct ar6_softc *ar)
     if((ar->arWmiReady == TRUE) && (ar->arSsidLen > 0) && ar->arNetworkType!=AP_NETWORK)
     {
         A_STATUS status; 
+        A_UINT16 channelHint = ar->arChannelHint;
+        struct ar6000_conn_cache *entry;
         if((ADHOC_NETWORK != ar->arNetworkType) &&
            (NONE_AUTH==ar->arAuthMode)          &&
            (WEP_CRYPT==ar->arPairwiseCrypto)) {
@@ -5474,22 +6095,46 @@ ar6000_connect_to_ap(struct ar6_softc *ar)
             wmi_listeninterval_cmd(ar->arWmi, 1000, 0);
         }
         
+        /* A network joined before is probed on its last channel first,
+           so a reconnect after resume does not wait for a full scan */
+        ar->arConnHinted = FALSE;
+        if ((channelHint == 0) && (ar->arNetworkType == INFRA_NETWORK) &&
+            IS_MAC_NULL(ar->arReqBssid)) {
+            entry = ar6000_conn_cache_find(ar);
+            if (entry != NULL) {
+                channelHint = entry->channel;
+                ar->arConnHinted = TRUE;
+                ar->arConnStats.hintedConnects++;
+            }
+        }
+
         ar->arConnectPending = TRUE;
+        ar->arConnKeysPending = FALSE;
+        ar->arConnStats.connects++;
+        ar->arConnStats.cmdSentUs = 0;
+        ar->arConnStats.assocUs = 0;
+        ar->arConnStats.keysUs = 0;
+        ar->arConnStart = ktime_get();
 
         status = wmi_connect_cmd(ar->arWmi, ar->arNetworkType,
                                  ar->arDot11AuthMode, ar->arAuthMode,
                                  ar->arPairwiseCrypto, ar->arPairwiseCryptoLen,
                                  ar->arGroupCrypto,ar->arGroupCryptoLen,
                                  ar->arSsidLen, ar->arSsid,
-                                 ar->arReqBssid, ar->arChannelHint,
+                                 ar->arReqBssid, channelHint,
                                  ar->arConnectCtrlFlags | CONNECT_IGNORE_WPAx_GROUP_CIPHER);
 
         if (status != A_OK) {
             wmi_listeninterval_cmd(ar->arWmi, ar->arListenInterval, 0);
             ar->arConnectPending = FALSE;
+            ar->arConnHinted = FALSE;
+            ar->arConnStart = ktime_set(0, 0);
             return status;
         }
 
+        ar6000_wmi_cmd_barrier(ar, ar6000_connect_cmd_sent,
+                               (void *)(unsigned long)ar->arConnStats.connects);
+
         ar->arPrevCrypto = ar->arPairwiseCrypto;
         
         return status;    
@@ -49,6 +49,15 @@
 static A_UINT32 sys_sleep_reg;
 static HIF_DEVICE *p_bmi_device;
 
+/*
+ * Board data as read from the EEPROM.  Reading it takes a few hundred
+ * BMI register accesses, and it does not change while the driver stays
+ * loaded, so later wifi on cycles reuse this copy.  The MAC address and
+ * region code patches are applied again on each transfer.
+ */
+static A_UCHAR eeprom_cache[EEPROM_SZ];
+static A_BOOL eeprom_cache_valid = FALSE;
+
 /* */
 /* Functions */
 /* */
@@ -541,13 +550,16 @@ void eeprom_ar6000_transfer(HIF_DEVICE *device, char *fake_file, char *p_mac, in
     A_UINT32 board_data_addr;
     int i;
     int is_read_eeprom_from_file = 0;
+    A_BOOL use_SI = (!fake_file && !eeprom_cache_valid);
     A_UCHAR eeprom_data[EEPROM_SZ];
     unsigned char soft_mac_addr[ATH_MAC_LEN];
 
 
     AR_DEBUG_PRINTF("%s: Enter\n", __FUNCTION__);
 
-    enable_SI(device);
+    p_bmi_device = device;
+    if (use_SI)
+        enable_SI(device);
 
     if (fake_file) {
         if ( read_eeprom_from_file(fake_file, eeprom_data) == 0 ) /* success */
@@ -558,7 +570,9 @@ void eeprom_ar6000_transfer(HIF_DEVICE *device, char *fake_file, char *p_mac, in
         }
     }
 
-    if (!is_read_eeprom_from_file) {
+    if (!is_read_eeprom_from_file && eeprom_cache_valid) {
+        memcpy(eeprom_data, eeprom_cache, EEPROM_SZ);
+    } else if (!is_read_eeprom_from_file) {
 
         /*
          * Read from EEPROM to file OR transfer from EEPROM to Target RAM.
@@ -578,6 +592,11 @@ void eeprom_ar6000_transfer(HIF_DEVICE *device, char *fake_file, char *p_mac, in
         for (i = 8; i < EEPROM_SZ; i += 8) {
             fetch_8bytes(i, (A_UINT32 *)(&eeprom_data[i]));
         }
+
+        if ((first_word != 0) && (first_word != 0xffffffff)) {
+            memcpy(eeprom_cache, eeprom_data, EEPROM_SZ);
+            eeprom_cache_valid = TRUE;
+        }
     }
 
     if (p_mac) {
@@ -628,7 +647,8 @@ void eeprom_ar6000_transfer(HIF_DEVICE *device, char *fake_file, char *p_mac, in
                      (A_UINT8 *)&one, sizeof(A_UINT32));
     }
 
-    disable_SI();
+    if (use_SI)
+        disable_SI();
 }
 #endif /* ANDROID_ENV */
 /* ATHENV */
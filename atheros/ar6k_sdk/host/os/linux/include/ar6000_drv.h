@@ -138,6 +138,17 @@ extern "C" {
 #define MAX_AR6000                        1
 #define AR6000_MAX_RX_BUFFERS             16
 #define AR6000_BUFFER_SIZE                1664
+#define AR6000_RX_POOL_MAX                (AR6000_MAX_RX_BUFFERS * 2) /* recycled rx buffers kept */
+#define AR6000_RX_NAPI_WEIGHT             32
+#define AR6000_TXQ_LIMIT_MIN              (4 * AR6000_BUFFER_SIZE)  /* per AC tx byte limits */
+#define AR6000_TXQ_LIMIT_MAX              (32 * AR6000_BUFFER_SIZE)
+#define AR6000_TXQ_LIMIT_INTERVAL         (HZ / 50)                 /* limit adjust period */
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,29)
+/* received frames are handed to the stack from a NAPI poll instead of one
+ * netif_rx() per frame from the HIF completion context */
+#define AR6000_RX_NAPI
+#endif
 #define AR6000_TX_TIMEOUT                 10
 #define AR6000_ETH_ADDR_LEN               6
 #define AR6000_MAX_ENDPOINTS              4
@@ -202,6 +213,50 @@ struct ar_cookie {
     A_UINT32               arc_bp[2];    /* Must be first field */
     HTC_PACKET             HtcPkt;       /* HTC packet wrapper */
     struct ar_cookie *arc_list_next;
+    A_UINT32               arc_txq_bytes; /* bytes charged to the AC limit */
+    ktime_t                arc_txq_time;  /* data frames only, zero otherwise */
+};
+
+/*
+ * Byte limit on the data handed to HTC for one access category. Frames
+ * queued in HTC are out of reach of the stack's qdisc, so the limit is
+ * kept close to what the target drains in one adjust interval: it grows
+ * when the queue ran dry while the stack was held off and shrinks by the
+ * slack when it never did.
+ */
+struct ar6000_txq {
+    A_UINT32                inflight;
+    A_UINT32                limit;
+    A_UINT32                lowest;      /* lowest inflight this interval */
+    A_BOOL                  starved;
+    unsigned long           intervalEnd;
+    struct ar6000_txq_ac_stats stats;
+};
+
+/*
+ * WMI commands are never dropped when the control endpoint is full, they
+ * wait on arWmiCmdQueue and go out in order as earlier ones complete. A
+ * barrier runs its callback once every command submitted before it has
+ * been handed to the target.
+ */
+#define AR6000_WMI_CMD_QUEUE_MAX    64
+#define AR6000_WMI_BARRIERS         4
+
+struct ar6000_wmi_barrier {
+    A_UINT32                seq;
+    A_BOOL                  failed;
+    AR6000_WMI_DONE_CB      cb;
+    void                    *context;
+};
+
+/* last channel each recently joined network was found on */
+#define AR6000_CONN_CACHE_SIZE      4
+
+struct ar6000_conn_cache {
+    A_UINT8                 ssid[32];
+    A_UINT8                 ssidLen;
+    A_UINT16                channel;
+    unsigned long           lastUsed;
 };
 
 struct ar_hb_chlng_resp {
@@ -254,6 +309,11 @@ typedef struct ar6_softc {
     spinlock_t              arLock;
     struct semaphore        arSem;
     int                     arRxBuffers[ENDPOINT_MAX];
+    A_NETBUF_QUEUE_T        arRxBufPool;    /* recycled rx buffers for the refill path */
+#ifdef AR6000_RX_NAPI
+    struct napi_struct      arNapi;
+    A_NETBUF_QUEUE_T        arRxNapiQueue;  /* frames waiting for the poll */
+#endif
     int                     arSsidLen;
     u_char                  arSsid[32];
     A_UINT8                 arNextMode;
@@ -330,10 +390,21 @@ typedef struct ar6_softc {
     A_BOOL                  read_buffer_available[HTC_RAW_STREAM_NUM_MAX];
 #endif
     A_BOOL                  arNetQueueStopped;
+    struct ar6000_txq       arTxq[WMM_NUM_AC];
     A_BOOL                  arRawIfInit;
     int                     arDeviceIndex;
     COMMON_CREDIT_STATE_INFO arCreditStateInfo;
     A_BOOL                  arWMIControlEpFull;
+    A_NETBUF_QUEUE_T        arWmiCmdQueue;   /* control commands not yet given to HTC */
+    A_BOOL                  arWmiCmdSending;
+    A_UINT32                arWmiCmdSeq;     /* control commands submitted */
+    A_UINT32                arWmiCmdDone;    /* ... completed, failed or purged */
+    struct ar6000_wmi_barrier arWmiBarrier[AR6000_WMI_BARRIERS];
+    struct ar6000_conn_cache arConnCache[AR6000_CONN_CACHE_SIZE];
+    A_BOOL                  arConnHinted;    /* pending connect uses a cached channel */
+    A_BOOL                  arConnKeysPending;
+    ktime_t                 arConnStart;     /* zero when no connect is being timed */
+    struct ar6000_connect_stats arConnStats;
     A_BOOL                  dbgLogFetchInProgress;
     A_UCHAR                 log_buffer[DBGLOG_HOST_LOG_BUFFER_SIZE];
     A_UINT32                log_cnt;
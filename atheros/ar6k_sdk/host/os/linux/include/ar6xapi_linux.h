@@ -151,6 +151,9 @@ void ar6000_dtimexpiry_event(struct ar6_softc *ar);
 
 A_STATUS ar6000_connect_to_ap(struct ar6_softc *ar);
 A_STATUS ar6000_set_wlan_state(struct ar6_softc *ar, AR6000_WLAN_STATE state);
+typedef void (*AR6000_WMI_DONE_CB)(struct ar6_softc *ar, A_STATUS status, void *context);
+A_STATUS ar6000_wmi_cmd_barrier(struct ar6_softc *ar, AR6000_WMI_DONE_CB cb, void *context);
+void ar6000_connect_keys_installed(struct ar6_softc *ar);
 #ifdef __cplusplus
 }
 #endif
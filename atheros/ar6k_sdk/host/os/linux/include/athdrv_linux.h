@@ -914,6 +914,30 @@ typedef enum {
 
 #define AR6000_XIOCTL_TCMD_GET_MAC                  120
 
+#define AR6000_XIOCTL_GET_HTC_BUNDLE_STATS          121
+/*
+ * arguments:
+ *   UINT32 cmd (AR6000_XIOCTL_GET_HTC_BUNDLE_STATS)
+ *   UINT32 clear (0 to only sample, otherwise sample and clear)
+ *   HTC_BUNDLE_STATS stats (returned, overwrites clear)
+ */
+
+#define AR6000_XIOCTL_GET_TX_QUEUE_STATS            122
+/*
+ * arguments:
+ *   UINT32 cmd (AR6000_XIOCTL_GET_TX_QUEUE_STATS)
+ *   UINT32 clear (0 to only sample, otherwise also clear the delay stats)
+ *   struct ar6000_txq_stats stats (returned, overwrites clear)
+ */
+
+#define AR6000_XIOCTL_GET_CONNECT_STATS             123
+/*
+ * arguments:
+ *   UINT32 cmd (AR6000_XIOCTL_GET_CONNECT_STATS)
+ *   UINT32 clear (0 to only sample, otherwise also clear the counters)
+ *   struct ar6000_connect_stats stats (returned, overwrites clear)
+ */
+
 /* used by AR6000_IOCTL_WMI_GETREV */
 struct ar6000_version {
     A_UINT32        host_ver;
@@ -1089,6 +1113,32 @@ struct ar6000_traffic_activity_change {
     A_UINT32    Active;     /* active (1) or inactive (0) */
 };
 
+/* Used with AR6000_XIOCTL_GET_TX_QUEUE_STATS, one entry per WMM access category */
+struct ar6000_txq_ac_stats {
+    A_UINT32    limitBytes;     /* current byte limit for frames queued to HTC */
+    A_UINT32    inflightBytes;  /* bytes queued to HTC and not completed */
+    A_UINT32    avgDelayUs;     /* moving average of queue to completion time */
+    A_UINT32    maxDelayUs;
+    A_UINT32    limitStops;     /* times the limit stopped the network queue */
+    A_UINT32    fastAcks;       /* TCP ACKs sent ahead of bulk data */
+};
+
+struct ar6000_txq_stats {
+    struct ar6000_txq_ac_stats ac[4];  /* indexed by WMM_AC_BE .. WMM_AC_VO */
+};
+
+/* Used with AR6000_XIOCTL_GET_CONNECT_STATS, phase times are for the last connect */
+struct ar6000_connect_stats {
+    A_UINT32    connects;        /* connect commands issued by the host */
+    A_UINT32    hintedConnects;  /* connects probing the cached channel first */
+    A_UINT32    hintMisses;      /* hinted connects that failed, entry dropped */
+    A_UINT32    cmdSentUs;       /* connect issued to commands taken by the target */
+    A_UINT32    assocUs;         /* connect issued to connect event */
+    A_UINT32    keysUs;          /* connect issued to group key installed */
+    A_UINT32    wmiCmdsDeferred; /* commands held while the control endpoint was busy */
+    A_UINT32    wmiQueueMax;     /* most commands held at once */
+};
+
 /* Used with AR6000_XIOCTL_PROF_COUNT_GET */
 struct prof_count_s {
     A_UINT32    addr;       /* bin start address */
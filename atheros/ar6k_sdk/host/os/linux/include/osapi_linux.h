@@ -224,6 +224,8 @@ typedef struct sk_buff_head A_NETBUF_QUEUE_T;
     a_netbuf_alloc(size)
 #define A_NETBUF_ALLOC_RAW(size) \
     a_netbuf_alloc_raw(size)
+#define A_NETBUF_RECYCLE(bufPtr, size) \
+    a_netbuf_recycle(bufPtr, size)
 #define A_NETBUF_FREE(bufPtr) \
     a_netbuf_free(bufPtr)
 #define A_NETBUF_DATA(bufPtr) \
@@ -272,6 +274,7 @@ typedef struct sk_buff_head A_NETBUF_QUEUE_T;
  */
 void *a_netbuf_alloc(int size);
 void *a_netbuf_alloc_raw(int size);
+void *a_netbuf_recycle(void *bufPtr, int size);
 void a_netbuf_free(void *bufPtr);
 void *a_netbuf_to_data(void *bufPtr);
 A_UINT32 a_netbuf_to_len(void *bufPtr);
@@ -249,6 +249,10 @@ A_UINT8 xioctl_filter[] = {
 (AP_NETWORK),                                   /* AR6000_XIOCTL_AP_GET_DTIM                       117  */
 (AP_NETWORK | ADHOC_NETWORK),                   /* AR6000_XIOCTL_AP_GET_BINTVL                     118  */
 (0xFF),                                         /* AR6000_XIOCTL_AP_GET_RTS                        119  */
+(0xFF),                                         /* AR6000_XIOCTL_TCMD_GET_MAC                      120  */
+(0xFF),                                         /* AR6000_XIOCTL_GET_HTC_BUNDLE_STATS              121  */
+(0xFF),                                         /* AR6000_XIOCTL_GET_TX_QUEUE_STATS                122  */
+(0xFF),                                         /* AR6000_XIOCTL_GET_CONNECT_STATS                 123  */
 };
 
 #endif /*_WMI_FILTER_LINUX_H_*/
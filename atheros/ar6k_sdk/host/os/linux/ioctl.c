@@ -1338,6 +1338,9 @@ ar6000_ioctl_setkey(AR_SOFTC_T *ar, struct ieee80211req_key *ik)
         if (status != A_OK) {
             return -EIO;
         }
+        if (keyUsage & GROUP_USAGE) {
+            ar6000_connect_keys_installed(ar);
+        }
     } else {
         status = wmi_add_krk_cmd(ar->arWmi, ik->ik_keydata);
     }
@@ -3209,6 +3212,76 @@ int ar6000_ioctl(struct net_device *dev, struct ifreq *rq, int cmd)
                 HTCDumpCreditStates(ar->arHtcTarget);
             }
             break;
+        case AR6000_XIOCTL_GET_HTC_BUNDLE_STATS:
+            if (ar->arHtcTarget != NULL) {
+                HTC_BUNDLE_STATS stats;
+                A_UINT32 clear;
+
+                if (get_user(clear, (A_UINT32 *)userdata)) {
+                    ret = -EFAULT;
+                    break;
+                }
+
+                HTCGetBundleStatistics(ar->arHtcTarget,
+                                       clear ? HTC_EP_STAT_SAMPLE_AND_CLEAR : HTC_EP_STAT_SAMPLE,
+                                       &stats);
+
+                if (copy_to_user(userdata, &stats, sizeof(stats))) {
+                    ret = -EFAULT;
+                }
+            } else {
+                ret = -EIO;
+            }
+            break;
+        case AR6000_XIOCTL_GET_TX_QUEUE_STATS:
+        {
+            struct ar6000_txq_stats stats;
+            A_UINT32 clear;
+            int i;
+
+            if (get_user(clear, (A_UINT32 *)userdata)) {
+                ret = -EFAULT;
+                break;
+            }
+
+            AR6000_SPIN_LOCK(&ar->arLock, 0);
+            for (i = 0; i < WMM_NUM_AC; i++) {
+                stats.ac[i] = ar->arTxq[i].stats;
+                stats.ac[i].limitBytes = ar->arTxq[i].limit;
+                stats.ac[i].inflightBytes = ar->arTxq[i].inflight;
+                if (clear) {
+                    A_MEMZERO(&ar->arTxq[i].stats, sizeof(ar->arTxq[i].stats));
+                }
+            }
+            AR6000_SPIN_UNLOCK(&ar->arLock, 0);
+
+            if (copy_to_user(userdata, &stats, sizeof(stats))) {
+                ret = -EFAULT;
+            }
+            break;
+        }
+        case AR6000_XIOCTL_GET_CONNECT_STATS:
+        {
+            struct ar6000_connect_stats stats;
+            A_UINT32 clear;
+
+            if (get_user(clear, (A_UINT32 *)userdata)) {
+                ret = -EFAULT;
+                break;
+            }
+
+            AR6000_SPIN_LOCK(&ar->arLock, 0);
+            stats = ar->arConnStats;
+            if (clear) {
+                A_MEMZERO(&ar->arConnStats, sizeof(ar->arConnStats));
+            }
+            AR6000_SPIN_UNLOCK(&ar->arLock, 0);
+
+            if (copy_to_user(userdata, &stats, sizeof(stats))) {
+                ret = -EFAULT;
+            }
+            break;
+        }
         case AR6000_XIOCTL_TRAFFIC_ACTIVITY_CHANGE:
             if (ar->arHtcTarget != NULL) {
                 struct ar6000_traffic_activity_change data;
@@ -62,6 +62,25 @@ a_netbuf_alloc(int size)
 {
     struct sk_buff *skb;
     skb = dev_alloc_skb(AR6000_DATA_OFFSET + sizeof(HTC_PACKET) + size);
+    if (skb != NULL) {
+        skb_reserve(skb, AR6000_DATA_OFFSET + sizeof(HTC_PACKET));
+    }
+    return ((void *)skb);
+}
+
+/*
+ * Turn a buffer we are done with back into one that looks like it came from
+ * a_netbuf_alloc(size).  Returns NULL if the buffer is too small, shared,
+ * cloned or fragmented, the caller still owns it and has to free it.
+ */
+void *
+a_netbuf_recycle(void *bufPtr, int size)
+{
+    struct sk_buff *skb = (struct sk_buff *)bufPtr;
+
+    if (!skb_recycle_check(skb, AR6000_DATA_OFFSET + sizeof(HTC_PACKET) + size)) {
+        return NULL;
+    }
     skb_reserve(skb, AR6000_DATA_OFFSET + sizeof(HTC_PACKET));
     return ((void *)skb);
 }
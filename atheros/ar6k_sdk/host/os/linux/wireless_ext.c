@@ -557,16 +557,10 @@ ar6000_ioctl_siwessid(struct net_device *dev,
         return -EBUSY;
     }
 
-    if (ar->arTxPending[wmi_get_control_ep(ar->arWmi)]) {
-        /*
-         * sleep until the command queue drains
-         */
-        wait_event_interruptible_timeout(arEvent,
-            ar->arTxPending[wmi_get_control_ep(ar->arWmi)] == 0, wmitimeout * HZ);
-        if (signal_pending(current)) {
-            return -EINTR;
-        }
-    }
+    /*
+     * No need to drain the command queue first, WMI commands are never
+     * dropped and reach the target in the order they were issued.
+     */
 
     if (!data->flags) {
         arNetworkType = ar->arNetworkType;
@@ -1736,6 +1730,9 @@ ar6000_ioctl_siwencodeext(struct net_device *dev,
             if (status != A_OK) {
                 return -EIO;
             }
+            if (keyUsage & GROUP_USAGE) {
+                ar6000_connect_keys_installed(ar);
+            }
         }
 
 #ifdef USER_KEYS
@@ -78,8 +78,16 @@ typedef PREPACK struct _HTC_FRAME_HDR{
 } POSTPACK HTC_FRAME_HDR;
 
 /* frame header flags */
+
+    /* send direction */
 #define HTC_FLAGS_NEED_CREDIT_UPDATE (1 << 0)
-#define HTC_FLAGS_RECV_TRAILER       (1 << 1)
+#define HTC_FLAGS_SEND_BUNDLE        (1 << 1)  /* message is part of a send bundle */
+
+    /* receive direction */
+#define HTC_FLAGS_RECV_UNUSED_0      (1 << 0)  /* bit 0 unused */
+#define HTC_FLAGS_RECV_TRAILER       (1 << 1)  /* bit 1 trailer data present */
+#define HTC_FLAGS_RECV_BUNDLE_CNT_MASK  (0xF0) /* bits 7..4, messages that follow in this bundle */
+#define HTC_FLAGS_RECV_BUNDLE_CNT_SHIFT 4
 
 
 #define HTC_HDR_LENGTH  (sizeof(HTC_FRAME_HDR))
@@ -92,6 +100,7 @@ typedef enum {
     HTC_MSG_CONNECT_SERVICE_ID = 2,
     HTC_MSG_CONNECT_SERVICE_RESPONSE_ID = 3,   
     HTC_MSG_SETUP_COMPLETE_ID = 4,
+    HTC_MSG_SETUP_COMPLETE_EX_ID = 5,
 } HTC_MSG_IDS;
  
 #define HTC_MAX_CONTROL_MESSAGE_LENGTH  256
@@ -111,6 +120,17 @@ typedef PREPACK struct {
     A_UINT8   _Pad1;
 } POSTPACK HTC_READY_MSG;
 
+    /* extended HTC ready message, sent by HTC 2.1 and later targets */
+typedef PREPACK struct {
+    HTC_READY_MSG   Version2_0_Info;   /* legacy version 2.0 information at the front... */
+    /* extended information */
+    A_UINT8         HTCVersion;
+    A_UINT8         MaxMsgsPerHTCBundle;
+} POSTPACK HTC_READY_EX_MSG;
+
+#define HTC_VERSION_2P0  0x00
+#define HTC_VERSION_2P1  0x01  /* HTC 2.1 adds message bundling */
+
 #define HTC_SERVICE_META_DATA_MAX_LENGTH 128
 
 /* connect service
@@ -155,6 +175,16 @@ typedef PREPACK struct {
     /* currently, no other fields */
 } POSTPACK HTC_SETUP_COMPLETE_MSG;
 
+    /* extended setup completion message, only sent to HTC 2.1 and later targets */
+typedef PREPACK struct {
+    A_UINT16  MessageID;
+    A_UINT32  SetupFlags;
+    A_UINT8   MaxMsgsPerBundledRecv;
+    A_UINT8   Rsvd[3];
+} POSTPACK HTC_SETUP_COMPLETE_EX_MSG;
+
+#define HTC_SETUP_COMPLETE_FLAGS_ENABLE_BUNDLE_RECV     (1 << 0)
+
 
 /* connect response status codes */
 #define HTC_SERVICE_SUCCESS      0  /* success */
@@ -169,6 +199,7 @@ typedef enum {
     HTC_RECORD_NULL  = 0,
     HTC_RECORD_CREDITS   = 1,
     HTC_RECORD_LOOKAHEAD = 2,   
+    HTC_RECORD_LOOKAHEAD_BUNDLE = 3,
 } HTC_RPT_IDS;
 
 typedef PREPACK struct {
@@ -191,6 +222,10 @@ typedef PREPACK struct {
     
 } POSTPACK HTC_LOOKAHEAD_REPORT;
 
+typedef PREPACK struct {    
+    A_UINT8 LookAhead[4];     /* 4 byte lookahead */
+} POSTPACK HTC_BUNDLED_LOOKAHEAD_REPORT;
+
 #ifndef ATH_TARGET
 #include "athendpack.h"
 #endif
@@ -0,0 +1,466 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  Deadline style FIFO scheduling for devices without seek cost, such as
+ *  eMMC and SD cards.  Requests are kept in arrival order per sync/async
+ *  class and data direction, reads are preferred over writes, writes are
+ *  issued in bounded batches and the queue is never idled waiting for a
+ *  process to submit more nearby I/O.
+ *
+ *  Copyright (C) 2011 NVIDIA Corporation
+ *
+ *  Based on the deadline i/o scheduler,
+ *  Copyright (C) 2002 Jens Axboe <axboe@kernel.dk>
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int sync_read_expire = HZ / 8;	/* max time before a sync read is submitted */
+static const int sync_write_expire = HZ / 2;	/* ditto for sync writes */
+static const int async_read_expire = HZ / 4;	/* ditto for async reads */
+static const int async_write_expire = 5 * HZ;	/* ditto for async writes */
+static const int writes_starved = 4;		/* max times reads can starve a write */
+static const int write_batch = 8;		/* max writes issued back to back */
+
+#define FLASH_ASYNC	0
+#define FLASH_SYNC	1
+
+/*
+ * Read latency histogram.  The first four buckets are 1us wide, after
+ * that every power of two is split into four buckets, so a reported
+ * percentile is within 25% of the real value.  The last bucket collects
+ * everything above ~16s.
+ */
+#define FLASH_LAT_BUCKETS	96
+
+struct flash_data {
+	/*
+	 * requests are on one of the fifo lists, indexed [sync][data_dir]
+	 */
+	struct list_head fifo_list[2][2];
+
+	unsigned int batching;		/* writes issued in the current batch */
+	int batch_dir;			/* data direction of the current batch */
+	unsigned int starved;		/* times reads have starved writes */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2][2];
+	int writes_starved;
+	int write_batch;
+
+	struct request_queue *q;
+	unsigned int read_lat[FLASH_LAT_BUCKETS];
+	unsigned int read_lat_count;
+};
+
+/*
+ * The time a request entered the scheduler is kept in elevator_private,
+ * truncated to an unsigned long worth of microseconds.
+ */
+static inline unsigned long flash_now_us(void)
+{
+	return (unsigned long)ktime_to_us(ktime_get());
+}
+
+static inline struct list_head *
+flash_fifo(struct flash_data *fd, struct request *rq)
+{
+	return &fd->fifo_list[rq_is_sync(rq)][rq_data_dir(rq)];
+}
+
+static void flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int sync = rq_is_sync(rq);
+	const int data_dir = rq_data_dir(rq);
+
+	rq->elevator_private = (void *)flash_now_us();
+
+	/*
+	 * set expire time and add to fifo list
+	 */
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[sync][data_dir]);
+	list_add_tail(&rq->queuelist, flash_fifo(fd, rq));
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	rq_fifo_clear(next);
+}
+
+static inline void
+flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	rq_fifo_clear(rq);
+	elv_dispatch_add_tail(fd->q, rq);
+}
+
+/*
+ * return the oldest expired request, reads and sync requests first
+ */
+static struct request *flash_expired_request(struct flash_data *fd)
+{
+	static const int order[4][2] = {
+		{ FLASH_SYNC, READ }, { FLASH_ASYNC, READ },
+		{ FLASH_SYNC, WRITE }, { FLASH_ASYNC, WRITE },
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(order); i++) {
+		struct list_head *fifo = &fd->fifo_list[order[i][0]][order[i][1]];
+		struct request *rq;
+
+		if (list_empty(fifo))
+			continue;
+
+		rq = rq_entry_fifo(fifo->next);
+		if (time_after(jiffies, rq_fifo_time(rq)))
+			return rq;
+	}
+
+	return NULL;
+}
+
+static struct request *
+flash_first_request(struct flash_data *fd, int data_dir)
+{
+	if (!list_empty(&fd->fifo_list[FLASH_SYNC][data_dir]))
+		return rq_entry_fifo(fd->fifo_list[FLASH_SYNC][data_dir].next);
+	if (!list_empty(&fd->fifo_list[FLASH_ASYNC][data_dir]))
+		return rq_entry_fifo(fd->fifo_list[FLASH_ASYNC][data_dir].next);
+
+	return NULL;
+}
+
+/*
+ * flash_dispatch_requests selects the next request to issue.  There is
+ * no idling: if anything is queued, something is dispatched.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *reads = flash_first_request(fd, READ);
+	struct request *writes = flash_first_request(fd, WRITE);
+	struct request *rq;
+
+	if (!reads && !writes)
+		return 0;
+
+	rq = flash_expired_request(fd);
+	if (rq)
+		goto dispatch_request;
+
+	/*
+	 * finish the current write batch, unless it has run its course
+	 */
+	if (fd->batch_dir == WRITE && writes &&
+	    fd->batching < fd->write_batch) {
+		rq = writes;
+		goto dispatch_request;
+	}
+
+	if (reads && !(writes && fd->starved++ >= fd->writes_starved)) {
+		rq = reads;
+		goto dispatch_request;
+	}
+
+	/*
+	 * there are either no reads or writes have been starved
+	 */
+	fd->starved = 0;
+	fd->batching = 0;
+	rq = writes;
+
+dispatch_request:
+	if (rq_data_dir(rq) == WRITE) {
+		if (fd->batch_dir != WRITE)
+			fd->batching = 0;
+		fd->batching++;
+	}
+	fd->batch_dir = rq_data_dir(rq);
+
+	flash_move_to_dispatch(fd, rq);
+
+	return 1;
+}
+
+static inline int flash_fifo_empty(struct flash_data *fd)
+{
+	return list_empty(&fd->fifo_list[FLASH_SYNC][READ])
+		&& list_empty(&fd->fifo_list[FLASH_SYNC][WRITE])
+		&& list_empty(&fd->fifo_list[FLASH_ASYNC][READ])
+		&& list_empty(&fd->fifo_list[FLASH_ASYNC][WRITE]);
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	return flash_fifo_empty(q->elevator->elevator_data);
+}
+
+static unsigned int flash_lat_bucket(unsigned long us)
+{
+	unsigned int order, idx;
+
+	if (us < 4)
+		return us;
+
+	order = fls_long(us) - 1;
+	idx = (order - 1) * 4 + ((us >> (order - 2)) & 3);
+
+	return min(idx, FLASH_LAT_BUCKETS - 1U);
+}
+
+/* lowest latency, in us, that falls in bucket @idx */
+static unsigned long flash_lat_bucket_start(unsigned int idx)
+{
+	if (idx < 4)
+		return idx;
+
+	return (4UL + (idx & 3)) << (idx / 4 - 1);
+}
+
+static void flash_completed_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	unsigned long lat;
+
+	if (rq_data_dir(rq) != READ)
+		return;
+
+	lat = flash_now_us() - (unsigned long)rq->elevator_private;
+	fd->read_lat[flash_lat_bucket(lat)]++;
+	fd->read_lat_count++;
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(!flash_fifo_empty(fd));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	INIT_LIST_HEAD(&fd->fifo_list[FLASH_SYNC][READ]);
+	INIT_LIST_HEAD(&fd->fifo_list[FLASH_SYNC][WRITE]);
+	INIT_LIST_HEAD(&fd->fifo_list[FLASH_ASYNC][READ]);
+	INIT_LIST_HEAD(&fd->fifo_list[FLASH_ASYNC][WRITE]);
+	fd->fifo_expire[FLASH_SYNC][READ] = sync_read_expire;
+	fd->fifo_expire[FLASH_SYNC][WRITE] = sync_write_expire;
+	fd->fifo_expire[FLASH_ASYNC][READ] = async_read_expire;
+	fd->fifo_expire[FLASH_ASYNC][WRITE] = async_write_expire;
+	fd->writes_starved = writes_starved;
+	fd->write_batch = write_batch;
+	fd->batch_dir = READ;
+	fd->q = q;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_sync_read_expire_show, fd->fifo_expire[FLASH_SYNC][READ], 1);
+SHOW_FUNCTION(flash_sync_write_expire_show, fd->fifo_expire[FLASH_SYNC][WRITE], 1);
+SHOW_FUNCTION(flash_async_read_expire_show, fd->fifo_expire[FLASH_ASYNC][READ], 1);
+SHOW_FUNCTION(flash_async_write_expire_show, fd->fifo_expire[FLASH_ASYNC][WRITE], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_write_batch_show, fd->write_batch, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_sync_read_expire_store, &fd->fifo_expire[FLASH_SYNC][READ], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_sync_write_expire_store, &fd->fifo_expire[FLASH_SYNC][WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_read_expire_store, &fd->fifo_expire[FLASH_ASYNC][READ], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_write_expire_store, &fd->fifo_expire[FLASH_ASYNC][WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_store, &fd->write_batch, 1, INT_MAX, 0);
+#undef STORE_FUNCTION
+
+/*
+ * read latency percentiles, in us, from the time a read entered the
+ * scheduler until it completed
+ */
+static ssize_t flash_read_lat_show(struct elevator_queue *e, char *page,
+				   unsigned int permille)
+{
+	struct flash_data *fd = e->elevator_data;
+	unsigned long long target;
+	unsigned int sum = 0;
+	unsigned long lat = 0;
+	int i;
+
+	spin_lock_irq(fd->q->queue_lock);
+	target = (unsigned long long)fd->read_lat_count * permille;
+	for (i = 0; i < FLASH_LAT_BUCKETS && fd->read_lat_count; i++) {
+		sum += fd->read_lat[i];
+		if ((unsigned long long)sum * 1000 >= target) {
+			lat = flash_lat_bucket_start(i + 1);
+			break;
+		}
+	}
+	spin_unlock_irq(fd->q->queue_lock);
+
+	return sprintf(page, "%lu\n", lat);
+}
+
+#define READ_LAT_FUNCTION(__FUNC, __PERMILLE)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	return flash_read_lat_show(e, page, __PERMILLE);		\
+}
+READ_LAT_FUNCTION(flash_read_lat_p50_show, 500);
+READ_LAT_FUNCTION(flash_read_lat_p90_show, 900);
+READ_LAT_FUNCTION(flash_read_lat_p99_show, 990);
+#undef READ_LAT_FUNCTION
+
+static ssize_t flash_read_lat_count_show(struct elevator_queue *e, char *page)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	return sprintf(page, "%u\n", fd->read_lat_count);
+}
+
+/* writing anything clears the read latency histogram */
+static ssize_t flash_read_lat_count_store(struct elevator_queue *e,
+					  const char *page, size_t count)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	spin_lock_irq(fd->q->queue_lock);
+	memset(fd->read_lat, 0, sizeof(fd->read_lat));
+	fd->read_lat_count = 0;
+	spin_unlock_irq(fd->q->queue_lock);
+
+	return count;
+}
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+#define FD_ATTR_RO(name) \
+	__ATTR(name, S_IRUGO, flash_##name##_show, NULL)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(sync_read_expire),
+	FD_ATTR(sync_write_expire),
+	FD_ATTR(async_read_expire),
+	FD_ATTR(async_write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(write_batch),
+	FD_ATTR_RO(read_lat_p50),
+	FD_ATTR_RO(read_lat_p90),
+	FD_ATTR_RO(read_lat_p99),
+	FD_ATTR(read_lat_count),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_completed_req_fn =	flash_completed_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -20,6 +20,9 @@
 #include <linux/highmem.h>
 #include <linux/firmware.h>
 #include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/suspend.h>
 
 #define to_dev(obj) container_of(obj, struct device, kobj)
 
@@ -73,6 +76,358 @@ static inline bool fw_is_builtin_firmware(const struct firmware *fw)
 }
 #endif
 
+/* Firmware image cache */
+
+struct fw_cache_entry;
+
+#ifdef CONFIG_FW_CACHE
+
+static void firmware_free_data(const struct firmware *fw);
+
+/*
+ * Images are kept by name after their first successful load, so
+ * drivers that request firmware on every enable or resume get it back
+ * without the filesystem or the usermode helper.  An entry is pinned
+ * while a struct firmware points at it.  Idle entries are dropped by
+ * the shrinker, least recently used first, except between suspend
+ * prepare and resume when neither way of reloading them is usable.
+ */
+#define FW_DIRECT_MAX_SIZE	(32 << 20)
+
+struct fw_cache_entry {
+	struct list_head list;
+	int users;
+	size_t size;
+	u8 *data;
+	char name[];
+};
+
+static LIST_HEAD(fw_cache);
+static DEFINE_SPINLOCK(fw_cache_lock);
+static unsigned long fw_cache_idle_pages;
+static bool fw_cache_suspended;
+
+static char fw_path[256] = CONFIG_FW_LOADER_PATH;
+module_param_string(path, fw_path, sizeof(fw_path), 0644);
+MODULE_PARM_DESC(path, "Directories searched before the usermode helper");
+
+static struct fw_cache_entry *fw_cache_alloc(const char *name, size_t size)
+{
+	struct fw_cache_entry *ce;
+
+	ce = kmalloc(sizeof(*ce) + strlen(name) + 1, GFP_KERNEL);
+	if (!ce)
+		return NULL;
+
+	ce->data = vmalloc(size);
+	if (!ce->data) {
+		kfree(ce);
+		return NULL;
+	}
+	ce->size = size;
+	ce->users = 1;
+	strcpy(ce->name, name);
+
+	return ce;
+}
+
+static void fw_cache_free(struct fw_cache_entry *ce)
+{
+	vfree(ce->data);
+	kfree(ce);
+}
+
+/* Called with fw_cache_lock held */
+static struct fw_cache_entry *fw_cache_lookup(const char *name)
+{
+	struct fw_cache_entry *ce;
+
+	list_for_each_entry(ce, &fw_cache, list)
+		if (strcmp(ce->name, name) == 0)
+			return ce;
+
+	return NULL;
+}
+
+/* Called with fw_cache_lock held */
+static void fw_cache_use(struct firmware *fw, struct fw_cache_entry *ce)
+{
+	if (!ce->users++)
+		fw_cache_idle_pages -= PFN_UP(ce->size);
+	list_move(&ce->list, &fw_cache);
+
+	fw->size = ce->size;
+	fw->data = ce->data;
+	fw->pages = NULL;
+	fw->priv = ce;
+}
+
+static bool fw_get_cached_firmware(struct firmware *fw, const char *name)
+{
+	struct fw_cache_entry *ce;
+
+	spin_lock(&fw_cache_lock);
+	ce = fw_cache_lookup(name);
+	if (ce)
+		fw_cache_use(fw, ce);
+	spin_unlock(&fw_cache_lock);
+
+	return ce != NULL;
+}
+
+/*
+ * Publish a freshly loaded entry, holding one reference, and point @fw
+ * at it.  Should a concurrent load of the same name have won, its entry
+ * is used instead and @ce is discarded.
+ */
+static void fw_cache_add(struct firmware *fw, struct fw_cache_entry *ce)
+{
+	struct fw_cache_entry *old;
+
+	spin_lock(&fw_cache_lock);
+	old = fw_cache_lookup(ce->name);
+	if (old) {
+		fw_cache_use(fw, old);
+	} else {
+		list_add(&ce->list, &fw_cache);
+		fw->size = ce->size;
+		fw->data = ce->data;
+		fw->pages = NULL;
+		fw->priv = ce;
+	}
+	spin_unlock(&fw_cache_lock);
+
+	if (old)
+		fw_cache_free(ce);
+}
+
+static void fw_cache_put(struct fw_cache_entry *ce)
+{
+	spin_lock(&fw_cache_lock);
+	if (!--ce->users)
+		fw_cache_idle_pages += PFN_UP(ce->size);
+	spin_unlock(&fw_cache_lock);
+}
+
+/* Drop idle entries, oldest first, until @nr pages have been freed */
+static void fw_cache_drop(unsigned long nr)
+{
+	struct fw_cache_entry *ce, *tmp;
+	LIST_HEAD(victims);
+
+	spin_lock(&fw_cache_lock);
+	list_for_each_entry_safe_reverse(ce, tmp, &fw_cache, list) {
+		if (!nr)
+			break;
+		if (ce->users)
+			continue;
+		fw_cache_idle_pages -= PFN_UP(ce->size);
+		nr -= min_t(unsigned long, nr, PFN_UP(ce->size));
+		list_move(&ce->list, &victims);
+	}
+	spin_unlock(&fw_cache_lock);
+
+	list_for_each_entry_safe(ce, tmp, &victims, list)
+		fw_cache_free(ce);
+}
+
+static int fw_cache_shrink(struct shrinker *shrinker, int nr_to_scan,
+			   gfp_t gfp_mask)
+{
+	if (fw_cache_suspended)
+		return 0;
+
+	if (nr_to_scan)
+		fw_cache_drop(nr_to_scan);
+
+	return min_t(unsigned long, fw_cache_idle_pages, INT_MAX);
+}
+
+static struct shrinker fw_cache_shrinker = {
+	.shrink	= fw_cache_shrink,
+	.seeks	= DEFAULT_SEEKS,
+};
+
+static int fw_cache_pm_notify(struct notifier_block *nb,
+			      unsigned long event, void *unused)
+{
+	switch (event) {
+	case PM_HIBERNATION_PREPARE:
+	case PM_SUSPEND_PREPARE:
+		fw_cache_suspended = true;
+		break;
+	case PM_POST_HIBERNATION:
+	case PM_POST_SUSPEND:
+	case PM_POST_RESTORE:
+		fw_cache_suspended = false;
+		break;
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block fw_cache_pm_nb = {
+	.notifier_call = fw_cache_pm_notify,
+};
+
+static struct fw_cache_entry *fw_read_file(const char *path,
+					   const char *name)
+{
+	struct fw_cache_entry *ce = NULL;
+	struct inode *inode;
+	struct file *filp;
+	loff_t size;
+
+	filp = filp_open(path, O_RDONLY, 0);
+	if (IS_ERR(filp))
+		return NULL;
+
+	inode = filp->f_path.dentry->d_inode;
+	if (!S_ISREG(inode->i_mode))
+		goto out;
+
+	size = i_size_read(inode);
+	if (size <= 0 || size > FW_DIRECT_MAX_SIZE)
+		goto out;
+
+	ce = fw_cache_alloc(name, size);
+	if (ce && kernel_read(filp, 0, ce->data, size) != size) {
+		fw_cache_free(ce);
+		ce = NULL;
+	}
+out:
+	filp_close(filp, NULL);
+	return ce;
+}
+
+/*
+ * Try each directory of the search path in turn.  This is skipped
+ * while suspending: the filesystem may sit on a device that has
+ * already been put to sleep.
+ */
+static bool fw_load_direct(struct firmware *fw, const char *name,
+			   struct device *device)
+{
+	struct fw_cache_entry *ce = NULL;
+	const char *dir, *end;
+	char *path;
+	int len;
+
+	if (!fw_path[0] || fw_cache_suspended)
+		return false;
+
+	path = __getname();
+	if (!path)
+		return false;
+
+	for (dir = fw_path; *dir && !ce; dir = end) {
+		end = strchr(dir, ':');
+		if (!end)
+			end = dir + strlen(dir);
+		len = end - dir;
+		if (*end)
+			end++;
+
+		if (!len || snprintf(path, PATH_MAX, "%.*s/%s",
+				     len, dir, name) >= PATH_MAX)
+			continue;
+
+		ce = fw_read_file(path, name);
+	}
+
+	if (ce) {
+		dev_dbg(device, "firmware: loaded %s directly\n", path);
+		fw_cache_add(fw, ce);
+	}
+	__putname(path);
+
+	return ce != NULL;
+}
+
+/* Move an image that came through the usermode helper into the cache */
+static void fw_cache_insert(struct firmware *fw, const char *name)
+{
+	struct fw_cache_entry *ce;
+
+	ce = fw_cache_alloc(name, fw->size);
+	if (!ce)
+		return;
+
+	memcpy(ce->data, fw->data, fw->size);
+	firmware_free_data(fw);
+	fw_cache_add(fw, ce);
+}
+
+static ssize_t firmware_cache_show(struct class *class,
+				   struct class_attribute *attr,
+				   char *buf)
+{
+	struct fw_cache_entry *ce;
+	ssize_t len = 0;
+
+	spin_lock(&fw_cache_lock);
+	list_for_each_entry(ce, &fw_cache, list)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s %zu %d\n",
+				 ce->name, ce->size, ce->users);
+	spin_unlock(&fw_cache_lock);
+
+	return len;
+}
+
+/* Any write drops every cached image that is not in use */
+static ssize_t firmware_cache_store(struct class *class,
+				    struct class_attribute *attr,
+				    const char *buf, size_t count)
+{
+	fw_cache_drop(ULONG_MAX);
+
+	return count;
+}
+
+static void __init fw_cache_init(void)
+{
+	register_shrinker(&fw_cache_shrinker);
+	register_pm_notifier(&fw_cache_pm_nb);
+}
+
+static void __exit fw_cache_exit(void)
+{
+	unregister_pm_notifier(&fw_cache_pm_nb);
+	unregister_shrinker(&fw_cache_shrinker);
+	fw_cache_drop(ULONG_MAX);
+}
+
+#else
+
+static inline bool fw_get_cached_firmware(struct firmware *fw,
+					  const char *name)
+{
+	return false;
+}
+
+static inline bool fw_load_direct(struct firmware *fw, const char *name,
+				  struct device *device)
+{
+	return false;
+}
+
+static inline void fw_cache_insert(struct firmware *fw, const char *name)
+{
+}
+
+static inline void fw_cache_put(struct fw_cache_entry *ce)
+{
+}
+
+static inline void fw_cache_init(void)
+{
+}
+
+static inline void fw_cache_exit(void)
+{
+}
+#endif
+
 enum {
 	FW_STATUS_LOADING,
 	FW_STATUS_DONE,
@@ -144,6 +499,10 @@ static ssize_t firmware_timeout_store(struct class *class,
 static struct class_attribute firmware_class_attrs[] = {
 	__ATTR(timeout, S_IWUSR | S_IRUGO,
 		firmware_timeout_show, firmware_timeout_store),
+#ifdef CONFIG_FW_CACHE
+	__ATTR(cache, S_IWUSR | S_IRUGO,
+		firmware_cache_show, firmware_cache_store),
+#endif
 	__ATTR_NULL
 };
 
@@ -534,6 +893,14 @@ static int _request_firmware(const struct firmware **firmware_p,
 		return 0;
 	}
 
+	if (fw_get_cached_firmware(firmware, name)) {
+		dev_dbg(device, "firmware: using cached firmware %s\n", name);
+		return 0;
+	}
+
+	if (fw_load_direct(firmware, name, device))
+		return 0;
+
 	if (uevent)
 		dev_dbg(device, "firmware: requesting %s\n", name);
 
@@ -565,6 +932,9 @@ static int _request_firmware(const struct firmware **firmware_p,
 
 	fw_destroy_instance(fw_priv);
 
+	if (!retval)
+		fw_cache_insert(firmware, name);
+
 out:
 	if (retval) {
 		release_firmware(firmware);
@@ -604,7 +974,9 @@ request_firmware(const struct firmware **firmware_p, const char *name,
 void release_firmware(const struct firmware *fw)
 {
 	if (fw) {
-		if (!fw_is_builtin_firmware(fw))
+		if (fw->priv)
+			fw_cache_put(fw->priv);
+		else if (!fw_is_builtin_firmware(fw))
 			firmware_free_data(fw);
 		kfree(fw);
 	}
@@ -698,11 +1070,18 @@ request_firmware_nowait(
 
 static int __init firmware_class_init(void)
 {
-	return class_register(&firmware_class);
+	int ret;
+
+	ret = class_register(&firmware_class);
+	if (!ret)
+		fw_cache_init();
+
+	return ret;
 }
 
 static void __exit firmware_class_exit(void)
 {
+	fw_cache_exit();
 	class_unregister(&firmware_class);
 }
 
@@ -174,6 +174,24 @@ void device_pm_move_last(struct device *dev)
 	list_move_tail(&dev->power.entry, &dpm_list);
 }
 
+static const struct dpm_platform_ops *dpm_platform_ops;
+
+/**
+ * dpm_set_platform_ops - Install platform hooks for device suspend/resume.
+ * @ops: Callbacks to run around each device's suspend and resume, or NULL.
+ *
+ * Lets the platform order devices that are not parent and child, which
+ * matters once they suspend and resume asynchronously, and collect
+ * per-device resume times.  Must not be changed during a transition.
+ */
+void dpm_set_platform_ops(const struct dpm_platform_ops *ops)
+{
+	mutex_lock(&dpm_list_mtx);
+	dpm_platform_ops = ops;
+	mutex_unlock(&dpm_list_mtx);
+}
+EXPORT_SYMBOL_GPL(dpm_set_platform_ops);
+
 static ktime_t initcall_debug_start(struct device *dev)
 {
 	ktime_t calltime = ktime_set(0, 0);
@@ -526,6 +544,8 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
  */
 static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
+	const struct dpm_platform_ops *ops = dpm_platform_ops;
+	ktime_t starttime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -534,6 +554,9 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	if (dev->parent && (dev->parent->power.status >= DPM_OFF ||
 			    dev->parent->power.status == DPM_RESUMING))
 		dpm_wait(dev->parent, async);
+	if (ops && ops->resume_prepare)
+		ops->resume_prepare(dev);
+	starttime = ktime_get();
 	device_lock(dev);
 
 	dev->power.status = DPM_RESUMING;
@@ -570,6 +593,9 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	}
  End:
 	device_unlock(dev);
+	if (ops && ops->resume_report)
+		ops->resume_report(dev,
+			ktime_to_us(ktime_sub(ktime_get(), starttime)), error);
 	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
@@ -877,6 +903,8 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	struct dpm_drv_wd_data data;
 
 	dpm_wait_for_children(dev, async);
+	if (dpm_platform_ops && dpm_platform_ops->suspend_prepare)
+		dpm_platform_ops->suspend_prepare(dev);
 
 	data.dev = dev;
 	data.tsk = get_current();
@@ -82,6 +82,23 @@ static DEFINE_MUTEX(loop_devices_mutex);
 
 static int max_part;
 static int part_shift;
+static int direct_io = 1;
+
+static struct bio_set *loop_bio_set;
+
+/*
+ * Block map of the backing file, in 512 byte sectors: file sectors
+ * [start, start + nr_sects) are at [disk_start, disk_start + nr_sects)
+ * on lo_extent_bdev.
+ */
+struct loop_extent {
+	sector_t	start;
+	sector_t	nr_sects;
+	sector_t	disk_start;
+};
+
+/* a more fragmented file is left to the loop thread */
+#define LOOP_MAX_EXTENTS	2048
 
 /*
  * Transfer functions
@@ -507,6 +524,215 @@ out:
 	return ret;
 }
 
+/*
+ * Direct I/O mode
+ *
+ * When the backing file is fully allocated on a block device, reads are
+ * remapped to the blocks of the file and sent straight to that device.
+ * They neither go through the loop thread nor leave a second copy of
+ * the data in the backing file's page cache.  The file is marked
+ * S_SWAPFILE while it is mapped, so it can't be truncated and its blocks
+ * can't be moved under us.  The first write to the device hands it back
+ * to the loop thread, as it has to go through the page cache.
+ */
+static void loop_bio_destructor(struct bio *bio)
+{
+	bio_free(bio, loop_bio_set);
+}
+
+static void loop_extent_endio(struct bio *clone, int error)
+{
+	struct bio *bio = clone->bi_private;
+	struct loop_device *lo = bio->bi_bdev->bd_disk->private_data;
+
+	bio_put(clone);
+	bio_endio(bio, error);
+
+	if (atomic_dec_and_test(&lo->lo_extent_inflight))
+		wake_up(&lo->lo_event);
+}
+
+/*
+ * Find the disk sector of @bio, if all of it lies in one extent.
+ * Called with lo_lock held.
+ */
+static int loop_map_extent(struct loop_device *lo, struct bio *bio,
+			   sector_t *disk_sector)
+{
+	struct loop_extent *ext;
+	sector_t sector = bio->bi_sector + (lo->lo_offset >> 9);
+	unsigned int lo_idx = 0, hi_idx = lo->lo_nr_extents;
+
+	if (!bio->bi_size || (bio->bi_rw & REQ_HARDBARRIER))
+		return 0;
+
+	while (lo_idx < hi_idx) {
+		unsigned int mid = (lo_idx + hi_idx) / 2;
+
+		ext = &lo->lo_extents[mid];
+		if (sector < ext->start) {
+			hi_idx = mid;
+		} else if (sector >= ext->start + ext->nr_sects) {
+			lo_idx = mid + 1;
+		} else {
+			if (sector + bio_sectors(bio) >
+			    ext->start + ext->nr_sects)
+				return 0;
+			*disk_sector = ext->disk_start + (sector - ext->start);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void loop_submit_extent(struct loop_device *lo, struct bio *bio,
+			       sector_t disk_sector)
+{
+	struct bio *clone;
+
+	clone = bio_alloc_bioset(GFP_NOIO, bio->bi_max_vecs, loop_bio_set);
+	__bio_clone(clone, bio);
+	clone->bi_flags &= ~(1 << BIO_SEG_VALID);
+	clone->bi_destructor = loop_bio_destructor;
+	clone->bi_bdev = lo->lo_extent_bdev;
+	clone->bi_sector = disk_sector;
+	clone->bi_private = bio;
+	clone->bi_end_io = loop_extent_endio;
+	generic_make_request(clone);
+}
+
+static int loop_add_extent(struct loop_device *lo, unsigned int *size,
+			   sector_t start, sector_t disk_start, sector_t len)
+{
+	struct loop_extent *ext;
+
+	if (lo->lo_nr_extents) {
+		ext = &lo->lo_extents[lo->lo_nr_extents - 1];
+		if (ext->start + ext->nr_sects == start &&
+		    ext->disk_start + ext->nr_sects == disk_start) {
+			ext->nr_sects += len;
+			return 0;
+		}
+	}
+
+	if (lo->lo_nr_extents == *size) {
+		unsigned int new_size = *size ? *size * 2 : 16;
+
+		if (new_size > LOOP_MAX_EXTENTS)
+			return -E2BIG;
+		ext = krealloc(lo->lo_extents, new_size * sizeof(*ext),
+			       GFP_KERNEL);
+		if (!ext)
+			return -ENOMEM;
+		lo->lo_extents = ext;
+		*size = new_size;
+	}
+
+	ext = &lo->lo_extents[lo->lo_nr_extents++];
+	ext->start = start;
+	ext->nr_sects = len;
+	ext->disk_start = disk_start;
+	return 0;
+}
+
+/*
+ * Map the part of the backing file used by the device and switch to
+ * direct I/O if it can be done.  Called with lo_ctl_mutex held.
+ */
+static void loop_setup_extents(struct loop_device *lo)
+{
+	struct file *file = lo->lo_backing_file;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	struct block_device *bdev = inode->i_sb->s_bdev;
+	unsigned int blkbits = inode->i_blkbits;
+	unsigned int size = 0;
+	sector_t block, last_block, disk_block;
+	loff_t end;
+	int err = 0;
+
+	if (!direct_io || lo->lo_encryption || !S_ISREG(inode->i_mode) ||
+	    !mapping->a_ops->bmap || !bdev || (lo->lo_offset & 511) ||
+	    bdev_logical_block_size(bdev) != 512 ||
+	    bdev_get_queue(bdev)->merge_bvec_fn)
+		return;
+
+	end = lo->lo_offset + ((loff_t)get_capacity(lo->lo_disk) << 9);
+	if (end <= lo->lo_offset)
+		return;
+	last_block = (end - 1) >> blkbits;
+
+	mutex_lock(&inode->i_mutex);
+	if (IS_SWAPFILE(inode)) {
+		mutex_unlock(&inode->i_mutex);
+		return;
+	}
+
+	for (block = lo->lo_offset >> blkbits; block <= last_block; block++) {
+		disk_block = bmap(inode, block);
+		if (!disk_block) {
+			err = -ENOENT;	/* hole */
+			break;
+		}
+		err = loop_add_extent(lo, &size, block << (blkbits - 9),
+				      disk_block << (blkbits - 9),
+				      1 << (blkbits - 9));
+		if (err)
+			break;
+		cond_resched();
+	}
+
+	if (err) {
+		mutex_unlock(&inode->i_mutex);
+		kfree(lo->lo_extents);
+		lo->lo_extents = NULL;
+		lo->lo_nr_extents = 0;
+		return;
+	}
+
+	inode->i_flags |= S_SWAPFILE;
+	mutex_unlock(&inode->i_mutex);
+
+	/* from now on the page cache only holds stale copies */
+	filemap_write_and_wait(mapping);
+	invalidate_mapping_pages(mapping, 0, -1);
+
+	blk_queue_stack_limits(lo->lo_queue, bdev_get_queue(bdev));
+
+	spin_lock_irq(&lo->lo_lock);
+	lo->lo_extent_bdev = bdev;
+	lo->lo_flags |= LO_FLAGS_DIRECT_IO;
+	spin_unlock_irq(&lo->lo_lock);
+}
+
+/*
+ * Leave direct I/O mode and wait for the reads already sent to the
+ * backing device.  Called with lo_ctl_mutex held.
+ */
+static void loop_release_extents(struct loop_device *lo)
+{
+	struct inode *inode;
+
+	if (!lo->lo_extent_bdev)
+		return;
+
+	spin_lock_irq(&lo->lo_lock);
+	lo->lo_flags &= ~LO_FLAGS_DIRECT_IO;
+	spin_unlock_irq(&lo->lo_lock);
+
+	wait_event(lo->lo_event, !atomic_read(&lo->lo_extent_inflight));
+
+	inode = lo->lo_backing_file->f_mapping->host;
+	mutex_lock(&inode->i_mutex);
+	inode->i_flags &= ~S_SWAPFILE;
+	mutex_unlock(&inode->i_mutex);
+
+	kfree(lo->lo_extents);
+	lo->lo_extents = NULL;
+	lo->lo_nr_extents = 0;
+	lo->lo_extent_bdev = NULL;
+}
+
 /*
  * Add bio to back of pending list
  */
@@ -527,6 +753,7 @@ static int loop_make_request(struct request_queue *q, struct bio *old_bio)
 {
 	struct loop_device *lo = q->queuedata;
 	int rw = bio_rw(old_bio);
+	sector_t disk_sector;
 
 	if (rw == READA)
 		rw = READ;
@@ -538,6 +765,17 @@ static int loop_make_request(struct request_queue *q, struct bio *old_bio)
 		goto out;
 	if (unlikely(rw == WRITE && (lo->lo_flags & LO_FLAGS_READ_ONLY)))
 		goto out;
+	if (lo->lo_flags & LO_FLAGS_DIRECT_IO) {
+		if (rw == WRITE) {
+			lo->lo_flags &= ~LO_FLAGS_DIRECT_IO;
+		} else if (old_bio->bi_bdev &&
+			   loop_map_extent(lo, old_bio, &disk_sector)) {
+			atomic_inc(&lo->lo_extent_inflight);
+			spin_unlock_irq(&lo->lo_lock);
+			loop_submit_extent(lo, old_bio, disk_sector);
+			return 0;
+		}
+	}
 	loop_add_bio(lo, old_bio);
 	wake_up(&lo->lo_event);
 	spin_unlock_irq(&lo->lo_lock);
@@ -715,9 +953,13 @@ static int loop_change_fd(struct loop_device *lo, struct block_device *bdev,
 		goto out_putf;
 
 	/* and ... switch */
+	loop_release_extents(lo);
 	error = loop_switch(lo, file);
-	if (error)
+	if (error) {
+		loop_setup_extents(lo);
 		goto out_putf;
+	}
+	loop_setup_extents(lo);
 
 	fput(old_file);
 	if (max_part > 0)
@@ -849,6 +1091,7 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 	}
 	lo->lo_state = Lo_bound;
 	wake_up_process(lo->lo_thread);
+	loop_setup_extents(lo);
 	if (max_part > 0)
 		ioctl_by_bdev(bdev, BLKRRPART, 0);
 	return 0;
@@ -928,6 +1171,7 @@ static int loop_clr_fd(struct loop_device *lo, struct block_device *bdev)
 	spin_unlock_irq(&lo->lo_lock);
 
 	kthread_stop(lo->lo_thread);
+	loop_release_extents(lo);
 
 	lo->lo_queue->unplug_fn = NULL;
 	lo->lo_backing_file = NULL;
@@ -986,31 +1230,35 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 	if ((unsigned int) info->lo_encrypt_key_size > LO_KEY_SIZE)
 		return -EINVAL;
 
+	loop_release_extents(lo);
+
 	err = loop_release_xfer(lo);
 	if (err)
-		return err;
+		goto out;
 
 	if (info->lo_encrypt_type) {
 		unsigned int type = info->lo_encrypt_type;
 
+		err = -EINVAL;
 		if (type >= MAX_LO_CRYPT)
-			return -EINVAL;
+			goto out;
 		xfer = xfer_funcs[type];
 		if (xfer == NULL)
-			return -EINVAL;
+			goto out;
 	} else
 		xfer = NULL;
 
 	err = loop_init_xfer(lo, xfer, info);
 	if (err)
-		return err;
+		goto out;
 
 	if (lo->lo_offset != info->lo_offset ||
 	    lo->lo_sizelimit != info->lo_sizelimit) {
 		lo->lo_offset = info->lo_offset;
 		lo->lo_sizelimit = info->lo_sizelimit;
+		err = -EFBIG;
 		if (figure_loop_size(lo))
-			return -EFBIG;
+			goto out;
 	}
 
 	memcpy(lo->lo_file_name, info->lo_file_name, LO_NAME_SIZE);
@@ -1035,8 +1283,11 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 		       info->lo_encrypt_key_size);
 		lo->lo_key_owner = uid;
 	}	
+	err = 0;
 
-	return 0;
+out:
+	loop_setup_extents(lo);
+	return err;
 }
 
 static int
@@ -1470,6 +1721,8 @@ module_param(max_loop, int, 0);
 MODULE_PARM_DESC(max_loop, "Maximum number of loop devices");
 module_param(max_part, int, 0);
 MODULE_PARM_DESC(max_part, "Maximum number of partitions per loop device");
+module_param(direct_io, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(direct_io, "Read fully allocated backing files directly");
 MODULE_LICENSE("GPL");
 MODULE_ALIAS_BLOCKDEV_MAJOR(LOOP_MAJOR);
 
@@ -1628,8 +1881,14 @@ static int __init loop_init(void)
 		range = 1UL << (MINORBITS - part_shift);
 	}
 
-	if (register_blkdev(LOOP_MAJOR, "loop"))
+	loop_bio_set = bioset_create(BIO_POOL_SIZE, 0);
+	if (!loop_bio_set)
+		return -ENOMEM;
+
+	if (register_blkdev(LOOP_MAJOR, "loop")) {
+		bioset_free(loop_bio_set);
 		return -EIO;
+	}
 
 	for (i = 0; i < nr; i++) {
 		lo = loop_alloc(i);
@@ -1656,6 +1915,7 @@ Enomem:
 		loop_free(lo);
 
 	unregister_blkdev(LOOP_MAJOR, "loop");
+	bioset_free(loop_bio_set);
 	return -ENOMEM;
 }
 
@@ -1671,6 +1931,7 @@ static void __exit loop_exit(void)
 
 	blk_unregister_region(MKDEV(LOOP_MAJOR, 0), range);
 	unregister_blkdev(LOOP_MAJOR, "loop");
+	bioset_free(loop_bio_set);
 }
 
 module_init(loop_init);
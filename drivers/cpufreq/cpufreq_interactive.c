@@ -19,12 +19,15 @@
 #include <linux/cpu.h>
 #include <linux/cpumask.h>
 #include <linux/cpufreq.h>
+#include <linux/hrtimer.h>
+#include <linux/input.h>
 #include <linux/mutex.h>
 #include <linux/sched.h>
 #include <linux/tick.h>
 #include <linux/timer.h>
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
+#include <linux/slab.h>
 
 #include <asm/cputime.h>
 
@@ -67,6 +70,19 @@ static unsigned long go_maxspeed_load;
 #define DEFAULT_MIN_SAMPLE_TIME 80000;
 static unsigned long min_sample_time;
 
+/*
+ * On input, raise all online CPUs to at least this speed (kHz) for
+ * input_boost_time usecs.  Zero disables the boost.
+ */
+#define DEFAULT_INPUT_BOOST_TIME 200000
+static unsigned long input_boost_freq;
+static unsigned long input_boost_time;
+
+/* ktime_to_us(ktime_get()) at which the current boost ends */
+static u64 input_boost_end;
+static spinlock_t input_boost_lock;
+static int input_handler_registered;
+
 #define DEBUG 0
 #define BUFSZ 128
 
@@ -167,6 +183,22 @@ struct cpufreq_governor cpufreq_gov_interactive = {
 	.owner = THIS_MODULE,
 };
 
+/*
+ * Returns the lowest frequency the timer may pick at time now (usecs),
+ * or zero if no input boost is in effect.
+ */
+static unsigned int cpufreq_interactive_boost_floor(u64 now)
+{
+	unsigned long flags;
+	unsigned int floor = 0;
+
+	spin_lock_irqsave(&input_boost_lock, flags);
+	if (now < input_boost_end)
+		floor = input_boost_freq;
+	spin_unlock_irqrestore(&input_boost_lock, flags);
+	return floor;
+}
+
 static void cpufreq_interactive_timer(unsigned long data)
 {
 	unsigned int delta_idle;
@@ -179,6 +211,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 		&per_cpu(cpuinfo, data);
 	u64 now_idle;
 	unsigned int new_freq;
+	unsigned int boost_freq;
+	unsigned int relation = CPUFREQ_RELATION_H;
 	unsigned int index;
 	unsigned long flags;
 
@@ -255,9 +289,15 @@ static void cpufreq_interactive_timer(unsigned long data)
 	else
 		new_freq = pcpu->policy->max * cpu_load / 100;
 
+	/* Hold the input boost speed until the boost expires. */
+	boost_freq = cpufreq_interactive_boost_floor(pcpu->timer_run_time);
+	if (new_freq < boost_freq) {
+		new_freq = min(boost_freq, pcpu->policy->max);
+		relation = CPUFREQ_RELATION_L;
+	}
+
 	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
-					   new_freq, CPUFREQ_RELATION_H,
-					   &index)) {
+					   new_freq, relation, &index)) {
 		dbgpr("timer %d: cpufreq_frequency_table_target error\n", (int) data);
 		goto rearm;
 	}
@@ -527,6 +567,134 @@ static void cpufreq_interactive_freq_down(struct work_struct *work)
 	}
 }
 
+static void cpufreq_interactive_boost(void)
+{
+	unsigned int cpu;
+	unsigned int index;
+	unsigned int boost_freq;
+	unsigned long flags;
+	int wake = 0;
+	struct cpufreq_interactive_cpuinfo *pcpu;
+
+	spin_lock_irqsave(&input_boost_lock, flags);
+	boost_freq = input_boost_freq;
+	input_boost_end = ktime_to_us(ktime_get()) + input_boost_time;
+	spin_unlock_irqrestore(&input_boost_lock, flags);
+
+	if (!boost_freq)
+		return;
+
+	for_each_online_cpu(cpu) {
+		pcpu = &per_cpu(cpuinfo, cpu);
+
+		smp_rmb();
+
+		if (!pcpu->governor_enabled)
+			continue;
+
+		if (cpufreq_frequency_table_target(pcpu->policy,
+						   pcpu->freq_table,
+						   min(boost_freq,
+						       pcpu->policy->max),
+						   CPUFREQ_RELATION_L, &index))
+			continue;
+
+		if (pcpu->target_freq >= pcpu->freq_table[index].frequency)
+			continue;
+
+		pcpu->target_freq = pcpu->freq_table[index].frequency;
+		spin_lock_irqsave(&up_cpumask_lock, flags);
+		cpumask_set_cpu(cpu, &up_cpumask);
+		spin_unlock_irqrestore(&up_cpumask_lock, flags);
+		wake = 1;
+		dbgpr("boost %d: tgt=%d\n", cpu, pcpu->target_freq);
+	}
+
+	/* Go through the up task so the driver sees a normal target call */
+	if (wake)
+		wake_up_process(up_task);
+}
+
+static void cpufreq_interactive_input_event(struct input_handle *handle,
+					    unsigned int type,
+					    unsigned int code, int value)
+{
+	/* Key presses and touch contacts; ignore releases and sync */
+	if ((type == EV_KEY && value) || type == EV_ABS)
+		cpufreq_interactive_boost();
+}
+
+static int cpufreq_interactive_input_connect(struct input_handler *handler,
+					     struct input_dev *dev,
+					     const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq_interactive";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void cpufreq_interactive_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id cpufreq_interactive_ids[] = {
+	{
+		/* multi-touch touchscreens */
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			BIT_MASK(ABS_MT_POSITION_X) },
+	},
+	{
+		/* single-touch touchscreens */
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] = BIT_MASK(ABS_X) },
+	},
+	{
+		/* keypads and buttons */
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	},
+	{ },
+};
+
+static struct input_handler cpufreq_interactive_input_handler = {
+	.event		= cpufreq_interactive_input_event,
+	.connect	= cpufreq_interactive_input_connect,
+	.disconnect	= cpufreq_interactive_input_disconnect,
+	.name		= "cpufreq_interactive",
+	.id_table	= cpufreq_interactive_ids,
+};
+
 static ssize_t show_go_maxspeed_load(struct kobject *kobj,
 				     struct attribute *attr, char *buf)
 {
@@ -557,9 +725,63 @@ static ssize_t store_min_sample_time(struct kobject *kobj,
 static struct global_attr min_sample_time_attr = __ATTR(min_sample_time, 0644,
 		show_min_sample_time, store_min_sample_time);
 
+static ssize_t show_input_boost_freq(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", input_boost_freq);
+}
+
+static ssize_t store_input_boost_freq(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	unsigned long val;
+	unsigned long flags;
+	int ret;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	spin_lock_irqsave(&input_boost_lock, flags);
+	input_boost_freq = val;
+	spin_unlock_irqrestore(&input_boost_lock, flags);
+	return count;
+}
+
+static struct global_attr input_boost_freq_attr = __ATTR(input_boost_freq,
+		0644, show_input_boost_freq, store_input_boost_freq);
+
+static ssize_t show_input_boost_time(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", input_boost_time);
+}
+
+static ssize_t store_input_boost_time(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	unsigned long val;
+	unsigned long flags;
+	int ret;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	spin_lock_irqsave(&input_boost_lock, flags);
+	input_boost_time = val;
+	spin_unlock_irqrestore(&input_boost_lock, flags);
+	return count;
+}
+
+static struct global_attr input_boost_time_attr = __ATTR(input_boost_time,
+		0644, show_input_boost_time, store_input_boost_time);
+
 static struct attribute *interactive_attributes[] = {
 	&go_maxspeed_load_attr.attr,
 	&min_sample_time_attr.attr,
+	&input_boost_freq_attr.attr,
+	&input_boost_time_attr.attr,
 	NULL,
 };
 
@@ -600,6 +822,12 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *new_policy,
 		if (rc)
 			return rc;
 
+		rc = input_register_handler(&cpufreq_interactive_input_handler);
+		if (rc)
+			pr_warning("%s: failed to register input handler: %d\n",
+				   __func__, rc);
+		input_handler_registered = !rc;
+
 		pm_idle_old = pm_idle;
 		pm_idle = cpufreq_interactive_idle;
 		break;
@@ -620,6 +848,10 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *new_policy,
 		if (atomic_dec_return(&active_count) > 0)
 			return 0;
 
+		if (input_handler_registered)
+			input_unregister_handler(
+				&cpufreq_interactive_input_handler);
+		input_handler_registered = 0;
 		sysfs_remove_group(cpufreq_global_kobject,
 				&interactive_attr_group);
 
@@ -646,6 +878,7 @@ static int __init cpufreq_interactive_init(void)
 
 	go_maxspeed_load = DEFAULT_GO_MAXSPEED_LOAD;
 	min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
+	input_boost_time = DEFAULT_INPUT_BOOST_TIME;
 
 	/* Initalize per-cpu timers */
 	for_each_possible_cpu(i) {
@@ -675,6 +908,7 @@ static int __init cpufreq_interactive_init(void)
 
 	spin_lock_init(&up_cpumask_lock);
 	spin_lock_init(&down_cpumask_lock);
+	spin_lock_init(&input_boost_lock);
 
 #if DEBUG
 	spin_lock_init(&dbgpr_lock);
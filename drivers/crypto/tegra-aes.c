@@ -39,11 +39,13 @@
 
 #include <crypto/scatterwalk.h>
 #include <crypto/aes.h>
+#include <crypto/b128ops.h>
+#include <crypto/gf128mul.h>
 #include <crypto/internal/rng.h>
 
 #include "tegra-aes.h"
 
-#define FLAGS_MODE_MASK		0x000f
+#define FLAGS_MODE_MASK		(0x000f | FLAGS_CTR | FLAGS_XTS)
 #define FLAGS_ENCRYPT		BIT(0)
 #define FLAGS_CBC		BIT(1)
 #define FLAGS_GIV		BIT(2)
@@ -53,6 +55,9 @@
 #define FLAGS_INIT		BIT(6)
 #define FLAGS_FAST		BIT(7)
 #define FLAGS_BUSY		8
+#define FLAGS_CTR		BIT(9)
+#define FLAGS_XTS		BIT(10)
+#define FLAGS_USE_SSK		BIT(11)
 
 /*
  * Defines AES engine Max process bytes size in one go, which takes 1 msec.
@@ -63,6 +68,15 @@
  */
 #define AES_HW_DMA_BUFFER_SIZE_BYTES 0x4000
 
+/*
+ * Requests smaller than this are run on the CPU.  Taking the arbitration
+ * semaphore, waking the workqueue and loading the IV costs more than
+ * encrypting a few blocks with the generic code.
+ */
+static unsigned int min_hw_bytes = 256;
+module_param(min_hw_bytes, uint, 0644);
+MODULE_PARM_DESC(min_hw_bytes, "smallest request handed to the AES engine");
+
 /*
  * The key table length is 64 bytes
  * (This includes first upto 32 bytes key + 16 bytes original initial vector
@@ -129,10 +143,16 @@ enum {
 #define AES_NR_KEYSLOTS	8
 #define SSK_SLOT_NUM	4
 
+/*
+ * Key slots are a cache: a context keeps its slot (and the key loaded into
+ * it) until the slot is needed for another key, the least recently used
+ * one being recycled first.  dev_list is kept in LRU order.
+ */
 struct tegra_aes_slot {
 	struct list_head node;
 	int slot_num;
 	bool available;
+	struct tegra_aes_ctx *owner;
 };
 
 static struct tegra_aes_slot ssk = {
@@ -183,6 +203,8 @@ struct tegra_aes_ctx {
 	struct tegra_aes_dev *dd;
 	unsigned long flags;
 	struct tegra_aes_slot *slot;
+	struct crypto_blkcipher *fallback;
+	struct crypto_cipher *tweak;	/* xts only */
 	u8 key[AES_MAX_KEY_SIZE];
 	int keylen;
 };
@@ -330,11 +352,17 @@ static int aes_start_crypt(struct tegra_aes_dev *dd, u32 in_addr, u32 out_addr,
 static void aes_release_key_slot(struct tegra_aes_ctx *ctx)
 {
 	spin_lock(&list_lock);
-	ctx->slot->available = true;
+	if (ctx->slot && ctx->slot != &ssk) {
+		/* recycle it first */
+		ctx->slot->available = true;
+		ctx->slot->owner = NULL;
+		list_move(&ctx->slot->node, &dev_list);
+	}
 	ctx->slot = NULL;
 	spin_unlock(&list_lock);
 }
 
+/* take the least recently used slot out of the cache for good */
 static struct tegra_aes_slot *aes_find_key_slot(struct tegra_aes_dev *dd)
 {
 	struct tegra_aes_slot *slot = NULL;
@@ -346,6 +374,9 @@ static struct tegra_aes_slot *aes_find_key_slot(struct tegra_aes_dev *dd)
 			slot->slot_num);
 		if (slot->available) {
 			slot->available = false;
+			if (slot->owner)
+				slot->owner->slot = NULL;
+			slot->owner = NULL;
 			found = true;
 			break;
 		}
@@ -354,6 +385,56 @@ static struct tegra_aes_slot *aes_find_key_slot(struct tegra_aes_dev *dd)
 	return found ? slot : NULL;
 }
 
+/*
+ * Give ctx a slot, evicting the least recently used key if it does not
+ * own one already.  Returns true if the key has to be (re)loaded.
+ */
+static bool aes_get_key_slot(struct tegra_aes_dev *dd,
+	struct tegra_aes_ctx *ctx)
+{
+	struct tegra_aes_slot *slot;
+	bool reload = false;
+
+	spin_lock(&list_lock);
+	slot = ctx->slot;
+	if (!slot || slot->owner != ctx) {
+		ctx->slot = NULL;
+		list_for_each_entry(slot, &dev_list, node) {
+			if (slot->available) {
+				if (slot->owner)
+					slot->owner->slot = NULL;
+				slot->owner = ctx;
+				ctx->slot = slot;
+				reload = true;
+				break;
+			}
+		}
+	}
+	if (ctx->slot)
+		list_move_tail(&ctx->slot->node, &dev_list);
+	spin_unlock(&list_lock);
+
+	dev_dbg(dd->dev, "slot %d%s\n", ctx->slot ? ctx->slot->slot_num : -1,
+		reload ? " (reload)" : "");
+	return reload;
+}
+
+static void aes_select_key_slot(struct tegra_aes_dev *dd, int slot_num)
+{
+	u32 value;
+
+	/* enable key schedule generation in hardware */
+	value = aes_readl(dd, SECURE_CONFIG_EXT);
+	value &= ~SECURE_KEY_SCH_DIS_FIELD;
+	aes_writel(dd, value, SECURE_CONFIG_EXT);
+
+	/* select the key slot */
+	value = aes_readl(dd, SECURE_CONFIG);
+	value &= ~SECURE_KEY_INDEX_FIELD;
+	value |= (slot_num << SECURE_KEY_INDEX_SHIFT);
+	aes_writel(dd, value, SECURE_CONFIG);
+}
+
 static int aes_set_key(struct tegra_aes_dev *dd)
 {
 	u32 value, cmdq[2];
@@ -373,16 +454,7 @@ static int aes_set_key(struct tegra_aes_dev *dd)
 		use_ssk = true;
 	}
 
-	/* enable key schedule generation in hardware */
-	value = aes_readl(dd, SECURE_CONFIG_EXT);
-	value &= ~SECURE_KEY_SCH_DIS_FIELD;
-	aes_writel(dd, value, SECURE_CONFIG_EXT);
-
-	/* select the key slot */
-	value = aes_readl(dd, SECURE_CONFIG);
-	value &= ~SECURE_KEY_INDEX_FIELD;
-	value |= (ctx->slot->slot_num << SECURE_KEY_INDEX_SHIFT);
-	aes_writel(dd, value, SECURE_CONFIG);
+	aes_select_key_slot(dd, ctx->slot->slot_num);
 
 	if (use_ssk)
 		goto out;
@@ -423,6 +495,115 @@ out:
 	return 0;
 }
 
+/* the engine reads and writes whole blocks from word aligned buffers */
+static bool aes_sg_aligned(struct scatterlist *sg, size_t nbytes)
+{
+	while (sg && nbytes) {
+		if ((sg->offset & 3) ||
+			((sg->length & (AES_BLOCK_SIZE - 1)) &&
+			sg->length < nbytes))
+			return false;
+		nbytes -= min_t(size_t, nbytes, sg->length);
+		sg = sg_next(sg);
+	}
+	return true;
+}
+
+static void aes_xts_xor_tweaks(u8 *buf, int nblocks, be128 *t)
+{
+	int i;
+
+	for (i = 0; i < nblocks; i++) {
+		be128_xor((be128 *)(buf + i * AES_BLOCK_SIZE),
+			(be128 *)(buf + i * AES_BLOCK_SIZE), t);
+		gf128mul_x_ble(t, t);
+	}
+}
+
+/*
+ * Modes the engine can't do by itself, and requests whose scatterlists the
+ * engine can't walk, go through the driver's buffers a chunk at a time.
+ * CTR runs the counter blocks through ECB and xors the keystream into the
+ * data; XTS applies the tweaks around an ECB pass with the data key.
+ */
+static int aes_crypt_staged(struct tegra_aes_dev *dd,
+	struct ablkcipher_request *req)
+{
+	struct tegra_aes_ctx *ctx = dd->ctx;
+	unsigned long mode = dd->flags;
+	u8 *in = (u8 *)dd->buf_in, *out = (u8 *)dd->buf_out;
+	u8 ctr[AES_BLOCK_SIZE];
+	be128 t, t_chunk;
+	size_t off = 0, total = req->nbytes, count;
+	int nblocks, i, ret = 0;
+	int hw_mode = mode;
+
+	if (mode & FLAGS_CTR) {
+		memcpy(ctr, req->info, AES_BLOCK_SIZE);
+		hw_mode = FLAGS_ENCRYPT;
+	} else if (mode & FLAGS_XTS) {
+		crypto_cipher_encrypt_one(ctx->tweak, (u8 *)&t, req->info);
+		hw_mode = mode & FLAGS_ENCRYPT;
+	}
+
+	while (total) {
+		count = min_t(size_t, total, AES_HW_DMA_BUFFER_SIZE_BYTES);
+		nblocks = DIV_ROUND_UP(count, AES_BLOCK_SIZE);
+
+		if (mode & FLAGS_CTR) {
+			for (i = 0; i < nblocks; i++) {
+				memcpy(in + i * AES_BLOCK_SIZE, ctr,
+					AES_BLOCK_SIZE);
+				crypto_inc(ctr, AES_BLOCK_SIZE);
+			}
+		} else {
+			scatterwalk_map_and_copy(in, req->src, off, count, 0);
+			if (mode & FLAGS_XTS) {
+				t_chunk = t;
+				aes_xts_xor_tweaks(in, nblocks, &t);
+			}
+		}
+
+		ret = aes_start_crypt(dd, (u32)dd->dma_buf_in,
+			(u32)dd->dma_buf_out, nblocks, hw_mode, true);
+		if (ret < 0) {
+			dev_err(dd->dev, "aes_start_crypt fail(%d)\n", ret);
+			break;
+		}
+
+		if (mode & FLAGS_CTR) {
+			/* the counters are consumed, reuse the buffer */
+			scatterwalk_map_and_copy(in, req->src, off, count, 0);
+			crypto_xor(in, out, count);
+			out = in;
+		} else if (mode & FLAGS_XTS) {
+			aes_xts_xor_tweaks(out, nblocks, &t_chunk);
+		}
+		scatterwalk_map_and_copy(out, req->dst, off, count, 1);
+		out = (u8 *)dd->buf_out;
+
+		off += count;
+		total -= count;
+	}
+
+	if (mode & FLAGS_CTR)
+		memcpy(req->info, ctr, AES_BLOCK_SIZE);
+
+	return ret;
+}
+
+static int aes_sg_nents(struct scatterlist *sg, size_t nbytes)
+{
+	int nents = 0;
+
+	while (sg && nbytes) {
+		nents++;
+		nbytes -= min_t(size_t, nbytes, sg->length);
+		sg = sg_next(sg);
+	}
+	return nents;
+}
+
 static int tegra_aes_handle_req(struct tegra_aes_dev *dd)
 {
 	struct crypto_async_request *async_req, *backlog;
@@ -435,6 +616,9 @@ static int tegra_aes_handle_req(struct tegra_aes_dev *dd)
 	int count = 0;
 	dma_addr_t addr_in, addr_out;
 	struct scatterlist *in_sg, *out_sg;
+	size_t in_offset = 0, out_offset = 0;
+	int in_nents, out_nents;
+	bool reload;
 
 	if (!dd)
 		return -EINVAL;
@@ -456,12 +640,15 @@ static int tegra_aes_handle_req(struct tegra_aes_dev *dd)
 
 	dev_dbg(dd->dev, "%s: get new req\n", __func__);
 
-	if (!req->src || !req->dst)
+	if (!req->src || !req->dst) {
+		req->base.complete(&req->base, -EINVAL);
 		return -EINVAL;
+	}
 
 	/* take the hardware semaphore */
 	if (tegra_arb_mutex_lock_timeout(dd->res_id, ARB_SEMA_TIMEOUT) < 0) {
 		dev_err(dd->dev, "aes hardware not available\n");
+		req->base.complete(&req->base, -EBUSY);
 		return -EBUSY;
 	}
 
@@ -489,14 +676,33 @@ static int tegra_aes_handle_req(struct tegra_aes_dev *dd)
 	ctx->dd = dd;
 	dd->ctx = ctx;
 
-	if (ctx->flags & FLAGS_NEW_KEY) {
+	if (ctx->flags & FLAGS_USE_SSK) {
+		/* no key of our own, aes_set_key() selects the ssk */
+		aes_release_key_slot(ctx);
+		aes_set_key(dd);
+		ctx->flags &= ~FLAGS_NEW_KEY;
+		goto key_done;
+	}
+
+	/* the key stays in its slot until the slot is recycled */
+	reload = aes_get_key_slot(dd, ctx);
+	if (!ctx->slot) {
+		dev_err(dd->dev, "no key slot\n");
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (reload || (ctx->flags & FLAGS_NEW_KEY)) {
 		/* copy the key */
 		memset(dd->ivkey_base, 0, AES_HW_KEY_TABLE_LENGTH_BYTES);
 		memcpy(dd->ivkey_base, ctx->key, ctx->keylen);
 		aes_set_key(dd);
 		ctx->flags &= ~FLAGS_NEW_KEY;
+	} else {
+		aes_select_key_slot(dd, ctx->slot->slot_num);
 	}
 
+key_done:
 	if ((dd->flags & FLAGS_CBC) && dd->iv) {
 		/* set iv to the aes hw slot */
 		memcpy(dd->buf_in, dd->iv, dd->ivlen);
@@ -509,46 +715,77 @@ static int tegra_aes_handle_req(struct tegra_aes_dev *dd)
 		}
 	}
 
-	while (total) {
-		dev_dbg(dd->dev, "remain: %d\n", total);
-		ret = dma_map_sg(dd->dev, in_sg, 1, DMA_TO_DEVICE);
-		if (!ret) {
-			dev_err(dd->dev, "dma_map_sg() error\n");
-			goto out;
-		}
+	if ((dd->flags & (FLAGS_CTR | FLAGS_XTS)) ||
+		!aes_sg_aligned(in_sg, total) ||
+		!aes_sg_aligned(out_sg, total)) {
+		ret = aes_crypt_staged(dd, req);
+		if (!ret)
+			total = 0;
+		goto out;
+	}
 
-		ret = dma_map_sg(dd->dev, out_sg, 1, DMA_FROM_DEVICE);
-		if (!ret) {
-			dev_err(dd->dev, "dma_map_sg() error\n");
-			dma_unmap_sg(dd->dev, dd->in_sg,
-				1, DMA_TO_DEVICE);
-			goto out;
+	/* map the whole request once rather than an entry at a time */
+	in_nents = aes_sg_nents(in_sg, total);
+	out_nents = aes_sg_nents(out_sg, total);
+	if (in_sg == out_sg) {
+		ret = dma_map_sg(dd->dev, in_sg, in_nents, DMA_BIDIRECTIONAL);
+	} else {
+		ret = dma_map_sg(dd->dev, in_sg, in_nents, DMA_TO_DEVICE);
+		if (ret && !dma_map_sg(dd->dev, out_sg, out_nents,
+				DMA_FROM_DEVICE)) {
+			dma_unmap_sg(dd->dev, in_sg, in_nents, DMA_TO_DEVICE);
+			ret = 0;
 		}
+	}
+	if (!ret) {
+		dev_err(dd->dev, "dma_map_sg() error\n");
+		ret = -ENOMEM;
+		goto out;
+	}
+	ret = 0;
 
-		addr_in = sg_dma_address(in_sg);
-		addr_out = sg_dma_address(out_sg);
-		dd->flags |= FLAGS_FAST;
-		count = min((int)sg_dma_len(in_sg), (int)dma_max);
-		WARN_ON(sg_dma_len(in_sg) != sg_dma_len(out_sg));
+	dd->flags |= FLAGS_FAST;
+	while (total) {
+		dev_dbg(dd->dev, "remain: %d\n", total);
+		addr_in = sg_dma_address(in_sg) + in_offset;
+		addr_out = sg_dma_address(out_sg) + out_offset;
+		count = min_t(int, total, dma_max);
+		count = min_t(int, count, sg_dma_len(in_sg) - in_offset);
+		count = min_t(int, count, sg_dma_len(out_sg) - out_offset);
+		WARN_ON(count & (AES_BLOCK_SIZE - 1));
 		nblocks = DIV_ROUND_UP(count, AES_BLOCK_SIZE);
 
 		ret = aes_start_crypt(dd, addr_in, addr_out, nblocks,
 			dd->flags, true);
-
-		dma_unmap_sg(dd->dev, out_sg, 1, DMA_FROM_DEVICE);
-		dma_unmap_sg(dd->dev, in_sg, 1, DMA_TO_DEVICE);
-
 		if (ret < 0) {
 			dev_err(dd->dev, "aes_start_crypt fail(%d)\n", ret);
-			goto out;
+			break;
 		}
-		dd->flags &= ~FLAGS_FAST;
 
 		dev_dbg(dd->dev, "out: copied %d\n", count);
 		total -= count;
-		in_sg = sg_next(in_sg);
-		out_sg = sg_next(out_sg);
-		WARN_ON(((total != 0) && (!in_sg || !out_sg)));
+		in_offset += count;
+		if (in_offset == sg_dma_len(in_sg)) {
+			in_sg = sg_next(in_sg);
+			in_offset = 0;
+		}
+		out_offset += count;
+		if (out_offset == sg_dma_len(out_sg)) {
+			out_sg = sg_next(out_sg);
+			out_offset = 0;
+		}
+		if (WARN_ON(total && (!in_sg || !out_sg))) {
+			ret = -EINVAL;
+			break;
+		}
+	}
+	dd->flags &= ~FLAGS_FAST;
+
+	if (dd->in_sg == dd->out_sg) {
+		dma_unmap_sg(dd->dev, dd->in_sg, in_nents, DMA_BIDIRECTIONAL);
+	} else {
+		dma_unmap_sg(dd->dev, dd->out_sg, out_nents, DMA_FROM_DEVICE);
+		dma_unmap_sg(dd->dev, dd->in_sg, in_nents, DMA_TO_DEVICE);
 	}
 
 out:
@@ -569,7 +806,7 @@ static int tegra_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 {
 	struct tegra_aes_ctx *ctx = crypto_ablkcipher_ctx(tfm);
 	struct tegra_aes_dev *dd = aes_dev;
-	struct tegra_aes_slot *key_slot;
+	unsigned int hw_keylen;
 
 	if (!ctx || !dd) {
 		dev_err(dd->dev, "ctx=0x%x, dd=0x%x\n",
@@ -577,8 +814,12 @@ static int tegra_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 		return -EINVAL;
 	}
 
-	if ((keylen != AES_KEYSIZE_128) && (keylen != AES_KEYSIZE_192) &&
-		(keylen != AES_KEYSIZE_256)) {
+	/* xts takes the data key followed by the tweak key */
+	hw_keylen = ctx->tweak ? keylen / 2 : keylen;
+	if ((ctx->tweak && (keylen & 1)) ||
+		((hw_keylen != AES_KEYSIZE_128) &&
+		(hw_keylen != AES_KEYSIZE_192) &&
+		(hw_keylen != AES_KEYSIZE_256))) {
 		dev_err(dd->dev, "unsupported key size\n");
 		return -EINVAL;
 	}
@@ -588,20 +829,38 @@ static int tegra_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 	ctx->dd = dd;
 
 	if (key) {
-		if (!ctx->slot) {
-			key_slot = aes_find_key_slot(dd);
-			if (!key_slot) {
-				dev_err(dd->dev, "no empty slot\n");
-				return -ENOMEM;
-			}
-
-			ctx->slot = key_slot;
+		/* a slot is only claimed once the key gets used */
+		memcpy(ctx->key, key, hw_keylen);
+		ctx->keylen = hw_keylen;
+
+		if (ctx->tweak) {
+			int ret = crypto_cipher_setkey(ctx->tweak,
+				key + hw_keylen, hw_keylen);
+			if (ret)
+				return ret;
 		}
 
-		memcpy(ctx->key, key, keylen);
-		ctx->keylen = keylen;
+		if (ctx->fallback) {
+			int ret;
+
+			ctx->fallback->base.crt_flags &= ~CRYPTO_TFM_REQ_MASK;
+			ctx->fallback->base.crt_flags |=
+				crypto_ablkcipher_get_flags(tfm) &
+				CRYPTO_TFM_REQ_MASK;
+			ret = crypto_blkcipher_setkey(ctx->fallback, key,
+				keylen);
+			if (ret)
+				return ret;
+		}
+	} else {
+		/* the key lives in the ssk slot, keep its length */
+		ctx->keylen = hw_keylen;
 	}
 
+	if (key)
+		ctx->flags &= ~FLAGS_USE_SSK;
+	else
+		ctx->flags |= FLAGS_USE_SSK;
 	ctx->flags |= FLAGS_NEW_KEY;
 	dev_dbg(dd->dev, "done\n");
 	return 0;
@@ -617,7 +876,7 @@ static void aes_workqueue_handler(struct work_struct *work)
 	/* empty the crypto queue and then return */
 	do {
 		ret = tegra_aes_handle_req(dd);
-	} while (!ret);
+	} while (ret != -ENODATA);
 
 	aes_hw_deinit(dd);
 }
@@ -634,9 +893,27 @@ static irqreturn_t aes_irq(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+static int tegra_aes_crypt_fallback(struct ablkcipher_request *req,
+	struct tegra_aes_ctx *ctx, unsigned long mode)
+{
+	struct blkcipher_desc desc = {
+		.tfm = ctx->fallback,
+		.info = req->info,
+		.flags = req->base.flags,
+	};
+
+	if (mode & FLAGS_ENCRYPT)
+		return crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+			req->nbytes);
+	return crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+		req->nbytes);
+}
+
 static int tegra_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 {
 	struct tegra_aes_reqctx *rctx = ablkcipher_request_ctx(req);
+	struct tegra_aes_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
 	struct tegra_aes_dev *dd = aes_dev;
 	unsigned long flags;
 	int err = 0;
@@ -646,6 +923,13 @@ static int tegra_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 		!!(mode & FLAGS_ENCRYPT),
 		!!(mode & FLAGS_CBC));
 
+	if (!(mode & FLAGS_CTR) && (req->nbytes & (AES_BLOCK_SIZE - 1)))
+		return -EINVAL;
+
+	if (req->nbytes < min_hw_bytes && ctx->fallback &&
+		!(ctx->flags & FLAGS_USE_SSK))
+		return tegra_aes_crypt_fallback(req, ctx, mode);
+
 	rctx->mode = mode;
 
 	spin_lock_irqsave(&dd->lock, flags);
@@ -679,6 +963,21 @@ static int tegra_aes_cbc_decrypt(struct ablkcipher_request *req)
 	return tegra_aes_crypt(req, FLAGS_CBC);
 }
 
+static int tegra_aes_ctr_crypt(struct ablkcipher_request *req)
+{
+	return tegra_aes_crypt(req, FLAGS_ENCRYPT | FLAGS_CTR);
+}
+
+static int tegra_aes_xts_encrypt(struct ablkcipher_request *req)
+{
+	return tegra_aes_crypt(req, FLAGS_ENCRYPT | FLAGS_XTS);
+}
+
+static int tegra_aes_xts_decrypt(struct ablkcipher_request *req)
+{
+	return tegra_aes_crypt(req, FLAGS_XTS);
+}
+
 static int tegra_aes_get_random(struct crypto_rng *tfm, u8 *rdata,
 	unsigned int dlen)
 {
@@ -855,6 +1154,45 @@ void tegra_aes_cra_exit(struct crypto_tfm *tfm)
 		aes_release_key_slot(ctx);
 }
 
+static int tegra_aes_cra_cipher_init(struct crypto_tfm *tfm)
+{
+	struct tegra_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(tfm);
+
+	/* our algs are registered as disabled_<mode>(aes) */
+	if (!strncmp(name, "disabled_", 9))
+		name += 9;
+
+	if (!strcmp(name, "xts(aes)")) {
+		ctx->tweak = crypto_alloc_cipher("aes", 0, 0);
+		if (IS_ERR(ctx->tweak))
+			return PTR_ERR(ctx->tweak);
+	}
+
+	ctx->fallback = crypto_alloc_blkcipher(name, 0,
+		CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		pr_debug("%s: no fallback for %s\n", __func__, name);
+		ctx->fallback = NULL;
+	}
+
+	return tegra_aes_cra_init(tfm);
+}
+
+static void tegra_aes_cra_cipher_exit(struct crypto_tfm *tfm)
+{
+	struct tegra_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	if (ctx->fallback)
+		crypto_free_blkcipher(ctx->fallback);
+	ctx->fallback = NULL;
+	if (ctx->tweak)
+		crypto_free_cipher(ctx->tweak);
+	ctx->tweak = NULL;
+
+	tegra_aes_cra_exit(tfm);
+}
+
 static struct crypto_alg algs[] = {
 	{
 		.cra_name = "disabled_ecb(aes)",
@@ -866,8 +1204,8 @@ static struct crypto_alg algs[] = {
 		.cra_alignmask = 3,
 		.cra_type = &crypto_ablkcipher_type,
 		.cra_module = THIS_MODULE,
-		.cra_init = tegra_aes_cra_init,
-		.cra_exit = tegra_aes_cra_exit,
+		.cra_init = tegra_aes_cra_cipher_init,
+		.cra_exit = tegra_aes_cra_cipher_exit,
 		.cra_u.ablkcipher = {
 			.min_keysize = AES_MIN_KEY_SIZE,
 			.max_keysize = AES_MAX_KEY_SIZE,
@@ -885,8 +1223,8 @@ static struct crypto_alg algs[] = {
 		.cra_alignmask = 3,
 		.cra_type = &crypto_ablkcipher_type,
 		.cra_module = THIS_MODULE,
-		.cra_init = tegra_aes_cra_init,
-		.cra_exit = tegra_aes_cra_exit,
+		.cra_init = tegra_aes_cra_cipher_init,
+		.cra_exit = tegra_aes_cra_cipher_exit,
 		.cra_u.ablkcipher = {
 			.min_keysize = AES_MIN_KEY_SIZE,
 			.max_keysize = AES_MAX_KEY_SIZE,
@@ -895,6 +1233,46 @@ static struct crypto_alg algs[] = {
 			.encrypt = tegra_aes_cbc_encrypt,
 			.decrypt = tegra_aes_cbc_decrypt,
 		}
+	}, {
+		.cra_name = "disabled_ctr(aes)",
+		.cra_driver_name = "ctr-aes-tegra",
+		.cra_priority = 100,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_blocksize = 1,
+		.cra_ctxsize  = sizeof(struct tegra_aes_ctx),
+		.cra_alignmask = 3,
+		.cra_type = &crypto_ablkcipher_type,
+		.cra_module = THIS_MODULE,
+		.cra_init = tegra_aes_cra_cipher_init,
+		.cra_exit = tegra_aes_cra_cipher_exit,
+		.cra_u.ablkcipher = {
+			.min_keysize = AES_MIN_KEY_SIZE,
+			.max_keysize = AES_MAX_KEY_SIZE,
+			.ivsize = AES_BLOCK_SIZE,
+			.setkey = tegra_aes_setkey,
+			.encrypt = tegra_aes_ctr_crypt,
+			.decrypt = tegra_aes_ctr_crypt,
+		}
+	}, {
+		.cra_name = "disabled_xts(aes)",
+		.cra_driver_name = "xts-aes-tegra",
+		.cra_priority = 100,
+		.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_blocksize = AES_BLOCK_SIZE,
+		.cra_ctxsize  = sizeof(struct tegra_aes_ctx),
+		.cra_alignmask = 3,
+		.cra_type = &crypto_ablkcipher_type,
+		.cra_module = THIS_MODULE,
+		.cra_init = tegra_aes_cra_cipher_init,
+		.cra_exit = tegra_aes_cra_cipher_exit,
+		.cra_u.ablkcipher = {
+			.min_keysize = 2 * AES_MIN_KEY_SIZE,
+			.max_keysize = 2 * AES_MAX_KEY_SIZE,
+			.ivsize = AES_BLOCK_SIZE,
+			.setkey = tegra_aes_setkey,
+			.encrypt = tegra_aes_xts_encrypt,
+			.decrypt = tegra_aes_xts_decrypt,
+		}
 	}, {
 		.cra_name = "disabled_ansi_cprng",
 		.cra_driver_name = "rng-aes-tegra",
@@ -0,0 +1,593 @@
+/*
+ * tegra_dma.c dmaengine front end for the NVIDIA Tegra APB DMA controller
+ *
+ * Copyright (c) 2010, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* Supports:
+ * Slave scatter-gather and cyclic transfers on the Tegra APB DMA, built
+ * on the channel machinery in arch/arm/mach-tegra/dma.c.
+ *
+ * The APB DMA always has a peripheral on its APB side, so there is no
+ * memory to memory (DMA_MEMCPY) capability.
+ */
+
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+
+#include <mach/dma.h>
+
+#define DRIVER_NAME "tegra-dma"
+
+#define TEGRA_DMAE_NR_CHANNELS	4
+
+struct tegra_dmae_chan;
+
+struct tegra_dmae_desc {
+	struct dma_async_tx_descriptor	txd;
+	struct list_head		node;
+	struct tegra_dmae_chan		*tdc;
+	bool				cyclic;
+	bool				issued;
+	unsigned int			nr_reqs;
+	struct tegra_dma_req		*reqs;
+	struct scatterlist		*sg;
+};
+
+struct tegra_dmae_chan {
+	struct dma_chan			chan;
+	struct tegra_dma_channel	*ch;
+	int				mode;
+	spinlock_t			lock;
+	dma_cookie_t			last_completed_cookie;
+	struct list_head		queue;	/* submitted, not issued */
+	struct list_head		active;	/* queued on the channel */
+	struct list_head		done;	/* waiting for the tasklet */
+	struct tegra_dmae_desc		*cyclic;
+	unsigned int			periods;
+	struct dma_slave_config		config;
+	struct tasklet_struct		tasklet;
+};
+
+struct tegra_dmae {
+	struct dma_device		dma;
+	struct tegra_dmae_chan		channels[TEGRA_DMAE_NR_CHANNELS];
+};
+
+static struct tegra_dmae_chan *to_tegra_dmae_chan(struct dma_chan *chan)
+{
+	return container_of(chan, struct tegra_dmae_chan, chan);
+}
+
+static struct tegra_dmae_desc *tegra_dmae_alloc_desc(
+	struct tegra_dmae_chan *tdc, unsigned int nr_reqs, unsigned int nr_sg)
+{
+	struct tegra_dmae_desc *desc;
+
+	desc = kzalloc(sizeof(*desc) + nr_reqs * sizeof(*desc->reqs) +
+		nr_sg * sizeof(*desc->sg), GFP_NOWAIT);
+	if (!desc)
+		return NULL;
+
+	desc->tdc = tdc;
+	desc->nr_reqs = nr_reqs;
+	desc->reqs = (struct tegra_dma_req *)(desc + 1);
+	if (nr_sg) {
+		desc->sg = (struct scatterlist *)(desc->reqs + nr_reqs);
+		sg_init_table(desc->sg, nr_sg);
+	}
+	INIT_LIST_HEAD(&desc->node);
+	return desc;
+}
+
+static void tegra_dmae_req_complete(struct tegra_dma_req *req)
+{
+	struct tegra_dmae_desc *desc = req->dev;
+	struct tegra_dmae_chan *tdc = desc->tdc;
+	unsigned long flags;
+
+	/* Aborted requests belong to tegra_dmae_terminate_all() */
+	if (req->status != TEGRA_DMA_REQ_SUCCESS)
+		return;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	if (!desc->issued) {
+		spin_unlock_irqrestore(&tdc->lock, flags);
+		return;
+	}
+
+	if (desc->cyclic) {
+		tdc->periods++;
+		tegra_dma_enqueue_req(tdc->ch, req);
+	} else {
+		desc->issued = false;
+		list_move_tail(&desc->node, &tdc->done);
+	}
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	tasklet_schedule(&tdc->tasklet);
+}
+
+static void tegra_dmae_req_threshold(struct tegra_dma_req *req)
+{
+	struct tegra_dmae_desc *desc = req->dev;
+	struct tegra_dmae_chan *tdc = desc->tdc;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	if (desc->issued)
+		tdc->periods++;
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	tasklet_schedule(&tdc->tasklet);
+}
+
+static void tegra_dmae_tasklet(unsigned long data)
+{
+	struct tegra_dmae_chan *tdc = (struct tegra_dmae_chan *)data;
+	struct tegra_dmae_desc *desc;
+	dma_async_tx_callback callback = NULL;
+	void *param = NULL;
+	unsigned int periods = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	while (!list_empty(&tdc->done)) {
+		desc = list_first_entry(&tdc->done, struct tegra_dmae_desc,
+			node);
+		list_del(&desc->node);
+		tdc->last_completed_cookie = desc->txd.cookie;
+		spin_unlock_irqrestore(&tdc->lock, flags);
+
+		if (desc->txd.callback)
+			desc->txd.callback(desc->txd.callback_param);
+		kfree(desc);
+
+		spin_lock_irqsave(&tdc->lock, flags);
+	}
+
+	if (tdc->cyclic) {
+		callback = tdc->cyclic->txd.callback;
+		param = tdc->cyclic->txd.callback_param;
+		periods = tdc->periods;
+	}
+	tdc->periods = 0;
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	while (callback && periods--)
+		callback(param);
+}
+
+static void tegra_dmae_free_desc_list(struct tegra_dmae_chan *tdc,
+	struct list_head *list)
+{
+	struct tegra_dmae_desc *desc, *tmp;
+	unsigned int i;
+
+	list_for_each_entry_safe(desc, tmp, list, node) {
+		for (i = 0; i < desc->nr_reqs; i++)
+			tegra_dma_dequeue_req(tdc->ch, &desc->reqs[i]);
+		list_del(&desc->node);
+		kfree(desc);
+	}
+}
+
+static void tegra_dmae_terminate_all(struct tegra_dmae_chan *tdc)
+{
+	struct tegra_dmae_desc *desc;
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	list_for_each_entry(desc, &tdc->active, node)
+		desc->issued = false;
+	list_splice_init(&tdc->active, &list);
+	list_splice_init(&tdc->queue, &list);
+	tdc->cyclic = NULL;
+	tdc->periods = 0;
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	/* Dequeue outside the lock, it calls back into
+	 * tegra_dmae_req_complete() for the request in flight.
+	 */
+	tegra_dmae_free_desc_list(tdc, &list);
+}
+
+static dma_cookie_t tegra_dmae_tx_submit(struct dma_async_tx_descriptor *txd)
+{
+	struct tegra_dmae_desc *desc = container_of(txd,
+		struct tegra_dmae_desc, txd);
+	struct tegra_dmae_chan *tdc = desc->tdc;
+	dma_cookie_t cookie;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	cookie = txd->chan->cookie;
+	if (++cookie < 0)
+		cookie = 1;
+	txd->chan->cookie = cookie;
+	txd->cookie = cookie;
+	list_add_tail(&desc->node, &tdc->queue);
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	return cookie;
+}
+
+static void tegra_dmae_issue_pending(struct dma_chan *chan)
+{
+	struct tegra_dmae_chan *tdc = to_tegra_dmae_chan(chan);
+	struct tegra_dmae_desc *desc, *tmp;
+	unsigned long flags;
+	unsigned int i;
+	int ret;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	list_for_each_entry_safe(desc, tmp, &tdc->queue, node) {
+		list_move_tail(&desc->node, &tdc->active);
+		desc->issued = true;
+		if (desc->cyclic)
+			tdc->cyclic = desc;
+
+		for (i = 0; i < desc->nr_reqs; i++) {
+			ret = tegra_dma_enqueue_req(tdc->ch, &desc->reqs[i]);
+			if (ret < 0) {
+				dev_err(chan->device->dev, "failed to queue "
+					"request %d: %d\n", desc->txd.cookie,
+					ret);
+				break;
+			}
+		}
+	}
+	spin_unlock_irqrestore(&tdc->lock, flags);
+}
+
+static void tegra_dmae_setup_req(struct tegra_dmae_chan *tdc,
+	struct tegra_dmae_desc *desc, struct tegra_dma_req *req,
+	enum dma_data_direction direction, dma_addr_t mem_addr)
+{
+	struct tegra_dma_slave *slave = tdc->chan.private;
+	struct dma_slave_config *config = &tdc->config;
+
+	req->complete = tegra_dmae_req_complete;
+	req->dev = desc;
+	req->req_sel = slave->req_sel;
+
+	if (direction == DMA_FROM_DEVICE) {
+		req->to_memory = 1;
+		req->source_addr = config->src_addr;
+		req->source_bus_width = config->src_addr_width * 8;
+		req->source_wrap = 4;
+		req->dest_addr = mem_addr;
+		req->dest_bus_width = 32;
+		req->dest_wrap = 0;
+	} else {
+		req->to_memory = 0;
+		req->dest_addr = config->dst_addr;
+		req->dest_bus_width = config->dst_addr_width * 8;
+		req->dest_wrap = 4;
+		req->source_addr = mem_addr;
+		req->source_bus_width = 32;
+		req->source_wrap = 0;
+	}
+}
+
+static bool tegra_dmae_slave_ready(struct tegra_dmae_chan *tdc,
+	enum dma_data_direction direction)
+{
+	if (!tdc->chan.private)
+		return false;
+	if (direction == DMA_FROM_DEVICE)
+		return tdc->config.src_addr != 0;
+	if (direction == DMA_TO_DEVICE)
+		return tdc->config.dst_addr != 0;
+	return false;
+}
+
+static struct dma_async_tx_descriptor *tegra_dmae_prep_slave_sg(
+	struct dma_chan *chan, struct scatterlist *sgl, unsigned int sg_len,
+	enum dma_data_direction direction, unsigned long flags)
+{
+	struct tegra_dmae_chan *tdc = to_tegra_dmae_chan(chan);
+	struct tegra_dmae_desc *desc;
+	struct scatterlist *sg;
+	unsigned int i;
+
+	if (!sg_len || tdc->mode != TEGRA_DMA_MODE_ONESHOT ||
+	    !tegra_dmae_slave_ready(tdc, direction))
+		return NULL;
+
+	for_each_sg(sgl, sg, sg_len, i) {
+		if (!sg_dma_len(sg) ||
+		    sg_dma_len(sg) > TEGRA_DMA_MAX_TRANSFER_SIZE ||
+		    (sg_dma_len(sg) | sg_dma_address(sg)) & 0x3) {
+			dev_err(chan->device->dev, "bad segment %u\n", i);
+			return NULL;
+		}
+	}
+
+	desc = tegra_dmae_alloc_desc(tdc, 1, sg_len);
+	if (!desc)
+		return NULL;
+
+	/* Copy the list, the caller's one need not outlive the prep */
+	for_each_sg(sgl, sg, sg_len, i) {
+		sg_dma_address(&desc->sg[i]) = sg_dma_address(sg);
+		sg_dma_len(&desc->sg[i]) = sg_dma_len(sg);
+	}
+
+	tegra_dmae_setup_req(tdc, desc, &desc->reqs[0], direction,
+		sg_dma_address(sgl));
+	desc->reqs[0].sg = desc->sg;
+	desc->reqs[0].sg_len = sg_len;
+
+	dma_async_tx_descriptor_init(&desc->txd, chan);
+	desc->txd.tx_submit = tegra_dmae_tx_submit;
+	desc->txd.flags = flags;
+	return &desc->txd;
+}
+
+/**
+ * tegra_dmae_prep_cyclic - prepare a cyclic transfer over a ring buffer
+ * @chan: channel obtained through tegra_dmae_filter()
+ * @buf_addr: bus address of the ring
+ * @buf_len: ring length, a multiple of two periods
+ * @period_len: bytes between callbacks
+ * @direction: DMA_TO_DEVICE or DMA_FROM_DEVICE
+ *
+ * The ring runs until DMA_TERMINATE_ALL, calling the descriptor callback
+ * once per period. It is backed by a continuous double buffered channel,
+ * so the channel must be idle and this may sleep. The channel stays in
+ * cyclic mode until it is released.
+ */
+struct dma_async_tx_descriptor *tegra_dmae_prep_cyclic(struct dma_chan *chan,
+	dma_addr_t buf_addr, size_t buf_len, size_t period_len,
+	enum dma_data_direction direction)
+{
+	struct tegra_dmae_chan *tdc = to_tegra_dmae_chan(chan);
+	struct tegra_dmae_desc *desc;
+	struct tegra_dma_channel *ch;
+	size_t req_len = period_len * 2;
+	unsigned long flags;
+	unsigned int i;
+	bool idle;
+
+	might_sleep();
+
+	if (!period_len || (period_len & 0x3) || (buf_addr & 0x3) ||
+	    req_len > TEGRA_DMA_MAX_TRANSFER_SIZE || buf_len % req_len ||
+	    !tegra_dmae_slave_ready(tdc, direction))
+		return NULL;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	idle = list_empty(&tdc->queue) && list_empty(&tdc->active);
+	spin_unlock_irqrestore(&tdc->lock, flags);
+	if (!idle)
+		return NULL;
+
+	if (tdc->mode != TEGRA_DMA_MODE_CONTINUOUS_DOUBLE) {
+		ch = tegra_dma_allocate_channel(
+			TEGRA_DMA_MODE_CONTINUOUS_DOUBLE);
+		if (IS_ERR_OR_NULL(ch))
+			return NULL;
+		tegra_dma_free_channel(tdc->ch);
+		tdc->ch = ch;
+		tdc->mode = TEGRA_DMA_MODE_CONTINUOUS_DOUBLE;
+	}
+
+	desc = tegra_dmae_alloc_desc(tdc, buf_len / req_len, 0);
+	if (!desc)
+		return NULL;
+
+	desc->cyclic = true;
+	for (i = 0; i < desc->nr_reqs; i++) {
+		tegra_dmae_setup_req(tdc, desc, &desc->reqs[i], direction,
+			buf_addr + i * req_len);
+		desc->reqs[i].threshold = tegra_dmae_req_threshold;
+		desc->reqs[i].size = req_len;
+	}
+
+	dma_async_tx_descriptor_init(&desc->txd, chan);
+	desc->txd.tx_submit = tegra_dmae_tx_submit;
+	return &desc->txd;
+}
+EXPORT_SYMBOL(tegra_dmae_prep_cyclic);
+
+static int tegra_dmae_control(struct dma_chan *chan, enum dma_ctrl_cmd cmd,
+	unsigned long arg)
+{
+	struct tegra_dmae_chan *tdc = to_tegra_dmae_chan(chan);
+	struct dma_slave_config *config;
+
+	switch (cmd) {
+	case DMA_TERMINATE_ALL:
+		tegra_dmae_terminate_all(tdc);
+		return 0;
+
+	case DMA_SLAVE_CONFIG:
+		config = (struct dma_slave_config *)arg;
+		if (config->src_addr_width > DMA_SLAVE_BUSWIDTH_4_BYTES ||
+		    config->dst_addr_width > DMA_SLAVE_BUSWIDTH_4_BYTES ||
+		    (config->src_addr & 0x3) || (config->dst_addr & 0x3))
+			return -EINVAL;
+		tdc->config = *config;
+		if (!tdc->config.src_addr_width)
+			tdc->config.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+		if (!tdc->config.dst_addr_width)
+			tdc->config.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+		return 0;
+
+	default:
+		return -ENXIO;
+	}
+}
+
+static enum dma_status tegra_dmae_tx_status(struct dma_chan *chan,
+	dma_cookie_t cookie, struct dma_tx_state *txstate)
+{
+	struct tegra_dmae_chan *tdc = to_tegra_dmae_chan(chan);
+	dma_cookie_t last_used;
+	dma_cookie_t last_complete;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	last_complete = tdc->last_completed_cookie;
+	last_used = chan->cookie;
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	dma_set_tx_state(txstate, last_complete, last_used, 0);
+	return dma_async_is_complete(cookie, last_complete, last_used);
+}
+
+static int tegra_dmae_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct tegra_dmae_chan *tdc = to_tegra_dmae_chan(chan);
+
+	tdc->ch = tegra_dma_allocate_channel(TEGRA_DMA_MODE_ONESHOT);
+	if (IS_ERR_OR_NULL(tdc->ch)) {
+		tdc->ch = NULL;
+		return -EBUSY;
+	}
+	tdc->mode = TEGRA_DMA_MODE_ONESHOT;
+
+	chan->cookie = 1;
+	tdc->last_completed_cookie = 1;
+	return 0;
+}
+
+static void tegra_dmae_free_chan_resources(struct dma_chan *chan)
+{
+	struct tegra_dmae_chan *tdc = to_tegra_dmae_chan(chan);
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	tegra_dmae_terminate_all(tdc);
+	tasklet_kill(&tdc->tasklet);
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	list_splice_init(&tdc->done, &list);
+	spin_unlock_irqrestore(&tdc->lock, flags);
+	tegra_dmae_free_desc_list(tdc, &list);
+
+	tegra_dma_free_channel(tdc->ch);
+	tdc->ch = NULL;
+	memset(&tdc->config, 0, sizeof(tdc->config));
+}
+
+/**
+ * tegra_dmae_filter - dma_request_channel() filter for Tegra slave channels
+ * @chan: candidate channel
+ * @param: struct tegra_dma_slave describing the peripheral
+ */
+bool tegra_dmae_filter(struct dma_chan *chan, void *param)
+{
+	if (strcmp(dev_name(chan->device->dev), DRIVER_NAME))
+		return false;
+
+	chan->private = param;
+	return true;
+}
+EXPORT_SYMBOL(tegra_dmae_filter);
+
+static int __devinit tegra_dmae_probe(struct platform_device *pdev)
+{
+	struct tegra_dmae *td;
+	int i;
+	int err;
+
+	td = kzalloc(sizeof(*td), GFP_KERNEL);
+	if (!td)
+		return -ENOMEM;
+
+	td->dma.device_alloc_chan_resources	= tegra_dmae_alloc_chan_resources;
+	td->dma.device_free_chan_resources	= tegra_dmae_free_chan_resources;
+	td->dma.device_tx_status		= tegra_dmae_tx_status;
+	td->dma.device_issue_pending		= tegra_dmae_issue_pending;
+
+	dma_cap_set(DMA_SLAVE, td->dma.cap_mask);
+	dma_cap_set(DMA_PRIVATE, td->dma.cap_mask);
+	td->dma.device_prep_slave_sg = tegra_dmae_prep_slave_sg;
+	td->dma.device_control = tegra_dmae_control;
+
+	td->dma.dev = &pdev->dev;
+
+	INIT_LIST_HEAD(&td->dma.channels);
+
+	for (i = 0; i < TEGRA_DMAE_NR_CHANNELS; i++, td->dma.chancnt++) {
+		struct tegra_dmae_chan *tdc = &td->channels[i];
+
+		tdc->chan.device = &td->dma;
+		tdc->chan.cookie = 1;
+		tdc->chan.chan_id = i;
+		spin_lock_init(&tdc->lock);
+		INIT_LIST_HEAD(&tdc->queue);
+		INIT_LIST_HEAD(&tdc->active);
+		INIT_LIST_HEAD(&tdc->done);
+		tasklet_init(&tdc->tasklet, tegra_dmae_tasklet,
+			(unsigned long)tdc);
+
+		list_add_tail(&tdc->chan.device_node, &td->dma.channels);
+	}
+
+	err = dma_async_device_register(&td->dma);
+	if (err) {
+		dev_err(&pdev->dev, "Failed to register async device\n");
+		kfree(td);
+		return err;
+	}
+
+	platform_set_drvdata(pdev, td);
+	return 0;
+}
+
+static int __devexit tegra_dmae_remove(struct platform_device *pdev)
+{
+	struct tegra_dmae *td = platform_get_drvdata(pdev);
+
+	dma_async_device_unregister(&td->dma);
+	kfree(td);
+	platform_set_drvdata(pdev, NULL);
+	return 0;
+}
+
+static struct platform_driver tegra_dmae_driver = {
+	.driver = {
+		.name	= DRIVER_NAME,
+		.owner  = THIS_MODULE,
+	},
+	.probe	= tegra_dmae_probe,
+	.remove	= __devexit_p(tegra_dmae_remove),
+};
+
+static int __init tegra_dmae_init(void)
+{
+	return platform_driver_register(&tegra_dmae_driver);
+}
+subsys_initcall(tegra_dmae_init);
+
+static void __exit tegra_dmae_exit(void)
+{
+	platform_driver_unregister(&tegra_dmae_driver);
+}
+module_exit(tegra_dmae_exit);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("NVIDIA Tegra APB DMA dmaengine driver");
+MODULE_ALIAS("platform:"DRIVER_NAME);
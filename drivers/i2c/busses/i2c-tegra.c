@@ -24,16 +24,27 @@
 #include <linux/interrupt.h>
 #include <linux/delay.h>
 #include <linux/slab.h>
+#include <linux/dma-mapping.h>
 #include <linux/i2c-tegra.h>
 
 #include <asm/unaligned.h>
 
 #include <mach/clk.h>
+#include <mach/dma.h>
 #include <mach/pinmux.h>
 
 #define TEGRA_I2C_TIMEOUT			(msecs_to_jiffies(1000))
 #define TEGRA_I2C_RETRIES			3
 #define BYTES_PER_FIFO_WORD			4
+#define I2C_FIFO_DEPTH				8
+#define I2C_PACKET_HEADER_WORDS			3
+#define I2C_MAX_PAYLOAD				4096
+
+/* Staging buffers for batched packets; transfers that do not fit in the
+ * FIFO move through them by APB DMA.
+ */
+#define TEGRA_I2C_BUF_LEN			PAGE_SIZE
+#define TEGRA_I2C_BUF_WORDS	(TEGRA_I2C_BUF_LEN / BYTES_PER_FIFO_WORD)
 
 #define I2C_CNFG				0x000
 #define I2C_CNFG_DEBOUNCE_CNT_SHIFT		12
@@ -143,9 +154,30 @@ struct tegra_i2c_dev {
 	int last_mux_len;
 	unsigned long last_bus_clk;
 	u16 slave_addr;
+
+	/* packet batching, fed by pio or dma */
+	bool batch;
+	u32 *tx_buf;
+	dma_addr_t tx_buf_phys;
+	u32 *tx_pos;
+	size_t tx_words;
+	u32 *rx_buf;
+	dma_addr_t rx_buf_phys;
+	u32 *rx_pos;
+	size_t rx_words;
+	struct tegra_dma_channel *dma_chan;
+	struct tegra_dma_req dma_req;
+	struct completion dma_complete;
+
 	struct tegra_i2c_bus busses[1];
 };
 
+static const unsigned long tegra_i2c_req_sels[] = {
+	TEGRA_DMA_REQ_SEL_I2C,
+	TEGRA_DMA_REQ_SEL_I2C2,
+	TEGRA_DMA_REQ_SEL_I2C3,
+};
+
 static void dvc_writel(struct tegra_i2c_dev *i2c_dev, u32 val, unsigned long reg)
 {
 	writel(val, i2c_dev->base + reg);
@@ -159,18 +191,22 @@ static u32 dvc_readl(struct tegra_i2c_dev *i2c_dev, unsigned long reg)
 /* i2c_writel and i2c_readl will offset the register if necessary to talk
  * to the I2C block inside the DVC block
  */
-static void i2c_writel(struct tegra_i2c_dev *i2c_dev, u32 val, unsigned long reg)
+static unsigned long tegra_i2c_reg(struct tegra_i2c_dev *i2c_dev,
+	unsigned long reg)
 {
 	if (i2c_dev->is_dvc)
 		reg += (reg >= I2C_TX_FIFO) ? 0x10 : 0x40;
-	writel(val, i2c_dev->base + reg);
+	return reg;
+}
+
+static void i2c_writel(struct tegra_i2c_dev *i2c_dev, u32 val, unsigned long reg)
+{
+	writel(val, i2c_dev->base + tegra_i2c_reg(i2c_dev, reg));
 }
 
 static u32 i2c_readl(struct tegra_i2c_dev *i2c_dev, unsigned long reg)
 {
-	if (i2c_dev->is_dvc)
-		reg += (reg >= I2C_TX_FIFO) ? 0x10 : 0x40;
-	return readl(i2c_dev->base + reg);
+	return readl(i2c_dev->base + tegra_i2c_reg(i2c_dev, reg));
 }
 
 static void tegra_i2c_mask_irq(struct tegra_i2c_dev *i2c_dev, u32 mask)
@@ -295,6 +331,40 @@ static int tegra_i2c_fill_tx_fifo(struct tegra_i2c_dev *i2c_dev)
 	return 0;
 }
 
+/* batched packets are staged word aligned, each packet padded to a word */
+static void tegra_i2c_fill_tx_words(struct tegra_i2c_dev *i2c_dev)
+{
+	u32 val = i2c_readl(i2c_dev, I2C_FIFO_STATUS);
+	int tx_fifo_avail = (val & I2C_FIFO_STATUS_TX_MASK) >>
+		I2C_FIFO_STATUS_TX_SHIFT;
+
+	while (tx_fifo_avail-- > 0 && i2c_dev->tx_words) {
+		i2c_writel(i2c_dev, *i2c_dev->tx_pos++, I2C_TX_FIFO);
+		i2c_dev->tx_words--;
+	}
+}
+
+static void tegra_i2c_empty_rx_words(struct tegra_i2c_dev *i2c_dev)
+{
+	u32 val = i2c_readl(i2c_dev, I2C_FIFO_STATUS);
+	int rx_fifo_avail = (val & I2C_FIFO_STATUS_RX_MASK) >>
+		I2C_FIFO_STATUS_RX_SHIFT;
+
+	while (rx_fifo_avail-- > 0 && i2c_dev->rx_words) {
+		*i2c_dev->rx_pos++ = i2c_readl(i2c_dev, I2C_RX_FIFO);
+		i2c_dev->rx_words--;
+	}
+}
+
+static void tegra_i2c_set_tx_trig(struct tegra_i2c_dev *i2c_dev, u32 trig)
+{
+	u32 val = i2c_readl(i2c_dev, I2C_FIFO_CONTROL);
+
+	val &= ~(7 << I2C_FIFO_CONTROL_TX_TRIG_SHIFT);
+	val |= trig << I2C_FIFO_CONTROL_TX_TRIG_SHIFT;
+	i2c_writel(i2c_dev, val, I2C_FIFO_CONTROL);
+}
+
 /* One of the Tegra I2C blocks is inside the DVC (Digital Voltage Controller)
  * block.  This block is identical to the rest of the I2C blocks, except that
  * it only supports master mode, it has registers moved around, and it needs
@@ -419,24 +489,40 @@ static irqreturn_t tegra_i2c_isr(int irq, void *dev_id)
 		goto err;
 	}
 
-	if (i2c_dev->msg_read && (status & I2C_INT_RX_FIFO_DATA_REQ)) {
-		if (i2c_dev->msg_buf_remaining)
-			tegra_i2c_empty_rx_fifo(i2c_dev);
-		else
-			BUG();
-	}
+	if (i2c_dev->batch) {
+		if (status & I2C_INT_RX_FIFO_DATA_REQ)
+			tegra_i2c_empty_rx_words(i2c_dev);
 
-	if (!i2c_dev->msg_read && (status & I2C_INT_TX_FIFO_DATA_REQ)) {
-		if (i2c_dev->msg_buf_remaining)
-			tegra_i2c_fill_tx_fifo(i2c_dev);
-		else
-			tegra_i2c_mask_irq(i2c_dev, I2C_INT_TX_FIFO_DATA_REQ);
+		if (status & I2C_INT_TX_FIFO_DATA_REQ) {
+			if (i2c_dev->tx_words)
+				tegra_i2c_fill_tx_words(i2c_dev);
+			else
+				tegra_i2c_mask_irq(i2c_dev,
+					I2C_INT_TX_FIFO_DATA_REQ);
+		}
+	} else {
+		if (i2c_dev->msg_read && (status & I2C_INT_RX_FIFO_DATA_REQ)) {
+			if (i2c_dev->msg_buf_remaining)
+				tegra_i2c_empty_rx_fifo(i2c_dev);
+			else
+				BUG();
+		}
+
+		if (!i2c_dev->msg_read && (status & I2C_INT_TX_FIFO_DATA_REQ)) {
+			if (i2c_dev->msg_buf_remaining)
+				tegra_i2c_fill_tx_fifo(i2c_dev);
+			else
+				tegra_i2c_mask_irq(i2c_dev,
+					I2C_INT_TX_FIFO_DATA_REQ);
+		}
 	}
 
+	/* in a batch only the last packet has I2C_HEADER_IE_ENABLE set */
 	if (status & I2C_INT_PACKET_XFER_COMPLETE)
 		i2c_dev->msg_transfer_complete = 1;
 
-	if (i2c_dev->msg_transfer_complete && !i2c_dev->msg_buf_remaining)
+	if (i2c_dev->msg_transfer_complete && !i2c_dev->msg_buf_remaining &&
+		!i2c_dev->rx_words)
 		complete(&i2c_dev->msg_complete);
 
 	i2c_writel(i2c_dev, status, I2C_INT_STATUS);
@@ -480,6 +566,21 @@ err:
 	return IRQ_HANDLED;
 }
 
+static u32 tegra_i2c_io_header(struct i2c_msg *msg, int stop)
+{
+	u32 io_header = msg->addr << I2C_HEADER_SLAVE_ADDR_SHIFT;
+
+	if (!stop)
+		io_header |= I2C_HEADER_REPEAT_START;
+	if (msg->flags & I2C_M_TEN)
+		io_header |= I2C_HEADER_10BIT_ADDR;
+	if (msg->flags & I2C_M_IGNORE_NAK)
+		io_header |= I2C_HEADER_CONT_ON_NAK;
+	if (msg->flags & I2C_M_RD)
+		io_header |= I2C_HEADER_READ;
+	return io_header;
+}
+
 static int tegra_i2c_xfer_msg(struct tegra_i2c_bus *i2c_bus,
 	struct i2c_msg *msg, int stop)
 {
@@ -509,16 +610,8 @@ static int tegra_i2c_xfer_msg(struct tegra_i2c_bus *i2c_bus,
 	i2c_dev->payload_size = msg->len - 1;
 	i2c_writel(i2c_dev, i2c_dev->payload_size, I2C_TX_FIFO);
 
-	i2c_dev->io_header = msg->addr << I2C_HEADER_SLAVE_ADDR_SHIFT;
-	i2c_dev->io_header |= I2C_HEADER_IE_ENABLE;
-	if (!stop)
-		i2c_dev->io_header |= I2C_HEADER_REPEAT_START;
-	if (msg->flags & I2C_M_TEN)
-		i2c_dev->io_header |= I2C_HEADER_10BIT_ADDR;
-	if (msg->flags & I2C_M_IGNORE_NAK)
-		i2c_dev->io_header |= I2C_HEADER_CONT_ON_NAK;
-	if (msg->flags & I2C_M_RD)
-		i2c_dev->io_header |= I2C_HEADER_READ;
+	i2c_dev->io_header = tegra_i2c_io_header(msg, stop) |
+		I2C_HEADER_IE_ENABLE;
 	i2c_writel(i2c_dev, i2c_dev->io_header, I2C_TX_FIFO);
 
 	if (!(msg->flags & I2C_M_RD))
@@ -565,12 +658,221 @@ static int tegra_i2c_xfer_msg(struct tegra_i2c_bus *i2c_bus,
 	return -EIO;
 }
 
+static void tegra_i2c_dma_complete(struct tegra_dma_req *req)
+{
+	struct tegra_i2c_dev *i2c_dev = req->dev;
+
+	complete(&i2c_dev->dma_complete);
+}
+
+static int tegra_i2c_start_dma(struct tegra_i2c_dev *i2c_dev, int to_memory,
+	size_t words)
+{
+	struct tegra_dma_req *req = &i2c_dev->dma_req;
+	unsigned long fifo = i2c_dev->iomem->start +
+		tegra_i2c_reg(i2c_dev, to_memory ? I2C_RX_FIFO : I2C_TX_FIFO);
+
+	req->to_memory = to_memory;
+	req->size = words * BYTES_PER_FIFO_WORD;
+	if (to_memory) {
+		req->source_addr = fifo;
+		req->source_wrap = 4;
+		req->dest_addr = i2c_dev->rx_buf_phys;
+		req->dest_wrap = 0;
+		req->virt_addr = i2c_dev->rx_buf;
+	} else {
+		req->source_addr = i2c_dev->tx_buf_phys;
+		req->source_wrap = 0;
+		req->dest_addr = fifo;
+		req->dest_wrap = 4;
+		req->virt_addr = i2c_dev->tx_buf;
+	}
+
+	INIT_COMPLETION(i2c_dev->dma_complete);
+	return tegra_dma_enqueue_req(i2c_dev->dma_chan, req);
+}
+
+/*
+ * Returns how many of the leading messages can go out as one batch of
+ * back to back packets through the staging buffers.
+ */
+static int tegra_i2c_batch_len(struct tegra_i2c_dev *i2c_dev,
+	struct i2c_msg *msgs, int num)
+{
+	size_t tx_words = 0, rx_words = 0;
+	int i;
+
+	if (!i2c_dev->tx_buf)
+		return 0;
+
+	for (i = 0; i < num; i++) {
+		size_t words = DIV_ROUND_UP(msgs[i].len, BYTES_PER_FIFO_WORD);
+
+		/* a nak must stop at the message that ignores it */
+		if (!msgs[i].len || msgs[i].len > I2C_MAX_PAYLOAD ||
+			(msgs[i].flags & I2C_M_IGNORE_NAK))
+			break;
+
+		tx_words += I2C_PACKET_HEADER_WORDS;
+		if (msgs[i].flags & I2C_M_RD)
+			rx_words += words;
+		else
+			tx_words += words;
+		if (tx_words > TEGRA_I2C_BUF_WORDS ||
+			rx_words > TEGRA_I2C_BUF_WORDS)
+			break;
+	}
+
+	return i;
+}
+
+/*
+ * Send a run of messages as consecutive packets with a single completion
+ * interrupt. The direction that does not fit in the FIFO moves by DMA.
+ */
+static int tegra_i2c_xfer_batch(struct tegra_i2c_bus *i2c_bus,
+	struct i2c_msg *msgs, int num, int stop)
+{
+	struct tegra_i2c_dev *i2c_dev = i2c_bus->dev;
+	u32 *tx = i2c_dev->tx_buf;
+	u32 *rx = i2c_dev->rx_buf;
+	size_t tx_words, rx_words = 0;
+	int dma = 0, to_memory = 0;
+	u32 int_mask;
+	int i, ret;
+
+	tegra_i2c_flush_fifos(i2c_dev);
+	i2c_writel(i2c_dev, 0xFF, I2C_INT_STATUS);
+
+	for (i = 0; i < num; i++) {
+		struct i2c_msg *msg = &msgs[i];
+		int last = (i == num - 1);
+
+		i2c_dev->packet_header =
+			(0 << PACKET_HEADER0_HEADER_SIZE_SHIFT) |
+			PACKET_HEADER0_PROTOCOL_I2C |
+			(i2c_dev->cont_id << PACKET_HEADER0_CONT_ID_SHIFT) |
+			((i + 1) << PACKET_HEADER0_PACKET_ID_SHIFT);
+		i2c_dev->payload_size = msg->len - 1;
+		i2c_dev->io_header = tegra_i2c_io_header(msg, last && stop);
+		if (last)
+			i2c_dev->io_header |= I2C_HEADER_IE_ENABLE;
+
+		*tx++ = i2c_dev->packet_header;
+		*tx++ = i2c_dev->payload_size;
+		*tx++ = i2c_dev->io_header;
+
+		if (msg->flags & I2C_M_RD) {
+			rx_words += DIV_ROUND_UP(msg->len, BYTES_PER_FIFO_WORD);
+		} else {
+			memcpy(tx, msg->buf, msg->len);
+			tx += DIV_ROUND_UP(msg->len, BYTES_PER_FIFO_WORD);
+		}
+	}
+	tx_words = tx - i2c_dev->tx_buf;
+
+	i2c_dev->msg_buf_remaining = 0;
+	i2c_dev->msg_err = I2C_ERR_NONE;
+	i2c_dev->msg_transfer_complete = 0;
+	i2c_dev->msg_read = 0;
+	INIT_COMPLETION(i2c_dev->msg_complete);
+
+	i2c_dev->tx_pos = i2c_dev->tx_buf;
+	i2c_dev->tx_words = tx_words;
+	i2c_dev->rx_pos = i2c_dev->rx_buf;
+	i2c_dev->rx_words = rx_words;
+
+	/* one channel per controller, give it to the longer direction */
+	if (i2c_dev->dma_chan) {
+		if (rx_words > I2C_FIFO_DEPTH) {
+			dma = 1;
+			to_memory = 1;
+		} else if (tx_words > I2C_FIFO_DEPTH) {
+			dma = 1;
+		}
+	}
+
+	if (dma) {
+		if (!to_memory)
+			tegra_i2c_set_tx_trig(i2c_dev, 0);
+		ret = tegra_i2c_start_dma(i2c_dev, to_memory,
+			to_memory ? rx_words : tx_words);
+		if (ret) {
+			dev_warn(i2c_dev->dev, "dma enqueue failed %d\n", ret);
+			tegra_i2c_set_tx_trig(i2c_dev, 7);
+			dma = 0;
+		} else if (to_memory) {
+			i2c_dev->rx_words = 0;
+		} else {
+			i2c_dev->tx_words = 0;
+		}
+	}
+
+	i2c_dev->batch = true;
+
+	if (i2c_dev->tx_words)
+		tegra_i2c_fill_tx_words(i2c_dev);
+
+	int_mask = I2C_INT_NO_ACK | I2C_INT_ARBITRATION_LOST;
+	if (i2c_dev->rx_words)
+		int_mask |= I2C_INT_RX_FIFO_DATA_REQ;
+	if (i2c_dev->tx_words)
+		int_mask |= I2C_INT_TX_FIFO_DATA_REQ;
+	tegra_i2c_unmask_irq(i2c_dev, int_mask);
+
+	ret = wait_for_completion_timeout(&i2c_dev->msg_complete,
+					TEGRA_I2C_TIMEOUT);
+	tegra_i2c_mask_irq(i2c_dev, int_mask);
+
+	if (dma) {
+		/* the last rx words may still be on their way to memory */
+		if (ret && i2c_dev->msg_err == I2C_ERR_NONE)
+			ret = wait_for_completion_timeout(
+				&i2c_dev->dma_complete, TEGRA_I2C_TIMEOUT);
+		if (!ret || i2c_dev->msg_err != I2C_ERR_NONE)
+			tegra_dma_dequeue_req(i2c_dev->dma_chan,
+				&i2c_dev->dma_req);
+		if (!to_memory)
+			tegra_i2c_set_tx_trig(i2c_dev, 7);
+	}
+
+	i2c_dev->batch = false;
+	i2c_dev->tx_words = 0;
+	i2c_dev->rx_words = 0;
+
+	if (WARN_ON(ret == 0)) {
+		dev_err(i2c_dev->dev,
+			"i2c batch of %d timed out, addr 0x%04x\n",
+			num, msgs[0].addr);
+		tegra_i2c_init(i2c_dev);
+		return -ETIMEDOUT;
+	}
+
+	if (unlikely(i2c_dev->msg_err != I2C_ERR_NONE)) {
+		tegra_i2c_init(i2c_dev);
+		if (i2c_dev->msg_err == I2C_ERR_NO_ACK)
+			return -EREMOTEIO;
+		if (i2c_dev->msg_err & I2C_ERR_UNEXPECTED_STATUS)
+			return -EAGAIN;
+		return -EIO;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (!(msgs[i].flags & I2C_M_RD))
+			continue;
+		memcpy(msgs[i].buf, rx, msgs[i].len);
+		rx += DIV_ROUND_UP(msgs[i].len, BYTES_PER_FIFO_WORD);
+	}
+
+	return 0;
+}
+
 static int tegra_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[],
 	int num)
 {
 	struct tegra_i2c_bus *i2c_bus = i2c_get_adapdata(adap);
 	struct tegra_i2c_dev *i2c_dev = i2c_bus->dev;
-	int i;
+	int i, n;
 	int ret = 0;
 
 	if (i2c_dev->is_suspended)
@@ -596,9 +898,22 @@ static int tegra_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[],
 	i2c_dev->msgs_num = num;
 
 	clk_enable(i2c_dev->clk);
-	for (i = 0; i < num; i++) {
-		int stop = (i == (num - 1)) ? 1  : 0;
-		ret = tegra_i2c_xfer_msg(i2c_bus, &msgs[i], stop);
+	for (i = 0; i < num; i += n) {
+		n = tegra_i2c_batch_len(i2c_dev, &msgs[i], num - i);
+
+		/* a lone message only gains from the staging buffers with dma */
+		if (n == 1 && (!i2c_dev->dma_chan ||
+			msgs[i].len <= I2C_FIFO_DEPTH * BYTES_PER_FIFO_WORD))
+			n = 0;
+
+		if (n) {
+			ret = tegra_i2c_xfer_batch(i2c_bus, &msgs[i], n,
+				i + n == num);
+		} else {
+			n = 1;
+			ret = tegra_i2c_xfer_msg(i2c_bus, &msgs[i],
+				i + 1 == num);
+		}
 		if (ret)
 			goto out;
 	}
@@ -615,6 +930,55 @@ out:
 	return ret;
 }
 
+static void tegra_i2c_free_dma(struct tegra_i2c_dev *i2c_dev)
+{
+	if (i2c_dev->dma_chan)
+		tegra_dma_free_channel(i2c_dev->dma_chan);
+	if (i2c_dev->rx_buf)
+		dma_free_coherent(i2c_dev->dev, TEGRA_I2C_BUF_LEN,
+			i2c_dev->rx_buf, i2c_dev->rx_buf_phys);
+	if (i2c_dev->tx_buf)
+		dma_free_coherent(i2c_dev->dev, TEGRA_I2C_BUF_LEN,
+			i2c_dev->tx_buf, i2c_dev->tx_buf_phys);
+	i2c_dev->dma_chan = NULL;
+	i2c_dev->rx_buf = NULL;
+	i2c_dev->tx_buf = NULL;
+}
+
+/* batching and dma are optional, the controller still works without */
+static void tegra_i2c_init_dma(struct tegra_i2c_dev *i2c_dev, int id)
+{
+	struct tegra_dma_req *req = &i2c_dev->dma_req;
+
+	init_completion(&i2c_dev->dma_complete);
+
+	i2c_dev->tx_buf = dma_alloc_coherent(i2c_dev->dev, TEGRA_I2C_BUF_LEN,
+		&i2c_dev->tx_buf_phys, GFP_KERNEL);
+	i2c_dev->rx_buf = dma_alloc_coherent(i2c_dev->dev, TEGRA_I2C_BUF_LEN,
+		&i2c_dev->rx_buf_phys, GFP_KERNEL);
+	if (!i2c_dev->tx_buf || !i2c_dev->rx_buf) {
+		dev_warn(i2c_dev->dev, "no staging buffers, not batching\n");
+		tegra_i2c_free_dma(i2c_dev);
+		return;
+	}
+
+	if (!i2c_dev->is_dvc && (id < 0 || id >= ARRAY_SIZE(tegra_i2c_req_sels)))
+		return;
+
+	i2c_dev->dma_chan = tegra_dma_allocate_channel(TEGRA_DMA_MODE_ONESHOT);
+	if (!i2c_dev->dma_chan) {
+		dev_warn(i2c_dev->dev, "no dma channel, using pio\n");
+		return;
+	}
+
+	req->complete = tegra_i2c_dma_complete;
+	req->source_bus_width = 32;
+	req->dest_bus_width = 32;
+	req->req_sel = i2c_dev->is_dvc ? TEGRA_DMA_REQ_SEL_DVC_I2C :
+		tegra_i2c_req_sels[id];
+	req->dev = i2c_dev;
+}
+
 static u32 tegra_i2c_func(struct i2c_adapter *adap)
 {
 	/* FIXME: For now keep it simple and don't support protocol mangling
@@ -713,6 +1077,7 @@ static int tegra_i2c_probe(struct platform_device *pdev)
 	i2c_dev->slave_addr = plat->slave_addr;
 	i2c_dev->is_dvc = plat->is_dvc;
 	init_completion(&i2c_dev->msg_complete);
+	tegra_i2c_init_dma(i2c_dev, pdev->id);
 
 	if (irq == INT_I2C || irq == INT_I2C2 || irq == INT_I2C3)
 		i2c_dev->is_slave = true;
@@ -772,6 +1137,7 @@ err_del_bus:
 		i2c_del_adapter(&i2c_dev->busses[i2c_dev->bus_count].adapter);
 	free_irq(i2c_dev->irq, i2c_dev);
 err_free:
+	tegra_i2c_free_dma(i2c_dev);
 	kfree(i2c_dev);
 err_i2c_clk_put:
 	clk_put(i2c_clk);
@@ -791,6 +1157,7 @@ static int tegra_i2c_remove(struct platform_device *pdev)
 		i2c_del_adapter(&i2c_dev->busses[i2c_dev->bus_count].adapter);
 
 	free_irq(i2c_dev->irq, i2c_dev);
+	tegra_i2c_free_dma(i2c_dev);
 	clk_put(i2c_dev->i2c_clk);
 	clk_put(i2c_dev->clk);
 	release_mem_region(i2c_dev->iomem->start,
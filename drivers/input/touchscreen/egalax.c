@@ -27,6 +27,7 @@
 #include <linux/platform_device.h>
 #include <linux/slab.h>
 #include <linux/gpio.h>
+#include <linux/sched.h>
 #include <linux/input/egalax.h>
 
 #define MAX_I2C_LEN		10
@@ -34,6 +35,11 @@
 #define REPORTID_VENDOR		0x03
 #define REPORTID_MTOUCH		0x04
 
+/* Priority of the irq thread, 0 runs it as a normal task */
+static int thread_prio = MAX_USER_RT_PRIO / 2;
+module_param(thread_prio, int, 0644);
+MODULE_PARM_DESC(thread_prio, "SCHED_FIFO priority of the irq thread, 0 for SCHED_NORMAL");
+
 struct ts_point {
 	int x,y;		/* coordinates of the touch */
 	int p;			/* Touch pressure */
@@ -44,13 +50,12 @@ struct eGalax_ts_data {
 	struct i2c_client *client;
 	struct input_dev *input_dev;
 	char phys[32];
+	int thread_prio;		/* priority the irq thread runs at */
 	
-	struct work_struct  work;
 #ifdef CONFIG_HAS_EARLYSUSPEND	
 	struct early_suspend early_suspend;
 #endif
 
-	struct workqueue_struct *eGalax_wq;	
 	void (*disable_tp)(void);	/* function to disable the touchpad */
 	void (*enable_tp)(void);	/* function to enable the touchpad */
 	
@@ -107,7 +112,7 @@ static int eGalax_init(struct eGalax_ts_data *ts)
 	return ret != 0 ? 0 : -1;
 }
 
-static void eGalax_readpoints(struct eGalax_ts_data *ts)
+static int eGalax_readpoints(struct eGalax_ts_data *ts)
 {
 	unsigned char buf[MAX_I2C_LEN];
 	int count, loop = 3;
@@ -120,12 +125,12 @@ static void eGalax_readpoints(struct eGalax_ts_data *ts)
 		(buf[0] != REPORTID_VENDOR && buf[0] != REPORTID_MTOUCH) )
 	{
 		dev_err(&ts->client->dev,"I2C read error data with Len=%d header=%d\n",count, buf[0]);
-		return;
+		return -EIO;
 	}
 
-	dev_info(&ts->client->dev,"read data with Len=%d\n", count);
+	dev_dbg(&ts->client->dev,"read data with Len=%d\n", count);
 	if(buf[0] == REPORTID_VENDOR) {
-		dev_info(&ts->client->dev,"got command packet\n");
+		dev_dbg(&ts->client->dev,"got command packet\n");
 	} else
 
 	// If dealing with a multitouch event...
@@ -143,7 +148,7 @@ static void eGalax_readpoints(struct eGalax_ts_data *ts)
 		ts->pt[ContactID].x = X;
 		ts->pt[ContactID].y = Y;
 
-		dev_info(&ts->client->dev,"Get Point[%d] Update: Status=%d X=%d Y=%d\n", ContactID, Status, X, Y);
+		dev_dbg(&ts->client->dev,"Get Point[%d] Update: Status=%d X=%d Y=%d\n", ContactID, Status, X, Y);
 
 		// Send point report to Android if we started from a new point scan, or any point was released
 		if(!Status || ContactID <= ts->LastUpdateID)
@@ -176,29 +181,33 @@ static void eGalax_readpoints(struct eGalax_ts_data *ts)
 		// Remember the last processed point
 		ts->LastUpdateID = ContactID;
 	}
+	return 0;
 }
 
-static void eGalax_ts_work_func(struct work_struct *work)
+// Runs in the irq thread, an edge seen meanwhile runs it once more
+static irqreturn_t eGalax_ts_irq_thread(int irq, void *dev_id)
 {
-	struct eGalax_ts_data *ts = container_of(work, struct eGalax_ts_data, work);
+	struct eGalax_ts_data *ts = dev_id;
+	int gpio = irq_to_gpio(ts->client->irq);
+	int prio = thread_prio;
+
+	if (unlikely(prio != ts->thread_prio)) {
+		struct sched_param param = { .sched_priority = 0 };
+
+		ts->thread_prio = prio;
+		if (prio > 0 && prio < MAX_USER_RT_PRIO) {
+			param.sched_priority = prio;
+			sched_setscheduler(current, SCHED_FIFO, &param);
+		} else {
+			sched_setscheduler(current, SCHED_NORMAL, &param);
+		}
+	}
 
 	// Process all the available data
-	int gpio = irq_to_gpio(ts->client->irq);
 	while( !gpio_get_value(gpio) ) {
-		eGalax_readpoints(ts);
-		schedule();
+		if (eGalax_readpoints(ts))
+			break;
 	}
-	
-	// Reenable interrupts
-	enable_irq(ts->client->irq);
-}
-
-static irqreturn_t eGalax_ts_irq_handler(int irq, void *dev_id)
-{
-	struct eGalax_ts_data *ts = dev_id;
-
-	disable_irq_nosync(ts->client->irq);
-	queue_work(ts->eGalax_wq, &ts->work);
 	return IRQ_HANDLED;
 }
 
@@ -299,16 +308,10 @@ static int eGalax_ts_probe(
 	register_early_suspend(&ts->early_suspend);
 #endif
 	
-	ts->eGalax_wq = create_singlethread_workqueue("eGalax_wq");
-	if (!ts->eGalax_wq) {
-		ret = -ENOMEM;
-		dev_err(&client->dev,"unable to allocate workqueue\n");	
-		goto err_alloc_wq;
-	}
-	
-	INIT_WORK(&ts->work, eGalax_ts_work_func);
-
-	ret = request_irq(client->irq, eGalax_ts_irq_handler, IRQF_TRIGGER_FALLING, client->name, ts);
+	// genirq starts the thread at MAX_USER_RT_PRIO/2
+	ts->thread_prio = MAX_USER_RT_PRIO / 2;
+	ret = request_threaded_irq(client->irq, NULL, eGalax_ts_irq_thread,
+		IRQF_TRIGGER_FALLING | IRQF_ONESHOT, client->name, ts);
 	if (ret) {
 		ret = -ENOMEM;
 		dev_err(&client->dev, "request_irq failed\n");
@@ -319,9 +322,6 @@ static int eGalax_ts_probe(
 	return 0;
 
 err_alloc_irq:	
-	destroy_workqueue(ts->eGalax_wq);
-	
-err_alloc_wq:
 err_could_not_register:
 	input_free_device(ts->input_dev);
 	
@@ -344,7 +344,6 @@ static int eGalax_ts_remove(struct i2c_client *client)
 	struct eGalax_ts_data *ts = i2c_get_clientdata(client);
 
 	free_irq(client->irq,ts);
-	destroy_workqueue(ts->eGalax_wq);
 	input_free_device(ts->input_dev);
 	
 	// Disable the touchpad
@@ -362,14 +361,11 @@ static int eGalax_ts_suspend(struct i2c_client *client, pm_message_t mesg)
 	// Power down command
 	unsigned char cmdbuf[MAX_I2C_LEN]={0x03, 0x05, 0x0A, 0x03, 0x36, 0x3F, 0x02, 0, 0, 0};
 	
-	int ret;
 	struct eGalax_ts_data *ts = i2c_get_clientdata(client);
+
+	/* also waits for the irq thread */
 	disable_irq(client->irq);
 		
-	ret = cancel_work_sync(&ts->work);
-	if (ret) /* if work was pending disable-count is now 2 */
-		enable_irq(client->irq);
-		
 	// Power down the touchscreen
 	i2c_master_send(ts->client, cmdbuf, MAX_I2C_LEN);
 	
@@ -28,6 +28,26 @@
 #define DM_MSG_PREFIX "crypt"
 #define MESG_STR(x) x, sizeof(x)
 
+/*
+ * Offload engine, looked up by its "<mode>-<cipher>-<driver>" driver
+ * name next to the default cipher. Bios smaller than offload_min_bytes
+ * stay on the default cipher, where the engine setup and completion
+ * interrupt would cost more than the software cipher does.
+ */
+#ifdef CONFIG_CRYPTO_DEV_TEGRA_AES
+#define DM_CRYPT_OFFLOAD_DRIVER "tegra"
+#else
+#define DM_CRYPT_OFFLOAD_DRIVER ""
+#endif
+
+static char *offload_driver = DM_CRYPT_OFFLOAD_DRIVER;
+module_param(offload_driver, charp, S_IRUGO);
+MODULE_PARM_DESC(offload_driver, "Crypto driver suffix used for large bios");
+
+static unsigned int offload_min_bytes = 16384;
+module_param(offload_min_bytes, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(offload_min_bytes, "Smallest bio sent to the offload driver");
+
 /*
  * context holding the current state of a multi-part conversion
  */
@@ -41,6 +61,8 @@ struct convert_context {
 	unsigned int idx_out;
 	sector_t sector;
 	atomic_t pending;
+	struct crypto_ablkcipher *tfm;
+	struct ablkcipher_request *req;
 };
 
 /*
@@ -132,9 +154,9 @@ struct crypt_config {
 	 * correctly aligned.
 	 */
 	unsigned int dmreq_start;
-	struct ablkcipher_request *req;
 
 	struct crypto_ablkcipher *tfm;
+	struct crypto_ablkcipher *offload_tfm;
 	unsigned long flags;
 	unsigned int key_size;
 	u8 key[0];
@@ -386,6 +408,11 @@ static void crypt_convert_init(struct crypt_config *cc,
 	ctx->idx_out = bio_out ? bio_out->bi_idx : 0;
 	ctx->sector = sector + cc->iv_offset;
 	init_completion(&ctx->restart);
+
+	if (cc->offload_tfm && bio_in && bio_in->bi_size >= offload_min_bytes)
+		ctx->tfm = cc->offload_tfm;
+	else
+		ctx->tfm = cc->tfm;
 }
 
 static struct dm_crypt_request *dmreq_of_req(struct crypt_config *cc,
@@ -412,7 +439,7 @@ static int crypt_convert_block(struct crypt_config *cc,
 
 	dmreq = dmreq_of_req(cc, req);
 	iv = (u8 *)ALIGN((unsigned long)(dmreq + 1),
-			 crypto_ablkcipher_alignmask(cc->tfm) + 1);
+			 crypto_ablkcipher_alignmask(ctx->tfm) + 1);
 
 	dmreq->ctx = ctx;
 	sg_init_table(&dmreq->sg_in, 1);
@@ -457,13 +484,13 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 static void crypt_alloc_req(struct crypt_config *cc,
 			    struct convert_context *ctx)
 {
-	if (!cc->req)
-		cc->req = mempool_alloc(cc->req_pool, GFP_NOIO);
-	ablkcipher_request_set_tfm(cc->req, cc->tfm);
-	ablkcipher_request_set_callback(cc->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+	if (!ctx->req)
+		ctx->req = mempool_alloc(cc->req_pool, GFP_NOIO);
+	ablkcipher_request_set_tfm(ctx->req, ctx->tfm);
+	ablkcipher_request_set_callback(ctx->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
 					CRYPTO_TFM_REQ_MAY_SLEEP,
 					kcryptd_async_done,
-					dmreq_of_req(cc, cc->req));
+					dmreq_of_req(cc, ctx->req));
 }
 
 /*
@@ -483,7 +510,7 @@ static int crypt_convert(struct crypt_config *cc,
 
 		atomic_inc(&ctx->pending);
 
-		r = crypt_convert_block(cc, ctx, cc->req);
+		r = crypt_convert_block(cc, ctx, ctx->req);
 
 		switch (r) {
 		/* async */
@@ -492,7 +519,7 @@ static int crypt_convert(struct crypt_config *cc,
 			INIT_COMPLETION(ctx->restart);
 			/* fall through*/
 		case -EINPROGRESS:
-			cc->req = NULL;
+			ctx->req = NULL;
 			ctx->sector++;
 			continue;
 
@@ -602,6 +629,7 @@ static struct dm_crypt_io *crypt_io_alloc(struct dm_target *ti,
 	io->sector = sector;
 	io->error = 0;
 	io->base_io = NULL;
+	io->ctx.req = NULL;
 	atomic_set(&io->pending, 0);
 
 	return io;
@@ -627,6 +655,8 @@ static void crypt_dec_pending(struct dm_crypt_io *io)
 	if (!atomic_dec_and_test(&io->pending))
 		return;
 
+	if (io->ctx.req)
+		mempool_free(io->ctx.req, cc->req_pool);
 	mempool_free(io, cc->io_pool);
 
 	if (likely(!base_io))
@@ -644,7 +674,9 @@ static void crypt_dec_pending(struct dm_crypt_io *io)
  * Needed because it would be very unwise to do decryption in an
  * interrupt context.
  *
- * kcryptd performs the actual encryption or decryption.
+ * kcryptd performs the actual encryption or decryption. It has a worker
+ * on each CPU, so bios are converted in parallel and a bio waiting for
+ * room in a busy crypto engine queue does not hold up the others.
  *
  * kcryptd_io performs the IO submission.
  *
@@ -971,6 +1003,17 @@ static void crypt_encode_key(char *hex, u8 *key, unsigned int size)
 	}
 }
 
+static int crypt_setkey_tfms(struct crypt_config *cc)
+{
+	int r;
+
+	r = crypto_ablkcipher_setkey(cc->tfm, cc->key, cc->key_size);
+	if (!r && cc->offload_tfm)
+		r = crypto_ablkcipher_setkey(cc->offload_tfm, cc->key,
+					     cc->key_size);
+	return r;
+}
+
 static int crypt_set_key(struct crypt_config *cc, char *key)
 {
 	unsigned key_size = strlen(key) >> 1;
@@ -986,14 +1029,14 @@ static int crypt_set_key(struct crypt_config *cc, char *key)
 
 	set_bit(DM_CRYPT_KEY_VALID, &cc->flags);
 
-	return crypto_ablkcipher_setkey(cc->tfm, cc->key, cc->key_size);
+	return crypt_setkey_tfms(cc);
 }
 
 static int crypt_wipe_key(struct crypt_config *cc)
 {
 	clear_bit(DM_CRYPT_KEY_VALID, &cc->flags);
 	memset(&cc->key, 0, cc->key_size * sizeof(u8));
-	return crypto_ablkcipher_setkey(cc->tfm, cc->key, cc->key_size);
+	return crypt_setkey_tfms(cc);
 }
 
 static void crypt_dtr(struct dm_target *ti)
@@ -1023,6 +1066,8 @@ static void crypt_dtr(struct dm_target *ti)
 	if (cc->iv_gen_ops && cc->iv_gen_ops->dtr)
 		cc->iv_gen_ops->dtr(cc);
 
+	if (cc->offload_tfm)
+		crypto_free_ablkcipher(cc->offload_tfm);
 	if (cc->tfm && !IS_ERR(cc->tfm))
 		crypto_free_ablkcipher(cc->tfm);
 
@@ -1036,6 +1081,40 @@ static void crypt_dtr(struct dm_target *ti)
 	kzfree(cc);
 }
 
+/*
+ * Look for the offload driver's implementation of the cipher. It is only
+ * used if it is a different algorithm from the default one with the same
+ * IV size, otherwise all bios stay on the default cipher.
+ */
+static void crypt_alloc_offload(struct crypt_config *cc,
+				const char *chainmode, const char *cipher)
+{
+	struct crypto_ablkcipher *tfm;
+	char name[CRYPTO_MAX_ALG_NAME];
+
+	if (!offload_driver || !*offload_driver)
+		return;
+
+	if (snprintf(name, sizeof(name), "%s-%s-%s", chainmode, cipher,
+		     offload_driver) >= sizeof(name))
+		return;
+
+	tfm = crypto_alloc_ablkcipher(name, 0, 0);
+	if (IS_ERR(tfm))
+		return;
+
+	if (crypto_ablkcipher_ivsize(tfm) != crypto_ablkcipher_ivsize(cc->tfm) ||
+	    !strcmp(crypto_tfm_alg_driver_name(crypto_ablkcipher_tfm(tfm)),
+		    crypto_tfm_alg_driver_name(crypto_ablkcipher_tfm(cc->tfm)))) {
+		crypto_free_ablkcipher(tfm);
+		return;
+	}
+
+	DMINFO("%s: bios of %u bytes or more use %s", cc->cipher,
+	       offload_min_bytes, name);
+	cc->offload_tfm = tfm;
+}
+
 static int crypt_ctr_cipher(struct dm_target *ti,
 			    char *cipher_in, char *key)
 {
@@ -1106,6 +1185,8 @@ static int crypt_ctr_cipher(struct dm_target *ti,
 		goto bad;
 	}
 
+	crypt_alloc_offload(cc, chainmode, cipher);
+
 	/* Initialize and set key */
 	ret = crypt_set_key(cc, key);
 	if (ret < 0) {
@@ -1180,6 +1261,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	struct crypt_config *cc;
 	unsigned int key_size;
 	unsigned long long tmpll;
+	unsigned int reqsize, alignmask;
 	int ret;
 
 	if (argc != 5) {
@@ -1207,11 +1289,19 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	/* requests come from one pool, size them for either cipher */
+	reqsize = crypto_ablkcipher_reqsize(cc->tfm);
+	alignmask = crypto_ablkcipher_alignmask(cc->tfm);
+	if (cc->offload_tfm) {
+		reqsize = max(reqsize,
+			      crypto_ablkcipher_reqsize(cc->offload_tfm));
+		alignmask |= crypto_ablkcipher_alignmask(cc->offload_tfm);
+	}
+
 	cc->dmreq_start = sizeof(struct ablkcipher_request);
-	cc->dmreq_start += crypto_ablkcipher_reqsize(cc->tfm);
+	cc->dmreq_start += reqsize;
 	cc->dmreq_start = ALIGN(cc->dmreq_start, crypto_tfm_ctx_alignment());
-	cc->dmreq_start += crypto_ablkcipher_alignmask(cc->tfm) &
-			   ~(crypto_tfm_ctx_alignment() - 1);
+	cc->dmreq_start += alignmask & ~(crypto_tfm_ctx_alignment() - 1);
 
 	cc->req_pool = mempool_create_kmalloc_pool(MIN_IOS, cc->dmreq_start +
 			sizeof(struct dm_crypt_request) + cc->iv_size);
@@ -1219,7 +1309,6 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		ti->error = "Cannot allocate crypt request mempool";
 		goto bad;
 	}
-	cc->req = NULL;
 
 	cc->page_pool = mempool_create_page_pool(MIN_POOL_PAGES, 0);
 	if (!cc->page_pool) {
@@ -1252,13 +1341,16 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	cc->start = tmpll;
 
 	ret = -ENOMEM;
-	cc->io_queue = create_singlethread_workqueue("kcryptd_io");
+	cc->io_queue = alloc_workqueue("kcryptd_io",
+				       WQ_NON_REENTRANT | WQ_RESCUER, 1);
 	if (!cc->io_queue) {
 		ti->error = "Couldn't create kcryptd io queue";
 		goto bad;
 	}
 
-	cc->crypt_queue = create_singlethread_workqueue("kcryptd");
+	cc->crypt_queue = alloc_workqueue("kcryptd",
+					  WQ_NON_REENTRANT | WQ_CPU_INTENSIVE |
+					  WQ_RESCUER, 1);
 	if (!cc->crypt_queue) {
 		ti->error = "Couldn't create kcryptd queue";
 		goto bad;
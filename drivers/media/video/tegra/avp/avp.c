@@ -25,6 +25,7 @@
 #include <linux/ioctl.h>
 #include <linux/irq.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/mutex.h>
@@ -147,6 +148,11 @@ struct remote_info {
 	u32			rem_id;
 	struct kref		ref;
 
+	/* messages sent to the AVP and time spent waiting for the mailbox */
+	unsigned long		tx_msgs;
+	u32			tx_wait_max_us;
+	u64			tx_wait_total_us;
+
 	struct trpc_endpoint	*trpc_ep;
 	struct rb_node		rb_node;
 };
@@ -280,6 +286,14 @@ static void avp_trpc_show(struct seq_file *s, struct trpc_endpoint *ep)
 	}
 	seq_printf(s, "    loc_id:0x%x\n	rem_id:0x%x\n",
 		   rinfo->loc_id, rinfo->rem_id);
+	if (rinfo->tx_msgs) {
+		u64 avg = rinfo->tx_wait_total_us;
+
+		do_div(avg, rinfo->tx_msgs);
+		seq_printf(s, "    tx_msgs:%lu\n    tx_wait_us avg:%llu max:%u\n",
+			   rinfo->tx_msgs, (unsigned long long)avg,
+			   rinfo->tx_wait_max_us);
+	}
 out:
 	spin_unlock_irqrestore(&avp->state_lock, flags);
 }
@@ -383,6 +397,8 @@ static int avp_trpc_send(struct trpc_endpoint *ep, void *buf, size_t len)
 	struct tegra_avp_info *avp = tegra_avp;
 	struct remote_info *rinfo;
 	struct msg_port_data msg;
+	ktime_t start;
+	u32 wait_us;
 	int ret;
 	unsigned long flags;
 
@@ -409,9 +425,17 @@ static int avp_trpc_send(struct trpc_endpoint *ep, void *buf, size_t len)
 	msg.port_id = rinfo->rem_id;
 	msg.msg_len = len;
 
+	start = ktime_get();
 	mutex_lock(&avp->to_avp_lock);
 	ret = msg_write(avp, &msg, sizeof(msg), buf, len);
 	mutex_unlock(&avp->to_avp_lock);
+	if (!ret) {
+		wait_us = ktime_to_us(ktime_sub(ktime_get(), start));
+		rinfo->tx_msgs++;
+		rinfo->tx_wait_total_us += wait_us;
+		if (wait_us > rinfo->tx_wait_max_us)
+			rinfo->tx_wait_max_us = wait_us;
+	}
 
 	DBG(AVP_DBG_TRACE_TRPC_MSG, "%s: msg sent for %s (%x->%x) (%d)\n",
 		__func__, trpc_name(ep), rinfo->loc_id, rinfo->rem_id, ret);
@@ -14,16 +14,22 @@
  */
 
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/io.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #include <linux/mutex.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/tegra_rpc.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 
 #include <mach/clk.h>
 #include <mach/nvmap.h>
@@ -78,6 +84,40 @@ struct avp_clk {
 	struct avp_module	*mod;
 };
 
+/*
+ * Requests are served in one of three classes. Memory, DFS and power
+ * queries are answered straight from the receive thread. Module clock
+ * and reset requests can wait on dvfs and the PMIC, so they go to their
+ * own ordered workqueue and never hold up the per-frame nvmap queries.
+ * Remote printf only logs and has its own queue.
+ *
+ * Responses carry no request tag, but each class answers with its own
+ * response ids, so reordering across classes is safe. Within a class the
+ * order is kept.
+ */
+enum avp_svc_class {
+	AVP_SVC_INLINE,
+	AVP_SVC_CLOCK,
+	AVP_SVC_LOG,
+};
+
+struct avp_svc_work {
+	struct work_struct	work;
+	struct avp_svc_info	*avp_svc;
+	ktime_t			received;
+	size_t			len;
+	u8			buf[TEGRA_RPC_MAX_MSG_LEN];
+};
+
+#define AVP_SVC_NUM_IDS		(SVC_DFS_GET_CLK_UTIL_RESPONSE + 1)
+
+/* time from receiving a request to having served it */
+struct avp_svc_stats {
+	unsigned long		count;
+	u64			total_us;
+	u32			max_us;
+};
+
 struct avp_svc_info {
 	struct avp_clk			clks[NUM_CLK_REQUESTS];
 	/* used for dvfs */
@@ -88,6 +128,12 @@ struct avp_svc_info {
 
 	struct trpc_endpoint		*cpu_ep;
 	struct task_struct		*svc_thread;
+	struct workqueue_struct		*clk_wq;
+	struct workqueue_struct		*log_wq;
+
+	spinlock_t			stats_lock;
+	struct avp_svc_stats		stats[AVP_SVC_NUM_IDS];
+	struct dentry			*debug_file;
 
 	/* client for remote allocations, for easy tear down */
 	struct nvmap_client		*nvmap_remote;
@@ -525,11 +571,81 @@ static int dispatch_svc_message(struct avp_svc_info *avp_svc,
 	return ret;
 }
 
+static enum avp_svc_class svc_class(u32 svc_id)
+{
+	switch (svc_id) {
+	case SVC_MODULE_CLOCK:
+	case SVC_MODULE_RESET:
+		return AVP_SVC_CLOCK;
+	case SVC_PRINTF:
+		return AVP_SVC_LOG;
+	default:
+		return AVP_SVC_INLINE;
+	}
+}
+
+static void svc_note_latency(struct avp_svc_info *avp_svc, u32 svc_id,
+			     ktime_t received)
+{
+	struct avp_svc_stats *st;
+	unsigned long flags;
+	u32 us;
+
+	if (svc_id >= AVP_SVC_NUM_IDS)
+		return;
+
+	us = ktime_us_delta(ktime_get(), received);
+	st = &avp_svc->stats[svc_id];
+	spin_lock_irqsave(&avp_svc->stats_lock, flags);
+	st->count++;
+	st->total_us += us;
+	if (us > st->max_us)
+		st->max_us = us;
+	spin_unlock_irqrestore(&avp_svc->stats_lock, flags);
+}
+
+static void avp_svc_worker(struct work_struct *work)
+{
+	struct avp_svc_work *w = container_of(work, struct avp_svc_work, work);
+	struct avp_svc_info *avp_svc = w->avp_svc;
+	struct svc_msg *msg = (struct svc_msg *)w->buf;
+
+	dispatch_svc_message(avp_svc, msg, w->len);
+	svc_note_latency(avp_svc, msg->svc_id, w->received);
+	/* the port was referenced when the request was queued */
+	trpc_put(avp_svc->cpu_ep);
+	kfree(w);
+}
+
+static int queue_svc_message(struct avp_svc_info *avp_svc,
+			     enum avp_svc_class cls, struct svc_msg *msg,
+			     size_t len, ktime_t received)
+{
+	struct avp_svc_work *w;
+
+	w = kmalloc(sizeof(*w), GFP_KERNEL);
+	if (!w)
+		return -ENOMEM;
+
+	INIT_WORK(&w->work, avp_svc_worker);
+	w->avp_svc = avp_svc;
+	w->received = received;
+	w->len = len;
+	memcpy(w->buf, msg, len);
+
+	trpc_get(avp_svc->cpu_ep);
+	queue_work(cls == AVP_SVC_CLOCK ? avp_svc->clk_wq : avp_svc->log_wq,
+		   &w->work);
+	return 0;
+}
+
 static int avp_svc_thread(void *data)
 {
 	struct avp_svc_info *avp_svc = data;
 	u8 buf[TEGRA_RPC_MAX_MSG_LEN];
 	struct svc_msg *msg = (struct svc_msg *)buf;
+	enum avp_svc_class cls;
+	ktime_t received;
 	int ret;
 
 	BUG_ON(!avp_svc->cpu_ep);
@@ -556,7 +672,14 @@ static int avp_svc_thread(void *data)
 			pr_err("%s: received msg of len 0?!\n", __func__);
 			continue;
 		}
+		received = ktime_get();
+		cls = svc_class(msg->svc_id);
+		/* serve it here if it can't be queued */
+		if (cls != AVP_SVC_INLINE &&
+		    !queue_svc_message(avp_svc, cls, msg, ret, received))
+			continue;
 		dispatch_svc_message(avp_svc, msg, ret);
+		svc_note_latency(avp_svc, msg->svc_id, received);
 	}
 
 err:
@@ -621,6 +744,9 @@ void avp_svc_stop(struct avp_svc_info *avp_svc)
 		/* the thread never started, drop it's extra reference */
 		trpc_put(avp_svc->cpu_ep);
 	}
+	/* queued requests still use the port and the clocks */
+	flush_workqueue(avp_svc->clk_wq);
+	flush_workqueue(avp_svc->log_wq);
 	avp_svc->cpu_ep = NULL;
 
 	nvmap_client_put(avp_svc->nvmap_remote);
@@ -643,6 +769,62 @@ void avp_svc_stop(struct avp_svc_info *avp_svc)
 	mutex_unlock(&avp_svc->clk_lock);
 }
 
+static const char *const svc_names[AVP_SVC_NUM_IDS] = {
+	[SVC_NVMAP_CREATE]		= "nvmap_create",
+	[SVC_NVMAP_FREE]		= "nvmap_free",
+	[SVC_NVMAP_ALLOC]		= "nvmap_alloc",
+	[SVC_NVMAP_PIN]			= "nvmap_pin",
+	[SVC_NVMAP_UNPIN]		= "nvmap_unpin",
+	[SVC_NVMAP_GET_ADDRESS]		= "nvmap_get_addr",
+	[SVC_NVMAP_FROM_ID]		= "nvmap_from_id",
+	[SVC_MODULE_CLOCK]		= "module_clock",
+	[SVC_MODULE_RESET]		= "module_reset",
+	[SVC_POWER_REGISTER]		= "power_register",
+	[SVC_POWER_UNREGISTER]		= "power_unregister",
+	[SVC_POWER_STARVATION]		= "power_starvation",
+	[SVC_POWER_BUSY_HINT]		= "power_busy_hint",
+	[SVC_POWER_BUSY_HINT_MULTI]	= "power_busy_hint_multi",
+	[SVC_DFS_GETSTATE]		= "dfs_get_state",
+	[SVC_POWER_MAXFREQ]		= "power_max_freq",
+	[SVC_PRINTF]			= "printf",
+	[SVC_AVP_WDT_RESET]		= "avp_wdt_reset",
+	[SVC_DFS_GET_CLK_UTIL]		= "dfs_get_clk_util",
+};
+
+static int avp_svc_stats_show(struct seq_file *s, void *data)
+{
+	struct avp_svc_info *avp_svc = s->private;
+	struct avp_svc_stats st;
+	unsigned long flags;
+	int i;
+
+	seq_printf(s, "%-22s %10s %10s %10s\n", "request", "count",
+		   "avg_us", "max_us");
+	for (i = 0; i < AVP_SVC_NUM_IDS; i++) {
+		spin_lock_irqsave(&avp_svc->stats_lock, flags);
+		st = avp_svc->stats[i];
+		spin_unlock_irqrestore(&avp_svc->stats_lock, flags);
+		if (!st.count)
+			continue;
+		seq_printf(s, "%-22s %10lu %10llu %10u\n",
+			   svc_names[i] ?: "?", st.count,
+			   div_u64(st.total_us, st.count), st.max_us);
+	}
+	return 0;
+}
+
+static int avp_svc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, avp_svc_stats_show, inode->i_private);
+}
+
+static const struct file_operations avp_svc_stats_fops = {
+	.open = avp_svc_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 struct avp_svc_info *avp_svc_init(struct platform_device *pdev,
 				  struct trpc_node *rpc_node)
 {
@@ -704,9 +886,27 @@ struct avp_svc_info *avp_svc_init(struct platform_device *pdev,
 	avp_svc->rpc_node = rpc_node;
 
 	mutex_init(&avp_svc->clk_lock);
+	spin_lock_init(&avp_svc->stats_lock);
+
+	avp_svc->clk_wq = create_singlethread_workqueue("avp_svc_clk");
+	avp_svc->log_wq = create_singlethread_workqueue("avp_svc_log");
+	if (!avp_svc->clk_wq || !avp_svc->log_wq) {
+		pr_err("avp_svc: can't create service workqueues\n");
+		ret = -ENOMEM;
+		goto err_create_wq;
+	}
+
+	avp_svc->debug_file = debugfs_create_file("avp_svc", S_IRUGO, NULL,
+						  avp_svc,
+						  &avp_svc_stats_fops);
 
 	return avp_svc;
 
+err_create_wq:
+	if (avp_svc->clk_wq)
+		destroy_workqueue(avp_svc->clk_wq);
+	if (avp_svc->log_wq)
+		destroy_workqueue(avp_svc->log_wq);
 err_get_clks:
 	for (i = 0; i < NUM_CLK_REQUESTS; i++)
 		if (avp_svc->clks[i].clk)
@@ -723,6 +923,10 @@ void avp_svc_destroy(struct avp_svc_info *avp_svc)
 {
 	int i;
 
+	debugfs_remove(avp_svc->debug_file);
+	destroy_workqueue(avp_svc->clk_wq);
+	destroy_workqueue(avp_svc->log_wq);
+
 	for (i = 0; i < NUM_CLK_REQUESTS; i++)
 		clk_put(avp_svc->clks[i].clk);
 	clk_put(avp_svc->sclk);
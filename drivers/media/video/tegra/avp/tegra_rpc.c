@@ -21,7 +21,9 @@
 #include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/err.h>
+#include <linux/jiffies.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
@@ -35,10 +37,48 @@
 
 #include "trpc.h"
 
+/*
+ * Each endpoint receives through a single-producer/single-consumer ring.
+ * Senders serialize among themselves on send_lock and receivers on
+ * recv_lock, but the two sides only meet through the head and tail
+ * indices.  Messages up to TRPC_INLINE_MSG_LEN bytes are copied straight
+ * into the slot; longer ones are allocated from the message cache.
+ */
+#define TRPC_RING_SIZE		32	/* must be a power of 2 */
+#define TRPC_INLINE_MSG_LEN	48
+
+struct trpc_msg;
+
+struct trpc_ring_slot {
+	size_t			len;
+	struct trpc_msg		*msg;	/* NULL if the payload is inline */
+	ktime_t			stamp;
+	u8			data[TRPC_INLINE_MSG_LEN];
+};
+
+struct trpc_ring {
+	unsigned int		head;	/* only written by the sender */
+	unsigned int		tail;	/* only written by the receiver */
+	struct trpc_ring_slot	slots[TRPC_RING_SIZE];
+};
+
+struct trpc_ep_stats {
+	unsigned long		msgs;
+	unsigned long		bytes;
+	unsigned long		doorbells;
+	unsigned long		ring_full;
+	u64			lat_total_us;
+	u32			lat_max_us;
+};
+
 struct trpc_port;
 struct trpc_endpoint {
-	struct list_head	msg_list;
+	struct trpc_ring	*ring;
+	spinlock_t		send_lock;
+	spinlock_t		recv_lock;
 	wait_queue_head_t	msg_waitq;
+	wait_queue_head_t	space_waitq;
+	struct trpc_ep_stats	stats;
 
 	struct trpc_endpoint	*out;
 	struct trpc_port	*port;
@@ -58,6 +98,7 @@ struct trpc_port {
 	spinlock_t		lock;
 	struct trpc_endpoint	peers[2];
 	bool			closed;
+	unsigned long		created;	/* jiffies */
 
 	/* private */
 	struct kref		ref;
@@ -87,17 +128,12 @@ struct tegra_rpc_info {
 };
 
 struct trpc_msg {
-	struct list_head		list;
-
-	size_t				len;
 	u8				payload[TEGRA_RPC_MAX_MSG_LEN];
 };
 
 static struct tegra_rpc_info *tegra_rpc;
 static struct dentry *trpc_debug_root;
 
-static struct trpc_msg *dequeue_msg_locked(struct trpc_endpoint *ep);
-
 /* a few accessors for the outside world to keep the trpc_endpoint struct
  * definition private to this module */
 void *trpc_priv(struct trpc_endpoint *ep)
@@ -125,18 +161,28 @@ static inline bool is_closed(struct trpc_port *port)
 	return port->closed;
 }
 
+static inline unsigned int ring_count(struct trpc_ring *ring)
+{
+	return ACCESS_ONCE(ring->head) - ACCESS_ONCE(ring->tail);
+}
+
 static void rpc_port_free(struct tegra_rpc_info *info, struct trpc_port *port)
 {
-	struct trpc_msg *msg;
+	struct trpc_ring *ring;
 	int i;
 
 	for (i = 0; i < 2; ++i) {
-		struct list_head *list = &port->peers[i].msg_list;
-		while (!list_empty(list)) {
-			msg = list_first_entry(list, struct trpc_msg, list);
-			list_del(&msg->list);
-			kmem_cache_free(info->msg_cache, msg);
+		ring = port->peers[i].ring;
+		if (!ring)
+			continue;
+		for (; ring->tail != ring->head; ring->tail++) {
+			struct trpc_ring_slot *slot;
+
+			slot = &ring->slots[ring->tail & (TRPC_RING_SIZE - 1)];
+			if (slot->msg)
+				kmem_cache_free(info->msg_cache, slot->msg);
 		}
+		kfree(ring);
 	}
 	kfree(port);
 }
@@ -234,10 +280,19 @@ static struct trpc_port *rpc_port_alloc(const char *name)
 	spin_lock_init(&port->lock);
 	kref_init(&port->ref);
 	strlcpy(port->name, name, TEGRA_RPC_MAX_NAME_LEN);
+	port->created = jiffies;
 	for (i = 0; i < 2; i++) {
 		struct trpc_endpoint *ep = port->peers + i;
-		INIT_LIST_HEAD(&ep->msg_list);
+		ep->ring = kzalloc(sizeof(struct trpc_ring), GFP_KERNEL);
+		if (!ep->ring) {
+			pr_err("%s: can't alloc message ring\n", __func__);
+			rpc_port_free(tegra_rpc, port);
+			return NULL;
+		}
+		spin_lock_init(&ep->send_lock);
+		spin_lock_init(&ep->recv_lock);
 		init_waitqueue_head(&ep->msg_waitq);
+		init_waitqueue_head(&ep->space_waitq);
 		ep->port = port;
 	}
 	port->peers[0].out = &port->peers[1];
@@ -447,6 +502,9 @@ void trpc_close(struct trpc_endpoint *ep)
 	BUG_ON(!ep->ready);
 	ep->ready = false;
 	port->closed = true;
+	/* senders may be waiting for room in either ring */
+	wake_up_all(&ep->space_waitq);
+	wake_up_all(&peer->space_waitq);
 	if (peer->ready) {
 		need_close_op = true;
 		/* the peer may be waiting for a message */
@@ -515,14 +573,23 @@ static inline int _ep_id(struct trpc_endpoint *ep)
 	return ep - ep->port->peers;
 }
 
+static bool __has_space(struct trpc_endpoint *ep)
+{
+	return ring_count(ep->ring) < TRPC_RING_SIZE || is_closed(ep->port);
+}
+
 static int queue_msg(struct trpc_node *src, struct trpc_endpoint *from,
 		     void *buf, size_t len, gfp_t gfp_flags)
 {
 	struct tegra_rpc_info *info = tegra_rpc;
 	struct trpc_endpoint *peer = from->out;
 	struct trpc_port *port = from->port;
-	struct trpc_msg *msg;
+	struct trpc_ring *ring = peer->ring;
+	struct trpc_ring_slot *slot;
+	struct trpc_msg *msg = NULL;
 	unsigned long flags;
+	unsigned int head;
+	bool was_empty;
 	int ret;
 
 	BUG_ON(len > TEGRA_RPC_MAX_MSG_LEN);
@@ -532,38 +599,78 @@ static int queue_msg(struct trpc_node *src, struct trpc_endpoint *from,
 	DBG(TRPC_TRACE_MSG, "%s: queueing message for %s.%d\n", __func__,
 	    port->name, _ep_id(peer));
 
-	msg = kmem_cache_alloc(info->msg_cache, gfp_flags);
-	if (!msg) {
-		pr_err("%s: can't alloc memory for msg\n", __func__);
-		return -ENOMEM;
+	if (len > TRPC_INLINE_MSG_LEN) {
+		msg = kmem_cache_alloc(info->msg_cache, gfp_flags);
+		if (!msg) {
+			pr_err("%s: can't alloc memory for msg\n", __func__);
+			return -ENOMEM;
+		}
+		memcpy(msg->payload, buf, len);
 	}
 
-	memcpy(msg->payload, buf, len);
-	msg->len = len;
-
 	spin_lock_irqsave(&port->lock, flags);
 	if (is_closed(port)) {
 		pr_err("%s: cannot send message for closed port %s.%d\n",
 		       __func__, port->name, _ep_id(peer));
 		ret = -ECONNRESET;
-		goto err;
+		goto err_port_locked;
 	} else if (!is_connected(port)) {
 		pr_err("%s: cannot send message for unconnected port %s.%d\n",
 		       __func__, port->name, _ep_id(peer));
 		ret = -ENOTCONN;
-		goto err;
+		goto err_port_locked;
+	}
+	spin_unlock_irqrestore(&port->lock, flags);
+
+	spin_lock_irqsave(&peer->send_lock, flags);
+	while (ring_count(ring) == TRPC_RING_SIZE) {
+		peer->stats.ring_full++;
+		spin_unlock_irqrestore(&peer->send_lock, flags);
+		/* atomic senders (the AVP irq) defer to process context */
+		if (!(gfp_flags & __GFP_WAIT)) {
+			DBG(TRPC_TRACE_MSG, "%s: ring full for %s.%d\n",
+			    __func__, port->name, _ep_id(peer));
+			ret = -ENOMEM;
+			goto err;
+		}
+		wait_event(peer->space_waitq, __has_space(peer));
+		if (is_closed(port)) {
+			ret = -ECONNRESET;
+			goto err;
+		}
+		spin_lock_irqsave(&peer->send_lock, flags);
 	}
 
-	list_add_tail(&msg->list, &peer->msg_list);
+	head = ring->head;
+	slot = &ring->slots[head & (TRPC_RING_SIZE - 1)];
+	slot->len = len;
+	slot->msg = msg;
+	if (!msg)
+		memcpy(slot->data, buf, len);
+	slot->stamp = ktime_get();
+	/* publish the slot before the index that makes it visible */
+	smp_wmb();
+	ring->head = head + 1;
+	/* pairs with the barrier in the receiver's wait: either it sees the
+	 * new head or we see the tail it left behind */
+	smp_mb();
+	was_empty = ACCESS_ONCE(ring->tail) == head;
+	if (was_empty)
+		peer->stats.doorbells++;
+	spin_unlock_irqrestore(&peer->send_lock, flags);
+
 	if (peer->ops && peer->ops->notify_recv)
 		peer->ops->notify_recv(peer);
-	wake_up_all(&peer->msg_waitq);
-	spin_unlock_irqrestore(&port->lock, flags);
+	/* a receiver only sleeps on an empty ring */
+	if (was_empty)
+		wake_up_all(&peer->msg_waitq);
 	return 0;
 
-err:
+err_port_locked:
 	spin_unlock_irqrestore(&port->lock, flags);
-	kmem_cache_free(info->msg_cache, msg);
+err:
+	if (msg)
+		kmem_cache_free(info->msg_cache, msg);
 	return ret;
 }
 
@@ -588,16 +695,50 @@ int trpc_send_msg(struct trpc_node *src, struct trpc_endpoint *from,
 	}
 }
 
-static inline struct trpc_msg *dequeue_msg_locked(struct trpc_endpoint *ep)
+/* Returns the message length, or -EAGAIN if the ring is empty */
+static int dequeue_msg(struct trpc_endpoint *ep, void *buf, size_t buf_len)
 {
-	struct trpc_msg *msg = NULL;
-
-	if (!list_empty(&ep->msg_list)) {
-		msg = list_first_entry(&ep->msg_list, struct trpc_msg, list);
-		list_del_init(&msg->list);
+	struct tegra_rpc_info *info = tegra_rpc;
+	struct trpc_ring *ring = ep->ring;
+	struct trpc_ep_stats *stats = &ep->stats;
+	struct trpc_ring_slot *slot;
+	struct trpc_msg *msg;
+	unsigned long flags;
+	unsigned int head, tail;
+	size_t len;
+	u32 lat;
+
+	spin_lock_irqsave(&ep->recv_lock, flags);
+	tail = ring->tail;
+	head = ACCESS_ONCE(ring->head);
+	if (tail == head) {
+		spin_unlock_irqrestore(&ep->recv_lock, flags);
+		return -EAGAIN;
 	}
-
-	return msg;
+	/* read the slot only after seeing the index that published it */
+	smp_rmb();
+	slot = &ring->slots[tail & (TRPC_RING_SIZE - 1)];
+	msg = slot->msg;
+	len = min(buf_len, slot->len);
+	memcpy(buf, msg ? msg->payload : slot->data, len);
+
+	lat = ktime_to_us(ktime_sub(ktime_get(), slot->stamp));
+	stats->msgs++;
+	stats->bytes += slot->len;
+	stats->lat_total_us += lat;
+	if (lat > stats->lat_max_us)
+		stats->lat_max_us = lat;
+
+	/* done with the slot before handing it back */
+	smp_mb();
+	ring->tail = tail + 1;
+	spin_unlock_irqrestore(&ep->recv_lock, flags);
+
+	if (head - tail == TRPC_RING_SIZE)
+		wake_up_all(&ep->space_waitq);
+	if (msg)
+		kmem_cache_free(info->msg_cache, msg);
+	return len;
 }
 
 static bool __should_wake(struct trpc_endpoint *ep)
@@ -607,7 +748,7 @@ static bool __should_wake(struct trpc_endpoint *ep)
 	bool ret;
 
 	spin_lock_irqsave(&port->lock, flags);
-	ret = !list_empty(&ep->msg_list) || is_closed(port);
+	ret = ring_count(ep->ring) || is_closed(port);
 	spin_unlock_irqrestore(&port->lock, flags);
 	return ret;
 }
@@ -615,21 +756,20 @@ static bool __should_wake(struct trpc_endpoint *ep)
 int trpc_recv_msg(struct trpc_node *src, struct trpc_endpoint *ep,
 		  void *buf, size_t buf_len, long timeout)
 {
-	struct tegra_rpc_info *info = tegra_rpc;
 	struct trpc_port *port = ep->port;
-	struct trpc_msg *msg;
-	size_t len;
 	long ret;
+	int len;
 	unsigned long flags;
 
 	BUG_ON(buf_len > TEGRA_RPC_MAX_MSG_LEN);
 
-	spin_lock_irqsave(&port->lock, flags);
 	/* we allow closed ports to finish receiving already-queued messages */
-	msg = dequeue_msg_locked(ep);
-	if (msg) {
-		goto got_msg;
-	} else if (is_closed(port)) {
+	len = dequeue_msg(ep, buf, buf_len);
+	if (len >= 0)
+		return len;
+
+	spin_lock_irqsave(&port->lock, flags);
+	if (is_closed(port)) {
 		ret = -ECONNRESET;
 		goto out;
 	} else if (!is_connected(port)) {
@@ -653,27 +793,20 @@ int trpc_recv_msg(struct trpc_node *src, struct trpc_endpoint *ep,
 					       timeout);
 
 	DBG(TRPC_TRACE_MSG, "%s: woke up for %s\n", __func__, port->name);
-	spin_lock_irqsave(&port->lock, flags);
-	msg = dequeue_msg_locked(ep);
-	if (!msg) {
-		if (is_closed(port))
-			ret = -ECONNRESET;
-		else if (!ret)
-			ret = -ETIMEDOUT;
-		else if (ret == -ERESTARTSYS)
-			ret = -EINTR;
-		else
-			pr_err("%s: error (%d) while receiving msg for '%s'\n",
-			       __func__, (int)ret, port->name);
-		goto out;
-	}
+	len = dequeue_msg(ep, buf, buf_len);
+	if (len >= 0)
+		return len;
 
-got_msg:
-	spin_unlock_irqrestore(&port->lock, flags);
-	len = min(buf_len, msg->len);
-	memcpy(buf, msg->payload, len);
-	kmem_cache_free(info->msg_cache, msg);
-	return len;
+	spin_lock_irqsave(&port->lock, flags);
+	if (is_closed(port))
+		ret = -ECONNRESET;
+	else if (!ret)
+		ret = -ETIMEDOUT;
+	else if (ret == -ERESTARTSYS)
+		ret = -EINTR;
+	else
+		pr_err("%s: error (%d) while receiving msg for '%s'\n",
+		       __func__, (int)ret, port->name);
 
 out:
 	spin_unlock_irqrestore(&port->lock, flags);
@@ -707,6 +840,24 @@ void trpc_node_unregister(struct trpc_node *node)
 	mutex_unlock(&info->node_lock);
 }
 
+/* received side statistics; the counters are read without locking */
+static void trpc_debug_show_stats(struct seq_file *s, struct trpc_endpoint *ep,
+				  unsigned long secs)
+{
+	struct trpc_ep_stats *stats = &ep->stats;
+	unsigned long msgs = stats->msgs;
+	u64 lat_avg = stats->lat_total_us;
+
+	if (msgs)
+		do_div(lat_avg, msgs);
+	seq_printf(s, "    msgs:%lu (%lu/s) bytes:%lu queued:%u\n"
+		   "    doorbells:%lu ring_full:%lu\n"
+		   "    latency_us avg:%llu max:%u\n",
+		   msgs, msgs / secs, stats->bytes, ring_count(ep->ring),
+		   stats->doorbells, stats->ring_full,
+		   (unsigned long long)lat_avg, stats->lat_max_us);
+}
+
 static int trpc_debug_ports_show(struct seq_file *s, void *data)
 {
 	struct tegra_rpc_info *info = s->private;
@@ -717,6 +868,8 @@ static int trpc_debug_ports_show(struct seq_file *s, void *data)
 	spin_lock_irqsave(&info->ports_lock, flags);
 	for (n = rb_first(&info->ports); n; n = rb_next(n)) {
 		struct trpc_port *port = rb_entry(n, struct trpc_port, rb_node);
+		unsigned long secs = (jiffies - port->created) / HZ ?: 1;
+
 		seq_printf(s, "port: %s\n closed:%s\n", port->name,
 			   port->closed ? "yes" : "no");
 
@@ -726,6 +879,7 @@ static int trpc_debug_ports_show(struct seq_file *s, void *data)
 			seq_printf(s, "  peer%d: %s\n    ready:%s\n", i,
 				   ep->owner ? ep->owner->name : "<none>",
 				   ep->ready ? "yes" : "no");
+			trpc_debug_show_stats(s, ep, secs);
 			if (ep->ops && ep->ops->show)
 				ep->ops->show(s, ep);
 		}
@@ -19,6 +19,7 @@
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/mm.h>
+#include <linux/moduleparam.h>
 
 #include <linux/tegra_mediaserver.h>
 #include "../avp/nvavp.h"
@@ -43,9 +44,21 @@ struct tegra_mediasrv_iram {
 	struct tegra_mediaserver_iram_info iram;
 };
 
+/*
+ * Decoder surface, pinned for its whole life.  While in use it is on the
+ * owning node's list; once freed it goes to the front of the pool.
+ */
+struct tegra_mediasrv_surface {
+	struct list_head entry;
+	struct nvmap_handle_ref *ref;
+	size_t size;
+	unsigned long physical_address;
+};
+
 struct tegra_mediasrv_node {
 	struct tegra_mediasrv_info *mediasrv;
 	struct list_head blocks;
+	struct list_head surfaces;
 	int nr_iram_shared;
 };
 
@@ -65,10 +78,163 @@ struct tegra_mediasrv_info {
 	int nr_blocks;
 	struct tegra_mediaserver_iram_info iram; /* only one supported */
 	int nr_iram_shared;
+
+	struct list_head surface_pool;	/* most recently freed first */
+	size_t surface_pool_bytes;
+	struct shrinker surface_shrinker;
 };
 
 static struct tegra_mediasrv_info *mediasrv_info;
 
+/* upper bound on memory kept in the surface pool */
+static unsigned int surface_pool_kb = 16384;
+module_param(surface_pool_kb, uint, 0644);
+MODULE_PARM_DESC(surface_pool_kb, "Max KiB of freed decoder surfaces kept");
+
+
+/*
+ * Surface pool
+ *
+ * Seeks and stream switches free and re-allocate every decoder surface
+ * at once.  Keeping freed surfaces pinned lets the next stream reuse them
+ * without another carveout allocation, pin and cache flush.  Surfaces
+ * are write-combined, so no dirty lines are left in the CPU caches and a
+ * pooled surface can be handed out as is.
+ */
+static void mediasrv_surface_destroy(struct tegra_mediasrv_info *mediasrv,
+				     struct tegra_mediasrv_surface *surface)
+{
+	nvmap_unpin(mediasrv->nvmap, surface->ref);
+	nvmap_free(mediasrv->nvmap, surface->ref);
+	kfree(surface);
+}
+
+/* drops the least recently freed surfaces until the pool fits in limit */
+static void mediasrv_pool_trim(struct tegra_mediasrv_info *mediasrv,
+			       size_t limit)
+{
+	struct tegra_mediasrv_surface *surface;
+
+	while (mediasrv->surface_pool_bytes > limit &&
+	       !list_empty(&mediasrv->surface_pool)) {
+		surface = list_entry(mediasrv->surface_pool.prev,
+				     struct tegra_mediasrv_surface, entry);
+		list_del(&surface->entry);
+		mediasrv->surface_pool_bytes -= surface->size;
+		mediasrv_surface_destroy(mediasrv, surface);
+	}
+}
+
+static struct tegra_mediasrv_surface *mediasrv_pool_get(
+	struct tegra_mediasrv_info *mediasrv, size_t size, size_t align)
+{
+	struct tegra_mediasrv_surface *surface;
+
+	list_for_each_entry(surface, &mediasrv->surface_pool, entry) {
+		if (surface->size != size ||
+		    (surface->physical_address & (align - 1)))
+			continue;
+
+		list_del(&surface->entry);
+		mediasrv->surface_pool_bytes -= size;
+		return surface;
+	}
+
+	return NULL;
+}
+
+static void mediasrv_pool_put(struct tegra_mediasrv_info *mediasrv,
+			      struct tegra_mediasrv_surface *surface)
+{
+	size_t limit = (size_t)surface_pool_kb << 10;
+
+	if (surface->size > limit) {
+		mediasrv_surface_destroy(mediasrv, surface);
+		return;
+	}
+
+	mediasrv_pool_trim(mediasrv, limit - surface->size);
+	list_add(&surface->entry, &mediasrv->surface_pool);
+	mediasrv->surface_pool_bytes += surface->size;
+}
+
+static int mediasrv_surface_new(struct tegra_mediasrv_info *mediasrv,
+				size_t size, size_t align,
+				struct tegra_mediasrv_surface **out)
+{
+	struct tegra_mediasrv_surface *surface;
+	struct nvmap_handle_ref *r;
+	bool retried = false;
+	int e;
+
+	surface = kzalloc(sizeof(struct tegra_mediasrv_surface), GFP_KERNEL);
+	CHECK_NULL(surface, surface_alloc_fail);
+
+retry:
+	r = nvmap_alloc(mediasrv->nvmap, size, align,
+			NVMAP_HANDLE_WRITE_COMBINE);
+	if (IS_ERR(r)) {
+		/* the carveout may be held by pooled surfaces of another
+		 * size; give them back and try once more */
+		if (!retried && mediasrv->surface_pool_bytes) {
+			mediasrv_pool_trim(mediasrv, 0);
+			retried = true;
+			goto retry;
+		}
+		e = PTR_ERR(r);
+		goto handle_alloc_fail;
+	}
+
+	surface->physical_address = nvmap_pin(mediasrv->nvmap, r);
+	if (IS_ERR((void *)surface->physical_address)) {
+		e = PTR_ERR((void *)surface->physical_address);
+		goto pin_fail;
+	}
+
+	/* let the media process duplicate it into its own client */
+	nvmap_ref_to_handle(r)->global = true;
+	surface->ref = r;
+	surface->size = size;
+	*out = surface;
+	return 0;
+
+pin_fail:
+	nvmap_free(mediasrv->nvmap, r);
+handle_alloc_fail:
+	kfree(surface);
+	return e;
+
+surface_alloc_fail:
+	return -ENOMEM;
+}
+
+static int mediasrv_surface_shrink(struct shrinker *shrinker, int nr_to_scan,
+				   gfp_t gfp_mask)
+{
+	struct tegra_mediasrv_info *mediasrv =
+		container_of(shrinker, struct tegra_mediasrv_info,
+			     surface_shrinker);
+	size_t bytes;
+	int pages;
+
+	/* the pool is filled from allocations made under this lock */
+	if (!mutex_trylock(&mediasrv->lock))
+		return nr_to_scan ? -1 : 0;
+
+	if (nr_to_scan) {
+		bytes = (size_t)nr_to_scan << PAGE_SHIFT;
+		if (bytes >= mediasrv->surface_pool_bytes)
+			mediasrv_pool_trim(mediasrv, 0);
+		else
+			mediasrv_pool_trim(mediasrv,
+					   mediasrv->surface_pool_bytes - bytes);
+	}
+	pages = mediasrv->surface_pool_bytes >> PAGE_SHIFT;
+	mutex_unlock(&mediasrv->lock);
+
+	return pages;
+}
+
 
 /*
  * File entry points
@@ -84,6 +250,7 @@ static int mediasrv_open(struct inode *inode, struct file *file)
 	node = kzalloc(sizeof(struct tegra_mediasrv_node), GFP_KERNEL);
 	CHECK_NULL(node, node_alloc_fail);
 	INIT_LIST_HEAD(&node->blocks);
+	INIT_LIST_HEAD(&node->surfaces);
 	node->mediasrv = mediasrv;
 
 	mutex_lock(&mediasrv->lock);
@@ -200,6 +367,16 @@ static int mediasrv_release(struct inode *inode, struct file *file)
 		kfree(block);
 	}
 
+	while (!list_empty(&node->surfaces)) {
+		struct tegra_mediasrv_surface *surface;
+
+		surface = list_first_entry(&node->surfaces,
+					   struct tegra_mediasrv_surface,
+					   entry);
+		list_del(&surface->entry);
+		mediasrv_pool_put(mediasrv, surface);
+	}
+
 	mediasrv->nr_iram_shared -= node->nr_iram_shared;
 	if (mediasrv->iram.rm_handle && !mediasrv->nr_iram_shared) {
 		pr_info("Improperly freed shared iram found!");
@@ -317,6 +494,32 @@ iram_shared_done:
 	}
 	break;
 
+	case TEGRA_MEDIASERVER_RESOURCE_SURFACE:
+	{
+		struct tegra_mediasrv_surface *surface;
+		size_t align, size;
+
+		size = PAGE_ALIGN(in->in.u.surface.size);
+		align = max_t(size_t, in->in.u.surface.alignment, PAGE_SIZE);
+		if (!size || (align & (align - 1))) {
+			e = -EINVAL;
+			goto fail;
+		}
+
+		surface = mediasrv_pool_get(mediasrv, size, align);
+		if (!surface) {
+			e = mediasrv_surface_new(mediasrv, size, align,
+						 &surface);
+			CHECK_STATUS(e, fail);
+		}
+
+		list_add(&surface->entry, &node->surfaces);
+		out->out.u.surface.rm_handle = nvmap_ref_to_id(surface->ref);
+		out->out.u.surface.physical_address =
+			surface->physical_address;
+	}
+	break;
+
 	default:
 	{
 		e = -EINVAL;
@@ -381,6 +584,22 @@ static void mediasrv_free(struct tegra_mediasrv_node *node,
 			goto done;
 	}
 	break;
+
+	case TEGRA_MEDIASERVER_RESOURCE_SURFACE:
+	{
+		struct tegra_mediasrv_surface *surface;
+
+		list_for_each_entry(surface, &node->surfaces, entry) {
+			if (nvmap_ref_to_id(surface->ref) !=
+			    (unsigned long)in->in.u.surface_rm_handle)
+				continue;
+
+			list_del(&surface->entry);
+			mediasrv_pool_put(mediasrv, surface);
+			break;
+		}
+	}
+	break;
 	}
 
 done:
@@ -469,6 +688,7 @@ static long mediasrv_unlocked_ioctl(struct file *file, unsigned int cmd,
 copy_fail:
 	e = -EFAULT;
 fail:
+	mutex_unlock(&mediasrv->lock);
 	return e;
 }
 
@@ -506,6 +726,10 @@ static int __init tegra_mediaserver_init(void)
 
 	mediasrv->nr_nodes = 0;
 	mutex_init(&mediasrv->lock);
+	INIT_LIST_HEAD(&mediasrv->surface_pool);
+	mediasrv->surface_shrinker.shrink = mediasrv_surface_shrink;
+	mediasrv->surface_shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&mediasrv->surface_shrinker);
 
 	mediasrv_info = mediasrv;
 	goto done;
@@ -540,6 +764,8 @@ void __exit tegra_mediaserver_cleanup(void)
 	e = misc_deregister(&mediaserver_misc_device);
 	CHECK_STATUS(e, fail);
 
+	unregister_shrinker(&mediasrv->surface_shrinker);
+	mediasrv_pool_trim(mediasrv, 0);
 	nvmap_client_put(mediasrv->nvmap);
 	kfree(mediasrv);
 	mediasrv_info = NULL;
@@ -21,10 +21,7 @@
 #include <linux/uaccess.h>
 #include <media/ov2710.h>
 
-struct ov2710_reg {
-	u16 addr;
-	u16 val;
-};
+#include "sensor_table.h"
 
 struct ov2710_info {
 	int mode;
@@ -32,11 +29,11 @@ struct ov2710_info {
 	struct ov2710_platform_data *pdata;
 };
 
-#define OV2710_TABLE_WAIT_MS 0
-#define OV2710_TABLE_END 1
+#define OV2710_TABLE_WAIT_MS SENSOR_TABLE_WAIT_MS
+#define OV2710_TABLE_END SENSOR_TABLE_END
 #define OV2710_MAX_RETRIES 3
 
-static struct ov2710_reg mode_start[] = {
+static struct sensor_reg mode_start[] = {
 	{0x3008, 0x82}, /* reset registers pg 72 */
 	{OV2710_TABLE_WAIT_MS, 5},
 	{0x3008, 0x42}, /* register power down pg 72 */
@@ -95,7 +92,7 @@ static struct ov2710_reg mode_start[] = {
 	{OV2710_TABLE_END, 0x0},
 };
 
-static struct ov2710_reg mode_1920x1080[] = {
+static struct sensor_reg mode_1920x1080[] = {
 	{0x3103, 0x93},
 	{0x3008, 0x82},
 	{0x3017, 0x7f},
@@ -173,7 +170,7 @@ static struct ov2710_reg mode_1920x1080[] = {
 	{OV2710_TABLE_END, 0x0000}
 };
 
-static struct ov2710_reg mode_1280x720[] = {
+static struct sensor_reg mode_1280x720[] = {
 	{0x3008, 0x82},
 	{OV2710_TABLE_WAIT_MS, 5},
 	{0x3008, 0x02},
@@ -290,7 +287,7 @@ static struct ov2710_reg mode_1280x720[] = {
 	{OV2710_TABLE_END, 0x0000}
 };
 
-static struct ov2710_reg mode_end[] = {
+static struct sensor_reg mode_end[] = {
 	{0x3212, 0x00}, /* SRM_GROUP_ACCESS (group hold begin) */
 	{0x3003, 0x01}, /* reset DVP pg 97 */
 	{0x3212, 0x10}, /* SRM_GROUP_ACCESS (group hold end) */
@@ -306,13 +303,13 @@ enum {
 	OV2710_MODE_1280x720,
 };
 
-static struct ov2710_reg *mode_table[] = {
+static struct sensor_reg *mode_table[] = {
 	[OV2710_MODE_1920x1080] = mode_1920x1080,
 	[OV2710_MODE_1280x720] = mode_1280x720,
 };
 
 /* 2 regs to program frame length */
-static inline void ov2710_get_frame_length_regs(struct ov2710_reg *regs,
+static inline void ov2710_get_frame_length_regs(struct sensor_reg *regs,
 						u32 frame_length)
 {
 	regs->addr = 0x380e;
@@ -322,7 +319,7 @@ static inline void ov2710_get_frame_length_regs(struct ov2710_reg *regs,
 }
 
 /* 3 regs to program coarse time */
-static inline void ov2710_get_coarse_time_regs(struct ov2710_reg *regs,
+static inline void ov2710_get_coarse_time_regs(struct sensor_reg *regs,
 					       u32 coarse_time)
 {
 	regs->addr = 0x3500;
@@ -334,7 +331,7 @@ static inline void ov2710_get_coarse_time_regs(struct ov2710_reg *regs,
 }
 
 /* 1 reg to program gain */
-static inline void ov2710_get_gain_reg(struct ov2710_reg *regs, u16 gain)
+static inline void ov2710_get_gain_reg(struct sensor_reg *regs, u16 gain)
 {
 	regs->addr = 0x350b;
 	regs->val = gain;
@@ -406,46 +403,19 @@ static int ov2710_write_reg(struct i2c_client *client, u16 addr, u8 val)
 }
 
 static int ov2710_write_table(struct i2c_client *client,
-			      const struct ov2710_reg table[],
-			      const struct ov2710_reg override_list[],
+			      const struct sensor_reg table[],
+			      const struct sensor_reg override_list[],
 			      int num_override_regs)
 {
-	int err;
-	const struct ov2710_reg *next;
-	int i;
-	u16 val;
-
-	for (next = table; next->addr != OV2710_TABLE_END; next++) {
-		if (next->addr == OV2710_TABLE_WAIT_MS) {
-			msleep(next->val);
-			continue;
-		}
-
-		val = next->val;
-
-		/* When an override list is passed in, replace the reg */
-		/* value to write if the reg is in the list            */
-		if (override_list) {
-			for (i = 0; i < num_override_regs; i++) {
-				if (next->addr == override_list[i].addr) {
-					val = override_list[i].val;
-					break;
-				}
-			}
-		}
-
-		err = ov2710_write_reg(client, next->addr, val);
-		if (err)
-			return err;
-	}
-	return 0;
+	return sensor_write_table(client, table, override_list,
+		num_override_regs, 0);
 }
 
 static int ov2710_set_mode(struct ov2710_info *info, struct ov2710_mode *mode)
 {
 	int sensor_mode;
 	int err;
-	struct ov2710_reg reg_list[6];
+	struct sensor_reg reg_list[6];
 
 	pr_info("%s: xres %u yres %u framelength %u coarsetime %u gain %u\n",
 		__func__, mode->xres, mode->yres, mode->frame_length,
@@ -477,57 +447,35 @@ static int ov2710_set_mode(struct ov2710_info *info, struct ov2710_mode *mode)
 
 static int ov2710_set_frame_length(struct ov2710_info *info, u32 frame_length)
 {
-	struct ov2710_reg reg_list[2];
-	int i = 0;
-	int ret;
+	struct sensor_reg reg_list[2];
 
 	ov2710_get_frame_length_regs(reg_list, frame_length);
 
-	for (i = 0; i < 2; i++)	{
-		ret = ov2710_write_reg(info->i2c_client, reg_list[i].addr,
-			reg_list[i].val);
-		if (ret)
-			return ret;
-	}
-
-	return 0;
+	return sensor_write_regs(info->i2c_client, reg_list,
+		ARRAY_SIZE(reg_list), 0);
 }
 
 static int ov2710_set_coarse_time(struct ov2710_info *info, u32 coarse_time)
 {
-	int ret;
-
-	struct ov2710_reg reg_list[3];
-	int i = 0;
-
-	ov2710_get_coarse_time_regs(reg_list, coarse_time);
-
-	ret = ov2710_write_reg(info->i2c_client, 0x3212, 0x01);
-	if (ret)
-		return ret;
-
-	for (i = 0; i < 3; i++)	{
-		ret = ov2710_write_reg(info->i2c_client, reg_list[i].addr,
-			reg_list[i].val);
-		if (ret)
-			return ret;
-	}
-
-	ret = ov2710_write_reg(info->i2c_client, 0x3212, 0x11);
-	if (ret)
-		return ret;
-
-	ret = ov2710_write_reg(info->i2c_client, 0x3212, 0xa1);
-	if (ret)
-		return ret;
-
-	return 0;
+	struct sensor_reg reg_list[6];
+
+	/* the exposure is latched through a register group hold */
+	reg_list[0].addr = 0x3212;
+	reg_list[0].val = 0x01;
+	ov2710_get_coarse_time_regs(reg_list + 1, coarse_time);
+	reg_list[4].addr = 0x3212;
+	reg_list[4].val = 0x11;
+	reg_list[5].addr = 0x3212;
+	reg_list[5].val = 0xa1;
+
+	return sensor_write_regs(info->i2c_client, reg_list,
+		ARRAY_SIZE(reg_list), 0);
 }
 
 static int ov2710_set_gain(struct ov2710_info *info, u16 gain)
 {
 	int ret;
-	struct ov2710_reg reg_list;
+	struct sensor_reg reg_list;
 
 	ov2710_get_gain_reg(&reg_list, gain);
 
@@ -21,10 +21,7 @@
 #include <linux/uaccess.h>
 #include <media/ov5650.h>
 
-struct ov5650_reg {
-	u16 addr;
-	u16 val;
-};
+#include "sensor_table.h"
 
 enum StereoCameraMode{
 	/* Sets the default camera to Main */
@@ -53,36 +50,36 @@ struct ov5650_info {
 
 static struct ov5650_info *info;
 
-#define OV5650_TABLE_WAIT_MS 0
-#define OV5650_TABLE_END 1
+#define OV5650_TABLE_WAIT_MS SENSOR_TABLE_WAIT_MS
+#define OV5650_TABLE_END SENSOR_TABLE_END
 #define OV5650_MAX_RETRIES 3
 
-static struct ov5650_reg tp_none_seq[] = {
+static struct sensor_reg tp_none_seq[] = {
 	{0x5046, 0x00}, /* isp_off */
 	{OV5650_TABLE_END, 0x0000}
 };
 
-static struct ov5650_reg tp_cbars_seq[] = {
+static struct sensor_reg tp_cbars_seq[] = {
 	{0x503D, 0xC0},
 	{0x503E, 0x00},
 	{0x5046, 0x01}, /* isp_on */
 	{OV5650_TABLE_END, 0x0000}
 };
 
-static struct ov5650_reg tp_checker_seq[] = {
+static struct sensor_reg tp_checker_seq[] = {
 	{0x503D, 0xC0},
 	{0x503E, 0x0A},
 	{0x5046, 0x01}, /* isp_on */
 	{OV5650_TABLE_END, 0x0000}
 };
 
-static struct ov5650_reg *test_pattern_modes[] = {
+static struct sensor_reg *test_pattern_modes[] = {
 	tp_none_seq,
 	tp_cbars_seq,
 	tp_checker_seq,
 };
 
-static struct ov5650_reg reset_seq[] = {
+static struct sensor_reg reset_seq[] = {
 	{0x3008, 0x82}, /* reset registers pg 72 */
 	{OV5650_TABLE_WAIT_MS, 5},
 	{0x3008, 0x42}, /* register power down pg 72 */
@@ -90,7 +87,7 @@ static struct ov5650_reg reset_seq[] = {
 	{OV5650_TABLE_END, 0x0000},
 };
 
-static struct ov5650_reg mode_start[] = {
+static struct sensor_reg mode_start[] = {
 	{0x3103, 0x93}, /* power up system clock from PLL page 77 */
 	{0x3017, 0xff}, /* PAD output enable page 100 */
 	{0x3018, 0xfc}, /* PAD output enable page 100 */
@@ -145,7 +142,7 @@ static struct ov5650_reg mode_start[] = {
 	{OV5650_TABLE_END, 0x0},
 };
 
-static struct ov5650_reg mode_2592x1944[] = {
+static struct sensor_reg mode_2592x1944[] = {
 	{0x3621, 0x2f}, /* analog horizontal binning/sampling not enabled.
 			   pg 108 */
 	{0x3632, 0x55}, /* analog pg 108 */
@@ -199,7 +196,7 @@ static struct ov5650_reg mode_2592x1944[] = {
 	{OV5650_TABLE_END, 0x0000}
 };
 
-static struct ov5650_reg mode_1296x972[] = {
+static struct sensor_reg mode_1296x972[] = {
 	{0x3621, 0xaf}, /* analog horizontal binning/sampling not enabled.
 			   pg 108 */
 	{0x3632, 0x5a}, /* analog pg 108 */
@@ -252,7 +249,7 @@ static struct ov5650_reg mode_1296x972[] = {
 	{OV5650_TABLE_END, 0x0000}
 };
 
-static struct ov5650_reg mode_2080x1164[] = {
+static struct sensor_reg mode_2080x1164[] = {
 	{0x3103, 0x93}, // power up system clock from PLL page 77
 	{0x3007, 0x3b}, // clock enable03 pg 98
 	{0x3017, 0xff}, // PAD output enable page 100
@@ -363,7 +360,7 @@ static struct ov5650_reg mode_2080x1164[] = {
 	{OV5650_TABLE_END, 0x0000}
 };
 
-static struct ov5650_reg mode_1264x704[] = {
+static struct sensor_reg mode_1264x704[] = {
 	{0x3600, 0x54}, /* analog pg 108 */
 	{0x3601, 0x05}, /* analog pg 108 */
 	{0x3604, 0x40}, /* analog pg 108 */
@@ -452,7 +449,7 @@ static struct ov5650_reg mode_1264x704[] = {
 	{OV5650_TABLE_END, 0x0000}
 };
 
-static struct ov5650_reg mode_end[] = {
+static struct sensor_reg mode_end[] = {
 	{0x3212, 0x00}, /* SRM_GROUP_ACCESS (group hold begin) */
 	{0x3003, 0x01}, /* reset DVP pg 97 */
 	{0x3212, 0x10}, /* SRM_GROUP_ACCESS (group hold end) */
@@ -470,7 +467,7 @@ enum {
 	OV5650_MODE_1264x704
 };
 
-static struct ov5650_reg *mode_table[] = {
+static struct sensor_reg *mode_table[] = {
 	[OV5650_MODE_2592x1944] = mode_2592x1944,
 	[OV5650_MODE_1296x972] = mode_1296x972,
 	[OV5650_MODE_2080x1164] = mode_2080x1164,
@@ -478,7 +475,7 @@ static struct ov5650_reg *mode_table[] = {
 };
 
 /* 2 regs to program frame length */
-static inline void ov5650_get_frame_length_regs(struct ov5650_reg *regs,
+static inline void ov5650_get_frame_length_regs(struct sensor_reg *regs,
 						u32 frame_length)
 {
 	regs->addr = 0x380e;
@@ -488,7 +485,7 @@ static inline void ov5650_get_frame_length_regs(struct ov5650_reg *regs,
 }
 
 /* 3 regs to program coarse time */
-static inline void ov5650_get_coarse_time_regs(struct ov5650_reg *regs,
+static inline void ov5650_get_coarse_time_regs(struct sensor_reg *regs,
                                                u32 coarse_time)
 {
 	regs->addr = 0x3500;
@@ -500,7 +497,7 @@ static inline void ov5650_get_coarse_time_regs(struct ov5650_reg *regs,
 }
 
 /* 1 reg to program gain */
-static inline void ov5650_get_gain_reg(struct ov5650_reg *regs, u16 gain)
+static inline void ov5650_get_gain_reg(struct sensor_reg *regs, u16 gain)
 {
 	regs->addr = 0x350b;
 	regs->val = gain;
@@ -562,47 +559,60 @@ static int ov5650_write_reg_helper(struct ov5650_info *info,
 	return ret;
 }
 
+/* the sensors the current camera mode writes to, left first */
+static int ov5650_get_clients(struct ov5650_info *info,
+			      struct i2c_client *clients[])
+{
+	switch (info->camera_mode) {
+	case Main:
+	case LeftOnly:
+		clients[0] = info->left.i2c_client;
+		return 1;
+	case Stereo:
+		clients[0] = info->left.i2c_client;
+		clients[1] = info->right.i2c_client;
+		return 2;
+	case RightOnly:
+		clients[0] = info->right.i2c_client;
+		return 1;
+	default:
+		return -1;
+	}
+}
+
 static int ov5650_write_table(struct ov5650_info *info,
-				const struct ov5650_reg table[],
-				const struct ov5650_reg override_list[],
+				const struct sensor_reg table[],
+				const struct sensor_reg override_list[],
 				int num_override_regs)
 {
-	int err;
-	const struct ov5650_reg *next;
-	int i;
-	u16 val;
-
-	for (next = table; next->addr != OV5650_TABLE_END; next++) {
-		if (next->addr == OV5650_TABLE_WAIT_MS) {
-			msleep(next->val);
-			continue;
-		}
+	struct i2c_client *clients[SENSOR_TABLE_MAX_CLIENTS];
+	int num_clients = ov5650_get_clients(info, clients);
 
-		val = next->val;
+	if (num_clients < 0)
+		return -1;
 
-		/* When an override list is passed in, replace the reg */
-		/* value to write if the reg is in the list            */
-		if (override_list) {
-			for (i = 0; i < num_override_regs; i++) {
-				if (next->addr == override_list[i].addr) {
-					val = override_list[i].val;
-					break;
-				}
-			}
-		}
+	/* stereo sensors are written in lock step */
+	return sensor_write_table_clients(clients, num_clients, table,
+		override_list, num_override_regs, 0);
+}
 
-		err = ov5650_write_reg_helper(info, next->addr, val);
-		if (err)
-			return err;
-	}
-	return 0;
+static int ov5650_write_regs(struct ov5650_info *info,
+			     const struct sensor_reg regs[], int num)
+{
+	struct i2c_client *clients[SENSOR_TABLE_MAX_CLIENTS];
+	int num_clients = ov5650_get_clients(info, clients);
+
+	if (num_clients < 0)
+		return -1;
+
+	return sensor_write_regs_clients(clients, num_clients, regs, num, 0);
 }
 
 static int ov5650_set_mode(struct ov5650_info *info, struct ov5650_mode *mode)
 {
 	int sensor_mode;
 	int err;
-	struct ov5650_reg reg_list[6];
+	struct sensor_reg reg_list[6];
 
 	pr_info("%s: xres %u yres %u framelength %u coarsetime %u gain %u\n",
 		__func__, mode->xres, mode->yres, mode->frame_length,
@@ -650,57 +660,33 @@ static int ov5650_set_mode(struct ov5650_info *info, struct ov5650_mode *mode)
 
 static int ov5650_set_frame_length(struct ov5650_info *info, u32 frame_length)
 {
-	struct ov5650_reg reg_list[2];
-	int i = 0;
-	int ret;
+	struct sensor_reg reg_list[2];
 
 	ov5650_get_frame_length_regs(reg_list, frame_length);
 
-	for (i = 0; i < 2; i++)	{
-		ret = ov5650_write_reg_helper(info, reg_list[i].addr,
-			reg_list[i].val);
-		if (ret)
-			return ret;
-	}
-
-	return 0;
+	return ov5650_write_regs(info, reg_list, ARRAY_SIZE(reg_list));
 }
 
 static int ov5650_set_coarse_time(struct ov5650_info *info, u32 coarse_time)
 {
-	int ret;
-
-	struct ov5650_reg reg_list[3];
-	int i = 0;
-
-	ov5650_get_coarse_time_regs(reg_list, coarse_time);
-
-	ret = ov5650_write_reg_helper(info, 0x3212, 0x01);
-	if (ret)
-		return ret;
-
-	for (i = 0; i < 3; i++)	{
-		ret = ov5650_write_reg_helper(info, reg_list[i].addr,
-			reg_list[i].val);
-		if (ret)
-			return ret;
-	}
-
-	ret = ov5650_write_reg_helper(info, 0x3212, 0x11);
-	if (ret)
-		return ret;
-
-	ret = ov5650_write_reg_helper(info, 0x3212, 0xa1);
-	if (ret)
-		return ret;
-
-	return 0;
+	struct sensor_reg reg_list[6];
+
+	/* the exposure is latched through a register group hold */
+	reg_list[0].addr = 0x3212;
+	reg_list[0].val = 0x01;
+	ov5650_get_coarse_time_regs(reg_list + 1, coarse_time);
+	reg_list[4].addr = 0x3212;
+	reg_list[4].val = 0x11;
+	reg_list[5].addr = 0x3212;
+	reg_list[5].val = 0xa1;
+
+	return ov5650_write_regs(info, reg_list, ARRAY_SIZE(reg_list));
 }
 
 static int ov5650_set_gain(struct ov5650_info *info, u16 gain)
 {
 	int ret;
-	struct ov5650_reg reg_list;
+	struct sensor_reg reg_list;
 
 	ov5650_get_gain_reg(&reg_list, gain);
 
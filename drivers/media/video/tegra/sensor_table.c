@@ -0,0 +1,184 @@
+/*
+ * sensor_table.c - batched register table writes for tegra camera sensors
+ *
+ * Sensor mode tables are hundreds of single register writes. Writing
+ * them one i2c_transfer() at a time costs a full bus transaction and a
+ * controller interrupt per register, so runs of consecutive addresses
+ * are merged into auto-increment bursts and several bursts share one
+ * transfer.
+ *
+ * This file is licensed under the terms of the GNU General Public License
+ * version 2. This program is licensed "as is" without any warranty of any
+ * kind, whether express or implied.
+ */
+
+#include <linux/delay.h>
+#include <linux/i2c.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include "sensor_table.h"
+
+#define SENSOR_BURST_MAX	16	/* data bytes per message */
+#define SENSOR_MSGS_MAX		8	/* messages per i2c_transfer() */
+#define SENSOR_MAX_RETRIES	3
+
+struct sensor_batch {
+	struct i2c_client *client;
+	int addr_len;
+	struct i2c_msg msgs[SENSOR_MSGS_MAX];
+	u8 bufs[SENSOR_MSGS_MAX][2 + SENSOR_BURST_MAX];
+	int num_msgs;
+	u16 next_addr;
+};
+
+static int sensor_batch_flush(struct sensor_batch *batch)
+{
+	int retry = 0;
+	int err;
+
+	if (!batch->num_msgs)
+		return 0;
+
+	do {
+		err = i2c_transfer(batch->client->adapter, batch->msgs,
+			batch->num_msgs);
+		if (err == batch->num_msgs) {
+			batch->num_msgs = 0;
+			return 0;
+		}
+		retry++;
+		pr_err("%s: i2c transfer failed at 0x%02x%02x, retrying\n",
+			__func__, batch->bufs[0][0],
+			batch->addr_len > 1 ? batch->bufs[0][1] : 0);
+		msleep(3);
+	} while (retry <= SENSOR_MAX_RETRIES);
+
+	batch->num_msgs = 0;
+	return err < 0 ? err : -EIO;
+}
+
+static int sensor_batch_add(struct sensor_batch *batch, u16 addr, u8 val)
+{
+	struct i2c_msg *msg = NULL;
+	int err;
+
+	if (batch->num_msgs)
+		msg = &batch->msgs[batch->num_msgs - 1];
+
+	/* extend the last burst if this is the next register */
+	if (msg && addr == batch->next_addr &&
+		msg->len < batch->addr_len + SENSOR_BURST_MAX) {
+		msg->buf[msg->len++] = val;
+		batch->next_addr = addr + 1;
+		return 0;
+	}
+
+	if (batch->num_msgs == SENSOR_MSGS_MAX) {
+		err = sensor_batch_flush(batch);
+		if (err)
+			return err;
+	}
+
+	msg = &batch->msgs[batch->num_msgs];
+	msg->addr = batch->client->addr;
+	msg->flags = 0;
+	msg->buf = batch->bufs[batch->num_msgs];
+	msg->len = 0;
+	if (batch->addr_len > 1)
+		msg->buf[msg->len++] = (u8)(addr >> 8);
+	msg->buf[msg->len++] = (u8)(addr & 0xff);
+	msg->buf[msg->len++] = val;
+	batch->num_msgs++;
+	batch->next_addr = addr + 1;
+	return 0;
+}
+
+static int sensor_flush_all(struct sensor_batch *batches, int num_clients)
+{
+	int i, err;
+
+	for (i = 0; i < num_clients; i++) {
+		err = sensor_batch_flush(&batches[i]);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
+/* num < 0 walks the table up to SENSOR_TABLE_END */
+static int sensor_write(struct i2c_client *const clients[], int num_clients,
+	const struct sensor_reg regs[], int num,
+	const struct sensor_reg override_list[], int num_override_regs,
+	unsigned int flags)
+{
+	struct sensor_batch batches[SENSOR_TABLE_MAX_CLIENTS];
+	const struct sensor_reg *next;
+	int i, err;
+	u16 val;
+
+	if (num_clients <= 0 || num_clients > SENSOR_TABLE_MAX_CLIENTS)
+		return -EINVAL;
+
+	for (i = 0; i < num_clients; i++) {
+		if (!clients[i] || !clients[i]->adapter)
+			return -ENODEV;
+		batches[i].client = clients[i];
+		batches[i].addr_len = (flags & SENSOR_TABLE_ADDR8) ? 1 : 2;
+		batches[i].num_msgs = 0;
+	}
+
+	for (next = regs; num < 0 || next < regs + num; next++) {
+		if (num < 0) {
+			if (next->addr == SENSOR_TABLE_END)
+				break;
+			if (next->addr == SENSOR_TABLE_WAIT_MS) {
+				err = sensor_flush_all(batches, num_clients);
+				if (err)
+					return err;
+				msleep(next->val);
+				continue;
+			}
+		}
+
+		val = next->val;
+
+		/* When an override list is passed in, replace the reg */
+		/* value to write if the reg is in the list            */
+		for (i = 0; i < num_override_regs; i++) {
+			if (next->addr == override_list[i].addr) {
+				val = override_list[i].val;
+				break;
+			}
+		}
+
+		for (i = 0; i < num_clients; i++) {
+			err = sensor_batch_add(&batches[i], next->addr, val);
+			if (err)
+				return err;
+		}
+	}
+
+	return sensor_flush_all(batches, num_clients);
+}
+
+int sensor_write_table_clients(struct i2c_client *const clients[],
+	int num_clients, const struct sensor_reg table[],
+	const struct sensor_reg override_list[], int num_override_regs,
+	unsigned int flags)
+{
+	return sensor_write(clients, num_clients, table, -1,
+		override_list, override_list ? num_override_regs : 0, flags);
+}
+EXPORT_SYMBOL(sensor_write_table_clients);
+
+int sensor_write_regs_clients(struct i2c_client *const clients[],
+	int num_clients, const struct sensor_reg regs[], int num,
+	unsigned int flags)
+{
+	return sensor_write(clients, num_clients, regs, num, NULL, 0, flags);
+}
+EXPORT_SYMBOL(sensor_write_regs_clients);
+
+MODULE_DESCRIPTION("Tegra camera sensor register tables");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,61 @@
+/*
+ * sensor_table.h - batched register table writes for tegra camera sensors
+ *
+ * This file is licensed under the terms of the GNU General Public License
+ * version 2. This program is licensed "as is" without any warranty of any
+ * kind, whether express or implied.
+ */
+
+#ifndef __SENSOR_TABLE_H__
+#define __SENSOR_TABLE_H__
+
+#include <linux/i2c.h>
+
+struct sensor_reg {
+	u16 addr;
+	u16 val;
+};
+
+/* sentinel addresses in tables passed to sensor_write_table() */
+#define SENSOR_TABLE_WAIT_MS	0
+#define SENSOR_TABLE_END	1
+
+/* flags */
+#define SENSOR_TABLE_ADDR8	(1 << 0)	/* one byte register address */
+
+#define SENSOR_TABLE_MAX_CLIENTS	2
+
+/*
+ * Write a table terminated by SENSOR_TABLE_END to every client in lock
+ * step. Registers at consecutive addresses go out as one auto-increment
+ * burst and independent bursts are grouped into one i2c_transfer(); the
+ * queue is flushed at every SENSOR_TABLE_WAIT_MS entry before sleeping.
+ * A register that appears in override_list is written with the value
+ * from that list instead.
+ */
+int sensor_write_table_clients(struct i2c_client *const clients[],
+	int num_clients, const struct sensor_reg table[],
+	const struct sensor_reg override_list[], int num_override_regs,
+	unsigned int flags);
+
+/* like sensor_write_table_clients(), for num regs without sentinels */
+int sensor_write_regs_clients(struct i2c_client *const clients[],
+	int num_clients, const struct sensor_reg regs[], int num,
+	unsigned int flags);
+
+static inline int sensor_write_table(struct i2c_client *client,
+	const struct sensor_reg table[],
+	const struct sensor_reg override_list[], int num_override_regs,
+	unsigned int flags)
+{
+	return sensor_write_table_clients(&client, 1, table, override_list,
+		num_override_regs, flags);
+}
+
+static inline int sensor_write_regs(struct i2c_client *client,
+	const struct sensor_reg regs[], int num, unsigned int flags)
+{
+	return sensor_write_regs_clients(&client, 1, regs, num, flags);
+}
+
+#endif  /* __SENSOR_TABLE_H__ */
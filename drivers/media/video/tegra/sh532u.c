@@ -28,11 +28,14 @@
 
 #include <asm/traps.h>
 
+#include "sensor_table.h"
+
 #define POS_LOW (0xA000)
 #define POS_HIGH (0x6000)
 #define SETTLETIME_MS (7)
 #define FOCAL_LENGTH 0x408d70a4 /* (4.42f) */
 #define FNUMBER 0x40333333 /* (2.8f) */
+#define INIT_QUEUE_LEN 32
 
 
 struct sh532u_info {
@@ -414,11 +417,22 @@ static void sh532u_hvca_wr2(u8 ep_type, u8 ep_data1, u8 ep_data2, u8 ep_addr)
 		pr_err("Focuser: Failed to init!\n");
 }
 
+/* direct init writes are queued and sent in bursts */
+static void sh532u_flush_init_regs(struct sensor_reg *regs, int *num_regs)
+{
+	if (*num_regs && sensor_write_regs(info->i2c_client, regs, *num_regs,
+		SENSOR_TABLE_ADDR8))
+		pr_err("Focuser: Failed to init!\n");
+	*num_regs = 0;
+}
+
 static void init_driver(void)
 {
 	int eeprom_addr;
 	unsigned int eeprom_data;
 	u8 ep_addr, ep_type, ep_data1, ep_data2, uc_data;
+	struct sensor_reg regs[INIT_QUEUE_LEN];
+	int num_regs = 0;
 
 	for (eeprom_addr = 0x30; eeprom_addr <= 0x013C; eeprom_addr += 4) {
 		if (eeprom_addr > 0xff) {
@@ -439,8 +453,21 @@ static void init_driver(void)
 			break;
 
 		if (ep_addr == 0xDD) {
+			sh532u_flush_init_regs(regs, &num_regs);
 			mdelay((unsigned int)((ep_data1 << 8) | ep_data2));
+		} else if ((ep_type & 0xF0) == DIRECT_MODE) {
+			if (num_regs + 2 > INIT_QUEUE_LEN)
+				sh532u_flush_init_regs(regs, &num_regs);
+			/* a 2 byte value is the high byte then the next reg */
+			regs[num_regs].addr = ep_addr;
+			regs[num_regs++].val = ep_data1;
+			if ((ep_type & 0x0F) != DATA_1BYTE) {
+				regs[num_regs].addr = ep_addr + 1;
+				regs[num_regs++].val = ep_data2;
+			}
 		} else {
+			/* read-modify-write must see the queued values */
+			sh532u_flush_init_regs(regs, &num_regs);
 			if ((ep_type & 0x0F) == DATA_1BYTE) {
 				sh532u_hvca_wr1(ep_type, ep_data1, ep_addr);
 			} else {
@@ -451,6 +478,7 @@ static void init_driver(void)
 			}
 		}
 	}
+	sh532u_flush_init_regs(regs, &num_regs);
 	msleep(300);
 
 	init_hvca_pos();
@@ -23,11 +23,21 @@
 #include <linux/io.h>
 #include <linux/uaccess.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 #include <mach/iomap.h>
 #include <mach/clk.h>
+#include <mach/nvmap.h>
 
 #include <media/tegra_camera.h>
 
+#include "../../../video/tegra/host/dev.h"
+#include "../../../video/tegra/nvmap/nvmap.h"
+
 /* Eventually this should handle all clock and reset calls for the isp, vi,
  * vi_sensor, and csi modules, replacing nvrm and nvos completely for camera
  */
@@ -111,6 +121,273 @@ struct tegra_camera_block tegra_camera_block[] = {
 #define TEGRA_CAMERA_PD2VI_CLK_SEL_VI_SENSOR_CLK (1<<25)
 #define TEGRA_CAMERA_PD2VI_CLK_SEL_PD2VI_CLK 0
 
+/*
+ * Kernel side capture queue.  Frame completion is taken from the VI sync
+ * point interrupt rather than from the camera HAL waking up, so frames
+ * that land while userspace is busy wait on the done list, each with the
+ * time it completed.
+ */
+struct tegra_camera_buffer {
+	struct nvmap_handle_ref *handle;
+	unsigned long phys;
+	struct list_head list;
+	struct nvhost_intr_callback cb;
+	void *intr_ref;		/* set while queued or done */
+	u32 thresh;
+	u32 sequence;
+	u64 timestamp_us;
+};
+
+static struct tegra_camera_capture {
+	struct nvmap_client *nvmap;
+	u32 syncpt_id;
+	int num_buffers;
+	struct tegra_camera_buffer buffers[TEGRA_CAMERA_MAX_BUFFERS];
+
+	spinlock_t lock;	/* done list, intr_ref and active */
+	struct list_head done;
+	wait_queue_head_t waitq;
+	u32 sequence;
+	bool active;
+} capture;
+
+static void tegra_camera_frame_done(struct nvhost_intr_callback *cb)
+{
+	struct tegra_camera_buffer *buf =
+		container_of(cb, struct tegra_camera_buffer, cb);
+	unsigned long flags;
+
+	spin_lock_irqsave(&capture.lock, flags);
+	buf->timestamp_us = ktime_to_us(ktime_get());
+	buf->sequence = capture.sequence++;
+	list_add_tail(&buf->list, &capture.done);
+	spin_unlock_irqrestore(&capture.lock, flags);
+
+	wake_up_interruptible(&capture.waitq);
+}
+
+/* must be called with tegra_camera_lock held */
+static void tegra_camera_capture_teardown(void)
+{
+	void *refs[TEGRA_CAMERA_MAX_BUFFERS];
+	unsigned long flags;
+	int i;
+
+	if (!capture.nvmap)
+		return;
+
+	spin_lock_irqsave(&capture.lock, flags);
+	capture.active = false;
+	for (i = 0; i < capture.num_buffers; i++) {
+		refs[i] = capture.buffers[i].intr_ref;
+		capture.buffers[i].intr_ref = NULL;
+	}
+	spin_unlock_irqrestore(&capture.lock, flags);
+	wake_up_interruptible(&capture.waitq);
+
+	/* after this no frame-done callback can still be running */
+	for (i = 0; i < capture.num_buffers; i++)
+		if (refs[i])
+			nvhost_intr_put_ref(&nvhost->intr, refs[i]);
+
+	spin_lock_irqsave(&capture.lock, flags);
+	INIT_LIST_HEAD(&capture.done);
+	spin_unlock_irqrestore(&capture.lock, flags);
+
+	for (i = 0; i < capture.num_buffers; i++) {
+		struct tegra_camera_buffer *buf = &capture.buffers[i];
+
+		nvmap_unpin(capture.nvmap, buf->handle);
+		nvmap_free(capture.nvmap, buf->handle);
+		buf->handle = NULL;
+	}
+	capture.num_buffers = 0;
+
+	nvmap_client_put(capture.nvmap);
+	capture.nvmap = NULL;
+	nvhost_module_idle(&nvhost->mod);
+}
+
+static int tegra_camera_pin_buffer(struct nvmap_client *user_nvmap,
+				   struct tegra_camera_buffer *buf, u32 id)
+{
+	struct nvmap_handle *handle;
+
+	/* hold our own reference so the HAL can't free it under the VI */
+	handle = nvmap_get_handle_id(user_nvmap, id);
+	if (!handle)
+		return -EPERM;
+	buf->handle = nvmap_duplicate_handle_id(capture.nvmap, id);
+	nvmap_handle_put(handle);
+	if (IS_ERR(buf->handle)) {
+		int err = PTR_ERR(buf->handle);
+
+		buf->handle = NULL;
+		return err;
+	}
+
+	buf->phys = nvmap_pin(capture.nvmap, buf->handle);
+	if (IS_ERR((void *)buf->phys)) {
+		nvmap_free(capture.nvmap, buf->handle);
+		buf->handle = NULL;
+		return PTR_ERR((void *)buf->phys);
+	}
+	return 0;
+}
+
+/* must be called with tegra_camera_lock held */
+static int tegra_camera_capture_setup(struct tegra_camera_capture_setup *setup)
+{
+	struct nvmap_client *user_nvmap;
+	int i, err;
+
+	if (!nvhost)
+		return -ENODEV;
+	if (capture.nvmap)
+		return -EBUSY;
+	if (setup->syncpt_id < NVSYNCPT_VI_ISP_0 ||
+	    setup->syncpt_id > NVSYNCPT_VI_ISP_5 ||
+	    setup->num_buffers < 2 ||
+	    setup->num_buffers > TEGRA_CAMERA_MAX_BUFFERS)
+		return -EINVAL;
+
+	user_nvmap = nvmap_client_get_file(setup->nvmap_fd);
+	if (IS_ERR(user_nvmap))
+		return PTR_ERR(user_nvmap);
+
+	capture.nvmap = nvmap_create_client(nvmap_dev, TEGRA_CAMERA_NAME);
+	if (!capture.nvmap) {
+		err = -ENOMEM;
+		goto err_client;
+	}
+
+	for (i = 0; i < setup->num_buffers; i++) {
+		err = tegra_camera_pin_buffer(user_nvmap, &capture.buffers[i],
+					      setup->buffers[i]);
+		if (err) {
+			pr_err("%s: can't pin buffer %d (%d)\n", __func__,
+			       i, err);
+			goto err_pin;
+		}
+		capture.buffers[i].cb.func = tegra_camera_frame_done;
+		capture.buffers[i].intr_ref = NULL;
+	}
+	nvmap_client_put(user_nvmap);
+
+	capture.syncpt_id = setup->syncpt_id;
+	capture.num_buffers = setup->num_buffers;
+	capture.sequence = 0;
+	INIT_LIST_HEAD(&capture.done);
+	/* keep host1x powered so the sync point interrupt can fire */
+	nvhost_module_busy(&nvhost->mod);
+	capture.active = true;
+	return 0;
+
+err_pin:
+	while (--i >= 0) {
+		nvmap_unpin(capture.nvmap, capture.buffers[i].handle);
+		nvmap_free(capture.nvmap, capture.buffers[i].handle);
+		capture.buffers[i].handle = NULL;
+	}
+	nvmap_client_put(capture.nvmap);
+	capture.nvmap = NULL;
+err_client:
+	nvmap_client_put(user_nvmap);
+	return err;
+}
+
+/* must be called with tegra_camera_lock held */
+static int tegra_camera_capture_qbuf(struct tegra_camera_capture_buf *req)
+{
+	struct tegra_camera_buffer *buf;
+	void *ref;
+	int err;
+
+	if (!capture.active)
+		return -ENODEV;
+	if (req->index >= capture.num_buffers)
+		return -EINVAL;
+	buf = &capture.buffers[req->index];
+	if (buf->intr_ref)
+		return -EBUSY;
+
+	buf->thresh = req->syncpt_thresh;
+	err = nvhost_intr_add_action(&nvhost->intr, capture.syncpt_id,
+				     buf->thresh, NVHOST_INTR_ACTION_CALLBACK,
+				     &buf->cb, &ref);
+	if (err)
+		return err;
+	buf->intr_ref = ref;
+	return 0;
+}
+
+static bool tegra_camera_capture_ready(void)
+{
+	unsigned long flags;
+	bool ret;
+
+	spin_lock_irqsave(&capture.lock, flags);
+	ret = !list_empty(&capture.done) || !capture.active;
+	spin_unlock_irqrestore(&capture.lock, flags);
+	return ret;
+}
+
+/* does not take tegra_camera_lock, so qbuf can run while this waits */
+static int tegra_camera_capture_dqbuf(struct file *file,
+				      struct tegra_camera_capture_buf *req)
+{
+	struct tegra_camera_buffer *buf;
+	unsigned long flags;
+	void *ref;
+	int err;
+
+	for (;;) {
+		spin_lock_irqsave(&capture.lock, flags);
+		if (!capture.active) {
+			spin_unlock_irqrestore(&capture.lock, flags);
+			return -ENODEV;
+		}
+		if (!list_empty(&capture.done))
+			break;
+		spin_unlock_irqrestore(&capture.lock, flags);
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		err = wait_event_interruptible(capture.waitq,
+					       tegra_camera_capture_ready());
+		if (err)
+			return err;
+	}
+
+	buf = list_first_entry(&capture.done, struct tegra_camera_buffer,
+			       list);
+	list_del(&buf->list);
+	ref = buf->intr_ref;
+	buf->intr_ref = NULL;
+	req->index = buf - capture.buffers;
+	req->syncpt_thresh = buf->thresh;
+	req->sequence = buf->sequence;
+	req->timestamp_us = buf->timestamp_us;
+	spin_unlock_irqrestore(&capture.lock, flags);
+
+	nvhost_intr_put_ref(&nvhost->intr, ref);
+	return 0;
+}
+
+static unsigned int tegra_camera_poll(struct file *file, poll_table *wait)
+{
+	unsigned int mask = 0;
+	unsigned long flags;
+
+	poll_wait(file, &capture.waitq, wait);
+
+	spin_lock_irqsave(&capture.lock, flags);
+	if (!list_empty(&capture.done))
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock_irqrestore(&capture.lock, flags);
+	return mask;
+}
+
 static int tegra_camera_clk_set_rate(struct tegra_camera_clk_info *info)
 {
 	u32 offset;
@@ -241,6 +518,58 @@ static long tegra_camera_ioctl(struct file *file,
 	}
 	case TEGRA_CAMERA_IOCTL_RESET:
 		return tegra_camera_reset(id);
+	case TEGRA_CAMERA_IOCTL_CAPTURE_SETUP:
+	{
+		struct tegra_camera_capture_setup setup;
+		int ret;
+
+		if (id != TEGRA_CAMERA_MODULE_VI)
+			return -EINVAL;
+		if (copy_from_user(&setup, (const void __user *)arg,
+				   sizeof(setup))) {
+			pr_err("%s: Failed to copy arg from user\n", __func__);
+			return -EFAULT;
+		}
+		mutex_lock(&tegra_camera_lock);
+		ret = tegra_camera_capture_setup(&setup);
+		mutex_unlock(&tegra_camera_lock);
+		return ret;
+	}
+	case TEGRA_CAMERA_IOCTL_CAPTURE_TEARDOWN:
+		if (id != TEGRA_CAMERA_MODULE_VI)
+			return -EINVAL;
+		mutex_lock(&tegra_camera_lock);
+		tegra_camera_capture_teardown();
+		mutex_unlock(&tegra_camera_lock);
+		return 0;
+	case TEGRA_CAMERA_IOCTL_CAPTURE_QBUF:
+	case TEGRA_CAMERA_IOCTL_CAPTURE_DQBUF:
+	{
+		struct tegra_camera_capture_buf req;
+		int ret;
+
+		if (id != TEGRA_CAMERA_MODULE_VI)
+			return -EINVAL;
+		if (copy_from_user(&req, (const void __user *)arg,
+				   sizeof(req))) {
+			pr_err("%s: Failed to copy arg from user\n", __func__);
+			return -EFAULT;
+		}
+		if (cmd == TEGRA_CAMERA_IOCTL_CAPTURE_QBUF) {
+			mutex_lock(&tegra_camera_lock);
+			ret = tegra_camera_capture_qbuf(&req);
+			mutex_unlock(&tegra_camera_lock);
+			return ret;
+		}
+		ret = tegra_camera_capture_dqbuf(file, &req);
+		if (ret)
+			return ret;
+		if (copy_to_user((void __user *)arg, &req, sizeof(req))) {
+			pr_err("%s: Failed to copy arg to user\n", __func__);
+			return -EFAULT;
+		}
+		return 0;
+	}
 	default:
 		pr_err("%s: Unknown tegra_camera ioctl.\n", TEGRA_CAMERA_NAME);
 		return -EINVAL;
@@ -252,6 +581,10 @@ static int tegra_camera_release(struct inode *inode, struct file *file)
 {
 	int i;
 
+	mutex_lock(&tegra_camera_lock);
+	tegra_camera_capture_teardown();
+	mutex_unlock(&tegra_camera_lock);
+
 	for (i = 0; i < ARRAY_SIZE(tegra_camera_block); i++)
 		if (tegra_camera_block[i].is_enabled) {
 			tegra_camera_block[i].disable();
@@ -264,6 +597,7 @@ static int tegra_camera_release(struct inode *inode, struct file *file)
 static const struct file_operations tegra_camera_fops = {
 	.owner = THIS_MODULE,
 	.unlocked_ioctl = tegra_camera_ioctl,
+	.poll = tegra_camera_poll,
 	.release = tegra_camera_release,
 };
 
@@ -290,6 +624,10 @@ static int tegra_camera_probe(struct platform_device *pdev)
 	int err;
 
 	pr_info("%s: probe\n", TEGRA_CAMERA_NAME);
+	spin_lock_init(&capture.lock);
+	INIT_LIST_HEAD(&capture.done);
+	init_waitqueue_head(&capture.waitq);
+
 	tegra_camera_regulator_csi = regulator_get(&pdev->dev, "vcsi");
 	if (IS_ERR_OR_NULL(tegra_camera_regulator_csi)) {
 		pr_err("%s: Couldn't get regulator vcsi\n", TEGRA_CAMERA_NAME);
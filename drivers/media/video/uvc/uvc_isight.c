@@ -84,7 +84,7 @@ static int isight_decode(struct uvc_video_queue *queue, struct uvc_buffer *buf,
 	 */
 	if (!is_header) {
 		maxlen = buf->buf.length - buf->buf.bytesused;
-		mem = queue->mem + buf->buf.m.offset + buf->buf.bytesused;
+		mem = buf->mem + buf->buf.bytesused;
 		nbytes = min(len, maxlen);
 		memcpy(mem, data, nbytes);
 		buf->buf.bytesused += nbytes;
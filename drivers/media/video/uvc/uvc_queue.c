@@ -21,6 +21,12 @@
 #include <linux/wait.h>
 #include <asm/atomic.h>
 
+#ifdef CONFIG_USB_VIDEO_CLASS_NVMAP
+#include <mach/nvmap.h>
+
+#include "../../../video/tegra/nvmap/nvmap.h"
+#endif
+
 #include "uvcvideo.h"
 
 /* ------------------------------------------------------------------------
@@ -35,6 +41,12 @@
  * free previously allocated buffers). Trying to free buffers that are mapped
  * to user space will return -EBUSY.
  *
+ * USERPTR queues don't allocate any memory. When CONFIG_USB_VIDEO_CLASS_NVMAP
+ * is set, m.userptr carries a global nvmap handle id that uvc_queue_buffer()
+ * pins and maps into the kernel, so the completion handler writes the video
+ * payloads directly into the application buffer. The import is kept until
+ * another handle is queued with the same index or the buffers are freed.
+ *
  * Video buffers are managed using two queues. However, unlike most USB video
  * drivers that use an in queue and an out queue, we use a main queue to hold
  * all queued buffers (both 'empty' and 'done' buffers), and an irq queue to
@@ -89,6 +101,81 @@ void uvc_queue_init(struct uvc_video_queue *queue, enum v4l2_buf_type type,
 	queue->type = type;
 }
 
+#ifdef CONFIG_USB_VIDEO_CLASS_NVMAP
+static void uvc_queue_release_nvmap(struct uvc_video_queue *queue,
+		struct uvc_buffer *buf)
+{
+	if (buf->handle == NULL)
+		return;
+
+	nvmap_munmap(buf->handle, buf->mem);
+	nvmap_unpin(queue->nvmap, buf->handle);
+	nvmap_free(queue->nvmap, buf->handle);
+	buf->handle = NULL;
+	buf->mem = NULL;
+	buf->buf.m.userptr = 0;
+}
+
+/*
+ * Import the nvmap handle passed in m.userptr. Only uncached and
+ * write-combined handles are accepted: the consumer reads the buffer through
+ * the GPU or the encoder, which don't snoop the CPU caches.
+ *
+ * This function must be called with the queue lock held.
+ */
+static int uvc_queue_import_nvmap(struct uvc_video_queue *queue,
+		struct uvc_buffer *buf, unsigned long id)
+{
+	struct nvmap_handle_ref *ref;
+	struct nvmap_handle *h;
+	unsigned long phys;
+	int ret;
+
+	if (buf->handle != NULL && buf->buf.m.userptr == id)
+		return 0;
+
+	uvc_queue_release_nvmap(queue, buf);
+
+	ref = nvmap_duplicate_handle_id(queue->nvmap, id);
+	if (IS_ERR(ref)) {
+		uvc_trace(UVC_TRACE_CAPTURE, "[E] Invalid nvmap handle "
+			"0x%08lx.\n", id);
+		return PTR_ERR(ref);
+	}
+
+	h = nvmap_ref_to_handle(ref);
+	if (h->size < buf->buf.length ||
+	    (h->flags & NVMAP_HANDLE_CACHE_FLAG) > NVMAP_HANDLE_WRITE_COMBINE) {
+		uvc_trace(UVC_TRACE_CAPTURE, "[E] nvmap handle 0x%08lx is too "
+			"small (%zu) or cacheable.\n", id, h->size);
+		ret = -EINVAL;
+		goto error_free;
+	}
+
+	phys = nvmap_pin(queue->nvmap, ref);
+	if (IS_ERR((void *)phys)) {
+		ret = PTR_ERR((void *)phys);
+		goto error_free;
+	}
+
+	buf->mem = nvmap_mmap(ref);
+	if (buf->mem == NULL) {
+		ret = -ENOMEM;
+		goto error_unpin;
+	}
+
+	buf->handle = ref;
+	buf->buf.m.userptr = id;
+	return 0;
+
+error_unpin:
+	nvmap_unpin(queue->nvmap, ref);
+error_free:
+	nvmap_free(queue->nvmap, ref);
+	return ret;
+}
+#endif
+
 /*
  * Allocate the video buffers.
  *
@@ -96,9 +183,12 @@ void uvc_queue_init(struct uvc_video_queue *queue, enum v4l2_buf_type type,
  * filled in the URB completion handler.
  *
  * Buffers will be individually mapped, so they must all be page aligned.
+ *
+ * USERPTR buffers get their memory when they are queued, only the buffer
+ * descriptors are initialized here.
  */
 int uvc_alloc_buffers(struct uvc_video_queue *queue, unsigned int nbuffers,
-		unsigned int buflength)
+		unsigned int buflength, enum v4l2_memory memory)
 {
 	unsigned int bufsize = PAGE_ALIGN(buflength);
 	unsigned int i;
@@ -117,32 +207,47 @@ int uvc_alloc_buffers(struct uvc_video_queue *queue, unsigned int nbuffers,
 	if (nbuffers == 0)
 		goto done;
 
-	/* Decrement the number of buffers until allocation succeeds. */
-	for (; nbuffers > 0; --nbuffers) {
-		mem = vmalloc_32(nbuffers * bufsize);
-		if (mem != NULL)
-			break;
-	}
+	if (memory == V4L2_MEMORY_MMAP) {
+		/* Decrement the number of buffers until allocation succeeds. */
+		for (; nbuffers > 0; --nbuffers) {
+			mem = vmalloc_32(nbuffers * bufsize);
+			if (mem != NULL)
+				break;
+		}
 
-	if (mem == NULL) {
-		ret = -ENOMEM;
-		goto done;
+		if (mem == NULL) {
+			ret = -ENOMEM;
+			goto done;
+		}
 	}
+#ifdef CONFIG_USB_VIDEO_CLASS_NVMAP
+	else {
+		queue->nvmap = nvmap_create_client(nvmap_dev, "uvcvideo");
+		if (queue->nvmap == NULL) {
+			ret = -ENOMEM;
+			goto done;
+		}
+	}
+#endif
 
 	for (i = 0; i < nbuffers; ++i) {
 		memset(&queue->buffer[i], 0, sizeof queue->buffer[i]);
 		queue->buffer[i].buf.index = i;
-		queue->buffer[i].buf.m.offset = i * bufsize;
+		if (memory == V4L2_MEMORY_MMAP) {
+			queue->buffer[i].buf.m.offset = i * bufsize;
+			queue->buffer[i].mem = mem + i * bufsize;
+		}
 		queue->buffer[i].buf.length = buflength;
 		queue->buffer[i].buf.type = queue->type;
 		queue->buffer[i].buf.sequence = 0;
 		queue->buffer[i].buf.field = V4L2_FIELD_NONE;
-		queue->buffer[i].buf.memory = V4L2_MEMORY_MMAP;
+		queue->buffer[i].buf.memory = memory;
 		queue->buffer[i].buf.flags = 0;
 		init_waitqueue_head(&queue->buffer[i].wait);
 	}
 
 	queue->mem = mem;
+	queue->memory = memory;
 	queue->count = nbuffers;
 	queue->buf_size = bufsize;
 	ret = nbuffers;
@@ -166,10 +271,22 @@ int uvc_free_buffers(struct uvc_video_queue *queue)
 			return -EBUSY;
 	}
 
-	if (queue->count) {
-		vfree(queue->mem);
-		queue->count = 0;
+	if (queue->count == 0)
+		return 0;
+
+#ifdef CONFIG_USB_VIDEO_CLASS_NVMAP
+	if (queue->memory == V4L2_MEMORY_USERPTR) {
+		for (i = 0; i < queue->count; ++i)
+			uvc_queue_release_nvmap(queue, &queue->buffer[i]);
+
+		nvmap_client_put(queue->nvmap);
+		queue->nvmap = NULL;
 	}
+#endif
+
+	vfree(queue->mem);
+	queue->mem = NULL;
+	queue->count = 0;
 
 	return 0;
 }
@@ -243,15 +360,16 @@ int uvc_queue_buffer(struct uvc_video_queue *queue,
 
 	uvc_trace(UVC_TRACE_CAPTURE, "Queuing buffer %u.\n", v4l2_buf->index);
 
+	mutex_lock(&queue->mutex);
 	if (v4l2_buf->type != queue->type ||
-	    v4l2_buf->memory != V4L2_MEMORY_MMAP) {
+	    v4l2_buf->memory != queue->memory) {
 		uvc_trace(UVC_TRACE_CAPTURE, "[E] Invalid buffer type (%u) "
 			"and/or memory (%u).\n", v4l2_buf->type,
 			v4l2_buf->memory);
-		return -EINVAL;
+		ret = -EINVAL;
+		goto done;
 	}
 
-	mutex_lock(&queue->mutex);
 	if (v4l2_buf->index >= queue->count) {
 		uvc_trace(UVC_TRACE_CAPTURE, "[E] Out of range index.\n");
 		ret = -EINVAL;
@@ -273,6 +391,14 @@ int uvc_queue_buffer(struct uvc_video_queue *queue,
 		goto done;
 	}
 
+#ifdef CONFIG_USB_VIDEO_CLASS_NVMAP
+	if (queue->memory == V4L2_MEMORY_USERPTR) {
+		ret = uvc_queue_import_nvmap(queue, buf, v4l2_buf->m.userptr);
+		if (ret < 0)
+			goto done;
+	}
+#endif
+
 	spin_lock_irqsave(&queue->irqlock, flags);
 	if (queue->flags & UVC_QUEUE_DISCONNECTED) {
 		spin_unlock_irqrestore(&queue->irqlock, flags);
@@ -280,6 +406,7 @@ int uvc_queue_buffer(struct uvc_video_queue *queue,
 		goto done;
 	}
 	buf->state = UVC_BUF_STATE_QUEUED;
+	buf->jpeg_end = 0;
 	if (v4l2_buf->type == V4L2_BUF_TYPE_VIDEO_CAPTURE)
 		buf->buf.bytesused = 0;
 	else
@@ -319,15 +446,16 @@ int uvc_dequeue_buffer(struct uvc_video_queue *queue,
 	struct uvc_buffer *buf;
 	int ret = 0;
 
+	mutex_lock(&queue->mutex);
 	if (v4l2_buf->type != queue->type ||
-	    v4l2_buf->memory != V4L2_MEMORY_MMAP) {
+	    v4l2_buf->memory != queue->memory) {
 		uvc_trace(UVC_TRACE_CAPTURE, "[E] Invalid buffer type (%u) "
 			"and/or memory (%u).\n", v4l2_buf->type,
 			v4l2_buf->memory);
-		return -EINVAL;
+		ret = -EINVAL;
+		goto done;
 	}
 
-	mutex_lock(&queue->mutex);
 	if (list_empty(&queue->mainqueue)) {
 		uvc_trace(UVC_TRACE_CAPTURE, "[E] Empty buffer queue.\n");
 		ret = -EINVAL;
@@ -496,6 +624,7 @@ struct uvc_buffer *uvc_queue_next_buffer(struct uvc_video_queue *queue,
 		buf->error = 0;
 		buf->state = UVC_BUF_STATE_QUEUED;
 		buf->buf.bytesused = 0;
+		buf->jpeg_end = 0;
 		return buf;
 	}
 
@@ -930,14 +930,27 @@ static long uvc_v4l2_do_ioctl(struct file *file, unsigned int cmd, void *arg)
 		unsigned int bufsize =
 			stream->ctrl.dwMaxVideoFrameSize;
 
-		if (rb->type != stream->type ||
-		    rb->memory != V4L2_MEMORY_MMAP)
+		if (rb->type != stream->type)
 			return -EINVAL;
 
+		switch (rb->memory) {
+		case V4L2_MEMORY_MMAP:
+			break;
+#ifdef CONFIG_USB_VIDEO_CLASS_NVMAP
+		case V4L2_MEMORY_USERPTR:
+			if (stream->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+				return -EINVAL;
+			break;
+#endif
+		default:
+			return -EINVAL;
+		}
+
 		if ((ret = uvc_acquire_privileges(handle)) < 0)
 			return ret;
 
-		ret = uvc_alloc_buffers(&stream->queue, rb->count, bufsize);
+		ret = uvc_alloc_buffers(&stream->queue, rb->count, bufsize,
+					rb->memory);
 		if (ret < 0)
 			return ret;
 
@@ -1132,6 +1145,11 @@ static int uvc_v4l2_mmap(struct file *file, struct vm_area_struct *vma)
 
 	mutex_lock(&queue->mutex);
 
+	if (queue->memory != V4L2_MEMORY_MMAP) {
+		ret = -EINVAL;
+		goto done;
+	}
+
 	for (i = 0; i < queue->count; ++i) {
 		buffer = &queue->buffer[i];
 		if ((buffer->buf.m.offset >> PAGE_SHIFT) == vma->vm_pgoff)
@@ -1149,7 +1167,7 @@ static int uvc_v4l2_mmap(struct file *file, struct vm_area_struct *vma)
 	 */
 	vma->vm_flags |= VM_IO;
 
-	addr = (unsigned long)queue->mem + buffer->buf.m.offset;
+	addr = (unsigned long)buffer->mem;
 	while (size > 0) {
 		page = vmalloc_to_page((void *)addr);
 		if ((ret = vm_insert_page(vma, start, page)) < 0)
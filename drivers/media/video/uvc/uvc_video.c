@@ -461,10 +461,42 @@ static int uvc_video_decode_start(struct uvc_streaming *stream,
 	return data[0];
 }
 
+/*
+ * Many MJPEG devices pad frames with zeros after the EOI marker. Locate the
+ * marker while the payload is still in the URB buffer, skipping the trailing
+ * zeros only, so that the buffer (possibly an uncached nvmap surface) never
+ * has to be read back. A payload ending with anything else than padding
+ * means the frame continues.
+ */
+static void uvc_video_find_jpeg_end(struct uvc_buffer *buf, const __u8 *data,
+		unsigned int len)
+{
+	unsigned int i = len;
+
+	while (i > 0 && data[i - 1] == 0x00)
+		--i;
+
+	if (i >= 2 && data[i - 2] == 0xff && data[i - 1] == 0xd9)
+		buf->jpeg_end = buf->buf.bytesused + i;
+	else if (i != 0)
+		buf->jpeg_end = 0;
+}
+
+/*
+ * Report the real payload size of completed MJPEG frames.
+ */
+static void uvc_video_complete_jpeg(struct uvc_buffer *buf)
+{
+	if (buf->jpeg_end != 0 && buf->jpeg_end < buf->buf.bytesused) {
+		uvc_trace(UVC_TRACE_FRAME, "Dropping %u bytes of MJPEG "
+			"padding.\n", buf->buf.bytesused - buf->jpeg_end);
+		buf->buf.bytesused = buf->jpeg_end;
+	}
+}
+
 static void uvc_video_decode_data(struct uvc_streaming *stream,
 		struct uvc_buffer *buf, const __u8 *data, int len)
 {
-	struct uvc_video_queue *queue = &stream->queue;
 	unsigned int maxlen, nbytes;
 	void *mem;
 
@@ -473,8 +505,10 @@ static void uvc_video_decode_data(struct uvc_streaming *stream,
 
 	/* Copy the video data to the buffer. */
 	maxlen = buf->buf.length - buf->buf.bytesused;
-	mem = queue->mem + buf->buf.m.offset + buf->buf.bytesused;
+	mem = buf->mem + buf->buf.bytesused;
 	nbytes = min((unsigned int)len, maxlen);
+	if (stream->cur_format->fcc == V4L2_PIX_FMT_MJPEG)
+		uvc_video_find_jpeg_end(buf, data, nbytes);
 	memcpy(mem, data, nbytes);
 	buf->buf.bytesused += nbytes;
 
@@ -527,7 +561,7 @@ static int uvc_video_encode_data(struct uvc_streaming *stream,
 	void *mem;
 
 	/* Copy video data to the URB buffer. */
-	mem = queue->mem + buf->buf.m.offset + queue->buf_used;
+	mem = buf->mem + queue->buf_used;
 	nbytes = min((unsigned int)len, buf->buf.bytesused - queue->buf_used);
 	nbytes = min(stream->bulk.max_payload_size - stream->bulk.payload_size,
 			nbytes);
@@ -588,6 +622,7 @@ static void uvc_video_decode_isoc(struct urb *urb, struct uvc_streaming *stream,
 			      UVC_FMT_FLAG_COMPRESSED))
 				buf->error = 1;
 
+			uvc_video_complete_jpeg(buf);
 			buf = uvc_queue_next_buffer(&stream->queue, buf);
 		}
 	}
@@ -646,9 +681,11 @@ static void uvc_video_decode_bulk(struct urb *urb, struct uvc_streaming *stream,
 		if (!stream->bulk.skip_payload && buf != NULL) {
 			uvc_video_decode_end(stream, buf, stream->bulk.header,
 				stream->bulk.payload_size);
-			if (buf->state == UVC_BUF_STATE_READY)
+			if (buf->state == UVC_BUF_STATE_READY) {
+				uvc_video_complete_jpeg(buf);
 				buf = uvc_queue_next_buffer(&stream->queue,
 							    buf);
+			}
 		}
 
 		stream->bulk.header_size = 0;
@@ -193,6 +193,8 @@ struct uvc_xu_control {
  */
 
 struct uvc_device;
+struct nvmap_client;
+struct nvmap_handle_ref;
 
 /* TODO: Put the most frequently accessed fields at the beginning of
  * structures to maximize cache efficiency.
@@ -374,9 +376,14 @@ enum uvc_buffer_state {
 struct uvc_buffer {
 	unsigned long vma_use_count;
 	struct list_head stream;
+#ifdef CONFIG_USB_VIDEO_CLASS_NVMAP
+	struct nvmap_handle_ref *handle;	/* imported USERPTR buffer */
+#endif
 
 	/* Touched by interrupt handler. */
 	struct v4l2_buffer buf;
+	void *mem;
+	unsigned int jpeg_end;
 	struct list_head queue;
 	wait_queue_head_t wait;
 	enum uvc_buffer_state state;
@@ -389,8 +396,12 @@ struct uvc_buffer {
 
 struct uvc_video_queue {
 	enum v4l2_buf_type type;
+	enum v4l2_memory memory;
 
 	void *mem;
+#ifdef CONFIG_USB_VIDEO_CLASS_NVMAP
+	struct nvmap_client *nvmap;
+#endif
 	unsigned int flags;
 	__u32 sequence;
 
@@ -566,7 +577,8 @@ extern struct uvc_driver uvc_driver;
 extern void uvc_queue_init(struct uvc_video_queue *queue,
 		enum v4l2_buf_type type, int drop_corrupted);
 extern int uvc_alloc_buffers(struct uvc_video_queue *queue,
-		unsigned int nbuffers, unsigned int buflength);
+		unsigned int nbuffers, unsigned int buflength,
+		enum v4l2_memory memory);
 extern int uvc_free_buffers(struct uvc_video_queue *queue);
 extern int uvc_query_buffer(struct uvc_video_queue *queue,
 		struct v4l2_buffer *v4l2_buf);
@@ -23,6 +23,9 @@
 #include <linux/slab.h>
 #include <linux/gpio.h>
 #include <linux/i2c.h>
+#include <linux/bitmap.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/mfd/core.h>
 #include <linux/mfd/tps6586x.h>
@@ -51,6 +54,21 @@
 /* device id */
 #define TPS6586X_VERSIONCRC	0xcd
 
+/*
+ * Supply enables (0x10-0x14) and voltage/converter settings (0x20-0x48)
+ * only change when written from here, so they are cached and the read
+ * half of every read-modify-write is free.  The DVM go bits in VCC1 and
+ * VCC2 clear themselves once the ramp is done and are never cached.
+ */
+#define TPS6586X_CACHE_FIRST	0x10
+#define TPS6586X_CACHE_LAST	0x48
+#define TPS6586X_CACHE_SIZE	(TPS6586X_CACHE_LAST - TPS6586X_CACHE_FIRST + 1)
+
+#define TPS6586X_VCC1		0x20
+#define TPS6586X_VCC2		0x21
+#define TPS6586X_VCC1_GO_BITS	(BIT(0) | BIT(2) | BIT(6))
+#define TPS6586X_VCC2_GO_BITS	BIT(6)
+
 struct tps6586x_irq_data {
 	u8	mask_reg;
 	u8	mask_mask;
@@ -104,6 +122,19 @@ struct tps6586x {
 	u32			irq_en;
 	u8			mask_cache[5];
 	u8			mask_reg[5];
+
+	/* register cache, protected by lock */
+	u8			cache[TPS6586X_CACHE_SIZE];
+	DECLARE_BITMAP(cache_valid, TPS6586X_CACHE_SIZE);
+
+	/* i2c transactions done and saved on the cached registers */
+	unsigned long		i2c_reads;
+	unsigned long		i2c_writes;
+	unsigned long		cache_hits;
+	unsigned long		merged_writes;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry		*debugfs;
+#endif
 };
 
 static inline int __tps6586x_read(struct i2c_client *client,
@@ -165,21 +196,113 @@ static inline int __tps6586x_writes(struct i2c_client *client, int reg,
 	return 0;
 }
 
+static inline bool tps6586x_cacheable(int reg)
+{
+	return (reg >= TPS6586X_CACHE_FIRST && reg <= TPS6586X_SUPPLYENE) ||
+		(reg >= TPS6586X_VCC1 && reg <= TPS6586X_CACHE_LAST);
+}
+
+static inline uint8_t tps6586x_go_bits(int reg)
+{
+	if (reg == TPS6586X_VCC1)
+		return TPS6586X_VCC1_GO_BITS;
+	if (reg == TPS6586X_VCC2)
+		return TPS6586X_VCC2_GO_BITS;
+	return 0;
+}
+
+/* The cache helpers must be called with tps6586x->lock held */
+static void tps6586x_cache_store(struct tps6586x *tps6586x, int reg,
+				 uint8_t val)
+{
+	if (!tps6586x_cacheable(reg))
+		return;
+
+	tps6586x->cache[reg - TPS6586X_CACHE_FIRST] =
+		val & ~tps6586x_go_bits(reg);
+	set_bit(reg - TPS6586X_CACHE_FIRST, tps6586x->cache_valid);
+}
+
+static void tps6586x_cache_drop(struct tps6586x *tps6586x, int reg)
+{
+	if (tps6586x_cacheable(reg))
+		clear_bit(reg - TPS6586X_CACHE_FIRST, tps6586x->cache_valid);
+}
+
+static int tps6586x_cache_read(struct tps6586x *tps6586x, int reg,
+			       uint8_t *val)
+{
+	int ret;
+
+	if (tps6586x_cacheable(reg) &&
+	    test_bit(reg - TPS6586X_CACHE_FIRST, tps6586x->cache_valid)) {
+		*val = tps6586x->cache[reg - TPS6586X_CACHE_FIRST];
+		tps6586x->cache_hits++;
+		return 0;
+	}
+
+	ret = __tps6586x_read(tps6586x->client, reg, val);
+	if (ret)
+		return ret;
+
+	tps6586x->i2c_reads++;
+	tps6586x_cache_store(tps6586x, reg, *val);
+	return 0;
+}
+
+static int tps6586x_cache_write(struct tps6586x *tps6586x, int reg,
+				uint8_t val)
+{
+	int ret;
+
+	ret = __tps6586x_write(tps6586x->client, reg, val);
+	if (ret) {
+		tps6586x_cache_drop(tps6586x, reg);
+		return ret;
+	}
+
+	tps6586x->i2c_writes++;
+	tps6586x_cache_store(tps6586x, reg, val);
+	return 0;
+}
+
 int tps6586x_write(struct device *dev, int reg, uint8_t val)
 {
-	return __tps6586x_write(to_i2c_client(dev), reg, val);
+	struct tps6586x *tps6586x = dev_get_drvdata(dev);
+	int ret;
+
+	mutex_lock(&tps6586x->lock);
+	ret = tps6586x_cache_write(tps6586x, reg, val);
+	mutex_unlock(&tps6586x->lock);
+	return ret;
 }
 EXPORT_SYMBOL_GPL(tps6586x_write);
 
 int tps6586x_writes(struct device *dev, int reg, int len, uint8_t *val)
 {
-	return __tps6586x_writes(to_i2c_client(dev), reg, len, val);
+	struct tps6586x *tps6586x = dev_get_drvdata(dev);
+	int ret = 0, i;
+
+	mutex_lock(&tps6586x->lock);
+	for (i = 0; i < len; i++) {
+		ret = tps6586x_cache_write(tps6586x, reg + i, val[i]);
+		if (ret)
+			break;
+	}
+	mutex_unlock(&tps6586x->lock);
+	return ret;
 }
 EXPORT_SYMBOL_GPL(tps6586x_writes);
 
 int tps6586x_read(struct device *dev, int reg, uint8_t *val)
 {
-	return __tps6586x_read(to_i2c_client(dev), reg, val);
+	struct tps6586x *tps6586x = dev_get_drvdata(dev);
+	int ret;
+
+	mutex_lock(&tps6586x->lock);
+	ret = tps6586x_cache_read(tps6586x, reg, val);
+	mutex_unlock(&tps6586x->lock);
+	return ret;
 }
 EXPORT_SYMBOL_GPL(tps6586x_read);
 
@@ -197,13 +320,13 @@ int tps6586x_set_bits(struct device *dev, int reg, uint8_t bit_mask)
 
 	mutex_lock(&tps6586x->lock);
 
-	ret = __tps6586x_read(to_i2c_client(dev), reg, &reg_val);
+	ret = tps6586x_cache_read(tps6586x, reg, &reg_val);
 	if (ret)
 		goto out;
 
 	if ((reg_val & bit_mask) == 0) {
 		reg_val |= bit_mask;
-		ret = __tps6586x_write(to_i2c_client(dev), reg, reg_val);
+		ret = tps6586x_cache_write(tps6586x, reg, reg_val);
 	}
 out:
 	mutex_unlock(&tps6586x->lock);
@@ -219,13 +342,13 @@ int tps6586x_clr_bits(struct device *dev, int reg, uint8_t bit_mask)
 
 	mutex_lock(&tps6586x->lock);
 
-	ret = __tps6586x_read(to_i2c_client(dev), reg, &reg_val);
+	ret = tps6586x_cache_read(tps6586x, reg, &reg_val);
 	if (ret)
 		goto out;
 
 	if (reg_val & bit_mask) {
 		reg_val &= ~bit_mask;
-		ret = __tps6586x_write(to_i2c_client(dev), reg, reg_val);
+		ret = tps6586x_cache_write(tps6586x, reg, reg_val);
 	}
 out:
 	mutex_unlock(&tps6586x->lock);
@@ -241,13 +364,13 @@ int tps6586x_update(struct device *dev, int reg, uint8_t val, uint8_t mask)
 
 	mutex_lock(&tps6586x->lock);
 
-	ret = __tps6586x_read(tps6586x->client, reg, &reg_val);
+	ret = tps6586x_cache_read(tps6586x, reg, &reg_val);
 	if (ret)
 		goto out;
 
 	if ((reg_val & mask) != val) {
 		reg_val = (reg_val & ~mask) | val;
-		ret = __tps6586x_write(tps6586x->client, reg, reg_val);
+		ret = tps6586x_cache_write(tps6586x, reg, reg_val);
 	}
 out:
 	mutex_unlock(&tps6586x->lock);
@@ -255,6 +378,70 @@ out:
 }
 EXPORT_SYMBOL_GPL(tps6586x_update);
 
+/*
+ * Update a DVM voltage register and start the ramp by setting go_bits in
+ * go_reg.  Both writes are sent in one i2c_transfer(), and the voltage
+ * write is left out if the value does not change.
+ */
+int tps6586x_update_go(struct device *dev, int reg, uint8_t val, uint8_t mask,
+		       int go_reg, uint8_t go_bits)
+{
+	struct tps6586x *tps6586x = dev_get_drvdata(dev);
+	struct i2c_client *client = tps6586x->client;
+	struct i2c_msg msgs[2];
+	uint8_t bufs[2][2];
+	uint8_t reg_val, go_val;
+	int n = 0;
+	int ret;
+
+	mutex_lock(&tps6586x->lock);
+
+	ret = tps6586x_cache_read(tps6586x, reg, &reg_val);
+	if (ret)
+		goto out;
+
+	ret = tps6586x_cache_read(tps6586x, go_reg, &go_val);
+	if (ret)
+		goto out;
+
+	if ((reg_val & mask) != val) {
+		reg_val = (reg_val & ~mask) | val;
+		bufs[n][0] = reg;
+		bufs[n][1] = reg_val;
+		n++;
+	}
+	bufs[n][0] = go_reg;
+	bufs[n][1] = go_val | go_bits;
+	n++;
+
+	for (ret = 0; ret < n; ret++) {
+		msgs[ret].addr = client->addr;
+		msgs[ret].flags = 0;
+		msgs[ret].len = 2;
+		msgs[ret].buf = bufs[ret];
+	}
+
+	ret = i2c_transfer(client->adapter, msgs, n);
+	if (ret != n) {
+		dev_err(tps6586x->dev, "failed writing 0x%02x to 0x%02x\n",
+			reg_val, reg);
+		tps6586x_cache_drop(tps6586x, reg);
+		ret = ret < 0 ? ret : -EIO;
+		goto out;
+	}
+
+	tps6586x->i2c_writes++;
+	if (n > 1) {
+		tps6586x->merged_writes++;
+		tps6586x_cache_store(tps6586x, reg, reg_val);
+	}
+	ret = 0;
+out:
+	mutex_unlock(&tps6586x->lock);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(tps6586x_update_go);
+
 static struct i2c_client *tps6586x_i2c_client = NULL;
 int tps6586x_power_off(void)
 {
@@ -483,6 +670,55 @@ static int __devinit tps6586x_irq_init(struct tps6586x *tps6586x, int irq,
 	return ret;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int tps6586x_stats_show(struct seq_file *s, void *data)
+{
+	struct tps6586x *tps6586x = s->private;
+
+	mutex_lock(&tps6586x->lock);
+	seq_printf(s, "i2c reads:     %lu\n", tps6586x->i2c_reads);
+	seq_printf(s, "i2c writes:    %lu\n", tps6586x->i2c_writes);
+	seq_printf(s, "cache hits:    %lu\n", tps6586x->cache_hits);
+	seq_printf(s, "merged writes: %lu\n", tps6586x->merged_writes);
+	seq_printf(s, "saved:         %lu\n",
+		   tps6586x->cache_hits + tps6586x->merged_writes);
+	mutex_unlock(&tps6586x->lock);
+
+	return 0;
+}
+
+static int tps6586x_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tps6586x_stats_show, inode->i_private);
+}
+
+static const struct file_operations tps6586x_stats_fops = {
+	.open		= tps6586x_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __devinit tps6586x_debugfs_init(struct tps6586x *tps6586x)
+{
+	tps6586x->debugfs = debugfs_create_file("tps6586x", S_IRUGO, NULL,
+						tps6586x, &tps6586x_stats_fops);
+}
+
+static void tps6586x_debugfs_exit(struct tps6586x *tps6586x)
+{
+	debugfs_remove(tps6586x->debugfs);
+}
+#else
+static inline void tps6586x_debugfs_init(struct tps6586x *tps6586x)
+{
+}
+
+static inline void tps6586x_debugfs_exit(struct tps6586x *tps6586x)
+{
+}
+#endif
+
 static int __devinit tps6586x_add_subdevs(struct tps6586x *tps6586x,
 					  struct tps6586x_platform_data *pdata)
 {
@@ -559,6 +795,7 @@ static int __devinit tps6586x_i2c_probe(struct i2c_client *client,
 
 
 	tps6586x_i2c_client = client;
+	tps6586x_debugfs_init(tps6586x);
 
 	return 0;
 
@@ -574,6 +811,7 @@ static int __devexit tps6586x_i2c_remove(struct i2c_client *client)
 {
 	struct tps6586x *tps6586x = i2c_get_clientdata(client);
 
+	tps6586x_debugfs_exit(tps6586x);
 	if (client->irq)
 		free_irq(client->irq, tps6586x);
 
@@ -53,6 +53,16 @@ struct akm8975_data {
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	struct early_suspend early_suspend;
 #endif
+
+	/* batch mode */
+	struct delayed_work measure_work;
+	struct mutex batch_lock;
+	wait_queue_head_t batch_wait;
+	struct akm8975_batch batch;
+	unsigned long batch_start;	/* jiffies of the oldest queued sample */
+	s64 irq_time;
+	short batch_delay;
+	short batch_latency;
 };
 
 /*
@@ -184,6 +194,88 @@ static void akm8975_ecs_report_value(struct akm8975_data *akm, short *rbuf)
 	input_sync(data->input_dev);
 }
 
+/* Unlocked, it is a wait condition and is checked again on every wakeup */
+static bool akm8975_batch_ready(struct akm8975_data *akm)
+{
+	return !akm->batch_delay || akm->batch.count >= AKM8975_BATCH_MAX ||
+		(akm->batch.count && time_after_eq(jiffies, akm->batch_start +
+			msecs_to_jiffies(akm->batch_latency)));
+}
+
+/* Called from the irq work with the data ready pin still asserted */
+static void akm8975_batch_add(struct akm8975_data *akm)
+{
+	struct akm8975_sample *sample;
+	char buf[RBUFF_SIZE];
+
+	buf[0] = AK8975_REG_ST1;
+	if (akm8975_i2c_rxdata(akm, buf, RBUFF_SIZE))
+		return;
+
+	mutex_lock(&akm->batch_lock);
+	if (akm->batch.count >= AKM8975_BATCH_MAX) {
+		akm->batch.dropped++;
+	} else {
+		if (!akm->batch.count)
+			akm->batch_start = jiffies;
+		sample = &akm->batch.sample[akm->batch.count++];
+		sample->time = akm->irq_time;
+		memcpy(sample->data, buf, RBUFF_SIZE);
+	}
+	mutex_unlock(&akm->batch_lock);
+
+	if (akm8975_batch_ready(akm))
+		wake_up_interruptible(&akm->batch_wait);
+}
+
+static void akm_measure_work_func(struct work_struct *work)
+{
+	struct akm8975_data *akm = container_of(to_delayed_work(work),
+		struct akm8975_data, measure_work);
+	char buf[2];
+
+	buf[0] = AK8975_REG_CNTL;
+	buf[1] = AK8975_MODE_SNG_MEASURE;
+	akm8975_i2c_txdata(akm, buf, 2);
+
+	schedule_delayed_work(&akm->measure_work,
+		msecs_to_jiffies(akm->batch_delay));
+}
+
+static void akm8975_batch_config(struct akm8975_data *akm,
+	struct akm8975_batch_config *config)
+{
+	cancel_delayed_work_sync(&akm->measure_work);
+
+	mutex_lock(&akm->batch_lock);
+	akm->batch_delay = max_t(short, config->delay, 0);
+	akm->batch_latency = max_t(short, config->latency, 0);
+	mutex_unlock(&akm->batch_lock);
+
+	if (akm->batch_delay)
+		schedule_delayed_work(&akm->measure_work, 0);
+	else
+		wake_up_interruptible(&akm->batch_wait);
+}
+
+static int akm8975_batch_get(struct akm8975_data *akm, void __user *argp)
+{
+	int ret;
+
+	ret = wait_event_interruptible(akm->batch_wait,
+		akm8975_batch_ready(akm));
+	if (ret)
+		return ret;
+
+	mutex_lock(&akm->batch_lock);
+	ret = copy_to_user(argp, &akm->batch, sizeof(akm->batch)) ?
+		-EFAULT : 0;
+	akm->batch.count = 0;
+	akm->batch.dropped = 0;
+	mutex_unlock(&akm->batch_lock);
+	return ret;
+}
+
 static void akm8975_ecs_close_done(struct akm8975_data *akm)
 {
 	FUNCDBG("called");
@@ -326,6 +418,7 @@ static long akmd_ioctl(struct file *file, unsigned int cmd,
 	int status;
 	short value[12];
 	short delay;
+	struct akm8975_batch_config config;
 	struct akm8975_data *akm = file->private_data;
 
 	FUNCDBG("called");
@@ -342,6 +435,11 @@ static long akmd_ioctl(struct file *file, unsigned int cmd,
 			return -EFAULT;
 		break;
 
+	case ECS_IOCTL_SET_BATCH:
+		if (copy_from_user(&config, argp, sizeof(config)))
+			return -EFAULT;
+		break;
+
 	default:
 		break;
 	}
@@ -383,6 +481,13 @@ static long akmd_ioctl(struct file *file, unsigned int cmd,
 		delay = akmd_delay;
 		break;
 
+	case ECS_IOCTL_SET_BATCH:
+		akm8975_batch_config(akm, &config);
+		break;
+
+	case ECS_IOCTL_GET_BATCH:
+		return akm8975_batch_get(akm, argp);
+
 	default:
 		FUNCDBG("Unknown cmd\n");
 		return -ENOTTY;
@@ -416,6 +521,8 @@ static void akm_work_func(struct work_struct *work)
 	    container_of(work, struct akm8975_data, work);
 
 	FUNCDBG("called");
+	if (akm->batch_delay)
+		akm8975_batch_add(akm);
 	enable_irq(akm->this_client->irq);
 }
 
@@ -424,6 +531,8 @@ static irqreturn_t akm8975_interrupt(int irq, void *dev_id)
 	struct akm8975_data *akm = dev_id;
 	FUNCDBG("called");
 
+	akm->irq_time = ktime_to_ns(ktime_get());
+
 	disable_irq_nosync(akm->this_client->irq);
 	schedule_work(&akm->work);
 	return IRQ_HANDLED;
@@ -462,6 +571,7 @@ static int akm8975_suspend(struct i2c_client *client, pm_message_t mesg)
 #if AK8975DRV_CALL_DBG
 	pr_info("%s\n", __func__);
 #endif
+	cancel_delayed_work_sync(&akm->measure_work);
 	/* TO DO: might need more work after power mgmt
 	   is enabled */
 	return akm8975_power_off(akm);
@@ -470,13 +580,17 @@ static int akm8975_suspend(struct i2c_client *client, pm_message_t mesg)
 static int akm8975_resume(struct i2c_client *client)
 {
 	struct akm8975_data *akm = i2c_get_clientdata(client);
+	int err;
 
 #if AK8975DRV_CALL_DBG
 	pr_info("%s\n", __func__);
 #endif
 	/* TO DO: might need more work after power mgmt
 	   is enabled */
-	return akm8975_power_on(akm);
+	err = akm8975_power_on(akm);
+	if (!err && akm->batch_delay)
+		schedule_delayed_work(&akm->measure_work, 0);
+	return err;
 }
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
@@ -590,6 +704,9 @@ int akm8975_probe(struct i2c_client *client,
 
 	mutex_init(&akm->flags_lock);
 	INIT_WORK(&akm->work, akm_work_func);
+	mutex_init(&akm->batch_lock);
+	init_waitqueue_head(&akm->batch_wait);
+	INIT_DELAYED_WORK(&akm->measure_work, akm_measure_work_func);
 	i2c_set_clientdata(client, akm);
 
 	err = akm8975_power_on(akm);
@@ -682,6 +799,7 @@ static int __devexit akm8975_remove(struct i2c_client *client)
 {
 	struct akm8975_data *akm = i2c_get_clientdata(client);
 	FUNCDBG("called");
+	cancel_delayed_work_sync(&akm->measure_work);
 	free_irq(client->irq, NULL);
 	input_unregister_device(akm->input_dev);
 	misc_deregister(&akmd_device);
@@ -37,6 +37,9 @@
 #include <linux/wait.h>
 #include <linux/uaccess.h>
 #include <linux/io.h>
+#include <linux/timer.h>
+#include <linux/spinlock.h>
+#include <linux/slab.h>
 
 #include "mpu.h"
 #include "mpuirq.h"
@@ -58,10 +61,17 @@ struct mpuirq_dev_data {
 	int accel_divider;
 	int data_ready;
 	int timeout;
+
+	/* batch mode */
+	spinlock_t batch_lock;
+	struct timer_list batch_timer;
+	int batch_latency;
+	int batch_max;
 };
 
 static struct mpuirq_dev_data mpuirq_dev_data;
 static struct mpuirq_data mpuirq_data;
+static struct mpuirq_batch mpuirq_batch;
 static char *interface = MPUIRQ_NAME;
 
 static void mpu_accel_data_work_fcn(struct work_struct *work);
@@ -126,6 +136,64 @@ unsigned int mpuirq_poll(struct file *file, struct poll_table_struct *poll)
 	return mask;
 }
 
+static void mpuirq_batch_ready(void)
+{
+	mpuirq_dev_data.data_ready = 1;
+	wake_up_interruptible(&mpuirq_wait);
+}
+
+static void mpuirq_batch_timer_fcn(unsigned long data)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&mpuirq_dev_data.batch_lock, flags);
+	if (mpuirq_batch.count)
+		mpuirq_batch_ready();
+	spin_unlock_irqrestore(&mpuirq_dev_data.batch_lock, flags);
+}
+
+static int mpuirq_set_batch(struct mpuirq_batch_config __user *arg)
+{
+	struct mpuirq_batch_config config;
+
+	if (copy_from_user(&config, arg, sizeof(config)))
+		return -EFAULT;
+	if (config.latency < 0 || config.max_count < 0)
+		return -EINVAL;
+
+	spin_lock_irq(&mpuirq_dev_data.batch_lock);
+	mpuirq_dev_data.batch_latency = msecs_to_jiffies(config.latency);
+	mpuirq_dev_data.batch_max = min(config.max_count ? config.max_count :
+					MPUIRQ_BATCH_MAX, MPUIRQ_BATCH_MAX);
+	mpuirq_batch.count = 0;
+	mpuirq_batch.dropped = 0;
+	spin_unlock_irq(&mpuirq_dev_data.batch_lock);
+
+	del_timer_sync(&mpuirq_dev_data.batch_timer);
+	return 0;
+}
+
+static int mpuirq_get_batch(struct mpuirq_batch __user *arg)
+{
+	struct mpuirq_batch *batch;
+	int res = 0;
+
+	batch = kmalloc(sizeof(*batch), GFP_KERNEL);
+	if (!batch)
+		return -ENOMEM;
+
+	spin_lock_irq(&mpuirq_dev_data.batch_lock);
+	memcpy(batch, &mpuirq_batch, sizeof(*batch));
+	mpuirq_batch.count = 0;
+	mpuirq_batch.dropped = 0;
+	spin_unlock_irq(&mpuirq_dev_data.batch_lock);
+
+	if (copy_to_user(arg, batch, sizeof(*batch)))
+		res = -EFAULT;
+	kfree(batch);
+	return res;
+}
+
 /* ioctl - I/O control */
 static long mpuirq_ioctl(struct file *file,
 			 unsigned int cmd, unsigned long arg)
@@ -155,6 +223,13 @@ static long mpuirq_ioctl(struct file *file,
 	case MPUIRQ_SET_FREQUENCY_DIVIDER:
 		mpuirq_dev_data.accel_divider = arg;
 		break;
+	case MPUIRQ_SET_BATCH:
+		retval = mpuirq_set_batch(
+			(struct mpuirq_batch_config __user *) arg);
+		break;
+	case MPUIRQ_GET_BATCH:
+		retval = mpuirq_get_batch((struct mpuirq_batch __user *) arg);
+		break;
 	default:
 		retval = -EINVAL;
 	}
@@ -204,21 +279,37 @@ static irqreturn_t mpuirq_handler(int irq, void *dev_id)
 
 	mpuirq_data.interruptcount++;
 
-	/* wake up (unblock) for reading data from userspace */
-	/* and ignore first interrupt generated in module init */
-	mpuirq_dev_data.data_ready = 1;
-
 	do_gettimeofday(&irqtime);
 	mpuirq_data.irqtime = (((long long) irqtime.tv_sec) << 32);
 	mpuirq_data.irqtime += irqtime.tv_usec;
 
+	if (mpuirq_dev_data.batch_latency) {
+		spin_lock(&mpuirq_dev_data.batch_lock);
+		if (mpuirq_batch.count < MPUIRQ_BATCH_MAX)
+			mpuirq_batch.irqtime[mpuirq_batch.count++] =
+				mpuirq_data.irqtime;
+		else
+			mpuirq_batch.dropped++;
+		if (mpuirq_batch.count >= mpuirq_dev_data.batch_max)
+			mpuirq_batch_ready();
+		else if (mpuirq_batch.count == 1)
+			mod_timer(&mpuirq_dev_data.batch_timer, jiffies +
+				  mpuirq_dev_data.batch_latency);
+		spin_unlock(&mpuirq_dev_data.batch_lock);
+	} else {
+		/* wake up (unblock) for reading data from userspace */
+		/* and ignore first interrupt generated in module init */
+		mpuirq_dev_data.data_ready = 1;
+	}
+
 	if ((mpuirq_dev_data.accel_divider >= 0) &&
 		(0 == (mycount % (mpuirq_dev_data.accel_divider + 1)))) {
 		schedule_work((struct work_struct
 				*) (&mpuirq_dev_data));
 	}
 
-	wake_up_interruptible(&mpuirq_wait);
+	if (!mpuirq_dev_data.batch_latency)
+		wake_up_interruptible(&mpuirq_wait);
 
 	return IRQ_HANDLED;
 
@@ -267,6 +358,10 @@ int mpuirq_init(struct i2c_client *mpu_client)
 	mpuirq_dev_data.data_ready = 0;
 	mpuirq_dev_data.timeout = 0;
 	mpuirq_dev_data.dev = &mpuirq_device;
+	spin_lock_init(&mpuirq_dev_data.batch_lock);
+	setup_timer(&mpuirq_dev_data.batch_timer, mpuirq_batch_timer_fcn, 0);
+	mpuirq_dev_data.batch_latency = 0;
+	mpuirq_dev_data.batch_max = MPUIRQ_BATCH_MAX;
 
 	if (mpuirq_dev_data.irq) {
 		unsigned long flags;
@@ -306,6 +401,7 @@ void mpuirq_exit(void)
 	/* Free the IRQ first before flushing the work */
 	if (mpuirq_dev_data.irq > 0)
 		free_irq(mpuirq_dev_data.irq, &mpuirq_dev_data.irq);
+	del_timer_sync(&mpuirq_dev_data.batch_timer);
 
 	flush_scheduled_work();
 
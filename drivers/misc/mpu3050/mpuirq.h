@@ -31,6 +31,28 @@
 #define MPUIRQ_SET_TIMEOUT           (5)
 #define MPUIRQ_SET_ACCEL_INFO        (6)
 #define MPUIRQ_SET_FREQUENCY_DIVIDER (7)
+#define MPUIRQ_SET_BATCH             (8)
+#define MPUIRQ_GET_BATCH             (9)
+
+/*
+ * Batch mode: interrupts are only timestamped until latency ms have
+ * passed since the first one, or max_count of them have been seen.
+ * Only then is the reader woken up. It drains the hardware FIFO in one
+ * burst and takes the matching timestamps with MPUIRQ_GET_BATCH.
+ * max_count should leave room in the 512 byte FIFO.
+ */
+#define MPUIRQ_BATCH_MAX             (64)
+
+struct mpuirq_batch_config {
+	int latency;		/* ms, 0 wakes the reader on every interrupt */
+	int max_count;		/* at most MPUIRQ_BATCH_MAX */
+};
+
+struct mpuirq_batch {
+	int count;
+	int dropped;		/* interrupts past MPUIRQ_BATCH_MAX */
+	unsigned long long irqtime[MPUIRQ_BATCH_MAX];	/* oldest first */
+};
 
 #ifdef __KERNEL__
 
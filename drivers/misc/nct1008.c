@@ -43,7 +43,9 @@
 #define CONFIG_WR			0x09
 #define CONV_RATE_WR			0x0A
 #define LOCAL_TEMP_HI_LIMIT_WR		0x0B
+#define LOCAL_TEMP_LO_LIMIT_WR		0x0C
 #define EXT_TEMP_HI_LIMIT_HI_BYTE	0x0D
+#define EXT_TEMP_LO_LIMIT_HI_BYTE	0x0E
 #define OFFSET_WR			0x11
 #define EXT_THERM_LIMIT_WR		0x19
 #define LOCAL_THERM_LIMIT_WR		0x20
@@ -65,6 +67,7 @@ struct nct1008_data {
 	struct mutex mutex;
 	u8 config;
 	void (*alarm_fn)(bool raised);
+	int step;
 };
 
 static ssize_t nct1008_show_temp(struct device *dev,
@@ -142,14 +145,86 @@ static void nct1008_disable(struct i2c_client *client)
 }
 
 
+static inline u8 value_to_temperature(bool extended, u8 value)
+{
+	return (extended ? (u8)(value - EXTENDED_RANGE_OFFSET) : value);
+}
+
+static inline u8 temperature_to_value(bool extended, u8 temp)
+{
+	return (extended ? (u8)(temp + EXTENDED_RANGE_OFFSET) : temp);
+}
+
+static inline bool nct1008_has_steps(struct nct1008_platform_data *pdata)
+{
+	return pdata->throttle_limits && pdata->num_throttle_limits > 0;
+}
+
+/*
+ * Find the throttle step for the current temperature and move the ALERT
+ * window around it, so that the next interrupt comes when a limit is
+ * crossed and nothing has to poll the sensor meanwhile.
+ */
+static void nct1008_update_step(struct nct1008_data *data)
+{
+	struct i2c_client *client = data->client;
+	struct nct1008_platform_data *pdata = client->dev.platform_data;
+	const u8 *limits = pdata->throttle_limits;
+	int num = pdata->num_throttle_limits;
+	int step = data->step;
+	u8 temp, hi, lo;
+	int value;
+
+	value = i2c_smbus_read_byte_data(client, EXT_HI_TEMP_RD);
+	if (value < 0) {
+		dev_err(&client->dev, "%s: failed to read "
+			"ext_temperature\n", __func__);
+		return;
+	}
+	temp = value_to_temperature(pdata->ext_range, value);
+
+	while (step < num && temp >= limits[step])
+		step++;
+	while (step > 0 && temp + pdata->throttle_hysteresis < limits[step - 1])
+		step--;
+
+	if (step < num)
+		hi = temperature_to_value(pdata->ext_range, limits[step] - 1);
+	else
+		hi = pdata->ext_range ? EXTENDED_RANGE_MAX : STANDARD_RANGE_MAX;
+
+	if (step > 0)
+		lo = temperature_to_value(pdata->ext_range,
+			limits[step - 1] - pdata->throttle_hysteresis);
+	else
+		lo = 0;
+
+	i2c_smbus_write_byte_data(client, EXT_TEMP_HI_LIMIT_HI_BYTE, hi);
+	i2c_smbus_write_byte_data(client, EXT_TEMP_LO_LIMIT_HI_BYTE, lo);
+
+	/* reading the status releases ALERT now that the window moved */
+	i2c_smbus_read_byte_data(client, STATUS_RD);
+
+	if (step != data->step) {
+		dev_dbg(&client->dev, "%s: %d C, throttle step %d\n",
+			__func__, temp, step);
+		data->step = step;
+		if (pdata->throttle_fn)
+			pdata->throttle_fn(step);
+	}
+}
+
 static void nct1008_work_func(struct work_struct *work)
 {
 	struct nct1008_data *data = container_of(work, struct nct1008_data, work);
+	struct nct1008_platform_data *pdata = data->client->dev.platform_data;
 	int irq = data->client->irq;
 
 	mutex_lock(&data->mutex);
 
-	if (data->alarm_fn) {
+	if (nct1008_has_steps(pdata)) {
+		nct1008_update_step(data);
+	} else if (data->alarm_fn) {
 		/* Therm2 line is active low */
 		data->alarm_fn(!gpio_get_value(irq_to_gpio(irq)));
 	}
@@ -165,16 +240,6 @@ static irqreturn_t nct1008_irq(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
-static inline u8 value_to_temperature(bool extended, u8 value)
-{
-	return (extended ? (u8)(value - EXTENDED_RANGE_OFFSET) : value);
-}
-
-static inline u8 temperature_to_value(bool extended, u8 temp)
-{
-	return (extended ? (u8)(temp + EXTENDED_RANGE_OFFSET) : temp);
-}
-
 static int __devinit nct1008_configure_sensor(struct nct1008_data* data)
 {
 	struct i2c_client *client           = data->client;
@@ -187,11 +252,15 @@ static int __devinit nct1008_configure_sensor(struct nct1008_data* data)
 
 	/*
 	 * Initial Configuration - device is placed in standby and
-	 * ALERT/THERM2 pin is configured as THERM2
+	 * ALERT/THERM2 pin is configured as THERM2, or as ALERT when
+	 * throttle steps are used
 	 */
-	data->config = value = pdata->ext_range ?
-		(STANDBY_BIT | THERM2_BIT | EXTENDED_RANGE_BIT) :
-		(STANDBY_BIT | THERM2_BIT);
+	value = STANDBY_BIT;
+	if (pdata->ext_range)
+		value |= EXTENDED_RANGE_BIT;
+	if (!nct1008_has_steps(pdata))
+		value |= THERM2_BIT;
+	data->config = value;
 
 	err = i2c_smbus_write_byte_data(client, CONFIG_WR, value);
 	if (err < 0)
@@ -214,11 +283,18 @@ static int __devinit nct1008_configure_sensor(struct nct1008_data* data)
 	if (err < 0)
 		goto error;
 
-	/* External Temperature Throttling limit */
-	value = temperature_to_value(pdata->ext_range, pdata->throttling_ext_limit);
-	err = i2c_smbus_write_byte_data(client, EXT_TEMP_HI_LIMIT_HI_BYTE, value);
-	if (err < 0)
-		goto error;
+	/*
+	 * External Temperature Throttling limit, with throttle steps the
+	 * ALERT window is set up by the first nct1008_update_step()
+	 */
+	if (!nct1008_has_steps(pdata)) {
+		value = temperature_to_value(pdata->ext_range,
+			pdata->throttling_ext_limit);
+		err = i2c_smbus_write_byte_data(client,
+			EXT_TEMP_HI_LIMIT_HI_BYTE, value);
+		if (err < 0)
+			goto error;
+	}
 
 	/* Local Temperature Throttling limit */
 	value = pdata->ext_range ? EXTENDED_RANGE_MAX : STANDARD_RANGE_MAX;
@@ -226,6 +302,11 @@ static int __devinit nct1008_configure_sensor(struct nct1008_data* data)
 	if (err < 0)
 		goto error;
 
+	/* the local channel must not raise ALERT either */
+	err = i2c_smbus_write_byte_data(client, LOCAL_TEMP_LO_LIMIT_WR, 0);
+	if (err < 0)
+		goto error;
+
 	/* Remote channel offset */
 	err = i2c_smbus_write_byte_data(client, OFFSET_WR, pdata->offset);
 	if (err < 0)
@@ -293,9 +374,12 @@ error:
 static int __devexit nct1008_remove(struct i2c_client *client)
 {
 	struct nct1008_data *data = i2c_get_clientdata(client);
+	struct nct1008_platform_data *pdata = client->dev.platform_data;
 
 	free_irq(data->client->irq, data);
 	cancel_work_sync(&data->work);
+	if (data->step && pdata->throttle_fn)
+		pdata->throttle_fn(0);
 	sysfs_remove_group(&client->dev.kobj, &nct1008_attr_group);
 	kfree(data);
 
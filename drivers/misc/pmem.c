@@ -19,6 +19,8 @@
 #include <linux/file.h>
 #include <linux/mm.h>
 #include <linux/list.h>
+#include <linux/bitmap.h>
+#include <linux/log2.h>
 #include <linux/debugfs.h>
 #include <linux/android_pmem.h>
 #include <linux/mempolicy.h>
@@ -118,6 +120,14 @@ struct pmem_info {
 	struct pmem_bits *bitmap;
 	/* indicates the region should not be managed with an allocator */
 	unsigned no_allocator;
+	/* indicates the region is managed with the bitmap allocator, then
+	 * each entry is quantum bytes, alloc_map has a bit set for every
+	 * allocated entry and alloc_quanta holds the number of entries of
+	 * each allocation at its first entry */
+	unsigned bitmap_allocator;
+	unsigned long quantum;
+	unsigned long *alloc_map;
+	unsigned int *alloc_quanta;
 	/* indicates maps of this region should be cached, if a mix of
 	 * cached and uncached is desired, set this and open the device with
 	 * O_SYNC to get an uncached region */
@@ -242,6 +252,12 @@ static int pmem_free(int id, int index)
 		pmem[id].allocated = 0;
 		return 0;
 	}
+	if (pmem[id].bitmap_allocator) {
+		bitmap_clear(pmem[id].alloc_map, index,
+			     pmem[id].alloc_quanta[index]);
+		pmem[id].alloc_quanta[index] = 0;
+		return 0;
+	}
 	/* clean up the bitmap, merging any buddies */
 	pmem[id].bitmap[curr].allocated = 0;
 	/* find a slots buddy Buddy# = Slot# ^ (1 << order)
@@ -376,6 +392,41 @@ static unsigned long pmem_order(unsigned long len)
 	return i;
 }
 
+/* best fit: the smallest run of free entries that holds len */
+static int pmem_allocate_bitmap(int id, unsigned long len)
+{
+	unsigned long *map = pmem[id].alloc_map;
+	unsigned long end = pmem[id].num_entries;
+	unsigned long quanta = DIV_ROUND_UP(len, pmem[id].quantum);
+	unsigned long start, next, best_len = 0;
+	int best_fit = -1;
+
+	if (!quanta || quanta > end)
+		return -1;
+
+	start = find_next_zero_bit(map, end, 0);
+	while (start < end) {
+		next = find_next_bit(map, end, start);
+		if (next - start >= quanta &&
+		    (best_fit < 0 || next - start < best_len)) {
+			best_fit = start;
+			best_len = next - start;
+			if (best_len == quanta)
+				break;
+		}
+		start = find_next_zero_bit(map, end, next);
+	}
+
+	if (best_fit < 0) {
+		printk("pmem: no space left to allocate!\n");
+		return -1;
+	}
+
+	bitmap_set(map, best_fit, quanta);
+	pmem[id].alloc_quanta[best_fit] = quanta;
+	return best_fit;
+}
+
 static int pmem_allocate(int id, unsigned long len)
 {
 	/* caller should hold the write lock on pmem_sem! */
@@ -393,6 +444,9 @@ static int pmem_allocate(int id, unsigned long len)
 		return len;
 	}
 
+	if (pmem[id].bitmap_allocator)
+		return pmem_allocate_bitmap(id, len);
+
 	if (order > PMEM_MAX_ORDER)
 		return -1;
 	DLOG("order %lx\n", order);
@@ -456,6 +510,8 @@ static unsigned long pmem_start_addr(int id, struct pmem_data *data)
 {
 	if (pmem[id].no_allocator)
 		return PMEM_START_ADDR(id, 0);
+	else if (pmem[id].bitmap_allocator)
+		return pmem[id].base + data->index * pmem[id].quantum;
 	else
 		return PMEM_START_ADDR(id, data->index);
 
@@ -470,6 +526,8 @@ static unsigned long pmem_len(int id, struct pmem_data *data)
 {
 	if (pmem[id].no_allocator)
 		return data->index;
+	else if (pmem[id].bitmap_allocator)
+		return pmem[id].alloc_quanta[data->index] * pmem[id].quantum;
 	else
 		return PMEM_LEN(id, data->index);
 }
@@ -1166,6 +1224,50 @@ static long pmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 }
 
 #if PMEM_DEBUG
+/* bytes allocated, number of free extents and the largest of them */
+static void pmem_usage(int id, unsigned long *used, unsigned long *free_blocks,
+		       unsigned long *largest)
+{
+	unsigned long entry, start, next, run, end = pmem[id].num_entries;
+
+	*used = 0;
+	*free_blocks = 0;
+	*largest = 0;
+
+	down_read(&pmem[id].bitmap_sem);
+	if (pmem[id].no_allocator) {
+		if (pmem[id].allocated)
+			*used = pmem[id].size;
+	} else if (pmem[id].bitmap_allocator) {
+		entry = pmem[id].quantum;
+		*used = bitmap_weight(pmem[id].alloc_map, end) * entry;
+		start = find_next_zero_bit(pmem[id].alloc_map, end, 0);
+		while (start < end) {
+			next = find_next_bit(pmem[id].alloc_map, end, start);
+			(*free_blocks)++;
+			*largest = max(*largest, (next - start) * entry);
+			start = find_next_zero_bit(pmem[id].alloc_map, end,
+						   next);
+		}
+	} else {
+		/* neighbouring free buddies of different orders are one
+		 * extent */
+		run = 0;
+		for (start = 0; start < end; start = PMEM_NEXT_INDEX(id, start)) {
+			if (!PMEM_IS_FREE(id, start)) {
+				*used += PMEM_LEN(id, start);
+				run = 0;
+				continue;
+			}
+			if (!run)
+				(*free_blocks)++;
+			run += PMEM_LEN(id, start);
+			*largest = max(*largest, run);
+		}
+	}
+	up_read(&pmem[id].bitmap_sem);
+}
+
 static ssize_t debug_open(struct inode *inode, struct file *file)
 {
 	file->private_data = inode->i_private;
@@ -1181,10 +1283,22 @@ static ssize_t debug_read(struct file *file, char __user *buf, size_t count,
 	int id = (int)file->private_data;
 	const int debug_bufmax = 4096;
 	static char buffer[4096];
+	unsigned long used, free_blocks, largest, free_k, frag;
 	int n = 0;
 
 	DLOG("debug open\n");
+	pmem_usage(id, &used, &free_blocks, &largest);
+	/* share of the free space outside the largest free block */
+	free_k = (pmem[id].size - used) >> 10;
+	frag = free_k ? 100 - (largest >> 10) * 100 / free_k : 0;
 	n = scnprintf(buffer, debug_bufmax,
+		      "%s allocator: used %luK of %luK, %lu free blocks, "
+		      "largest %luK, fragmentation %lu%%\n",
+		      pmem[id].no_allocator ? "no" :
+		      pmem[id].bitmap_allocator ? "bitmap" : "buddy",
+		      used >> 10, pmem[id].size >> 10, free_blocks,
+		      largest >> 10, frag);
+	n += scnprintf(buffer + n, debug_bufmax - n,
 		      "pid #: mapped regions (offset, len) (offset,len)...\n");
 
 	down(&pmem[id].data_list_sem);
@@ -1234,6 +1348,13 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	id_count++;
 
 	pmem[id].no_allocator = pdata->no_allocator;
+	pmem[id].bitmap_allocator = pdata->bitmap_allocator;
+	pmem[id].quantum = pdata->quantum ? pdata->quantum : PAGE_SIZE;
+	if (pmem[id].quantum < PAGE_SIZE || !is_power_of_2(pmem[id].quantum)) {
+		printk(KERN_WARNING "%s: bad quantum %lu, using %lu\n",
+		       pdata->name, pmem[id].quantum, PAGE_SIZE);
+		pmem[id].quantum = PAGE_SIZE;
+	}
 	pmem[id].cached = pdata->cached;
 	pmem[id].buffered = pdata->buffered;
 	pmem[id].base = pdata->start;
@@ -1253,20 +1374,31 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 		printk(KERN_ALERT "Unable to register pmem driver!\n");
 		goto err_cant_register_device;
 	}
-	pmem[id].num_entries = pmem[id].size / PMEM_MIN_ALLOC;
+	if (pmem[id].bitmap_allocator) {
+		pmem[id].num_entries = pmem[id].size / pmem[id].quantum;
+
+		pmem[id].alloc_map = kzalloc(BITS_TO_LONGS(
+			pmem[id].num_entries) * sizeof(long), GFP_KERNEL);
+		pmem[id].alloc_quanta = kzalloc(pmem[id].num_entries *
+			sizeof(unsigned int), GFP_KERNEL);
+		if (!pmem[id].alloc_map || !pmem[id].alloc_quanta)
+			goto err_no_mem_for_metadata;
+	} else {
+		pmem[id].num_entries = pmem[id].size / PMEM_MIN_ALLOC;
 
-	pmem[id].bitmap = kmalloc(pmem[id].num_entries *
-				  sizeof(struct pmem_bits), GFP_KERNEL);
-	if (!pmem[id].bitmap)
-		goto err_no_mem_for_metadata;
+		pmem[id].bitmap = kmalloc(pmem[id].num_entries *
+					  sizeof(struct pmem_bits), GFP_KERNEL);
+		if (!pmem[id].bitmap)
+			goto err_no_mem_for_metadata;
 
-	memset(pmem[id].bitmap, 0, sizeof(struct pmem_bits) *
-					  pmem[id].num_entries);
+		memset(pmem[id].bitmap, 0, sizeof(struct pmem_bits) *
+						  pmem[id].num_entries);
 
-	for (i = sizeof(pmem[id].num_entries) * 8 - 1; i >= 0; i--) {
-		if ((pmem[id].num_entries) &  1<<i) {
-			PMEM_ORDER(id, index) = i;
-			index = PMEM_NEXT_INDEX(id, index);
+		for (i = sizeof(pmem[id].num_entries) * 8 - 1; i >= 0; i--) {
+			if ((pmem[id].num_entries) &  1<<i) {
+				PMEM_ORDER(id, index) = i;
+				index = PMEM_NEXT_INDEX(id, index);
+			}
 		}
 	}
 
@@ -1294,8 +1426,10 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 #endif
 	return 0;
 error_cant_remap:
-	kfree(pmem[id].bitmap);
 err_no_mem_for_metadata:
+	kfree(pmem[id].bitmap);
+	kfree(pmem[id].alloc_map);
+	kfree(pmem[id].alloc_quanta);
 	misc_deregister(&pmem[id].dev);
 err_cant_register_device:
 	return -1;
@@ -30,6 +30,11 @@
 #include <linux/crypto.h>
 #include <linux/scatterlist.h>
 #include <linux/uaccess.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
 #include <crypto/rng.h>
 
 #include "tegra-cryptodev.h"
@@ -42,6 +47,13 @@ struct tegra_crypto_ctx {
 	struct crypto_rng *rng;
 	u8 seed[TEGRA_CRYPTO_RNG_SEED_SIZE];
 	int use_ssk;
+
+	/* asynchronous vectored requests */
+	spinlock_t lock;
+	struct list_head done;
+	wait_queue_head_t wait;
+	int inflight;	/* submitted, not completed */
+	int nr_batches;	/* submitted, not read back */
 };
 
 struct tegra_crypto_completion {
@@ -49,6 +61,34 @@ struct tegra_crypto_completion {
 	int req_err;
 };
 
+struct tegra_crypt_batch;
+
+struct tegra_crypt_batch_seg {
+	struct tegra_crypt_batch *batch;
+	struct ablkcipher_request *req;
+	struct sg_table in;
+	struct sg_table out;
+	struct page **pages;	/* src pages followed by dst pages */
+	int nr_src;
+	int nr_dst;
+	bool inplace;
+	u8 iv[TEGRA_CRYPTO_IV_SIZE];
+	int status;
+};
+
+struct tegra_crypt_batch {
+	struct list_head node;
+	struct tegra_crypto_ctx *ctx;
+	struct crypto_ablkcipher *tfm;
+	struct tegra_crypt_seg __user *usegs;
+	u64 cookie;
+	bool async;
+	atomic_t pending;
+	struct completion done;
+	int nsegs;
+	struct tegra_crypt_batch_seg segs[0];
+};
+
 static int alloc_bufs(unsigned long *buf[NBUFS])
 {
 	int i;
@@ -76,6 +116,133 @@ static void free_bufs(unsigned long *buf[NBUFS])
 		free_page((unsigned long)buf[i]);
 }
 
+static int tegra_crypt_nr_pages(unsigned long uaddr, int len)
+{
+	return DIV_ROUND_UP((uaddr & ~PAGE_MASK) + len, PAGE_SIZE);
+}
+
+/* pin a user buffer and describe it with one sg entry per page */
+static int tegra_crypt_pin(unsigned long uaddr, int len, int write,
+	struct page **pages, struct sg_table *sgt)
+{
+	unsigned int offset = uaddr & ~PAGE_MASK;
+	int nr = tegra_crypt_nr_pages(uaddr, len);
+	struct scatterlist *sg;
+	int i, ret;
+
+	ret = get_user_pages_fast(uaddr & PAGE_MASK, nr, write, pages);
+	if (ret < nr) {
+		for (i = 0; i < ret; i++)
+			page_cache_release(pages[i]);
+		return ret < 0 ? ret : -EFAULT;
+	}
+
+	ret = sg_alloc_table(sgt, nr, GFP_KERNEL);
+	if (ret) {
+		for (i = 0; i < nr; i++)
+			page_cache_release(pages[i]);
+		return ret;
+	}
+
+	for_each_sg(sgt->sgl, sg, nr, i) {
+		unsigned int n = min_t(unsigned int, len, PAGE_SIZE - offset);
+
+		sg_set_page(sg, pages[i], n, offset);
+		offset = 0;
+		len -= n;
+	}
+
+	return nr;
+}
+
+static void tegra_crypt_seg_unmap(struct tegra_crypt_batch_seg *seg)
+{
+	int i;
+
+	for (i = 0; i < seg->nr_src + seg->nr_dst; i++) {
+		if (seg->inplace || i >= seg->nr_src)
+			set_page_dirty_lock(seg->pages[i]);
+		page_cache_release(seg->pages[i]);
+	}
+
+	if (seg->nr_src)
+		sg_free_table(&seg->in);
+	if (seg->nr_dst)
+		sg_free_table(&seg->out);
+
+	ablkcipher_request_free(seg->req);
+	kfree(seg->pages);
+}
+
+/*
+ * Returns the first failing segment status. The status words are only
+ * written back when the submitter is still around to read them.
+ */
+static int tegra_crypt_batch_finish(struct tegra_crypt_batch *batch,
+	bool copy_status)
+{
+	int i, status = 0;
+
+	for (i = 0; i < batch->nsegs; i++) {
+		struct tegra_crypt_batch_seg *seg = &batch->segs[i];
+
+		if (copy_status && put_user(seg->status,
+			&batch->usegs[i].status) && !status)
+			status = -EFAULT;
+		if (seg->status && !status)
+			status = seg->status;
+		tegra_crypt_seg_unmap(seg);
+	}
+
+	crypto_free_ablkcipher(batch->tfm);
+	kfree(batch);
+	return status;
+}
+
+static void tegra_crypt_batch_put(struct tegra_crypt_batch *batch)
+{
+	struct tegra_crypto_ctx *ctx = batch->ctx;
+	unsigned long flags;
+
+	if (!atomic_dec_and_test(&batch->pending))
+		return;
+
+	if (!batch->async) {
+		complete(&batch->done);
+		return;
+	}
+
+	/* wake up under the lock, release() frees ctx once it sees idle */
+	spin_lock_irqsave(&ctx->lock, flags);
+	list_add_tail(&batch->node, &ctx->done);
+	ctx->inflight--;
+	wake_up(&ctx->wait);
+	spin_unlock_irqrestore(&ctx->lock, flags);
+}
+
+static void tegra_crypt_batch_complete(struct crypto_async_request *req,
+	int err)
+{
+	struct tegra_crypt_batch_seg *seg = req->data;
+
+	/* backlogged request got queued, it completes later */
+	if (err == -EINPROGRESS)
+		return;
+
+	seg->status = err;
+	tegra_crypt_batch_put(seg->batch);
+}
+
+static bool tegra_crypt_idle(struct tegra_crypto_ctx *ctx)
+{
+	bool idle;
+
+	spin_lock_irq(&ctx->lock);
+	idle = !ctx->inflight;
+	spin_unlock_irq(&ctx->lock);
+	return idle;
+}
+
 static int tegra_crypto_dev_open(struct inode *inode, struct file *filp)
 {
 	struct tegra_crypto_ctx *ctx;
@@ -113,6 +280,10 @@ static int tegra_crypto_dev_open(struct inode *inode, struct file *filp)
 		goto fail_rng;
 	}
 
+	spin_lock_init(&ctx->lock);
+	INIT_LIST_HEAD(&ctx->done);
+	init_waitqueue_head(&ctx->wait);
+
 	filp->private_data = ctx;
 	return ret;
 
@@ -130,6 +301,15 @@ fail_ecb:
 static int tegra_crypto_dev_release(struct inode *inode, struct file *filp)
 {
 	struct tegra_crypto_ctx *ctx = filp->private_data;
+	struct tegra_crypt_batch *batch, *tmp;
+
+	/* the engine still owns the pinned pages of in-flight batches */
+	wait_event(ctx->wait, tegra_crypt_idle(ctx));
+
+	list_for_each_entry_safe(batch, tmp, &ctx->done, node) {
+		list_del(&batch->node);
+		tegra_crypt_batch_finish(batch, false);
+	}
 
 	crypto_free_ablkcipher(ctx->ecb_tfm);
 	crypto_free_ablkcipher(ctx->cbc_tfm);
@@ -254,11 +434,159 @@ process_req_out:
 	return ret;
 }
 
+static int tegra_crypt_seg_map(struct tegra_crypt_batch *batch,
+	struct tegra_crypt_batch_seg *seg, struct tegra_crypt_seg *useg)
+{
+	unsigned long src = (unsigned long)useg->src;
+	unsigned long dst = (unsigned long)useg->dst;
+	int nr_pages, ret;
+
+	if ((useg->size <= 0) || (useg->size > TEGRA_CRYPTO_MAX_SEG_SIZE) ||
+		(useg->size % AES_BLOCK_SIZE))
+		return -EINVAL;
+
+	seg->batch = batch;
+	seg->inplace = (src == dst);
+	nr_pages = tegra_crypt_nr_pages(src, useg->size);
+	if (!seg->inplace)
+		nr_pages += tegra_crypt_nr_pages(dst, useg->size);
+
+	seg->pages = kcalloc(nr_pages, sizeof(struct page *), GFP_KERNEL);
+	seg->req = ablkcipher_request_alloc(batch->tfm, GFP_KERNEL);
+	if (!seg->pages || !seg->req)
+		return -ENOMEM;
+
+	/* an in-place buffer is written back by the engine */
+	ret = tegra_crypt_pin(src, useg->size, seg->inplace, seg->pages,
+		&seg->in);
+	if (ret < 0)
+		return ret;
+	seg->nr_src = ret;
+
+	if (!seg->inplace) {
+		ret = tegra_crypt_pin(dst, useg->size, 1,
+			seg->pages + seg->nr_src, &seg->out);
+		if (ret < 0)
+			return ret;
+		seg->nr_dst = ret;
+	}
+
+	memcpy(seg->iv, useg->iv, TEGRA_CRYPTO_IV_SIZE);
+
+	ablkcipher_request_set_callback(seg->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+		tegra_crypt_batch_complete, seg);
+	ablkcipher_request_set_crypt(seg->req, seg->in.sgl,
+		seg->inplace ? seg->in.sgl : seg->out.sgl, useg->size, seg->iv);
+
+	return 0;
+}
+
+/*
+ * Pin every segment into scatterlists and queue them all before waiting,
+ * so the engine works straight on user memory without bounce copies.
+ */
+static int process_crypt_req_vec(struct tegra_crypto_ctx *ctx,
+	struct tegra_crypt_req_vec *vec)
+{
+	struct tegra_crypt_batch *batch;
+	struct tegra_crypt_seg useg;
+	const u8 *key = NULL;
+	int i, ret;
+
+	if (!(vec->op & (TEGRA_CRYPTO_ECB | TEGRA_CRYPTO_CBC)) ||
+		(vec->keylen < 0) || (vec->keylen > AES_MAX_KEY_SIZE) ||
+		(vec->nsegs <= 0) || (vec->nsegs > TEGRA_CRYPTO_MAX_SEGS))
+		return -EINVAL;
+
+	batch = kzalloc(sizeof(*batch) +
+		vec->nsegs * sizeof(struct tegra_crypt_batch_seg), GFP_KERNEL);
+	if (!batch) {
+		pr_err("%s: Failed to allocate batch\n", __func__);
+		return -ENOMEM;
+	}
+
+	batch->ctx = ctx;
+	batch->usegs = (struct tegra_crypt_seg __user *)vec->segs;
+	batch->cookie = vec->cookie;
+	batch->async = !!(vec->flags & TEGRA_CRYPTO_VEC_ASYNC);
+	init_completion(&batch->done);
+
+	/* the batch keeps its own key while it is in flight */
+	batch->tfm = crypto_alloc_ablkcipher((vec->op & TEGRA_CRYPTO_ECB) ?
+		"ecb-aes-tegra" : "cbc-aes-tegra",
+		CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC, 0);
+	if (IS_ERR(batch->tfm)) {
+		ret = PTR_ERR(batch->tfm);
+		kfree(batch);
+		return ret;
+	}
+
+	if (!ctx->use_ssk)
+		key = vec->key;
+
+	ret = crypto_ablkcipher_setkey(batch->tfm, key, vec->keylen);
+	if (ret < 0) {
+		pr_err("setkey failed");
+		goto fail;
+	}
+
+	for (i = 0; i < vec->nsegs; i++) {
+		batch->nsegs++;
+		if (copy_from_user(&useg, &batch->usegs[i], sizeof(useg))) {
+			ret = -EFAULT;
+			goto fail;
+		}
+		ret = tegra_crypt_seg_map(batch, &batch->segs[i], &useg);
+		if (ret < 0) {
+			pr_debug("%s: segment %d: %d\n", __func__, i, ret);
+			goto fail;
+		}
+	}
+
+	if (batch->async) {
+		spin_lock_irq(&ctx->lock);
+		if (ctx->nr_batches >= TEGRA_CRYPTO_MAX_BATCHES) {
+			spin_unlock_irq(&ctx->lock);
+			ret = -EBUSY;
+			goto fail;
+		}
+		ctx->nr_batches++;
+		ctx->inflight++;
+		spin_unlock_irq(&ctx->lock);
+	}
+
+	/* one extra reference until everything is queued */
+	atomic_set(&batch->pending, batch->nsegs + 1);
+
+	for (i = 0; i < batch->nsegs; i++) {
+		struct tegra_crypt_batch_seg *seg = &batch->segs[i];
+
+		ret = vec->encrypt ? crypto_ablkcipher_encrypt(seg->req) :
+			crypto_ablkcipher_decrypt(seg->req);
+		if ((ret != -EINPROGRESS) && (ret != -EBUSY))
+			tegra_crypt_batch_complete(&seg->req->base, ret);
+	}
+
+	tegra_crypt_batch_put(batch);
+
+	if (batch->async)
+		return 0;
+
+	/* pages are pinned for the engine, do not bail out early */
+	wait_for_completion(&batch->done);
+	return tegra_crypt_batch_finish(batch, true);
+
+fail:
+	tegra_crypt_batch_finish(batch, false);
+	return ret;
+}
+
 static long tegra_crypto_dev_ioctl(struct file *filp,
 	unsigned int ioctl_num, unsigned long arg)
 {
 	struct tegra_crypto_ctx *ctx = filp->private_data;
 	struct tegra_crypt_req crypt_req;
+	struct tegra_crypt_req_vec crypt_req_vec;
 	struct tegra_rng_req rng_req;
 	char *rng;
 	int ret = 0;
@@ -277,6 +605,14 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 		ret = process_crypt_req(ctx, &crypt_req);
 		break;
 
+	case TEGRA_CRYPTO_IOCTL_PROCESS_REQ_VEC:
+		if (copy_from_user(&crypt_req_vec, (void __user *)arg,
+			sizeof(crypt_req_vec)))
+			return -EFAULT;
+
+		ret = process_crypt_req_vec(ctx, &crypt_req_vec);
+		break;
+
 	case TEGRA_CRYPTO_IOCTL_SET_SEED:
 		if (copy_from_user(&rng_req, (void __user *)arg, sizeof(rng_req)))
 			return -EFAULT;
@@ -323,10 +659,73 @@ rng_out:
 	return ret;
 }
 
+/* returns one struct tegra_crypt_done per finished asynchronous batch */
+static ssize_t tegra_crypto_dev_read(struct file *filp, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct tegra_crypto_ctx *ctx = filp->private_data;
+	struct tegra_crypt_batch *batch;
+	struct tegra_crypt_done done;
+	ssize_t copied = 0;
+	int ret;
+
+	if (count < sizeof(done))
+		return -EINVAL;
+
+	spin_lock_irq(&ctx->lock);
+	while (list_empty(&ctx->done)) {
+		spin_unlock_irq(&ctx->lock);
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(ctx->wait,
+			!list_empty(&ctx->done));
+		if (ret)
+			return ret;
+		spin_lock_irq(&ctx->lock);
+	}
+
+	while (!list_empty(&ctx->done) && (count - copied >= sizeof(done))) {
+		batch = list_first_entry(&ctx->done, struct tegra_crypt_batch,
+			node);
+		list_del(&batch->node);
+		ctx->nr_batches--;
+		spin_unlock_irq(&ctx->lock);
+
+		done.cookie = batch->cookie;
+		done.status = tegra_crypt_batch_finish(batch, true);
+		if (copy_to_user(buf + copied, &done, sizeof(done)))
+			return copied ? copied : -EFAULT;
+		copied += sizeof(done);
+
+		spin_lock_irq(&ctx->lock);
+	}
+	spin_unlock_irq(&ctx->lock);
+
+	return copied;
+}
+
+static unsigned int tegra_crypto_dev_poll(struct file *filp,
+	poll_table *wait)
+{
+	struct tegra_crypto_ctx *ctx = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &ctx->wait, wait);
+
+	spin_lock_irq(&ctx->lock);
+	if (!list_empty(&ctx->done))
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock_irq(&ctx->lock);
+
+	return mask;
+}
+
 struct file_operations tegra_crypto_fops = {
 	.owner = THIS_MODULE,
 	.open = tegra_crypto_dev_open,
 	.release = tegra_crypto_dev_release,
+	.read = tegra_crypto_dev_read,
+	.poll = tegra_crypto_dev_poll,
 	.unlocked_ioctl = tegra_crypto_dev_ioctl,
 };
 
@@ -28,6 +28,7 @@
 #define TEGRA_CRYPTO_IOCTL_PROCESS_REQ	_IOWR(0x98, 101, int*)
 #define TEGRA_CRYPTO_IOCTL_SET_SEED	_IOWR(0x98, 102, int*)
 #define TEGRA_CRYPTO_IOCTL_GET_RANDOM	_IOWR(0x98, 103, int*)
+#define TEGRA_CRYPTO_IOCTL_PROCESS_REQ_VEC	_IOWR(0x98, 104, int*)
 
 #define TEGRA_CRYPTO_MAX_KEY_SIZE	AES_MAX_KEY_SIZE
 #define TEGRA_CRYPTO_IV_SIZE	AES_BLOCK_SIZE
@@ -42,6 +43,14 @@
 #define TEGRA_CRYPTO_CBC	BIT(1)
 #define TEGRA_CRYPTO_RNG	BIT(2)
 
+/* limits for TEGRA_CRYPTO_IOCTL_PROCESS_REQ_VEC */
+#define TEGRA_CRYPTO_MAX_SEGS	64
+#define TEGRA_CRYPTO_MAX_SEG_SIZE	SZ_1M
+#define TEGRA_CRYPTO_MAX_BATCHES	16
+
+/* tegra_crypt_req_vec flags */
+#define TEGRA_CRYPTO_VEC_ASYNC	BIT(0)
+
 /* a pointer to this struct needs to be passed to:
  * TEGRA_CRYPTO_IOCTL_PROCESS_REQ
  */
@@ -57,6 +66,43 @@ struct tegra_crypt_req {
 	u8 *result;
 };
 
+/* one buffer of a TEGRA_CRYPTO_IOCTL_PROCESS_REQ_VEC batch. src and dst
+ * are pinned and handed to the engine directly, they may be the same
+ * buffer. size must be a multiple of the aes block size.
+ */
+struct tegra_crypt_seg {
+	char iv[TEGRA_CRYPTO_IV_SIZE];
+	u8 *src;
+	u8 *dst;
+	int size;
+	int status; /* written back when the batch is done */
+};
+
+/* a pointer to this struct needs to be passed to:
+ * TEGRA_CRYPTO_IOCTL_PROCESS_REQ_VEC
+ *
+ * All segments share op, direction and key. Without TEGRA_CRYPTO_VEC_ASYNC
+ * the ioctl returns once every segment is done. With it the ioctl returns
+ * after submission and a struct tegra_crypt_done carrying the cookie can
+ * be read() from the same fd once the batch completes; the segment status
+ * words are written back by that read(). poll() reports POLLIN then.
+ */
+struct tegra_crypt_req_vec {
+	int op; /* TEGRA_CRYPTO_ECB or TEGRA_CRYPTO_CBC */
+	bool encrypt;
+	char key[TEGRA_CRYPTO_MAX_KEY_SIZE];
+	int keylen;
+	int flags;
+	int nsegs;
+	struct tegra_crypt_seg *segs;
+	u64 cookie;
+};
+
+struct tegra_crypt_done {
+	u64 cookie;
+	int status; /* first failing segment status or 0 */
+};
+
 /* pointer to this struct should be passed to:
  * TEGRA_CRYPTO_IOCTL_SET_SEED
  * TEGRA_CRYPTO_IOCTL_GET_RANDOM
@@ -13,56 +13,110 @@
  *
  */
 
-#include <asm/atomic.h>
-
-#include <linux/err.h>
+#include <linux/hash.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/netdevice.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
+#include <linux/rculist.h>
 #include <linux/slab.h>
-#include <linux/spinlock.h>
 #include <linux/stat.h>
 #include <linux/uid_stat.h>
 #include <net/activity_stats.h>
+#include <net/dst.h>
+#include <net/sock.h>
+
+/*
+ * Entries are looked up on every send and receive, so the hash chains and
+ * the per-uid interface lists are walked under RCU only.  Entries are never
+ * freed, uid_lock just serializes creation.  Each (uid, interface) pair
+ * has per-cpu byte counters that are summed when /proc is read.
+ */
+#define UID_HASH_BITS	6
 
-static DEFINE_SPINLOCK(uid_lock);
-static LIST_HEAD(uid_list);
+static DEFINE_MUTEX(uid_lock);
+static struct hlist_head uid_hash[1 << UID_HASH_BITS];
 static struct proc_dir_entry *parent;
 
-struct uid_stat {
+enum {
+	UID_STAT_TCP_SND,
+	UID_STAT_TCP_RCV,
+	UID_STAT_UDP_SND,
+	UID_STAT_UDP_RCV,
+	UID_STAT_NR,
+};
+
+struct uid_stat_counters {
+	unsigned long bytes[UID_STAT_NR];
+};
+
+struct uid_iface_stat {
 	struct list_head link;
+	int ifindex;
+	char name[IFNAMSIZ];
+	struct uid_stat_counters __percpu *counters;
+};
+
+struct uid_stat {
+	struct hlist_node hash;
 	uid_t uid;
-	atomic_t tcp_rcv;
-	atomic_t tcp_snd;
+	struct list_head ifaces;
 };
 
 static struct uid_stat *find_uid_stat(uid_t uid) {
-	unsigned long flags;
 	struct uid_stat *entry;
+	struct hlist_node *node;
 
-	spin_lock_irqsave(&uid_lock, flags);
-	list_for_each_entry(entry, &uid_list, link) {
-		if (entry->uid == uid) {
-			spin_unlock_irqrestore(&uid_lock, flags);
+	hlist_for_each_entry_rcu(entry, node,
+			&uid_hash[hash_32(uid, UID_HASH_BITS)], hash) {
+		if (entry->uid == uid)
 			return entry;
-		}
 	}
-	spin_unlock_irqrestore(&uid_lock, flags);
 	return NULL;
 }
 
-static int tcp_snd_read_proc(char *page, char **start, off_t off,
-				int count, int *eof, void *data)
+static struct uid_iface_stat *find_iface_stat(struct uid_stat *uid_entry,
+					      int ifindex)
+{
+	struct uid_iface_stat *iface;
+
+	list_for_each_entry_rcu(iface, &uid_entry->ifaces, link) {
+		if (iface->ifindex == ifindex)
+			return iface;
+	}
+	return NULL;
+}
+
+static unsigned long uid_stat_sum(struct uid_iface_stat *iface, int type)
+{
+	unsigned long bytes = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		bytes += per_cpu_ptr(iface->counters, cpu)->bytes[type];
+	return bytes;
+}
+
+static int uid_stat_read_proc(char *page, char **start, off_t off,
+			      int count, int *eof, void *data, int type)
 {
 	int len;
-	unsigned int bytes;
+	unsigned int bytes = 0;
 	char *p = page;
 	struct uid_stat *uid_entry = (struct uid_stat *) data;
+	struct uid_iface_stat *iface;
 	if (!data)
 		return 0;
 
-	bytes = (unsigned int) (atomic_read(&uid_entry->tcp_snd) + INT_MIN);
+	/* Totals wrap at 4GB, as they always have. */
+	rcu_read_lock();
+	list_for_each_entry_rcu(iface, &uid_entry->ifaces, link)
+		bytes += uid_stat_sum(iface, type);
+	rcu_read_unlock();
+
 	p += sprintf(p, "%u\n", bytes);
 	len = (p - page) - off;
 	*eof = (len <= count) ? 1 : 0;
@@ -70,43 +124,75 @@ static int tcp_snd_read_proc(char *page, char **start, off_t off,
 	return len;
 }
 
+static int tcp_snd_read_proc(char *page, char **start, off_t off,
+				int count, int *eof, void *data)
+{
+	return uid_stat_read_proc(page, start, off, count, eof, data,
+				  UID_STAT_TCP_SND);
+}
+
 static int tcp_rcv_read_proc(char *page, char **start, off_t off,
 				int count, int *eof, void *data)
+{
+	return uid_stat_read_proc(page, start, off, count, eof, data,
+				  UID_STAT_TCP_RCV);
+}
+
+static int udp_snd_read_proc(char *page, char **start, off_t off,
+				int count, int *eof, void *data)
+{
+	return uid_stat_read_proc(page, start, off, count, eof, data,
+				  UID_STAT_UDP_SND);
+}
+
+static int udp_rcv_read_proc(char *page, char **start, off_t off,
+				int count, int *eof, void *data)
+{
+	return uid_stat_read_proc(page, start, off, count, eof, data,
+				  UID_STAT_UDP_RCV);
+}
+
+/* One line per interface the uid has used, in order of first use. */
+static int iface_read_proc(char *page, char **start, off_t off,
+				int count, int *eof, void *data)
 {
 	int len;
-	unsigned int bytes;
 	char *p = page;
 	struct uid_stat *uid_entry = (struct uid_stat *) data;
+	struct uid_iface_stat *iface;
 	if (!data)
 		return 0;
 
-	bytes = (unsigned int) (atomic_read(&uid_entry->tcp_rcv) + INT_MIN);
-	p += sprintf(p, "%u\n", bytes);
+	p += sprintf(p, "iface tcp_rcv tcp_snd udp_rcv udp_snd\n");
+	rcu_read_lock();
+	list_for_each_entry_rcu(iface, &uid_entry->ifaces, link) {
+		if (p - page > PAGE_SIZE - 80)
+			break;
+		p += sprintf(p, "%s %lu %lu %lu %lu\n", iface->name,
+			     uid_stat_sum(iface, UID_STAT_TCP_RCV),
+			     uid_stat_sum(iface, UID_STAT_TCP_SND),
+			     uid_stat_sum(iface, UID_STAT_UDP_RCV),
+			     uid_stat_sum(iface, UID_STAT_UDP_SND));
+	}
+	rcu_read_unlock();
+
 	len = (p - page) - off;
 	*eof = (len <= count) ? 1 : 0;
 	*start = page + off;
 	return len;
 }
 
-/* Create a new entry for tracking the specified uid. */
+/* Create a new entry for tracking the specified uid. Called with uid_lock. */
 static struct uid_stat *create_stat(uid_t uid) {
-	unsigned long flags;
 	char uid_s[32];
 	struct uid_stat *new_uid;
 	struct proc_dir_entry *entry;
 
-	/* Create the uid stat struct and append it to the list. */
 	if ((new_uid = kmalloc(sizeof(struct uid_stat), GFP_KERNEL)) == NULL)
 		return NULL;
 
 	new_uid->uid = uid;
-	/* Counters start at INT_MIN, so we can track 4GB of network traffic. */
-	atomic_set(&new_uid->tcp_rcv, INT_MIN);
-	atomic_set(&new_uid->tcp_snd, INT_MIN);
-
-	spin_lock_irqsave(&uid_lock, flags);
-	list_add_tail(&new_uid->link, &uid_list);
-	spin_unlock_irqrestore(&uid_lock, flags);
+	INIT_LIST_HEAD(&new_uid->ifaces);
 
 	sprintf(uid_s, "%d", uid);
 	entry = proc_mkdir(uid_s, parent);
@@ -118,31 +204,144 @@ static struct uid_stat *create_stat(uid_t uid) {
 	create_proc_read_entry("tcp_rcv", S_IRUGO, entry, tcp_rcv_read_proc,
 		(void *) new_uid);
 
+	create_proc_read_entry("udp_snd", S_IRUGO, entry, udp_snd_read_proc,
+		(void *) new_uid);
+
+	create_proc_read_entry("udp_rcv", S_IRUGO, entry, udp_rcv_read_proc,
+		(void *) new_uid);
+
+	create_proc_read_entry("iface", S_IRUGO, entry, iface_read_proc,
+		(void *) new_uid);
+
+	hlist_add_head_rcu(&new_uid->hash,
+			   &uid_hash[hash_32(uid, UID_HASH_BITS)]);
 	return new_uid;
 }
 
-int uid_stat_tcp_snd(uid_t uid, int size) {
-	struct uid_stat *entry;
-	activity_stats_update();
-	if ((entry = find_uid_stat(uid)) == NULL &&
-		((entry = create_stat(uid)) == NULL)) {
-			return -1;
+/* Called with uid_lock. */
+static struct uid_iface_stat *create_iface_stat(struct uid_stat *uid_entry,
+						struct net *net, int ifindex)
+{
+	struct uid_iface_stat *iface;
+	struct net_device *dev;
+
+	iface = kmalloc(sizeof(*iface), GFP_KERNEL);
+	if (!iface)
+		return NULL;
+
+	iface->counters = alloc_percpu(struct uid_stat_counters);
+	if (!iface->counters) {
+		kfree(iface);
+		return NULL;
 	}
-	atomic_add(size, &entry->tcp_snd);
-	return 0;
+
+	iface->ifindex = ifindex;
+	strcpy(iface->name, "unknown");
+	rcu_read_lock();
+	dev = ifindex ? dev_get_by_index_rcu(net, ifindex) : NULL;
+	if (dev)
+		strlcpy(iface->name, dev->name, IFNAMSIZ);
+	rcu_read_unlock();
+
+	list_add_tail_rcu(&iface->link, &uid_entry->ifaces);
+	return iface;
 }
 
-int uid_stat_tcp_rcv(uid_t uid, int size) {
-	struct uid_stat *entry;
+static struct uid_iface_stat *lookup_iface_stat(uid_t uid, int ifindex)
+{
+	struct uid_stat *uid_entry;
+	struct uid_iface_stat *iface = NULL;
+
+	rcu_read_lock();
+	uid_entry = find_uid_stat(uid);
+	if (uid_entry)
+		iface = find_iface_stat(uid_entry, ifindex);
+	rcu_read_unlock();
+
+	return iface;
+}
+
+/* First traffic of a uid on an interface, may sleep. */
+static struct uid_iface_stat *create_iface_stat_slow(uid_t uid,
+		struct net *net, int ifindex)
+{
+	struct uid_stat *uid_entry;
+	struct uid_iface_stat *iface;
+
+	mutex_lock(&uid_lock);
+	iface = lookup_iface_stat(uid, ifindex);
+	if (!iface) {
+		rcu_read_lock();
+		uid_entry = find_uid_stat(uid);
+		rcu_read_unlock();
+		if (!uid_entry)
+			uid_entry = create_stat(uid);
+		if (uid_entry)
+			iface = create_iface_stat(uid_entry, net, ifindex);
+	}
+	mutex_unlock(&uid_lock);
+
+	return iface;
+}
+
+static int uid_stat_update(uid_t uid, struct net *net, int ifindex,
+			   int type, int size)
+{
+	struct uid_iface_stat *iface;
+
 	activity_stats_update();
-	if ((entry = find_uid_stat(uid)) == NULL &&
-		((entry = create_stat(uid)) == NULL)) {
+
+	iface = lookup_iface_stat(uid, ifindex);
+	if (unlikely(!iface)) {
+		if (in_interrupt())
+			return -1;
+		iface = create_iface_stat_slow(uid, net, ifindex);
+		if (!iface)
 			return -1;
 	}
-	atomic_add(size, &entry->tcp_rcv);
+
+	/* rx can be accounted from softirq, so the add must be irq safe */
+	irqsafe_cpu_add(iface->counters->bytes[type], size);
 	return 0;
 }
 
+/* Stream sockets are accounted to the interface of their cached route. */
+static int uid_stat_sk_ifindex(struct sock *sk)
+{
+	struct dst_entry *dst;
+	int ifindex = 0;
+
+	rcu_read_lock();
+	dst = __sk_dst_get(sk);
+	if (dst && dst->dev)
+		ifindex = dst->dev->ifindex;
+	rcu_read_unlock();
+
+	return ifindex;
+}
+
+int uid_stat_tcp_snd(uid_t uid, struct sock *sk, int size) {
+	return uid_stat_update(uid, sock_net(sk), uid_stat_sk_ifindex(sk),
+			       UID_STAT_TCP_SND, size);
+}
+
+int uid_stat_tcp_rcv(uid_t uid, struct sock *sk, int size) {
+	return uid_stat_update(uid, sock_net(sk), uid_stat_sk_ifindex(sk),
+			       UID_STAT_TCP_RCV, size);
+}
+
+int uid_stat_udp_snd(uid_t uid, struct sock *sk, int ifindex, int size)
+{
+	return uid_stat_update(uid, sock_net(sk), ifindex, UID_STAT_UDP_SND,
+			       size);
+}
+
+int uid_stat_udp_rcv(uid_t uid, struct sock *sk, int ifindex, int size)
+{
+	return uid_stat_update(uid, sock_net(sk), ifindex, UID_STAT_UDP_RCV,
+			       size);
+}
+
 static int __init uid_stat_init(void)
 {
 	parent = proc_mkdir("uid_stat", NULL);
@@ -32,6 +32,7 @@
 #include <linux/smp_lock.h>
 #include <linux/scatterlist.h>
 #include <linux/string_helpers.h>
+#include <linux/power_supply.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -53,6 +54,33 @@ MODULE_ALIAS("mmc:block");
 
 static DECLARE_BITMAP(dev_use, MMC_NUM_MINORS);
 
+/*
+ * Discards are collected and sent to the card once the queue has been
+ * idle for this long, so that the I/O behind them does not wait for the
+ * erase.  0 sends them as they come.
+ */
+static unsigned int idle_discard_ms = 1000;
+module_param(idle_discard_ms, uint, 0444);
+MODULE_PARM_DESC(idle_discard_ms, "Defer discards until the queue is idle "
+		 "for this many ms (0 = no deferral)");
+
+/*
+ * eMMC background operations are started once the queue has been idle
+ * for this long after writes.  On battery only cards reporting that
+ * their performance is impacted get them.  0 never starts them.
+ */
+static unsigned int idle_bkops_ms = 2000;
+module_param(idle_bkops_ms, uint, 0644);
+MODULE_PARM_DESC(idle_bkops_ms, "Start eMMC background operations when the "
+		 "queue is idle for this many ms (0 = never)");
+
+#define MMC_BLK_DISCARD_RANGES	32
+
+struct mmc_blk_range {
+	unsigned int	from;
+	unsigned int	nr;
+};
+
 /*
  * There is one mmc_blk_data per slot.
  */
@@ -63,6 +91,18 @@ struct mmc_blk_data {
 
 	unsigned int	usage;
 	unsigned int	read_only;
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+	unsigned int	blksize_pending;
+#endif
+
+	/* deferred discards, only touched from the queue thread */
+	struct mmc_blk_range discard[MMC_BLK_DISCARD_RANGES];
+	unsigned int	nr_discard;
+	unsigned int	defer_discard;
+
+	/* writes since the last idle BKOPS check, queue thread only */
+	unsigned int	bkops_check;
+	unsigned int	bkops_urgent;	/* card raised an exception event */
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -146,13 +186,6 @@ static const struct block_device_operations mmc_bdops = {
 	.owner			= THIS_MODULE,
 };
 
-struct mmc_blk_request {
-	struct mmc_request	mrq;
-	struct mmc_command	cmd;
-	struct mmc_command	stop;
-	struct mmc_data		data;
-};
-
 static u32 mmc_sd_num_wr_blocks(struct mmc_card *card)
 {
 	int err;
@@ -243,6 +276,163 @@ static u32 get_card_status(struct mmc_card *card, struct request *req)
 	return cmd.resp[0];
 }
 
+static bool mmc_blk_queue_pending(struct mmc_queue *mq)
+{
+	struct request_queue *q = mq->queue;
+	bool pending;
+
+	spin_lock_irq(q->queue_lock);
+	pending = blk_peek_request(q) != NULL;
+	spin_unlock_irq(q->queue_lock);
+
+	return pending;
+}
+
+/* When the queue thread should call mmc_blk_idle() next */
+static void mmc_blk_set_idle(struct mmc_blk_data *md)
+{
+	unsigned long timeout = 0;
+
+	if (md->nr_discard)
+		timeout = msecs_to_jiffies(idle_discard_ms);
+	else if (md->bkops_urgent)
+		timeout = 1;
+	else if (md->bkops_check && idle_bkops_ms)
+		timeout = msecs_to_jiffies(idle_bkops_ms);
+
+	md->queue.idle_timeout = timeout;
+}
+
+/*
+ * Send the deferred discards, newest first.  With @preempt, stop as soon
+ * as new requests are queued; the rest waits for the next idle period.
+ * The host must be claimed.
+ */
+static void mmc_blk_flush_discards(struct mmc_blk_data *md, bool preempt)
+{
+	struct mmc_card *card = md->queue.card;
+	unsigned int max = md->queue.queue->limits.max_discard_sectors;
+	unsigned int arg = mmc_can_trim(card) ? MMC_TRIM_ARG : MMC_ERASE_ARG;
+
+	while (md->nr_discard) {
+		struct mmc_blk_range *r = &md->discard[md->nr_discard - 1];
+		unsigned int nr = min(r->nr, max);
+		int err;
+
+		err = mmc_erase(card, r->from, nr, arg);
+		if (err)
+			pr_debug("%s: discard of %u sectors at %u failed: %d\n",
+				 md->disk->disk_name, nr, r->from, err);
+
+		r->from += nr;
+		r->nr -= nr;
+		if (!r->nr)
+			md->nr_discard--;
+
+		if (preempt && mmc_blk_queue_pending(&md->queue))
+			break;
+	}
+
+	mmc_blk_set_idle(md);
+}
+
+/*
+ * Background operations keep the card busy until they finish or the
+ * next request interrupts them with an HPI.  They are worth starting
+ * at any level while on external power; on battery only once the card
+ * reports its performance is impacted, or raised an exception event.
+ */
+static void mmc_blk_start_bkops(struct mmc_blk_data *md)
+{
+	struct mmc_card *card = md->queue.card;
+	unsigned int min_level = EXT_CSD_BKOPS_LEVEL_1;
+
+	if (!md->bkops_urgent && !power_supply_is_system_supplied())
+		min_level = EXT_CSD_BKOPS_LEVEL_2;
+
+	if (!mmc_blk_queue_pending(&md->queue))
+		mmc_start_bkops(card, min_level);
+
+	md->bkops_check = 0;
+	md->bkops_urgent = 0;
+}
+
+static void mmc_blk_idle(struct mmc_queue *mq)
+{
+	struct mmc_blk_data *md = mq->data;
+
+	mmc_claim_host(md->queue.card->host);
+	if (md->nr_discard)
+		mmc_blk_flush_discards(md, true);
+	if (!md->nr_discard && (md->bkops_check || md->bkops_urgent))
+		mmc_blk_start_bkops(md);
+	mmc_blk_set_idle(md);
+	mmc_release_host(md->queue.card->host);
+}
+
+/* Remember a discard, merging it with one already pending if they touch */
+static void mmc_blk_defer_discard(struct mmc_blk_data *md, unsigned int from,
+				  unsigned int nr)
+{
+	unsigned int end = from + nr;
+	int i;
+
+	for (i = 0; i < md->nr_discard; i++) {
+		struct mmc_blk_range *r = &md->discard[i];
+		unsigned int r_end = r->from + r->nr;
+
+		if (from <= r_end && r->from <= end) {
+			r->from = min(r->from, from);
+			r->nr = max(r_end, end) - r->from;
+			goto out;
+		}
+	}
+
+	if (md->nr_discard == MMC_BLK_DISCARD_RANGES)
+		mmc_blk_flush_discards(md, false);
+
+	md->discard[md->nr_discard].from = from;
+	md->discard[md->nr_discard].nr = nr;
+	md->nr_discard++;
+ out:
+	mmc_blk_set_idle(md);
+}
+
+/*
+ * A write to a range with a deferred discard must not be erased
+ * afterwards.  If a range cannot be split, its tail is dropped, which
+ * is always safe for a discard.
+ */
+static void mmc_blk_discard_clip(struct mmc_blk_data *md, unsigned int from,
+				 unsigned int nr)
+{
+	unsigned int end = from + nr;
+	int i;
+
+	for (i = md->nr_discard - 1; i >= 0; i--) {
+		struct mmc_blk_range *r = &md->discard[i];
+		unsigned int r_end = r->from + r->nr;
+
+		if (end <= r->from || from >= r_end)
+			continue;
+
+		if (from > r->from) {
+			if (end < r_end &&
+			    md->nr_discard < MMC_BLK_DISCARD_RANGES) {
+				md->discard[md->nr_discard].from = end;
+				md->discard[md->nr_discard].nr = r_end - end;
+				md->nr_discard++;
+			}
+			r->nr = from - r->from;
+		} else if (end < r_end) {
+			r->nr = r_end - end;
+			r->from = end;
+		} else {
+			*r = md->discard[--md->nr_discard];
+		}
+	}
+}
+
 static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
@@ -260,6 +450,11 @@ static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 	from = blk_rq_pos(req);
 	nr = blk_rq_sectors(req);
 
+	if (md->defer_discard) {
+		mmc_blk_defer_discard(md, from, nr);
+		goto out;
+	}
+
 	if (mmc_can_trim(card))
 		arg = MMC_TRIM_ARG;
 	else
@@ -312,234 +507,331 @@ out:
 	return err ? 0 : 1;
 }
 
-static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
+enum mmc_blk_status {
+	MMC_BLK_SUCCESS = 0,
+	MMC_BLK_RETRY_SINGLE,
+	MMC_BLK_DATA_ERR,
+	MMC_BLK_CMD_ERR,
+};
+
+static int mmc_blk_err_check(struct mmc_card *card,
+			     struct mmc_async_req *areq)
 {
-	struct mmc_blk_data *md = mq->data;
-	struct mmc_card *card = md->queue.card;
-	struct mmc_blk_request brq;
-	int ret = 1, disable_multi = 0;
+	struct mmc_queue_req *mqrq = container_of(areq, struct mmc_queue_req,
+						  mmc_active);
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct mmc_command cmd;
+	u32 status = 0;
 
-	mmc_claim_host(card->host);
+	/*
+	 * Check for errors here, but don't report them until later as
+	 * we need to wait for the card to leave programming mode even
+	 * when things go wrong.
+	 */
+	if (brq->cmd.error || brq->data.error || brq->stop.error) {
+		if (brq->data.blocks > 1 && rq_data_dir(req) == READ) {
+			/* Redo read one sector at a time */
+			printk(KERN_WARNING "%s: retrying using single "
+			       "block read\n", req->rq_disk->disk_name);
+			return MMC_BLK_RETRY_SINGLE;
+		}
+		status = get_card_status(card, req);
+	}
 
-	do {
-		struct mmc_command cmd;
-		u32 readcmd, writecmd, status = 0;
-
-		memset(&brq, 0, sizeof(struct mmc_blk_request));
-		brq.mrq.cmd = &brq.cmd;
-		brq.mrq.data = &brq.data;
-
-		brq.cmd.arg = blk_rq_pos(req);
-		if (!mmc_card_blockaddr(card))
-			brq.cmd.arg <<= 9;
-		brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
-		brq.data.blksz = 512;
-		brq.stop.opcode = MMC_STOP_TRANSMISSION;
-		brq.stop.arg = 0;
-		brq.stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-		brq.data.blocks = blk_rq_sectors(req);
+	if (brq->cmd.error) {
+		printk(KERN_ERR "%s: error %d sending read/write "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->cmd.error,
+		       brq->cmd.resp[0], status);
+	}
 
-		/*
-		 * The block layer doesn't support all sector count
-		 * restrictions, so we need to be prepared for too big
-		 * requests.
-		 */
-		if (brq.data.blocks > card->host->max_blk_count)
-			brq.data.blocks = card->host->max_blk_count;
+	if (brq->data.error) {
+		if (brq->data.error == -ETIMEDOUT && brq->mrq.stop)
+			/* 'Stop' response contains card status */
+			status = brq->mrq.stop->resp[0];
+		printk(KERN_ERR "%s: error %d transferring data,"
+		       " sector %u, nr %u, card status %#x\n",
+		       req->rq_disk->disk_name, brq->data.error,
+		       (unsigned)blk_rq_pos(req),
+		       (unsigned)blk_rq_sectors(req), status);
+	}
 
-		/*
-		 * After a read error, we redo the request one sector at a time
-		 * in order to accurately determine which sectors can be read
-		 * successfully.
-		 */
-		if (disable_multi && brq.data.blocks > 1)
-			brq.data.blocks = 1;
+	if (brq->stop.error) {
+		printk(KERN_ERR "%s: error %d sending stop command, "
+		       "response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->stop.error,
+		       brq->stop.resp[0], status);
+	}
 
-		if (brq.data.blocks > 1) {
-			/* SPI multiblock writes terminate using a special
-			 * token, not a STOP_TRANSMISSION request.
+	if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
+		do {
+			int err;
+
+			memset(&cmd, 0, sizeof(struct mmc_command));
+			cmd.opcode = MMC_SEND_STATUS;
+			cmd.arg = card->rca << 16;
+			cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+			err = mmc_wait_for_cmd(card->host, &cmd, 5);
+			if (err) {
+				printk(KERN_ERR "%s: error %d requesting status\n",
+				       req->rq_disk->disk_name, err);
+				return MMC_BLK_CMD_ERR;
+			}
+			/*
+			 * Some cards mishandle the status bits,
+			 * so make sure to check both the busy
+			 * indication and the card state.
 			 */
-			if (!mmc_host_is_spi(card->host)
-					|| rq_data_dir(req) == READ)
-				brq.mrq.stop = &brq.stop;
-			readcmd = MMC_READ_MULTIPLE_BLOCK;
-			writecmd = MMC_WRITE_MULTIPLE_BLOCK;
-		} else {
-			brq.mrq.stop = NULL;
-			readcmd = MMC_READ_SINGLE_BLOCK;
-			writecmd = MMC_WRITE_BLOCK;
-		}
+		} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+			(R1_CURRENT_STATE(cmd.resp[0]) == 7));
+	}
 
-		if (rq_data_dir(req) == READ) {
-			brq.cmd.opcode = readcmd;
-			brq.data.flags |= MMC_DATA_READ;
-		} else {
-			brq.cmd.opcode = writecmd;
-			brq.data.flags |= MMC_DATA_WRITE;
-		}
+	if (brq->cmd.error || brq->stop.error || brq->data.error) {
+		if (rq_data_dir(req) == READ)
+			return MMC_BLK_DATA_ERR;
+		return MMC_BLK_CMD_ERR;
+	}
 
-		mmc_set_data_timeout(&brq.data, card);
+	return MMC_BLK_SUCCESS;
+}
 
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
+			       struct mmc_card *card, struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	u32 readcmd, writecmd;
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	brq->data.blocks = blk_rq_sectors(req);
 
-		/*
-		 * Adjust the sg list so it is the same size as the
-		 * request.
+	/*
+	 * The block layer doesn't support all sector count
+	 * restrictions, so we need to be prepared for too big
+	 * requests.
+	 */
+	if (brq->data.blocks > card->host->max_blk_count)
+		brq->data.blocks = card->host->max_blk_count;
+
+	/*
+	 * After a read error, we redo the request one sector at a time
+	 * in order to accurately determine which sectors can be read
+	 * successfully.
+	 */
+	if (mqrq->disable_multi && brq->data.blocks > 1)
+		brq->data.blocks = 1;
+
+	if (brq->data.blocks > 1) {
+		/* SPI multiblock writes terminate using a special
+		 * token, not a STOP_TRANSMISSION request.
 		 */
-		if (brq.data.blocks != blk_rq_sectors(req)) {
-			int i, data_size = brq.data.blocks << 9;
-			struct scatterlist *sg;
-
-			for_each_sg(brq.data.sg, sg, brq.data.sg_len, i) {
-				data_size -= sg->length;
-				if (data_size <= 0) {
-					sg->length += data_size;
-					i++;
-					break;
-				}
-			}
-			brq.data.sg_len = i;
-		}
+		if (!mmc_host_is_spi(card->host)
+				|| rq_data_dir(req) == READ)
+			brq->mrq.stop = &brq->stop;
+		readcmd = MMC_READ_MULTIPLE_BLOCK;
+		writecmd = MMC_WRITE_MULTIPLE_BLOCK;
+	} else {
+		brq->mrq.stop = NULL;
+		readcmd = MMC_READ_SINGLE_BLOCK;
+		writecmd = MMC_WRITE_BLOCK;
+	}
 
-		mmc_queue_bounce_pre(mq);
+	if (rq_data_dir(req) == READ) {
+		brq->cmd.opcode = readcmd;
+		brq->data.flags |= MMC_DATA_READ;
+	} else {
+		brq->cmd.opcode = writecmd;
+		brq->data.flags |= MMC_DATA_WRITE;
+	}
 
-		mmc_wait_for_req(card->host, &brq.mrq);
+	mmc_set_data_timeout(&brq->data, card);
 
-		mmc_queue_bounce_post(mq);
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
 
-		/*
-		 * Check for errors here, but don't jump to cmd_err
-		 * until later as we need to wait for the card to leave
-		 * programming mode even when things go wrong.
-		 */
-		if (brq.cmd.error || brq.data.error || brq.stop.error) {
-			if (brq.data.blocks > 1 && rq_data_dir(req) == READ) {
-				/* Redo read one sector at a time */
-				printk(KERN_WARNING "%s: retrying using single "
-				       "block read\n", req->rq_disk->disk_name);
-				disable_multi = 1;
-				continue;
+	/*
+	 * Adjust the sg list so it is the same size as the
+	 * request.
+	 */
+	if (brq->data.blocks != blk_rq_sectors(req)) {
+		int i, data_size = brq->data.blocks << 9;
+		struct scatterlist *sg;
+
+		for_each_sg(brq->data.sg, sg, brq->data.sg_len, i) {
+			data_size -= sg->length;
+			if (data_size <= 0) {
+				sg->length += data_size;
+				i++;
+				break;
 			}
-			status = get_card_status(card, req);
-		} else if (disable_multi == 1) {
-			disable_multi = 0;
 		}
+		brq->data.sg_len = i;
+	}
 
-		if (brq.cmd.error) {
-			printk(KERN_ERR "%s: error %d sending read/write "
-			       "command, response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.cmd.error,
-			       brq.cmd.resp[0], status);
-		}
+	mmc_queue_bounce_pre(mqrq);
 
-		if (brq.data.error) {
-			if (brq.data.error == -ETIMEDOUT && brq.mrq.stop)
-				/* 'Stop' response contains card status */
-				status = brq.mrq.stop->resp[0];
-			printk(KERN_ERR "%s: error %d transferring data,"
-			       " sector %u, nr %u, card status %#x\n",
-			       req->rq_disk->disk_name, brq.data.error,
-			       (unsigned)blk_rq_pos(req),
-			       (unsigned)blk_rq_sectors(req), status);
-		}
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_err_check;
+}
 
-		if (brq.stop.error) {
-			printk(KERN_ERR "%s: error %d sending stop command, "
-			       "response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.stop.error,
-			       brq.stop.resp[0], status);
-		}
+/*
+ * Complete the part of a request that has been transferred.  Returns
+ * non-zero if some of it is left, in which case it has been prepared
+ * to be sent again; otherwise the slot is freed.
+ */
+static int mmc_blk_rw_done(struct mmc_queue *mq, struct mmc_queue_req *mqrq,
+			   int status)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	int ret;
 
-		if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
-			do {
-				int err;
-
-				cmd.opcode = MMC_SEND_STATUS;
-				cmd.arg = card->rca << 16;
-				cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
-				err = mmc_wait_for_cmd(card->host, &cmd, 5);
-				if (err) {
-					printk(KERN_ERR "%s: error %d requesting status\n",
-					       req->rq_disk->disk_name, err);
-					goto cmd_err;
-				}
-				/*
-				 * Some cards mishandle the status bits,
-				 * so make sure to check both the busy
-				 * indication and the card state.
-				 */
-			} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
-				(R1_CURRENT_STATE(cmd.resp[0]) == 7));
-
-#if 0
-			if (cmd.resp[0] & ~0x00000900)
-				printk(KERN_ERR "%s: status = %08x\n",
-				       req->rq_disk->disk_name, cmd.resp[0]);
-			if (mmc_decode_status(cmd.resp))
-				goto cmd_err;
-#endif
+	mmc_queue_bounce_post(mqrq);
+
+	switch (status) {
+	case MMC_BLK_SUCCESS:
+		/*
+		 * A block was successfully transferred.
+		 */
+		mqrq->disable_multi = 0;
+		if (rq_data_dir(req) == WRITE && mmc_card_can_bkops(card)) {
+			md->bkops_check = 1;
+			if (brq->cmd.resp[0] & R1_EXCEPTION_EVENT)
+				md->bkops_urgent = 1;
+			mmc_blk_set_idle(md);
 		}
+		spin_lock_irq(&md->lock);
+		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
+		spin_unlock_irq(&md->lock);
+		break;
+	case MMC_BLK_RETRY_SINGLE:
+		mqrq->disable_multi = 1;
+		ret = 1;
+		break;
+	case MMC_BLK_DATA_ERR:
+		/*
+		 * After an error, we redo I/O one sector at a
+		 * time, so we only reach here after trying to
+		 * read a single sector.
+		 */
+		spin_lock_irq(&md->lock);
+		ret = __blk_end_request(req, -EIO, brq->data.blksz);
+		spin_unlock_irq(&md->lock);
+		break;
+	default:
+		/*
+		 * If this is an SD card and we're writing, we can first
+		 * mark the known good sectors as ok.
+		 *
+		 * If the card is not SD, we can still ok written sectors
+		 * as reported by the controller (which might be less than
+		 * the real number of written sectors, but never more).
+		 */
+		ret = 1;
+		if (mmc_card_sd(card)) {
+			u32 blocks;
 
-		if (brq.cmd.error || brq.stop.error || brq.data.error) {
-			if (rq_data_dir(req) == READ) {
-				/*
-				 * After an error, we redo I/O one sector at a
-				 * time, so we only reach here after trying to
-				 * read a single sector.
-				 */
+			blocks = mmc_sd_num_wr_blocks(card);
+			if (blocks != (u32)-1) {
 				spin_lock_irq(&md->lock);
-				ret = __blk_end_request(req, -EIO, brq.data.blksz);
+				ret = __blk_end_request(req, 0, blocks << 9);
 				spin_unlock_irq(&md->lock);
-				continue;
 			}
-			goto cmd_err;
+		} else {
+			spin_lock_irq(&md->lock);
+			ret = __blk_end_request(req, 0,
+						brq->data.bytes_xfered);
+			spin_unlock_irq(&md->lock);
 		}
 
-		/*
-		 * A block was successfully transferred.
-		 */
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		while (ret)
+			ret = __blk_end_request(req, -EIO,
+						blk_rq_cur_bytes(req));
 		spin_unlock_irq(&md->lock);
-	} while (ret);
+		break;
+	}
 
-	mmc_release_host(card->host);
+	if (ret)
+		mmc_blk_rw_rq_prep(mqrq, card, mq);
+	else
+		mqrq->req = NULL;
 
-	return 1;
+	return ret;
+}
 
- cmd_err:
- 	/*
- 	 * If this is an SD card and we're writing, we can first
- 	 * mark the known good sectors as ok.
- 	 *
-	 * If the card is not SD, we can still ok written sectors
-	 * as reported by the controller (which might be less than
-	 * the real number of written sectors, but never more).
-	 */
-	if (mmc_card_sd(card)) {
-		u32 blocks;
+/*
+ * Start @rqc (if any) and complete the request that was on the bus
+ * before it.  Only the new request is left in flight on return; when
+ * called without one, the host is idle on return.
+ */
+static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_async_req *next = NULL, *done;
+	int status;
+
+	if (rqc) {
+		if (md->nr_discard && rq_data_dir(rqc) == WRITE)
+			mmc_blk_discard_clip(md, blk_rq_pos(rqc),
+					     blk_rq_sectors(rqc));
+		mq->mqrq_cur->disable_multi = 0;
+		mmc_blk_rw_rq_prep(mq->mqrq_cur, card, mq);
+		next = &mq->mqrq_cur->mmc_active;
+	}
 
-		blocks = mmc_sd_num_wr_blocks(card);
-		if (blocks != (u32)-1) {
-			spin_lock_irq(&md->lock);
-			ret = __blk_end_request(req, 0, blocks << 9);
-			spin_unlock_irq(&md->lock);
+	do {
+		done = mmc_start_req(card->host, next, &status);
+		if (!status)
+			next = NULL;
+		if (!done)
+			continue;
+
+		if (mmc_blk_rw_done(mq, container_of(done,
+				struct mmc_queue_req, mmc_active), status)) {
+			/*
+			 * The rest of a request goes out before anything
+			 * else.  If it failed, mmc_start_req() left the
+			 * host idle and @next unstarted.
+			 */
+			if (next)
+				mmc_start_req(card->host, done, NULL);
+			else
+				next = done;
 		}
-	} else {
-		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
-		spin_unlock_irq(&md->lock);
-	}
+	} while (next || (!rqc && card->host->areq));
 
-	mmc_release_host(card->host);
+	return 1;
+}
+
+/* Cache flush, queued by the block layer around barriers */
+static int mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	int err;
+
+	err = mmc_flush_cache(md->queue.card);
 
 	spin_lock_irq(&md->lock);
-	while (ret)
-		ret = __blk_end_request(req, -EIO, blk_rq_cur_bytes(req));
+	__blk_end_request_all(req, err);
 	spin_unlock_irq(&md->lock);
 
-	return 0;
+	return err ? 0 : 1;
 }
 
 static int
@@ -547,24 +839,50 @@ mmc_blk_set_blksize(struct mmc_blk_data *md, struct mmc_card *card);
 
 static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
-#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
+	int ret;
 
-	if (mmc_bus_needs_resume(card->host)) {
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+	/* The bus may have been resumed in the background already */
+	if (mmc_bus_needs_resume(card->host))
 		mmc_resume_bus(card->host);
+	if (md->blksize_pending) {
+		md->blksize_pending = 0;
 		mmc_blk_set_blksize(md, card);
 	}
 #endif
 
-	if (req->cmd_flags & REQ_DISCARD) {
+	/* The host stays claimed while a request is on the bus */
+	if (!card->host->areq) {
+		mmc_claim_host(card->host);
+		/* new I/O preempts idle background operations */
+		if (mmc_card_doing_bkops(card))
+			mmc_stop_bkops(card);
+	}
+
+	if (req && (req->cmd_flags & REQ_DISCARD)) {
+		/* complete the transfer in flight before the discard */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
 		if (req->cmd_flags & REQ_SECURE)
-			return mmc_blk_issue_secdiscard_rq(mq, req);
+			ret = mmc_blk_issue_secdiscard_rq(mq, req);
 		else
-			return mmc_blk_issue_discard_rq(mq, req);
+			ret = mmc_blk_issue_discard_rq(mq, req);
+		mq->mqrq_cur->req = NULL;
+	} else if (req && (req->cmd_flags & REQ_FLUSH)) {
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
+		ret = mmc_blk_issue_flush(mq, req);
+		mq->mqrq_cur->req = NULL;
 	} else {
-		return mmc_blk_issue_rw_rq(mq, req);
+		ret = mmc_blk_issue_rw_rq(mq, req);
 	}
+
+	if (!card->host->areq)
+		mmc_release_host(card->host);
+
+	return ret;
 }
 
 static inline int mmc_blk_readonly(struct mmc_card *card)
@@ -612,6 +930,25 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 	md->queue.issue_fn = mmc_blk_issue_rq;
 	md->queue.data = md;
 
+	/* deferred discards leave the old data readable for a while */
+	if (idle_discard_ms && blk_queue_discard(md->queue.queue)) {
+		md->defer_discard = 1;
+		md->queue.queue->limits.discard_zeroes_data = 0;
+	}
+	if (md->defer_discard || mmc_card_can_bkops(card))
+		md->queue.idle_fn = mmc_blk_idle;
+
+	/*
+	 * eMMC without a write cache completes a write only once it is
+	 * on flash, and reliable write support means the card keeps
+	 * sector updates atomic across power loss.  Barriers on this
+	 * queue are bare drains, let journals know they buy nothing.
+	 */
+	if (mmc_card_mmc(card) && card->ext_csd.rel_sectors &&
+	    !card->ext_csd.cache_ctrl)
+		queue_flag_set_unlocked(QUEUE_FLAG_RELWRITE,
+					md->queue.queue);
+
 	md->disk->major	= MMC_BLOCK_MAJOR;
 	md->disk->first_minor = devidx << MMC_SHIFT;
 	md->disk->fops = &mmc_bdops;
@@ -764,6 +1101,8 @@ static int mmc_blk_resume(struct mmc_card *card)
 	if (md) {
 #ifndef CONFIG_MMC_BLOCK_DEFERRED_RESUME
 		mmc_blk_set_blksize(md, card);
+#else
+		md->blksize_pending = 1;
 #endif
 		mmc_queue_resume(&md->queue);
 	}
@@ -17,6 +17,9 @@
 
 #include <linux/scatterlist.h>
 #include <linux/swap.h>		/* For nr_free_buffer_pages() */
+#include <linux/random.h>
+#include <linux/sort.h>
+#include <linux/kernel_stat.h>
 
 #define RESULT_OK		0
 #define RESULT_FAIL		1
@@ -32,6 +35,13 @@
  */
 #define TEST_AREA_MAX_SIZE (128 * 1024 * 1024)
 
+/*
+ * Limits for the latency tests: at most this many requests, and no more
+ * than this many seconds per transfer size.
+ */
+#define TEST_LAT_MAX_CNT	2000
+#define TEST_LAT_MAX_SECS	10
+
 /**
  * struct mmc_test_pages - pages allocated by 'alloc_pages()'.
  * @page: first page in the allocation
@@ -72,6 +82,20 @@ struct mmc_test_area {
 	struct scatterlist *sg;
 };
 
+/**
+ * struct mmc_test_lat - per-request latencies for performance tests.
+ * @us: latency of each request (in microseconds)
+ * @cnt: number of requests recorded in @us
+ * @ts: time at which the first request was started
+ * @busy: CPU time spent by all CPUs outside idle when @ts was taken
+ */
+struct mmc_test_lat {
+	unsigned int *us;
+	unsigned int cnt;
+	struct timespec ts;
+	cputime64_t busy;
+};
+
 /**
  * struct mmc_test_card - test information.
  * @card: card under test
@@ -1405,6 +1429,274 @@ static int mmc_test_best_performance(struct mmc_test_card *test, int write,
 				write, max_scatter, 1);
 }
 
+/*
+ * CPU time spent outside idle, summed over all CPUs.  This includes the
+ * interrupt and softirq time of the host driver, which is not charged to
+ * the task waiting for the request.
+ */
+static cputime64_t mmc_test_busy_time(void)
+{
+	cputime64_t busy = cputime64_zero;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct cpu_usage_stat *st = &kstat_cpu(cpu).cpustat;
+
+		busy = cputime64_add(busy, st->user);
+		busy = cputime64_add(busy, st->nice);
+		busy = cputime64_add(busy, st->system);
+		busy = cputime64_add(busy, st->irq);
+		busy = cputime64_add(busy, st->softirq);
+	}
+
+	return busy;
+}
+
+static int mmc_test_lat_init(struct mmc_test_lat *lat)
+{
+	lat->us = kmalloc(TEST_LAT_MAX_CNT * sizeof(*lat->us), GFP_KERNEL);
+	if (!lat->us)
+		return -ENOMEM;
+	lat->cnt = 0;
+	lat->busy = mmc_test_busy_time();
+	getnstimeofday(&lat->ts);
+
+	return 0;
+}
+
+static void mmc_test_lat_free(struct mmc_test_lat *lat)
+{
+	kfree(lat->us);
+}
+
+/*
+ * Record one request.  Returns non-zero once enough requests have been
+ * recorded or the time limit has passed.
+ */
+static int mmc_test_lat_add(struct mmc_test_lat *lat, struct timespec *ts1,
+			    struct timespec *ts2)
+{
+	struct timespec ts = timespec_sub(*ts2, *ts1);
+
+	lat->us[lat->cnt++] = ts.tv_sec * USEC_PER_SEC +
+			      ts.tv_nsec / NSEC_PER_USEC;
+
+	return lat->cnt >= TEST_LAT_MAX_CNT ||
+	       ts2->tv_sec - lat->ts.tv_sec >= TEST_LAT_MAX_SECS;
+}
+
+static int mmc_test_cmp_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a;
+	unsigned int y = *(const unsigned int *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Print the rate, request rate, latency percentiles and the CPU time
+ * used for lat->cnt requests of sz bytes each.
+ */
+static void mmc_test_lat_print(struct mmc_test_card *test,
+			       struct mmc_test_lat *lat, unsigned long sz)
+{
+	unsigned int rate, iops, cpu_us, cpu_pct, i;
+	uint64_t busy_us, wall_us;
+	struct timespec ts, now;
+
+	getnstimeofday(&now);
+	busy_us = jiffies_to_usecs((unsigned long)cputime64_to_jiffies64(
+			cputime64_sub(mmc_test_busy_time(), lat->busy)));
+	ts = timespec_sub(now, lat->ts);
+	wall_us = timespec_to_ns(&ts);
+	do_div(wall_us, NSEC_PER_USEC);
+
+	if (!lat->cnt || !wall_us)
+		return;
+
+	rate = mmc_test_rate((uint64_t)sz * lat->cnt, &ts);
+	iops = mmc_test_rate(lat->cnt, &ts);
+	cpu_us = busy_us;
+	busy_us *= 100;
+	do_div(busy_us, (uint32_t)wall_us);
+	cpu_pct = busy_us;
+
+	sort(lat->us, lat->cnt, sizeof(*lat->us), mmc_test_cmp_uint, NULL);
+	i = lat->cnt - 1;
+
+	printk(KERN_INFO "%s: %u x %lu KiB: %u kB/s, %u IOPS, latency (us) "
+			 "p50 %u p90 %u p99 %u max %u, cpu %u us (%u%%)\n",
+			 mmc_hostname(test->card->host), lat->cnt, sz >> 10,
+			 rate / 1000, iops, lat->us[i * 50 / 100],
+			 lat->us[i * 90 / 100], lat->us[i * 99 / 100],
+			 lat->us[i], cpu_us, cpu_pct);
+}
+
+/*
+ * Time sz byte requests at random sz aligned offsets in the test area.
+ */
+static int mmc_test_random_perf(struct mmc_test_card *test, int write,
+				unsigned long sz)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_test_lat lat;
+	struct timespec ts1, ts2;
+	unsigned int dev_addr, cnt;
+	int ret;
+
+	ret = mmc_test_area_map(test, sz, 0);
+	if (ret)
+		return ret;
+
+	ret = mmc_test_lat_init(&lat);
+	if (ret)
+		return ret;
+
+	cnt = t->max_sz / sz;
+	do {
+		dev_addr = t->dev_addr + (random32() % cnt) * (sz >> 9);
+		getnstimeofday(&ts1);
+		ret = mmc_test_area_transfer(test, dev_addr, write);
+		if (ret)
+			break;
+		getnstimeofday(&ts2);
+	} while (!mmc_test_lat_add(&lat, &ts1, &ts2));
+
+	if (!ret)
+		mmc_test_lat_print(test, &lat, sz);
+	mmc_test_lat_free(&lat);
+
+	return ret;
+}
+
+/*
+ * Random read performance, 4KiB requests.
+ */
+static int mmc_test_random_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_random_perf(test, 0, 4096);
+}
+
+/*
+ * Random write performance, 4KiB requests.
+ */
+static int mmc_test_random_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_random_perf(test, 1, 4096);
+}
+
+/*
+ * Sequential transfers of the whole test area with one segment per page,
+ * to measure how the host copes with long scatterlists.
+ */
+static int mmc_test_large_seq_perf(struct mmc_test_card *test, int write)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_test_lat lat;
+	struct timespec ts1, ts2;
+	int ret;
+
+	ret = mmc_test_area_map(test, t->max_sz, 1);
+	if (ret)
+		return ret;
+
+	ret = mmc_test_lat_init(&lat);
+	if (ret)
+		return ret;
+
+	do {
+		getnstimeofday(&ts1);
+		ret = mmc_test_area_transfer(test, t->dev_addr, write);
+		if (ret)
+			break;
+		getnstimeofday(&ts2);
+	} while (!mmc_test_lat_add(&lat, &ts1, &ts2));
+
+	if (!ret) {
+		printk(KERN_INFO "%s: %u segments per request\n",
+		       mmc_hostname(test->card->host), t->sg_len);
+		mmc_test_lat_print(test, &lat, t->max_sz);
+	}
+	mmc_test_lat_free(&lat);
+
+	return ret;
+}
+
+/*
+ * Large sequential read performance into scattered pages.
+ */
+static int mmc_test_large_seq_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_large_seq_perf(test, 0);
+}
+
+/*
+ * Large sequential write performance from scattered pages.
+ */
+static int mmc_test_large_seq_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_large_seq_perf(test, 1);
+}
+
+/*
+ * Sequential performance by transfer size, with latency percentiles.
+ */
+static int mmc_test_seq_lat_perf(struct mmc_test_card *test, int write)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_test_lat lat;
+	struct timespec ts1, ts2;
+	unsigned int dev_addr;
+	unsigned long sz;
+	int ret;
+
+	for (sz = 4096; sz <= t->max_sz; sz <<= 1) {
+		ret = mmc_test_area_map(test, sz, 0);
+		if (ret)
+			return ret;
+
+		ret = mmc_test_lat_init(&lat);
+		if (ret)
+			return ret;
+
+		dev_addr = t->dev_addr;
+		do {
+			getnstimeofday(&ts1);
+			ret = mmc_test_area_transfer(test, dev_addr, write);
+			if (ret)
+				break;
+			getnstimeofday(&ts2);
+			dev_addr += sz >> 9;
+			if (dev_addr + (sz >> 9) > t->dev_addr + (t->max_sz >> 9))
+				dev_addr = t->dev_addr;
+		} while (!mmc_test_lat_add(&lat, &ts1, &ts2));
+
+		if (!ret)
+			mmc_test_lat_print(test, &lat, sz);
+		mmc_test_lat_free(&lat);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Sequential read latency by transfer size.
+ */
+static int mmc_test_seq_read_lat_perf(struct mmc_test_card *test)
+{
+	return mmc_test_seq_lat_perf(test, 0);
+}
+
+/*
+ * Sequential write latency by transfer size.
+ */
+static int mmc_test_seq_write_lat_perf(struct mmc_test_card *test)
+{
+	return mmc_test_seq_lat_perf(test, 1);
+}
+
 /*
  * Best-case read performance.
  */
@@ -1849,6 +2141,48 @@ static const struct mmc_test_case mmc_test_cases[] = {
 		.cleanup = mmc_test_area_cleanup,
 	},
 
+	{
+		.name = "Random read performance (4KiB requests)",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_random_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random write performance (4KiB requests)",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_random_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Large sequential read into scattered pages",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_large_seq_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Large sequential write from scattered pages",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_large_seq_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential read latency by transfer size",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_seq_read_lat_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential write latency by transfer size",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_seq_write_lat_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
@@ -21,6 +21,7 @@
 #include <linux/leds.h>
 #include <linux/scatterlist.h>
 #include <linux/log2.h>
+#include <linux/slab.h>
 #include <linux/regulator/consumer.h>
 #include <linux/wakelock.h>
 
@@ -200,6 +201,74 @@ static void mmc_wait_done(struct mmc_request *mrq)
 	complete(mrq->done_data);
 }
 
+static void mmc_pre_req(struct mmc_host *host, struct mmc_request *mrq,
+	bool is_first_req)
+{
+	if (host->ops->pre_req)
+		host->ops->pre_req(host, mrq, is_first_req);
+}
+
+static void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq,
+	int err)
+{
+	if (host->ops->post_req)
+		host->ops->post_req(host, mrq, err);
+}
+
+/**
+ *	mmc_start_req - start a request without waiting for it
+ *	@host: MMC host to start the request on
+ *	@areq: request to start, or NULL to only finish the current one
+ *	@error: where to store the err_check result of the finished request
+ *
+ *	The buffers of @areq are prepared while the request already on the
+ *	bus, if any, is completing.  Once that request is done and passes
+ *	its err_check, @areq is started and the finished request is
+ *	returned.  If the err_check fails @areq is not started and the
+ *	host is left idle, so that the caller can recover first.
+ *
+ *	Returns the request that finished, or NULL if none was active.
+ */
+struct mmc_async_req *mmc_start_req(struct mmc_host *host,
+	struct mmc_async_req *areq, int *error)
+{
+	struct mmc_async_req *done = host->areq;
+	int err = 0;
+
+	if (areq)
+		mmc_pre_req(host, areq->mrq, !host->areq);
+
+	if (host->areq) {
+		wait_for_completion(&host->areq->complete);
+		err = host->areq->err_check(host->card, host->areq);
+		if (err) {
+			mmc_post_req(host, host->areq->mrq, 0);
+			if (areq)
+				mmc_post_req(host, areq->mrq, -EINVAL);
+			host->areq = NULL;
+			goto out;
+		}
+	}
+
+	if (areq) {
+		init_completion(&areq->complete);
+		areq->mrq->done_data = &areq->complete;
+		areq->mrq->done = mmc_wait_done;
+		mmc_start_request(host, areq->mrq);
+	}
+
+	/* unmap the finished request while the next one is on the bus */
+	if (host->areq)
+		mmc_post_req(host, host->areq->mrq, 0);
+
+	host->areq = areq;
+ out:
+	if (error)
+		*error = err;
+	return done;
+}
+EXPORT_SYMBOL(mmc_start_req);
+
 /**
  *	mmc_wait_for_req - start a request and wait for completion
  *	@host: MMC host to start command
@@ -215,6 +284,9 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 
 	mrq->done_data = &complete;
 	mrq->done = mmc_wait_done;
+	/* nothing has been prepared by pre_req */
+	if (mrq->data)
+		mrq->data->host_cookie = 0;
 
 	mmc_start_request(host, mrq);
 
@@ -985,20 +1057,35 @@ int mmc_resume_bus(struct mmc_host *host)
 	if (!mmc_bus_needs_resume(host))
 		return -EINVAL;
 
-	printk("%s: Starting deferred resume\n", mmc_hostname(host));
+	/*
+	 * The background resume and the first request can both get here,
+	 * holding the host makes the second one wait for the first.
+	 */
+	mmc_claim_host(host);
 	spin_lock_irqsave(&host->lock, flags);
+	if (!mmc_bus_needs_resume(host)) {
+		spin_unlock_irqrestore(&host->lock, flags);
+		mmc_release_host(host);
+		return 0;
+	}
+	printk("%s: Starting deferred resume\n", mmc_hostname(host));
 	host->bus_resume_flags &= ~MMC_BUSRESUME_NEEDS_RESUME;
 	host->rescan_disable = 0;
 	spin_unlock_irqrestore(&host->lock, flags);
 
 	mmc_bus_get(host);
 	if (host->bus_ops && !host->bus_dead) {
-		mmc_power_up(host);
+		if (!(host->pm_flags & MMC_PM_KEEP_POWER)) {
+			mmc_power_up(host);
+			mmc_select_voltage(host, host->ocr);
+		}
 		BUG_ON(!host->bus_ops->resume);
 		host->bus_ops->resume(host);
 	}
+	mmc_release_host(host);
 
-	if (host->bus_ops->detect && !host->bus_dead)
+	/* detect may remove the card, which waits for the block queue */
+	if (host->bus_ops && host->bus_ops->detect && !host->bus_dead)
 		host->bus_ops->detect(host);
 
 	mmc_bus_put(host);
@@ -1008,6 +1095,20 @@ int mmc_resume_bus(struct mmc_host *host)
 
 EXPORT_SYMBOL(mmc_resume_bus);
 
+/*
+ * Hosts with a manual resume policy are brought back from kmmcd right
+ * after system resume, off the device resume path, unless a request
+ * gets there first.
+ */
+void mmc_deferred_resume(struct work_struct *work)
+{
+	struct mmc_host *host =
+		container_of(work, struct mmc_host, deferred_resume.work);
+
+	mmc_resume_bus(host);
+	wake_lock_timeout(&mmc_delayed_work_wake_lock, HZ / 2);
+}
+
 /*
  * Assign a mmc bus handler to a host. Only one bus handler may control a
  * host at any given time.
@@ -1130,9 +1231,8 @@ void mmc_init_erase(struct mmc_card *card)
 	}
 }
 
-static void mmc_set_mmc_erase_timeout(struct mmc_card *card,
-				      struct mmc_command *cmd,
-				      unsigned int arg, unsigned int qty)
+static unsigned int mmc_mmc_erase_timeout(struct mmc_card *card,
+					  unsigned int arg, unsigned int qty)
 {
 	unsigned int erase_timeout;
 
@@ -1189,38 +1289,40 @@ static void mmc_set_mmc_erase_timeout(struct mmc_card *card,
 	if (mmc_host_is_spi(card->host) && erase_timeout < 1000)
 		erase_timeout = 1000;
 
-	cmd->erase_timeout = erase_timeout;
+	return erase_timeout;
 }
 
-static void mmc_set_sd_erase_timeout(struct mmc_card *card,
-				     struct mmc_command *cmd, unsigned int arg,
-				     unsigned int qty)
+static unsigned int mmc_sd_erase_timeout(struct mmc_card *card,
+					 unsigned int arg, unsigned int qty)
 {
+	unsigned int erase_timeout;
+
 	if (card->ssr.erase_timeout) {
 		/* Erase timeout specified in SD Status Register (SSR) */
-		cmd->erase_timeout = card->ssr.erase_timeout * qty +
-				     card->ssr.erase_offset;
+		erase_timeout = card->ssr.erase_timeout * qty +
+				card->ssr.erase_offset;
 	} else {
 		/*
 		 * Erase timeout not specified in SD Status Register (SSR) so
 		 * use 250ms per write block.
 		 */
-		cmd->erase_timeout = 250 * qty;
+		erase_timeout = 250 * qty;
 	}
 
 	/* Must not be less than 1 second */
-	if (cmd->erase_timeout < 1000)
-		cmd->erase_timeout = 1000;
+	if (erase_timeout < 1000)
+		erase_timeout = 1000;
+
+	return erase_timeout;
 }
 
-static void mmc_set_erase_timeout(struct mmc_card *card,
-				  struct mmc_command *cmd, unsigned int arg,
-				  unsigned int qty)
+static unsigned int mmc_erase_timeout(struct mmc_card *card,
+				      unsigned int arg, unsigned int qty)
 {
 	if (mmc_card_sd(card))
-		mmc_set_sd_erase_timeout(card, cmd, arg, qty);
+		return mmc_sd_erase_timeout(card, arg, qty);
 	else
-		mmc_set_mmc_erase_timeout(card, cmd, arg, qty);
+		return mmc_mmc_erase_timeout(card, arg, qty);
 }
 
 static int mmc_do_erase(struct mmc_card *card, unsigned int from,
@@ -1294,7 +1396,7 @@ static int mmc_do_erase(struct mmc_card *card, unsigned int from,
 	cmd.opcode = MMC_ERASE;
 	cmd.arg = arg;
 	cmd.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-	mmc_set_erase_timeout(card, &cmd, arg, qty);
+	cmd.erase_timeout = mmc_erase_timeout(card, arg, qty);
 	err = mmc_wait_for_cmd(card->host, &cmd, 0);
 	if (err) {
 		printk(KERN_ERR "mmc_erase: erase error %d, status %#x\n",
@@ -1428,6 +1530,233 @@ int mmc_erase_group_aligned(struct mmc_card *card, unsigned int from,
 }
 EXPORT_SYMBOL(mmc_erase_group_aligned);
 
+static int mmc_read_bkops_status(struct mmc_card *card, u8 *level)
+{
+	u8 *ext_csd;
+	int err;
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return -ENOMEM;
+
+	err = mmc_send_ext_csd(card, ext_csd);
+	if (!err)
+		*level = ext_csd[EXT_CSD_BKOPS_STATUS] & 0x3;
+
+	kfree(ext_csd);
+	return err;
+}
+
+/**
+ *	mmc_start_bkops - start background operations if the card needs them
+ *	@card: MMC card
+ *	@min_level: lowest EXT_CSD_BKOPS_LEVEL_* worth starting for
+ *
+ *	The card is left busy, mmc_stop_bkops() must be called before it is
+ *	sent anything else.  The host must be claimed.
+ */
+int mmc_start_bkops(struct mmc_card *card, unsigned int min_level)
+{
+	u8 level;
+	int err;
+
+	if (!mmc_card_can_bkops(card) || mmc_card_doing_bkops(card))
+		return 0;
+
+	err = mmc_read_bkops_status(card, &level);
+	if (err || level < min_level || !level)
+		return err;
+
+	err = __mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			   EXT_CSD_BKOPS_START, 1, false);
+	if (err) {
+		pr_debug("%s: starting BKOPS failed: %d\n",
+			 mmc_hostname(card->host), err);
+		return err;
+	}
+
+	mmc_card_set_doing_bkops(card);
+	return 0;
+}
+EXPORT_SYMBOL(mmc_start_bkops);
+
+static int mmc_send_hpi_cmd(struct mmc_card *card)
+{
+	struct mmc_command cmd;
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = card->ext_csd.hpi_cmd;
+	cmd.arg = card->rca << 16 | 1;
+	if (cmd.opcode == MMC_STOP_TRANSMISSION)
+		cmd.flags = MMC_RSP_R1B | MMC_CMD_AC;
+	else
+		cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	return mmc_wait_for_cmd(card->host, &cmd, 0);
+}
+
+/**
+ *	mmc_stop_bkops - interrupt background operations
+ *	@card: MMC card
+ *
+ *	Sends a high priority interrupt if the card is still busy with the
+ *	background operations started by mmc_start_bkops(), and waits for
+ *	it to return to the transfer state.  The host must be claimed.
+ */
+int mmc_stop_bkops(struct mmc_card *card)
+{
+	unsigned long timeout;
+	u32 status;
+	int err;
+
+	if (!mmc_card_doing_bkops(card))
+		return 0;
+
+	err = mmc_send_status(card, &status);
+	if (err)
+		goto out;
+
+	/* nothing to interrupt unless it is still programming */
+	if (R1_CURRENT_STATE(status) != 7)
+		goto out;
+
+	err = mmc_send_hpi_cmd(card);
+	if (err)
+		goto out;
+
+	timeout = jiffies +
+		msecs_to_jiffies(card->ext_csd.out_of_int_time ?: 100) + 1;
+	do {
+		err = mmc_send_status(card, &status);
+		if (err)
+			break;
+		if (R1_CURRENT_STATE(status) == 4)	/* tran */
+			break;
+		if (time_after(jiffies, timeout)) {
+			err = -ETIMEDOUT;
+			break;
+		}
+	} while (1);
+
+out:
+	if (err)
+		printk(KERN_WARNING "%s: interrupting BKOPS failed: %d\n",
+		       mmc_hostname(card->host), err);
+	mmc_card_clr_doing_bkops(card);
+	return err;
+}
+EXPORT_SYMBOL(mmc_stop_bkops);
+
+/**
+ *	mmc_flush_cache - write back the eMMC volatile cache
+ *	@card: MMC card
+ *
+ *	The host must be claimed.
+ */
+int mmc_flush_cache(struct mmc_card *card)
+{
+	int err;
+
+	if (!mmc_card_mmc(card) || !card->ext_csd.cache_ctrl)
+		return 0;
+
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			 EXT_CSD_FLUSH_CACHE, 1);
+	if (err)
+		printk(KERN_ERR "%s: cache flush error %d\n",
+		       mmc_hostname(card->host), err);
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_flush_cache);
+
+static unsigned int mmc_do_calc_max_discard(struct mmc_card *card,
+					    unsigned int arg)
+{
+	struct mmc_host *host = card->host;
+	unsigned int max_discard, x, y, qty = 0, max_qty, timeout;
+	unsigned int last_timeout = 0;
+
+	if (card->erase_shift)
+		max_qty = UINT_MAX >> card->erase_shift;
+	else if (mmc_card_sd(card))
+		max_qty = UINT_MAX;
+	else
+		max_qty = UINT_MAX / card->erase_size;
+
+	/* Find the largest qty with an OK timeout */
+	do {
+		y = 0;
+		for (x = 1; x && x <= max_qty && max_qty - x >= qty; x <<= 1) {
+			timeout = mmc_erase_timeout(card, arg, qty + x);
+			if (timeout > host->max_discard_to)
+				break;
+			if (timeout < last_timeout)
+				break;
+			last_timeout = timeout;
+			y = x;
+		}
+		qty += y;
+	} while (y);
+
+	if (!qty)
+		return 0;
+
+	if (qty == 1)
+		return 1;
+
+	/*
+	 * Convert qty to sectors.  A discard not aligned to the erase
+	 * groups touches one group more than its size suggests.
+	 */
+	if (card->erase_shift)
+		max_discard = --qty << card->erase_shift;
+	else if (mmc_card_sd(card))
+		max_discard = qty;
+	else
+		max_discard = --qty * card->erase_size;
+
+	return max_discard;
+}
+
+/**
+ * mmc_calc_max_discard - largest discard the host can wait for
+ * @card: card to discard on
+ *
+ * Returns the number of sectors that can be erased or trimmed in one go
+ * without the busy time exceeding the host's max_discard_to, UINT_MAX if
+ * the host has no such limit, or 0 if not even one erase group fits.
+ */
+unsigned int mmc_calc_max_discard(struct mmc_card *card)
+{
+	struct mmc_host *host = card->host;
+	unsigned int max_discard, max_trim;
+
+	if (!host->max_discard_to)
+		return UINT_MAX;
+
+	/*
+	 * Without erase_group_def set, MMC erase timeout depends on clock
+	 * frequency which can change.  In that case, the best choice is
+	 * just the preferred erase size.
+	 */
+	if (mmc_card_mmc(card) && !(card->ext_csd.erase_group_def & 1))
+		return card->pref_erase;
+
+	max_discard = mmc_do_calc_max_discard(card, MMC_ERASE_ARG);
+	if (mmc_can_trim(card)) {
+		max_trim = mmc_do_calc_max_discard(card, MMC_TRIM_ARG);
+		if (max_trim < max_discard)
+			max_discard = max_trim;
+	} else if (max_discard < card->erase_size) {
+		max_discard = 0;
+	}
+	pr_debug("%s: calculated max. discard sectors %u for timeout %u ms\n",
+		 mmc_hostname(host), max_discard, host->max_discard_to);
+	return max_discard;
+}
+EXPORT_SYMBOL(mmc_calc_max_discard);
+
 void mmc_rescan(struct work_struct *work)
 {
 	struct mmc_host *host =
@@ -1561,6 +1890,7 @@ void mmc_stop_host(struct mmc_host *host)
 	if (host->caps & MMC_CAP_DISABLE)
 		cancel_delayed_work(&host->disable);
 	cancel_delayed_work_sync(&host->detect);
+	cancel_delayed_work_sync(&host->deferred_resume);
 	mmc_flush_scheduled_work();
 
 	/* clear pm flags now and let card drivers set them as needed */
@@ -1668,6 +1998,8 @@ int mmc_suspend_host(struct mmc_host *host)
 {
 	int err = 0;
 
+	/* Either finish a background resume or leave the card down */
+	cancel_delayed_work_sync(&host->deferred_resume);
 	if (mmc_bus_needs_resume(host))
 		return 0;
 
@@ -1716,6 +2048,7 @@ int mmc_resume_host(struct mmc_host *host)
 	if (mmc_bus_manual_resume(host)) {
 		host->bus_resume_flags |= MMC_BUSRESUME_NEEDS_RESUME;
 		mmc_bus_put(host);
+		mmc_schedule_delayed_work(&host->deferred_resume, 0);
 		return 0;
 	}
 
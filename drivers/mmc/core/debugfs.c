@@ -134,6 +134,38 @@ static const struct file_operations mmc_ios_fops = {
 	.release	= single_release,
 };
 
+static int mmc_sdio_irq_show(struct seq_file *s, void *data)
+{
+	struct mmc_host *host = s->private;
+	u64 avg = 0;
+
+	if (host->sdio_irq_count) {
+		avg = host->sdio_irq_lat_total;
+		do_div(avg, host->sdio_irq_count);
+	}
+
+	seq_printf(s, "mode:\t\t%s\n",
+		   (host->caps & MMC_CAP_SDIO_IRQ_NOTHREAD) ? "irq thread" :
+		   (host->caps & MMC_CAP_SDIO_IRQ) ? "ksdioirqd" : "polled");
+	seq_printf(s, "irqs:\t\t%lu\n", host->sdio_irq_count);
+	seq_printf(s, "latency avg:\t%llu us\n", (unsigned long long)avg);
+	seq_printf(s, "latency max:\t%u us\n", host->sdio_irq_lat_max);
+
+	return 0;
+}
+
+static int mmc_sdio_irq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_sdio_irq_show, inode->i_private);
+}
+
+static const struct file_operations mmc_sdio_irq_fops = {
+	.open		= mmc_sdio_irq_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_host_debugfs(struct mmc_host *host)
 {
 	struct dentry *root;
@@ -152,6 +184,10 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 	if (!debugfs_create_file("ios", S_IRUSR, root, host, &mmc_ios_fops))
 		goto err_ios;
 
+	if (!debugfs_create_file("sdio_irq", S_IRUSR, root, host,
+				 &mmc_sdio_irq_fops))
+		goto err_ios;
+
 	return;
 
 err_ios:
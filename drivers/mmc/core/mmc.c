@@ -238,7 +238,7 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 	}
 
 	card->ext_csd.rev = ext_csd[EXT_CSD_REV];
-	if (card->ext_csd.rev > 5) {
+	if (card->ext_csd.rev > 6) {
 		printk(KERN_ERR "%s: unrecognised EXT_CSD revision %d\n",
 			mmc_hostname(card->host), card->ext_csd.rev);
 		err = -EINVAL;
@@ -289,6 +289,7 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 			ext_csd[EXT_CSD_ERASE_TIMEOUT_MULT];
 		card->ext_csd.hc_erase_size =
 			ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] << 10;
+		card->ext_csd.rel_sectors = ext_csd[EXT_CSD_REL_WR_SEC_C];
 	}
 
 	if (card->ext_csd.rev >= 4) {
@@ -302,6 +303,31 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 			ext_csd[EXT_CSD_TRIM_MULT];
 	}
 
+	/* eMMC 4.41: background operations and high priority interrupt */
+	if (card->ext_csd.rev >= 5) {
+		card->ext_csd.bkops_en = (ext_csd[EXT_CSD_BKOPS_SUPPORT] & 1) &&
+			(ext_csd[EXT_CSD_BKOPS_EN] & 1);
+		card->ext_csd.hpi = ext_csd[EXT_CSD_HPI_FEATURES] &
+			EXT_CSD_HPI_SUPPORT;
+		card->ext_csd.hpi_cmd = (ext_csd[EXT_CSD_HPI_FEATURES] &
+			EXT_CSD_HPI_IMPL_CMD12) ?
+			MMC_STOP_TRANSMISSION : MMC_SEND_STATUS;
+		card->ext_csd.out_of_int_time = 10 *
+			ext_csd[EXT_CSD_OUT_OF_INTERRUPT_TIME];
+		if ((ext_csd[EXT_CSD_BKOPS_SUPPORT] & 1) &&
+		    !card->ext_csd.bkops_en)
+			printk(KERN_INFO "%s: BKOPS supported but not enabled\n",
+			       mmc_hostname(card->host));
+	}
+
+	/* eMMC 4.5: volatile cache */
+	if (card->ext_csd.rev >= 6)
+		card->ext_csd.cache_size =
+			ext_csd[EXT_CSD_CACHE_SIZE + 0] << 0 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 1] << 8 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 2] << 16 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 3] << 24;
+
 	if (ext_csd[EXT_CSD_ERASED_MEM_CONT])
 		card->erased_byte = 0xFF;
 	else
@@ -326,6 +352,9 @@ MMC_DEV_ATTR(manfid, "0x%06x\n", card->cid.manfid);
 MMC_DEV_ATTR(name, "%s\n", card->cid.prod_name);
 MMC_DEV_ATTR(oemid, "0x%04x\n", card->cid.oemid);
 MMC_DEV_ATTR(serial, "0x%08x\n", card->cid.serial);
+MMC_DEV_ATTR(cache_size, "%u\n", card->ext_csd.cache_ctrl ?
+	card->ext_csd.cache_size : 0);
+MMC_DEV_ATTR(bkops, "%d\n", mmc_card_can_bkops(card));
 
 static struct attribute *mmc_std_attrs[] = {
 	&dev_attr_cid.attr,
@@ -339,6 +368,8 @@ static struct attribute *mmc_std_attrs[] = {
 	&dev_attr_name.attr,
 	&dev_attr_oemid.attr,
 	&dev_attr_serial.attr,
+	&dev_attr_cache_size.attr,
+	&dev_attr_bkops.attr,
 	NULL,
 };
 
@@ -473,6 +504,28 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		mmc_set_erase_size(card);
 	}
 
+	/*
+	 * Switch to the high-capacity erase group size, which also selects
+	 * the HC erase and trim timeouts.  The setting does not survive a
+	 * power cycle, so it is redone on resume.
+	 */
+	if (card->ext_csd.rev >= 3 && card->ext_csd.hc_erase_size &&
+	    (host->caps & MMC_CAP_HC_ERASE_SZ)) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_ERASE_GROUP_DEF, 1);
+		if (err && err != -EBADMSG)
+			goto free_card;
+
+		if (err) {
+			printk(KERN_WARNING "%s: switch to HC erase groups "
+			       "failed\n", mmc_hostname(card->host));
+			err = 0;
+		} else if (!oldcard) {
+			card->ext_csd.erase_group_def = 1;
+			mmc_set_erase_size(card);
+		}
+	}
+
 	/*
 	 * Activate high speed (if supported)
 	 */
@@ -538,6 +591,34 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		}
 	}
 
+	/*
+	 * Enable HPI, needed to interrupt background operations, and the
+	 * volatile cache.  Neither survives a power cycle.
+	 */
+	mmc_card_clr_doing_bkops(card);
+	if (card->ext_csd.hpi) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_HPI_MGMT, 1);
+		if (err && err != -EBADMSG)
+			goto free_card;
+		card->ext_csd.hpi_en = !err;
+		err = 0;
+	}
+
+	if (card->ext_csd.cache_size) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_CACHE_CTRL, 1);
+		if (err && err != -EBADMSG)
+			goto free_card;
+
+		card->ext_csd.cache_ctrl = !err;
+		if (err) {
+			printk(KERN_WARNING "%s: enabling the cache failed\n",
+			       mmc_hostname(card->host));
+			err = 0;
+		}
+	}
+
 	if (!oldcard)
 		host->card = card;
 
@@ -600,6 +681,8 @@ static int mmc_suspend(struct mmc_host *host)
 	BUG_ON(!host->card);
 
 	mmc_claim_host(host);
+	mmc_stop_bkops(host->card);
+	mmc_flush_cache(host->card);
 	if (!mmc_host_is_spi(host))
 		mmc_deselect_cards(host);
 	host->card->state &= ~MMC_STATE_HIGHSPEED;
@@ -387,7 +387,12 @@ int mmc_spi_set_crc(struct mmc_host *host, int use_crc)
 	return err;
 }
 
-int mmc_switch(struct mmc_card *card, u8 set, u8 index, u8 value)
+/*
+ * Without @wait_busy the switch is sent with a plain R1 response and
+ * the card is left busy; used to start background operations.
+ */
+int __mmc_switch(struct mmc_card *card, u8 set, u8 index, u8 value,
+		 bool wait_busy)
 {
 	int err;
 	struct mmc_command cmd;
@@ -403,12 +408,18 @@ int mmc_switch(struct mmc_card *card, u8 set, u8 index, u8 value)
 		  (index << 16) |
 		  (value << 8) |
 		  set;
-	cmd.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	if (wait_busy)
+		cmd.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	else
+		cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_AC;
 
 	err = mmc_wait_for_cmd(card->host, &cmd, MMC_CMD_RETRIES);
 	if (err)
 		return err;
 
+	if (!wait_busy)
+		return 0;
+
 	/* Must check status to be sure of no errors */
 	do {
 		err = mmc_send_status(card, &status);
@@ -434,6 +445,11 @@ int mmc_switch(struct mmc_card *card, u8 set, u8 index, u8 value)
 	return 0;
 }
 
+int mmc_switch(struct mmc_card *card, u8 set, u8 index, u8 value)
+{
+	return __mmc_switch(card, set, index, value, true);
+}
+
 int mmc_send_status(struct mmc_card *card, u32 *status)
 {
 	int err;
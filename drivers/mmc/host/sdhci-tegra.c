@@ -24,6 +24,9 @@
 #include <linux/gpio.h>
 #include <linux/delay.h>
 #include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 #include <linux/mmc/card.h>
 
 #include <mach/sdhci.h>
@@ -34,13 +37,23 @@
 
 #define SDHCI_VENDOR_CLOCK_CNTRL       0x100
 
+/* idle time after the last request before the controller clock is gated */
+#define TEGRA_SDHCI_CLK_GATE_DELAY	10	/* ms */
+
 struct tegra_sdhci_host {
 	struct sdhci_host *sdhci;
 	struct clk *clk;
 	int clk_enabled;
+	bool clk_gated;		/* gated while idle, card clock programmed */
 	bool card_always_on;
 	u32 sdhci_ints;
 	int wp_gpio;
+
+	unsigned int gate_count;
+	unsigned int ungate_count;
+	unsigned int gate_skipped;	/* SDIO interrupt armed or pending */
+	u64 ungate_ns;
+	u32 ungate_max_ns;
 };
 
 static irqreturn_t carddetect_irq(int irq, void *data)
@@ -83,9 +96,117 @@ static void tegra_sdhci_set_clock(struct sdhci_host *sdhci, unsigned int clock)
 	pr_debug("tegra sdhci clock %s %u enabled=%d\n",
 		mmc_hostname(sdhci->mmc), clock, host->clk_enabled);
 
+	host->clk_gated = false;
 	tegra_sdhci_enable_clock(host, clock);
 }
 
+/*
+ * Runtime gating only stops the controller clock; the card clock setup in
+ * SDHCI_CLOCK_CONTROL is kept, so ungating does not go through
+ * sdhci_set_clock() and only waits for the internal clock to settle.
+ */
+static void tegra_sdhci_clk_ungate(struct tegra_sdhci_host *host)
+{
+	unsigned int timeout = 1000;
+	ktime_t start;
+	u32 ns;
+
+	if (!host->clk_gated)
+		return;
+
+	start = ktime_get();
+	tegra_sdhci_enable_clock(host, 1);
+	host->clk_gated = false;
+
+	while (!(sdhci_readw(host->sdhci, SDHCI_CLOCK_CONTROL) &
+		 SDHCI_CLOCK_INT_STABLE)) {
+		if (!--timeout) {
+			pr_err("%s: internal clock not stable after ungate\n",
+				mmc_hostname(host->sdhci->mmc));
+			break;
+		}
+		udelay(1);
+	}
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	host->ungate_count++;
+	host->ungate_ns += ns;
+	if (ns > host->ungate_max_ns)
+		host->ungate_max_ns = ns;
+}
+
+static int tegra_sdhci_enable(struct sdhci_host *sdhci)
+{
+	tegra_sdhci_clk_ungate(sdhci_priv(sdhci));
+	return 0;
+}
+
+static int tegra_sdhci_disable(struct sdhci_host *sdhci, int lazy)
+{
+	struct tegra_sdhci_host *host = sdhci_priv(sdhci);
+	struct mmc_host *mmc = sdhci->mmc;
+
+	if (!host->clk_enabled || host->clk_gated || !mmc->ios.clock)
+		return 0;
+
+	/*
+	 * A gated controller cannot see the card interrupt on DAT1, so an
+	 * SDIO function with its interrupt claimed keeps the clock running.
+	 */
+	if (mmc->sdio_irqs || (sdhci_readl(sdhci, SDHCI_INT_STATUS) &
+			       SDHCI_INT_CARD_INT)) {
+		host->gate_skipped++;
+		return 0;
+	}
+
+	tegra_sdhci_enable_clock(host, 0);
+	host->clk_gated = true;
+	host->gate_count++;
+	return 0;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int tegra_sdhci_clk_gate_show(struct seq_file *s, void *data)
+{
+	struct tegra_sdhci_host *host = s->private;
+
+	seq_printf(s, "state:        %s\n", host->clk_gated ? "gated" :
+		   host->clk_enabled ? "running" : "off");
+	seq_printf(s, "gated:        %u\n", host->gate_count);
+	seq_printf(s, "ungated:      %u\n", host->ungate_count);
+	seq_printf(s, "skipped:      %u\n", host->gate_skipped);
+	seq_printf(s, "ungate avg:   %llu ns\n", host->ungate_count ?
+		   div_u64(host->ungate_ns, host->ungate_count) : 0);
+	seq_printf(s, "ungate max:   %u ns\n", host->ungate_max_ns);
+	return 0;
+}
+
+static int tegra_sdhci_clk_gate_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_sdhci_clk_gate_show, inode->i_private);
+}
+
+static const struct file_operations tegra_sdhci_clk_gate_fops = {
+	.open		= tegra_sdhci_clk_gate_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_sdhci_debugfs_init(struct tegra_sdhci_host *host)
+{
+	/* removed along with the rest of the host's debugfs directory */
+	if (host->sdhci->mmc->debugfs_root)
+		debugfs_create_file("clk_gate", S_IRUGO,
+			host->sdhci->mmc->debugfs_root, host,
+			&tegra_sdhci_clk_gate_fops);
+}
+#else
+static inline void tegra_sdhci_debugfs_init(struct tegra_sdhci_host *host)
+{
+}
+#endif
+
 static int tegra_sdhci_get_ro(struct sdhci_host *sdhci)
 {
 	struct tegra_sdhci_host *host;
@@ -98,6 +219,8 @@ static int tegra_sdhci_get_ro(struct sdhci_host *sdhci)
 static struct sdhci_ops tegra_sdhci_ops = {
 	.enable_dma = tegra_sdhci_enable_dma,
 	.set_clock = tegra_sdhci_set_clock,
+	.enable = tegra_sdhci_enable,
+	.disable = tegra_sdhci_disable,
 	.get_ro = tegra_sdhci_get_ro,
 };
 
@@ -174,12 +297,19 @@ static int __devinit tegra_sdhci_probe(struct platform_device *pdev)
 			plat->funcs,
 			plat->num_funcs);
 #endif
+	if (plat->deferred_resume)
+		mmc_set_bus_resume_policy(sdhci->mmc, 1);
+	mmc_set_disable_delay(sdhci->mmc, TEGRA_SDHCI_CLK_GATE_DELAY);
+	sdhci->mmc->caps |= MMC_CAP_HC_ERASE_SZ;
+	/* run SDIO function handlers straight from our irq thread */
+	sdhci->mmc->caps |= MMC_CAP_SDIO_IRQ_NOTHREAD;
 
 	rc = sdhci_add_host(sdhci);
 	if (rc)
 		goto err_clk_disable;
 
 	platform_set_drvdata(pdev, host);
+	tegra_sdhci_debugfs_init(host);
 
 	if (plat->cd_gpio != -1) {
 		rc = request_irq(gpio_to_irq(plat->cd_gpio), carddetect_irq,
@@ -291,6 +421,8 @@ static int tegra_sdhci_suspend(struct platform_device *pdev, pm_message_t state)
 	struct tegra_sdhci_host *host = platform_get_drvdata(pdev);
 	int ret = 0;
 
+	tegra_sdhci_clk_ungate(host);
+
 	if (host->card_always_on && is_card_sdio(host->sdhci->mmc->card)) {
 		int div = 0;
 		u16 clk;
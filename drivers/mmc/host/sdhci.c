@@ -416,7 +416,7 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	int len, offset;
 
 	struct scatterlist *sg;
-	int i;
+	int i, max_len;
 	char *buffer;
 	unsigned long flags;
 
@@ -441,8 +441,11 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		goto fail;
 	BUG_ON(host->align_addr & 0x3);
 
-	host->sg_count = dma_map_sg(mmc_dev(host->mmc),
-		data->sg, data->sg_len, direction);
+	if (data->host_cookie)
+		host->sg_count = data->host_cookie;
+	else
+		host->sg_count = dma_map_sg(mmc_dev(host->mmc),
+			data->sg, data->sg_len, direction);
 	if (host->sg_count == 0)
 		goto unmap_align;
 
@@ -451,6 +454,15 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 
 	align_addr = host->align_addr;
 
+	/*
+	 * Longer segments are split over several descriptors; keep the
+	 * pieces 32-bit aligned if a zero length cannot mean 64 KiB.
+	 */
+	if (host->quirks & SDHCI_QUIRK_BROKEN_ADMA_ZEROLEN_DESC)
+		max_len = 0xfffc;
+	else
+		max_len = 65536;
+
 	for_each_sg(data->sg, sg, host->sg_count, i) {
 		addr = sg_dma_address(sg);
 		len = sg_dma_len(sg);
@@ -485,17 +497,22 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 			len -= offset;
 		}
 
-		BUG_ON(len > 65536);
+		while (len) {
+			int chunk = min(len, max_len);
+
+			/* tran, valid */
+			sdhci_set_adma_desc(desc, addr, chunk, 0x21);
+			desc += 8;
 
-		/* tran, valid */
-		sdhci_set_adma_desc(desc, addr, len, 0x21);
-		desc += 8;
+			addr += chunk;
+			len -= chunk;
+		}
 
 		/*
 		 * If this triggers then we have a calculation bug
 		 * somewhere. :/
 		 */
-		WARN_ON((desc - host->adma_desc) > (128 * 2 + 1) * 4);
+		WARN_ON((desc - host->adma_desc) > SDHCI_ADMA_DESC_SIZE - 8);
 	}
 
 	if (host->quirks & SDHCI_QUIRK_NO_ENDATTR_IN_NOPDESC) {
@@ -524,7 +541,7 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	}
 
 	host->adma_addr = dma_map_single(mmc_dev(host->mmc),
-		host->adma_desc, (128 * 2 + 1) * 4, DMA_TO_DEVICE);
+		host->adma_desc, SDHCI_ADMA_DESC_SIZE, DMA_TO_DEVICE);
 	if (dma_mapping_error(mmc_dev(host->mmc), host->adma_addr))
 		goto unmap_entries;
 	BUG_ON(host->adma_addr & 0x3);
@@ -532,8 +549,9 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	return 0;
 
 unmap_entries:
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-		data->sg_len, direction);
+	if (!data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+			data->sg_len, direction);
 unmap_align:
 	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
 		128 * 4, direction);
@@ -551,6 +569,7 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 	u8 *align;
 	char *buffer;
 	unsigned long flags;
+	bool has_unaligned = false;
 
 	if (data->flags & MMC_DATA_READ)
 		direction = DMA_FROM_DEVICE;
@@ -558,12 +577,22 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 		direction = DMA_TO_DEVICE;
 
 	dma_unmap_single(mmc_dev(host->mmc), host->adma_addr,
-		(128 * 2 + 1) * 4, DMA_TO_DEVICE);
+		SDHCI_ADMA_DESC_SIZE, DMA_TO_DEVICE);
 
 	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
 		128 * 4, direction);
 
+	/* Only sync the data back if bytes went through the align buffer */
 	if (data->flags & MMC_DATA_READ) {
+		for_each_sg(data->sg, sg, host->sg_count, i) {
+			if (sg_dma_address(sg) & 0x3) {
+				has_unaligned = true;
+				break;
+			}
+		}
+	}
+
+	if (has_unaligned) {
 		dma_sync_sg_for_cpu(mmc_dev(host->mmc), data->sg,
 			data->sg_len, direction);
 
@@ -583,8 +612,9 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 		}
 	}
 
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-		data->sg_len, direction);
+	if (!data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+			data->sg_len, direction);
 }
 
 static u8 sdhci_calc_timeout(struct sdhci_host *host, struct mmc_data *data)
@@ -753,7 +783,10 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 		} else {
 			int sg_cnt;
 
-			sg_cnt = dma_map_sg(mmc_dev(host->mmc),
+			if (data->host_cookie)
+				sg_cnt = data->host_cookie;
+			else
+				sg_cnt = dma_map_sg(mmc_dev(host->mmc),
 					data->sg, data->sg_len,
 					(data->flags & MMC_DATA_READ) ?
 						DMA_FROM_DEVICE :
@@ -845,7 +878,7 @@ static void sdhci_finish_data(struct sdhci_host *host)
 	if (host->flags & SDHCI_REQ_USE_DMA) {
 		if (host->flags & SDHCI_USE_ADMA)
 			sdhci_adma_table_post(host, data);
-		else {
+		else if (!data->host_cookie) {
 			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
 				data->sg_len, (data->flags & MMC_DATA_READ) ?
 					DMA_FROM_DEVICE : DMA_TO_DEVICE);
@@ -912,10 +945,16 @@ static void sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 		mdelay(1);
 	}
 
-	mod_timer(&host->timer, jiffies + 10 * HZ);
+	/* erases can keep the card busy for longer than any transfer */
+	mod_timer(&host->timer, jiffies + 10 * HZ +
+		  msecs_to_jiffies(cmd->erase_timeout));
 
 	host->cmd = cmd;
 
+	/* busy signalling without data uses the longest data timeout */
+	if (!cmd->data && (cmd->flags & MMC_RSP_BUSY))
+		sdhci_writeb(host, 0xE, SDHCI_TIMEOUT_CONTROL);
+
 	sdhci_prepare_data(host, cmd->data);
 
 	sdhci_writel(host, cmd->arg, SDHCI_ARGUMENT);
@@ -1141,6 +1180,46 @@ static void sdhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	spin_unlock_irqrestore(&host->lock, flags);
 }
 
+/*
+ * Map the data of the next request while the current one is on the bus.
+ * Only done when sdhci_prepare_data() is sure to use DMA for it.
+ */
+static void sdhci_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+	bool is_first_req)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data || data->host_cookie)
+		return;
+
+	if (!(host->flags & (SDHCI_USE_SDMA | SDHCI_USE_ADMA)))
+		return;
+
+	if (host->quirks & (SDHCI_QUIRK_32BIT_DMA_ADDR |
+			    SDHCI_QUIRK_32BIT_DMA_SIZE |
+			    SDHCI_QUIRK_32BIT_ADMA_SIZE))
+		return;
+
+	data->host_cookie = dma_map_sg(mmc_dev(mmc), data->sg, data->sg_len,
+		(data->flags & MMC_DATA_READ) ?
+			DMA_FROM_DEVICE : DMA_TO_DEVICE);
+}
+
+static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+	int err)
+{
+	struct mmc_data *data = mrq->data;
+
+	if (!data || !data->host_cookie)
+		return;
+
+	dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len,
+		(data->flags & MMC_DATA_READ) ?
+			DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	data->host_cookie = 0;
+}
+
 static void sdhci_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 {
 	struct sdhci_host *host;
@@ -1265,6 +1344,9 @@ int sdhci_enable(struct mmc_host *mmc)
 {
 	struct sdhci_host *host = mmc_priv(mmc);
 
+	if (host->ops->enable)
+		return host->ops->enable(host);
+
 	if (!mmc->card || mmc->card->type == MMC_TYPE_SDIO)
 		return 0;
 
@@ -1278,6 +1360,9 @@ int sdhci_disable(struct mmc_host *mmc, int lazy)
 {
 	struct sdhci_host *host = mmc_priv(mmc);
 
+	if (host->ops->disable)
+		return host->ops->disable(host, lazy);
+
 	if (!mmc->card || mmc->card->type == MMC_TYPE_SDIO)
 		return 0;
 
@@ -1288,6 +1373,8 @@ int sdhci_disable(struct mmc_host *mmc, int lazy)
 
 static const struct mmc_host_ops sdhci_ops = {
 	.request	= sdhci_request,
+	.pre_req	= sdhci_pre_req,
+	.post_req	= sdhci_post_req,
 	.set_ios	= sdhci_set_ios,
 	.get_ro		= sdhci_get_ro,
 	.enable	= sdhci_enable,
@@ -1645,12 +1732,27 @@ out:
 	/*
 	 * We have to delay this as it calls back into the driver.
 	 */
-	if (cardint)
-		mmc_signal_sdio_irq(host->mmc);
+	if (cardint) {
+		if (host->mmc->caps & MMC_CAP_SDIO_IRQ_NOTHREAD) {
+			sdhci_enable_sdio_irq(host->mmc, 0);
+			host->mmc->sdio_irq_stamp = ktime_get();
+			result = IRQ_WAKE_THREAD;
+		} else
+			mmc_signal_sdio_irq(host->mmc);
+	}
 
 	return result;
 }
 
+static irqreturn_t sdhci_thread_irq(int irq, void *dev_id)
+{
+	struct sdhci_host *host = dev_id;
+
+	sdio_run_irqs(host->mmc);
+
+	return IRQ_HANDLED;
+}
+
 /*****************************************************************************\
  *                                                                           *
  * Suspend/resume                                                            *
@@ -1815,7 +1917,7 @@ int sdhci_add_host(struct sdhci_host *host)
 		 * (128) and potentially one alignment transfer for
 		 * each of those entries.
 		 */
-		host->adma_desc = kmalloc((128 * 2 + 1) * 4, GFP_KERNEL);
+		host->adma_desc = kmalloc(SDHCI_ADMA_DESC_SIZE, GFP_KERNEL);
 		host->align_buffer = kmalloc(128 * 4, GFP_KERNEL);
 		if (!host->adma_desc || !host->align_buffer) {
 			kfree(host->adma_desc);
@@ -1876,7 +1978,7 @@ int sdhci_add_host(struct sdhci_host *host)
 	else
 		mmc->f_min = host->max_clk / 256;
 	mmc->f_max = host->max_clk;
-	mmc->caps = 0;
+	/* keep capabilities the glue driver set before adding the host */
 
 	if (host->quirks & SDHCI_QUIRK_8_BIT_DATA)
 		mmc->caps |= MMC_CAP_8_BIT_DATA;
@@ -1903,6 +2005,10 @@ int sdhci_add_host(struct sdhci_host *host)
 
 	mmc->caps |= MMC_CAP_ERASE;
 
+	/* the longest busy time the data timeout counter covers, in ms */
+	if (host->timeout_clk)
+		mmc->max_discard_to = (1 << 27) / host->timeout_clk;
+
 	mmc->ocr_avail = 0;
 	if (caps & SDHCI_CAN_VDD_330)
 		mmc->ocr_avail |= MMC_VDD_32_33|MMC_VDD_33_34;
@@ -1939,17 +2045,10 @@ int sdhci_add_host(struct sdhci_host *host)
 
 	/*
 	 * Maximum segment size. Could be one segment with the maximum number
-	 * of bytes. When doing hardware scatter/gather, each entry cannot
-	 * be larger than 64 KiB though.
+	 * of bytes. ADMA entries larger than 64 KiB are split over several
+	 * descriptors by sdhci_adma_table_pre().
 	 */
-	if (host->flags & SDHCI_USE_ADMA) {
-		if (host->quirks & SDHCI_QUIRK_BROKEN_ADMA_ZEROLEN_DESC)
-			mmc->max_seg_size = 0xffff;
-		else
-			mmc->max_seg_size = 65536;
-	} else {
-		mmc->max_seg_size = mmc->max_req_size;
-	}
+	mmc->max_seg_size = mmc->max_req_size;
 
 	/*
 	 * Maximum block size. This varies from controller to controller and
@@ -1984,8 +2083,8 @@ int sdhci_add_host(struct sdhci_host *host)
 
 	setup_timer(&host->timer, sdhci_timeout_timer, (unsigned long)host);
 
-	ret = request_irq(host->irq, sdhci_irq, IRQF_SHARED,
-		mmc_hostname(mmc), host);
+	ret = request_threaded_irq(host->irq, sdhci_irq, sdhci_thread_irq,
+		IRQF_SHARED, mmc_hostname(mmc), host);
 	if (ret)
 		goto untasklet;
 
@@ -180,6 +180,14 @@
 #define   SDHCI_SPEC_100	0
 #define   SDHCI_SPEC_200	1
 
+/*
+ * ADMA descriptor table: a descriptor per segment and one more for the
+ * alignment bounce of each, up to eight for splitting segments longer
+ * than a descriptor can carry (512 KiB per request), and the end mark.
+ */
+#define SDHCI_ADMA_DESC_COUNT	(128 * 2 + 8 + 1)
+#define SDHCI_ADMA_DESC_SIZE	(SDHCI_ADMA_DESC_COUNT * 8)
+
 struct sdhci_ops;
 
 struct sdhci_host {
@@ -338,6 +346,10 @@ struct sdhci_ops {
 
 	void	(*set_clock)(struct sdhci_host *host, unsigned int clock);
 
+	/* runtime enable / disable, see SDHCI_QUIRK_RUNTIME_DISABLE */
+	int		(*enable)(struct sdhci_host *host);
+	int		(*disable)(struct sdhci_host *host, int lazy);
+
 	int		(*enable_dma)(struct sdhci_host *host);
 	int		(*get_ro)(struct sdhci_host *host);
 	unsigned int	(*get_max_clock)(struct sdhci_host *host);
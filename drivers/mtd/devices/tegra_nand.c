@@ -95,6 +95,7 @@ struct tegra_nand_info {
 	struct tegra_nand_chip		chip;
 	struct mtd_info			mtd;
 	struct tegra_nand_platform	*plat;
+	struct tegra_nand_chip_parms	*chip_parms;
 	struct device			*dev;
 	struct mtd_partition		*parts;
 
@@ -123,6 +124,22 @@ struct tegra_nand_info {
 	/* bad block bitmap: 1 == good, 0 == bad/unknown */
 	unsigned long			*bb_bitmap;
 
+	/* chip supports the cache read/program commands */
+	int				cache_read;
+	int				cache_prog;
+	uint32_t			pages_per_block;
+
+	/* A cache read sequence is open on cache_rd_chip and the chip is
+	 * loading cache_rd_page into its data register. Any other command
+	 * must close the sequence first with tegra_nand_end_cache_read(). */
+	int				cache_rd_active;
+	int				cache_rd_chip;
+	uint32_t			cache_rd_page;
+
+	/* last page read with data, to detect sequential reads */
+	int				last_rd_chip;
+	uint32_t			last_rd_page;
+
 	struct clk			*clk;
 };
 #define MTD_TO_INFO(mtd)	container_of((mtd), struct tegra_nand_info, mtd)
@@ -416,6 +433,46 @@ nand_cmd_get_status(struct tegra_nand_info *info, uint32_t *status)
 }
 
 
+/* Closes an open cache read sequence. The chip finishes loading the page
+ * it was reading ahead and goes back to accepting normal commands. The
+ * read ahead data is dropped. Must be called with lock held. */
+static int
+tegra_nand_end_cache_read(struct tegra_nand_info *info)
+{
+	if (!info->cache_rd_active)
+		return 0;
+
+	info->cache_rd_active = 0;
+	info->command_reg = (COMMAND_CLE | COMMAND_RBSY_CHK |
+			     COMMAND_CE(info->cache_rd_chip));
+	writel(NAND_CMD_READ_CACHE_END, CMD_REG1);
+	writel(0, CMD_REG2);
+	writel(0, ADDR_REG1);
+	writel(0, ADDR_REG2);
+	writel(CONFIG_COM_BSY, CONFIG_REG);
+
+	return tegra_nand_go(info);
+}
+
+
+/* Loads a page into the chip's data register without transferring it,
+ * to start a cache read sequence. Must be called with lock held. */
+static int
+tegra_nand_load_page(struct tegra_nand_info *info, uint32_t page)
+{
+	info->command_reg =
+		COMMAND_CE(info->chip.curr_chip) | COMMAND_CLE | COMMAND_ALE |
+		COMMAND_ALE_BYTE_SIZE(4) | COMMAND_SEC_CMD | COMMAND_RBSY_CHK;
+	writel(NAND_CMD_READ0, CMD_REG1);
+	writel(NAND_CMD_READSTART, CMD_REG2);
+	writel((page & 0xffff) << 16, ADDR_REG1);
+	writel((page >> 16) & 0xff, ADDR_REG2);
+	writel(CONFIG_COM_BSY, CONFIG_REG);
+
+	return tegra_nand_go(info);
+}
+
+
 /* must be called with lock held */
 static int
 check_block_isbad(struct mtd_info *mtd, loff_t offs)
@@ -492,7 +549,9 @@ tegra_nand_block_isbad(struct mtd_info *mtd, loff_t offs)
 		return -EINVAL;
 
 	mutex_lock(&info->lock);
-	ret = check_block_isbad(mtd, offs);
+	ret = tegra_nand_end_cache_read(info);
+	if (ret == 0)
+		ret = check_block_isbad(mtd, offs);
 	mutex_unlock(&info->lock);
 
 #if 0
@@ -525,6 +584,10 @@ tegra_nand_block_markbad(struct mtd_info *mtd, loff_t offs)
 	mutex_lock(&info->lock);
 	offs &= ~(mtd->erasesize - 1);
 
+	ret = tegra_nand_end_cache_read(info);
+	if (ret != 0)
+		goto out;
+
 	/* mark the block bad in our bitmap */
 	clear_bit(block, info->bb_bitmap);
 	mtd->ecc_stats.badblocks++;
@@ -606,6 +669,11 @@ tegra_nand_erase(struct mtd_info *mtd, struct erase_info *instr)
 
 	instr->state = MTD_ERASING;
 
+	if (tegra_nand_end_cache_read(info) != 0) {
+		instr->fail_addr = instr->addr;
+		goto out_err;
+	}
+
 	offs = instr->addr;
 	num_blocks = instr->len >> info->chip.block_shift;
 
@@ -865,6 +933,7 @@ do_read_oob(struct mtd_info *mtd, loff_t from, struct mtd_oob_ops *ops)
 	int err;
 	int do_ecc = 1;
 	dma_addr_t datbuf_dma_addr = 0;
+	uint32_t cache_cmd;
 
 #if 0
 	dump_mtd_oob_ops(mtd, ops);
@@ -916,12 +985,42 @@ do_read_oob(struct mtd_info *mtd, loff_t from, struct mtd_oob_ops *ops)
 	while (page_count--) {
 		int a_len = min(mtd->writesize - column, len);
 		int b_len = min(oobsz, ooblen);
+		int cache_ok = info->cache_read && datbuf && do_ecc &&
+			column == 0 && a_len == mtd->writesize;
+		int last_in_block = ((page + 1) % info->pages_per_block) == 0;
 
 #if 0
 		pr_info("%s: chip:=%d page=%d col=%d\n", __func__, chipnr,
 			page, column);
 #endif
 
+		/* Full page reads that follow each other go through the chip's
+		 * cache register: while this page is transferred, the chip
+		 * already loads the next one, so its tR is hidden unless the
+		 * next read goes somewhere else. Sequences never cross a
+		 * block. */
+		cache_cmd = 0;
+		if (info->cache_rd_active &&
+		    (!cache_ok || info->cache_rd_chip != chipnr ||
+		     info->cache_rd_page != page)) {
+			err = tegra_nand_end_cache_read(info);
+			if (err != 0)
+				goto out_err;
+		}
+
+		if (info->cache_rd_active) {
+			cache_cmd = last_in_block ? NAND_CMD_READ_CACHE_END :
+				NAND_CMD_READ_CACHE;
+		} else if (cache_ok && !last_in_block &&
+			   (page_count || (info->last_rd_chip == chipnr &&
+					   info->last_rd_page + 1 == page))) {
+			err = tegra_nand_load_page(info, page);
+			if (err != 0)
+				goto out_err;
+			cache_cmd = NAND_CMD_READ_CACHE;
+		}
+		info->cache_rd_active = 0;
+
 		clear_regs(info);
 		if (datbuf)
 			datbuf_dma_addr = tegra_nand_dma_map(info->dev, datbuf, a_len, DMA_FROM_DEVICE);
@@ -929,6 +1028,13 @@ do_read_oob(struct mtd_info *mtd, loff_t from, struct mtd_oob_ops *ops)
 		prep_transfer_dma(info, 1, do_ecc, page, column, datbuf_dma_addr,
 				  a_len, info->oob_dma_addr,
 				  b_len);
+		if (cache_cmd) {
+			/* data comes out of the cache register, no address */
+			info->command_reg &= ~(COMMAND_ALE | COMMAND_SEC_CMD |
+					       COMMAND_ALE_BYTE_SIZE(0xf));
+			writel(cache_cmd, CMD_REG1);
+			writel(0, CMD_REG2);
+		}
 		writel(info->config_reg, CONFIG_REG);
 		writel(info->dmactrl_reg, DMA_MST_CTRL_REG);
 
@@ -947,8 +1053,17 @@ do_read_oob(struct mtd_info *mtd, loff_t from, struct mtd_oob_ops *ops)
 		/*pr_info("tegra_read_oob: DMA complete\n");*/
 
 		/* if we are here, transfer is done */
-		if (datbuf)
+		if (datbuf) {
 			dma_unmap_page(info->dev, datbuf_dma_addr, a_len, DMA_FROM_DEVICE);
+			info->last_rd_chip = chipnr;
+			info->last_rd_page = page;
+		}
+
+		if (cache_cmd == NAND_CMD_READ_CACHE) {
+			info->cache_rd_active = 1;
+			info->cache_rd_chip = chipnr;
+			info->cache_rd_page = page + 1;
+		}
 
 		if (oobbuf) {
 			uint32_t ofs = datbuf && oobbuf ? 4 : 0; /* skipped bytes */
@@ -1096,6 +1211,10 @@ do_write_oob(struct mtd_info *mtd, loff_t to, struct mtd_oob_ops *ops)
 
 	mutex_lock(&info->lock);
 
+	err = tegra_nand_end_cache_read(info);
+	if (err != 0)
+		goto out_err;
+
 	split_addr(info, to, &chipnr, &page, &column);
 	select_chip(info, chipnr);
 
@@ -1112,6 +1231,14 @@ do_write_oob(struct mtd_info *mtd, loff_t to, struct mtd_oob_ops *ops)
 		prep_transfer_dma(info, 0, do_ecc, page, column, datbuf_dma_addr,
 				  a_len, info->oob_dma_addr, b_len);
 
+		/* more pages follow in this block: the chip programs this one
+		 * from its cache register while the next one is transferred.
+		 * The last page is always a normal program, so that the
+		 * sequence is finished when we return. */
+		if (info->cache_prog && datbuf && page_count &&
+		    ((page + 1) % info->pages_per_block))
+			writel(NAND_CMD_CACHEDPROG, CMD_REG2);
+
 		writel(info->config_reg, CONFIG_REG);
 		writel(info->dmactrl_reg, DMA_MST_CTRL_REG);
 
@@ -1182,7 +1309,14 @@ tegra_nand_write_oob(struct mtd_info *mtd, loff_t to, struct mtd_oob_ops *ops)
 static int
 tegra_nand_suspend(struct mtd_info *mtd)
 {
-	return 0;
+	struct tegra_nand_info *info = MTD_TO_INFO(mtd);
+	int err;
+
+	mutex_lock(&info->lock);
+	err = tegra_nand_end_cache_read(info);
+	mutex_unlock(&info->lock);
+
+	return err;
 }
 
 static void
@@ -1220,10 +1354,9 @@ scan_bad_blocks(struct tegra_nand_info *info)
 static void
 set_chip_timing(struct tegra_nand_info *info)
 {
-	struct tegra_nand_chip_parms *chip_parms = &info->plat->chip_parms[0];
+	struct tegra_nand_chip_parms *chip_parms = info->chip_parms;
 	uint32_t tmp;
 
-	/* TODO: Actually search the chip_parms list for the correct device. */
 	/* TODO: Get the appropriate frequency from the clock subsystem */
 #define NAND_CLK_FREQ	108000
 #define CNT(t)		(((((t) * NAND_CLK_FREQ) + 1000000 - 1) / 1000000) - 1)
@@ -1288,6 +1421,16 @@ tegra_nand_scan(struct mtd_info *mtd, int maxchips)
 		goto out_error;
 	}
 
+	/* use the board's parameters for this device, if it has any */
+	info->chip_parms = &info->plat->chip_parms[0];
+	for (cnt = 0; cnt < info->plat->nr_chip_parms; ++cnt) {
+		if (info->plat->chip_parms[cnt].vendor_id == vendor_id &&
+		    info->plat->chip_parms[cnt].device_id == dev_id) {
+			info->chip_parms = &info->plat->chip_parms[cnt];
+			break;
+		}
+	}
+
 	/* loop through and see if we can find more devices */
 	for (cnt = 1; cnt < info->plat->max_chips; ++cnt) {
 		select_chip(info, cnt);
@@ -1349,6 +1492,18 @@ tegra_nand_scan(struct mtd_info *mtd, int maxchips)
 	tmp = (dev_parms >> 4) & 0x3;
 	mtd->erasesize = (64 * 1024) << tmp;
 	info->chip.block_shift = ffs(mtd->erasesize) - 1;
+	info->pages_per_block = mtd->erasesize / mtd->writesize;
+
+	/* bit 7 of the 3rd id byte == cache program supported. The cache
+	 * read commands cannot be probed, so those are left to the board. */
+	info->cache_prog = (info->chip_parms->flags & TEGRA_NAND_CACHE_PROG) &&
+		(mlc_parms & 0x80);
+	info->cache_read = !!(info->chip_parms->flags & TEGRA_NAND_CACHE_READ);
+	info->last_rd_chip = -1;
+	if (info->cache_read || info->cache_prog)
+		pr_info("%s: cache read %s, cache program %s\n", DRIVER_NAME,
+			info->cache_read ? "on" : "off",
+			info->cache_prog ? "on" : "off");
 
 	/* used to select the appropriate chip/page in case multiple devices
 	 * are connected */
@@ -2335,6 +2335,23 @@ static struct net_device_ops dhd_ops_virt = {
 };
 #endif
 
+/* Steer rx protocol work off CPU0, which takes the SDIO interrupt and runs
+ * the dpc; user space can still change this through queues/rx-0/rps_cpus.
+ */
+static void
+dhd_rps_init(struct net_device *net)
+{
+	cpumask_var_t mask;
+
+	if (num_possible_cpus() < 2 || !alloc_cpumask_var(&mask, GFP_KERNEL))
+		return;
+
+	cpumask_andnot(mask, cpu_possible_mask, cpumask_of(0));
+	if (netif_set_rps_cpus(net, 0, mask))
+		DHD_ERROR(("%s: couldn't set rps cpus\n", __FUNCTION__));
+	free_cpumask_var(mask);
+}
+
 int
 dhd_net_attach(dhd_pub_t *dhdp, int ifidx)
 {
@@ -2404,6 +2421,8 @@ dhd_net_attach(dhd_pub_t *dhdp, int ifidx)
 		goto fail;
 	}
 
+	dhd_rps_init(net);
+
 	printf("%s: Broadcom Dongle Host Driver mac=%.2x:%.2x:%.2x:%.2x:%.2x:%.2x\n", net->name,
 	       dhd->pub.mac.octet[0], dhd->pub.mac.octet[1], dhd->pub.mac.octet[2],
 	       dhd->pub.mac.octet[3], dhd->pub.mac.octet[4], dhd->pub.mac.octet[5]);
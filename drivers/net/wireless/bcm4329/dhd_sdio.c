@@ -208,6 +208,7 @@ typedef struct dhd_bus {
 
 	void		*glomd;			/* Packet containing glomming descriptor */
 	void		*glom;			/* Packet chain for glommed superframe */
+	bool		glomshared;		/* Chain members are views of one buffer */
 	uint		glomerr;		/* Glom packet read errors */
 
 	uint8		*rxbuf;			/* Buffer for receiving control packets */
@@ -293,6 +294,7 @@ typedef struct dhd_bus {
 	uint		rxglomfail;		/* Failed deglom attempts */
 	uint		rxglomframes;		/* Number of glom frames (superframes) */
 	uint		rxglompkts;		/* Number of packets from glom frames */
+	uint		rxglomshared;		/* Superframes delivered without a copy */
 	uint		f2rxhdrs;		/* Number of header reads */
 	uint		f2rxdata;		/* Number of frame data reads */
 	uint		f2txdata;		/* Number of f2 frame writes */
@@ -1513,8 +1515,8 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	            bus->rx_hdrfail, bus->rx_badhdr, bus->rx_badseq);
 	bcm_bprintf(strbuf, "fc_rcvd %d, fc_xoff %d, fc_xon %d\n",
 	            bus->fc_rcvd, bus->fc_xoff, bus->fc_xon);
-	bcm_bprintf(strbuf, "rxglomfail %d, rxglomframes %d, rxglompkts %d\n",
-	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts);
+	bcm_bprintf(strbuf, "rxglomfail %d, rxglomframes %d, rxglompkts %d, rxglomshared %d\n",
+	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts, bus->rxglomshared);
 	bcm_bprintf(strbuf, "f2rx (hdrs/data) %d (%d/%d), f2tx %d f1regs %d\n",
 	            (bus->f2rxhdrs + bus->f2rxdata), bus->f2rxhdrs, bus->f2rxdata,
 	            bus->f2txdata, bus->f1regdata);
@@ -1580,7 +1582,7 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->rxrtx = bus->rx_toolong = bus->rxc_errors = 0;
 	bus->rx_hdrfail = bus->rx_badhdr = bus->rx_badseq = 0;
 	bus->tx_sderrs = bus->fc_rcvd = bus->fc_xoff = bus->fc_xon = 0;
-	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = 0;
+	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = bus->rxglomshared = 0;
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
 }
 
@@ -2999,6 +3001,9 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 
 	uint16 sublen, check;
 	void *pfirst, *plast, *pnext, *save_pfirst;
+	void *psuper;
+	uint32 sflen;
+	uint16 sfoff;
 	osl_t *osh = bus->dhd->osh;
 
 	int errcode;
@@ -3017,7 +3022,7 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 	if (bus->glomd) {
 		dhd_os_sdlock_rxq(bus->dhd);
 
-		pfirst = plast = pnext = NULL;
+		pfirst = plast = pnext = psuper = NULL;
 		dlen = (uint16)PKTLEN(osh, bus->glomd);
 		dptr = PKTDATA(osh, bus->glomd);
 		if (!dlen || (dlen & 1)) {
@@ -3026,6 +3031,19 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 			dlen = 0;
 		}
 
+		/* Without chained reads, read the superframe into one packet and
+		 * make the subframes clones of their part of it rather than
+		 * copying them out of databuf.
+		 */
+		if (!usechain && dlen) {
+			for (sflen = 0, sfoff = 0; sfoff < dlen; sfoff += sizeof(uint16))
+				sflen += ltoh16_ua(dptr + sfoff);
+			sflen = ROUNDUP(sflen, bus->blocksize);
+			if ((sflen <= MAX_DATA_BUF) &&
+			    (psuper = PKTGET(osh, sflen + DHD_SDALIGN, FALSE)) != NULL)
+				PKTALIGN(osh, psuper, sflen, DHD_SDALIGN);
+		}
+
 		for (totlen = num = 0; dlen; num++) {
 			/* Get (and move past) next length */
 			sublen = ltoh16_ua(dptr);
@@ -3052,7 +3070,16 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 			}
 
 			/* Allocate/chain packet for next subframe */
-			if ((pnext = PKTGET(osh, sublen + DHD_SDALIGN, FALSE)) == NULL) {
+			if (psuper) {
+				if ((totlen > sflen) ||
+				    ((pnext = PKTCLONE(osh, psuper, totlen - sublen,
+				                       sublen)) == NULL)) {
+					DHD_ERROR(("%s: PKTCLONE failed, num %d len %d\n",
+					           __FUNCTION__, num, sublen));
+					pnext = NULL;
+					break;
+				}
+			} else if ((pnext = PKTGET(osh, sublen + DHD_SDALIGN, FALSE)) == NULL) {
 				DHD_ERROR(("%s: PKTGET failed, num %d len %d\n",
 				           __FUNCTION__, num, sublen));
 				break;
@@ -3068,7 +3095,8 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 			}
 
 			/* Adhere to start alignment requirements */
-			PKTALIGN(osh, pnext, sublen, DHD_SDALIGN);
+			if (!psuper)
+				PKTALIGN(osh, pnext, sublen, DHD_SDALIGN);
 		}
 
 		/* If all allocations succeeded, save packet chain in bus structure */
@@ -3083,6 +3111,7 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 				}
 			}
 			bus->glom = pfirst;
+			bus->glomshared = (psuper != NULL);
 			pfirst = pnext = NULL;
 		} else {
 			if (pfirst)
@@ -3091,6 +3120,10 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 			num = 0;
 		}
 
+		/* The clones keep the superframe buffer */
+		if (psuper)
+			PKTFREE(osh, psuper, FALSE);
+
 		/* Done with descriptor packet */
 		PKTFREE(osh, bus->glomd, FALSE);
 		bus->glomd = NULL;
@@ -3117,7 +3150,14 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 		 * read directly into the chained packet, or allocate a large
 		 * packet and and copy into the chain.
 		 */
-		if (usechain) {
+		if (bus->glomshared) {
+			/* Chain members are consecutive parts of one buffer */
+			errcode = dhd_bcmsdh_recv_buf(bus,
+			                              bcmsdh_cur_sbwad(bus->sdh), SDIO_FUNC_2,
+			                              F2SYNC, (uint8*)PKTDATA(osh, pfirst),
+			                              dlen, NULL, NULL, NULL);
+			bus->rxglomshared++;
+		} else if (usechain) {
 			errcode = dhd_bcmsdh_recv_buf(bus,
 			                              bcmsdh_cur_sbwad(bus->sdh), SDIO_FUNC_2,
 			                              F2SYNC, (uint8*)PKTDATA(osh, pfirst),
@@ -4022,6 +4062,29 @@ dhdsdio_hostmail(dhd_bus_t *bus)
 	return intstatus;
 }
 
+/* Split one scheduling round between rx and tx.  A deep tx queue is sent
+ * in longer runs (up to 4x dhd_txbound) and rx gives up the same share of
+ * its bound, so a round takes about as long as with the fixed bounds.
+ * Rx left over from the last round keeps the full rx bound.
+ */
+static void
+dhdsdio_bounds(dhd_bus_t *bus, uint *rxlimit, uint *txlimit)
+{
+	uint txqlen;
+
+	*rxlimit = dhd_rxbound;
+	*txlimit = dhd_txbound;
+
+	if (!dhd_txbound || (bus->intstatus & I_HMB_FRAME_IND))
+		return;
+
+	txqlen = pktq_mlen(&bus->txq, ~bus->flowcontrol);
+	if (txqlen > dhd_txbound) {
+		*txlimit = MIN(txqlen, dhd_txbound * 4);
+		*rxlimit = MAX((dhd_rxbound * dhd_txbound) / *txlimit, 1);
+	}
+}
+
 bool
 dhdsdio_dpc(dhd_bus_t *bus)
 {
@@ -4029,8 +4092,8 @@ dhdsdio_dpc(dhd_bus_t *bus)
 	sdpcmd_regs_t *regs = bus->regs;
 	uint32 intstatus, newstatus = 0;
 	uint retries = 0;
-	uint rxlimit = dhd_rxbound; /* Rx frames to read before resched */
-	uint txlimit = dhd_txbound; /* Tx frames to send before resched */
+	uint rxlimit;			  /* Rx frames to read before resched */
+	uint txlimit;			  /* Tx frames to send before resched */
 	uint framecnt = 0;		  /* Temporary counter of tx/rx frames */
 	bool rxdone = TRUE;		  /* Flag for no more read data */
 	bool resched = FALSE;	  /* Flag indicating resched wanted */
@@ -4039,6 +4102,7 @@ dhdsdio_dpc(dhd_bus_t *bus)
 
 	/* Start with leftover status bits */
 	intstatus = bus->intstatus;
+	dhdsdio_bounds(bus, &rxlimit, &txlimit);
 
 	dhd_os_sdlock(bus->dhd);
 
@@ -622,3 +622,22 @@ osl_pktdup(osl_t *osh, void *skb)
 	osh->pub.pktalloced++;
 	return (p);
 }
+
+/* Clone of [offset, offset + len) in skb's data, sharing the buffer. The
+ * clone is charged only for its own part so that several clones of one
+ * big buffer don't each count it in full against a socket.
+ */
+void *
+osl_pktclone(osl_t *osh, void *skb, uint offset, uint len)
+{
+	struct sk_buff *p;
+
+	if ((p = osl_pktdup(osh, skb)) == NULL)
+		return NULL;
+
+	skb_pull(p, offset);
+	__skb_trim(p, len);
+	p->truesize = SKB_DATA_ALIGN(len) + sizeof(struct sk_buff);
+
+	return (p);
+}
@@ -30,6 +30,8 @@
 #include <linux/slab.h>
 #include <linux/jiffies.h>
 #include <linux/interrupt.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include <mach/gpio.h>
 
@@ -64,14 +66,39 @@ enum {
 #define BATTERY_FULL_CHARGED		0x20
 #define BATTERY_FULL_DISCHARGED		0x10
 
+/* battery status alarm bits */
+#define BATTERY_OVER_CHARGED_ALARM	0x8000
+#define BATTERY_TERMINATE_CHARGE_ALARM	0x4000
+#define BATTERY_OVER_TEMP_ALARM		0x1000
+#define BATTERY_TERMINATE_DISCHARGE_ALARM	0x0800
+#define BATTERY_REMAINING_CAPACITY_ALARM	0x0200
+#define BATTERY_REMAINING_TIME_ALARM	0x0100
+
+/* status bits whose change is reported to userspace */
+#define BATTERY_STATUS_EVENTS	(BATTERY_OVER_CHARGED_ALARM | \
+				 BATTERY_TERMINATE_CHARGE_ALARM | \
+				 BATTERY_OVER_TEMP_ALARM | \
+				 BATTERY_TERMINATE_DISCHARGE_ALARM | \
+				 BATTERY_REMAINING_CAPACITY_ALARM | \
+				 BATTERY_REMAINING_TIME_ALARM | \
+				 BATTERY_DISCHARGING | \
+				 BATTERY_FULL_CHARGED | \
+				 BATTERY_FULL_DISCHARGED)
+
 #define BATTERY_POLL_PERIOD		30000
+/* temperature change, in 0.1K, worth a uevent */
+#define BATTERY_TEMP_DELTA		10
+
+/* cache lifetime of registers that only change with the battery pack */
+#define CACHE_STATIC			UINT_MAX
 
-#define BQ20Z75_DATA(_psp, _addr, _min_value, _max_value)	\
+#define BQ20Z75_DATA(_psp, _addr, _min_value, _max_value, _cache_ms)	\
 	{							\
 		.psp = POWER_SUPPLY_PROP_##_psp,		\
 		.addr = _addr,					\
 		.min_value = _min_value,			\
 		.max_value = _max_value,			\
+		.cache_ms = _cache_ms,				\
 	}
 
 static struct bq20z75_device_data {
@@ -79,21 +106,31 @@ static struct bq20z75_device_data {
 	u8 addr;
 	int min_value;
 	int max_value;
+	unsigned int cache_ms;
 } bq20z75_data[] = {
-	[REG_MANUFACTURER_DATA] = BQ20Z75_DATA(PRESENT, 0x00, 0, 65535),
-	[REG_TEMPERATURE]       = BQ20Z75_DATA(TEMP, 0x08, 0, 65535),
-	[REG_VOLTAGE]           = BQ20Z75_DATA(VOLTAGE_NOW, 0x09, 0, 20000),
-	[REG_CURRENT]           = BQ20Z75_DATA(CURRENT_NOW, 0x0A, -32768, 32767),
-	[REG_CAPACITY]          = BQ20Z75_DATA(CAPACITY, 0x0e, 0, 100),
-	[REG_REMAINING_CAPACITY] = BQ20Z75_DATA(ENERGY_NOW, 0x0F, 0, 65535),
-	[REG_FULL_CHARGE_CAPACITY] = BQ20Z75_DATA(ENERGY_FULL, 0x10, 0, 65535),
-	[REG_TIME_TO_EMPTY]     = BQ20Z75_DATA(TIME_TO_EMPTY_AVG, 0x12, 0, 65535),
-	[REG_TIME_TO_FULL]      = BQ20Z75_DATA(TIME_TO_FULL_AVG, 0x13, 0, 65535),
-	[REG_STATUS]            = BQ20Z75_DATA(STATUS, 0x16, 0, 65535),
-	[REG_CYCLE_COUNT]       = BQ20Z75_DATA(CYCLE_COUNT, 0x17, 0, 65535),
-	[REG_DESIGN_CAPACITY]   = BQ20Z75_DATA(ENERGY_FULL_DESIGN, 0x18, 0, 65535),
-	[REG_DESIGN_VOLTAGE]    = BQ20Z75_DATA(VOLTAGE_MAX_DESIGN, 0x19, 0, 65535),
-	[REG_SERIAL_NUMBER]     = BQ20Z75_DATA(SERIAL_NUMBER, 0x1C, 0, 65535),
+	[REG_MANUFACTURER_DATA] = BQ20Z75_DATA(PRESENT, 0x00, 0, 65535, 5000),
+	[REG_TEMPERATURE]       = BQ20Z75_DATA(TEMP, 0x08, 0, 65535, 5000),
+	[REG_VOLTAGE]           = BQ20Z75_DATA(VOLTAGE_NOW, 0x09, 0, 20000, 2000),
+	[REG_CURRENT]           = BQ20Z75_DATA(CURRENT_NOW, 0x0A, -32768, 32767,
+					       2000),
+	[REG_CAPACITY]          = BQ20Z75_DATA(CAPACITY, 0x0e, 0, 100, 5000),
+	[REG_REMAINING_CAPACITY] = BQ20Z75_DATA(ENERGY_NOW, 0x0F, 0, 65535,
+						5000),
+	[REG_FULL_CHARGE_CAPACITY] = BQ20Z75_DATA(ENERGY_FULL, 0x10, 0, 65535,
+						  60000),
+	[REG_TIME_TO_EMPTY]     = BQ20Z75_DATA(TIME_TO_EMPTY_AVG, 0x12, 0, 65535,
+					       5000),
+	[REG_TIME_TO_FULL]      = BQ20Z75_DATA(TIME_TO_FULL_AVG, 0x13, 0, 65535,
+					       5000),
+	[REG_STATUS]            = BQ20Z75_DATA(STATUS, 0x16, 0, 65535, 2000),
+	[REG_CYCLE_COUNT]       = BQ20Z75_DATA(CYCLE_COUNT, 0x17, 0, 65535,
+					       60000),
+	[REG_DESIGN_CAPACITY]   = BQ20Z75_DATA(ENERGY_FULL_DESIGN, 0x18, 0, 65535,
+					       CACHE_STATIC),
+	[REG_DESIGN_VOLTAGE]    = BQ20Z75_DATA(VOLTAGE_MAX_DESIGN, 0x19, 0, 65535,
+					       CACHE_STATIC),
+	[REG_SERIAL_NUMBER]     = BQ20Z75_DATA(SERIAL_NUMBER, 0x1C, 0, 65535,
+					       CACHE_STATIC),
 };
 
 static enum power_supply_property bq20z75_battery_properties[] = {
@@ -152,13 +189,71 @@ static struct power_supply bq20z75_supply[] = {
 	},
 };
 
+struct bq20z75_reg_cache {
+	s32		value;
+	unsigned long	stamp;
+	bool		valid;
+};
+
 static struct bq20z75_device_info {
-	struct timer_list	battery_poll_timer;
+	struct delayed_work	battery_work;
 	struct i2c_client	*client;
 	int irq;
 	bool battery_present;
+
+	/* protects cache[] and the ManufacturerAccess write/read pair */
+	struct mutex		lock;
+	struct bq20z75_reg_cache cache[REG_MAX];
+
+	/* last values reported with power_supply_changed() */
+	int			last_status;
+	int			last_capacity;
+	int			last_temp;
 } *bq20z75_device;
 
+static bool bq20z75_cache_fresh(int reg_offset)
+{
+	struct bq20z75_reg_cache *c = &bq20z75_device->cache[reg_offset];
+	unsigned int cache_ms = bq20z75_data[reg_offset].cache_ms;
+
+	if (!c->valid)
+		return false;
+	if (cache_ms == CACHE_STATIC)
+		return true;
+	return time_before(jiffies, c->stamp + msecs_to_jiffies(cache_ms));
+}
+
+/* drop cached values, keeping the pack constants unless @all is set */
+static void bq20z75_invalidate_cache(bool all)
+{
+	int i;
+
+	for (i = 0; i < REG_MAX; i++)
+		if (all || bq20z75_data[i].cache_ms != CACHE_STATIC)
+			bq20z75_device->cache[i].valid = false;
+}
+
+/* called with bq20z75_device->lock held */
+static s32 bq20z75_read_word(struct i2c_client *client, int reg_offset)
+{
+	struct bq20z75_reg_cache *c = &bq20z75_device->cache[reg_offset];
+	s32 ret;
+
+	if (bq20z75_cache_fresh(reg_offset))
+		return c->value;
+
+	ret = i2c_smbus_read_word_data(client, bq20z75_data[reg_offset].addr);
+	if (ret < 0) {
+		c->valid = false;
+		return ret;
+	}
+
+	c->value = ret;
+	c->stamp = jiffies;
+	c->valid = true;
+	return ret;
+}
+
 static int bq20z75_get_ac_status(void)
 {
 	int charger_gpio = irq_to_gpio(bq20z75_device->irq);
@@ -191,15 +286,15 @@ static int bq20z75_get_battery_presence_and_health(
 	/* Write to ManufacturerAccess with
 	 * ManufacturerAccess command and then
 	 * read the status */
-	ret = i2c_smbus_write_word_data(client,
-		bq20z75_data[REG_MANUFACTURER_DATA].addr,
-		MANUFACTURER_ACCESS_STATUS);
-	if (ret < 0)
-		return ret;
-
+	if (!bq20z75_cache_fresh(REG_MANUFACTURER_DATA)) {
+		ret = i2c_smbus_write_word_data(client,
+			bq20z75_data[REG_MANUFACTURER_DATA].addr,
+			MANUFACTURER_ACCESS_STATUS);
+		if (ret < 0)
+			return ret;
+	}
 
-	ret = i2c_smbus_read_word_data(client,
-		bq20z75_data[REG_MANUFACTURER_DATA].addr);
+	ret = bq20z75_read_word(client, REG_MANUFACTURER_DATA);
 	if (ret < 0)
 		return ret;
 
@@ -240,7 +335,7 @@ static int bq20z75_get_battery_property(struct i2c_client *client, int reg_offse
 	s32 ret;
 	int ac_status;
 
-	ret = i2c_smbus_read_word_data(client, bq20z75_data[reg_offset].addr);
+	ret = bq20z75_read_word(client, reg_offset);
 	if (ret < 0) {
 		dev_err(&client->dev,
 			"%s: i2c read for %d failed\n", __func__, reg_offset);
@@ -316,7 +411,7 @@ static int bq20z75_get_battery_capacity(struct i2c_client *client,
 {
 	s32 ret;
 
-	ret = i2c_smbus_read_word_data(client, bq20z75_data[reg_offset].addr);
+	ret = bq20z75_read_word(client, reg_offset);
 	if (ret < 0)
 		return ret;
 
@@ -336,8 +431,7 @@ static int bq20z75_get_battery_serial_number(struct i2c_client *client,
 {
 	int ret;
 
-	ret = i2c_smbus_read_word_data(client,
-		bq20z75_data[REG_SERIAL_NUMBER].addr);
+	ret = bq20z75_read_word(client, REG_SERIAL_NUMBER);
 	if (ret < 0)
 		return ret;
 
@@ -347,13 +441,12 @@ static int bq20z75_get_battery_serial_number(struct i2c_client *client,
 	return 0;
 }
 
-static int bq20z75_bat_get_property(struct power_supply *psy,
+static int bq20z75_get_bat_property(struct i2c_client *client,
 	enum power_supply_property psp,
 	union power_supply_propval *val)
 {
 	int count;
 	int ret;
-	struct i2c_client *client = bq20z75_device->client;
 
 	switch (psp) {
 	case POWER_SUPPLY_PROP_PRESENT:
@@ -413,6 +506,22 @@ static int bq20z75_bat_get_property(struct power_supply *psy,
 		return -EINVAL;
 	}
 
+	return 0;
+}
+
+static int bq20z75_bat_get_property(struct power_supply *psy,
+	enum power_supply_property psp,
+	union power_supply_propval *val)
+{
+	int ret;
+	struct i2c_client *client = bq20z75_device->client;
+
+	mutex_lock(&bq20z75_device->lock);
+	ret = bq20z75_get_bat_property(client, psp, val);
+	mutex_unlock(&bq20z75_device->lock);
+	if (ret)
+		return ret;
+
 	/* Convert units to match requirements for power supply class */
 	bq20z75_unit_adjustment(client, psp, val);
 
@@ -424,17 +533,56 @@ static int bq20z75_bat_get_property(struct power_supply *psy,
 
 static irqreturn_t ac_present_irq(int irq, void *data)
 {
+	mutex_lock(&bq20z75_device->lock);
+	bq20z75_invalidate_cache(false);
+	mutex_unlock(&bq20z75_device->lock);
+
 	power_supply_changed(&bq20z75_supply[SUPPLY_TYPE_AC]);
 	power_supply_changed(&bq20z75_supply[SUPPLY_TYPE_BATTERY]);
 	return IRQ_HANDLED;
 }
 
-static void battery_poll_timer_func(unsigned long unused)
+/*
+ * The gauge's SMBus alarm broadcasts need a bus master that accepts
+ * slave writes, which the host controller does not do, so the alarm
+ * and state bits are polled instead.  Userspace only hears about a
+ * poll when the capacity, status/alarm bits or temperature changed.
+ */
+static void bq20z75_battery_work(struct work_struct *work)
 {
-	power_supply_changed(&bq20z75_supply[SUPPLY_TYPE_BATTERY]);
-	power_supply_changed(&bq20z75_supply[SUPPLY_TYPE_AC]);
-	mod_timer(&bq20z75_device->battery_poll_timer,
-		jiffies + msecs_to_jiffies(BATTERY_POLL_PERIOD));
+	struct bq20z75_device_info *di = container_of(work,
+		struct bq20z75_device_info, battery_work.work);
+	s32 status, capacity, temp;
+	bool changed = false;
+
+	mutex_lock(&di->lock);
+	status = bq20z75_read_word(di->client, REG_STATUS);
+	capacity = bq20z75_read_word(di->client, REG_CAPACITY);
+	temp = bq20z75_read_word(di->client, REG_TEMPERATURE);
+	mutex_unlock(&di->lock);
+
+	status = status < 0 ? -1 : status & BATTERY_STATUS_EVENTS;
+	if (status != di->last_status) {
+		di->last_status = status;
+		changed = true;
+	}
+
+	capacity = capacity < 0 ? -1 : min(capacity, 100);
+	if (capacity != di->last_capacity) {
+		di->last_capacity = capacity;
+		changed = true;
+	}
+
+	if (temp >= 0 && abs(temp - di->last_temp) >= BATTERY_TEMP_DELTA) {
+		di->last_temp = temp;
+		changed = true;
+	}
+
+	if (changed)
+		power_supply_changed(&bq20z75_supply[SUPPLY_TYPE_BATTERY]);
+
+	schedule_delayed_work(&di->battery_work,
+		msecs_to_jiffies(BATTERY_POLL_PERIOD));
 }
 
 static int bq20z75_probe(struct i2c_client *client,
@@ -448,6 +596,9 @@ static int bq20z75_probe(struct i2c_client *client,
 		return -ENOMEM;
 
 	bq20z75_device->client = client;
+	mutex_init(&bq20z75_device->lock);
+	bq20z75_device->last_status = -1;
+	bq20z75_device->last_capacity = -1;
 	flags = bq20z75_device->client->flags;
 	bq20z75_device->client->flags &= ~I2C_M_IGNORE_NAK;
 
@@ -487,10 +638,11 @@ static int bq20z75_probe(struct i2c_client *client,
 	}
 
 	if (bq20z75_device->battery_present) {
-		setup_timer(&bq20z75_device->battery_poll_timer,
-			battery_poll_timer_func, 0);
-		mod_timer(&bq20z75_device->battery_poll_timer,
-			jiffies + msecs_to_jiffies(BATTERY_POLL_PERIOD));
+		/* deferrable: an idle system is not woken just to poll */
+		INIT_DELAYED_WORK_DEFERRABLE(&bq20z75_device->battery_work,
+			bq20z75_battery_work);
+		schedule_delayed_work(&bq20z75_device->battery_work,
+			msecs_to_jiffies(BATTERY_POLL_PERIOD));
 	}
 
 	dev_info(&bq20z75_device->client->dev, "driver registered\n");
@@ -512,7 +664,7 @@ static int bq20z75_remove(struct i2c_client *client)
 	int supply_index = 0, i;
 
 	if (bq20z75_device->battery_present)
-		del_timer_sync(&bq20z75_device->battery_poll_timer);
+		cancel_delayed_work_sync(&bq20z75_device->battery_work);
 	else
 		supply_index = SUPPLY_TYPE_AC;
 
@@ -535,7 +687,7 @@ static int bq20z75_suspend(struct i2c_client *client,
 	if (!bq20z75_device->battery_present)
 		return 0;
 
-	del_timer_sync(&bq20z75_device->battery_poll_timer);
+	cancel_delayed_work_sync(&bq20z75_device->battery_work);
 
 	/* write to manufacture access with sleep command */
 	ret = i2c_smbus_write_word_data(bq20z75_device->client,
@@ -560,10 +712,12 @@ static int bq20z75_resume(struct i2c_client *client)
 	if (!bq20z75_device->battery_present)
 		return 0;
 
-	setup_timer(&bq20z75_device->battery_poll_timer,
-		battery_poll_timer_func, 0);
-	mod_timer(&bq20z75_device->battery_poll_timer,
-		jiffies + msecs_to_jiffies(BATTERY_POLL_PERIOD));
+	/* the pack may have been swapped while we were asleep */
+	mutex_lock(&bq20z75_device->lock);
+	bq20z75_invalidate_cache(true);
+	mutex_unlock(&bq20z75_device->lock);
+
+	schedule_delayed_work(&bq20z75_device->battery_work, 0);
 	return 0;
 }
 #endif
@@ -38,11 +38,40 @@
 #define BQ27x00_REG_TTECP		0x26
 
 #define BQ27000_REG_RSOC		0x0B /* Relative State-of-Charge */
+#define BQ27000_FLAG_EDVF		BIT(0)
+#define BQ27000_FLAG_EDV1		BIT(1)
 #define BQ27000_FLAG_CHGS		BIT(7)
 
 #define BQ27500_REG_SOC			0x2c
 #define BQ27500_FLAG_DSC		BIT(0)
+#define BQ27500_FLAG_SOCF		BIT(1)
+#define BQ27500_FLAG_SOC1		BIT(2)
 #define BQ27500_FLAG_FC			BIT(9)
+#define BQ27500_FLAG_OTD		BIT(14)
+#define BQ27500_FLAG_OTC		BIT(15)
+
+/* flags whose change is reported to userspace */
+#define BQ27000_FLAG_EVENTS	(BQ27000_FLAG_CHGS | BQ27000_FLAG_EDV1 | \
+				 BQ27000_FLAG_EDVF)
+#define BQ27500_FLAG_EVENTS	(BQ27500_FLAG_DSC | BQ27500_FLAG_FC | \
+				 BQ27500_FLAG_SOC1 | BQ27500_FLAG_SOCF | \
+				 BQ27500_FLAG_OTC | BQ27500_FLAG_OTD)
+
+/*
+ * All registers the driver uses sit in BQ27x00_REG_TEMP..BQ27500_REG_SOC,
+ * so one burst read refreshes every property.
+ */
+#define BQ27x00_CACHE_FIRST		BQ27x00_REG_TEMP
+#define BQ27x00_CACHE_LEN		(BQ27500_REG_SOC + 2 - BQ27x00_CACHE_FIRST)
+#define BQ27x00_CACHE_MS		2000
+
+/* temperature change, in 0.1 degree, worth a uevent */
+#define BQ27x00_TEMP_DELTA		10
+
+static unsigned int poll_interval = 60;
+module_param(poll_interval, uint, 0644);
+MODULE_PARM_DESC(poll_interval, "battery poll interval in seconds - "
+				"0 disables polling");
 
 /* If the system has several batteries we need a different name for each
  * of them...
@@ -54,6 +83,8 @@ struct bq27x00_device_info;
 struct bq27x00_access_methods {
 	int (*read)(u8 reg, int *rt_value, int b_single,
 		struct bq27x00_device_info *di);
+	int (*read_block)(u8 reg, u8 *buf, int len,
+		struct bq27x00_device_info *di);
 };
 
 enum bq27x00_chip { BQ27000, BQ27500 };
@@ -66,6 +97,17 @@ struct bq27x00_device_info {
 	enum bq27x00_chip	chip;
 
 	struct i2c_client	*client;
+
+	/* protects the register cache */
+	struct mutex		lock;
+	u8			cache[BQ27x00_CACHE_LEN];
+	unsigned long		cache_stamp;
+	bool			cache_valid;
+
+	struct delayed_work	work;
+	int			last_flags;
+	int			last_capacity;
+	int			last_temp;
 };
 
 static enum power_supply_property bq27x00_battery_props[] = {
@@ -87,9 +129,49 @@ static enum power_supply_property bq27x00_battery_props[] = {
 static int bq27x00_read(u8 reg, int *rt_value, int b_single,
 			struct bq27x00_device_info *di)
 {
+	int off = reg - BQ27x00_CACHE_FIRST;
+
+	if (di->cache_valid && off >= 0 &&
+	    off + (b_single ? 1 : 2) <= BQ27x00_CACHE_LEN) {
+		if (b_single)
+			*rt_value = di->cache[off];
+		else
+			*rt_value = get_unaligned_le16(&di->cache[off]);
+		return 0;
+	}
+
 	return di->bus->read(reg, rt_value, b_single, di);
 }
 
+/*
+ * Refresh the register cache if it is older than BQ27x00_CACHE_MS.
+ * On failure the cache is dropped and the property helpers fall back
+ * to single register reads.  Called with di->lock held.
+ */
+static void bq27x00_update(struct bq27x00_device_info *di)
+{
+	int ret;
+
+	if (di->cache_valid &&
+	    time_before(jiffies, di->cache_stamp +
+			msecs_to_jiffies(BQ27x00_CACHE_MS)))
+		return;
+
+	di->cache_valid = false;
+	if (!di->bus->read_block)
+		return;
+
+	ret = di->bus->read_block(BQ27x00_CACHE_FIRST, di->cache,
+				  BQ27x00_CACHE_LEN, di);
+	if (ret) {
+		dev_dbg(di->dev, "error reading register block\n");
+		return;
+	}
+
+	di->cache_stamp = jiffies;
+	di->cache_valid = true;
+}
+
 /*
  * Return the battery temperature in tenths of degree Celsius
  * Or < 0 if something fails.
@@ -249,6 +331,9 @@ static int bq27x00_battery_get_property(struct power_supply *psy,
 	int ret = 0;
 	struct bq27x00_device_info *di = to_bq27x00_device_info(psy);
 
+	mutex_lock(&di->lock);
+	bq27x00_update(di);
+
 	switch (psp) {
 	case POWER_SUPPLY_PROP_STATUS:
 		ret = bq27x00_battery_status(di, val);
@@ -278,12 +363,61 @@ static int bq27x00_battery_get_property(struct power_supply *psy,
 		ret = bq27x00_battery_time(di, BQ27x00_REG_TTF, val);
 		break;
 	default:
-		return -EINVAL;
+		ret = -EINVAL;
 	}
 
+	mutex_unlock(&di->lock);
 	return ret;
 }
 
+/*
+ * There is no alarm interrupt wired up for the gauge, so poll it at
+ * poll_interval and only notify userspace when the capacity, the state
+ * flags or the temperature changed.  The work is deferrable, so an idle
+ * system is not woken up for it.
+ */
+static void bq27x00_battery_work(struct work_struct *work)
+{
+	struct bq27x00_device_info *di =
+		container_of(work, struct bq27x00_device_info, work.work);
+	int flags = 0, capacity, temp;
+	bool changed = false;
+
+	mutex_lock(&di->lock);
+	bq27x00_update(di);
+	if (bq27x00_read(BQ27x00_REG_FLAGS, &flags, 0, di))
+		flags = -1;
+	capacity = bq27x00_battery_rsoc(di);
+	temp = bq27x00_battery_temperature(di);
+	mutex_unlock(&di->lock);
+
+	if (flags >= 0)
+		flags &= di->chip == BQ27500 ? BQ27500_FLAG_EVENTS :
+					       BQ27000_FLAG_EVENTS;
+	if (flags != di->last_flags) {
+		di->last_flags = flags;
+		changed = true;
+	}
+
+	if (capacity < 0)
+		capacity = -1;
+	if (capacity != di->last_capacity) {
+		di->last_capacity = capacity;
+		changed = true;
+	}
+
+	if (abs(temp - di->last_temp) >= BQ27x00_TEMP_DELTA) {
+		di->last_temp = temp;
+		changed = true;
+	}
+
+	if (changed)
+		power_supply_changed(&di->bat);
+
+	if (poll_interval)
+		schedule_delayed_work(&di->work, poll_interval * HZ);
+}
+
 static void bq27x00_powersupply_init(struct bq27x00_device_info *di)
 {
 	di->bat.type = POWER_SUPPLY_TYPE_BATTERY;
@@ -297,43 +431,50 @@ static void bq27x00_powersupply_init(struct bq27x00_device_info *di)
  * i2c specific code
  */
 
-static int bq27x00_read_i2c(u8 reg, int *rt_value, int b_single,
+/* register write and data read in one transfer, with a repeated start */
+static int bq27x00_read_block_i2c(u8 reg, u8 *buf, int len,
 			struct bq27x00_device_info *di)
 {
 	struct i2c_client *client = di->client;
-	struct i2c_msg msg[1];
-	unsigned char data[2];
+	struct i2c_msg msg[2];
 	int err;
 
 	if (!client->adapter)
 		return -ENODEV;
 
-	msg->addr = client->addr;
-	msg->flags = 0;
-	msg->len = 1;
-	msg->buf = data;
+	msg[0].addr = client->addr;
+	msg[0].flags = 0;
+	msg[0].len = 1;
+	msg[0].buf = &reg;
 
-	data[0] = reg;
-	err = i2c_transfer(client->adapter, msg, 1);
+	msg[1].addr = client->addr;
+	msg[1].flags = I2C_M_RD;
+	msg[1].len = len;
+	msg[1].buf = buf;
 
-	if (err >= 0) {
-		if (!b_single)
-			msg->len = 2;
-		else
-			msg->len = 1;
+	err = i2c_transfer(client->adapter, msg, 2);
+	if (err < 0)
+		return err;
+
+	return err == 2 ? 0 : -EIO;
+}
 
-		msg->flags = I2C_M_RD;
-		err = i2c_transfer(client->adapter, msg, 1);
-		if (err >= 0) {
-			if (!b_single)
-				*rt_value = get_unaligned_le16(data);
-			else
-				*rt_value = data[0];
+static int bq27x00_read_i2c(u8 reg, int *rt_value, int b_single,
+			struct bq27x00_device_info *di)
+{
+	unsigned char data[2];
+	int err;
 
-			return 0;
-		}
-	}
-	return err;
+	err = bq27x00_read_block_i2c(reg, data, b_single ? 1 : 2, di);
+	if (err)
+		return err;
+
+	if (!b_single)
+		*rt_value = get_unaligned_le16(data);
+	else
+		*rt_value = data[0];
+
+	return 0;
 }
 
 static int bq27x00_battery_probe(struct i2c_client *client,
@@ -383,8 +524,13 @@ static int bq27x00_battery_probe(struct i2c_client *client,
 	di->dev = &client->dev;
 	di->bat.name = name;
 	bus->read = &bq27x00_read_i2c;
+	bus->read_block = &bq27x00_read_block_i2c;
 	di->bus = bus;
 	di->client = client;
+	mutex_init(&di->lock);
+	di->last_flags = -1;
+	di->last_capacity = -1;
+	INIT_DELAYED_WORK_DEFERRABLE(&di->work, bq27x00_battery_work);
 
 	bq27x00_powersupply_init(di);
 
@@ -394,6 +540,9 @@ static int bq27x00_battery_probe(struct i2c_client *client,
 		goto batt_failed_4;
 	}
 
+	if (poll_interval)
+		schedule_delayed_work(&di->work, poll_interval * HZ);
+
 	dev_info(&client->dev, "support ver. %s enabled\n", DRIVER_VERSION);
 
 	return 0;
@@ -416,6 +565,7 @@ static int bq27x00_battery_remove(struct i2c_client *client)
 {
 	struct bq27x00_device_info *di = i2c_get_clientdata(client);
 
+	cancel_delayed_work_sync(&di->work);
 	power_supply_unregister(&di->bat);
 
 	kfree(di->bat.name);
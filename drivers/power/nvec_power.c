@@ -35,6 +35,9 @@
  
 #define NVEC_POWER_POLLING_INTERVAL 30000
 
+/* Temperature change, in 0.1 degC, worth a battery uevent */
+#define NVEC_POWER_TEMP_DELTA 10
+
 struct nvec_power {
 	struct notifier_block 	 notifier;
 	
@@ -323,10 +326,13 @@ static void get_bat_mfg_data(struct nvec_power *power)
 }
 
 /* This fn is the only one that should be called by the driver to update
-   the battery status */
+   the battery status. It only signals userspace when something it cares
+   about changed: presence, charging state, capacity percent, AC line or
+   a meaningful temperature step */
 static int nvec_power_update_status(struct nvec_power *power,bool force_update)
 {
 	int bat_status_changed = 0;
+	int old_status, old_cap, old_temp;
 	struct device* master = power->master;
 	
 	/* Do not accept to update too often */
@@ -336,6 +342,10 @@ static int nvec_power_update_status(struct nvec_power *power,bool force_update)
 	/* get exclusive access to the accelerometer */
 	mutex_lock(&power->lock);	
 
+	old_status = power->bat_status;
+	old_cap = power->bat_cap;
+	old_temp = power->bat_temperature;
+
 	{
 		struct NVEC_ANS_BATTERY_GETCAPACITYREMAINING_PAYLOAD getRemCapacity;
 		if (nvec_cmd_xfer(master,NVEC_CMD_BATTERY,NVEC_CMD_BATTERY_GETCAPACITYREMAINING,
@@ -508,6 +518,13 @@ static int nvec_power_update_status(struct nvec_power *power,bool force_update)
 		}
 	}
 	
+	if (power->bat_status != old_status ||
+		power->bat_cap != old_cap ||
+		abs(power->bat_temperature - old_temp) >= NVEC_POWER_TEMP_DELTA)
+		bat_status_changed = 1;
+	else
+		power->bat_temperature = old_temp;	/* keep the reference point */
+
 	if (bat_status_changed)
 		power_supply_changed(&nvec_bat_psy);
 	
@@ -743,11 +760,10 @@ static void nvec_power_work_func(struct work_struct *work)
 	struct nvec_power *power = container_of((struct delayed_work*)work,
 		struct nvec_power, work);
 
-	/* Update power supply status */
-	if (!nvec_power_update_status(power,true)) {
-		power_supply_changed(&nvec_bat_psy);
-		power_supply_changed(&nvec_ac_psy);
-	}
+	/* Update power supply status. Presence, charging state and the
+	   low capacity alarm arrive as EC events, so this poll only has to
+	   track the gauge; changes are propagated by the update itself */
+	nvec_power_update_status(power,true);
 	
 	queue_delayed_work(power->work_queue, &power->work,
 				 msecs_to_jiffies(NVEC_POWER_POLLING_INTERVAL));
@@ -760,8 +776,6 @@ static void nvec_power_isr_work_func(struct work_struct *isr_work)
 
 	/* Update power supply status */
 	if (!nvec_power_update_status(power,true)) {
-		power_supply_changed(&nvec_bat_psy);
-		power_supply_changed(&nvec_ac_psy);
 		
 		/* If battery is below minimun, force a kernel shutdown */
 		if (power->capacity_remain < power->critical_capacity) {
@@ -834,7 +848,8 @@ static int __devinit nvec_power_probe(struct platform_device *pdev)
 		dev_err(&pdev->dev, "could not create workqueue\n");
 		goto err_ps_register4;
 	}
-	INIT_DELAYED_WORK(&power->work, nvec_power_work_func);
+	/* Deferrable, so the poll never wakes an idle system by itself */
+	INIT_DELAYED_WORK_DEFERRABLE(&power->work, nvec_power_work_func);
 	
 	power->isr_wq = create_singlethread_workqueue("nvec_power_isr_wq");
 	if (!power->isr_wq) {
@@ -921,8 +936,8 @@ static int nvec_power_resume(struct platform_device *dev)
 	struct nvec_power *power = platform_get_drvdata(dev);
 	if (power->in_s3_state_gpio) 
 		gpio_set_value(power->in_s3_state_gpio,0);
-	queue_delayed_work(power->work_queue, &power->work,
-		msecs_to_jiffies(NVEC_POWER_POLLING_INTERVAL));
+	/* Catch up with whatever happened while suspended right away */
+	queue_delayed_work(power->work_queue, &power->work, 0);
 	return 0;
 }
 
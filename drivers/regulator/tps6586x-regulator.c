@@ -115,6 +115,12 @@ static int __tps6586x_ldo_set_voltage(struct device *parent,
 			val <<= ri->volt_shift;
 			mask = ((1 << ri->volt_nbits) - 1) << ri->volt_shift;
 
+			/* DVM rails: voltage and go bit in one transfer */
+			if (ri->go_reg)
+				return tps6586x_update_go(parent, ri->volt_reg,
+						val, mask, ri->go_reg,
+						1 << ri->go_bit);
+
 			return tps6586x_update(parent, ri->volt_reg, val, mask);
 		}
 	}
@@ -171,18 +177,14 @@ static int tps6586x_dvm_set_voltage(struct regulator_dev *rdev,
 {
 	struct tps6586x_regulator *ri = rdev_get_drvdata(rdev);
 	struct device *parent = to_tps6586x_dev(rdev);
-	int ret;
 
+	/* the go bit is set along with the voltage, see above */
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,38)	
-	ret = __tps6586x_ldo_set_voltage(parent, ri, min_uV, max_uV,
+	return __tps6586x_ldo_set_voltage(parent, ri, min_uV, max_uV,
 									 selector);
 #else
-	ret = __tps6586x_ldo_set_voltage(parent, ri, min_uV, max_uV);
+	return __tps6586x_ldo_set_voltage(parent, ri, min_uV, max_uV);
 #endif
-	if (ret)
-		return ret;
-
-	return tps6586x_set_bits(parent, ri->go_reg, 1 << ri->go_bit);
 }
 
 static int tps6586x_regulator_enable(struct regulator_dev *rdev)
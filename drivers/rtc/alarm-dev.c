@@ -62,6 +62,8 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	int rv = 0;
 	unsigned long flags;
 	struct timespec new_alarm_time;
+	struct timespec new_alarm_end;
+	struct android_alarm_window new_alarm_window;
 	struct timespec new_rtc_time;
 	struct timespec tmp_time;
 	enum android_alarm_type alarm_type = ANDROID_ALARM_IOCTL_TO_TYPE(cmd);
@@ -117,13 +119,17 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			goto err1;
 		}
 from_old_alarm_set:
+		new_alarm_end = new_alarm_time;
+from_alarm_set_window:
 		spin_lock_irqsave(&alarm_slock, flags);
-		pr_alarm(IO, "alarm %d set %ld.%09ld\n", alarm_type,
-			new_alarm_time.tv_sec, new_alarm_time.tv_nsec);
+		pr_alarm(IO, "alarm %d set %ld.%09ld window end %ld.%09ld\n",
+			alarm_type, new_alarm_time.tv_sec,
+			new_alarm_time.tv_nsec, new_alarm_end.tv_sec,
+			new_alarm_end.tv_nsec);
 		alarm_enabled |= alarm_type_mask;
 		alarm_start_range(&alarms[alarm_type],
 			timespec_to_ktime(new_alarm_time),
-			timespec_to_ktime(new_alarm_time));
+			timespec_to_ktime(new_alarm_end));
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		if (ANDROID_ALARM_BASE_CMD(cmd) != ANDROID_ALARM_SET_AND_WAIT(0)
 		    && cmd != ANDROID_ALARM_SET_AND_WAIT_OLD)
@@ -146,6 +152,20 @@ from_old_alarm_set:
 		alarm_pending = 0;
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		break;
+	case ANDROID_ALARM_SET_WINDOW(0):
+		if (copy_from_user(&new_alarm_window, (void __user *)arg,
+		    sizeof(new_alarm_window))) {
+			rv = -EFAULT;
+			goto err1;
+		}
+		if (!timespec_valid(&new_alarm_window.window)) {
+			rv = -EINVAL;
+			goto err1;
+		}
+		new_alarm_time = new_alarm_window.time;
+		new_alarm_end = timespec_add(new_alarm_time,
+					     new_alarm_window.window);
+		goto from_alarm_set_window;
 	case ANDROID_ALARM_SET_RTC:
 		if (copy_from_user(&new_rtc_time, (void __user *)arg,
 		    sizeof(new_rtc_time))) {
@@ -68,11 +68,23 @@ static struct platform_device *alarm_platform_dev;
 struct alarm_queue alarms[ANDROID_ALARM_TYPE_COUNT];
 static bool suspended;
 
+/*
+ * Wakeup alarms that went off before their hard expiry because another
+ * wakeup alarm woke the system inside their window.
+ */
+static unsigned long coalesced_wakeups;
+module_param(coalesced_wakeups, ulong, S_IRUGO);
+
+static inline bool alarm_is_wakeup_queue(struct alarm_queue *base)
+{
+	return base == &alarms[ANDROID_ALARM_RTC_WAKEUP] ||
+		base == &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP];
+}
+
 static void update_timer_locked(struct alarm_queue *base, bool head_removed)
 {
 	struct alarm *alarm;
-	bool is_wakeup = base == &alarms[ANDROID_ALARM_RTC_WAKEUP] ||
-			base == &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP];
+	bool is_wakeup = alarm_is_wakeup_queue(base);
 
 	if (base->stopped) {
 		pr_alarm(FLOW, "changed alarm while setting the wall time\n");
@@ -317,17 +329,20 @@ ktime_t alarm_get_elapsed_realtime(void)
 	return now;
 }
 
-static enum hrtimer_restart alarm_timer_triggered(struct hrtimer *timer)
+/*
+ * Call every alarm on @base whose window has opened. Called with
+ * alarm_slock held, the lock is dropped around each callback. Returns
+ * true if any alarm was removed from the queue.
+ */
+static bool alarm_run_queue_locked(struct alarm_queue *base,
+				   unsigned long *flags)
 {
-	struct alarm_queue *base;
 	struct alarm *alarm;
-	unsigned long flags;
+	bool head_removed = false;
 	ktime_t now;
 
-	spin_lock_irqsave(&alarm_slock, flags);
-
-	base = container_of(timer, struct alarm_queue, timer);
-	now = base->stopped ? base->stopped_time : hrtimer_cb_get_time(timer);
+	now = base->stopped ? base->stopped_time :
+		hrtimer_cb_get_time(&base->timer);
 	now = ktime_sub(now, base->delta);
 
 	pr_alarm(INT, "alarm_timer_triggered type %d at %lld\n",
@@ -344,17 +359,47 @@ static enum hrtimer_restart alarm_timer_triggered(struct hrtimer *timer)
 		base->first = rb_next(&alarm->node);
 		rb_erase(&alarm->node, &base->alarms);
 		RB_CLEAR_NODE(&alarm->node);
+		head_removed = true;
+		if (alarm_is_wakeup_queue(base) &&
+		    alarm->expires.tv64 > now.tv64)
+			coalesced_wakeups++;
 		pr_alarm(CALL, "call alarm, type %d, func %pF, %lld (s %lld)\n",
 			alarm->type, alarm->function,
 			ktime_to_ns(alarm->expires),
 			ktime_to_ns(alarm->softexpires));
-		spin_unlock_irqrestore(&alarm_slock, flags);
+		spin_unlock_irqrestore(&alarm_slock, *flags);
 		alarm->function(alarm);
-		spin_lock_irqsave(&alarm_slock, flags);
+		spin_lock_irqsave(&alarm_slock, *flags);
 	}
 	if (!base->first)
 		pr_alarm(FLOW, "no more alarms of type %d\n", base - alarms);
+	return head_removed;
+}
+
+static enum hrtimer_restart alarm_timer_triggered(struct hrtimer *timer)
+{
+	struct alarm_queue *base;
+	struct alarm_queue *other = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&alarm_slock, flags);
+
+	base = container_of(timer, struct alarm_queue, timer);
+	alarm_run_queue_locked(base, &flags);
 	update_timer_locked(base, true);
+
+	/*
+	 * The system is awake anyway, so deliver the wakeup alarms of the
+	 * other wakeup type whose window has already opened instead of
+	 * waking up again for them at their hard expiry.
+	 */
+	if (base == &alarms[ANDROID_ALARM_RTC_WAKEUP])
+		other = &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP];
+	else if (base == &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP])
+		other = &alarms[ANDROID_ALARM_RTC_WAKEUP];
+	if (other && other->first && alarm_run_queue_locked(other, &flags))
+		update_timer_locked(other, true);
+
 	spin_unlock_irqrestore(&alarm_slock, flags);
 	return HRTIMER_NORESTART;
 }
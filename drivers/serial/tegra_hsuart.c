@@ -40,6 +40,7 @@
 #include <linux/serial_8250.h>
 #include <linux/debugfs.h>
 #include <linux/slab.h>
+#include <linux/scatterlist.h>
 #include <linux/workqueue.h>
 #include <linux/tegra_uart.h>
 
@@ -52,6 +53,8 @@
 	(unsigned long)(x))
 
 #define UART_RX_DMA_BUFFER_SIZE    (2048*4)
+#define UART_RX_DMA_SEGS           4
+#define UART_RX_DMA_SEG_SIZE       (UART_RX_DMA_BUFFER_SIZE / UART_RX_DMA_SEGS)
 
 #define UART_LSR_FIFOE		0x80
 #define UART_IER_EORD		0x20
@@ -114,10 +117,21 @@ struct tegra_uart_port {
 	/* TX DMA */
 	struct tegra_dma_req	tx_dma_req;
 	struct tegra_dma_channel *tx_dma;
+	struct scatterlist	tx_sg[2];
 
-	/* RX DMA */
-	struct tegra_dma_req	rx_dma_req;
+	/* RX DMA
+	 *
+	 * The receive buffer is split into a ring of requests that are all
+	 * kept queued, so the DMA moves from one segment to the next without
+	 * being stopped. rx_head is the segment being filled and rx_pushed
+	 * the number of its bytes already handed to the tty.
+	 */
+	struct tegra_dma_req	rx_dma_req[UART_RX_DMA_SEGS];
 	struct tegra_dma_channel *rx_dma;
+	void			*rx_dma_virt;
+	dma_addr_t		rx_dma_phys;
+	unsigned int		rx_head;
+	unsigned int		rx_pushed;
 
 	bool			use_rx_dma;
 	bool			use_tx_dma;
@@ -197,8 +211,24 @@ static void tegra_start_dma_tx(struct tegra_uart_port *t, unsigned long bytes)
 	uart_writeb(t, t->fcr_shadow, UART_FCR);
 
 	t->tx_bytes = bytes & ~(sizeof(u32)-1);
-	t->tx_dma_req.source_addr = t->xmit_dma_addr + xmit->tail;
-	t->tx_dma_req.size = t->tx_bytes;
+
+	/* Carry on from the start of the circ buffer in the same request
+	 * when the data wraps, instead of taking another interrupt at the
+	 * end of the buffer.
+	 */
+	sg_init_table(t->tx_sg, ARRAY_SIZE(t->tx_sg));
+	sg_dma_address(&t->tx_sg[0]) = t->xmit_dma_addr + xmit->tail;
+	sg_dma_len(&t->tx_sg[0]) = t->tx_bytes;
+	t->tx_dma_req.sg_len = 1;
+	if (xmit->tail + t->tx_bytes == UART_XMIT_SIZE &&
+		(xmit->head & ~(sizeof(u32)-1))) {
+		sg_dma_address(&t->tx_sg[1]) = t->xmit_dma_addr;
+		sg_dma_len(&t->tx_sg[1]) = xmit->head & ~(sizeof(u32)-1);
+		t->tx_bytes += sg_dma_len(&t->tx_sg[1]);
+		t->tx_dma_req.sg_len = 2;
+	}
+	sg_mark_end(&t->tx_sg[t->tx_dma_req.sg_len - 1]);
+	t->tx_dma_req.sg = t->tx_sg;
 
 	t->tx_in_progress = TEGRA_TX_DMA;
 
@@ -250,75 +280,113 @@ static void tegra_start_tx(struct uart_port *u)
 
 static int tegra_start_dma_rx(struct tegra_uart_port *t)
 {
+	int i;
+
+	t->rx_head = 0;
+	t->rx_pushed = 0;
 	wmb();
-	if (tegra_dma_enqueue_req(t->rx_dma, &t->rx_dma_req)) {
-		dev_err(t->uport.dev, "Could not enqueue Rx DMA req\n");
-		return -EINVAL;
+	for (i = 0; i < UART_RX_DMA_SEGS; i++) {
+		if (tegra_dma_enqueue_req(t->rx_dma, &t->rx_dma_req[i])) {
+			dev_err(t->uport.dev, "Could not enqueue Rx DMA req\n");
+			tegra_dma_cancel(t->rx_dma);
+			return -EINVAL;
+		}
 	}
 	return 0;
 }
 
+/* Hand the bytes of the head segment up to count to the tty. Lock taken. */
+static void tegra_rx_dma_push(struct tegra_uart_port *t,
+	struct tegra_dma_req *req, unsigned int count)
+{
+	struct tty_struct *tty = t->uport.state->port.tty;
+
+	count = min(count, req->size);
+	if (count <= t->rx_pushed)
+		return;
+
+	t->uport.icount.rx += count - t->rx_pushed;
+	tty_insert_flip_string(tty,
+		(unsigned char *)req->virt_addr + t->rx_pushed,
+		count - t->rx_pushed);
+	t->rx_pushed = count;
+}
+
 static void tegra_rx_dma_threshold_callback(struct tegra_dma_req *req)
 {
 	struct tegra_uart_port *t = req->dev;
+	struct uart_port *u = &t->uport;
 	unsigned long flags;
 
-	spin_lock_irqsave(&t->uport.lock, flags);
-
-	do_handle_rx_dma(t);
+	/* first half of the segment is done, the DMA keeps running */
+	spin_lock_irqsave(&u->lock, flags);
+	tegra_rx_dma_push(t, req, req->bytes_transferred);
+	spin_unlock_irqrestore(&u->lock, flags);
 
-	spin_unlock_irqrestore(&t->uport.lock, flags);
+	tty_flip_buffer_push(u->state->port.tty);
 }
 
-/* It is expected that the callers take the UART lock when this API is called.
- *
+/*
  * There are 2 contexts when this function is called:
  *
- * 1. DMA ISR - DMA ISR triggers the threshold complete calback, which calls the
- * dequue API which in-turn calls this callback. UART lock is taken during
- * the call to the threshold callback.
+ * 1. DMA ISR - the segment is full and the DMA has already moved on to the
+ * next one in the ring. The UART lock is not held.
  *
- * 2. UART ISR - UART calls the dequue API which in-turn will call this API.
- * In this case, UART ISR takes the UART lock.
- * */
+ * 2. tegra_dma_dequeue_req() from the UART ISR or tegra_stop_rx(), with the
+ * UART lock held and the status set to aborted. The caller pushes the data.
+ */
 static void tegra_rx_dma_complete_callback(struct tegra_dma_req *req)
 {
 	struct tegra_uart_port *t = req->dev;
 	struct uart_port *u = &t->uport;
-	struct tty_struct *tty = u->state->port.tty;
-
-	/* If we are here, DMA is stopped */
+	bool aborted = req->status == -TEGRA_DMA_REQ_ERROR_ABORTED;
+	unsigned long flags = 0;
 
 	dev_dbg(t->uport.dev, "%s: %d %d\n", __func__, req->bytes_transferred,
 		req->status);
-	if (req->bytes_transferred) {
-		t->uport.icount.rx += req->bytes_transferred;
-		tty_insert_flip_string(tty,
-			((unsigned char *)(req->virt_addr)),
-			req->bytes_transferred);
-	}
 
-	do_handle_rx_pio(t);
+	if (!aborted)
+		spin_lock_irqsave(&u->lock, flags);
+
+	tegra_rx_dma_push(t, req, req->bytes_transferred);
+	t->rx_pushed = 0;
+	t->rx_head = (t->rx_head + 1) % UART_RX_DMA_SEGS;
+
+	/* bytes short of a DMA word are left behind in the FIFO */
+	if (aborted)
+		do_handle_rx_pio(t);
+
+	/* the segment is free again, put it back at the end of the ring */
+	if (t->rx_in_progress)
+		tegra_dma_enqueue_req(t->rx_dma, req);
 
-	/* Push the read data later in caller place. */
-	if (req->status == -TEGRA_DMA_REQ_ERROR_ABORTED)
+	if (aborted)
 		return;
 
-	spin_unlock(&u->lock);
+	spin_unlock_irqrestore(&u->lock, flags);
 	tty_flip_buffer_push(u->state->port.tty);
-	spin_lock(&u->lock);
 }
 
 /* Lock already taken */
 static void do_handle_rx_dma(struct tegra_uart_port *t)
 {
 	struct uart_port *u = &t->uport;
+	struct tegra_dma_req *req = &t->rx_dma_req[t->rx_head];
+
 	if (t->rts_active)
 		set_rts(t, false);
-	tegra_dma_dequeue(t->rx_dma);
+
+	/* Push what the DMA has written so far without stopping it. Only a
+	 * tail that does not fill a DMA word needs the DMA stopped, so that
+	 * it can be read from the FIFO in order; the ring then continues
+	 * with the next segment.
+	 */
+	tegra_rx_dma_push(t, req,
+		tegra_dma_get_transfer_count(t->rx_dma, req, false));
+	if (uart_readb(t, UART_LSR) & UART_LSR_DR)
+		tegra_dma_dequeue_req(t->rx_dma, req);
+
 	tty_flip_buffer_push(u->state->port.tty);
-	/* enqueue the request again */
-	tegra_start_dma_rx(t);
 	if (t->rts_active)
 		set_rts(t, true);
 }
@@ -571,9 +639,10 @@ static void tegra_stop_rx(struct uart_port *u)
 		uart_writeb(t, ier, UART_IER);
 		t->rx_in_progress = 0;
 
-		if (t->use_rx_dma && t->rx_dma)
+		if (t->use_rx_dma && t->rx_dma) {
 			tegra_dma_dequeue(t->rx_dma);
-		else
+			tegra_dma_cancel(t->rx_dma);
+		} else
 			do_handle_rx_pio(t);
 
 		tty_flip_buffer_push(u->state->port.tty);
@@ -612,11 +681,11 @@ static void tegra_uart_free_rx_dma(struct tegra_uart_port *t)
 	tegra_dma_free_channel(t->rx_dma);
 	t->rx_dma = NULL;
 
-	if (likely(t->rx_dma_req.dest_addr))
-		dma_free_coherent(t->uport.dev, t->rx_dma_req.size,
-			t->rx_dma_req.virt_addr, t->rx_dma_req.dest_addr);
-	t->rx_dma_req.dest_addr = 0;
-	t->rx_dma_req.virt_addr = NULL;
+	if (likely(t->rx_dma_virt))
+		dma_free_coherent(t->uport.dev, UART_RX_DMA_BUFFER_SIZE,
+			t->rx_dma_virt, t->rx_dma_phys);
+	t->rx_dma_phys = 0;
+	t->rx_dma_virt = NULL;
 
 	t->use_rx_dma = false;
 }
@@ -724,8 +793,8 @@ static int tegra_uart_hw_init(struct tegra_uart_port *t)
 
 static int tegra_uart_init_rx_dma(struct tegra_uart_port *t)
 {
-	dma_addr_t rx_dma_phys;
-	void *rx_dma_virt;
+	struct tegra_dma_req *req;
+	int i;
 
 	t->rx_dma = tegra_dma_allocate_channel(TEGRA_DMA_MODE_CONTINUOUS);
 	if (!t->rx_dma) {
@@ -733,26 +802,30 @@ static int tegra_uart_init_rx_dma(struct tegra_uart_port *t)
 		return -ENODEV;
 	}
 
-	t->rx_dma_req.size = UART_RX_DMA_BUFFER_SIZE;
-	rx_dma_virt = dma_alloc_coherent(t->uport.dev,
-		t->rx_dma_req.size, &rx_dma_phys, GFP_KERNEL);
-	if (!rx_dma_virt) {
+	t->rx_dma_virt = dma_alloc_coherent(t->uport.dev,
+		UART_RX_DMA_BUFFER_SIZE, &t->rx_dma_phys, GFP_KERNEL);
+	if (!t->rx_dma_virt) {
 		dev_err(t->uport.dev, "DMA buffers allocate failed\n");
 		goto fail;
 	}
-	t->rx_dma_req.dest_addr = rx_dma_phys;
-	t->rx_dma_req.virt_addr = rx_dma_virt;
-
-	t->rx_dma_req.source_addr = (unsigned long)t->uport.mapbase;
-	t->rx_dma_req.source_wrap = 4;
-	t->rx_dma_req.dest_wrap = 0;
-	t->rx_dma_req.to_memory = 1;
-	t->rx_dma_req.source_bus_width = 8;
-	t->rx_dma_req.dest_bus_width = 32;
-	t->rx_dma_req.req_sel = dma_req_sel[t->uport.line];
-	t->rx_dma_req.complete = tegra_rx_dma_complete_callback;
-	t->rx_dma_req.threshold = tegra_rx_dma_threshold_callback;
-	t->rx_dma_req.dev = t;
+
+	for (i = 0; i < UART_RX_DMA_SEGS; i++) {
+		req = &t->rx_dma_req[i];
+		req->size = UART_RX_DMA_SEG_SIZE;
+		req->dest_addr = t->rx_dma_phys + i * UART_RX_DMA_SEG_SIZE;
+		req->virt_addr = t->rx_dma_virt + i * UART_RX_DMA_SEG_SIZE;
+
+		req->source_addr = (unsigned long)t->uport.mapbase;
+		req->source_wrap = 4;
+		req->dest_wrap = 0;
+		req->to_memory = 1;
+		req->source_bus_width = 8;
+		req->dest_bus_width = 32;
+		req->req_sel = dma_req_sel[t->uport.line];
+		req->complete = tegra_rx_dma_complete_callback;
+		req->threshold = tegra_rx_dma_threshold_callback;
+		req->dev = t;
+	}
 
 	return 0;
 fail:
@@ -140,6 +140,14 @@
 #define DATA_DIR_RX		(1 << 1)
 
 #define SPI_FIFO_DEPTH		32
+
+/* Largest SLINK DMA block, in words */
+#define SLINK_DMA_MAX_WORDS	0x10000
+
+/* Transfers with client buffers mapped in place run as one SLINK block,
+ * split into APB DMA segments of at most TEGRA_DMA_MAX_TRANSFER_SIZE.
+ */
+#define SPI_DMA_MAX_SEGS	2
 #define SLINK_DMA_TIMEOUT (msecs_to_jiffies(1000))
 
 
@@ -204,6 +212,14 @@ struct spi_tegra_data {
 	dma_addr_t		tx_buf_phys;
 	unsigned		cur_tx_pos;
 
+	/* Client buffers mapped for DMA in place of the bounce buffers */
+	bool			is_zero_copy;
+	struct scatterlist	rx_sg[SPI_DMA_MAX_SEGS];
+	struct scatterlist	tx_sg[SPI_DMA_MAX_SEGS];
+	dma_addr_t		rx_map;
+	dma_addr_t		tx_map;
+	unsigned		map_len;
+
 	unsigned		dma_buf_size;
 	unsigned		max_buf_size;
 	bool			is_curr_dma_xfer;
@@ -292,6 +308,35 @@ static unsigned long spi_tegra_get_packed_size(struct spi_tegra_data *tspi,
 	return val;
 }
 
+static bool spi_tegra_client_buf_dma_safe(const void *buf, unsigned len)
+{
+	if (!buf)
+		return true;
+	if ((unsigned long)buf & 0x3)
+		return false;
+	return virt_addr_valid(buf) && virt_addr_valid(buf + len - 1);
+}
+
+/*
+ * Large packed transfers with word aligned client buffers are mapped for
+ * DMA directly instead of being copied through the bounce buffers.
+ */
+static bool spi_tegra_can_map_client_buf(struct spi_tegra_data *tspi,
+	struct spi_transfer *t, unsigned remain_len)
+{
+	if (!tspi->is_dma_allowed || !tspi->is_packed)
+		return false;
+	if (remain_len <= tspi->dma_buf_size || (remain_len & 0x3))
+		return false;
+	if (t->tx_buf && !spi_tegra_client_buf_dma_safe(
+				t->tx_buf + tspi->cur_pos, remain_len))
+		return false;
+	if (t->rx_buf && !spi_tegra_client_buf_dma_safe(
+				t->rx_buf + tspi->cur_pos, remain_len))
+		return false;
+	return true;
+}
+
 static unsigned spi_tegra_calculate_curr_xfer_param(
 	struct spi_device *spi, struct spi_tegra_data *tspi,
 	struct spi_transfer *t)
@@ -315,7 +360,15 @@ static unsigned spi_tegra_calculate_curr_xfer_param(
 	}
 	tspi->packed_size = spi_tegra_get_packed_size(tspi, t);
 
-	if (tspi->is_packed) {
+	tspi->is_zero_copy = spi_tegra_can_map_client_buf(tspi, t, remain_len);
+	if (tspi->is_zero_copy) {
+		max_len = min_t(unsigned, SLINK_DMA_MAX_WORDS *
+				tspi->bytes_per_word,
+				SPI_DMA_MAX_SEGS * TEGRA_DMA_MAX_TRANSFER_SIZE);
+		max_len = min(remain_len, max_len);
+		tspi->curr_dma_words = max_len/tspi->bytes_per_word;
+		total_fifo_words = remain_len/4;
+	} else if (tspi->is_packed) {
 		max_len = min(remain_len, tspi->max_buf_size);
 		tspi->curr_dma_words = max_len/tspi->bytes_per_word;
 		total_fifo_words = remain_len/4;
@@ -451,6 +504,74 @@ static void spi_tegra_copy_spi_rxbuf_to_client_rxbuf(
 	tspi->cur_rx_pos += tspi->curr_dma_words * tspi->bytes_per_word;
 }
 
+static unsigned spi_tegra_fill_sg(struct scatterlist *sg, dma_addr_t addr,
+	unsigned len)
+{
+	unsigned nents = 0;
+	unsigned seg;
+
+	sg_init_table(sg, SPI_DMA_MAX_SEGS);
+	while (len) {
+		seg = min_t(unsigned, len, TEGRA_DMA_MAX_TRANSFER_SIZE);
+		sg_dma_address(&sg[nents]) = addr;
+		sg_dma_len(&sg[nents]) = seg;
+		addr += seg;
+		len -= seg;
+		nents++;
+	}
+	sg_mark_end(&sg[nents - 1]);
+	return nents;
+}
+
+static int spi_tegra_map_client_buf(struct spi_tegra_data *tspi,
+	struct spi_transfer *t, unsigned len)
+{
+	struct device *dev = &tspi->pdev->dev;
+
+	tspi->map_len = len;
+	if (tspi->cur_direction & DATA_DIR_TX) {
+		tspi->tx_map = dma_map_single(dev,
+				(void *)t->tx_buf + tspi->cur_tx_pos, len,
+				DMA_TO_DEVICE);
+		if (dma_mapping_error(dev, tspi->tx_map))
+			return -ENOMEM;
+		tspi->tx_dma_req.sg = tspi->tx_sg;
+		tspi->tx_dma_req.sg_len = spi_tegra_fill_sg(tspi->tx_sg,
+						tspi->tx_map, len);
+	}
+
+	if (tspi->cur_direction & DATA_DIR_RX) {
+		tspi->rx_map = dma_map_single(dev,
+				t->rx_buf + tspi->cur_rx_pos, len,
+				DMA_FROM_DEVICE);
+		if (dma_mapping_error(dev, tspi->rx_map)) {
+			if (tspi->cur_direction & DATA_DIR_TX)
+				dma_unmap_single(dev, tspi->tx_map, len,
+						DMA_TO_DEVICE);
+			return -ENOMEM;
+		}
+		tspi->rx_dma_req.sg = tspi->rx_sg;
+		tspi->rx_dma_req.sg_len = spi_tegra_fill_sg(tspi->rx_sg,
+						tspi->rx_map, len);
+	}
+	return 0;
+}
+
+static void spi_tegra_unmap_client_buf(struct spi_tegra_data *tspi)
+{
+	struct device *dev = &tspi->pdev->dev;
+
+	if (!tspi->is_zero_copy)
+		return;
+
+	if (tspi->cur_direction & DATA_DIR_TX)
+		dma_unmap_single(dev, tspi->tx_map, tspi->map_len,
+				DMA_TO_DEVICE);
+	if (tspi->cur_direction & DATA_DIR_RX)
+		dma_unmap_single(dev, tspi->rx_map, tspi->map_len,
+				DMA_FROM_DEVICE);
+}
+
 static int spi_tegra_start_dma_based_transfer(
 		struct spi_tegra_data *tspi, struct spi_transfer *t)
 {
@@ -486,14 +607,31 @@ static int spi_tegra_start_dma_based_transfer(
 	spi_tegra_writel(tspi, val, SLINK_DMA_CTL);
 	tspi->dma_control_reg = val;
 
+	tspi->tx_dma_req.sg = NULL;
+	tspi->rx_dma_req.sg = NULL;
+	if (tspi->is_zero_copy) {
+		ret = spi_tegra_map_client_buf(tspi, t, len);
+		if (ret < 0) {
+			dev_err(&tspi->pdev->dev, "Error in mapping client "
+						"buffers error = %d\n", ret);
+			tspi->is_zero_copy = false;
+			return ret;
+		}
+	}
+
 	if (tspi->cur_direction & DATA_DIR_TX) {
-		spi_tegra_copy_client_txbuf_to_spi_txbuf(tspi, t);
+		if (tspi->is_zero_copy)
+			tspi->cur_tx_pos += len;
+		else
+			spi_tegra_copy_client_txbuf_to_spi_txbuf(tspi, t);
 		wmb();
 		tspi->tx_dma_req.size = len;
 		ret = tegra_dma_enqueue_req(tspi->tx_dma, &tspi->tx_dma_req);
 		if (ret < 0) {
 			dev_err(&tspi->pdev->dev, "Error in starting tx dma "
 						" error = %d\n", ret);
+			spi_tegra_unmap_client_buf(tspi);
+			tspi->is_zero_copy = false;
 			return ret;
 		}
 
@@ -512,6 +650,8 @@ static int spi_tegra_start_dma_based_transfer(
 			if (tspi->cur_direction & DATA_DIR_TX)
 				tegra_dma_dequeue_req(tspi->tx_dma,
 							&tspi->tx_dma_req);
+			spi_tegra_unmap_client_buf(tspi);
+			tspi->is_zero_copy = false;
 			return ret;
 		}
 	}
@@ -772,8 +912,10 @@ static void spi_tegra_curr_transfer_complete(struct spi_tegra_data *tspi,
 			struct spi_transfer, transfer_list);
 		spi_tegra_start_transfer(spi, tspi->cur, false);
 	} else {
+		struct spi_message *done = m;
+
+		/* keep the controller busy while the client looks at done */
 		list_del(&m->queue);
-		m->complete(m->context);
 		if (!list_empty(&tspi->queue)) {
 			m = list_first_entry(&tspi->queue, struct spi_message,
 				queue);
@@ -794,6 +936,7 @@ static void spi_tegra_curr_transfer_complete(struct spi_tegra_data *tspi,
 				}
 			}
 		}
+		done->complete(done->context);
 	}
 }
 
@@ -904,6 +1047,7 @@ static irqreturn_t spi_tegra_isr_thread(int irq, void *context_data)
 	}
 
 	spin_lock_irqsave(&tspi->lock, flags);
+	spi_tegra_unmap_client_buf(tspi);
 	if (err) {
 		dev_err(&tspi->pdev->dev, "%s ERROR bit set 0x%x\n",
 					 __func__, tspi->status_reg);
@@ -916,8 +1060,12 @@ static irqreturn_t spi_tegra_isr_thread(int irq, void *context_data)
 		return IRQ_HANDLED;
 	}
 
-	if (tspi->cur_direction & DATA_DIR_RX)
-		spi_tegra_copy_spi_rxbuf_to_client_rxbuf(tspi, t);
+	if (tspi->cur_direction & DATA_DIR_RX) {
+		if (tspi->is_zero_copy)
+			tspi->cur_rx_pos += tspi->map_len;
+		else
+			spi_tegra_copy_spi_rxbuf_to_client_rxbuf(tspi, t);
+	}
 
 	if (tspi->cur_direction & DATA_DIR_TX)
 		tspi->cur_pos = tspi->cur_tx_pos;
@@ -19,6 +19,7 @@
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
@@ -28,16 +29,47 @@
 #include <linux/poll.h>
 #include <linux/debugfs.h>
 #include <linux/rbtree.h>
+#include <linux/rwsem.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
 
 #include "binder.h"
 
-static DEFINE_MUTEX(binder_lock);
+#define CREATE_TRACE_POINTS
+#include <trace/events/binder.h>
+
+/*
+ * Locking
+ *
+ * binder_lock is taken shared by every ioctl and exclusively by everything
+ * that frees a binder_proc or binder_thread (release, flush, put_files,
+ * BINDER_THREAD_EXIT) or that changes the context manager.  Holding it shared
+ * therefore keeps every proc and thread alive, and the locks below only
+ * protect their contents:
+ *
+ * proc->lock        (mutex) the thread, node and ref trees of the proc, the
+ *                   refs it owns and their death notifications.
+ * proc->alloc_lock  (mutex) the buffer allocator and pages of the proc.
+ * node->lock        (spinlock) node reference counts, flags and node->refs.
+ * proc->todo_lock   (spinlock) every work list owned by the proc
+ *                   (proc->todo, thread->todo, node->async_todo and
+ *                   delivered_death) and the looper thread counts.
+ * binder_stack_lock (spinlock) transaction stacks, the t->buffer <->
+ *                   buffer->transaction links and thread->return_error.
+ *
+ * Nesting order is binder_lock, proc->lock, proc->alloc_lock, node->lock,
+ * binder_dead_nodes_lock, proc->todo_lock.  Two proc->lock are never held at
+ * the same time, and nothing is taken while binder_stack_lock is held.
+ */
+static DECLARE_RWSEM(binder_lock);
 static DEFINE_MUTEX(binder_deferred_lock);
+static DEFINE_SPINLOCK(binder_stack_lock);
+static DEFINE_SPINLOCK(binder_dead_nodes_lock);
+static DEFINE_SPINLOCK(binder_transaction_log_lock);
 
 static HLIST_HEAD(binder_procs);
 static HLIST_HEAD(binder_deferred_list);
@@ -47,7 +79,7 @@ static struct dentry *binder_debugfs_dir_entry_root;
 static struct dentry *binder_debugfs_dir_entry_proc;
 static struct binder_node *binder_context_mgr_node;
 static uid_t binder_context_mgr_uid = -1;
-static int binder_last_id;
+static atomic_t binder_last_id;
 static struct workqueue_struct *binder_deferred_workqueue;
 
 #define BINDER_DEBUG_ENTRY(name) \
@@ -145,23 +177,74 @@ enum binder_stat_types {
 	BINDER_STAT_COUNT
 };
 
+enum binder_lock_types {
+	BINDER_LOCK_GLOBAL,
+	BINDER_LOCK_PROC,
+	BINDER_LOCK_ALLOC,
+	BINDER_LOCK_COUNT
+};
+
+/*
+ * Small parcels are recycled through per-proc fast bins instead of being
+ * merged back into the size-sorted free tree.  A freed buffer is parked in
+ * the largest bin it can satisfy, so any buffer taken from bin i holds at
+ * least BINDER_BIN_SIZE(i) bytes.  Parked buffers stay marked in-use, which
+ * keeps their neighbours from merging over them, and their pages stay
+ * mapped.
+ */
+#define BINDER_BIN_SHIFT	5	/* smallest bin is 32 bytes */
+#define BINDER_BIN_COUNT	4	/* 32, 64, 128 and 256 bytes */
+#define BINDER_BIN_DEPTH	8	/* buffers parked per bin */
+#define BINDER_BIN_SIZE(bin)	((size_t)1 << (BINDER_BIN_SHIFT + (bin)))
+
+/* idle buffer pages kept mapped per proc instead of being freed */
+#define BINDER_PAGE_CACHE_PAGES	8
+
 struct binder_stats {
-	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
-	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
-	int obj_created[BINDER_STAT_COUNT];
-	int obj_deleted[BINDER_STAT_COUNT];
+	atomic_t br[_IOC_NR(BR_FAILED_REPLY) + 1];
+	atomic_t bc[_IOC_NR(BC_REPLY_SG) + 1];
+	atomic_t obj_created[BINDER_STAT_COUNT];
+	atomic_t obj_deleted[BINDER_STAT_COUNT];
+	atomic_t lock_contended[BINDER_LOCK_COUNT];
+	atomic_t bin_hit[BINDER_BIN_COUNT];
+	atomic_t bin_miss[BINDER_BIN_COUNT];
+	atomic_t page_cache_hit;
+	atomic_t page_cache_miss;
+	atomic_t spurious_wakeup;
 };
 
 static struct binder_stats binder_stats;
 
+/*
+ * Transaction latency, in log2 buckets of microseconds: bucket 0 counts
+ * waits under 1us, bucket i waits under 2^i us and the last bucket
+ * everything longer.  Queue latency runs from binder_transaction()
+ * enqueueing the work to binder_thread_read() handing out BR_TRANSACTION,
+ * reply latency from there to the server's BC_REPLY.
+ */
+enum binder_latency_types {
+	BINDER_LATENCY_QUEUE_ONEWAY,
+	BINDER_LATENCY_QUEUE_TWOWAY,
+	BINDER_LATENCY_REPLY,
+	BINDER_LATENCY_COUNT
+};
+
+#define BINDER_LATENCY_BUCKETS	24
+
+struct binder_latency {
+	atomic_t hist[BINDER_LATENCY_COUNT][BINDER_LATENCY_BUCKETS];
+};
+
+static struct binder_latency binder_latency;
+
 static inline void binder_stats_deleted(enum binder_stat_types type)
 {
-	binder_stats.obj_deleted[type]++;
+	atomic_inc(&binder_stats.obj_deleted[type]);
 }
 
 static inline void binder_stats_created(enum binder_stat_types type)
 {
-	binder_stats.obj_created[type]++;
+	atomic_inc(&binder_stats.obj_created[type]);
 }
 
 struct binder_transaction_log_entry {
@@ -188,6 +271,8 @@ static struct binder_transaction_log_entry *binder_transaction_log_add(
 	struct binder_transaction_log *log)
 {
 	struct binder_transaction_log_entry *e;
+
+	spin_lock(&binder_transaction_log_lock);
 	e = &log->entry[log->next];
 	memset(e, 0, sizeof(*e));
 	log->next++;
@@ -195,6 +280,7 @@ static struct binder_transaction_log_entry *binder_transaction_log_add(
 		log->next = 0;
 		log->full = 1;
 	}
+	spin_unlock(&binder_transaction_log_lock);
 	return e;
 }
 
@@ -212,6 +298,7 @@ struct binder_work {
 
 struct binder_node {
 	int debug_id;
+	spinlock_t lock;
 	struct binder_work work;
 	union {
 		struct rb_node rb_node;
@@ -222,6 +309,7 @@ struct binder_node {
 	int internal_strong_refs;
 	int local_weak_refs;
 	int local_strong_refs;
+	int tmp_refs; /* pins the node while no proc->lock is held */
 	void __user *ptr;
 	void __user *cookie;
 	unsigned has_strong_ref:1;
@@ -258,8 +346,11 @@ struct binder_ref {
 
 struct binder_buffer {
 	struct list_head entry; /* free and allocated entries by addesss */
-	struct rb_node rb_node; /* free entry by size or allocated entry */
-				/* by address */
+	union {
+		struct rb_node rb_node; /* free entry by size or allocated */
+					/* entry by address */
+		struct list_head bin_entry; /* parked in a fast bin */
+	};
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
@@ -270,6 +361,7 @@ struct binder_buffer {
 	struct binder_node *target_node;
 	size_t data_size;
 	size_t offsets_size;
+	size_t extra_buffers_size;
 	uint8_t data[0];
 };
 
@@ -281,6 +373,9 @@ enum binder_deferred_state {
 
 struct binder_proc {
 	struct hlist_node proc_node;
+	struct mutex lock;
+	struct mutex alloc_lock;
+	spinlock_t todo_lock;
 	struct rb_root threads;
 	struct rb_root nodes;
 	struct rb_root refs_by_desc;
@@ -298,12 +393,17 @@ struct binder_proc {
 	struct rb_root free_buffers;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
+	struct list_head bins[BINDER_BIN_COUNT];
+	int bin_count[BINDER_BIN_COUNT];
 
 	struct page **pages;
+	int pages_cached;
+	struct binder_latency latency;
 	size_t buffer_size;
 	uint32_t buffer_free;
 	struct list_head todo;
 	wait_queue_head_t wait;
+	struct list_head waiting_threads; /* idle loopers, most recent first */
 	struct binder_stats stats;
 	struct list_head delivered_death;
 	int max_threads;
@@ -330,6 +430,8 @@ struct binder_thread {
 	int looper;
 	struct binder_transaction *transaction_stack;
 	struct list_head todo;
+	struct list_head waiting_thread_node;
+	int last_cpu; /* cpu the thread last ran on before going idle */
 	uint32_t return_error; /* Write failed, return error code in read buf */
 	uint32_t return_error2; /* Write failed, return error code in read */
 		/* buffer. Used when sending a reply to a dead process that */
@@ -355,11 +457,155 @@ struct binder_transaction {
 	long	priority;
 	long	saved_priority;
 	uid_t	sender_euid;
+	ktime_t	enqueue_time;
+	ktime_t	dequeue_time;
 };
 
 static void
 binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer);
 
+static inline void binder_lock_contended(struct binder_proc *proc,
+					 enum binder_lock_types type)
+{
+	atomic_inc(&binder_stats.lock_contended[type]);
+	if (proc)
+		atomic_inc(&proc->stats.lock_contended[type]);
+}
+
+static inline void binder_stats_bin(struct binder_proc *proc, int bin,
+				    int hit)
+{
+	if (hit) {
+		atomic_inc(&binder_stats.bin_hit[bin]);
+		atomic_inc(&proc->stats.bin_hit[bin]);
+	} else {
+		atomic_inc(&binder_stats.bin_miss[bin]);
+		atomic_inc(&proc->stats.bin_miss[bin]);
+	}
+}
+
+static inline void binder_stats_page_cache(struct binder_proc *proc,
+					   int hit, int count)
+{
+	if (hit) {
+		atomic_add(count, &binder_stats.page_cache_hit);
+		atomic_add(count, &proc->stats.page_cache_hit);
+	} else {
+		atomic_add(count, &binder_stats.page_cache_miss);
+		atomic_add(count, &proc->stats.page_cache_miss);
+	}
+}
+
+static void binder_latency_add(struct binder_proc *proc,
+			       enum binder_latency_types type,
+			       ktime_t start, ktime_t end)
+{
+	s64 us = ktime_us_delta(end, start);
+	int bucket;
+
+	if (us <= 0)
+		bucket = 0;
+	else if (us >= (1LL << (BINDER_LATENCY_BUCKETS - 2)))
+		bucket = BINDER_LATENCY_BUCKETS - 1;
+	else
+		bucket = fls((u32)us);
+	atomic_inc(&binder_latency.hist[type][bucket]);
+	atomic_inc(&proc->latency.hist[type][bucket]);
+}
+
+/*
+ * Idle loopers sleep on their own wait queue and park themselves on
+ * proc->waiting_threads, so queueing proc work wakes exactly one of them.
+ * The most recently idled thread that last ran on the waker's cpu is
+ * preferred, as its cache is the most likely to still be warm; otherwise
+ * the most recently idled thread is used.  Only when no looper is parked
+ * is proc->wait woken, for threads using poll() or non-blocking reads.
+ *
+ * Called with proc->todo_lock held.
+ */
+static void __binder_wakeup_proc(struct binder_proc *proc)
+{
+	struct binder_thread *thread;
+	struct binder_thread *target = NULL;
+	int cpu = raw_smp_processor_id();
+
+	list_for_each_entry(thread, &proc->waiting_threads,
+			    waiting_thread_node) {
+		if (thread->last_cpu == cpu) {
+			target = thread;
+			break;
+		}
+	}
+	if (target == NULL && !list_empty(&proc->waiting_threads))
+		target = list_first_entry(&proc->waiting_threads,
+					  struct binder_thread,
+					  waiting_thread_node);
+	if (target) {
+		list_del_init(&target->waiting_thread_node);
+		wake_up_interruptible(&target->wait);
+	} else
+		wake_up_interruptible(&proc->wait);
+}
+
+static void binder_wakeup_proc(struct binder_proc *proc)
+{
+	spin_lock(&proc->todo_lock);
+	__binder_wakeup_proc(proc);
+	spin_unlock(&proc->todo_lock);
+}
+
+static inline void binder_read_lock(void)
+{
+	if (!down_read_trylock(&binder_lock)) {
+		binder_lock_contended(NULL, BINDER_LOCK_GLOBAL);
+		down_read(&binder_lock);
+	}
+}
+
+static inline void binder_read_unlock(void)
+{
+	up_read(&binder_lock);
+}
+
+static inline void binder_write_lock(void)
+{
+	if (!down_write_trylock(&binder_lock)) {
+		binder_lock_contended(NULL, BINDER_LOCK_GLOBAL);
+		down_write(&binder_lock);
+	}
+}
+
+static inline void binder_write_unlock(void)
+{
+	up_write(&binder_lock);
+}
+
+static inline void binder_proc_lock(struct binder_proc *proc)
+{
+	if (!mutex_trylock(&proc->lock)) {
+		binder_lock_contended(proc, BINDER_LOCK_PROC);
+		mutex_lock(&proc->lock);
+	}
+}
+
+static inline void binder_proc_unlock(struct binder_proc *proc)
+{
+	mutex_unlock(&proc->lock);
+}
+
+static inline void binder_alloc_lock(struct binder_proc *proc)
+{
+	if (!mutex_trylock(&proc->alloc_lock)) {
+		binder_lock_contended(proc, BINDER_LOCK_ALLOC);
+		mutex_lock(&proc->alloc_lock);
+	}
+}
+
+static inline void binder_alloc_unlock(struct binder_proc *proc)
+{
+	mutex_unlock(&proc->alloc_lock);
+}
+
 /*
  * copied from get_unused_fd_flags
  */
@@ -624,6 +870,29 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	if (end <= start)
 		return 0;
 
+	/*
+	 * Pages freed while the cache has room stay mapped, and a range
+	 * that is already fully mapped is handed out again without taking
+	 * mmap_sem or touching the page tables.  The cached pages only ever
+	 * held data that was delivered to this proc.
+	 */
+	if (allocate) {
+		int cached = 0;
+
+		for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE)
+			if (proc->pages[(page_addr - proc->buffer) / PAGE_SIZE])
+				cached++;
+		if (cached == (end - start) / PAGE_SIZE) {
+			proc->pages_cached -= cached;
+			binder_stats_page_cache(proc, 1, cached);
+			return 0;
+		}
+	} else if (proc->pages_cached + (end - start) / PAGE_SIZE <=
+		   BINDER_PAGE_CACHE_PAGES) {
+		proc->pages_cached += (end - start) / PAGE_SIZE;
+		return 0;
+	}
+
 	if (vma)
 		mm = NULL;
 	else
@@ -648,7 +917,12 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		struct page **page_array_ptr;
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 
-		BUG_ON(*page);
+		if (*page) {
+			proc->pages_cached--;
+			binder_stats_page_cache(proc, 1, 1);
+			continue;
+		}
+		binder_stats_page_cache(proc, 0, 1);
 		*page = alloc_page(GFP_KERNEL | __GFP_ZERO);
 		if (*page == NULL) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
@@ -705,17 +979,44 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+static int binder_bin_alloc_index(size_t size)
+{
+	int bin;
+
+	for (bin = 0; bin < BINDER_BIN_COUNT; bin++)
+		if (size <= BINDER_BIN_SIZE(bin))
+			return bin;
+	return -1;
+}
+
+static int binder_bin_free_index(size_t buffer_size)
 {
-	struct rb_node *n = proc->free_buffers.rb_node;
+	int bin;
+
+	if (buffer_size >= 2 * BINDER_BIN_SIZE(BINDER_BIN_COUNT - 1))
+		return -1;
+	for (bin = BINDER_BIN_COUNT - 1; bin >= 0; bin--)
+		if (buffer_size >= BINDER_BIN_SIZE(bin))
+			return bin;
+	return -1;
+}
+
+static void binder_flush_bins(struct binder_proc *proc);
+
+static struct binder_buffer *__binder_alloc_buf(struct binder_proc *proc,
+						size_t data_size,
+						size_t offsets_size,
+						size_t extra_buffers_size,
+						int is_async)
+{
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
-	struct rb_node *best_fit = NULL;
+	struct rb_node *best_fit;
 	void *has_page_addr;
 	void *end_page_addr;
 	size_t size;
+	int bin;
 
 	if (proc->vma == NULL) {
 		printk(KERN_ERR "binder: %d: binder_alloc_buf, no vma\n",
@@ -732,6 +1033,14 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
+	size += ALIGN(extra_buffers_size, sizeof(void *));
+	if (size < extra_buffers_size) {
+		binder_user_error("binder: %d: got transaction with invalid "
+			"extra buffers size %zd\n", proc->pid,
+			extra_buffers_size);
+		return NULL;
+	}
+
 	if (is_async &&
 	    proc->free_async_space < size + sizeof(struct binder_buffer)) {
 		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
@@ -740,6 +1049,28 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
+	bin = binder_bin_alloc_index(size);
+	if (bin >= 0) {
+		if (!list_empty(&proc->bins[bin])) {
+			buffer = list_first_entry(&proc->bins[bin],
+						  struct binder_buffer,
+						  bin_entry);
+			list_del(&buffer->bin_entry);
+			proc->bin_count[bin]--;
+			binder_stats_bin(proc, bin, 1);
+			binder_insert_allocated_buffer(proc, buffer);
+			binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+				     "binder: %d: binder_alloc_buf size %zd got "
+				     "%p from bin %d\n", proc->pid, size, buffer,
+				     bin);
+			goto found;
+		}
+		binder_stats_bin(proc, bin, 0);
+	}
+
+retry:
+	n = proc->free_buffers.rb_node;
+	best_fit = NULL;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
@@ -756,6 +1087,12 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		}
 	}
 	if (best_fit == NULL) {
+		for (bin = 0; bin < BINDER_BIN_COUNT; bin++) {
+			if (proc->bin_count[bin]) {
+				binder_flush_bins(proc);
+				goto retry;
+			}
+		}
 		printk(KERN_ERR "binder: %d: binder_alloc_buf size %zd failed, "
 		       "no address space\n", proc->pid, size);
 		return NULL;
@@ -797,9 +1134,12 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: binder_alloc_buf size %zd got "
 		     "%p\n", proc->pid, size, buffer);
+found:
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
+	buffer->extra_buffers_size = extra_buffers_size;
 	buffer->async_transaction = is_async;
+	buffer->allow_user_free = 0;
 	if (is_async) {
 		proc->free_async_space -= size + sizeof(struct binder_buffer);
 		binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
@@ -811,6 +1151,23 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size,
+					      size_t extra_buffers_size,
+					      int is_async)
+{
+	struct binder_buffer *buffer;
+
+	binder_alloc_lock(proc);
+	buffer = __binder_alloc_buf(proc, data_size, offsets_size,
+				    extra_buffers_size, is_async);
+	binder_alloc_unlock(proc);
+	trace_binder_alloc_buf(proc->pid, data_size, offsets_size, is_async,
+			       buffer != NULL);
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -868,15 +1225,68 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
-static void binder_free_buf(struct binder_proc *proc,
-			    struct binder_buffer *buffer)
+/* buffer must already be off the allocated tree */
+static void binder_release_buf(struct binder_proc *proc,
+			       struct binder_buffer *buffer)
+{
+	size_t buffer_size = binder_buffer_size(proc, buffer);
+
+	binder_update_page_range(proc, 0,
+		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
+		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
+		NULL);
+	buffer->free = 1;
+	if (!list_is_last(&buffer->entry, &proc->buffers)) {
+		struct binder_buffer *next = list_entry(buffer->entry.next,
+						struct binder_buffer, entry);
+		if (next->free) {
+			rb_erase(&next->rb_node, &proc->free_buffers);
+			binder_delete_free_buffer(proc, next);
+		}
+	}
+	if (proc->buffers.next != &buffer->entry) {
+		struct binder_buffer *prev = list_entry(buffer->entry.prev,
+						struct binder_buffer, entry);
+		if (prev->free) {
+			binder_delete_free_buffer(proc, buffer);
+			rb_erase(&prev->rb_node, &proc->free_buffers);
+			buffer = prev;
+		}
+	}
+	binder_insert_free_buffer(proc, buffer);
+}
+
+static void binder_flush_bins(struct binder_proc *proc)
+{
+	struct binder_buffer *buffer;
+	int bin;
+
+	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+		     "binder: %d: flush bins\n", proc->pid);
+
+	for (bin = 0; bin < BINDER_BIN_COUNT; bin++) {
+		while (!list_empty(&proc->bins[bin])) {
+			buffer = list_first_entry(&proc->bins[bin],
+						  struct binder_buffer,
+						  bin_entry);
+			list_del(&buffer->bin_entry);
+			proc->bin_count[bin]--;
+			binder_release_buf(proc, buffer);
+		}
+	}
+}
+
+static void __binder_free_buf(struct binder_proc *proc,
+			      struct binder_buffer *buffer)
 {
 	size_t size, buffer_size;
+	int bin;
 
 	buffer_size = binder_buffer_size(proc, buffer);
 
 	size = ALIGN(buffer->data_size, sizeof(void *)) +
-		ALIGN(buffer->offsets_size, sizeof(void *));
+		ALIGN(buffer->offsets_size, sizeof(void *)) +
+		ALIGN(buffer->extra_buffers_size, sizeof(void *));
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: binder_free_buf %p size %zd buffer"
@@ -897,30 +1307,23 @@ static void binder_free_buf(struct binder_proc *proc,
 			     proc->free_async_space);
 	}
 
-	binder_update_page_range(proc, 0,
-		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
-		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
-		NULL);
 	rb_erase(&buffer->rb_node, &proc->allocated_buffers);
-	buffer->free = 1;
-	if (!list_is_last(&buffer->entry, &proc->buffers)) {
-		struct binder_buffer *next = list_entry(buffer->entry.next,
-						struct binder_buffer, entry);
-		if (next->free) {
-			rb_erase(&next->rb_node, &proc->free_buffers);
-			binder_delete_free_buffer(proc, next);
-		}
-	}
-	if (proc->buffers.next != &buffer->entry) {
-		struct binder_buffer *prev = list_entry(buffer->entry.prev,
-						struct binder_buffer, entry);
-		if (prev->free) {
-			binder_delete_free_buffer(proc, buffer);
-			rb_erase(&prev->rb_node, &proc->free_buffers);
-			buffer = prev;
-		}
+
+	bin = binder_bin_free_index(buffer_size);
+	if (bin >= 0 && proc->bin_count[bin] < BINDER_BIN_DEPTH) {
+		list_add(&buffer->bin_entry, &proc->bins[bin]);
+		proc->bin_count[bin]++;
+		return;
 	}
-	binder_insert_free_buffer(proc, buffer);
+	binder_release_buf(proc, buffer);
+}
+
+static void binder_free_buf(struct binder_proc *proc,
+			    struct binder_buffer *buffer)
+{
+	binder_alloc_lock(proc);
+	__binder_free_buf(proc, buffer);
+	binder_alloc_unlock(proc);
 }
 
 static struct binder_node *binder_get_node(struct binder_proc *proc,
@@ -968,7 +1371,8 @@ static struct binder_node *binder_new_node(struct binder_proc *proc,
 	binder_stats_created(BINDER_STAT_NODE);
 	rb_link_node(&node->rb_node, parent, p);
 	rb_insert_color(&node->rb_node, &proc->nodes);
-	node->debug_id = ++binder_last_id;
+	node->debug_id = atomic_inc_return(&binder_last_id);
+	spin_lock_init(&node->lock);
 	node->proc = proc;
 	node->ptr = ptr;
 	node->cookie = cookie;
@@ -985,6 +1389,9 @@ static struct binder_node *binder_new_node(struct binder_proc *proc,
 static int binder_inc_node(struct binder_node *node, int strong, int internal,
 			   struct list_head *target_list)
 {
+	int ret = 0;
+
+	spin_lock(&node->lock);
 	if (strong) {
 		if (internal) {
 			if (target_list == NULL &&
@@ -993,14 +1400,17 @@ static int binder_inc_node(struct binder_node *node, int strong, int internal,
 			    node->has_strong_ref)) {
 				printk(KERN_ERR "binder: invalid inc strong "
 					"node for %d\n", node->debug_id);
-				return -EINVAL;
+				ret = -EINVAL;
+				goto out;
 			}
 			node->internal_strong_refs++;
 		} else
 			node->local_strong_refs++;
 		if (!node->has_strong_ref && target_list) {
+			spin_lock(&node->proc->todo_lock);
 			list_del_init(&node->work.entry);
 			list_add_tail(&node->work.entry, target_list);
+			spin_unlock(&node->proc->todo_lock);
 		}
 	} else {
 		if (!internal)
@@ -1009,57 +1419,102 @@ static int binder_inc_node(struct binder_node *node, int strong, int internal,
 			if (target_list == NULL) {
 				printk(KERN_ERR "binder: invalid inc weak node "
 					"for %d\n", node->debug_id);
-				return -EINVAL;
+				ret = -EINVAL;
+				goto out;
 			}
+			spin_lock(&node->proc->todo_lock);
 			list_add_tail(&node->work.entry, target_list);
+			spin_unlock(&node->proc->todo_lock);
 		}
 	}
-	return 0;
+out:
+	spin_unlock(&node->lock);
+	return ret;
+}
+
+static int binder_node_unreferenced(struct binder_node *node)
+{
+	return hlist_empty(&node->refs) && !node->local_strong_refs &&
+		!node->local_weak_refs && !node->tmp_refs;
+}
+
+/*
+ * Called with node->lock held once a reference count of the node has
+ * dropped to zero; releases node->lock.  A node whose proc is still alive
+ * can only be unlinked under that proc's lock, so it is queued on the owner
+ * instead, and binder_thread_read() either sends BR_RELEASE/BR_DECREFS or
+ * frees it.
+ */
+static void binder_node_put_locked(struct binder_node *node)
+{
+	struct binder_proc *proc = node->proc;
+
+	if (proc && (node->has_strong_ref || node->has_weak_ref ||
+		     binder_node_unreferenced(node))) {
+		spin_lock(&proc->todo_lock);
+		if (list_empty(&node->work.entry)) {
+			list_add_tail(&node->work.entry, &proc->todo);
+			__binder_wakeup_proc(proc);
+		}
+		spin_unlock(&proc->todo_lock);
+		spin_unlock(&node->lock);
+		return;
+	}
+	if (proc || !binder_node_unreferenced(node)) {
+		spin_unlock(&node->lock);
+		return;
+	}
+	list_del_init(&node->work.entry);
+	spin_lock(&binder_dead_nodes_lock);
+	hlist_del(&node->dead_node);
+	spin_unlock(&binder_dead_nodes_lock);
+	spin_unlock(&node->lock);
+	binder_debug(BINDER_DEBUG_INTERNAL_REFS,
+		     "binder: dead node %d deleted\n", node->debug_id);
+	kfree(node);
+	binder_stats_deleted(BINDER_STAT_NODE);
 }
 
 static int binder_dec_node(struct binder_node *node, int strong, int internal)
 {
+	spin_lock(&node->lock);
 	if (strong) {
 		if (internal)
 			node->internal_strong_refs--;
 		else
 			node->local_strong_refs--;
-		if (node->local_strong_refs || node->internal_strong_refs)
+		if (node->local_strong_refs || node->internal_strong_refs) {
+			spin_unlock(&node->lock);
 			return 0;
+		}
 	} else {
 		if (!internal)
 			node->local_weak_refs--;
-		if (node->local_weak_refs || !hlist_empty(&node->refs))
+		if (node->local_weak_refs || !hlist_empty(&node->refs)) {
+			spin_unlock(&node->lock);
 			return 0;
-	}
-	if (node->proc && (node->has_strong_ref || node->has_weak_ref)) {
-		if (list_empty(&node->work.entry)) {
-			list_add_tail(&node->work.entry, &node->proc->todo);
-			wake_up_interruptible(&node->proc->wait);
-		}
-	} else {
-		if (hlist_empty(&node->refs) && !node->local_strong_refs &&
-		    !node->local_weak_refs) {
-			list_del_init(&node->work.entry);
-			if (node->proc) {
-				rb_erase(&node->rb_node, &node->proc->nodes);
-				binder_debug(BINDER_DEBUG_INTERNAL_REFS,
-					     "binder: refless node %d deleted\n",
-					     node->debug_id);
-			} else {
-				hlist_del(&node->dead_node);
-				binder_debug(BINDER_DEBUG_INTERNAL_REFS,
-					     "binder: dead node %d deleted\n",
-					     node->debug_id);
-			}
-			kfree(node);
-			binder_stats_deleted(BINDER_STAT_NODE);
 		}
 	}
-
+	binder_node_put_locked(node);
 	return 0;
 }
 
+static void binder_inc_node_tmpref(struct binder_node *node)
+{
+	spin_lock(&node->lock);
+	node->tmp_refs++;
+	spin_unlock(&node->lock);
+}
+
+static void binder_dec_node_tmpref(struct binder_node *node)
+{
+	spin_lock(&node->lock);
+	if (--node->tmp_refs || !binder_node_unreferenced(node)) {
+		spin_unlock(&node->lock);
+		return;
+	}
+	binder_node_put_locked(node);
+}
 
 static struct binder_ref *binder_get_ref(struct binder_proc *proc,
 					 uint32_t desc)
@@ -1103,7 +1558,7 @@ static struct binder_ref *binder_get_ref_for_node(struct binder_proc *proc,
 	if (new_ref == NULL)
 		return NULL;
 	binder_stats_created(BINDER_STAT_REF);
-	new_ref->debug_id = ++binder_last_id;
+	new_ref->debug_id = atomic_inc_return(&binder_last_id);
 	new_ref->proc = proc;
 	new_ref->node = node;
 	rb_link_node(&new_ref->rb_node_node, parent, p);
@@ -1132,7 +1587,9 @@ static struct binder_ref *binder_get_ref_for_node(struct binder_proc *proc,
 	rb_link_node(&new_ref->rb_node_desc, parent, p);
 	rb_insert_color(&new_ref->rb_node_desc, &proc->refs_by_desc);
 	if (node) {
+		spin_lock(&node->lock);
 		hlist_add_head(&new_ref->node_entry, &node->refs);
+		spin_unlock(&node->lock);
 
 		binder_debug(BINDER_DEBUG_INTERNAL_REFS,
 			     "binder: %d new ref %d desc %d for "
@@ -1158,14 +1615,18 @@ static void binder_delete_ref(struct binder_ref *ref)
 	rb_erase(&ref->rb_node_node, &ref->proc->refs_by_node);
 	if (ref->strong)
 		binder_dec_node(ref->node, 1, 1);
+	spin_lock(&ref->node->lock);
 	hlist_del(&ref->node_entry);
+	spin_unlock(&ref->node->lock);
 	binder_dec_node(ref->node, 0, 1);
 	if (ref->death) {
 		binder_debug(BINDER_DEBUG_DEAD_BINDER,
 			     "binder: %d delete ref %d desc %d "
 			     "has death notification\n", ref->proc->pid,
 			     ref->debug_id, ref->desc);
+		spin_lock(&ref->proc->todo_lock);
 		list_del(&ref->death->work.entry);
+		spin_unlock(&ref->proc->todo_lock);
 		kfree(ref->death);
 		binder_stats_deleted(BINDER_STAT_DEATH);
 	}
@@ -1228,6 +1689,7 @@ static int binder_dec_ref(struct binder_ref *ref, int strong)
 	return 0;
 }
 
+/* Called with binder_stack_lock held */
 static void binder_pop_transaction(struct binder_thread *target_thread,
 				   struct binder_transaction *t)
 {
@@ -1245,8 +1707,9 @@ static void binder_pop_transaction(struct binder_thread *target_thread,
 	binder_stats_deleted(BINDER_STAT_TRANSACTION);
 }
 
-static void binder_send_failed_reply(struct binder_transaction *t,
-				     uint32_t error_code)
+/* Called with binder_stack_lock held */
+static void __binder_send_failed_reply(struct binder_transaction *t,
+				       uint32_t error_code)
 {
 	struct binder_thread *target_thread;
 	BUG_ON(t->flags & TF_ONE_WAY);
@@ -1300,6 +1763,14 @@ static void binder_send_failed_reply(struct binder_transaction *t,
 	}
 }
 
+static void binder_send_failed_reply(struct binder_transaction *t,
+				     uint32_t error_code)
+{
+	spin_lock(&binder_stack_lock);
+	__binder_send_failed_reply(t, error_code);
+	spin_unlock(&binder_stack_lock);
+}
+
 static void binder_transaction_buffer_release(struct binder_proc *proc,
 					      struct binder_buffer *buffer,
 					      size_t *failed_at)
@@ -1334,8 +1805,12 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 		switch (fp->type) {
 		case BINDER_TYPE_BINDER:
 		case BINDER_TYPE_WEAK_BINDER: {
-			struct binder_node *node = binder_get_node(proc, fp->binder);
+			struct binder_node *node;
+
+			binder_proc_lock(proc);
+			node = binder_get_node(proc, fp->binder);
 			if (node == NULL) {
+				binder_proc_unlock(proc);
 				printk(KERN_ERR "binder: transaction release %d"
 				       " bad node %p\n", debug_id, fp->binder);
 				break;
@@ -1344,11 +1819,16 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 				     "        node %d u%p\n",
 				     node->debug_id, node->ptr);
 			binder_dec_node(node, fp->type == BINDER_TYPE_BINDER, 0);
+			binder_proc_unlock(proc);
 		} break;
 		case BINDER_TYPE_HANDLE:
 		case BINDER_TYPE_WEAK_HANDLE: {
-			struct binder_ref *ref = binder_get_ref(proc, fp->handle);
+			struct binder_ref *ref;
+
+			binder_proc_lock(proc);
+			ref = binder_get_ref(proc, fp->handle);
 			if (ref == NULL) {
+				binder_proc_unlock(proc);
 				printk(KERN_ERR "binder: transaction release %d"
 				       " bad handle %ld\n", debug_id,
 				       fp->handle);
@@ -1358,6 +1838,7 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 				     "        ref %d desc %d (node %d)\n",
 				     ref->debug_id, ref->desc, ref->node->debug_id);
 			binder_dec_ref(ref, fp->type == BINDER_TYPE_HANDLE);
+			binder_proc_unlock(proc);
 		} break;
 
 		case BINDER_TYPE_FD:
@@ -1367,6 +1848,10 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 				task_close_fd(proc, fp->handle);
 			break;
 
+		case BINDER_TYPE_PTR:
+			/* the gathered copy goes with the buffer */
+			break;
+
 		default:
 			printk(KERN_ERR "binder: transaction release %d bad "
 			       "object type %lx\n", debug_id, fp->type);
@@ -1377,11 +1862,13 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
-			       struct binder_transaction_data *tr, int reply)
+			       struct binder_transaction_data *tr, int reply,
+			       size_t extra_buffers_size)
 {
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
 	size_t *offp, *off_end;
+	uint8_t *sg_bufp, *sg_buf_end;
 	struct binder_proc *target_proc;
 	struct binder_thread *target_thread = NULL;
 	struct binder_node *target_node = NULL;
@@ -1390,6 +1877,7 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
+	long saved_priority;
 
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
@@ -1400,16 +1888,20 @@ static void binder_transaction(struct binder_proc *proc,
 	e->offsets_size = tr->offsets_size;
 
 	if (reply) {
+		spin_lock(&binder_stack_lock);
 		in_reply_to = thread->transaction_stack;
 		if (in_reply_to == NULL) {
+			spin_unlock(&binder_stack_lock);
 			binder_user_error("binder: %d:%d got reply transaction "
 					  "with no transaction stack\n",
 					  proc->pid, thread->pid);
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		saved_priority = in_reply_to->saved_priority;
 		if (in_reply_to->to_thread != thread) {
+			spin_unlock(&binder_stack_lock);
+			binder_set_nice(saved_priority);
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad transaction stack,"
 				" transaction %d has target %d:%d\n",
@@ -1425,10 +1917,13 @@ static void binder_transaction(struct binder_proc *proc,
 		thread->transaction_stack = in_reply_to->to_parent;
 		target_thread = in_reply_to->from;
 		if (target_thread == NULL) {
+			spin_unlock(&binder_stack_lock);
+			binder_set_nice(saved_priority);
 			return_error = BR_DEAD_REPLY;
 			goto err_dead_binder;
 		}
 		if (target_thread->transaction_stack != in_reply_to) {
+			spin_unlock(&binder_stack_lock);
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad target transaction stack %d, "
 				"expected %d\n",
@@ -1436,17 +1931,23 @@ static void binder_transaction(struct binder_proc *proc,
 				target_thread->transaction_stack ?
 				target_thread->transaction_stack->debug_id : 0,
 				in_reply_to->debug_id);
+			binder_set_nice(saved_priority);
 			return_error = BR_FAILED_REPLY;
 			in_reply_to = NULL;
 			target_thread = NULL;
 			goto err_dead_binder;
 		}
+		spin_unlock(&binder_stack_lock);
+		binder_set_nice(saved_priority);
 		target_proc = target_thread->proc;
 	} else {
 		if (tr->target.handle) {
 			struct binder_ref *ref;
+
+			binder_proc_lock(proc);
 			ref = binder_get_ref(proc, tr->target.handle);
 			if (ref == NULL) {
+				binder_proc_unlock(proc);
 				binder_user_error("binder: %d:%d got "
 					"transaction to invalid handle\n",
 					proc->pid, thread->pid);
@@ -1454,12 +1955,15 @@ static void binder_transaction(struct binder_proc *proc,
 				goto err_invalid_target_handle;
 			}
 			target_node = ref->node;
+			binder_inc_node_tmpref(target_node);
+			binder_proc_unlock(proc);
 		} else {
 			target_node = binder_context_mgr_node;
 			if (target_node == NULL) {
 				return_error = BR_DEAD_REPLY;
 				goto err_no_context_mgr_node;
 			}
+			binder_inc_node_tmpref(target_node);
 		}
 		e->to_node = target_node->debug_id;
 		target_proc = target_node->proc;
@@ -1469,8 +1973,11 @@ static void binder_transaction(struct binder_proc *proc,
 		}
 		if (!(tr->flags & TF_ONE_WAY) && thread->transaction_stack) {
 			struct binder_transaction *tmp;
+
+			spin_lock(&binder_stack_lock);
 			tmp = thread->transaction_stack;
 			if (tmp->to_thread != thread) {
+				spin_unlock(&binder_stack_lock);
 				binder_user_error("binder: %d:%d got new "
 					"transaction with bad transaction stack"
 					", transaction %d has target %d:%d\n",
@@ -1486,6 +1993,7 @@ static void binder_transaction(struct binder_proc *proc,
 					target_thread = tmp->from;
 				tmp = tmp->from_parent;
 			}
+			spin_unlock(&binder_stack_lock);
 		}
 	}
 	if (target_thread) {
@@ -1513,7 +2021,7 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 	binder_stats_created(BINDER_STAT_TRANSACTION_COMPLETE);
 
-	t->debug_id = ++binder_last_id;
+	t->debug_id = atomic_inc_return(&binder_last_id);
 	e->debug_id = t->debug_id;
 
 	if (reply)
@@ -1543,13 +2051,16 @@ static void binder_transaction(struct binder_proc *proc,
 	t->code = tr->code;
 	t->flags = tr->flags;
 	t->priority = task_nice(current);
+	trace_binder_transaction(t->debug_id, reply, target_proc->pid,
+				 target_thread ? target_thread->pid : 0,
+				 t->code, t->flags);
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
-		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
+		tr->offsets_size, extra_buffers_size,
+		!reply && (t->flags & TF_ONE_WAY));
 	if (t->buffer == NULL) {
 		return_error = BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
 	}
-	t->buffer->allow_user_free = 0;
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
 	t->buffer->target_node = target_node;
@@ -1578,6 +2089,8 @@ static void binder_transaction(struct binder_proc *proc,
 		goto err_bad_offset;
 	}
 	off_end = (void *)offp + tr->offsets_size;
+	sg_bufp = (uint8_t *)offp + ALIGN(tr->offsets_size, sizeof(void *));
+	sg_buf_end = sg_bufp + ALIGN(extra_buffers_size, sizeof(void *));
 	for (; offp < off_end; offp++) {
 		struct flat_binder_object *fp;
 		if (*offp > t->buffer->data_size - sizeof(*fp) ||
@@ -1594,10 +2107,14 @@ static void binder_transaction(struct binder_proc *proc,
 		case BINDER_TYPE_BINDER:
 		case BINDER_TYPE_WEAK_BINDER: {
 			struct binder_ref *ref;
-			struct binder_node *node = binder_get_node(proc, fp->binder);
+			struct binder_node *node;
+
+			binder_proc_lock(proc);
+			node = binder_get_node(proc, fp->binder);
 			if (node == NULL) {
 				node = binder_new_node(proc, fp->binder, fp->cookie);
 				if (node == NULL) {
+					binder_proc_unlock(proc);
 					return_error = BR_FAILED_REPLY;
 					goto err_binder_new_node_failed;
 				}
@@ -1605,6 +2122,7 @@ static void binder_transaction(struct binder_proc *proc,
 				node->accept_fds = !!(fp->flags & FLAT_BINDER_FLAG_ACCEPTS_FDS);
 			}
 			if (fp->cookie != node->cookie) {
+				binder_proc_unlock(proc);
 				binder_user_error("binder: %d:%d sending u%p "
 					"node %d, cookie mismatch %p != %p\n",
 					proc->pid, thread->pid,
@@ -1612,8 +2130,14 @@ static void binder_transaction(struct binder_proc *proc,
 					fp->cookie, node->cookie);
 				goto err_binder_get_ref_for_node_failed;
 			}
+			binder_inc_node_tmpref(node);
+			binder_proc_unlock(proc);
+
+			binder_proc_lock(target_proc);
 			ref = binder_get_ref_for_node(target_proc, node);
 			if (ref == NULL) {
+				binder_proc_unlock(target_proc);
+				binder_dec_node_tmpref(node);
 				return_error = BR_FAILED_REPLY;
 				goto err_binder_get_ref_for_node_failed;
 			}
@@ -1629,11 +2153,20 @@ static void binder_transaction(struct binder_proc *proc,
 				     "        node %d u%p -> ref %d desc %d\n",
 				     node->debug_id, node->ptr, ref->debug_id,
 				     ref->desc);
+			binder_proc_unlock(target_proc);
+			binder_dec_node_tmpref(node);
 		} break;
 		case BINDER_TYPE_HANDLE:
 		case BINDER_TYPE_WEAK_HANDLE: {
-			struct binder_ref *ref = binder_get_ref(proc, fp->handle);
+			struct binder_ref *ref;
+			struct binder_node *node;
+			int ref_debug_id;
+			uint32_t ref_desc;
+
+			binder_proc_lock(proc);
+			ref = binder_get_ref(proc, fp->handle);
 			if (ref == NULL) {
+				binder_proc_unlock(proc);
 				binder_user_error("binder: %d:%d got "
 					"transaction with invalid "
 					"handle, %ld\n", proc->pid,
@@ -1641,22 +2174,32 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error = BR_FAILED_REPLY;
 				goto err_binder_get_ref_failed;
 			}
-			if (ref->node->proc == target_proc) {
+			node = ref->node;
+			ref_debug_id = ref->debug_id;
+			ref_desc = ref->desc;
+			binder_inc_node_tmpref(node);
+			binder_proc_unlock(proc);
+
+			if (node->proc == target_proc) {
 				if (fp->type == BINDER_TYPE_HANDLE)
 					fp->type = BINDER_TYPE_BINDER;
 				else
 					fp->type = BINDER_TYPE_WEAK_BINDER;
-				fp->binder = ref->node->ptr;
-				fp->cookie = ref->node->cookie;
-				binder_inc_node(ref->node, fp->type == BINDER_TYPE_BINDER, 0, NULL);
+				fp->binder = node->ptr;
+				fp->cookie = node->cookie;
+				binder_inc_node(node, fp->type == BINDER_TYPE_BINDER, 0, NULL);
 				binder_debug(BINDER_DEBUG_TRANSACTION,
 					     "        ref %d desc %d -> node %d u%p\n",
-					     ref->debug_id, ref->desc, ref->node->debug_id,
-					     ref->node->ptr);
+					     ref_debug_id, ref_desc, node->debug_id,
+					     node->ptr);
 			} else {
 				struct binder_ref *new_ref;
-				new_ref = binder_get_ref_for_node(target_proc, ref->node);
+
+				binder_proc_lock(target_proc);
+				new_ref = binder_get_ref_for_node(target_proc, node);
 				if (new_ref == NULL) {
+					binder_proc_unlock(target_proc);
+					binder_dec_node_tmpref(node);
 					return_error = BR_FAILED_REPLY;
 					goto err_binder_get_ref_for_node_failed;
 				}
@@ -1664,9 +2207,11 @@ static void binder_transaction(struct binder_proc *proc,
 				binder_inc_ref(new_ref, fp->type == BINDER_TYPE_HANDLE, NULL);
 				binder_debug(BINDER_DEBUG_TRANSACTION,
 					     "        ref %d desc %d -> ref %d desc %d (node %d)\n",
-					     ref->debug_id, ref->desc, new_ref->debug_id,
-					     new_ref->desc, ref->node->debug_id);
+					     ref_debug_id, ref_desc, new_ref->debug_id,
+					     new_ref->desc, node->debug_id);
+				binder_proc_unlock(target_proc);
 			}
+			binder_dec_node_tmpref(node);
 		} break;
 
 		case BINDER_TYPE_FD: {
@@ -1707,6 +2252,33 @@ static void binder_transaction(struct binder_proc *proc,
 			fp->handle = target_fd;
 		} break;
 
+		case BINDER_TYPE_PTR: {
+			struct binder_buffer_object *bp = (void *)fp;
+			size_t buf_left = sg_buf_end - sg_bufp;
+
+			if (bp->flags || bp->length > buf_left ||
+			    ALIGN(bp->length, sizeof(void *)) > buf_left) {
+				binder_user_error("binder: %d:%d got transaction with too large buffer, %zd of %zd\n",
+					proc->pid, thread->pid, bp->length,
+					buf_left);
+				return_error = BR_FAILED_REPLY;
+				goto err_bad_offset;
+			}
+			/* gather straight into the target's mapped buffer */
+			if (copy_from_user(sg_bufp, bp->buffer, bp->length)) {
+				binder_user_error("binder: %d:%d got transaction with invalid buffer ptr\n",
+					proc->pid, thread->pid);
+				return_error = BR_FAILED_REPLY;
+				goto err_copy_data_failed;
+			}
+			binder_debug(BINDER_DEBUG_TRANSACTION,
+				     "        ptr %p size %zd -> %p\n",
+				     bp->buffer, bp->length,
+				     sg_bufp + target_proc->user_buffer_offset);
+			bp->buffer = sg_bufp + target_proc->user_buffer_offset;
+			sg_bufp += ALIGN(bp->length, sizeof(void *));
+		} break;
+
 		default:
 			binder_user_error("binder: %d:%d got transactio"
 				"n with invalid object type, %lx\n",
@@ -1715,29 +2287,54 @@ static void binder_transaction(struct binder_proc *proc,
 			goto err_bad_object_type;
 		}
 	}
+	t->work.type = BINDER_WORK_TRANSACTION;
+	t->enqueue_time = ktime_get();
 	if (reply) {
 		BUG_ON(t->buffer->async_transaction != 0);
+		binder_latency_add(proc, BINDER_LATENCY_REPLY,
+				   in_reply_to->dequeue_time, t->enqueue_time);
+		spin_lock(&binder_stack_lock);
 		binder_pop_transaction(target_thread, in_reply_to);
+		spin_unlock(&binder_stack_lock);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
+		spin_lock(&binder_stack_lock);
 		t->need_reply = 1;
 		t->from_parent = thread->transaction_stack;
 		thread->transaction_stack = t;
+		spin_unlock(&binder_stack_lock);
 	} else {
 		BUG_ON(target_node == NULL);
 		BUG_ON(t->buffer->async_transaction != 1);
+		spin_lock(&target_node->lock);
 		if (target_node->has_async_transaction) {
 			target_list = &target_node->async_todo;
 			target_wait = NULL;
 		} else
 			target_node->has_async_transaction = 1;
+		spin_lock(&target_proc->todo_lock);
+		list_add_tail(&t->work.entry, target_list);
+		spin_unlock(&target_proc->todo_lock);
+		spin_unlock(&target_node->lock);
+		target_list = NULL;
+	}
+	if (target_list) {
+		spin_lock(&target_proc->todo_lock);
+		list_add_tail(&t->work.entry, target_list);
+		spin_unlock(&target_proc->todo_lock);
 	}
-	t->work.type = BINDER_WORK_TRANSACTION;
-	list_add_tail(&t->work.entry, target_list);
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
+	spin_lock(&proc->todo_lock);
 	list_add_tail(&tcomplete->entry, &thread->todo);
-	if (target_wait)
-		wake_up_interruptible(target_wait);
+	spin_unlock(&proc->todo_lock);
+	if (target_wait) {
+		if (target_thread)
+			wake_up_interruptible(target_wait);
+		else
+			binder_wakeup_proc(target_proc);
+	}
+	if (target_node)
+		binder_dec_node_tmpref(target_node);
 	return;
 
 err_get_unused_fd_failed:
@@ -1762,6 +2359,8 @@ err_alloc_t_failed:
 err_bad_call_stack:
 err_empty_call_stack:
 err_dead_binder:
+	if (target_node)
+		binder_dec_node_tmpref(target_node);
 err_invalid_target_handle:
 err_no_context_mgr_node:
 	binder_debug(BINDER_DEBUG_FAILED_TRANSACTION,
@@ -1775,12 +2374,14 @@ err_no_context_mgr_node:
 		*fe = *e;
 	}
 
+	spin_lock(&binder_stack_lock);
 	BUG_ON(thread->return_error != BR_OK);
 	if (in_reply_to) {
 		thread->return_error = BR_TRANSACTION_COMPLETE;
-		binder_send_failed_reply(in_reply_to, return_error);
+		__binder_send_failed_reply(in_reply_to, return_error);
 	} else
 		thread->return_error = return_error;
+	spin_unlock(&binder_stack_lock);
 }
 
 int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
@@ -1795,9 +2396,9 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			return -EFAULT;
 		ptr += sizeof(uint32_t);
 		if (_IOC_NR(cmd) < ARRAY_SIZE(binder_stats.bc)) {
-			binder_stats.bc[_IOC_NR(cmd)]++;
-			proc->stats.bc[_IOC_NR(cmd)]++;
-			thread->stats.bc[_IOC_NR(cmd)]++;
+			atomic_inc(&binder_stats.bc[_IOC_NR(cmd)]);
+			atomic_inc(&proc->stats.bc[_IOC_NR(cmd)]);
+			atomic_inc(&thread->stats.bc[_IOC_NR(cmd)]);
 		}
 		switch (cmd) {
 		case BC_INCREFS:
@@ -1811,11 +2412,12 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (get_user(target, (uint32_t __user *)ptr))
 				return -EFAULT;
 			ptr += sizeof(uint32_t);
+			binder_proc_lock(proc);
 			if (target == 0 && binder_context_mgr_node &&
 			    (cmd == BC_INCREFS || cmd == BC_ACQUIRE)) {
 				ref = binder_get_ref_for_node(proc,
 					       binder_context_mgr_node);
-				if (ref->desc != target) {
+				if (ref && ref->desc != target) {
 					binder_user_error("binder: %d:"
 						"%d tried to acquire "
 						"reference to desc 0, "
@@ -1826,6 +2428,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			} else
 				ref = binder_get_ref(proc, target);
 			if (ref == NULL) {
+				binder_proc_unlock(proc);
 				binder_user_error("binder: %d:%d refcou"
 					"nt change on invalid ref %d\n",
 					proc->pid, thread->pid, target);
@@ -1854,6 +2457,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				     "binder: %d:%d %s ref %d desc %d s %d w %d for node %d\n",
 				     proc->pid, thread->pid, debug_string, ref->debug_id,
 				     ref->desc, ref->strong, ref->weak, ref->node->debug_id);
+			binder_proc_unlock(proc);
 			break;
 		}
 		case BC_INCREFS_DONE:
@@ -1868,8 +2472,10 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (get_user(cookie, (void * __user *)ptr))
 				return -EFAULT;
 			ptr += sizeof(void *);
+			binder_proc_lock(proc);
 			node = binder_get_node(proc, node_ptr);
 			if (node == NULL) {
+				binder_proc_unlock(proc);
 				binder_user_error("binder: %d:%d "
 					"%s u%p no match\n",
 					proc->pid, thread->pid,
@@ -1887,35 +2493,43 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 					"BC_INCREFS_DONE" : "BC_ACQUIRE_DONE",
 					node_ptr, node->debug_id,
 					cookie, node->cookie);
+				binder_proc_unlock(proc);
 				break;
 			}
+			spin_lock(&node->lock);
 			if (cmd == BC_ACQUIRE_DONE) {
 				if (node->pending_strong_ref == 0) {
+					spin_unlock(&node->lock);
 					binder_user_error("binder: %d:%d "
 						"BC_ACQUIRE_DONE node %d has "
 						"no pending acquire request\n",
 						proc->pid, thread->pid,
 						node->debug_id);
+					binder_proc_unlock(proc);
 					break;
 				}
 				node->pending_strong_ref = 0;
 			} else {
 				if (node->pending_weak_ref == 0) {
+					spin_unlock(&node->lock);
 					binder_user_error("binder: %d:%d "
 						"BC_INCREFS_DONE node %d has "
 						"no pending increfs request\n",
 						proc->pid, thread->pid,
 						node->debug_id);
+					binder_proc_unlock(proc);
 					break;
 				}
 				node->pending_weak_ref = 0;
 			}
+			spin_unlock(&node->lock);
 			binder_dec_node(node, cmd == BC_ACQUIRE_DONE, 0);
 			binder_debug(BINDER_DEBUG_USER_REFS,
 				     "binder: %d:%d %s node %d ls %d lw %d\n",
 				     proc->pid, thread->pid,
 				     cmd == BC_INCREFS_DONE ? "BC_INCREFS_DONE" : "BC_ACQUIRE_DONE",
 				     node->debug_id, node->local_strong_refs, node->local_weak_refs);
+			binder_proc_unlock(proc);
 			break;
 		}
 		case BC_ATTEMPT_ACQUIRE:
@@ -1933,35 +2547,50 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				return -EFAULT;
 			ptr += sizeof(void *);
 
+			binder_alloc_lock(proc);
 			buffer = binder_buffer_lookup(proc, data_ptr);
 			if (buffer == NULL) {
+				binder_alloc_unlock(proc);
 				binder_user_error("binder: %d:%d "
 					"BC_FREE_BUFFER u%p no match\n",
 					proc->pid, thread->pid, data_ptr);
 				break;
 			}
 			if (!buffer->allow_user_free) {
+				binder_alloc_unlock(proc);
 				binder_user_error("binder: %d:%d "
 					"BC_FREE_BUFFER u%p matched "
 					"unreturned buffer\n",
 					proc->pid, thread->pid, data_ptr);
 				break;
 			}
+			/* claim the buffer so a second BC_FREE_BUFFER fails */
+			buffer->allow_user_free = 0;
+			binder_alloc_unlock(proc);
 			binder_debug(BINDER_DEBUG_FREE_BUFFER,
 				     "binder: %d:%d BC_FREE_BUFFER u%p found buffer %d for %s transaction\n",
 				     proc->pid, thread->pid, data_ptr, buffer->debug_id,
 				     buffer->transaction ? "active" : "finished");
 
+			spin_lock(&binder_stack_lock);
 			if (buffer->transaction) {
 				buffer->transaction->buffer = NULL;
 				buffer->transaction = NULL;
 			}
+			spin_unlock(&binder_stack_lock);
 			if (buffer->async_transaction && buffer->target_node) {
-				BUG_ON(!buffer->target_node->has_async_transaction);
-				if (list_empty(&buffer->target_node->async_todo))
-					buffer->target_node->has_async_transaction = 0;
-				else
-					list_move_tail(buffer->target_node->async_todo.next, &thread->todo);
+				struct binder_node *node = buffer->target_node;
+
+				spin_lock(&node->lock);
+				BUG_ON(!node->has_async_transaction);
+				if (list_empty(&node->async_todo))
+					node->has_async_transaction = 0;
+				else {
+					spin_lock(&proc->todo_lock);
+					list_move_tail(node->async_todo.next, &thread->todo);
+					spin_unlock(&proc->todo_lock);
+				}
+				spin_unlock(&node->lock);
 			}
 			binder_transaction_buffer_release(proc, buffer, NULL);
 			binder_free_buf(proc, buffer);
@@ -1975,7 +2604,19 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (copy_from_user(&tr, ptr, sizeof(tr)))
 				return -EFAULT;
 			ptr += sizeof(tr);
-			binder_transaction(proc, thread, &tr, cmd == BC_REPLY);
+			binder_transaction(proc, thread, &tr, cmd == BC_REPLY, 0);
+			break;
+		}
+
+		case BC_TRANSACTION_SG:
+		case BC_REPLY_SG: {
+			struct binder_transaction_data_sg tr;
+
+			if (copy_from_user(&tr, ptr, sizeof(tr)))
+				return -EFAULT;
+			ptr += sizeof(tr);
+			binder_transaction(proc, thread, &tr.transaction_data,
+					   cmd == BC_REPLY_SG, tr.buffers_size);
 			break;
 		}
 
@@ -1989,15 +2630,23 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 					" BC_REGISTER_LOOPER called "
 					"after BC_ENTER_LOOPER\n",
 					proc->pid, thread->pid);
-			} else if (proc->requested_threads == 0) {
-				thread->looper |= BINDER_LOOPER_STATE_INVALID;
-				binder_user_error("binder: %d:%d ERROR:"
-					" BC_REGISTER_LOOPER called "
-					"without request\n",
-					proc->pid, thread->pid);
 			} else {
-				proc->requested_threads--;
-				proc->requested_threads_started++;
+				int requested;
+
+				spin_lock(&proc->todo_lock);
+				requested = proc->requested_threads;
+				if (requested) {
+					proc->requested_threads--;
+					proc->requested_threads_started++;
+				}
+				spin_unlock(&proc->todo_lock);
+				if (requested == 0) {
+					thread->looper |= BINDER_LOOPER_STATE_INVALID;
+					binder_user_error("binder: %d:%d ERROR:"
+						" BC_REGISTER_LOOPER called "
+						"without request\n",
+						proc->pid, thread->pid);
+				}
 			}
 			thread->looper |= BINDER_LOOPER_STATE_REGISTERED;
 			break;
@@ -2034,8 +2683,10 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (get_user(cookie, (void __user * __user *)ptr))
 				return -EFAULT;
 			ptr += sizeof(void *);
+			binder_proc_lock(proc);
 			ref = binder_get_ref(proc, target);
 			if (ref == NULL) {
+				binder_proc_unlock(proc);
 				binder_user_error("binder: %d:%d %s "
 					"invalid ref %d\n",
 					proc->pid, thread->pid,
@@ -2057,6 +2708,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 
 			if (cmd == BC_REQUEST_DEATH_NOTIFICATION) {
 				if (ref->death) {
+					binder_proc_unlock(proc);
 					binder_user_error("binder: %d:%"
 						"d BC_REQUEST_DEATH_NOTI"
 						"FICATION death notific"
@@ -2066,7 +2718,10 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				}
 				death = kzalloc(sizeof(*death), GFP_KERNEL);
 				if (death == NULL) {
+					binder_proc_unlock(proc);
+					spin_lock(&binder_stack_lock);
 					thread->return_error = BR_ERROR;
+					spin_unlock(&binder_stack_lock);
 					binder_debug(BINDER_DEBUG_FAILED_TRANSACTION,
 						     "binder: %d:%d "
 						     "BC_REQUEST_DEATH_NOTIFICATION failed\n",
@@ -2079,15 +2734,18 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				ref->death = death;
 				if (ref->node->proc == NULL) {
 					ref->death->work.type = BINDER_WORK_DEAD_BINDER;
+					spin_lock(&proc->todo_lock);
 					if (thread->looper & (BINDER_LOOPER_STATE_REGISTERED | BINDER_LOOPER_STATE_ENTERED)) {
 						list_add_tail(&ref->death->work.entry, &thread->todo);
 					} else {
 						list_add_tail(&ref->death->work.entry, &proc->todo);
-						wake_up_interruptible(&proc->wait);
+						__binder_wakeup_proc(proc);
 					}
+					spin_unlock(&proc->todo_lock);
 				}
 			} else {
 				if (ref->death == NULL) {
+					binder_proc_unlock(proc);
 					binder_user_error("binder: %d:%"
 						"d BC_CLEAR_DEATH_NOTIFI"
 						"CATION death notificat"
@@ -2097,6 +2755,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				}
 				death = ref->death;
 				if (death->cookie != cookie) {
+					binder_proc_unlock(proc);
 					binder_user_error("binder: %d:%"
 						"d BC_CLEAR_DEATH_NOTIFI"
 						"CATION death notificat"
@@ -2107,19 +2766,22 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 					break;
 				}
 				ref->death = NULL;
+				spin_lock(&proc->todo_lock);
 				if (list_empty(&death->work.entry)) {
 					death->work.type = BINDER_WORK_CLEAR_DEATH_NOTIFICATION;
 					if (thread->looper & (BINDER_LOOPER_STATE_REGISTERED | BINDER_LOOPER_STATE_ENTERED)) {
 						list_add_tail(&death->work.entry, &thread->todo);
 					} else {
 						list_add_tail(&death->work.entry, &proc->todo);
-						wake_up_interruptible(&proc->wait);
+						__binder_wakeup_proc(proc);
 					}
 				} else {
 					BUG_ON(death->work.type != BINDER_WORK_DEAD_BINDER);
 					death->work.type = BINDER_WORK_DEAD_BINDER_AND_CLEAR;
 				}
+				spin_unlock(&proc->todo_lock);
 			}
+			binder_proc_unlock(proc);
 		} break;
 		case BC_DEAD_BINDER_DONE: {
 			struct binder_work *w;
@@ -2129,6 +2791,8 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				return -EFAULT;
 
 			ptr += sizeof(void *);
+			binder_proc_lock(proc);
+			spin_lock(&proc->todo_lock);
 			list_for_each_entry(w, &proc->delivered_death, entry) {
 				struct binder_ref_death *tmp_death = container_of(w, struct binder_ref_death, work);
 				if (tmp_death->cookie == cookie) {
@@ -2140,6 +2804,8 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				     "binder: %d:%d BC_DEAD_BINDER_DONE %p found %p\n",
 				     proc->pid, thread->pid, cookie, death);
 			if (death == NULL) {
+				spin_unlock(&proc->todo_lock);
+				binder_proc_unlock(proc);
 				binder_user_error("binder: %d:%d BC_DEAD"
 					"_BINDER_DONE %p not found\n",
 					proc->pid, thread->pid, cookie);
@@ -2153,9 +2819,11 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 					list_add_tail(&death->work.entry, &thread->todo);
 				} else {
 					list_add_tail(&death->work.entry, &proc->todo);
-					wake_up_interruptible(&proc->wait);
+					__binder_wakeup_proc(proc);
 				}
 			}
+			spin_unlock(&proc->todo_lock);
+			binder_proc_unlock(proc);
 		} break;
 
 		default:
@@ -2172,9 +2840,9 @@ void binder_stat_br(struct binder_proc *proc, struct binder_thread *thread,
 		    uint32_t cmd)
 {
 	if (_IOC_NR(cmd) < ARRAY_SIZE(binder_stats.br)) {
-		binder_stats.br[_IOC_NR(cmd)]++;
-		proc->stats.br[_IOC_NR(cmd)]++;
-		thread->stats.br[_IOC_NR(cmd)]++;
+		atomic_inc(&binder_stats.br[_IOC_NR(cmd)]);
+		atomic_inc(&proc->stats.br[_IOC_NR(cmd)]);
+		atomic_inc(&thread->stats.br[_IOC_NR(cmd)]);
 	}
 }
 
@@ -2213,26 +2881,44 @@ retry:
 				list_empty(&thread->todo);
 
 	if (thread->return_error != BR_OK && ptr < end) {
-		if (thread->return_error2 != BR_OK) {
-			if (put_user(thread->return_error2, (uint32_t __user *)ptr))
+		uint32_t return_error, return_error2;
+
+		spin_lock(&binder_stack_lock);
+		return_error = thread->return_error;
+		return_error2 = thread->return_error2;
+		spin_unlock(&binder_stack_lock);
+		if (return_error2 != BR_OK) {
+			if (put_user(return_error2, (uint32_t __user *)ptr))
 				return -EFAULT;
 			ptr += sizeof(uint32_t);
 			if (ptr == end)
 				goto done;
+			spin_lock(&binder_stack_lock);
 			thread->return_error2 = BR_OK;
+			spin_unlock(&binder_stack_lock);
 		}
-		if (put_user(thread->return_error, (uint32_t __user *)ptr))
+		if (put_user(return_error, (uint32_t __user *)ptr))
 			return -EFAULT;
 		ptr += sizeof(uint32_t);
+		spin_lock(&binder_stack_lock);
 		thread->return_error = BR_OK;
+		spin_unlock(&binder_stack_lock);
 		goto done;
 	}
 
 
 	thread->looper |= BINDER_LOOPER_STATE_WAITING;
-	if (wait_for_proc_work)
+	if (wait_for_proc_work) {
+		spin_lock(&proc->todo_lock);
 		proc->ready_threads++;
-	mutex_unlock(&binder_lock);
+		if (!non_block) {
+			thread->last_cpu = raw_smp_processor_id();
+			list_add(&thread->waiting_thread_node,
+				 &proc->waiting_threads);
+		}
+		spin_unlock(&proc->todo_lock);
+	}
+	binder_read_unlock();
 	if (wait_for_proc_work) {
 		if (!(thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 					BINDER_LOOPER_STATE_ENTERED))) {
@@ -2248,7 +2934,7 @@ retry:
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
 		} else
-			ret = wait_event_interruptible_exclusive(proc->wait, binder_has_proc_work(proc, thread));
+			ret = wait_event_interruptible(thread->wait, binder_has_proc_work(proc, thread));
 	} else {
 		if (non_block) {
 			if (!binder_has_thread_work(thread))
@@ -2256,9 +2942,13 @@ retry:
 		} else
 			ret = wait_event_interruptible(thread->wait, binder_has_thread_work(thread));
 	}
-	mutex_lock(&binder_lock);
-	if (wait_for_proc_work)
+	binder_read_lock();
+	if (wait_for_proc_work) {
+		spin_lock(&proc->todo_lock);
 		proc->ready_threads--;
+		list_del_init(&thread->waiting_thread_node);
+		spin_unlock(&proc->todo_lock);
+	}
 	thread->looper &= ~BINDER_LOOPER_STATE_WAITING;
 
 	if (ret)
@@ -2269,19 +2959,38 @@ retry:
 		struct binder_transaction_data tr;
 		struct binder_work *w;
 		struct binder_transaction *t = NULL;
+		struct binder_buffer *t_buffer;
 
+		/*
+		 * proc->lock serializes the readers of this proc, so the work
+		 * item stays at the head of its list until it is consumed.
+		 */
+		binder_proc_lock(proc);
+		spin_lock(&proc->todo_lock);
 		if (!list_empty(&thread->todo))
 			w = list_first_entry(&thread->todo, struct binder_work, entry);
 		else if (!list_empty(&proc->todo) && wait_for_proc_work)
 			w = list_first_entry(&proc->todo, struct binder_work, entry);
-		else {
-			if (ptr - buffer == 4 && !(thread->looper & BINDER_LOOPER_STATE_NEED_RETURN)) /* no data added */
+		else
+			w = NULL;
+		spin_unlock(&proc->todo_lock);
+		if (w == NULL) {
+			binder_proc_unlock(proc);
+			if (ptr - buffer == 4 && !(thread->looper & BINDER_LOOPER_STATE_NEED_RETURN)) { /* no data added */
+				if (wait_for_proc_work && !non_block) {
+					/* another thread took the work */
+					atomic_inc(&binder_stats.spurious_wakeup);
+					atomic_inc(&proc->stats.spurious_wakeup);
+				}
 				goto retry;
+			}
 			break;
 		}
 
-		if (end - ptr < sizeof(tr) + 4)
+		if (end - ptr < sizeof(tr) + 4) {
+			binder_proc_unlock(proc);
 			break;
+		}
 
 		switch (w->type) {
 		case BINDER_WORK_TRANSACTION: {
@@ -2290,7 +2999,7 @@ retry:
 		case BINDER_WORK_TRANSACTION_COMPLETE: {
 			cmd = BR_TRANSACTION_COMPLETE;
 			if (put_user(cmd, (uint32_t __user *)ptr))
-				return -EFAULT;
+				goto err_fault;
 			ptr += sizeof(uint32_t);
 
 			binder_stat_br(proc, thread, cmd);
@@ -2298,7 +3007,9 @@ retry:
 				     "binder: %d:%d BR_TRANSACTION_COMPLETE\n",
 				     proc->pid, thread->pid);
 
+			spin_lock(&proc->todo_lock);
 			list_del(&w->entry);
+			spin_unlock(&proc->todo_lock);
 			kfree(w);
 			binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 		} break;
@@ -2306,8 +3017,11 @@ retry:
 			struct binder_node *node = container_of(w, struct binder_node, work);
 			uint32_t cmd = BR_NOOP;
 			const char *cmd_name;
-			int strong = node->internal_strong_refs || node->local_strong_refs;
-			int weak = !hlist_empty(&node->refs) || node->local_weak_refs || strong;
+			int strong, weak, unused = 0;
+
+			spin_lock(&node->lock);
+			strong = node->internal_strong_refs || node->local_strong_refs;
+			weak = !hlist_empty(&node->refs) || node->local_weak_refs || strong;
 			if (weak && !node->has_weak_ref) {
 				cmd = BR_INCREFS;
 				cmd_name = "BR_INCREFS";
@@ -2329,15 +3043,23 @@ retry:
 				cmd_name = "BR_DECREFS";
 				node->has_weak_ref = 0;
 			}
+			if (cmd == BR_NOOP) {
+				spin_lock(&proc->todo_lock);
+				list_del_init(&w->entry);
+				spin_unlock(&proc->todo_lock);
+				/* nothing can find the node but this proc now */
+				unused = !weak && !node->tmp_refs;
+			}
+			spin_unlock(&node->lock);
 			if (cmd != BR_NOOP) {
 				if (put_user(cmd, (uint32_t __user *)ptr))
-					return -EFAULT;
+					goto err_fault;
 				ptr += sizeof(uint32_t);
 				if (put_user(node->ptr, (void * __user *)ptr))
-					return -EFAULT;
+					goto err_fault;
 				ptr += sizeof(void *);
 				if (put_user(node->cookie, (void * __user *)ptr))
-					return -EFAULT;
+					goto err_fault;
 				ptr += sizeof(void *);
 
 				binder_stat_br(proc, thread, cmd);
@@ -2345,8 +3067,7 @@ retry:
 					     "binder: %d:%d %s %d u%p c%p\n",
 					     proc->pid, thread->pid, cmd_name, node->debug_id, node->ptr, node->cookie);
 			} else {
-				list_del_init(&w->entry);
-				if (!weak && !strong) {
+				if (unused) {
 					binder_debug(BINDER_DEBUG_INTERNAL_REFS,
 						     "binder: %d:%d node %d u%p c%p deleted\n",
 						     proc->pid, thread->pid, node->debug_id,
@@ -2374,10 +3095,10 @@ retry:
 			else
 				cmd = BR_DEAD_BINDER;
 			if (put_user(cmd, (uint32_t __user *)ptr))
-				return -EFAULT;
+				goto err_fault;
 			ptr += sizeof(uint32_t);
 			if (put_user(death->cookie, (void * __user *)ptr))
-				return -EFAULT;
+				goto err_fault;
 			ptr += sizeof(void *);
 			binder_debug(BINDER_DEBUG_DEATH_NOTIFICATION,
 				     "binder: %d:%d %s %p\n",
@@ -2388,18 +3109,27 @@ retry:
 				      death->cookie);
 
 			if (w->type == BINDER_WORK_CLEAR_DEATH_NOTIFICATION) {
+				spin_lock(&proc->todo_lock);
 				list_del(&w->entry);
+				spin_unlock(&proc->todo_lock);
 				kfree(death);
 				binder_stats_deleted(BINDER_STAT_DEATH);
-			} else
+			} else {
+				spin_lock(&proc->todo_lock);
 				list_move(&w->entry, &proc->delivered_death);
-			if (cmd == BR_DEAD_BINDER)
+				spin_unlock(&proc->todo_lock);
+			}
+			if (cmd == BR_DEAD_BINDER) {
+				binder_proc_unlock(proc);
 				goto done; /* DEAD_BINDER notifications can cause transactions */
+			}
 		} break;
 		}
 
-		if (!t)
+		if (!t) {
+			binder_proc_unlock(proc);
 			continue;
+		}
 
 		BUG_ON(t->buffer == NULL);
 		if (t->buffer->target_node) {
@@ -2440,10 +3170,10 @@ retry:
 					    sizeof(void *));
 
 		if (put_user(cmd, (uint32_t __user *)ptr))
-			return -EFAULT;
+			goto err_fault;
 		ptr += sizeof(uint32_t);
 		if (copy_to_user(ptr, &tr, sizeof(tr)))
-			return -EFAULT;
+			goto err_fault;
 		ptr += sizeof(tr);
 
 		binder_stat_br(proc, thread, cmd);
@@ -2458,44 +3188,77 @@ retry:
 			     t->buffer->data_size, t->buffer->offsets_size,
 			     tr.data.ptr.buffer, tr.data.ptr.offsets);
 
+		spin_lock(&proc->todo_lock);
 		list_del(&t->work.entry);
-		t->buffer->allow_user_free = 1;
+		spin_unlock(&proc->todo_lock);
+		t_buffer = t->buffer;
+		if (cmd == BR_TRANSACTION) {
+			t->dequeue_time = ktime_get();
+			binder_latency_add(proc, (t->flags & TF_ONE_WAY) ?
+					   BINDER_LATENCY_QUEUE_ONEWAY :
+					   BINDER_LATENCY_QUEUE_TWOWAY,
+					   t->enqueue_time, t->dequeue_time);
+		}
 		if (cmd == BR_TRANSACTION && !(t->flags & TF_ONE_WAY)) {
+			spin_lock(&binder_stack_lock);
 			t->to_parent = thread->transaction_stack;
 			t->to_thread = thread;
 			thread->transaction_stack = t;
+			spin_unlock(&binder_stack_lock);
 		} else {
+			spin_lock(&binder_stack_lock);
 			t->buffer->transaction = NULL;
+			spin_unlock(&binder_stack_lock);
 			kfree(t);
 			binder_stats_deleted(BINDER_STAT_TRANSACTION);
 		}
+		/* last: once set, user space may free the buffer */
+		binder_alloc_lock(proc);
+		t_buffer->allow_user_free = 1;
+		binder_alloc_unlock(proc);
+		binder_proc_unlock(proc);
 		break;
 	}
 
 done:
 
 	*consumed = ptr - buffer;
+	spin_lock(&proc->todo_lock);
 	if (proc->requested_threads + proc->ready_threads == 0 &&
 	    proc->requested_threads_started < proc->max_threads &&
 	    (thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 	     BINDER_LOOPER_STATE_ENTERED)) /* the user-space code fails to */
 	     /*spawn a new thread if we leave this out */) {
 		proc->requested_threads++;
+		spin_unlock(&proc->todo_lock);
 		binder_debug(BINDER_DEBUG_THREADS,
 			     "binder: %d:%d BR_SPAWN_LOOPER\n",
 			     proc->pid, thread->pid);
 		if (put_user(BR_SPAWN_LOOPER, (uint32_t __user *)buffer))
 			return -EFAULT;
-	}
+	} else
+		spin_unlock(&proc->todo_lock);
 	return 0;
+
+err_fault:
+	binder_proc_unlock(proc);
+	return -EFAULT;
 }
 
-static void binder_release_work(struct list_head *list)
+static void binder_release_work(struct binder_proc *proc,
+				struct list_head *list)
 {
 	struct binder_work *w;
-	while (!list_empty(list)) {
+
+	while (1) {
+		spin_lock(&proc->todo_lock);
+		if (list_empty(list)) {
+			spin_unlock(&proc->todo_lock);
+			break;
+		}
 		w = list_first_entry(list, struct binder_work, entry);
 		list_del_init(&w->entry);
+		spin_unlock(&proc->todo_lock);
 		switch (w->type) {
 		case BINDER_WORK_TRANSACTION: {
 			struct binder_transaction *t;
@@ -2519,8 +3282,10 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 {
 	struct binder_thread *thread = NULL;
 	struct rb_node *parent = NULL;
-	struct rb_node **p = &proc->threads.rb_node;
+	struct rb_node **p;
 
+	binder_proc_lock(proc);
+	p = &proc->threads.rb_node;
 	while (*p) {
 		parent = *p;
 		thread = rb_entry(parent, struct binder_thread, rb_node);
@@ -2535,21 +3300,25 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 	if (*p == NULL) {
 		thread = kzalloc(sizeof(*thread), GFP_KERNEL);
 		if (thread == NULL)
-			return NULL;
+			goto out;
 		binder_stats_created(BINDER_STAT_THREAD);
 		thread->proc = proc;
 		thread->pid = current->pid;
 		init_waitqueue_head(&thread->wait);
 		INIT_LIST_HEAD(&thread->todo);
+		INIT_LIST_HEAD(&thread->waiting_thread_node);
 		rb_link_node(&thread->rb_node, parent, p);
 		rb_insert_color(&thread->rb_node, &proc->threads);
 		thread->looper |= BINDER_LOOPER_STATE_NEED_RETURN;
 		thread->return_error = BR_OK;
 		thread->return_error2 = BR_OK;
 	}
+out:
+	binder_proc_unlock(proc);
 	return thread;
 }
 
+/* Called with binder_lock held exclusively */
 static int binder_free_thread(struct binder_proc *proc,
 			      struct binder_thread *thread)
 {
@@ -2557,7 +3326,13 @@ static int binder_free_thread(struct binder_proc *proc,
 	struct binder_transaction *send_reply = NULL;
 	int active_transactions = 0;
 
+	binder_proc_lock(proc);
 	rb_erase(&thread->rb_node, &proc->threads);
+	binder_proc_unlock(proc);
+	spin_lock(&proc->todo_lock);
+	list_del_init(&thread->waiting_thread_node);
+	spin_unlock(&proc->todo_lock);
+	spin_lock(&binder_stack_lock);
 	t = thread->transaction_stack;
 	if (t && t->to_thread == thread)
 		send_reply = t;
@@ -2584,8 +3359,9 @@ static int binder_free_thread(struct binder_proc *proc,
 			BUG();
 	}
 	if (send_reply)
-		binder_send_failed_reply(send_reply, BR_DEAD_REPLY);
-	binder_release_work(&thread->todo);
+		__binder_send_failed_reply(send_reply, BR_DEAD_REPLY);
+	spin_unlock(&binder_stack_lock);
+	binder_release_work(proc, &thread->todo);
 	kfree(thread);
 	binder_stats_deleted(BINDER_STAT_THREAD);
 	return active_transactions;
@@ -2598,12 +3374,16 @@ static unsigned int binder_poll(struct file *filp,
 	struct binder_thread *thread = NULL;
 	int wait_for_proc_work;
 
-	mutex_lock(&binder_lock);
+	binder_read_lock();
 	thread = binder_get_thread(proc);
+	if (thread == NULL) {
+		binder_read_unlock();
+		return POLLERR;
+	}
 
 	wait_for_proc_work = thread->transaction_stack == NULL &&
 		list_empty(&thread->todo) && thread->return_error == BR_OK;
-	mutex_unlock(&binder_lock);
+	binder_read_unlock();
 
 	if (wait_for_proc_work) {
 		if (binder_has_proc_work(proc, thread))
@@ -2628,6 +3408,8 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	struct binder_thread *thread;
 	unsigned int size = _IOC_SIZE(cmd);
 	void __user *ubuf = (void __user *)arg;
+	int exclusive = cmd == BINDER_SET_CONTEXT_MGR ||
+			cmd == BINDER_THREAD_EXIT;
 
 	/*printk(KERN_INFO "binder_ioctl: %d:%d %x %lx\n", proc->pid, current->pid, cmd, arg);*/
 
@@ -2635,7 +3417,10 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	if (ret)
 		return ret;
 
-	mutex_lock(&binder_lock);
+	if (exclusive)
+		binder_write_lock();
+	else
+		binder_read_lock();
 	thread = binder_get_thread(proc);
 	if (thread == NULL) {
 		ret = -ENOMEM;
@@ -2670,7 +3455,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		if (bwr.read_size > 0) {
 			ret = binder_thread_read(proc, thread, (void __user *)bwr.read_buffer, bwr.read_size, &bwr.read_consumed, filp->f_flags & O_NONBLOCK);
 			if (!list_empty(&proc->todo))
-				wake_up_interruptible(&proc->wait);
+				binder_wakeup_proc(proc);
 			if (ret < 0) {
 				if (copy_to_user(ubuf, &bwr, sizeof(bwr)))
 					ret = -EFAULT;
@@ -2687,12 +3472,18 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		}
 		break;
 	}
-	case BINDER_SET_MAX_THREADS:
-		if (copy_from_user(&proc->max_threads, ubuf, sizeof(proc->max_threads))) {
+	case BINDER_SET_MAX_THREADS: {
+		int max_threads;
+
+		if (copy_from_user(&max_threads, ubuf, sizeof(max_threads))) {
 			ret = -EINVAL;
 			goto err;
 		}
+		spin_lock(&proc->todo_lock);
+		proc->max_threads = max_threads;
+		spin_unlock(&proc->todo_lock);
 		break;
+	}
 	case BINDER_SET_CONTEXT_MGR:
 		if (binder_context_mgr_node != NULL) {
 			printk(KERN_ERR "binder: BINDER_SET_CONTEXT_MGR already set\n");
@@ -2710,7 +3501,9 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 			}
 		} else
 			binder_context_mgr_uid = current->cred->euid;
+		binder_proc_lock(proc);
 		binder_context_mgr_node = binder_new_node(proc, NULL, NULL);
+		binder_proc_unlock(proc);
 		if (binder_context_mgr_node == NULL) {
 			ret = -ENOMEM;
 			goto err;
@@ -2744,7 +3537,10 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 err:
 	if (thread)
 		thread->looper &= ~BINDER_LOOPER_STATE_NEED_RETURN;
-	mutex_unlock(&binder_lock);
+	if (exclusive)
+		binder_write_unlock();
+	else
+		binder_read_unlock();
 	wait_event_interruptible(binder_user_error_wait, binder_stop_on_user_error < 2);
 	if (ret && ret != -ERESTARTSYS)
 		printk(KERN_INFO "binder: %d:%d ioctl %x %lx returned %d\n", proc->pid, current->pid, cmd, arg, ret);
@@ -2873,6 +3669,7 @@ err_bad_arg:
 static int binder_open(struct inode *nodp, struct file *filp)
 {
 	struct binder_proc *proc;
+	int i;
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE, "binder_open: %d:%d\n",
 		     current->group_leader->pid, current->pid);
@@ -2882,16 +3679,22 @@ static int binder_open(struct inode *nodp, struct file *filp)
 		return -ENOMEM;
 	get_task_struct(current);
 	proc->tsk = current;
+	mutex_init(&proc->lock);
+	mutex_init(&proc->alloc_lock);
+	spin_lock_init(&proc->todo_lock);
+	for (i = 0; i < BINDER_BIN_COUNT; i++)
+		INIT_LIST_HEAD(&proc->bins[i]);
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
+	INIT_LIST_HEAD(&proc->waiting_threads);
 	proc->default_priority = task_nice(current);
-	mutex_lock(&binder_lock);
+	binder_write_lock();
 	binder_stats_created(BINDER_STAT_PROC);
 	hlist_add_head(&proc->proc_node, &binder_procs);
 	proc->pid = current->group_leader->pid;
 	INIT_LIST_HEAD(&proc->delivered_death);
 	filp->private_data = proc;
-	mutex_unlock(&binder_lock);
+	binder_write_unlock();
 
 	if (binder_debugfs_dir_entry_proc) {
 		char strbuf[11];
@@ -2940,11 +3743,62 @@ static int binder_release(struct inode *nodp, struct file *filp)
 	return 0;
 }
 
+/*
+ * Releasing a big proc takes long enough to stall every other binder user,
+ * so binder_deferred_release() lets go of binder_lock after every
+ * BINDER_RELEASE_BATCH objects.  The proc is already off binder_procs and
+ * has no threads or vma left by then, so between batches other procs can
+ * only reach it through the nodes not released yet, like they could before
+ * the release started.  Death notifications are queued as the nodes go but
+ * each target proc is woken once per batch.
+ */
+#define BINDER_RELEASE_BATCH	64
+#define BINDER_RELEASE_WAKE_MAX	16
+
+struct binder_release_state {
+	int count;
+	int nr_wake;
+	struct binder_proc *wake[BINDER_RELEASE_WAKE_MAX];
+};
+
+static void binder_release_wake_all(struct binder_release_state *rs)
+{
+	while (rs->nr_wake)
+		binder_wakeup_proc(rs->wake[--rs->nr_wake]);
+}
+
+/* the procs stay alive as long as binder_lock is held */
+static void binder_release_queue_wake(struct binder_release_state *rs,
+				      struct binder_proc *proc)
+{
+	int i;
+
+	for (i = 0; i < rs->nr_wake; i++)
+		if (rs->wake[i] == proc)
+			return;
+	if (rs->nr_wake == BINDER_RELEASE_WAKE_MAX)
+		binder_release_wake_all(rs);
+	rs->wake[rs->nr_wake++] = proc;
+}
+
+static void binder_release_yield(struct binder_release_state *rs)
+{
+	if (++rs->count % BINDER_RELEASE_BATCH)
+		return;
+
+	binder_release_wake_all(rs);
+	binder_write_unlock();
+	cond_resched();
+	binder_write_lock();
+}
+
+/* Called with binder_lock held exclusively, drops it between batches */
 static void binder_deferred_release(struct binder_proc *proc)
 {
 	struct hlist_node *pos;
 	struct binder_transaction *t;
 	struct rb_node *n;
+	struct binder_release_state rs = { 0 };
 	int threads, nodes, incoming_refs, outgoing_refs, buffers, active_transactions, page_count;
 
 	BUG_ON(proc->vma);
@@ -2964,6 +3818,7 @@ static void binder_deferred_release(struct binder_proc *proc)
 		struct binder_thread *thread = rb_entry(n, struct binder_thread, rb_node);
 		threads++;
 		active_transactions += binder_free_thread(proc, thread);
+		binder_release_yield(&rs);
 	}
 	nodes = 0;
 	incoming_refs = 0;
@@ -2972,7 +3827,9 @@ static void binder_deferred_release(struct binder_proc *proc)
 
 		nodes++;
 		rb_erase(&node->rb_node, &proc->nodes);
+		spin_lock(&proc->todo_lock);
 		list_del_init(&node->work.entry);
+		spin_unlock(&proc->todo_lock);
 		if (hlist_empty(&node->refs)) {
 			kfree(node);
 			binder_stats_deleted(BINDER_STAT_NODE);
@@ -2983,18 +3840,22 @@ static void binder_deferred_release(struct binder_proc *proc)
 			node->proc = NULL;
 			node->local_strong_refs = 0;
 			node->local_weak_refs = 0;
+			spin_lock(&binder_dead_nodes_lock);
 			hlist_add_head(&node->dead_node, &binder_dead_nodes);
+			spin_unlock(&binder_dead_nodes_lock);
 
 			hlist_for_each_entry(ref, pos, &node->refs, node_entry) {
 				incoming_refs++;
 				if (ref->death) {
 					death++;
+					spin_lock(&ref->proc->todo_lock);
 					if (list_empty(&ref->death->work.entry)) {
 						ref->death->work.type = BINDER_WORK_DEAD_BINDER;
 						list_add_tail(&ref->death->work.entry, &ref->proc->todo);
-						wake_up_interruptible(&ref->proc->wait);
 					} else
 						BUG();
+					spin_unlock(&ref->proc->todo_lock);
+					binder_release_queue_wake(&rs, ref->proc);
 				}
 			}
 			binder_debug(BINDER_DEBUG_DEAD_BINDER,
@@ -3002,15 +3863,27 @@ static void binder_deferred_release(struct binder_proc *proc)
 				     "refs %d, death %d\n", node->debug_id,
 				     incoming_refs, death);
 		}
+		binder_release_yield(&rs);
 	}
+	binder_release_wake_all(&rs);
 	outgoing_refs = 0;
-	while ((n = rb_first(&proc->refs_by_desc))) {
-		struct binder_ref *ref = rb_entry(n, struct binder_ref,
-						  rb_node_desc);
+	for (;;) {
+		struct binder_ref *ref;
+
+		binder_proc_lock(proc);
+		n = rb_first(&proc->refs_by_desc);
+		if (!n) {
+			binder_proc_unlock(proc);
+			break;
+		}
+		ref = rb_entry(n, struct binder_ref, rb_node_desc);
 		outgoing_refs++;
 		binder_delete_ref(ref);
+		binder_proc_unlock(proc);
+		binder_release_yield(&rs);
 	}
-	binder_release_work(&proc->todo);
+	/* nothing can queue work to the proc once its nodes are dead */
+	binder_release_work(proc, &proc->todo);
 	buffers = 0;
 
 	while ((n = rb_first(&proc->allocated_buffers))) {
@@ -3027,6 +3900,7 @@ static void binder_deferred_release(struct binder_proc *proc)
 		}
 		binder_free_buf(proc, buffer);
 		buffers++;
+		binder_release_yield(&rs);
 	}
 
 	binder_stats_deleted(BINDER_STAT_PROC);
@@ -3071,7 +3945,7 @@ static void binder_deferred_func(struct work_struct *work)
 
 	int defer;
 	do {
-		mutex_lock(&binder_lock);
+		binder_write_lock();
 		mutex_lock(&binder_deferred_lock);
 		if (!hlist_empty(&binder_deferred_list)) {
 			proc = hlist_entry(binder_deferred_list.first,
@@ -3098,7 +3972,7 @@ static void binder_deferred_func(struct work_struct *work)
 		if (defer & BINDER_DEFERRED_RELEASE)
 			binder_deferred_release(proc); /* frees proc */
 
-		mutex_unlock(&binder_lock);
+		binder_write_unlock();
 		if (files)
 			put_files_struct(files);
 	} while (proc);
@@ -3330,7 +4204,9 @@ static const char *binder_command_strings[] = {
 	"BC_EXIT_LOOPER",
 	"BC_REQUEST_DEATH_NOTIFICATION",
 	"BC_CLEAR_DEATH_NOTIFICATION",
-	"BC_DEAD_BINDER_DONE"
+	"BC_DEAD_BINDER_DONE",
+	"BC_TRANSACTION_SG",
+	"BC_REPLY_SG"
 };
 
 static const char *binder_objstat_strings[] = {
@@ -3343,6 +4219,18 @@ static const char *binder_objstat_strings[] = {
 	"transaction_complete"
 };
 
+static const char *binder_latency_strings[] = {
+	"queue oneway",
+	"queue twoway",
+	"reply"
+};
+
+static const char *binder_lockstat_strings[] = {
+	"global",
+	"proc",
+	"alloc"
+};
+
 static void print_binder_stats(struct seq_file *m, const char *prefix,
 			       struct binder_stats *stats)
 {
@@ -3351,17 +4239,19 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 	BUILD_BUG_ON(ARRAY_SIZE(stats->bc) !=
 		     ARRAY_SIZE(binder_command_strings));
 	for (i = 0; i < ARRAY_SIZE(stats->bc); i++) {
-		if (stats->bc[i])
+		int count = atomic_read(&stats->bc[i]);
+		if (count)
 			seq_printf(m, "%s%s: %d\n", prefix,
-				   binder_command_strings[i], stats->bc[i]);
+				   binder_command_strings[i], count);
 	}
 
 	BUILD_BUG_ON(ARRAY_SIZE(stats->br) !=
 		     ARRAY_SIZE(binder_return_strings));
 	for (i = 0; i < ARRAY_SIZE(stats->br); i++) {
-		if (stats->br[i])
+		int count = atomic_read(&stats->br[i]);
+		if (count)
 			seq_printf(m, "%s%s: %d\n", prefix,
-				   binder_return_strings[i], stats->br[i]);
+				   binder_return_strings[i], count);
 	}
 
 	BUILD_BUG_ON(ARRAY_SIZE(stats->obj_created) !=
@@ -3369,12 +4259,40 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 	BUILD_BUG_ON(ARRAY_SIZE(stats->obj_created) !=
 		     ARRAY_SIZE(stats->obj_deleted));
 	for (i = 0; i < ARRAY_SIZE(stats->obj_created); i++) {
-		if (stats->obj_created[i] || stats->obj_deleted[i])
+		int created = atomic_read(&stats->obj_created[i]);
+		int deleted = atomic_read(&stats->obj_deleted[i]);
+		if (created || deleted)
 			seq_printf(m, "%s%s: active %d total %d\n", prefix,
 				binder_objstat_strings[i],
-				stats->obj_created[i] - stats->obj_deleted[i],
-				stats->obj_created[i]);
+				created - deleted, created);
+	}
+
+	BUILD_BUG_ON(ARRAY_SIZE(stats->lock_contended) !=
+		     ARRAY_SIZE(binder_lockstat_strings));
+	for (i = 0; i < ARRAY_SIZE(stats->lock_contended); i++) {
+		int count = atomic_read(&stats->lock_contended[i]);
+		if (count)
+			seq_printf(m, "%slock contended %s: %d\n", prefix,
+				   binder_lockstat_strings[i], count);
+	}
+
+	for (i = 0; i < BINDER_BIN_COUNT; i++) {
+		int hit = atomic_read(&stats->bin_hit[i]);
+		int miss = atomic_read(&stats->bin_miss[i]);
+		if (hit || miss)
+			seq_printf(m, "%salloc bin %zd: hit %d miss %d\n",
+				   prefix, BINDER_BIN_SIZE(i), hit, miss);
 	}
+
+	if (atomic_read(&stats->spurious_wakeup))
+		seq_printf(m, "%sspurious wakeups: %d\n", prefix,
+			   atomic_read(&stats->spurious_wakeup));
+
+	if (atomic_read(&stats->page_cache_hit) ||
+	    atomic_read(&stats->page_cache_miss))
+		seq_printf(m, "%spage cache: hit %d miss %d\n", prefix,
+			   atomic_read(&stats->page_cache_hit),
+			   atomic_read(&stats->page_cache_miss));
 }
 
 static void print_binder_proc_stats(struct seq_file *m,
@@ -3382,7 +4300,7 @@ static void print_binder_proc_stats(struct seq_file *m,
 {
 	struct binder_work *w;
 	struct rb_node *n;
-	int count, strong, weak;
+	int count, strong, weak, i;
 
 	seq_printf(m, "proc %d\n", proc->pid);
 	count = 0;
@@ -3415,6 +4333,12 @@ static void print_binder_proc_stats(struct seq_file *m,
 		count++;
 	seq_printf(m, "  buffers: %d\n", count);
 
+	count = 0;
+	for (i = 0; i < BINDER_BIN_COUNT; i++)
+		count += proc->bin_count[i];
+	seq_printf(m, "  binned buffers: %d\n"
+			"  cached pages: %d\n", count, proc->pages_cached);
+
 	count = 0;
 	list_for_each_entry(w, &proc->todo, entry) {
 		switch (w->type) {
@@ -3431,6 +4355,36 @@ static void print_binder_proc_stats(struct seq_file *m,
 }
 
 
+static void print_binder_latency(struct seq_file *m, const char *prefix,
+				 struct binder_latency *latency)
+{
+	int i, j;
+
+	BUILD_BUG_ON(ARRAY_SIZE(latency->hist) !=
+		     ARRAY_SIZE(binder_latency_strings));
+	for (i = 0; i < ARRAY_SIZE(latency->hist); i++) {
+		int total = 0;
+
+		for (j = 0; j < BINDER_LATENCY_BUCKETS; j++)
+			total += atomic_read(&latency->hist[i][j]);
+		if (!total)
+			continue;
+		seq_printf(m, "%s%s: %d\n", prefix, binder_latency_strings[i],
+			   total);
+		for (j = 0; j < BINDER_LATENCY_BUCKETS; j++) {
+			int count = atomic_read(&latency->hist[i][j]);
+			if (!count)
+				continue;
+			if (j == BINDER_LATENCY_BUCKETS - 1)
+				seq_printf(m, "%s  >=%luus: %d\n", prefix,
+					   1UL << (j - 1), count);
+			else
+				seq_printf(m, "%s  <%luus: %d\n", prefix,
+					   1UL << j, count);
+		}
+	}
+}
+
 static int binder_state_show(struct seq_file *m, void *unused)
 {
 	struct binder_proc *proc;
@@ -3439,7 +4393,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_write_lock();
 
 	seq_puts(m, "binder state:\n");
 
@@ -3451,7 +4405,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_write_unlock();
 	return 0;
 }
 
@@ -3462,7 +4416,7 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_write_lock();
 
 	seq_puts(m, "binder stats:\n");
 
@@ -3471,7 +4425,29 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc_stats(m, proc);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_write_unlock();
+	return 0;
+}
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	int do_lock = !binder_debug_no_lock;
+
+	if (do_lock)
+		binder_write_lock();
+
+	seq_puts(m, "binder latency:\n");
+
+	print_binder_latency(m, "", &binder_latency);
+
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		seq_printf(m, "proc %d\n", proc->pid);
+		print_binder_latency(m, "  ", &proc->latency);
+	}
+	if (do_lock)
+		binder_write_unlock();
 	return 0;
 }
 
@@ -3482,13 +4458,13 @@ static int binder_transactions_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_write_lock();
 
 	seq_puts(m, "binder transactions:\n");
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 0);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_write_unlock();
 	return 0;
 }
 
@@ -3498,11 +4474,11 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_write_lock();
 	seq_puts(m, "binder proc state:\n");
 	print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_write_unlock();
 	return 0;
 }
 
@@ -3549,6 +4525,7 @@ static struct miscdevice binder_miscdev = {
 
 BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
+BINDER_DEBUG_ENTRY(latency);
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
 
@@ -3576,6 +4553,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    NULL,
 				    &binder_stats_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 		debugfs_create_file("transactions",
 				    S_IRUGO,
 				    binder_debugfs_dir_entry_root,
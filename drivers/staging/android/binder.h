@@ -32,6 +32,7 @@ enum {
 	BINDER_TYPE_HANDLE	= B_PACK_CHARS('s', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_WEAK_HANDLE	= B_PACK_CHARS('w', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_FD		= B_PACK_CHARS('f', 'd', '*', B_TYPE_LARGE),
+	BINDER_TYPE_PTR		= B_PACK_CHARS('p', 't', '*', B_TYPE_LARGE),
 };
 
 enum {
@@ -61,6 +62,20 @@ struct flat_binder_object {
 	void			*cookie;
 };
 
+/*
+ * A BINDER_TYPE_PTR object describes a user buffer outside the parcel.
+ * The driver copies the buffer straight into the extra space of the
+ * target's transaction buffer (see BC_TRANSACTION_SG) and rewrites
+ * 'buffer' to where the receiver finds it.  It has the size of a
+ * flat_binder_object and is found through the same offsets array.
+ */
+struct binder_buffer_object {
+	unsigned long		type;		/* BINDER_TYPE_PTR */
+	unsigned long		flags;		/* must be zero */
+	void			*buffer;
+	size_t			length;
+};
+
 /*
  * On 64-bit platforms where user code may run in 32-bits the driver must
  * translate the buffer (and local binder) addresses apropriately.
@@ -147,6 +162,12 @@ struct binder_transaction_data {
 	} data;
 };
 
+struct binder_transaction_data_sg {
+	struct binder_transaction_data	transaction_data;
+	/* space for the BINDER_TYPE_PTR buffers, each pointer-aligned */
+	size_t				buffers_size;
+};
+
 struct binder_ptr_cookie {
 	void *ptr;
 	void *cookie;
@@ -324,6 +345,14 @@ enum BinderDriverCommandProtocol {
 	/*
 	 * void *: cookie
 	 */
+
+	BC_TRANSACTION_SG = _IOW('c', 17, struct binder_transaction_data_sg),
+	BC_REPLY_SG = _IOW('c', 18, struct binder_transaction_data_sg),
+	/*
+	 * binder_transaction_data_sg: the sent command, whose
+	 * BINDER_TYPE_PTR objects are gathered into buffers_size bytes
+	 * following the offsets.
+	 */
 };
 
 #endif /* _LINUX_BINDER_H */
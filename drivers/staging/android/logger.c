@@ -25,16 +25,39 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/mm.h>
 #include "logger.h"
 
+#include <asm/io.h>
 #include <asm/ioctls.h>
 
+/*
+ * struct logger_stage - per-cpu staging area for writers
+ *
+ * Writers append complete entries here holding only the stage's own mutex,
+ * which is shared just by tasks running on the same cpu, and readers
+ * merge the staged entries into the main ring (see logger_drain()). Entries
+ * are stored contiguously at LOGGER_STAGE_ALIGN-aligned offsets. 'w_off' is
+ * protected by 'mutex'; 'r_off' and 'end' are only used by logger_drain()
+ * and are protected by log->mutex.
+ */
+#define LOGGER_STAGE_SIZE	(8*1024)
+#define LOGGER_STAGE_ALIGN	4
+
+struct logger_stage {
+	struct mutex		mutex;	/* serializes writers on this cpu */
+	size_t			w_off;	/* end of the committed entries */
+	size_t			r_off;	/* next entry to merge */
+	size_t			end;	/* end of the entries being merged */
+	unsigned char		buffer[LOGGER_STAGE_SIZE];
+};
+
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
  * This structure lives from module insertion until module removal, so it does
  * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * mutex 'mutex', except for the write staging areas in 'stage'.
  */
 struct logger_log {
 	unsigned char 		*buffer;/* the ring buffer itself */
@@ -45,6 +68,8 @@ struct logger_log {
 	size_t			w_off;	/* current write head offset */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
+	struct logger_stage	*stage[NR_CPUS]; /* per-cpu write staging */
+	struct logger_mmap_index *index; /* index page shared with mmap */
 };
 
 /*
@@ -57,6 +82,7 @@ struct logger_reader {
 	struct logger_log	*log;	/* associated log */
 	struct list_head	list;	/* entry in logger_log's list */
 	size_t			r_off;	/* current read head offset */
+	int			mapped;	/* reads through mmap, not read() */
 };
 
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
@@ -85,6 +111,36 @@ static inline struct logger_log *file_get_log(struct file *file)
 		return file->private_data;
 }
 
+/*
+ * logger_index_begin - marks the mmap index as being updated, before the
+ * ring or its head are modified
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_index_begin(struct logger_log *log)
+{
+	if (!log->index)
+		return;
+	log->index->seq++;
+	smp_wmb();
+}
+
+/*
+ * logger_index_end - publishes the new write offset and head to mmap
+ * readers
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_index_end(struct logger_log *log)
+{
+	if (!log->index)
+		return;
+	log->index->w_off = log->w_off;
+	log->index->head = log->head;
+	smp_wmb();
+	log->index->seq++;
+}
+
 /*
  * get_entry_len - Grabs the length of the payload of the next entry starting
  * from 'off'.
@@ -142,6 +198,8 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 	return count;
 }
 
+static void logger_drain(struct logger_log *log);
+
 /*
  * logger_read - our log's read() method
  *
@@ -167,6 +225,7 @@ start:
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
 		mutex_lock(&log->mutex);
+		logger_drain(log);
 		ret = (log->w_off == reader->r_off);
 		mutex_unlock(&log->mutex);
 		if (!ret)
@@ -317,32 +376,113 @@ static ssize_t do_write_log_from_user(struct logger_log *log,
 }
 
 /*
- * logger_aio_write - our write method, implementing support for write(),
- * writev(), and aio_write(). Writes are our fast path, and we try to optimize
- * them above all else.
+ * logger_drain - merge the entries staged by writers on every cpu into the
+ * ring, oldest timestamp first
+ *
+ * Writers only ever append past a stage's 'w_off', so the entries below the
+ * snapshot taken in 'end' can be read without the stage mutex. The merged
+ * entries go through fix_up_readers() just like a direct write.
+ *
+ * The caller needs to hold log->mutex.
  */
-ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
-			 unsigned long nr_segs, loff_t ppos)
+static void logger_drain(struct logger_log *log)
+{
+	struct logger_stage *stage, *oldest;
+	struct logger_entry *entry, *first;
+	size_t len;
+	int cpu, staged = 0;
+
+	for_each_possible_cpu(cpu) {
+		stage = log->stage[cpu];
+		if (!stage)
+			continue;
+		mutex_lock(&stage->mutex);
+		stage->end = stage->w_off;
+		mutex_unlock(&stage->mutex);
+		stage->r_off = 0;
+		staged |= stage->end != 0;
+	}
+
+	if (!staged)
+		return;
+
+	logger_index_begin(log);
+	while (1) {
+		oldest = NULL;
+		first = NULL;
+		for_each_possible_cpu(cpu) {
+			stage = log->stage[cpu];
+			if (!stage || stage->r_off == stage->end)
+				continue;
+			entry = (struct logger_entry *)
+				(stage->buffer + stage->r_off);
+			if (!first || entry->sec < first->sec ||
+			    (entry->sec == first->sec &&
+			     entry->nsec < first->nsec)) {
+				oldest = stage;
+				first = entry;
+			}
+		}
+		if (!oldest)
+			break;
+
+		len = sizeof(struct logger_entry) + first->len;
+		fix_up_readers(log, len);
+		do_write_log(log, first, len);
+		oldest->r_off += ALIGN(len, LOGGER_STAGE_ALIGN);
+	}
+	logger_index_end(log);
+
+	/* drop the merged entries, keeping anything appended meanwhile */
+	for_each_possible_cpu(cpu) {
+		stage = log->stage[cpu];
+		if (!stage || !stage->end)
+			continue;
+		mutex_lock(&stage->mutex);
+		memmove(stage->buffer, stage->buffer + stage->end,
+			stage->w_off - stage->end);
+		stage->w_off -= stage->end;
+		mutex_unlock(&stage->mutex);
+		stage->end = 0;
+	}
+}
+
+/*
+ * logger_fill_header - stamps a new entry header with the current task and
+ * time
+ */
+static void logger_fill_header(struct logger_entry *header, size_t len)
 {
-	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
-	struct logger_entry header;
 	struct timespec now;
-	ssize_t ret = 0;
 
 	now = current_kernel_time();
 
-	header.pid = current->tgid;
-	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
-	header.len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
+	header->pid = current->tgid;
+	header->tid = current->pid;
+	header->sec = now.tv_sec;
+	header->nsec = now.tv_nsec;
+	header->len = len;
+}
 
-	/* null writes succeed, return zero */
-	if (unlikely(!header.len))
-		return 0;
+/*
+ * do_write_log_iov - writes one entry with a 'len' bytes payload gathered
+ * from 'iov' straight into the ring
+ *
+ * The caller needs to hold log->mutex.
+ *
+ * Returns 'len' on success, negative error code on failure.
+ */
+static ssize_t do_write_log_iov(struct logger_log *log,
+				const struct iovec *iov,
+				unsigned long nr_segs, size_t len)
+{
+	size_t orig = log->w_off;
+	struct logger_entry header;
+	ssize_t ret = 0;
 
-	mutex_lock(&log->mutex);
+	logger_fill_header(&header, len);
+
+	logger_index_begin(log);
 
 	/*
 	 * Fix up any readers, pulling them forward to the first readable
@@ -365,7 +505,7 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 		nr = do_write_log_from_user(log, iov->iov_base, len);
 		if (unlikely(nr < 0)) {
 			log->w_off = orig;
-			mutex_unlock(&log->mutex);
+			logger_index_end(log);
 			return nr;
 		}
 
@@ -373,7 +513,97 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 		ret += nr;
 	}
 
-	mutex_unlock(&log->mutex);
+	logger_index_end(log);
+
+	return ret;
+}
+
+/*
+ * logger_stage_write - appends one entry with a 'len' bytes payload gathered
+ * from 'iov' to the current cpu's staging area
+ *
+ * Returns 'len' on success, 0 if the stage has no room for the entry, and a
+ * negative error code on failure.
+ */
+static ssize_t logger_stage_write(struct logger_log *log,
+				  const struct iovec *iov,
+				  unsigned long nr_segs, size_t len)
+{
+	struct logger_stage *stage;
+	struct logger_entry header;
+	size_t off, count = 0;
+
+	stage = log->stage[raw_smp_processor_id()];
+	if (unlikely(!stage))
+		return 0;
+
+	mutex_lock(&stage->mutex);
+
+	off = stage->w_off;
+	if (off + sizeof(struct logger_entry) + len > LOGGER_STAGE_SIZE) {
+		mutex_unlock(&stage->mutex);
+		return 0;
+	}
+
+	/* stamped under the stage mutex, so each stage stays in time order */
+	logger_fill_header(&header, len);
+	memcpy(stage->buffer + off, &header, sizeof(struct logger_entry));
+	off += sizeof(struct logger_entry);
+
+	while (nr_segs-- > 0 && count < len) {
+		size_t seg = min_t(size_t, iov->iov_len, len - count);
+
+		if (seg && copy_from_user(stage->buffer + off, iov->iov_base,
+					  seg)) {
+			mutex_unlock(&stage->mutex);
+			return -EFAULT;
+		}
+
+		iov++;
+		off += seg;
+		count += seg;
+	}
+
+	/* commit; logger_drain() never looks past w_off */
+	stage->w_off = ALIGN(off, LOGGER_STAGE_ALIGN);
+
+	mutex_unlock(&stage->mutex);
+
+	return len;
+}
+
+/*
+ * logger_aio_write - our write method, implementing support for write(),
+ * writev(), and aio_write(). Writes are our fast path, and we try to optimize
+ * them above all else.
+ *
+ * Entries normally go to the writing cpu's staging area without touching
+ * log->mutex. Only when the stage is full do we take the mutex, merge the
+ * staged entries and write directly to the ring.
+ */
+ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
+			 unsigned long nr_segs, loff_t ppos)
+{
+	struct logger_log *log = file_get_log(iocb->ki_filp);
+	size_t len;
+	ssize_t ret;
+
+	len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
+
+	/* null writes succeed, return zero */
+	if (unlikely(!len))
+		return 0;
+
+	ret = logger_stage_write(log, iov, nr_segs, len);
+	if (ret == 0) {
+		mutex_lock(&log->mutex);
+		logger_drain(log);
+		ret = do_write_log_iov(log, iov, nr_segs, len);
+		mutex_unlock(&log->mutex);
+	}
+
+	if (unlikely(ret < 0))
+		return ret;
 
 	/* wake up any blocked readers */
 	wake_up_interruptible(&log->wq);
@@ -409,6 +639,7 @@ static int logger_open(struct inode *inode, struct file *file)
 			return -ENOMEM;
 
 		reader->log = log;
+		reader->mapped = 0;
 		INIT_LIST_HEAD(&reader->list);
 
 		mutex_lock(&log->mutex);
@@ -447,6 +678,10 @@ static int logger_release(struct inode *ignored, struct file *file)
  * guarantee that the log is readable without blocking, as there is a small
  * chance that the writer can lap the reader in the interim between poll()
  * returning and the read() request.
+ *
+ * A reader that has mapped the log never moves its read head with read(), so
+ * for it POLLIN means the log was written since the last time poll() returned
+ * POLLIN; it is expected to consume up to the index page's w_off each time.
  */
 static unsigned int logger_poll(struct file *file, poll_table *wait)
 {
@@ -463,13 +698,65 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
-	if (log->w_off != reader->r_off)
+	logger_drain(log);
+	if (log->w_off != reader->r_off) {
 		ret |= POLLIN | POLLRDNORM;
+		if (reader->mapped)
+			reader->r_off = log->w_off;
+	}
 	mutex_unlock(&log->mutex);
 
 	return ret;
 }
 
+/*
+ * logger_mmap - the log's mmap file operation
+ *
+ * Maps the index page at offset 0 followed by the whole ring, read-only. The
+ * reader follows the ring itself using the index page; see logger.h.
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_reader *reader;
+	struct logger_log *log;
+	int ret;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+
+	reader = file->private_data;
+	log = reader->log;
+
+	if (!log->index)
+		return -ENOMEM;
+
+	if (vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start != PAGE_SIZE + log->size)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	ret = remap_pfn_range(vma, vma->vm_start,
+			      virt_to_phys(log->index) >> PAGE_SHIFT,
+			      PAGE_SIZE, vma->vm_page_prot);
+	if (ret)
+		return ret;
+
+	ret = remap_pfn_range(vma, vma->vm_start + PAGE_SIZE,
+			      virt_to_phys(log->buffer) >> PAGE_SHIFT,
+			      log->size, vma->vm_page_prot);
+	if (ret)
+		return ret;
+
+	mutex_lock(&log->mutex);
+	reader->mapped = 1;
+	mutex_unlock(&log->mutex);
+
+	return 0;
+}
+
 static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct logger_log *log = file_get_log(file);
@@ -477,6 +764,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	long ret = -ENOTTY;
 
 	mutex_lock(&log->mutex);
+	logger_drain(log);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -509,9 +797,11 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			ret = -EBADF;
 			break;
 		}
+		logger_index_begin(log);
 		list_for_each_entry(reader, &log->readers, list)
 			reader->r_off = log->w_off;
 		log->head = log->w_off;
+		logger_index_end(log);
 		ret = 0;
 		break;
 	}
@@ -526,6 +816,7 @@ static const struct file_operations logger_fops = {
 	.read = logger_read,
 	.aio_write = logger_aio_write,
 	.poll = logger_poll,
+	.mmap = logger_mmap,
 	.unlocked_ioctl = logger_ioctl,
 	.compat_ioctl = logger_ioctl,
 	.open = logger_open,
@@ -535,10 +826,11 @@ static const struct file_operations logger_fops = {
 /*
  * Defines a log structure with name 'NAME' and a size of 'SIZE' bytes, which
  * must be a power of two, greater than LOGGER_ENTRY_MAX_LEN, and less than
- * LONG_MAX minus LOGGER_ENTRY_MAX_LEN.
+ * LONG_MAX minus LOGGER_ENTRY_MAX_LEN. The buffer is page aligned so it can be
+ * mapped by readers.
  */
 #define DEFINE_LOGGER_DEVICE(VAR, NAME, SIZE) \
-static unsigned char _buf_ ## VAR[SIZE]; \
+static unsigned char _buf_ ## VAR[SIZE] __aligned(PAGE_SIZE); \
 static struct logger_log VAR = { \
 	.buffer = _buf_ ## VAR, \
 	.misc = { \
@@ -575,7 +867,26 @@ static struct logger_log *get_log_from_minor(int minor)
 
 static int __init init_log(struct logger_log *log)
 {
-	int ret;
+	int ret, cpu;
+
+	/* a cpu without a stage just takes the log->mutex path */
+	for_each_possible_cpu(cpu) {
+		struct logger_stage *stage;
+
+		stage = kmalloc(sizeof(struct logger_stage), GFP_KERNEL);
+		if (!stage)
+			break;
+		mutex_init(&stage->mutex);
+		stage->w_off = 0;
+		stage->r_off = 0;
+		stage->end = 0;
+		log->stage[cpu] = stage;
+	}
+
+	/* without an index page the log just cannot be mapped */
+	log->index = (struct logger_mmap_index *)get_zeroed_page(GFP_KERNEL);
+	if (log->index)
+		log->index->size = log->size;
 
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
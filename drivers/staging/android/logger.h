@@ -30,6 +30,22 @@ struct logger_entry {
 	char		msg[0];	/* the entry's payload */
 };
 
+/*
+ * A reader may mmap() the log read-only: the first page holds a struct
+ * logger_mmap_index and the ring of 'size' bytes follows it. Entries are laid
+ * out in the ring exactly as read() returns them, wrapping at 'size'. The
+ * kernel makes 'seq' odd while it updates the ring or the index; a reader
+ * consumes from its own offset up to 'w_off' and, if 'seq' changed meanwhile,
+ * restarts from 'head' when the writer passed it. poll() wakes the reader
+ * when the log has been written since it last returned POLLIN.
+ */
+struct logger_mmap_index {
+	__u32		seq;	/* odd while the kernel updates the log */
+	__u32		w_off;	/* ring offset of the next entry written */
+	__u32		head;	/* ring offset of the oldest entry */
+	__u32		size;	/* size of the ring */
+};
+
 #define LOGGER_LOG_RADIO	"log_radio"	/* radio-related messages */
 #define LOGGER_LOG_EVENTS	"log_events"	/* system/hardware events */
 #define LOGGER_LOG_SYSTEM	"log_system"	/* system/framework messages */
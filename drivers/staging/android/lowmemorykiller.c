@@ -16,6 +16,27 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * Victims are picked from an index of tasks bucketed by oom_adj, fed by
+ * oom_adj writes and pruned when tasks are freed. Tasks that never had their
+ * oom_adj written are found by a full scan, at most once a second, when
+ * the index has no victim to offer.
+ *
+ * Before killing, the same tables drive trim notifications: /dev/lowmemnotify
+ * becomes readable for a process whose oom_adj is at or above lowmem_adj[i]
+ * once free memory drops below lowmem_minfree[i] plus notify_margin percent.
+ * A level is only left again once memory rises notify_hysteresis percent
+ * above its trim threshold, and at most one notification is sent every
+ * notify_interval_ms. read() returns the int oom_adj of the level that fired.
+ *
+ * With swap, typically on zram, anonymous pages that still fit in free swap
+ * can be reclaimed instead of killed for. swap_credit percent of them are
+ * counted as free memory, the share of a page that compressing it is
+ * expected to give back, so kills only start once swap cannot keep up.
+ *
+ * With the memory controller, how far a task's cgroup is over its soft
+ * limit is added to its size, so among tasks of the same oom_adj those of
+ * app groups past their memory budget go first.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  *
  * This software is licensed under the terms of the GNU General Public
@@ -32,9 +53,19 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/mm.h>
+#include <linux/memcontrol.h>
 #include <linux/oom.h>
 #include <linux/sched.h>
 #include <linux/notifier.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -51,9 +82,32 @@ static size_t lowmem_minfree[6] = {
 	16 * 1024,	/* 64MB */
 };
 static int lowmem_minfree_size = 4;
+static uint32_t lowmem_swap_credit = 50;
+static long lowmem_swap_used_at_kill;
 
 static struct task_struct *lowmem_deathpending;
 static unsigned long lowmem_deathpending_timeout;
+static unsigned long lowmem_scan_timeout;
+
+/*
+ * The victim index. lowmem_index_lock is taken from the task free notifier,
+ * which can run in softirq context, so it is irq safe and nothing else is
+ * taken under it.
+ */
+struct lowmem_candidate {
+	struct hlist_node	hash;	/* lowmem_hash, by task */
+	struct list_head	list;	/* lowmem_buckets, by oom_adj */
+	struct task_struct	*task;
+	int			oom_adj;
+};
+
+#define LOWMEM_HASH_BITS	6
+#define LOWMEM_BUCKETS		(OOM_ADJUST_MAX - OOM_DISABLE + 1)
+#define LOWMEM_BATCH		16
+
+static DEFINE_SPINLOCK(lowmem_index_lock);
+static struct hlist_head lowmem_hash[1 << LOWMEM_HASH_BITS];
+static struct list_head lowmem_buckets[LOWMEM_BUCKETS];
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -68,6 +122,84 @@ static struct notifier_block task_nb = {
 	.notifier_call	= task_notify_func,
 };
 
+static uint32_t lowmem_notify_margin = 25;
+static uint32_t lowmem_notify_hysteresis = 10;
+static uint32_t lowmem_notify_interval_ms = 1000;
+
+/*
+ * Trim notification state, protected by lowmem_notify_lock. The level is an
+ * index into lowmem_adj/lowmem_minfree, or -1 when memory is plentiful.
+ */
+static DEFINE_SPINLOCK(lowmem_notify_lock);
+static DECLARE_WAIT_QUEUE_HEAD(lowmem_notify_wait);
+static int lowmem_notify_level = -1;
+static int lowmem_notify_adj = OOM_ADJUST_MAX + 1;
+static unsigned int lowmem_notify_seq;
+static unsigned long lowmem_notify_last;
+
+static int
+oom_adj_notify_func(struct notifier_block *self, unsigned long val, void *data);
+
+static struct notifier_block oom_adj_nb = {
+	.notifier_call	= oom_adj_notify_func,
+};
+
+/* Called with lowmem_index_lock held */
+static struct lowmem_candidate *lowmem_index_find(struct task_struct *task)
+{
+	struct hlist_head *head;
+	struct hlist_node *pos;
+	struct lowmem_candidate *c;
+
+	head = &lowmem_hash[hash_ptr(task, LOWMEM_HASH_BITS)];
+	hlist_for_each_entry(c, pos, head, hash)
+		if (c->task == task)
+			return c;
+	return NULL;
+}
+
+static void lowmem_index_update(struct task_struct *task, int oom_adj)
+{
+	struct lowmem_candidate *c;
+	unsigned long flags;
+
+	if (oom_adj < OOM_DISABLE || oom_adj > OOM_ADJUST_MAX)
+		return;
+
+	spin_lock_irqsave(&lowmem_index_lock, flags);
+	c = lowmem_index_find(task);
+	if (!c) {
+		c = kmalloc(sizeof(*c), GFP_ATOMIC);
+		if (!c)
+			goto out;
+		c->task = task;
+		hlist_add_head(&c->hash,
+			&lowmem_hash[hash_ptr(task, LOWMEM_HASH_BITS)]);
+	} else if (c->oom_adj == oom_adj)
+		goto out;
+	else
+		list_del(&c->list);
+	c->oom_adj = oom_adj;
+	list_add(&c->list, &lowmem_buckets[oom_adj - OOM_DISABLE]);
+out:
+	spin_unlock_irqrestore(&lowmem_index_lock, flags);
+}
+
+static void lowmem_index_remove(struct task_struct *task)
+{
+	struct lowmem_candidate *c;
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_index_lock, flags);
+	c = lowmem_index_find(task);
+	if (c) {
+		hlist_del(&c->hash);
+		list_del(&c->list);
+	}
+	spin_unlock_irqrestore(&lowmem_index_lock, flags);
+	kfree(c);
+}
+
 static int
 task_notify_func(struct notifier_block *self, unsigned long val, void *data)
 {
@@ -76,15 +208,234 @@ task_notify_func(struct notifier_block *self, unsigned long val, void *data)
 	if (task == lowmem_deathpending)
 		lowmem_deathpending = NULL;
 
+	lowmem_index_remove(task);
+
 	return NOTIFY_OK;
 }
 
-static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
+static int
+oom_adj_notify_func(struct notifier_block *self, unsigned long val, void *data)
+{
+	lowmem_index_update(data, (int)val);
+
+	return NOTIFY_OK;
+}
+
+/*
+ * lowmem_task_size - returns the rss of 'p' plus the soft limit excess of
+ * its memory cgroup, or 0 if it has no mm
+ */
+static int lowmem_task_size(struct task_struct *p)
+{
+	int tasksize = 0;
+
+	task_lock(p);
+	if (p->mm && p->signal)
+		tasksize = get_mm_rss(p->mm);
+	task_unlock(p);
+
+	if (tasksize > 0)
+		tasksize += mem_cgroup_task_excess(p);
+
+	return tasksize;
+}
+
+/*
+ * lowmem_select_indexed - picks the largest task in the highest non-empty
+ * oom_adj bucket at or above 'min_adj' and returns it with a reference held.
+ *
+ * Candidates are pinned under lowmem_index_lock and sized outside it, as
+ * task_lock() must not nest inside an irq safe lock. A task whose usage has
+ * already dropped to zero is about to leave the index and is skipped.
+ */
+static struct task_struct *lowmem_select_indexed(int min_adj, int *size,
+						 int *adj)
+{
+	struct task_struct *batch[LOWMEM_BATCH];
+	struct task_struct *selected = NULL;
+	struct lowmem_candidate *c;
+	unsigned long flags;
+	int oom_adj, tasksize, n, i;
+
+	if (min_adj < OOM_DISABLE)
+		min_adj = OOM_DISABLE;
+
+	for (oom_adj = OOM_ADJUST_MAX; oom_adj >= min_adj; oom_adj--) {
+		if (list_empty(&lowmem_buckets[oom_adj - OOM_DISABLE]))
+			continue;
+
+		n = 0;
+		spin_lock_irqsave(&lowmem_index_lock, flags);
+		list_for_each_entry(c, &lowmem_buckets[oom_adj - OOM_DISABLE],
+				    list) {
+			if (n == LOWMEM_BATCH)
+				break;
+			if (atomic_inc_not_zero(&c->task->usage))
+				batch[n++] = c->task;
+		}
+		spin_unlock_irqrestore(&lowmem_index_lock, flags);
+
+		for (i = 0; i < n; i++) {
+			tasksize = lowmem_task_size(batch[i]);
+			if (tasksize <= 0 || (selected && tasksize <= *size)) {
+				put_task_struct(batch[i]);
+				continue;
+			}
+			if (selected)
+				put_task_struct(selected);
+			selected = batch[i];
+			*size = tasksize;
+			*adj = oom_adj;
+			lowmem_print(2, "select %d (%s), adj %d, size %d, "
+				     "to kill\n", selected->pid, selected->comm,
+				     oom_adj, tasksize);
+		}
+		if (selected)
+			break;
+	}
+
+	return selected;
+}
+
+/*
+ * lowmem_select_scan - the slow path: walks every process, like the index
+ * was never there, and adds the candidates it meets to the index.
+ */
+static struct task_struct *lowmem_select_scan(int min_adj, int *size, int *adj)
 {
 	struct task_struct *p;
 	struct task_struct *selected = NULL;
-	int rem = 0;
+	int selected_tasksize = 0;
+	int selected_oom_adj = min_adj;
 	int tasksize;
+
+	read_lock(&tasklist_lock);
+	for_each_process(p) {
+		struct mm_struct *mm;
+		struct signal_struct *sig;
+		int oom_adj;
+
+		task_lock(p);
+		mm = p->mm;
+		sig = p->signal;
+		if (!mm || !sig) {
+			task_unlock(p);
+			continue;
+		}
+		oom_adj = sig->oom_adj;
+		if (oom_adj < min_adj) {
+			task_unlock(p);
+			continue;
+		}
+		tasksize = get_mm_rss(mm);
+		task_unlock(p);
+		lowmem_index_update(p, oom_adj);
+		if (tasksize <= 0)
+			continue;
+		tasksize += mem_cgroup_task_excess(p);
+		if (selected) {
+			if (oom_adj < selected_oom_adj)
+				continue;
+			if (oom_adj == selected_oom_adj &&
+			    tasksize <= selected_tasksize)
+				continue;
+		}
+		selected = p;
+		selected_tasksize = tasksize;
+		selected_oom_adj = oom_adj;
+		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
+			     p->pid, p->comm, oom_adj, tasksize);
+	}
+	if (selected)
+		get_task_struct(selected);
+	read_unlock(&tasklist_lock);
+
+	*size = selected_tasksize;
+	*adj = selected_oom_adj;
+	return selected;
+}
+
+/*
+ * lowmem_notify_find_level - returns the most severe level whose trim
+ * threshold, raised by 'percent', is above both free and file pages, or -1
+ */
+static int lowmem_notify_find_level(int array_size, int percent,
+				    int other_free, int other_file)
+{
+	int i;
+
+	for (i = 0; i < array_size; i++) {
+		size_t minfree = lowmem_minfree[i] * (100 + percent) / 100;
+		if (other_free < minfree && other_file < minfree)
+			return i;
+	}
+	return -1;
+}
+
+static void lowmem_notify_update(int other_free, int other_file)
+{
+	int array_size = ARRAY_SIZE(lowmem_adj);
+	int enter, leave;
+
+	if (lowmem_adj_size < array_size)
+		array_size = lowmem_adj_size;
+	if (lowmem_minfree_size < array_size)
+		array_size = lowmem_minfree_size;
+
+	enter = lowmem_notify_find_level(array_size, lowmem_notify_margin,
+					 other_free, other_file);
+	leave = lowmem_notify_find_level(array_size, lowmem_notify_margin +
+					 lowmem_notify_hysteresis,
+					 other_free, other_file);
+
+	spin_lock(&lowmem_notify_lock);
+	if (enter >= 0 &&
+	    (lowmem_notify_level < 0 || enter < lowmem_notify_level)) {
+		/* more pressure; a suppressed event is retried next time */
+		if (lowmem_notify_seq &&
+		    time_before(jiffies, lowmem_notify_last +
+				msecs_to_jiffies(lowmem_notify_interval_ms)))
+			goto out;
+		lowmem_notify_level = enter;
+		lowmem_notify_adj = lowmem_adj[enter];
+		lowmem_notify_seq++;
+		lowmem_notify_last = jiffies;
+		lowmem_print(3, "lowmem_notify level %d, adj %d, ofree %d %d\n",
+			     enter, lowmem_notify_adj, other_free, other_file);
+		wake_up_interruptible(&lowmem_notify_wait);
+	} else if (lowmem_notify_level >= 0 &&
+		   (leave < 0 || leave > lowmem_notify_level)) {
+		/* relaxed past the hysteresis band; no event for that */
+		lowmem_notify_level = leave;
+		lowmem_notify_adj = leave < 0 ? OOM_ADJUST_MAX + 1 :
+				    lowmem_adj[leave];
+	}
+out:
+	spin_unlock(&lowmem_notify_lock);
+}
+
+/*
+ * lowmem_swap_reclaimable - returns the number of pages that swapping out
+ * anonymous memory is still expected to free
+ */
+static int lowmem_swap_reclaimable(void)
+{
+	long anon, swappable;
+
+	if (!lowmem_swap_credit || nr_swap_pages <= 0)
+		return 0;
+
+	anon = global_page_state(NR_ACTIVE_ANON) +
+		global_page_state(NR_INACTIVE_ANON);
+	swappable = min(anon, nr_swap_pages);
+
+	return swappable * min_t(uint32_t, lowmem_swap_credit, 100) / 100;
+}
+
+static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
+{
+	struct task_struct *selected = NULL;
+	int rem = 0;
 	int i;
 	int min_adj = OOM_ADJUST_MAX + 1;
 	int selected_tasksize = 0;
@@ -93,6 +444,12 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 	int other_free = global_page_state(NR_FREE_PAGES);
 	int other_file = global_page_state(NR_FILE_PAGES) -
 						global_page_state(NR_SHMEM);
+	int other_swap = lowmem_swap_reclaimable();
+	long swap_used = total_swap_pages - nr_swap_pages;
+
+	other_free += other_swap;
+
+	lowmem_notify_update(other_free, other_file);
 
 	/*
 	 * If we already have a death outstanding, then
@@ -109,6 +466,11 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 		array_size = lowmem_adj_size;
 	if (lowmem_minfree_size < array_size)
 		array_size = lowmem_minfree_size;
+	/* the thresholds ascend, so clearing the last one clears them all */
+	if (array_size > 0 &&
+	    (other_free >= lowmem_minfree[array_size - 1] ||
+	     other_file >= lowmem_minfree[array_size - 1]))
+		array_size = 0;
 	for (i = 0; i < array_size; i++) {
 		if (other_free < lowmem_minfree[i] &&
 		    other_file < lowmem_minfree[i]) {
@@ -117,9 +479,9 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 		}
 	}
 	if (nr_to_scan > 0)
-		lowmem_print(3, "lowmem_shrink %d, %x, ofree %d %d, ma %d\n",
-			     nr_to_scan, gfp_mask, other_free, other_file,
-			     min_adj);
+		lowmem_print(3, "lowmem_shrink %d, %x, ofree %d %d, "
+			     "swap %d, ma %d\n", nr_to_scan, gfp_mask,
+			     other_free, other_file, other_swap, min_adj);
 	rem = global_page_state(NR_ACTIVE_ANON) +
 		global_page_state(NR_ACTIVE_FILE) +
 		global_page_state(NR_INACTIVE_ANON) +
@@ -131,56 +493,126 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 	}
 	selected_oom_adj = min_adj;
 
-	read_lock(&tasklist_lock);
-	for_each_process(p) {
-		struct mm_struct *mm;
-		struct signal_struct *sig;
-		int oom_adj;
-
-		task_lock(p);
-		mm = p->mm;
-		sig = p->signal;
-		if (!mm || !sig) {
-			task_unlock(p);
-			continue;
-		}
-		oom_adj = sig->oom_adj;
-		if (oom_adj < min_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_adj < selected_oom_adj)
-				continue;
-			if (oom_adj == selected_oom_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_adj = oom_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_adj, tasksize);
+	selected = lowmem_select_indexed(min_adj, &selected_tasksize,
+					 &selected_oom_adj);
+	if (!selected && time_after_eq(jiffies, lowmem_scan_timeout)) {
+		lowmem_scan_timeout = jiffies + HZ;
+		selected = lowmem_select_scan(min_adj, &selected_tasksize,
+					      &selected_oom_adj);
 	}
 	if (selected) {
-		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
+		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d, "
+			     "swap used %ld of %ld, %+ld since last kill\n",
 			     selected->pid, selected->comm,
-			     selected_oom_adj, selected_tasksize);
+			     selected_oom_adj, selected_tasksize,
+			     swap_used, total_swap_pages,
+			     swap_used - lowmem_swap_used_at_kill);
+		lowmem_swap_used_at_kill = swap_used;
 		lowmem_deathpending = selected;
 		lowmem_deathpending_timeout = jiffies + HZ;
 		force_sig(SIGKILL, selected);
 		rem -= selected_tasksize;
+		put_task_struct(selected);
 	}
 	lowmem_print(4, "lowmem_shrink %d, %x, return %d\n",
 		     nr_to_scan, gfp_mask, rem);
-	read_unlock(&tasklist_lock);
 	return rem;
 }
 
+/*
+ * A reader tracks the last event it consumed; events for levels that do not
+ * reach its process's oom_adj are consumed without ever being pending.
+ */
+static int lowmem_notify_pending(unsigned int *seq, int *adj)
+{
+	int pending;
+
+	spin_lock(&lowmem_notify_lock);
+	pending = lowmem_notify_seq != *seq &&
+		  current->signal->oom_adj >= lowmem_notify_adj;
+	*seq = lowmem_notify_seq;
+	*adj = lowmem_notify_adj;
+	spin_unlock(&lowmem_notify_lock);
+
+	return pending;
+}
+
+static int lowmem_notify_open(struct inode *inode, struct file *file)
+{
+	unsigned int *seq;
+
+	seq = kmalloc(sizeof(*seq), GFP_KERNEL);
+	if (!seq)
+		return -ENOMEM;
+
+	/* only events from now on */
+	spin_lock(&lowmem_notify_lock);
+	*seq = lowmem_notify_seq;
+	spin_unlock(&lowmem_notify_lock);
+
+	file->private_data = seq;
+	return nonseekable_open(inode, file);
+}
+
+static int lowmem_notify_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static ssize_t lowmem_notify_read(struct file *file, char __user *buf,
+				  size_t count, loff_t *pos)
+{
+	unsigned int *seq = file->private_data;
+	unsigned int next = *seq;
+	int adj;
+	int ret;
+
+	if (count < sizeof(adj))
+		return -EINVAL;
+
+	while (!lowmem_notify_pending(&next, &adj)) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(lowmem_notify_wait,
+			lowmem_notify_seq != next);
+		if (ret)
+			return ret;
+	}
+
+	if (copy_to_user(buf, &adj, sizeof(adj)))
+		return -EFAULT;
+	*seq = next;
+
+	return sizeof(adj);
+}
+
+static unsigned int lowmem_notify_poll(struct file *file, poll_table *wait)
+{
+	unsigned int next = *(unsigned int *)file->private_data;
+	int adj;
+
+	poll_wait(file, &lowmem_notify_wait, wait);
+
+	if (lowmem_notify_pending(&next, &adj))
+		return POLLIN | POLLRDNORM;
+	return 0;
+}
+
+static const struct file_operations lowmem_notify_fops = {
+	.owner = THIS_MODULE,
+	.read = lowmem_notify_read,
+	.poll = lowmem_notify_poll,
+	.open = lowmem_notify_open,
+	.release = lowmem_notify_release,
+};
+
+static struct miscdevice lowmem_notify_misc = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "lowmemnotify",
+	.fops = &lowmem_notify_fops,
+};
+
 static struct shrinker lowmem_shrinker = {
 	.shrink = lowmem_shrink,
 	.seeks = DEFAULT_SEEKS * 16
@@ -188,15 +620,35 @@ static struct shrinker lowmem_shrinker = {
 
 static int __init lowmem_init(void)
 {
+	int i;
+
+	for (i = 0; i < LOWMEM_BUCKETS; i++)
+		INIT_LIST_HEAD(&lowmem_buckets[i]);
 	task_free_register(&task_nb);
+	register_oom_adj_notifier(&oom_adj_nb);
 	register_shrinker(&lowmem_shrinker);
+	if (misc_register(&lowmem_notify_misc))
+		printk(KERN_ERR "lowmemorykiller: failed to register "
+		       "notification device\n");
 	return 0;
 }
 
 static void __exit lowmem_exit(void)
 {
+	struct lowmem_candidate *c, *tmp;
+	int i;
+
+	misc_deregister(&lowmem_notify_misc);
 	unregister_shrinker(&lowmem_shrinker);
+	unregister_oom_adj_notifier(&oom_adj_nb);
 	task_free_unregister(&task_nb);
+	for (i = 0; i < LOWMEM_BUCKETS; i++) {
+		list_for_each_entry_safe(c, tmp, &lowmem_buckets[i], list) {
+			hlist_del(&c->hash);
+			list_del(&c->list);
+			kfree(c);
+		}
+	}
 }
 
 module_param_named(cost, lowmem_shrinker.seeks, int, S_IRUGO | S_IWUSR);
@@ -205,6 +657,13 @@ module_param_array_named(adj, lowmem_adj, int, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+module_param_named(swap_credit, lowmem_swap_credit, uint, S_IRUGO | S_IWUSR);
+module_param_named(notify_margin, lowmem_notify_margin, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(notify_hysteresis, lowmem_notify_hysteresis, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(notify_interval_ms, lowmem_notify_interval_ms, uint,
+		   S_IRUGO | S_IWUSR);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
@@ -24,6 +24,10 @@
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 #include <linux/rslib.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/notifier.h>
+#include <linux/reboot.h>
 #endif
 
 struct ram_console_buffer {
@@ -53,6 +57,22 @@ static int ram_console_bad_blocks;
 #define ECC_SIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_ECC_SIZE
 #define ECC_SYMSIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_SYMBOL_SIZE
 #define ECC_POLY CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_POLYNOMIAL
+
+/*
+ * Data blocks are not encoded from the console write path.  Writes only
+ * mark the blocks they touch dirty, and a delayed work encodes them in
+ * batches.  The panic and reboot notifiers encode whatever is still
+ * dirty and switch back to synchronous encoding, so the last messages
+ * before a crash stay recoverable.  Until workqueues are up, or if the
+ * dirty map can't be allocated, blocks are encoded synchronously.
+ */
+#define ECC_DELAY (HZ / 10)
+static unsigned long *ram_console_ecc_dirty;
+static int ram_console_ecc_blocks;
+static int ram_console_ecc_busy = -1;
+static int ram_console_ecc_deferred;
+static void ram_console_ecc_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(ram_console_ecc_dwork, ram_console_ecc_work);
 #endif
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
@@ -78,27 +98,93 @@ static int ram_console_decode_rs8(void *data, size_t len, uint8_t *ecc)
 }
 #endif
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+static void ram_console_encode_block(int i)
+{
+	uint8_t *block = ram_console_buffer->data + i * ECC_BLOCK_SIZE;
+	int size = ECC_BLOCK_SIZE;
+
+	if (block + size > ram_console_buffer->data + ram_console_buffer_size)
+		size = ram_console_buffer->data + ram_console_buffer_size - block;
+	ram_console_encode_rs8(block, size,
+			       ram_console_par_buffer + i * ECC_SIZE);
+}
+
+static void ram_console_ecc_work(struct work_struct *work)
+{
+	int i;
+
+	for_each_set_bit(i, ram_console_ecc_dirty, ram_console_ecc_blocks) {
+		/* tells a concurrent flush which block may be half done */
+		ram_console_ecc_busy = i;
+		if (test_and_clear_bit(i, ram_console_ecc_dirty))
+			ram_console_encode_block(i);
+	}
+	ram_console_ecc_busy = -1;
+}
+
+static void ram_console_ecc_flush(void)
+{
+	int i, busy = ACCESS_ONCE(ram_console_ecc_busy);
+
+	ram_console_ecc_deferred = 0;
+	if (!ram_console_ecc_dirty)
+		return;
+
+	if (busy >= 0)
+		ram_console_encode_block(busy);
+	for_each_set_bit(i, ram_console_ecc_dirty, ram_console_ecc_blocks) {
+		clear_bit(i, ram_console_ecc_dirty);
+		ram_console_encode_block(i);
+	}
+}
+
+static int ram_console_ecc_notify(struct notifier_block *nb,
+				  unsigned long event, void *unused)
+{
+	ram_console_ecc_flush();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ram_console_panic_nb = {
+	.notifier_call	= ram_console_ecc_notify,
+};
+
+static struct notifier_block ram_console_reboot_nb = {
+	.notifier_call	= ram_console_ecc_notify,
+};
+
+static int __init ram_console_ecc_init(void)
+{
+	atomic_notifier_chain_register(&panic_notifier_list,
+				       &ram_console_panic_nb);
+	register_reboot_notifier(&ram_console_reboot_nb);
+	ram_console_ecc_deferred = 1;
+	return 0;
+}
+core_initcall(ram_console_ecc_init);
+#endif
+
 static void ram_console_update(const char *s, unsigned int count)
 {
 	struct ram_console_buffer *buffer = ram_console_buffer;
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	uint8_t *buffer_end = buffer->data + ram_console_buffer_size;
-	uint8_t *block;
-	uint8_t *par;
-	int size = ECC_BLOCK_SIZE;
+	int first = buffer->start / ECC_BLOCK_SIZE;
+	int last = (buffer->start + count - 1) / ECC_BLOCK_SIZE;
+	int i;
 #endif
 	memcpy(buffer->data + buffer->start, s, count);
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	block = buffer->data + (buffer->start & ~(ECC_BLOCK_SIZE - 1));
-	par = ram_console_par_buffer +
-	      (buffer->start / ECC_BLOCK_SIZE) * ECC_SIZE;
-	do {
-		if (block + ECC_BLOCK_SIZE > buffer_end)
-			size = buffer_end - block;
-		ram_console_encode_rs8(block, size, par);
-		block += ECC_BLOCK_SIZE;
-		par += ECC_SIZE;
-	} while (block < buffer->data + buffer->start + count);
+	if (ram_console_ecc_dirty && ram_console_ecc_deferred) {
+		/* the data must be visible before the dirty bits */
+		smp_mb__before_clear_bit();
+		for (i = first; i <= last; i++)
+			set_bit(i, ram_console_ecc_dirty);
+		schedule_delayed_work(&ram_console_ecc_dwork, ECC_DELAY);
+		return;
+	}
+	for (i = first; i <= last; i++)
+		ram_console_encode_block(i);
 #endif
 }
 
@@ -265,6 +351,11 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 	ram_console_corrected_bytes = 0;
 	ram_console_bad_blocks = 0;
 
+	ram_console_ecc_blocks = DIV_ROUND_UP(ram_console_buffer_size,
+					      ECC_BLOCK_SIZE);
+	ram_console_ecc_dirty = kzalloc(BITS_TO_LONGS(ram_console_ecc_blocks) *
+					sizeof(long), GFP_KERNEL);
+
 	par = ram_console_par_buffer +
 	      DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE) * ECC_SIZE;
 
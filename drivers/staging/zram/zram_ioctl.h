@@ -31,11 +31,14 @@ struct zram_ioctl_stats {
 	u64 orig_data_size;
 	u64 compr_data_size;
 	u64 mem_used_total;
+	u32 pages_same;		/* no. of non-zero same filled pages */
+	u64 discard_free;	/* no. of pages freed by discard requests */
 } __attribute__ ((packed, aligned(4)));
 
 #define ZRAMIO_SET_DISKSIZE_KB	_IOW('z', 0, size_t)
 #define ZRAMIO_GET_STATS	_IOR('z', 1, struct zram_ioctl_stats)
 #define ZRAMIO_INIT		_IO('z', 2)
 #define ZRAMIO_RESET		_IO('z', 3)
+#define ZRAMIO_COMPACT		_IO('z', 4)
 
 #endif
@@ -0,0 +1,863 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+/*
+ * Objects are grouped by size class and stored in zspages, groups of
+ * 0-order pages that may come from highmem. Objects of a class are laid
+ * out back to back across the pages of a zspage, so an object may start
+ * in one page and end in the next. Such objects are accessed through a
+ * per-cpu buffer by zs_map_object()/zs_unmap_object().
+ *
+ * struct page fields used:
+ *	page->private: next page of the zspage, or 0 for the last one
+ *	PG_private: set on the first page of a zspage
+ *
+ * first page only:
+ *	page->mapping: class index and fullness group
+ *	page->freelist: index + 1 of the first free object, or 0 if full
+ *	page->inuse: number of objects in use
+ *	page->lru: entry in the fullness list of the size class
+ *
+ * other pages:
+ *	page->index: first page of the zspage
+ *
+ * Each object starts with a header word. For a used object it holds the
+ * handle with OBJ_ALLOCATED_TAG set, for a free one the encoded index of
+ * the next free object. Handles are words allocated from a slab cache
+ * and hold the object location, so compaction can move an object by
+ * rewriting its handle. The low bit of the handle is a bit spinlock
+ * held while the object is mapped or freed, and compaction skips pinned
+ * objects.
+ */
+
+#include <linux/bitops.h>
+#include <linux/errno.h>
+#include <linux/highmem.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/bit_spinlock.h>
+
+#include "zsmalloc.h"
+#include "zsmalloc_int.h"
+
+/*
+ * The handle cache and the per-cpu mapping buffers are shared by all
+ * pools and exist while at least one pool does.
+ */
+static DEFINE_PER_CPU(struct mapping_area, zs_map_area);
+static struct kmem_cache *zs_handle_cachep;
+static DEFINE_MUTEX(zs_global_lock);
+static int zs_nr_pools;
+
+static int is_first_page(struct page *page)
+{
+	return PagePrivate(page);
+}
+
+static struct page *get_first_page(struct page *page)
+{
+	if (is_first_page(page))
+		return page;
+	return (struct page *)page->index;
+}
+
+static struct page *get_next_page(struct page *page)
+{
+	return (struct page *)page_private(page);
+}
+
+static void get_zspage_mapping(struct page *first_page, int *class_idx,
+				enum fullness_group *fullness)
+{
+	unsigned long m = (unsigned long)first_page->mapping;
+
+	*fullness = m & FULLNESS_MASK;
+	*class_idx = m >> FULLNESS_BITS;
+}
+
+static void set_zspage_mapping(struct page *first_page, int class_idx,
+				enum fullness_group fullness)
+{
+	unsigned long m = (class_idx << FULLNESS_BITS) | fullness;
+
+	first_page->mapping = (struct address_space *)m;
+}
+
+static struct size_class *get_zspage_class(struct zs_pool *pool,
+				struct page *first_page)
+{
+	int class_idx;
+	enum fullness_group fullness;
+
+	get_zspage_mapping(first_page, &class_idx, &fullness);
+	return &pool->size_class[class_idx];
+}
+
+static int get_size_class_index(int size)
+{
+	int idx = 0;
+
+	if (likely(size > ZS_MIN_ALLOC_SIZE))
+		idx = DIV_ROUND_UP(size - ZS_MIN_ALLOC_SIZE,
+				ZS_SIZE_CLASS_DELTA);
+
+	return idx;
+}
+
+/*
+ * Pick the zspage size, in pages, that wastes the least space for
+ * objects of the given size.
+ */
+static int get_pages_per_zspage(int class_size)
+{
+	int i, max_usedpc = 0;
+	int max_usedpc_order = 1;
+
+	for (i = 1; i <= ZS_MAX_PAGES_PER_ZSPAGE; i++) {
+		int zspage_size = i * PAGE_SIZE;
+		int waste = zspage_size % class_size;
+		int usedpc = (zspage_size - waste) * 100 / zspage_size;
+
+		if (usedpc > max_usedpc) {
+			max_usedpc = usedpc;
+			max_usedpc_order = i;
+		}
+	}
+
+	return max_usedpc_order;
+}
+
+static enum fullness_group get_fullness_group(struct size_class *class,
+				struct page *first_page)
+{
+	int inuse = first_page->inuse;
+	int max_objects = class->objs_per_zspage;
+
+	if (inuse == 0)
+		return ZS_EMPTY;
+	if (inuse == max_objects)
+		return ZS_FULL;
+	if (inuse <= max_objects * ZS_ALMOST_EMPTY_QUARTERS / 4)
+		return ZS_ALMOST_EMPTY;
+	return ZS_ALMOST_FULL;
+}
+
+static void insert_zspage(struct page *first_page, struct size_class *class,
+				enum fullness_group fullness)
+{
+	if (fullness >= _ZS_NR_FULLNESS_GROUPS)
+		return;
+
+	list_add_tail(&first_page->lru, &class->fullness_list[fullness]);
+}
+
+static void remove_zspage(struct page *first_page, struct size_class *class,
+				enum fullness_group fullness)
+{
+	if (fullness >= _ZS_NR_FULLNESS_GROUPS)
+		return;
+
+	list_del_init(&first_page->lru);
+}
+
+/*
+ * Move a zspage to the list matching its current fullness. Called with
+ * class->lock held after objects were allocated or freed in it.
+ */
+static enum fullness_group fix_fullness_group(struct size_class *class,
+				struct page *first_page)
+{
+	int class_idx;
+	enum fullness_group currfg, newfg;
+
+	get_zspage_mapping(first_page, &class_idx, &currfg);
+	newfg = get_fullness_group(class, first_page);
+	if (newfg == currfg)
+		goto out;
+
+	remove_zspage(first_page, class, currfg);
+	insert_zspage(first_page, class, newfg);
+	set_zspage_mapping(first_page, class_idx, newfg);
+
+out:
+	return newfg;
+}
+
+/* Returns a zspage of the class with at least one free object */
+static struct page *find_get_zspage(struct size_class *class)
+{
+	int i;
+
+	for (i = 0; i < _ZS_NR_FULLNESS_GROUPS; i++) {
+		if (!list_empty(&class->fullness_list[i]))
+			return list_first_entry(&class->fullness_list[i],
+						struct page, lru);
+	}
+
+	return NULL;
+}
+
+static unsigned long location_to_obj(struct page *page, unsigned long offset)
+{
+	unsigned long obj;
+
+	obj = page_to_pfn(page) << OBJ_INDEX_BITS;
+	obj |= (offset >> ZS_ALIGN_SHIFT) & OBJ_INDEX_MASK;
+
+	return obj << OBJ_TAG_BITS;
+}
+
+static void obj_to_location(unsigned long obj, struct page **page,
+				unsigned long *offset)
+{
+	obj >>= OBJ_TAG_BITS;
+	*page = pfn_to_page(obj >> OBJ_INDEX_BITS);
+	*offset = (obj & OBJ_INDEX_MASK) << ZS_ALIGN_SHIFT;
+}
+
+/* Free list links and first_page->freelist hold (index + 1) << tag bits */
+static unsigned long obj_idx_to_link(int obj_idx)
+{
+	return (unsigned long)(obj_idx + 1) << OBJ_TAG_BITS;
+}
+
+static int link_to_obj_idx(unsigned long link)
+{
+	return (link >> OBJ_TAG_BITS) - 1;
+}
+
+static struct page *obj_idx_to_page(struct page *first_page,
+				struct size_class *class, int obj_idx,
+				unsigned long *offset)
+{
+	struct page *page = first_page;
+	unsigned long off = (unsigned long)obj_idx * class->size;
+
+	while (off >= PAGE_SIZE) {
+		page = get_next_page(page);
+		off -= PAGE_SIZE;
+	}
+
+	*offset = off;
+	return page;
+}
+
+static int location_to_obj_idx(struct page *first_page,
+				struct size_class *class, struct page *page,
+				unsigned long offset)
+{
+	struct page *p;
+	unsigned long off = offset;
+
+	for (p = first_page; p != page; p = get_next_page(p))
+		off += PAGE_SIZE;
+
+	return off / class->size;
+}
+
+static unsigned long handle_to_obj(unsigned long handle)
+{
+	return *(unsigned long *)handle & ~BIT(HANDLE_PIN_BIT);
+}
+
+static void record_obj(unsigned long handle, unsigned long obj)
+{
+	*(unsigned long *)handle = obj;
+}
+
+static void pin_tag(unsigned long handle)
+{
+	bit_spin_lock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static int trypin_tag(unsigned long handle)
+{
+	return bit_spin_trylock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static void unpin_tag(unsigned long handle)
+{
+	bit_spin_unlock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static void reset_page(struct page *page)
+{
+	ClearPagePrivate(page);
+	set_page_private(page, 0);
+	page->mapping = NULL;
+	page->freelist = NULL;
+	reset_page_mapcount(page);
+}
+
+static void free_zspage(struct page *first_page)
+{
+	struct page *page, *next;
+
+	for (page = first_page; page; page = next) {
+		next = get_next_page(page);
+		reset_page(page);
+		__free_page(page);
+	}
+}
+
+/* Link all objects of a new zspage into its free list */
+static void init_zspage(struct page *first_page, struct size_class *class)
+{
+	struct page *page = first_page;
+	unsigned long off = 0;
+	int obj_idx = 0;
+
+	first_page->freelist = (void *)obj_idx_to_link(0);
+
+	while (page && obj_idx < class->objs_per_zspage) {
+		unsigned char *vaddr = kmap_atomic(page, KM_USER0);
+
+		while (off < PAGE_SIZE && obj_idx < class->objs_per_zspage) {
+			unsigned long *link = (unsigned long *)(vaddr + off);
+
+			if (obj_idx + 1 < class->objs_per_zspage)
+				*link = obj_idx_to_link(obj_idx + 1);
+			else
+				*link = 0;
+
+			obj_idx++;
+			off += class->size;
+		}
+
+		kunmap_atomic(vaddr, KM_USER0);
+		off -= PAGE_SIZE;
+		page = get_next_page(page);
+	}
+}
+
+static struct page *alloc_zspage(struct size_class *class, gfp_t flags)
+{
+	int i;
+	struct page *first_page = NULL, *prev_page = NULL;
+
+	for (i = 0; i < class->pages_per_zspage; i++) {
+		struct page *page;
+
+		page = alloc_page(flags);
+		if (!page)
+			goto cleanup;
+
+		INIT_LIST_HEAD(&page->lru);
+		set_page_private(page, 0);
+		if (i == 0) {
+			SetPagePrivate(page);
+			page->inuse = 0;
+			first_page = page;
+		} else {
+			page->index = (unsigned long)first_page;
+			set_page_private(prev_page, (unsigned long)page);
+		}
+		prev_page = page;
+	}
+
+	init_zspage(first_page, class);
+	set_zspage_mapping(first_page, class->index, ZS_EMPTY);
+
+	return first_page;
+
+cleanup:
+	if (first_page)
+		free_zspage(first_page);
+	return NULL;
+}
+
+/* Take the first free object of a zspage. Called with class->lock held. */
+static unsigned long obj_malloc(struct size_class *class,
+				struct page *first_page, unsigned long handle)
+{
+	struct page *page;
+	unsigned long offset, *link;
+	unsigned char *vaddr;
+	int obj_idx;
+
+	obj_idx = link_to_obj_idx((unsigned long)first_page->freelist);
+	page = obj_idx_to_page(first_page, class, obj_idx, &offset);
+
+	vaddr = kmap_atomic(page, KM_USER0);
+	link = (unsigned long *)(vaddr + offset);
+	first_page->freelist = (void *)*link;
+	*link = handle | OBJ_ALLOCATED_TAG;
+	kunmap_atomic(vaddr, KM_USER0);
+
+	first_page->inuse++;
+
+	return location_to_obj(page, offset);
+}
+
+/* Called with class->lock held */
+static void obj_free(struct size_class *class, unsigned long obj)
+{
+	struct page *page, *first_page;
+	unsigned long offset, *link;
+	unsigned char *vaddr;
+	int obj_idx;
+
+	obj_to_location(obj, &page, &offset);
+	first_page = get_first_page(page);
+	obj_idx = location_to_obj_idx(first_page, class, page, offset);
+
+	vaddr = kmap_atomic(page, KM_USER0);
+	link = (unsigned long *)(vaddr + offset);
+	*link = (unsigned long)first_page->freelist;
+	kunmap_atomic(vaddr, KM_USER0);
+
+	first_page->freelist = (void *)obj_idx_to_link(obj_idx);
+	first_page->inuse--;
+}
+
+/*
+ * Copy size bytes between buf and the object data at <page, offset>,
+ * following the zspage into the next page if needed.
+ */
+static void zs_copy_object(char *buf, struct page *page, unsigned long offset,
+				int size, int to_object)
+{
+	while (size) {
+		int n = min_t(int, size, PAGE_SIZE - offset);
+		unsigned char *vaddr = kmap_atomic(page, KM_USER1);
+
+		if (to_object)
+			memcpy(vaddr + offset, buf, n);
+		else
+			memcpy(buf, vaddr + offset, n);
+		kunmap_atomic(vaddr, KM_USER1);
+
+		buf += n;
+		size -= n;
+		offset = 0;
+		page = get_next_page(page);
+	}
+}
+
+/* Copy a whole object, header included, for compaction */
+static void zs_move_object(unsigned long dst_obj, unsigned long src_obj,
+				struct size_class *class)
+{
+	struct page *s_page, *d_page;
+	unsigned long s_off, d_off;
+	int size = class->size;
+
+	obj_to_location(src_obj, &s_page, &s_off);
+	obj_to_location(dst_obj, &d_page, &d_off);
+
+	while (size) {
+		unsigned char *s_addr, *d_addr;
+		int n = min_t(int, size, PAGE_SIZE - s_off);
+
+		n = min_t(int, n, PAGE_SIZE - d_off);
+
+		s_addr = kmap_atomic(s_page, KM_USER0);
+		d_addr = kmap_atomic(d_page, KM_USER1);
+		memcpy(d_addr + d_off, s_addr + s_off, n);
+		kunmap_atomic(d_addr, KM_USER1);
+		kunmap_atomic(s_addr, KM_USER0);
+
+		size -= n;
+		s_off += n;
+		d_off += n;
+		if (s_off == PAGE_SIZE) {
+			s_page = get_next_page(s_page);
+			s_off = 0;
+		}
+		if (d_off == PAGE_SIZE) {
+			d_page = get_next_page(d_page);
+			d_off = 0;
+		}
+	}
+}
+
+static void zs_put_global(void)
+{
+	int cpu;
+
+	mutex_lock(&zs_global_lock);
+	if (--zs_nr_pools)
+		goto out;
+
+	for_each_possible_cpu(cpu) {
+		struct mapping_area *area = &per_cpu(zs_map_area, cpu);
+
+		kfree(area->vm_buf);
+		area->vm_buf = NULL;
+	}
+
+	if (zs_handle_cachep)
+		kmem_cache_destroy(zs_handle_cachep);
+	zs_handle_cachep = NULL;
+out:
+	mutex_unlock(&zs_global_lock);
+}
+
+static int zs_get_global(void)
+{
+	int cpu;
+
+	mutex_lock(&zs_global_lock);
+	if (zs_nr_pools++)
+		goto out;
+
+	zs_handle_cachep = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
+					ZS_HANDLE_SIZE, 0, NULL);
+	if (!zs_handle_cachep)
+		goto fail;
+
+	for_each_possible_cpu(cpu) {
+		struct mapping_area *area = &per_cpu(zs_map_area, cpu);
+
+		area->vm_buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		if (!area->vm_buf)
+			goto fail;
+	}
+
+out:
+	mutex_unlock(&zs_global_lock);
+	return 0;
+
+fail:
+	mutex_unlock(&zs_global_lock);
+	zs_put_global();
+	return -ENOMEM;
+}
+
+/*
+ * Create a memory pool. Sets up the size classes and other
+ * per-pool metadata.
+ */
+struct zs_pool *zs_create_pool(void)
+{
+	int i;
+	struct zs_pool *pool;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return NULL;
+
+	if (zs_get_global()) {
+		kfree(pool);
+		return NULL;
+	}
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		int fg;
+		struct size_class *class = &pool->size_class[i];
+
+		class->size = ZS_MIN_ALLOC_SIZE + i * ZS_SIZE_CLASS_DELTA;
+		class->index = i;
+		class->pages_per_zspage = get_pages_per_zspage(class->size);
+		class->objs_per_zspage = class->pages_per_zspage *
+						PAGE_SIZE / class->size;
+		spin_lock_init(&class->lock);
+		for (fg = 0; fg < _ZS_NR_FULLNESS_GROUPS; fg++)
+			INIT_LIST_HEAD(&class->fullness_list[fg]);
+	}
+
+	atomic_long_set(&pool->pages_allocated, 0);
+
+	return pool;
+}
+
+/* All objects must have been freed */
+void zs_destroy_pool(struct zs_pool *pool)
+{
+	if (atomic_long_read(&pool->pages_allocated))
+		pr_info("zsmalloc: destroying pool with %ld pages in use\n",
+			atomic_long_read(&pool->pages_allocated));
+
+	kfree(pool);
+	zs_put_global();
+}
+
+/**
+ * zs_malloc - Allocate block of given size from pool.
+ * @pool: pool to allocate from
+ * @size: size of block to allocate
+ * @flags: gfp flags for the backing pages, may include __GFP_HIGHMEM
+ *
+ * Returns a handle to the object, or 0 on failure. The object must be
+ * mapped with zs_map_object() before it can be accessed.
+ *
+ * Allocation requests with size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE
+ * will fail.
+ */
+unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t flags)
+{
+	unsigned long handle, obj;
+	struct size_class *class;
+	struct page *first_page;
+
+	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE))
+		return 0;
+
+	handle = (unsigned long)kmem_cache_alloc(zs_handle_cachep,
+						flags & ~__GFP_HIGHMEM);
+	if (unlikely(!handle))
+		return 0;
+
+	class = &pool->size_class[get_size_class_index(size + ZS_HANDLE_SIZE)];
+
+	spin_lock(&class->lock);
+	first_page = find_get_zspage(class);
+
+	if (!first_page) {
+		spin_unlock(&class->lock);
+		first_page = alloc_zspage(class, flags);
+		if (unlikely(!first_page)) {
+			kmem_cache_free(zs_handle_cachep, (void *)handle);
+			return 0;
+		}
+
+		atomic_long_add(class->pages_per_zspage,
+				&pool->pages_allocated);
+		spin_lock(&class->lock);
+	}
+
+	obj = obj_malloc(class, first_page, handle);
+	fix_fullness_group(class, first_page);
+	record_obj(handle, obj);
+	spin_unlock(&class->lock);
+
+	return handle;
+}
+
+void zs_free(struct zs_pool *pool, unsigned long handle)
+{
+	unsigned long obj, offset;
+	struct page *page, *first_page;
+	struct size_class *class;
+	enum fullness_group fullness;
+
+	if (unlikely(!handle))
+		return;
+
+	/* Keeps compaction from moving the object under us */
+	pin_tag(handle);
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &page, &offset);
+	first_page = get_first_page(page);
+	class = get_zspage_class(pool, first_page);
+
+	spin_lock(&class->lock);
+	obj_free(class, obj);
+	fullness = fix_fullness_group(class, first_page);
+	spin_unlock(&class->lock);
+	unpin_tag(handle);
+
+	if (fullness == ZS_EMPTY) {
+		atomic_long_sub(class->pages_per_zspage,
+				&pool->pages_allocated);
+		free_zspage(first_page);
+	}
+
+	kmem_cache_free(zs_handle_cachep, (void *)handle);
+}
+
+/**
+ * zs_map_object - get address of allocated object from handle.
+ * @pool: pool from which the object was allocated
+ * @handle: handle returned from zs_malloc
+ * @mm: how the object will be accessed
+ *
+ * Objects within one page are kmapped with KM_USER1, objects that span
+ * two pages are copied to a per-cpu buffer. Preemption is disabled until
+ * zs_unmap_object(), and only one object can be mapped per cpu at a time.
+ */
+void *zs_map_object(struct zs_pool *pool, unsigned long handle,
+			enum zs_mapmode mm)
+{
+	unsigned long obj, offset;
+	struct page *page;
+	struct size_class *class;
+	struct mapping_area *area;
+
+	pin_tag(handle);
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &page, &offset);
+	class = get_zspage_class(pool, get_first_page(page));
+
+	area = &get_cpu_var(zs_map_area);
+	area->vm_mm = mm;
+
+	if (offset + class->size <= PAGE_SIZE) {
+		area->vm_addr = kmap_atomic(page, KM_USER1);
+		return area->vm_addr + offset + ZS_HANDLE_SIZE;
+	}
+
+	/* The header never crosses a page, only the data does */
+	area->vm_addr = NULL;
+	if (mm != ZS_MM_WO)
+		zs_copy_object(area->vm_buf, page, offset + ZS_HANDLE_SIZE,
+				class->size - ZS_HANDLE_SIZE, 0);
+
+	return area->vm_buf;
+}
+
+void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
+{
+	unsigned long obj, offset;
+	struct page *page;
+	struct size_class *class;
+	struct mapping_area *area;
+
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &page, &offset);
+	class = get_zspage_class(pool, get_first_page(page));
+
+	area = &__get_cpu_var(zs_map_area);
+	if (area->vm_addr)
+		kunmap_atomic(area->vm_addr, KM_USER1);
+	else if (area->vm_mm != ZS_MM_RO)
+		zs_copy_object(area->vm_buf, page, offset + ZS_HANDLE_SIZE,
+				class->size - ZS_HANDLE_SIZE, 1);
+
+	put_cpu_var(zs_map_area);
+	unpin_tag(handle);
+}
+
+/*
+ * Move objects from src to dst until src is empty or dst is full.
+ * Objects that are currently mapped are left where they are. Returns the
+ * number of objects moved. Called with class->lock held and both zspages
+ * off the fullness lists.
+ */
+static int migrate_zspage(struct size_class *class, struct page *src,
+				struct page *dst)
+{
+	int obj_idx, nr_moved = 0;
+
+	for (obj_idx = 0; obj_idx < class->objs_per_zspage &&
+			src->inuse && dst->freelist; obj_idx++) {
+		struct page *page;
+		unsigned long offset, header, handle, old_obj, new_obj;
+		unsigned char *vaddr;
+
+		page = obj_idx_to_page(src, class, obj_idx, &offset);
+		vaddr = kmap_atomic(page, KM_USER0);
+		header = *(unsigned long *)(vaddr + offset);
+		kunmap_atomic(vaddr, KM_USER0);
+
+		if (!(header & OBJ_ALLOCATED_TAG))
+			continue;
+
+		handle = header & ~OBJ_ALLOCATED_TAG;
+		if (!trypin_tag(handle))
+			continue;
+
+		old_obj = location_to_obj(page, offset);
+		new_obj = obj_malloc(class, dst, handle);
+		zs_move_object(new_obj, old_obj, class);
+		record_obj(handle, new_obj | BIT(HANDLE_PIN_BIT));
+		unpin_tag(handle);
+		obj_free(class, old_obj);
+
+		nr_moved++;
+	}
+
+	return nr_moved;
+}
+
+static void putback_zspage(struct size_class *class, struct page *first_page)
+{
+	enum fullness_group fullness = get_fullness_group(class, first_page);
+
+	insert_zspage(first_page, class, fullness);
+	set_zspage_mapping(first_page, class->index, fullness);
+}
+
+static unsigned long compact_class(struct zs_pool *pool,
+				struct size_class *class)
+{
+	unsigned long pages_freed = 0;
+	struct list_head *almost_empty;
+	struct page *src, *dst;
+	int nr_moved;
+
+	almost_empty = &class->fullness_list[ZS_ALMOST_EMPTY];
+
+	spin_lock(&class->lock);
+	while (!list_empty(almost_empty)) {
+		src = list_entry(almost_empty->prev, struct page, lru);
+		remove_zspage(src, class, ZS_ALMOST_EMPTY);
+
+		do {
+			dst = find_get_zspage(class);
+			if (!dst)
+				break;
+
+			remove_zspage(dst, class, ZS_ALMOST_FULL);
+			nr_moved = migrate_zspage(class, src, dst);
+			putback_zspage(class, dst);
+		} while (src->inuse && nr_moved);
+
+		if (src->inuse) {
+			putback_zspage(class, src);
+			break;
+		}
+
+		set_zspage_mapping(src, class->index, ZS_EMPTY);
+		spin_unlock(&class->lock);
+
+		atomic_long_sub(class->pages_per_zspage,
+				&pool->pages_allocated);
+		free_zspage(src);
+		pages_freed += class->pages_per_zspage;
+
+		cond_resched();
+		spin_lock(&class->lock);
+	}
+	spin_unlock(&class->lock);
+
+	return pages_freed;
+}
+
+/**
+ * zs_compact - move objects out of sparsely used zspages
+ * @pool: pool to compact
+ *
+ * Empties almost empty zspages into other zspages of the same class and
+ * frees them. Must be called from process context. Returns the number of
+ * pages freed.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	int i;
+	unsigned long pages_freed = 0;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		/* Nothing to gain if each zspage holds one object */
+		if (class->objs_per_zspage == 1)
+			continue;
+
+		pages_freed += compact_class(pool, class);
+	}
+
+	return pages_freed;
+}
+
+/*
+ * Returns total memory used by allocator (userdata + metadata)
+ */
+u64 zs_get_total_size_bytes(struct zs_pool *pool)
+{
+	return (u64)atomic_long_read(&pool->pages_allocated) << PAGE_SHIFT;
+}
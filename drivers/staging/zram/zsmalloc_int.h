@@ -0,0 +1,111 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZS_MALLOC_INT_H_
+#define _ZS_MALLOC_INT_H_
+
+#include <linux/kernel.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+/* User configurable params */
+
+/* Must be power of two */
+#define ZS_ALIGN_SHIFT	4
+#define ZS_ALIGN	(1 << ZS_ALIGN_SHIFT)
+
+/*
+ * Every object starts with a word holding its handle, which lets
+ * compaction find the handle of an object it moves.
+ */
+#define ZS_HANDLE_SIZE	(sizeof(unsigned long))
+
+/* This must be a multiple of ZS_ALIGN and larger than ZS_HANDLE_SIZE */
+#define ZS_MIN_ALLOC_SIZE	32
+#define ZS_MAX_ALLOC_SIZE	PAGE_SIZE
+
+/* Size classes are separated by ZS_SIZE_CLASS_DELTA bytes */
+#define ZS_SIZE_CLASS_DELTA	ZS_ALIGN
+#define ZS_SIZE_CLASSES	((ZS_MAX_ALLOC_SIZE - ZS_MIN_ALLOC_SIZE) \
+				/ ZS_SIZE_CLASS_DELTA + 1)
+
+/*
+ * A zspage is a group of up to this many 0-order pages, not necessarily
+ * contiguous or lowmem, that holds objects of one size class. Objects
+ * may cross the boundary between two pages of a zspage.
+ */
+#define ZS_MAX_PAGES_PER_ZSPAGE	4
+
+/* End of user params */
+
+/*
+ * Object location: <pfn, offset / ZS_ALIGN> shifted left by OBJ_TAG_BITS.
+ * The low bit is used as a pin bit in the handle and as the allocated
+ * tag in the object header.
+ */
+#define OBJ_TAG_BITS		1
+#define OBJ_ALLOCATED_TAG	1
+#define OBJ_INDEX_BITS		(PAGE_SHIFT - ZS_ALIGN_SHIFT)
+#define OBJ_INDEX_MASK		((1UL << OBJ_INDEX_BITS) - 1)
+
+#define HANDLE_PIN_BIT		0
+
+/* Bits of first_page->mapping used for the fullness group */
+#define FULLNESS_BITS		2
+#define FULLNESS_MASK		((1UL << FULLNESS_BITS) - 1)
+
+/*
+ * Zspages with at most this fraction (n/4) of their objects in use are
+ * almost empty, and are what compaction empties.
+ */
+#define ZS_ALMOST_EMPTY_QUARTERS	3
+
+enum fullness_group {
+	ZS_ALMOST_FULL,
+	ZS_ALMOST_EMPTY,
+	_ZS_NR_FULLNESS_GROUPS,
+
+	/* Not kept on any list */
+	ZS_EMPTY,
+	ZS_FULL,
+};
+
+struct size_class {
+	spinlock_t lock;
+	/* Zspages that still have free objects, by fullness */
+	struct list_head fullness_list[_ZS_NR_FULLNESS_GROUPS];
+
+	int size;		/* object size, including the handle */
+	int index;
+	int pages_per_zspage;
+	int objs_per_zspage;
+};
+
+/*
+ * Per-cpu state of zs_map_object(). vm_addr is the kmap of the page
+ * holding the object, or NULL if the object spans pages and was copied
+ * to vm_buf.
+ */
+struct mapping_area {
+	char *vm_buf;
+	char *vm_addr;
+	enum zs_mapmode vm_mm;
+};
+
+struct zs_pool {
+	struct size_class size_class[ZS_SIZE_CLASSES];
+
+	/* stats */
+	atomic_long_t pages_allocated;
+};
+
+#endif
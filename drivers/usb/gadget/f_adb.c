@@ -35,7 +35,7 @@
 #define BULK_BUFFER_SIZE           4096
 
 /* number of tx requests to allocate */
-#define TX_REQ_MAX 4
+#define TX_REQ_MAX 8
 
 static const char shortname[] = "android_adb";
 
@@ -29,6 +29,7 @@
 
 #include <linux/blkdev.h>
 #include <linux/pagemap.h>
+#include <linux/aio.h>
 #include <asm/unaligned.h>
 #include <linux/smp_lock.h>
 
@@ -876,6 +877,220 @@ ffs_epfile_read(struct file *file, char __user *buf, size_t len, loff_t *ptr)
 	return ffs_epfile_io(file, buf, len, 1);
 }
 
+
+/* Asynchronous I/O.  Every kiocb gets its own request and buffer so
+ * user space can keep as many transfers queued on an endpoint as it
+ * likes instead of waiting for each one to complete.  The request is
+ * only freed together with the kiocb so that cancel never races with
+ * completion freeing it under our feet. */
+
+struct ffs_io_data {
+	struct usb_ep			*ep;
+	struct usb_request		*req;
+	char				*buf;
+
+	/* Only for reads; data is copied out from the retry callback
+	 * which runs with the submitter's mm. */
+	const struct iovec		*iv;
+	unsigned long			nr_segs;
+	unsigned			actual;
+};
+
+static void ffs_epfile_aio_dtor(struct kiocb *iocb)
+{
+	struct ffs_io_data *io_data = iocb->private;
+
+	ENTER();
+
+	if (io_data) {
+		usb_ep_free_request(io_data->ep, io_data->req);
+		kfree(io_data->buf);
+		kfree(io_data);
+		iocb->private = NULL;
+	}
+}
+
+static int ffs_epfile_aio_cancel(struct kiocb *iocb, struct io_event *e)
+{
+	struct ffs_io_data *io_data = iocb->private;
+	int ret;
+
+	ENTER();
+
+	/* The request is completed with -ECONNRESET, aio_complete()
+	 * then drops the kiocb without reporting another event. */
+	ret = usb_ep_dequeue(io_data->ep, io_data->req);
+
+	aio_put_req(iocb);
+	return ret;
+}
+
+static ssize_t ffs_epfile_aio_read_retry(struct kiocb *iocb)
+{
+	struct ffs_io_data *io_data = iocb->private;
+	const char *data = io_data->buf;
+	size_t total = io_data->actual;
+	ssize_t ret = 0;
+	unsigned long i;
+
+	ENTER();
+
+	for (i = 0; i < io_data->nr_segs && total; ++i) {
+		size_t n = min(io_data->iv[i].iov_len, total);
+
+		if (unlikely(copy_to_user(io_data->iv[i].iov_base, data, n))) {
+			if (!ret)
+				ret = -EFAULT;
+			break;
+		}
+
+		data  += n;
+		total -= n;
+		ret   += n;
+	}
+
+	return ret;
+}
+
+static void ffs_epfile_aio_complete(struct usb_ep *_ep,
+				    struct usb_request *req)
+{
+	struct kiocb *iocb = req->context;
+	struct ffs_io_data *io_data = iocb->private;
+
+	ENTER();
+
+	if (io_data->iv && likely(req->actual)) {
+		io_data->actual = req->actual;
+		kick_iocb(iocb);
+	} else {
+		aio_complete(iocb, req->actual ? req->actual : req->status,
+			     req->status);
+	}
+}
+
+static ssize_t ffs_epfile_aio(struct kiocb *iocb, const struct iovec *iv,
+			      unsigned long nr_segs, int read)
+{
+	struct ffs_epfile *epfile = iocb->ki_filp->private_data;
+	struct ffs_io_data *io_data;
+	struct usb_request *req;
+	size_t len = iocb->ki_left;
+	struct ffs_ep *ep;
+	ssize_t ret;
+
+	if (WARN_ON(epfile->ffs->state != FFS_ACTIVE))
+		return -ENODEV;
+
+	/* Wait for endpoint to be enabled */
+	if (!epfile->ep) {
+		if (iocb->ki_filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		if (unlikely(wait_event_interruptible(epfile->wait,
+						      epfile->ep)))
+			return -EINTR;
+	}
+
+	io_data = kzalloc(sizeof *io_data, GFP_KERNEL);
+	if (unlikely(!io_data))
+		return -ENOMEM;
+
+	io_data->buf = kmalloc(len, GFP_KERNEL);
+	if (unlikely(!io_data->buf)) {
+		ret = -ENOMEM;
+		goto error;
+	}
+
+	if (read) {
+		io_data->iv      = iv;
+		io_data->nr_segs = nr_segs;
+	} else {
+		char *data = io_data->buf;
+		unsigned long i;
+
+		for (i = 0; i < nr_segs; ++i) {
+			if (unlikely(copy_from_user(data, iv[i].iov_base,
+						    iv[i].iov_len))) {
+				ret = -EFAULT;
+				goto error;
+			}
+			data += iv[i].iov_len;
+		}
+	}
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+
+	ep = epfile->ep;
+	if (unlikely(!ep)) {
+		ret = -ENODEV;
+		goto error_unlock;
+	}
+
+	/* There is no way to report a halt through aio */
+	if (!read == !epfile->in) {
+		ret = -EINVAL;
+		goto error_unlock;
+	}
+
+	req = usb_ep_alloc_request(ep->ep, GFP_ATOMIC);
+	if (unlikely(!req)) {
+		ret = -ENOMEM;
+		goto error_unlock;
+	}
+
+	io_data->ep  = ep->ep;
+	io_data->req = req;
+
+	req->buf      = io_data->buf;
+	req->length   = len;
+	req->complete = ffs_epfile_aio_complete;
+	req->context  = iocb;
+
+	iocb->private   = io_data;
+	iocb->ki_dtor   = ffs_epfile_aio_dtor;
+	iocb->ki_cancel = ffs_epfile_aio_cancel;
+	if (read)
+		iocb->ki_retry = ffs_epfile_aio_read_retry;
+
+	ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
+	if (unlikely(ret)) {
+		iocb->private   = NULL;
+		iocb->ki_dtor   = NULL;
+		iocb->ki_cancel = NULL;
+		usb_ep_free_request(ep->ep, req);
+		goto error_unlock;
+	}
+
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	return read ? -EIOCBRETRY : -EIOCBQUEUED;
+
+error_unlock:
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+error:
+	kfree(io_data->buf);
+	kfree(io_data);
+	return ret;
+}
+
+static ssize_t
+ffs_epfile_aio_write(struct kiocb *iocb, const struct iovec *iv,
+		     unsigned long nr_segs, loff_t pos)
+{
+	ENTER();
+
+	return ffs_epfile_aio(iocb, iv, nr_segs, 0);
+}
+
+static ssize_t
+ffs_epfile_aio_read(struct kiocb *iocb, const struct iovec *iv,
+		    unsigned long nr_segs, loff_t pos)
+{
+	ENTER();
+
+	return ffs_epfile_aio(iocb, iv, nr_segs, 1);
+}
+
 static int
 ffs_epfile_open(struct inode *inode, struct file *file)
 {
@@ -951,6 +1166,8 @@ static const struct file_operations ffs_epfile_operations = {
 	.open =		ffs_epfile_open,
 	.write =	ffs_epfile_write,
 	.read =		ffs_epfile_read,
+	.aio_write =	ffs_epfile_aio_write,
+	.aio_read =	ffs_epfile_aio_read,
 	.release =	ffs_epfile_release,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
 };
@@ -30,6 +30,10 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
+#include <linux/highmem.h>
+#include <linux/ktime.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -52,7 +56,10 @@
 
 /* number of tx and rx requests to allocate */
 #define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+#define RX_REQ_MAX 4
+
+/* number of bufferless tx requests used to send page cache pages */
+#define TX_PAGE_REQ_MAX 32
 
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
@@ -89,6 +96,7 @@ struct mtp_dev {
 	atomic_t ioctl_excl;
 
 	struct list_head tx_idle;
+	struct list_head tx_page_idle;
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
@@ -108,6 +116,14 @@ struct mtp_dev {
 	loff_t xfer_file_offset;
 	int64_t xfer_file_length;
 	int xfer_result;
+
+	/* file transfer statistics, exported in sysfs */
+	u64 tx_bytes;
+	u64 tx_usecs;
+	u64 tx_cpu_usecs;
+	u64 rx_bytes;
+	u64 rx_usecs;
+	u64 rx_cpu_usecs;
 };
 
 static struct usb_interface_descriptor mtp_interface_desc = {
@@ -357,11 +373,28 @@ static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->write_wq);
 }
 
+/* a page cache page was sent, drop our reference to it */
+static void mtp_complete_in_page(struct usb_ep *ep, struct usb_request *req)
+{
+	struct mtp_dev *dev = _mtp_dev;
+
+	if (req->status != 0)
+		dev->state = STATE_ERROR;
+
+	put_page(req->context);
+	req->context = NULL;
+	req->buf = NULL;
+	req_put(dev, &dev->tx_page_idle, req);
+
+	wake_up(&dev->write_wq);
+}
+
 static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
+	/* rx requests complete in the order they were queued */
+	dev->rx_done++;
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
@@ -435,6 +468,13 @@ static int __init create_bulk_endpoints(struct mtp_dev *dev,
 		req->complete = mtp_complete_in;
 		req_put(dev, &dev->tx_idle, req);
 	}
+	for (i = 0; i < TX_PAGE_REQ_MAX; i++) {
+		req = usb_ep_alloc_request(dev->ep_in, GFP_KERNEL);
+		if (!req)
+			goto fail;
+		req->complete = mtp_complete_in_page;
+		req_put(dev, &dev->tx_page_idle, req);
+	}
 	for (i = 0; i < RX_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_out, BULK_BUFFER_SIZE);
 		if (!req)
@@ -624,6 +664,106 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/* queue one pipe buffer of the file on the IN endpoint */
+static int mtp_send_pipe_buf(struct pipe_inode_info *pipe,
+		struct pipe_buffer *buf, struct splice_desc *sd)
+{
+	struct mtp_dev *dev = sd->u.data;
+	struct usb_request *req = 0;
+	struct list_head *idle;
+	void *src;
+	int ret;
+
+	ret = buf->ops->confirm(pipe, buf);
+	if (ret)
+		return ret;
+
+	/* highmem pages have no address the udc could map for dma */
+	if (PageHighMem(buf->page))
+		idle = &dev->tx_idle;
+	else
+		idle = &dev->tx_page_idle;
+
+	ret = wait_event_interruptible(dev->write_wq,
+		(req = req_get(dev, idle)) || dev->state != STATE_BUSY);
+	if (dev->state == STATE_CANCELED) {
+		if (req)
+			req_put(dev, idle, req);
+		return -ECANCELED;
+	}
+	if (!req)
+		return ret ? ret : -EIO;
+
+	if (idle == &dev->tx_idle) {
+		src = buf->ops->map(pipe, buf, 1);
+		memcpy(req->buf, src + buf->offset, sd->len);
+		buf->ops->unmap(pipe, buf, src);
+	} else {
+		/* the pipe drops its reference before the transfer is done */
+		get_page(buf->page);
+		req->context = buf->page;
+		req->buf = page_address(buf->page) + buf->offset;
+	}
+
+	req->length = sd->len;
+	ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
+	if (ret < 0) {
+		DBG(dev->cdev, "send_file_work: xfer error %d\n", ret);
+		dev->state = STATE_ERROR;
+		if (req->context) {
+			put_page(req->context);
+			req->context = NULL;
+			req->buf = NULL;
+		}
+		req_put(dev, idle, req);
+		return -EIO;
+	}
+
+	return sd->len;
+}
+
+static int mtp_send_actor(struct pipe_inode_info *pipe, struct splice_desc *sd)
+{
+	struct splice_desc psd = {
+		.total_len = sd->total_len,
+		.flags = sd->flags,
+		.pos = sd->pos,
+		.u.data = sd->u.data,
+	};
+
+	return __splice_from_pipe(pipe, &psd, mtp_send_pipe_buf);
+}
+
+/*
+ * Send the file by splicing its page cache pages straight into usb
+ * requests, so the data is never copied by the cpu.
+ */
+static int send_file_splice(struct mtp_dev *dev, struct file *filp,
+		loff_t *offset, int64_t *count)
+{
+	struct splice_desc sd = {
+		.pos = *offset,
+		.u.data = dev,
+	};
+	long ret;
+
+	while (*count > 0) {
+		sd.total_len = min_t(int64_t, *count, INT_MAX);
+		ret = splice_direct_to_actor(filp, &sd, mtp_send_actor);
+		if (ret < 0)
+			return ret;
+		if (ret == 0) {
+			/* end of file, nothing more to send */
+			*count = 0;
+			break;
+		}
+		*count -= ret;
+	}
+
+	*offset = sd.pos;
+	return 0;
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data) {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, send_file_work);
@@ -635,6 +775,8 @@ static void send_file_work(struct work_struct *data) {
 	int xfer, ret;
 	int r = 0;
 	int sendZLP = 0;
+	ktime_t start;
+	u64 cpu_start;
 
 	/* read our parameters */
 	smp_rmb();
@@ -644,6 +786,9 @@ static void send_file_work(struct work_struct *data) {
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	start = ktime_get();
+	cpu_start = task_sched_runtime(current);
+
 	/* we need to send a zero length packet to signal the end of transfer
 	 * if the transfer size is aligned to a packet boundary.
 	 */
@@ -651,7 +796,15 @@ static void send_file_work(struct work_struct *data) {
 		sendZLP = 1;
 	}
 
-	while (count > 0 || sendZLP) {
+	/* the copying loop below then only sends the ZLP */
+	if ((filp->f_mode & FMODE_READ) && filp->f_op &&
+	    filp->f_op->splice_read) {
+		r = send_file_splice(dev, filp, &offset, &count);
+		if (r)
+			sendZLP = 0;
+	}
+
+	while (r == 0 && (count > 0 || sendZLP)) {
 		/* so we exit after sending ZLP */
 		if (count == 0)
 			sendZLP = 0;
@@ -699,6 +852,11 @@ static void send_file_work(struct work_struct *data) {
 	if (req)
 		req_put(dev, &dev->tx_idle, req);
 
+	dev->tx_bytes += dev->xfer_file_length - count;
+	dev->tx_usecs += ktime_us_delta(ktime_get(), start);
+	dev->tx_cpu_usecs += div_u64(task_sched_runtime(current) - cpu_start,
+				     NSEC_PER_USEC);
+
 	DBG(cdev, "send_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -710,12 +868,14 @@ static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, unqueued;
+	int ret, queued = 0, done = 0, max_queued;
 	int r = 0;
+	ktime_t start;
+	u64 cpu_start, bytes = 0;
 
 	/* read our parameters */
 	smp_rmb();
@@ -725,62 +885,80 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	start = ktime_get();
+	cpu_start = task_sched_runtime(current);
+
+	/* if xfer_file_length is 0xFFFFFFFF, then we read until we get a
+	 * short packet, and anything queued past it would be lost.
+	 */
+	unqueued = count;
+	max_queued = (count == 0xFFFFFFFF) ? 1 : RX_REQ_MAX;
+	dev->rx_done = 0;
 
-			read_req->length = (count > BULK_BUFFER_SIZE
-					? BULK_BUFFER_SIZE : count);
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+	while (count > 0) {
+		/* keep reads queued while the oldest one is written out */
+		while (unqueued > 0 && queued - done < max_queued) {
+			req = dev->rx_req[queued % RX_REQ_MAX];
+			req->length = (unqueued > BULK_BUFFER_SIZE
+					? BULK_BUFFER_SIZE : unqueued);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			if (count != 0xFFFFFFFF)
+				unqueued -= req->length;
+			queued++;
 		}
 
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+		/* wait for the oldest read to complete */
+		req = dev->rx_req[done % RX_REQ_MAX];
+		ret = wait_event_interruptible(dev->read_wq,
+			dev->rx_done > done || dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			break;
+		}
+		if (dev->rx_done <= done) {
+			r = ret ? ret : -EIO;
+			break;
+		}
+		done++;
+
+		if (count != 0xFFFFFFFF)
+			count -= req->actual;
+		if (req->actual < req->length) {
+			/* short packet is used to signal EOF for sizes > 4 gig */
+			DBG(cdev, "got short packet\n");
+			count = 0;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/* short packet is used to signal EOF for sizes > 4 gig */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
-
-			write_req = read_req;
-			read_req = NULL;
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			break;
 		}
+		bytes += ret;
+	}
+
+out:
+	/* a short packet or an error ends the transfer early */
+	while (done < queued) {
+		if (dev->rx_done <= done)
+			usb_ep_dequeue(dev->ep_out,
+				       dev->rx_req[done % RX_REQ_MAX]);
+		done++;
 	}
 
+	dev->rx_bytes += bytes;
+	dev->rx_usecs += ktime_us_delta(ktime_get(), start);
+	dev->rx_cpu_usecs += div_u64(task_sched_runtime(current) - cpu_start,
+				     NSEC_PER_USEC);
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -965,6 +1143,37 @@ static struct miscdevice mtp_device = {
 	.fops = &mtp_fops,
 };
 
+/* cumulative file transfer statistics in /sys/class/misc/mtp_usb/ */
+#define MTP_STAT_ATTR(field)						\
+static ssize_t field##_show(struct device *d,				\
+		struct device_attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%llu\n",					\
+		       (unsigned long long)_mtp_dev->field);		\
+}									\
+static DEVICE_ATTR(field, S_IRUGO, field##_show, NULL)
+
+MTP_STAT_ATTR(tx_bytes);
+MTP_STAT_ATTR(tx_usecs);
+MTP_STAT_ATTR(tx_cpu_usecs);
+MTP_STAT_ATTR(rx_bytes);
+MTP_STAT_ATTR(rx_usecs);
+MTP_STAT_ATTR(rx_cpu_usecs);
+
+static struct attribute *mtp_stats_attrs[] = {
+	&dev_attr_tx_bytes.attr,
+	&dev_attr_tx_usecs.attr,
+	&dev_attr_tx_cpu_usecs.attr,
+	&dev_attr_rx_bytes.attr,
+	&dev_attr_rx_usecs.attr,
+	&dev_attr_rx_cpu_usecs.attr,
+	NULL,
+};
+
+static struct attribute_group mtp_stats_group = {
+	.attrs = mtp_stats_attrs,
+};
+
 static int
 mtp_function_bind(struct usb_configuration *c, struct usb_function *f)
 {
@@ -1012,12 +1221,15 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	spin_lock_irq(&dev->lock);
 	while ((req = req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
+	while ((req = req_get(dev, &dev->tx_page_idle)))
+		usb_ep_free_request(dev->ep_in, req);
 	for (i = 0; i < RX_REQ_MAX; i++)
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
 	mtp_request_free(dev->intr_req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
 	spin_unlock_irq(&dev->lock);
 
+	sysfs_remove_group(&mtp_device.this_device->kobj, &mtp_stats_group);
 	misc_deregister(&mtp_device);
 	kfree(_mtp_dev);
 	_mtp_dev = NULL;
@@ -1210,6 +1422,7 @@ static int mtp_bind_config(struct usb_configuration *c)
 	atomic_set(&dev->open_excl, 0);
 	atomic_set(&dev->ioctl_excl, 0);
 	INIT_LIST_HEAD(&dev->tx_idle);
+	INIT_LIST_HEAD(&dev->tx_page_idle);
 
 	dev->wq = create_singlethread_workqueue("f_mtp");
 	if (!dev->wq)
@@ -1238,12 +1451,19 @@ static int mtp_bind_config(struct usb_configuration *c)
 	if (ret)
 		goto err1;
 
-	ret = usb_add_function(c, &dev->function);
+	ret = sysfs_create_group(&mtp_device.this_device->kobj,
+				 &mtp_stats_group);
 	if (ret)
 		goto err2;
 
+	ret = usb_add_function(c, &dev->function);
+	if (ret)
+		goto err3;
+
 	return 0;
 
+err3:
+	sysfs_remove_group(&mtp_device.this_device->kobj, &mtp_stats_group);
 err2:
 	misc_deregister(&mtp_device);
 err1:
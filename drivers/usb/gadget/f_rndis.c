@@ -323,6 +323,12 @@ static struct usb_gadget_strings *rndis_strings[] = {
 static struct usb_ether_platform_data *rndis_pdata;
 #endif
 
+/* Concatenated packets accepted per OUT transfer; rx buffers grow with it */
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+	"packets per host to device RNDIS transfer");
+
 /*-------------------------------------------------------------------------*/
 
 static struct sk_buff *rndis_add_header(struct gether *port,
@@ -416,6 +422,9 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 		ERROR(cdev, "RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
 //	spin_unlock(&dev->lock);
+
+	/* u_ether packs IN transfers up to what the host said it takes */
+	rndis->port.dl_max_xfer_size = rndis_get_dl_max_xfer_size(rndis->config);
 }
 
 static int
@@ -726,6 +735,11 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 	rndis_set_param_medium(rndis->config, NDIS_MEDIUM_802_3, 0);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
 
+	if (!rndis_ul_max_pkt_per_xfer)
+		rndis_ul_max_pkt_per_xfer = 1;
+	rndis_set_max_pkt_xfer(rndis->config, rndis_ul_max_pkt_per_xfer);
+	rndis->port.ul_max_pkts_per_xfer = rndis_ul_max_pkt_per_xfer;
+
 #ifdef CONFIG_USB_ANDROID_RNDIS
 	if (rndis_pdata) {
 		if (rndis_set_param_vendor(rndis->config, rndis_pdata->vendorID,
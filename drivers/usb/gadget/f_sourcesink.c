@@ -42,11 +42,12 @@
  * mode is enabled, it provides good functional coverage for the "USBCV"
  * test harness from USB-IF.
  *
- * Note that because this doesn't queue more than one request at a time,
- * some other function must be used to test queueing logic.  The network
- * link (g_ether) is the best overall option for that, since its TX and RX
- * queues are relatively independent, will receive a range of packet sizes,
- * and can often be made to run out completely.  Those issues are important
+ * By default only one request is queued on each endpoint.  The ss_qlen
+ * parameter keeps more of them in flight, which is what a peripheral
+ * controller needs to reach its sustained bulk throughput; report_secs
+ * logs that throughput periodically.  For queueing logic with a range of
+ * packet sizes and queues that run out completely, the network link
+ * (g_ether) is still the best overall option.  Those issues are important
  * when stress testing peripheral controller drivers.
  *
  *
@@ -59,6 +60,11 @@ struct f_sourcesink {
 
 	struct usb_ep		*in_ep;
 	struct usb_ep		*out_ep;
+
+	/* bytes moved since report_start, for report_secs */
+	unsigned long		report_start;
+	u64			in_bytes;
+	u64			out_bytes;
 };
 
 static inline struct f_sourcesink *func_to_ss(struct usb_function *f)
@@ -70,6 +76,14 @@ static unsigned pattern;
 module_param(pattern, uint, 0);
 MODULE_PARM_DESC(pattern, "0 = all zeroes, 1 = mod63 ");
 
+static unsigned ss_qlen = 1;
+module_param(ss_qlen, uint, 0);
+MODULE_PARM_DESC(ss_qlen, "depth of source and sink queues");
+
+static unsigned report_secs;
+module_param(report_secs, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(report_secs, "seconds between throughput reports, 0 = off");
+
 /*-------------------------------------------------------------------------*/
 
 static struct usb_interface_descriptor source_sink_intf = {
@@ -250,6 +264,25 @@ static void reinit_write_data(struct usb_ep *ep, struct usb_request *req)
 	}
 }
 
+static void source_sink_report(struct f_sourcesink *ss)
+{
+	struct usb_composite_dev *cdev = ss->function.config->cdev;
+	unsigned long elapsed = jiffies - ss->report_start;
+	u32 msecs;
+
+	if (!report_secs || elapsed < report_secs * HZ)
+		return;
+
+	msecs = jiffies_to_msecs(elapsed);
+	INFO(cdev, "%s: IN %llu KB/s, OUT %llu KB/s\n", ss->function.name,
+			div_u64(ss->in_bytes * 1000 / 1024, msecs),
+			div_u64(ss->out_bytes * 1000 / 1024, msecs));
+
+	ss->report_start = jiffies;
+	ss->in_bytes = 0;
+	ss->out_bytes = 0;
+}
+
 static void source_sink_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct f_sourcesink	*ss = ep->driver_data;
@@ -262,8 +295,12 @@ static void source_sink_complete(struct usb_ep *ep, struct usb_request *req)
 		if (ep == ss->out_ep) {
 			check_read_data(ss, req);
 			memset(req->buf, 0x55, req->length);
-		} else
+			ss->out_bytes += req->actual;
+		} else {
 			reinit_write_data(ep, req);
+			ss->in_bytes += req->actual;
+		}
+		source_sink_report(ss);
 		break;
 
 	/* this endpoint is normally active while we're configured */
@@ -304,30 +341,34 @@ static int source_sink_start_ep(struct f_sourcesink *ss, bool is_in)
 	struct usb_ep		*ep;
 	struct usb_request	*req;
 	int			status;
+	unsigned		i = 0;
 
 	ep = is_in ? ss->in_ep : ss->out_ep;
-	req = alloc_ep_req(ep);
-	if (!req)
-		return -ENOMEM;
+	do {
+		req = alloc_ep_req(ep);
+		if (!req)
+			return -ENOMEM;
 
-	req->complete = source_sink_complete;
-	if (is_in)
-		reinit_write_data(ep, req);
-	else
-		memset(req->buf, 0x55, req->length);
+		req->complete = source_sink_complete;
+		if (is_in)
+			reinit_write_data(ep, req);
+		else
+			memset(req->buf, 0x55, req->length);
 
-	status = usb_ep_queue(ep, req, GFP_ATOMIC);
-	if (status) {
-		struct usb_composite_dev	*cdev;
+		status = usb_ep_queue(ep, req, GFP_ATOMIC);
+		if (status) {
+			struct usb_composite_dev	*cdev;
 
-		cdev = ss->function.config->cdev;
-		ERROR(cdev, "start %s %s --> %d\n",
-				is_in ? "IN" : "OUT",
-				ep->name, status);
-		free_ep_req(ep, req);
-	}
+			cdev = ss->function.config->cdev;
+			ERROR(cdev, "start %s %s --> %d\n",
+					is_in ? "IN" : "OUT",
+					ep->name, status);
+			free_ep_req(ep, req);
+			return status;
+		}
+	} while (++i < ss_qlen);
 
-	return status;
+	return 0;
 }
 
 static void disable_source_sink(struct f_sourcesink *ss)
@@ -349,6 +390,10 @@ enable_source_sink(struct usb_composite_dev *cdev, struct f_sourcesink *ss)
 	src = ep_choose(cdev->gadget, &hs_source_desc, &fs_source_desc);
 	sink = ep_choose(cdev->gadget, &hs_sink_desc, &fs_sink_desc);
 
+	ss->report_start = jiffies;
+	ss->in_bytes = 0;
+	ss->out_bytes = 0;
+
 	/* one endpoint writes (sources) zeroes IN (to the host) */
 	ep = ss->in_ep;
 	result = usb_ep_enable(ep, src);
@@ -116,6 +116,52 @@ static const u8 fsl_udc_test_packet[53] = {
 /********************************************************************
  *	Internal Used Function
 ********************************************************************/
+/*
+ * dTDs are recycled through a free list rather than handed back to the
+ * dma_pool, so queueing a request normally takes no pool allocation.
+ */
+static struct ep_td_struct *fsl_alloc_dtd(struct fsl_udc *udc,
+		gfp_t gfp_flags)
+{
+	struct ep_td_struct *dtd;
+	dma_addr_t dma;
+	unsigned long flags;
+
+	spin_lock_irqsave(&udc->td_lock, flags);
+	dtd = udc->td_free;
+	if (dtd)
+		udc->td_free = dtd->next_td_virt;
+	spin_unlock_irqrestore(&udc->td_lock, flags);
+	if (dtd)
+		return dtd;
+
+	dtd = dma_pool_alloc(udc->td_pool, gfp_flags, &dma);
+	if (dtd)
+		dtd->td_dma = dma;
+	return dtd;
+}
+
+static void fsl_free_dtd(struct fsl_udc *udc, struct ep_td_struct *dtd)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&udc->td_lock, flags);
+	dtd->next_td_virt = udc->td_free;
+	udc->td_free = dtd;
+	spin_unlock_irqrestore(&udc->td_lock, flags);
+}
+
+static void fsl_destroy_td_pool(struct fsl_udc *udc)
+{
+	struct ep_td_struct *dtd;
+
+	while ((dtd = udc->td_free)) {
+		udc->td_free = dtd->next_td_virt;
+		dma_pool_free(udc->td_pool, dtd, dtd->td_dma);
+	}
+	dma_pool_destroy(udc->td_pool);
+}
+
 /*-----------------------------------------------------------------
  * done() - retire a request; caller blocked irqs
  * @status : request status to be set, only works when
@@ -145,10 +191,17 @@ static void done(struct fsl_ep *ep, struct fsl_req *req, int status)
 		if (j != req->dtd_count - 1) {
 			next_td = curr_td->next_td_virt;
 		}
-		dma_pool_free(udc->td_pool, curr_td, curr_td->td_dma);
+		fsl_free_dtd(udc, curr_td);
 	}
 
-	if (req->mapped) {
+	if (req->req.num_sgs) {
+		dma_unmap_sg(ep->udc->gadget.dev.parent,
+			req->req.sg, req->req.num_sgs,
+			ep_is_in(ep)
+				? DMA_TO_DEVICE
+				: DMA_FROM_DEVICE);
+		req->req.num_mapped_sgs = 0;
+	} else if (req->mapped) {
 		dma_unmap_single(ep->udc->gadget.dev.parent,
 			req->req.dma, req->req.length,
 			ep_is_in(ep)
@@ -754,100 +807,145 @@ out:
 
 /* Fill in the dTD structure
  * @req: request that the transfer belongs to
- * @length: return actually data length of the dTD
- * @dma: return dma address of the dTD
- * @is_last: return flag if it is the last dTD of the request
+ * @buf: dma address of the data, or where a zero length dTD points
+ * @length: data length of the dTD, at most EP_MAX_LENGTH_TRANSFER
+ * @is_last: true for the last dTD of the request
  * return: pointer to the built dTD */
-static struct ep_td_struct *fsl_build_dtd(struct fsl_req *req, unsigned *length,
-		dma_addr_t *dma, int *is_last, gfp_t gfp_flags)
+static struct ep_td_struct *fsl_build_dtd(struct fsl_req *req, dma_addr_t buf,
+		unsigned length, int is_last, gfp_t gfp_flags)
 {
 	u32 swap_temp;
 	struct ep_td_struct *dtd;
 
-	/* how big will this transfer be? */
-	*length = min(req->req.length - req->req.actual,
-			(unsigned)EP_MAX_LENGTH_TRANSFER);
-
-	dtd = dma_pool_alloc(udc_controller->td_pool, gfp_flags, dma);
+	dtd = fsl_alloc_dtd(udc_controller, gfp_flags);
 	if (dtd == NULL)
 		return dtd;
 
-	dtd->td_dma = *dma;
 	/* Clear reserved field */
 	swap_temp = cpu_to_le32(dtd->size_ioc_sts);
 	swap_temp &= ~DTD_RESERVED_FIELDS;
 	dtd->size_ioc_sts = cpu_to_le32(swap_temp);
 
 	/* Init all of buffer page pointers */
-	swap_temp = (u32) (req->req.dma + req->req.actual);
+	swap_temp = (u32) buf;
 	dtd->buff_ptr0 = cpu_to_le32(swap_temp);
 	dtd->buff_ptr1 = cpu_to_le32(swap_temp + 0x1000);
 	dtd->buff_ptr2 = cpu_to_le32(swap_temp + 0x2000);
 	dtd->buff_ptr3 = cpu_to_le32(swap_temp + 0x3000);
 	dtd->buff_ptr4 = cpu_to_le32(swap_temp + 0x4000);
 
-	req->req.actual += *length;
-
-	/* zlp is needed if req->req.zero is set */
-	if (req->req.zero) {
-		if (*length == 0 || (*length % req->ep->ep.maxpacket) != 0)
-			*is_last = 1;
-		else
-			*is_last = 0;
-	} else if (req->req.length == req->req.actual)
-		*is_last = 1;
-	else
-		*is_last = 0;
-
-	if ((*is_last) == 0)
+	if (!is_last)
 		VDBG("multi-dtd request!");
 	/* Fill in the transfer size; set active bit */
-	swap_temp = ((*length << DTD_LENGTH_BIT_POS) | DTD_STATUS_ACTIVE);
+	swap_temp = ((length << DTD_LENGTH_BIT_POS) | DTD_STATUS_ACTIVE);
 
 	/* Enable interrupt for the last dtd of a request */
-	if (*is_last && !req->req.no_interrupt)
+	if (is_last && !req->req.no_interrupt)
 		swap_temp |= DTD_IOC;
 
 	dtd->size_ioc_sts = cpu_to_le32(swap_temp);
 
 	mb();
 
-	VDBG("length = %d address= 0x%x", *length, (int)*dma);
+	VDBG("length = %d address= 0x%x", length, (int)dtd->td_dma);
 
 	return dtd;
 }
 
+/* Build a dTD and append it to the request's chain */
+static int fsl_req_add_dtd(struct fsl_req *req, dma_addr_t buf,
+		unsigned length, int is_last, gfp_t gfp_flags)
+{
+	struct ep_td_struct *dtd;
+
+	dtd = fsl_build_dtd(req, buf, length, is_last, gfp_flags);
+	if (dtd == NULL)
+		return -ENOMEM;
+
+	if (req->dtd_count == 0) {
+		req->head = dtd;
+	} else {
+		req->tail->next_td_ptr = cpu_to_le32(dtd->td_dma);
+		req->tail->next_td_virt = dtd;
+	}
+	req->tail = dtd;
+	req->dtd_count++;
+
+	return 0;
+}
+
 /* Generate dtd chain for a request */
 static int fsl_req_to_dtd(struct fsl_req *req, gfp_t gfp_flags)
 {
-	unsigned	count;
-	int		is_last;
-	int		is_first =1;
-	struct ep_td_struct	*last_dtd = NULL, *dtd;
-	dma_addr_t dma;
+	unsigned	maxpacket = req->ep->ep.maxpacket;
+	unsigned	offset, length, seg_len;
+	int		is_last, zlp, i, ret;
+	struct scatterlist *sg;
 
-	do {
-		dtd = fsl_build_dtd(req, &count, &dma, &is_last, gfp_flags);
-		if (dtd == NULL)
-			return -ENOMEM;
+	/* zlp is needed if req->req.zero is set */
+	zlp = req->req.zero && (req->req.length % maxpacket) == 0;
 
-		if (is_first) {
-			is_first = 0;
-			req->head = dtd;
-		} else {
-			last_dtd->next_td_ptr = cpu_to_le32(dma);
-			last_dtd->next_td_virt = dtd;
+	if (!req->req.num_sgs) {
+		offset = 0;
+		do {
+			/* how big will this transfer be? */
+			length = min(req->req.length - offset,
+					(unsigned)EP_MAX_LENGTH_TRANSFER);
+			offset += length;
+			if (req->req.zero)
+				is_last = length == 0 || length % maxpacket;
+			else
+				is_last = offset == req->req.length;
+
+			ret = fsl_req_add_dtd(req, req->req.dma + offset - length,
+					length, is_last, gfp_flags);
+			if (ret)
+				goto fail;
+		} while (!is_last);
+		goto out;
+	}
+
+	/* one or more dTDs per segment, the hardware follows the chain */
+	for_each_sg(req->req.sg, sg, req->req.num_mapped_sgs, i) {
+		seg_len = sg_dma_len(sg);
+		if (!sg_is_last(sg) && seg_len % maxpacket) {
+			ret = -EINVAL;
+			goto fail;
 		}
-		last_dtd = dtd;
 
-		req->dtd_count++;
-	} while (!is_last);
+		for (offset = 0; offset < seg_len; offset += length) {
+			length = min(seg_len - offset,
+					(unsigned)EP_MAX_LENGTH_TRANSFER);
+			is_last = i == req->req.num_mapped_sgs - 1 &&
+				offset + length == seg_len && !zlp;
 
-	dtd->next_td_ptr = cpu_to_le32(DTD_NEXT_TERMINATE);
+			ret = fsl_req_add_dtd(req, sg_dma_address(sg) + offset,
+					length, is_last, gfp_flags);
+			if (ret)
+				goto fail;
+		}
+	}
+	if (zlp) {
+		ret = fsl_req_add_dtd(req, sg_dma_address(req->req.sg), 0, 1,
+				gfp_flags);
+		if (ret)
+			goto fail;
+	}
 
-	req->tail = dtd;
+out:
+	req->tail->next_td_ptr = cpu_to_le32(DTD_NEXT_TERMINATE);
 
 	return 0;
+
+fail:
+	while (req->dtd_count--) {
+		struct ep_td_struct *dtd = req->head;
+
+		req->head = dtd->next_td_virt;
+		fsl_free_dtd(udc_controller, dtd);
+	}
+	req->dtd_count = 0;
+	return ret;
 }
 
 /* queues (submits) an I/O request to an endpoint */
@@ -863,7 +961,8 @@ fsl_ep_queue(struct usb_ep *_ep, struct usb_request *_req, gfp_t gfp_flags)
 	int status;
 
 	/* catch various bogus parameters */
-	if (!_req || !req->req.complete || !req->req.buf
+	if (!_req || !req->req.complete
+			|| !(req->req.buf || req->req.num_sgs)
 			|| !list_empty(&req->queue)) {
 		VDBG("%s, bad params", __func__);
 		return -EINVAL;
@@ -895,7 +994,12 @@ fsl_ep_queue(struct usb_ep *_ep, struct usb_request *_req, gfp_t gfp_flags)
 	req->ep = ep;
 
 	/* map virtual address to hardware */
-	if (req->req.dma == DMA_ADDR_INVALID) {
+	if (req->req.num_sgs) {
+		req->req.num_mapped_sgs = dma_map_sg(udc->gadget.dev.parent,
+					req->req.sg, req->req.num_sgs, dir);
+		if (!req->req.num_mapped_sgs)
+			return -ENOMEM;
+	} else if (req->req.dma == DMA_ADDR_INVALID) {
 		req->req.dma = dma_map_single(udc->gadget.dev.parent,
 					req->req.buf, req->req.length, dir);
 		req->mapped = 1;
@@ -938,7 +1042,11 @@ fsl_ep_queue(struct usb_ep *_ep, struct usb_request *_req, gfp_t gfp_flags)
 	return 0;
 
 err_unmap:
-	if (req->mapped) {
+	if (req->req.num_sgs) {
+		dma_unmap_sg(udc->gadget.dev.parent,
+			req->req.sg, req->req.num_sgs, dir);
+		req->req.num_mapped_sgs = 0;
+	} else if (req->mapped) {
 		dma_unmap_single(udc->gadget.dev.parent,
 			req->req.dma, req->req.length, dir);
 		req->req.dma = DMA_ADDR_INVALID;
@@ -2701,6 +2809,7 @@ static int __init fsl_udc_probe(struct platform_device *pdev)
 	/* Setup gadget structure */
 	udc_controller->gadget.ops = &fsl_gadget_ops;
 	udc_controller->gadget.is_dualspeed = 1;
+	udc_controller->gadget.sg_supported = 1;
 	udc_controller->gadget.ep0 = &udc_controller->eps[0].ep;
 	INIT_LIST_HEAD(&udc_controller->gadget.ep_list);
 	udc_controller->gadget.speed = USB_SPEED_UNKNOWN;
@@ -2744,6 +2853,17 @@ static int __init fsl_udc_probe(struct platform_device *pdev)
 		ret = -ENOMEM;
 		goto err_unregister;
 	}
+	spin_lock_init(&udc_controller->td_lock);
+	for (i = 0; i < FSL_UDC_TD_PREALLOC; i++) {
+		struct ep_td_struct *dtd;
+		dma_addr_t dma;
+
+		dtd = dma_pool_alloc(udc_controller->td_pool, GFP_KERNEL, &dma);
+		if (!dtd)
+			break;
+		dtd->td_dma = dma;
+		fsl_free_dtd(udc_controller, dtd);
+	}
 	create_proc_file();
 
 #ifdef CONFIG_USB_OTG_UTILS
@@ -2810,7 +2930,7 @@ static int __exit fsl_udc_remove(struct platform_device *pdev)
 	kfree(udc_controller->status_req);
 	kfree(udc_controller->eps);
 
-	dma_pool_destroy(udc_controller->td_pool);
+	fsl_destroy_td_pool(udc_controller);
 	free_irq(udc_controller->irq, udc_controller);
 	iounmap(dr_regs);
 	release_mem_region(res->start, res->end - res->start + 1);
@@ -393,6 +393,8 @@ struct ep_queue_head {
 #define  EP_QUEUE_HEAD_NEXT_POINTER_MASK      0xFFFFFFE0
 #define  EP_QUEUE_FRINDEX_MASK                0x000007FF
 #define  EP_MAX_LENGTH_TRANSFER               0x4000
+/* dTDs allocated up front, more come from the dma_pool under load */
+#define  FSL_UDC_TD_PREALLOC                  128
 
 /* Endpoint Transfer Descriptor data struct */
 /* Rem: all the variables of td are LittleEndian Mode */
@@ -496,6 +498,8 @@ struct fsl_udc {
 	struct ep_queue_head *ep_qh;	/* Endpoints Queue-Head */
 	struct fsl_req *status_req;	/* ep0 status request */
 	struct dma_pool *td_pool;	/* dma pool for DTD */
+	spinlock_t td_lock;		/* protect td_free */
+	struct ep_td_struct *td_free;	/* retired dTDs, via next_td_virt */
 	enum fsl_usb2_phy_modes phy_mode;
 
 	size_t ep_qh_size;		/* size after alignment adjustment*/
@@ -72,6 +72,7 @@ struct eth_dev {
 	struct sk_buff_head	rx_frames;
 
 	unsigned		header_len;
+	unsigned		ul_max_pkts;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
 	int			(*unwrap)(struct gether *,
 						struct sk_buff *skb,
@@ -84,6 +85,10 @@ struct eth_dev {
 
 	bool			zlp;
 	u8			host_mac[ETH_ALEN];
+
+	/* IN aggregation, see eth_xmit_aggr(); guarded by req_lock */
+	bool			tx_aggr;
+	struct usb_request	*tx_fill;
 };
 
 /*-------------------------------------------------------------------------*/
@@ -92,6 +97,8 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+#define TX_AGGR_SIZE	8192	/* buffer per aggregated IN request */
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -235,8 +242,10 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 * means receivers can't recover lost synch on their own (because
 	 * new packets don't only start after a short RX).
 	 */
-	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
+	size += sizeof(struct ethhdr) + dev->net->mtu;
 	size += dev->port_usb->header_len;
+	size *= dev->ul_max_pkts;
+	size += RX_EXTRA;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -382,6 +391,7 @@ static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
 		req = usb_ep_alloc_request(ep, GFP_ATOMIC);
 		if (!req)
 			return list_empty(list) ? -ENOMEM : 0;
+		req->buf = NULL;
 		list_add(&req->list, list);
 	}
 	return 0;
@@ -458,10 +468,14 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_queue_aggr(struct eth_dev *dev, struct usb_ep *in,
+			  struct usb_request *req);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
+	struct usb_request *fill = NULL;
 
 	switch (req->status) {
 	default:
@@ -472,20 +486,132 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		/* aggregated packets were counted when they were copied */
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+	if (skb)
+		dev->net->stats.tx_packets++;
 
 	spin_lock(&dev->req_lock);
+	/* only aggregation buffers stay attached to free requests */
+	if (skb)
+		req->buf = NULL;
 	list_add(&req->list, &dev->tx_reqs);
+	atomic_dec(&dev->tx_qlen);
+
+	/* the bus can take another transfer: send what piled up meanwhile */
+	if (dev->tx_fill && req->status != -ESHUTDOWN) {
+		fill = dev->tx_fill;
+		dev->tx_fill = NULL;
+		atomic_inc(&dev->tx_qlen);
+	}
 	spin_unlock(&dev->req_lock);
 	dev_kfree_skb_any(skb);
 
+	if (fill)
+		tx_queue_aggr(dev, ep, fill);
+	if (netif_carrier_ok(dev->net))
+		netif_wake_queue(dev->net);
+}
+
+static void tx_queue_aggr(struct eth_dev *dev, struct usb_ep *in,
+			  struct usb_request *req)
+{
+	unsigned long	flags;
+
+	req->complete = tx_complete;
+	req->no_interrupt = 0;
+	req->zero = 1;
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		req->length++;
+
+	if (usb_ep_queue(in, req, GFP_ATOMIC) == 0) {
+		dev->net->trans_start = jiffies;
+		return;
+	}
+
+	DBG(dev, "tx queue err\n");
+	dev->net->stats.tx_dropped++;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	list_add(&req->list, &dev->tx_reqs);
 	atomic_dec(&dev->tx_qlen);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
 
+/*
+ * Hosts that take several packets per IN transfer (RNDIS) get them
+ * copied into preallocated TX_AGGR_SIZE buffers.  A packet goes out at
+ * once while the link is idle.  Otherwise packets collect in tx_fill
+ * until it is full or the next transfer completes, so each completion
+ * costs one request however many packets arrived meanwhile.  The
+ * framing wrapper has already run on the skb.
+ */
+static netdev_tx_t eth_xmit_aggr(struct eth_dev *dev, struct sk_buff *skb,
+				 struct usb_ep *in, unsigned max)
+{
+	struct net_device	*net = dev->net;
+	struct usb_request	*req, *send = NULL;
+	unsigned		room = ETH_FRAME_LEN + dev->header_len;
+	unsigned long		flags;
+
+	/* leave a byte for zlp padding */
+	max = min_t(unsigned, max, TX_AGGR_SIZE) - 1;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	dev->tx_aggr = true;
+
+	req = dev->tx_fill;
+	if (!req) {
+		/* disconnect raced us, the queue is stopped otherwise */
+		if (list_empty(&dev->tx_reqs))
+			goto drop;
+
+		req = container_of(dev->tx_reqs.next, struct usb_request, list);
+		if (!req->buf) {
+			req->buf = kmalloc(TX_AGGR_SIZE, GFP_ATOMIC);
+			if (!req->buf)
+				goto drop;
+		}
+		list_del(&req->list);
+		req->context = NULL;
+		req->length = 0;
+		dev->tx_fill = req;
+	}
+
+	if (req->length + skb->len > max)
+		goto drop;
+
+	memcpy(req->buf + req->length, skb->data, skb->len);
+	req->length += skb->len;
+	net->stats.tx_packets++;
+	net->stats.tx_bytes += skb->len;
+
+	if (atomic_read(&dev->tx_qlen) == 0 || req->length + room > max) {
+		dev->tx_fill = NULL;
+		atomic_inc(&dev->tx_qlen);
+		send = req;
+	}
+
+	/* keep the stack out until a request is back on the freelist */
+	if (!dev->tx_fill && list_empty(&dev->tx_reqs))
+		netif_stop_queue(net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any(skb);
+	if (send)
+		tx_queue_aggr(dev, in, send);
+	return NETDEV_TX_OK;
+
+drop:
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+	dev_kfree_skb_any(skb);
+	net->stats.tx_dropped++;
+	return NETDEV_TX_OK;
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
@@ -501,14 +627,17 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	u32			dl_max;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
+		dl_max = dev->port_usb->dl_max_xfer_size;
 	} else {
 		in = NULL;
 		cdc_filter = 0;
+		dl_max = 0;
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
@@ -539,6 +668,26 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	/* packing pays off once the host takes two full frames per transfer */
+	if (dev->tx_aggr ||
+	    dl_max >= 2 * (ETH_FRAME_LEN + dev->header_len)) {
+		if (dev->wrap) {
+			spin_lock_irqsave(&dev->lock, flags);
+			if (dev->port_usb)
+				skb = dev->wrap(dev->port_usb, skb);
+			else {
+				dev_kfree_skb_any(skb);
+				skb = NULL;
+			}
+			spin_unlock_irqrestore(&dev->lock, flags);
+			if (!skb) {
+				dev->net->stats.tx_dropped++;
+				return NETDEV_TX_OK;
+			}
+		}
+		return eth_xmit_aggr(dev, skb, in, dl_max);
+	}
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -611,6 +760,7 @@ drop:
 		spin_lock_irqsave(&dev->req_lock, flags);
 		if (list_empty(&dev->tx_reqs))
 			netif_start_queue(net);
+		req->buf = NULL;
 		list_add(&req->list, &dev->tx_reqs);
 		spin_unlock_irqrestore(&dev->req_lock, flags);
 	}
@@ -887,8 +1037,10 @@ struct net_device *gether_connect(struct gether *link)
 		DBG(dev, "qlen %d\n", qlen(dev->gadget));
 
 		dev->header_len = link->header_len;
+		dev->ul_max_pkts = link->ul_max_pkts_per_xfer ? : 1;
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
+		dev->tx_aggr = false;
 
 		spin_lock(&dev->lock);
 		dev->port_usb = link;
@@ -950,12 +1102,17 @@ void gether_disconnect(struct gether *link)
 	 */
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_fill) {
+		list_add(&dev->tx_fill->list, &dev->tx_reqs);
+		dev->tx_fill = NULL;
+	}
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		kfree(req->buf);	/* aggregation buffer, if any */
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
@@ -68,6 +68,13 @@ struct gether {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/* Framings that carry several packets per transfer (RNDIS).  The
+	 * host may concatenate up to ul_max_pkts_per_xfer on OUT, and takes
+	 * IN transfers of up to dl_max_xfer_size bytes; 0 means one packet.
+	 */
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
+
 	/* called on network open/close */
 	void				(*open)(struct gether *);
 	void				(*close)(struct gether *);
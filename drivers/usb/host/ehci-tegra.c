@@ -20,6 +20,7 @@
 #include <linux/platform_device.h>
 #include <linux/platform_data/tegra_usb.h>
 #include <linux/irq.h>
+#include <linux/log2.h>
 #include <linux/usb/otg.h>
 #include <mach/usb_phy.h>
 #include <mach/iomap.h>
@@ -38,6 +39,23 @@
 
 #define STS_SRI	(1<<7)	/*	SOF Recieved	*/
 
+#define TEGRA_EHCI_ITC_MASK	(0xff << 16)
+#define TEGRA_EHCI_ITC(log2)	((1 << (log2)) << 16)
+
+/* interrupt threshold while interrupt or isochronous endpoints are
+ * scheduled, and while only control and bulk traffic is queued */
+static int itc_periodic = 0;		/* 1 microframe */
+module_param(itc_periodic, int, S_IRUGO);
+MODULE_PARM_DESC(itc_periodic, "log2 IRQ latency with periodic transfers");
+static int itc_async = 3;		/* 8 microframes */
+module_param(itc_async, int, S_IRUGO);
+MODULE_PARM_DESC(itc_async, "log2 IRQ latency with only async transfers");
+
+/* the Tegra controller can park on a high speed async qh */
+static unsigned tegra_park = 3;
+module_param(tegra_park, uint, S_IRUGO);
+MODULE_PARM_DESC(tegra_park, "park setting; 1-3 back-to-back async packets");
+
 struct tegra_ehci_hcd {
 	struct ehci_hcd *ehci;
 	struct tegra_usb_phy *phy;
@@ -48,6 +66,10 @@ struct tegra_ehci_hcd {
 	int bus_suspended;
 	int port_resuming;
 	int power_down_on_bus_suspend;
+	int clk_gate_on_bus_suspend;
+	int clk_gated;
+	int itc_periodic;
+	int itc_async;
 	struct delayed_work work;
 	enum tegra_usb_phy_port_speed port_speed;
 };
@@ -72,6 +94,75 @@ static void tegra_ehci_power_down(struct usb_hcd *hcd)
 	clk_disable(tegra->emc_clk);
 }
 
+static void tegra_ehci_clk_ungate(struct usb_hcd *hcd)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(hcd->self.controller);
+
+	if (!tegra->clk_gated)
+		return;
+
+	clk_enable(tegra->emc_clk);
+	clk_enable(tegra->clk);
+	tegra_usb_phy_clk_enable(tegra->phy);
+	set_bit(HCD_FLAG_HW_ACCESSIBLE, &hcd->flags);
+	tegra->clk_gated = 0;
+}
+
+/* Pick the interrupt threshold for the current schedule: low latency as
+ * long as HID or audio endpoints are linked, coalesced for bulk.  Called
+ * with ehci->lock held. */
+static void tegra_ehci_update_itc(struct ehci_hcd *ehci, int periodic)
+{
+	struct usb_hcd *hcd = ehci_to_hcd(ehci);
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(hcd->self.controller);
+	u32 itc, cmd;
+
+	itc = TEGRA_EHCI_ITC(periodic ? tegra->itc_periodic : tegra->itc_async);
+	if ((ehci->command & TEGRA_EHCI_ITC_MASK) == itc)
+		return;
+
+	ehci->command = (ehci->command & ~TEGRA_EHCI_ITC_MASK) | itc;
+	if (!HC_IS_RUNNING(hcd->state) ||
+	    !test_bit(HCD_FLAG_HW_ACCESSIBLE, &hcd->flags))
+		return;
+
+	cmd = ehci_readl(ehci, &ehci->regs->command);
+	cmd = (cmd & ~TEGRA_EHCI_ITC_MASK) | itc;
+	ehci_writel(ehci, cmd, &ehci->regs->command);
+}
+
+static irqreturn_t tegra_ehci_irq(struct usb_hcd *hcd)
+{
+	struct ehci_hcd *ehci = hcd_to_ehci(hcd);
+	irqreturn_t ret;
+
+	ret = ehci_irq(hcd);
+
+	/* fall back to coalescing once the periodic schedule drains */
+	spin_lock(&ehci->lock);
+	tegra_ehci_update_itc(ehci, ehci->periodic_sched);
+	spin_unlock(&ehci->lock);
+
+	return ret;
+}
+
+static int tegra_ehci_urb_enqueue(struct usb_hcd *hcd, struct urb *urb,
+				  gfp_t mem_flags)
+{
+	struct ehci_hcd *ehci = hcd_to_ehci(hcd);
+	unsigned long flags;
+
+	/* don't make the first interrupt or iso transfer wait for the
+	 * coalesced threshold */
+	if (usb_pipeint(urb->pipe) || usb_pipeisoc(urb->pipe)) {
+		spin_lock_irqsave(&ehci->lock, flags);
+		tegra_ehci_update_itc(ehci, 1);
+		spin_unlock_irqrestore(&ehci->lock, flags);
+	}
+
+	return ehci_urb_enqueue(hcd, urb, mem_flags);
+}
+
 static int tegra_ehci_hub_control(
 	struct usb_hcd	*hcd,
 	u16		typeReq,
@@ -449,6 +540,7 @@ static void tegra_ehci_shutdown(struct usb_hcd *hcd)
 
 	/* ehci_shutdown touches the USB controller registers, make sure
 	 * controller has clocks to it */
+	tegra_ehci_clk_ungate(hcd);
 	if (!tegra->host_resumed)
 		tegra_ehci_power_up(hcd);
 
@@ -489,11 +581,42 @@ static int tegra_ehci_setup(struct usb_hcd *hcd)
 
 	ehci->sbrn = 0x20;
 
+	/* ehci_init() only parks when asked to; the hw default of 3 saves
+	 * the qh fetches between bulk packets */
+	if (HCC_CANPARK(ehci_readl(ehci, &ehci->caps->hcc_params)) &&
+	    !(ehci->command & CMD_PARK) && tegra_park) {
+		ehci->command |= CMD_PARK;
+		ehci->command |= min(tegra_park, (unsigned) 3) << 8;
+	}
+	tegra_ehci_update_itc(ehci, 0);
+
 	ehci_port_power(ehci, 1);
 	return retval;
 }
 
 #ifdef CONFIG_PM
+/* With the port suspended nothing is fetched from memory and the phy
+ * only has to watch the lines, so the controller clock and the phy
+ * clock can go.  Unlike tegra_usb_suspend() this leaves vbus and the
+ * port registers alone and a resume does not re-enumerate the bus. */
+static void tegra_ehci_clk_gate(struct usb_hcd *hcd)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(hcd->self.controller);
+	unsigned long flags;
+
+	if (tegra->clk_gated)
+		return;
+
+	spin_lock_irqsave(&tegra->ehci->lock, flags);
+	clear_bit(HCD_FLAG_HW_ACCESSIBLE, &hcd->flags);
+	spin_unlock_irqrestore(&tegra->ehci->lock, flags);
+
+	tegra_usb_phy_clk_disable(tegra->phy);
+	clk_disable(tegra->clk);
+	clk_disable(tegra->emc_clk);
+	tegra->clk_gated = 1;
+}
+
 static int tegra_ehci_bus_suspend(struct usb_hcd *hcd)
 {
 	struct tegra_ehci_hcd *tegra = dev_get_drvdata(hcd->self.controller);
@@ -503,6 +626,9 @@ static int tegra_ehci_bus_suspend(struct usb_hcd *hcd)
 	if (!error_status && tegra->power_down_on_bus_suspend) {
 		tegra_usb_suspend(hcd);
 		tegra->bus_suspended = 1;
+	} else if (!error_status && tegra->clk_gate_on_bus_suspend &&
+		   !hcd->self.root_hub->do_remote_wakeup) {
+		tegra_ehci_clk_gate(hcd);
 	}
 	return error_status;
 }
@@ -515,6 +641,7 @@ static int tegra_ehci_bus_resume(struct usb_hcd *hcd)
 		tegra_usb_resume(hcd);
 		tegra->bus_suspended = 0;
 	}
+	tegra_ehci_clk_ungate(hcd);
 
 	tegra_usb_phy_preresume(tegra->phy);
 	tegra->port_resuming = 1;
@@ -620,6 +747,52 @@ static void tegra_hsic_connection_work(struct work_struct *work)
 	return;
 }
 
+/* Interrupt thresholds in microframes, a power of two up to 64.  Writing
+ * the same value to both turns the adaptation off. */
+static ssize_t show_irq_thresh(struct device *dev, char *buf, int *itc)
+{
+	return sprintf(buf, "%d\n", 1 << *itc);
+}
+
+static ssize_t store_irq_thresh(struct device *dev, const char *buf,
+				size_t count, int *itc)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+	struct ehci_hcd *ehci = tegra->ehci;
+	unsigned long flags;
+	unsigned int uframes;
+
+	if (sscanf(buf, "%u", &uframes) != 1 || uframes < 1 || uframes > 64 ||
+	    !is_power_of_2(uframes))
+		return -EINVAL;
+
+	spin_lock_irqsave(&ehci->lock, flags);
+	*itc = ilog2(uframes);
+	tegra_ehci_update_itc(ehci, ehci->periodic_sched);
+	spin_unlock_irqrestore(&ehci->lock, flags);
+
+	return count;
+}
+
+#define TEGRA_EHCI_IRQ_THRESH_ATTR(name)				\
+static ssize_t show_irq_thresh_##name(struct device *dev,		\
+		struct device_attribute *attr, char *buf)		\
+{									\
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);		\
+	return show_irq_thresh(dev, buf, &tegra->itc_##name);		\
+}									\
+static ssize_t store_irq_thresh_##name(struct device *dev,		\
+		struct device_attribute *attr, const char *buf, size_t count) \
+{									\
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);		\
+	return store_irq_thresh(dev, buf, count, &tegra->itc_##name);	\
+}									\
+static DEVICE_ATTR(irq_thresh_##name, S_IRUGO | S_IWUSR,		\
+		show_irq_thresh_##name, store_irq_thresh_##name)
+
+TEGRA_EHCI_IRQ_THRESH_ATTR(periodic);
+TEGRA_EHCI_IRQ_THRESH_ATTR(async);
+
 #ifdef CONFIG_USB_EHCI_ONOFF_FEATURE
 /* Stored ehci handle for hsic insatnce */
 struct usb_hcd *ehci_handle;
@@ -768,12 +941,12 @@ static const struct hc_driver tegra_ehci_hc_driver = {
 	.flags			= HCD_USB2 | HCD_MEMORY,
 
 	.reset			= tegra_ehci_setup,
-	.irq			= ehci_irq,
+	.irq			= tegra_ehci_irq,
 
 	.start			= ehci_run,
 	.stop			= ehci_stop,
 	.shutdown		= tegra_ehci_shutdown,
-	.urb_enqueue		= ehci_urb_enqueue,
+	.urb_enqueue		= tegra_ehci_urb_enqueue,
 	.urb_dequeue		= ehci_urb_dequeue,
 	.map_urb_for_dma	= tegra_ehci_map_urb_for_dma,
 	.unmap_urb_for_dma	= tegra_ehci_unmap_urb_for_dma,
@@ -875,6 +1048,9 @@ static int tegra_ehci_probe(struct platform_device *pdev)
 
 	tegra->host_resumed = 1;
 	tegra->power_down_on_bus_suspend = pdata->power_down_on_bus_suspend;
+	tegra->clk_gate_on_bus_suspend = pdata->clk_gate_on_bus_suspend;
+	tegra->itc_periodic = clamp(itc_periodic, 0, 6);
+	tegra->itc_async = clamp(itc_async, 0, 6);
 	tegra->ehci = hcd_to_ehci(hcd);
 
 	irq = platform_get_irq(pdev, 0);
@@ -910,6 +1086,11 @@ static int tegra_ehci_probe(struct platform_device *pdev)
 	if (instance == 1)
 		ehci_handle = hcd;
 #endif
+
+	if (device_create_file(&pdev->dev, &dev_attr_irq_thresh_periodic) ||
+	    device_create_file(&pdev->dev, &dev_attr_irq_thresh_async))
+		dev_warn(&pdev->dev, "Failed to create irq_thresh files\n");
+
 	return err;
 
 fail:
@@ -956,6 +1137,8 @@ static int tegra_ehci_suspend(struct platform_device *pdev, pm_message_t state)
 	if ((tegra->bus_suspended) && (tegra->power_down_on_bus_suspend))
 		return 0;
 
+	tegra_ehci_clk_ungate(hcd);
+
 	if (time_before(jiffies, tegra->ehci->next_statechange))
 		msleep(10);
 
@@ -985,6 +1168,10 @@ static int tegra_ehci_remove(struct platform_device *pdev)
 	}
 #endif
 
+	device_remove_file(&pdev->dev, &dev_attr_irq_thresh_periodic);
+	device_remove_file(&pdev->dev, &dev_attr_irq_thresh_async);
+	tegra_ehci_clk_ungate(hcd);
+
 	/* Turn Off Interrupts */
 	ehci_writel(tegra->ehci, 0, &tegra->ehci->regs->intr_enable);
 	clear_bit(HCD_FLAG_HW_ACCESSIBLE, &hcd->flags);
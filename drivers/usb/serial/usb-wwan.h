@@ -29,9 +29,8 @@ extern int usb_wwan_resume(struct usb_serial *serial);
 
 /* per port private data */
 
-#define N_IN_URB 4
+#define N_IN_URB_MAX 16	/* see the nr_in_urbs parameter */
 #define N_OUT_URB 4
-#define IN_BUFLEN 4096
 #define OUT_BUFLEN 4096
 
 struct usb_wwan_intf_private {
@@ -44,12 +43,18 @@ struct usb_wwan_intf_private {
 
 struct usb_wwan_port_private {
 	/* Input endpoints and buffer for this port */
-	struct urb *in_urbs[N_IN_URB];
-	u8 *in_buffer[N_IN_URB];
+	struct urb *in_urbs[N_IN_URB_MAX];
+	u8 *in_buffer[N_IN_URB_MAX];
+	int n_in_urbs;
+	int in_buflen;
+	struct usb_anchor rx_parked;	/* waiting for rx_work */
+	struct work_struct rx_work;
 	/* Output endpoints and buffer for this port */
 	struct urb *out_urbs[N_OUT_URB];
 	u8 *out_buffer[N_OUT_URB];
 	unsigned long out_busy;	/* Bit vector of URBs in use */
+	spinlock_t tx_lock;
+	int tx_fill;		/* URB being filled while others are sent */
 	int opened;
 	struct usb_anchor delayed;
 
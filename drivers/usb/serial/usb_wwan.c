@@ -37,6 +37,23 @@
 
 static int debug;
 
+/*
+ * HSPA downlink needs more and larger receive URBs than the AT ports;
+ * the numbers are read when an interface is bound.
+ */
+static int nr_in_urbs = 8;
+static int in_buflen = 8192;
+
+/* queue small writes behind the URBs in flight instead of one URB each */
+static int tx_batch = 1;
+
+/*
+ * Once PPP is running on a port, hand each receive URB to the line
+ * discipline as a whole from process context instead of copying it
+ * through the tty flip buffers.
+ */
+static int rx_direct = 1;
+
 void usb_wwan_dtr_rts(struct usb_serial_port *port, int on)
 {
 	struct usb_serial *serial = port->serial;
@@ -123,73 +140,120 @@ int usb_wwan_tiocmset(struct tty_struct *tty, struct file *file,
 }
 EXPORT_SYMBOL(usb_wwan_tiocmset);
 
+/* Send out URB i, which the caller has marked busy. */
+static int usb_wwan_submit_out(struct usb_serial_port *port, int i)
+{
+	struct usb_wwan_port_private *portdata;
+	struct usb_wwan_intf_private *intfdata;
+	struct urb *this_urb;
+	int err;
+	unsigned long flags;
+
+	portdata = usb_get_serial_port_data(port);
+	intfdata = port->serial->private;
+	this_urb = portdata->out_urbs[i];
+
+	dbg("%s: endpoint %d buf %d", __func__,
+	    usb_pipeendpoint(this_urb->pipe), i);
+
+	err = usb_autopm_get_interface_async(port->serial->interface);
+	if (err < 0)
+		goto out_free;
+
+	spin_lock_irqsave(&intfdata->susp_lock, flags);
+	if (intfdata->suspended) {
+		usb_anchor_urb(this_urb, &portdata->delayed);
+		spin_unlock_irqrestore(&intfdata->susp_lock, flags);
+	} else {
+		intfdata->in_flight++;
+		spin_unlock_irqrestore(&intfdata->susp_lock, flags);
+		err = usb_submit_urb(this_urb, GFP_ATOMIC);
+		if (err) {
+			dbg("usb_submit_urb %p (write bulk) failed "
+			    "(%d)", this_urb, err);
+			spin_lock_irqsave(&intfdata->susp_lock, flags);
+			intfdata->in_flight--;
+			spin_unlock_irqrestore(&intfdata->susp_lock, flags);
+			usb_autopm_put_interface_async(port->serial->interface);
+			goto out_free;
+		}
+	}
+
+	portdata->tx_start_time[i] = jiffies;
+	return 0;
+
+out_free:
+	smp_mb__before_clear_bit();
+	clear_bit(i, &portdata->out_busy);
+	return err;
+}
+
 /* Write */
 int usb_wwan_write(struct tty_struct *tty, struct usb_serial_port *port,
 		   const unsigned char *buf, int count)
 {
 	struct usb_wwan_port_private *portdata;
-	struct usb_wwan_intf_private *intfdata;
-	int i;
+	int i, stale = -1;
 	int left, todo;
-	struct urb *this_urb = NULL;	/* spurious */
-	int err;
+	struct urb *this_urb;
 	unsigned long flags;
 
 	portdata = usb_get_serial_port_data(port);
-	intfdata = port->serial->private;
 
 	dbg("%s: write (%d chars)", __func__, count);
 
-	i = 0;
 	left = count;
-	for (i = 0; left > 0 && i < N_OUT_URB; i++) {
-		todo = left;
-		if (todo > OUT_BUFLEN)
-			todo = OUT_BUFLEN;
-
-		this_urb = portdata->out_urbs[i];
-		if (test_and_set_bit(i, &portdata->out_busy)) {
-			if (time_before(jiffies,
-					portdata->tx_start_time[i] + 10 * HZ))
-				continue;
-			usb_unlink_urb(this_urb);
+	spin_lock_irqsave(&portdata->tx_lock, flags);
+	while (left > 0) {
+		i = portdata->tx_fill;
+		if (i >= 0) {
+			/* top up the URB waiting for the ones in flight */
+			this_urb = portdata->out_urbs[i];
+			todo = min_t(int, left,
+				     OUT_BUFLEN - this_urb->transfer_buffer_length);
+			memcpy(this_urb->transfer_buffer +
+			       this_urb->transfer_buffer_length, buf, todo);
+			this_urb->transfer_buffer_length += todo;
+			buf += todo;
+			left -= todo;
+			if (this_urb->transfer_buffer_length < OUT_BUFLEN)
+				break;
+			portdata->tx_fill = -1;
+			if (usb_wwan_submit_out(port, i))
+				break;
 			continue;
 		}
-		dbg("%s: endpoint %d buf %d", __func__,
-		    usb_pipeendpoint(this_urb->pipe), i);
 
-		err = usb_autopm_get_interface_async(port->serial->interface);
-		if (err < 0)
+		for (i = 0; i < N_OUT_URB; i++) {
+			if (!test_and_set_bit(i, &portdata->out_busy))
+				break;
+			if (time_after_eq(jiffies,
+					  portdata->tx_start_time[i] + 10 * HZ))
+				stale = i;
+		}
+		if (i == N_OUT_URB)
 			break;
 
-		/* send the data */
+		this_urb = portdata->out_urbs[i];
+		todo = min(left, OUT_BUFLEN);
 		memcpy(this_urb->transfer_buffer, buf, todo);
 		this_urb->transfer_buffer_length = todo;
 
-		spin_lock_irqsave(&intfdata->susp_lock, flags);
-		if (intfdata->suspended) {
-			usb_anchor_urb(this_urb, &portdata->delayed);
-			spin_unlock_irqrestore(&intfdata->susp_lock, flags);
-		} else {
-			intfdata->in_flight++;
-			spin_unlock_irqrestore(&intfdata->susp_lock, flags);
-			err = usb_submit_urb(this_urb, GFP_ATOMIC);
-			if (err) {
-				dbg("usb_submit_urb %p (write bulk) failed "
-				    "(%d)", this_urb, err);
-				clear_bit(i, &portdata->out_busy);
-				spin_lock_irqsave(&intfdata->susp_lock, flags);
-				intfdata->in_flight--;
-				spin_unlock_irqrestore(&intfdata->susp_lock,
-						       flags);
-				continue;
-			}
+		if (tx_batch && todo < OUT_BUFLEN &&
+		    (portdata->out_busy & ~(1UL << i))) {
+			/* sent from the outdat callback of an URB in flight */
+			portdata->tx_fill = i;
+		} else if (usb_wwan_submit_out(port, i)) {
+			break;
 		}
-
-		portdata->tx_start_time[i] = jiffies;
 		buf += todo;
 		left -= todo;
 	}
+	spin_unlock_irqrestore(&portdata->tx_lock, flags);
+
+	/* unlinking may complete the URB, which takes tx_lock */
+	if (stale >= 0)
+		usb_unlink_urb(portdata->out_urbs[stale]);
 
 	count -= left;
 	dbg("%s: wrote (did %d)", __func__, count);
@@ -197,6 +261,64 @@ int usb_wwan_write(struct tty_struct *tty, struct usb_serial_port *port,
 }
 EXPORT_SYMBOL(usb_wwan_write);
 
+static bool usb_wwan_rx_direct(struct tty_struct *tty)
+{
+	struct tty_ldisc *ld;
+	bool direct = false;
+
+	if (!rx_direct || !tty)
+		return false;
+
+	ld = tty_ldisc_ref(tty);
+	if (ld) {
+		direct = ld->ops->num == N_PPP && ld->ops->receive_buf;
+		tty_ldisc_deref(ld);
+	}
+	return direct;
+}
+
+static void usb_wwan_rx_work(struct work_struct *work)
+{
+	struct usb_wwan_port_private *portdata =
+		container_of(work, struct usb_wwan_port_private, rx_work);
+	struct usb_serial_port *port;
+	struct usb_wwan_intf_private *intfdata;
+	struct tty_struct *tty;
+	struct tty_ldisc *ld;
+	struct urb *urb;
+	int err;
+
+	while ((urb = usb_get_from_anchor(&portdata->rx_parked))) {
+		port = urb->context;
+		intfdata = port->serial->private;
+
+		tty = tty_port_tty_get(&port->port);
+		if (tty) {
+			ld = tty_ldisc_ref(tty);
+			if (ld) {
+				if (ld->ops->receive_buf)
+					ld->ops->receive_buf(tty,
+						urb->transfer_buffer, NULL,
+						urb->actual_length);
+				tty_ldisc_deref(ld);
+			}
+			tty_kref_put(tty);
+		}
+
+		spin_lock_irq(&intfdata->susp_lock);
+		if (portdata->opened && !intfdata->suspended) {
+			err = usb_submit_urb(urb, GFP_ATOMIC);
+			if (err && err != -EPERM)
+				printk(KERN_ERR "%s: resubmit read urb failed. "
+				       "(%d)", __func__, err);
+			else
+				usb_mark_last_busy(port->serial->dev);
+		}
+		spin_unlock_irq(&intfdata->susp_lock);
+		usb_put_urb(urb);
+	}
+}
+
 static void usb_wwan_indat_callback(struct urb *urb)
 {
 	int err;
@@ -216,6 +338,16 @@ static void usb_wwan_indat_callback(struct urb *urb)
 		    __func__, status, endpoint);
 	} else {
 		tty = tty_port_tty_get(&port->port);
+		if (urb->actual_length && usb_wwan_rx_direct(tty)) {
+			struct usb_wwan_port_private *portdata =
+				usb_get_serial_port_data(port);
+
+			/* rx_work delivers and resubmits it */
+			usb_anchor_urb(urb, &portdata->rx_parked);
+			schedule_work(&portdata->rx_work);
+			tty_kref_put(tty);
+			return;
+		}
 		if (urb->actual_length) {
 			tty_insert_flip_string(tty, data, urb->actual_length);
 			tty_flip_buffer_push(tty);
@@ -242,6 +374,7 @@ static void usb_wwan_outdat_callback(struct urb *urb)
 	struct usb_serial_port *port;
 	struct usb_wwan_port_private *portdata;
 	struct usb_wwan_intf_private *intfdata;
+	unsigned long flags;
 	int i;
 
 	dbg("%s", __func__);
@@ -263,6 +396,15 @@ static void usb_wwan_outdat_callback(struct urb *urb)
 			break;
 		}
 	}
+
+	/* send what was batched up while this one was in flight */
+	spin_lock_irqsave(&portdata->tx_lock, flags);
+	i = portdata->tx_fill;
+	if (i >= 0) {
+		portdata->tx_fill = -1;
+		usb_wwan_submit_out(port, i);
+	}
+	spin_unlock_irqrestore(&portdata->tx_lock, flags);
 }
 
 int usb_wwan_write_room(struct tty_struct *tty)
@@ -280,6 +422,10 @@ int usb_wwan_write_room(struct tty_struct *tty)
 		if (this_urb && !test_bit(i, &portdata->out_busy))
 			data_len += OUT_BUFLEN;
 	}
+	i = portdata->tx_fill;
+	if (i >= 0)
+		data_len += OUT_BUFLEN -
+			portdata->out_urbs[i]->transfer_buffer_length;
 
 	dbg("%s: %d", __func__, data_len);
 	return data_len;
@@ -322,7 +468,7 @@ int usb_wwan_open(struct tty_struct *tty, struct usb_serial_port *port)
 	dbg("%s", __func__);
 
 	/* Start reading from the IN endpoint */
-	for (i = 0; i < N_IN_URB; i++) {
+	for (i = 0; i < portdata->n_in_urbs; i++) {
 		urb = portdata->in_urbs[i];
 		if (!urb)
 			continue;
@@ -362,8 +508,17 @@ void usb_wwan_close(struct usb_serial_port *port)
 		portdata->opened = 0;
 		spin_unlock_irq(&intfdata->susp_lock);
 
-		for (i = 0; i < N_IN_URB; i++)
+		for (i = 0; i < portdata->n_in_urbs; i++)
 			usb_kill_urb(portdata->in_urbs[i]);
+		flush_work(&portdata->rx_work);
+
+		spin_lock_irq(&portdata->tx_lock);
+		i = portdata->tx_fill;
+		if (i >= 0) {
+			portdata->tx_fill = -1;
+			clear_bit(i, &portdata->out_busy);
+		}
+		spin_unlock_irq(&portdata->tx_lock);
 		for (i = 0; i < N_OUT_URB; i++)
 			usb_kill_urb(portdata->out_urbs[i]);
 		usb_autopm_get_interface(serial->interface);
@@ -410,7 +565,7 @@ static void usb_wwan_setup_urbs(struct usb_serial *serial)
 		portdata = usb_get_serial_port_data(port);
 
 		/* Do indat endpoints first */
-		for (j = 0; j < N_IN_URB; ++j) {
+		for (j = 0; j < portdata->n_in_urbs; ++j) {
 			portdata->in_urbs[j] = usb_wwan_setup_urb(serial,
 								  port->
 								  bulk_in_endpointAddress,
@@ -418,7 +573,8 @@ static void usb_wwan_setup_urbs(struct usb_serial *serial)
 								  port,
 								  portdata->
 								  in_buffer[j],
-								  IN_BUFLEN,
+								  portdata->
+								  in_buflen,
 								  usb_wwan_indat_callback);
 		}
 
@@ -457,9 +613,15 @@ int usb_wwan_startup(struct usb_serial *serial)
 			return 1;
 		}
 		init_usb_anchor(&portdata->delayed);
-
-		for (j = 0; j < N_IN_URB; j++) {
-			buffer = (u8 *) __get_free_page(GFP_KERNEL);
+		init_usb_anchor(&portdata->rx_parked);
+		INIT_WORK(&portdata->rx_work, usb_wwan_rx_work);
+		spin_lock_init(&portdata->tx_lock);
+		portdata->tx_fill = -1;
+		portdata->n_in_urbs = clamp(nr_in_urbs, 1, N_IN_URB_MAX);
+		portdata->in_buflen = clamp(in_buflen, 64, 65536);
+
+		for (j = 0; j < portdata->n_in_urbs; j++) {
+			buffer = kmalloc(portdata->in_buflen, GFP_KERNEL);
 			if (!buffer)
 				goto bail_out_error;
 			portdata->in_buffer[j] = buffer;
@@ -487,9 +649,8 @@ bail_out_error2:
 	for (j = 0; j < N_OUT_URB; j++)
 		kfree(portdata->out_buffer[j]);
 bail_out_error:
-	for (j = 0; j < N_IN_URB; j++)
-		if (portdata->in_buffer[j])
-			free_page((unsigned long)portdata->in_buffer[j]);
+	for (j = 0; j < portdata->n_in_urbs; j++)
+		kfree(portdata->in_buffer[j]);
 	kfree(portdata);
 	return 1;
 }
@@ -505,7 +666,11 @@ static void stop_read_write_urbs(struct usb_serial *serial)
 	for (i = 0; i < serial->num_ports; ++i) {
 		port = serial->port[i];
 		portdata = usb_get_serial_port_data(port);
-		for (j = 0; j < N_IN_URB; j++)
+		for (j = 0; j < portdata->n_in_urbs; j++)
+			usb_kill_urb(portdata->in_urbs[j]);
+		/* deliver parked URBs, rx_work may have resubmitted some */
+		flush_work(&portdata->rx_work);
+		for (j = 0; j < portdata->n_in_urbs; j++)
 			usb_kill_urb(portdata->in_urbs[j]);
 		for (j = 0; j < N_OUT_URB; j++)
 			usb_kill_urb(portdata->out_urbs[j]);
@@ -533,10 +698,9 @@ void usb_wwan_release(struct usb_serial *serial)
 		port = serial->port[i];
 		portdata = usb_get_serial_port_data(port);
 
-		for (j = 0; j < N_IN_URB; j++) {
+		for (j = 0; j < portdata->n_in_urbs; j++) {
 			usb_free_urb(portdata->in_urbs[j]);
-			free_page((unsigned long)
-				  portdata->in_buffer[j]);
+			kfree(portdata->in_buffer[j]);
 			portdata->in_urbs[j] = NULL;
 		}
 		for (j = 0; j < N_OUT_URB; j++) {
@@ -634,7 +798,7 @@ int usb_wwan_resume(struct usb_serial *serial)
 			continue;
 		}
 
-		for (j = 0; j < N_IN_URB; j++) {
+		for (j = 0; j < portdata->n_in_urbs; j++) {
 			urb = portdata->in_urbs[j];
 			err = usb_submit_urb(urb, GFP_ATOMIC);
 			if (err < 0) {
@@ -663,3 +827,11 @@ MODULE_LICENSE("GPL");
 
 module_param(debug, bool, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(debug, "Debug messages");
+module_param(nr_in_urbs, int, S_IRUGO);
+MODULE_PARM_DESC(nr_in_urbs, "Receive URBs per port");
+module_param(in_buflen, int, S_IRUGO);
+MODULE_PARM_DESC(in_buflen, "Size of each receive URB");
+module_param(tx_batch, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(tx_batch, "Batch writes while URBs are in flight");
+module_param(rx_direct, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rx_direct, "Pass receive URBs straight to PPP");
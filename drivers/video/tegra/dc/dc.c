@@ -28,6 +28,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/workqueue.h>
 #include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/switch.h>
@@ -35,6 +36,7 @@
 #include <mach/clk.h>
 #include <mach/dc.h>
 #include <mach/fb.h>
+#include <mach/frame_timeline.h>
 #include <mach/mc.h>
 #include <mach/nvhost.h>
 
@@ -42,15 +44,27 @@
 #include "dc_priv.h"
 #include "overlay.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/tegra_dc.h>
+
 static int no_vsync;
 
 module_param_named(no_vsync, no_vsync, int, S_IRUGO | S_IWUSR);
 
+/* number of flips a client may have queued ahead of the screen */
+static unsigned int flip_queue_depth = 2;
+
+module_param_named(flip_queue_depth, flip_queue_depth, uint,
+		   S_IRUGO | S_IWUSR);
+
 struct tegra_dc *tegra_dcs[TEGRA_MAX_DC];
 
 DEFINE_MUTEX(tegra_dc_lock);
 DEFINE_MUTEX(shared_lock);
 
+/* serializes the EMC requests of the display heads, nests inside dc->lock */
+static DEFINE_MUTEX(bandwidth_lock);
+
 static inline int tegra_dc_fmt_bpp(int fmt)
 {
 	switch (fmt) {
@@ -316,12 +330,51 @@ static const struct file_operations dbg_fops = {
 	.release	= single_release,
 };
 
+static unsigned long tegra_dc_win_bandwidth(struct tegra_dc *dc,
+					    struct tegra_dc_win *win);
+static unsigned long tegra_dc_emc_rate(void);
+
+static int dbg_bandwidth_show(struct seq_file *s, void *unused)
+{
+	struct tegra_dc *dc = s->private;
+	int i;
+
+	mutex_lock(&dc->lock);
+	for (i = 0; i < dc->n_windows; i++)
+		seq_printf(s, "win%c: %lu KB/s\n", 'a' + i,
+			   tegra_dc_win_bandwidth(dc, &dc->windows[i]) / 1000);
+	seq_printf(s, "head: %lu KB/s\n", dc->bandwidth / 1000);
+	mutex_unlock(&dc->lock);
+
+	mutex_lock(&bandwidth_lock);
+	seq_printf(s, "emc floor: %lu kHz\n", tegra_dc_emc_rate() / 1000);
+	mutex_unlock(&bandwidth_lock);
+
+	return 0;
+}
+
+static int dbg_bandwidth_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbg_bandwidth_show, inode->i_private);
+}
+
+static const struct file_operations dbg_bandwidth_fops = {
+	.open		= dbg_bandwidth_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void tegra_dc_dbg_add(struct tegra_dc *dc)
 {
 	char name[32];
 
 	snprintf(name, sizeof(name), "tegra_dc%d_regs", dc->ndev->id);
 	(void) debugfs_create_file(name, S_IRUGO, NULL, dc, &dbg_fops);
+
+	snprintf(name, sizeof(name), "tegra_dc%d_bandwidth", dc->ndev->id);
+	(void) debugfs_create_file(name, S_IRUGO, NULL, dc,
+				   &dbg_bandwidth_fops);
 }
 #else
 static void tegra_dc_dbg_add(struct tegra_dc *dc) {}
@@ -370,6 +423,56 @@ struct tegra_dc_win *tegra_dc_get_window(struct tegra_dc *dc, unsigned win)
 }
 EXPORT_SYMBOL(tegra_dc_get_window);
 
+/*
+ * Window A has no scaling filters and no color space converter, window C
+ * only filters horizontally.  The DDA increment is 4.12 fixed point, so no
+ * window shrinks the source by 16 or more.
+ */
+static const struct tegra_dc_win_caps tegra_dc_win_caps[DC_N_WINDOWS] = {
+	{
+		.formats	= TEGRA_WIN_FMT_RGB_MASK,
+		.flags		= 0,
+		.max_w		= 4095,
+		.max_h		= 4095,
+		.max_downscale	= 15,
+	}, {
+		.formats	= TEGRA_WIN_FMT_RGB_MASK | TEGRA_WIN_FMT_YUV_MASK,
+		.flags		= TEGRA_WIN_CAP_H_FILTER | TEGRA_WIN_CAP_V_FILTER |
+				  TEGRA_WIN_CAP_CSC,
+		.max_w		= 4095,
+		.max_h		= 4095,
+		.max_downscale	= 15,
+	}, {
+		.formats	= TEGRA_WIN_FMT_RGB_MASK | TEGRA_WIN_FMT_YUV_MASK,
+		.flags		= TEGRA_WIN_CAP_H_FILTER | TEGRA_WIN_CAP_CSC,
+		.max_w		= 4095,
+		.max_h		= 4095,
+		.max_downscale	= 15,
+	},
+};
+
+const struct tegra_dc_win_caps *tegra_dc_get_window_caps(unsigned win)
+{
+	if (win >= DC_N_WINDOWS)
+		return NULL;
+
+	return &tegra_dc_win_caps[win];
+}
+EXPORT_SYMBOL(tegra_dc_get_window_caps);
+
+/* limited range BT.601, loaded into every window at init */
+const struct tegra_dc_csc tegra_dc_csc_bt601 = {
+	.yof	= 0x00f0,
+	.kyrgb	= 0x012a,
+	.kur	= 0x0000,
+	.kvr	= 0x0198,
+	.kug	= 0x039b,
+	.kvg	= 0x032f,
+	.kub	= 0x0204,
+	.kvb	= 0x0000,
+};
+EXPORT_SYMBOL(tegra_dc_csc_bt601);
+
 static int get_topmost_window(u32 *depths, unsigned long *wins)
 {
 	int idx, best = -1;
@@ -447,16 +550,16 @@ static void tegra_dc_set_blending(struct tegra_dc *dc, struct tegra_dc_blend *bl
 	}
 }
 
-static void tegra_dc_set_csc(struct tegra_dc *dc)
+static void tegra_dc_set_csc(struct tegra_dc *dc, const struct tegra_dc_csc *csc)
 {
-	tegra_dc_writel(dc, 0x00f0, DC_WIN_CSC_YOF);
-	tegra_dc_writel(dc, 0x012a, DC_WIN_CSC_KYRGB);
-	tegra_dc_writel(dc, 0x0000, DC_WIN_CSC_KUR);
-	tegra_dc_writel(dc, 0x0198, DC_WIN_CSC_KVR);
-	tegra_dc_writel(dc, 0x039b, DC_WIN_CSC_KUG);
-	tegra_dc_writel(dc, 0x032f, DC_WIN_CSC_KVG);
-	tegra_dc_writel(dc, 0x0204, DC_WIN_CSC_KUB);
-	tegra_dc_writel(dc, 0x0000, DC_WIN_CSC_KVB);
+	tegra_dc_writel(dc, csc->yof, DC_WIN_CSC_YOF);
+	tegra_dc_writel(dc, csc->kyrgb, DC_WIN_CSC_KYRGB);
+	tegra_dc_writel(dc, csc->kur, DC_WIN_CSC_KUR);
+	tegra_dc_writel(dc, csc->kvr, DC_WIN_CSC_KVR);
+	tegra_dc_writel(dc, csc->kug, DC_WIN_CSC_KUG);
+	tegra_dc_writel(dc, csc->kvg, DC_WIN_CSC_KVG);
+	tegra_dc_writel(dc, csc->kub, DC_WIN_CSC_KUB);
+	tegra_dc_writel(dc, csc->kvb, DC_WIN_CSC_KVB);
 }
 
 static void tegra_dc_set_scaling_filter(struct tegra_dc *dc)
@@ -476,13 +579,184 @@ static void tegra_dc_set_scaling_filter(struct tegra_dc *dc)
 	}
 }
 
+/*
+ * Scan-out bandwidth of a window in bytes per second.  While the window is
+ * on a line it fetches w pixels for every out_w pixel clocks, and when it
+ * is scaled down vertically it skips through h / out_h source lines per
+ * output line.  pclk already accounts for the refresh rate of the head.
+ */
+static unsigned long tegra_dc_win_bandwidth(struct tegra_dc *dc,
+					    struct tegra_dc_win *win)
+{
+	unsigned bpp;
+	u64 bw;
+
+	if (!(win->flags & TEGRA_WIN_FLAG_ENABLED) ||
+	    !win->out_w || !win->out_h || dc->mode.pclk <= 0)
+		return 0;
+
+	bpp = tegra_dc_fmt_bpp(win->fmt);
+	switch (win->fmt) {
+	/* tegra_dc_fmt_bpp() only covers the luma plane of planar formats */
+	case TEGRA_WIN_FMT_YCbCr420P:
+	case TEGRA_WIN_FMT_YUV420P:
+		bpp = bpp * 3 / 2;
+		break;
+	case TEGRA_WIN_FMT_YCbCr422P:
+	case TEGRA_WIN_FMT_YUV422P:
+		bpp *= 2;
+		break;
+	default:
+		/* packed YUV 4:2:2 */
+		if (!bpp)
+			bpp = 16;
+		break;
+	}
+
+	bw = (u64)dc->mode.pclk * bpp / 8;
+	bw = div_u64(bw * win->w, win->out_w);
+	if (win->h > win->out_h)
+		bw = div_u64(bw * win->h, win->out_h);
+
+	return bw > ULONG_MAX ? ULONG_MAX : (unsigned long)bw;
+}
+
+static unsigned long tegra_dc_head_bandwidth(struct tegra_dc *dc)
+{
+	unsigned long bw = 0;
+	int i;
+
+	for (i = 0; i < dc->n_windows; i++)
+		bw += tegra_dc_win_bandwidth(dc, &dc->windows[i]);
+
+	return bw;
+}
+
+/*
+ * DRAM is 32 bits wide and the EMC clock runs at its data rate, so every
+ * EMC cycle moves 4 bytes.  The display shares the DRAM with everything
+ * else and gets roughly half of its peak, so ask for twice the scan-out
+ * bandwidth.  Both heads fetch at the same time but the shared EMC clock
+ * only takes the highest request, so each head asks for the total.
+ */
+#define EMC_BYTES_PER_CLK		4
+#define EMC_DISPLAY_HEADROOM		2
+
+static unsigned long tegra_dc_emc_rate(void)
+{
+	unsigned long bw = 0;
+	int i;
+
+	for (i = 0; i < TEGRA_MAX_DC; i++)
+		if (tegra_dcs[i] && tegra_dcs[i]->enabled)
+			bw += tegra_dcs[i]->bandwidth;
+
+	if (bw > ULONG_MAX / EMC_DISPLAY_HEADROOM)
+		return ULONG_MAX;
+
+	return bw * EMC_DISPLAY_HEADROOM / EMC_BYTES_PER_CLK;
+}
+
+/* called with dc->lock held */
+static void tegra_dc_set_bandwidth(struct tegra_dc *dc, unsigned long bw)
+{
+	unsigned long rate;
+	int i;
+
+	mutex_lock(&bandwidth_lock);
+	dc->bandwidth = bw;
+	rate = tegra_dc_emc_rate();
+	for (i = 0; i < TEGRA_MAX_DC; i++)
+		if (tegra_dcs[i] && tegra_dcs[i]->enabled)
+			clk_set_rate(tegra_dcs[i]->emc_clk, rate);
+	mutex_unlock(&bandwidth_lock);
+}
+
+/*
+ * One-shot outputs only send the lines that changed.  Widens @damage to
+ * full lines and stores them in @band; falls back to the whole screen when
+ * a vertically scaled window crosses the damage, since its filter would
+ * need lines outside of the band.
+ */
+static void tegra_dc_get_update_band(struct tegra_dc *dc,
+				     const struct tegra_dc_rect *damage,
+				     struct tegra_dc_rect *band)
+{
+	unsigned top, bottom;
+	int i;
+
+	band->x = 0;
+	band->y = 0;
+	band->w = dc->mode.h_active;
+	band->h = dc->mode.v_active;
+
+	if (!damage)
+		return;
+
+	top = min_t(unsigned, damage->y, dc->mode.v_active);
+	bottom = min_t(unsigned, damage->y + damage->h, dc->mode.v_active);
+	if (bottom <= top)
+		return;
+
+	for (i = 0; i < dc->n_windows; i++) {
+		struct tegra_dc_win *win = &dc->windows[i];
+
+		if (!(win->flags & TEGRA_WIN_FLAG_ENABLED) ||
+		    win->out_y >= bottom || win->out_y + win->out_h <= top)
+			continue;
+
+		if (win->h != win->out_h)
+			return;
+	}
+
+	band->y = top;
+	band->h = bottom - top;
+}
+
+/*
+ * Crops @win to the lines of @band, in band-relative coordinates.  Returns
+ * false if the window has nothing to show in the band.
+ */
+static bool tegra_dc_clip_window(struct tegra_dc_win *win,
+				 const struct tegra_dc_rect *band)
+{
+	unsigned top = max(win->out_y, band->y);
+	unsigned bottom = min(win->out_y + win->out_h, band->y + band->h);
+
+	if (bottom <= top)
+		return false;
+
+	win->y += top - win->out_y;
+	win->h = bottom - top;
+	win->out_h = bottom - top;
+	win->out_y = top - band->y;
+
+	return true;
+}
+
 /* does not support updating windows on multiple dcs in one call */
 int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
+{
+	return tegra_dc_update_windows_region(windows, n, NULL);
+}
+EXPORT_SYMBOL(tegra_dc_update_windows);
+
+/*
+ * Like tegra_dc_update_windows(), @damage (NULL for the whole screen)
+ * bounds what has to be resent to outputs that keep their own copy of the
+ * frame.  Continuous outputs always scan out the full frame.
+ */
+int tegra_dc_update_windows_region(struct tegra_dc_win *windows[], int n,
+				   const struct tegra_dc_rect *damage)
 {
 	struct tegra_dc *dc;
+	struct tegra_dc_win *all[DC_N_WINDOWS];
+	struct tegra_dc_rect band;
 	unsigned long update_mask = GENERAL_ACT_REQ;
 	unsigned long val;
 	bool update_blend = false;
+	bool partial = false;
+	unsigned long bw;
 	int i;
 
 	dc = windows[0]->dc;
@@ -494,6 +768,35 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		return -EFAULT;
 	}
 
+	/*
+	 * One-shot frames are sent band by band, so every window has to be
+	 * reprogrammed for the band of this update.
+	 */
+	tegra_dc_get_update_band(dc, damage, &band);
+	if (dc->one_shot) {
+		if (dc->out_ops && dc->out_ops->set_update_region &&
+		    dc->out_ops->set_update_region(dc, &band) < 0 &&
+		    band.h != dc->mode.v_active) {
+			tegra_dc_get_update_band(dc, NULL, &band);
+			dc->out_ops->set_update_region(dc, &band);
+		}
+		partial = band.h != dc->mode.v_active;
+
+		for (i = 0; i < dc->n_windows; i++)
+			all[i] = &dc->windows[i];
+		windows = all;
+		n = dc->n_windows;
+	}
+
+	/*
+	 * Raise the EMC floor before the new windows are fetched; a lower
+	 * floor waits in tegra_dc_sync_windows() until the old state is gone.
+	 */
+	bw = tegra_dc_head_bandwidth(dc);
+	dc->new_bandwidth = bw;
+	if (bw > dc->bandwidth)
+		tegra_dc_set_bandwidth(dc, bw);
+
 	if (no_vsync)
 		tegra_dc_writel(dc, WRITE_MUX_ACTIVE | READ_MUX_ACTIVE, DC_CMD_STATE_ACCESS);
 	else
@@ -501,6 +804,8 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 
 	for (i = 0; i < n; i++) {
 		struct tegra_dc_win *win = windows[i];
+		struct tegra_dc_win clip;
+		const struct tegra_dc_win *w;
 		unsigned h_dda;
 		unsigned v_dda;
 		bool yuvp = tegra_dc_is_yuv_planar(win->fmt);
@@ -522,27 +827,44 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		if (!no_vsync)
 			update_mask |= WIN_A_ACT_REQ << win->idx;
 
+		if (win->csc_dirty) {
+			tegra_dc_set_csc(dc, &win->csc);
+			win->csc_dirty = false;
+		}
+
 		if (!(win->flags & TEGRA_WIN_FLAG_ENABLED)) {
 			tegra_dc_writel(dc, 0, DC_WIN_WIN_OPTIONS);
 			continue;
 		}
 
-		tegra_dc_writel(dc, win->fmt, DC_WIN_COLOR_DEPTH);
+		if (partial) {
+			clip = *win;
+			if (!tegra_dc_clip_window(&clip, &band)) {
+				tegra_dc_writel(dc, 0, DC_WIN_WIN_OPTIONS);
+				win->dirty = no_vsync ? 0 : 1;
+				continue;
+			}
+			w = &clip;
+		} else {
+			w = win;
+		}
+
+		tegra_dc_writel(dc, w->fmt, DC_WIN_COLOR_DEPTH);
 		tegra_dc_writel(dc, 0, DC_WIN_BYTE_SWAP);
 
 		tegra_dc_writel(dc,
-				V_POSITION(win->out_y) | H_POSITION(win->out_x),
+				V_POSITION(w->out_y) | H_POSITION(w->out_x),
 				DC_WIN_POSITION);
 		tegra_dc_writel(dc,
-				V_SIZE(win->out_h) | H_SIZE(win->out_w),
+				V_SIZE(w->out_h) | H_SIZE(w->out_w),
 				DC_WIN_SIZE);
 		tegra_dc_writel(dc,
-				V_PRESCALED_SIZE(win->h) |
-				H_PRESCALED_SIZE(win->w * tegra_dc_fmt_bpp(win->fmt) / 8),
+				V_PRESCALED_SIZE(w->h) |
+				H_PRESCALED_SIZE(w->w * tegra_dc_fmt_bpp(w->fmt) / 8),
 				DC_WIN_PRESCALED_SIZE);
 
-		h_dda = ((win->w - 1) * 0x1000) / max_t(int, win->out_w - 1, 1);
-		v_dda = ((win->h - 1) * 0x1000) / max_t(int, win->out_h - 1, 1);
+		h_dda = ((w->w - 1) * 0x1000) / max_t(int, w->out_w - 1, 1);
+		v_dda = ((w->h - 1) * 0x1000) / max_t(int, w->out_h - 1, 1);
 		tegra_dc_writel(dc, V_DDA_INC(v_dda) | H_DDA_INC(h_dda),
 				DC_WIN_DDA_INCREMENT);
 		tegra_dc_writel(dc, 0, DC_WIN_H_INITIAL_DDA);
@@ -551,28 +873,28 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		tegra_dc_writel(dc, 0, DC_WIN_BUF_STRIDE);
 		tegra_dc_writel(dc, 0, DC_WIN_UV_BUF_STRIDE);
 		tegra_dc_writel(dc,
-				(unsigned long)win->phys_addr +
-				(unsigned long)win->offset,
+				(unsigned long)w->phys_addr +
+				(unsigned long)w->offset,
 				DC_WINBUF_START_ADDR);
 
 		if (!yuvp) {
-			tegra_dc_writel(dc, win->stride, DC_WIN_LINE_STRIDE);
+			tegra_dc_writel(dc, w->stride, DC_WIN_LINE_STRIDE);
 		} else {
 			tegra_dc_writel(dc,
-					(unsigned long)win->phys_addr +
-					(unsigned long)win->offset_u,
+					(unsigned long)w->phys_addr +
+					(unsigned long)w->offset_u,
 					DC_WINBUF_START_ADDR_U);
 			tegra_dc_writel(dc,
-					(unsigned long)win->phys_addr +
-					(unsigned long)win->offset_v,
+					(unsigned long)w->phys_addr +
+					(unsigned long)w->offset_v,
 					DC_WINBUF_START_ADDR_V);
 			tegra_dc_writel(dc,
-					LINE_STRIDE(win->stride) |
-					UV_LINE_STRIDE(win->stride_uv),
+					LINE_STRIDE(w->stride) |
+					UV_LINE_STRIDE(w->stride_uv),
 					DC_WIN_LINE_STRIDE);
 		}
 
-		if (win->flags & TEGRA_WIN_FLAG_TILED)
+		if (w->flags & TEGRA_WIN_FLAG_TILED)
 			tegra_dc_writel(dc,
 					DC_WIN_BUFFER_ADDR_MODE_TILE |
 					DC_WIN_BUFFER_ADDR_MODE_TILE_UV,
@@ -583,19 +905,21 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 					DC_WIN_BUFFER_ADDR_MODE_LINEAR_UV,
 					DC_WIN_BUFFER_ADDR_MODE);
 
-		tegra_dc_writel(dc, win->x * tegra_dc_fmt_bpp(win->fmt) / 8,
+		tegra_dc_writel(dc, w->x * tegra_dc_fmt_bpp(w->fmt) / 8,
 				DC_WINBUF_ADDR_H_OFFSET);
-		tegra_dc_writel(dc, win->y, DC_WINBUF_ADDR_V_OFFSET);
+		tegra_dc_writel(dc, w->y, DC_WINBUF_ADDR_V_OFFSET);
 
 		val = WIN_ENABLE;
 		if (yuvp)
 			val |= CSC_ENABLE;
-		else if (tegra_dc_fmt_bpp(win->fmt) < 24)
+		else if (tegra_dc_fmt_bpp(w->fmt) < 24)
 			val |= COLOR_EXPAND;
 
-		if (win->w != win->out_w)
+		if (w->w != w->out_w &&
+		    (tegra_dc_win_caps[w->idx].flags & TEGRA_WIN_CAP_H_FILTER))
 			val |= H_FILTER_ENABLE;
-		if (win->h != win->out_h)
+		if (w->h != w->out_h &&
+		    (tegra_dc_win_caps[w->idx].flags & TEGRA_WIN_CAP_V_FILTER))
 			val |= V_FILTER_ENABLE;
 
 		tegra_dc_writel(dc, val, DC_WIN_WIN_OPTIONS);
@@ -603,6 +927,9 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		win->dirty = no_vsync ? 0 : 1;
 	}
 
+	if (no_vsync)
+		dc->latch_ts = ktime_get();
+
 	if (update_blend) {
 		tegra_dc_set_blending(dc, &dc->blend);
 		for (i = 0; i < DC_N_WINDOWS; i++) {
@@ -612,6 +939,10 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		}
 	}
 
+	if (dc->one_shot)
+		tegra_dc_writel(dc, dc->mode.h_active | (band.h << 16),
+				DC_DISP_DISP_ACTIVE);
+
 	tegra_dc_writel(dc, update_mask << 8, DC_CMD_STATE_CONTROL);
 
 	if (!no_vsync) {
@@ -624,12 +955,67 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		tegra_dc_writel(dc, val, DC_CMD_INT_MASK);
 	}
 
+	/* one-shot outputs only get a frame when it is asked for */
+	if (dc->one_shot)
+		update_mask |= NC_HOST_TRIG;
+
 	tegra_dc_writel(dc, update_mask, DC_CMD_STATE_CONTROL);
+	trace_tegra_dc_flip(dc->ndev->id, n, partial);
 	mutex_unlock(&dc->lock);
 
 	return 0;
 }
-EXPORT_SYMBOL(tegra_dc_update_windows);
+EXPORT_SYMBOL(tegra_dc_update_windows_region);
+
+unsigned tegra_dc_flip_queue_depth(void)
+{
+	return max(flip_queue_depth, 1u);
+}
+
+/*
+ * Sleeps until the next vertical blank or until @timeout jiffies have
+ * passed.  The flip queues use this to re-check their fences once a frame
+ * instead of blocking on a single syncpoint.
+ */
+int tegra_dc_wait_vblank(struct tegra_dc *dc, unsigned long timeout)
+{
+	unsigned long val;
+	u32 count;
+	int ret;
+
+	mutex_lock(&dc->lock);
+	if (!dc->enabled) {
+		mutex_unlock(&dc->lock);
+		return -EFAULT;
+	}
+
+	/* one-shot outputs have no vblank while nothing is sent */
+	if (dc->one_shot) {
+		mutex_unlock(&dc->lock);
+		return schedule_timeout_interruptible(min(timeout,
+						msecs_to_jiffies(16)));
+	}
+
+	count = dc->vblank_count;
+	if (dc->vblank_ref++ == 0) {
+		val = tegra_dc_readl(dc, DC_CMD_INT_ENABLE);
+		val |= V_BLANK_INT;
+		tegra_dc_writel(dc, val, DC_CMD_INT_ENABLE);
+	}
+	mutex_unlock(&dc->lock);
+
+	ret = wait_event_interruptible_timeout(dc->wq,
+					       dc->vblank_count != count,
+					       timeout);
+
+	/* the irq handler turns V_BLANK_INT off once nobody needs it */
+	mutex_lock(&dc->lock);
+	dc->vblank_ref--;
+	mutex_unlock(&dc->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(tegra_dc_wait_vblank);
 
 u32 tegra_dc_get_syncpt_id(const struct tegra_dc *dc)
 {
@@ -675,15 +1061,29 @@ static bool tegra_dc_windows_are_clean(struct tegra_dc_win *windows[],
 /* does not support syncing windows on multiple dcs in one call */
 int tegra_dc_sync_windows(struct tegra_dc_win *windows[], int n)
 {
+	struct tegra_dc *dc;
+	int ret;
+
 	if (n < 1 || n > DC_N_WINDOWS)
 		return -EINVAL;
 
-	if (!windows[0]->dc->enabled)
+	dc = windows[0]->dc;
+	if (!dc->enabled)
 		return -EFAULT;
 
-	return wait_event_interruptible_timeout(windows[0]->dc->wq,
+	ret = wait_event_interruptible_timeout(dc->wq,
 					 tegra_dc_windows_are_clean(windows, n),
 					 HZ);
+
+	/* the windows have latched, drop to the lower EMC floor if any */
+	if (ret > 0) {
+		mutex_lock(&dc->lock);
+		if (dc->enabled && dc->new_bandwidth < dc->bandwidth)
+			tegra_dc_set_bandwidth(dc, dc->new_bandwidth);
+		mutex_unlock(&dc->lock);
+	}
+
+	return ret;
 }
 EXPORT_SYMBOL(tegra_dc_sync_windows);
 
@@ -817,6 +1217,18 @@ static int tegra_dc_program_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode
 	switch_set_state(&dc->modeset_switch,
 			 (mode->h_active << 16) | mode->v_active);
 
+	if (mode->pclk) {
+		u64 htotal = mode->h_sync_width + mode->h_back_porch +
+			     mode->h_active + mode->h_front_porch;
+		u32 vblank = mode->v_sync_width + mode->v_back_porch +
+			     mode->v_front_porch;
+
+		tegra_ftl_dc_mode(dc->ndev->id,
+			div_u64(htotal * (vblank + mode->v_active) *
+				NSEC_PER_SEC, mode->pclk),
+			div_u64(htotal * vblank * NSEC_PER_SEC, mode->pclk));
+	}
+
 	return 0;
 }
 
@@ -989,10 +1401,13 @@ static irqreturn_t tegra_dc_irq(int irq, void *ptr)
 	if (status & FRAME_END_INT) {
 		int completed = 0;
 		int dirty = 0;
+		int latched = 0;
 
 		val = tegra_dc_readl(dc, DC_CMD_STATE_CONTROL);
 		for (i = 0; i < DC_N_WINDOWS; i++) {
 			if (!(val & (WIN_A_UPDATE << i))) {
+				if (dc->windows[i].dirty)
+					latched = 1;
 				dc->windows[i].dirty = 0;
 				completed = 1;
 			} else {
@@ -1006,6 +1421,11 @@ static irqreturn_t tegra_dc_irq(int irq, void *ptr)
 			tegra_dc_writel(dc, val, DC_CMD_INT_ENABLE);
 		}
 
+		if (latched) {
+			dc->latch_ts = ktime_get();
+			tegra_ftl_flip_latched(dc->ndev->id, dc->latch_ts);
+		}
+
 		if (completed)
 			wake_up(&dc->wq);
 	}
@@ -1039,13 +1459,20 @@ static irqreturn_t tegra_dc_irq(int irq, void *ptr)
 			}
 		}
 
-		if (!dc->underflow_mask) {
+		if (!dc->underflow_mask && !dc->vblank_ref) {
 			val = tegra_dc_readl(dc, DC_CMD_INT_ENABLE);
 			val &= ~V_BLANK_INT;
 			tegra_dc_writel(dc, val, DC_CMD_INT_ENABLE);
 		}
 
 		dc->underflow_mask = 0;
+
+		trace_tegra_dc_vblank(dc->ndev->id, dc->vblank_count);
+
+		if (dc->vblank_ref) {
+			dc->vblank_count++;
+			wake_up(&dc->wq);
+		}
 	}
 
 
@@ -1172,7 +1599,7 @@ static void tegra_dc_init(struct tegra_dc *dc)
 	for (i = 0; i < DC_N_WINDOWS; i++) {
 		tegra_dc_writel(dc, WINDOW_A_SELECT << i,
 				DC_CMD_DISPLAY_WINDOW_HEADER);
-		tegra_dc_set_csc(dc);
+		tegra_dc_set_csc(dc, &dc->windows[i].csc);
 		tegra_dc_set_scaling_filter(dc);
 	}
 
@@ -1255,6 +1682,10 @@ static void _tegra_dc_controller_disable(struct tegra_dc *dc)
 	clk_disable(dc->clk);
 	tegra_dvfs_set_rate(dc->clk, 0);
 
+	/* the other head no longer needs to cover this one's fetches */
+	dc->new_bandwidth = 0;
+	tegra_dc_set_bandwidth(dc, 0);
+
 	if (dc->out && dc->out->disable)
 		dc->out->disable();
 
@@ -1453,6 +1884,7 @@ static int tegra_dc_probe(struct nvhost_device *ndev)
 	for (i = 0; i < dc->n_windows; i++) {
 		dc->windows[i].idx = i;
 		dc->windows[i].dc = dc;
+		dc->windows[i].csc = tegra_dc_csc_bt601;
 	}
 
 	if (request_irq(irq, tegra_dc_irq, IRQF_DISABLED,
@@ -19,6 +19,7 @@
 #define __DRIVERS_VIDEO_TEGRA_DC_DC_PRIV_H
 
 #include <linux/io.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/wait.h>
@@ -48,6 +49,11 @@ struct tegra_dc_out_ops {
 	void (*suspend)(struct tegra_dc *dc);
 	/* resume output.  dc clocks are on at this point */
 	void (*resume)(struct tegra_dc *dc);
+
+	/* one-shot outputs: make the panel take the next frame into
+	 * @rect of its own frame buffer.  dc clocks are on at this point */
+	int (*set_update_region)(struct tegra_dc *dc,
+				 const struct tegra_dc_rect *rect);
 };
 
 struct tegra_dc {
@@ -75,6 +81,9 @@ struct tegra_dc {
 	struct tegra_dc_blend		blend;
 	int				n_windows;
 
+	/* the panel keeps the frame, the dc only sends it on request */
+	bool				one_shot;
+
 	wait_queue_head_t		wq;
 
 	struct mutex			lock;
@@ -91,6 +100,17 @@ struct tegra_dc {
 	unsigned long			underflow_mask;
 	struct work_struct		reset_work;
 
+	/* vblank waiters, protected by lock; read from the irq handler */
+	int				vblank_ref;
+	u32				vblank_count;
+	/* when the last window update reached the screen */
+	ktime_t				latch_ts;
+
+	/* scan-out bandwidth in bytes/s requested from the EMC, and the
+	 * request of the windows programmed but not yet latched */
+	unsigned long			bandwidth;
+	unsigned long			new_bandwidth;
+
 	struct switch_dev		modeset_switch;
 };
 
@@ -142,6 +162,8 @@ static inline void *tegra_dc_get_outdata(struct tegra_dc *dc)
 
 void tegra_dc_setup_clk(struct tegra_dc *dc, struct clk *clk);
 
+unsigned tegra_dc_flip_queue_depth(void);
+
 extern struct tegra_dc_out_ops tegra_dc_rgb_ops;
 extern struct tegra_dc_out_ops tegra_dc_hdmi_ops;
 extern struct tegra_dc_out_ops tegra_dc_dsi_ops;
@@ -117,6 +117,9 @@ struct tegra_dc_dsi_data {
 	u32		current_dsi_clk_khz;
 
 	u32		dsi_control_val;
+
+	/* panel frame buffer area the next one-shot frame goes to */
+	struct tegra_dc_rect	update_region;
 };
 
 const u32 dsi_pkt_seq_reg[NUMOF_PKT_SEQ] = {
@@ -725,9 +728,8 @@ static void tegra_dsi_start_dc_stream(struct tegra_dc *dc,
 	tegra_dc_writel(dc, val, DC_CMD_DISPLAY_COMMAND_OPTION0);
 
 
-	/* TODO: using continuous video mode for now */
-	/* if (dsi->info.panel_has_frame_buffer) {*/
-	if (0) {
+	/* panels with a frame buffer only get the frames that changed */
+	if (dc->one_shot) {
 		tegra_dc_writel(dc, DISP_CTRL_MODE_NC_DISPLAY, DC_CMD_DISPLAY_COMMAND);
 		tegra_dc_writel(dc, GENERAL_UPDATE, DC_CMD_STATE_CONTROL);
 		val = GENERAL_ACT_REQ | NC_HOST_TRIG;
@@ -1171,6 +1173,57 @@ fail:
 	return err;
 }
 
+static int tegra_dsi_set_address(struct tegra_dc *dc,
+				 struct tegra_dc_dsi_data *dsi,
+				 u8 cmd, unsigned start, unsigned end)
+{
+	u8 data[5];
+
+	data[0] = cmd;
+	data[1] = start >> 8;
+	data[2] = start & 0xff;
+	data[3] = end >> 8;
+	data[4] = end & 0xff;
+
+	return tegra_dsi_write_data(dc, dsi, data, dsi_command_long_write,
+				    sizeof(data));
+}
+
+/*
+ * Points the panel's memory window at @rect, so that the write_memory_start
+ * of the next one-shot frame fills only that area.
+ */
+static int tegra_dc_dsi_set_update_region(struct tegra_dc *dc,
+					  const struct tegra_dc_rect *rect)
+{
+	struct tegra_dc_dsi_data *dsi = tegra_dc_get_outdata(dc);
+	int err = 0;
+
+	if (!memcmp(&dsi->update_region, rect, sizeof(*rect)))
+		return 0;
+
+	mutex_lock(&dsi->lock);
+
+	/* forget the old window if the panel only took part of the update */
+	memset(&dsi->update_region, 0, sizeof(dsi->update_region));
+
+	err = tegra_dsi_set_address(dc, dsi, DSI_SET_COLUMN_ADDRESS,
+				    rect->x, rect->x + rect->w - 1);
+	if (err < 0)
+		goto fail;
+
+	err = tegra_dsi_set_address(dc, dsi, DSI_SET_PAGE_ADDRESS,
+				    rect->y, rect->y + rect->h - 1);
+	if (err < 0)
+		goto fail;
+
+	dsi->update_region = *rect;
+
+fail:
+	mutex_unlock(&dsi->lock);
+	return err;
+}
+
 static int tegra_dsi_init_panel(struct tegra_dc *dc,
 						struct tegra_dc_dsi_data *dsi)
 {
@@ -1229,6 +1282,9 @@ static void tegra_dc_dsi_enable(struct tegra_dc *dc)
 		return;
 	}
 
+	/* the panel init reset its memory window */
+	memset(&dsi->update_region, 0, sizeof(dsi->update_region));
+
 	if (dsi->status.driven == DSI_DRIVEN_MODE_DC) {
 		tegra_dsi_start_dc_stream(dc, dsi);
 	}
@@ -1392,6 +1448,10 @@ static int tegra_dc_dsi_init(struct tegra_dc *dc)
 	tegra_dc_set_outdata(dc, dsi);
 	_tegra_dc_dsi_init(dc);
 
+	dc->one_shot = dsi->info.video_data_type ==
+			TEGRA_DSI_VIDEO_TYPE_COMMAND_MODE &&
+		       dsi->info.panel_has_frame_buffer;
+
 	return 0;
 
 err_dsi_data:
@@ -1465,4 +1525,5 @@ struct tegra_dc_out_ops tegra_dc_dsi_ops = {
 	.destroy = tegra_dc_dsi_destroy,
 	.enable = tegra_dc_dsi_enable,
 	.disable = tegra_dc_dsi_disable,
+	.set_update_region = tegra_dc_dsi_set_update_region,
 };
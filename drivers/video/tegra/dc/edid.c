@@ -21,10 +21,26 @@
 #include <linux/fb.h>
 #include <linux/i2c.h>
 #include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 #include <linux/vmalloc.h>
 
 #include "edid.h"
 
+/*
+ * Raw EDIDs of the last few sinks seen on the bus.  Block 0 carries the
+ * sink's vendor, product and serial number, so a sink whose block 0
+ * matches a cached copy gets its extension blocks from the cache instead
+ * of another round of DDC reads.
+ */
+#define TEGRA_EDID_CACHE_SIZE	4
+
+struct tegra_edid_cache_entry {
+	u8			*data;
+	unsigned		len;
+	unsigned		stamp;
+};
+
 struct tegra_edid {
 	struct i2c_client	*client;
 	struct i2c_board_info	info;
@@ -33,6 +49,9 @@ struct tegra_edid {
 	u8			*data;
 	unsigned		len;
 	u8			support_stereo;
+
+	struct tegra_edid_cache_entry	cache[TEGRA_EDID_CACHE_SIZE];
+	unsigned		cache_stamp;
 };
 
 #if defined(DEBUG) || defined(CONFIG_DEBUG_FS)
@@ -163,6 +182,54 @@ int tegra_edid_read_block(struct tegra_edid *edid, int block, u8 *data)
 	return 0;
 }
 
+static struct tegra_edid_cache_entry *
+tegra_edid_cache_lookup(struct tegra_edid *edid)
+{
+	struct tegra_edid_cache_entry *entry;
+	int i;
+
+	for (i = 0; i < TEGRA_EDID_CACHE_SIZE; i++) {
+		entry = &edid->cache[i];
+		if (entry->data && !memcmp(entry->data, edid->data, 128)) {
+			entry->stamp = ++edid->cache_stamp;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void tegra_edid_cache_store(struct tegra_edid *edid)
+{
+	struct tegra_edid_cache_entry *entry = &edid->cache[0];
+	u8 *data;
+	int i;
+
+	/* replace an empty slot or else the least recently used one */
+	for (i = 1; i < TEGRA_EDID_CACHE_SIZE && entry->data; i++) {
+		if (!edid->cache[i].data ||
+		    (int)(edid->cache[i].stamp - entry->stamp) < 0)
+			entry = &edid->cache[i];
+	}
+
+	data = kmemdup(edid->data, edid->len, GFP_KERNEL);
+	if (!data)
+		return;
+
+	kfree(entry->data);
+	entry->data = data;
+	entry->len = edid->len;
+	entry->stamp = ++edid->cache_stamp;
+}
+
+static void tegra_edid_cache_free(struct tegra_edid *edid)
+{
+	int i;
+
+	for (i = 0; i < TEGRA_EDID_CACHE_SIZE; i++)
+		kfree(edid->cache[i].data);
+}
+
 int tegra_edid_parse_ext_block(u8 *raw, int idx, struct tegra_edid *edid)
 {
 	u8 *ptr;
@@ -239,6 +306,7 @@ int tegra_edid_mode_support_stereo(struct fb_videomode *mode)
 
 int tegra_edid_get_monspecs(struct tegra_edid *edid, struct fb_monspecs *specs)
 {
+	struct tegra_edid_cache_entry *cached;
 	int i;
 	int j;
 	int ret;
@@ -257,10 +325,20 @@ int tegra_edid_get_monspecs(struct tegra_edid *edid, struct fb_monspecs *specs)
 
 	extension_blocks = edid->data[0x7e];
 
+	cached = tegra_edid_cache_lookup(edid);
+	if (cached) {
+		pr_debug("edid: sink known, using cached extension blocks\n");
+		memcpy(edid->data + 128, cached->data + 128, cached->len - 128);
+		extension_blocks = cached->len / 128 - 1;
+	}
+
 	for (i = 1; i <= extension_blocks; i++) {
-		ret = tegra_edid_read_block(edid, i, edid->data + i * 128);
-		if (ret < 0)
-			break;
+		if (!cached) {
+			ret = tegra_edid_read_block(edid, i,
+						    edid->data + i * 128);
+			if (ret < 0)
+				break;
+		}
 
 		if (edid->data[i * 128] == 0x2) {
 			fb_edid_add_monspecs(edid->data + i * 128, specs);
@@ -281,6 +359,10 @@ int tegra_edid_get_monspecs(struct tegra_edid *edid, struct fb_monspecs *specs)
 
 	edid->len = i * 128;
 
+	/* only complete reads are worth remembering */
+	if (!cached && i > extension_blocks)
+		tegra_edid_cache_store(edid);
+
 	tegra_edid_dump(edid);
 
 	return 0;
@@ -336,6 +418,7 @@ free_edid:
 void tegra_edid_destroy(struct tegra_edid *edid)
 {
 	i2c_release_client(edid->client);
+	tegra_edid_cache_free(edid);
 	vfree(edid->data);
 	kfree(edid);
 }
@@ -30,6 +30,7 @@
 #include <mach/clk.h>
 #include <mach/dc.h>
 #include <mach/fb.h>
+#include <mach/hdmi-audio.h>
 #include <mach/nvhost.h>
 
 #include <video/tegrafb.h>
@@ -68,6 +69,13 @@ struct tegra_dc_hdmi_data {
 	bool				dvi;
 };
 
+/* S/PDIF source format, set by tegra_hdmi_setup_audio_format() and
+ * protected by hdmi_audio_dc->lock once HDMI is registered.
+ */
+static struct tegra_dc *hdmi_audio_dc;
+static unsigned hdmi_audio_freq = 44100;
+static bool hdmi_audio_compressed;
+
 const struct fb_videomode tegra_dc_hdmi_supported_modes[] = {
 	/* 1280x720p 60hz: EIA/CEA-861-B Format 4 */
 	{
@@ -734,6 +742,7 @@ static int tegra_dc_hdmi_init(struct tegra_dc *dc)
 	dc->out->depth = 24;
 
 	tegra_dc_set_outdata(dc, hdmi);
+	hdmi_audio_dc = dc;
 
 	/* boards can select default content protection policy */
 	if (dc->out->flags & TEGRA_DC_OUT_NVHDCP_POLICY_ON_DEMAND) {
@@ -782,6 +791,7 @@ static void tegra_dc_hdmi_destroy(struct tegra_dc *dc)
 	tegra_edid_destroy(hdmi->edid);
 	tegra_nvhdcp_destroy(hdmi->nvhdcp);
 
+	hdmi_audio_dc = NULL;
 	kfree(hdmi);
 
 }
@@ -824,7 +834,7 @@ static int tegra_dc_hdmi_setup_audio(struct tegra_dc *dc)
 	struct tegra_dc_hdmi_data *hdmi = tegra_dc_get_outdata(dc);
 	const struct tegra_hdmi_audio_config *config;
 	unsigned long audio_n;
-	unsigned audio_freq = 44100; /* TODO: find some way of configuring this */
+	unsigned audio_freq = hdmi_audio_freq;
 
 	tegra_hdmi_writel(hdmi,
 			  AUDIO_CNTRL0_ERROR_TOLERANCE(6) |
@@ -1022,7 +1032,9 @@ static void tegra_dc_hdmi_setup_audio_infoframe(struct tegra_dc *dc, bool dvi)
 
 	memset(&audio, 0x0, sizeof(audio));
 
-	audio.cc = HDMI_AUDIO_CC_2;
+	/* compressed streams carry coding type and channels in their header */
+	if (!hdmi_audio_compressed)
+		audio.cc = HDMI_AUDIO_CC_2;
 	tegra_dc_hdmi_write_infopack(dc, HDMI_NV_PDISP_HDMI_AUDIO_INFOFRAME_HEADER,
 				     HDMI_INFOFRAME_TYPE_AUDIO,
 				     HDMI_AUDIO_VERSION,
@@ -1032,6 +1044,47 @@ static void tegra_dc_hdmi_setup_audio_infoframe(struct tegra_dc *dc, bool dvi)
 			  HDMI_NV_PDISP_HDMI_AUDIO_INFOFRAME_CTRL);
 }
 
+int tegra_hdmi_setup_audio_format(unsigned audio_freq, bool compressed)
+{
+	struct tegra_dc *dc = hdmi_audio_dc;
+	struct tegra_dc_hdmi_data *hdmi;
+	int err = 0;
+
+	/* the ACR tables only cover these */
+	if (audio_freq != 32000 && audio_freq != 44100 && audio_freq != 48000)
+		return -EINVAL;
+
+	if (!dc) {
+		hdmi_audio_freq = audio_freq;
+		hdmi_audio_compressed = compressed;
+		return 0;
+	}
+
+	mutex_lock(&dc->lock);
+	hdmi = tegra_dc_get_outdata(dc);
+	if (dc->enabled && !hdmi->dvi &&
+	    !tegra_hdmi_get_audio_config(audio_freq, dc->mode.pclk)) {
+		dev_err(&dc->ndev->dev,
+			"hdmi: can't set audio to %d at %d pix_clock",
+			audio_freq, dc->mode.pclk);
+		err = -EINVAL;
+		goto out;
+	}
+
+	hdmi_audio_freq = audio_freq;
+	hdmi_audio_compressed = compressed;
+
+	if (dc->enabled && !hdmi->dvi) {
+		err = tegra_dc_hdmi_setup_audio(dc);
+		if (!err)
+			tegra_dc_hdmi_setup_audio_infoframe(dc, false);
+	}
+out:
+	mutex_unlock(&dc->lock);
+	return err;
+}
+EXPORT_SYMBOL(tegra_hdmi_setup_audio_format);
+
 static void tegra_dc_hdmi_setup_tdms(struct tegra_dc_hdmi_data *hdmi,
 		const struct tdms_config *tc)
 {
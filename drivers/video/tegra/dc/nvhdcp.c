@@ -112,36 +112,24 @@ static inline bool nvhdcp_set_plugged(struct tegra_nvhdcp *nvhdcp, bool plugged)
 	wmb();
 }
 
-static int nvhdcp_i2c_read(struct tegra_nvhdcp *nvhdcp, u8 reg,
-					size_t len, void *data)
+/* only back off between attempts, a transfer that worked returns at once */
+static int nvhdcp_i2c_xfer(struct tegra_nvhdcp *nvhdcp,
+				struct i2c_msg *msg, int num)
 {
 	int status;
 	int retries = 15;
-	struct i2c_msg msg[] = {
-		{
-			.addr = 0x74 >> 1, /* primary link */
-			.flags = 0,
-			.len = 1,
-			.buf = &reg,
-		},
-		{
-			.addr = 0x74 >> 1, /* primary link */
-			.flags = I2C_M_RD,
-			.len = len,
-			.buf = data,
-		},
-	};
 
 	do {
 		if (!nvhdcp_is_plugged(nvhdcp)) {
 			nvhdcp_err("disconnect during i2c xfer\n");
 			return -EIO;
 		}
-		status = i2c_transfer(nvhdcp->client->adapter,
-			msg, ARRAY_SIZE(msg));
+		status = i2c_transfer(nvhdcp->client->adapter, msg, num);
+		if (status >= 0)
+			break;
 		if (retries > 1)
 			msleep(250);
-	} while ((status < 0) && retries--);
+	} while (retries--);
 
 	if (status < 0) {
 		nvhdcp_err("i2c xfer error %d\n", status);
@@ -151,10 +139,30 @@ static int nvhdcp_i2c_read(struct tegra_nvhdcp *nvhdcp, u8 reg,
 	return 0;
 }
 
+static int nvhdcp_i2c_read(struct tegra_nvhdcp *nvhdcp, u8 reg,
+					size_t len, void *data)
+{
+	struct i2c_msg msg[] = {
+		{
+			.addr = 0x74 >> 1, /* primary link */
+			.flags = 0,
+			.len = 1,
+			.buf = &reg,
+		},
+		{
+			.addr = 0x74 >> 1, /* primary link */
+			.flags = I2C_M_RD,
+			.len = len,
+			.buf = data,
+		},
+	};
+
+	return nvhdcp_i2c_xfer(nvhdcp, msg, ARRAY_SIZE(msg));
+}
+
 static int nvhdcp_i2c_write(struct tegra_nvhdcp *nvhdcp, u8 reg,
 					size_t len, const void *data)
 {
-	int status;
 	u8 buf[len + 1];
 	struct i2c_msg msg[] = {
 		{
@@ -164,28 +172,11 @@ static int nvhdcp_i2c_write(struct tegra_nvhdcp *nvhdcp, u8 reg,
 			.buf = buf,
 		},
 	};
-	int retries = 15;
 
 	buf[0] = reg;
 	memcpy(buf + 1, data, len);
 
-	do {
-		if (!nvhdcp_is_plugged(nvhdcp)) {
-			nvhdcp_err("disconnect during i2c xfer\n");
-			return -EIO;
-		}
-		status = i2c_transfer(nvhdcp->client->adapter,
-			msg, ARRAY_SIZE(msg));
-		if (retries > 1)
-			msleep(250);
-	} while ((status < 0) && retries--);
-
-	if (status < 0) {
-		nvhdcp_err("i2c xfer error %d\n", status);
-		return status;
-	}
-
-	return 0;
+	return nvhdcp_i2c_xfer(nvhdcp, msg, ARRAY_SIZE(msg));
 }
 
 static inline int nvhdcp_i2c_read8(struct tegra_nvhdcp *nvhdcp, u8 reg, u8 *val)
@@ -235,26 +226,54 @@ static int nvhdcp_i2c_read40(struct tegra_nvhdcp *nvhdcp, u8 reg, u64 *val)
 	return 0;
 }
 
-static int nvhdcp_i2c_write40(struct tegra_nvhdcp *nvhdcp, u8 reg, u64 val)
+/*
+ * Write Ainfo, An and Aksv to the receiver in one transfer.  Aksv goes
+ * last since writing it starts the authentication on the receiver.
+ */
+static int nvhdcp_i2c_write_auth(struct tegra_nvhdcp *nvhdcp, u8 a_info,
+					u64 a_n, u64 a_ksv)
 {
-	char buf[5];
+	u8 info_buf[2];
+	u8 an_buf[9];
+	u8 aksv_buf[6];
+	struct i2c_msg msg[] = {
+		{
+			.addr = 0x74 >> 1, /* primary link */
+			.flags = 0,
+			.len = sizeof info_buf,
+			.buf = info_buf,
+		},
+		{
+			.addr = 0x74 >> 1, /* primary link */
+			.flags = 0,
+			.len = sizeof an_buf,
+			.buf = an_buf,
+		},
+		{
+			.addr = 0x74 >> 1, /* primary link */
+			.flags = 0,
+			.len = sizeof aksv_buf,
+			.buf = aksv_buf,
+		},
+	};
 	int i;
-	for(i = 0; i < 5; i++ ) {
-		buf[i] = val;
-		val >>= 8;
+
+	info_buf[0] = 0x15;
+	info_buf[1] = a_info;
+
+	an_buf[0] = 0x18;
+	for (i = 1; i < sizeof an_buf; i++) {
+		an_buf[i] = a_n;
+		a_n >>= 8;
 	}
-	return nvhdcp_i2c_write(nvhdcp, reg, sizeof buf, buf);
-}
 
-static int nvhdcp_i2c_write64(struct tegra_nvhdcp *nvhdcp, u8 reg, u64 val)
-{
-	char buf[8];
-	int i;
-	for(i = 0; i < 8; i++ ) {
-		buf[i] = val;
-		val >>= 8;
+	aksv_buf[0] = 0x10;
+	for (i = 1; i < sizeof aksv_buf; i++) {
+		aksv_buf[i] = a_ksv;
+		a_ksv >>= 8;
 	}
-	return nvhdcp_i2c_write(nvhdcp, reg, sizeof buf, buf);
+
+	return nvhdcp_i2c_xfer(nvhdcp, msg, ARRAY_SIZE(msg));
 }
 
 
@@ -376,17 +395,10 @@ static int get_ksvfifo(struct tegra_nvhdcp *nvhdcp,
 	return 0;
 }
 
-/* get V' 160-bit SHA-1 hash from repeater */
+/* get V' 160-bit SHA-1 hash from repeater, H0' to H4' are contiguous */
 static int get_vprime(struct tegra_nvhdcp *nvhdcp, u8 *v_prime)
 {
-	int e, i;
-
-	for (i = 0; i < 20; i += 4) {
-		e = nvhdcp_i2c_read(nvhdcp, 0x20 + i, 4, v_prime + i);
-		if (e)
-			return e;
-	}
-	return 0;
+	return nvhdcp_i2c_read(nvhdcp, 0x20, 20, v_prime);
 }
 
 
@@ -894,29 +906,16 @@ static void nvhdcp_downstream_worker(struct work_struct *work)
 		goto failure;
 	}
 
-	/* write Ainfo to receiver - set 1.1 only if b_caps supports it */
-	e = nvhdcp_i2c_write8(nvhdcp, 0x15, b_caps & BCAPS_11);
-	if (e) {
-		nvhdcp_err("Ainfo write failure\n");
-		goto failure;
-	}
-
-	/* write An to receiver */
-	e = nvhdcp_i2c_write64(nvhdcp, 0x18, nvhdcp->a_n);
+	/* write Ainfo (1.1 only if b_caps supports it), An and Aksv to
+	 * receiver - Aksv triggers auth sequence */
+	e = nvhdcp_i2c_write_auth(nvhdcp, b_caps & BCAPS_11,
+				nvhdcp->a_n, nvhdcp->a_ksv);
 	if (e) {
-		nvhdcp_err("An write failure\n");
+		nvhdcp_err("Ainfo/An/Aksv write failure\n");
 		goto failure;
 	}
 
 	nvhdcp_vdbg("wrote An = 0x%016llx\n", nvhdcp->a_n);
-
-	/* write Aksv to receiver - triggers auth sequence */
-	e = nvhdcp_i2c_write40(nvhdcp, 0x10, nvhdcp->a_ksv);
-	if (e) {
-		nvhdcp_err("Aksv write failure\n");
-		goto failure;
-	}
-
 	nvhdcp_vdbg("wrote Aksv = 0x%010llx\n", nvhdcp->a_ksv);
 
 	/* bail out if unplugged in the middle of negotiation */
@@ -27,11 +27,13 @@
 #include <linux/spinlock.h>
 #include <linux/tegra_overlay.h>
 #include <linux/uaccess.h>
+#include <linux/wait.h>
 
 #include <asm/atomic.h>
 
 #include <mach/dc.h>
 #include <mach/fb.h>
+#include <mach/frame_timeline.h>
 #include <mach/nvhost.h>
 
 #include "dc_priv.h"
@@ -42,6 +44,10 @@ struct overlay_client;
 
 struct overlay {
 	struct overlay_client	*owner;
+
+	/* set by SET_CSC, handed to the next flip of the window */
+	struct tegra_dc_csc	csc;
+	bool			csc_pending;
 };
 
 struct tegra_overlay_info {
@@ -60,6 +66,18 @@ struct tegra_overlay_info {
 	struct tegra_dc		*dc;
 
 	struct workqueue_struct	*flip_wq;
+	struct work_struct	flip_work;
+
+	/* flips waiting for their fences, oldest first */
+	struct list_head	flip_queue;
+	int			flip_queued;
+	struct mutex		flip_lock;
+	wait_queue_head_t	flip_wait;
+
+	/* last flip that reached the screen, protected by flip_lock */
+	u32			present_val;
+	u32			present_dropped;
+	ktime_t			present_ts;
 
 	/* Big enough for tegra_dc%u when %u < 10 */
 	char			name[10];
@@ -76,15 +94,21 @@ struct tegra_overlay_flip_win {
 	struct tegra_overlay_windowattr	attr;
 	struct nvmap_handle_ref		*handle;
 	dma_addr_t			phys_addr;
+	struct tegra_dc_csc		csc;
+	bool				csc_valid;
 };
 
 struct tegra_overlay_flip_data {
-	struct work_struct		work;
+	struct list_head		list;
 	struct tegra_overlay_info	*overlay;
 	struct tegra_overlay_flip_win	win[TEGRA_FB_FLIP_N_WINDOWS];
 	u32				syncpt_max;
+	unsigned long			deadline;
 };
 
+/* how long a flip waits for its fences before it is shown anyway */
+#define TEGRA_OVERLAY_FLIP_TIMEOUT	msecs_to_jiffies(500)
+
 /* Overlay window manipulation */
 static int tegra_overlay_pin_window(struct tegra_overlay_info *overlay,
 				    struct tegra_overlay_flip_win *flip_win,
@@ -132,6 +156,12 @@ static int tegra_overlay_set_windowattr(struct tegra_overlay_info *overlay,
 					const struct tegra_overlay_flip_win *flip_win)
 {
 	int xres, yres;
+
+	if (flip_win->csc_valid) {
+		win->csc = flip_win->csc;
+		win->csc_dirty = true;
+	}
+
 	if (flip_win->handle == NULL) {
 		win->flags = 0;
 		win->cur_handle = NULL;
@@ -174,29 +204,136 @@ static int tegra_overlay_set_windowattr(struct tegra_overlay_info *overlay,
 	if (flip_win->attr.tiled)
 		win->flags |= TEGRA_WIN_FLAG_TILED;
 
-	if ((s32)flip_win->attr.pre_syncpt_id >= 0) {
-		nvhost_syncpt_wait_timeout(&overlay->ndev->host->syncpt,
-					   flip_win->attr.pre_syncpt_id,
-					   flip_win->attr.pre_syncpt_val,
-					   msecs_to_jiffies(500));
+	return 0;
+}
+
+static void tegra_overlay_unpin_flip(struct tegra_overlay_info *overlay,
+				     struct tegra_overlay_flip_data *data)
+{
+	int i;
+
+	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
+		if (data->win[i].handle) {
+			nvmap_unpin(overlay->overlay_nvmap,
+				    data->win[i].handle);
+			nvmap_free(overlay->overlay_nvmap,
+				   data->win[i].handle);
+		}
 	}
+}
 
+/* True once every pre-fence of the flip has been reached. */
+static bool tegra_overlay_flip_ready(struct tegra_overlay_info *overlay,
+				     struct tegra_overlay_flip_data *data)
+{
+	struct nvhost_syncpt *sp = &overlay->ndev->host->syncpt;
+	int i;
 
-	return 0;
+	if (!overlay->dc->enabled || time_after_eq(jiffies, data->deadline))
+		return true;
+
+	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
+		const struct tegra_overlay_windowattr *attr = &data->win[i].attr;
+
+		if (attr->index == -1 ||
+		    attr->pre_syncpt_id >= NV_HOST1X_SYNCPT_NB_PTS)
+			continue;
+
+		if (nvhost_syncpt_min_cmp(sp, attr->pre_syncpt_id,
+					  attr->pre_syncpt_val))
+			continue;
+
+		nvhost_syncpt_read(sp, attr->pre_syncpt_id);
+		if (!nvhost_syncpt_min_cmp(sp, attr->pre_syncpt_id,
+					   attr->pre_syncpt_val))
+			return false;
+	}
+
+	return true;
 }
 
-static void tegra_overlay_flip_worker(struct work_struct *work)
+/* True if @next updates every window that @data updates. */
+static bool tegra_overlay_flip_supersedes(struct tegra_overlay_flip_data *next,
+					  struct tegra_overlay_flip_data *data)
+{
+	int i, j;
+
+	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
+		int idx = data->win[i].attr.index;
+
+		if (idx == -1)
+			continue;
+
+		for (j = 0; j < TEGRA_FB_FLIP_N_WINDOWS; j++)
+			if (next->win[j].attr.index == idx)
+				break;
+
+		if (j == TEGRA_FB_FLIP_N_WINDOWS)
+			return false;
+	}
+
+	return true;
+}
+
+/* Hands CSC changes of a flip that is never shown on to @next. */
+static void tegra_overlay_carry_csc(struct tegra_overlay_flip_data *next,
+				    struct tegra_overlay_flip_data *data)
+{
+	int i, j;
+
+	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
+		if (!data->win[i].csc_valid)
+			continue;
+
+		for (j = 0; j < TEGRA_FB_FLIP_N_WINDOWS; j++) {
+			struct tegra_overlay_flip_win *flip_win = &next->win[j];
+
+			if (flip_win->attr.index != data->win[i].attr.index)
+				continue;
+			if (!flip_win->csc_valid) {
+				flip_win->csc = data->win[i].csc;
+				flip_win->csc_valid = true;
+			}
+			break;
+		}
+	}
+}
+
+/* Grows @damage to cover the area @win shows on screen. */
+static void tegra_overlay_add_damage(struct tegra_dc_rect *damage,
+				     const struct tegra_dc_win *win)
+{
+	unsigned x2, y2;
+
+	if (!(win->flags & TEGRA_WIN_FLAG_ENABLED) || !win->out_w ||
+	    !win->out_h)
+		return;
+
+	if (!damage->w || !damage->h) {
+		damage->x = win->out_x;
+		damage->y = win->out_y;
+		damage->w = win->out_w;
+		damage->h = win->out_h;
+		return;
+	}
+
+	x2 = max(damage->x + damage->w, win->out_x + win->out_w);
+	y2 = max(damage->y + damage->h, win->out_y + win->out_h);
+	damage->x = min(damage->x, win->out_x);
+	damage->y = min(damage->y, win->out_y);
+	damage->w = x2 - damage->x;
+	damage->h = y2 - damage->y;
+}
+
+static void tegra_overlay_present_flip(struct tegra_overlay_info *overlay,
+				       struct tegra_overlay_flip_data *data)
 {
-	struct tegra_overlay_flip_data *data =
-		container_of(work, struct tegra_overlay_flip_data, work);
-	struct tegra_overlay_info *overlay = data->overlay;
 	struct tegra_dc_win *win;
 	struct tegra_dc_win *wins[TEGRA_FB_FLIP_N_WINDOWS];
 	struct nvmap_handle_ref *unpin_handles[TEGRA_FB_FLIP_N_WINDOWS];
+	struct tegra_dc_rect damage = { 0 };
 	int i, nr_win = 0, nr_unpin = 0;
 
-	data = container_of(work, struct tegra_overlay_flip_data, work);
-
 	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
 		struct tegra_overlay_flip_win *flip_win = &data->win[i];
 		int idx = flip_win->attr.index;
@@ -212,28 +349,26 @@ static void tegra_overlay_flip_worker(struct work_struct *work)
 		if (win->flags && win->cur_handle)
 			unpin_handles[nr_unpin++] = win->cur_handle;
 
+		/* only what the overlay covered before and after changes */
+		tegra_overlay_add_damage(&damage, win);
 		tegra_overlay_set_windowattr(overlay, win, &data->win[i]);
+		tegra_overlay_add_damage(&damage, win);
 
 		wins[nr_win++] = win;
-
-#if 0
-		if (flip_win->attr.pre_syncpt_id < 0)
-			continue;
-		printk("%08x %08x\n",
-		       flip_win->attr.pre_syncpt_id,
-		       flip_win->attr.pre_syncpt_val);
-
-		nvhost_syncpt_wait_timeout(&overlay->ndev->host->syncpt,
-					   flip_win->attr.pre_syncpt_id,
-					   flip_win->attr.pre_syncpt_val,
-					   msecs_to_jiffies(500));
-#endif
 	}
 
-	tegra_dc_update_windows(wins, nr_win);
+	tegra_dc_update_windows_region(wins, nr_win,
+				       damage.h ? &damage : NULL);
+	tegra_ftl_flip_programmed(overlay->dc->ndev->id, data->syncpt_max);
 	/* TODO: implement swapinterval here */
 	tegra_dc_sync_windows(wins, nr_win);
 
+	mutex_lock(&overlay->flip_lock);
+	overlay->present_val = data->syncpt_max;
+	overlay->present_ts = overlay->dc->latch_ts;
+	mutex_unlock(&overlay->flip_lock);
+
+	/* this also releases the post fences of any flips dropped before it */
 	tegra_dc_incr_syncpt_min(overlay->dc, data->syncpt_max);
 
 	/* unpin and deref previous front buffers */
@@ -245,13 +380,75 @@ static void tegra_overlay_flip_worker(struct work_struct *work)
 	kfree(data);
 }
 
+/*
+ * Shows queued flips in order, each as soon as a vblank finds its fences
+ * signaled.  A flip that is ready at the same time as a newer flip covering
+ * the same windows is never shown; the newer one replaces it.
+ */
+static void tegra_overlay_flip_worker(struct work_struct *work)
+{
+	struct tegra_overlay_info *overlay =
+		container_of(work, struct tegra_overlay_info, flip_work);
+	struct tegra_overlay_flip_data *data, *next;
+	LIST_HEAD(dropped);
+
+	mutex_lock(&overlay->flip_lock);
+	while (!list_empty(&overlay->flip_queue)) {
+		data = list_first_entry(&overlay->flip_queue,
+					struct tegra_overlay_flip_data, list);
+
+		if (!tegra_overlay_flip_ready(overlay, data)) {
+			mutex_unlock(&overlay->flip_lock);
+			tegra_dc_wait_vblank(overlay->dc, msecs_to_jiffies(50));
+			mutex_lock(&overlay->flip_lock);
+			continue;
+		}
+
+		while (!list_is_last(&data->list, &overlay->flip_queue)) {
+			next = list_entry(data->list.next,
+					  struct tegra_overlay_flip_data, list);
+			if (!tegra_overlay_flip_supersedes(next, data) ||
+			    !tegra_overlay_flip_ready(overlay, next))
+				break;
+
+			tegra_overlay_carry_csc(next, data);
+			list_move_tail(&data->list, &dropped);
+			overlay->flip_queued--;
+			overlay->present_dropped++;
+			data = next;
+		}
+
+		list_del(&data->list);
+		overlay->flip_queued--;
+		mutex_unlock(&overlay->flip_lock);
+
+		wake_up(&overlay->flip_wait);
+
+		while (!list_empty(&dropped)) {
+			next = list_first_entry(&dropped,
+					struct tegra_overlay_flip_data, list);
+			list_del(&next->list);
+			tegra_overlay_unpin_flip(overlay, next);
+			kfree(next);
+		}
+
+		tegra_overlay_present_flip(overlay, data);
+
+		mutex_lock(&overlay->flip_lock);
+	}
+	mutex_unlock(&overlay->flip_lock);
+}
+
+/* called with overlays_lock held */
 static int tegra_overlay_flip(struct tegra_overlay_info *overlay,
 			      struct tegra_overlay_flip_args *args,
 			      struct nvmap_client *user_nvmap)
 {
 	struct tegra_overlay_flip_data *data;
 	struct tegra_overlay_flip_win *flip_win;
+	struct overlay *ov;
 	u32 syncpt_max;
+	u32 fence_id = TEGRA_FTL_NO_FENCE, fence_val = 0;
 	int i, err;
 
 	if (WARN_ON(!overlay->ndev))
@@ -264,7 +461,6 @@ static int tegra_overlay_flip(struct tegra_overlay_info *overlay,
 		return -ENOMEM;
 	}
 
-	INIT_WORK(&data->work, tegra_overlay_flip_worker);
 	data->overlay = overlay;
 
 	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
@@ -275,18 +471,39 @@ static int tegra_overlay_flip(struct tegra_overlay_info *overlay,
 		if (flip_win->attr.index == -1)
 			continue;
 
+		ov = &overlay->overlays[flip_win->attr.index];
+		if (ov->csc_pending) {
+			flip_win->csc = ov->csc;
+			flip_win->csc_valid = true;
+			ov->csc_pending = false;
+		}
+
 		err = tegra_overlay_pin_window(overlay, flip_win, user_nvmap);
 		if (err < 0) {
 			dev_err(&overlay->ndev->dev,
 				"error setting window attributes\n");
 			goto surf_err;
 		}
+
+		if (fence_id == TEGRA_FTL_NO_FENCE &&
+		    flip_win->attr.pre_syncpt_id < NV_HOST1X_SYNCPT_NB_PTS) {
+			fence_id = flip_win->attr.pre_syncpt_id;
+			fence_val = flip_win->attr.pre_syncpt_val;
+		}
 	}
 
 	syncpt_max = tegra_dc_incr_syncpt_max(overlay->dc);
 	data->syncpt_max = syncpt_max;
+	tegra_ftl_flip_queued(overlay->dc->ndev->id, syncpt_max,
+			      fence_id, fence_val);
+	data->deadline = jiffies + TEGRA_OVERLAY_FLIP_TIMEOUT;
 
-	queue_work(overlay->flip_wq, &data->work);
+	mutex_lock(&overlay->flip_lock);
+	list_add_tail(&data->list, &overlay->flip_queue);
+	overlay->flip_queued++;
+	mutex_unlock(&overlay->flip_lock);
+
+	queue_work(overlay->flip_wq, &overlay->flip_work);
 
 	args->post_syncpt_val = syncpt_max;
 	args->post_syncpt_id = tegra_dc_get_syncpt_id(overlay->dc);
@@ -305,33 +522,19 @@ surf_err:
 	kfree(data);
 	return err;
 }
-static void tegra_overlay_set_emc_freq(struct tegra_overlay_info *dev)
-{
-	unsigned long emc_freq = 0;
-	int i;
-
-	for (i = 0; i < dev->dc->n_windows; i++) {
-		if (dev->overlays[i].owner != NULL)
-			emc_freq += dev->dc->mode.pclk*(i==1?2:1)*2;
-	}
-	clk_set_rate(dev->dc->emc_clk, emc_freq);
-}
-
 /* Overlay functions */
 static bool tegra_overlay_get(struct overlay_client *client, int idx)
 {
 	struct tegra_overlay_info *dev = client->dev;
 	bool ret = false;
 
-	if (idx < 0 || idx > dev->dc->n_windows)
+	if (idx < 0 || idx >= dev->dc->n_windows)
 		return ret;
 
 	mutex_lock(&dev->overlays_lock);
 	if (dev->overlays[idx].owner == NULL) {
 		dev->overlays[idx].owner = client;
 		ret = true;
-		if (dev->dc->mode.pclk != 0)
-			tegra_overlay_set_emc_freq(dev);
 	}
 	mutex_unlock(&dev->overlays_lock);
 
@@ -343,7 +546,7 @@ static void tegra_overlay_put_locked(struct overlay_client *client, int idx)
 	struct tegra_overlay_flip_args flip_args;
 	struct tegra_overlay_info *dev = client->dev;
 
-	if (idx < 0 || idx > dev->dc->n_windows)
+	if (idx < 0 || idx >= dev->dc->n_windows)
 		return;
 
 	if (dev->overlays[idx].owner != client)
@@ -357,8 +560,6 @@ static void tegra_overlay_put_locked(struct overlay_client *client, int idx)
 	flip_args.win[2].index = -1;
 
 	tegra_overlay_flip(dev, &flip_args, NULL);
-	if (dev->dc->mode.pclk != 0)
-		tegra_overlay_set_emc_freq(dev);
 }
 
 static void tegra_overlay_put(struct overlay_client *client, int idx)
@@ -397,7 +598,7 @@ static int tegra_overlay_ioctl_close(struct overlay_client *client,
 	if (copy_from_user(&idx, arg, sizeof(idx)))
 		return -EFAULT;
 
-	if (idx < 0 || idx > client->dev->dc->n_windows)
+	if (idx < 0 || idx >= client->dev->dc->n_windows)
 		return -EINVAL;
 
 	mutex_lock(&client->dev->overlays_lock);
@@ -410,6 +611,32 @@ static int tegra_overlay_ioctl_close(struct overlay_client *client,
 	return err;
 }
 
+/* Checks a window against what the hardware window can scan out. */
+static int tegra_overlay_check_window(const struct tegra_overlay_windowattr *attr)
+{
+	const struct tegra_dc_win_caps *caps;
+
+	if (!attr->buff_id)
+		return 0;
+
+	caps = tegra_dc_get_window_caps(attr->index);
+	if (!caps)
+		return -EINVAL;
+
+	if (attr->pixformat >= 32 || !(caps->formats & BIT(attr->pixformat)))
+		return -EINVAL;
+
+	if (attr->w > caps->max_w || attr->h > caps->max_h ||
+	    attr->out_w > caps->max_w || attr->out_h > caps->max_h)
+		return -EINVAL;
+
+	if (attr->w >= attr->out_w * caps->max_downscale ||
+	    attr->h >= attr->out_h * caps->max_downscale)
+		return -EINVAL;
+
+	return 0;
+}
+
 static int tegra_overlay_ioctl_flip(struct overlay_client *client,
 				    void __user *arg)
 {
@@ -417,6 +644,8 @@ static int tegra_overlay_ioctl_flip(struct overlay_client *client,
 	int idx = 0;
 	bool found_one = false;
 	struct tegra_overlay_flip_args flip_args;
+	struct tegra_overlay_info *overlay = client->dev;
+	int err;
 
 	if (!client->dev->dc->enabled)
 		return -EPIPE;
@@ -431,7 +660,7 @@ static int tegra_overlay_ioctl_flip(struct overlay_client *client,
 			continue;
 		}
 
-		if (idx < 0 || idx > client->dev->dc->n_windows) {
+		if (idx < 0 || idx >= client->dev->dc->n_windows) {
 			dev_err(&client->dev->ndev->dev,
 				"Flipping an invalid overlay! %d\n", idx);
 			flip_args.win[i].index = -1;
@@ -447,13 +676,29 @@ static int tegra_overlay_ioctl_flip(struct overlay_client *client,
 			continue;
 		}
 
+		if (tegra_overlay_check_window(&flip_args.win[i])) {
+			dev_err(&client->dev->ndev->dev,
+				"Unsupported window attributes! %d\n", idx);
+			return -EINVAL;
+		}
+
 		found_one = true;
 	}
 
 	if (!found_one)
 		return -EFAULT;
 
-	tegra_overlay_flip(client->dev, &flip_args, client->user_nvmap);
+	/* keep at most flip_queue_depth flips ahead of the screen */
+	err = wait_event_interruptible(overlay->flip_wait,
+			overlay->flip_queued < tegra_dc_flip_queue_depth());
+	if (err)
+		return err;
+
+	mutex_lock(&overlay->overlays_lock);
+	err = tegra_overlay_flip(overlay, &flip_args, client->user_nvmap);
+	mutex_unlock(&overlay->overlays_lock);
+	if (err)
+		return err;
 
 	if (copy_to_user(arg, &flip_args, sizeof(flip_args)))
 		return -EFAULT;
@@ -461,6 +706,97 @@ static int tegra_overlay_ioctl_flip(struct overlay_client *client,
 	return 0;
 }
 
+static int tegra_overlay_ioctl_get_present(struct overlay_client *client,
+					   void __user *arg)
+{
+	struct tegra_overlay_info *overlay = client->dev;
+	struct tegra_overlay_present present;
+
+	mutex_lock(&overlay->flip_lock);
+	present.syncpt_val = overlay->present_val;
+	present.dropped = overlay->present_dropped;
+	present.timestamp_ns = ktime_to_ns(overlay->present_ts);
+	mutex_unlock(&overlay->flip_lock);
+
+	if (copy_to_user(arg, &present, sizeof(present)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int tegra_overlay_ioctl_set_csc(struct overlay_client *client,
+				       void __user *arg)
+{
+	struct tegra_overlay_info *overlay = client->dev;
+	struct tegra_overlay_csc args;
+	struct overlay *ov;
+	int err = 0;
+
+	if (copy_from_user(&args, arg, sizeof(args)))
+		return -EFAULT;
+
+	if (args.index < 0 || args.index >= overlay->dc->n_windows)
+		return -EINVAL;
+
+	if (!(tegra_dc_get_window_caps(args.index)->flags & TEGRA_WIN_CAP_CSC))
+		return -EINVAL;
+
+	mutex_lock(&overlay->overlays_lock);
+	ov = &overlay->overlays[args.index];
+	if (ov->owner == client) {
+		ov->csc.yof = args.yof;
+		ov->csc.kyrgb = args.kyrgb;
+		ov->csc.kur = args.kur;
+		ov->csc.kvr = args.kvr;
+		ov->csc.kug = args.kug;
+		ov->csc.kvg = args.kvg;
+		ov->csc.kub = args.kub;
+		ov->csc.kvb = args.kvb;
+		ov->csc_pending = true;
+	} else {
+		err = -EINVAL;
+	}
+	mutex_unlock(&overlay->overlays_lock);
+
+	return err;
+}
+
+static int tegra_overlay_ioctl_get_caps(struct overlay_client *client,
+					void __user *arg)
+{
+	struct tegra_overlay_caps caps;
+	int i;
+
+	memset(&caps, 0, sizeof(caps));
+	caps.n_windows = min(client->dev->dc->n_windows,
+			     TEGRA_FB_FLIP_N_WINDOWS);
+
+	for (i = 0; i < caps.n_windows; i++) {
+		const struct tegra_dc_win_caps *win_caps;
+		struct tegra_overlay_plane_caps *plane = &caps.plane[i];
+
+		win_caps = tegra_dc_get_window_caps(i);
+		plane->formats = win_caps->formats;
+		plane->blend = BIT(TEGRA_FB_WIN_BLEND_NONE) |
+			       BIT(TEGRA_FB_WIN_BLEND_PREMULT) |
+			       BIT(TEGRA_FB_WIN_BLEND_COVERAGE);
+		if (win_caps->flags & TEGRA_WIN_CAP_H_FILTER)
+			plane->flags |= TEGRA_OVERLAY_CAP_H_FILTER;
+		if (win_caps->flags & TEGRA_WIN_CAP_V_FILTER)
+			plane->flags |= TEGRA_OVERLAY_CAP_V_FILTER;
+		if (win_caps->flags & TEGRA_WIN_CAP_CSC)
+			plane->flags |= TEGRA_OVERLAY_CAP_CSC;
+		plane->max_w = win_caps->max_w;
+		plane->max_h = win_caps->max_h;
+		plane->max_downscale = win_caps->max_downscale;
+	}
+
+	if (copy_to_user(arg, &caps, sizeof(caps)))
+		return -EFAULT;
+
+	return 0;
+}
+
 static int tegra_overlay_ioctl_set_nvmap_fd(struct overlay_client *client,
 					    void __user *arg)
 {
@@ -576,6 +912,15 @@ static long tegra_overlay_ioctl(struct file *filp, unsigned int cmd,
 	case TEGRA_OVERLAY_IOCTL_SET_NVMAP_FD:
 		err = tegra_overlay_ioctl_set_nvmap_fd(client, uarg);
 		break;
+	case TEGRA_OVERLAY_IOCTL_GET_PRESENT:
+		err = tegra_overlay_ioctl_get_present(client, uarg);
+		break;
+	case TEGRA_OVERLAY_IOCTL_SET_CSC:
+		err = tegra_overlay_ioctl_set_csc(client, uarg);
+		break;
+	case TEGRA_OVERLAY_IOCTL_GET_CAPS:
+		err = tegra_overlay_ioctl_get_caps(client, uarg);
+		break;
 	default:
 		return -ENOTTY;
 	}
@@ -615,6 +960,11 @@ struct tegra_overlay_info *tegra_overlay_register(struct nvhost_device *ndev,
 
 	mutex_init(&dev->overlays_lock);
 
+	INIT_LIST_HEAD(&dev->flip_queue);
+	mutex_init(&dev->flip_lock);
+	init_waitqueue_head(&dev->flip_wait);
+	INIT_WORK(&dev->flip_work, tegra_overlay_flip_worker);
+
 	e = misc_register(&dev->dev);
 	if (e) {
 		dev_err(&ndev->dev, "unable to register miscdevice %s\n",
@@ -27,6 +27,9 @@
 #include <linux/slab.h>
 #include <linux/file.h>
 #include <linux/workqueue.h>
+#include <linux/delay.h>
+#include <linux/hardirq.h>
+#include <linux/wait.h>
 
 #include <asm/atomic.h>
 
@@ -34,6 +37,7 @@
 
 #include <mach/dc.h>
 #include <mach/fb.h>
+#include <mach/frame_timeline.h>
 #include <mach/nvhost.h>
 #include <mach/nvmap.h>
 
@@ -57,6 +61,21 @@ struct tegra_fb_info {
 	struct nvmap_client	*fb_nvmap;
 
 	struct workqueue_struct	*flip_wq;
+	struct work_struct	flip_work;
+
+	/* flips waiting for their fences, oldest first */
+	struct list_head	flip_queue;
+	int			flip_queued;
+	struct mutex		flip_lock;
+	wait_queue_head_t	flip_wait;
+
+	/* last flip that reached the screen, protected by flip_lock */
+	u32			present_val;
+	u32			present_dropped;
+	ktime_t			present_ts;
+
+	struct nvhost_channel	*g2_ch;		/* gr2d channel, NULL if none */
+	u32			g2_fence;	/* last submitted 2D syncpt */
 };
 
 struct tegra_fb_flip_win {
@@ -66,15 +85,207 @@ struct tegra_fb_flip_win {
 };
 
 struct tegra_fb_flip_data {
-	struct work_struct		work;
+	struct list_head		list;
 	struct tegra_fb_info		*fb;
 	struct tegra_fb_flip_win	win[TEGRA_FB_FLIP_N_WINDOWS];
 	u32				syncpt_max;
+	unsigned long			deadline;
 };
 
+/* how long a flip waits for its fences before it is shown anyway */
+#define TEGRA_FB_FLIP_TIMEOUT		msecs_to_jiffies(500)
+
 /* palette array used by the fbcon */
 static u32 pseudo_palette[16];
 
+/*
+ * 2D engine (G2) registers and fields used for console acceleration
+ */
+#define G2_TRIGGER			0x09
+#define G2_CMDSEL			0x0c
+#define G2_CONTROLSECOND		0x1e
+#define G2_CONTROLMAIN			0x1f
+#define  G2_CONTROLMAIN_SRCSLD		BIT(6)
+#define  G2_CONTROLMAIN_XDIR		BIT(9)
+#define  G2_CONTROLMAIN_YDIR		BIT(10)
+#define  G2_CONTROLMAIN_DSTCD(bpp)	(((bpp) >> 4) << 16)
+#define G2_ROPFADE			0x20
+#define  G2_ROP_SRCCOPY			0xcc
+#define  G2_ROP_SRCXOR			0x66
+#define G2_DSTBA			0x2b
+#define G2_DSTST			0x2e
+#define G2_SRCBA			0x31
+#define G2_SRCST			0x33
+#define G2_SRCFGC			0x35
+#define G2_DSTSIZE			0x38
+#define G2_SRCPS			0x39
+#define G2_DSTPS			0x3a
+
+#define TEGRA_FB_G2_SYNCPT		NVSYNCPT_2D_0
+#define TEGRA_FB_G2_MAX_WORDS		20
+
+/*
+ * Operations covering fewer pixels than this are done by the CPU while the
+ * 2D engine is powered down; waking it would cost more than the blit.
+ */
+#define TEGRA_FB_G2_MIN_PIXELS		(64 * 64)
+
+static struct nvhost_channel *tegra_fb_g2_get(struct nvhost_master *host)
+{
+	int i;
+
+	for (i = 0; i < NVHOST_NUMCHANNELS; i++) {
+		struct nvhost_channel *ch = &host->channels[i];
+
+		if (!strcmp(ch->desc->name, "gr2d"))
+			return nvhost_getchannel(ch);
+	}
+	return NULL;
+}
+
+static bool tegra_fb_g2_usable(struct fb_info *info, u32 w, u32 h)
+{
+	struct tegra_fb_info *tegra_fb = info->par;
+
+	if (!tegra_fb->g2_ch || tegra_fb->win->cur_handle)
+		return false;
+	if (info->var.bits_per_pixel != 16 && info->var.bits_per_pixel != 32)
+		return false;
+	/* nvhost submission sleeps */
+	if (oops_in_progress || in_atomic() || irqs_disabled())
+		return false;
+	if (w * h < TEGRA_FB_G2_MIN_PIXELS &&
+	    !nvhost_module_powered(&tegra_fb->g2_ch->mod))
+		return false;
+	return true;
+}
+
+/*
+ * tegra_fb_g2_sync - wait for queued 2D operations to land in the framebuffer
+ *
+ * Must be called before the CPU touches pixels the engine may still be
+ * writing. The engine is kept powered until our last submit completes, so
+ * from atomic context we can poll the syncpoint register directly.
+ */
+static void tegra_fb_g2_sync(struct tegra_fb_info *tegra_fb)
+{
+	struct nvhost_syncpt *sp;
+	int timeout = 100000;
+
+	if (!tegra_fb->g2_ch)
+		return;
+
+	sp = &tegra_fb->ndev->host->syncpt;
+	if (nvhost_syncpt_min_cmp(sp, TEGRA_FB_G2_SYNCPT, tegra_fb->g2_fence))
+		return;
+
+	/* the kick of the last submit may have been deferred */
+	nvhost_cdma_kick(&tegra_fb->g2_ch->cdma);
+
+	if (!in_atomic() && !irqs_disabled()) {
+		nvhost_syncpt_wait_timeout(sp, TEGRA_FB_G2_SYNCPT,
+					   tegra_fb->g2_fence,
+					   msecs_to_jiffies(500));
+		return;
+	}
+
+	while (timeout--) {
+		u32 val = nvhost_syncpt_update_min(sp, TEGRA_FB_G2_SYNCPT);
+
+		if ((s32)(val - tegra_fb->g2_fence) >= 0)
+			break;
+		udelay(1);
+	}
+}
+
+static void tegra_fb_g2_submit(struct tegra_fb_info *tegra_fb,
+			       u32 *words, int count)
+{
+	struct nvhost_channel *ch = tegra_fb->g2_ch;
+	struct nvhost_syncpt *sp = &ch->dev->syncpt;
+	u32 syncval;
+	int i;
+
+	words[count++] = nvhost_opcode_imm(0, 0x100 | TEGRA_FB_G2_SYNCPT);
+	if (count & 1)
+		words[count++] = NVHOST_OPCODE_NOOP;
+	BUG_ON(count > TEGRA_FB_G2_MAX_WORDS);
+
+	/* released by the submit complete interrupt */
+	nvhost_module_busy(&ch->mod);
+
+	mutex_lock(&ch->submitlock);
+	syncval = nvhost_syncpt_incr_max(sp, TEGRA_FB_G2_SYNCPT, 1);
+
+	nvhost_cdma_begin(&ch->cdma);
+	for (i = 0; i < count; i += 2)
+		nvhost_cdma_push(&ch->cdma, words[i], words[i + 1]);
+	nvhost_cdma_end(ch->dev->nvmap, &ch->cdma, TEGRA_FB_G2_SYNCPT,
+			syncval, NULL, 0);
+
+	nvhost_intr_add_action(&ch->dev->intr, TEGRA_FB_G2_SYNCPT, syncval,
+			       NVHOST_INTR_ACTION_SUBMIT_COMPLETE, ch, NULL);
+	tegra_fb->g2_fence = syncval;
+	mutex_unlock(&ch->submitlock);
+}
+
+/* common setup: class, trigger on DSTSIZE, destination surface */
+static int tegra_fb_g2_setup(struct fb_info *info, u32 *words,
+			     u32 controlmain, u32 rop)
+{
+	int n = 0;
+
+	words[n++] = nvhost_opcode_setclass(NV_GRAPHICS_2D_CLASS_ID, 0, 0);
+	words[n++] = nvhost_opcode_mask(G2_TRIGGER, BIT(0) | BIT(3));
+	words[n++] = G2_DSTSIZE;
+	words[n++] = 0;
+	words[n++] = nvhost_opcode_mask(G2_CONTROLSECOND, 0x7);
+	words[n++] = 0;
+	words[n++] = controlmain |
+		     G2_CONTROLMAIN_DSTCD(info->var.bits_per_pixel);
+	words[n++] = rop;
+	words[n++] = nvhost_opcode_mask(G2_DSTBA, BIT(0) | BIT(3));
+	words[n++] = info->fix.smem_start;
+	words[n++] = info->fix.line_length;
+	return n;
+}
+
+static void tegra_fb_fillrect(struct fb_info *info,
+			      const struct fb_fillrect *rect)
+{
+	struct tegra_fb_info *tegra_fb = info->par;
+	u32 words[TEGRA_FB_G2_MAX_WORDS];
+	u32 color;
+	int n;
+
+	if (!tegra_fb_g2_usable(info, rect->width, rect->height) ||
+	    !rect->width || !rect->height ||
+	    rect->dx + rect->width > info->var.xres_virtual ||
+	    rect->dy + rect->height > info->var.yres_virtual) {
+		tegra_fb_g2_sync(tegra_fb);
+		cfb_fillrect(info, rect);
+		return;
+	}
+
+	if (info->fix.visual == FB_VISUAL_TRUECOLOR ||
+	    info->fix.visual == FB_VISUAL_DIRECTCOLOR)
+		color = ((u32 *)info->pseudo_palette)[rect->color];
+	else
+		color = rect->color;
+
+	n = tegra_fb_g2_setup(info, words, G2_CONTROLMAIN_SRCSLD,
+			      rect->rop == ROP_XOR ?
+			      G2_ROP_SRCXOR : G2_ROP_SRCCOPY);
+	words[n++] = nvhost_opcode_nonincr(G2_SRCFGC, 1);
+	words[n++] = color;
+	words[n++] = nvhost_opcode_nonincr(G2_DSTPS, 1);
+	words[n++] = (rect->dy << 16) | rect->dx;
+	words[n++] = nvhost_opcode_nonincr(G2_DSTSIZE, 1);
+	words[n++] = (rect->height << 16) | rect->width;
+
+	tegra_fb_g2_submit(tegra_fb, words, n);
+}
+
 static int tegra_fb_open(struct fb_info *info, int user)
 {
 	struct tegra_fb_info *tegra_fb = info->par;
@@ -290,6 +501,8 @@ static int tegra_fb_pan_display(struct fb_var_screeninfo *var,
 	u32 addr;
 
 	if (!tegra_fb->win->cur_handle) {
+		tegra_fb_g2_sync(tegra_fb);
+
 		flush_start = info->screen_base + (var->yoffset * info->fix.line_length);
 		flush_end = flush_start + (var->yres * info->fix.line_length);
 
@@ -309,24 +522,60 @@ static int tegra_fb_pan_display(struct fb_var_screeninfo *var,
 	return 0;
 }
 
-static void tegra_fb_fillrect(struct fb_info *info,
-			      const struct fb_fillrect *rect)
-{
-	cfb_fillrect(info, rect);
-}
-
 static void tegra_fb_copyarea(struct fb_info *info,
 			      const struct fb_copyarea *region)
 {
-	cfb_copyarea(info, region);
+	struct tegra_fb_info *tegra_fb = info->par;
+	u32 words[TEGRA_FB_G2_MAX_WORDS];
+	u32 controlmain = 0;
+	u32 sx = region->sx, sy = region->sy;
+	u32 dx = region->dx, dy = region->dy;
+	int n;
+
+	if (!tegra_fb_g2_usable(info, region->width, region->height) ||
+	    !region->width || !region->height ||
+	    max(sx, dx) + region->width > info->var.xres_virtual ||
+	    max(sy, dy) + region->height > info->var.yres_virtual) {
+		tegra_fb_g2_sync(tegra_fb);
+		cfb_copyarea(info, region);
+		return;
+	}
+
+	/* walk backwards from the far corner when the areas overlap that way */
+	if (dy > sy || (dy == sy && dx > sx)) {
+		controlmain |= G2_CONTROLMAIN_XDIR | G2_CONTROLMAIN_YDIR;
+		sx += region->width - 1;
+		dx += region->width - 1;
+		sy += region->height - 1;
+		dy += region->height - 1;
+	}
+
+	n = tegra_fb_g2_setup(info, words, controlmain, G2_ROP_SRCCOPY);
+	words[n++] = nvhost_opcode_mask(G2_SRCBA, BIT(0) | BIT(2));
+	words[n++] = info->fix.smem_start;
+	words[n++] = info->fix.line_length;
+	words[n++] = nvhost_opcode_incr(G2_SRCPS, 2);
+	words[n++] = (sy << 16) | sx;
+	words[n++] = (dy << 16) | dx;
+	words[n++] = nvhost_opcode_nonincr(G2_DSTSIZE, 1);
+	words[n++] = (region->height << 16) | region->width;
+
+	tegra_fb_g2_submit(tegra_fb, words, n);
 }
 
 static void tegra_fb_imageblit(struct fb_info *info,
 			       const struct fb_image *image)
 {
+	tegra_fb_g2_sync(info->par);
 	cfb_imageblit(info, image);
 }
 
+static int tegra_fb_sync(struct fb_info *info)
+{
+	tegra_fb_g2_sync(info->par);
+	return 0;
+}
+
 /* TODO: implement ALLOC, FREE, BLANK ioctls */
 
 static int tegra_fb_set_nvmap_fd(struct tegra_fb_info *tegra_fb, int fd)
@@ -436,29 +685,86 @@ static int tegra_fb_set_windowattr(struct tegra_fb_info *tegra_fb,
 	win->stride = flip_win->attr.stride;
 	win->stride_uv = flip_win->attr.stride_uv;
 
-	if ((s32)flip_win->attr.pre_syncpt_id >= 0) {
-		nvhost_syncpt_wait_timeout(&tegra_fb->ndev->host->syncpt,
-					   flip_win->attr.pre_syncpt_id,
-					   flip_win->attr.pre_syncpt_val,
-					   msecs_to_jiffies(500));
+	return 0;
+}
+
+static void tegra_fb_unpin_flip(struct tegra_fb_info *tegra_fb,
+				struct tegra_fb_flip_data *data)
+{
+	int i;
+
+	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
+		if (data->win[i].handle) {
+			nvmap_unpin(tegra_fb->fb_nvmap, data->win[i].handle);
+			nvmap_free(tegra_fb->fb_nvmap, data->win[i].handle);
+		}
 	}
+}
+
+/* True once every pre-fence of the flip has been reached. */
+static bool tegra_fb_flip_ready(struct tegra_fb_info *tegra_fb,
+				struct tegra_fb_flip_data *data)
+{
+	struct nvhost_syncpt *sp = &tegra_fb->ndev->host->syncpt;
+	struct tegra_dc *dc = tegra_fb->win->dc;
+	int i;
 
+	if (!dc->enabled || time_after_eq(jiffies, data->deadline))
+		return true;
 
-	return 0;
+	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
+		const struct tegra_fb_windowattr *attr = &data->win[i].attr;
+
+		if (!tegra_dc_get_window(dc, attr->index) ||
+		    attr->pre_syncpt_id >= NV_HOST1X_SYNCPT_NB_PTS)
+			continue;
+
+		if (nvhost_syncpt_min_cmp(sp, attr->pre_syncpt_id,
+					  attr->pre_syncpt_val))
+			continue;
+
+		nvhost_syncpt_read(sp, attr->pre_syncpt_id);
+		if (!nvhost_syncpt_min_cmp(sp, attr->pre_syncpt_id,
+					   attr->pre_syncpt_val))
+			return false;
+	}
+
+	return true;
 }
 
-static void tegra_fb_flip_worker(struct work_struct *work)
+/* True if @next updates every window that @data updates. */
+static bool tegra_fb_flip_supersedes(struct tegra_fb_info *tegra_fb,
+				     struct tegra_fb_flip_data *next,
+				     struct tegra_fb_flip_data *data)
+{
+	struct tegra_dc *dc = tegra_fb->win->dc;
+	int i, j;
+
+	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
+		int idx = data->win[i].attr.index;
+
+		if (!tegra_dc_get_window(dc, idx))
+			continue;
+
+		for (j = 0; j < TEGRA_FB_FLIP_N_WINDOWS; j++)
+			if (next->win[j].attr.index == idx)
+				break;
+
+		if (j == TEGRA_FB_FLIP_N_WINDOWS)
+			return false;
+	}
+
+	return true;
+}
+
+static void tegra_fb_present_flip(struct tegra_fb_info *tegra_fb,
+				  struct tegra_fb_flip_data *data)
 {
-	struct tegra_fb_flip_data *data =
-		container_of(work, struct tegra_fb_flip_data, work);
-	struct tegra_fb_info *tegra_fb = data->fb;
 	struct tegra_dc_win *win;
 	struct tegra_dc_win *wins[TEGRA_FB_FLIP_N_WINDOWS];
 	struct nvmap_handle_ref *unpin_handles[TEGRA_FB_FLIP_N_WINDOWS];
 	int i, nr_win = 0, nr_unpin = 0;
 
-	data = container_of(work, struct tegra_fb_flip_data, work);
-
 	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
 		struct tegra_fb_flip_win *flip_win = &data->win[i];
 		int idx = flip_win->attr.index;
@@ -473,25 +779,20 @@ static void tegra_fb_flip_worker(struct work_struct *work)
 		tegra_fb_set_windowattr(tegra_fb, win, &data->win[i]);
 
 		wins[nr_win++] = win;
-
-#if 0
-		if (flip_win->attr.pre_syncpt_id < 0)
-			continue;
-		printk("%08x %08x\n",
-		       flip_win->attr.pre_syncpt_id,
-		       flip_win->attr.pre_syncpt_val);
-
-		nvhost_syncpt_wait_timeout(&tegra_fb->ndev->host->syncpt,
-					   flip_win->attr.pre_syncpt_id,
-					   flip_win->attr.pre_syncpt_val,
-					   msecs_to_jiffies(500));
-#endif
 	}
 
 	tegra_dc_update_windows(wins, nr_win);
+	tegra_ftl_flip_programmed(tegra_fb->win->dc->ndev->id,
+				  data->syncpt_max);
 	/* TODO: implement swapinterval here */
 	tegra_dc_sync_windows(wins, nr_win);
 
+	mutex_lock(&tegra_fb->flip_lock);
+	tegra_fb->present_val = data->syncpt_max;
+	tegra_fb->present_ts = tegra_fb->win->dc->latch_ts;
+	mutex_unlock(&tegra_fb->flip_lock);
+
+	/* this also releases the post fences of any flips dropped before it */
 	tegra_dc_incr_syncpt_min(tegra_fb->win->dc, data->syncpt_max);
 
 	/* unpin and deref previous front buffers */
@@ -503,6 +804,65 @@ static void tegra_fb_flip_worker(struct work_struct *work)
 	kfree(data);
 }
 
+/*
+ * Shows queued flips in order, each as soon as a vblank finds its fences
+ * signaled.  A flip that is ready at the same time as a newer flip covering
+ * the same windows is never shown; the newer one replaces it.
+ */
+static void tegra_fb_flip_worker(struct work_struct *work)
+{
+	struct tegra_fb_info *tegra_fb =
+		container_of(work, struct tegra_fb_info, flip_work);
+	struct tegra_fb_flip_data *data, *next;
+	LIST_HEAD(dropped);
+
+	mutex_lock(&tegra_fb->flip_lock);
+	while (!list_empty(&tegra_fb->flip_queue)) {
+		data = list_first_entry(&tegra_fb->flip_queue,
+					struct tegra_fb_flip_data, list);
+
+		if (!tegra_fb_flip_ready(tegra_fb, data)) {
+			mutex_unlock(&tegra_fb->flip_lock);
+			tegra_dc_wait_vblank(tegra_fb->win->dc,
+					     msecs_to_jiffies(50));
+			mutex_lock(&tegra_fb->flip_lock);
+			continue;
+		}
+
+		while (!list_is_last(&data->list, &tegra_fb->flip_queue)) {
+			next = list_entry(data->list.next,
+					  struct tegra_fb_flip_data, list);
+			if (!tegra_fb_flip_supersedes(tegra_fb, next, data) ||
+			    !tegra_fb_flip_ready(tegra_fb, next))
+				break;
+
+			list_move_tail(&data->list, &dropped);
+			tegra_fb->flip_queued--;
+			tegra_fb->present_dropped++;
+			data = next;
+		}
+
+		list_del(&data->list);
+		tegra_fb->flip_queued--;
+		mutex_unlock(&tegra_fb->flip_lock);
+
+		wake_up(&tegra_fb->flip_wait);
+
+		while (!list_empty(&dropped)) {
+			next = list_first_entry(&dropped,
+					struct tegra_fb_flip_data, list);
+			list_del(&next->list);
+			tegra_fb_unpin_flip(tegra_fb, next);
+			kfree(next);
+		}
+
+		tegra_fb_present_flip(tegra_fb, data);
+
+		mutex_lock(&tegra_fb->flip_lock);
+	}
+	mutex_unlock(&tegra_fb->flip_lock);
+}
+
 static int tegra_fb_flip(struct tegra_fb_info *tegra_fb,
 			 struct tegra_fb_flip_args *args)
 {
@@ -524,7 +884,6 @@ static int tegra_fb_flip(struct tegra_fb_info *tegra_fb,
 		return -ENOMEM;
 	}
 
-	INIT_WORK(&data->work, tegra_fb_flip_worker);
 	data->fb = tegra_fb;
 
 	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
@@ -542,8 +901,27 @@ static int tegra_fb_flip(struct tegra_fb_info *tegra_fb,
 
 	syncpt_max = tegra_dc_incr_syncpt_max(tegra_fb->win->dc);
 	data->syncpt_max = syncpt_max;
+	data->deadline = jiffies + TEGRA_FB_FLIP_TIMEOUT;
+
+	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
+		if (tegra_dc_get_window(tegra_fb->win->dc,
+					data->win[i].attr.index) &&
+		    data->win[i].attr.pre_syncpt_id < NV_HOST1X_SYNCPT_NB_PTS)
+			break;
+	}
+	tegra_ftl_flip_queued(tegra_fb->win->dc->ndev->id, syncpt_max,
+			      i < TEGRA_FB_FLIP_N_WINDOWS ?
+			      data->win[i].attr.pre_syncpt_id :
+			      TEGRA_FTL_NO_FENCE,
+			      i < TEGRA_FB_FLIP_N_WINDOWS ?
+			      data->win[i].attr.pre_syncpt_val : 0);
+
+	mutex_lock(&tegra_fb->flip_lock);
+	list_add_tail(&data->list, &tegra_fb->flip_queue);
+	tegra_fb->flip_queued++;
+	mutex_unlock(&tegra_fb->flip_lock);
 
-	queue_work(tegra_fb->flip_wq, &data->work);
+	queue_work(tegra_fb->flip_wq, &tegra_fb->flip_work);
 
 	args->post_syncpt_val = syncpt_max;
 	args->post_syncpt_id = tegra_dc_get_syncpt_id(tegra_fb->win->dc);
@@ -569,6 +947,7 @@ static int tegra_fb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long
 {
 	struct tegra_fb_info *tegra_fb = info->par;
 	struct tegra_fb_flip_args flip_args;
+	struct tegra_fb_present present;
 	struct tegra_fb_modedb modedb;
 	struct fb_modelist *modelist;
 	int i;
@@ -586,6 +965,12 @@ static int tegra_fb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long
 		if (copy_from_user(&flip_args, (void __user *)arg, sizeof(flip_args)))
 			return -EFAULT;
 
+		/* keep at most flip_queue_depth flips ahead of the screen */
+		ret = wait_event_interruptible(tegra_fb->flip_wait,
+			tegra_fb->flip_queued < tegra_dc_flip_queue_depth());
+		if (ret)
+			return ret;
+
 		ret = tegra_fb_flip(tegra_fb, &flip_args);
 
 		if (copy_to_user((void __user *)arg, &flip_args, sizeof(flip_args)))
@@ -632,6 +1017,17 @@ static int tegra_fb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long
 			return -EFAULT;
 		break;
 
+	case FBIO_TEGRA_GET_PRESENT:
+		mutex_lock(&tegra_fb->flip_lock);
+		present.syncpt_val = tegra_fb->present_val;
+		present.dropped = tegra_fb->present_dropped;
+		present.timestamp_ns = ktime_to_ns(tegra_fb->present_ts);
+		mutex_unlock(&tegra_fb->flip_lock);
+
+		if (copy_to_user((void __user *)arg, &present, sizeof(present)))
+			return -EFAULT;
+		break;
+
 	default:
 		return -ENOTTY;
 	}
@@ -651,6 +1047,7 @@ static struct fb_ops tegra_fb_ops = {
 	.fb_fillrect = tegra_fb_fillrect,
 	.fb_copyarea = tegra_fb_copyarea,
 	.fb_imageblit = tegra_fb_imageblit,
+	.fb_sync = tegra_fb_sync,
 	.fb_ioctl = tegra_fb_ioctl,
 };
 
@@ -756,6 +1153,11 @@ struct tegra_fb_info *tegra_fb_register(struct nvhost_device *ndev,
 	}
 	atomic_set(&tegra_fb->in_use, 0);
 
+	INIT_LIST_HEAD(&tegra_fb->flip_queue);
+	mutex_init(&tegra_fb->flip_lock);
+	init_waitqueue_head(&tegra_fb->flip_wait);
+	INIT_WORK(&tegra_fb->flip_work, tegra_fb_flip_worker);
+
 	tegra_fb->flip_wq = create_singlethread_workqueue(dev_name(&ndev->dev));
 	if (!tegra_fb->flip_wq) {
 		dev_err(&ndev->dev, "couldn't create flip work-queue\n");
@@ -773,12 +1175,23 @@ struct tegra_fb_info *tegra_fb_register(struct nvhost_device *ndev,
 			goto err_put_client;
 		}
 		tegra_fb->valid = true;
+
+		tegra_fb->g2_ch = tegra_fb_g2_get(ndev->host);
+		if (tegra_fb->g2_ch)
+			tegra_fb->g2_fence = nvhost_syncpt_read_max(
+				&ndev->host->syncpt, TEGRA_FB_G2_SYNCPT);
+		else
+			dev_warn(&ndev->dev, "no 2D channel, not accelerated\n");
 	}
 
 	info->fbops = &tegra_fb_ops;
 	info->pseudo_palette = pseudo_palette;
 	info->screen_base = fb_base;
 	info->screen_size = fb_size;
+	info->flags = FBINFO_DEFAULT;
+	if (tegra_fb->g2_ch)
+		info->flags |= FBINFO_HWACCEL_COPYAREA |
+			       FBINFO_HWACCEL_FILLRECT;
 
 	strlcpy(info->fix.id, "tegra_fb", sizeof(info->fix.id));
 	info->fix.type		= FB_TYPE_PACKED_PIXELS;
@@ -845,6 +1258,8 @@ struct tegra_fb_info *tegra_fb_register(struct nvhost_device *ndev,
 	return tegra_fb;
 
 err_iounmap_fb:
+	if (tegra_fb->g2_ch)
+		nvhost_putchannel(tegra_fb->g2_ch, NULL);
 	iounmap(fb_base);
 err_put_client:
 	nvmap_client_put(tegra_fb->fb_nvmap);
@@ -870,6 +1285,11 @@ void tegra_fb_unregister(struct tegra_fb_info *fb_info)
 
 	unregister_framebuffer(info);
 
+	if (fb_info->g2_ch) {
+		tegra_fb_g2_sync(fb_info);
+		nvhost_putchannel(fb_info->g2_ch, NULL);
+	}
+
 	flush_workqueue(fb_info->flip_wq);
 	destroy_workqueue(fb_info->flip_wq);
 
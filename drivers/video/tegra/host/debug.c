@@ -197,6 +197,10 @@ static int nvhost_debug_show(struct seq_file *s, void *unused)
 
 		seq_printf(s, "%d-%s (%d): ", i, m->channels[i].mod.name,
 			   atomic_read(&m->channels[i].mod.refcount));
+		seq_printf(s, "jobs %lu kicks %lu pb waits %lu, ",
+			   m->channels[i].cdma.stats.jobs,
+			   m->channels[i].cdma.stats.kicks,
+			   m->channels[i].cdma.stats.pb_waits);
 
 		if (dmactrl != 0x0 || !m->channels[i].cdma.push_buffer.mapped) {
 			seq_printf(s, "inactive\n\n");
@@ -294,6 +298,45 @@ static int nvhost_debug_show(struct seq_file *s, void *unused)
 
 #ifdef CONFIG_DEBUG_FS
 
+static void nvhost_debug_show_power(struct seq_file *s,
+				    struct nvhost_module *mod)
+{
+	struct nvhost_module_stats st;
+
+	nvhost_module_get_stats(mod, &st);
+	seq_printf(s, "%-8s %s busy %llu us, idle %llu us, off %llu us\n",
+		   mod->name, mod->powered ? "on " : "off",
+		   st.busy_us, st.idle_us, st.off_us);
+	seq_printf(s, "         %lu powerups, wake latency %u us (max %u), "
+		   "gap %u us, rebusied %u%%, delay %u ms\n",
+		   st.powerups, st.wake_latency_us, st.wake_latency_max_us,
+		   st.avg_gap_us, st.rebusy_pct, st.delay_ms);
+}
+
+static int nvhost_debug_power_show(struct seq_file *s, void *unused)
+{
+	struct nvhost_master *m = s->private;
+	int i;
+
+	nvhost_debug_show_power(s, &m->mod);
+	for (i = 0; i < NVHOST_NUMCHANNELS; i++)
+		if (m->channels[i].mod.name)
+			nvhost_debug_show_power(s, &m->channels[i].mod);
+	return 0;
+}
+
+static int nvhost_debug_power_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvhost_debug_power_show, inode->i_private);
+}
+
+static const struct file_operations nvhost_debug_power_fops = {
+	.open		= nvhost_debug_power_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int nvhost_debug_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, nvhost_debug_show, inode->i_private);
@@ -310,6 +353,8 @@ void nvhost_debug_init(struct nvhost_master *master)
 {
 	debug_master = master;
 	debugfs_create_file("tegra_host", S_IRUGO, NULL, master, &nvhost_debug_fops);
+	debugfs_create_file("tegra_host_power", S_IRUGO, NULL, master,
+			    &nvhost_debug_power_fops);
 }
 #else
 void nvhost_debug_init(struct nvhost_master *master)
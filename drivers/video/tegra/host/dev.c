@@ -21,6 +21,7 @@
  */
 
 #include "dev.h"
+#include "nvhost_fence.h"
 
 #include <linux/slab.h>
 #include <linux/string.h>
@@ -37,6 +38,9 @@
 #include <mach/nvhost.h>
 #include <mach/nvmap.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/nvhost.h>
+
 #define DRIVER_NAME "tegra_grhost"
 #define IFACE_NAME "nvhost"
 
@@ -316,6 +320,106 @@ static int nvhost_ioctl_channel_flush(struct nvhost_channel_userctx *ctx,
 	return 0;
 }
 
+#define NVHOST_SUBMIT_CHUNK	16
+
+/* replaces waits on already expired thresholds with a no-op wait */
+static int nvhost_patch_waitchks(struct nvhost_channel_userctx *ctx,
+				 struct nvhost_waitchk __user *uwait, u32 num)
+{
+	struct nvhost_syncpt *sp = &ctx->ch->dev->syncpt;
+	struct nvhost_waitchk wait[NVHOST_SUBMIT_CHUNK];
+	u32 updated = 0;
+	int i, n, err;
+
+	while (num) {
+		n = min_t(u32, num, NVHOST_SUBMIT_CHUNK);
+		if (copy_from_user(wait, uwait, n * sizeof(wait[0])))
+			return -EFAULT;
+
+		for (i = 0; i < n; i++) {
+			u32 id = wait[i].syncpt_id;
+
+			if (id >= NV_HOST1X_SYNCPT_NB_PTS)
+				return -EINVAL;
+
+			if (!(updated & BIT(id))) {
+				nvhost_syncpt_update_min(sp, id);
+				updated |= BIT(id);
+			}
+
+			if (!nvhost_syncpt_min_cmp(sp, id, wait[i].thresh))
+				continue;
+
+			err = nvmap_patch_word(ctx->nvmap, wait[i].mem,
+				wait[i].offset,
+				nvhost_class_host_wait_syncpt(
+					NVSYNCPT_GRAPHICS_HOST, 0));
+			if (err)
+				return err;
+		}
+		num -= n;
+		uwait += n;
+	}
+
+	return 0;
+}
+
+static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
+				       struct nvhost_submit_args *args)
+{
+	struct nvhost_cmdbuf __user *ucmd = args->cmdbufs;
+	struct nvhost_cmdbuf cmdbuf[NVHOST_SUBMIT_CHUNK];
+	struct nvhost_get_param_args fence;
+	u32 num = args->num_cmdbufs;
+	int i, n, err;
+
+	if (ctx->relocs_pending || ctx->cmdbufs_pending) {
+		reset_submit(ctx);
+		dev_err(&ctx->ch->dev->pdev->dev, "channel submit out of sync\n");
+		return -EFAULT;
+	}
+	if (!ctx->nvmap) {
+		dev_err(&ctx->ch->dev->pdev->dev, "no nvmap context set\n");
+		return -EFAULT;
+	}
+	if (!num || num > NVHOST_MAX_GATHERS - 2 ||
+	    args->num_relocs > NVHOST_MAX_HANDLES - num ||
+	    args->syncpt_id >= NV_HOST1X_SYNCPT_NB_PTS)
+		return -EINVAL;
+
+	/* leave room for ctx switch */
+	ctx->num_gathers = 2;
+	ctx->pinarray_size = 0;
+
+	while (num) {
+		n = min_t(u32, num, NVHOST_SUBMIT_CHUNK);
+		if (copy_from_user(cmdbuf, ucmd, n * sizeof(cmdbuf[0])))
+			return -EFAULT;
+		for (i = 0; i < n; i++)
+			add_gather(ctx, ctx->num_gathers++, cmdbuf[i].mem,
+				   cmdbuf[i].words, cmdbuf[i].offset);
+		num -= n;
+		ucmd += n;
+	}
+
+	if (copy_from_user(&ctx->pinarray[ctx->pinarray_size], args->relocs,
+			   args->num_relocs * sizeof(struct nvhost_reloc)))
+		return -EFAULT;
+	ctx->pinarray_size += args->num_relocs;
+
+	err = nvhost_patch_waitchks(ctx, args->waitchks, args->num_waitchks);
+	if (err)
+		return err;
+
+	ctx->syncpt_id = args->syncpt_id;
+	ctx->syncpt_incrs = args->syncpt_incrs;
+
+	err = nvhost_ioctl_channel_flush(ctx, &fence, args->null_kickoff);
+	if (!err)
+		args->fence = fence.value;
+	return err;
+}
+
 static long nvhost_channelctl(struct file *filp,
 	unsigned int cmd, unsigned long arg)
 {
@@ -342,6 +446,9 @@ static long nvhost_channelctl(struct file *filp,
 	case NVHOST_IOCTL_CHANNEL_NULL_KICKOFF:
 		err = nvhost_ioctl_channel_flush(priv, (void *)buf, 1);
 		break;
+	case NVHOST_IOCTL_CHANNEL_SUBMIT:
+		err = nvhost_ioctl_channel_submit(priv, (void *)buf);
+		break;
 	case NVHOST_IOCTL_CHANNEL_GET_SYNCPOINTS:
 		((struct nvhost_get_param_args *)buf)->value =
 			priv->ch->desc->syncpts;
@@ -522,6 +629,30 @@ static int nvhost_ioctl_ctrl_module_regrdwr(
 	return 0;
 }
 
+static int nvhost_ioctl_ctrl_fence_create(
+	struct nvhost_ctrl_userctx *ctx,
+	struct nvhost_ctrl_fence_create_args *args)
+{
+	int fd = nvhost_fence_create_fd(ctx->dev, args->id, args->thresh);
+
+	if (fd < 0)
+		return fd;
+	args->fd = fd;
+	return 0;
+}
+
+static int nvhost_ioctl_ctrl_fence_merge(
+	struct nvhost_ctrl_userctx *ctx,
+	struct nvhost_ctrl_fence_merge_args *args)
+{
+	int fd = nvhost_fence_merge_fd(ctx->dev, args->fd1, args->fd2);
+
+	if (fd < 0)
+		return fd;
+	args->fd = fd;
+	return 0;
+}
+
 static long nvhost_ctrlctl(struct file *filp,
 	unsigned int cmd, unsigned long arg)
 {
@@ -557,6 +688,12 @@ static long nvhost_ctrlctl(struct file *filp,
 	case NVHOST_IOCTL_CTRL_MODULE_REGRDWR:
 		err = nvhost_ioctl_ctrl_module_regrdwr(priv, (void *)buf);
 		break;
+	case NVHOST_IOCTL_CTRL_FENCE_CREATE:
+		err = nvhost_ioctl_ctrl_fence_create(priv, (void *)buf);
+		break;
+	case NVHOST_IOCTL_CTRL_FENCE_MERGE:
+		err = nvhost_ioctl_ctrl_fence_merge(priv, (void *)buf);
+		break;
 	default:
 		err = -ENOTTY;
 		break;
@@ -746,7 +883,10 @@ static int __exit nvhost_remove(struct platform_device *pdev)
 static int nvhost_suspend(struct platform_device *pdev, pm_message_t state)
 {
 	struct nvhost_master *host = platform_get_drvdata(pdev);
+	int i;
 	dev_info(&pdev->dev, "suspending\n");
+	for (i = 0; i < NVHOST_NUMCHANNELS; i++)
+		nvhost_channel_save_context(&host->channels[i]);
 	nvhost_module_suspend(&host->mod, true);
 	clk_enable(host->mod.clk[0]);
 	nvhost_syncpt_save(&host->syncpt);
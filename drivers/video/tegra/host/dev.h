@@ -47,6 +47,9 @@ struct nvhost_master {
 	struct nvhost_channel channels[NVHOST_NUMCHANNELS];
 };
 
+/* the host1x instance, NULL until it has probed */
+extern struct nvhost_master *nvhost;
+
 void nvhost_debug_init(struct nvhost_master *master);
 void nvhost_debug_dump(void);
 
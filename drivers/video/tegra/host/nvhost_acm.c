@@ -32,20 +32,108 @@
 
 #define ACM_TIMEOUT 1*HZ
 
+/*
+ * The powerdown delay adapts to how the module is used. Every time the
+ * module is re-busied, the idle gap is compared with the restore window,
+ * the idle time below which powering down costs more than it saves: the
+ * module's measured power up latency (and the context restore which follows
+ * for 3D) times ACM_WINDOW_FACTOR, and at least ACM_WINDOW_MIN_US. If most
+ * gaps are that short, the module stays powered across about twice the
+ * typical gap (up to ACM_TIMEOUT); if not, it powers down after
+ * ACM_DELAY_MIN_US.
+ */
+#define ACM_WINDOW_MIN_US	20000
+#define ACM_WINDOW_FACTOR	16
+#define ACM_DELAY_MIN_US	5000
+#define ACM_TIMEOUT_US		(jiffies_to_usecs(ACM_TIMEOUT))
+#define ACM_REBUSY_ONE		256
+
 #define DISABLE_3D_POWERGATING
 #define DISABLE_MPE_POWERGATING
 
+/* the host1x module; every channel module keeps it busy while powered */
+static struct nvhost_module *host_module;
+
+#ifdef CONFIG_TEGRA_GRHOST
+/*
+ * Returns true when no engine behind host1x is in use, for background work
+ * that would otherwise compete with the GPU for memory bandwidth.
+ */
+bool nvhost_is_idle(void)
+{
+	return !host_module || atomic_read(&host_module->refcount) == 0;
+}
+#endif
+
+/* smoothed average, giving the new sample an eighth of the weight */
+static inline u32 acm_ewma(u32 avg, u32 sample)
+{
+	return avg - (avg >> 3) + (sample >> 3);
+}
+
+static u32 acm_window_us(struct nvhost_module *mod)
+{
+	return max_t(u32, ACM_WINDOW_MIN_US,
+		     mod->wake_latency * ACM_WINDOW_FACTOR);
+}
+
+/* time since the last transition; restarts the clock. must hold lock */
+static u32 acm_period_us(struct nvhost_module *mod, ktime_t now)
+{
+	s64 us = ktime_to_us(ktime_sub(now, mod->state_start));
+
+	mod->state_start = now;
+	return us < 0 ? 0 : (u32)min_t(s64, us, UINT_MAX);
+}
+
+/* learn from an idle gap that just ended. must hold lock */
+static void acm_account_gap(struct nvhost_module *mod, u32 gap)
+{
+	bool within = gap < acm_window_us(mod);
+
+	mod->rebusy = acm_ewma(mod->rebusy, within ? ACM_REBUSY_ONE : 0);
+	mod->avg_gap = acm_ewma(mod->avg_gap, min_t(u32, gap, ACM_TIMEOUT_US));
+}
+
+static unsigned long acm_powerdown_delay(struct nvhost_module *mod)
+{
+	u32 delay;
+
+	if (mod->rebusy >= ACM_REBUSY_ONE / 2)
+		delay = clamp_t(u32, mod->avg_gap * 2, acm_window_us(mod),
+				ACM_TIMEOUT_US);
+	else
+		delay = ACM_DELAY_MIN_US;
+
+	return usecs_to_jiffies(delay);
+}
+
 void nvhost_module_busy(struct nvhost_module *mod)
 {
+	bool first;
+
 	mutex_lock(&mod->lock);
 	cancel_delayed_work(&mod->powerdown);
-	if ((atomic_inc_return(&mod->refcount) == 1) && !mod->powered) {
+	first = atomic_inc_return(&mod->refcount) == 1;
+	if (first) {
+		ktime_t now = ktime_get();
+		s64 gap = ktime_to_us(ktime_sub(now, mod->idle_start));
+
+		if (mod->powered)
+			mod->stats.idle_us += acm_period_us(mod, now);
+		else
+			mod->stats.off_us += acm_period_us(mod, now);
+		acm_account_gap(mod, (u32)clamp_t(s64, gap, 0, UINT_MAX));
+	}
+	if (first && !mod->powered) {
+		ktime_t start = ktime_get();
+		u32 latency;
+
 		if (mod->parent)
 			nvhost_module_busy(mod->parent);
 		if (mod->powergate_id != -1) {
 			BUG_ON(mod->num_clks != 1);
-			tegra_powergate_sequence_power_up(
-				mod->powergate_id, mod->clk[0]);
+			tegra_powergate_get(mod->powergate_id, mod->clk[0]);
 		} else {
 			int i;
 			for (i = 0; i < mod->num_clks; i++)
@@ -54,6 +142,13 @@ void nvhost_module_busy(struct nvhost_module *mod)
 		if (mod->func)
 			mod->func(mod, NVHOST_POWER_ACTION_ON);
 		mod->powered = true;
+
+		latency = (u32)ktime_to_us(ktime_sub(ktime_get(), start));
+		mod->wake_latency = mod->stats.powerups ?
+			acm_ewma(mod->wake_latency, latency) : latency;
+		mod->stats.wake_latency_max_us =
+			max(mod->stats.wake_latency_max_us, latency);
+		mod->stats.powerups++;
 	}
 	mutex_unlock(&mod->lock);
 }
@@ -65,15 +160,14 @@ static void powerdown_handler(struct work_struct *work)
 	mutex_lock(&mod->lock);
 	if ((atomic_read(&mod->refcount) == 0) && mod->powered) {
 		int i;
+		mod->stats.idle_us += acm_period_us(mod, ktime_get());
 		if (mod->func)
 			mod->func(mod, NVHOST_POWER_ACTION_OFF);
 		for (i = 0; i < mod->num_clks; i++) {
 			clk_disable(mod->clk[i]);
 		}
-		if (mod->powergate_id != -1) {
-			tegra_periph_reset_assert(mod->clk[0]);
-			tegra_powergate_power_off(mod->powergate_id);
-		}
+		if (mod->powergate_id != -1)
+			tegra_powergate_put(mod->powergate_id, mod->clk[0]);
 		mod->powered = false;
 		if (mod->parent)
 			nvhost_module_idle(mod->parent);
@@ -88,7 +182,10 @@ void nvhost_module_idle_mult(struct nvhost_module *mod, int refs)
 	mutex_lock(&mod->lock);
 	if (atomic_sub_return(refs, &mod->refcount) == 0) {
 		BUG_ON(!mod->powered);
-		schedule_delayed_work(&mod->powerdown, ACM_TIMEOUT);
+		mod->idle_start = ktime_get();
+		mod->stats.busy_us += acm_period_us(mod, mod->idle_start);
+		mod->powerdown_delay = acm_powerdown_delay(mod);
+		schedule_delayed_work(&mod->powerdown, mod->powerdown_delay);
 		kick = true;
 	}
 	mutex_unlock(&mod->lock);
@@ -97,6 +194,31 @@ void nvhost_module_idle_mult(struct nvhost_module *mod, int refs)
 		wake_up(&mod->idle);
 }
 
+/**
+ * Snapshot the power statistics of a module, including the time spent in
+ * its current state
+ */
+void nvhost_module_get_stats(struct nvhost_module *mod,
+			     struct nvhost_module_stats *stats)
+{
+	s64 cur;
+
+	mutex_lock(&mod->lock);
+	*stats = mod->stats;
+	cur = ktime_to_us(ktime_sub(ktime_get(), mod->state_start));
+	if (atomic_read(&mod->refcount))
+		stats->busy_us += cur;
+	else if (mod->powered)
+		stats->idle_us += cur;
+	else
+		stats->off_us += cur;
+	stats->wake_latency_us = mod->wake_latency;
+	stats->avg_gap_us = mod->avg_gap;
+	stats->rebusy_pct = mod->rebusy * 100 / ACM_REBUSY_ONE;
+	stats->delay_ms = jiffies_to_msecs(mod->powerdown_delay);
+	mutex_unlock(&mod->lock);
+}
+
 static const char *get_module_clk_id(const char *module, int index)
 {
 	if (index == 1 && strcmp(module, "gr2d") == 0)
@@ -182,6 +304,18 @@ int nvhost_module_init(struct nvhost_module *mod, const char *name,
 	init_waitqueue_head(&mod->idle);
 	INIT_DELAYED_WORK(&mod->powerdown, powerdown_handler);
 
+	/* until the usage is learnt, keep powered for ACM_TIMEOUT */
+	mod->state_start = ktime_get();
+	mod->idle_start = mod->state_start;
+	mod->avg_gap = ACM_TIMEOUT_US / 2;
+	mod->rebusy = ACM_REBUSY_ONE;
+	mod->wake_latency = 0;
+	mod->powerdown_delay = ACM_TIMEOUT;
+	memset(&mod->stats, 0, sizeof(mod->stats));
+
+	if (!parent)
+		host_module = mod;
+
 	return 0;
 }
 
@@ -27,6 +27,7 @@
 #include <linux/wait.h>
 #include <linux/mutex.h>
 #include <linux/clk.h>
+#include <linux/ktime.h>
 
 #define NVHOST_MODULE_MAX_CLOCKS 3
 
@@ -39,6 +40,19 @@ enum nvhost_power_action {
 
 typedef void (*nvhost_modulef)(struct nvhost_module *mod, enum nvhost_power_action action);
 
+/* residencies are in microseconds */
+struct nvhost_module_stats {
+	u64 busy_us;		/* refcount held */
+	u64 idle_us;		/* no refcount, still powered */
+	u64 off_us;		/* powered down */
+	unsigned long powerups;
+	u32 wake_latency_us;	/* smoothed power up time */
+	u32 wake_latency_max_us;
+	u32 avg_gap_us;		/* smoothed busy -> busy gap */
+	u32 rebusy_pct;		/* gaps within the restore window */
+	u32 delay_ms;		/* current powerdown delay */
+};
+
 struct nvhost_module {
 	const char *name;
 	nvhost_modulef func;
@@ -51,6 +65,15 @@ struct nvhost_module {
 	wait_queue_head_t idle;
 	struct nvhost_module *parent;
 	int powergate_id;
+
+	/* adaptive powerdown, see nvhost_acm.c; protected by lock */
+	ktime_t state_start;		/* last busy, idle or off transition */
+	ktime_t idle_start;		/* refcount last dropped to zero */
+	u32 avg_gap;			/* smoothed idle gap, us */
+	u32 rebusy;			/* smoothed short gap share, /256 */
+	u32 wake_latency;		/* smoothed power up time, us */
+	unsigned long powerdown_delay;	/* jiffies */
+	struct nvhost_module_stats stats;
 };
 
 int nvhost_module_init(struct nvhost_module *mod, const char *name,
@@ -61,6 +84,8 @@ void nvhost_module_suspend(struct nvhost_module *mod, bool system_suspend);
 
 void nvhost_module_busy(struct nvhost_module *mod);
 void nvhost_module_idle_mult(struct nvhost_module *mod, int refs);
+void nvhost_module_get_stats(struct nvhost_module *mod,
+			     struct nvhost_module_stats *stats);
 
 static inline bool nvhost_module_powered(struct nvhost_module *mod)
 {
@@ -26,8 +26,6 @@
 
 /*
  * TODO:
- *   stats
- *     - for figuring out what to optimize further
  *   resizable push buffer & sync queue
  *     - some channels hardly need any, some channels (3d) could use more
  */
@@ -327,17 +325,86 @@ dequeue_sync_queue_head(struct sync_queue *queue)
 /*** Cdma internal stuff ***/
 
 /**
- * Kick channel DMA into action by writing its PUT offset (if it has changed)
+ * Write a new PUT offset (if it has changed)
+ * Must be called with the kick lock held.
  */
-static void kick_cdma(struct nvhost_cdma *cdma)
+static void write_put(struct nvhost_cdma *cdma, u32 put)
 {
-	u32 put = push_buffer_putptr(&cdma->push_buffer);
 	if (put != cdma->last_put) {
 		void __iomem *chan_regs = cdma_to_channel(cdma)->aperture;
 		wmb();
 		writel(put, chan_regs + HOST1X_CHANNEL_DMAPUT);
 		cdma->last_put = put;
+		cdma->stats.kicks++;
+	}
+}
+
+/**
+ * Kick channel DMA into action by writing its PUT offset (if it has changed)
+ * This supersedes any deferred kick, as the push buffer only grows.
+ */
+static void kick_cdma(struct nvhost_cdma *cdma)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cdma->kick_lock, flags);
+	cdma->kick_pending = false;
+	cdma->batched = 0;
+	write_put(cdma, push_buffer_putptr(&cdma->push_buffer));
+	spin_unlock_irqrestore(&cdma->kick_lock, flags);
+}
+
+/**
+ * Write a deferred kick now, if there is one
+ * Safe to call from any context.
+ */
+static void flush_kick(struct nvhost_cdma *cdma)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cdma->kick_lock, flags);
+	if (cdma->kick_pending) {
+		cdma->kick_pending = false;
+		cdma->batched = 0;
+		write_put(cdma, cdma->pending_put);
+	}
+	spin_unlock_irqrestore(&cdma->kick_lock, flags);
+}
+
+static enum hrtimer_restart kick_timer_fn(struct hrtimer *timer)
+{
+	struct nvhost_cdma *cdma =
+		container_of(timer, struct nvhost_cdma, kick_timer);
+
+	flush_kick(cdma);
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * Kick at the end of a submit. If the channel had nothing queued, kick
+ * right away; otherwise the hardware has work to do, so defer the kick
+ * to batch it with those of the next few submits.
+ * Must be called with the cdma lock held.
+ */
+static void kick_cdma_batched(struct nvhost_cdma *cdma, bool idle)
+{
+	unsigned long flags;
+	bool start;
+
+	spin_lock_irqsave(&cdma->kick_lock, flags);
+	if (idle || ++cdma->batched >= NVHOST_CDMA_BATCH_JOBS) {
+		spin_unlock_irqrestore(&cdma->kick_lock, flags);
+		kick_cdma(cdma);
+		return;
 	}
+	start = !cdma->kick_pending;
+	cdma->pending_put = push_buffer_putptr(&cdma->push_buffer);
+	cdma->kick_pending = true;
+	if (start)
+		hrtimer_start(&cdma->kick_timer,
+			      ktime_set(0, NVHOST_CDMA_BATCH_NS),
+			      HRTIMER_MODE_REL);
+	spin_unlock_irqrestore(&cdma->kick_lock, flags);
 }
 
 /**
@@ -379,6 +446,11 @@ static unsigned int wait_cdma(struct nvhost_cdma *cdma, enum cdma_event event)
 
 		BUG_ON(cdma->event != CDMA_EVENT_NONE);
 		cdma->event = event;
+		if (event == CDMA_EVENT_PUSH_BUFFER_SPACE)
+			cdma->stats.pb_waits++;
+
+		/* don't sleep on work that hasn't been kicked yet */
+		flush_kick(cdma);
 
 		mutex_unlock(&cdma->lock);
 		down(&cdma->sem);
@@ -386,10 +458,55 @@ static unsigned int wait_cdma(struct nvhost_cdma *cdma, enum cdma_event event)
 	}
 }
 
+/**
+ * Unpin the handles collected by update_cdma(), and drop the reference to
+ * the nvmap client that pinned them
+ */
+static void flush_unpins(struct nvhost_cdma *cdma)
+{
+	if (!cdma->unpin_client)
+		return;
+
+	if (cdma->nr_unpins)
+		nvmap_unpin_handles(cdma->unpin_client, cdma->unpins,
+				    cdma->nr_unpins);
+	nvmap_client_put(cdma->unpin_client);
+	cdma->unpin_client = NULL;
+	cdma->nr_unpins = 0;
+}
+
+/**
+ * Queue the handles of a completed sync queue entry for unpinning; takes
+ * over the entry's reference to nvmap
+ */
+static void queue_unpins(struct nvhost_cdma *cdma, struct nvmap_client *nvmap,
+			 struct nvmap_handle **handles, unsigned int nr_handles)
+{
+	if (nr_handles > NVHOST_CDMA_UNPIN_BATCH) {
+		flush_unpins(cdma);
+		nvmap_unpin_handles(nvmap, handles, nr_handles);
+		nvmap_client_put(nvmap);
+		return;
+	}
+
+	if (nvmap != cdma->unpin_client ||
+	    cdma->nr_unpins + nr_handles > NVHOST_CDMA_UNPIN_BATCH)
+		flush_unpins(cdma);
+
+	if (cdma->unpin_client)
+		nvmap_client_put(nvmap);
+	else
+		cdma->unpin_client = nvmap;
+
+	memcpy(cdma->unpins + cdma->nr_unpins, handles,
+	       nr_handles * sizeof(*handles));
+	cdma->nr_unpins += nr_handles;
+}
+
 /**
  * For all sync queue entries that have already finished according to the
  * current sync point registers:
- *  - unpin & unref their mems
+ *  - unpin & unref their mems (batched across entries)
  *  - pop their push buffer slots
  *  - remove them from the sync queue
  * This is normally called from the host code's worker thread, but can be
@@ -439,9 +556,7 @@ static void update_cdma(struct nvhost_cdma *cdma)
 		BUG_ON(!nvmap);
 
 		/* Unpin the memory */
-		nvmap_unpin_handles(nvmap, handles, nr_handles);
-
-		nvmap_client_put(nvmap);
+		queue_unpins(cdma, nvmap, handles, nr_handles);
 
 		/* Pop push buffer slots */
 		if (nr_slots) {
@@ -455,6 +570,8 @@ static void update_cdma(struct nvhost_cdma *cdma)
 			signal = true;
 	}
 
+	flush_unpins(cdma);
+
 	/* Wake up CdmaWait() if the requested event happened */
 	if (signal) {
 		cdma->event = CDMA_EVENT_NONE;
@@ -473,6 +590,14 @@ int nvhost_cdma_init(struct nvhost_cdma *cdma)
 	sema_init(&cdma->sem, 0);
 	cdma->event = CDMA_EVENT_NONE;
 	cdma->running = false;
+	spin_lock_init(&cdma->kick_lock);
+	cdma->kick_pending = false;
+	cdma->batched = 0;
+	hrtimer_init(&cdma->kick_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cdma->kick_timer.function = kick_timer_fn;
+	cdma->unpin_client = NULL;
+	cdma->nr_unpins = 0;
+	memset(&cdma->stats, 0, sizeof(cdma->stats));
 	err = init_push_buffer(&cdma->push_buffer);
 	if (err)
 		return err;
@@ -486,17 +611,23 @@ int nvhost_cdma_init(struct nvhost_cdma *cdma)
 void nvhost_cdma_deinit(struct nvhost_cdma *cdma)
 {
 	BUG_ON(cdma->running);
+	hrtimer_cancel(&cdma->kick_timer);
 	destroy_push_buffer(&cdma->push_buffer);
 }
 
 static void start_cdma(struct nvhost_cdma *cdma)
 {
 	void __iomem *chan_regs = cdma_to_channel(cdma)->aperture;
+	unsigned long flags;
 
 	if (cdma->running)
 		return;
 
+	spin_lock_irqsave(&cdma->kick_lock, flags);
 	cdma->last_put = push_buffer_putptr(&cdma->push_buffer);
+	cdma->kick_pending = false;
+	cdma->batched = 0;
+	spin_unlock_irqrestore(&cdma->kick_lock, flags);
 
 	writel(nvhost_channel_dmactrl(true, false, false),
 		chan_regs + HOST1X_CHANNEL_DMACTRL);
@@ -562,8 +693,9 @@ void nvhost_cdma_push(struct nvhost_cdma *cdma, u32 op1, u32 op2)
 
 /**
  * End a cdma submit
- * Kick off DMA, add a contiguous block of memory handles to the sync queue,
- * and a number of slots to be freed from the pushbuffer.
+ * Kick off DMA (possibly batched with the following submits), add a
+ * contiguous block of memory handles to the sync queue, and a number of
+ * slots to be freed from the pushbuffer.
  * Blocks as necessary if the sync queue is full.
  * The handles for a submit must all be pinned at the same time, but they
  * can be unpinned in smaller chunks.
@@ -572,7 +704,8 @@ void nvhost_cdma_end(struct nvmap_client *user_nvmap, struct nvhost_cdma *cdma,
 		     u32 sync_point_id, u32 sync_point_value,
 		     struct nvmap_handle **handles, unsigned int nr_handles)
 {
-	kick_cdma(cdma);
+	cdma->stats.jobs++;
+	kick_cdma_batched(cdma, !sync_queue_head(&cdma->sync_queue));
 
 	while (nr_handles || cdma->slots_used) {
 		unsigned int count;
@@ -600,6 +733,15 @@ void nvhost_cdma_end(struct nvmap_client *user_nvmap, struct nvhost_cdma *cdma,
 	mutex_unlock(&cdma->lock);
 }
 
+/**
+ * Write out a deferred kick now. For callers which are about to poll for
+ * the completion of their submit without being able to sleep.
+ */
+void nvhost_cdma_kick(struct nvhost_cdma *cdma)
+{
+	flush_kick(cdma);
+}
+
 /**
  * Update cdma state according to current sync point values
  */
@@ -617,6 +759,7 @@ void nvhost_cdma_update(struct nvhost_cdma *cdma)
 void nvhost_cdma_flush(struct nvhost_cdma *cdma)
 {
 	mutex_lock(&cdma->lock);
+	flush_kick(cdma);
 	while (sync_queue_head(&cdma->sync_queue)) {
 		update_cdma(cdma);
 		mutex_unlock(&cdma->lock);
@@ -23,8 +23,10 @@
 #ifndef __NVHOST_CDMA_H
 #define __NVHOST_CDMA_H
 
+#include <linux/hrtimer.h>
 #include <linux/sched.h>
 #include <linux/semaphore.h>
+#include <linux/spinlock.h>
 
 #include <mach/nvhost.h>
 #include <mach/nvmap.h>
@@ -43,6 +45,10 @@
  *	end - start command DMA and enqueue handles to be unpinned
  * Consumer:
  *	update - call to update sync queue and push buffer, unpin memory
+ *
+ * Submits ended while earlier ones are still queued share one DMAPUT
+ * write: the kick is deferred by up to NVHOST_CDMA_BATCH_NS, or until
+ * NVHOST_CDMA_BATCH_JOBS submits have been ended.
  */
 
 /* Size of the sync queue. If it is too small, we won't be able to queue up
@@ -53,6 +59,14 @@
    power of two. Currently sized such that pushbuffer is 4KB (512*8B). */
 #define NVHOST_GATHER_QUEUE_SIZE 512
 
+/* Submit batching window, and the number of submits which force a kick */
+#define NVHOST_CDMA_BATCH_NS	(100 * NSEC_PER_USEC)
+#define NVHOST_CDMA_BATCH_JOBS	8
+
+/* Number of handles collected from completed sync queue entries before
+ * they are handed to nvmap in one unpin call */
+#define NVHOST_CDMA_UNPIN_BATCH	64
+
 struct push_buffer {
 	struct nvmap_handle_ref *mem; /* handle to pushbuffer memory */
 	u32 *mapped;		/* mapped pushbuffer memory */
@@ -74,15 +88,30 @@ enum cdma_event {
 	CDMA_EVENT_PUSH_BUFFER_SPACE	/* wait for space in push buffer */
 };
 
+struct nvhost_cdma_stats {
+	unsigned long jobs;		/* submits ended */
+	unsigned long kicks;		/* DMAPUT writes */
+	unsigned long pb_waits;		/* waits for push buffer space */
+};
+
 struct nvhost_cdma {
 	struct mutex lock;		/* controls access to shared state */
 	struct semaphore sem;		/* signalled when event occurs */
 	enum cdma_event event;		/* event that sem is waiting for */
 	unsigned int slots_used;	/* pb slots used in current submit */
 	unsigned int slots_free;	/* pb slots free in current submit */
+	spinlock_t kick_lock;		/* protects DMAPUT state below */
 	unsigned int last_put;		/* last value written to DMAPUT */
+	unsigned int pending_put;	/* DMAPUT value of a deferred kick */
+	bool kick_pending;		/* pending_put is yet to be written */
+	unsigned int batched;		/* submits in the deferred kick */
+	struct hrtimer kick_timer;	/* ends the batching window */
 	struct push_buffer push_buffer;	/* channel's push buffer */
 	struct sync_queue sync_queue;	/* channel's sync queue */
+	struct nvmap_client *unpin_client;	/* owner of queued unpins */
+	unsigned int nr_unpins;
+	struct nvmap_handle *unpins[NVHOST_CDMA_UNPIN_BATCH];
+	struct nvhost_cdma_stats stats;
 	bool running;
 };
 
@@ -95,6 +124,7 @@ void	nvhost_cdma_end(struct nvmap_client *user_nvmap,
 			struct nvhost_cdma *cdma,
 			u32 sync_point_id, u32 sync_point_value,
 			struct nvmap_handle **handles, unsigned int nr_handles);
+void	nvhost_cdma_kick(struct nvhost_cdma *cdma);
 void	nvhost_cdma_update(struct nvhost_cdma *cdma);
 void	nvhost_cdma_flush(struct nvhost_cdma *cdma);
 void    nvhost_cdma_find_gather(struct nvhost_cdma *cdma, u32 dmaget,
@@ -26,6 +26,10 @@
 
 #include <linux/platform_device.h>
 
+#include <trace/events/nvhost.h>
+
+#include <mach/frame_timeline.h>
+
 #define NVMODMUTEX_2D_FULL   (1)
 #define NVMODMUTEX_2D_SIMPLE (2)
 #define NVMODMUTEX_2D_SB_A   (3)
@@ -179,6 +183,10 @@ void nvhost_channel_submit(struct nvhost_channel *ch,
 	int i;
 	struct nvhost_op_pair* p;
 
+	trace_nvhost_channel_submit(ch->desc->name, num_pairs,
+				    syncpt_id, syncpt_val);
+	tegra_ftl_submit(ch - ch->dev->channels, syncpt_id, syncpt_val);
+
 	/* schedule interrupts */
 	for (i = 0; i < num_intrs; i++) {
 		nvhost_intr_add_action(&ch->dev->intr, syncpt_id, intrs[i].syncpt_val,
@@ -230,45 +238,81 @@ static void power_2d(struct nvhost_module *mod, enum nvhost_power_action action)
 	}
 }
 
+/*
+ * save the context currently in the 3D unit to memory, and wait for the
+ * save to complete; the next submit of the context will restore it.
+ * must be called with the submit lock held and the module powered
+ */
+static void save_cur_ctx_3d(struct nvhost_channel *ch)
+{
+	DECLARE_WAIT_QUEUE_HEAD_ONSTACK(wq);
+	struct nvhost_op_pair save;
+	struct nvhost_cpuinterrupt ctxsw;
+	u32 syncval;
+	void *ref;
+
+	syncval = nvhost_syncpt_incr_max(&ch->dev->syncpt,
+					NVSYNCPT_3D,
+					ch->cur_ctx->save_incrs);
+	save.op1 = nvhost_opcode_gather(0, ch->cur_ctx->save_size);
+	save.op2 = ch->cur_ctx->save_phys;
+	ctxsw.intr_data = ch->cur_ctx;
+	ctxsw.syncpt_val = syncval - 1;
+	ch->cur_ctx->valid = true;
+	ch->ctxhandler.get(ch->cur_ctx);
+	ch->cur_ctx = NULL;
+
+	nvhost_channel_submit(ch, ch->dev->nvmap,
+				&save, 1, &ctxsw, 1, NULL, 0,
+				NVSYNCPT_3D, syncval, 0);
+
+	nvhost_intr_add_action(&ch->dev->intr, NVSYNCPT_3D,
+			       syncval,
+			       NVHOST_INTR_ACTION_WAKEUP,
+			       &wq, &ref);
+	wait_event(wq,
+		   nvhost_syncpt_min_cmp(&ch->dev->syncpt,
+					 NVSYNCPT_3D, syncval));
+	nvhost_intr_put_ref(&ch->dev->intr, ref);
+	nvhost_cdma_update(&ch->cdma);
+}
+
 static void power_3d(struct nvhost_module *mod, enum nvhost_power_action action)
 {
 	struct nvhost_channel *ch = container_of(mod, struct nvhost_channel, mod);
 
 	if (action == NVHOST_POWER_ACTION_OFF) {
 		mutex_lock(&ch->submitlock);
-		if (ch->cur_ctx) {
-			DECLARE_WAIT_QUEUE_HEAD_ONSTACK(wq);
-			struct nvhost_op_pair save;
-			struct nvhost_cpuinterrupt ctxsw;
-			u32 syncval;
-			void *ref;
-			syncval = nvhost_syncpt_incr_max(&ch->dev->syncpt,
-							NVSYNCPT_3D,
-							ch->cur_ctx->save_incrs);
-			save.op1 = nvhost_opcode_gather(0, ch->cur_ctx->save_size);
-			save.op2 = ch->cur_ctx->save_phys;
-			ctxsw.intr_data = ch->cur_ctx;
-			ctxsw.syncpt_val = syncval - 1;
-			ch->cur_ctx->valid = true;
-			ch->ctxhandler.get(ch->cur_ctx);
-			ch->cur_ctx = NULL;
+		/*
+		 * unless the unit is power gated, its registers survive
+		 * with the clocks off, so the current context is left in
+		 * the hardware: if it is the next one to submit, which is
+		 * the common case, neither a save nor a restore is done.
+		 * switching in another context saves it as usual, and
+		 * nvhost_channel_save_context() does before system suspend.
+		 */
+		if (ch->cur_ctx && mod->powergate_id != -1)
+			save_cur_ctx_3d(ch);
+		mutex_unlock(&ch->submitlock);
+	}
+}
 
-			nvhost_channel_submit(ch, ch->dev->nvmap,
-						&save, 1, &ctxsw, 1, NULL, 0,
-						NVSYNCPT_3D, syncval, 0);
-
-			nvhost_intr_add_action(&ch->dev->intr, NVSYNCPT_3D,
-					       syncval,
-					       NVHOST_INTR_ACTION_WAKEUP,
-					       &wq, &ref);
-			wait_event(wq,
-				   nvhost_syncpt_min_cmp(&ch->dev->syncpt,
-							 NVSYNCPT_3D, syncval));
-			nvhost_intr_put_ref(&ch->dev->intr, ref);
-			nvhost_cdma_update(&ch->cdma);
-		}
+/**
+ * Save a context left in the hardware by power_3d() before the unit loses
+ * its state, i.e. before system suspend
+ */
+void nvhost_channel_save_context(struct nvhost_channel *ch)
+{
+	mutex_lock(&ch->reflock);
+	if (ch->refcount && ch->cur_ctx && ch->desc->power == power_3d) {
+		nvhost_module_busy(&ch->mod);
+		mutex_lock(&ch->submitlock);
+		if (ch->cur_ctx)
+			save_cur_ctx_3d(ch);
 		mutex_unlock(&ch->submitlock);
+		nvhost_module_idle(&ch->mod);
 	}
+	mutex_unlock(&ch->reflock);
 }
 
 static void power_mpe(struct nvhost_module *mod, enum nvhost_power_action action)
@@ -86,5 +86,6 @@ void nvhost_channel_submit(struct nvhost_channel *ch,
 struct nvhost_channel *nvhost_getchannel(struct nvhost_channel *ch);
 void nvhost_putchannel(struct nvhost_channel *ch, struct nvhost_hwctx *ctx);
 void nvhost_channel_suspend(struct nvhost_channel *ch);
+void nvhost_channel_save_context(struct nvhost_channel *ch);
 
 #endif
@@ -0,0 +1,270 @@
+/*
+ * drivers/video/tegra/host/nvhost_fence.c
+ *
+ * Tegra Graphics Host Syncpoint Fences
+ *
+ * Copyright (c) 2010, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <linux/anon_inodes.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+
+#include "nvhost_fence.h"
+#include "dev.h"
+
+#define client_managed(id) (BIT(id) & NVSYNCPTS_CLIENT_MANAGED)
+
+/*
+ * A fence is a set of (sync point, threshold) pairs, at most one per sync
+ * point, which is signalled once all of them have been reached. It is
+ * handed to userspace as a file, so it can be polled, and passed to other
+ * processes like any other file descriptor.
+ *
+ * Points which have already expired when the fence is created are dropped;
+ * for each of the others, a waiter is queued with the interrupt code, and
+ * the last one to run signals the fence. While any point is pending, the
+ * fence keeps the host powered so that the threshold interrupts arrive.
+ */
+
+struct nvhost_fence_pt {
+	u32 id;
+	u32 thresh;
+	void *ref;		/* interrupt waiter */
+};
+
+struct nvhost_fence {
+	struct nvhost_master *host;
+	wait_queue_head_t wq;
+	atomic_t pending;	/* points yet to expire */
+	unsigned int num_pts;
+	struct nvhost_fence_pt pts[NV_HOST1X_SYNCPT_NB_PTS];
+};
+
+static const struct file_operations nvhost_fence_fops;
+
+void nvhost_fence_signal_pt(struct nvhost_fence *fence)
+{
+	if (atomic_dec_and_test(&fence->pending)) {
+		nvhost_module_idle(&fence->host->mod);
+		wake_up_interruptible_all(&fence->wq);
+	}
+}
+
+static struct nvhost_fence *fence_alloc(struct nvhost_master *host)
+{
+	struct nvhost_fence *fence;
+
+	fence = kzalloc(sizeof(*fence), GFP_KERNEL);
+	if (!fence)
+		return NULL;
+
+	fence->host = host;
+	init_waitqueue_head(&fence->wq);
+	return fence;
+}
+
+static void fence_free(struct nvhost_fence *fence)
+{
+	unsigned int i;
+
+	/* once all the waiters are cancelled or have run, any point still
+	 * counted as pending holds the host busy */
+	for (i = 0; i < fence->num_pts; i++)
+		if (fence->pts[i].ref)
+			nvhost_intr_put_ref(&fence->host->intr,
+					    fence->pts[i].ref);
+
+	if (atomic_read(&fence->pending))
+		nvhost_module_idle(&fence->host->mod);
+
+	kfree(fence);
+}
+
+/* add a point, or raise the threshold of the point on the same sync point */
+static void fence_add_pt(struct nvhost_fence *fence, u32 id, u32 thresh)
+{
+	unsigned int i;
+
+	for (i = 0; i < fence->num_pts; i++) {
+		if (fence->pts[i].id == id) {
+			if ((s32)(thresh - fence->pts[i].thresh) > 0)
+				fence->pts[i].thresh = thresh;
+			return;
+		}
+	}
+
+	BUG_ON(fence->num_pts >= NV_HOST1X_SYNCPT_NB_PTS);
+	fence->pts[fence->num_pts].id = id;
+	fence->pts[fence->num_pts].thresh = thresh;
+	fence->num_pts++;
+}
+
+/* must be called with the host busy */
+static bool pt_expired(struct nvhost_syncpt *sp, u32 id, u32 thresh)
+{
+	if (nvhost_syncpt_min_cmp(sp, id, thresh))
+		return true;
+
+	if (client_managed(id) || !nvhost_syncpt_min_eq_max(sp, id)) {
+		u32 val = nvhost_syncpt_update_min(sp, id);
+		if ((s32)(val - thresh) >= 0)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Drop the expired points of a fence, queue waiters for the others, and
+ * return a file descriptor for it. Frees the fence on failure.
+ */
+static int fence_install(struct nvhost_fence *fence)
+{
+	struct nvhost_master *host = fence->host;
+	unsigned int i, n;
+	int err;
+
+	nvhost_module_busy(&host->mod);
+
+	for (i = 0, n = 0; i < fence->num_pts; i++) {
+		if (pt_expired(&host->syncpt, fence->pts[i].id,
+			       fence->pts[i].thresh))
+			continue;
+		fence->pts[n++] = fence->pts[i];
+	}
+	fence->num_pts = n;
+
+	/* the extra count keeps the fence from being signalled (and the
+	 * host from going idle) until all waiters have been queued */
+	atomic_set(&fence->pending, n + 1);
+
+	for (i = 0; i < n; i++) {
+		err = nvhost_intr_add_action(&host->intr, fence->pts[i].id,
+					     fence->pts[i].thresh,
+					     NVHOST_INTR_ACTION_SIGNAL_FENCE,
+					     fence, &fence->pts[i].ref);
+		if (err) {
+			fence->num_pts = i;
+			fence_free(fence);
+			return err;
+		}
+	}
+
+	nvhost_fence_signal_pt(fence);
+
+	err = anon_inode_getfd("nvhost_fence", &nvhost_fence_fops, fence,
+			       O_RDONLY | O_CLOEXEC);
+	if (err < 0)
+		fence_free(fence);
+
+	return err;
+}
+
+int nvhost_fence_create_fd(struct nvhost_master *host, u32 id, u32 thresh)
+{
+	struct nvhost_fence *fence;
+
+	if (id >= NV_HOST1X_SYNCPT_NB_PTS)
+		return -EINVAL;
+
+	/* a threshold beyond the last increment would never be reached */
+	if (!client_managed(id) &&
+	    (s32)(nvhost_syncpt_read_max(&host->syncpt, id) - thresh) < 0)
+		return -EINVAL;
+
+	fence = fence_alloc(host);
+	if (!fence)
+		return -ENOMEM;
+
+	fence_add_pt(fence, id, thresh);
+	return fence_install(fence);
+}
+
+static struct file *fence_fget(int fd)
+{
+	struct file *file = fget(fd);
+
+	if (file && file->f_op != &nvhost_fence_fops) {
+		fput(file);
+		return NULL;
+	}
+	return file;
+}
+
+int nvhost_fence_merge_fd(struct nvhost_master *host, int fd1, int fd2)
+{
+	struct nvhost_fence *fence;
+	struct file *f1, *f2;
+	unsigned int i;
+	int err = -EINVAL;
+
+	f1 = fence_fget(fd1);
+	if (!f1)
+		return -EINVAL;
+
+	f2 = fence_fget(fd2);
+	if (!f2)
+		goto out_put1;
+
+	fence = fence_alloc(host);
+	if (!fence) {
+		err = -ENOMEM;
+		goto out_put2;
+	}
+
+	/* the points of an installed fence no longer change */
+	for (i = 0; i < 2; i++) {
+		struct nvhost_fence *src = (i ? f2 : f1)->private_data;
+		unsigned int j;
+
+		for (j = 0; j < src->num_pts; j++)
+			fence_add_pt(fence, src->pts[j].id,
+				     src->pts[j].thresh);
+	}
+
+	err = fence_install(fence);
+
+out_put2:
+	fput(f2);
+out_put1:
+	fput(f1);
+	return err;
+}
+
+static unsigned int nvhost_fence_poll(struct file *file, poll_table *wait)
+{
+	struct nvhost_fence *fence = file->private_data;
+
+	poll_wait(file, &fence->wq, wait);
+
+	return atomic_read(&fence->pending) ? 0 : POLLIN | POLLRDNORM;
+}
+
+static int nvhost_fence_release(struct inode *inode, struct file *file)
+{
+	fence_free(file->private_data);
+	return 0;
+}
+
+static const struct file_operations nvhost_fence_fops = {
+	.owner = THIS_MODULE,
+	.poll = nvhost_fence_poll,
+	.release = nvhost_fence_release,
+};
@@ -0,0 +1,48 @@
+/*
+ * drivers/video/tegra/host/nvhost_fence.h
+ *
+ * Tegra Graphics Host Syncpoint Fences
+ *
+ * Copyright (c) 2010, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __NVHOST_FENCE_H
+#define __NVHOST_FENCE_H
+
+#include <linux/types.h>
+
+struct nvhost_master;
+struct nvhost_fence;
+
+/**
+ * Create a fence file for a (sync point, threshold) pair.
+ * Returns a new file descriptor, or a negative error code.
+ */
+int nvhost_fence_create_fd(struct nvhost_master *host, u32 id, u32 thresh);
+
+/**
+ * Create a fence file which signals once both fences fd1 and fd2 have.
+ * Returns a new file descriptor, or a negative error code.
+ */
+int nvhost_fence_merge_fd(struct nvhost_master *host, int fd1, int fd2);
+
+/**
+ * Called by the interrupt code when one point of a fence has expired.
+ */
+void nvhost_fence_signal_pt(struct nvhost_fence *fence);
+
+#endif
@@ -30,6 +30,7 @@
 enum {
 	NV_HOST1X_CLASS_ID = 0x1,
 	NV_VIDEO_ENCODE_MPEG_CLASS_ID = 0x20,
+	NV_GRAPHICS_2D_CLASS_ID = 0x51,
 	NV_GRAPHICS_3D_CLASS_ID = 0x60
 };
 
@@ -141,6 +142,12 @@ enum {
 	NV_CLASS_HOST_INDDATA = 0x2e
 };
 
+static inline u32 nvhost_class_host_wait_syncpt(
+	unsigned indx, unsigned threshold)
+{
+	return (indx << 24) | (threshold & 0xffffff);
+}
+
 static inline u32 nvhost_class_host_wait_syncpt_base(
 	unsigned indx, unsigned base_indx, unsigned offset)
 {
@@ -21,11 +21,14 @@
  */
 
 #include "nvhost_intr.h"
+#include "nvhost_fence.h"
 #include "dev.h"
 #include <linux/interrupt.h>
 #include <linux/slab.h>
 #include <linux/irq.h>
 
+#include <mach/frame_timeline.h>
+
 #define intr_to_dev(x) container_of(x, struct nvhost_master, intr)
 
 
@@ -157,6 +160,18 @@ static void action_wakeup_interruptible(struct nvhost_waitlist *waiter)
 	wake_up_interruptible(wq);
 }
 
+static void action_signal_fence(struct nvhost_waitlist *waiter)
+{
+	nvhost_fence_signal_pt(waiter->data);
+}
+
+static void action_callback(struct nvhost_waitlist *waiter)
+{
+	struct nvhost_intr_callback *cb = waiter->data;
+
+	cb->func(cb);
+}
+
 typedef void (*action_handler)(struct nvhost_waitlist *waiter);
 
 static action_handler action_handlers[NVHOST_INTR_ACTION_COUNT] = {
@@ -164,6 +179,8 @@ static action_handler action_handlers[NVHOST_INTR_ACTION_COUNT] = {
 	action_ctxsave,
 	action_wakeup,
 	action_wakeup_interruptible,
+	action_signal_fence,
+	action_callback,
 };
 
 static void run_handlers(struct list_head completed[NVHOST_INTR_ACTION_COUNT])
@@ -230,6 +247,7 @@ static irqreturn_t syncpt_thresh_isr(int irq, void *dev_id)
 						syncpt[id]);
 	void __iomem *sync_regs = intr_to_dev(intr)->sync_aperture;
 
+	syncpt->isr_ts = ktime_get();
 	writel(BIT(id),
 		sync_regs + HOST1X_SYNC_SYNCPT_THRESH_INT_DISABLE);
 	writel(BIT(id),
@@ -260,6 +278,7 @@ static irqreturn_t syncpt_thresh_fn(int irq, void *dev_id)
 		INIT_LIST_HEAD(completed + i);
 
 	sync = nvhost_syncpt_update_min(&dev->syncpt, id);
+	tegra_ftl_syncpt_done(id, sync, syncpt->isr_ts);
 
 	spin_lock(&syncpt->lock);
 
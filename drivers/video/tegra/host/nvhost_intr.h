@@ -24,6 +24,7 @@
 #define __NVHOST_INTR_H
 
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/semaphore.h>
 
 #include "nvhost_hardware.h"
@@ -55,9 +56,26 @@ enum nvhost_intr_action {
 	 */
 	NVHOST_INTR_ACTION_WAKEUP_INTERRUPTIBLE,
 
+	/**
+	 * Signal one point of a fence.
+	 * 'data' points to a struct nvhost_fence
+	 */
+	NVHOST_INTR_ACTION_SIGNAL_FENCE,
+
+	/**
+	 * Call a driver function from the sync point irq thread.
+	 * 'data' points to a struct nvhost_intr_callback
+	 */
+	NVHOST_INTR_ACTION_CALLBACK,
+
 	NVHOST_INTR_ACTION_COUNT
 };
 
+/* Embed in the caller's own structure and use container_of() in func. */
+struct nvhost_intr_callback {
+	void (*func)(struct nvhost_intr_callback *cb);
+};
+
 struct nvhost_intr_syncpt {
 	u8 id;
 	u8 irq_requested;
@@ -65,6 +83,7 @@ struct nvhost_intr_syncpt {
 	spinlock_t lock;
 	struct list_head wait_head;
 	char thresh_irq_name[12];
+	ktime_t isr_ts;
 };
 
 struct nvhost_intr {
@@ -20,6 +20,10 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <linux/ktime.h>
+
+#include <trace/events/nvhost.h>
+
 #include "nvhost_syncpt.h"
 #include "dev.h"
 
@@ -151,6 +155,7 @@ void nvhost_syncpt_cpu_incr(struct nvhost_syncpt *sp, u32 id)
  */
 void nvhost_syncpt_incr(struct nvhost_syncpt *sp, u32 id)
 {
+	trace_nvhost_syncpt_incr(id);
 	nvhost_syncpt_incr_max(sp, id, 1);
 	nvhost_module_busy(&syncpt_to_dev(sp)->mod);
 	nvhost_syncpt_cpu_incr(sp, id);
@@ -164,6 +169,7 @@ int nvhost_syncpt_wait_timeout(struct nvhost_syncpt *sp, u32 id,
 			u32 thresh, u32 timeout)
 {
 	DECLARE_WAIT_QUEUE_HEAD_ONSTACK(wq);
+	ktime_t start;
 	void *ref;
 	int err = 0;
 
@@ -173,6 +179,8 @@ int nvhost_syncpt_wait_timeout(struct nvhost_syncpt *sp, u32 id,
 	if (nvhost_syncpt_min_cmp(sp, id, thresh))
 		return 0;
 
+	start = ktime_get();
+
 	/* keep host alive */
 	nvhost_module_busy(&syncpt_to_dev(sp)->mod);
 
@@ -222,6 +230,8 @@ int nvhost_syncpt_wait_timeout(struct nvhost_syncpt *sp, u32 id,
 
 done:
 	nvhost_module_idle(&syncpt_to_dev(sp)->mod);
+	trace_nvhost_syncpt_wait(id, thresh, err,
+		ktime_to_ns(ktime_sub(ktime_get(), start)));
 	return err;
 }
 
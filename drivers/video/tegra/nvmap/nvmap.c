@@ -29,11 +29,15 @@
 #include <linux/wait.h>
 
 #include <asm/pgtable.h>
+#include <asm/sizes.h>
 #include <asm/tlbflush.h>
+#include <asm/mach/map.h>
 
 #include <mach/iovmm.h>
 #include <mach/nvmap.h>
 
+#include <trace/events/nvmap.h>
+
 #include "nvmap.h"
 #include "nvmap_mru.h"
 
@@ -58,6 +62,7 @@ static void map_iovmm_area(struct nvmap_handle *h)
 					  page_to_pfn(h->pgalloc.pages[i]));
 	}
 	h->pgalloc.dirty = false;
+	nvmap_mru_account_remap(nvmap_get_share_from_dev(h->dev), h->size);
 }
 
 /* must be called inside nvmap_pin_lock, to ensure that an entire stream
@@ -67,9 +72,12 @@ static void map_iovmm_area(struct nvmap_handle *h)
 static int pin_locked(struct nvmap_client *client, struct nvmap_handle *h)
 {
 	struct tegra_iovmm_area *area;
+	int pin;
 	BUG_ON(!h->alloc);
 
-	if (atomic_inc_return(&h->pin) == 1) {
+	pin = atomic_inc_return(&h->pin);
+	trace_nvmap_pin(h, h->size, pin);
+	if (pin == 1) {
 		if (h->heap_pgalloc && !h->pgalloc.contig) {
 			area = nvmap_handle_iovmm(client, h);
 			if (!area) {
@@ -101,14 +109,19 @@ static int wait_pin_locked(struct nvmap_client *client, struct nvmap_handle *h)
 }
 
 /* doesn't need to be called inside nvmap_pin_lock, since this will only
- * expand the available VM area */
-static int handle_unpin(struct nvmap_client *client, struct nvmap_handle *h)
+ * expand the available VM area. if lazy is set and this is the last pin
+ * of an IOVMM handle, the pin is kept by the MRU lazy list instead, so
+ * that the next pin of the handle does not need to look up its area */
+static int handle_unpin(struct nvmap_client *client, struct nvmap_handle *h,
+			bool lazy)
 {
+	int pins;
 	int ret = 0;
 
 	nvmap_mru_lock(client->share);
 
-	if (atomic_read(&h->pin) == 0) {
+	pins = atomic_read(&h->pin);
+	if (pins == 0 || (pins == 1 && nvmap_handle_lazy_pinned(h))) {
 		nvmap_err(client, "%s unpinning unpinned handle %p\n",
 			  current->group_leader->comm, h);
 		nvmap_mru_unlock(client->share);
@@ -117,7 +130,11 @@ static int handle_unpin(struct nvmap_client *client, struct nvmap_handle *h)
 
 	BUG_ON(!h->alloc);
 
-	if (!atomic_dec_return(&h->pin)) {
+	/* a concurrent pin can only raise the count, in which case the
+	 * kept pin still accounts for one of them */
+	if (lazy && pins == 1 && nvmap_mru_pin_lazy_locked(client->share, h)) {
+		ret = 0;
+	} else if (!atomic_dec_return(&h->pin)) {
 		if (h->heap_pgalloc && h->pgalloc.area) {
 			/* if a secure handle is clean (i.e., mapped into
 			 * IOVMM, it needs to be zapped on unpin. */
@@ -152,7 +169,7 @@ static int handle_unpin_noref(struct nvmap_client *client, unsigned long id)
 		  current->group_leader->comm, h);
 	WARN_ON(1);
 
-	w = handle_unpin(client, h);
+	w = handle_unpin(client, h, false);
 	nvmap_handle_put(h);
 	return w;
 }
@@ -182,7 +199,7 @@ void nvmap_unpin_ids(struct nvmap_client *client,
 					  "handle %08lx\n",
 					  current->group_leader->comm, ids[i]);
 			} else {
-				do_wake |= handle_unpin(client, h);
+				do_wake |= handle_unpin(client, h, false);
 			}
 		} else {
 			nvmap_ref_unlock(client);
@@ -258,7 +275,7 @@ int nvmap_pin_ids(struct nvmap_client *client,
 		int do_wake = 0;
 
 		for (i = 0; i < cnt; i++)
-			do_wake |= handle_unpin(client, h[i]);
+			do_wake |= handle_unpin(client, h[i], false);
 
 		if (do_wake)
 			wake_up(&client->share->pin_wait);
@@ -394,6 +411,52 @@ static int nvmap_reloc_pin_array(struct nvmap_client *client,
 	return 0;
 }
 
+/* overwrites one word of a client's handle, e.g. a stale sync point wait */
+int nvmap_patch_word(struct nvmap_client *client, unsigned long id,
+		     u32 offset, u32 value)
+{
+	struct nvmap_handle *h;
+	unsigned long phys;
+	unsigned long kaddr;
+	pte_t **pte;
+	void *addr;
+
+	h = nvmap_get_handle_id(client, id);
+	if (!h)
+		return -EPERM;
+
+	if (!h->alloc || (offset & 3) || offset >= h->size) {
+		nvmap_handle_put(h);
+		return -EINVAL;
+	}
+
+	pte = nvmap_alloc_pte(client->dev, &addr);
+	if (IS_ERR(pte)) {
+		nvmap_handle_put(h);
+		return PTR_ERR(pte);
+	}
+
+	if (h->heap_pgalloc) {
+		phys = page_to_phys(h->pgalloc.pages[offset >> PAGE_SHIFT]);
+		phys += (offset & ~PAGE_MASK);
+	} else {
+		phys = h->carveout->base + offset;
+	}
+
+	kaddr = (unsigned long)addr;
+	set_pte_at(&init_mm, kaddr, *pte,
+		   pfn_pte(__phys_to_pfn(phys), nvmap_pgprot(h, pgprot_kernel)));
+	flush_tlb_kernel_page(kaddr);
+	__raw_writel(value, addr + (phys & ~PAGE_MASK));
+
+	nvmap_free_pte(client->dev, pte);
+	nvmap_handle_put(h);
+
+	wmb();
+
+	return 0;
+}
+
 static int nvmap_validate_get_pin_array(struct nvmap_client *client,
 					const struct nvmap_pinarray_elem *arr,
 					int nr, struct nvmap_handle **h)
@@ -522,7 +585,7 @@ int nvmap_pin_array(struct nvmap_client *client, struct nvmap_handle *gather,
 			nvmap_handle_put(unique_arr[i]);
 
 		for (i = 0; i < pinned; i++)
-			do_wake |= handle_unpin(client, unique_arr[i]);
+			do_wake |= handle_unpin(client, unique_arr[i], false);
 
 		if (do_wake)
 			wake_up(&client->share->pin_wait);
@@ -590,10 +653,12 @@ unsigned long nvmap_handle_address(struct nvmap_client *c, unsigned long id)
 void nvmap_unpin(struct nvmap_client *client, struct nvmap_handle_ref *ref)
 {
 	atomic_dec(&ref->pin);
-	if (handle_unpin(client, ref->handle))
+	if (handle_unpin(client, ref->handle, false))
 		wake_up(&client->share->pin_wait);
 }
 
+/* releases the pins taken by nvmap_pin_array once the submit which used
+ * them has completed; IOVMM handles stay lazily pinned, see nvmap_mru.c */
 void nvmap_unpin_handles(struct nvmap_client *client,
 			 struct nvmap_handle **h, int nr)
 {
@@ -603,7 +668,7 @@ void nvmap_unpin_handles(struct nvmap_client *client,
 	for (i = 0; i < nr; i++) {
 		if (WARN_ON(!h[i]))
 			continue;
-		do_wake |= handle_unpin(client, h[i]);
+		do_wake |= handle_unpin(client, h[i], true);
 	}
 
 	if (do_wake)
@@ -676,6 +741,12 @@ void *nvmap_mmap(struct nvmap_handle_ref *ref)
 		return NULL;
 	}
 
+	/* vm areas this size are 64K aligned, so large carveout buffers get
+	 * large pages whenever their physical base is aligned too */
+	if (adj_size >= SZ_64K)
+		remap_kernel_large_pages((unsigned long)v->addr,
+					 (unsigned long)v->addr + adj_size);
+
 	/* leave the handle ref count incremented by 1, so that
 	 * the handle will not be freed while the kernel mapping exists.
 	 * nvmap_handle_put will be called by unmapping this address */
@@ -49,6 +49,7 @@
 
 #define nvmap_ref_to_id(_ref)		((unsigned long)(_ref)->handle)
 
+struct dentry;
 struct nvmap_device;
 struct page;
 struct tegra_iovmm_area;
@@ -61,6 +62,11 @@ struct nvmap_pgalloc {
 	struct list_head mru_list;	/* MRU entry for IOVMM reclamation */
 	bool contig;			/* contiguous system memory */
 	bool dirty;			/* area is invalid and needs mapping */
+#ifdef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
+	bool mru_protected;		/* on the protected MRU segment */
+	unsigned int mru_hits;		/* re-pins served from the MRU */
+	bool lazy_pin;			/* one pin is held by the lazy list */
+#endif
 };
 
 struct nvmap_handle {
@@ -84,14 +90,31 @@ struct nvmap_handle {
 	struct mutex lock;
 };
 
+struct nvmap_mru_stats {
+	unsigned long hits;		/* re-pins that kept their area */
+	unsigned long steals;		/* areas handed over without a free */
+	unsigned long evictions;	/* areas freed to make space */
+	unsigned long long evicted_bytes;
+	unsigned long demotions;	/* protected -> probation moves */
+	unsigned long remaps;		/* areas (re)filled with pages */
+	unsigned long long remap_bytes;
+	unsigned long lazy_pins;	/* final unpins kept pinned */
+	unsigned long lazy_drops;	/* lazy pins dropped under pressure */
+};
+
 struct nvmap_share {
 	struct tegra_iovmm_client *iovmm;
 	wait_queue_head_t pin_wait;
 	struct mutex pin_lock;
 #ifdef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
 	spinlock_t mru_lock;
-	struct list_head *mru_lists;
-	int nr_mru;
+	struct list_head mru_probation;
+	struct list_head mru_protected;
+	size_t mru_probation_size;
+	size_t mru_protected_size;
+	struct list_head mru_lazy;
+	size_t mru_lazy_size;
+	struct nvmap_mru_stats mru_stats;
 #endif
 };
 
@@ -201,6 +224,8 @@ void nvmap_unpin_ids(struct nvmap_client *priv,
 
 void _nvmap_handle_free(struct nvmap_handle *h);
 
+void nvmap_page_pool_init(struct dentry *debug_root);
+
 int nvmap_handle_remove(struct nvmap_device *dev, struct nvmap_handle *h);
 
 void nvmap_handle_add(struct nvmap_device *dev, struct nvmap_handle *h);
@@ -36,6 +36,7 @@
 #include <linux/vmalloc.h>
 
 #include <asm/cacheflush.h>
+#include <asm/sizes.h>
 #include <asm/tlbflush.h>
 
 #include <mach/iovmm.h>
@@ -46,6 +47,9 @@
 #include "nvmap_mru.h"
 #include "nvmap_common.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/nvmap.h>
+
 #define NVMAP_NUM_PTES		64
 #define NVMAP_CARVEOUT_KILLER_RETRY_TIME 100 /* msecs */
 
@@ -863,6 +867,10 @@ static long nvmap_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		err = nvmap_ioctl_cache_maint(filp, uarg);
 		break;
 
+	case NVMAP_IOC_CACHE_LIST:
+		err = nvmap_ioctl_cache_maint_list(filp, uarg);
+		break;
+
 	default:
 		return -ENOTTY;
 	}
@@ -922,10 +930,25 @@ static int nvmap_vma_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 		return VM_FAULT_SIGBUS;
 
 	if (!priv->handle->heap_pgalloc) {
-		unsigned long pfn;
+		unsigned long addr = (unsigned long)vmf->virtual_address;
+		unsigned long start, end, pfn;
 		BUG_ON(priv->handle->carveout->base & ~PAGE_MASK);
 		pfn = ((priv->handle->carveout->base + offs) >> PAGE_SHIFT);
-		vm_insert_pfn(vma, (unsigned long)vmf->virtual_address, pfn);
+		vm_insert_pfn(vma, addr, pfn);
+
+		/* carveouts are contiguous: fill in the rest of the 64K
+		 * block, so walking a buffer takes one fault per block
+		 * instead of one per page */
+		start = addr & ~(SZ_64K - 1);
+		if (addr - start > offs)
+			start = addr - offs;
+		start = max(start, vma->vm_start);
+		end = min(ALIGN(addr + 1, SZ_64K), vma->vm_end);
+		end = min(end, addr + PAGE_ALIGN(priv->handle->size - offs));
+		pfn -= (addr - start) >> PAGE_SHIFT;
+		for (; start < end; start += PAGE_SIZE, pfn++)
+			if (start != addr)
+				vm_insert_pfn(vma, start, pfn);
 		return VM_FAULT_NOPAGE;
 	} else {
 		struct page *page;
@@ -1173,6 +1196,9 @@ static int nvmap_probe(struct platform_device *pdev)
 	if (IS_ERR_OR_NULL(nvmap_debug_root))
 		dev_err(&pdev->dev, "couldn't create debug files\n");
 
+	nvmap_page_pool_init(nvmap_debug_root);
+	nvmap_mru_debugfs_init(&dev->iovmm_master, nvmap_debug_root);
+
 	for (i = 0; i < plat->nr_carveouts; i++) {
 		struct nvmap_carveout_node *node = &dev->heaps[i];
 		const struct nvmap_platform_carveout *co = &plat->carveouts[i];
@@ -20,13 +20,18 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <linux/debugfs.h>
 #include <linux/err.h>
+#include <linux/highmem.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/mm.h>
 #include <linux/rbtree.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 #include <asm/cacheflush.h>
 #include <asm/outercache.h>
@@ -35,6 +40,8 @@
 #include <mach/iovmm.h>
 #include <mach/nvmap.h>
 
+#include <trace/events/nvmap.h>
+
 #include "nvmap.h"
 #include "nvmap_mru.h"
 #include "nvmap_common.h"
@@ -108,6 +115,215 @@ out:
 
 extern void __flush_dcache_page(struct address_space *, struct page *);
 
+/* page pools of zeroed pages that are already clean in the inner and outer
+ * caches, one per cache attribute. allocations drop below the low watermark
+ * kick a background refill up to the high watermark; the shrinker hands
+ * pages back under memory pressure. */
+enum {
+	NVMAP_POOL_UC,
+	NVMAP_POOL_WC,
+	NVMAP_POOL_IC,
+	NVMAP_NUM_POOLS,
+};
+
+#define NVMAP_POOL_LOW_DEFAULT	128
+#define NVMAP_POOL_HIGH_DEFAULT	512
+#define NVMAP_POOL_REFILL_GFP	(GFP_NVMAP | __GFP_NORETRY | __GFP_NOMEMALLOC)
+
+struct nvmap_page_pool {
+	spinlock_t lock;
+	struct list_head pages;		/* linked through page->lru */
+	u32 count;
+	u32 low;
+	u32 high;
+	unsigned long hits;
+	unsigned long misses;
+	const char *name;
+	struct work_struct refill;
+};
+
+static struct nvmap_page_pool nvmap_pools[NVMAP_NUM_POOLS];
+static bool nvmap_pools_ready;
+
+static const char *nvmap_pool_names[NVMAP_NUM_POOLS] = {
+	[NVMAP_POOL_UC] = "uc",
+	[NVMAP_POOL_WC] = "wc",
+	[NVMAP_POOL_IC] = "iwb",
+};
+
+static struct nvmap_page_pool *nvmap_handle_pool(struct nvmap_handle *h)
+{
+	if (!nvmap_pools_ready)
+		return NULL;
+
+	switch (h->flags) {
+	case NVMAP_HANDLE_UNCACHEABLE:
+		return &nvmap_pools[NVMAP_POOL_UC];
+	case NVMAP_HANDLE_WRITE_COMBINE:
+		return &nvmap_pools[NVMAP_POOL_WC];
+	case NVMAP_HANDLE_INNER_CACHEABLE:
+		return &nvmap_pools[NVMAP_POOL_IC];
+	default:
+		return NULL;
+	}
+}
+
+/* takes up to nr pages from the pool into pages[], returns how many */
+static unsigned int nvmap_page_pool_alloc(struct nvmap_page_pool *pool,
+					  struct page **pages, unsigned int nr)
+{
+	unsigned int i = 0;
+	bool refill;
+
+	spin_lock(&pool->lock);
+	while (i < nr && !list_empty(&pool->pages)) {
+		struct page *page = list_first_entry(&pool->pages,
+						     struct page, lru);
+		list_del(&page->lru);
+		pages[i++] = page;
+	}
+	pool->count -= i;
+	pool->hits += i;
+	pool->misses += nr - i;
+	refill = pool->count < pool->low;
+	spin_unlock(&pool->lock);
+
+	if (refill)
+		schedule_work(&pool->refill);
+
+	return i;
+}
+
+static void nvmap_page_pool_refill(struct work_struct *work)
+{
+	struct nvmap_page_pool *pool;
+	unsigned long base;
+	struct page *page;
+
+	pool = container_of(work, struct nvmap_page_pool, refill);
+
+	while (ACCESS_ONCE(pool->count) < ACCESS_ONCE(pool->high)) {
+		page = alloc_page(NVMAP_POOL_REFILL_GFP);
+		if (!page)
+			break;
+
+		clear_highpage(page);
+		__flush_dcache_page(page_mapping(page), page);
+		base = page_to_phys(page);
+		outer_flush_range(base, base + PAGE_SIZE);
+
+		spin_lock(&pool->lock);
+		list_add_tail(&page->lru, &pool->pages);
+		pool->count++;
+		spin_unlock(&pool->lock);
+
+		cond_resched();
+	}
+}
+
+static int nvmap_page_pool_shrink(struct shrinker *shrinker, int nr_to_scan,
+				  gfp_t gfp_mask)
+{
+	unsigned int total = 0;
+	int i;
+
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		struct nvmap_page_pool *pool = &nvmap_pools[i];
+		struct page *page;
+
+		spin_lock(&pool->lock);
+		while (nr_to_scan > 0 && !list_empty(&pool->pages)) {
+			page = list_first_entry(&pool->pages, struct page, lru);
+			list_del(&page->lru);
+			pool->count--;
+			spin_unlock(&pool->lock);
+
+			__free_page(page);
+			nr_to_scan--;
+
+			spin_lock(&pool->lock);
+		}
+		total += pool->count;
+		spin_unlock(&pool->lock);
+	}
+
+	return total;
+}
+
+static struct shrinker nvmap_page_pool_shrinker = {
+	.shrink = nvmap_page_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int nvmap_page_pool_stats_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_printf(s, "%-6s%10s%10s%10s%12s%12s\n",
+		   "pool", "pages", "low", "high", "hits", "misses");
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		struct nvmap_page_pool *pool = &nvmap_pools[i];
+
+		spin_lock(&pool->lock);
+		seq_printf(s, "%-6s%10u%10u%10u%12lu%12lu\n", pool->name,
+			   pool->count, pool->low, pool->high,
+			   pool->hits, pool->misses);
+		spin_unlock(&pool->lock);
+	}
+
+	return 0;
+}
+
+static int nvmap_page_pool_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvmap_page_pool_stats_show, inode->i_private);
+}
+
+static const struct file_operations nvmap_page_pool_stats_fops = {
+	.open = nvmap_page_pool_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void nvmap_page_pool_init(struct dentry *debug_root)
+{
+	struct dentry *pool_root = NULL;
+	int i;
+
+	if (!IS_ERR_OR_NULL(debug_root)) {
+		pool_root = debugfs_create_dir("pagepool", debug_root);
+		if (!IS_ERR_OR_NULL(pool_root))
+			debugfs_create_file("stats", 0444, pool_root, NULL,
+					    &nvmap_page_pool_stats_fops);
+	}
+
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		struct nvmap_page_pool *pool = &nvmap_pools[i];
+
+		spin_lock_init(&pool->lock);
+		INIT_LIST_HEAD(&pool->pages);
+		INIT_WORK(&pool->refill, nvmap_page_pool_refill);
+		pool->name = nvmap_pool_names[i];
+		pool->low = NVMAP_POOL_LOW_DEFAULT;
+		pool->high = NVMAP_POOL_HIGH_DEFAULT;
+
+		if (!IS_ERR_OR_NULL(pool_root)) {
+			struct dentry *d = debugfs_create_dir(pool->name,
+							      pool_root);
+			if (!IS_ERR_OR_NULL(d)) {
+				debugfs_create_u32("low", 0644, d, &pool->low);
+				debugfs_create_u32("high", 0644, d,
+						   &pool->high);
+			}
+		}
+		schedule_work(&pool->refill);
+	}
+
+	register_shrinker(&nvmap_page_pool_shrinker);
+	nvmap_pools_ready = true;
+}
+
 static struct page *nvmap_alloc_pages_exact(gfp_t gfp,
 	size_t size, bool flush_inner)
 {
@@ -147,6 +363,7 @@ static int handle_page_alloc(struct nvmap_client *client,
 	pgprot_t prot;
 	unsigned int i = 0;
 	struct page **pages;
+	struct nvmap_page_pool *pool = nvmap_handle_pool(h);
 	bool flush_inner = true;
 
 	pages = altalloc(nr_page * sizeof(*pages));
@@ -160,13 +377,22 @@ static int handle_page_alloc(struct nvmap_client *client,
 		contiguous = true;
 #endif
 
-	if (size >= FLUSH_CLEAN_BY_SET_WAY_THRESHOLD) {
+	/* single pages come from the pool when it has them; only what is
+	 * left to allocate counts against the set/way flush threshold */
+	if (pool && (!contiguous || nr_page == 1))
+		i = nvmap_page_pool_alloc(pool, pages, nr_page);
+
+	if (((nr_page - i) << PAGE_SHIFT) >= FLUSH_CLEAN_BY_SET_WAY_THRESHOLD) {
 		inner_flush_cache_all();
 		flush_inner = false;
 	}
 	h->pgalloc.area = NULL;
 	if (contiguous) {
 		struct page *page;
+
+		if (i == nr_page)
+			goto done;
+
 		page = nvmap_alloc_pages_exact(GFP_NVMAP, size, flush_inner);
 		if (!page)
 			goto fail;
@@ -175,7 +401,7 @@ static int handle_page_alloc(struct nvmap_client *client,
 			pages[i] = nth_page(page, i);
 
 	} else {
-		for (i = 0; i < nr_page; i++) {
+		for (; i < nr_page; i++) {
 			pages[i] = nvmap_alloc_pages_exact(GFP_NVMAP, PAGE_SIZE,
 				flush_inner);
 			if (!pages[i])
@@ -192,7 +418,7 @@ static int handle_page_alloc(struct nvmap_client *client,
 #endif
 	}
 
-
+done:
 	h->size = size;
 	h->pgalloc.pages = pages;
 	h->pgalloc.contig = contiguous;
@@ -348,6 +574,7 @@ int nvmap_alloc_handle_id(struct nvmap_client *client,
 
 out:
 	err = (h->alloc) ? 0 : err;
+	trace_nvmap_alloc(h, h->size, h->flags, h->heap_pgalloc, err);
 	nvmap_handle_put(h);
 	return err;
 }
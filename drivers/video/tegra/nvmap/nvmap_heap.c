@@ -23,11 +23,14 @@
 #include <linux/device.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/err.h>
+#include <linux/workqueue.h>
 
+#include <mach/nvhost.h>
 #include <mach/nvmap.h>
 #include "nvmap.h"
 #include "nvmap_heap.h"
@@ -144,8 +147,21 @@ struct nvmap_heap {
 	const char *name;
 	void *arg;
 	struct device dev;
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	struct delayed_work compact_work;
+#endif
 };
 
+/* background compaction: wait this long after a free before looking at the
+ * heap, retry this often while the GPU is busy, and move at most this many
+ * blocks per step so that allocations never wait long on the heap lock. */
+#define NVMAP_COMPACT_DELAY		(2 * HZ)
+#define NVMAP_COMPACT_BUSY_DELAY	(HZ / 2)
+#define NVMAP_COMPACT_STEP_DELAY	(HZ / 50)
+#define NVMAP_COMPACT_STEP_BLOCKS	4
+/* fragmentation index (per mille) above which the heap is compacted */
+#define NVMAP_COMPACT_FRAG_THRESHOLD	250
+
 static struct kmem_cache *buddy_heap_cache;
 static struct kmem_cache *block_cache;
 
@@ -220,6 +236,15 @@ static unsigned long heap_stat(struct nvmap_heap *heap, struct heap_stat *stat)
 	return base;
 }
 
+/* fragmentation index: per mille of free space that is not in the largest
+ * free block; 0 means all free space is contiguous */
+static unsigned int heap_fragmentation(size_t free, size_t free_largest)
+{
+	if (!free)
+		return 0;
+	return 1000 - (unsigned int)div_u64((u64)free_largest * 1000, free);
+}
+
 static ssize_t heap_name_show(struct device *dev,
 			      struct device_attribute *attr, char *buf);
 
@@ -247,6 +272,9 @@ static struct device_attribute heap_stat_free_size =
 static struct device_attribute heap_stat_base =
 	__ATTR(base, S_IRUGO, heap_stat_show, NULL);
 
+static struct device_attribute heap_stat_fragmentation =
+	__ATTR(fragmentation, S_IRUGO, heap_stat_show, NULL);
+
 static struct device_attribute heap_attr_name =
 	__ATTR(name, S_IRUGO, heap_name_show, NULL);
 
@@ -258,6 +286,7 @@ static struct attribute *heap_stat_attrs[] = {
 	&heap_stat_free_count.attr,
 	&heap_stat_free_size.attr,
 	&heap_stat_base.attr,
+	&heap_stat_fragmentation.attr,
 	&heap_attr_name.attr,
 	NULL,
 };
@@ -297,6 +326,9 @@ static ssize_t heap_stat_show(struct device *dev,
 		return sprintf(buf, "%u\n", stat.free);
 	else if (attr == &heap_stat_base)
 		return sprintf(buf, "%08lx\n", base);
+	else if (attr == &heap_stat_fragmentation)
+		return sprintf(buf, "%u\n",
+			       heap_fragmentation(stat.free, stat.free_largest));
 	else
 		return -EINVAL;
 }
@@ -759,8 +791,12 @@ fail:
 	return heap_block_new;
 }
 
-static void nvmap_heap_compact(struct nvmap_heap *heap,
-				size_t requested_size, bool fast)
+/* relocates blocks towards the heap base until a free block of
+ * requested_size exists (fast only), or max_relocations blocks have moved
+ * (if non-zero); returns the number of blocks relocated */
+static int nvmap_heap_compact(struct nvmap_heap *heap,
+			      size_t requested_size, bool fast,
+			      int max_relocations)
 {
 	struct list_block *block_current = NULL;
 	struct list_block *block_prev = NULL;
@@ -786,6 +822,9 @@ static void nvmap_heap_compact(struct nvmap_heap *heap,
 		if (fast && block_current->size >= requested_size)
 			break;
 
+		if (max_relocations && relocation_count >= max_relocations)
+			break;
+
 		/* relocate prev block */
 		if (ptr_prev != &heap->all_list) {
 
@@ -821,7 +860,46 @@ static void nvmap_heap_compact(struct nvmap_heap *heap,
 		}
 		ptr = ptr_next;
 	}
-	pr_err("Relocated %d chunks\n", relocation_count);
+	return relocation_count;
+}
+
+/* free-list fragmentation, ignoring buddy sub-heaps, which are never
+ * relocated; must be called while holding the heap's lock */
+static unsigned int heap_fragmentation_locked(struct nvmap_heap *heap)
+{
+	struct list_block *l;
+	size_t free = 0, free_largest = 0;
+
+	list_for_each_entry(l, &heap->free_list, free_list) {
+		free += l->size;
+		free_largest = max(l->size, free_largest);
+	}
+	return heap_fragmentation(free, free_largest);
+}
+
+/* background compaction, run while host1x is idle. each step moves a few
+ * blocks under the heap lock and then lets allocations in again. */
+static void nvmap_heap_compact_worker(struct work_struct *work)
+{
+	struct nvmap_heap *heap = container_of(to_delayed_work(work),
+					       struct nvmap_heap, compact_work);
+	int moved = 0;
+
+	if (!nvhost_is_idle()) {
+		schedule_delayed_work(&heap->compact_work,
+				      NVMAP_COMPACT_BUSY_DELAY);
+		return;
+	}
+
+	mutex_lock(&heap->lock);
+	if (heap_fragmentation_locked(heap) > NVMAP_COMPACT_FRAG_THRESHOLD)
+		moved = nvmap_heap_compact(heap, 0, false,
+					   NVMAP_COMPACT_STEP_BLOCKS);
+	mutex_unlock(&heap->lock);
+
+	if (moved)
+		schedule_delayed_work(&heap->compact_work,
+				      NVMAP_COMPACT_STEP_DELAY);
 }
 #endif
 
@@ -859,11 +937,13 @@ struct nvmap_heap_block *nvmap_heap_alloc(struct nvmap_heap *h, size_t len,
 	b = do_heap_alloc(h, len, align, prot, 0);
 	if (!b) {
 		pr_err("Compaction triggered!\n");
-		nvmap_heap_compact(h, len, true);
+		pr_err("Relocated %d chunks\n",
+		       nvmap_heap_compact(h, len, true, 0));
 		b = do_heap_alloc(h, len, align, prot, 0);
 		if (!b) {
 			pr_err("Full compaction triggered!\n");
-			nvmap_heap_compact(h, len, false);
+			pr_err("Relocated %d chunks\n",
+			       nvmap_heap_compact(h, len, false, 0));
 			b = do_heap_alloc(h, len, align, prot, 0);
 		}
 	}
@@ -928,6 +1008,10 @@ void nvmap_heap_free(struct nvmap_heap_block *b)
 		kmem_cache_free(buddy_heap_cache, bh);
 	} else
 		mutex_unlock(&h->lock);
+
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	schedule_delayed_work(&h->compact_work, NVMAP_COMPACT_DELAY);
+#endif
 }
 
 
@@ -1013,6 +1097,9 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 	INIT_LIST_HEAD(&h->buddy_list);
 	INIT_LIST_HEAD(&h->all_list);
 	mutex_init(&h->lock);
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	INIT_DELAYED_WORK(&h->compact_work, nvmap_heap_compact_worker);
+#endif
 	l->block.base = base;
 	l->block.type = BLOCK_EMPTY;
 	l->size = len;
@@ -1050,6 +1137,10 @@ void nvmap_heap_destroy(struct nvmap_heap *heap)
 {
 	WARN_ON(!list_empty(&heap->buddy_list));
 
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	cancel_delayed_work_sync(&heap->compact_work);
+#endif
+
 	sysfs_remove_group(&heap->dev.kobj, &heap_stat_attr_group);
 	device_unregister(&heap->dev);
 
@@ -33,6 +33,8 @@
 #include <mach/iovmm.h>
 #include <mach/nvmap.h>
 
+#include <trace/events/nvmap.h>
+
 #include "nvmap_ioctl.h"
 #include "nvmap.h"
 #include "nvmap_common.h"
@@ -488,14 +490,16 @@ static void inner_cache_maint(unsigned int op, void *vaddr, size_t size)
 		dmac_map_area(vaddr, size, DMA_TO_DEVICE);
 }
 
+/* the L2 sync is left to the end of the whole request, see cache_maint()
+ * and nvmap_ioctl_cache_maint_list() */
 static void outer_cache_maint(unsigned int op, unsigned long paddr, size_t size)
 {
 	if (op == NVMAP_CACHE_OP_WB_INV)
-		outer_flush_range(paddr, paddr + size);
+		outer_flush_range_nosync(paddr, paddr + size);
 	else if (op == NVMAP_CACHE_OP_INV)
-		outer_inv_range(paddr, paddr + size);
+		outer_inv_range_nosync(paddr, paddr + size);
 	else
-		outer_clean_range(paddr, paddr + size);
+		outer_clean_range_nosync(paddr, paddr + size);
 }
 
 static void heap_page_cache_maint(struct nvmap_client *client,
@@ -560,13 +564,33 @@ out:
 	return ret;
 }
 
+/* inner maintenance of the carveout range [start, end), given as physical
+ * addresses, one page at a time through the scratch pte */
+static void carveout_inner_cache_maint(unsigned long start, unsigned long end,
+	unsigned int op, pte_t **pte, unsigned long kaddr, pgprot_t prot)
+{
+	unsigned long loop = start;
+
+	while (loop < end) {
+		unsigned long next = (loop + PAGE_SIZE) & PAGE_MASK;
+		void *base = (void *)kaddr + (loop & ~PAGE_MASK);
+		next = min(next, end);
+
+		set_pte_at(&init_mm, kaddr, *pte,
+			   pfn_pte(__phys_to_pfn(loop), prot));
+		flush_tlb_kernel_page(kaddr);
+
+		inner_cache_maint(op, base, next - loop);
+		loop = next;
+	}
+}
+
 static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
 		       unsigned long start, unsigned long end, unsigned int op)
 {
 	pgprot_t prot;
 	pte_t **pte = NULL;
 	unsigned long kaddr;
-	unsigned long loop;
 	int err = 0;
 
 	h = nvmap_handle_get(h);
@@ -578,6 +602,8 @@ static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
 		goto out;
 	}
 
+	trace_nvmap_cache_op(h, start, end, op);
+
 	if (h->flags == NVMAP_HANDLE_UNCACHEABLE ||
 	    h->flags == NVMAP_HANDLE_WRITE_COMBINE ||
 	    start == end)
@@ -612,20 +638,7 @@ static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
 	start += h->carveout->base;
 	end += h->carveout->base;
 
-	loop = start;
-
-	while (loop < end) {
-		unsigned long next = (loop + PAGE_SIZE) & PAGE_MASK;
-		void *base = (void *)kaddr + (loop & ~PAGE_MASK);
-		next = min(next, end);
-
-		set_pte_at(&init_mm, kaddr, *pte,
-			   pfn_pte(__phys_to_pfn(loop), prot));
-		flush_tlb_kernel_page(kaddr);
-
-		inner_cache_maint(op, base, next - loop);
-		loop = next;
-	}
+	carveout_inner_cache_maint(start, end, op, pte, kaddr, prot);
 
 	if (h->flags != NVMAP_HANDLE_INNER_CACHEABLE)
 		outer_cache_maint(op, start, end - start);
@@ -634,6 +647,7 @@ static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
 	nvmap_usecount_dec(h);
 
 out:
+	outer_sync();
 	if (pte)
 		nvmap_free_pte(client->dev, pte);
 	nvmap_handle_put(h);
@@ -641,6 +655,209 @@ out:
 	return err;
 }
 
+#define NVMAP_CACHE_LIST_MAX	1024
+
+/* physically contiguous outer cache operations are merged into one run, so
+ * that the L2 is walked (and synced) once per run instead of once per page
+ * and list entry */
+struct outer_batch {
+	unsigned int op;
+	unsigned long start;
+	unsigned long end;
+};
+
+static void outer_batch_flush(struct outer_batch *b)
+{
+	if (b->end > b->start)
+		outer_cache_maint(b->op, b->start, b->end - b->start);
+	b->start = b->end = 0;
+}
+
+static void outer_batch_add(struct outer_batch *b, unsigned int op,
+			    unsigned long paddr, size_t size)
+{
+	if (b->end > b->start && b->op == op && b->end == paddr) {
+		b->end += size;
+		return;
+	}
+	outer_batch_flush(b);
+	b->op = op;
+	b->start = paddr;
+	b->end = paddr + size;
+}
+
+static void cache_maint_list_entry(struct nvmap_handle *h,
+	unsigned long start, unsigned long end, unsigned int op, bool inner,
+	struct outer_batch *batch, pte_t **pte, unsigned long kaddr)
+{
+	pgprot_t prot = nvmap_pgprot(h, pgprot_kernel);
+	bool outer = h->flags != NVMAP_HANDLE_INNER_CACHEABLE;
+
+	if (h->heap_pgalloc) {
+		if (inner)
+			heap_page_cache_maint(NULL, h, start, end, op, true,
+					      false, pte, kaddr, prot);
+		while (outer && start < end) {
+			struct page *page = h->pgalloc.pages[start >> PAGE_SHIFT];
+			unsigned long next;
+
+			next = min(((start + PAGE_SIZE) & PAGE_MASK), end);
+			outer_batch_add(batch, op, page_to_phys(page) +
+					(start & ~PAGE_MASK), next - start);
+			start = next;
+		}
+		return;
+	}
+
+	/* lock carveout from relocation by mapcount */
+	nvmap_usecount_inc(h);
+	start += h->carveout->base;
+	end += h->carveout->base;
+	if (inner)
+		carveout_inner_cache_maint(start, end, op, pte, kaddr, prot);
+	if (outer)
+		outer_batch_add(batch, op, start, end - start);
+	nvmap_usecount_dec(h);
+}
+
+/* vectored cache maintenance. entries are processed in the order given;
+ * neighbouring entries for the same handle and operation whose regions
+ * touch are merged first. if there is no invalidate in the list and the
+ * cacheable bytes to clean pass FLUSH_CLEAN_BY_SET_WAY_THRESHOLD, the inner
+ * cache is cleaned (or flushed) as a whole once instead of by range. */
+int nvmap_ioctl_cache_maint_list(struct file *filp, void __user *arg)
+{
+	struct nvmap_client *client = filp->private_data;
+	struct nvmap_cache_op_list op;
+	struct nvmap_cache_op_entry *ops;
+	struct nvmap_handle **handles;
+	struct outer_batch batch = { 0 };
+	unsigned long inner_bytes = 0;
+	bool any_inv = false, any_flush = false, whole;
+	pte_t **pte = NULL;
+	unsigned long kaddr = 0;
+	unsigned int i, n;
+	int err = 0;
+
+	if (copy_from_user(&op, arg, sizeof(op)))
+		return -EFAULT;
+
+	if (!op.count)
+		return 0;
+	if (op.count > NVMAP_CACHE_LIST_MAX)
+		return -EINVAL;
+
+	ops = kmalloc(op.count * sizeof(*ops), GFP_KERNEL);
+	handles = kzalloc(op.count * sizeof(*handles), GFP_KERNEL);
+	if (!ops || !handles) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	if (copy_from_user(ops, (void __user *)op.ops,
+			   op.count * sizeof(*ops))) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	/* coalesce touching regions of consecutive entries */
+	for (i = 1, n = 0; i < op.count; i++) {
+		struct nvmap_cache_op_entry *cur = &ops[n];
+		struct nvmap_cache_op_entry *next = &ops[i];
+
+		if (next->handle == cur->handle && next->op == cur->op &&
+		    next->offset >= cur->offset &&
+		    next->offset <= cur->offset + cur->len) {
+			cur->len = max(cur->len,
+				       next->offset + next->len - cur->offset);
+			continue;
+		}
+		ops[++n] = *next;
+	}
+	n++;
+
+	for (i = 0; i < n; i++) {
+		struct nvmap_handle *h;
+
+		if (!ops[i].handle || ops[i].op < NVMAP_CACHE_OP_WB ||
+		    ops[i].op > NVMAP_CACHE_OP_WB_INV) {
+			err = -EINVAL;
+			goto out;
+		}
+
+		h = nvmap_validate_get(client, ops[i].handle);
+		if (!h) {
+			err = -EPERM;
+			goto out;
+		}
+		handles[i] = h;
+
+		if (!h->alloc) {
+			err = -EFAULT;
+			goto out;
+		}
+		if (ops[i].offset > h->size ||
+		    ops[i].len > h->size - ops[i].offset) {
+			nvmap_warn(client, "cache maintenance outside handle\n");
+			err = -EINVAL;
+			goto out;
+		}
+
+		if (h->flags == NVMAP_HANDLE_UNCACHEABLE ||
+		    h->flags == NVMAP_HANDLE_WRITE_COMBINE)
+			continue;
+
+		if (ops[i].op == NVMAP_CACHE_OP_INV)
+			any_inv = true;
+		else
+			inner_bytes += ops[i].len;
+		if (ops[i].op == NVMAP_CACHE_OP_WB_INV)
+			any_flush = true;
+	}
+
+	whole = !any_inv && inner_bytes >= FLUSH_CLEAN_BY_SET_WAY_THRESHOLD;
+	if (whole) {
+		if (any_flush)
+			inner_flush_cache_all();
+		else
+			inner_clean_cache_all();
+	} else {
+		pte = nvmap_alloc_pte(client->dev, (void **)&kaddr);
+		if (IS_ERR(pte)) {
+			err = PTR_ERR(pte);
+			pte = NULL;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		struct nvmap_handle *h = handles[i];
+
+		if (h->flags == NVMAP_HANDLE_UNCACHEABLE ||
+		    h->flags == NVMAP_HANDLE_WRITE_COMBINE || !ops[i].len)
+			continue;
+
+		cache_maint_list_entry(h, ops[i].offset,
+				       ops[i].offset + ops[i].len, ops[i].op,
+				       !whole, &batch, pte, kaddr);
+	}
+	outer_batch_flush(&batch);
+	outer_sync();
+
+out:
+	if (pte)
+		nvmap_free_pte(client->dev, pte);
+	if (handles) {
+		for (i = 0; i < op.count; i++)
+			if (handles[i])
+				nvmap_handle_put(handles[i]);
+	}
+	kfree(handles);
+	kfree(ops);
+	wmb();
+	return err;
+}
+
 static int rw_handle_page(struct nvmap_handle *h, int is_read,
 			  unsigned long start, unsigned long rw_addr,
 			  unsigned long bytes, unsigned long kaddr, pte_t *pte)
@@ -95,6 +95,18 @@ struct nvmap_cache_op {
 	__s32 op;
 };
 
+struct nvmap_cache_op_entry {
+	__u32 handle;
+	__u32 offset;		/* offset into hmem */
+	__u32 len;
+	__s32 op;
+};
+
+struct nvmap_cache_op_list {
+	unsigned long ops;	/* array of struct nvmap_cache_op_entry */
+	__u32 count;		/* number of entries in ops */
+};
+
 #define NVMAP_IOC_MAGIC 'N'
 
 /* Creates a new memory handle. On input, the argument is the size of the new
@@ -134,7 +146,11 @@ struct nvmap_cache_op {
  * reference to the same handle */
 #define NVMAP_IOC_GET_ID  _IOWR(NVMAP_IOC_MAGIC, 13, struct nvmap_create_handle)
 
-#define NVMAP_IOC_MAXNR (_IOC_NR(NVMAP_IOC_GET_ID))
+/* Performs cache maintenance on a list of (handle, offset, length) regions,
+ * in order, with a single outer cache sync at the end */
+#define NVMAP_IOC_CACHE_LIST _IOW(NVMAP_IOC_MAGIC, 14, struct nvmap_cache_op_list)
+
+#define NVMAP_IOC_MAXNR (_IOC_NR(NVMAP_IOC_CACHE_LIST))
 
 int nvmap_ioctl_pinop(struct file *filp, bool is_pin, void __user *arg);
 
@@ -152,6 +168,8 @@ int nvmap_map_into_caller_ptr(struct file *filp, void __user *arg);
 
 int nvmap_ioctl_cache_maint(struct file *filp, void __user *arg);
 
+int nvmap_ioctl_cache_maint_list(struct file *filp, void __user *arg);
+
 int nvmap_ioctl_rw_handle(struct file *filp, int is_read, void __user* arg);
 
 
@@ -20,7 +20,9 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <linux/debugfs.h>
 #include <linux/list.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 
 #include <asm/pgtable.h>
@@ -31,29 +33,46 @@
 #include "nvmap_mru.h"
 
 /* if IOVMM reclamation is enabled (CONFIG_NVMAP_RECLAIM_UNPINNED_VM),
- * unpinned handles are placed onto a most-recently-used eviction list;
- * multiple lists are maintained, segmented by size (sizes were chosen to
- * roughly correspond with common sizes for graphics surfaces).
+ * unpinned handles keep their IOVMM area and are placed onto an eviction
+ * list; if a handle is located on one of these lists, then the code below
+ * may steal its IOVMM area at any time to satisfy a pin operation if no
+ * free IOVMM space is available.
  *
- * if a handle is located on the MRU list, then the code below may
- * steal its IOVMM area at any time to satisfy a pin operation if no
- * free IOVMM space is available
+ * the lists form a segmented LRU: a handle unpinned for the first time since
+ * it got its area goes to the head of the probation list; a handle that has
+ * been re-pinned from the lists at least once goes to the protected list,
+ * which is capped at half of the IOVMM space and demotes its oldest entries
+ * back to probation. victims are taken from the tail (oldest) of probation
+ * first, and an area of about the right size is preferred over freeing one
+ * area after another, so that textures cycled by an app do not keep pushing
+ * out each other's mappings.
+ *
+ * when the host driver releases the last pin of a handle after its submit
+ * has completed, the pin is not dropped but handed over to the lazy list:
+ * the handle stays pinned with its area mapped, so the next submit which
+ * references it only bumps the pin count. lazy pins are dropped, oldest
+ * first, only once both unpinned lists are empty, or when the handle is
+ * freed.
  */
 
-static const size_t mru_cutoff[] = {
-	262144, 393216, 786432, 1048576, 1572864
-};
+/* how many of the oldest entries to inspect for a reusable area */
+#define MRU_FIT_SCAN	8
 
-static inline struct list_head *mru_list(struct nvmap_share *share, size_t size)
+static inline size_t mru_len(struct nvmap_handle *h)
 {
-	unsigned int i;
-
-	BUG_ON(!share->mru_lists);
-	for (i = 0; i < ARRAY_SIZE(mru_cutoff); i++)
-		if (size <= mru_cutoff[i])
-			break;
+	return h->pgalloc.area->iovm_length;
+}
 
-	return &share->mru_lists[i];
+static void mru_del_locked(struct nvmap_share *share, struct nvmap_handle *h)
+{
+	if (h->pgalloc.lazy_pin)
+		share->mru_lazy_size -= mru_len(h);
+	else if (h->pgalloc.mru_protected)
+		share->mru_protected_size -= mru_len(h);
+	else
+		share->mru_probation_size -= mru_len(h);
+	list_del(&h->pgalloc.mru_list);
+	INIT_LIST_HEAD(&h->pgalloc.mru_list);
 }
 
 size_t nvmap_mru_vm_size(struct tegra_iovmm_client *iovmm)
@@ -65,38 +84,103 @@ size_t nvmap_mru_vm_size(struct tegra_iovmm_client *iovmm)
 /*  nvmap_mru_vma_lock should be acquired by the caller before calling this */
 void nvmap_mru_insert_locked(struct nvmap_share *share, struct nvmap_handle *h)
 {
-	size_t len = h->pgalloc.area->iovm_length;
-	list_add(&h->pgalloc.mru_list, mru_list(share, len));
+	size_t max = tegra_iovmm_get_vm_size(share->iovmm) / 2;
+
+	if (!h->pgalloc.mru_hits) {
+		h->pgalloc.mru_protected = false;
+		list_add(&h->pgalloc.mru_list, &share->mru_probation);
+		share->mru_probation_size += mru_len(h);
+		return;
+	}
+
+	h->pgalloc.mru_protected = true;
+	list_add(&h->pgalloc.mru_list, &share->mru_protected);
+	share->mru_protected_size += mru_len(h);
+
+	while (share->mru_protected_size > max) {
+		struct nvmap_handle *old;
+
+		old = list_entry(share->mru_protected.prev,
+				 struct nvmap_handle, pgalloc.mru_list);
+		mru_del_locked(share, old);
+		old->pgalloc.mru_hits = 0;
+		old->pgalloc.mru_protected = false;
+		list_add(&old->pgalloc.mru_list, &share->mru_probation);
+		share->mru_probation_size += mru_len(old);
+		share->mru_stats.demotions++;
+	}
+}
+
+/* called instead of dropping the final pin of h; returns true if the pin
+ * is now held by the lazy list. must hold the mru lock */
+bool nvmap_mru_pin_lazy_locked(struct nvmap_share *s, struct nvmap_handle *h)
+{
+	if (!h->heap_pgalloc || !h->pgalloc.area || h->secure ||
+	    h->pgalloc.lazy_pin)
+		return false;
+
+	h->pgalloc.lazy_pin = true;
+	list_add(&h->pgalloc.mru_list, &s->mru_lazy);
+	s->mru_lazy_size += mru_len(h);
+	s->mru_stats.lazy_pins++;
+	return true;
 }
 
 void nvmap_mru_remove(struct nvmap_share *s, struct nvmap_handle *h)
 {
 	nvmap_mru_lock(s);
 	if (!list_empty(&h->pgalloc.mru_list))
-		list_del(&h->pgalloc.mru_list);
+		mru_del_locked(s, h);
+	h->pgalloc.lazy_pin = false;
 	nvmap_mru_unlock(s);
 	INIT_LIST_HEAD(&h->pgalloc.mru_list);
 }
 
+void nvmap_mru_account_remap(struct nvmap_share *s, size_t len)
+{
+	nvmap_mru_lock(s);
+	s->mru_stats.remaps++;
+	s->mru_stats.remap_bytes += len;
+	nvmap_mru_unlock(s);
+}
+
+/* finds the oldest of the oldest few areas on list that can hold len bytes
+ * without wasting more than as much again; must hold the mru lock */
+static struct nvmap_handle *mru_find_fit(struct list_head *list, size_t len)
+{
+	struct nvmap_handle *h;
+	int scanned = 0;
+
+	list_for_each_entry_reverse(h, list, pgalloc.mru_list) {
+		size_t area = mru_len(h);
+
+		if (area >= len && area / 2 <= len)
+			return h;
+		if (++scanned == MRU_FIT_SCAN)
+			break;
+	}
+
+	return NULL;
+}
+
 /* returns a tegra_iovmm_area for a handle. if the handle already has
  * an iovmm_area allocated, the handle is simply removed from its MRU list
  * and the existing iovmm_area is returned.
  *
  * if no existing allocation exists, try to allocate a new IOVMM area.
  *
- * if a new area can not be allocated, try to re-use the most-recently-unpinned
- * handle's allocation.
+ * if a new area can not be allocated, try to re-use a similarly-sized area
+ * among the oldest unpinned handles, probation before protected.
  *
- * and if that fails, iteratively evict handles from the MRU lists and free
- * their allocations, until the new allocation succeeds.
+ * and if that fails, iteratively evict the oldest handles and free their
+ * allocations, until the new allocation succeeds.
  */
 struct tegra_iovmm_area *nvmap_handle_iovmm(struct nvmap_client *c,
 					    struct nvmap_handle *h)
 {
-	struct list_head *mru;
+	struct nvmap_share *share = c->share;
 	struct nvmap_handle *evict = NULL;
 	struct tegra_iovmm_area *vm = NULL;
-	unsigned int i, idx;
 	pgprot_t prot;
 
 	BUG_ON(!h || !c || !c->share);
@@ -107,88 +191,142 @@ struct tegra_iovmm_area *nvmap_handle_iovmm(struct nvmap_client *c,
 		/* since this is only called inside the pin lock, and the
 		 * handle is gotten before it is pinned, there are no races
 		 * where h->pgalloc.area is changed after the comparison */
-		nvmap_mru_lock(c->share);
+		nvmap_mru_lock(share);
 		BUG_ON(list_empty(&h->pgalloc.mru_list));
-		list_del(&h->pgalloc.mru_list);
-		INIT_LIST_HEAD(&h->pgalloc.mru_list);
-		nvmap_mru_unlock(c->share);
+		mru_del_locked(share, h);
+		if (h->pgalloc.mru_hits < UINT_MAX)
+			h->pgalloc.mru_hits++;
+		share->mru_stats.hits++;
+		nvmap_mru_unlock(share);
 		return h->pgalloc.area;
 	}
 
-	vm = tegra_iovmm_create_vm(c->share->iovmm, NULL, h->size, prot);
+	h->pgalloc.mru_hits = 0;
+	vm = tegra_iovmm_create_vm(share->iovmm, NULL, h->size, prot);
 
 	if (vm) {
 		INIT_LIST_HEAD(&h->pgalloc.mru_list);
 		return vm;
 	}
-	/* attempt to re-use the most recently unpinned IOVMM area in the
-	 * same size bin as the current handle. If that fails, iteratively
-	 * evict handles (starting from the current bin) until an allocation
-	 * succeeds or no more areas can be evicted */
-
-	nvmap_mru_lock(c->share);
-	mru = mru_list(c->share, h->size);
-	if (!list_empty(mru))
-		evict = list_first_entry(mru, struct nvmap_handle,
-					 pgalloc.mru_list);
-
-	if (evict && evict->pgalloc.area->iovm_length >= h->size) {
-		list_del(&evict->pgalloc.mru_list);
+
+	nvmap_mru_lock(share);
+	evict = mru_find_fit(&share->mru_probation, h->size);
+	if (!evict)
+		evict = mru_find_fit(&share->mru_protected, h->size);
+
+	if (evict) {
+		mru_del_locked(share, evict);
 		vm = evict->pgalloc.area;
 		evict->pgalloc.area = NULL;
-		INIT_LIST_HEAD(&evict->pgalloc.mru_list);
-		nvmap_mru_unlock(c->share);
+		share->mru_stats.steals++;
+		nvmap_mru_unlock(share);
 		return vm;
 	}
 
-	idx = mru - c->share->mru_lists;
-
-	for (i = 0; i < c->share->nr_mru && !vm; i++, idx++) {
-		if (idx >= c->share->nr_mru)
-			idx = 0;
-		mru = &c->share->mru_lists[idx];
-		while (!list_empty(mru) && !vm) {
-			evict = list_first_entry(mru, struct nvmap_handle,
-						 pgalloc.mru_list);
-
-			BUG_ON(atomic_read(&evict->pin) != 0);
-			BUG_ON(!evict->pgalloc.area);
-			list_del(&evict->pgalloc.mru_list);
-			INIT_LIST_HEAD(&evict->pgalloc.mru_list);
-			nvmap_mru_unlock(c->share);
-			tegra_iovmm_free_vm(evict->pgalloc.area);
-			evict->pgalloc.area = NULL;
-			vm = tegra_iovmm_create_vm(c->share->iovmm,
-						   NULL, h->size, prot);
-			nvmap_mru_lock(c->share);
+	while (!vm) {
+		struct list_head *list = &share->mru_probation;
+
+		if (list_empty(list))
+			list = &share->mru_protected;
+		if (list_empty(list))
+			list = &share->mru_lazy;
+		if (list_empty(list))
+			break;
+
+		evict = list_entry(list->prev, struct nvmap_handle,
+				   pgalloc.mru_list);
+
+		if (evict->pgalloc.lazy_pin) {
+			/* pins are only taken inside the pin lock, which
+			 * the caller holds, and only dropped inside the
+			 * mru lock; if a submit still has the handle
+			 * pinned, it simply loses its lazy pin */
+			mru_del_locked(share, evict);
+			evict->pgalloc.lazy_pin = false;
+			share->mru_stats.lazy_drops++;
+			if (!atomic_dec_and_test(&evict->pin))
+				continue;
+		} else {
+			mru_del_locked(share, evict);
 		}
+
+		BUG_ON(atomic_read(&evict->pin) != 0);
+		BUG_ON(!evict->pgalloc.area);
+		share->mru_stats.evictions++;
+		share->mru_stats.evicted_bytes += evict->pgalloc.area->iovm_length;
+		nvmap_mru_unlock(share);
+		tegra_iovmm_free_vm(evict->pgalloc.area);
+		evict->pgalloc.area = NULL;
+		vm = tegra_iovmm_create_vm(share->iovmm, NULL, h->size, prot);
+		nvmap_mru_lock(share);
 	}
-	nvmap_mru_unlock(c->share);
+	nvmap_mru_unlock(share);
 	return vm;
 }
 
-int nvmap_mru_init(struct nvmap_share *share)
+static int mru_stats_show(struct seq_file *s, void *unused)
 {
-	int i;
-	spin_lock_init(&share->mru_lock);
-	share->nr_mru = ARRAY_SIZE(mru_cutoff) + 1;
+	struct nvmap_share *share = s->private;
+	struct nvmap_mru_stats stats;
+	size_t probation, protected, lazy;
 
-	share->mru_lists = kzalloc(sizeof(struct list_head) * share->nr_mru,
-				   GFP_KERNEL);
+	nvmap_mru_lock(share);
+	stats = share->mru_stats;
+	probation = share->mru_probation_size;
+	protected = share->mru_protected_size;
+	lazy = share->mru_lazy_size;
+	nvmap_mru_unlock(share);
 
-	if (!share->mru_lists)
-		return -ENOMEM;
+	seq_printf(s, "probation bytes:  %zu\n", probation);
+	seq_printf(s, "protected bytes:  %zu\n", protected);
+	seq_printf(s, "lazy pinned bytes: %zu\n", lazy);
+	seq_printf(s, "hits:             %lu\n", stats.hits);
+	seq_printf(s, "steals:           %lu\n", stats.steals);
+	seq_printf(s, "evictions:        %lu\n", stats.evictions);
+	seq_printf(s, "evicted bytes:    %llu\n", stats.evicted_bytes);
+	seq_printf(s, "demotions:        %lu\n", stats.demotions);
+	seq_printf(s, "remaps:           %lu\n", stats.remaps);
+	seq_printf(s, "remapped bytes:   %llu\n", stats.remap_bytes);
+	seq_printf(s, "lazy pins:        %lu\n", stats.lazy_pins);
+	seq_printf(s, "lazy pin drops:   %lu\n", stats.lazy_drops);
+	return 0;
+}
 
-	for (i = 0; i <= share->nr_mru; i++)
-		INIT_LIST_HEAD(&share->mru_lists[i]);
+static int mru_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mru_stats_show, inode->i_private);
+}
 
+static const struct file_operations mru_stats_fops = {
+	.open = mru_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void nvmap_mru_debugfs_init(struct nvmap_share *share, struct dentry *root)
+{
+	if (!IS_ERR_OR_NULL(root))
+		debugfs_create_file("iovmm_mru", 0444, root, share,
+				    &mru_stats_fops);
+}
+
+int nvmap_mru_init(struct nvmap_share *share)
+{
+	spin_lock_init(&share->mru_lock);
+	INIT_LIST_HEAD(&share->mru_probation);
+	INIT_LIST_HEAD(&share->mru_protected);
+	INIT_LIST_HEAD(&share->mru_lazy);
+	share->mru_probation_size = 0;
+	share->mru_protected_size = 0;
+	share->mru_lazy_size = 0;
+	memset(&share->mru_stats, 0, sizeof(share->mru_stats));
 	return 0;
 }
 
 void nvmap_mru_destroy(struct nvmap_share *share)
 {
-	if (share->mru_lists)
-		kfree(share->mru_lists);
-
-	share->mru_lists = NULL;
+	WARN_ON(!list_empty(&share->mru_probation));
+	WARN_ON(!list_empty(&share->mru_protected));
+	WARN_ON(!list_empty(&share->mru_lazy));
 }
@@ -28,6 +28,7 @@
 
 #include "nvmap.h"
 
+struct dentry;
 struct tegra_iovmm_area;
 struct tegra_iovmm_client;
 
@@ -53,6 +54,17 @@ void nvmap_mru_insert_locked(struct nvmap_share *share, struct nvmap_handle *h);
 
 void nvmap_mru_remove(struct nvmap_share *s, struct nvmap_handle *h);
 
+void nvmap_mru_account_remap(struct nvmap_share *s, size_t len);
+
+bool nvmap_mru_pin_lazy_locked(struct nvmap_share *s, struct nvmap_handle *h);
+
+static inline bool nvmap_handle_lazy_pinned(struct nvmap_handle *h)
+{
+	return h->heap_pgalloc && h->pgalloc.lazy_pin;
+}
+
+void nvmap_mru_debugfs_init(struct nvmap_share *share, struct dentry *root);
+
 struct tegra_iovmm_area *nvmap_handle_iovmm(struct nvmap_client *c,
 					    struct nvmap_handle *h);
 
@@ -72,6 +84,11 @@ static inline void nvmap_mru_remove(struct nvmap_share *s,
                                     struct nvmap_handle *h)
 { }
 
+#define nvmap_mru_account_remap(_s, _l)	do { } while (0)
+#define nvmap_mru_pin_lazy_locked(_s, _h)	false
+#define nvmap_handle_lazy_pinned(_h)	false
+#define nvmap_mru_debugfs_init(_s, _r)	do { } while (0)
+
 static inline struct tegra_iovmm_area *nvmap_handle_iovmm(struct nvmap_client *c,
 							  struct nvmap_handle *h)
 {
@@ -200,6 +200,31 @@ static struct dentry *d_kill(struct dentry *dentry)
  * Real recursion would eat up our stack space.
  */
 
+/*
+ * Drop the last reference to a dentry that stays cached: hashed, on
+ * the LRU already and without ->d_delete().  Only the count changes,
+ * and d_lock is enough for that: unhashing and __d_lookup() both take
+ * it, so the dentry can be neither dropped nor found in between.
+ * This keeps dcache_lock out of path walks through cached (positive
+ * or negative) dentries nobody else holds, which is most of them.
+ *
+ * Returns 0 if dput() must take the slow path.
+ */
+static inline int dput_cached(struct dentry *dentry)
+{
+	int ret = 0;
+
+	spin_lock(&dentry->d_lock);
+	if (atomic_read(&dentry->d_count) == 1 &&
+	    !(dentry->d_op && dentry->d_op->d_delete) &&
+	    !d_unhashed(dentry) && !list_empty(&dentry->d_lru)) {
+		atomic_dec(&dentry->d_count);
+		ret = 1;
+	}
+	spin_unlock(&dentry->d_lock);
+	return ret;
+}
+
 /*
  * dput - release a dentry
  * @dentry: dentry to release 
@@ -220,6 +245,10 @@ void dput(struct dentry *dentry)
 repeat:
 	if (atomic_read(&dentry->d_count) == 1)
 		might_sleep();
+	if (atomic_add_unless(&dentry->d_count, -1, 1))
+		return;
+	if (dput_cached(dentry))
+		return;
 	if (!atomic_dec_and_lock(&dentry->d_count, &dcache_lock))
 		return;
 
@@ -83,6 +83,12 @@
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
 
+/*
+ * Set in epitem->revents when the item became ready without the wakeup
+ * telling which events, so they have to be found with ->poll()
+ */
+#define EP_REVENTS_POLL (1U << 31)
+
 struct epoll_filefd {
 	struct file *file;
 	int fd;
@@ -141,6 +147,13 @@ struct epitem {
 
 	/* The structure that describe the interested events and the source fd */
 	struct epoll_event event;
+
+	/*
+	 * Events reported by the wakeups since the item entered the ready
+	 * list, or EP_REVENTS_POLL. Protected by "ep->lock" while the item
+	 * is on the ready list.
+	 */
+	unsigned int revents;
 };
 
 /*
@@ -492,6 +505,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 		 */
 		if (!ep_is_linked(&epi->rdllink))
 			list_add_tail(&epi->rdllink, &ep->rdllist);
+		epi->revents |= EP_REVENTS_POLL;
 	}
 	/*
 	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
@@ -785,7 +799,7 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
-	int pwake = 0;
+	int pwake = 0, was_empty;
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
@@ -824,18 +838,30 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 		goto out_unlock;
 	}
 
+	/* Remember what happened, so harvesting can skip ->poll() */
+	if (key)
+		epi->revents |= (unsigned long) key & epi->event.events;
+	else
+		epi->revents |= EP_REVENTS_POLL;
+
 	/* If this file is already in the ready list we exit soon */
+	was_empty = list_empty(&ep->rdllist);
 	if (!ep_is_linked(&epi->rdllink))
 		list_add_tail(&epi->rdllink, &ep->rdllist);
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * wait list. If the ready list was not empty, the waiter woken when it
+	 * was filled has not collected it yet and will collect this event
+	 * too, so back-to-back callbacks cost a single wake up. Another
+	 * wake up here would only reach a second waiter, for nothing.
 	 */
-	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
-	if (waitqueue_active(&ep->poll_wait))
-		pwake++;
+	if (was_empty) {
+		if (waitqueue_active(&ep->wq))
+			wake_up_locked(&ep->wq);
+		if (waitqueue_active(&ep->poll_wait))
+			pwake++;
+	}
 
 out_unlock:
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -913,6 +939,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	epi->ep = ep;
 	ep_set_ffd(&epi->ffd, tfile, fd);
 	epi->event = *event;
+	epi->revents = 0;
 	epi->nwait = 0;
 	epi->next = EP_UNACTIVE_PTR;
 
@@ -955,6 +982,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	/* If the file is already "ready" we drop it inside the ready list */
 	if ((revents & event->events) && !ep_is_linked(&epi->rdllink)) {
 		list_add_tail(&epi->rdllink, &ep->rdllist);
+		epi->revents |= EP_REVENTS_POLL;
 
 		/* Notify waiting tasks that events are available */
 		if (waitqueue_active(&ep->wq))
@@ -1023,6 +1051,7 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 		spin_lock_irq(&ep->lock);
 		if (!ep_is_linked(&epi->rdllink)) {
 			list_add_tail(&epi->rdllink, &ep->rdllist);
+			epi->revents |= EP_REVENTS_POLL;
 
 			/* Notify waiting tasks that events are available */
 			if (waitqueue_active(&ep->wq))
@@ -1060,8 +1089,19 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 
 		list_del_init(&epi->rdllink);
 
-		revents = epi->ffd.file->f_op->poll(epi->ffd.file, NULL) &
-			epi->event.events;
+		/*
+		 * Edge triggered items woken with the events in the key
+		 * report those: the caller reads until EAGAIN anyway, so
+		 * polling the file again would only confirm them.
+		 */
+		if ((epi->event.events & EPOLLET) && epi->revents &&
+		    !(epi->revents & EP_REVENTS_POLL))
+			revents = epi->revents & epi->event.events;
+		else
+			revents = epi->ffd.file->f_op->poll(epi->ffd.file,
+							    NULL) &
+				epi->event.events;
+		epi->revents = 0;
 
 		/*
 		 * If the event mask intersect the caller-requested one,
@@ -1092,6 +1132,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 				 * poll callback will queue them in ep->ovflist.
 				 */
 				list_add_tail(&epi->rdllink, &ep->rdllist);
+				epi->revents = EP_REVENTS_POLL;
 			}
 		}
 	}
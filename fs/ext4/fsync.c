@@ -115,7 +115,12 @@ int ext4_sync_file(struct file *file, int datasync)
 		return ext4_force_commit(inode->i_sb);
 
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
-	if (jbd2_log_start_commit(journal, commit_tid)) {
+	/*
+	 * A commit requested by someone else may be held back to batch
+	 * more fsyncs into it, wait for it as well.
+	 */
+	if (jbd2_log_start_commit(journal, commit_tid) ||
+	    !jbd2_log_commit_done(journal, commit_tid)) {
 		/*
 		 * When the journal is on a different device than the
 		 * fs data disk, we need to issue the barrier in
@@ -2040,8 +2040,13 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 			ac->ac_2order = i - 1;
 	}
 
-	/* if stream allocation is enabled, use global goal */
-	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
+	/*
+	 * if stream allocation is enabled, use global goal; but a file
+	 * being written sequentially keeps searching from its own goal,
+	 * past its last extent, rather than interleave with other streams
+	 */
+	if ((ac->ac_flags & EXT4_MB_STREAM_ALLOC) &&
+	    !EXT4_I(ac->ac_inode)->i_stream_window) {
 		/* TBD: may be hot point */
 		spin_lock(&sbi->s_md_lock);
 		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
@@ -2453,6 +2458,7 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
+	sbi->s_mb_stream_prealloc_max = MB_DEFAULT_STREAM_PREALLOC_MAX;
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
@@ -2836,6 +2842,36 @@ static void ext4_mb_normalize_group_request(struct ext4_allocation_context *ac)
 		current->pid, ac->ac_g_ex.fe_len);
 }
 
+/*
+ * A file that keeps allocating right where its last allocation ended is
+ * written as a stream: grow its prealloc window, doubling each time up
+ * to s_mb_stream_prealloc_max, so that it is laid out in large extents
+ * even when other files are written at the same time.  Any other
+ * allocation resets the window.
+ */
+static void ext4_mb_stream_window(struct ext4_allocation_context *ac,
+				  ext4_lblk_t *start, loff_t *size)
+{
+	struct ext4_inode_info *ei = EXT4_I(ac->ac_inode);
+	unsigned int max, window;
+
+	max = min_t(unsigned int, EXT4_SB(ac->ac_sb)->s_mb_stream_prealloc_max,
+		    EXT4_BLOCKS_PER_GROUP(ac->ac_sb));
+	if (!max || ac->ac_o_ex.fe_logical != ei->i_stream_next) {
+		ei->i_stream_window = 0;
+		return;
+	}
+
+	window = max_t(unsigned int, ei->i_stream_window * 2, *size);
+	window = min(window, max);
+	ei->i_stream_window = window;
+	if (window <= *size)
+		return;
+
+	*start = ac->ac_o_ex.fe_logical;
+	*size = window;
+}
+
 /*
  * Normalization means making request better in terms of
  * size and alignment
@@ -2923,6 +2959,9 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 	size = size >> bsbits;
 	start = start_off >> bsbits;
 
+	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC)
+		ext4_mb_stream_window(ac, &start, &size);
+
 	/* don't cover already allocated blocks in selected range */
 	if (ar->pleft && start <= ar->lleft) {
 		size -= ar->lleft + 1 - start;
@@ -4350,6 +4389,9 @@ repeat:
 		else {
 			block = ext4_grp_offs_to_block(sb, &ac->ac_b_ex);
 			ar->len = ac->ac_b_ex.fe_len;
+			if (ar->flags & EXT4_MB_HINT_DATA)
+				EXT4_I(ar->inode)->i_stream_next =
+					ar->logical + ar->len;
 		}
 	} else {
 		freed  = ext4_mb_discard_preallocations(sb, ac->ac_o_ex.fe_len);
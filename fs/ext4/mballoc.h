@@ -84,6 +84,13 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_STREAM_THRESHOLD	16	/* 64K */
 
+/*
+ * ceiling of the inode prealloc window of a file written sequentially;
+ * the window doubles with each allocation that continues the file.
+ * Tune via /sys/fs/ext4/<partition>/mb_stream_prealloc_max, 0 disables
+ */
+#define MB_DEFAULT_STREAM_PREALLOC_MAX	4096	/* 16M */
+
 /*
  * for which requests use 2^N search using buddies
  */
@@ -802,6 +802,8 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	memset(&ei->i_cached_extent, 0, sizeof(struct ext4_ext_cache));
 	INIT_LIST_HEAD(&ei->i_prealloc_list);
 	spin_lock_init(&ei->i_prealloc_lock);
+	ei->i_stream_next = 0;
+	ei->i_stream_window = 0;
 	/*
 	 * Note:  We can be called before EXT4_SB(sb)->s_journal is set,
 	 * therefore it can be null here.  Don't check it, just initialize
@@ -1000,6 +1002,8 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	 */
 	seq_puts(seq, ",barrier=");
 	seq_puts(seq, test_opt(sb, BARRIER) ? "1" : "0");
+	if (test_opt(sb, RELIABLE_NOBARRIER))
+		seq_puts(seq, ",reliable_nobarrier");
 	if (test_opt(sb, JOURNAL_ASYNC_COMMIT))
 		seq_puts(seq, ",journal_async_commit");
 	else if (test_opt(sb, JOURNAL_CHECKSUM))
@@ -1213,7 +1217,8 @@ enum {
 	Opt_data_err_abort, Opt_data_err_ignore,
 	Opt_usrjquota, Opt_grpjquota, Opt_offusrjquota, Opt_offgrpjquota,
 	Opt_jqfmt_vfsold, Opt_jqfmt_vfsv0, Opt_jqfmt_vfsv1, Opt_quota,
-	Opt_noquota, Opt_ignore, Opt_barrier, Opt_nobarrier, Opt_err,
+	Opt_noquota, Opt_ignore, Opt_barrier, Opt_nobarrier,
+	Opt_reliable_nobarrier, Opt_noreliable_nobarrier, Opt_err,
 	Opt_resize, Opt_usrquota, Opt_grpquota, Opt_i_version,
 	Opt_stripe, Opt_delalloc, Opt_nodelalloc,
 	Opt_block_validity, Opt_noblock_validity,
@@ -1274,6 +1279,8 @@ static const match_table_t tokens = {
 	{Opt_barrier, "barrier=%u"},
 	{Opt_barrier, "barrier"},
 	{Opt_nobarrier, "nobarrier"},
+	{Opt_reliable_nobarrier, "reliable_nobarrier"},
+	{Opt_noreliable_nobarrier, "noreliable_nobarrier"},
 	{Opt_i_version, "i_version"},
 	{Opt_stripe, "stripe=%u"},
 	{Opt_resize, "resize"},
@@ -1658,6 +1665,12 @@ set_qf_format:
 		case Opt_nobarrier:
 			clear_opt(sbi->s_mount_opt, BARRIER);
 			break;
+		case Opt_reliable_nobarrier:
+			set_opt(sbi->s_mount_opt, RELIABLE_NOBARRIER);
+			break;
+		case Opt_noreliable_nobarrier:
+			clear_opt(sbi->s_mount_opt, RELIABLE_NOBARRIER);
+			break;
 		case Opt_barrier:
 			if (args[0].from) {
 				if (match_int(&args[0], &option))
@@ -2395,6 +2408,7 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_stream_prealloc_max, s_mb_stream_prealloc_max);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 
 static struct attribute *ext4_attrs[] = {
@@ -2409,6 +2423,7 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_stream_prealloc_max),
 	ATTR_LIST(max_writeback_mb_bump),
 	NULL,
 };
@@ -3249,7 +3264,9 @@ static void ext4_init_journal_params(struct super_block *sb, journal_t *journal)
 	journal->j_max_batch_time = sbi->s_max_batch_time;
 
 	write_lock(&journal->j_state_lock);
-	if (test_opt(sb, BARRIER))
+	if (test_opt(sb, BARRIER) &&
+	    !(test_opt(sb, RELIABLE_NOBARRIER) &&
+	      jbd2_journal_reliable_write(journal)))
 		journal->j_flags |= JBD2_BARRIER;
 	else
 		journal->j_flags &= ~JBD2_BARRIER;
@@ -221,6 +221,9 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 	const int limit = sb->s_maxbytes >> MSDOS_SB(sb)->cluster_bits;
 	struct fat_entry fatent;
 	struct fat_cache_id cid;
+	/* the walk may ask for FAT_ENT_EOF, bound readahead by the size */
+	int nr_alloc = inode->i_blocks >> (MSDOS_SB(sb)->cluster_bits - 9);
+	sector_t reada_end = 0;
 	int nr;
 
 	BUG_ON(MSDOS_I(inode)->i_start == 0);
@@ -240,6 +243,8 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 
 	fatent_init(&fatent);
 	while (*fclus < cluster) {
+		fat_ent_reada_chain(sb, *dclus, min(cluster, nr_alloc) - *fclus,
+				    &reada_end);
 		/* prevent the infinite loop of cluster chain */
 		if (*fclus > limit) {
 			fat_fs_error_ratelimit(sb,
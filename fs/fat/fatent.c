@@ -7,6 +7,8 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/blkdev.h>
+#include <linux/bitmap.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -434,6 +436,71 @@ static inline int fat_ent_read_block(struct super_block *sb,
 	return ops->ent_bread(sb, fatent, offset, blocknr);
 }
 
+/*
+ * The free cluster bitmap covers entries below free_map_scanned while
+ * it is being built, and all of them once free_map_valid is set.
+ * Called with fat_lock held.
+ */
+static inline void fat_free_map_mark(struct msdos_sb_info *sbi, int entry,
+				     int used)
+{
+	if (!sbi->free_map || entry >= sbi->free_map_scanned)
+		return;
+	if (used)
+		__set_bit(entry, sbi->free_map);
+	else
+		__clear_bit(entry, sbi->free_map);
+}
+
+/* Writes that have allocated this many clusters get contiguous runs */
+#define FAT_ALLOC_RUN		16
+
+/*
+ * Pick a free cluster from the bitmap: the one following the inode's
+ * last allocation if possible, else the start of a free run large
+ * enough for the request (or FAT_ALLOC_RUN clusters for a large file),
+ * else any free cluster after prev_free.
+ */
+static int fat_free_map_find(struct inode *inode, int goal, int nr_cluster)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(inode->i_sb);
+	unsigned long max = sbi->max_cluster;
+	unsigned long start, entry;
+	int run = nr_cluster;
+
+	if (goal >= FAT_START_ENT && goal < max &&
+	    !test_bit(goal, sbi->free_map))
+		return goal;
+
+	if (MSDOS_I(inode)->mmu_private >=
+	    ((loff_t)FAT_ALLOC_RUN << sbi->cluster_bits))
+		run = max(run, FAT_ALLOC_RUN);
+
+	start = sbi->prev_free + 1;
+	if (start >= max)
+		start = FAT_START_ENT;
+
+	if (run > 1) {
+		entry = bitmap_find_next_zero_area(sbi->free_map, max, start,
+						   run, 0);
+		if (entry < max)
+			return entry;
+		entry = bitmap_find_next_zero_area(sbi->free_map, max,
+						   FAT_START_ENT, run, 0);
+		if (entry < max)
+			return entry;
+	}
+
+	entry = find_next_zero_bit(sbi->free_map, max, start);
+	if (entry < max)
+		return entry;
+	entry = find_next_zero_bit(sbi->free_map, max, FAT_START_ENT);
+	if (entry < max)
+		return entry;
+
+	return -ENOSPC;
+}
+
 static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 			    struct fat_entry *fatent)
 {
@@ -474,6 +541,47 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	count = FAT_START_ENT;
 	fatent_init(&prev_ent);
 	fatent_init(&fatent);
+
+	if (sbi->free_map_valid) {
+		int goal = MSDOS_I(inode)->i_alloc_goal;
+
+		while (idx_clus < nr_cluster) {
+			int entry = fat_free_map_find(inode, goal,
+						      nr_cluster - idx_clus);
+			if (entry < 0)
+				goto nospc;
+
+			err = fat_ent_read(inode, &fatent, entry);
+			if (err < 0)
+				goto out;
+			__set_bit(entry, sbi->free_map);
+			goal = entry + 1;
+			if (err != FAT_ENT_FREE) {
+				/* the FAT was changed behind our back */
+				err = 0;
+				continue;
+			}
+			err = 0;
+
+			ops->ent_put(&fatent, FAT_ENT_EOF);
+			if (prev_ent.nr_bhs)
+				ops->ent_put(&prev_ent, entry);
+
+			fat_collect_bhs(bhs, &nr_bhs, &fatent);
+
+			sbi->prev_free = entry;
+			if (sbi->free_clusters != -1)
+				sbi->free_clusters--;
+			sb->s_dirt = 1;
+
+			cluster[idx_clus] = entry;
+			idx_clus++;
+			MSDOS_I(inode)->i_alloc_goal = goal;
+			prev_ent = fatent;
+		}
+		goto out;
+	}
+
 	fatent_set_entry(&fatent, sbi->prev_free + 1);
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
@@ -494,6 +602,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 					ops->ent_put(&prev_ent, entry);
 
 				fat_collect_bhs(bhs, &nr_bhs, &fatent);
+				fat_free_map_mark(sbi, entry, 1);
 
 				sbi->prev_free = entry;
 				if (sbi->free_clusters != -1)
@@ -502,6 +611,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 
 				cluster[idx_clus] = entry;
 				idx_clus++;
+				MSDOS_I(inode)->i_alloc_goal = entry + 1;
 				if (idx_clus == nr_cluster)
 					goto out;
 
@@ -517,6 +627,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 		} while (fat_ent_next(sbi, &fatent));
 	}
 
+nospc:
 	/* Couldn't allocate the free entries */
 	sbi->free_clusters = 0;
 	sbi->free_clus_valid = 1;
@@ -550,11 +661,14 @@ int fat_free_clusters(struct inode *inode, int cluster)
 	struct buffer_head *bhs[MAX_BUF_PER_PAGE];
 	int i, err, nr_bhs;
 	int first_cl = cluster;
+	int nr_left = inode->i_blocks >> (sbi->cluster_bits - 9);
+	sector_t reada_end = 0;
 
 	nr_bhs = 0;
 	fatent_init(&fatent);
 	lock_fat(sbi);
 	do {
+		fat_ent_reada_chain(sb, cluster, nr_left--, &reada_end);
 		cluster = fat_ent_read(inode, &fatent, cluster);
 		if (cluster < 0) {
 			err = cluster;
@@ -584,6 +698,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		fat_free_map_mark(sbi, fatent.entry, 0);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
@@ -638,6 +753,45 @@ static void fat_ent_reada(struct super_block *sb, struct fat_entry *fatent,
 		sb_breadahead(sb, blocknr + i);
 }
 
+/* Chain walks shorter than this read the FAT one block at a time */
+#define FAT_READA_CHAIN_MIN	256
+
+/*
+ * Read ahead the FAT blocks a chain walk of nr_entries clusters from
+ * entry is likely to need, assuming the chain is mostly contiguous.
+ * *reada_end is the block after the last one read ahead by the
+ * previous call for the same walk (0 initially).
+ */
+void fat_ent_reada_chain(struct super_block *sb, int entry, int nr_entries,
+			 sector_t *reada_end)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	unsigned long reada_blocks, nr_blocks;
+	sector_t blocknr, fat_end;
+	int i, offset;
+
+	if (nr_entries < FAT_READA_CHAIN_MIN ||
+	    entry < FAT_START_ENT || entry >= sbi->max_cluster)
+		return;
+
+	sbi->fatent_ops->ent_blocknr(sb, entry, &offset, &blocknr);
+	/* start the next window when the walk reaches the end of this one */
+	if (blocknr + 1 < *reada_end)
+		return;
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+	nr_blocks = ((unsigned long)nr_entries * sbi->fat_bits / 8 >>
+		     sb->s_blocksize_bits) + 1;
+	nr_blocks = min(nr_blocks, reada_blocks);
+	fat_end = sbi->fat_start + sbi->fat_length;
+	if (blocknr + nr_blocks > fat_end)
+		nr_blocks = fat_end - blocknr;
+
+	for (i = 0; i < nr_blocks; i++)
+		sb_breadahead(sb, blocknr + i);
+	*reada_end = blocknr + nr_blocks;
+}
+
 int fat_count_free_clusters(struct super_block *sb)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -682,3 +836,90 @@ out:
 	unlock_fat(sbi);
 	return err;
 }
+
+/* Larger volumes (in clusters) fall back to scanning the FAT */
+#define FAT_FREE_MAP_MAX	(32 * 1024 * 1024)
+
+/*
+ * Build the free cluster bitmap in the background, 128kb of FAT at a
+ * time with fat_lock held, so allocations in between only wait for one
+ * chunk.  Allocations and frees keep the already scanned part up to
+ * date, and the bitmap is used once the whole FAT has been scanned.
+ */
+static void fat_free_map_build(struct work_struct *work)
+{
+	struct msdos_sb_info *sbi = container_of(work, struct msdos_sb_info,
+						 free_map_work);
+	struct super_block *sb = sbi->fat_inode->i_sb;
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks, nr_blocks;
+	sector_t reada_end = 0;
+	int err = 0;
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+
+	lock_fat(sbi);
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, sbi->free_map_scanned);
+	fat_ent_reada_chain(sb, fatent.entry,
+			    sbi->max_cluster - fatent.entry, &reada_end);
+	for (nr_blocks = 0; nr_blocks < reada_blocks &&
+		     fatent.entry < sbi->max_cluster; nr_blocks++) {
+		err = fat_ent_read_block(sb, &fatent);
+		if (err)
+			break;
+		do {
+			if (ops->ent_get(&fatent) != FAT_ENT_FREE)
+				__set_bit(fatent.entry, sbi->free_map);
+		} while (fat_ent_next(sbi, &fatent));
+		sbi->free_map_scanned = fatent.entry;
+	}
+	fatent_brelse(&fatent);
+
+	if (err) {
+		/* leave the bitmap unused, alloc and free stop updating it */
+		sbi->free_map_scanned = 0;
+	} else if (sbi->free_map_scanned >= sbi->max_cluster) {
+		sbi->free_map_scanned = sbi->max_cluster;
+		sbi->free_map_valid = 1;
+		sbi->free_clusters = sbi->max_cluster -
+			bitmap_weight(sbi->free_map, sbi->max_cluster);
+		sbi->free_clus_valid = 1;
+		sb->s_dirt = 1;
+	} else {
+		schedule_work(&sbi->free_map_work);
+	}
+	unlock_fat(sbi);
+}
+
+void fat_free_map_init(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	if ((sb->s_flags & MS_RDONLY) || sbi->max_cluster > FAT_FREE_MAP_MAX)
+		return;
+
+	sbi->free_map = vmalloc(BITS_TO_LONGS(sbi->max_cluster) *
+				sizeof(unsigned long));
+	if (!sbi->free_map)
+		return;
+	bitmap_zero(sbi->free_map, sbi->max_cluster);
+	/* the reserved entries are never free */
+	bitmap_set(sbi->free_map, 0, FAT_START_ENT);
+	sbi->free_map_scanned = FAT_START_ENT;
+
+	INIT_WORK(&sbi->free_map_work, fat_free_map_build);
+	schedule_work(&sbi->free_map_work);
+}
+
+void fat_free_map_destroy(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	if (!sbi->free_map)
+		return;
+	cancel_work_sync(&sbi->free_map_work);
+	vfree(sbi->free_map);
+	sbi->free_map = NULL;
+}
@@ -491,6 +491,8 @@ static void fat_put_super(struct super_block *sb)
 
 	lock_kernel();
 
+	fat_free_map_destroy(sb);
+
 	if (sb->s_dirt)
 		fat_write_super(sb);
 
@@ -516,6 +518,7 @@ static struct inode *fat_alloc_inode(struct super_block *sb)
 	ei = kmem_cache_alloc(fat_inode_cachep, GFP_NOFS);
 	if (!ei)
 		return NULL;
+	ei->i_alloc_goal = 0;
 	return &ei->vfs_inode;
 }
 
@@ -1516,6 +1519,8 @@ int fat_fill_super(struct super_block *sb, void *data, int silent,
 		goto out_fail;
 	}
 
+	fat_free_map_init(sb);
+
 	return 0;
 
 out_invalid:
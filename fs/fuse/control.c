@@ -10,6 +10,8 @@
 
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
 
 #define FUSE_CTL_SUPER_MAGIC 0x65735543
 
@@ -176,6 +178,50 @@ static ssize_t fuse_conn_congestion_threshold_write(struct file *file,
 	return ret;
 }
 
+/*
+ * Pending requests on each CPU, followed by the number of requests
+ * served and their average and maximum time from queueing to answer
+ */
+static ssize_t fuse_conn_queue_read(struct file *file, char __user *buf,
+				    size_t len, loff_t *ppos)
+{
+	struct fuse_conn *fc = fuse_ctl_file_conn_get(file);
+	u64 served, avg_ns, max_ns;
+	size_t size = 0;
+	ssize_t ret;
+	char *tmp;
+	int cpu;
+
+	if (!fc)
+		return 0;
+
+	tmp = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!tmp) {
+		fuse_conn_put(fc);
+		return -ENOMEM;
+	}
+
+	spin_lock(&fc->lock);
+	for_each_online_cpu(cpu)
+		size += scnprintf(tmp + size, PAGE_SIZE - size, "cpu%d %u\n",
+				  cpu, per_cpu_ptr(fc->queues, cpu)->nr_pending);
+	served = fc->nr_served;
+	avg_ns = served ? div64_u64(fc->service_ns, served) : 0;
+	max_ns = fc->max_service_ns;
+	spin_unlock(&fc->lock);
+	fuse_conn_put(fc);
+
+	size += scnprintf(tmp + size, PAGE_SIZE - size,
+			  "served %llu\navg_us %llu\nmax_us %llu\n",
+			  (unsigned long long)served,
+			  (unsigned long long)div_u64(avg_ns, NSEC_PER_USEC),
+			  (unsigned long long)div_u64(max_ns, NSEC_PER_USEC));
+
+	ret = simple_read_from_buffer(buf, len, ppos, tmp, size);
+	kfree(tmp);
+	return ret;
+}
+
 static const struct file_operations fuse_ctl_abort_ops = {
 	.open = nonseekable_open,
 	.write = fuse_conn_abort_write,
@@ -186,6 +232,11 @@ static const struct file_operations fuse_ctl_waiting_ops = {
 	.read = fuse_conn_waiting_read,
 };
 
+static const struct file_operations fuse_ctl_queue_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_queue_read,
+};
+
 static const struct file_operations fuse_conn_max_background_ops = {
 	.open = nonseekable_open,
 	.read = fuse_conn_max_background_read,
@@ -255,6 +306,8 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 
 	if (!fuse_ctl_add_dentry(parent, fc, "waiting", S_IFREG | 0400, 1,
 				 NULL, &fuse_ctl_waiting_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "queue", S_IFREG | 0400, 1,
+				 NULL, &fuse_ctl_queue_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "abort", S_IFREG | 0200, 1,
 				 NULL, &fuse_ctl_abort_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "max_background", S_IFREG | 0600,
@@ -19,6 +19,7 @@
 #include <linux/pipe_fs_i.h>
 #include <linux/swap.h>
 #include <linux/splice.h>
+#include <linux/percpu.h>
 
 MODULE_ALIAS_MISCDEV(FUSE_MINOR);
 MODULE_ALIAS("devname:fuse");
@@ -237,20 +238,82 @@ static u64 fuse_get_unique(struct fuse_conn *fc)
 	return fc->reqctr;
 }
 
+/*
+ * Wake up a single daemon thread, preferring one that is idle on @cpu.
+ * Pollers on fc->waitq are always woken, they don't consume requests
+ * directly.
+ *
+ * Called with fc->lock held
+ */
+static void wake_up_reader(struct fuse_conn *fc, int cpu)
+{
+	struct fuse_cpu_queue *q = per_cpu_ptr(fc->queues, cpu);
+	int i;
+
+	if (waitqueue_active(&q->waitq)) {
+		wake_up(&q->waitq);
+	} else {
+		for_each_possible_cpu(i) {
+			q = per_cpu_ptr(fc->queues, i);
+			if (waitqueue_active(&q->waitq)) {
+				wake_up(&q->waitq);
+				break;
+			}
+		}
+	}
+	wake_up(&fc->waitq);
+}
+
+void fuse_wake_up_readers(struct fuse_conn *fc)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		wake_up_all(&per_cpu_ptr(fc->queues, cpu)->waitq);
+	wake_up_all(&fc->waitq);
+}
+
 static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 {
+	int cpu = raw_smp_processor_id();
+	struct fuse_cpu_queue *q = per_cpu_ptr(fc->queues, cpu);
+
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fc->pending);
+	list_add_tail(&req->list, &q->pending);
+	req->queue = q;
+	req->queued = ktime_get();
+	q->nr_pending++;
+	fc->nr_pending++;
 	req->state = FUSE_REQ_PENDING;
 	if (!req->waiting) {
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
 	}
-	wake_up(&fc->waitq);
+	wake_up_reader(fc, cpu);
 	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 }
 
+/*
+ * Account for a request leaving its pending list.  The caller unlinks
+ * it.
+ */
+static void unqueue_request(struct fuse_conn *fc, struct fuse_req *req)
+{
+	req->queue->nr_pending--;
+	fc->nr_pending--;
+}
+
+static void account_service_time(struct fuse_conn *fc, struct fuse_req *req)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), req->queued));
+
+	fc->nr_served++;
+	fc->service_ns += ns;
+	if (ns > fc->max_service_ns)
+		fc->max_service_ns = ns;
+}
+
 static void flush_bg_queue(struct fuse_conn *fc)
 {
 	while (fc->active_background < fc->max_background &&
@@ -282,6 +345,10 @@ __releases(fc->lock)
 	req->end = NULL;
 	list_del(&req->list);
 	list_del(&req->intr_entry);
+	if (req->state == FUSE_REQ_PENDING)
+		unqueue_request(fc, req);
+	else if (req->state != FUSE_REQ_INIT)
+		account_service_time(fc, req);
 	req->state = FUSE_REQ_FINISHED;
 	if (req->background) {
 		if (fc->num_background == fc->max_background) {
@@ -320,7 +387,7 @@ __acquires(fc->lock)
 static void queue_interrupt(struct fuse_conn *fc, struct fuse_req *req)
 {
 	list_add_tail(&req->intr_entry, &fc->interrupts);
-	wake_up(&fc->waitq);
+	wake_up_reader(fc, raw_smp_processor_id());
 	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 }
 
@@ -358,6 +425,7 @@ __acquires(fc->lock)
 		/* Request is not yet in userspace, bail out */
 		if (req->state == FUSE_REQ_PENDING) {
 			list_del(&req->list);
+			unqueue_request(fc, req);
 			__fuse_put_request(req);
 			req->out.h.error = -EINTR;
 			return;
@@ -900,7 +968,34 @@ static int fuse_copy_args(struct fuse_copy_state *cs, unsigned numargs,
 
 static int request_pending(struct fuse_conn *fc)
 {
-	return !list_empty(&fc->pending) || !list_empty(&fc->interrupts);
+	return fc->nr_pending || !list_empty(&fc->interrupts);
+}
+
+/*
+ * Pick the next request to read: the oldest one queued on this CPU, or
+ * failing that, the oldest one queued on any other CPU.
+ */
+static struct fuse_req *next_pending_request(struct fuse_conn *fc)
+{
+	struct fuse_cpu_queue *q = per_cpu_ptr(fc->queues,
+					       raw_smp_processor_id());
+	struct fuse_req *req = NULL;
+	struct fuse_req *head;
+	int cpu;
+
+	if (!list_empty(&q->pending))
+		return list_entry(q->pending.next, struct fuse_req, list);
+
+	for_each_possible_cpu(cpu) {
+		q = per_cpu_ptr(fc->queues, cpu);
+		if (list_empty(&q->pending))
+			continue;
+		head = list_entry(q->pending.next, struct fuse_req, list);
+		if (!req || ktime_to_ns(ktime_sub(head->queued,
+						  req->queued)) < 0)
+			req = head;
+	}
+	return req;
 }
 
 /* Wait until a request is available on the pending list */
@@ -908,9 +1003,11 @@ static void request_wait(struct fuse_conn *fc)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
+	struct fuse_cpu_queue *q = per_cpu_ptr(fc->queues,
+					       raw_smp_processor_id());
 	DECLARE_WAITQUEUE(wait, current);
 
-	add_wait_queue_exclusive(&fc->waitq, &wait);
+	add_wait_queue_exclusive(&q->waitq, &wait);
 	while (fc->connected && !request_pending(fc)) {
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (signal_pending(current))
@@ -921,7 +1018,7 @@ __acquires(fc->lock)
 		spin_lock(&fc->lock);
 	}
 	set_current_state(TASK_RUNNING);
-	remove_wait_queue(&fc->waitq, &wait);
+	remove_wait_queue(&q->waitq, &wait);
 }
 
 /*
@@ -1000,7 +1097,8 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		return fuse_read_interrupt(fc, cs, nbytes, req);
 	}
 
-	req = list_entry(fc->pending.next, struct fuse_req, list);
+	req = next_pending_request(fc);
+	unqueue_request(fc, req);
 	req->state = FUSE_REQ_READING;
 	list_move(&req->list, &fc->io);
 
@@ -1773,9 +1871,12 @@ static void end_queued_requests(struct fuse_conn *fc)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
+	int cpu;
+
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
-	end_requests(fc, &fc->pending);
+	for_each_possible_cpu(cpu)
+		end_requests(fc, &per_cpu_ptr(fc->queues, cpu)->pending);
 	end_requests(fc, &fc->processing);
 }
 
@@ -1806,7 +1907,7 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		fc->blocked = 0;
 		end_io_requests(fc);
 		end_queued_requests(fc);
-		wake_up_all(&fc->waitq);
+		fuse_wake_up_readers(fc);
 		wake_up_all(&fc->blocked_waitq);
 		kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 	}
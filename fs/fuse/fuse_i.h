@@ -21,9 +21,10 @@
 #include <linux/rwsem.h>
 #include <linux/rbtree.h>
 #include <linux/poll.h>
+#include <linux/ktime.h>
 
-/** Max number of pages that can be used in a single read request */
-#define FUSE_MAX_PAGES_PER_REQ 32
+/** Max number of pages that can be used in a single read or write request */
+#define FUSE_MAX_PAGES_PER_REQ 128
 
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
@@ -32,7 +33,7 @@
 #define FUSE_NAME_MAX 1024
 
 /** Number of dentries for each connection in the control filesystem */
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 6
 
 /** If the FUSE_DEFAULT_PERMISSIONS flag is given, the filesystem
     module will check permissions based on the file mode.  Otherwise no
@@ -299,6 +300,31 @@ struct fuse_req {
 
 	/** Request is stolen from fuse_file->reserved_req */
 	struct file *stolen_file;
+
+	/** Pending queue the request was added to */
+	struct fuse_cpu_queue *queue;
+
+	/** Time the request was queued for userspace */
+	ktime_t queued;
+};
+
+/**
+ * Per-CPU pending queue of a connection.
+ *
+ * Requests are queued on the CPU they were submitted from, and a
+ * daemon thread waiting for requests sleeps on the queue of the CPU it
+ * last ran on, so a request is usually picked up by a thread whose
+ * cache is warm and only that thread is woken.
+ */
+struct fuse_cpu_queue {
+	/** Requests waiting to be read by userspace */
+	struct list_head pending;
+
+	/** Daemon threads idle on this CPU are waiting on this */
+	wait_queue_head_t waitq;
+
+	/** Number of requests on the pending list */
+	unsigned nr_pending;
 };
 
 /**
@@ -333,11 +359,21 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
-	/** Readers of the connection are waiting on this */
+	/** Pollers of the connection are waiting on this */
 	wait_queue_head_t waitq;
 
-	/** The list of pending requests */
-	struct list_head pending;
+	/** Per-CPU lists of pending requests */
+	struct fuse_cpu_queue __percpu *queues;
+
+	/** Number of pending requests on all CPUs */
+	unsigned nr_pending;
+
+	/** Number of requests answered (or read, if no answer is needed) */
+	u64 nr_served;
+
+	/** Total and maximum time from queueing to answer, in ns */
+	u64 service_ns;
+	u64 max_service_ns;
 
 	/** The list of requests being processed */
 	struct list_head processing;
@@ -457,6 +493,9 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** Buffer writes of files with a single writer in the page cache */
+	unsigned writeback_cache:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -685,10 +724,15 @@ struct fuse_conn *fuse_conn_get(struct fuse_conn *fc);
 
 void fuse_conn_kill(struct fuse_conn *fc);
 
+/**
+ * Wake up all daemon threads waiting for requests
+ */
+void fuse_wake_up_readers(struct fuse_conn *fc);
+
 /**
  * Initialize fuse_conn
  */
-void fuse_conn_init(struct fuse_conn *fc);
+int fuse_conn_init(struct fuse_conn *fc);
 
 /**
  * Release reference to fuse_conn
@@ -751,4 +795,10 @@ int fuse_dev_release(struct inode *inode, struct file *file);
 
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+/**
+ * Is i_size owned by the kernel rather than the server?  Called with
+ * fc->lock held.
+ */
+bool fuse_size_is_local(struct inode *inode);
+
 #endif /* _FS_FUSE_I_H */
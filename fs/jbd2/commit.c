@@ -26,6 +26,8 @@
 #include <linux/backing-dev.h>
 #include <linux/bio.h>
 #include <linux/blkdev.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
 #include <trace/events/jbd2.h>
 
 /*
@@ -324,6 +326,15 @@ static __u32 jbd2_checksum_data(__u32 crc32_sum, struct buffer_head *bh)
 	return checksum;
 }
 
+/* Histogram bucket of v: 0 below 1 << shift, then one per power of two */
+static inline int jbd2_hist_bucket(u64 v, int shift)
+{
+	v >>= shift;
+	if (!v)
+		return 0;
+	return min_t(int, ilog2(v) + 1, JBD2_HIST_BUCKETS - 1);
+}
+
 static void write_tag_block(int tag_bytes, journal_block_tag_t *tag,
 				   unsigned long long block)
 {
@@ -350,6 +361,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	unsigned long long blocknr;
 	ktime_t start_time;
 	u64 commit_time;
+	unsigned int batch;
 	char *tagp = NULL;
 	journal_header_t *header;
 	journal_block_tag_t *tag = NULL;
@@ -1015,6 +1027,8 @@ restart_loop:
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
 	spin_unlock(&journal->j_history_lock);
 
+	batch = atomic_read(&commit_transaction->t_commit_requests);
+
 	commit_transaction->t_state = T_FINISHED;
 	J_ASSERT(commit_transaction == journal->j_committing_transaction);
 	journal->j_commit_sequence = commit_transaction->t_tid;
@@ -1030,8 +1044,16 @@ restart_loop:
 				journal->j_average_commit_time*3) / 4;
 	else
 		journal->j_average_commit_time = commit_time;
+	journal->j_average_batch = (batch * JBD2_BATCH_SCALE +
+				    journal->j_average_batch * 3) / 4;
 	write_unlock(&journal->j_state_lock);
 
+	spin_lock(&journal->j_history_lock);
+	journal->j_commit_hist[jbd2_hist_bucket(div_u64(commit_time, 1000),
+						JBD2_HIST_LAT_SHIFT)]++;
+	journal->j_batch_hist[jbd2_hist_bucket(batch, 0)]++;
+	spin_unlock(&journal->j_history_lock);
+
 	if (commit_transaction->t_checkpoint_list == NULL &&
 	    commit_transaction->t_checkpoint_io_list == NULL) {
 		__jbd2_journal_drop_transaction(journal, commit_transaction);
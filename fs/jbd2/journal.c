@@ -42,6 +42,8 @@
 #include <linux/log2.h>
 #include <linux/vmalloc.h>
 #include <linux/backing-dev.h>
+#include <linux/blkdev.h>
+#include <linux/hrtimer.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/jbd2.h>
@@ -123,6 +125,29 @@ static void commit_timeout(unsigned long __data)
  *    known as checkpointing, and this thread is responsible for that job.
  */
 
+/*
+ * How long to hold a requested commit back so that more fsyncs can
+ * join it.  Only worth it while commits are requested by several
+ * callers each: a single stream of fsyncs has nobody to wait for.  A
+ * request arriving during the window would otherwise wait for this
+ * commit and then need one of its own, so the window is the average
+ * commit time, bounded by the batch times.
+ *
+ * Called under j_state_lock
+ */
+static u64 jbd2_commit_batch_window(journal_t *journal)
+{
+	u64 window;
+
+	if (journal->j_average_batch < JBD2_BATCH_MIN)
+		return 0;
+
+	window = journal->j_average_commit_time;
+	window = max_t(u64, window, 1000 * journal->j_min_batch_time);
+	window = min_t(u64, window, 1000 * journal->j_max_batch_time);
+	return window;
+}
+
 static int kjournald2(void *arg)
 {
 	journal_t *journal = arg;
@@ -152,6 +177,22 @@ loop:
 		journal->j_commit_sequence, journal->j_commit_request);
 
 	if (journal->j_commit_sequence != journal->j_commit_request) {
+		u64 window;
+
+		transaction = journal->j_running_transaction;
+		if (transaction && !transaction->t_batch_waited &&
+		    transaction->t_tid == journal->j_commit_request &&
+		    (window = jbd2_commit_batch_window(journal))) {
+			ktime_t expires = ktime_add_ns(ktime_get(), window);
+
+			transaction->t_batch_waited = 1;
+			write_unlock(&journal->j_state_lock);
+			set_current_state(TASK_INTERRUPTIBLE);
+			schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+			write_lock(&journal->j_state_lock);
+			goto loop;
+		}
+
 		jbd_debug(1, "OK, requests differ\n");
 		write_unlock(&journal->j_state_lock);
 		del_timer_sync(&journal->j_commit_timer);
@@ -497,11 +538,40 @@ int jbd2_log_start_commit(journal_t *journal, tid_t tid)
 	int ret;
 
 	write_lock(&journal->j_state_lock);
+	if (journal->j_running_transaction &&
+	    journal->j_running_transaction->t_tid == tid)
+		atomic_inc(&journal->j_running_transaction->t_commit_requests);
 	ret = __jbd2_log_start_commit(journal, tid);
 	write_unlock(&journal->j_state_lock);
 	return ret;
 }
 
+/*
+ * Has the commit of tid completed?
+ */
+int jbd2_log_commit_done(journal_t *journal, tid_t tid)
+{
+	int ret;
+
+	read_lock(&journal->j_state_lock);
+	ret = tid_geq(journal->j_commit_sequence, tid);
+	read_unlock(&journal->j_state_lock);
+	return ret;
+}
+EXPORT_SYMBOL(jbd2_log_commit_done);
+
+/*
+ * Do both the journal and the filesystem device complete writes
+ * atomically and durably, so that cache flushes and barriers only
+ * cost time?  Block drivers report this with QUEUE_FLAG_RELWRITE.
+ */
+int jbd2_journal_reliable_write(journal_t *journal)
+{
+	return blk_queue_reliable_write(bdev_get_queue(journal->j_dev)) &&
+		blk_queue_reliable_write(bdev_get_queue(journal->j_fs_dev));
+}
+EXPORT_SYMBOL(jbd2_journal_reliable_write);
+
 /*
  * Force and wait upon a commit if the calling process is not within
  * transaction.  This is used for forcing out undo-protected data which contains
@@ -792,6 +862,65 @@ static const struct file_operations jbd2_seq_info_fops = {
 	.release        = jbd2_seq_info_release,
 };
 
+static void jbd2_seq_hist_show_one(struct seq_file *seq, unsigned long *hist,
+				   int shift, const char *unit)
+{
+	int i;
+
+	for (i = 0; i < JBD2_HIST_BUCKETS; i++) {
+		if (i == 0)
+			seq_printf(seq, "  < %lu%s", 1UL << shift, unit);
+		else if (i == JBD2_HIST_BUCKETS - 1)
+			seq_printf(seq, "  >= %lu%s", 1UL << (i + shift - 1),
+				   unit);
+		else
+			seq_printf(seq, "  %lu-%lu%s", 1UL << (i + shift - 1),
+				   (1UL << (i + shift)) - 1, unit);
+		seq_printf(seq, ": %lu\n", hist[i]);
+	}
+}
+
+static int jbd2_seq_hist_show(struct seq_file *seq, void *v)
+{
+	journal_t *journal = seq->private;
+	unsigned long commit_hist[JBD2_HIST_BUCKETS];
+	unsigned long batch_hist[JBD2_HIST_BUCKETS];
+	unsigned int batch;
+	u64 window;
+
+	spin_lock(&journal->j_history_lock);
+	memcpy(commit_hist, journal->j_commit_hist, sizeof(commit_hist));
+	memcpy(batch_hist, journal->j_batch_hist, sizeof(batch_hist));
+	spin_unlock(&journal->j_history_lock);
+
+	read_lock(&journal->j_state_lock);
+	batch = journal->j_average_batch;
+	window = jbd2_commit_batch_window(journal);
+	read_unlock(&journal->j_state_lock);
+
+	seq_printf(seq, "average batch: %u.%02u\n", batch / JBD2_BATCH_SCALE,
+		   (batch % JBD2_BATCH_SCALE) * 100 / JBD2_BATCH_SCALE);
+	seq_printf(seq, "batch window: %lluus\n", div_u64(window, 1000));
+	seq_printf(seq, "commit latency:\n");
+	jbd2_seq_hist_show_one(seq, commit_hist, JBD2_HIST_LAT_SHIFT, "us");
+	seq_printf(seq, "commit requests per transaction:\n");
+	jbd2_seq_hist_show_one(seq, batch_hist, 0, "");
+	return 0;
+}
+
+static int jbd2_seq_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, jbd2_seq_hist_show, PDE(inode)->data);
+}
+
+static const struct file_operations jbd2_seq_hist_fops = {
+	.owner		= THIS_MODULE,
+	.open		= jbd2_seq_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct proc_dir_entry *proc_jbd2_stats;
 
 static void jbd2_stats_proc_init(journal_t *journal)
@@ -800,11 +929,14 @@ static void jbd2_stats_proc_init(journal_t *journal)
 	if (journal->j_proc_entry) {
 		proc_create_data("info", S_IRUGO, journal->j_proc_entry,
 				 &jbd2_seq_info_fops, journal);
+		proc_create_data("histogram", S_IRUGO, journal->j_proc_entry,
+				 &jbd2_seq_hist_fops, journal);
 	}
 }
 
 static void jbd2_stats_proc_exit(journal_t *journal)
 {
+	remove_proc_entry("histogram", journal->j_proc_entry);
 	remove_proc_entry("info", journal->j_proc_entry);
 	remove_proc_entry(journal->j_devname, proc_jbd2_stats);
 }
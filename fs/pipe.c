@@ -201,12 +201,13 @@ static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
 	struct page *page = buf->page;
 
 	/*
-	 * If nobody else uses this page, and we don't already have a
-	 * temporary page, let's keep track of it as a one-deep
-	 * allocation cache. (Otherwise just release our reference to it)
+	 * If nobody else uses this page, and the recycle list is not
+	 * full yet, keep it for the next write instead of handing it
+	 * back to the page allocator.  (Otherwise just release our
+	 * reference to it)
 	 */
-	if (page_count(page) == 1 && !pipe->tmp_page)
-		pipe->tmp_page = page;
+	if (page_count(page) == 1 && pipe->nr_tmp_pages < PIPE_TMP_PAGES)
+		pipe->tmp_pages[pipe->nr_tmp_pages++] = page;
 	else
 		page_cache_release(page);
 }
@@ -540,18 +541,19 @@ redo1:
 		if (bufs < pipe->buffers) {
 			int newbuf = (pipe->curbuf + bufs) & (pipe->buffers-1);
 			struct pipe_buffer *buf = pipe->bufs + newbuf;
-			struct page *page = pipe->tmp_page;
+			struct page *page;
 			char *src;
 			int error, atomic = 1;
 
-			if (!page) {
+			if (!pipe->nr_tmp_pages) {
 				page = alloc_page(GFP_HIGHUSER);
 				if (unlikely(!page)) {
 					ret = ret ? : -ENOMEM;
 					break;
 				}
-				pipe->tmp_page = page;
+				pipe->tmp_pages[pipe->nr_tmp_pages++] = page;
 			}
+			page = pipe->tmp_pages[pipe->nr_tmp_pages - 1];
 			/* Always wake up, even if the copy fails. Otherwise
 			 * we lock up (O_NONBLOCK-)readers that sleep due to
 			 * syscall merging.
@@ -593,7 +595,7 @@ redo2:
 			buf->offset = 0;
 			buf->len = chars;
 			pipe->nrbufs = ++bufs;
-			pipe->tmp_page = NULL;
+			pipe->nr_tmp_pages--;
 
 			total_len -= chars;
 			if (!total_len)
@@ -919,8 +921,8 @@ void __free_pipe_info(struct pipe_inode_info *pipe)
 		if (buf->ops)
 			buf->ops->release(pipe, buf);
 	}
-	if (pipe->tmp_page)
-		__free_page(pipe->tmp_page);
+	for (i = 0; i < pipe->nr_tmp_pages; i++)
+		__free_page(pipe->tmp_pages[i]);
 	kfree(pipe->bufs);
 	kfree(pipe);
 }
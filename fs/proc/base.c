@@ -369,6 +369,15 @@ static int proc_pid_schedstat(struct task_struct *task, char *buffer)
 }
 #endif
 
+/*
+ * Provides /proc/PID/reclaimstat
+ */
+static int proc_pid_reclaimstat(struct task_struct *task, char *buffer)
+{
+	return sprintf(buffer, "%lu %llu\n", task->nr_direct_reclaim,
+			(unsigned long long)task->direct_reclaim_ns);
+}
+
 #ifdef CONFIG_LATENCYTOP
 static int lstats_show_proc(struct seq_file *m, void *v)
 {
@@ -1073,6 +1082,7 @@ static ssize_t oom_adjust_write(struct file *file, const char __user *buf,
 		task->signal->oom_score_adj = (oom_adjust * OOM_SCORE_ADJ_MAX) /
 								-OOM_DISABLE;
 	unlock_task_sighand(task, &flags);
+	oom_adj_notify(task, oom_adjust);
 	put_task_struct(task);
 
 	return count;
@@ -1138,6 +1148,7 @@ static ssize_t oom_score_adj_write(struct file *file, const char __user *buf,
 	char buffer[PROC_NUMBUF];
 	unsigned long flags;
 	long oom_score_adj;
+	int oom_adj;
 	int err;
 
 	memset(buffer, 0, sizeof(buffer));
@@ -1177,7 +1188,9 @@ static ssize_t oom_score_adj_write(struct file *file, const char __user *buf,
 	else
 		task->signal->oom_adj = (oom_score_adj * OOM_ADJUST_MAX) /
 							OOM_SCORE_ADJ_MAX;
+	oom_adj = task->signal->oom_adj;
 	unlock_task_sighand(task, &flags);
+	oom_adj_notify(task, oom_adj);
 	put_task_struct(task);
 	return count;
 }
@@ -2748,6 +2761,7 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat",  S_IRUGO, proc_pid_schedstat),
 #endif
+	INF("reclaimstat", S_IRUGO, proc_pid_reclaimstat),
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
@@ -3083,6 +3097,7 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat", S_IRUGO, proc_pid_schedstat),
 #endif
+	INF("reclaimstat", S_IRUGO, proc_pid_reclaimstat),
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
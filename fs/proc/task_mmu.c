@@ -59,6 +59,14 @@ void task_mem(struct seq_file *m, struct mm_struct *mm)
 		mm->stack_vm << (PAGE_SHIFT-10), text, lib,
 		(PTRS_PER_PTE*sizeof(pte_t)*mm->nr_ptes) >> 10,
 		swap << (PAGE_SHIFT-10));
+#ifdef CONFIG_KSM
+	seq_printf(m,
+		"KsmMerged:\t%8lu kB\n"
+		"KsmUnmerged:\t%8lu kB\n",
+		mm->ksm_merged << (PAGE_SHIFT-10),
+		(mm->ksm_rmap_items > mm->ksm_merged ?
+		 mm->ksm_rmap_items - mm->ksm_merged : 0) << (PAGE_SHIFT-10));
+#endif
 }
 
 unsigned long task_vsize(struct mm_struct *mm)
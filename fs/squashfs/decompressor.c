@@ -23,6 +23,7 @@
 
 #include <linux/types.h>
 #include <linux/mutex.h>
+#include <linux/slab.h>
 #include <linux/buffer_head.h>
 
 #include "squashfs_fs.h"
@@ -72,3 +73,94 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 
 	return decompressor[i];
 }
+
+
+/*
+ * Each mounted filesystem has one decompressor stream per possible CPU,
+ * so that readers on different CPUs do not wait for each other.  A
+ * stream cannot be bound to its CPU (decompression sleeps waiting for
+ * the buffer heads), so streams sit on a free list instead, and a reader
+ * that finds it empty waits for one to be released.
+ */
+struct squashfs_stream {
+	struct list_head	list;
+	void			*stream;
+};
+
+int squashfs_decompressor_create(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *strm;
+	int i;
+
+	for (i = 0; i < num_possible_cpus(); i++) {
+		strm = kmalloc(sizeof(*strm), GFP_KERNEL);
+		if (strm == NULL)
+			break;
+		strm->stream = msblk->decompressor->init(msblk);
+		if (strm->stream == NULL) {
+			kfree(strm);
+			break;
+		}
+		list_add(&strm->list, &msblk->stream_list);
+	}
+
+	/* one stream is enough to mount, more only help concurrency */
+	return i ? 0 : -ENOMEM;
+}
+
+
+void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *strm, *next;
+
+	list_for_each_entry_safe(strm, next, &msblk->stream_list, list) {
+		msblk->decompressor->free(strm->stream);
+		kfree(strm);
+	}
+	INIT_LIST_HEAD(&msblk->stream_list);
+}
+
+
+static struct squashfs_stream *get_stream(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *strm;
+
+	spin_lock(&msblk->stream_lock);
+	while (list_empty(&msblk->stream_list)) {
+		spin_unlock(&msblk->stream_lock);
+		wait_event(msblk->stream_wait,
+			!list_empty(&msblk->stream_list));
+		spin_lock(&msblk->stream_lock);
+	}
+	strm = list_first_entry(&msblk->stream_list, struct squashfs_stream,
+		list);
+	list_del(&strm->list);
+	spin_unlock(&msblk->stream_lock);
+
+	return strm;
+}
+
+
+static void put_stream(struct squashfs_sb_info *msblk,
+	struct squashfs_stream *strm)
+{
+	spin_lock(&msblk->stream_lock);
+	list_add(&strm->list, &msblk->stream_list);
+	spin_unlock(&msblk->stream_lock);
+	wake_up(&msblk->stream_wait);
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	struct squashfs_stream *strm = get_stream(msblk);
+	int res;
+
+	res = msblk->decompressor->decompress(msblk, strm->stream, buffer, bh,
+		b, offset, length, srclength, pages);
+	put_stream(msblk, strm);
+
+	return res;
+}
@@ -47,6 +47,8 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/semaphore.h>
+#include <linux/highmem.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -371,6 +373,85 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Decompress a whole datablock straight into its page cache pages,
+ * skipping the copy through the read_page cache.  All pages covering
+ * the block must be grabbed (and none of them already uptodate),
+ * otherwise -EAGAIN is returned and the caller takes the cached path.
+ *
+ * Every page stays kmapped while the block is decompressed, so the
+ * number of readers doing this at once is limited by direct_sem, which
+ * keeps the kmap pool from running dry on highmem systems.
+ */
+static int squashfs_readpage_direct(struct page *target, u64 block,
+	int bsize, int start_index, int nr)
+{
+	struct inode *inode = target->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	struct page **page;
+	void **data;
+	int i, n = 0, bytes, res = -EAGAIN;
+
+	page = kmalloc(nr * (sizeof(*page) + sizeof(*data)), GFP_KERNEL);
+	if (page == NULL)
+		return -EAGAIN;
+	data = (void **) (page + nr);
+
+	for (; n < nr; n++) {
+		page[n] = (start_index + n == target->index) ? target :
+			grab_cache_page_nowait(target->mapping, start_index + n);
+		if (page[n] == NULL)
+			goto release;
+		if (PageUptodate(page[n])) {
+			n++;
+			goto release;
+		}
+	}
+
+	down(&msblk->direct_sem);
+	for (i = 0; i < nr; i++)
+		data[i] = kmap(page[i]);
+
+	bytes = squashfs_read_data(inode->i_sb, data, block, bsize, NULL,
+		min_t(int, msblk->block_size, nr << PAGE_CACHE_SHIFT), nr);
+
+	for (i = 0; i < nr; i++) {
+		int avail = clamp_t(int, bytes - (i << PAGE_CACHE_SHIFT), 0,
+			PAGE_CACHE_SIZE);
+
+		if (bytes >= 0)
+			memset(data[i] + avail, 0, PAGE_CACHE_SIZE - avail);
+		kunmap(page[i]);
+	}
+	up(&msblk->direct_sem);
+
+	if (bytes < 0) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		res = -EIO;
+		goto release;
+	}
+
+	for (i = 0; i < nr; i++) {
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+	}
+	res = 0;
+
+release:
+	/* the target page is left locked on failure */
+	for (i = 0; i < n; i++) {
+		if (page[i] == target && res)
+			continue;
+		unlock_page(page[i]);
+		if (page[i] != target)
+			page_cache_release(page[i]);
+	}
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -384,6 +465,8 @@ static int squashfs_readpage(struct file *file, struct page *page)
 	int start_index = page->index & ~mask;
 	int end_index = start_index | mask;
 	int file_end = i_size_read(inode) >> msblk->block_log;
+	int file_pages = (i_size_read(inode) + PAGE_CACHE_SIZE - 1) >>
+						PAGE_CACHE_SHIFT;
 
 	TRACE("Entered squashfs_readpage, page index %lx, start block %llx\n",
 				page->index, squashfs_i(inode)->start);
@@ -409,6 +492,15 @@ static int squashfs_readpage(struct file *file, struct page *page)
 				 msblk->block_size;
 			sparse = 1;
 		} else {
+			int res = squashfs_readpage_direct(page, block, bsize,
+				start_index,
+				min(end_index, file_pages - 1) - start_index + 1);
+
+			if (res == 0)
+				return 0;
+			if (res != -EAGAIN)
+				goto error_out;
+
 			/*
 			 * Read and decompress datablock.
 			 */
@@ -32,6 +32,7 @@
 #include <linux/slab.h>
 #include <linux/smp_lock.h>
 #include <linux/mutex.h>
+#include <linux/semaphore.h>
 #include <linux/pagemap.h>
 #include <linux/init.h>
 #include <linux/module.h>
@@ -48,6 +49,19 @@
 static struct file_system_type squashfs_fs_type;
 static const struct super_operations squashfs_super_ops;
 
+/*
+ * Cache sizes used for new mounts.  The metadata cache cannot be made
+ * smaller than SQUASHFS_CACHED_BLKS, read_blocklist() relies on it.
+ */
+static unsigned int fragment_cache_entries = SQUASHFS_CACHED_FRAGMENTS;
+module_param(fragment_cache_entries, uint, 0644);
+MODULE_PARM_DESC(fragment_cache_entries, "Number of fragments cached per mount");
+
+static unsigned int metadata_cache_entries = SQUASHFS_CACHED_BLKS;
+module_param(metadata_cache_entries, uint, 0644);
+MODULE_PARM_DESC(metadata_cache_entries,
+	"Number of metadata blocks cached per mount");
+
 static const struct squashfs_decompressor *supported_squashfs_filesystem(short
 	major, short minor, short id)
 {
@@ -105,8 +119,11 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	msblk->devblksize = sb_min_blocksize(sb, BLOCK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
 
-	mutex_init(&msblk->read_data_mutex);
 	mutex_init(&msblk->meta_index_mutex);
+	INIT_LIST_HEAD(&msblk->stream_list);
+	spin_lock_init(&msblk->stream_lock);
+	init_waitqueue_head(&msblk->stream_wait);
+	sema_init(&msblk->direct_sem, num_possible_cpus());
 
 	/*
 	 * msblk->bytes_used is checked in squashfs_read_table to ensure reads
@@ -200,17 +217,22 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 
 	err = -ENOMEM;
 
-	msblk->stream = squashfs_decompressor_init(msblk);
-	if (msblk->stream == NULL)
+	if (squashfs_decompressor_create(msblk))
 		goto failed_mount;
 
 	msblk->block_cache = squashfs_cache_init("metadata",
-			SQUASHFS_CACHED_BLKS, SQUASHFS_METADATA_SIZE);
+			max_t(unsigned int, metadata_cache_entries,
+				SQUASHFS_CACHED_BLKS), SQUASHFS_METADATA_SIZE);
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
-	/* Allocate read_page block */
-	msblk->read_page = squashfs_cache_init("data", 1, msblk->block_size);
+	/*
+	 * Allocate read_page blocks, one per CPU so parallel readers of
+	 * different blocks do not wait for each other.  Most full blocks
+	 * are decompressed straight into the page cache and never use it.
+	 */
+	msblk->read_page = squashfs_cache_init("data", num_possible_cpus(),
+		msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -230,7 +252,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto allocate_lookup_table;
 
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		max(fragment_cache_entries, 1U), msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
@@ -307,7 +329,7 @@ failed_mount:
 	squashfs_cache_delete(msblk->block_cache);
 	squashfs_cache_delete(msblk->fragment_cache);
 	squashfs_cache_delete(msblk->read_page);
-	squashfs_decompressor_free(msblk, msblk->stream);
+	squashfs_decompressor_destroy(msblk);
 	kfree(msblk->inode_lookup_table);
 	kfree(msblk->fragment_index);
 	kfree(msblk->id_table);
@@ -361,7 +383,7 @@ static void squashfs_put_super(struct super_block *sb)
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
-		squashfs_decompressor_free(sbi, sbi->stream);
+		squashfs_decompressor_destroy(sbi);
 		kfree(sbi->id_table);
 		kfree(sbi->fragment_index);
 		kfree(sbi->meta_index);
@@ -15,6 +15,8 @@
 #include <linux/quotaops.h>
 #include <linux/buffer_head.h>
 #include <linux/backing-dev.h>
+#include <linux/eventfd.h>
+#include <linux/workqueue.h>
 #include "internal.h"
 
 #define VALID_FLAGS (SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE| \
@@ -193,6 +195,117 @@ static int do_fsync(unsigned int fd, int datasync)
 	return ret;
 }
 
+struct fsyncv_work {
+	struct work_struct work;
+	struct eventfd_ctx *eventfd;
+	int datasync;
+	unsigned int nr;
+	struct file *files[0];
+};
+
+/*
+ * Start writeback on all files before waiting on any of them, so their
+ * data goes to the device together.  On a journalling filesystem the
+ * commit forced by the first ->fsync() then usually covers the metadata
+ * of the others as well, and their ->fsync() finds nothing left to do.
+ */
+static int fsyncv_files(struct fsyncv_work *fw)
+{
+	unsigned int i;
+	int err, ret = 0;
+
+	for (i = 0; i < fw->nr; i++)
+		filemap_fdatawrite(fw->files[i]->f_mapping);
+
+	for (i = 0; i < fw->nr; i++) {
+		err = vfs_fsync(fw->files[i], fw->datasync);
+		if (err && fw->eventfd)
+			/* keep it around for the next fsync() to see */
+			mapping_set_error(fw->files[i]->f_mapping, err);
+		if (!ret)
+			ret = err;
+	}
+	return ret;
+}
+
+static void fsyncv_free(struct fsyncv_work *fw)
+{
+	unsigned int i;
+
+	for (i = 0; i < fw->nr; i++)
+		fput(fw->files[i]);
+	if (fw->eventfd)
+		eventfd_ctx_put(fw->eventfd);
+	kfree(fw);
+}
+
+static void fsyncv_work_fn(struct work_struct *work)
+{
+	struct fsyncv_work *fw = container_of(work, struct fsyncv_work, work);
+
+	fsyncv_files(fw);
+	eventfd_signal(fw->eventfd, 1);
+	fsyncv_free(fw);
+}
+
+/*
+ * fsyncv - flush several files with one wait
+ * @fds:	array of file descriptors
+ * @nr:		number of entries in @fds, at most FSYNCV_MAX
+ * @flags:	FSYNCV_DATASYNC and/or FSYNCV_ASYNC
+ * @efd:	eventfd signalled when an FSYNCV_ASYNC flush is done
+ *
+ * Without FSYNCV_ASYNC the call returns the first error any file saw.
+ * With it the call returns once the request is queued; errors hit by the
+ * flush stay recorded on the mapping and are reported by the next fsync().
+ */
+SYSCALL_DEFINE4(fsyncv, const unsigned int __user *, fds, unsigned int, nr,
+		unsigned int, flags, int, efd)
+{
+	struct fsyncv_work *fw;
+	int ret;
+
+	if (flags & ~(FSYNCV_DATASYNC | FSYNCV_ASYNC))
+		return -EINVAL;
+	if (nr > FSYNCV_MAX)
+		return -EINVAL;
+
+	fw = kzalloc(sizeof(*fw) + nr * sizeof(struct file *), GFP_KERNEL);
+	if (!fw)
+		return -ENOMEM;
+	fw->datasync = flags & FSYNCV_DATASYNC;
+
+	while (fw->nr < nr) {
+		unsigned int fd;
+
+		ret = -EFAULT;
+		if (get_user(fd, fds + fw->nr))
+			goto out;
+		ret = -EBADF;
+		fw->files[fw->nr] = fget(fd);
+		if (!fw->files[fw->nr])
+			goto out;
+		fw->nr++;
+	}
+
+	if (flags & FSYNCV_ASYNC) {
+		fw->eventfd = eventfd_ctx_fdget(efd);
+		if (IS_ERR(fw->eventfd)) {
+			ret = PTR_ERR(fw->eventfd);
+			fw->eventfd = NULL;
+			goto out;
+		}
+		INIT_WORK(&fw->work, fsyncv_work_fn);
+		queue_work(system_long_wq, &fw->work);
+		return 0;
+	}
+
+	ret = fsyncv_files(fw);
+out:
+	fsyncv_free(fw);
+	return ret;
+}
+
 SYSCALL_DEFINE1(fsync, unsigned int, fd)
 {
 	return do_fsync(fd, 0);
@@ -26,6 +26,7 @@
 #include "yaffs_yaffs2.h"
 #include "yaffs_bitmap.h"
 #include "yaffs_verify.h"
+#include "yaffs_summary.h"
 
 #include "yaffs_nand.h"
 #include "yaffs_packedtags2.h"
@@ -468,6 +469,8 @@ static int yaffs_write_new_chunk(struct yaffs_dev_s *dev,
 		/* Copy the data into the robustification buffer */
 		yaffs_handle_chunk_wr_ok(dev, chunk, data, tags);
 
+		yaffs_summary_add(dev, tags, chunk);
+
 	} while (write_ok != YAFFS_OK &&
 		(yaffs_wr_attempts <= 0 || attempts <= yaffs_wr_attempts));
 
@@ -2546,9 +2549,13 @@ static int yaffs_check_gc(yaffs_dev_t *dev, int background)
 	int min_erased;
 	int erased_chunks;
 	int checkpt_block_adjust;
+	unsigned gc_control = 1;
+	__u64 start;
+
+	if(dev->param.gc_control)
+		gc_control = dev->param.gc_control(dev);
 
-	if(dev->param.gc_control &&
-		(dev->param.gc_control(dev) & 1) == 0)
+	if((gc_control & 1) == 0)
 		return YAFFS_OK;
 
 	if (dev->gc_disable) {
@@ -2572,6 +2579,10 @@ static int yaffs_check_gc(yaffs_dev_t *dev, int background)
 		if (dev->n_erased_blocks < min_erased)
 			aggressive = 1;
 		else {
+			/* Leave passive gc to the background thread */
+			if(!background && (gc_control & 2))
+				break;
+
 			if(!background && erased_chunks > (dev->n_free_chunks / 4))
 				break;
 
@@ -2612,7 +2623,14 @@ static int yaffs_check_gc(yaffs_dev_t *dev, int background)
 			   ("yaffs: GC n_erased_blocks %d aggressive %d" TENDSTR),
 			   dev->n_erased_blocks, aggressive));
 
+			start = Y_CLOCK_US();
 			gc_ok = yaffs_gc_block(dev, dev->gc_block, aggressive);
+			if (background)
+				dev->bg_gc_time += Y_CLOCK_US() - start;
+			else {
+				dev->fg_gc_time += Y_CLOCK_US() - start;
+				dev->n_fg_gcs++;
+			}
 		}
 
 		if (dev->n_erased_blocks < (dev->param.n_reserved_blocks) && dev->gc_block > 0) {
@@ -5270,6 +5288,9 @@ int yaffs_guts_initialise(yaffs_dev_t *dev)
 	dev->passive_gc_count = 0;
 	dev->oldest_dirty_gc_count = 0;
 	dev->bg_gcs = 0;
+	dev->n_fg_gcs = 0;
+	dev->fg_gc_time = 0;
+	dev->bg_gc_time = 0;
 	dev->gc_block_finder = 0;
 	dev->buffered_block = -1;
 	dev->doing_buffered_block_rewrite = 0;
@@ -5338,6 +5359,9 @@ int yaffs_guts_initialise(yaffs_dev_t *dev)
 	if (!init_failed && !yaffs_init_blocks(dev))
 		init_failed = 1;
 
+	if (!init_failed && !yaffs_summary_init(dev))
+		init_failed = 1;
+
 	yaffs_init_tnodes_and_objs(dev);
 
 	if (!init_failed && !yaffs_create_initial_dir(dev))
@@ -5426,6 +5450,7 @@ void yaffs_deinitialise(yaffs_dev_t *dev)
 
 		yaffs_deinit_blocks(dev);
 		yaffs_deinit_tnodes_and_objs(dev);
+		yaffs_summary_deinit(dev);
 		if (dev->param.n_caches > 0 &&
 		    dev->cache) {
 
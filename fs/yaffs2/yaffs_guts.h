@@ -87,6 +87,9 @@
 #define YAFFS_OBJECTID_CHECKPOINT_DATA	0x20
 #define YAFFS_SEQUENCE_CHECKPOINT_DATA  0x21
 
+/* Pseudo object id for block summary chunks */
+#define YAFFS_OBJECTID_SUMMARY		0x11
+
 
 #define YAFFS_MAX_SHORT_OP_CACHES	20
 
@@ -587,12 +590,16 @@ struct yaffs_param_s {
 	/* Callback to mark the superblock dirty */
 	void (*sb_dirty_fn)(struct yaffs_dev_s *dev);
 	
-	/*  Callback to control garbage collection. */
+	/*  Callback to control garbage collection.
+	 *  Bit 0 enables gc. Bit 1 means a background thread does the
+	 *  passive gc, so writers only collect when space is short.
+	 */
 	unsigned (*gc_control)(struct yaffs_dev_s *dev);
 
         /* Debug control flags. Don't use unless you know what you're doing */
 	int use_header_file_size;	/* Flag to determine if we should use file sizes from the header */
 	int disable_lazy_load;	/* Disable lazy loading on this device */
+	int disable_summary;	/* Disable block summaries on this device */
 	int wide_tnodes_disabled; /* Set to disable wide tnodes */
 	int disable_soft_del;  /* yaffs 1 only: Set to disable the use of softdeletion. */
 	
@@ -680,6 +687,10 @@ struct yaffs_dev_s {
 	__u32 alloc_page;
 	int alloc_block_finder;	/* Used to search for next allocation block */
 
+	/* Block summaries */
+	int chunks_per_summary;	/* Chunks per block before the summary */
+	__u8 *sum_buffer;	/* Summary being built or read */
+
 	/* Object and Tnode memory management */
 	void *allocator;
 	int n_obj;
@@ -759,6 +770,9 @@ struct yaffs_dev_s {
 	__u32 oldest_dirty_gc_count;
 	__u32 n_gc_blocks;
 	__u32 bg_gcs;
+	__u32 n_fg_gcs;		/* gc passes done inline by writers */
+	__u64 fg_gc_time;	/* us spent in inline gc */
+	__u64 bg_gc_time;	/* us spent in background gc */
 	__u32 n_retired_writes;
 	__u32 n_retired_blocks;
 	__u32 n_ecc_fixed;
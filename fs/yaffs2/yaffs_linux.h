@@ -25,6 +25,7 @@ struct yaffs_linux_context {
 	struct super_block * super;
 	struct task_struct *bg_thread; /* Background thread for this device */
 	int bg_running;
+	unsigned long fg_jiffies; /* Last time anyone else took the lock */
         struct semaphore gross_lock;     /* Gross locking semaphore */
 	__u8 *spare_buffer;      /* For mtdif2 use. Don't know the size of the buffer
 				 * at compile time so we have to allocate it.
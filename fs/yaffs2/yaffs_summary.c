@@ -0,0 +1,258 @@
+/*
+ * YAFFS: Yet Another Flash File System. A NAND-flash specific file system.
+ *
+ * Copyright (C) 2002-2010 Aleph One Ltd.
+ *   for Toby Churchill Ltd and Brightstar Engineering
+ *
+ * Created by Charles Manning <charles@aleph1.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Block summaries.
+ *
+ * The last few chunks of each yaffs2 block hold a copy of the tags of the
+ * chunks before them. When the block becomes full the summary is written
+ * and the rest of the block is skipped. A backwards scan can then read the
+ * summary instead of reading every chunk in the block, and only blocks which
+ * were partially written when power was lost are scanned chunk by chunk.
+ *
+ * Summary chunks are written with the pseudo object id
+ * YAFFS_OBJECTID_SUMMARY and are never marked as in use, so they are counted
+ * as free and reclaimed with the block.
+ */
+
+#include "yaffs_summary.h"
+#include "yaffs_packedtags2.h"
+#include "yaffs_nand.h"
+#include "yaffs_tagsvalidity.h"
+#include "yaffs_getblockinfo.h"
+#include "yaffs_trace.h"
+
+#define YAFFS_SUMMARY_VERSION	1
+
+/* Tags of one chunk, as packed by yaffs_pack_tags2_tags_only() but without
+ * the sequence number, which is the same for the whole block.
+ */
+struct yaffs_summary_tags {
+	unsigned obj_id;
+	unsigned chunk_id;
+	unsigned n_bytes;
+};
+
+struct yaffs_summary_header {
+	unsigned version;	/* YAFFS_SUMMARY_VERSION */
+	unsigned block;		/* Block the summary describes */
+	unsigned seq;		/* Sequence number of that block */
+	unsigned sum;		/* Byte sum of the summary tags */
+};
+
+static Y_INLINE struct yaffs_summary_tags *yaffs_summary_tags(yaffs_dev_t *dev)
+{
+	return (struct yaffs_summary_tags *)
+		(dev->sum_buffer + sizeof(struct yaffs_summary_header));
+}
+
+static int yaffs_summary_chunks(yaffs_dev_t *dev)
+{
+	return dev->param.chunks_per_block - dev->chunks_per_summary;
+}
+
+int yaffs_summary_init(yaffs_dev_t *dev)
+{
+	int sum_bytes;
+	int n_chunks;
+
+	dev->chunks_per_summary = dev->param.chunks_per_block;
+	dev->sum_buffer = NULL;
+
+	if (!dev->param.is_yaffs2 || dev->param.inband_tags ||
+	    dev->param.disable_summary)
+		return YAFFS_OK;
+
+	sum_bytes = sizeof(struct yaffs_summary_header) +
+		dev->param.chunks_per_block * sizeof(struct yaffs_summary_tags);
+	n_chunks = (sum_bytes + dev->data_bytes_per_chunk - 1) /
+		dev->data_bytes_per_chunk;
+
+	if (n_chunks >= dev->param.chunks_per_block) {
+		T(YAFFS_TRACE_ALWAYS,
+		  (TSTR("yaffs: blocks too small for summaries" TENDSTR)));
+		return YAFFS_OK;
+	}
+
+	dev->sum_buffer = YMALLOC(n_chunks * dev->data_bytes_per_chunk);
+	if (!dev->sum_buffer)
+		return YAFFS_FAIL;
+
+	dev->chunks_per_summary = dev->param.chunks_per_block - n_chunks;
+	yaffs_summary_clear(dev);
+
+	return YAFFS_OK;
+}
+
+void yaffs_summary_deinit(yaffs_dev_t *dev)
+{
+	if (dev->sum_buffer)
+		YFREE(dev->sum_buffer);
+	dev->sum_buffer = NULL;
+	dev->chunks_per_summary = dev->param.chunks_per_block;
+}
+
+void yaffs_summary_clear(yaffs_dev_t *dev)
+{
+	if (dev->sum_buffer)
+		memset(dev->sum_buffer, 0,
+			yaffs_summary_chunks(dev) * dev->data_bytes_per_chunk);
+}
+
+static unsigned yaffs_summary_sum(yaffs_dev_t *dev)
+{
+	__u8 *p = (__u8 *)yaffs_summary_tags(dev);
+	int n = dev->chunks_per_summary * sizeof(struct yaffs_summary_tags);
+	unsigned sum = 0;
+
+	while (n-- > 0)
+		sum += *p++;
+
+	return sum;
+}
+
+static void yaffs_summary_write(yaffs_dev_t *dev, int blk)
+{
+	struct yaffs_summary_header *hdr =
+		(struct yaffs_summary_header *)dev->sum_buffer;
+	yaffs_block_info_t *bi = yaffs_get_block_info(dev, blk);
+	yaffs_ext_tags tags;
+	int chunk = blk * dev->param.chunks_per_block + dev->chunks_per_summary;
+	int i;
+
+	hdr->version = YAFFS_SUMMARY_VERSION;
+	hdr->block = blk;
+	hdr->seq = bi->seq_number;
+	hdr->sum = yaffs_summary_sum(dev);
+
+	for (i = 0; i < yaffs_summary_chunks(dev); i++) {
+		yaffs_init_tags(&tags);
+		tags.obj_id = YAFFS_OBJECTID_SUMMARY;
+		tags.chunk_id = i + 1;
+		tags.n_bytes = dev->data_bytes_per_chunk;
+
+		if (yaffs_wr_chunk_tags_nand(dev, chunk + i,
+				dev->sum_buffer + i * dev->data_bytes_per_chunk,
+				&tags) != YAFFS_OK) {
+			/* The block stays usable, it just scans the slow way */
+			T(YAFFS_TRACE_ERROR,
+			  (TSTR("yaffs: summary write of block %d failed" TENDSTR),
+			  blk));
+			yaffs_handle_chunk_error(dev, bi);
+			break;
+		}
+	}
+}
+
+/*
+ * Called after each successful chunk write. Records the tags and, once the
+ * last chunk before the summary area is written, writes the summary and
+ * closes the block.
+ */
+void yaffs_summary_add(yaffs_dev_t *dev, yaffs_ext_tags *tags, int chunk_in_nand)
+{
+	yaffs_packed_tags2_tags_only pt;
+	struct yaffs_summary_tags *sum;
+	int blk = chunk_in_nand / dev->param.chunks_per_block;
+	int chunk_in_block = chunk_in_nand % dev->param.chunks_per_block;
+
+	if (!dev->sum_buffer || chunk_in_block >= dev->chunks_per_summary)
+		return;
+
+	if (chunk_in_block == 0)
+		yaffs_summary_clear(dev);
+
+	yaffs_pack_tags2_tags_only(&pt, tags);
+	sum = yaffs_summary_tags(dev) + chunk_in_block;
+	sum->obj_id = pt.obj_id;
+	sum->chunk_id = pt.chunk_id;
+	sum->n_bytes = pt.n_bytes;
+
+	if (chunk_in_block == dev->chunks_per_summary - 1 &&
+	    blk == dev->alloc_block) {
+		yaffs_summary_write(dev, blk);
+		yaffs_summary_clear(dev);
+		yaffs_skip_rest_of_block(dev);
+	}
+}
+
+/*
+ * Reads the summary of a block into the summary buffer. Returns 1 if the
+ * block has a valid summary.
+ */
+int yaffs_summary_read(yaffs_dev_t *dev, int blk)
+{
+	struct yaffs_summary_header *hdr =
+		(struct yaffs_summary_header *)dev->sum_buffer;
+	yaffs_block_info_t *bi = yaffs_get_block_info(dev, blk);
+	yaffs_ext_tags tags;
+	int chunk = blk * dev->param.chunks_per_block + dev->chunks_per_summary;
+	int result;
+	int i;
+
+	if (!dev->sum_buffer)
+		return 0;
+
+	for (i = 0; i < yaffs_summary_chunks(dev); i++) {
+		result = yaffs_rd_chunk_tags_nand(dev, chunk + i,
+				dev->sum_buffer + i * dev->data_bytes_per_chunk,
+				&tags);
+
+		if (result != YAFFS_OK ||
+		    !tags.chunk_used ||
+		    tags.ecc_result == YAFFS_ECC_RESULT_UNFIXED ||
+		    tags.obj_id != YAFFS_OBJECTID_SUMMARY ||
+		    tags.chunk_id != i + 1 ||
+		    tags.seq_number != bi->seq_number)
+			return 0;
+	}
+
+	if (hdr->version != YAFFS_SUMMARY_VERSION ||
+	    hdr->block != blk ||
+	    hdr->seq != bi->seq_number ||
+	    hdr->sum != yaffs_summary_sum(dev)) {
+		T(YAFFS_TRACE_SCAN,
+		  (TSTR("yaffs: block %d has a bad summary" TENDSTR), blk));
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Fills in the tags of a chunk from the summary last read. Returns 0 if the
+ * summary has no entry for the chunk and its tags must be read from flash.
+ */
+int yaffs_summary_fetch(yaffs_dev_t *dev, yaffs_ext_tags *tags, int chunk_in_block)
+{
+	struct yaffs_summary_header *hdr =
+		(struct yaffs_summary_header *)dev->sum_buffer;
+	yaffs_packed_tags2_tags_only pt;
+	struct yaffs_summary_tags *sum;
+
+	if (!dev->sum_buffer || chunk_in_block >= dev->chunks_per_summary)
+		return 0;
+
+	sum = yaffs_summary_tags(dev) + chunk_in_block;
+	if (!sum->obj_id)
+		return 0;
+
+	pt.seq_number = hdr->seq;
+	pt.obj_id = sum->obj_id;
+	pt.chunk_id = sum->chunk_id;
+	pt.n_bytes = sum->n_bytes;
+	yaffs_unpack_tags2_tags_only(tags, &pt);
+	tags->ecc_result = YAFFS_ECC_RESULT_NO_ERROR;
+
+	return 1;
+}
@@ -0,0 +1,32 @@
+/*
+ * YAFFS: Yet another Flash File System . A NAND-flash specific file system.
+ *
+ * Copyright (C) 2002-2010 Aleph One Ltd.
+ *   for Toby Churchill Ltd and Brightstar Engineering
+ *
+ * Created by Charles Manning <charles@aleph1.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1 as
+ * published by the Free Software Foundation.
+ *
+ * Note: Only YAFFS headers are LGPL, YAFFS C code is covered by GPL.
+ */
+
+/*
+ * Block summaries
+ */
+
+#ifndef __YAFFS_SUMMARY_H__
+#define __YAFFS_SUMMARY_H__
+
+#include "yaffs_guts.h"
+
+int yaffs_summary_init(yaffs_dev_t *dev);
+void yaffs_summary_deinit(yaffs_dev_t *dev);
+void yaffs_summary_clear(yaffs_dev_t *dev);
+void yaffs_summary_add(yaffs_dev_t *dev, yaffs_ext_tags *tags, int chunk_in_nand);
+int yaffs_summary_read(yaffs_dev_t *dev, int blk);
+int yaffs_summary_fetch(yaffs_dev_t *dev, yaffs_ext_tags *tags, int chunk_in_block);
+
+#endif
@@ -98,6 +98,8 @@ unsigned int yaffs_wr_attempts = YAFFS_WR_ATTEMPTS;
 unsigned int yaffs_auto_checkpoint = 1;
 unsigned int yaffs_gc_control = 1;
 unsigned int yaffs_bg_enable = 1;
+unsigned int yaffs_bg_gc_idle_ms = 200;
+unsigned int yaffs_bg_gc_urgent_blocks = 8;
 
 /* Module Parameters */
 module_param(yaffs_trace_mask, uint, 0644);
@@ -105,6 +107,8 @@ module_param(yaffs_wr_attempts, uint, 0644);
 module_param(yaffs_auto_checkpoint, uint, 0644);
 module_param(yaffs_gc_control, uint, 0644);
 module_param(yaffs_bg_enable, uint, 0644);
+module_param(yaffs_bg_gc_idle_ms, uint, 0644);
+module_param(yaffs_bg_gc_urgent_blocks, uint, 0644);
 
 #define Y_IGET(sb, inum) yaffs_iget((sb), (inum))
 
@@ -291,14 +295,24 @@ static  int yaffs_vfs_setsize(struct inode *inode, loff_t newsize)
 
 static unsigned yaffs_gc_control_callback(yaffs_dev_t *dev)
 {
+	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
+
+	if (context->bg_running && yaffs_bg_enable)
+		return yaffs_gc_control | 2;
 	return yaffs_gc_control;
 }
                 	                                                                                          	
 static void yaffs_gross_lock(yaffs_dev_t *dev)
 {
+	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
+
 	T(YAFFS_TRACE_LOCK, (TSTR("yaffs locking %p\n"), current));
-	down(&(yaffs_dev_to_lc(dev)->gross_lock));
+	down(&context->gross_lock);
 	T(YAFFS_TRACE_LOCK, (TSTR("yaffs locked %p\n"), current));
+
+	/* Anything but the background thread counts as activity */
+	if (current != context->bg_thread)
+		context->fg_jiffies = jiffies;
 }
 
 static void yaffs_gross_unlock(yaffs_dev_t *dev)
@@ -1836,6 +1850,9 @@ static unsigned yaffs_bg_gc_urgency(yaffs_dev_t *dev)
 		return 0;
 	else if(scattered < (dev->param.chunks_per_block * 2))
 		return 0;
+	else if(dev->n_erased_blocks <=
+		dev->param.n_reserved_blocks + yaffs_bg_gc_urgent_blocks)
+		return 2;
 	else if(erased_chunks > dev->n_free_chunks/2)
 		return 0;
 	else if(erased_chunks > dev->n_free_chunks/4)
@@ -1894,6 +1911,45 @@ void yaffs_background_waker(unsigned long data)
 	wake_up_process((struct task_struct *)data);
 }
 
+#define YAFFS_BG_GC_IDLE_PASSES 16
+
+static int yaffs_bg_idle(struct yaffs_linux_context *context)
+{
+	return time_after_eq(jiffies, context->fg_jiffies +
+				msecs_to_jiffies(yaffs_bg_gc_idle_ms));
+}
+
+/*
+ * Passive gc only runs once nobody else has used the device for
+ * yaffs_bg_gc_idle_ms, and then keeps going, dropping the lock between
+ * passes, until there is nothing left to do or someone else takes the lock.
+ * Once erased blocks get scarce it runs one pass per wakeup even when busy
+ * so that writers do not have to gc inline.
+ */
+static void yaffs_bg_gc_run(yaffs_dev_t *dev, unsigned urgency)
+{
+	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
+	int busy = !yaffs_bg_idle(context);
+	int passes = 0;
+
+	if (urgency < 1 || (urgency < 2 && busy))
+		return;
+
+	do {
+		yaffs_bg_gc(dev, urgency);
+		if (busy || ++passes >= YAFFS_BG_GC_IDLE_PASSES)
+			break;
+
+		yaffs_gross_unlock(dev);
+		cond_resched();
+		yaffs_gross_lock(dev);
+
+		busy = !yaffs_bg_idle(context);
+		urgency = yaffs_bg_gc_urgency(dev);
+	} while (urgency > 0 && !busy && !dev->is_checkpointed &&
+		!kthread_should_stop());
+}
+
 static int yaffs_bg_thread_fn(void *data)
 {
 	yaffs_dev_t *dev = (yaffs_dev_t *)data;
@@ -1904,7 +1960,6 @@ static int yaffs_bg_thread_fn(void *data)
 	unsigned long expires;
 	unsigned int urgency;
 
-	int gc_result;
 	struct timer_list timer;
 
 	T(YAFFS_TRACE_BACKGROUND,
@@ -1934,7 +1989,7 @@ static int yaffs_bg_thread_fn(void *data)
 		if(time_after(now,next_gc) && yaffs_bg_enable){
 			if(!dev->is_checkpointed){
 				urgency = yaffs_bg_gc_urgency(dev);
-				gc_result = yaffs_bg_gc(dev, urgency);
+				yaffs_bg_gc_run(dev, urgency);
 				if(urgency > 1)
 					next_gc = now + HZ/20+1;
 				else if(urgency > 0)
@@ -1977,6 +2032,7 @@ static int yaffs_bg_start(yaffs_dev_t *dev)
 		return -1;
 
 	context->bg_running = 1;
+	context->fg_jiffies = jiffies;
 
 	context->bg_thread = kthread_run(yaffs_bg_thread_fn,
 	                        (void *)dev,"yaffs-bg-%d",context->mount_id);
@@ -2129,6 +2185,8 @@ typedef struct {
 	int tags_ecc_overridden;
 	int lazy_loading_enabled;
 	int lazy_loading_overridden;
+	int summary_enabled;
+	int summary_overridden;
 	int empty_lost_and_found;
 	int empty_lost_and_found_overridden;
 } yaffs_options;
@@ -2171,6 +2229,12 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 		} else if (!strcmp(cur_opt, "lazy-loading-on")){
 			options->lazy_loading_enabled = 1;
 			options->lazy_loading_overridden = 1;
+		} else if (!strcmp(cur_opt, "summary-off")){
+			options->summary_enabled = 0;
+			options->summary_overridden = 1;
+		} else if (!strcmp(cur_opt, "summary-on")){
+			options->summary_enabled = 1;
+			options->summary_overridden = 1;
 		} else if (!strcmp(cur_opt, "empty-lost-and-found-off")){
 			options->empty_lost_and_found = 0;
 			options->empty_lost_and_found_overridden=1;
@@ -2426,6 +2490,12 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	if(options.lazy_loading_overridden)
 		param->disable_lazy_load = !options.lazy_loading_enabled;
 
+#ifdef CONFIG_YAFFS_DISABLE_SUMMARY
+	param->disable_summary = 1;
+#endif
+	if(options.summary_overridden)
+		param->disable_summary = !options.summary_enabled;
+
 #ifdef CONFIG_YAFFS_DISABLE_TAGS_ECC
 	param->no_tags_ecc = 1;
 #endif
@@ -2639,6 +2709,7 @@ static char *yaffs_dump_dev_part0(char *buf, yaffs_dev_t * dev)
 	buf += sprintf(buf, "inband_tags........... %d\n", dev->param.inband_tags);
 	buf += sprintf(buf, "empty_lost_n_found.... %d\n", dev->param.empty_lost_n_found);
 	buf += sprintf(buf, "disable_lazy_load..... %d\n", dev->param.disable_lazy_load);
+	buf += sprintf(buf, "disable_summary....... %d\n", dev->param.disable_summary);
 	buf += sprintf(buf, "refresh_period........ %d\n", dev->param.refresh_period);
 	buf += sprintf(buf, "n_caches.............. %d\n", dev->param.n_caches);
 	buf += sprintf(buf, "n_reserved_blocks..... %d\n", dev->param.n_reserved_blocks);
@@ -2671,6 +2742,11 @@ static char *yaffs_dump_dev_part1(char *buf, yaffs_dev_t * dev)
 	buf += sprintf(buf, "oldest_dirty_gc_count. %u\n", dev->oldest_dirty_gc_count);
 	buf += sprintf(buf, "n_gc_blocks........... %u\n", dev->n_gc_blocks);
 	buf += sprintf(buf, "bg_gcs................ %u\n", dev->bg_gcs);
+	buf += sprintf(buf, "n_fg_gcs.............. %u\n", dev->n_fg_gcs);
+	buf += sprintf(buf, "fg_gc_ms.............. %llu\n",
+		div_u64(dev->fg_gc_time, 1000));
+	buf += sprintf(buf, "bg_gc_ms.............. %llu\n",
+		div_u64(dev->bg_gc_time, 1000));
 	buf += sprintf(buf, "n_retired_writes...... %u\n", dev->n_retired_writes);
 	buf += sprintf(buf, "n_retired_blocks...... %u\n", dev->n_retired_blocks);
 	buf += sprintf(buf, "n_ecc_fixed........... %u\n", dev->n_ecc_fixed);
@@ -21,6 +21,7 @@
 #include "yaffs_nand.h"
 #include "yaffs_getblockinfo.h"
 #include "yaffs_verify.h"
+#include "yaffs_summary.h"
 
 /*
  * Checkpoints are really no benefit on very small partitions.
@@ -939,6 +940,8 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 	int found_chunks;
 	int equiv_id;
 	int alloc_failed = 0;
+	int summary_available;
+	int n_summaries = 0;
 
 
 	yaffs_block_index *block_index = NULL;
@@ -1064,9 +1067,22 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 
 		deleted = 0;
 
+		/* A full block with a summary only needs the summary read.
+		 * The summary chunks themselves are never in use.
+		 */
+		summary_available = 0;
+		c = dev->param.chunks_per_block - 1;
+		if (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING &&
+		    yaffs_summary_read(dev, blk)) {
+			summary_available = 1;
+			n_summaries++;
+			dev->n_free_chunks += c + 1 - dev->chunks_per_summary;
+			c = dev->chunks_per_summary - 1;
+		}
+
 		/* For each chunk in each block that needs scanning.... */
 		found_chunks = 0;
-		for (c = dev->param.chunks_per_block - 1;
+		for (;
 		     !alloc_failed && c >= 0 &&
 		     (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING ||
 		      state == YAFFS_BLOCK_STATE_ALLOCATING); c--) {
@@ -1076,8 +1092,10 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 
 			chunk = blk * dev->param.chunks_per_block + c;
 
-			result = yaffs_rd_chunk_tags_nand(dev, chunk, NULL,
-							&tags);
+			if (!summary_available ||
+			    !yaffs_summary_fetch(dev, &tags, c))
+				result = yaffs_rd_chunk_tags_nand(dev, chunk,
+							NULL, &tags);
 
 			/* Let's have a good look at this chunk... */
 
@@ -1133,7 +1151,8 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 
 				  dev->n_free_chunks++;
 
-			} else if (tags.obj_id > YAFFS_MAX_OBJECT_ID ||
+			} else if (tags.obj_id == YAFFS_OBJECTID_SUMMARY ||
+				tags.obj_id > YAFFS_MAX_OBJECT_ID ||
 				tags.chunk_id > YAFFS_MAX_CHUNK_ID ||
 				(tags.chunk_id > 0 && tags.n_bytes > dev->data_bytes_per_chunk) ||
 				tags.seq_number != bi->seq_number ) {
@@ -1516,6 +1535,10 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 	}
 	
 	yaffs_skip_rest_of_block(dev);
+	yaffs_summary_clear(dev);
+
+	T(YAFFS_TRACE_SCAN,
+	  (TSTR("%d blocks scanned using summaries" TENDSTR), n_summaries));
 
 	if (alt_block_index)
 		YFREE_ALT(block_index);
@@ -87,6 +87,8 @@
 #define Y_TIME_CONVERT(x) (x)
 #endif
 
+#define Y_CLOCK_US() ((__u64)ktime_to_us(ktime_get()))
+
 #define yaffs_sum_cmp(x, y) ((x) == (y))
 #define yaffs_strcmp(a, b) strcmp(a, b)
 
@@ -320,6 +322,10 @@
 #define Y_DUMP_STACK() do { } while (0)
 #endif
 
+#ifndef Y_CLOCK_US
+#define Y_CLOCK_US() 0
+#endif
+
 #ifndef YBUG
 #define YBUG() do {\
 	T(YAFFS_TRACE_BUG,\
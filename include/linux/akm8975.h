@@ -73,6 +73,30 @@ Defines a read-only address of the fuse ROM of the AK8975.*/
 #define ECS_IOCTL_APP_GET_MVFLAG	_IOR(AKMIO, 0x1A, short)
 #define ECS_IOCTL_APP_SET_TFLAG         _IOR(AKMIO, 0x15, short)
 
+/* Batch mode: the driver triggers the measurements itself and queues
+ * the results, so the daemon only wakes up once per batch */
+#define AKM8975_BATCH_MAX	32
+
+struct akm8975_batch_config {
+	short delay;		/* ms between measurements, 0 leaves batch mode */
+	short latency;		/* ms a queued sample may wait to be read */
+};
+
+struct akm8975_sample {
+	long long time;		/* ns, CLOCK_MONOTONIC at data ready */
+	char data[RBUFF_SIZE];	/* AK8975_REG_ST1 to AK8975_REG_ST2 */
+};
+
+struct akm8975_batch {
+	int count;
+	int dropped;		/* samples lost to a full queue */
+	struct akm8975_sample sample[AKM8975_BATCH_MAX];
+};
+
+#define ECS_IOCTL_SET_BATCH	_IOW(AKMIO, 0x1B, struct akm8975_batch_config)
+/* Blocks until a batch is ready or batch mode is left */
+#define ECS_IOCTL_GET_BATCH	_IOR(AKMIO, 0x1C, struct akm8975_batch)
+
 
 struct akm8975_platform_data {
 	int intr;
@@ -100,6 +100,17 @@ enum android_alarm_return_flags {
 #define ANDROID_ALARM_SET_AND_WAIT(type)    ALARM_IOW(3, type, struct timespec)
 #define ANDROID_ALARM_GET_TIME(type)        ALARM_IOW(4, type, struct timespec)
 #define ANDROID_ALARM_SET_RTC               _IOW('a', 5, struct timespec)
+
+/*
+ * Set alarm that may go off anywhere between @time and @time + @window.
+ * Wakeup alarms whose windows overlap are delivered on the same wakeup.
+ */
+struct android_alarm_window {
+	struct timespec time;
+	struct timespec window;
+};
+#define ANDROID_ALARM_SET_WINDOW(type) \
+			ALARM_IOW(6, type, struct android_alarm_window)
 #define ANDROID_ALARM_BASE_CMD(cmd)         (cmd & ~(_IOC(0, 0, 0xf0, 0)))
 #define ANDROID_ALARM_IOCTL_TO_TYPE(cmd)    (_IOC_NR(cmd) >> 4)
 
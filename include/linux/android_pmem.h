@@ -50,6 +50,13 @@ struct android_pmem_platform_data
 	unsigned cached;
 	/* The MSM7k has bits to enable a write buffer in the bus controller*/
 	unsigned buffered;
+	/* set to manage the region with a best-fit bitmap allocator instead
+	 * of the buddy allocator, allocations are then rounded up to quantum
+	 * rather than to a power of two */
+	unsigned bitmap_allocator;
+	/* allocation granularity of the bitmap allocator, a power of two
+	 * multiple of PAGE_SIZE (e.g. SZ_64K), PAGE_SIZE if 0 */
+	unsigned long quantum;
 };
 
 struct pmem_region {
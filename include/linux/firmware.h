@@ -13,6 +13,7 @@ struct firmware {
 	size_t size;
 	const u8 *data;
 	struct page **pages;
+	void *priv;
 };
 
 struct device;
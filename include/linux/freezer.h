@@ -65,11 +65,16 @@ extern void cancel_freezing(struct task_struct *p);
 
 #ifdef CONFIG_CGROUP_FREEZER
 extern int cgroup_freezing_or_frozen(struct task_struct *task);
+extern void cgroup_freezer_frozen(struct task_struct *task);
 #else /* !CONFIG_CGROUP_FREEZER */
 static inline int cgroup_freezing_or_frozen(struct task_struct *task)
 {
 	return 0;
 }
+
+static inline void cgroup_freezer_frozen(struct task_struct *task)
+{
+}
 #endif /* !CONFIG_CGROUP_FREEZER */
 
 /*
@@ -363,6 +363,11 @@ struct inodes_stat_t {
 #define SYNC_FILE_RANGE_WRITE		2
 #define SYNC_FILE_RANGE_WAIT_AFTER	4
 
+/* fsyncv() flags */
+#define FSYNCV_DATASYNC		1	/* fdatasync() semantics */
+#define FSYNCV_ASYNC		2	/* don't wait, signal the eventfd */
+#define FSYNCV_MAX		64	/* files per call */
+
 #ifdef __KERNEL__
 
 #include <linux/linkage.h>
@@ -930,6 +935,9 @@ struct file {
 	struct fown_struct	f_owner;
 	const struct cred	*f_cred;
 	struct file_ra_state	f_ra;
+#ifdef CONFIG_READAHEAD_PROFILE
+	struct ra_profile	*f_ra_profile;
+#endif
 
 	u64			f_version;
 #ifdef CONFIG_SECURITY
@@ -2240,6 +2248,31 @@ extern long do_splice_direct(struct file *in, loff_t *ppos, struct file *out,
 
 extern void
 file_ra_state_init(struct file_ra_state *ra, struct address_space *mapping);
+
+#ifdef CONFIG_READAHEAD_PROFILE
+struct ra_profile;
+extern void ra_profile_open(struct file *filp);
+extern void ra_profile_release(struct file *filp);
+extern void __ra_profile_fault(struct ra_profile *p, pgoff_t offset);
+
+/* record a page fault on a file whose profile is being learnt */
+static inline void ra_profile_fault(struct file *filp, pgoff_t offset)
+{
+	if (unlikely(filp->f_ra_profile))
+		__ra_profile_fault(filp->f_ra_profile, offset);
+}
+#else
+static inline void ra_profile_open(struct file *filp)
+{
+}
+static inline void ra_profile_release(struct file *filp)
+{
+}
+static inline void ra_profile_fault(struct file *filp, pgoff_t offset)
+{
+}
+#endif
+
 extern loff_t noop_llseek(struct file *file, loff_t offset, int origin);
 extern loff_t no_llseek(struct file *file, loff_t offset, int origin);
 extern loff_t generic_file_llseek(struct file *file, loff_t offset, int origin);
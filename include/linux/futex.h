@@ -176,6 +176,8 @@ union futex_key {
 #ifdef CONFIG_FUTEX
 extern void exit_robust_list(struct task_struct *curr);
 extern void exit_pi_state_list(struct task_struct *curr);
+extern int futex_mm_init(struct mm_struct *mm);
+extern void futex_mm_free(struct mm_struct *mm);
 extern int futex_cmpxchg_enabled;
 #else
 static inline void exit_robust_list(struct task_struct *curr)
@@ -184,6 +186,13 @@ static inline void exit_robust_list(struct task_struct *curr)
 static inline void exit_pi_state_list(struct task_struct *curr)
 {
 }
+static inline int futex_mm_init(struct mm_struct *mm)
+{
+	return 0;
+}
+static inline void futex_mm_free(struct mm_struct *mm)
+{
+}
 #endif
 #endif /* __KERNEL__ */
 
@@ -179,6 +179,7 @@ struct hrtimer_cpu_base {
 	unsigned long			nr_retries;
 	unsigned long			nr_hangs;
 	ktime_t				max_hang_time;
+	unsigned long			nr_coalesced;
 #endif
 };
 
@@ -426,6 +427,12 @@ extern int schedule_hrtimeout_range_clock(ktime_t *expires,
 		unsigned long delta, const enum hrtimer_mode mode, int clock);
 extern int schedule_hrtimeout(ktime_t *expires, const enum hrtimer_mode mode);
 
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+extern void cgroup_timer_slack_coalesced(struct task_struct *task);
+#else
+static inline void cgroup_timer_slack_coalesced(struct task_struct *task) { }
+#endif
+
 /* Soft interrupt function to run the hrtimer queues: */
 extern void hrtimer_run_queues(void);
 extern void hrtimer_run_pending(void);
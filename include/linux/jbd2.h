@@ -631,6 +631,12 @@ struct transaction_s
 	 */
 	atomic_t		t_handle_count;
 
+	/*
+	 * How many times was a commit of this transaction requested
+	 * through jbd2_log_start_commit() (fsync and sync handles)?
+	 */
+	atomic_t		t_commit_requests;
+
 	/*
 	 * This transaction is being forced and some process is
 	 * waiting for it to finish.
@@ -638,6 +644,9 @@ struct transaction_s
 	unsigned int t_synchronous_commit:1;
 	unsigned int t_flushed_data_blocks:1;
 
+	/* kjournald2 already delayed this commit to batch requests */
+	unsigned int t_batch_waited:1;
+
 	/*
 	 * For use by the filesystem to store fs-specific data
 	 * structures associated with the transaction
@@ -662,6 +671,17 @@ struct transaction_stats_s {
 	struct transaction_run_stats_s run;
 };
 
+/*
+ * Commit latency histogram buckets are powers of two of microseconds
+ * starting below 256us, batch size buckets are powers of two.
+ */
+#define JBD2_HIST_BUCKETS	12
+#define JBD2_HIST_LAT_SHIFT	8
+
+/* j_average_batch is fixed point, batched commits start at 1.5 */
+#define JBD2_BATCH_SCALE	16
+#define JBD2_BATCH_MIN		(JBD2_BATCH_SCALE * 3 / 2)
+
 static inline unsigned long
 jbd2_time_diff(unsigned long start, unsigned long end)
 {
@@ -958,6 +978,15 @@ struct journal_s
 	u32			j_min_batch_time;
 	u32			j_max_batch_time;
 
+	/*
+	 * Running average of commit requests per committed transaction,
+	 * scaled by JBD2_BATCH_SCALE.  kjournald2 holds a requested
+	 * commit back for up to one commit time while it is above
+	 * JBD2_BATCH_MIN, so concurrent fsyncs share a commit.
+	 * [j_state_lock]
+	 */
+	unsigned int		j_average_batch;
+
 	/* This function is called when a transaction is closed */
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
@@ -969,6 +998,10 @@ struct journal_s
 	struct proc_dir_entry	*j_proc_entry;
 	struct transaction_stats_s j_stats;
 
+	/* Commit latency and batch size histograms [j_history_lock] */
+	unsigned long		j_commit_hist[JBD2_HIST_BUCKETS];
+	unsigned long		j_batch_hist[JBD2_HIST_BUCKETS];
+
 	/* Failed journal commit ID */
 	unsigned int		j_failed_commit;
 
@@ -1189,6 +1222,8 @@ int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_journal_force_commit_nested(journal_t *journal);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
+int jbd2_log_commit_done(journal_t *journal, tid_t tid);
+int jbd2_journal_reliable_write(journal_t *journal);
 int jbd2_log_do_checkpoint(journal_t *journal);
 
 void __jbd2_log_wait_for_space(journal_t *journal);
@@ -65,6 +65,12 @@ struct loop_device {
 	struct request_queue	*lo_queue;
 	struct gendisk		*lo_disk;
 	struct list_head	lo_list;
+
+	/* block map of the backing file, see LO_FLAGS_DIRECT_IO */
+	struct loop_extent	*lo_extents;
+	unsigned int		lo_nr_extents;
+	struct block_device	*lo_extent_bdev;
+	atomic_t		lo_extent_inflight;
 };
 
 #endif /* __KERNEL__ */
@@ -76,6 +82,7 @@ enum {
 	LO_FLAGS_READ_ONLY	= 1,
 	LO_FLAGS_USE_AOPS	= 2,
 	LO_FLAGS_AUTOCLEAR	= 4,
+	LO_FLAGS_DIRECT_IO	= 16,	/* reads bypass the backing file */
 };
 
 #include <asm/posix_types.h>	/* for __kernel_old_dev_t */
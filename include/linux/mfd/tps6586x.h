@@ -79,5 +79,7 @@ extern int tps6586x_set_bits(struct device *dev, int reg, uint8_t bit_mask);
 extern int tps6586x_clr_bits(struct device *dev, int reg, uint8_t bit_mask);
 extern int tps6586x_update(struct device *dev, int reg, uint8_t val,
 			   uint8_t mask);
+extern int tps6586x_update_go(struct device *dev, int reg, uint8_t val,
+			      uint8_t mask, int go_reg, uint8_t go_bits);
 
 #endif /*__LINUX_MFD_TPS6586X_H */
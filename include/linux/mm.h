@@ -1127,6 +1127,66 @@ static inline void pgtable_page_dtor(struct page *page)
 	((unlikely(!pmd_present(*(pmd))) && __pte_alloc_kernel(pmd, address))? \
 		NULL: pte_offset_kernel(pmd, address))
 
+#ifdef CONFIG_FORK_SHARE_PTE
+/*
+ * Page tables shared between mms since fork, see mm/memory.c.
+ * A shared table is referenced once per mm pointing at it.
+ */
+static inline int pte_table_shared(pmd_t *pmd)
+{
+	return pmd_present(*pmd) && page_count(pmd_page(*pmd)) > 1;
+}
+
+static inline int ptep_table_shared(pte_t *pte)
+{
+	return page_count(virt_to_page(pte)) > 1;
+}
+
+/* @pte was looked up through @pmd, which now points elsewhere */
+static inline int pte_table_moved(pmd_t *pmd, pte_t *pte)
+{
+	return !pmd_present(*pmd) || pmd_page(*pmd) != virt_to_page(pte);
+}
+
+extern int unshare_pte_table(struct vm_area_struct *vma, unsigned long addr);
+extern int unshare_pte_range(struct vm_area_struct *vma,
+			     unsigned long start, unsigned long end);
+extern int unshare_pte_boundary(struct mm_struct *mm, unsigned long addr);
+#else
+static inline int pte_table_shared(pmd_t *pmd)
+{
+	return 0;
+}
+
+static inline int ptep_table_shared(pte_t *pte)
+{
+	return 0;
+}
+
+static inline int pte_table_moved(pmd_t *pmd, pte_t *pte)
+{
+	return 0;
+}
+
+static inline int unshare_pte_table(struct vm_area_struct *vma,
+				    unsigned long addr)
+{
+	return 0;
+}
+
+static inline int unshare_pte_range(struct vm_area_struct *vma,
+				    unsigned long start, unsigned long end)
+{
+	return 0;
+}
+
+static inline int unshare_pte_boundary(struct mm_struct *mm,
+				       unsigned long addr)
+{
+	return 0;
+}
+#endif
+
 extern void free_area_init(unsigned long * zones_size);
 extern void free_area_init_node(int nid, unsigned long * zones_size,
 		unsigned long zone_start_pfn, unsigned long *zholes_size);
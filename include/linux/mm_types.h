@@ -310,6 +310,15 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_KSM
+	/* pages ksmd has merged, and pages it has scanned, written by ksmd */
+	unsigned long ksm_merged;
+	unsigned long ksm_rmap_items;
+#endif
+#ifdef CONFIG_FUTEX
+	/* hash buckets for process private futexes */
+	struct futex_hash_bucket *futex_hash;
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
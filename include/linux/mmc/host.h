@@ -83,6 +83,17 @@ struct mmc_host_ops {
 	int (*enable)(struct mmc_host *host);
 	int (*disable)(struct mmc_host *host, int lazy);
 	void	(*request)(struct mmc_host *host, struct mmc_request *req);
+	/*
+	 * 'pre_req' is called from mmc_start_req() for a request that will
+	 * be started once the one on the bus has finished, so that a host
+	 * can map its buffers in parallel.  'post_req' undoes it once the
+	 * request is done, or with a non-zero @err if it is not started.
+	 * Both are optional and may sleep.
+	 */
+	void	(*pre_req)(struct mmc_host *host, struct mmc_request *req,
+			   bool is_first_req);
+	void	(*post_req)(struct mmc_host *host, struct mmc_request *req,
+			    int err);
 	/*
 	 * Avoid calling these three functions too often or in a "fast path",
 	 * since underlaying controller might implement them in an expensive
@@ -158,6 +169,8 @@ struct mmc_host {
 #define MMC_CAP_WAIT_WHILE_BUSY	(1 << 9)	/* Waits while card is busy */
 #define MMC_CAP_ERASE		(1 << 10)	/* Allow erase/trim commands */
 #define MMC_CAP_FORCE_HS	(1 << 11)	/* Must enable highspeed mode */
+#define MMC_CAP_HC_ERASE_SZ	(1 << 12)	/* Use high-capacity erase groups */
+#define MMC_CAP_SDIO_IRQ_NOTHREAD (1 << 13)	/* Runs SDIO IRQs from its own irq thread */
 
 	mmc_pm_flag_t		pm_caps;	/* supported pm features */
 
@@ -169,6 +182,7 @@ struct mmc_host {
 	unsigned int		max_req_size;	/* maximum number of bytes in one req */
 	unsigned int		max_blk_size;	/* maximum size of one mmc block */
 	unsigned int		max_blk_count;	/* maximum number of blocks in one req */
+	unsigned int		max_discard_to;	/* max. discard timeout in ms */
 
 	/* private data */
 	spinlock_t		lock;		/* lock for claim and bus ops */
@@ -197,6 +211,7 @@ struct mmc_host {
 	wait_queue_head_t	wq;
 	struct task_struct	*claimer;	/* task that has host claimed */
 	int			claim_cnt;	/* "claim" nesting count */
+	struct mmc_async_req	*areq;		/* request on the bus */
 
 	struct delayed_work	detect;
 
@@ -206,10 +221,15 @@ struct mmc_host {
 	unsigned int		bus_resume_flags;
 #define MMC_BUSRESUME_MANUAL_RESUME	(1 << 0)
 #define MMC_BUSRESUME_NEEDS_RESUME	(1 << 1)
+	struct delayed_work	deferred_resume;	/* background bus resume */
 
 	unsigned int		sdio_irqs;
 	struct task_struct	*sdio_irq_thread;
 	atomic_t		sdio_irq_thread_abort;
+	ktime_t			sdio_irq_stamp;	/* card interrupt raised */
+	unsigned long		sdio_irq_count;
+	u64			sdio_irq_lat_total;	/* us */
+	unsigned int		sdio_irq_lat_max;	/* us */
 
 	mmc_pm_flag_t		pm_flags;	/* requested pm features */
 
@@ -279,9 +299,12 @@ extern void mmc_request_done(struct mmc_host *, struct mmc_request *);
 static inline void mmc_signal_sdio_irq(struct mmc_host *host)
 {
 	host->ops->enable_sdio_irq(host, 0);
+	host->sdio_irq_stamp = ktime_get();
 	wake_up_process(host->sdio_irq_thread);
 }
 
+extern void sdio_run_irqs(struct mmc_host *host);
+
 struct regulator;
 
 int mmc_regulator_get_ocrmask(struct regulator *supply);
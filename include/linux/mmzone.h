@@ -35,6 +35,9 @@
  */
 #define PAGE_ALLOC_COSTLY_ORDER 3
 
+/* Highest order cached on the per-cpu lists */
+#define PCP_MAX_ORDER PAGE_ALLOC_COSTLY_ORDER
+
 #define MIGRATE_UNMOVABLE     0
 #define MIGRATE_RECLAIMABLE   1
 #define MIGRATE_MOVABLE       2
@@ -173,6 +176,10 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* Unmovable blocks of order 1..PCP_MAX_ORDER, one list per order */
+	int order_count[PCP_MAX_ORDER];
+	struct list_head order_lists[PCP_MAX_ORDER];
 };
 
 struct per_cpu_pageset {
@@ -283,6 +290,19 @@ struct zone {
 	/* zone watermarks, access with *_wmark_pages(zone) macros */
 	unsigned long watermark[NR_WMARK];
 
+	/*
+	 * Share of extra_free_kbytes, included in the low and high marks.
+	 * Background tasks leave it alone in the allocator slow path so
+	 * it is still there for the foreground.
+	 */
+	unsigned long fg_reserve;
+
+	/*
+	 * Raised when an allocation falls into direct reclaim, kswapd
+	 * reclaims this far past the high mark and then clears it.
+	 */
+	unsigned long watermark_boost;
+
 	/*
 	 * When free pages are below this point, additional steps are taken
 	 * when reading the number of free pages to avoid per-cpu counter
@@ -651,6 +671,7 @@ typedef struct pglist_data {
 extern struct mutex zonelists_mutex;
 void build_all_zonelists(void *data);
 void wakeup_kswapd(struct zone *zone, int order);
+void boost_kswapd_watermark(struct zone *zone);
 int zone_watermark_ok(struct zone *z, int order, unsigned long mark,
 		int classzone_idx, int alloc_flags);
 enum memmap_context {
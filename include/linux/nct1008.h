@@ -35,6 +35,18 @@ struct nct1008_platform_data {
 	u8 shutdown_local_limit;
 	u8 throttling_ext_limit;
 	void (*alarm_fn)(bool raised);
+
+	/*
+	 * Several throttle steps instead of a single alarm: the ALERT pin
+	 * interrupts as the external temperature leaves the window around
+	 * the current step, throttle_limits are the temperatures (ascending)
+	 * of each step and the step is left throttle_hysteresis below it.
+	 * throttling_ext_limit and alarm_fn are unused when this is set.
+	 */
+	const u8 *throttle_limits;
+	int num_throttle_limits;
+	u8 throttle_hysteresis;
+	void (*throttle_fn)(int step);
 };
 
 #endif /* _LINUX_NCT1008_H */
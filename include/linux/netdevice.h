@@ -1715,6 +1715,17 @@ extern int netdev_rx_handler_register(struct net_device *dev,
 				      void *rx_handler_data);
 extern void netdev_rx_handler_unregister(struct net_device *dev);
 
+#ifdef CONFIG_RPS
+extern int netif_set_rps_cpus(struct net_device *dev, unsigned int rxq,
+			      const struct cpumask *mask);
+#else
+static inline int netif_set_rps_cpus(struct net_device *dev, unsigned int rxq,
+				     const struct cpumask *mask)
+{
+	return 0;
+}
+#endif
+
 extern void		netif_nit_deliver(struct sk_buff *skb);
 extern int		dev_valid_name(const char *name);
 extern int		dev_ioctl(struct net *net, unsigned int cmd, void __user *);
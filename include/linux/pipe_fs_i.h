@@ -4,6 +4,7 @@
 #define PIPEFS_MAGIC 0x50495045
 
 #define PIPE_DEF_BUFFERS	16
+#define PIPE_TMP_PAGES		4	/* released pages kept for reuse */
 
 #define PIPE_BUF_FLAG_LRU	0x01	/* page is on the LRU */
 #define PIPE_BUF_FLAG_ATOMIC	0x02	/* was atomically mapped */
@@ -31,7 +32,7 @@ struct pipe_buffer {
  *	@wait: reader/writer wait point in case of empty/full pipe
  *	@nrbufs: the number of non-empty pipe buffers in this pipe
  *	@curbuf: the current pipe buffer entry
- *	@tmp_page: cached released page
+ *	@nr_tmp_pages: number of pages in @tmp_pages
  *	@readers: number of current readers of this pipe
  *	@writers: number of current writers of this pipe
  *	@waiting_writers: number of writers blocked waiting for room
@@ -41,6 +42,7 @@ struct pipe_buffer {
  *	@fasync_writers: writer side fasync
  *	@inode: inode this pipe is attached to
  *	@bufs: the circular array of pipe buffers
+ *	@tmp_pages: cached released pages
  **/
 struct pipe_inode_info {
 	wait_queue_head_t wait;
@@ -50,11 +52,12 @@ struct pipe_inode_info {
 	unsigned int waiting_writers;
 	unsigned int r_counter;
 	unsigned int w_counter;
-	struct page *tmp_page;
+	unsigned int nr_tmp_pages;
 	struct fasync_struct *fasync_readers;
 	struct fasync_struct *fasync_writers;
 	struct inode *inode;
 	struct pipe_buffer *bufs;
+	struct page *tmp_pages[PIPE_TMP_PAGES];
 };
 
 /*
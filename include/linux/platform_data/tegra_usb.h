@@ -25,6 +25,9 @@ struct tegra_ehci_platform_data {
 	enum tegra_usb_operating_modes operating_mode;
 	/* power down the phy on bus suspend */
 	int power_down_on_bus_suspend;
+	/* only gate the controller and phy clocks on bus suspend, keeping
+	 * vbus and the port state so devices need not be re-enumerated */
+	int clk_gate_on_bus_suspend;
 	void *phy_config;
 };
 
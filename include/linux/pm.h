@@ -560,6 +560,23 @@ extern void __suspend_report_result(const char *function, void *fn, int ret);
 
 extern void device_pm_wait_for_dev(struct device *sub, struct device *dev);
 
+/**
+ * struct dpm_platform_ops - Platform hooks run around device callbacks.
+ * @suspend_prepare: Called before a device's suspend callbacks, may wait
+ *	for other devices.
+ * @resume_prepare: Called before a device's resume callbacks, may wait for
+ *	other devices.
+ * @resume_report: Called with the time the resume callbacks took, in
+ *	microseconds.
+ */
+struct dpm_platform_ops {
+	void (*suspend_prepare)(struct device *dev);
+	void (*resume_prepare)(struct device *dev);
+	void (*resume_report)(struct device *dev, s64 usecs, int error);
+};
+
+extern void dpm_set_platform_ops(const struct dpm_platform_ops *ops);
+
 /* drivers/base/power/wakeup.c */
 extern void pm_wakeup_event(struct device *dev, unsigned int msec);
 extern void pm_stay_awake(struct device *dev);
@@ -578,6 +595,9 @@ static inline int dpm_suspend_start(pm_message_t state)
 
 static inline void device_pm_wait_for_dev(struct device *a, struct device *b) {}
 
+struct dpm_platform_ops;
+static inline void dpm_set_platform_ops(const struct dpm_platform_ops *ops) {}
+
 static inline void pm_wakeup_event(struct device *dev, unsigned int msec) {}
 static inline void pm_stay_awake(struct device *dev) {}
 static inline void pm_relax(void) {}
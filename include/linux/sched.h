@@ -795,6 +795,7 @@ enum cpu_idle_type {
 #define SD_SERIALIZE		0x0400	/* Only a single load balancing instance */
 #define SD_ASYM_PACKING		0x0800  /* Place busy groups earlier in the domain */
 #define SD_PREFER_SIBLING	0x1000	/* Prefer to place tasks in a sibling domain */
+#define SD_PACK_WAKEUPS		0x2000	/* Wake short tasks on busy cpus, not idle ones */
 
 enum powersavings_balance_level {
 	POWERSAVINGS_BALANCE_NONE = 0,  /* No power saving load balance */
@@ -829,6 +830,7 @@ static inline int sd_balance_for_package_power(void)
 }
 
 extern int __weak arch_sd_sibiling_asym_packing(void);
+extern int __weak arch_sd_pack_wakeups(void);
 
 /*
  * Optimise SD flags for power savings:
@@ -1284,6 +1286,9 @@ struct task_struct {
 	struct timespec real_start_time;	/* boot based time */
 /* mm fault and swap info: this can arguably be seen as either mm-specific or thread-specific */
 	unsigned long min_flt, maj_flt;
+/* direct reclaim entered from the page allocator, see /proc/PID/reclaimstat */
+	unsigned long nr_direct_reclaim;
+	u64 direct_reclaim_ns;
 
 	struct task_cputime cputime_expires;
 	struct list_head cpu_timers[3];
@@ -1865,6 +1870,9 @@ extern unsigned int sysctl_sched_wakeup_granularity;
 extern unsigned int sysctl_sched_shares_ratelimit;
 extern unsigned int sysctl_sched_shares_thresh;
 extern unsigned int sysctl_sched_child_runs_first;
+extern unsigned int sysctl_sched_group_preempt_window;
+extern unsigned int sysctl_sched_pack_load_pct;
+extern unsigned int sysctl_sched_pack_burst;
 
 enum sched_tunable_scaling {
 	SCHED_TUNABLESCALING_NONE,
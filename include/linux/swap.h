@@ -249,6 +249,7 @@ extern unsigned long mem_cgroup_shrink_node_zone(struct mem_cgroup *mem,
 extern int __isolate_lru_page(struct page *page, int mode, int file);
 extern unsigned long shrink_all_memory(unsigned long nr_pages);
 extern int vm_swappiness;
+extern int watermark_boost_factor;
 extern int remove_mapping(struct address_space *mapping, struct page *page);
 extern long vm_total_pages;
 
@@ -363,6 +363,7 @@ struct tcp_sock {
 	u32	snd_up;		/* Urgent pointer		*/
 
 	u8	keepalive_probes; /* num of allowed keep alive probes	*/
+	u8	delack_segs;	/* Full segments held by a delayed ACK	*/
 /*
  *      Options received (usually on last packet, some only on SYN packets).
  */
@@ -93,4 +93,60 @@ enum tegra_audio_device {
 #define TEGRA_AUDIO_GET_BIT_FORMAT	_IOR(TEGRA_AUDIO_MAGIC, 12, \
 			unsigned int *)
 
+/* mmap mode, issued on the audio%d_out_ctl or audio%d_in_ctl device.
+ *
+ * The application maps num_periods * period_size bytes of the stream
+ * device (audio%d_out or audio%d_in) and the DMA runs over it as a ring.
+ * poll() on the stream device returns when a period can be filled
+ * (playback) or read (capture). TEGRA_AUDIO_MMAP_COMMIT tells the driver
+ * how many more periods the application has filled or consumed.
+ */
+#define TEGRA_AUDIO_MMAP_MAX_PERIODS	16
+#define TEGRA_AUDIO_MMAP_MIN_PERIOD	64
+
+struct tegra_audio_mmap_config {
+	unsigned int period_size;	/* bytes, multiple of 4 */
+	unsigned int num_periods;	/* even, 2..TEGRA_AUDIO_MMAP_MAX_PERIODS */
+};
+
+struct tegra_audio_mmap_status {
+	unsigned int hw_ptr;		/* byte offset of the DMA in the ring */
+	unsigned int hw_periods;	/* periods done by the DMA since start */
+	unsigned int appl_periods;	/* periods committed by the app */
+	unsigned int xruns;		/* underruns or overruns since start */
+	unsigned int latency_us;	/* average time a period spends queued
+					 * between the app and the DMA */
+};
+
+#define TEGRA_AUDIO_MMAP_SET_CONFIG	_IOW(TEGRA_AUDIO_MAGIC, 13, \
+			const struct tegra_audio_mmap_config *)
+#define TEGRA_AUDIO_MMAP_GET_CONFIG	_IOR(TEGRA_AUDIO_MAGIC, 14, \
+			struct tegra_audio_mmap_config *)
+#define TEGRA_AUDIO_MMAP_START		_IO(TEGRA_AUDIO_MAGIC, 15)
+#define TEGRA_AUDIO_MMAP_STOP		_IO(TEGRA_AUDIO_MAGIC, 16)
+#define TEGRA_AUDIO_MMAP_COMMIT		_IOW(TEGRA_AUDIO_MAGIC, 17, \
+			const unsigned int *)
+#define TEGRA_AUDIO_MMAP_GET_STATUS	_IOR(TEGRA_AUDIO_MAGIC, 18, \
+			struct tegra_audio_mmap_status *)
+
+/* S/PDIF output format, issued on spdif_out_ctl while the stream is idle.
+ *
+ * In TEGRA_AUDIO_SPDIF_NON_AUDIO mode the application writes IEC 61937
+ * data bursts (AC-3, DTS, ...) already packed into 16-bit stereo frames.
+ * The driver marks the channel status as non-PCM and the HDMI audio
+ * infoframe as "refer to stream header", so the receiver decodes it.
+ */
+#define TEGRA_AUDIO_SPDIF_PCM		0
+#define TEGRA_AUDIO_SPDIF_NON_AUDIO	1
+
+struct tegra_audio_spdif_format {
+	unsigned int rate;		/* Hz, 32000 to 192000 */
+	unsigned int mode;		/* TEGRA_AUDIO_SPDIF_PCM or _NON_AUDIO */
+};
+
+#define TEGRA_AUDIO_SPDIF_SET_FORMAT	_IOW(TEGRA_AUDIO_MAGIC, 19, \
+			const struct tegra_audio_spdif_format *)
+#define TEGRA_AUDIO_SPDIF_GET_FORMAT	_IOR(TEGRA_AUDIO_MAGIC, 20, \
+			struct tegra_audio_spdif_format *)
+
 #endif/*_CPCAP_AUDIO_H*/
@@ -33,6 +33,7 @@
 enum tegra_mediaserver_resource_type {
 	TEGRA_MEDIASERVER_RESOURCE_BLOCK = 0,
 	TEGRA_MEDIASERVER_RESOURCE_IRAM,
+	TEGRA_MEDIASERVER_RESOURCE_SURFACE,
 };
 
 enum tegra_mediaserver_block_type {
@@ -59,6 +60,16 @@ struct tegra_mediaserver_iram_info {
 	int physical_address;
 };
 
+/*
+ * Decoder surfaces come from a pool of pinned write-combined handles.
+ * rm_handle is global, so the caller can duplicate it into its own
+ * nvmap client.
+ */
+struct tegra_mediaserver_surface_info {
+	unsigned long rm_handle;
+	int physical_address;
+};
+
 union tegra_mediaserver_alloc_info {
 	struct {
 		int tegra_mediaserver_resource_type;
@@ -71,6 +82,12 @@ union tegra_mediaserver_alloc_info {
 				int alignment;
 				size_t size;
 			} iram;
+
+			struct {
+				int reserved;
+				int alignment;
+				size_t size;
+			} surface;
 		} u;
 	} in;
 
@@ -81,6 +98,7 @@ union tegra_mediaserver_alloc_info {
 			} block;
 
 			struct tegra_mediaserver_iram_info iram;
+			struct tegra_mediaserver_surface_info surface;
 		} u;
 	} out;
 };
@@ -96,6 +114,7 @@ union tegra_mediaserver_free_info {
 		union {
 			int nvmm_block_handle;
 			int iram_rm_handle;
+			int surface_rm_handle;
 		} u;
 	} in;
 };
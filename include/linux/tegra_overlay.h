@@ -54,14 +54,67 @@ struct tegra_overlay_flip_args {
 	__u32 post_syncpt_val;
 };
 
+/*
+ * Last flip that reached the screen: its post_syncpt_val, the time it was
+ * latched (CLOCK_MONOTONIC, ns) and the number of flips that were replaced
+ * by a newer one before being shown.
+ */
+struct tegra_overlay_present {
+	__u32	syncpt_val;
+	__u32	dropped;
+	__u64	timestamp_ns;
+};
+
+/*
+ * YUV to RGB coefficients for a window, in the format of the hardware
+ * registers.  They take effect with the next flip of that window.
+ */
+struct tegra_overlay_csc {
+	__s32	index;
+	__u16	yof;
+	__u16	kyrgb;
+	__u16	kur;
+	__u16	kvr;
+	__u16	kug;
+	__u16	kvg;
+	__u16	kub;
+	__u16	kvb;
+};
+
+#define TEGRA_OVERLAY_CAP_H_FILTER	(1 << 0)
+#define TEGRA_OVERLAY_CAP_V_FILTER	(1 << 1)
+#define TEGRA_OVERLAY_CAP_CSC		(1 << 2)
+
+/*
+ * formats is a mask of 1 << TEGRA_FB_WIN_FMT_*, blend of
+ * 1 << TEGRA_FB_WIN_BLEND_*.  A window may shrink its source by less than
+ * max_downscale in each direction.  Windows with a lower z are in front.
+ */
+struct tegra_overlay_plane_caps {
+	__u32	formats;
+	__u32	blend;
+	__u32	flags;
+	__u32	max_w;
+	__u32	max_h;
+	__u32	max_downscale;
+};
+
+struct tegra_overlay_caps {
+	__u32	n_windows;
+	struct tegra_overlay_plane_caps plane[TEGRA_FB_FLIP_N_WINDOWS];
+};
+
 #define TEGRA_OVERLAY_IOCTL_MAGIC		'O'
 
 #define TEGRA_OVERLAY_IOCTL_OPEN_WINDOW		_IOWR(TEGRA_OVERLAY_IOCTL_MAGIC, 0x40, __u32)
 #define TEGRA_OVERLAY_IOCTL_CLOSE_WINDOW	_IOW(TEGRA_OVERLAY_IOCTL_MAGIC, 0x41, __u32)
 #define TEGRA_OVERLAY_IOCTL_FLIP		_IOW(TEGRA_OVERLAY_IOCTL_MAGIC, 0x42, struct tegra_overlay_flip_args)
 #define TEGRA_OVERLAY_IOCTL_SET_NVMAP_FD	_IOW(TEGRA_OVERLAY_IOCTL_MAGIC, 0x43, __u32)
+#define TEGRA_OVERLAY_IOCTL_GET_PRESENT		_IOR(TEGRA_OVERLAY_IOCTL_MAGIC, 0x44, struct tegra_overlay_present)
+#define TEGRA_OVERLAY_IOCTL_SET_CSC		_IOW(TEGRA_OVERLAY_IOCTL_MAGIC, 0x45, struct tegra_overlay_csc)
+#define TEGRA_OVERLAY_IOCTL_GET_CAPS		_IOR(TEGRA_OVERLAY_IOCTL_MAGIC, 0x46, struct tegra_overlay_caps)
 
 #define TEGRA_OVERLAY_IOCTL_MIN_NR		_IOC_NR(TEGRA_OVERLAY_IOCTL_OPEN_WINDOW)
-#define TEGRA_OVERLAY_IOCTL_MAX_NR		_IOC_NR(TEGRA_OVERLAY_IOCTL_SET_NVMAP_FD)
+#define TEGRA_OVERLAY_IOCTL_MAX_NR		_IOC_NR(TEGRA_OVERLAY_IOCTL_GET_CAPS)
 
 #endif
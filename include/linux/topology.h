@@ -137,6 +137,7 @@ int arch_update_cpu_topology(void);
 				| 0*SD_SERIALIZE			\
 				| sd_balance_for_mc_power()		\
 				| sd_power_saving_flags()		\
+				| arch_sd_pack_wakeups()		\
 				,					\
 	.last_balance		= jiffies,				\
 	.balance_interval	= 1,					\
@@ -170,6 +171,7 @@ int arch_update_cpu_topology(void);
 				| 0*SD_SERIALIZE			\
 				| sd_balance_for_package_power()	\
 				| sd_power_saving_flags()		\
+				| arch_sd_pack_wakeups()		\
 				,					\
 	.last_balance		= jiffies,				\
 	.balance_interval	= 1,					\
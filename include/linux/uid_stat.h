@@ -19,11 +19,18 @@
 /* Contains definitions for resource tracking per uid. */
 
 #ifdef CONFIG_UID_STAT
-int uid_stat_tcp_snd(uid_t uid, int size);
-int uid_stat_tcp_rcv(uid_t uid, int size);
+struct sock;
+
+/* TCP is accounted to the interface of the socket's cached route. */
+int uid_stat_tcp_snd(uid_t uid, struct sock *sk, int size);
+int uid_stat_tcp_rcv(uid_t uid, struct sock *sk, int size);
+int uid_stat_udp_snd(uid_t uid, struct sock *sk, int ifindex, int size);
+int uid_stat_udp_rcv(uid_t uid, struct sock *sk, int ifindex, int size);
 #else
-#define uid_stat_tcp_snd(uid, size) do {} while (0);
-#define uid_stat_tcp_rcv(uid, size) do {} while (0);
+#define uid_stat_tcp_snd(uid, sk, size) do {} while (0);
+#define uid_stat_tcp_rcv(uid, sk, size) do {} while (0);
+#define uid_stat_udp_snd(uid, sk, ifindex, size) do {} while (0);
+#define uid_stat_udp_rcv(uid, sk, ifindex, size) do {} while (0);
 #endif
 
 #endif /* _LINUX_UID_STAT_H */
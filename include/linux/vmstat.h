@@ -43,12 +43,20 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
 		KSWAPD_SKIP_CONGESTION_WAIT,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
+		PGALLOC_HIGHORDER, PGALLOC_HIGHORDER_PCP,
+		PGALLOC_HIGHORDER_SLOW, PGALLOC_HIGHORDER_SLOW_US,
+		PGALLOC_HIGHORDER_FAIL,
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		COMPACTBACKGROUND,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
+#endif
+		FORK_PTE_COPIED,
+#ifdef CONFIG_FORK_SHARE_PTE
+		FORK_PTE_SHARED, FORK_PTE_TABLES_SHARED, FORK_PTE_TABLES_UNSHARED,
 #endif
 		UNEVICTABLE_PGCULLED,	/* culled to noreclaim list */
 		UNEVICTABLE_PGSCANNED,	/* scanned for reclaimability */
@@ -253,7 +261,8 @@ extern void __inc_zone_state(struct zone *, enum zone_stat_item);
 extern void dec_zone_state(struct zone *, enum zone_stat_item);
 extern void __dec_zone_state(struct zone *, enum zone_stat_item);
 
-void refresh_cpu_vm_stats(int);
+int refresh_cpu_vm_stats(int);
+void quiet_vmstat(void);
 #else /* CONFIG_SMP */
 
 /*
@@ -298,7 +307,8 @@ static inline void __dec_zone_page_state(struct page *page,
 #define dec_zone_page_state __dec_zone_page_state
 #define mod_zone_page_state __mod_zone_page_state
 
-static inline void refresh_cpu_vm_stats(int cpu) { }
+static inline int refresh_cpu_vm_stats(int cpu) { return 0; }
+static inline void quiet_vmstat(void) { }
 #endif
 
 #endif /* _LINUX_VMSTAT_H */
@@ -73,6 +73,12 @@ int wake_lock_active(struct wake_lock *lock);
  */
 long has_wake_lock(int type);
 
+/* suspend_abort_check returns -EAGAIN if the suspend in progress should be
+ * aborted because a suspend wake lock is held or a wakeup event arrived.
+ * The phase and the blocking wake lock are logged in /proc/suspend_aborts.
+ */
+int suspend_abort_check(const char *phase);
+
 #else
 
 static inline void wake_lock_init(struct wake_lock *lock, int type,
@@ -84,6 +90,7 @@ static inline void wake_unlock(struct wake_lock *lock) {}
 
 static inline int wake_lock_active(struct wake_lock *lock) { return 0; }
 static inline long has_wake_lock(int type) { return 0; }
+static inline int suspend_abort_check(const char *phase) { return 0; }
 
 #endif
 
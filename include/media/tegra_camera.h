@@ -14,6 +14,8 @@
  *
  */
 
+#include <linux/types.h>
+
 enum {
 	TEGRA_CAMERA_MODULE_ISP = 0,
 	TEGRA_CAMERA_MODULE_VI,
@@ -31,8 +33,42 @@ struct tegra_camera_clk_info {
 	unsigned long rate;
 };
 
+#define TEGRA_CAMERA_MAX_BUFFERS	8
+
+/*
+ * Capture queue.  The buffers are pinned once at setup and stay pinned
+ * until teardown.  A queued buffer is complete when the VI sync point
+ * reaches its threshold; dequeue returns completed buffers in order with
+ * the time the frame-done interrupt was handled.  The device polls
+ * readable while a completed buffer is waiting.
+ *
+ * id must be TEGRA_CAMERA_MODULE_VI.
+ */
+struct tegra_camera_capture_setup {
+	uint id;
+	int nvmap_fd;
+	__u32 syncpt_id;
+	__u32 num_buffers;
+	__u32 buffers[TEGRA_CAMERA_MAX_BUFFERS];	/* nvmap handle ids */
+};
+
+struct tegra_camera_capture_buf {
+	uint id;
+	__u32 index;
+	__u32 syncpt_thresh;
+	__u32 sequence;		/* dequeue only */
+	__u64 timestamp_us;	/* dequeue only, CLOCK_MONOTONIC */
+};
+
 #define TEGRA_CAMERA_IOCTL_ENABLE		_IOWR('i', 1, uint)
 #define TEGRA_CAMERA_IOCTL_DISABLE		_IOWR('i', 2, uint)
 #define TEGRA_CAMERA_IOCTL_CLK_SET_RATE		\
 	_IOWR('i', 3, struct tegra_camera_clk_info)
 #define TEGRA_CAMERA_IOCTL_RESET		_IOWR('i', 4, uint)
+#define TEGRA_CAMERA_IOCTL_CAPTURE_SETUP	\
+	_IOW('i', 5, struct tegra_camera_capture_setup)
+#define TEGRA_CAMERA_IOCTL_CAPTURE_TEARDOWN	_IOW('i', 6, uint)
+#define TEGRA_CAMERA_IOCTL_CAPTURE_QBUF		\
+	_IOW('i', 7, struct tegra_camera_capture_buf)
+#define TEGRA_CAMERA_IOCTL_CAPTURE_DQBUF	\
+	_IOWR('i', 8, struct tegra_camera_capture_buf)
@@ -331,6 +331,21 @@ extern ssize_t tcp_splice_read(struct socket *sk, loff_t *ppos,
 			       struct pipe_inode_info *pipe, size_t len,
 			       unsigned int flags);
 
+/* In-order data that may stay unacknowledged before an ACK goes out
+ * at once: one full segment, or tcp_delack_segs of the route's device.
+ */
+static inline u32 tcp_delack_thresh(const struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	u32 thresh = inet_csk(sk)->icsk_ack.rcv_mss;
+
+	/* never hold back more than half the window the peer may send */
+	if (tp->delack_segs > 1)
+		thresh = max(thresh, min(thresh * tp->delack_segs,
+					 tp->rcv_wnd >> 1));
+	return thresh;
+}
+
 static inline void tcp_dec_quickack_mode(struct sock *sk,
 					 const unsigned int pkts)
 {
@@ -240,6 +240,10 @@ struct snd_soc_jack_gpio;
 #endif
 
 typedef int (*hw_write_t)(void *,const char* ,int);
+typedef int (*hw_write_batch_t)(void *, const char *, int, int);
+
+/* Register writes queued by snd_soc_cache_batch_begin() before a flush */
+#define SND_SOC_CACHE_BATCH_MAX	16
 
 extern struct snd_ac97_bus_ops soc_ac97_ops;
 
@@ -257,6 +261,10 @@ int snd_soc_codec_volatile_register(struct snd_soc_codec *codec, int reg);
 int snd_soc_codec_set_cache_io(struct snd_soc_codec *codec,
 			       int addr_bits, int data_bits,
 			       enum snd_soc_control_type control);
+int snd_soc_cache_sync(struct snd_soc_codec *codec);
+void snd_soc_cache_batch_begin(struct snd_soc_codec *codec);
+int snd_soc_cache_batch_flush(struct snd_soc_codec *codec);
+int snd_soc_cache_batch_end(struct snd_soc_codec *codec);
 
 /* pcm <-> DAI connect */
 void snd_soc_free_pcms(struct snd_soc_device *socdev);
@@ -449,11 +457,19 @@ struct snd_soc_codec {
 	int (*volatile_register)(unsigned int);
 	int (*readable_register)(unsigned int);
 	hw_write_t hw_write;
+	hw_write_batch_t hw_write_batch;
 	unsigned int (*hw_read)(struct snd_soc_codec *, unsigned int);
 	void *reg_cache;
+	const void *reg_def_copy;	/* register values after a reset */
 	short reg_cache_size;
 	short reg_cache_step;
 
+	/* register writes queued by snd_soc_cache_batch_begin() */
+	unsigned int batch_depth;
+	unsigned int batch_count;
+	unsigned short batch_reg[SND_SOC_CACHE_BATCH_MAX];
+	unsigned short batch_val[SND_SOC_CACHE_BATCH_MAX];
+
 	unsigned int idle_bias_off:1; /* Use BIAS_OFF instead of STANDBY */
 	unsigned int cache_only:1;  /* Suppress writes to hardware */
 	unsigned int cache_sync:1; /* Cache needs to be synced to hardware */
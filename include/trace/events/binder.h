@@ -0,0 +1,88 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM binder
+
+#if !defined(_TRACE_BINDER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BINDER_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * binder_transaction - a transaction or reply is queued to its target
+ * @debug_id:	id of the transaction, as in the binder debugfs files
+ * @reply:	non-zero for BC_REPLY
+ * @to_proc:	pid of the target process
+ * @to_thread:	pid of the target thread, 0 if any thread may take it
+ * @code:	transaction code
+ * @flags:	TF_* flags
+ */
+TRACE_EVENT(binder_transaction,
+
+	TP_PROTO(int debug_id, int reply, int to_proc, int to_thread,
+		unsigned int code, unsigned int flags),
+
+	TP_ARGS(debug_id, reply, to_proc, to_thread, code, flags),
+
+	TP_STRUCT__entry(
+		__field(	int,		debug_id	)
+		__field(	int,		reply		)
+		__field(	int,		to_proc		)
+		__field(	int,		to_thread	)
+		__field(	unsigned int,	code		)
+		__field(	unsigned int,	flags		)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id	= debug_id;
+		__entry->reply		= reply;
+		__entry->to_proc	= to_proc;
+		__entry->to_thread	= to_thread;
+		__entry->code		= code;
+		__entry->flags		= flags;
+	),
+
+	TP_printk("transaction=%d dest_proc=%d dest_thread=%d reply=%d "
+		"code=0x%x flags=0x%x", __entry->debug_id, __entry->to_proc,
+		__entry->to_thread, __entry->reply, __entry->code,
+		__entry->flags)
+);
+
+/**
+ * binder_alloc_buf - a transaction buffer is allocated in the target
+ * @to_proc:	pid of the process the buffer is allocated in
+ * @data_size:	size of the transaction data
+ * @offsets_size: size of the object offsets array
+ * @is_async:	non-zero if taken from the async space
+ * @ok:		zero if the allocation failed
+ */
+TRACE_EVENT(binder_alloc_buf,
+
+	TP_PROTO(int to_proc, size_t data_size, size_t offsets_size,
+		int is_async, int ok),
+
+	TP_ARGS(to_proc, data_size, offsets_size, is_async, ok),
+
+	TP_STRUCT__entry(
+		__field(	int,		to_proc		)
+		__field(	size_t,		data_size	)
+		__field(	size_t,		offsets_size	)
+		__field(	int,		is_async	)
+		__field(	int,		ok		)
+	),
+
+	TP_fast_assign(
+		__entry->to_proc	= to_proc;
+		__entry->data_size	= data_size;
+		__entry->offsets_size	= offsets_size;
+		__entry->is_async	= is_async;
+		__entry->ok		= ok;
+	),
+
+	TP_printk("proc=%d data_size=%zu offsets_size=%zu async=%d%s",
+		__entry->to_proc, __entry->data_size, __entry->offsets_size,
+		__entry->is_async, __entry->ok ? "" : " failed")
+);
+
+#endif /* _TRACE_BINDER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
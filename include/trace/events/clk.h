@@ -0,0 +1,44 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM clk
+
+#if !defined(_TRACE_CLK_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CLK_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * clk_rate_change - called after a clock has been reprogrammed
+ * @name:	name of the clock
+ * @old_rate:	rate before the change, in Hz
+ * @new_rate:	rate after the change, in Hz
+ * @latency_us:	time taken by the change, including any voltage change
+ */
+TRACE_EVENT(clk_rate_change,
+
+	TP_PROTO(const char *name, unsigned long old_rate,
+		unsigned long new_rate, unsigned int latency_us),
+
+	TP_ARGS(name, old_rate, new_rate, latency_us),
+
+	TP_STRUCT__entry(
+		__string(	name,		name		)
+		__field(	unsigned long,	old_rate	)
+		__field(	unsigned long,	new_rate	)
+		__field(	unsigned int,	latency_us	)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->old_rate	= old_rate;
+		__entry->new_rate	= new_rate;
+		__entry->latency_us	= latency_us;
+	),
+
+	TP_printk("%s %lu -> %lu in %u us", __get_str(name),
+		__entry->old_rate, __entry->new_rate, __entry->latency_us)
+);
+
+#endif /* _TRACE_CLK_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,49 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM dma
+
+#if !defined(_TRACE_DMA_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_DMA_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * dma_sg_maint - cache maintenance done for a scatterlist
+ * @op:		"map", "unmap", "sync_cpu" or "sync_device"
+ * @nents:	number of segments
+ * @bytes:	total length of the segments
+ * @dir:	DMA direction
+ * @duration_ns: time spent in cache maintenance, including the final
+ *		outer cache sync
+ */
+TRACE_EVENT(dma_sg_maint,
+
+	TP_PROTO(const char *op, int nents, size_t bytes, int dir,
+		unsigned long long duration_ns),
+
+	TP_ARGS(op, nents, bytes, dir, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(	const char *,		op		)
+		__field(	int,			nents		)
+		__field(	size_t,			bytes		)
+		__field(	int,			dir		)
+		__field(	unsigned long long,	duration_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->op		= op;
+		__entry->nents		= nents;
+		__entry->bytes		= bytes;
+		__entry->dir		= dir;
+		__entry->duration_ns	= duration_ns;
+	),
+
+	TP_printk("%s nents=%d bytes=%zu dir=%d in %llu ns", __entry->op,
+		__entry->nents, __entry->bytes, __entry->dir,
+		__entry->duration_ns)
+);
+
+#endif /* _TRACE_DMA_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,97 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM nvhost
+
+#if !defined(_TRACE_NVHOST_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_NVHOST_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * nvhost_channel_submit - a command buffer is pushed to a channel
+ * @name:	channel name
+ * @num_pairs:	number of opcode pairs pushed
+ * @syncpt_id:	syncpoint the submit increments
+ * @syncpt_val:	syncpoint value once the submit completes
+ */
+TRACE_EVENT(nvhost_channel_submit,
+
+	TP_PROTO(const char *name, int num_pairs, u32 syncpt_id,
+		u32 syncpt_val),
+
+	TP_ARGS(name, num_pairs, syncpt_id, syncpt_val),
+
+	TP_STRUCT__entry(
+		__field(	const char *,	name		)
+		__field(	int,		num_pairs	)
+		__field(	u32,		syncpt_id	)
+		__field(	u32,		syncpt_val	)
+	),
+
+	TP_fast_assign(
+		__entry->name		= name;
+		__entry->num_pairs	= num_pairs;
+		__entry->syncpt_id	= syncpt_id;
+		__entry->syncpt_val	= syncpt_val;
+	),
+
+	TP_printk("%s pairs=%d syncpt=%u fence=%u", __entry->name,
+		__entry->num_pairs, __entry->syncpt_id, __entry->syncpt_val)
+);
+
+/**
+ * nvhost_syncpt_incr - a syncpoint is incremented from the cpu
+ * @id:		syncpoint id
+ */
+TRACE_EVENT(nvhost_syncpt_incr,
+
+	TP_PROTO(u32 id),
+
+	TP_ARGS(id),
+
+	TP_STRUCT__entry(
+		__field(	u32,		id		)
+	),
+
+	TP_fast_assign(
+		__entry->id		= id;
+	),
+
+	TP_printk("syncpt=%u", __entry->id)
+);
+
+/**
+ * nvhost_syncpt_wait - a cpu wait for a syncpoint threshold has ended
+ * @id:		syncpoint id
+ * @thresh:	value waited for
+ * @result:	0, -EAGAIN on timeout or the error from the wait
+ * @duration_ns: time spent waiting
+ */
+TRACE_EVENT(nvhost_syncpt_wait,
+
+	TP_PROTO(u32 id, u32 thresh, int result,
+		unsigned long long duration_ns),
+
+	TP_ARGS(id, thresh, result, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(	u32,			id		)
+		__field(	u32,			thresh		)
+		__field(	int,			result		)
+		__field(	unsigned long long,	duration_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->id		= id;
+		__entry->thresh		= thresh;
+		__entry->result		= result;
+		__entry->duration_ns	= duration_ns;
+	),
+
+	TP_printk("syncpt=%u thresh=%u result=%d in %llu ns", __entry->id,
+		__entry->thresh, __entry->result, __entry->duration_ns)
+);
+
+#endif /* _TRACE_NVHOST_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,108 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM nvmap
+
+#if !defined(_TRACE_NVMAP_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_NVMAP_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * nvmap_alloc - backing memory is allocated for a handle
+ * @handle:	the handle
+ * @size:	handle size in bytes
+ * @flags:	cache flags of the handle
+ * @sysmem:	non-zero when served from the page allocator
+ * @err:	0 or the allocation error
+ */
+TRACE_EVENT(nvmap_alloc,
+
+	TP_PROTO(const void *handle, size_t size, unsigned int flags,
+		int sysmem, int err),
+
+	TP_ARGS(handle, size, flags, sysmem, err),
+
+	TP_STRUCT__entry(
+		__field(	const void *,	handle		)
+		__field(	size_t,		size		)
+		__field(	unsigned int,	flags		)
+		__field(	int,		sysmem		)
+		__field(	int,		err		)
+	),
+
+	TP_fast_assign(
+		__entry->handle		= handle;
+		__entry->size		= size;
+		__entry->flags		= flags;
+		__entry->sysmem		= sysmem;
+		__entry->err		= err;
+	),
+
+	TP_printk("handle=%p size=%zu flags=%u %s err=%d", __entry->handle,
+		__entry->size, __entry->flags,
+		__entry->sysmem ? "sysmem" : "carveout", __entry->err)
+);
+
+/**
+ * nvmap_pin - a handle is pinned
+ * @handle:	the handle
+ * @size:	handle size in bytes
+ * @pin:	pin count after this pin, 1 if the handle had to be mapped
+ */
+TRACE_EVENT(nvmap_pin,
+
+	TP_PROTO(const void *handle, size_t size, int pin),
+
+	TP_ARGS(handle, size, pin),
+
+	TP_STRUCT__entry(
+		__field(	const void *,	handle		)
+		__field(	size_t,		size		)
+		__field(	int,		pin		)
+	),
+
+	TP_fast_assign(
+		__entry->handle		= handle;
+		__entry->size		= size;
+		__entry->pin		= pin;
+	),
+
+	TP_printk("handle=%p size=%zu pin=%d", __entry->handle,
+		__entry->size, __entry->pin)
+);
+
+/**
+ * nvmap_cache_op - cache maintenance is requested on part of a handle
+ * @handle:	the handle
+ * @start:	start offset in the handle
+ * @end:	end offset in the handle
+ * @op:		NVMAP_CACHE_OP_*
+ */
+TRACE_EVENT(nvmap_cache_op,
+
+	TP_PROTO(const void *handle, unsigned long start, unsigned long end,
+		unsigned int op),
+
+	TP_ARGS(handle, start, end, op),
+
+	TP_STRUCT__entry(
+		__field(	const void *,	handle		)
+		__field(	unsigned long,	start		)
+		__field(	unsigned long,	end		)
+		__field(	unsigned int,	op		)
+	),
+
+	TP_fast_assign(
+		__entry->handle		= handle;
+		__entry->start		= start;
+		__entry->end		= end;
+		__entry->op		= op;
+	),
+
+	TP_printk("handle=%p start=0x%lx end=0x%lx op=%u", __entry->handle,
+		__entry->start, __entry->end, __entry->op)
+);
+
+#endif /* _TRACE_NVMAP_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,64 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tegra_dc
+
+#if !defined(_TRACE_TEGRA_DC_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_TEGRA_DC_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * tegra_dc_flip - new window state is latched for the next frame
+ * @id:		display controller index
+ * @windows:	number of windows updated
+ * @partial:	non-zero if a one-shot output only gets part of the frame
+ */
+TRACE_EVENT(tegra_dc_flip,
+
+	TP_PROTO(int id, int windows, int partial),
+
+	TP_ARGS(id, windows, partial),
+
+	TP_STRUCT__entry(
+		__field(	int,		id		)
+		__field(	int,		windows		)
+		__field(	int,		partial		)
+	),
+
+	TP_fast_assign(
+		__entry->id		= id;
+		__entry->windows	= windows;
+		__entry->partial	= partial;
+	),
+
+	TP_printk("dc=%d windows=%d%s", __entry->id, __entry->windows,
+		__entry->partial ? " partial" : "")
+);
+
+/**
+ * tegra_dc_vblank - vertical blank interrupt
+ * @id:		display controller index
+ * @count:	vblanks counted while someone waits for them
+ */
+TRACE_EVENT(tegra_dc_vblank,
+
+	TP_PROTO(int id, u32 count),
+
+	TP_ARGS(id, count),
+
+	TP_STRUCT__entry(
+		__field(	int,		id		)
+		__field(	u32,		count		)
+	),
+
+	TP_fast_assign(
+		__entry->id		= id;
+		__entry->count		= count;
+	),
+
+	TP_printk("dc=%d count=%u", __entry->id, __entry->count)
+);
+
+#endif /* _TRACE_TEGRA_DC_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,73 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tegra_dma
+
+#if !defined(_TRACE_TEGRA_DMA_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_TEGRA_DMA_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * tegra_dma_req_start - a request (or its next segment) is programmed
+ * @channel:	APB DMA channel
+ * @req_sel:	requestor
+ * @size:	bytes programmed
+ * @to_memory:	direction, 1 for device to memory
+ */
+TRACE_EVENT(tegra_dma_req_start,
+
+	TP_PROTO(int channel, unsigned long req_sel, unsigned int size,
+		int to_memory),
+
+	TP_ARGS(channel, req_sel, size, to_memory),
+
+	TP_STRUCT__entry(
+		__field(	int,		channel		)
+		__field(	unsigned long,	req_sel		)
+		__field(	unsigned int,	size		)
+		__field(	int,		to_memory	)
+	),
+
+	TP_fast_assign(
+		__entry->channel	= channel;
+		__entry->req_sel	= req_sel;
+		__entry->size		= size;
+		__entry->to_memory	= to_memory;
+	),
+
+	TP_printk("ch=%d req_sel=%lu size=%u %s", __entry->channel,
+		__entry->req_sel, __entry->size,
+		__entry->to_memory ? "to_memory" : "from_memory")
+);
+
+/**
+ * tegra_dma_req_complete - a request is handed back to its client
+ * @channel:	APB DMA channel
+ * @bytes:	bytes transferred
+ * @status:	request status, negative if aborted
+ */
+TRACE_EVENT(tegra_dma_req_complete,
+
+	TP_PROTO(int channel, int bytes, int status),
+
+	TP_ARGS(channel, bytes, status),
+
+	TP_STRUCT__entry(
+		__field(	int,		channel		)
+		__field(	int,		bytes		)
+		__field(	int,		status		)
+	),
+
+	TP_fast_assign(
+		__entry->channel	= channel;
+		__entry->bytes		= bytes;
+		__entry->status		= status;
+	),
+
+	TP_printk("ch=%d bytes=%d status=%d", __entry->channel,
+		__entry->bytes, __entry->status)
+);
+
+#endif /* _TRACE_TEGRA_DMA_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
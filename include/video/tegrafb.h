@@ -86,8 +86,20 @@ struct tegra_fb_modedb {
 	__u32 modedb_len;
 };
 
+/*
+ * Last flip that reached the screen: its post_syncpt_val, the time it was
+ * latched (CLOCK_MONOTONIC, ns) and the number of flips that were replaced
+ * by a newer one before being shown.
+ */
+struct tegra_fb_present {
+	__u32 syncpt_val;
+	__u32 dropped;
+	__u64 timestamp_ns;
+};
+
 #define FBIO_TEGRA_SET_NVMAP_FD	_IOW('F', 0x40, __u32)
 #define FBIO_TEGRA_FLIP		_IOW('F', 0x41, struct tegra_fb_flip_args)
 #define FBIO_TEGRA_GET_MODEDB	_IOWR('F', 0x42, struct tegra_fb_modedb)
+#define FBIO_TEGRA_GET_PRESENT	_IOR('F', 0x43, struct tegra_fb_present)
 
 #endif
@@ -21,6 +21,11 @@
 #include <linux/uaccess.h>
 #include <linux/freezer.h>
 #include <linux/seq_file.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+
+/* how long a write of FROZEN waits for the tasks to reach the refrigerator */
+#define FREEZE_WAIT_MS		100
 
 enum freezer_state {
 	CGROUP_THAWED = 0,
@@ -32,6 +37,11 @@ struct freezer {
 	struct cgroup_subsys_state css;
 	enum freezer_state state;
 	spinlock_t lock; /* protects _writes_ to state */
+	wait_queue_head_t frozen_wait;
+	atomic_t frozen_events;	/* tasks that entered the refrigerator */
+	ktime_t freeze_start;
+	ktime_t freeze_latency;	/* last FREEZING -> FROZEN */
+	ktime_t thaw_latency;	/* last thaw pass */
 };
 
 static inline struct freezer *cgroup_freezer(
@@ -64,6 +74,25 @@ int cgroup_freezing_or_frozen(struct task_struct *task)
 	return (state == CGROUP_FREEZING) || (state == CGROUP_FROZEN);
 }
 
+/*
+ * Called by a task that has just entered the refrigerator, so that a
+ * writer waiting for the cgroup to become FROZEN rechecks it.
+ */
+void cgroup_freezer_frozen(struct task_struct *task)
+{
+	struct freezer *freezer;
+
+	rcu_read_lock();
+	freezer = task_freezer(task);
+	if (freezer->css.cgroup->parent) {
+		atomic_inc(&freezer->frozen_events);
+		smp_mb__after_atomic_inc();
+		if (waitqueue_active(&freezer->frozen_wait))
+			wake_up(&freezer->frozen_wait);
+	}
+	rcu_read_unlock();
+}
+
 /*
  * cgroups_write_string() limits the size of freezer state strings to
  * CGROUP_LOCAL_BUFFER_SIZE
@@ -133,6 +162,15 @@ struct cgroup_subsys freezer_subsys;
  *   read_lock css_set_lock (cgroup iterator start)
  *    task->alloc_lock (inside thaw_process(), prevents race with refrigerator())
  *     sighand->siglock
+ *
+ * freezer_wait_frozen() (after freeze, css reference held):
+ * cgroup_mutex
+ *  freezer->lock
+ *   read_lock css_set_lock (cgroup iterator start)
+ *
+ * cgroup_freezer_frozen() (from refrigerator()):
+ * rcu_read_lock
+ *  freezer->frozen_wait.lock
  */
 static struct cgroup_subsys_state *freezer_create(struct cgroup_subsys *ss,
 						  struct cgroup *cgroup)
@@ -144,6 +182,7 @@ static struct cgroup_subsys_state *freezer_create(struct cgroup_subsys *ss,
 		return ERR_PTR(-ENOMEM);
 
 	spin_lock_init(&freezer->lock);
+	init_waitqueue_head(&freezer->frozen_wait);
 	freezer->state = CGROUP_THAWED;
 	return &freezer->css;
 }
@@ -263,9 +302,12 @@ static void update_freezer_state(struct cgroup *cgroup,
 	 * that we never exist in the FROZEN state while there are unfrozen
 	 * tasks.
 	 */
-	if (nfrozen == ntotal)
+	if (nfrozen == ntotal) {
+		if (freezer->state == CGROUP_FREEZING)
+			freezer->freeze_latency = ktime_sub(ktime_get(),
+						freezer->freeze_start);
 		freezer->state = CGROUP_FROZEN;
-	else if (nfrozen > 0)
+	} else if (nfrozen > 0)
 		freezer->state = CGROUP_FREEZING;
 	else
 		freezer->state = CGROUP_THAWED;
@@ -304,6 +346,8 @@ static int try_to_freeze_cgroup(struct cgroup *cgroup, struct freezer *freezer)
 	struct task_struct *task;
 	unsigned int num_cant_freeze_now = 0;
 
+	if (freezer->state == CGROUP_THAWED)
+		freezer->freeze_start = ktime_get();
 	freezer->state = CGROUP_FREEZING;
 	cgroup_iter_start(cgroup, &it);
 	while ((task = cgroup_iter_next(cgroup, &it))) {
@@ -323,14 +367,18 @@ static void unfreeze_cgroup(struct cgroup *cgroup, struct freezer *freezer)
 {
 	struct cgroup_iter it;
 	struct task_struct *task;
+	ktime_t start = ktime_get();
 
 	cgroup_iter_start(cgroup, &it);
 	while ((task = cgroup_iter_next(cgroup, &it))) {
-		thaw_process(task);
+		/* most tasks of a frozen cgroup need a wakeup, skip the rest */
+		if (frozen(task) || freezing(task))
+			thaw_process(task);
 	}
 	cgroup_iter_end(cgroup, &it);
 
 	freezer->state = CGROUP_THAWED;
+	freezer->thaw_latency = ktime_sub(ktime_get(), start);
 }
 
 static int freezer_change_state(struct cgroup *cgroup,
@@ -343,7 +391,9 @@ static int freezer_change_state(struct cgroup *cgroup,
 
 	spin_lock_irq(&freezer->lock);
 
-	update_freezer_state(cgroup, freezer);
+	/* a THAWED cgroup has no frozen tasks, no need to count them */
+	if (freezer->state != CGROUP_THAWED)
+		update_freezer_state(cgroup, freezer);
 	if (goal_state == freezer->state)
 		goto out;
 
@@ -363,10 +413,43 @@ out:
 	return retval;
 }
 
+/*
+ * Wait until every task of a FREEZING cgroup is in the refrigerator, or
+ * FREEZE_WAIT_MS has passed.  Each task entering the refrigerator wakes
+ * us to recount; the short timeout per wait covers tasks that exit
+ * instead.  The cgroup is only held by the css reference the caller
+ * took, cgroup_mutex is retaken for each recount.
+ */
+static void freezer_wait_frozen(struct cgroup *cgroup, struct freezer *freezer)
+{
+	unsigned long timeout = jiffies + msecs_to_jiffies(FREEZE_WAIT_MS);
+	int events;
+	bool done;
+
+	for (;;) {
+		events = atomic_read(&freezer->frozen_events);
+		if (!cgroup_lock_live_group(cgroup))
+			return;
+		spin_lock_irq(&freezer->lock);
+		if (freezer->state == CGROUP_FREEZING)
+			update_freezer_state(cgroup, freezer);
+		done = freezer->state != CGROUP_FREEZING;
+		spin_unlock_irq(&freezer->lock);
+		cgroup_unlock();
+
+		if (done || time_after_eq(jiffies, timeout))
+			return;
+		wait_event_timeout(freezer->frozen_wait,
+			atomic_read(&freezer->frozen_events) != events,
+			msecs_to_jiffies(10));
+	}
+}
+
 static int freezer_write(struct cgroup *cgroup,
 			 struct cftype *cft,
 			 const char *buffer)
 {
+	struct freezer *freezer;
 	int retval;
 	enum freezer_state goal_state;
 
@@ -380,16 +463,44 @@ static int freezer_write(struct cgroup *cgroup,
 	if (!cgroup_lock_live_group(cgroup))
 		return -ENODEV;
 	retval = freezer_change_state(cgroup, goal_state);
+	if (!retval && goal_state == CGROUP_FROZEN) {
+		freezer = cgroup_freezer(cgroup);
+		css_get(&freezer->css);
+		cgroup_unlock();
+		freezer_wait_frozen(cgroup, freezer);
+		css_put(&freezer->css);
+		return 0;
+	}
 	cgroup_unlock();
 	return retval;
 }
 
+static u64 freezer_freeze_latency_read(struct cgroup *cgroup,
+				       struct cftype *cft)
+{
+	return ktime_to_us(cgroup_freezer(cgroup)->freeze_latency);
+}
+
+static u64 freezer_thaw_latency_read(struct cgroup *cgroup,
+				     struct cftype *cft)
+{
+	return ktime_to_us(cgroup_freezer(cgroup)->thaw_latency);
+}
+
 static struct cftype files[] = {
 	{
 		.name = "state",
 		.read_seq_string = freezer_read,
 		.write_string = freezer_write,
 	},
+	{
+		.name = "freeze_latency_us",
+		.read_u64 = freezer_freeze_latency_read,
+	},
+	{
+		.name = "thaw_latency_us",
+		.read_u64 = freezer_thaw_latency_read,
+	},
 };
 
 static int freezer_populate(struct cgroup_subsys *ss, struct cgroup *cgroup)
@@ -0,0 +1,151 @@
+/*
+ * cgroup_timer_slack.c - control group timer slack subsystem
+ *
+ * Tasks take the timer slack of their cgroup when they join it and when
+ * the cgroup's value is written.  With a large slack on the cgroup of
+ * background applications, their nanosleep, poll and select timeouts ride
+ * on wakeups the CPU takes anyway instead of breaking up idle periods.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/hrtimer.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+struct timer_slack_cgroup {
+	struct cgroup_subsys_state css;
+	unsigned long timer_slack_ns;
+	atomic_long_t coalesced;	/* sleeper wakeups taken early */
+};
+
+static inline struct timer_slack_cgroup *cgroup_timer_slack(
+		struct cgroup *cgroup)
+{
+	return container_of(
+		cgroup_subsys_state(cgroup, timer_slack_subsys_id),
+		struct timer_slack_cgroup, css);
+}
+
+static inline struct timer_slack_cgroup *task_timer_slack(
+		struct task_struct *task)
+{
+	return container_of(task_subsys_state(task, timer_slack_subsys_id),
+			    struct timer_slack_cgroup, css);
+}
+
+/*
+ * Called from hrtimer_interrupt() when the timer of a task sleeping in
+ * nanosleep, poll or select expires inside its slack, on an interrupt
+ * taken for another timer: a wakeup of its own was avoided.
+ */
+void cgroup_timer_slack_coalesced(struct task_struct *task)
+{
+	rcu_read_lock();
+	atomic_long_inc(&task_timer_slack(task)->coalesced);
+	rcu_read_unlock();
+}
+
+static struct cgroup_subsys_state *tslack_create(struct cgroup_subsys *ss,
+						 struct cgroup *cgroup)
+{
+	struct timer_slack_cgroup *tslack;
+
+	tslack = kzalloc(sizeof(*tslack), GFP_KERNEL);
+	if (!tslack)
+		return ERR_PTR(-ENOMEM);
+
+	if (cgroup->parent)
+		tslack->timer_slack_ns =
+			cgroup_timer_slack(cgroup->parent)->timer_slack_ns;
+	else
+		tslack->timer_slack_ns = init_task.timer_slack_ns;
+	return &tslack->css;
+}
+
+static void tslack_destroy(struct cgroup_subsys *ss, struct cgroup *cgroup)
+{
+	kfree(cgroup_timer_slack(cgroup));
+}
+
+/* The cgroup's slack also becomes what PR_SET_TIMERSLACK 0 restores. */
+static void tslack_set_task(struct task_struct *task, unsigned long slack)
+{
+	task->timer_slack_ns = slack;
+	task->default_timer_slack_ns = slack;
+}
+
+static void tslack_attach(struct cgroup_subsys *ss, struct cgroup *cgroup,
+			  struct cgroup *old_cgroup, struct task_struct *task,
+			  bool threadgroup)
+{
+	unsigned long slack = cgroup_timer_slack(cgroup)->timer_slack_ns;
+	struct task_struct *c;
+
+	tslack_set_task(task, slack);
+	if (threadgroup) {
+		rcu_read_lock();
+		list_for_each_entry_rcu(c, &task->thread_group, thread_group)
+			tslack_set_task(c, slack);
+		rcu_read_unlock();
+	}
+}
+
+static u64 tslack_read(struct cgroup *cgroup, struct cftype *cft)
+{
+	return cgroup_timer_slack(cgroup)->timer_slack_ns;
+}
+
+static int tslack_write(struct cgroup *cgroup, struct cftype *cft, u64 val)
+{
+	struct cgroup_iter it;
+	struct task_struct *task;
+
+	if (val > ULONG_MAX)
+		return -EINVAL;
+
+	if (!cgroup_lock_live_group(cgroup))
+		return -ENODEV;
+	cgroup_timer_slack(cgroup)->timer_slack_ns = val;
+	cgroup_iter_start(cgroup, &it);
+	while ((task = cgroup_iter_next(cgroup, &it)))
+		tslack_set_task(task, val);
+	cgroup_iter_end(cgroup, &it);
+	cgroup_unlock();
+	return 0;
+}
+
+static u64 tslack_coalesced_read(struct cgroup *cgroup, struct cftype *cft)
+{
+	return atomic_long_read(&cgroup_timer_slack(cgroup)->coalesced);
+}
+
+static struct cftype files[] = {
+	{
+		.name = "timer_slack_ns",
+		.read_u64 = tslack_read,
+		.write_u64 = tslack_write,
+	},
+	{
+		.name = "coalesced_wakeups",
+		.read_u64 = tslack_coalesced_read,
+	},
+};
+
+static int tslack_populate(struct cgroup_subsys *ss, struct cgroup *cgroup)
+{
+	return cgroup_add_files(cgroup, ss, files, ARRAY_SIZE(files));
+}
+
+struct cgroup_subsys timer_slack_subsys = {
+	.name		= "timer_slack",
+	.create		= tslack_create,
+	.destroy	= tslack_destroy,
+	.populate	= tslack_populate,
+	.subsys_id	= timer_slack_subsys_id,
+	.attach		= tslack_attach,
+};
@@ -33,6 +33,7 @@ void refrigerator(void)
 	if (freezing(current)) {
 		frozen_process();
 		task_unlock(current);
+		cgroup_freezer_frozen(current);
 	} else {
 		task_unlock(current);
 		return;
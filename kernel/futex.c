@@ -68,6 +68,12 @@ int __read_mostly futex_cmpxchg_enabled;
 
 #define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
 
+/*
+ * Process private futexes hash into a small table of their own mm, so
+ * the monitors of one VM do not share bucket locks with everybody else.
+ */
+#define FUTEX_PRIVATE_HASHBITS	4
+
 /*
  * Priority Inheritance state:
  */
@@ -142,9 +148,44 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
+
+	if (!(key->both.offset & (FUT_OFF_INODE|FUT_OFF_MMSHARED)) &&
+	    key->private.mm->futex_hash)
+		return &key->private.mm->futex_hash[hash &
+				((1 << FUTEX_PRIVATE_HASHBITS)-1)];
+
 	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
 }
 
+/*
+ * Set up the private hash of a new mm.  The table is never swapped
+ * for the global one later on, so a key always hashes to the same
+ * bucket for the lifetime of the mm.
+ */
+int futex_mm_init(struct mm_struct *mm)
+{
+	struct futex_hash_bucket *hb;
+	int i;
+
+	hb = kmalloc(sizeof(*hb) << FUTEX_PRIVATE_HASHBITS, GFP_KERNEL);
+	if (!hb)
+		return -ENOMEM;
+
+	for (i = 0; i < 1 << FUTEX_PRIVATE_HASHBITS; i++) {
+		plist_head_init(&hb[i].chain, &hb[i].lock);
+		spin_lock_init(&hb[i].lock);
+	}
+	mm->futex_hash = hb;
+
+	return 0;
+}
+
+void futex_mm_free(struct mm_struct *mm)
+{
+	kfree(mm->futex_hash);
+	mm->futex_hash = NULL;
+}
+
 /*
  * Return 1 if two futex_keys are equal, 0 otherwise.
  */
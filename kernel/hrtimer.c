@@ -1249,6 +1249,28 @@ static void __run_hrtimer(struct hrtimer *timer, ktime_t *now)
  * High resolution timer interrupt
  * Called with interrupts disabled
  */
+static enum hrtimer_restart hrtimer_wakeup(struct hrtimer *timer);
+
+/*
+ * A timer run ahead of its hard expiry rides on this interrupt, taken
+ * for some other timer, instead of needing one of its own.
+ */
+static void hrtimer_note_coalesced(struct hrtimer_cpu_base *cpu_base,
+				   struct hrtimer *timer, ktime_t basenow)
+{
+	struct hrtimer_sleeper *sleeper;
+
+	if (basenow.tv64 >= hrtimer_get_expires_tv64(timer))
+		return;
+
+	cpu_base->nr_coalesced++;
+	if (timer->function == hrtimer_wakeup) {
+		sleeper = container_of(timer, struct hrtimer_sleeper, timer);
+		if (sleeper->task)
+			cgroup_timer_slack_coalesced(sleeper->task);
+	}
+}
+
 void hrtimer_interrupt(struct clock_event_device *dev)
 {
 	struct hrtimer_cpu_base *cpu_base = &__get_cpu_var(hrtimer_bases);
@@ -1310,6 +1332,7 @@ retry:
 				break;
 			}
 
+			hrtimer_note_coalesced(cpu_base, timer, basenow);
 			__run_hrtimer(timer, &basenow);
 		}
 		base++;
@@ -13,10 +13,13 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -30,6 +33,10 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* run the handlers of one level concurrently */
+static int parallel = 1;
+module_param(parallel, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
 static void early_suspend(struct work_struct *work);
@@ -43,6 +50,9 @@ enum {
 	SUSPEND_REQUESTED_AND_SUSPENDED = SUSPEND_REQUESTED | SUSPENDED,
 };
 static int state;
+static LIST_HEAD(early_suspend_domain);
+static ktime_t early_suspend_time;
+static ktime_t late_resume_time;
 
 void register_early_suspend(struct early_suspend *handler)
 {
@@ -70,10 +80,47 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
+static void early_suspend_call(void *data, async_cookie_t cookie)
+{
+	struct early_suspend *h = data;
+	ktime_t start = ktime_get();
+
+	h->suspend(h);
+	h->suspend_time = ktime_sub(ktime_get(), start);
+}
+
+static void late_resume_call(void *data, async_cookie_t cookie)
+{
+	struct early_suspend *h = data;
+	ktime_t start = ktime_get();
+
+	h->resume(h);
+	h->resume_time = ktime_sub(ktime_get(), start);
+}
+
+/*
+ * Handlers are sorted by level.  All handlers of one level are started
+ * before any is waited for, and a level starts only after the previous
+ * one has finished.
+ */
+static void call_handler(struct early_suspend *pos, async_func_ptr *fn,
+			 int *level)
+{
+	if (pos->level != *level)
+		async_synchronize_full_domain(&early_suspend_domain);
+	*level = pos->level;
+	if (parallel)
+		async_schedule_domain(fn, pos, &early_suspend_domain);
+	else
+		fn(pos, 0);
+}
+
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
+	int level = INT_MIN;
+	ktime_t start;
 	int abort = 0;
 
 	mutex_lock(&early_suspend_lock);
@@ -93,10 +140,13 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
 		if (pos->suspend != NULL)
-			pos->suspend(pos);
+			call_handler(pos, early_suspend_call, &level);
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
+	early_suspend_time = ktime_sub(ktime_get(), start);
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
@@ -114,6 +164,8 @@ static void late_resume(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
+	int level = INT_MIN;
+	ktime_t start;
 	int abort = 0;
 
 	mutex_lock(&early_suspend_lock);
@@ -131,9 +183,12 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
 		if (pos->resume != NULL)
-			pos->resume(pos);
+			call_handler(pos, late_resume_call, &level);
+	async_synchronize_full_domain(&early_suspend_domain);
+	late_resume_time = ktime_sub(ktime_get(), start);
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 abort:
@@ -176,3 +231,48 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_stats_show(struct seq_file *s, void *data)
+{
+	struct early_suspend *pos;
+
+	mutex_lock(&early_suspend_lock);
+	seq_printf(s, "early_suspend: %lld us\n",
+		   ktime_to_us(early_suspend_time));
+	seq_printf(s, "late_resume:   %lld us\n",
+		   ktime_to_us(late_resume_time));
+	seq_printf(s, "\nlevel  suspend_us  resume_us  handler\n");
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(s, "%5d  %10lld  %9lld  %pf\n", pos->level,
+			   ktime_to_us(pos->suspend_time),
+			   ktime_to_us(pos->resume_time),
+			   pos->suspend ? (void *)pos->suspend :
+			   (void *)pos->resume);
+	mutex_unlock(&early_suspend_lock);
+
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, inode->i_private);
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.open		= early_suspend_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debugfs_init(void)
+{
+	if (!debugfs_create_file("earlysuspend", S_IRUGO, NULL, NULL,
+				 &early_suspend_stats_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+late_initcall(early_suspend_debugfs_init);
+#endif
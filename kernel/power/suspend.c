@@ -22,6 +22,7 @@
 #include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/suspend.h>
+#include <linux/wakelock.h>
 
 #include "power.h"
 
@@ -98,6 +99,10 @@ static int suspend_prepare(void)
 	if (error)
 		goto Finish;
 
+	error = suspend_abort_check("freeze");
+	if (error)
+		goto Finish;
+
 	error = usermodehelper_disable();
 	if (error)
 		goto Finish;
@@ -221,6 +226,10 @@ int suspend_devices_and_enter(suspend_state_t state)
 	if (suspend_test(TEST_DEVICES))
 		goto Recover_platform;
 
+	error = suspend_abort_check("dpm_suspend");
+	if (error)
+		goto Recover_platform;
+
 	suspend_enter(state);
 
  Resume_devices:
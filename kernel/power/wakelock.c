@@ -43,7 +43,7 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
-static int current_event_num;
+static atomic_t current_event_num = ATOMIC_INIT(0);
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
 suspend_state_t requested_suspend_state = PM_SUSPEND_MEM;
@@ -165,6 +165,47 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	}
 }
 
+/* the last few suspend attempts that were aborted, and why */
+#define SUSPEND_ABORT_LOG_SIZE	16
+
+static struct suspend_abort {
+	ktime_t time;
+	const char *phase;
+	char reason[32];
+} suspend_abort_log[SUSPEND_ABORT_LOG_SIZE];
+static unsigned int suspend_abort_count;
+
+static void log_suspend_abort_locked(const char *phase, const char *reason)
+{
+	struct suspend_abort *entry;
+
+	entry = &suspend_abort_log[suspend_abort_count++ %
+				   SUSPEND_ABORT_LOG_SIZE];
+	entry->time = ktime_get();
+	entry->phase = phase;
+	strlcpy(entry->reason, reason, sizeof(entry->reason));
+}
+
+static int suspend_abort_show(struct seq_file *m, void *unused)
+{
+	unsigned long irqflags;
+	struct suspend_abort *entry;
+	unsigned int i, start;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	seq_printf(m, "aborts: %u\n", suspend_abort_count);
+	seq_puts(m, "time\tphase\treason\n");
+	start = suspend_abort_count > SUSPEND_ABORT_LOG_SIZE ?
+		suspend_abort_count - SUSPEND_ABORT_LOG_SIZE : 0;
+	for (i = start; i < suspend_abort_count; i++) {
+		entry = &suspend_abort_log[i % SUSPEND_ABORT_LOG_SIZE];
+		seq_printf(m, "%lld\t%s\t\"%s\"\n", ktime_to_ns(entry->time),
+			   entry->phase, entry->reason);
+	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
+	return 0;
+}
+
 static void update_sleep_wait_stats_locked(int done)
 {
 	struct wake_lock *lock;
@@ -228,23 +269,29 @@ static void print_active_locks(int type)
 	}
 }
 
+/*
+ * Locks without a timeout are kept at the head of the active list and
+ * locks with one after them in order of expiry, so only the expired
+ * locks and the last one have to be looked at.
+ */
 static long has_wake_lock_locked(int type)
 {
+	struct list_head *head;
 	struct wake_lock *lock, *n;
-	long max_timeout = 0;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
+	head = &active_wake_locks[type];
+	list_for_each_entry_safe(lock, n, head, link) {
+		if (!(lock->flags & WAKE_LOCK_AUTO_EXPIRE))
 			return -1;
+		if ((long)(lock->expires - jiffies) > 0)
+			break;
+		expire_wake_lock(lock);
 	}
-	return max_timeout;
+	if (list_empty(head))
+		return 0;
+	lock = list_entry(head->prev, struct wake_lock, link);
+	return lock->expires - jiffies;
 }
 
 long has_wake_lock(int type)
@@ -259,6 +306,42 @@ long has_wake_lock(int type)
 	return ret;
 }
 
+/*
+ * Called at each phase boundary of the suspend sequence so that an
+ * attempt that is going to be aborted anyway backs out before doing
+ * more work.  Returns -EAGAIN if a suspend wake lock is held or a
+ * wakeup event has been reported, and records the phase and reason.
+ */
+int suspend_abort_check(const char *phase)
+{
+	struct wake_lock *lock;
+	unsigned long irqflags;
+	const char *reason = NULL;
+	bool events_ok;
+
+	events_ok = pm_check_wakeup_events();
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	if (has_wake_lock_locked(WAKE_LOCK_SUSPEND)) {
+		lock = list_first_entry(&active_wake_locks[WAKE_LOCK_SUSPEND],
+					struct wake_lock, link);
+		reason = lock->name;
+	} else if (!events_ok) {
+		reason = "wakeup event";
+	}
+	if (reason) {
+		if (debug_mask & DEBUG_SUSPEND)
+			pr_info("suspend: abort at %s, %s\n", phase, reason);
+#ifdef CONFIG_WAKELOCK_STAT
+		log_suspend_abort_locked(phase, reason);
+#endif
+	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	return reason ? -EAGAIN : 0;
+}
+EXPORT_SYMBOL(suspend_abort_check);
+
 static void suspend(struct work_struct *work)
 {
 	int ret;
@@ -270,7 +353,7 @@ static void suspend(struct work_struct *work)
 		return;
 	}
 
-	entry_event_num = current_event_num;
+	entry_event_num = atomic_read(&current_event_num);
 	sys_sync();
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("suspend: enter suspend\n");
@@ -285,7 +368,7 @@ static void suspend(struct work_struct *work)
 			tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
 			tm.tm_hour, tm.tm_min, tm.tm_sec, ts.tv_nsec);
 	}
-	if (current_event_num == entry_event_num) {
+	if (atomic_read(&current_event_num) == entry_event_num) {
 		if (debug_mask & DEBUG_SUSPEND)
 			pr_info("suspend: pm_suspend returned with no event\n");
 		wake_lock_timeout(&unknown_wakeup, HZ / 2);
@@ -313,7 +396,7 @@ static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
 static int power_suspend_late(struct device *dev)
 {
-	int ret = has_wake_lock(WAKE_LOCK_SUSPEND) ? -EAGAIN : 0;
+	int ret = suspend_abort_check("suspend_noirq");
 #ifdef CONFIG_WAKELOCK_STAT
 	wait_for_wakeup = 1;
 #endif
@@ -392,6 +475,7 @@ EXPORT_SYMBOL(wake_lock_destroy);
 static void wake_lock_internal(
 	struct wake_lock *lock, long timeout, int has_timeout)
 {
+	struct wake_lock *pos;
 	int type;
 	unsigned long irqflags;
 	long expire_in;
@@ -427,7 +511,12 @@ static void wake_lock_internal(
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		/* keep timed locks in expiry order, most go at the tail */
+		list_for_each_entry_reverse(pos, &active_wake_locks[type], link)
+			if (!(pos->flags & WAKE_LOCK_AUTO_EXPIRE) ||
+			    (long)(pos->expires - lock->expires) <= 0)
+				break;
+		list_add(&lock->link, &pos->link);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
@@ -436,7 +525,7 @@ static void wake_lock_internal(
 		list_add(&lock->link, &active_wake_locks[type]);
 	}
 	if (type == WAKE_LOCK_SUSPEND) {
-		current_event_num++;
+		atomic_inc(&current_event_num);
 #ifdef CONFIG_WAKELOCK_STAT
 		if (lock == &main_wake_lock)
 			update_sleep_wait_stats_locked(1);
@@ -464,8 +553,28 @@ static void wake_lock_internal(
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 
+#ifdef CONFIG_WAKELOCK_STAT
+#define wakeup_pending()	(wait_for_wakeup)
+#else
+#define wakeup_pending()	0
+#endif
+
+/*
+ * Taking a lock that is already held without a timeout, or dropping one
+ * that is not held, changes nothing on the lists.  Drivers do both per
+ * packet or input event, so they are handled without list_lock.
+ */
 void wake_lock(struct wake_lock *lock)
 {
+	int flags = ACCESS_ONCE(lock->flags);
+
+	if ((flags & (WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE)) ==
+	    WAKE_LOCK_ACTIVE && !wakeup_pending() &&
+	    !(debug_mask & DEBUG_WAKE_LOCK)) {
+		if ((flags & WAKE_LOCK_TYPE_MASK) == WAKE_LOCK_SUSPEND)
+			atomic_inc(&current_event_num);
+		return;
+	}
 	wake_lock_internal(lock, 0, 0);
 }
 EXPORT_SYMBOL(wake_lock);
@@ -480,6 +589,11 @@ void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
+
+	if (!(ACCESS_ONCE(lock->flags) & WAKE_LOCK_ACTIVE) &&
+	    !(debug_mask & DEBUG_WAKE_LOCK))
+		return;
+
 	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 #ifdef CONFIG_WAKELOCK_STAT
@@ -536,6 +650,21 @@ static const struct file_operations wakelock_stats_fops = {
 	.release = single_release,
 };
 
+#ifdef CONFIG_WAKELOCK_STAT
+static int suspend_abort_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_abort_show, NULL);
+}
+
+static const struct file_operations suspend_abort_fops = {
+	.owner = THIS_MODULE,
+	.open = suspend_abort_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static int __init wakelocks_init(void)
 {
 	int ret;
@@ -571,6 +700,7 @@ static int __init wakelocks_init(void)
 
 #ifdef CONFIG_WAKELOCK_STAT
 	proc_create("wakelocks", S_IRUGO, NULL, &wakelock_stats_fops);
+	proc_create("suspend_aborts", S_IRUGO, NULL, &suspend_abort_fops);
 #endif
 
 	return 0;
@@ -591,6 +721,7 @@ err_platform_device_register:
 static void  __exit wakelocks_exit(void)
 {
 #ifdef CONFIG_WAKELOCK_STAT
+	remove_proc_entry("suspend_aborts", NULL);
 	remove_proc_entry("wakelocks", NULL);
 #endif
 	destroy_workqueue(suspend_work_queue);
@@ -39,6 +39,9 @@
 #include <linux/syslog.h>
 #include <linux/cpu.h>
 #include <linux/notifier.h>
+#include <linux/kthread.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/uaccess.h>
 
@@ -152,6 +155,7 @@ static char *log_buf = __log_buf;
 static int log_buf_len = __LOG_BUF_LEN;
 static unsigned logged_chars; /* Number of chars produced since last read+clear operation */
 static int saved_console_loglevel = -1;
+static unsigned console_dropped; /* Messages overwritten before reaching the consoles */
 
 #ifdef CONFIG_KEXEC
 /*
@@ -594,6 +598,9 @@ static void call_console_drivers(unsigned start, unsigned end)
 
 static void emit_log_char(char c)
 {
+	/* the slot about to be reused holds the oldest unprinted char */
+	if (log_end - con_start == log_buf_len && LOG_BUF(log_end) == '\n')
+		console_dropped++;
 	LOG_BUF(log_end) = c;
 	log_end++;
 	if (log_end - log_start > log_buf_len)
@@ -735,6 +742,45 @@ static int acquire_console_semaphore_for_printk(unsigned int cpu)
 	spin_unlock(&logbuf_lock);
 	return retval;
 }
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+/*
+ * Once the system is up, printk() leaves the consoles to console_thread
+ * and returns as soon as the message is in log_buf.  Oopses, panics and
+ * the reboot and halt paths keep the synchronous flush: there may be
+ * nobody left to run the thread.
+ */
+static int printk_deferred = 1;
+module_param_named(deferred, printk_deferred, bool, S_IRUGO | S_IWUSR);
+
+static struct task_struct *console_thread;
+static DECLARE_WAIT_QUEUE_HEAD(console_wait);
+static unsigned long console_flushes_deferred, console_flushes_sync;
+static unsigned console_backlog_max;
+
+/* Called with logbuf_lock held. */
+static int console_defer(void)
+{
+	if (printk_deferred && console_thread && !oops_in_progress &&
+	    system_state == SYSTEM_RUNNING) {
+		console_flushes_deferred++;
+		return 1;
+	}
+	console_flushes_sync++;
+	return 0;
+}
+
+static void console_wake_thread(unsigned long flags);
+#else
+static inline int console_defer(void)
+{
+	return 0;
+}
+
+static inline void console_wake_thread(unsigned long flags)
+{
+}
+#endif
+
 static const char recursion_bug_msg [] =
 		KERN_CRIT "BUG: recent printk recursion!\n";
 static int recursion_bug;
@@ -869,6 +915,13 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 			new_text_line = 1;
 	}
 
+	if (console_defer()) {
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+		console_wake_thread(flags);
+		goto out_lockdep;
+	}
+
 	/*
 	 * Try to acquire and then immediately release the
 	 * console semaphore. The release will do all the
@@ -881,6 +934,7 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 */
 	if (acquire_console_semaphore_for_printk(this_cpu))
 		release_console_sem();
+out_lockdep:
 
 	lockdep_on();
 out_restore_irqs:
@@ -1119,13 +1173,23 @@ int is_console_locked(void)
 	return console_locked;
 }
 
+#define PRINTK_PENDING_KLOGD	0x01
+#define PRINTK_PENDING_CONSOLE	0x02
+
 static DEFINE_PER_CPU(int, printk_pending);
 
 void printk_tick(void)
 {
-	if (__get_cpu_var(printk_pending)) {
+	int pending = __get_cpu_var(printk_pending);
+
+	if (pending) {
 		__get_cpu_var(printk_pending) = 0;
-		wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_KLOGD)
+			wake_up_interruptible(&log_wait);
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+		if (pending & PRINTK_PENDING_CONSOLE)
+			wake_up(&console_wait);
+#endif
 	}
 }
 
@@ -1139,9 +1203,83 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		this_cpu_write(printk_pending, 1);
+		this_cpu_or(printk_pending, PRINTK_PENDING_KLOGD);
+}
+
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+/*
+ * Called by printk() with interrupts off.  A caller that had them off
+ * already might hold a runqueue lock, so such a wakeup is left to the
+ * next printk_tick() on this cpu.
+ */
+static void console_wake_thread(unsigned long flags)
+{
+	if (raw_irqs_disabled_flags(flags) || in_nmi())
+		this_cpu_or(printk_pending, PRINTK_PENDING_CONSOLE);
+	else
+		wake_up(&console_wait);
 }
 
+static int console_backlog(void)
+{
+	unsigned backlog = ACCESS_ONCE(log_end) - ACCESS_ONCE(con_start);
+
+	if (backlog > console_backlog_max)
+		console_backlog_max = backlog;
+	return backlog && !console_suspended;
+}
+
+static int console_thread_fn(void *unused)
+{
+	for (;;) {
+		wait_event(console_wait, console_backlog());
+		acquire_console_sem();
+		release_console_sem();
+	}
+	return 0;
+}
+
+static int console_backlog_show(struct seq_file *m, void *unused)
+{
+	seq_printf(m, "backlog: %u\n", log_end - con_start);
+	seq_printf(m, "backlog_max: %u\n", console_backlog_max);
+	seq_printf(m, "dropped: %u\n", console_dropped);
+	seq_printf(m, "deferred: %lu\n", console_flushes_deferred);
+	seq_printf(m, "sync: %lu\n", console_flushes_sync);
+	return 0;
+}
+
+static int console_backlog_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, console_backlog_show, NULL);
+}
+
+static const struct file_operations console_backlog_fops = {
+	.open		= console_backlog_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init console_thread_init(void)
+{
+	struct task_struct *t;
+
+	t = kthread_run(console_thread_fn, NULL, "kconsoled");
+	if (IS_ERR(t))
+		printk(KERN_ERR "printk: no console thread, printing synchronously\n");
+	else
+		console_thread = t;
+
+	debugfs_create_file("console_backlog", S_IRUGO, NULL, NULL,
+			    &console_backlog_fops);
+}
+#else
+static inline void console_thread_init(void)
+{
+}
+#endif
+
 /**
  * release_console_sem - unlock the console system
  *
@@ -1482,6 +1620,7 @@ static int __init printk_late_init(void)
 		}
 	}
 	hotcpu_notifier(console_cpu_notify, 0);
+	console_thread_init();
 	return 0;
 }
 late_initcall(printk_late_init);
@@ -47,6 +47,7 @@
 #include <linux/mutex.h>
 #include <linux/time.h>
 #include <linux/kernel_stat.h>
+#include <linux/kthread.h>
 
 #include "rcutree.h"
 
@@ -1061,6 +1062,7 @@ static void rcu_offline_cpu(int cpu)
 	__rcu_offline_cpu(cpu, &rcu_sched_state);
 	__rcu_offline_cpu(cpu, &rcu_bh_state);
 	rcu_preempt_offline_cpu(cpu);
+	rcu_nocb_wakeup_deferred(cpu);
 }
 
 #else /* #ifdef CONFIG_HOTPLUG_CPU */
@@ -1195,6 +1197,7 @@ void rcu_check_callbacks(int cpu, int user)
 	rcu_preempt_check_callbacks(cpu);
 	if (rcu_pending(cpu))
 		raise_softirq(RCU_SOFTIRQ);
+	rcu_nocb_wakeup_deferred(cpu);
 }
 
 #ifdef CONFIG_SMP
@@ -1395,6 +1398,10 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 
 	smp_mb(); /* Ensure RCU update seen before callback registry. */
 
+	/* Offloaded CPUs leave their callbacks to the kthread. */
+	if (rcu_nocb_enqueue(rsp, head))
+		return;
+
 	/*
 	 * Opportunistically note grace-period endings and beginnings.
 	 * Note that we might see a beginning right after we see an
@@ -1638,6 +1645,8 @@ static void rcu_barrier_func(void *type)
 	void (*call_rcu_func)(struct rcu_head *head,
 			      void (*func)(struct rcu_head *head));
 
+	if (rcu_is_nocb_cpu(cpu))
+		return;  /* rcu_nocb_barrier() queues it directly. */
 	atomic_inc(&rcu_barrier_cpu_count);
 	call_rcu_func = type;
 	call_rcu_func(head, rcu_barrier_callback);
@@ -1668,6 +1677,7 @@ static void _rcu_barrier(struct rcu_state *rsp,
 	preempt_disable(); /* stop CPU_DYING from filling orphan_cbs_list */
 	rcu_adopt_orphan_cbs(rsp);
 	on_each_cpu(rcu_barrier_func, (void *)call_rcu_func, 1);
+	rcu_nocb_barrier(rsp);
 	preempt_enable(); /* CPU_DYING can again fill orphan_cbs_list */
 	if (atomic_dec_and_test(&rcu_barrier_cpu_count))
 		complete(&rcu_barrier_completion);
@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/wait.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS and CONFIG_RCU_FANOUT.
@@ -231,6 +232,20 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 6) callbacks offloaded to the kthread on CPU 0. */
+	struct rcu_head *nocb_head;	/* Callbacks queued for the kthread, */
+	struct rcu_head **nocb_tail;	/*  appended to locklessly. */
+	atomic_long_t nocb_q_count;	/* # queued for the kthread. */
+	long nocb_p_count;		/* # waiting for the kthread's GP. */
+	bool nocb_defer_wakeup;		/* Wake the kthread from a safe spot. */
+	wait_queue_head_t nocb_wq;	/* The kthread waits here. */
+	struct task_struct *nocb_kthread;
+	void (*nocb_call)(struct rcu_head *head, /* Flavor's call_rcu(). */
+			  void (*func)(struct rcu_head *head));
+	unsigned long n_nocb_invoked;	/* Callbacks invoked by the kthread. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 };
 
@@ -385,5 +400,9 @@ static void __cpuinit rcu_preempt_init_percpu_data(int cpu);
 static void rcu_preempt_send_cbs_to_orphanage(void);
 static void __init __rcu_init_preempt(void);
 static void rcu_needs_cpu_flush(void);
+static bool rcu_is_nocb_cpu(int cpu);
+static bool rcu_nocb_enqueue(struct rcu_state *rsp, struct rcu_head *head);
+static void rcu_nocb_wakeup_deferred(int cpu);
+static void rcu_nocb_barrier(struct rcu_state *rsp);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
@@ -1015,6 +1015,7 @@ static void __init __rcu_init_preempt(void)
  */
 int rcu_needs_cpu(int cpu)
 {
+	rcu_nocb_wakeup_deferred(cpu);
 	return rcu_needs_cpu_quick_check(cpu);
 }
 
@@ -1057,6 +1058,8 @@ int rcu_needs_cpu(int cpu)
 	int snap_nmi;
 	int thatcpu;
 
+	rcu_nocb_wakeup_deferred(cpu);
+
 	/* Check for being in the holdoff period. */
 	if (per_cpu(rcu_dyntick_holdoff, cpu) == jiffies)
 		return rcu_needs_cpu_quick_check(cpu);
@@ -1120,3 +1123,252 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Callback offloading.  On an offloaded CPU, call_rcu() appends the
+ * callback to a per-CPU queue of its flavor and nothing else.  A kthread
+ * bound to CPU 0 takes the queue, waits for a grace period by posting
+ * its own callback on CPU 0, and then invokes the batch.  That grace
+ * period needs nothing from the offloaded CPU beyond what
+ * force_quiescent_state() reads of its dyntick-idle state, so the CPU
+ * keeps no callbacks of its own: rcu_needs_cpu() lets its tick stop,
+ * and going offline leaves it nothing to orphan.
+ */
+
+static cpumask_t rcu_nocb_mask;
+static bool rcu_nocb_mask_set;		/* rcu_nocbs= was given. */
+static bool rcu_nocb_active;		/* The kthreads are running. */
+
+static int __init rcu_nocb_setup(char *str)
+{
+	cpulist_parse(str, &rcu_nocb_mask);
+	rcu_nocb_mask_set = true;
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+static bool rcu_is_nocb_cpu(int cpu)
+{
+	return rcu_nocb_active && cpumask_test_cpu(cpu, &rcu_nocb_mask);
+}
+
+/*
+ * Append a callback to the specified CPU's offload queue, from any CPU.
+ * Only the enqueue that finds the queue empty has to wake the kthread;
+ * with "wake" clear, it leaves the wakeup to rcu_nocb_wakeup_deferred().
+ */
+static void __rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head,
+			       bool wake)
+{
+	struct rcu_head **old_tail;
+
+	old_tail = xchg(&rdp->nocb_tail, &head->next);
+	ACCESS_ONCE(*old_tail) = head;
+	atomic_long_inc(&rdp->nocb_q_count);
+	if (old_tail != &rdp->nocb_head)
+		return;
+	if (wake)
+		wake_up(&rdp->nocb_wq);
+	else
+		rdp->nocb_defer_wakeup = true;
+}
+
+/*
+ * Queue the callback for the kthread if the current CPU is offloaded,
+ * returning true if so.  Callers with irqs disabled might hold scheduler
+ * locks, so their wakeup waits for the next tick or idle entry.  The
+ * kthread itself, should it find itself on an offloaded CPU, must not
+ * queue its grace-period callback behind itself.
+ */
+static bool rcu_nocb_enqueue(struct rcu_state *rsp, struct rcu_head *head)
+{
+	unsigned long flags;
+	struct rcu_data *rdp;
+	bool ret = false;
+
+	local_irq_save(flags);
+	rdp = rsp->rda[smp_processor_id()];
+	if (rcu_is_nocb_cpu(rdp->cpu) && current != rdp->nocb_kthread) {
+		__rcu_nocb_enqueue(rdp, head, !irqs_disabled_flags(flags));
+		ret = true;
+	}
+	local_irq_restore(flags);
+	return ret;
+}
+
+static void __rcu_nocb_wakeup_deferred(struct rcu_data *rdp)
+{
+	if (!rdp->nocb_defer_wakeup)
+		return;
+	rdp->nocb_defer_wakeup = false;
+	wake_up(&rdp->nocb_wq);
+}
+
+/*
+ * Do the kthread wakeups that call_rcu() left pending on this CPU.
+ * Called from the tick, before the tick is stopped, and for a CPU that
+ * has gone offline.
+ */
+static void rcu_nocb_wakeup_deferred(int cpu)
+{
+	if (!rcu_is_nocb_cpu(cpu))
+		return;
+	__rcu_nocb_wakeup_deferred(&per_cpu(rcu_sched_data, cpu));
+	__rcu_nocb_wakeup_deferred(&per_cpu(rcu_bh_data, cpu));
+}
+
+/*
+ * Queue the barrier callback behind everything an offloaded CPU has
+ * queued, online or not.  No IPI is needed, and rcu_barrier_func()
+ * skips these CPUs.
+ */
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+	struct rcu_head *head;
+	int cpu;
+
+	if (!rcu_nocb_active)
+		return;
+	for_each_cpu(cpu, &rcu_nocb_mask) {
+		head = &per_cpu(rcu_barrier_head, cpu);
+		debug_rcu_head_queue(head);
+		head->func = rcu_barrier_callback;
+		head->next = NULL;
+		atomic_inc(&rcu_barrier_cpu_count);
+		__rcu_nocb_enqueue(rsp->rda[cpu], head, true);
+	}
+}
+
+/* Wait for a grace period of the kthread's flavor, from CPU 0. */
+static void rcu_nocb_wait_gp(struct rcu_data *rdp)
+{
+	struct rcu_synchronize rcu;
+
+	init_rcu_head_on_stack(&rcu.head);
+	init_completion(&rcu.completion);
+	rdp->nocb_call(&rcu.head, wakeme_after_rcu);
+	wait_for_completion(&rcu.completion);
+	destroy_rcu_head_on_stack(&rcu.head);
+}
+
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list, *next, **tail;
+	long c;
+
+	for (;;) {
+		wait_event_interruptible(rdp->nocb_wq,
+					 ACCESS_ONCE(rdp->nocb_head));
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list)
+			continue;
+
+		/* Take the whole queue, leaving it empty for call_rcu(). */
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		c = atomic_long_xchg(&rdp->nocb_q_count, 0);
+		ACCESS_ONCE(rdp->nocb_p_count) += c;
+
+		rcu_nocb_wait_gp(rdp);
+
+		c = 0;
+		while (list) {
+			next = ACCESS_ONCE(list->next);
+			/* An enqueue may not have linked its callback yet. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = ACCESS_ONCE(list->next);
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			list->func(list);
+			local_bh_enable();
+			list = next;
+			c++;
+			cond_resched();
+		}
+		ACCESS_ONCE(rdp->nocb_p_count) -= c;
+		rdp->n_nocb_invoked += c;
+	}
+	return 0;
+}
+
+static void __init
+rcu_spawn_nocb_kthreads(struct rcu_state *rsp,
+			void (*call_rcu_func)(struct rcu_head *head,
+					      void (*func)(struct rcu_head *head)),
+			char abbr)
+{
+	struct task_struct *t;
+	struct rcu_data *rdp;
+	int cpu;
+
+	for_each_cpu(cpu, &rcu_nocb_mask) {
+		rdp = rsp->rda[cpu];
+		rdp->nocb_head = NULL;
+		rdp->nocb_tail = &rdp->nocb_head;
+		init_waitqueue_head(&rdp->nocb_wq);
+		rdp->nocb_call = call_rcu_func;
+		t = kthread_create(rcu_nocb_kthread, rdp, "rcuo%c/%d",
+				   abbr, cpu);
+		if (IS_ERR(t)) {
+			pr_err("RCU: no callback kthread for CPU %d\n", cpu);
+			cpumask_clear_cpu(cpu, &rcu_nocb_mask);
+			continue;
+		}
+		kthread_bind(t, 0);
+		rdp->nocb_kthread = t;
+		wake_up_process(t);
+	}
+}
+
+/*
+ * Runs before the secondary CPUs are brought up, so none of them has
+ * queued callbacks the ordinary way yet.
+ */
+static int __init rcu_nocb_init(void)
+{
+	char buf[32];
+
+	if (!rcu_nocb_mask_set)
+		cpumask_copy(&rcu_nocb_mask, cpu_possible_mask);
+	cpumask_and(&rcu_nocb_mask, &rcu_nocb_mask, cpu_possible_mask);
+	cpumask_clear_cpu(0, &rcu_nocb_mask);
+	if (cpumask_empty(&rcu_nocb_mask))
+		return 0;
+
+	rcu_spawn_nocb_kthreads(&rcu_sched_state, call_rcu_sched, 's');
+	rcu_spawn_nocb_kthreads(&rcu_bh_state, call_rcu_bh, 'b');
+	smp_mb(); /* Kthreads and queues set up before first use. */
+	rcu_nocb_active = true;
+
+	cpulist_scnprintf(buf, sizeof(buf), &rcu_nocb_mask);
+	printk(KERN_INFO "RCU: callbacks offloaded from CPUs %s.\n", buf);
+	return 0;
+}
+early_initcall(rcu_nocb_init);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool rcu_is_nocb_cpu(int cpu)
+{
+	return false;
+}
+
+static bool rcu_nocb_enqueue(struct rcu_state *rsp, struct rcu_head *head)
+{
+	return false;
+}
+
+static void rcu_nocb_wakeup_deferred(int cpu)
+{
+}
+
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -607,6 +607,51 @@ void rt_mutex_adjust_pi(struct task_struct *task)
 	rt_mutex_adjust_prio_chain(task, 0, NULL, NULL, task);
 }
 
+#ifdef CONFIG_SMP
+/*
+ * Spin while the owner of the lock is running on another CPU: user
+ * space PI locks are mostly held for a few microseconds, which is far
+ * less than the cost of a sleep and a wakeup.  Called with
+ * lock->wait_lock held, drops it.  The RCU read lock keeps the owner's
+ * task_struct around once wait_lock is gone.
+ *
+ * Returns 1 if the owner changed and the lock is worth trying again
+ * without going to sleep.
+ */
+static int rt_mutex_spin_on_owner(struct rt_mutex *lock,
+				  struct rt_mutex_waiter *waiter)
+{
+	struct task_struct *owner = rt_mutex_owner(lock);
+	int ret = 0;
+
+	rcu_read_lock();
+	raw_spin_unlock(&lock->wait_lock);
+
+	if (!owner)
+		goto out;
+
+	while (waiter->task && !need_resched()) {
+		if (rt_mutex_owner(lock) != owner) {
+			ret = 1;
+			break;
+		}
+		if (!task_curr(owner))
+			break;
+		cpu_relax();
+	}
+out:
+	rcu_read_unlock();
+	return ret;
+}
+#else
+static inline int rt_mutex_spin_on_owner(struct rt_mutex *lock,
+					 struct rt_mutex_waiter *waiter)
+{
+	raw_spin_unlock(&lock->wait_lock);
+	return 0;
+}
+#endif
+
 /**
  * __rt_mutex_slowlock() - Perform the wait-wake-try-to-take loop
  * @lock:		 the rt_mutex to take
@@ -672,7 +717,10 @@ __rt_mutex_slowlock(struct rt_mutex *lock, int state,
 				break;
 		}
 
-		raw_spin_unlock(&lock->wait_lock);
+		if (rt_mutex_spin_on_owner(lock, waiter)) {
+			raw_spin_lock(&lock->wait_lock);
+			continue;
+		}
 
 		debug_rt_mutex_print_deadlock(waiter);
 
@@ -89,6 +89,26 @@ unsigned int normalized_sysctl_sched_wakeup_granularity = 1000000UL;
 
 const_debug unsigned int sysctl_sched_migration_cost = 500000UL;
 
+/*
+ * A wakeup from a group with fewer shares than the running one does not
+ * preempt it until it has run this long.
+ * (default: 3 msec, units: nanoseconds)
+ *
+ * This keeps background groups from cutting into foreground slices.
+ */
+unsigned int sysctl_sched_group_preempt_window = 3000000UL;
+
+/*
+ * On SD_PACK_WAKEUPS domains a task that ran for less than
+ * sysctl_sched_pack_burst (default: 1 msec, units: nanoseconds) on its
+ * last slice is woken on a busy cpu whose load is below
+ * sysctl_sched_pack_load_pct percent of a nice-0 task, instead of on an
+ * idle cpu.  Idle cpus in such domains do not pull from cpus below that
+ * load either.  0 turns packing off.
+ */
+unsigned int sysctl_sched_pack_load_pct = 60;
+unsigned int sysctl_sched_pack_burst = 1000000UL;
+
 static const struct sched_class fair_sched_class;
 
 /**************************************************************
@@ -267,6 +287,95 @@ find_matching_se(struct sched_entity **se, struct sched_entity **pse)
 
 #endif	/* CONFIG_FAIR_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * CFS bandwidth control: a group with a quota may run for quota ns per
+ * period, summed over all cpus.  Each cpu's cfs_rq draws runtime from
+ * the group's pool in slices; once the pool is empty the cfs_rq is
+ * throttled, i.e. its group entity is taken off the parent's tree until
+ * the period timer refills the pool.
+ */
+static const u64 sched_cfs_bandwidth_slice = 5000000ULL;
+
+static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
+{
+	return &tg->cfs_bandwidth;
+}
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return cfs_rq->throttled;
+}
+
+/* called with cfs_b->lock held */
+static void start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	unsigned long delta;
+	ktime_t now, soft, hard;
+
+	if (cfs_b->timer_active)
+		return;
+
+	cfs_b->timer_active = 1;
+	now = hrtimer_cb_get_time(&cfs_b->period_timer);
+	hrtimer_forward(&cfs_b->period_timer, now, cfs_b->period);
+
+	soft = hrtimer_get_softexpires(&cfs_b->period_timer);
+	hard = hrtimer_get_expires(&cfs_b->period_timer);
+	delta = ktime_to_ns(ktime_sub(hard, soft));
+	__hrtimer_start_range_ns(&cfs_b->period_timer, soft, delta,
+			HRTIMER_MODE_ABS_PINNED, 0);
+}
+
+static void assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	u64 amount, min_amount;
+
+	/* top the local pool up to one slice */
+	min_amount = sched_cfs_bandwidth_slice - cfs_rq->runtime_remaining;
+
+	raw_spin_lock(&cfs_b->lock);
+	if (cfs_b->quota == RUNTIME_INF) {
+		amount = min_amount;
+	} else {
+		start_cfs_bandwidth(cfs_b);
+		cfs_b->idle = 0;
+		amount = min(cfs_b->runtime, min_amount);
+		cfs_b->runtime -= amount;
+	}
+	raw_spin_unlock(&cfs_b->lock);
+
+	cfs_rq->runtime_remaining += amount;
+}
+
+static void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+				   unsigned long delta_exec)
+{
+	if (!cfs_rq->runtime_enabled)
+		return;
+
+	cfs_rq->runtime_remaining -= delta_exec;
+	if (likely(cfs_rq->runtime_remaining > 0))
+		return;
+
+	assign_cfs_rq_runtime(cfs_rq);
+	/* out of runtime: throttle at the next put_prev_entity() */
+	if (cfs_rq->runtime_remaining <= 0 && cfs_rq->curr)
+		resched_task(rq_of(cfs_rq)->curr);
+}
+#else /* !CONFIG_CFS_BANDWIDTH */
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+					  unsigned long delta_exec)
+{
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 
 /**************************************************************
  * Scheduling class tree data structure manipulation methods:
@@ -536,6 +645,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 
 	__update_curr(cfs_rq, curr, delta_exec);
 	curr->exec_start = now;
+	account_cfs_rq_runtime(cfs_rq, delta_exec);
 
 	if (entity_is_task(curr)) {
 		struct task_struct *curtask = task_of(curr);
@@ -1040,6 +1150,154 @@ static inline void hrtick_update(struct rq *rq)
 }
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq_of(cfs_rq))];
+
+	for_each_sched_entity(se) {
+		struct cfs_rq *qcfs_rq = cfs_rq_of(se);
+
+		if (!se->on_rq)
+			break;
+		dequeue_entity(qcfs_rq, se, DEQUEUE_SLEEP);
+		/* Don't dequeue parent if it has other entities besides us */
+		if (qcfs_rq->load.weight || cfs_rq_throttled(qcfs_rq))
+			break;
+	}
+	cfs_rq->throttled = 1;
+
+	/* make sure someone is around to unthrottle us */
+	raw_spin_lock(&cfs_b->lock);
+	start_cfs_bandwidth(cfs_b);
+	raw_spin_unlock(&cfs_b->lock);
+}
+
+/* called with the rq lock held */
+static void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq)];
+
+	cfs_rq->throttled = 0;
+	if (!cfs_rq->load.weight)
+		return;
+
+	update_rq_clock(rq);
+	for_each_sched_entity(se) {
+		if (se->on_rq)
+			break;
+		cfs_rq = cfs_rq_of(se);
+		enqueue_entity(cfs_rq, se, ENQUEUE_WAKEUP);
+		/* a throttled parent keeps us off the tree above it */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	/* the cpu may have gone idle while we were throttled */
+	if (rq->curr == rq->idle && rq->cfs.nr_running)
+		resched_task(rq->curr);
+}
+
+static void check_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	if (!cfs_rq->runtime_enabled || cfs_rq->runtime_remaining > 0)
+		return;
+
+	if (cfs_rq_throttled(cfs_rq))
+		return;
+
+	throttle_cfs_rq(cfs_rq);
+}
+
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b)
+{
+	struct task_group *tg =
+		container_of(cfs_b, struct task_group, cfs_bandwidth);
+	int i, idle, throttled = 0;
+
+	raw_spin_lock(&cfs_b->lock);
+	idle = cfs_b->idle;
+	cfs_b->runtime = cfs_b->quota;
+	cfs_b->idle = 1;
+	raw_spin_unlock(&cfs_b->lock);
+
+	for_each_possible_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = rq_of(cfs_rq);
+
+		if (!cfs_rq_throttled(cfs_rq))
+			continue;
+
+		raw_spin_lock(&rq->lock);
+		if (cfs_rq_throttled(cfs_rq)) {
+			cfs_rq->runtime_remaining = 0;
+			assign_cfs_rq_runtime(cfs_rq);
+			if (cfs_rq->runtime_remaining > 0)
+				unthrottle_cfs_rq(cfs_rq);
+			else
+				throttled = 1;
+		}
+		raw_spin_unlock(&rq->lock);
+	}
+
+	/*
+	 * Stop the timer only after a period in which nobody asked for
+	 * runtime; the next request restarts it.
+	 */
+	raw_spin_lock(&cfs_b->lock);
+	idle = idle && !throttled && cfs_b->idle;
+	if (idle)
+		cfs_b->timer_active = 0;
+	raw_spin_unlock(&cfs_b->lock);
+
+	return idle;
+}
+
+static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
+{
+	struct cfs_bandwidth *cfs_b =
+		container_of(timer, struct cfs_bandwidth, period_timer);
+	ktime_t now;
+	int overrun;
+	int idle = 0;
+
+	for (;;) {
+		now = hrtimer_cb_get_time(timer);
+		overrun = hrtimer_forward(timer, now, cfs_b->period);
+
+		if (!overrun)
+			break;
+
+		idle = do_sched_cfs_period_timer(cfs_b);
+	}
+
+	return idle ? HRTIMER_NORESTART : HRTIMER_RESTART;
+}
+
+static void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	raw_spin_lock_init(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(default_cfs_period());
+	cfs_b->quota = RUNTIME_INF;
+	cfs_b->runtime = 0;
+
+	hrtimer_init(&cfs_b->period_timer,
+			CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cfs_b->period_timer.function = sched_cfs_period_timer;
+}
+
+static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	hrtimer_cancel(&cfs_b->period_timer);
+}
+#else /* !CONFIG_CFS_BANDWIDTH */
+static inline void check_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 /*
  * The enqueue_task method is called before nr_running is
  * increased. Here we update the fair scheduling stats and
@@ -1056,6 +1314,9 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 			break;
 		cfs_rq = cfs_rq_of(se);
 		enqueue_entity(cfs_rq, se, flags);
+		/* a throttled group stays off its parent until unthrottled */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
 		flags = ENQUEUE_WAKEUP;
 	}
 
@@ -1076,7 +1337,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
 		/* Don't dequeue parent if it has other entities besides us */
-		if (cfs_rq->load.weight)
+		if (cfs_rq->load.weight || cfs_rq_throttled(cfs_rq))
 			break;
 		flags |= DEQUEUE_SLEEP;
 	}
@@ -1436,6 +1697,43 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	return target;
 }
 
+static inline int pack_load_ok(unsigned long load)
+{
+	return load * 100 < sysctl_sched_pack_load_pct * SCHED_LOAD_SCALE;
+}
+
+/*
+ * Find a busy cpu in @sd with room for the short running task @p, so
+ * that waking it does not take another cpu out of idle.  Returns -1 to
+ * fall back to the normal wake affine logic.
+ */
+static int select_packed_cpu(struct sched_domain *sd, struct task_struct *p,
+			     int this_cpu)
+{
+	u64 burst = p->se.sum_exec_runtime - p->se.prev_sum_exec_runtime;
+	unsigned long load, min_load = ULONG_MAX;
+	int i, target = -1;
+
+	if (!sysctl_sched_pack_load_pct || burst >= sysctl_sched_pack_burst)
+		return -1;
+
+	for_each_cpu_and(i, sched_domain_span(sd), &p->cpus_allowed) {
+		if (idle_cpu(i))
+			continue;
+
+		load = source_load(i, sd->busy_idx);
+		if (!pack_load_ok(load))
+			continue;
+
+		if (load < min_load || (load == min_load && i == this_cpu)) {
+			min_load = load;
+			target = i;
+		}
+	}
+
+	return target;
+}
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -1530,6 +1828,12 @@ select_task_rq_fair(struct rq *rq, struct task_struct *p, int sd_flag, int wake_
 #endif
 
 	if (affine_sd) {
+		if (affine_sd->flags & SD_PACK_WAKEUPS) {
+			new_cpu = select_packed_cpu(affine_sd, p, cpu);
+			if (new_cpu >= 0)
+				return new_cpu;
+		}
+
 		if (cpu == prev_cpu || wake_affine(affine_sd, p, sync))
 			return select_idle_sibling(p, cpu);
 		else
@@ -1635,19 +1939,59 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 static void set_last_buddy(struct sched_entity *se)
 {
 	if (likely(task_of(se)->policy != SCHED_IDLE)) {
-		for_each_sched_entity(se)
+		for_each_sched_entity(se) {
+			/* stop below a throttled group */
+			if (!se->on_rq)
+				break;
 			cfs_rq_of(se)->last = se;
+		}
 	}
 }
 
 static void set_next_buddy(struct sched_entity *se)
 {
 	if (likely(task_of(se)->policy != SCHED_IDLE)) {
-		for_each_sched_entity(se)
+		for_each_sched_entity(se) {
+			if (!se->on_rq)
+				break;
 			cfs_rq_of(se)->next = se;
+		}
 	}
 }
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+static inline unsigned long entity_shares(struct sched_entity *se)
+{
+	return group_cfs_rq(se) ? group_cfs_rq(se)->tg->shares : se->load.weight;
+}
+
+/*
+ * Should a wakeup of @pse be kept from preempting @se?  Only when they
+ * sit in different groups, the waking side has fewer shares and @se has
+ * not yet run for sysctl_sched_group_preempt_window.
+ */
+static int
+wakeup_preempt_group_deferred(struct sched_entity *se, struct sched_entity *pse)
+{
+	u64 ran;
+
+	if (!group_cfs_rq(se) && !group_cfs_rq(pse))
+		return 0;
+
+	if (entity_shares(pse) >= entity_shares(se))
+		return 0;
+
+	ran = se->sum_exec_runtime - se->prev_sum_exec_runtime;
+	return ran < sysctl_sched_group_preempt_window;
+}
+#else
+static inline int
+wakeup_preempt_group_deferred(struct sched_entity *se, struct sched_entity *pse)
+{
+	return 0;
+}
+#endif
+
 /*
  * Preempt the current task with a newly woken task if needed:
  */
@@ -1694,6 +2038,8 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	update_curr(cfs_rq);
 	find_matching_se(&se, &pse);
 	BUG_ON(!pse);
+	if (wakeup_preempt_group_deferred(se, pse))
+		return;
 	if (wakeup_preempt_entity(se, pse) == 1)
 		goto preempt;
 
@@ -1749,6 +2095,7 @@ static void put_prev_task_fair(struct rq *rq, struct task_struct *prev)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		put_prev_entity(cfs_rq, se);
+		check_cfs_rq_runtime(cfs_rq);
 	}
 }
 
@@ -2575,6 +2922,11 @@ int __weak arch_sd_sibling_asym_packing(void)
        return 0*SD_ASYM_PACKING;
 }
 
+int __weak arch_sd_pack_wakeups(void)
+{
+	return 0*SD_PACK_WAKEUPS;
+}
+
 /**
  * check_asym_packing - Check to see if the group is packed into the
  *			sched doman.
@@ -2823,6 +3175,14 @@ find_busiest_group(struct sched_domain *sd, int this_cpu,
 	if (sds.this_load >= sds.max_load)
 		goto out_balanced;
 
+	/*
+	 * Leave packed wakeups where they are: an idle cpu only takes load
+	 * off a cpu that is busy beyond the packing limit.
+	 */
+	if ((sd->flags & SD_PACK_WAKEUPS) && idle != CPU_NOT_IDLE &&
+	    !sds.this_nr_running && pack_load_ok(sds.max_load))
+		goto out_balanced;
+
 	sds.avg_load = (SCHED_LOAD_SCALE * sds.total_load) / sds.total_pwr;
 
 	if (sds.this_load >= sds.avg_load)
@@ -21,6 +21,7 @@
 #include <linux/sched.h>
 #include <linux/tick.h>
 #include <linux/module.h>
+#include <linux/mm.h>
 
 #include <asm/irq_regs.h>
 
@@ -405,6 +406,9 @@ void tick_nohz_stop_sched_tick(int inidle)
 		 * the scheduler tick in nohz_restart_sched_tick.
 		 */
 		if (!ts->tick_stopped) {
+			/* leave vmstat nothing to wake this cpu for */
+			if (inidle)
+				quiet_vmstat();
 			select_nohz_load_balancer(1);
 
 			ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
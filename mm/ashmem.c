@@ -28,6 +28,12 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/shmem_fs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/radix-tree.h>
+#include <linux/lzo.h>
 #include <linux/ashmem.h>
 
 #define ASHMEM_NAME_PREFIX "dev/ashmem/"
@@ -37,7 +43,7 @@
 /*
  * ashmem_area - anonymous shared memory area
  * Lifecycle: From our parent file's open() until its release()
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its own `mutex'; `area_list' by `ashmem_area_mutex'
  * Big Note: Mappings do NOT pin this structure; it dies on close()
  */
 struct ashmem_area {
@@ -46,12 +52,20 @@ struct ashmem_area {
 	struct file *file;		/* the shmem-based backing file */
 	size_t size;			/* size of the mapping, in bytes */
 	unsigned long prot_mask;	/* allowed prot bits, as vm_flags */
+	struct mutex mutex;		/* protects all of the above */
+	struct list_head area_list;	/* entry in ashmem_area_list */
+	pid_t pid;			/* tgid of the opener */
+	unsigned long purged_pages;	/* pages purged by the shrinker */
+	unsigned long purge_count;	/* ranges purged by the shrinker */
+#ifdef CONFIG_ASHMEM_COMPRESS
+	struct radix_tree_root cpages;	/* compressed unpinned pages */
+#endif
 };
 
 /*
  * ashmem_range - represents an interval of unpinned (evictable) pages
  * Lifecycle: From unpin to pin
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its area's `mutex'; `lru' also by `ashmem_mutex'
  */
 struct ashmem_range {
 	struct list_head lru;		/* entry in LRU list */
@@ -59,9 +73,12 @@ struct ashmem_range {
 	struct ashmem_area *asma;	/* associated area */
 	size_t pgstart;			/* starting page, inclusive */
 	size_t pgend;			/* ending page, inclusive */
-	unsigned int purged;		/* ASHMEM_NOT or ASHMEM_WAS_PURGED */
+	unsigned int purged;		/* ASHMEM_NOT, _WAS_PURGED or _COMPRESSED */
 };
 
+/* Internal range state: off the LRU, its resident pages compressed */
+#define ASHMEM_WAS_COMPRESSED	2
+
 /* LRU list of unpinned pages, protected by ashmem_mutex */
 static LIST_HEAD(ashmem_lru_list);
 
@@ -69,12 +86,27 @@ static LIST_HEAD(ashmem_lru_list);
 static unsigned long lru_count;
 
 /*
- * ashmem_mutex - protects the list of and each individual ashmem_area
+ * ashmem_mutex - protects the LRU list of unpinned ranges and lru_count
+ *
+ * Lock Ordering: asma->mutex -> ashmem_mutex
+ *                asma->mutex -> i_mutex -> i_alloc_sem
  *
- * Lock Ordering: ashmex_mutex -> i_mutex -> i_alloc_sem
+ * The shrinker walks the LRU under ashmem_mutex and so may only trylock an
+ * area; it drops ashmem_mutex before truncating.
  */
 static DEFINE_MUTEX(ashmem_mutex);
 
+/*
+ * ashmem_area_mutex - protects ashmem_area_list, used for the purge statistics
+ *
+ * Lock Ordering: ashmem_area_mutex -> asma->mutex
+ */
+static DEFINE_MUTEX(ashmem_area_mutex);
+static LIST_HEAD(ashmem_area_list);
+
+/* Pages purged from areas since boot, protected by ashmem_mutex */
+static unsigned long ashmem_purged_pages;
+
 static struct kmem_cache *ashmem_area_cachep __read_mostly;
 static struct kmem_cache *ashmem_range_cachep __read_mostly;
 
@@ -104,14 +136,18 @@ static struct kmem_cache *ashmem_range_cachep __read_mostly;
 
 static inline void lru_add(struct ashmem_range *range)
 {
+	mutex_lock(&ashmem_mutex);
 	list_add_tail(&range->lru, &ashmem_lru_list);
 	lru_count += range_size(range);
+	mutex_unlock(&ashmem_mutex);
 }
 
 static inline void lru_del(struct ashmem_range *range)
 {
+	mutex_lock(&ashmem_mutex);
 	list_del(&range->lru);
 	lru_count -= range_size(range);
+	mutex_unlock(&ashmem_mutex);
 }
 
 /*
@@ -123,7 +159,7 @@ static inline void lru_del(struct ashmem_range *range)
  * 'start' - starting page, inclusive
  * 'end' - ending page, inclusive
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int range_alloc(struct ashmem_area *asma,
 		       struct ashmem_range *prev_range, unsigned int purged,
@@ -159,7 +195,7 @@ static void range_del(struct ashmem_range *range)
 /*
  * range_shrink - shrinks a range
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold range->asma->mutex.
  */
 static inline void range_shrink(struct ashmem_range *range,
 				size_t start, size_t end)
@@ -169,8 +205,325 @@ static inline void range_shrink(struct ashmem_range *range,
 	range->pgstart = start;
 	range->pgend = end;
 
-	if (range_on_lru(range))
+	if (range_on_lru(range)) {
+		mutex_lock(&ashmem_mutex);
 		lru_count -= pre - range_size(range);
+		mutex_unlock(&ashmem_mutex);
+	}
+}
+
+#ifdef CONFIG_ASHMEM_COMPRESS
+/*
+ * Compress-on-unpin: instead of truncating an unpinned range, the shrinker
+ * compresses its resident pages into the area's cpages tree and truncates
+ * only those, so a later pin can decompress them and report the range as
+ * not purged.  Pages that are not resident (holes, or swapped out) are left
+ * alone.  If any page of the range cannot be kept the whole range is purged
+ * as before.  Compressed pages stay off the LRU until pinned or released,
+ * bounded by compress_limit_kb.
+ */
+struct ashmem_cpage {
+	pgoff_t index;
+	size_t len;
+	unsigned char data[0];
+};
+
+/* Pages that do not compress to this size are not worth keeping */
+#define ASHMEM_MAX_CSIZE	(PAGE_SIZE / 4 * 3)
+
+static int ashmem_compress = 1;
+module_param_named(compress, ashmem_compress, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(compress, "Compress unpinned pages instead of purging them");
+
+static unsigned long ashmem_compress_limit_kb;
+module_param_named(compress_limit_kb, ashmem_compress_limit_kb, ulong,
+		   S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(compress_limit_kb,
+		 "Most compressed data to keep (default 1/16 of RAM)");
+
+/* LZO workspace and output buffer, protected by ashmem_compress_mutex */
+static DEFINE_MUTEX(ashmem_compress_mutex);
+static void *ashmem_cwork;
+static unsigned char *ashmem_cbuf;
+
+static atomic_long_t ashmem_compressed_pages = ATOMIC_LONG_INIT(0);
+static atomic_long_t ashmem_compressed_bytes = ATOMIC_LONG_INIT(0);
+static atomic_long_t ashmem_zero_pages = ATOMIC_LONG_INIT(0);
+static atomic_long_t ashmem_restored_pages = ATOMIC_LONG_INIT(0);
+
+static inline void cpages_init(struct ashmem_area *asma)
+{
+	/* inserted from the shrinker, which must not wait */
+	INIT_RADIX_TREE(&asma->cpages, GFP_NOWAIT | __GFP_NOWARN);
+}
+
+static void cpage_free(struct ashmem_cpage *cpage)
+{
+	atomic_long_dec(&ashmem_compressed_pages);
+	atomic_long_sub(cpage->len, &ashmem_compressed_bytes);
+	kfree(cpage);
+}
+
+static int page_zero_filled(void *ptr)
+{
+	unsigned long *page = ptr;
+	unsigned int pos;
+
+	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos])
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * cpage_store - compress the resident, locked page at 'index'.  Returns
+ * zero if its contents can be rebuilt once it is truncated.
+ *
+ * Caller must hold asma->mutex.
+ */
+static int cpage_store(struct ashmem_area *asma, pgoff_t index,
+		       struct page *page)
+{
+	struct ashmem_cpage *cpage, *old;
+	size_t clen = 0;
+	void *src;
+	int ret;
+
+	/* a cpage left from before a fault in the unpinned range is stale */
+	old = radix_tree_delete(&asma->cpages, index);
+	if (old)
+		cpage_free(old);
+
+	src = kmap(page);
+	if (page_zero_filled(src)) {
+		/* a hole reads back as zeroes, nothing to keep */
+		kunmap(page);
+		atomic_long_inc(&ashmem_zero_pages);
+		return 0;
+	}
+
+	cpage = NULL;
+	mutex_lock(&ashmem_compress_mutex);
+	ret = lzo1x_1_compress(src, PAGE_SIZE, ashmem_cbuf, &clen,
+			       ashmem_cwork);
+	if (ret == LZO_E_OK && clen <= ASHMEM_MAX_CSIZE &&
+	    (atomic_long_read(&ashmem_compressed_bytes) + clen) >> 10 <
+	    ashmem_compress_limit_kb)
+		cpage = kmalloc(sizeof(*cpage) + clen,
+				GFP_NOWAIT | __GFP_NOWARN);
+	if (cpage)
+		memcpy(cpage->data, ashmem_cbuf, clen);
+	mutex_unlock(&ashmem_compress_mutex);
+	kunmap(page);
+
+	if (!cpage)
+		return -ENOMEM;
+
+	cpage->index = index;
+	cpage->len = clen;
+	ret = radix_tree_preload(GFP_NOWAIT | __GFP_NOWARN);
+	if (!ret) {
+		ret = radix_tree_insert(&asma->cpages, index, cpage);
+		radix_tree_preload_end();
+	}
+	if (ret) {
+		kfree(cpage);
+		return ret;
+	}
+	atomic_long_inc(&ashmem_compressed_pages);
+	atomic_long_add(clen, &ashmem_compressed_bytes);
+
+	return 0;
+}
+
+/*
+ * cpages_take - restore (or, with 'restore' false, just free) the compressed
+ * pages from 'start' to 'end' inclusive.  Returns zero if all were restored.
+ *
+ * Caller must hold asma->mutex.
+ */
+static int cpages_take(struct ashmem_area *asma, size_t start, size_t end,
+		       bool restore)
+{
+	struct address_space *mapping = asma->file->f_mapping;
+	struct ashmem_cpage *batch[16];
+	int ret = 0;
+	int i, nr;
+
+	do {
+		nr = radix_tree_gang_lookup(&asma->cpages, (void **)batch,
+					    start, ARRAY_SIZE(batch));
+		for (i = 0; i < nr; i++) {
+			struct ashmem_cpage *cpage = batch[i];
+			struct page *page;
+			size_t dlen = PAGE_SIZE;
+
+			if (cpage->index > end) {
+				nr = 0;
+				break;
+			}
+			start = cpage->index + 1;
+			radix_tree_delete(&asma->cpages, cpage->index);
+
+			if (!restore || ret) {
+				cpage_free(cpage);
+				continue;
+			}
+
+			page = read_mapping_page(mapping, cpage->index, NULL);
+			if (IS_ERR(page)) {
+				ret = PTR_ERR(page);
+				cpage_free(cpage);
+				continue;
+			}
+
+			lock_page(page);
+			if (lzo1x_decompress_safe(cpage->data, cpage->len,
+					kmap(page), &dlen) != LZO_E_OK ||
+			    dlen != PAGE_SIZE)
+				ret = -EIO;
+			kunmap(page);
+			flush_dcache_page(page);
+			set_page_dirty(page);
+			unlock_page(page);
+			page_cache_release(page);
+
+			cpage_free(cpage);
+			if (!ret)
+				atomic_long_inc(&ashmem_restored_pages);
+		}
+	} while (nr == ARRAY_SIZE(batch));
+
+	return ret;
+}
+
+static void truncate_pages(struct inode *inode, size_t start, size_t end)
+{
+	vmtruncate_range(inode, start * PAGE_SIZE, (end + 1) * PAGE_SIZE - 1);
+}
+
+/*
+ * range_compress - compress the resident pages of a range taken off the LRU
+ * and truncate them.  Returns zero if the range still holds all its data.
+ *
+ * Caller must hold range->asma->mutex.
+ */
+static int range_compress(struct ashmem_range *range)
+{
+	struct ashmem_area *asma = range->asma;
+	struct address_space *mapping = asma->file->f_mapping;
+	size_t idx, run = range->pgstart;
+	struct page *page;
+	int ret = 0;
+
+	if (!ashmem_compress || !ashmem_cwork)
+		return -EINVAL;
+
+	for (idx = range->pgstart; idx <= range->pgend && !ret; idx++) {
+		page = find_lock_page(mapping, idx);
+		if (!page) {
+			/* hole or swapped out: keep it, truncate up to it */
+			if (run < idx)
+				truncate_pages(mapping->host, run, idx - 1);
+			run = idx + 1;
+			continue;
+		}
+		ret = cpage_store(asma, idx, page);
+		unlock_page(page);
+		page_cache_release(page);
+	}
+
+	if (ret) {
+		cpages_take(asma, range->pgstart, range->pgend, false);
+		return ret;
+	}
+	if (run <= range->pgend)
+		truncate_pages(mapping->host, run, range->pgend);
+
+	return 0;
+}
+
+static void ashmem_compress_stats(struct seq_file *m)
+{
+	seq_printf(m, "compressed pages: %ld (%ld bytes)\n"
+		   "zero pages: %ld\nrestored pages: %ld\n",
+		   atomic_long_read(&ashmem_compressed_pages),
+		   atomic_long_read(&ashmem_compressed_bytes),
+		   atomic_long_read(&ashmem_zero_pages),
+		   atomic_long_read(&ashmem_restored_pages));
+}
+
+static int __init ashmem_compress_init(void)
+{
+	if (!ashmem_compress_limit_kb)
+		ashmem_compress_limit_kb = (totalram_pages / 16) <<
+					   (PAGE_SHIFT - 10);
+
+	ashmem_cwork = kmalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+	ashmem_cbuf = kmalloc(lzo1x_worst_compress(PAGE_SIZE), GFP_KERNEL);
+	if (!ashmem_cwork || !ashmem_cbuf) {
+		kfree(ashmem_cwork);
+		kfree(ashmem_cbuf);
+		ashmem_cwork = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void ashmem_compress_exit(void)
+{
+	kfree(ashmem_cwork);
+	kfree(ashmem_cbuf);
+}
+#else
+static inline void cpages_init(struct ashmem_area *asma)
+{
+}
+
+static inline int cpages_take(struct ashmem_area *asma, size_t start,
+			      size_t end, bool restore)
+{
+	return 0;
+}
+
+static inline int range_compress(struct ashmem_range *range)
+{
+	return -EINVAL;
+}
+
+static inline void ashmem_compress_stats(struct seq_file *m)
+{
+}
+
+static inline int ashmem_compress_init(void)
+{
+	return 0;
+}
+
+static inline void ashmem_compress_exit(void)
+{
+}
+#endif /* CONFIG_ASHMEM_COMPRESS */
+
+/*
+ * range_pin - pin the part of 'range' from 'pgstart' to 'pgend', returning
+ * whether its data was lost (ASHMEM_WAS_PURGED) or not (ASHMEM_NOT_PURGED).
+ *
+ * Caller must hold range->asma->mutex.
+ */
+static unsigned int range_pin(struct ashmem_range *range,
+			      size_t pgstart, size_t pgend)
+{
+	size_t start = max_t(size_t, range->pgstart, pgstart);
+	size_t end = min_t(size_t, range->pgend, pgend);
+	bool purged = range->purged == ASHMEM_WAS_PURGED;
+
+	if (cpages_take(range->asma, start, end, !purged) || purged)
+		return ASHMEM_WAS_PURGED;
+	return ASHMEM_NOT_PURGED;
 }
 
 static int ashmem_open(struct inode *inode, struct file *file)
@@ -189,8 +542,15 @@ static int ashmem_open(struct inode *inode, struct file *file)
 	INIT_LIST_HEAD(&asma->unpinned_list);
 	memcpy(asma->name, ASHMEM_NAME_PREFIX, ASHMEM_NAME_PREFIX_LEN);
 	asma->prot_mask = PROT_MASK;
+	mutex_init(&asma->mutex);
+	asma->pid = current->tgid;
+	cpages_init(asma);
 	file->private_data = asma;
 
+	mutex_lock(&ashmem_area_mutex);
+	list_add_tail(&asma->area_list, &ashmem_area_list);
+	mutex_unlock(&ashmem_area_mutex);
+
 	return 0;
 }
 
@@ -199,10 +559,20 @@ static int ashmem_release(struct inode *ignored, struct file *file)
 	struct ashmem_area *asma = file->private_data;
 	struct ashmem_range *range, *next;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&ashmem_area_mutex);
+	list_del(&asma->area_list);
+	mutex_unlock(&ashmem_area_mutex);
+
+	/*
+	 * Once the ranges are gone the shrinker can no longer find us, and
+	 * any purge it had in progress held our mutex.
+	 */
+	mutex_lock(&asma->mutex);
 	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned)
 		range_del(range);
-	mutex_unlock(&ashmem_mutex);
+	if (asma->file)
+		cpages_take(asma, 0, ULONG_MAX, false);
+	mutex_unlock(&asma->mutex);
 
 	if (asma->file)
 		fput(asma->file);
@@ -217,7 +587,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* If size is not set, or set to 0, always return EOF. */
 	if (asma->size == 0) {
@@ -238,7 +608,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	asma->file->f_pos = *pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -247,7 +617,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	struct ashmem_area *asma = file->private_data;
 	int ret;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	if (asma->size == 0) {
 		ret = -EINVAL;
@@ -268,7 +638,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	file->f_pos = asma->file->f_pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -285,7 +655,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* user needs to SET_SIZE before mapping */
 	if (unlikely(!asma->size)) {
@@ -328,7 +698,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	vma->vm_flags |= VM_CAN_NONLINEAR;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -345,11 +715,17 @@ out:
  *
  * We approximate LRU via least-recently-unpinned, jettisoning unpinned partial
  * chunks of ashmem regions LRU-wise one-at-a-time until we hit 'nr_to_scan'
- * pages freed.
+ * pages freed.  With CONFIG_ASHMEM_COMPRESS a chunk is compressed rather
+ * than jettisoned where its pages allow.
+ *
+ * Areas that are busy (their mutex is held, e.g. by a pin or unpin) are
+ * skipped rather than waited for. A range is taken off the LRU before
+ * ashmem_mutex is dropped for the truncation, and its area's mutex keeps it
+ * alive until we are done.
  */
 static int ashmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 {
-	struct ashmem_range *range, *next;
+	struct ashmem_range *range;
 
 	/* We might recurse into filesystem code, so bail out if necessary */
 	if (nr_to_scan && !(gfp_mask & __GFP_FS))
@@ -358,18 +734,44 @@ static int ashmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 		return lru_count;
 
 	mutex_lock(&ashmem_mutex);
-	list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
-		struct inode *inode = range->asma->file->f_dentry->d_inode;
-		loff_t start = range->pgstart * PAGE_SIZE;
-		loff_t end = (range->pgend + 1) * PAGE_SIZE - 1;
-
-		vmtruncate_range(inode, start, end);
-		range->purged = ASHMEM_WAS_PURGED;
-		lru_del(range);
+restart:
+	list_for_each_entry(range, &ashmem_lru_list, lru) {
+		struct ashmem_area *asma = range->asma;
+		struct inode *inode;
+		loff_t start, end;
+		size_t pages;
+		bool purged;
+
+		if (!mutex_trylock(&asma->mutex))
+			continue;
+
+		pages = range_size(range);
+		list_del(&range->lru);
+		lru_count -= pages;
+		mutex_unlock(&ashmem_mutex);
+
+		purged = range_compress(range) != 0;
+		if (purged) {
+			range->purged = ASHMEM_WAS_PURGED;
+			inode = asma->file->f_dentry->d_inode;
+			start = range->pgstart * PAGE_SIZE;
+			end = (range->pgend + 1) * PAGE_SIZE - 1;
+			vmtruncate_range(inode, start, end);
+
+			asma->purged_pages += pages;
+			asma->purge_count++;
+		} else {
+			range->purged = ASHMEM_WAS_COMPRESSED;
+		}
+		nr_to_scan -= pages;
+		mutex_unlock(&asma->mutex);
 
-		nr_to_scan -= range_size(range);
+		mutex_lock(&ashmem_mutex);
+		if (purged)
+			ashmem_purged_pages += pages;
 		if (nr_to_scan <= 0)
 			break;
+		goto restart;
 	}
 	mutex_unlock(&ashmem_mutex);
 
@@ -385,7 +787,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* the user can only remove, not add, protection bits */
 	if (unlikely((asma->prot_mask & prot) != prot)) {
@@ -400,7 +802,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 	asma->prot_mask = prot;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -408,7 +810,7 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* cannot change an existing mapping's name */
 	if (unlikely(asma->file)) {
@@ -422,7 +824,7 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 	asma->name[ASHMEM_FULL_NAME_LEN-1] = '\0';
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -431,7 +833,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0') {
 		size_t len;
 
@@ -448,7 +850,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 					  sizeof(ASHMEM_NAME_DEF))))
 			ret = -EFAULT;
 	}
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -457,7 +859,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
  * ashmem_pin - pin the given ashmem region, returning whether it was
  * previously purged (ASHMEM_WAS_PURGED) or not (ASHMEM_NOT_PURGED).
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
@@ -485,7 +887,7 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 		 *    create a new range for the other side.
 		 */
 		if (page_range_in_range(range, pgstart, pgend)) {
-			ret |= range->purged;
+			ret |= range_pin(range, pgstart, pgend);
 
 			/* Case #1: Easy. Just nuke the whole thing. */
 			if (page_range_subsumes_range(range, pgstart, pgend)) {
@@ -523,7 +925,7 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 /*
  * ashmem_unpin - unpin the given range of pages. Returns zero on success.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_unpin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
@@ -545,12 +947,18 @@ restart:
 		if (page_range_in_range(range, pgstart, pgend)) {
 			pgstart = min_t(size_t, range->pgstart, pgstart),
 			pgend = max_t(size_t, range->pgend, pgend);
-			purged |= range->purged;
+			/* compressed pages merge back onto the LRU */
+			if (range->purged == ASHMEM_WAS_PURGED)
+				purged = ASHMEM_WAS_PURGED;
 			range_del(range);
 			goto restart;
 		}
 	}
 
+	/* the whole range will read as purged, its data is of no use */
+	if (purged == ASHMEM_WAS_PURGED)
+		cpages_take(asma, pgstart, pgend, false);
+
 	return range_alloc(asma, range, purged, pgstart, pgend);
 }
 
@@ -558,7 +966,7 @@ restart:
  * ashmem_get_pin_status - Returns ASHMEM_IS_UNPINNED if _any_ pages in the
  * given interval are unpinned and ASHMEM_IS_PINNED otherwise.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_get_pin_status(struct ashmem_area *asma, size_t pgstart,
 				 size_t pgend)
@@ -607,7 +1015,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 	pgstart = pin.offset / PAGE_SIZE;
 	pgend = pgstart + (pin.len / PAGE_SIZE) - 1;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	switch (cmd) {
 	case ASHMEM_PIN:
@@ -621,7 +1029,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 		break;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -640,10 +1048,12 @@ static long ashmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		break;
 	case ASHMEM_SET_SIZE:
 		ret = -EINVAL;
+		mutex_lock(&asma->mutex);
 		if (!asma->file) {
 			ret = 0;
 			asma->size = (size_t) arg;
 		}
+		mutex_unlock(&asma->mutex);
 		break;
 	case ASHMEM_GET_SIZE:
 		ret = asma->size;
@@ -688,6 +1098,54 @@ static struct miscdevice ashmem_misc = {
 	.fops = &ashmem_fops,
 };
 
+/*
+ * ashmem_stats_show - per-area purge statistics, in debugfs as "ashmem"
+ *
+ * Areas are listed by opener and name, with their size and how many pages
+ * and ranges the shrinker has taken from them. An area busy in the shrinker
+ * just waits for its mutex.
+ */
+static int ashmem_stats_show(struct seq_file *m, void *unused)
+{
+	struct ashmem_area *asma;
+
+	mutex_lock(&ashmem_mutex);
+	seq_printf(m, "lru pages: %lu\npurged pages: %lu\n",
+		   lru_count, ashmem_purged_pages);
+	mutex_unlock(&ashmem_mutex);
+	ashmem_compress_stats(m);
+
+	seq_puts(m, "pid\tsize\tpurged pages\tpurges\tname\n");
+	mutex_lock(&ashmem_area_mutex);
+	list_for_each_entry(asma, &ashmem_area_list, area_list) {
+		mutex_lock(&asma->mutex);
+		seq_printf(m, "%d\t%zu\t%lu\t%lu\t%s\n", asma->pid,
+			   asma->size, asma->purged_pages, asma->purge_count,
+			   asma->name[ASHMEM_NAME_PREFIX_LEN] ?
+			   asma->name + ASHMEM_NAME_PREFIX_LEN :
+			   ASHMEM_NAME_DEF);
+		mutex_unlock(&asma->mutex);
+	}
+	mutex_unlock(&ashmem_area_mutex);
+
+	return 0;
+}
+
+static int ashmem_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ashmem_stats_show, inode->i_private);
+}
+
+static const struct file_operations ashmem_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = ashmem_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *ashmem_debugfs_entry;
+
 static int __init ashmem_init(void)
 {
 	int ret;
@@ -714,8 +1172,14 @@ static int __init ashmem_init(void)
 		return ret;
 	}
 
+	if (ashmem_compress_init())
+		printk(KERN_WARNING "ashmem: compression disabled, no memory\n");
+
 	register_shrinker(&ashmem_shrinker);
 
+	ashmem_debugfs_entry = debugfs_create_file("ashmem", S_IRUGO, NULL,
+						   NULL, &ashmem_stats_fops);
+
 	printk(KERN_INFO "ashmem: initialized\n");
 
 	return 0;
@@ -725,7 +1189,10 @@ static void __exit ashmem_exit(void)
 {
 	int ret;
 
+	debugfs_remove(ashmem_debugfs_entry);
+
 	unregister_shrinker(&ashmem_shrinker);
+	ashmem_compress_exit();
 
 	ret = misc_deregister(&ashmem_misc);
 	if (unlikely(ret))
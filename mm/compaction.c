@@ -14,6 +14,7 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/workqueue.h>
 #include "internal.h"
 
 /*
@@ -512,6 +513,92 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	return rc;
 }
 
+/*
+ * Background compaction.  Allocations up to PAGE_ALLOC_COSTLY_ORDER never
+ * compact directly, and the graphics and camera buffers come in those
+ * sizes.  When one of them has to take the slow path, a worker compacts
+ * each zone that is short of free blocks of sysctl_compact_bg_order, so
+ * that the next ones find memory in the fast path again.
+ */
+int sysctl_compact_bg_order = PAGE_ALLOC_COSTLY_ORDER + 1;
+
+static struct workqueue_struct *compact_bg_wq;
+
+static void compact_bg_zone(struct zone *zone, int order)
+{
+	unsigned long watermark = low_wmark_pages(zone);
+	struct compact_control cc = {
+		.nr_freepages = 0,
+		.nr_migratepages = 0,
+		.order = order,
+		.migratetype = MIGRATE_MOVABLE,
+		.zone = zone,
+	};
+
+	if (zone_watermark_ok(zone, order, watermark, 0, 0))
+		return;
+
+	/* as in try_to_compact_pages(), see there */
+	if (!zone_watermark_ok(zone, 0, watermark + (2UL << order), 0, 0))
+		return;
+
+	if (fragmentation_index(zone, order) <= sysctl_extfrag_threshold)
+		return;
+
+	if (compaction_deferred(zone))
+		return;
+
+	INIT_LIST_HEAD(&cc.freepages);
+	INIT_LIST_HEAD(&cc.migratepages);
+	count_vm_event(COMPACTBACKGROUND);
+	compact_zone(zone, &cc);
+
+	if (zone_watermark_ok(zone, order, watermark, 0, 0)) {
+		zone->compact_considered = 0;
+		zone->compact_defer_shift = 0;
+	} else {
+		defer_compaction(zone);
+	}
+}
+
+static void compact_bg_work_fn(struct work_struct *work)
+{
+	int order = sysctl_compact_bg_order;
+	struct zone *zone;
+
+	if (!order)
+		return;
+
+	lru_add_drain_all();
+	for_each_populated_zone(zone)
+		compact_bg_zone(zone, order);
+}
+
+static DECLARE_WORK(compact_bg_work, compact_bg_work_fn);
+
+/**
+ * wakeup_compaction - compact in the background for a slow allocation
+ * @order: The order of the allocation that missed the fast path
+ *
+ * Safe to call from atomic context.
+ */
+void wakeup_compaction(int order)
+{
+	if (!order || order > sysctl_compact_bg_order || !compact_bg_wq)
+		return;
+
+	queue_work(compact_bg_wq, &compact_bg_work);
+}
+
+static int __init compaction_init(void)
+{
+	compact_bg_wq = create_singlethread_workqueue("kcompactd");
+	if (!compact_bg_wq)
+		return -ENOMEM;
+
+	return 0;
+}
+module_init(compaction_init);
 
 /* Compact all zones within a node */
 static int compact_node(int nid)
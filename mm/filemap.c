@@ -1526,6 +1526,8 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (offset >= size)
 		return VM_FAULT_SIGBUS;
 
+	ra_profile_fault(file, offset);
+
 	/*
 	 * Do we have something in the page cache already?
 	 */
@@ -34,6 +34,8 @@
 #include <linux/swap.h>
 #include <linux/ksm.h>
 #include <linux/hash.h>
+#include <linux/kernel_stat.h>
+#include <linux/power_supply.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -83,21 +85,44 @@
  * @link: link to the mm_slots hash list
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
+ * @regions: merge history of this mm's VM_MERGEABLE areas
  * @mm: the mm that this information is valid for
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
+	struct list_head regions;
 	struct mm_struct *mm;
 };
 
+/**
+ * struct ksm_region - merge history of one VM_MERGEABLE area
+ * @list: link into the mm_slot's regions list
+ * @start: vm_start of the area
+ * @seqnr: ksm_scan.seqnr of the last full scan that reached the area
+ * @merged: pages merged during the current visit
+ * @total_merged: pages merged since the area was first scanned
+ * @idle_visits: consecutive visits that merged nothing
+ * @skip: visits still to be skipped before scanning the area again
+ */
+struct ksm_region {
+	struct list_head list;
+	unsigned long start;
+	unsigned long seqnr;
+	unsigned long merged;
+	unsigned long total_merged;
+	unsigned int idle_visits;
+	unsigned int skip;
+};
+
 /**
  * struct ksm_scan - cursor for scanning
  * @mm_slot: the current mm_slot we are scanning
  * @address: the next address inside that to be scanned
  * @rmap_list: link to the next rmap to be scanned in the rmap_list
  * @seqnr: count of completed full scans (needed when removing unstable node)
+ * @region: merge history of the area being scanned, if any
  *
  * There is only the one ksm_scan instance of this cursor structure.
  */
@@ -106,6 +131,7 @@ struct ksm_scan {
 	unsigned long address;
 	struct rmap_item **rmap_list;
 	unsigned long seqnr;
+	struct ksm_region *region;
 };
 
 /**
@@ -187,6 +213,30 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Scan only while charging or while the CPUs are mostly idle */
+static unsigned int ksm_thread_gated = 1;
+
+/* Percentage of CPU time that must have been idle for ksmd to scan */
+static unsigned int ksm_thread_idle_percent = 90;
+
+/* How often the gate is re-evaluated, and ksmd polls it while closed */
+#define KSM_GATE_MSECS		1000
+
+static bool ksm_gate_open;
+static unsigned long ksm_gate_stamp;
+static cputime64_t ksm_gate_busy;
+static u64 ksm_gate_runtime;
+
+/*
+ * An area that merged nothing on KSM_REGION_GRACE visits in a row is
+ * skipped on 2, 4, ... up to 1 << KSM_REGION_MAX_SHIFT following full
+ * scans.  Areas that merged pages before back off much less, they are
+ * the likeliest to have more.
+ */
+#define KSM_REGION_GRACE		2
+#define KSM_REGION_MAX_SHIFT		6
+#define KSM_REGION_MERGED_MAX_SHIFT	2
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -245,6 +295,7 @@ static inline struct rmap_item *alloc_rmap_item(void)
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
 	ksm_rmap_items--;
+	rmap_item->mm->ksm_rmap_items--;
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -261,13 +312,22 @@ static inline void free_stable_node(struct stable_node *stable_node)
 
 static inline struct mm_slot *alloc_mm_slot(void)
 {
+	struct mm_slot *mm_slot;
+
 	if (!mm_slot_cache)	/* initialization failed */
 		return NULL;
-	return kmem_cache_zalloc(mm_slot_cache, GFP_KERNEL);
+	mm_slot = kmem_cache_zalloc(mm_slot_cache, GFP_KERNEL);
+	if (mm_slot)
+		INIT_LIST_HEAD(&mm_slot->regions);
+	return mm_slot;
 }
 
 static inline void free_mm_slot(struct mm_slot *mm_slot)
 {
+	struct ksm_region *region, *next;
+
+	list_for_each_entry_safe(region, next, &mm_slot->regions, list)
+		kfree(region);
 	kmem_cache_free(mm_slot_cache, mm_slot);
 }
 
@@ -451,6 +511,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merged--;
 		ksm_drop_anon_vma(rmap_item);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
@@ -538,6 +599,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merged--;
 
 		ksm_drop_anon_vma(rmap_item);
 		rmap_item->address &= PAGE_MASK;
@@ -615,6 +677,7 @@ static int unmerge_and_remove_all_rmap_items(void)
 	struct vm_area_struct *vma;
 	int err = 0;
 
+	ksm_scan.region = NULL;
 	spin_lock(&ksm_mmlist_lock);
 	ksm_scan.mm_slot = list_entry(ksm_mm_head.mm_list.next,
 						struct mm_slot, mm_list);
@@ -1120,6 +1183,14 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	rmap_item->mm->ksm_merged++;
+}
+
+/* Credit a merge to the area being scanned */
+static inline void region_merged(void)
+{
+	if (ksm_scan.region)
+		ksm_scan.region->merged++;
 }
 
 /*
@@ -1154,6 +1225,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			lock_page(kpage);
 			stable_tree_append(rmap_item, page_stable_node(kpage));
 			unlock_page(kpage);
+			region_merged();
 		}
 		put_page(kpage);
 		return;
@@ -1190,6 +1262,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			if (stable_node) {
 				stable_tree_append(tree_rmap_item, stable_node);
 				stable_tree_append(rmap_item, stable_node);
+				region_merged();
 			}
 			unlock_page(kpage);
 
@@ -1228,6 +1301,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	if (rmap_item) {
 		/* It has already been zeroed */
 		rmap_item->mm = mm_slot->mm;
+		rmap_item->mm->ksm_rmap_items++;
 		rmap_item->address = addr;
 		rmap_item->rmap_list = *rmap_list;
 		*rmap_list = rmap_item;
@@ -1235,6 +1309,90 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * Called as the scan leaves an area: decide on how many of the next
+ * full scans to skip it, from how well it has merged so far.
+ */
+static void region_leave(void)
+{
+	struct ksm_region *region = ksm_scan.region;
+	unsigned int shift;
+
+	if (!region)
+		return;
+	ksm_scan.region = NULL;
+
+	if (region->merged) {
+		region->total_merged += region->merged;
+		region->merged = 0;
+		region->idle_visits = 0;
+		return;
+	}
+
+	if (++region->idle_visits <= KSM_REGION_GRACE)
+		return;
+	shift = min_t(unsigned int, region->idle_visits - KSM_REGION_GRACE,
+		      region->total_merged ? KSM_REGION_MERGED_MAX_SHIFT :
+					     KSM_REGION_MAX_SHIFT);
+	region->skip = 1 << shift;
+}
+
+/*
+ * Look up, or start, the merge history of the area at vma and make it
+ * the one being scanned.  Returns false if it is to be skipped this time.
+ */
+static bool region_enter(struct mm_slot *mm_slot, struct vm_area_struct *vma)
+{
+	struct ksm_region *region = ksm_scan.region;
+
+	if (region && region->start == vma->vm_start)
+		return true;
+	region_leave();
+
+	list_for_each_entry(region, &mm_slot->regions, list)
+		if (region->start == vma->vm_start)
+			goto found;
+
+	region = kzalloc(sizeof(*region), GFP_KERNEL);
+	if (!region)
+		return true;
+	region->start = vma->vm_start;
+	list_add_tail(&region->list, &mm_slot->regions);
+found:
+	region->seqnr = ksm_scan.seqnr;
+	if (region->skip) {
+		region->skip--;
+		return false;
+	}
+	ksm_scan.region = region;
+	return true;
+}
+
+/* Forget the areas this full scan did not come across: they are gone */
+static void prune_regions(struct mm_slot *mm_slot)
+{
+	struct ksm_region *region, *next;
+
+	list_for_each_entry_safe(region, next, &mm_slot->regions, list) {
+		if (region->seqnr != ksm_scan.seqnr) {
+			list_del(&region->list);
+			kfree(region);
+		}
+	}
+}
+
+/*
+ * Step the cursor over the rmap_items of an area being skipped, they
+ * still track its merged pages.
+ */
+static struct rmap_item **skip_rmap_items(struct rmap_item **rmap_list,
+					  unsigned long end)
+{
+	while (*rmap_list && ((*rmap_list)->address & PAGE_MASK) < end)
+		rmap_list = &(*rmap_list)->rmap_list;
+	return rmap_list;
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1256,6 +1414,7 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 next_mm:
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
+		ksm_scan.region = NULL;
 	}
 
 	mm = slot->mm;
@@ -1272,6 +1431,12 @@ next_mm:
 			ksm_scan.address = vma->vm_start;
 		if (!vma->anon_vma)
 			ksm_scan.address = vma->vm_end;
+		if (ksm_scan.address < vma->vm_end &&
+		    !region_enter(slot, vma)) {
+			ksm_scan.address = vma->vm_end;
+			ksm_scan.rmap_list = skip_rmap_items(ksm_scan.rmap_list,
+							     vma->vm_end);
+		}
 
 		while (ksm_scan.address < vma->vm_end) {
 			if (ksm_test_exit(mm))
@@ -1298,6 +1463,9 @@ next_mm:
 		}
 	}
 
+	region_leave();
+	prune_regions(slot);
+
 	if (ksm_test_exit(mm)) {
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
@@ -1368,19 +1536,89 @@ static int ksmd_should_run(void)
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
+static inline bool ksm_charging(void)
+{
+#ifdef CONFIG_POWER_SUPPLY
+	return power_supply_is_system_supplied() > 0;
+#else
+	return false;	/* a modular class cannot be called from here */
+#endif
+}
+
+static cputime64_t ksm_busy_time(void)
+{
+	cputime64_t busy = cputime64_zero;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct cpu_usage_stat *st = &kstat_cpu(cpu).cpustat;
+
+		busy = cputime64_add(busy, st->user);
+		busy = cputime64_add(busy, st->nice);
+		busy = cputime64_add(busy, st->system);
+		busy = cputime64_add(busy, st->irq);
+		busy = cputime64_add(busy, st->softirq);
+	}
+
+	return busy;
+}
+
+/*
+ * With the gate on, ksmd only scans while the device is charging, or
+ * while the CPUs were idle for idle_percent of the last KSM_GATE_MSECS
+ * leaving aside ksmd's own scanning: merging is then paid for by power
+ * or time nobody else wanted.  Busy time is measured against wall time
+ * since tickless idle CPUs do not account their idle time as they go.
+ */
+static bool ksmd_gate_open(void)
+{
+	unsigned long now = jiffies;
+	unsigned long elapsed = now - ksm_gate_stamp;
+	cputime64_t busy_time;
+	u64 runtime, busy, self;
+
+	if (!ksm_thread_gated)
+		return true;
+	if (elapsed < msecs_to_jiffies(KSM_GATE_MSECS))
+		return ksm_gate_open;
+
+	busy_time = ksm_busy_time();
+	runtime = current->se.sum_exec_runtime;
+	busy = cputime64_to_jiffies64(cputime64_sub(busy_time, ksm_gate_busy));
+	self = nsecs_to_jiffies(runtime - ksm_gate_runtime);
+	busy = busy > self ? busy - self : 0;
+
+	ksm_gate_stamp = now;
+	ksm_gate_busy = busy_time;
+	ksm_gate_runtime = runtime;
+
+	if (ksm_charging())
+		ksm_gate_open = true;
+	else
+		ksm_gate_open = busy * 100 <= (u64)elapsed *
+			num_online_cpus() * (100 - ksm_thread_idle_percent);
+	return ksm_gate_open;
+}
+
 static int ksm_scan_thread(void *nothing)
 {
+	bool gate_open = true;
+
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+		if (ksmd_should_run()) {
+			gate_open = ksmd_gate_open();
+			if (gate_open)
+				ksm_do_scan(ksm_thread_pages_to_scan);
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		if (ksmd_should_run()) {
-			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+			schedule_timeout_interruptible(msecs_to_jiffies(
+				gate_open ? ksm_thread_sleep_millisecs :
+					    KSM_GATE_MSECS));
 		} else {
 			wait_event_interruptible(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1406,6 +1644,11 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 				 VM_NONLINEAR | VM_MIXEDMAP | VM_SAO))
 			return 0;		/* just ignore the advice */
 
+		/* ksmd must not merge into page tables shared with a child */
+		err = unshare_pte_range(vma, start, end);
+		if (err)
+			return err;
+
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
 			err = __ksm_enter(mm);
 			if (err)
@@ -1804,6 +2047,51 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t gated_show(struct kobject *kobj, struct kobj_attribute *attr,
+			  char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_gated);
+}
+
+static ssize_t gated_store(struct kobject *kobj, struct kobj_attribute *attr,
+			   const char *buf, size_t count)
+{
+	int err;
+	unsigned long flags;
+
+	err = strict_strtoul(buf, 10, &flags);
+	if (err || flags > 1)
+		return -EINVAL;
+
+	ksm_thread_gated = flags;
+
+	return count;
+}
+KSM_ATTR(gated);
+
+static ssize_t idle_percent_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_idle_percent);
+}
+
+static ssize_t idle_percent_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	int err;
+	unsigned long percent;
+
+	err = strict_strtoul(buf, 10, &percent);
+	if (err || percent > 100)
+		return -EINVAL;
+
+	ksm_thread_idle_percent = percent;
+
+	return count;
+}
+KSM_ATTR(idle_percent);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1899,6 +2187,8 @@ KSM_ATTR_RO(full_scans);
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&gated_attr.attr,
+	&idle_percent_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
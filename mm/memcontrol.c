@@ -1196,6 +1196,28 @@ u64 mem_cgroup_get_limit(struct mem_cgroup *memcg)
 	return min(limit, memsw);
 }
 
+/*
+ * How many pages the memory cgroup of @p is over its soft limit.  The low
+ * memory killer adds this to the size of every member, so that an app
+ * group over its budget is killed from before the others.
+ */
+unsigned long mem_cgroup_task_excess(struct task_struct *p)
+{
+	struct mem_cgroup *mem;
+	unsigned long excess = 0;
+
+	if (mem_cgroup_disabled())
+		return 0;
+
+	rcu_read_lock();
+	mem = mem_cgroup_from_task(p);
+	if (mem && !mem_cgroup_is_root(mem))
+		excess = mem_cgroup_get_excess(mem);
+	rcu_read_unlock();
+
+	return excess;
+}
+
 /*
  * Visit the first child (need not be the first child as per the ordering
  * of the cgroup list, since we track last_scanned_child) of @mem and use
@@ -1526,6 +1548,26 @@ static bool consume_stock(struct mem_cgroup *mem)
 	return ret;
 }
 
+/*
+ * Give an uncharged page back to the local stock instead of res_counter,
+ * when the stock already caches @mem and has room.  Process exits and
+ * zygote forks free bursts of pages from one cgroup; these then cost no
+ * res_counter operation at all, neither here nor on the next charge.
+ */
+static bool uncharge_to_stock(struct mem_cgroup *mem)
+{
+	struct memcg_stock_pcp *stock;
+	bool ret = false;
+
+	stock = &get_cpu_var(memcg_stock);
+	if (mem == stock->cached && stock->charge < CHARGE_SIZE) {
+		stock->charge += PAGE_SIZE;
+		ret = true;
+	}
+	put_cpu_var(memcg_stock);
+	return ret;
+}
+
 /*
  * Returns stocks cached in percpu to res_counter and reset cached information.
  */
@@ -2308,6 +2350,10 @@ __do_uncharge(struct mem_cgroup *mem, const enum charge_type ctype)
 		batch->memsw_bytes += PAGE_SIZE;
 	return;
 direct_uncharge:
+	/* the stock holds memsw charges too, so only take full uncharges */
+	if ((uncharge_memsw || !do_swap_account) &&
+	    !test_thread_flag(TIF_MEMDIE) && uncharge_to_stock(mem))
+		return;
 	res_counter_uncharge(&mem->res, PAGE_SIZE);
 	if (uncharge_memsw)
 		res_counter_uncharge(&mem->memsw, PAGE_SIZE);
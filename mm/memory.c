@@ -727,6 +727,7 @@ static int copy_pte_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 	pte_t *src_pte, *dst_pte;
 	spinlock_t *src_ptl, *dst_ptl;
 	int progress = 0;
+	int copied = 0;
 	int rss[NR_MM_COUNTERS];
 	swp_entry_t entry = (swp_entry_t){0};
 
@@ -762,6 +763,7 @@ again:
 							vma, addr, rss);
 		if (entry.val)
 			break;
+		copied++;
 		progress += 8;
 	} while (dst_pte++, src_pte++, addr += PAGE_SIZE, addr != end);
 
@@ -770,6 +772,8 @@ again:
 	pte_unmap_nested(orig_src_pte);
 	add_mm_rss_vec(dst_mm, rss);
 	pte_unmap_unlock(orig_dst_pte, dst_ptl);
+	count_vm_events(FORK_PTE_COPIED, copied);
+	copied = 0;
 	cond_resched();
 
 	if (entry.val) {
@@ -782,6 +786,370 @@ again:
 	return 0;
 }
 
+#ifdef CONFIG_FORK_SHARE_PTE
+#if !USE_SPLIT_PTLOCKS
+#error "CONFIG_FORK_SHARE_PTE needs the pte lock in the page table page"
+#endif
+
+/*
+ * Instead of having every pte of a large private mapping copied at
+ * fork, the child is given a reference to the parent's page table page
+ * once all ptes in it are write protected.  The table rather than each
+ * mm then owns the page references, mapcounts and swap counts of what
+ * it maps.  Every mm pointing at it is charged rss for its ptes, by
+ * vma type: looking at each page is what sharing avoids.
+ *
+ * A shared table lies entirely inside one vma.  Before a vma boundary
+ * moves into it, before ptes in it are changed, and on the first fault
+ * in it, the mm doing so switches to a private copy; unmapping all of
+ * it just drops the reference.  Only the last mm frees the table, from
+ * free_pgtables() after unlinking its vma from the anon_vma and file,
+ * so rmap walkers holding those locks need only check that the pmd
+ * they followed still points at the table they locked.
+ */
+static inline int pte_table_shareable(struct vm_area_struct *vma,
+		unsigned long addr, unsigned long end)
+{
+	if (!is_cow_mapping(vma->vm_flags) ||
+	    (vma->vm_flags & (VM_HUGETLB|VM_NONLINEAR|VM_PFNMAP|VM_INSERTPAGE|
+			      VM_MERGEABLE)))
+		return 0;
+
+	return !(addr & ~PMD_MASK) && end - addr == PMD_SIZE;
+}
+
+static inline void shared_pte_rss(struct vm_area_struct *vma, pte_t pte,
+		int *rss, int delta)
+{
+	if (pte_present(pte))
+		rss[vma->vm_file ? MM_FILEPAGES : MM_ANONPAGES] += delta;
+	else if (!non_swap_entry(pte_to_swp_entry(pte)))
+		rss[MM_SWAPENTS] += delta;
+}
+
+static void share_pte_table(struct mm_struct *dst_mm, struct mm_struct *src_mm,
+		pmd_t *dst_pmd, pmd_t *src_pmd, struct vm_area_struct *vma,
+		unsigned long addr, unsigned long end)
+{
+	pgtable_t table = pmd_pgtable(*src_pmd);
+	pte_t *orig_pte, *pte;
+	spinlock_t *ptl;
+	int rss[NR_MM_COUNTERS];
+	int nr = 0;
+
+	init_rss_vec(rss);
+
+	orig_pte = pte = pte_offset_map_lock(src_mm, src_pmd, addr, &ptl);
+	arch_enter_lazy_mmu_mode();
+	do {
+		pte_t ptent = *pte;
+
+		if (pte_none(ptent))
+			continue;
+		nr++;
+		shared_pte_rss(vma, ptent, rss, 1);
+		if (pte_present(ptent)) {
+			if (pte_write(ptent))
+				ptep_set_wrprotect(src_mm, addr, pte);
+		} else {
+			swp_entry_t entry = pte_to_swp_entry(ptent);
+
+			if (is_write_migration_entry(entry)) {
+				make_migration_entry_read(&entry);
+				set_pte_at(src_mm, addr, pte,
+					   swp_entry_to_pte(entry));
+			}
+		}
+	} while (pte++, addr += PAGE_SIZE, addr != end);
+	arch_leave_lazy_mmu_mode();
+
+	/* make sure dst_mm is on swapoff's mmlist. */
+	if (rss[MM_SWAPENTS] && unlikely(list_empty(&dst_mm->mmlist))) {
+		spin_lock(&mmlist_lock);
+		if (list_empty(&dst_mm->mmlist))
+			list_add(&dst_mm->mmlist, &src_mm->mmlist);
+		spin_unlock(&mmlist_lock);
+	}
+
+	get_page(table);
+	spin_lock(&dst_mm->page_table_lock);
+	dst_mm->nr_ptes++;
+	pmd_populate(dst_mm, dst_pmd, table);
+	spin_unlock(&dst_mm->page_table_lock);
+	pte_unmap_unlock(orig_pte, ptl);
+
+	add_mm_rss_vec(dst_mm, rss);
+	count_vm_event(FORK_PTE_TABLES_SHARED);
+	count_vm_events(FORK_PTE_SHARED, nr);
+}
+
+static pmd_t *shared_pte_pmd(struct mm_struct *mm, unsigned long addr)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, addr);
+	if (!pgd_present(*pgd))
+		return NULL;
+	pud = pud_offset(pgd, addr);
+	if (!pud_present(*pud))
+		return NULL;
+	pmd = pmd_offset(pud, addr);
+	if (!pte_table_shared(pmd))
+		return NULL;
+
+	return pmd;
+}
+
+/* Take a reference on each swap entry in the table for a copy of it */
+static swp_entry_t dup_shared_swap(pte_t *ptes)
+{
+	swp_entry_t entry;
+	pte_t *pte;
+
+	for (pte = ptes; pte < ptes + PTRS_PER_PTE; pte++) {
+		if (pte_none(*pte) || pte_present(*pte))
+			continue;
+		entry = pte_to_swp_entry(*pte);
+		if (swap_duplicate(entry) < 0)
+			goto undo;
+	}
+	return (swp_entry_t){0};
+
+undo:
+	while (pte-- > ptes) {
+		if (pte_none(*pte) || pte_present(*pte) ||
+		    non_swap_entry(pte_to_swp_entry(*pte)))
+			continue;
+		swap_free(pte_to_swp_entry(*pte));
+	}
+	return entry;
+}
+
+/**
+ * unshare_pte_table - give the mm a private copy of a shared page table
+ * @vma: vma covering the table
+ * @addr: any address mapped by the table
+ *
+ * Does nothing if the table at @addr is not shared.  Called with
+ * mmap_sem held; may sleep.
+ */
+int unshare_pte_table(struct vm_area_struct *vma, unsigned long addr)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	pte_t *orig_src_pte, *orig_dst_pte, *src_pte, *dst_pte;
+	spinlock_t *src_ptl, *dst_ptl;
+	int rss[NR_MM_COUNTERS];
+	pgtable_t old, new;
+	swp_entry_t entry;
+	unsigned long end;
+	pmd_t *pmd;
+
+	addr &= PMD_MASK;
+	end = addr + PMD_SIZE;
+	pmd = shared_pte_pmd(mm, addr);
+	if (!pmd)
+		return 0;
+
+	new = pte_alloc_one(mm, addr);
+	if (!new)
+		return -ENOMEM;
+
+again:
+	init_rss_vec(rss);
+
+	/*
+	 * The anon_vma lock keeps the other mms from freeing the table
+	 * while another thread of ours copies it and drops our reference.
+	 */
+	anon_vma_lock(vma->anon_vma);
+	if (!pmd_present(*pmd))
+		goto out_unlock;
+	old = pmd_pgtable(*pmd);
+	orig_src_pte = src_pte = pte_offset_map_lock(mm, pmd, addr, &src_ptl);
+	if (page_count(old) == 1) {
+		/* another thread got here first, or the other side let go */
+		pte_unmap_unlock(orig_src_pte, src_ptl);
+		goto out_unlock;
+	}
+
+	entry = dup_shared_swap(src_pte);
+	if (unlikely(entry.val)) {
+		pte_unmap_unlock(orig_src_pte, src_ptl);
+		anon_vma_unlock(vma->anon_vma);
+		if (add_swap_count_continuation(entry, GFP_KERNEL) < 0) {
+			pte_free(mm, new);
+			return -ENOMEM;
+		}
+		goto again;
+	}
+
+	/*
+	 * Faults racing with the copy see the new table empty, and back
+	 * off once they get its lock and find the pte has changed.
+	 */
+	dst_ptl = __pte_lockptr(new);
+	spin_lock_nested(dst_ptl, SINGLE_DEPTH_NESTING);
+	pmd_populate(mm, pmd, new);
+	orig_dst_pte = dst_pte = pte_offset_map_nested(pmd, addr);
+	arch_enter_lazy_mmu_mode();
+	do {
+		pte_t ptent = *src_pte;
+		struct page *page;
+
+		if (pte_none(ptent))
+			continue;
+		shared_pte_rss(vma, ptent, rss, -1);
+		if (pte_present(ptent)) {
+			page = vm_normal_page(vma, addr, ptent);
+			if (page) {
+				get_page(page);
+				page_dup_rmap(page);
+				if (PageAnon(page))
+					rss[MM_ANONPAGES]++;
+				else
+					rss[MM_FILEPAGES]++;
+			}
+		} else if (!non_swap_entry(pte_to_swp_entry(ptent)))
+			rss[MM_SWAPENTS]++;
+		set_pte_at(mm, addr, dst_pte, ptent);
+	} while (dst_pte++, src_pte++, addr += PAGE_SIZE, addr != end);
+	arch_leave_lazy_mmu_mode();
+
+	put_page(old);
+	pte_unmap_nested(orig_dst_pte);
+	spin_unlock(dst_ptl);
+	pte_unmap_unlock(orig_src_pte, src_ptl);
+	anon_vma_unlock(vma->anon_vma);
+
+	add_mm_rss_vec(mm, rss);
+	flush_tlb_range(vma, end - PMD_SIZE, end);
+	count_vm_event(FORK_PTE_TABLES_UNSHARED);
+
+	return 0;
+
+out_unlock:
+	anon_vma_unlock(vma->anon_vma);
+	pte_free(mm, new);
+	return 0;
+}
+
+int unshare_pte_range(struct vm_area_struct *vma,
+		unsigned long start, unsigned long end)
+{
+	unsigned long addr;
+	int err;
+
+	for (addr = start & PMD_MASK; addr < end; addr += PMD_SIZE) {
+		err = unshare_pte_table(vma, addr);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/* A vma boundary is about to be moved to @addr */
+int unshare_pte_boundary(struct mm_struct *mm, unsigned long addr)
+{
+	struct vm_area_struct *vma;
+
+	if (!(addr & ~PMD_MASK))
+		return 0;
+
+	vma = find_vma(mm, addr);
+	if (!vma || vma->vm_start > addr)
+		return 0;
+
+	return unshare_pte_table(vma, addr);
+}
+
+/*
+ * Unmapping all of a table shared with other mms: drop our reference
+ * instead of zapping ptes they still map.
+ */
+static int drop_shared_pte_table(struct vm_area_struct *vma, pmd_t *pmd,
+		unsigned long addr, unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	pte_t *orig_pte, *pte;
+	spinlock_t *ptl;
+	int rss[NR_MM_COUNTERS];
+	int dropped = 0;
+	int i;
+
+	init_rss_vec(rss);
+
+	orig_pte = pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+	if (pte_table_shared(pmd)) {
+		for (i = 0; i < PTRS_PER_PTE; i++, pte++)
+			if (!pte_none(*pte))
+				shared_pte_rss(vma, *pte, rss, -1);
+		put_page(pmd_pgtable(*pmd));
+		pmd_clear(pmd);
+		mm->nr_ptes--;
+		dropped = 1;
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+
+	if (dropped) {
+		add_mm_rss_vec(mm, rss);
+		flush_tlb_range(vma, end - PMD_SIZE, end);
+	}
+
+	return dropped;
+}
+
+static unsigned long zap_pte_range(struct mmu_gather *tlb,
+				struct vm_area_struct *vma, pmd_t *pmd,
+				unsigned long addr, unsigned long end,
+				long *zap_work, struct zap_details *details);
+
+static unsigned long zap_shared_pte_table(struct mmu_gather *tlb,
+				struct vm_area_struct *vma, pmd_t *pmd,
+				unsigned long addr, unsigned long end,
+				long *zap_work, struct zap_details *details)
+{
+	if (!details && !(addr & ~PMD_MASK) && end - addr == PMD_SIZE &&
+	    drop_shared_pte_table(vma, pmd, addr, end)) {
+		(*zap_work)--;
+		return end;
+	}
+
+	/*
+	 * munmap and madvise unshare first; only truncation zaps part of
+	 * a shared table, and it unmaps those pages from every mm anyway.
+	 * The other mms' TLBs need flushing as well though.
+	 */
+	addr = zap_pte_range(tlb, vma, pmd, addr, end, zap_work, details);
+	flush_tlb_all();
+
+	return addr;
+}
+#else
+static inline int pte_table_shareable(struct vm_area_struct *vma,
+		unsigned long addr, unsigned long end)
+{
+	return 0;
+}
+
+static inline void share_pte_table(struct mm_struct *dst_mm,
+		struct mm_struct *src_mm, pmd_t *dst_pmd, pmd_t *src_pmd,
+		struct vm_area_struct *vma, unsigned long addr,
+		unsigned long end)
+{
+}
+
+static inline unsigned long zap_shared_pte_table(struct mmu_gather *tlb,
+				struct vm_area_struct *vma, pmd_t *pmd,
+				unsigned long addr, unsigned long end,
+				long *zap_work, struct zap_details *details)
+{
+	return end;
+}
+#endif /* CONFIG_FORK_SHARE_PTE */
+
 static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pud_t *dst_pud, pud_t *src_pud, struct vm_area_struct *vma,
 		unsigned long addr, unsigned long end)
@@ -797,6 +1165,11 @@ static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src
 		next = pmd_addr_end(addr, end);
 		if (pmd_none_or_clear_bad(src_pmd))
 			continue;
+		if (pte_table_shareable(vma, addr, next)) {
+			share_pte_table(dst_mm, src_mm, dst_pmd, src_pmd,
+					vma, addr, next);
+			continue;
+		}
 		if (copy_pte_range(dst_mm, src_mm, dst_pmd, src_pmd,
 						vma, addr, next))
 			return -ENOMEM;
@@ -1001,6 +1374,11 @@ static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 			(*zap_work)--;
 			continue;
 		}
+		if (unlikely(pte_table_shared(pmd))) {
+			next = zap_shared_pte_table(tlb, vma, pmd, addr, next,
+						zap_work, details);
+			continue;
+		}
 		next = zap_pte_range(tlb, vma, pmd, addr, next,
 						zap_work, details);
 	} while (pmd++, addr = next, (addr != end && *zap_work > 0));
@@ -3083,15 +3461,103 @@ unwritable_page:
 	return ret;
 }
 
+#ifdef CONFIG_FAULT_AROUND
+#define FAULT_AROUND_PAGES	16
+
+/*
+ * After a read fault on a page cache backed mapping, map the pages of
+ * the surrounding FAULT_AROUND_PAGES block that are uptodate and not
+ * locked by anyone else.  Nothing here waits: pages under I/O, or not
+ * cached yet, are left to fault normally.  The ptes are read-only so a
+ * later write still goes through do_wp_page() and ->page_mkwrite().
+ */
+static void do_fault_around(struct mm_struct *mm, struct vm_area_struct *vma,
+		unsigned long address, pmd_t *pmd)
+{
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	unsigned long start, end, addr;
+	pgoff_t pgoff, max_pgoff;
+	pte_t *page_table, *pte;
+	spinlock_t *ptl;
+
+	/* the block is naturally aligned, so it never spans two pmds */
+	start = address & ~((FAULT_AROUND_PAGES << PAGE_SHIFT) - 1);
+	start = max(start, vma->vm_start);
+	end = (address & ~((FAULT_AROUND_PAGES << PAGE_SHIFT) - 1)) +
+		(FAULT_AROUND_PAGES << PAGE_SHIFT);
+	end = min(end, vma->vm_end);
+
+	max_pgoff = (i_size_read(mapping->host) + PAGE_CACHE_SIZE - 1) >>
+		PAGE_CACHE_SHIFT;
+	pgoff = ((start - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+
+	page_table = pte_offset_map_lock(mm, pmd, start, &ptl);
+	for (addr = start, pte = page_table; addr < end && pgoff < max_pgoff;
+	     addr += PAGE_SIZE, pte++, pgoff++) {
+		struct page *page;
+
+		if (!pte_none(*pte))
+			continue;
+
+		page = find_get_page(mapping, pgoff);
+		if (!page)
+			continue;
+		if (!trylock_page(page))
+			goto release;
+		if (page->mapping != mapping || !PageUptodate(page))
+			goto unlock;
+
+		flush_icache_page(vma, page);
+		inc_mm_counter_fast(mm, MM_FILEPAGES);
+		page_add_file_rmap(page);
+		set_pte_at(mm, addr, pte,
+			   pte_wrprotect(mk_pte(page, vma->vm_page_prot)));
+		update_mmu_cache(vma, addr, pte);
+		unlock_page(page);
+		/* the pte keeps the reference */
+		continue;
+unlock:
+		unlock_page(page);
+release:
+		page_cache_release(page);
+	}
+	pte_unmap_unlock(page_table, ptl);
+}
+
+static inline bool want_fault_around(struct vm_area_struct *vma,
+		unsigned int flags, int ret)
+{
+	return !(flags & FAULT_FLAG_WRITE) &&
+		!(ret & (VM_FAULT_ERROR | VM_FAULT_NOPAGE)) &&
+		vma->vm_ops->fault == filemap_fault &&
+		!(vma->vm_flags & (VM_LOCKED | VM_NONLINEAR));
+}
+#else
+static inline void do_fault_around(struct mm_struct *mm,
+		struct vm_area_struct *vma, unsigned long address, pmd_t *pmd)
+{
+}
+
+static inline bool want_fault_around(struct vm_area_struct *vma,
+		unsigned int flags, int ret)
+{
+	return false;
+}
+#endif
+
 static int do_linear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, pte_t *page_table, pmd_t *pmd,
 		unsigned int flags, pte_t orig_pte)
 {
 	pgoff_t pgoff = (((address & PAGE_MASK)
 			- vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+	int ret;
 
 	pte_unmap(page_table);
-	return __do_fault(mm, vma, address, pmd, pgoff, flags, orig_pte);
+	ret = __do_fault(mm, vma, address, pmd, pgoff, flags, orig_pte);
+	if (want_fault_around(vma, flags, ret))
+		do_fault_around(mm, vma, address, pmd);
+	return ret;
 }
 
 /*
@@ -3220,6 +3686,8 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	pmd = pmd_alloc(mm, pud, address);
 	if (!pmd)
 		return VM_FAULT_OOM;
+	if (unlikely(pte_table_shared(pmd)) && unshare_pte_table(vma, address))
+		return VM_FAULT_OOM;
 	pte = pte_alloc_map(mm, pmd, address);
 	if (!pte)
 		return VM_FAULT_OOM;
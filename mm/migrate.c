@@ -104,6 +104,7 @@ static int remove_migration_pte(struct page *new, struct vm_area_struct *vma,
 		goto out;
 
 	pmd = pmd_offset(pud, addr);
+again:
 	if (!pmd_present(*pmd))
 		goto out;
 
@@ -116,6 +117,11 @@ static int remove_migration_pte(struct page *new, struct vm_area_struct *vma,
 
  	ptl = pte_lockptr(mm, pmd);
  	spin_lock(ptl);
+	if (unlikely(pte_table_moved(pmd, ptep))) {
+		/* the page table shared since fork was unshared meanwhile */
+		pte_unmap_unlock(ptep, ptl);
+		goto again;
+	}
 	pte = *ptep;
 	if (!is_swap_pte(pte))
 		goto unlock;
@@ -519,6 +519,11 @@ int vma_adjust(struct vm_area_struct *vma, unsigned long start,
 	long adjust_next = 0;
 	int remove_next = 0;
 
+	/* no page table shared since fork may straddle a vma boundary */
+	if ((start != vma->vm_start && unshare_pte_boundary(mm, start)) ||
+	    (end != vma->vm_end && unshare_pte_boundary(mm, end)))
+		return -ENOMEM;
+
 	if (next && !insert) {
 		struct vm_area_struct *exporter = NULL;
 
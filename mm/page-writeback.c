@@ -219,6 +219,7 @@ int dirty_bytes_handler(struct ctl_table *table, int write,
  */
 static inline void __bdi_writeout_inc(struct backing_dev_info *bdi)
 {
+	__inc_bdi_stat(bdi, BDI_WRITTEN);
 	__prop_inc_percpu_max(&vm_completions, &bdi->completions,
 			      bdi->max_prop_frac);
 }
@@ -440,6 +441,85 @@ void global_dirty_limits(unsigned long *pbackground, unsigned long *pdirty)
 	*pdirty = dirty;
 }
 
+/*
+ * The write bandwidth estimate is refreshed at most every 200ms and
+ * averaged over a ~3s period, so short bursts don't swing it around.
+ */
+#define BANDWIDTH_INTERVAL	max(HZ/5, 1)
+#define BANDWIDTH_PERIOD	roundup_pow_of_two(3 * HZ)
+
+/*
+ * A bdi never gets more dirty pages than it can write back in this many
+ * seconds at its measured bandwidth, but always at least BDI_DIRTY_MIN.
+ */
+#define BDI_DIRTY_SECONDS	2
+#define BDI_DIRTY_MIN		((4 << 20) >> PAGE_SHIFT)
+
+static void bdi_update_write_bandwidth(struct backing_dev_info *bdi,
+				       unsigned long elapsed,
+				       unsigned long written)
+{
+	const unsigned long period = BANDWIDTH_PERIOD;
+	u64 bw;
+
+	bw = (u64)(written - bdi->written_stamp) * HZ;
+	if (unlikely(elapsed > period)) {
+		do_div(bw, elapsed);
+		bdi->write_bandwidth = bw;
+		return;
+	}
+
+	/*
+	 * bw = written * HZ / elapsed
+	 *
+	 *                   bw * elapsed + write_bandwidth * (period - elapsed)
+	 * write_bandwidth = ---------------------------------------------------
+	 *                                          period
+	 */
+	bw += (u64)bdi->write_bandwidth * (period - elapsed);
+	bdi->write_bandwidth = bw >> ilog2(period);
+}
+
+/*
+ * bdi_update_bandwidth - refresh the write bandwidth estimate of @bdi
+ *
+ * Called from the dirty throttling and writeback loops, both of which run
+ * while the device has writeback in flight.
+ */
+void bdi_update_bandwidth(struct backing_dev_info *bdi)
+{
+	unsigned long now = jiffies;
+	unsigned long elapsed;
+	unsigned long written;
+
+	if (now - bdi->bw_time_stamp < BANDWIDTH_INTERVAL)
+		return;
+	if (!spin_trylock(&bdi->bw_lock))
+		return;
+
+	elapsed = now - bdi->bw_time_stamp;
+	if (elapsed < BANDWIDTH_INTERVAL)
+		goto unlock;
+
+	written = percpu_counter_read(&bdi->bdi_stat[BDI_WRITTEN]);
+
+	/*
+	 * A device that has been idle for a whole period would only
+	 * drag the estimate down, take a fresh snapshot instead.
+	 */
+	if (elapsed > BANDWIDTH_PERIOD &&
+	    !bdi_stat(bdi, BDI_WRITEBACK) && !bdi_stat(bdi, BDI_RECLAIMABLE))
+		goto snapshot;
+
+	bdi_update_write_bandwidth(bdi, elapsed, written);
+
+snapshot:
+	bdi->written_stamp = written;
+	bdi->bw_time_stamp = now;
+unlock:
+	spin_unlock(&bdi->bw_lock);
+}
+
 /*
  * bdi_dirty_limit - @bdi's share of dirty throttling threshold
  *
@@ -449,6 +529,9 @@ void global_dirty_limits(unsigned long *pbackground, unsigned long *pdirty)
  *
  * The bdi's share of dirty limit will be adapting to its throughput and
  * bounded by the bdi->min_ratio and/or bdi->max_ratio parameters, if set.
+ * Once the write bandwidth is known, it is further capped to what the
+ * device can write back in BDI_DIRTY_SECONDS, so a slow device cannot
+ * fill the global limit and stall writers to the others.
  */
 unsigned long bdi_dirty_limit(struct backing_dev_info *bdi, unsigned long dirty)
 {
@@ -468,6 +551,16 @@ unsigned long bdi_dirty_limit(struct backing_dev_info *bdi, unsigned long dirty)
 	if (bdi_dirty > (dirty * bdi->max_ratio) / 100)
 		bdi_dirty = dirty * bdi->max_ratio / 100;
 
+	if (bdi->write_bandwidth) {
+		unsigned long bw_dirty;
+
+		bw_dirty = bdi->write_bandwidth * BDI_DIRTY_SECONDS;
+		bw_dirty = max(bw_dirty, (unsigned long)BDI_DIRTY_MIN);
+		bw_dirty = max(bw_dirty, dirty * bdi->min_ratio / 100);
+		if (bdi_dirty > bw_dirty)
+			bdi_dirty = bw_dirty;
+	}
+
 	return bdi_dirty;
 }
 
@@ -505,6 +598,8 @@ static void balance_dirty_pages(struct address_space *mapping,
 
 		global_dirty_limits(&background_thresh, &dirty_thresh);
 
+		bdi_update_bandwidth(bdi);
+
 		/*
 		 * Throttle it only when the background writeback cannot
 		 * catch-up. This avoids (excessively) small writeouts
@@ -173,6 +173,12 @@ static char * const zone_names[MAX_NR_ZONES] = {
 int min_free_kbytes = 1024;
 int min_free_order_shift = 1;
 
+/*
+ * Extra memory kswapd keeps free on top of min_free_kbytes.  Background
+ * tasks are not allowed to allocate it without reclaiming first.
+ */
+int extra_free_kbytes = 0;
+
 static unsigned long __meminitdata nr_kernel_pages;
 static unsigned long __meminitdata nr_all_pages;
 static unsigned long __meminitdata dma_reserve;
@@ -643,6 +649,80 @@ static void free_one_page(struct zone *zone, struct page *page, int order,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * Unmovable blocks of order 1..PCP_MAX_ORDER are cached on the pcp too,
+ * one list per order, so that the nvmap and camera allocations of a few
+ * pages do not take the zone lock each time.  A list holds fewer than
+ * pcp_order_high() blocks and is refilled pcp_order_batch() at a time.
+ */
+static inline bool pcp_order_cached(int order, int migratetype)
+{
+	return order <= PCP_MAX_ORDER && migratetype == MIGRATE_UNMOVABLE;
+}
+
+static inline int pcp_order_high(struct per_cpu_pages *pcp, int order)
+{
+	return max(2, pcp->high >> (order + 1));
+}
+
+static inline int pcp_order_batch(struct per_cpu_pages *pcp, int order)
+{
+	return max(1, pcp->batch >> (order + 1));
+}
+
+/* Called with interrupts disabled */
+static void free_pcp_order_bulk(struct zone *zone, int order, int count,
+				struct per_cpu_pages *pcp)
+{
+	struct list_head *list = &pcp->order_lists[order - 1];
+	int i;
+
+	spin_lock(&zone->lock);
+	zone->all_unreclaimable = 0;
+	zone->pages_scanned = 0;
+
+	for (i = 0; i < count && !list_empty(list); i++) {
+		struct page *page = list_entry(list->prev, struct page, lru);
+
+		list_del(&page->lru);
+		__free_one_page(page, zone, order, page_private(page));
+		trace_mm_page_pcpu_drain(page, order, page_private(page));
+	}
+	pcp->order_count[order - 1] -= i;
+	__mod_zone_page_state(zone, NR_FREE_PAGES, i << order);
+	spin_unlock(&zone->lock);
+}
+
+/* Called with interrupts disabled */
+static void free_pcp_orders(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	int order;
+
+	for (order = 1; order <= PCP_MAX_ORDER; order++)
+		if (pcp->order_count[order - 1])
+			free_pcp_order_bulk(zone, order,
+					pcp->order_count[order - 1], pcp);
+}
+
+/* Called with interrupts disabled */
+static void free_pcp_order_page(struct zone *zone, struct page *page,
+				int order, int migratetype)
+{
+	struct per_cpu_pages *pcp;
+
+	/* __free_one_page() would do this, and the block may be reused */
+	if (unlikely(PageCompound(page)))
+		if (unlikely(destroy_compound_page(page, order)))
+			return;
+
+	set_page_private(page, migratetype);
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list_add(&page->lru, &pcp->order_lists[order - 1]);
+	if (++pcp->order_count[order - 1] >= pcp_order_high(pcp, order))
+		free_pcp_order_bulk(zone, order, pcp_order_batch(pcp, order),
+				    pcp);
+}
+
 static bool free_pages_prepare(struct page *page, unsigned int order)
 {
 	int i;
@@ -675,17 +755,21 @@ static bool free_pages_prepare(struct page *page, unsigned int order)
 static void __free_pages_ok(struct page *page, unsigned int order)
 {
 	unsigned long flags;
+	int migratetype;
 	int wasMlocked = __TestClearPageMlocked(page);
 
 	if (!free_pages_prepare(page, order))
 		return;
 
+	migratetype = get_pageblock_migratetype(page);
 	local_irq_save(flags);
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
-					get_pageblock_migratetype(page));
+	if (pcp_order_cached(order, migratetype))
+		free_pcp_order_page(page_zone(page), page, order, migratetype);
+	else
+		free_one_page(page_zone(page), page, order, migratetype);
 	local_irq_restore(flags);
 }
 
@@ -1097,6 +1181,7 @@ static void drain_pages(unsigned int cpu)
 		pcp = &pset->pcp;
 		free_pcppages_bulk(zone, pcp->count, pcp);
 		pcp->count = 0;
+		free_pcp_orders(zone, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1329,15 +1414,41 @@ again:
 			 */
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
-		page = __rmqueue(zone, order, migratetype);
-		spin_unlock(&zone->lock);
-		if (!page)
-			goto failed;
-		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1 << order));
+		if (pcp_order_cached(order, migratetype)) {
+			struct per_cpu_pages *pcp;
+			struct list_head *list;
+
+			local_irq_save(flags);
+			pcp = &this_cpu_ptr(zone->pageset)->pcp;
+			list = &pcp->order_lists[order - 1];
+			if (list_empty(list)) {
+				pcp->order_count[order - 1] +=
+					rmqueue_bulk(zone, order,
+						pcp_order_batch(pcp, order),
+						list, migratetype, 0);
+				if (unlikely(list_empty(list)))
+					goto failed;
+			} else {
+				__count_vm_event(PGALLOC_HIGHORDER_PCP);
+			}
+
+			page = list_entry(list->next, struct page, lru);
+			list_del(&page->lru);
+			pcp->order_count[order - 1]--;
+		} else {
+			spin_lock_irqsave(&zone->lock, flags);
+			page = __rmqueue(zone, order, migratetype);
+			spin_unlock(&zone->lock);
+			if (!page)
+				goto failed;
+			__mod_zone_page_state(zone, NR_FREE_PAGES,
+					      -(1 << order));
+		}
 	}
 
 	__count_zone_vm_events(PGALLOC, zone, 1 << order);
+	if (order)
+		__count_vm_event(PGALLOC_HIGHORDER);
 	zone_statistics(preferred_zone, zone);
 	local_irq_restore(flags);
 
@@ -1363,6 +1474,7 @@ failed:
 #define ALLOC_HARDER		0x10 /* try to alloc harder */
 #define ALLOC_HIGH		0x20 /* __GFP_HIGH set */
 #define ALLOC_CPUSET		0x40 /* check for correct cpuset */
+#define ALLOC_BACKGROUND	0x80 /* stay out of the foreground reserve */
 
 #ifdef CONFIG_FAIL_PAGE_ALLOC
 
@@ -1649,6 +1761,8 @@ zonelist_scan:
 			int ret;
 
 			mark = zone->watermark[alloc_flags & ALLOC_WMARK_MASK];
+			if (alloc_flags & ALLOC_BACKGROUND)
+				mark += zone->fg_reserve;
 			if (zone_watermark_ok(zone, order, mark,
 				    classzone_idx, alloc_flags))
 				goto try_this_zone;
@@ -1854,6 +1968,7 @@ __alloc_pages_direct_reclaim(gfp_t gfp_mask, unsigned int order,
 	struct reclaim_state reclaim_state;
 	struct task_struct *p = current;
 	bool drained = false;
+	u64 start, delta;
 
 	cond_resched();
 
@@ -1863,13 +1978,21 @@ __alloc_pages_direct_reclaim(gfp_t gfp_mask, unsigned int order,
 	lockdep_set_current_reclaim_state(gfp_mask);
 	reclaim_state.reclaimed_slab = 0;
 	p->reclaim_state = &reclaim_state;
+	start = sched_clock();
 
 	*did_some_progress = try_to_free_pages(zonelist, order, gfp_mask, nodemask);
 
+	delta = sched_clock() - start;
+	if ((s64)delta > 0)
+		p->direct_reclaim_ns += delta;
+	p->nr_direct_reclaim++;
 	p->reclaim_state = NULL;
 	lockdep_clear_current_reclaim_state();
 	p->flags &= ~PF_MEMALLOC;
 
+	/* kswapd should have kept this from happening, make it try harder */
+	boost_kswapd_watermark(preferred_zone);
+
 	cond_resched();
 
 	if (unlikely(!(*did_some_progress)))
@@ -1956,6 +2079,9 @@ gfp_to_alloc_flags(gfp_t gfp_mask)
 		alloc_flags &= ~ALLOC_CPUSET;
 	} else if (unlikely(rt_task(p)) && !in_interrupt())
 		alloc_flags |= ALLOC_HARDER;
+	else if (task_nice(p) > 0 && !in_interrupt() &&
+		 !(alloc_flags & ALLOC_HIGH))
+		alloc_flags |= ALLOC_BACKGROUND;
 
 	if (likely(!(gfp_mask & __GFP_NOMEMALLOC))) {
 		if (!in_interrupt() &&
@@ -2004,6 +2130,7 @@ __alloc_pages_slowpath(gfp_t gfp_mask, unsigned int order,
 
 restart:
 	wake_all_kswapd(order, zonelist, high_zoneidx);
+	wakeup_compaction(order);
 
 	/*
 	 * OK, we're below the kswapd watermark and have kicked background
@@ -2120,6 +2247,20 @@ got_pg:
 
 }
 
+/* Account a high-order allocation that took the slow path */
+static void count_highorder_slowpath(u64 start, struct page *page)
+{
+	u64 delta = sched_clock() - start;
+
+	if ((s64)delta < 0)
+		delta = 0;
+	count_vm_event(PGALLOC_HIGHORDER_SLOW);
+	count_vm_events(PGALLOC_HIGHORDER_SLOW_US,
+			div_u64(delta, NSEC_PER_USEC));
+	if (!page)
+		count_vm_event(PGALLOC_HIGHORDER_FAIL);
+}
+
 /*
  * This is the 'heart' of the zoned buddy allocator.
  */
@@ -2161,10 +2302,15 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 	page = get_page_from_freelist(gfp_mask|__GFP_HARDWALL, nodemask, order,
 			zonelist, high_zoneidx, ALLOC_WMARK_LOW|ALLOC_CPUSET,
 			preferred_zone, migratetype);
-	if (unlikely(!page))
+	if (unlikely(!page)) {
+		u64 start = order ? sched_clock() : 0;
+
 		page = __alloc_pages_slowpath(gfp_mask, order,
 				zonelist, high_zoneidx, nodemask,
 				preferred_zone, migratetype);
+		if (order)
+			count_highorder_slowpath(start, page);
+	}
 	put_mems_allowed();
 
 	trace_mm_page_alloc(page, order, gfp_mask, migratetype);
@@ -3377,7 +3523,7 @@ static int zone_batchsize(struct zone *zone)
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
-	int migratetype;
+	int migratetype, order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -3387,6 +3533,8 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+	for (order = 0; order < PCP_MAX_ORDER; order++)
+		INIT_LIST_HEAD(&pcp->order_lists[order]);
 }
 
 /*
@@ -3494,6 +3642,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		free_pcp_orders(zone, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -4872,7 +5021,8 @@ static void setup_per_zone_lowmem_reserve(void)
 }
 
 /**
- * setup_per_zone_wmarks - called when min_free_kbytes changes
+ * setup_per_zone_wmarks - called when min_free_kbytes or extra_free_kbytes
+ * changes
  * or when memory is hot-{added|removed}
  *
  * Ensures that the watermark[min,low,high] values for each zone are set
@@ -4881,7 +5031,9 @@ static void setup_per_zone_lowmem_reserve(void)
 void setup_per_zone_wmarks(void)
 {
 	unsigned long pages_min = min_free_kbytes >> (PAGE_SHIFT - 10);
+	unsigned long pages_extra = extra_free_kbytes >> (PAGE_SHIFT - 10);
 	unsigned long lowmem_pages = 0;
+	unsigned long total_pages = 0;
 	struct zone *zone;
 	unsigned long flags;
 
@@ -4889,10 +5041,11 @@ void setup_per_zone_wmarks(void)
 	for_each_zone(zone) {
 		if (!is_highmem(zone))
 			lowmem_pages += zone->present_pages;
+		total_pages += zone->present_pages;
 	}
 
 	for_each_zone(zone) {
-		u64 tmp;
+		u64 tmp, extra;
 
 		spin_lock_irqsave(&zone->lock, flags);
 		tmp = (u64)pages_min * zone->present_pages;
@@ -4923,8 +5076,15 @@ void setup_per_zone_wmarks(void)
 			zone->watermark[WMARK_MIN] = tmp;
 		}
 
-		zone->watermark[WMARK_LOW]  = min_wmark_pages(zone) + (tmp >> 2);
-		zone->watermark[WMARK_HIGH] = min_wmark_pages(zone) + (tmp >> 1);
+		/* the extra reserve is spread over all zones by size */
+		extra = (u64)pages_extra * zone->present_pages;
+		do_div(extra, total_pages);
+		zone->fg_reserve = extra;
+
+		zone->watermark[WMARK_LOW]  = min_wmark_pages(zone) +
+					(tmp >> 2) + extra;
+		zone->watermark[WMARK_HIGH] = min_wmark_pages(zone) +
+					(tmp >> 1) + extra;
 		setup_zone_migrate_reserve(zone);
 		spin_unlock_irqrestore(&zone->lock, flags);
 	}
@@ -17,6 +17,10 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -568,3 +572,284 @@ page_cache_async_readahead(struct address_space *mapping,
 #endif
 }
 EXPORT_SYMBOL_GPL(page_cache_async_readahead);
+
+#ifdef CONFIG_READAHEAD_PROFILE
+/*
+ * Readahead profiles.
+ *
+ * Launching an app faults in scattered pages of its apk, dex and shared
+ * library mappings, each one a small read that read-around either
+ * overshoots or has to repeat.  For the first RA_PROFILE_LEARN opens of a
+ * file the page offsets faulted through its mappings are recorded; later
+ * opens read whatever of the recorded pages is not cached, in ascending
+ * order and as one batch.
+ *
+ * Profiles are keyed by device and inode number so they outlive the inode
+ * in the icache, and are thrown away when the file size or mtime changes.
+ */
+#define RA_PROFILE_LEARN	3
+#define RA_PROFILE_MAX_PAGES	4096
+#define RA_PROFILE_MAX		256
+#define RA_PROFILE_HASH_BITS	6
+
+struct ra_profile {
+	struct hlist_node hash;
+	struct list_head lru;
+	atomic_t count;
+	dev_t dev;
+	unsigned long ino;
+	__u32 generation;
+	loff_t size;
+	struct timespec mtime;
+	unsigned int nr_opens;
+	DECLARE_BITMAP(pages, RA_PROFILE_MAX_PAGES);
+};
+
+/* protects the hash, the lru and nr_opens */
+static DEFINE_SPINLOCK(ra_profile_lock);
+static struct hlist_head ra_profile_hash[1 << RA_PROFILE_HASH_BITS];
+static LIST_HEAD(ra_profile_lru);
+static int nr_ra_profiles;
+
+static unsigned long ra_profile_replays;
+static unsigned long ra_profile_replay_pages;
+
+static struct hlist_head *ra_profile_head(struct inode *inode)
+{
+	unsigned long key = inode->i_ino ^ inode->i_sb->s_dev;
+
+	return &ra_profile_hash[hash_long(key, RA_PROFILE_HASH_BITS)];
+}
+
+static struct ra_profile *ra_profile_find(struct inode *inode)
+{
+	struct ra_profile *p;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(p, node, ra_profile_head(inode), hash) {
+		if (p->ino == inode->i_ino && p->dev == inode->i_sb->s_dev &&
+		    p->generation == inode->i_generation)
+			return p;
+	}
+	return NULL;
+}
+
+static void ra_profile_put(struct ra_profile *p)
+{
+	if (atomic_dec_and_test(&p->count))
+		kfree(p);
+}
+
+/* Called with ra_profile_lock held, drops the table's reference */
+static void ra_profile_unhash(struct ra_profile *p)
+{
+	hlist_del_init(&p->hash);
+	list_del_init(&p->lru);
+	nr_ra_profiles--;
+	ra_profile_put(p);
+}
+
+static int ra_profile_stale(struct ra_profile *p, struct inode *inode)
+{
+	return p->size != i_size_read(inode) ||
+		!timespec_equal(&p->mtime, &inode->i_mtime);
+}
+
+static void ra_profile_insert(struct ra_profile *p, struct inode *inode)
+{
+	p->dev = inode->i_sb->s_dev;
+	p->ino = inode->i_ino;
+	p->generation = inode->i_generation;
+	p->size = i_size_read(inode);
+	p->mtime = inode->i_mtime;
+	p->nr_opens = 0;
+	bitmap_zero(p->pages, RA_PROFILE_MAX_PAGES);
+	atomic_set(&p->count, 1);
+
+	hlist_add_head(&p->hash, ra_profile_head(inode));
+	list_add(&p->lru, &ra_profile_lru);
+	if (++nr_ra_profiles > RA_PROFILE_MAX)
+		ra_profile_unhash(list_entry(ra_profile_lru.prev,
+					     struct ra_profile, lru));
+}
+
+/*
+ * Read the recorded pages that are not in the page cache.  The bitmap is
+ * walked in ascending order so the reads reach the device sorted, in
+ * chunks of 2MB like force_page_cache_readahead().
+ */
+static void ra_profile_replay(struct file *filp, struct ra_profile *p)
+{
+	struct address_space *mapping = filp->f_mapping;
+	unsigned long chunk = (2 * 1024 * 1024) / PAGE_CACHE_SIZE;
+	unsigned long end_index, nr_pages = 0, total = 0;
+	loff_t isize = i_size_read(mapping->host);
+	LIST_HEAD(page_pool);
+	struct page *page;
+	unsigned long index;
+
+	if (isize == 0)
+		return;
+	end_index = min_t(unsigned long, (isize - 1) >> PAGE_CACHE_SHIFT,
+			  RA_PROFILE_MAX_PAGES - 1);
+	chunk = max_sane_readahead(chunk);
+
+	for_each_set_bit(index, p->pages, end_index + 1) {
+		rcu_read_lock();
+		page = radix_tree_lookup(&mapping->page_tree, index);
+		rcu_read_unlock();
+		if (page)
+			continue;
+
+		page = page_cache_alloc_cold(mapping);
+		if (!page)
+			break;
+		page->index = index;
+		list_add(&page->lru, &page_pool);
+		if (++nr_pages == chunk) {
+			read_pages(mapping, filp, &page_pool, nr_pages);
+			total += nr_pages;
+			nr_pages = 0;
+		}
+	}
+	if (nr_pages) {
+		read_pages(mapping, filp, &page_pool, nr_pages);
+		total += nr_pages;
+	}
+	BUG_ON(!list_empty(&page_pool));
+
+	if (total) {
+		blk_run_backing_dev(mapping->backing_dev_info, NULL);
+		spin_lock(&ra_profile_lock);
+		ra_profile_replays++;
+		ra_profile_replay_pages += total;
+		spin_unlock(&ra_profile_lock);
+	}
+}
+
+/**
+ * ra_profile_open - record or replay the readahead profile of a file
+ * @filp: file just opened
+ *
+ * The first RA_PROFILE_LEARN read-only opens of a regular file on a block
+ * device attach the inode's profile to @filp, so that ra_profile_fault()
+ * records into it.  Later opens replay the profile.
+ */
+void ra_profile_open(struct file *filp)
+{
+	struct inode *inode = filp->f_mapping->host;
+	struct ra_profile *p, *new = NULL;
+	int replay = 0;
+
+	if (!S_ISREG(inode->i_mode) || !inode->i_sb->s_bdev)
+		return;
+	if ((filp->f_mode & (FMODE_READ | FMODE_WRITE)) != FMODE_READ ||
+	    (filp->f_flags & O_DIRECT))
+		return;
+	if (!filp->f_mapping->a_ops->readpage &&
+	    !filp->f_mapping->a_ops->readpages)
+		return;
+
+again:
+	spin_lock(&ra_profile_lock);
+	p = ra_profile_find(inode);
+	if (p && ra_profile_stale(p, inode)) {
+		ra_profile_unhash(p);
+		p = NULL;
+	}
+	if (!p) {
+		if (!new) {
+			spin_unlock(&ra_profile_lock);
+			new = kmalloc(sizeof(*new), GFP_KERNEL);
+			if (!new)
+				return;
+			goto again;
+		}
+		ra_profile_insert(new, inode);
+		p = new;
+		new = NULL;
+	}
+	list_move(&p->lru, &ra_profile_lru);
+	atomic_inc(&p->count);
+	if (p->nr_opens < RA_PROFILE_LEARN) {
+		p->nr_opens++;
+		filp->f_ra_profile = p;
+	} else
+		replay = 1;
+	spin_unlock(&ra_profile_lock);
+
+	kfree(new);
+	if (replay) {
+		ra_profile_replay(filp, p);
+		ra_profile_put(p);
+	}
+}
+
+void __ra_profile_fault(struct ra_profile *p, pgoff_t offset)
+{
+	if (offset < RA_PROFILE_MAX_PAGES)
+		set_bit(offset, p->pages);
+}
+
+/*
+ * Called from __fput().  A profile that was created for this open and
+ * saw no faults is dropped again, most opened files are never mapped.
+ */
+void ra_profile_release(struct file *filp)
+{
+	struct ra_profile *p = filp->f_ra_profile;
+
+	if (!p)
+		return;
+
+	spin_lock(&ra_profile_lock);
+	if (p->nr_opens == 1 && !hlist_unhashed(&p->hash) &&
+	    bitmap_empty(p->pages, RA_PROFILE_MAX_PAGES))
+		ra_profile_unhash(p);
+	spin_unlock(&ra_profile_lock);
+
+	filp->f_ra_profile = NULL;
+	ra_profile_put(p);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int ra_profile_show(struct seq_file *s, void *data)
+{
+	struct ra_profile *p;
+
+	spin_lock(&ra_profile_lock);
+	seq_printf(s, "profiles:      %d\n", nr_ra_profiles);
+	seq_printf(s, "replays:       %lu\n", ra_profile_replays);
+	seq_printf(s, "replay pages:  %lu\n", ra_profile_replay_pages);
+	list_for_each_entry(p, &ra_profile_lru, lru)
+		seq_printf(s, "%u:%u %lu opens %u pages %d\n",
+			   MAJOR(p->dev), MINOR(p->dev), p->ino, p->nr_opens,
+			   bitmap_weight(p->pages, RA_PROFILE_MAX_PAGES));
+	spin_unlock(&ra_profile_lock);
+
+	return 0;
+}
+
+static int ra_profile_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ra_profile_show, inode->i_private);
+}
+
+static const struct file_operations ra_profile_fops = {
+	.open		= ra_profile_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init ra_profile_debugfs_init(void)
+{
+	if (!debugfs_create_file("ra_profiles", S_IRUGO, NULL, NULL,
+				 &ra_profile_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+late_initcall(ra_profile_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
+#endif /* CONFIG_READAHEAD_PROFILE */
@@ -419,6 +419,7 @@ pte_t *page_check_address(struct page *page, struct mm_struct *mm,
 	if (unlikely(PageHuge(page))) {
 		pte = huge_pte_offset(mm, address);
 		ptl = &mm->page_table_lock;
+		spin_lock(ptl);
 		goto check;
 	}
 
@@ -431,6 +432,7 @@ pte_t *page_check_address(struct page *page, struct mm_struct *mm,
 		return NULL;
 
 	pmd = pmd_offset(pud, address);
+again:
 	if (!pmd_present(*pmd))
 		return NULL;
 
@@ -442,8 +444,13 @@ pte_t *page_check_address(struct page *page, struct mm_struct *mm,
 	}
 
 	ptl = pte_lockptr(mm, pmd);
-check:
 	spin_lock(ptl);
+	if (unlikely(pte_table_moved(pmd, pte))) {
+		/* the page table shared since fork was unshared meanwhile */
+		pte_unmap_unlock(pte, ptl);
+		goto again;
+	}
+check:
 	if (pte_present(*pte) && page_to_pfn(page) == pte_pfn(*pte)) {
 		*ptlp = ptl;
 		return pte;
@@ -1008,6 +1015,9 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	/* Nuke the page table entry. */
 	flush_cache_page(vma, address, page_to_pfn(page));
 	pteval = ptep_clear_flush_notify(vma, address, pte);
+	/* other mms may map it through the same page table */
+	if (ptep_table_shared(pte))
+		flush_tlb_all();
 
 	/* Move the dirty bit to the physical page now the pte is gone. */
 	if (pte_dirty(pteval))
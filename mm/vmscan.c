@@ -128,6 +128,12 @@ struct scan_control {
  * From 0 .. 100.  Higher means more swappy.
  */
 int vm_swappiness = 60;
+
+/*
+ * How far direct reclaim may push kswapd's target past the high
+ * watermark, in fractions of 10000 of the high watermark.  0 disables it.
+ */
+int watermark_boost_factor = 15000;
 long vm_total_pages;	/* The total number of pages which the VM controls */
 
 static LIST_HEAD(shrinker_list);
@@ -2063,6 +2069,12 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *mem_cont,
 }
 #endif
 
+/* the mark kswapd reclaims a zone up to before going back to sleep */
+static inline unsigned long kswapd_wmark_pages(struct zone *zone)
+{
+	return high_wmark_pages(zone) + zone->watermark_boost;
+}
+
 /* is kswapd sleeping prematurely? */
 static int sleeping_prematurely(pg_data_t *pgdat, int order, long remaining)
 {
@@ -2082,7 +2094,7 @@ static int sleeping_prematurely(pg_data_t *pgdat, int order, long remaining)
 		if (zone->all_unreclaimable)
 			continue;
 
-		if (!zone_watermark_ok(zone, order, high_wmark_pages(zone),
+		if (!zone_watermark_ok(zone, order, kswapd_wmark_pages(zone),
 								0, 0))
 			return 1;
 	}
@@ -2090,6 +2102,22 @@ static int sleeping_prematurely(pg_data_t *pgdat, int order, long remaining)
 	return 0;
 }
 
+/* Drop the boosts once kswapd got there, or gave up trying */
+static int clear_watermark_boost(pg_data_t *pgdat)
+{
+	int i, boosted = 0;
+
+	for (i = 0; i < pgdat->nr_zones; i++) {
+		struct zone *zone = pgdat->node_zones + i;
+
+		if (zone->watermark_boost) {
+			zone->watermark_boost = 0;
+			boosted = 1;
+		}
+	}
+	return boosted;
+}
+
 /*
  * For kswapd, balance_pgdat() will work across all this node's zones until
  * they are all at high_wmark_pages(zone).
@@ -2170,7 +2198,7 @@ loop_again:
 							&sc, priority, 0);
 
 			if (!zone_watermark_ok(zone, order,
-					high_wmark_pages(zone), 0, 0)) {
+					kswapd_wmark_pages(zone), 0, 0)) {
 				end_zone = i;
 				break;
 			}
@@ -2237,7 +2265,7 @@ loop_again:
 				sc.may_writepage = 1;
 
 			if (!zone_watermark_ok(zone, order,
-					high_wmark_pages(zone), end_zone, 0)) {
+					kswapd_wmark_pages(zone), end_zone, 0)) {
 				all_zones_ok = 0;
 				/*
 				 * We are still under min water mark.  This
@@ -2292,12 +2320,17 @@ out:
 		 * back to sleep. High-order users can still perform direct
 		 * reclaim if they wish.
 		 */
-		if (sc.nr_reclaimed < SWAP_CLUSTER_MAX)
+		if (sc.nr_reclaimed < SWAP_CLUSTER_MAX) {
+			/* the boosted target is out of reach, settle for high */
+			if (clear_watermark_boost(pgdat))
+				goto loop_again;
 			order = sc.order = 0;
+		}
 
 		goto loop_again;
 	}
 
+	clear_watermark_boost(pgdat);
 	return sc.nr_reclaimed;
 }
 
@@ -2407,6 +2440,33 @@ static int kswapd(void *p)
 	return 0;
 }
 
+/*
+ * An allocation had to reclaim directly from @zone, so kswapd is falling
+ * behind.  Raise its target above the high mark by a pageblock per event,
+ * up to watermark_boost_factor/10000 of the high mark, and wake it to
+ * reclaim ahead of the next burst.
+ */
+void boost_kswapd_watermark(struct zone *zone)
+{
+	pg_data_t *pgdat;
+	unsigned long max_boost;
+
+	if (!watermark_boost_factor || !populated_zone(zone))
+		return;
+
+	max_boost = div_u64((u64)high_wmark_pages(zone) *
+			    watermark_boost_factor, 10000);
+	zone->watermark_boost = min(zone->watermark_boost + pageblock_nr_pages,
+				    max_boost);
+
+	pgdat = zone->zone_pgdat;
+	if (!cpuset_zone_allowed_hardwall(zone, GFP_KERNEL))
+		return;
+	if (!waitqueue_active(&pgdat->kswapd_wait))
+		return;
+	wake_up_interruptible(&pgdat->kswapd_wait);
+}
+
 /*
  * A zone is low on free memory, so wake its kswapd task to service it.
  */
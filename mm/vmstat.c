@@ -307,12 +307,18 @@ EXPORT_SYMBOL(dec_zone_page_state);
  * statistics in the remote zone struct as well as the global cachelines
  * with the global counters. These could cause remote node cache line
  * bouncing and will have to be only done when necessary.
+ *
+ * Returns nonzero if there was anything to fold, or remote pagesets are
+ * still waiting to be drained: then the next update should come around.
+ * With 'can_sleep' clear, as on the way into idle, it neither reschedules
+ * nor drains pagesets.
  */
-void refresh_cpu_vm_stats(int cpu)
+static int __refresh_cpu_vm_stats(int cpu, bool can_sleep)
 {
 	struct zone *zone;
 	int i;
 	int global_diff[NR_VM_ZONE_STAT_ITEMS] = { 0, };
+	int changes = 0;
 
 	for_each_populated_zone(zone) {
 		struct per_cpu_pageset *p;
@@ -330,11 +336,14 @@ void refresh_cpu_vm_stats(int cpu)
 				local_irq_restore(flags);
 				atomic_long_add(v, &zone->vm_stat[i]);
 				global_diff[i] += v;
+				changes++;
 #ifdef CONFIG_NUMA
 				/* 3 seconds idle till flush */
 				p->expire = 3;
 #endif
 			}
+		if (!can_sleep)
+			continue;
 		cond_resched();
 #ifdef CONFIG_NUMA
 		/*
@@ -356,8 +365,10 @@ void refresh_cpu_vm_stats(int cpu)
 		}
 
 		p->expire--;
-		if (p->expire)
+		if (p->expire) {
+			changes++;
 			continue;
+		}
 
 		if (p->pcp.count)
 			drain_zone_pages(zone, &p->pcp);
@@ -367,6 +378,29 @@ void refresh_cpu_vm_stats(int cpu)
 	for (i = 0; i < NR_VM_ZONE_STAT_ITEMS; i++)
 		if (global_diff[i])
 			atomic_long_add(global_diff[i], &vm_stat[i]);
+
+	return changes;
+}
+
+int refresh_cpu_vm_stats(int cpu)
+{
+	return __refresh_cpu_vm_stats(cpu, true);
+}
+
+/* Does the cpu have any differentials left to fold? */
+static bool need_update(int cpu)
+{
+	struct zone *zone;
+	int i;
+
+	for_each_populated_zone(zone) {
+		struct per_cpu_pageset *p = per_cpu_ptr(zone->pageset, cpu);
+
+		for (i = 0; i < NR_VM_ZONE_STAT_ITEMS; i++)
+			if (p->vm_stat_diff[i])
+				return true;
+	}
+	return false;
 }
 
 #endif
@@ -789,6 +823,12 @@ static const char * const vmstat_text[] = {
 
 	"pgrotated",
 
+	"pgalloc_highorder",
+	"pgalloc_highorder_pcp",
+	"pgalloc_highorder_slow",
+	"pgalloc_highorder_slow_us",
+	"pgalloc_highorder_fail",
+
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
 	"compact_pages_moved",
@@ -796,11 +836,18 @@ static const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_background",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
 	"htlb_buddy_alloc_success",
 	"htlb_buddy_alloc_fail",
+#endif
+	"fork_pte_copied",
+#ifdef CONFIG_FORK_SHARE_PTE
+	"fork_pte_shared",
+	"fork_pte_tables_shared",
+	"fork_pte_tables_unshared",
 #endif
 	"unevictable_pgs_culled",
 	"unevictable_pgs_scanned",
@@ -980,13 +1027,79 @@ static const struct file_operations proc_vmstat_file_operations = {
 #endif /* CONFIG_PROC_FS */
 
 #ifdef CONFIG_SMP
+/*
+ * Each cpu folds its differentials from a deferrable work, which stops
+ * rearming itself once a run finds nothing to fold.  The differentials
+ * are also folded from the idle loop just before the tick is stopped,
+ * so an idle cpu has nothing left and its work stays off.  The shepherd,
+ * itself deferrable, restarts the work of any cpu that has differentials
+ * again; an idle cpu is then never woken up for its statistics.
+ */
 static DEFINE_PER_CPU(struct delayed_work, vmstat_work);
 int sysctl_stat_interval __read_mostly = HZ;
+static cpumask_t vmstat_off_cpus;
+
+struct vmstat_work_stats {
+	unsigned long updates;		/* runs of vmstat_update */
+	unsigned long idle_updates;	/* of which found nothing to fold */
+	unsigned long quiet_folds;	/* folds on the way into idle */
+	unsigned long restarts;		/* restarts by the shepherd */
+};
+static DEFINE_PER_CPU(struct vmstat_work_stats, vmstat_work_stats);
 
 static void vmstat_update(struct work_struct *w)
 {
-	refresh_cpu_vm_stats(smp_processor_id());
-	schedule_delayed_work(&__get_cpu_var(vmstat_work),
+	int cpu = smp_processor_id();
+	struct vmstat_work_stats *stats = &__get_cpu_var(vmstat_work_stats);
+
+	stats->updates++;
+	if (refresh_cpu_vm_stats(cpu)) {
+		schedule_delayed_work(&__get_cpu_var(vmstat_work),
+			round_jiffies_relative(sysctl_stat_interval));
+	} else {
+		stats->idle_updates++;
+		cpumask_set_cpu(cpu, &vmstat_off_cpus);
+	}
+}
+
+/*
+ * quiet_vmstat - fold this cpu's differentials as it goes idle
+ *
+ * Called with interrupts disabled from the nohz idle path, when the tick
+ * is about to be stopped.
+ */
+void quiet_vmstat(void)
+{
+	int cpu = smp_processor_id();
+
+	if (system_state != SYSTEM_RUNNING || !need_update(cpu))
+		return;
+
+	__refresh_cpu_vm_stats(cpu, false);
+	__get_cpu_var(vmstat_work_stats).quiet_folds++;
+}
+
+static void vmstat_shepherd(struct work_struct *w);
+static struct delayed_work shepherd;
+
+static void vmstat_shepherd(struct work_struct *w)
+{
+	int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		if (!cpumask_test_cpu(cpu, &vmstat_off_cpus) ||
+		    !need_update(cpu))
+			continue;
+		if (cpumask_test_and_clear_cpu(cpu, &vmstat_off_cpus)) {
+			per_cpu(vmstat_work_stats, cpu).restarts++;
+			schedule_delayed_work_on(cpu,
+				&per_cpu(vmstat_work, cpu), 0);
+		}
+	}
+	put_online_cpus();
+
+	schedule_delayed_work(&shepherd,
 		round_jiffies_relative(sysctl_stat_interval));
 }
 
@@ -994,6 +1107,7 @@ static void __cpuinit start_cpu_timer(int cpu)
 {
 	struct delayed_work *work = &per_cpu(vmstat_work, cpu);
 
+	cpumask_clear_cpu(cpu, &vmstat_off_cpus);
 	INIT_DELAYED_WORK_DEFERRABLE(work, vmstat_update);
 	schedule_delayed_work_on(cpu, work, __round_jiffies_relative(HZ, cpu));
 }
@@ -1019,6 +1133,7 @@ static int __cpuinit vmstat_cpuup_callback(struct notifier_block *nfb,
 	case CPU_DOWN_PREPARE_FROZEN:
 		cancel_rearming_delayed_work(&per_cpu(vmstat_work, cpu));
 		per_cpu(vmstat_work, cpu).work.func = NULL;
+		cpumask_clear_cpu(cpu, &vmstat_off_cpus);
 		break;
 	case CPU_DOWN_FAILED:
 	case CPU_DOWN_FAILED_FROZEN:
@@ -1048,6 +1163,10 @@ static int __init setup_vmstat(void)
 
 	for_each_online_cpu(cpu)
 		start_cpu_timer(cpu);
+
+	INIT_DELAYED_WORK_DEFERRABLE(&shepherd, vmstat_shepherd);
+	schedule_delayed_work(&shepherd,
+		round_jiffies_relative(sysctl_stat_interval));
 #endif
 #ifdef CONFIG_PROC_FS
 	proc_create("buddyinfo", S_IRUGO, NULL, &fragmentation_file_operations);
@@ -1217,3 +1336,52 @@ static int __init extfrag_debug_init(void)
 
 module_init(extfrag_debug_init);
 #endif
+
+#if defined(CONFIG_DEBUG_FS) && defined(CONFIG_SMP)
+#include <linux/debugfs.h>
+
+/*
+ * Per-cpu activity of the vmstat work, in debugfs as "vmstat_work": a cpu
+ * left alone to idle shows its updates stopping while quiet folds go on.
+ */
+static int vmstat_work_show(struct seq_file *m, void *unused)
+{
+	int cpu;
+
+	seq_puts(m, "cpu\tupdates\tidle\tquiet\trestarts\toff\n");
+	for_each_online_cpu(cpu) {
+		struct vmstat_work_stats *stats =
+			&per_cpu(vmstat_work_stats, cpu);
+
+		seq_printf(m, "%d\t%lu\t%lu\t%lu\t%lu\t\t%d\n", cpu,
+			   stats->updates, stats->idle_updates,
+			   stats->quiet_folds, stats->restarts,
+			   cpumask_test_cpu(cpu, &vmstat_off_cpus));
+	}
+
+	return 0;
+}
+
+static int vmstat_work_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vmstat_work_show, NULL);
+}
+
+static const struct file_operations vmstat_work_fops = {
+	.open		= vmstat_work_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init vmstat_work_debug_init(void)
+{
+	if (!debugfs_create_file("vmstat_work", 0444, NULL, NULL,
+				 &vmstat_work_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+
+module_init(vmstat_work_debug_init);
+#endif
@@ -557,37 +557,26 @@ static void rps_map_release(struct rcu_head *rcu)
 	kfree(map);
 }
 
-static ssize_t store_rps_map(struct netdev_rx_queue *queue,
-		      struct rx_queue_attribute *attribute,
-		      const char *buf, size_t len)
+static DEFINE_SPINLOCK(rps_map_lock);
+
+static int rps_map_set(struct netdev_rx_queue *queue,
+		       const struct cpumask *mask)
 {
 	struct rps_map *old_map, *map;
-	cpumask_var_t mask;
-	int err, cpu, i;
-	static DEFINE_SPINLOCK(rps_map_lock);
-
-	if (!capable(CAP_NET_ADMIN))
-		return -EPERM;
-
-	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
-		return -ENOMEM;
-
-	err = bitmap_parse(buf, len, cpumask_bits(mask), nr_cpumask_bits);
-	if (err) {
-		free_cpumask_var(mask);
-		return err;
-	}
+	int cpu, i;
 
 	map = kzalloc(max_t(unsigned,
 	    RPS_MAP_SIZE(cpumask_weight(mask)), L1_CACHE_BYTES),
 	    GFP_KERNEL);
-	if (!map) {
-		free_cpumask_var(mask);
+	if (!map)
 		return -ENOMEM;
-	}
 
+	/*
+	 * Keep CPUs that are offline right now: get_rps_cpu() skips them,
+	 * and steering picks them up again when they are hotplugged back.
+	 */
 	i = 0;
-	for_each_cpu_and(cpu, mask, cpu_online_mask)
+	for_each_cpu_and(cpu, mask, cpu_possible_mask)
 		map->cpus[i++] = cpu;
 
 	if (i)
@@ -605,9 +594,48 @@ static ssize_t store_rps_map(struct netdev_rx_queue *queue,
 	if (old_map)
 		call_rcu(&old_map->rcu, rps_map_release);
 
+	return 0;
+}
+
+static ssize_t store_rps_map(struct netdev_rx_queue *queue,
+		      struct rx_queue_attribute *attribute,
+		      const char *buf, size_t len)
+{
+	cpumask_var_t mask;
+	int err;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	err = bitmap_parse(buf, len, cpumask_bits(mask), nr_cpumask_bits);
+	if (!err)
+		err = rps_map_set(queue, mask);
+
 	free_cpumask_var(mask);
-	return len;
+	return err ? err : len;
+}
+
+/**
+ *	netif_set_rps_cpus - set the CPUs that receive queue work is steered to
+ *	@dev: network device
+ *	@rxq: index of the receive queue
+ *	@mask: CPUs to spread received flows over, empty to turn steering off
+ *
+ *	Lets a driver pick a default for rx/N/rps_cpus, which user space can
+ *	still override through sysfs.
+ */
+int netif_set_rps_cpus(struct net_device *dev, unsigned int rxq,
+		       const struct cpumask *mask)
+{
+	if (rxq >= dev->num_rx_queues)
+		return -EINVAL;
+
+	return rps_map_set(&dev->_rx[rxq], mask);
 }
+EXPORT_SYMBOL(netif_set_rps_cpus);
 
 static ssize_t show_rps_dev_flow_table_cnt(struct netdev_rx_queue *queue,
 					   struct rx_queue_attribute *attr,
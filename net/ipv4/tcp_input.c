@@ -66,6 +66,7 @@
 #include <linux/module.h>
 #include <linux/sysctl.h>
 #include <linux/kernel.h>
+#include <linux/inetdevice.h>
 #include <net/dst.h>
 #include <net/tcp.h>
 #include <net/inet_common.h>
@@ -364,6 +365,13 @@ static void tcp_init_buffer_space(struct sock *sk)
 
 	tp->rcvq_space.space = tp->rcv_wnd;
 
+	/* Autotuning waits for one receiver RTT sample before it grows the
+	 * buffer.  Start from the handshake/route RTT instead so a slow
+	 * link does not spend its first round trips at the initial window.
+	 */
+	if (!tp->rcv_rtt_est.rtt && tp->srtt)
+		tp->rcv_rtt_est.rtt = tp->srtt;
+
 	maxwin = tcp_full_space(sk);
 
 	if (tp->window_clamp >= maxwin) {
@@ -870,15 +878,35 @@ static void tcp_dsack_seen(struct tcp_sock *tp)
 
 /* Initialize metrics on socket. */
 
+#define TCP_DELACK_SEGS_MAX	8
+
+/* ACK frequency of the route's device, see tcp_delack_thresh() */
+static u8 tcp_dst_delack_segs(const struct dst_entry *dst)
+{
+	struct in_device *in_dev;
+	int segs = 1;
+
+	rcu_read_lock();
+	in_dev = __in_dev_get_rcu(dst->dev);
+	if (in_dev)
+		segs = IN_DEV_CONF_GET(in_dev, TCP_DELACK_SEGS);
+	rcu_read_unlock();
+
+	return clamp(segs, 1, TCP_DELACK_SEGS_MAX);
+}
+
 static void tcp_init_metrics(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 	struct dst_entry *dst = __sk_dst_get(sk);
 
+	tp->delack_segs = 1;
 	if (dst == NULL)
 		goto reset;
 
 	dst_confirm(dst);
+	if (dst->dev)
+		tp->delack_segs = tcp_dst_delack_segs(dst);
 
 	if (dst_metric_locked(dst, RTAX_CWND))
 		tp->snd_cwnd_clamp = dst_metric(dst, RTAX_CWND);
@@ -4927,8 +4955,8 @@ static void __tcp_ack_snd_check(struct sock *sk, int ofo_possible)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 
-	    /* More than one full frame received... */
-	if (((tp->rcv_nxt - tp->rcv_wup) > inet_csk(sk)->icsk_ack.rcv_mss &&
+	    /* More than one full frame (or the device's delack_segs) received... */
+	if (((tp->rcv_nxt - tp->rcv_wup) > tcp_delack_thresh(sk) &&
 	     /* ... and right edge of window advances far enough.
 	      * (tcp_recvmsg() will send ACK otherwise). Or...
 	      */
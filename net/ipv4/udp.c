@@ -105,6 +105,7 @@
 #include <net/route.h>
 #include <net/checksum.h>
 #include <net/xfrm.h>
+#include <linux/uid_stat.h>
 #include "udp_impl.h"
 
 struct udp_table udp_table __read_mostly;
@@ -959,6 +960,8 @@ do_append_data:
 	release_sock(sk);
 
 out:
+	if (!err && rt && len)
+		uid_stat_udp_snd(current_uid(), sk, rt->dst.dev->ifindex, len);
 	ip_rt_put(rt);
 	if (free)
 		kfree(ipc.opt);
@@ -1176,6 +1179,8 @@ try_again:
 	if (!peeked)
 		UDP_INC_STATS_USER(sock_net(sk),
 				UDP_MIB_INDATAGRAMS, is_udplite);
+	if (!(flags & MSG_PEEK))
+		uid_stat_udp_rcv(current_uid(), sk, skb->skb_iif, len);
 
 	sock_recv_ts_and_drops(msg, sk, skb);
 
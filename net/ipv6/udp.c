@@ -48,6 +48,7 @@
 
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/uid_stat.h>
 #include "udp_impl.h"
 
 int ipv6_rcv_saddr_equal(const struct sock *sk, const struct sock *sk2)
@@ -392,6 +393,8 @@ try_again:
 			UDP6_INC_STATS_USER(sock_net(sk),
 					UDP_MIB_INDATAGRAMS, is_udplite);
 	}
+	if (!(flags & MSG_PEEK))
+		uid_stat_udp_rcv(current_uid(), sk, skb->skb_iif, len);
 
 	sock_recv_ts_and_drops(msg, sk, skb);
 
@@ -1178,6 +1181,9 @@ do_append_data:
 		up->pending = 0;
 
 	if (dst) {
+		if (!err && len)
+			uid_stat_udp_snd(current_uid(), sk, dst->dev->ifindex,
+					 len);
 		if (connected) {
 			ip6_dst_store(sk, dst,
 				      ipv6_addr_equal(&fl.fl6_dst, &np->daddr) ?
@@ -1392,6 +1392,56 @@ static int unix_scm_to_skb(struct scm_cookie *scm, struct sk_buff *skb, bool sen
 	return err;
 }
 
+/*
+ *	Readers only sleep on an empty receive queue, so the peer needs a
+ *	wakeup only when this skb makes it non-empty.  The check and the
+ *	enqueue share the queue lock because datagram readers dequeue
+ *	without the state lock.
+ */
+static bool unix_queue_skb(struct sock *other, struct sk_buff *skb)
+{
+	struct sk_buff_head *queue = &other->sk_receive_queue;
+	bool was_empty;
+
+	spin_lock(&queue->lock);
+	was_empty = skb_queue_empty(queue);
+	__skb_queue_tail(queue, skb);
+	spin_unlock(&queue->lock);
+
+	return was_empty;
+}
+
+/*
+ *	Small stream writes without fds are glued onto the last skb queued
+ *	on the peer when it came from the same writer and still has room,
+ *	so a burst of small messages costs one skb and one wakeup.  The
+ *	reader never merges data across pid/cred changes or past an fd,
+ *	and it only modifies an skb after dequeueing it.  Called with the
+ *	peer's state lock held.
+ */
+#define UNIX_STREAM_SMALL	256
+
+static bool unix_stream_append(struct sock *sk, struct sock *other,
+			       struct scm_cookie *scm, const void *data,
+			       int size)
+{
+	struct sk_buff_head *queue = &other->sk_receive_queue;
+	struct sk_buff *tail;
+	bool appended = false;
+
+	spin_lock(&queue->lock);
+	tail = skb_peek_tail(queue);
+	if (tail && tail->sk == sk && !UNIXCB(tail).fp &&
+	    UNIXCB(tail).pid == scm->pid && UNIXCB(tail).cred == scm->cred &&
+	    skb_tailroom(tail) >= size) {
+		memcpy(skb_put(tail, size), data, size);
+		appended = true;
+	}
+	spin_unlock(&queue->lock);
+
+	return appended;
+}
+
 /*
  *	Send AF_UNIX data.
  */
@@ -1412,6 +1462,7 @@ static int unix_dgram_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	long timeo;
 	struct scm_cookie tmp_scm;
 	int max_level;
+	bool wake;
 
 	if (NULL == siocb->scm)
 		siocb->scm = &tmp_scm;
@@ -1531,11 +1582,17 @@ restart:
 		goto restart;
 	}
 
-	skb_queue_tail(&other->sk_receive_queue, skb);
+	if (sk->sk_type == SOCK_SEQPACKET) {
+		wake = unix_queue_skb(other, skb);
+	} else {
+		skb_queue_tail(&other->sk_receive_queue, skb);
+		wake = true;
+	}
 	if (max_level > unix_sk(other)->recursion_level)
 		unix_sk(other)->recursion_level = max_level;
 	unix_state_unlock(other);
-	other->sk_data_ready(other, len);
+	if (wake)
+		other->sk_data_ready(other, len);
 	sock_put(other);
 	scm_destroy(siocb->scm);
 	return len;
@@ -1565,6 +1622,8 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	struct scm_cookie tmp_scm;
 	bool fds_sent = false;
 	int max_level;
+	u8 small_buf[UNIX_STREAM_SMALL];
+	bool small, wake;
 
 	if (NULL == siocb->scm)
 		siocb->scm = &tmp_scm;
@@ -1607,11 +1666,39 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 			size = SKB_MAX_ALLOC;
 
 		/*
-		 *	Grab a buffer
+		 *	Small fd-less writes are copied in up front so they can
+		 *	be appended to the peer's last skb under its lock.  An
+		 *	empty queue has nothing to append to, skip the lock.
+		 */
+		small = size <= UNIX_STREAM_SMALL && !siocb->scm->fp;
+		if (small) {
+			err = memcpy_fromiovec(small_buf, msg->msg_iov, size);
+			if (err)
+				goto out_err;
+
+			if (!skb_queue_empty(&other->sk_receive_queue)) {
+				skb = NULL;
+				unix_state_lock(other);
+				if (sock_flag(other, SOCK_DEAD) ||
+				    (other->sk_shutdown & RCV_SHUTDOWN))
+					goto pipe_err_free;
+				if (unix_stream_append(sk, other, siocb->scm,
+						       small_buf, size)) {
+					unix_state_unlock(other);
+					sent += size;
+					continue;
+				}
+				unix_state_unlock(other);
+			}
+		}
+
+		/*
+		 *	Grab a buffer.  Small ones get room for a few more
+		 *	writes to be appended.
 		 */
 
-		skb = sock_alloc_send_skb(sk, size, msg->msg_flags&MSG_DONTWAIT,
-					  &err);
+		skb = sock_alloc_send_skb(sk, small ? UNIX_STREAM_SMALL : size,
+					  msg->msg_flags&MSG_DONTWAIT, &err);
 
 		if (skb == NULL)
 			goto out_err;
@@ -1635,10 +1722,15 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		max_level = err + 1;
 		fds_sent = true;
 
-		err = memcpy_fromiovec(skb_put(skb, size), msg->msg_iov, size);
-		if (err) {
-			kfree_skb(skb);
-			goto out_err;
+		if (small) {
+			memcpy(skb_put(skb, size), small_buf, size);
+		} else {
+			err = memcpy_fromiovec(skb_put(skb, size), msg->msg_iov,
+					       size);
+			if (err) {
+				kfree_skb(skb);
+				goto out_err;
+			}
 		}
 
 		unix_state_lock(other);
@@ -1647,11 +1739,12 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		    (other->sk_shutdown & RCV_SHUTDOWN))
 			goto pipe_err_free;
 
-		skb_queue_tail(&other->sk_receive_queue, skb);
+		wake = unix_queue_skb(other, skb);
 		if (max_level > unix_sk(other)->recursion_level)
 			unix_sk(other)->recursion_level = max_level;
 		unix_state_unlock(other);
-		other->sk_data_ready(other, size);
+		if (wake)
+			other->sk_data_ready(other, size);
 		sent += size;
 	}
 
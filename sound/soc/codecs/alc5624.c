@@ -555,7 +555,10 @@ struct alc5624_priv {
 	/* original R/W functions */
 	unsigned int (*bus_hw_read)(struct snd_soc_codec *codec, unsigned int reg);
 	int (*bus_hw_write)(void*,const char*, int);  /* codec->control_data(->struct i2c_client), pdata, datalen */
+	int (*bus_hw_write_batch)(void*,const char*, int, int); /* same, num records of datalen bytes */
 	void *bus_control_data;			/* bus control_data to use when calling the original bus fns */
+	
+	u16 reg_def[REGISTER_COUNT];	/* register values after reset */
 };
 
 
@@ -1570,35 +1573,76 @@ static int alc5624_hw_write(void* control_data,const char* data_in_s,int len)
 }
 
 
-/* Sync reg_cache with the hardware - But skip the RESET address */
-static void alc5624_sync_cache(struct snd_soc_codec *codec)
-{
-	/*struct alc5624_priv *alc5624 = snd_soc_codec_get_drvdata(codec);*/
 #if LINUX_VERSION_CODE == KERNEL_VERSION(2,6,36)
-	int i, step = 2, size = REGISTER_COUNT;
-#else
-	int i, step = codec->driver->reg_cache_step, size = codec->driver->reg_cache_size;
+/* write a batch of num alc5624 register writes of len bytes each */
+static int alc5624_hw_write_batch(void* control_data,const char* data_in_s,int len,int num)
+{
+	struct alc5624_priv *alc5624 = control_data;
+	u8 data[SND_SOC_CACHE_BATCH_MAX * 3];
+	int i, n = 0, ret;
+	
+	if (!alc5624->bus_hw_write_batch) {
+		for (i = 0; i < num; i++)
+			if (alc5624_hw_write(control_data, data_in_s + i * len, len) < 0)
+				return -EIO;
+		return num;
+	}
+	
+	for (i = 0; i < num; i++) {
+		const u8* data_in = (const u8*)data_in_s + i * len;
+		
+		/* Indexed registers take two writes: make room for both */
+		if (n + 6 > sizeof(data)) {
+			ret = alc5624->bus_hw_write_batch(alc5624->bus_control_data,data,3,n / 3);
+			if (ret != n / 3)
+				return -EIO;
+			n = 0;
+		}
+		
+		/* Real registers are passed as they are */
+		if (data_in[0] <= ALC5624_VENDOR_ID2) {
+			memcpy(&data[n], data_in, 3);
+			n += 3;
+			continue;
+		}
+		
+		/* Virtual mixers have no hw register */
+		if (data_in[0] == VIRTUAL_HPL_MIXER ||
+			data_in[0] == VIRTUAL_HPR_MIXER)
+			continue;
+		
+		if (data_in[0] < VIRTUAL_IDX_BASE ||
+			data_in[0] >= REGISTER_COUNT)
+			return -EIO;
+		
+		/* Indexed register: select it, then set its value */
+		data[n++] = ALC5624_INDEX_ADDRESS;
+		data[n++] = 0; /* hi */
+		data[n++] = data_in[0]-VIRTUAL_IDX_BASE; /* lo */
+		data[n++] = ALC5624_INDEX_DATA;
+		data[n++] = data_in[1];
+		data[n++] = data_in[2];
+	}
+	
+	if (n) {
+		ret = alc5624->bus_hw_write_batch(alc5624->bus_control_data,data,3,n / 3);
+		if (ret != n / 3)
+			return -EIO;
+	}
+	return num;
+}
 #endif
-	u16 *cache = codec->reg_cache;
-	u8 data[3];
 
+
+/* Sync reg_cache with the hardware after a reset. Only the registers
+   that differ from their reset value are written, as one batch */
+static void alc5624_sync_cache(struct snd_soc_codec *codec)
+{
 	/* Already synchronized, no need to resync again */
 	if (!codec->cache_sync)
 		return;
 
-	codec->cache_only = 0;
-
-	/* Sync back cached values if they're different from the
-	 * hardware default.
-	 */
-	for (i = 2 ; i < size ; i += step) {
-		data[0] = i;
-		data[1] = cache[i] >> 8;
-		data[2] = cache[i];
-		alc5624_hw_write(codec->control_data, data, 3);
-	}
-
-	codec->cache_sync = 0;
+	snd_soc_cache_sync(codec);
 };
 
 /* Reset the codec */
@@ -1922,11 +1966,17 @@ static int alc5624_probe(struct snd_soc_codec *codec)
 	/* Get the original hw R/W functions */
 	alc5624->bus_hw_read = codec->hw_read;
 	alc5624->bus_hw_write = codec->hw_write;
+#if LINUX_VERSION_CODE == KERNEL_VERSION(2,6,36)
+	alc5624->bus_hw_write_batch = codec->hw_write_batch;
+#endif
 	alc5624->bus_control_data = codec->control_data;
 	
 	/* And install our own functions to be able to provide virtual registers */
 	codec->hw_read = alc5624_hw_read;
 	codec->hw_write = alc5624_hw_write;
+#if LINUX_VERSION_CODE == KERNEL_VERSION(2,6,36)
+	codec->hw_write_batch = alc5624_hw_write_batch;
+#endif
 	codec->control_data = alc5624;
 	
 	/* Enable the codec MCLK ... Otherwise, we can't read or write registers */
@@ -1938,11 +1988,23 @@ static int alc5624_probe(struct snd_soc_codec *codec)
 
 	/* Fill cache with the default register values after reset*/
 	alc5624_fill_cache(codec);
+	
+	/* And keep them, so resyncs only write what differs from them */
+	memcpy(alc5624->reg_def, codec->reg_cache, sizeof(alc5624->reg_def));
+#if LINUX_VERSION_CODE == KERNEL_VERSION(2,6,36)
+	codec->reg_def_copy = alc5624->reg_def;
+#endif
 
 	/* Modify the default values to properly config the CODEC */
+#if LINUX_VERSION_CODE == KERNEL_VERSION(2,6,36)
+	snd_soc_cache_batch_begin(codec);
+#endif
 	for (i = 0; i < ARRAY_SIZE(alc5624_reg_default); i++) {
 		snd_soc_write(codec,alc5624_reg_default[i].reg,alc5624_reg_default[i].val);
 	}
+#if LINUX_VERSION_CODE == KERNEL_VERSION(2,6,36)
+	snd_soc_cache_batch_end(codec);
+#endif
 	
 	/* Configure amplifier bias voltages based on voltage supplies */
 	spkbias = alc5624->spkvdd_mv >> 1;
@@ -2139,6 +2201,7 @@ static __devinit int alc5624_i2c_probe(struct i2c_client *client,
 	codec->dai = &alc5624_dai;
 	codec->num_dai = 1;
 	codec->reg_cache_size = REGISTER_COUNT;
+	codec->reg_cache_step = 2;
 	codec->reg_cache = &alc5624->reg_cache[0];
 	codec->volatile_register = alc5624_volatile_register;	
 	codec->cache_sync = 1;
@@ -1899,19 +1899,27 @@ static int wm8903_resume(struct platform_device *pdev)
 	u16 *tmp_cache = kmemdup(reg_cache, sizeof(wm8903_reg_defaults),
 				 GFP_KERNEL);
 
-	/* Sync back everything else */
+	/* The CODEC may have lost power, start again from the defaults */
+	wm8903_reset(codec);
+
+	/* Bring the codec back up to standby first to minimise pop/clicks */
+	wm8903_set_bias_level(codec, SND_SOC_BIAS_STANDBY);
+
+	/* Sync back the registers that differ from their defaults in one
+	 * batch, leaving those the start up sequence has just configured.
+	 */
 	if (tmp_cache) {
+		snd_soc_cache_batch_begin(codec);
 		for (i = 2; i < ARRAY_SIZE(wm8903_reg_defaults); i++)
-			if (tmp_cache[i] != reg_cache[i])
+			if (tmp_cache[i] != wm8903_reg_defaults[i] &&
+			    reg_cache[i] == wm8903_reg_defaults[i])
 				snd_soc_write(codec, i, tmp_cache[i]);
+		snd_soc_cache_batch_end(codec);
 		kfree(tmp_cache);
 	} else {
 		dev_err(&i2c->dev, "Failed to allocate temporary cache\n");
 	}
 
-	/* Bring the codec back up to standby first to minimise pop/clicks */
-	wm8903_set_bias_level(codec, SND_SOC_BIAS_STANDBY);
-
 	return 0;
 }
 
@@ -2023,6 +2031,7 @@ static __devinit int wm8903_i2c_probe(struct i2c_client *i2c,
 	wm8903_set_bias_level(codec, SND_SOC_BIAS_STANDBY);
 
 	/* Latch volume update bits */
+	snd_soc_cache_batch_begin(codec);
 	val = snd_soc_read(codec, WM8903_ADC_DIGITAL_VOLUME_LEFT);
 	val |= WM8903_ADCVU;
 	snd_soc_write(codec, WM8903_ADC_DIGITAL_VOLUME_LEFT, val);
@@ -2052,6 +2061,7 @@ static __devinit int wm8903_i2c_probe(struct i2c_client *i2c,
 	val = snd_soc_read(codec, WM8903_DAC_DIGITAL_1);
 	val |= WM8903_DAC_MUTEMODE;
 	snd_soc_write(codec, WM8903_DAC_DIGITAL_1, val);
+	snd_soc_cache_batch_end(codec);
 
 	wm8903_dai.dev = &i2c->dev;
 	wm8903_codec = codec;
@@ -193,25 +193,57 @@ static unsigned int snd_soc_8_8_read(struct snd_soc_codec *codec,
 	return cache[reg];
 }
 
+/*
+ * Queue a register write for the next batch flush.  Writes are never
+ * merged: staged power sequences write the same register several times
+ * and the hardware has to see every step.
+ */
+static int snd_soc_cache_batch_queue(struct snd_soc_codec *codec,
+				     unsigned int reg, unsigned int value)
+{
+	int ret;
+
+	if (codec->batch_count == SND_SOC_CACHE_BATCH_MAX) {
+		ret = snd_soc_cache_batch_flush(codec);
+		if (ret < 0)
+			return ret;
+	}
+
+	codec->batch_reg[codec->batch_count] = reg;
+	codec->batch_val[codec->batch_count] = value;
+	codec->batch_count++;
+	return 0;
+}
+
 static int snd_soc_8_16_write(struct snd_soc_codec *codec, unsigned int reg,
 			      unsigned int value)
 {
 	u16 *reg_cache = codec->reg_cache;
 	u8 data[3];
+	int cached = 0;
 
 	data[0] = reg;
 	data[1] = (value >> 8) & 0xff;
 	data[2] = value & 0xff;
 
 	if (!snd_soc_codec_volatile_register(codec, reg)
-		&& reg < codec->reg_cache_size)
+		&& reg < codec->reg_cache_size) {
 			reg_cache[reg] = value;
+			cached = 1;
+	}
 
 	if (codec->cache_only) {
 		codec->cache_sync = 1;
 		return 0;
 	}
 
+	if (codec->batch_depth) {
+		if (cached)
+			return snd_soc_cache_batch_queue(codec, reg, value);
+		if (snd_soc_cache_batch_flush(codec) < 0)
+			return -EIO;
+	}
+
 	dev_dbg(codec->dev, "0x%x = 0x%x\n", reg, value);
 
 	if (codec->hw_write(codec->control_data, data, 3) == 3)
@@ -230,6 +262,8 @@ static unsigned int snd_soc_8_16_read(struct snd_soc_codec *codec,
 		if (codec->cache_only)
 			return -EINVAL;
 
+		/* the value may depend on writes still queued */
+		snd_soc_cache_batch_flush(codec);
 		return codec->hw_read(codec, reg);
 	} else {
 		return cache[reg];
@@ -494,6 +528,32 @@ static int snd_soc_16_16_write(struct snd_soc_codec *codec, unsigned int reg,
 		return -EIO;
 }
 
+#if defined(CONFIG_I2C) || (defined(CONFIG_I2C_MODULE) && defined(MODULE))
+/*
+ * Send num register writes of len bytes each as the messages of a single
+ * I2C transfer, so the whole batch costs one bus arbitration.
+ */
+static int snd_soc_i2c_write_batch(void *control_data, const char *data,
+				   int len, int num)
+{
+	struct i2c_client *client = control_data;
+	struct i2c_msg msgs[SND_SOC_CACHE_BATCH_MAX];
+	int i;
+
+	if (num > SND_SOC_CACHE_BATCH_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < num; i++) {
+		msgs[i].addr = client->addr;
+		msgs[i].flags = client->flags & I2C_M_TEN;
+		msgs[i].len = len;
+		msgs[i].buf = (u8 *)data + i * len;
+	}
+
+	return i2c_transfer(client->adapter, msgs, num);
+}
+#endif
+
 static struct {
 	int addr_bits;
 	int data_bits;
@@ -582,6 +642,7 @@ int snd_soc_codec_set_cache_io(struct snd_soc_codec *codec,
 	case SND_SOC_I2C:
 #if defined(CONFIG_I2C) || (defined(CONFIG_I2C_MODULE) && defined(MODULE))
 		codec->hw_write = (hw_write_t)i2c_master_send;
+		codec->hw_write_batch = snd_soc_i2c_write_batch;
 #endif
 		if (io_types[i].i2c_read)
 			codec->hw_read = io_types[i].i2c_read;
@@ -596,3 +657,124 @@ int snd_soc_codec_set_cache_io(struct snd_soc_codec *codec,
 	return 0;
 }
 EXPORT_SYMBOL_GPL(snd_soc_codec_set_cache_io);
+
+/**
+ * snd_soc_cache_batch_begin: Start queueing register writes.
+ *
+ * @codec: CODEC to configure.
+ *
+ * Until the matching snd_soc_cache_batch_end() writes to cached registers
+ * update the cache and are queued, then sent to the hardware in bursts in
+ * the order they were made.  Volatile register accesses flush the queue
+ * first.  Anything that waits on the hardware in between (delays, polls
+ * through non volatile registers) must call snd_soc_cache_batch_flush().
+ *
+ * Batches nest and are currently only supported by the 8 bit address,
+ * 16 bit data I/O functions; other formats write through.
+ */
+void snd_soc_cache_batch_begin(struct snd_soc_codec *codec)
+{
+	codec->batch_depth++;
+}
+EXPORT_SYMBOL_GPL(snd_soc_cache_batch_begin);
+
+/**
+ * snd_soc_cache_batch_flush: Send the queued register writes.
+ *
+ * @codec: CODEC to flush.
+ */
+int snd_soc_cache_batch_flush(struct snd_soc_codec *codec)
+{
+	u8 data[SND_SOC_CACHE_BATCH_MAX * 3];
+	int num = codec->batch_count;
+	int i, ret;
+
+	if (num == 0)
+		return 0;
+	codec->batch_count = 0;
+
+	for (i = 0; i < num; i++) {
+		unsigned int value = codec->batch_val[i];
+
+		data[i * 3] = codec->batch_reg[i];
+		data[i * 3 + 1] = (value >> 8) & 0xff;
+		data[i * 3 + 2] = value & 0xff;
+		dev_dbg(codec->dev, "0x%x = 0x%x (batched)\n",
+			codec->batch_reg[i], value);
+	}
+
+	if (codec->hw_write_batch) {
+		ret = codec->hw_write_batch(codec->control_data, data, 3, num);
+		return ret == num ? 0 : -EIO;
+	}
+
+	for (i = 0; i < num; i++)
+		if (codec->hw_write(codec->control_data, data + i * 3, 3) != 3)
+			return -EIO;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(snd_soc_cache_batch_flush);
+
+/**
+ * snd_soc_cache_batch_end: Stop queueing register writes.
+ *
+ * @codec: CODEC to configure.
+ *
+ * The queued writes are flushed when the outermost batch ends.
+ */
+int snd_soc_cache_batch_end(struct snd_soc_codec *codec)
+{
+	if (WARN_ON(codec->batch_depth == 0))
+		return 0;
+
+	if (--codec->batch_depth)
+		return 0;
+
+	return snd_soc_cache_batch_flush(codec);
+}
+EXPORT_SYMBOL_GPL(snd_soc_cache_batch_end);
+
+/**
+ * snd_soc_cache_sync: Write the register cache back to the hardware.
+ *
+ * @codec: CODEC to sync.
+ *
+ * Meant to be called once the CODEC has been reset, for instance after
+ * it lost power over suspend.  Only the registers whose cached value
+ * differs from reg_def_copy, the register values after a reset, are
+ * written, in one batch.  Without reg_def_copy every non volatile
+ * register is written.  Only 16 bit register caches are supported.
+ */
+int snd_soc_cache_sync(struct snd_soc_codec *codec)
+{
+	const u16 *def = codec->reg_def_copy;
+	u16 *cache = codec->reg_cache;
+	int step = codec->reg_cache_step ? codec->reg_cache_step : 1;
+	int i, ret;
+
+	if (!codec->cache_sync)
+		return 0;
+
+	codec->cache_only = 0;
+
+	snd_soc_cache_batch_begin(codec);
+	for (i = 0; i < codec->reg_cache_size; i += step) {
+		if (snd_soc_codec_volatile_register(codec, i))
+			continue;
+		if (def && def[i] == cache[i])
+			continue;
+
+		ret = snd_soc_write(codec, i, cache[i]);
+		if (ret < 0) {
+			snd_soc_cache_batch_end(codec);
+			return ret;
+		}
+	}
+	ret = snd_soc_cache_batch_end(codec);
+	if (ret == 0)
+		codec->cache_sync = 0;
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(snd_soc_cache_sync);
@@ -569,6 +569,15 @@ int dapm_reg_event(struct snd_soc_dapm_widget *w,
 }
 EXPORT_SYMBOL_GPL(dapm_reg_event);
 
+/* Run a widget event.  Events may wait on or poll the hardware so any
+ * register writes still queued for the sequence are sent first.
+ */
+static int dapm_widget_event(struct snd_soc_dapm_widget *w, int event)
+{
+	snd_soc_cache_batch_flush(w->codec);
+	return w->event(w, NULL, event);
+}
+
 /* Standard power change method, used to apply power changes to most
  * widgets.
  */
@@ -585,7 +594,7 @@ static int dapm_generic_apply_power(struct snd_soc_dapm_widget *w)
 	/* power up pre event */
 	if (w->power && w->event &&
 	    (w->event_flags & SND_SOC_DAPM_PRE_PMU)) {
-		ret = w->event(w, NULL, SND_SOC_DAPM_PRE_PMU);
+		ret = dapm_widget_event(w, SND_SOC_DAPM_PRE_PMU);
 		if (ret < 0)
 			return ret;
 	}
@@ -593,7 +602,7 @@ static int dapm_generic_apply_power(struct snd_soc_dapm_widget *w)
 	/* power down pre event */
 	if (!w->power && w->event &&
 	    (w->event_flags & SND_SOC_DAPM_PRE_PMD)) {
-		ret = w->event(w, NULL, SND_SOC_DAPM_PRE_PMD);
+		ret = dapm_widget_event(w, SND_SOC_DAPM_PRE_PMD);
 		if (ret < 0)
 			return ret;
 	}
@@ -603,8 +612,7 @@ static int dapm_generic_apply_power(struct snd_soc_dapm_widget *w)
 	/* power up post event */
 	if (w->power && w->event &&
 	    (w->event_flags & SND_SOC_DAPM_POST_PMU)) {
-		ret = w->event(w,
-			       NULL, SND_SOC_DAPM_POST_PMU);
+		ret = dapm_widget_event(w, SND_SOC_DAPM_POST_PMU);
 		if (ret < 0)
 			return ret;
 	}
@@ -612,7 +620,7 @@ static int dapm_generic_apply_power(struct snd_soc_dapm_widget *w)
 	/* power down post event */
 	if (!w->power && w->event &&
 	    (w->event_flags & SND_SOC_DAPM_POST_PMD)) {
-		ret = w->event(w, NULL, SND_SOC_DAPM_POST_PMD);
+		ret = dapm_widget_event(w, SND_SOC_DAPM_POST_PMD);
 		if (ret < 0)
 			return ret;
 	}
@@ -750,7 +758,7 @@ static void dapm_seq_run_coalesced(struct snd_soc_codec *codec,
 		    (w->event_flags & SND_SOC_DAPM_PRE_PMU)) {
 			pop_dbg(codec->pop_time, "pop test : %s PRE_PMU\n",
 				w->name);
-			ret = w->event(w, NULL, SND_SOC_DAPM_PRE_PMU);
+			ret = dapm_widget_event(w, SND_SOC_DAPM_PRE_PMU);
 			if (ret < 0)
 				pr_err("%s: pre event failed: %d\n",
 				       w->name, ret);
@@ -761,7 +769,7 @@ static void dapm_seq_run_coalesced(struct snd_soc_codec *codec,
 		    (w->event_flags & SND_SOC_DAPM_PRE_PMD)) {
 			pop_dbg(codec->pop_time, "pop test : %s PRE_PMD\n",
 				w->name);
-			ret = w->event(w, NULL, SND_SOC_DAPM_PRE_PMD);
+			ret = dapm_widget_event(w, SND_SOC_DAPM_PRE_PMD);
 			if (ret < 0)
 				pr_err("%s: pre event failed: %d\n",
 				       w->name, ret);
@@ -782,8 +790,7 @@ static void dapm_seq_run_coalesced(struct snd_soc_codec *codec,
 		    (w->event_flags & SND_SOC_DAPM_POST_PMU)) {
 			pop_dbg(codec->pop_time, "pop test : %s POST_PMU\n",
 				w->name);
-			ret = w->event(w,
-				       NULL, SND_SOC_DAPM_POST_PMU);
+			ret = dapm_widget_event(w, SND_SOC_DAPM_POST_PMU);
 			if (ret < 0)
 				pr_err("%s: post event failed: %d\n",
 				       w->name, ret);
@@ -794,7 +801,7 @@ static void dapm_seq_run_coalesced(struct snd_soc_codec *codec,
 		    (w->event_flags & SND_SOC_DAPM_POST_PMD)) {
 			pop_dbg(codec->pop_time, "pop test : %s POST_PMD\n",
 				w->name);
-			ret = w->event(w, NULL, SND_SOC_DAPM_POST_PMD);
+			ret = dapm_widget_event(w, SND_SOC_DAPM_POST_PMD);
 			if (ret < 0)
 				pr_err("%s: post event failed: %d\n",
 				       w->name, ret);
@@ -839,11 +846,11 @@ static void dapm_seq_run(struct snd_soc_codec *codec, struct list_head *list,
 								  power_list);
 
 			if (event == SND_SOC_DAPM_STREAM_START)
-				ret = w->event(w,
-					       NULL, SND_SOC_DAPM_PRE_PMU);
+				ret = dapm_widget_event(w,
+							SND_SOC_DAPM_PRE_PMU);
 			else if (event == SND_SOC_DAPM_STREAM_STOP)
-				ret = w->event(w,
-					       NULL, SND_SOC_DAPM_PRE_PMD);
+				ret = dapm_widget_event(w,
+							SND_SOC_DAPM_PRE_PMD);
 			break;
 
 		case snd_soc_dapm_post:
@@ -852,11 +859,11 @@ static void dapm_seq_run(struct snd_soc_codec *codec, struct list_head *list,
 								  power_list);
 
 			if (event == SND_SOC_DAPM_STREAM_START)
-				ret = w->event(w,
-					       NULL, SND_SOC_DAPM_POST_PMU);
+				ret = dapm_widget_event(w,
+							SND_SOC_DAPM_POST_PMU);
 			else if (event == SND_SOC_DAPM_STREAM_STOP)
-				ret = w->event(w,
-					       NULL, SND_SOC_DAPM_POST_PMD);
+				ret = dapm_widget_event(w,
+							SND_SOC_DAPM_POST_PMD);
 			break;
 
 		case snd_soc_dapm_input:
@@ -904,6 +911,7 @@ static int dapm_power_widgets(struct snd_soc_codec *codec, int event)
 	int ret = 0;
 	int power;
 	int sys_power = 0;
+	int batch;
 
 	/* Check which widgets we need to power and store them in
 	 * lists indicating if they should be powered up or down.
@@ -985,12 +993,25 @@ static int dapm_power_widgets(struct snd_soc_codec *codec, int event)
 			pr_err("Failed to prepare bias: %d\n", ret);
 	}
 
+	/* Queue the register writes of the whole transition and send them
+	 * as bursts, unless the writes are being spaced out for pop testing.
+	 */
+	batch = !codec->pop_time;
+	if (batch)
+		snd_soc_cache_batch_begin(codec);
+
 	/* Power down widgets first; try to avoid amplifying pops. */
 	dapm_seq_run(codec, &down_list, event, dapm_down_seq);
 
 	/* Now power up. */
 	dapm_seq_run(codec, &up_list, event, dapm_up_seq);
 
+	if (batch) {
+		ret = snd_soc_cache_batch_end(codec);
+		if (ret != 0)
+			pr_err("Failed to write DAPM sequence: %d\n", ret);
+	}
+
 	/* If we just powered the last thing off drop to standby bias */
 	if (codec->bias_level == SND_SOC_BIAS_PREPARE && !sys_power) {
 		ret = snd_soc_dapm_set_bias_level(socdev,
@@ -23,6 +23,15 @@
 #define PLAYBACK_STARTED true
 #define PLAYBACK_STOPPED false
 
+/*
+ * Number of requests kept queued at the DMA channel.  Each request covers
+ * one period, or a run of periods when period wakeups are disabled.  A deeper
+ * queue gives the completion interrupt more slack before the channel runs dry.
+ */
+static int dma_queue_periods = 4;
+module_param(dma_queue_periods, int, 0644);
+MODULE_PARM_DESC(dma_queue_periods, "DMA requests queued ahead (2-8)");
+
 static void tegra_pcm_play(struct tegra_runtime_data *prtd)
 {
 	struct snd_pcm_substream *substream = prtd->substream;
@@ -30,9 +39,10 @@ static void tegra_pcm_play(struct tegra_runtime_data *prtd)
 	struct snd_dma_buffer *buf = &substream->dma_buffer;
 
 	if (runtime->dma_addr) {
-		prtd->size = frames_to_bytes(runtime, runtime->period_size);
+		prtd->size = frames_to_bytes(runtime, prtd->chunk_size);
 		if (prtd->dma_state != STATE_ABORT) {
-			prtd->dma_reqid_tail = (prtd->dma_reqid_tail + 1) % DMA_REQ_QCOUNT;
+			prtd->dma_reqid_tail = (prtd->dma_reqid_tail + 1) %
+						prtd->dma_req_count;
 			prtd->dma_req[prtd->dma_reqid_tail].source_addr = buf->addr +
 			frames_to_bytes(runtime,prtd->dma_pos);
 			prtd->dma_req[prtd->dma_reqid_tail].size = prtd->size;
@@ -41,7 +51,7 @@ static void tegra_pcm_play(struct tegra_runtime_data *prtd)
 		}
 	}
 
-	prtd->dma_pos += runtime->period_size;
+	prtd->dma_pos += prtd->chunk_size;
 	if (prtd->dma_pos >= runtime->buffer_size) {
 		prtd->dma_pos = 0;
 	}
@@ -55,9 +65,10 @@ static void tegra_pcm_capture(struct tegra_runtime_data *prtd)
 	struct snd_dma_buffer *buf = &substream->dma_buffer;
 
 	if (runtime->dma_addr) {
-		prtd->size = frames_to_bytes(runtime, runtime->period_size);
+		prtd->size = frames_to_bytes(runtime, prtd->chunk_size);
 		if (prtd->dma_state != STATE_ABORT) {
-			prtd->dma_reqid_tail = (prtd->dma_reqid_tail + 1) % DMA_REQ_QCOUNT;
+			prtd->dma_reqid_tail = (prtd->dma_reqid_tail + 1) %
+						prtd->dma_req_count;
 			prtd->dma_req[prtd->dma_reqid_tail].dest_addr = buf->addr +
 			frames_to_bytes(runtime,prtd->dma_pos);
 			prtd->dma_req[prtd->dma_reqid_tail].size = prtd->size;
@@ -66,7 +77,7 @@ static void tegra_pcm_capture(struct tegra_runtime_data *prtd)
 		}
 	}
 
-	prtd->dma_pos += runtime->period_size;
+	prtd->dma_pos += prtd->chunk_size;
 	if (prtd->dma_pos >= runtime->buffer_size) {
 		prtd->dma_pos = 0;
 	}
@@ -79,33 +90,37 @@ static void dma_complete_callback (struct tegra_dma_req *req)
 	struct snd_pcm_substream *substream = prtd->substream;
 	struct snd_pcm_runtime *runtime = substream->runtime;
 
-	if (++prtd->period_index >= runtime->periods) {
+	if (++prtd->period_index >= prtd->chunk_count) {
 		prtd->period_index = 0;
 	}
 
 	if (prtd->dma_state != STATE_ABORT) {
-		prtd->dma_reqid_head = (prtd->dma_reqid_head + 1) % DMA_REQ_QCOUNT;
-		snd_pcm_period_elapsed(substream);
+		prtd->dma_reqid_head = (prtd->dma_reqid_head + 1) %
+					prtd->dma_req_count;
+		/* Refill first so the channel never waits on ALSA */
 		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 			tegra_pcm_play(prtd);
 		} else {
 			tegra_pcm_capture(prtd);
 		}
+		if (!runtime->no_period_wakeup)
+			snd_pcm_period_elapsed(substream);
 	}
 }
 
 static const struct snd_pcm_hardware tegra_pcm_hardware = {
 	.info 	= SNDRV_PCM_INFO_INTERLEAVED | \
 			SNDRV_PCM_INFO_PAUSE | SNDRV_PCM_INFO_RESUME | \
-			SNDRV_PCM_INFO_MMAP | SNDRV_PCM_INFO_MMAP_VALID ,
+			SNDRV_PCM_INFO_MMAP | SNDRV_PCM_INFO_MMAP_VALID | \
+			SNDRV_PCM_INFO_NO_PERIOD_WAKEUP,
 	.formats		= SNDRV_PCM_FMTBIT_S16_LE,
 	.channels_min		= 1,
 	.channels_max		= 2,
-	.buffer_bytes_max	= (PAGE_SIZE * 8),
+	.buffer_bytes_max	= (PAGE_SIZE * 64),
 	.period_bytes_min	= 128,
 	.period_bytes_max	= (PAGE_SIZE),
 	.periods_min		= 2,
-	.periods_max		= 8,
+	.periods_max		= 64,
 	.fifo_size 		= 4,
 };
 
@@ -124,12 +139,33 @@ static int tegra_pcm_hw_free(struct snd_pcm_substream *substream)
 
 static int tegra_pcm_prepare(struct snd_pcm_substream *substream)
 {
-	struct tegra_runtime_data *prtd = substream->runtime->private_data;
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct tegra_runtime_data *prtd = runtime->private_data;
+	unsigned int periods = 1;
+
+	/*
+	 * Without period wakeups nobody needs an interrupt per period, so
+	 * let each request cover as many periods as still leaves the buffer
+	 * split into at least two requests.
+	 */
+	if (runtime->no_period_wakeup) {
+		while ((runtime->periods % (periods * 2)) == 0 &&
+		       runtime->periods / (periods * 2) >= 2 &&
+		       frames_to_bytes(runtime, runtime->period_size *
+				periods * 2) <= TEGRA_DMA_MAX_TRANSFER_SIZE)
+			periods *= 2;
+	}
+	prtd->chunk_size = runtime->period_size * periods;
+	prtd->chunk_count = runtime->periods / periods;
+
+	prtd->dma_req_count = clamp(dma_queue_periods, 2, DMA_REQ_QCOUNT);
+	if (prtd->dma_req_count > prtd->chunk_count)
+		prtd->dma_req_count = prtd->chunk_count;
 
 	prtd->dma_pos = 0;
 	prtd->period_index = 0;
 	prtd->dma_reqid_head = 0;
-	prtd->dma_reqid_tail = DMA_REQ_QCOUNT - 1;
+	prtd->dma_reqid_tail = prtd->dma_req_count - 1;
 
 	return 0;
 }
@@ -146,13 +182,13 @@ static int tegra_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 			prtd->state = STATE_INIT;
 			prtd->dma_state = STATE_INIT;
-			for (i = 0; i < DMA_REQ_QCOUNT; i++)
+			for (i = 0; i < prtd->dma_req_count; i++)
 				tegra_pcm_play(prtd); /* dma enqueue req */
 		} else if (prtd->state != STATE_INIT) {
 			/* start recording */
 			prtd->state = STATE_INIT;
 			prtd->dma_state = STATE_INIT;
-			for (i = 0; i < DMA_REQ_QCOUNT; i++)
+			for (i = 0; i < prtd->dma_req_count; i++)
 				tegra_pcm_capture(prtd); /* dma enqueue req */
 		}
 		break;
@@ -164,19 +200,19 @@ static int tegra_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 		tegra_dma_cancel(prtd->dma_chan);
 		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 			if (prtd->dma_chan) {
-				for (i = 0; i < DMA_REQ_QCOUNT; i++)
+				for (i = 0; i < prtd->dma_req_count; i++)
 					tegra_dma_dequeue_req(prtd->dma_chan,
 							&prtd->dma_req[i]);
 				prtd->dma_reqid_head = 0;
-				prtd->dma_reqid_tail = DMA_REQ_QCOUNT - 1;
+				prtd->dma_reqid_tail = prtd->dma_req_count - 1;
 			}
 		} else {
 			if (prtd->dma_chan) {
-				for (i = 0; i < DMA_REQ_QCOUNT; i++)
+				for (i = 0; i < prtd->dma_req_count; i++)
 					tegra_dma_dequeue_req(prtd->dma_chan,
 							&prtd->dma_req[i]);
 				prtd->dma_reqid_head = 0;
-				prtd->dma_reqid_tail = DMA_REQ_QCOUNT - 1;
+				prtd->dma_reqid_tail = prtd->dma_req_count - 1;
 			}
 		}
 		break;
@@ -191,14 +227,17 @@ static snd_pcm_uframes_t tegra_pcm_pointer(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct tegra_runtime_data *prtd = runtime->private_data;
-	int size;
+	snd_pcm_uframes_t size;
 
-	size = (prtd->period_index * runtime->period_size) +
+	/* Completed requests plus the live progress of the one in flight */
+	size = (prtd->period_index * prtd->chunk_size) +
 		 bytes_to_frames(runtime,
 				tegra_dma_get_transfer_count(
 					prtd->dma_chan,
 					&prtd->dma_req[prtd->dma_reqid_head],
 					false));
+	if (size >= runtime->buffer_size)
+		size -= runtime->buffer_size;
 	return (size);
 }
 
@@ -257,7 +296,8 @@ static int tegra_pcm_open(struct snd_pcm_substream *substream)
 		}
 	}
 
-	prtd->dma_chan = tegra_dma_allocate_channel(TEGRA_DMA_MODE_CONTINUOUS_DOUBLE);
+	/* One interrupt per request; the next one is already loaded */
+	prtd->dma_chan = tegra_dma_allocate_channel(TEGRA_DMA_MODE_CONTINUOUS_SINGLE);
 	if (IS_ERR(prtd->dma_chan)) {
 		pr_err("%s: could not allocate DMA channel for I2S: %ld\n",
 		       __func__, PTR_ERR(prtd->dma_chan));
@@ -306,7 +346,7 @@ static int tegra_pcm_close(struct snd_pcm_substream *substream)
 		tegra_dma_free_channel(prtd->dma_chan);
 		prtd->dma_chan = NULL;
 		prtd->dma_reqid_head = 0;
-		prtd->dma_reqid_tail = DMA_REQ_QCOUNT - 1;
+		prtd->dma_reqid_tail = 0;
 	}
 	kfree(prtd);
 
@@ -78,7 +78,7 @@
 #define TEGRA_VOICE_SAMPLE_RATES SNDRV_PCM_RATE_8000
 
 #define DMA_STEP_SIZE_MIN 8
-#define DMA_REQ_QCOUNT 2
+#define DMA_REQ_QCOUNT 8
 
 #define TEGRA_AUDIO_OFF		0x0
 #define TEGRA_HEADPHONE		0x1
@@ -99,6 +99,9 @@ struct tegra_runtime_data {
 	struct tegra_dma_req dma_req[DMA_REQ_QCOUNT];
 	int dma_reqid_head;
 	int dma_reqid_tail;
+	int dma_req_count;	/* requests in use, <= DMA_REQ_QCOUNT */
+	snd_pcm_uframes_t chunk_size;	/* frames per request */
+	unsigned int chunk_count;	/* requests per buffer */
 	volatile int state;
 	int period_index;
 	int dma_state;
@@ -52,7 +52,6 @@ static void tegra_audio_route(struct tegra_audio_data* audio_data,
 		if (play_device_new & TEGRA_AUDIO_DEVICE_OUT_HEADSET)
 			codec_con |= TEGRA_HEADSET;
 
-		tegra_ext_control(audio_data->codec, codec_con);
 		audio_data->play_device = play_device_new;
 	}
 
@@ -73,10 +72,13 @@ static void tegra_audio_route(struct tegra_audio_data* audio_data,
 		if (capture_device_new & TEGRA_AUDIO_DEVICE_IN_HEADSET)
 			codec_con |= TEGRA_HEADSET;
 
-		tegra_ext_control(audio_data->codec, codec_con);
 		audio_data->capture_device = capture_device_new;
 	}
 
+	/* Switch playback and capture routes in a single DAPM transition */
+	if (codec_con != audio_data->codec_con)
+		tegra_ext_control(audio_data->codec, codec_con);
+
 	if ((is_call_mode_new != audio_data->is_call_mode) ||
 		(is_bt_sco_mode != was_bt_sco_mode)) {
 		if (is_call_mode_new && is_bt_sco_mode) {
@@ -106,6 +106,8 @@ static int tegra_hifi_hw_params(struct snd_pcm_substream *substream,
 		int SidetoneCtrlReg = 0;
 		int SideToneAtenuation = 0;
 
+		/* Send the whole capture path setup as one burst */
+		snd_soc_cache_batch_begin(codec);
 		snd_soc_write(codec, WM8903_ANALOGUE_LEFT_INPUT_0, 0X7);
 		snd_soc_write(codec, WM8903_ANALOGUE_RIGHT_INPUT_0, 0X7);
 		/* Mic Bias enable */
@@ -155,6 +157,11 @@ static int tegra_hifi_hw_params(struct snd_pcm_substream *substream,
 		CtrlReg = snd_soc_read(codec, R29_DRC_1);
 		CtrlReg |= 0x3; /*mic volume 18 db */
 		snd_soc_write(codec, R29_DRC_1, CtrlReg);
+		err = snd_soc_cache_batch_end(codec);
+		if (err < 0) {
+			pr_err("codec capture path not set\n");
+			return err;
+		}
 	}
 
 	return 0;
@@ -0,0 +1,293 @@
+/*
+ * android-bench - microbenchmarks for binder, ashmem and the logger
+ *
+ * Each case prints one line of the form
+ *
+ *   <case> size=<bytes> threads=<n> ops=<n> avg_us=.. p50_us=.. p90_us=..
+ *          p99_us=.. max_us=.. ops_s=.. MBps=..
+ *
+ * so that runs on two kernels can be compared with a script.  With -H the
+ * counters in debugfs binder/latency and ashmem are read before and after
+ * each case and the difference is printed, which shows where in the driver
+ * the time went.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "android-bench.h"
+
+struct bench_opts opts = {
+	.iters		= 10000,
+	.debugfs	= "/sys/kernel/debug",
+};
+
+uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void lat_init(struct lat *l, size_t max)
+{
+	l->ns = calloc(max ? max : 1, sizeof(*l->ns));
+	if (!l->ns) {
+		perror("calloc");
+		exit(1);
+	}
+	l->cnt = 0;
+	l->max = max;
+	l->start = now_ns();
+}
+
+void lat_add(struct lat *l, uint64_t ns)
+{
+	if (l->cnt < l->max)
+		l->ns[l->cnt++] = ns;
+}
+
+void lat_merge(struct lat *dst, const struct lat *src)
+{
+	size_t i;
+
+	for (i = 0; i < src->cnt; i++)
+		lat_add(dst, src->ns[i]);
+}
+
+void lat_free(struct lat *l)
+{
+	free(l->ns);
+	l->ns = NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+void lat_report(struct lat *l, const char *name, size_t size,
+		unsigned int threads)
+{
+	double wall = (now_ns() - l->start) / 1e9;
+	uint64_t total = 0;
+	size_t i, last;
+
+	if (!l->cnt) {
+		printf("%s size=%zu threads=%u ops=0\n", name, size, threads);
+		return;
+	}
+
+	qsort(l->ns, l->cnt, sizeof(*l->ns), cmp_u64);
+	for (i = 0; i < l->cnt; i++)
+		total += l->ns[i];
+	last = l->cnt - 1;
+
+	printf("%s size=%zu threads=%u ops=%zu avg_us=%.1f p50_us=%.1f "
+	       "p90_us=%.1f p99_us=%.1f max_us=%.1f ops_s=%.0f MBps=%.2f\n",
+	       name, size, threads, l->cnt, total / 1e3 / l->cnt,
+	       l->ns[last * 50 / 100] / 1e3, l->ns[last * 90 / 100] / 1e3,
+	       l->ns[last * 99 / 100] / 1e3, l->ns[last] / 1e3,
+	       l->cnt / wall, (double)size * l->cnt / wall / 1e6);
+	fflush(stdout);
+}
+
+/*
+ * debugfs counters.  Lines of the form "name: <count>" are collected, and
+ * indented lines are prefixed with the last unindented name so that the
+ * histogram buckets of each binder transaction type stay apart.
+ */
+#define HIST_MAX	512
+
+struct hist_entry {
+	char key[384];
+	long val;
+};
+
+static const char *hist_files[] = {
+	"binder/latency",
+	"ashmem",
+};
+
+static struct hist_entry hist_before[HIST_MAX];
+static int hist_before_cnt;
+
+static int hist_read(struct hist_entry *e, int max)
+{
+	char path[256], line[256], section[256] = "";
+	unsigned int f;
+	int n = 0;
+
+	for (f = 0; f < ARRAY_SIZE(hist_files); f++) {
+		FILE *fp;
+
+		snprintf(path, sizeof(path), "%s/%s", opts.debugfs,
+			 hist_files[f]);
+		fp = fopen(path, "r");
+		if (!fp)
+			continue;
+
+		while (fgets(line, sizeof(line), fp) && n < max) {
+			char *colon = strrchr(line, ':');
+			char *p = line;
+			char *end;
+			long val;
+
+			if (!colon)
+				continue;
+			val = strtol(colon + 1, &end, 10);
+			if (end == colon + 1 || (*end && !isspace(*end)))
+				continue;
+			*colon = '\0';
+
+			if (isspace(*p)) {
+				while (isspace(*p))
+					p++;
+			} else {
+				snprintf(section, sizeof(section), "%s", p);
+				p = "total";
+			}
+
+			snprintf(e[n].key, sizeof(e[n].key), "%s:%s:%s",
+				 hist_files[f], section, p);
+			e[n].val = val;
+			n++;
+		}
+		fclose(fp);
+	}
+
+	return n;
+}
+
+void hist_begin(void)
+{
+	if (opts.hist)
+		hist_before_cnt = hist_read(hist_before, HIST_MAX);
+}
+
+void hist_end(const char *name)
+{
+	static struct hist_entry after[HIST_MAX];
+	int i, j, n;
+
+	if (!opts.hist)
+		return;
+
+	n = hist_read(after, HIST_MAX);
+	for (i = 0; i < n; i++) {
+		long delta = after[i].val;
+
+		for (j = 0; j < hist_before_cnt; j++) {
+			if (!strcmp(after[i].key, hist_before[j].key)) {
+				delta -= hist_before[j].val;
+				break;
+			}
+		}
+		if (delta)
+			printf("%s hist %s=%ld\n", name, after[i].key, delta);
+	}
+	fflush(stdout);
+}
+
+int hist_show(void)
+{
+	struct hist_entry e[HIST_MAX];
+	int i, n;
+
+	n = hist_read(e, HIST_MAX);
+	if (!n) {
+		fprintf(stderr, "no counters under %s\n", opts.debugfs);
+		return 1;
+	}
+	for (i = 0; i < n; i++)
+		printf("%s=%ld\n", e[i].key, e[i].val);
+
+	return 0;
+}
+
+static const struct {
+	const char *name;
+	int (*run)(void);
+} cases[] = {
+	{ "binder",	binder_bench },
+	{ "oneway",	binder_oneway_bench },
+	{ "ashmem",	ashmem_bench },
+	{ "logger",	logger_bench },
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options] <case>...\n"
+		"  cases: binder oneway ashmem logger all hist\n"
+		"  -n <ops>     operations per case (default %u)\n"
+		"  -s <bytes>   message size instead of the default list\n"
+		"  -t <n>       threads instead of the default list\n"
+		"  -H           print debugfs counter deltas for each case\n"
+		"  -d <dir>     debugfs mount point (default %s)\n",
+		prog, opts.iters, opts.debugfs);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int c, ret = 0;
+
+	while ((c = getopt(argc, argv, "n:s:t:Hd:")) != -1) {
+		switch (c) {
+		case 'n':
+			opts.iters = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			opts.size = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			opts.threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'H':
+			opts.hist = 1;
+			break;
+		case 'd':
+			opts.debugfs = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind >= argc || !opts.iters)
+		usage(argv[0]);
+
+	for (; optind < argc; optind++) {
+		const char *name = argv[optind];
+		int found = 0;
+
+		if (!strcmp(name, "hist")) {
+			ret |= hist_show();
+			continue;
+		}
+
+		for (i = 0; i < ARRAY_SIZE(cases); i++) {
+			if (strcmp(name, "all") && strcmp(name, cases[i].name))
+				continue;
+			found = 1;
+			ret |= cases[i].run();
+		}
+		if (!found)
+			usage(argv[0]);
+	}
+
+	return ret;
+}
@@ -0,0 +1,52 @@
+/*
+ * Common helpers for the binder, ashmem and logger benchmarks.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#ifndef ANDROID_BENCH_H
+#define ANDROID_BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct bench_opts {
+	unsigned int iters;	/* operations per case */
+	unsigned int threads;	/* 0: use each case's default list */
+	size_t size;		/* 0: use each case's default list */
+	int hist;		/* print debugfs histogram deltas per case */
+	const char *debugfs;	/* debugfs mount point */
+};
+
+extern struct bench_opts opts;
+
+/* latencies of one case, in nanoseconds */
+struct lat {
+	uint64_t *ns;
+	size_t cnt;
+	size_t max;
+	uint64_t start;		/* wall clock at lat_init() */
+};
+
+uint64_t now_ns(void);
+void lat_init(struct lat *l, size_t max);
+void lat_add(struct lat *l, uint64_t ns);
+void lat_merge(struct lat *dst, const struct lat *src);
+void lat_report(struct lat *l, const char *name, size_t size,
+		unsigned int threads);
+void lat_free(struct lat *l);
+
+void hist_begin(void);
+void hist_end(const char *name);
+int hist_show(void);
+
+int binder_bench(void);
+int binder_oneway_bench(void);
+int ashmem_bench(void);
+int logger_bench(void);
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+
+#endif
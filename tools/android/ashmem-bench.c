@@ -0,0 +1,146 @@
+/*
+ * ashmem pin/unpin benchmark.
+ *
+ * Ranges of an ashmem area are unpinned and pinned again while another
+ * thread keeps calling ASHMEM_PURGE_ALL_CACHES, which runs the ashmem
+ * shrinker over every unpinned range in the system.  This is the path
+ * where pin/unpin contend with reclaim.  The purge thread needs
+ * CAP_SYS_ADMIN; without it the case runs without the flood.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/types.h>
+
+#include "../../include/linux/ashmem.h"
+#include "android-bench.h"
+
+#define ASHMEM_RANGES		16
+
+static const size_t ashmem_sizes[] = { 4096, 65536, 1024 * 1024 };
+
+static volatile int purge_stop;
+static unsigned long purge_calls;
+
+static void *ashmem_purge_thread(void *arg)
+{
+	int fd = *(int *)arg;
+
+	while (!purge_stop) {
+		if (ioctl(fd, ASHMEM_PURGE_ALL_CACHES) < 0)
+			break;
+		purge_calls++;
+	}
+
+	return NULL;
+}
+
+static int ashmem_run(size_t size)
+{
+	struct ashmem_pin pin;
+	struct lat lat_pin, lat_unpin;
+	size_t area = size * ASHMEM_RANGES;
+	unsigned long purged = 0;
+	pthread_t purger;
+	int flood, fd;
+	unsigned int i;
+	char *map;
+
+	fd = open("/dev/ashmem", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/ashmem");
+		return 1;
+	}
+	if (ioctl(fd, ASHMEM_SET_NAME, "android-bench") < 0 ||
+	    ioctl(fd, ASHMEM_SET_SIZE, area) < 0) {
+		perror("ashmem setup");
+		close(fd);
+		return 1;
+	}
+	map = mmap(NULL, area, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("ashmem mmap");
+		close(fd);
+		return 1;
+	}
+	memset(map, 0xa5, area);
+
+	purge_stop = 0;
+	purge_calls = 0;
+	flood = ioctl(fd, ASHMEM_PURGE_ALL_CACHES) >= 0;
+	if (flood)
+		pthread_create(&purger, NULL, ashmem_purge_thread, &fd);
+
+	hist_begin();
+	lat_init(&lat_pin, opts.iters);
+	lat_init(&lat_unpin, opts.iters);
+	for (i = 0; i < opts.iters; i++) {
+		uint64_t t;
+		int ret;
+
+		pin.offset = (i % ASHMEM_RANGES) * size;
+		pin.len = size;
+
+		t = now_ns();
+		if (ioctl(fd, ASHMEM_UNPIN, &pin) < 0) {
+			perror("ASHMEM_UNPIN");
+			break;
+		}
+		lat_add(&lat_unpin, now_ns() - t);
+
+		t = now_ns();
+		ret = ioctl(fd, ASHMEM_PIN, &pin);
+		if (ret < 0) {
+			perror("ASHMEM_PIN");
+			break;
+		}
+		lat_add(&lat_pin, now_ns() - t);
+
+		if (ret == ASHMEM_WAS_PURGED) {
+			purged++;
+			memset(map + pin.offset, 0xa5, size);
+		}
+	}
+
+	purge_stop = 1;
+	if (flood)
+		pthread_join(purger, NULL);
+
+	lat_report(&lat_unpin, "ashmem_unpin", size, 1);
+	lat_report(&lat_pin, "ashmem_pin", size, 1);
+	printf("ashmem size=%zu flood=%s purge_calls=%lu purged=%lu\n", size,
+	       flood ? "purge" : "none", purge_calls, purged);
+	hist_end("ashmem");
+
+	lat_free(&lat_pin);
+	lat_free(&lat_unpin);
+	munmap(map, area);
+	close(fd);
+
+	return 0;
+}
+
+int ashmem_bench(void)
+{
+	unsigned int i;
+	int ret = 0;
+
+	if (opts.size)
+		return ashmem_run((opts.size + 4095) & ~4095UL);
+
+	for (i = 0; i < ARRAY_SIZE(ashmem_sizes); i++)
+		ret |= ashmem_run(ashmem_sizes[i]);
+
+	return ret;
+}
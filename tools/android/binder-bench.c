@@ -0,0 +1,545 @@
+/*
+ * Binder round trip and one-way transaction benchmarks.
+ *
+ * A server process is forked that either becomes the context manager or,
+ * when servicemanager already is, registers itself with it.  The client
+ * threads then send transactions of the requested size and time each one
+ * until the reply (or, for one-way calls, the transaction complete) comes
+ * back.  Only the raw driver protocol is used, there is no libbinder.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "binder.h"
+#include "android-bench.h"
+
+#define BINDER_MAP_SIZE		(1024 * 1024)
+#define BINDER_SERVER_THREADS	8
+#define BENCH_SERVICE		"android-bench"
+#define BENCH_CODE		1
+
+/* servicemanager protocol */
+#define SVC_MGR_CHECK_SERVICE	2
+#define SVC_MGR_ADD_SERVICE	3
+#define SVC_MGR_NAME		"android.os.IServiceManager"
+
+static const size_t binder_sizes[] = { 4, 64, 256, 1024, 4096, 16384, 65536 };
+static const unsigned int binder_threads[] = { 1, 2, 4 };
+
+struct binder_conn {
+	int fd;
+	void *map;
+};
+
+/* commands queued for the next BINDER_WRITE_READ of a thread */
+struct binder_out {
+	uint32_t buf[64];
+	size_t len;
+};
+
+static int binder_conn_open(struct binder_conn *c)
+{
+	struct binder_version vers;
+	size_t max_threads = 0;
+
+	c->fd = open("/dev/binder", O_RDWR);
+	if (c->fd < 0) {
+		perror("/dev/binder");
+		return -1;
+	}
+	if (ioctl(c->fd, BINDER_VERSION, &vers) < 0 ||
+	    vers.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder: protocol version mismatch\n");
+		close(c->fd);
+		return -1;
+	}
+	c->map = mmap(NULL, BINDER_MAP_SIZE, PROT_READ,
+		      MAP_PRIVATE | MAP_NORESERVE, c->fd, 0);
+	if (c->map == MAP_FAILED) {
+		perror("binder mmap");
+		close(c->fd);
+		return -1;
+	}
+	ioctl(c->fd, BINDER_SET_MAX_THREADS, &max_threads);
+
+	return 0;
+}
+
+static void binder_conn_close(struct binder_conn *c)
+{
+	munmap(c->map, BINDER_MAP_SIZE);
+	close(c->fd);
+}
+
+static void out_cmd(struct binder_out *o, uint32_t cmd, const void *data,
+		    size_t len)
+{
+	memcpy((char *)o->buf + o->len, &cmd, sizeof(cmd));
+	o->len += sizeof(cmd);
+	if (len)
+		memcpy((char *)o->buf + o->len, data, len);
+	o->len += len;
+}
+
+static void out_free(struct binder_out *o, const void *buffer)
+{
+	out_cmd(o, BC_FREE_BUFFER, &buffer, sizeof(buffer));
+}
+
+/* write everything queued in o and read into rbuf */
+static int binder_io(struct binder_conn *c, struct binder_out *o,
+		     void *rbuf, size_t rlen, size_t *consumed)
+{
+	struct binder_write_read bwr;
+
+	bwr.write_size = o->len;
+	bwr.write_consumed = 0;
+	bwr.write_buffer = (unsigned long)o->buf;
+	bwr.read_size = rlen;
+	bwr.read_consumed = 0;
+	bwr.read_buffer = (unsigned long)rbuf;
+
+	for (;;) {
+		if (ioctl(c->fd, BINDER_WRITE_READ, &bwr) >= 0)
+			break;
+		if (errno != EINTR) {
+			perror("BINDER_WRITE_READ");
+			return -1;
+		}
+	}
+	o->len = 0;
+	if (consumed)
+		*consumed = bwr.read_consumed;
+
+	return 0;
+}
+
+/*
+ * Send one transaction and wait for its reply, or only for the transaction
+ * complete if it is one-way.  A reply is copied to *reply and its buffer
+ * has to be freed by the caller, otherwise the reply buffer is freed with
+ * the next command sent on o.
+ */
+static int binder_txn(struct binder_conn *c, struct binder_out *o,
+		      size_t handle, uint32_t code, const void *data,
+		      size_t size, const size_t *offsets, size_t offsets_size,
+		      uint32_t flags, struct binder_transaction_data *reply)
+{
+	struct binder_transaction_data txn;
+	uint32_t rbuf[64];
+	int done = 0;
+
+	memset(&txn, 0, sizeof(txn));
+	txn.target.handle = handle;
+	txn.code = code;
+	txn.flags = flags;
+	txn.data_size = size;
+	txn.offsets_size = offsets_size;
+	txn.data.ptr.buffer = data;
+	txn.data.ptr.offsets = offsets;
+	out_cmd(o, BC_TRANSACTION, &txn, sizeof(txn));
+
+	while (!done) {
+		char *p = (char *)rbuf, *end;
+		size_t len;
+
+		if (binder_io(c, o, rbuf, sizeof(rbuf), &len))
+			return -1;
+
+		for (end = p + len; p < end; ) {
+			uint32_t cmd = *(uint32_t *)p;
+
+			p += sizeof(cmd);
+			switch (cmd) {
+			case BR_NOOP:
+				break;
+			case BR_TRANSACTION_COMPLETE:
+				if (flags & TF_ONE_WAY)
+					done = 1;
+				break;
+			case BR_REPLY:
+				memcpy(&txn, p, sizeof(txn));
+				if (reply)
+					*reply = txn;
+				else
+					out_free(o, txn.data.ptr.buffer);
+				done = 1;
+				break;
+			case BR_DEAD_REPLY:
+			case BR_FAILED_REPLY:
+				return -EAGAIN;
+			default:
+				fprintf(stderr, "binder: unexpected 0x%x\n",
+					cmd);
+				return -1;
+			}
+			p += _IOC_SIZE(cmd);
+		}
+	}
+
+	return 0;
+}
+
+/* minimal parcel for talking to servicemanager */
+struct parcel {
+	char data[512];
+	size_t len;
+	size_t offsets[1];
+	size_t offsets_cnt;
+};
+
+static void parcel_u32(struct parcel *p, uint32_t v)
+{
+	memcpy(p->data + p->len, &v, sizeof(v));
+	p->len += sizeof(v);
+}
+
+static void parcel_string16(struct parcel *p, const char *s)
+{
+	size_t i, n = strlen(s);
+
+	parcel_u32(p, n);
+	for (i = 0; i <= n; i++) {
+		uint16_t ch = (unsigned char)s[i];
+
+		memcpy(p->data + p->len, &ch, sizeof(ch));
+		p->len += sizeof(ch);
+	}
+	p->len = (p->len + 3) & ~3;
+}
+
+static void parcel_binder(struct parcel *p, void *ptr)
+{
+	struct flat_binder_object obj;
+
+	memset(&obj, 0, sizeof(obj));
+	obj.type = BINDER_TYPE_BINDER;
+	obj.flags = 0x7f | FLAT_BINDER_FLAG_ACCEPTS_FDS;
+	obj.binder = ptr;
+	p->offsets[p->offsets_cnt++] = p->len;
+	memcpy(p->data + p->len, &obj, sizeof(obj));
+	p->len += sizeof(obj);
+}
+
+static void parcel_svcmgr(struct parcel *p, const char *name)
+{
+	memset(p, 0, sizeof(*p));
+	parcel_u32(p, 0);	/* strict mode policy */
+	parcel_string16(p, SVC_MGR_NAME);
+	parcel_string16(p, name);
+}
+
+static int svcmgr_add(struct binder_conn *c, void *node)
+{
+	struct binder_transaction_data reply;
+	struct binder_out o = { .len = 0 };
+	struct parcel p;
+	int ret;
+
+	parcel_svcmgr(&p, BENCH_SERVICE);
+	parcel_binder(&p, node);
+	ret = binder_txn(c, &o, 0, SVC_MGR_ADD_SERVICE, p.data, p.len,
+			 p.offsets, p.offsets_cnt * sizeof(size_t), 0, &reply);
+	if (ret)
+		return ret;
+	if (reply.data_size < sizeof(uint32_t) ||
+	    *(const uint32_t *)reply.data.ptr.buffer)
+		ret = -1;
+
+	out_free(&o, reply.data.ptr.buffer);
+	binder_io(c, &o, NULL, 0, NULL);
+
+	return ret;
+}
+
+static int svcmgr_check(struct binder_conn *c, size_t *handle)
+{
+	struct binder_transaction_data reply;
+	const struct flat_binder_object *obj;
+	struct binder_out o = { .len = 0 };
+	struct parcel p;
+	int ret;
+
+	parcel_svcmgr(&p, BENCH_SERVICE);
+	ret = binder_txn(c, &o, 0, SVC_MGR_CHECK_SERVICE, p.data, p.len,
+			 NULL, 0, 0, &reply);
+	if (ret)
+		return ret;
+
+	obj = reply.data.ptr.buffer;
+	if (reply.data_size < sizeof(*obj) ||
+	    obj->type != BINDER_TYPE_HANDLE) {
+		ret = -1;
+	} else {
+		/* keep the reference the reply buffer carried */
+		uint32_t desc = obj->handle;
+
+		*handle = obj->handle;
+		out_cmd(&o, BC_ACQUIRE, &desc, sizeof(desc));
+	}
+
+	out_free(&o, reply.data.ptr.buffer);
+	binder_io(c, &o, NULL, 0, NULL);
+
+	return ret;
+}
+
+static void *binder_server_thread(void *arg)
+{
+	struct binder_conn *c = arg;
+	struct binder_out o = { .len = 0 };
+	uint32_t rbuf[64];
+
+	out_cmd(&o, BC_ENTER_LOOPER, NULL, 0);
+	for (;;) {
+		char *p = (char *)rbuf, *end;
+		size_t len;
+
+		if (binder_io(c, &o, rbuf, sizeof(rbuf), &len))
+			exit(1);
+
+		for (end = p + len; p < end; ) {
+			uint32_t cmd = *(uint32_t *)p;
+			struct binder_transaction_data txn, empty;
+
+			p += sizeof(cmd);
+			switch (cmd) {
+			case BR_INCREFS:
+				out_cmd(&o, BC_INCREFS_DONE, p,
+					sizeof(struct binder_ptr_cookie));
+				break;
+			case BR_ACQUIRE:
+				out_cmd(&o, BC_ACQUIRE_DONE, p,
+					sizeof(struct binder_ptr_cookie));
+				break;
+			case BR_TRANSACTION:
+				memcpy(&txn, p, sizeof(txn));
+				out_free(&o, txn.data.ptr.buffer);
+				if (txn.flags & TF_ONE_WAY)
+					break;
+				memset(&empty, 0, sizeof(empty));
+				out_cmd(&o, BC_REPLY, &empty, sizeof(empty));
+				break;
+			default:
+				break;
+			}
+			p += _IOC_SIZE(cmd);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Fork the server.  Returns its pid and sets *handle to the handle the
+ * client has to use, or returns -1.
+ */
+static pid_t binder_server_start(struct binder_conn *client, size_t *handle)
+{
+	static char node;
+	int pfd[2];
+	char mode;
+	pid_t pid;
+
+	if (pipe(pfd))
+		return -1;
+
+	pid = fork();
+	if (pid < 0)
+		return -1;
+
+	if (!pid) {
+		struct binder_conn c;
+		pthread_t thr;
+		int i;
+
+		close(pfd[0]);
+		if (binder_conn_open(&c))
+			exit(1);
+		if (!ioctl(c.fd, BINDER_SET_CONTEXT_MGR, 0))
+			mode = 'm';
+		else if (!svcmgr_add(&c, &node))
+			mode = 's';
+		else
+			exit(1);
+
+		for (i = 1; i < BINDER_SERVER_THREADS; i++)
+			pthread_create(&thr, NULL, binder_server_thread, &c);
+		if (write(pfd[1], &mode, 1) != 1)
+			exit(1);
+		binder_server_thread(&c);
+		exit(0);
+	}
+
+	close(pfd[1]);
+	if (read(pfd[0], &mode, 1) != 1) {
+		fprintf(stderr, "binder: server failed to start\n");
+		close(pfd[0]);
+		waitpid(pid, NULL, 0);
+		return -1;
+	}
+	close(pfd[0]);
+
+	*handle = 0;
+	if (mode == 's' && svcmgr_check(client, handle)) {
+		fprintf(stderr, "binder: cannot look up %s\n", BENCH_SERVICE);
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+		return -1;
+	}
+
+	return pid;
+}
+
+static void binder_server_stop(pid_t pid)
+{
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+struct binder_client {
+	pthread_t thread;
+	struct binder_conn *conn;
+	size_t handle;
+	size_t size;
+	uint32_t flags;
+	unsigned int ops;
+	unsigned int failed;
+	struct lat lat;
+};
+
+static void *binder_client_thread(void *arg)
+{
+	struct binder_client *cl = arg;
+	struct binder_out o = { .len = 0 };
+	unsigned int i;
+	char *data;
+
+	data = calloc(1, cl->size);
+	if (!data)
+		return NULL;
+
+	lat_init(&cl->lat, cl->ops);
+	for (i = 0; i < cl->ops; i++) {
+		uint64_t t = now_ns();
+		int ret;
+
+		ret = binder_txn(cl->conn, &o, cl->handle, BENCH_CODE, data,
+				 cl->size, NULL, 0, cl->flags, NULL);
+		if (ret == -EAGAIN) {
+			/* async space is full, let the server catch up */
+			cl->failed++;
+			i--;
+			sched_yield();
+			continue;
+		}
+		if (ret)
+			break;
+		lat_add(&cl->lat, now_ns() - t);
+	}
+	if (o.len)
+		binder_io(cl->conn, &o, NULL, 0, NULL);
+
+	free(data);
+	return NULL;
+}
+
+static int binder_run(const char *name, uint32_t flags, const size_t *sizes,
+		      size_t nsizes, const unsigned int *threads,
+		      size_t nthreads)
+{
+	struct binder_client cl[BINDER_SERVER_THREADS];
+	struct binder_conn conn;
+	size_t handle, s, t;
+	unsigned int i, failed;
+	struct lat all;
+	pid_t pid;
+
+	if (binder_conn_open(&conn))
+		return 1;
+
+	pid = binder_server_start(&conn, &handle);
+	if (pid < 0) {
+		binder_conn_close(&conn);
+		return 1;
+	}
+
+	for (s = 0; s < nsizes; s++) {
+		for (t = 0; t < nthreads; t++) {
+			unsigned int n = threads[t];
+
+			if (n > BINDER_SERVER_THREADS)
+				n = BINDER_SERVER_THREADS;
+
+			hist_begin();
+			lat_init(&all, opts.iters);
+			for (i = 0; i < n; i++) {
+				cl[i].conn = &conn;
+				cl[i].handle = handle;
+				cl[i].size = sizes[s];
+				cl[i].flags = flags;
+				cl[i].ops = opts.iters / n;
+				cl[i].failed = 0;
+				pthread_create(&cl[i].thread, NULL,
+					       binder_client_thread, &cl[i]);
+			}
+			failed = 0;
+			for (i = 0; i < n; i++) {
+				pthread_join(cl[i].thread, NULL);
+				lat_merge(&all, &cl[i].lat);
+				lat_free(&cl[i].lat);
+				failed += cl[i].failed;
+			}
+			lat_report(&all, name, sizes[s], n);
+			if (failed)
+				printf("%s size=%zu threads=%u retries=%u\n",
+				       name, sizes[s], n, failed);
+			lat_free(&all);
+			hist_end(name);
+		}
+	}
+
+	binder_server_stop(pid);
+	binder_conn_close(&conn);
+
+	return 0;
+}
+
+int binder_bench(void)
+{
+	size_t size = opts.size;
+	unsigned int threads = opts.threads;
+
+	return binder_run("binder_rtt", 0,
+			  size ? &size : binder_sizes,
+			  size ? 1 : ARRAY_SIZE(binder_sizes),
+			  threads ? &threads : binder_threads,
+			  threads ? 1 : ARRAY_SIZE(binder_threads));
+}
+
+int binder_oneway_bench(void)
+{
+	static const size_t sizes[] = { 256, 4096 };
+	size_t size = opts.size;
+	unsigned int threads = opts.threads ? opts.threads : 1;
+
+	return binder_run("binder_oneway", TF_ONE_WAY,
+			  size ? &size : sizes, size ? 1 : ARRAY_SIZE(sizes),
+			  &threads, 1);
+}
@@ -0,0 +1,193 @@
+/*
+ * Logger write throughput with concurrent readers.
+ *
+ * Writer threads log entries of a fixed payload size to the main log as
+ * fast as they can while reader threads drain it, the way logcat does.
+ * Every write is timed; the readers report how many entries they saw.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "logger.h"
+#include "android-bench.h"
+
+#define LOGGER_DEV		"/dev/log/main"
+#define LOGGER_TAG		"android-bench"
+#define LOGGER_MAX_THREADS	16
+
+static const size_t logger_sizes[] = { 64, 512, 4000 };
+static const unsigned int logger_writers[] = { 1, 4 };
+static const unsigned int logger_readers[] = { 0, 1, 4 };
+
+static volatile int readers_stop;
+
+struct logger_writer {
+	pthread_t thread;
+	size_t size;
+	unsigned int ops;
+	struct lat lat;
+};
+
+struct logger_reader {
+	pthread_t thread;
+	unsigned long entries;
+	unsigned long bytes;
+};
+
+static void *logger_writer_thread(void *arg)
+{
+	struct logger_writer *w = arg;
+	unsigned char prio = 3;	/* ANDROID_LOG_DEBUG */
+	struct iovec vec[3];
+	unsigned int i;
+	char *msg;
+	int fd;
+
+	lat_init(&w->lat, w->ops);
+
+	fd = open(LOGGER_DEV, O_WRONLY);
+	if (fd < 0) {
+		perror(LOGGER_DEV);
+		return NULL;
+	}
+	msg = malloc(w->size);
+	if (!msg) {
+		close(fd);
+		return NULL;
+	}
+	memset(msg, 'x', w->size - 1);
+	msg[w->size - 1] = '\0';
+
+	vec[0].iov_base = &prio;
+	vec[0].iov_len = 1;
+	vec[1].iov_base = LOGGER_TAG;
+	vec[1].iov_len = sizeof(LOGGER_TAG);
+	vec[2].iov_base = msg;
+	vec[2].iov_len = w->size;
+
+	for (i = 0; i < w->ops; i++) {
+		uint64_t t = now_ns();
+
+		if (writev(fd, vec, 3) < 0) {
+			perror("logger write");
+			break;
+		}
+		lat_add(&w->lat, now_ns() - t);
+	}
+
+	free(msg);
+	close(fd);
+	return NULL;
+}
+
+static void *logger_reader_thread(void *arg)
+{
+	struct logger_reader *r = arg;
+	char buf[LOGGER_ENTRY_MAX_LEN + 1];
+	struct pollfd pfd;
+	int fd;
+
+	fd = open(LOGGER_DEV, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		perror(LOGGER_DEV);
+		return NULL;
+	}
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	while (!readers_stop) {
+		ssize_t n = read(fd, buf, sizeof(buf));
+
+		if (n > 0) {
+			r->entries++;
+			r->bytes += n;
+		} else if (n < 0 && errno == EAGAIN) {
+			poll(&pfd, 1, 100);
+		} else if (n < 0 && errno != EINTR) {
+			perror("logger read");
+			break;
+		}
+	}
+
+	close(fd);
+	return NULL;
+}
+
+static void logger_run(size_t size, unsigned int nwriters,
+		       unsigned int nreaders)
+{
+	struct logger_writer w[LOGGER_MAX_THREADS];
+	struct logger_reader r[LOGGER_MAX_THREADS];
+	unsigned long entries = 0;
+	struct lat all;
+	unsigned int i;
+
+	if (nwriters > LOGGER_MAX_THREADS)
+		nwriters = LOGGER_MAX_THREADS;
+	if (nreaders > LOGGER_MAX_THREADS)
+		nreaders = LOGGER_MAX_THREADS;
+
+	hist_begin();
+	readers_stop = 0;
+	for (i = 0; i < nreaders; i++) {
+		memset(&r[i], 0, sizeof(r[i]));
+		pthread_create(&r[i].thread, NULL, logger_reader_thread, &r[i]);
+	}
+
+	lat_init(&all, opts.iters);
+	for (i = 0; i < nwriters; i++) {
+		w[i].size = size;
+		w[i].ops = opts.iters / nwriters;
+		pthread_create(&w[i].thread, NULL, logger_writer_thread, &w[i]);
+	}
+	for (i = 0; i < nwriters; i++) {
+		pthread_join(w[i].thread, NULL);
+		lat_merge(&all, &w[i].lat);
+		lat_free(&w[i].lat);
+	}
+	lat_report(&all, "logger_write", size, nwriters);
+	lat_free(&all);
+
+	readers_stop = 1;
+	for (i = 0; i < nreaders; i++) {
+		pthread_join(r[i].thread, NULL);
+		entries += r[i].entries;
+	}
+	printf("logger_read size=%zu threads=%u readers=%u entries=%lu\n",
+	       size, nwriters, nreaders, entries);
+	hist_end("logger");
+}
+
+int logger_bench(void)
+{
+	size_t s, size = opts.size;
+	unsigned int wi, ri, writers = opts.threads;
+
+	if (size > LOGGER_ENTRY_MAX_PAYLOAD - sizeof(LOGGER_TAG) - 1)
+		size = LOGGER_ENTRY_MAX_PAYLOAD - sizeof(LOGGER_TAG) - 1;
+
+	for (s = 0; s < (size ? 1 : ARRAY_SIZE(logger_sizes)); s++) {
+		for (wi = 0; wi < (writers ? 1 : ARRAY_SIZE(logger_writers));
+		     wi++) {
+			for (ri = 0; ri < ARRAY_SIZE(logger_readers); ri++)
+				logger_run(size ? size : logger_sizes[s],
+					   writers ? writers :
+					   logger_writers[wi],
+					   logger_readers[ri]);
+		}
+	}
+
+	return 0;
+}